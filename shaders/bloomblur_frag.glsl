@@ -0,0 +1,16 @@
+varying vec2 texCoord;
+
+uniform sampler2D tex;
+uniform float stepX;
+uniform float stepY;
+
+// Nine tap Gaussian filter along one axis, with the pairs of taps on each
+// side merged into single linearly filtered samples
+void main(void)
+{
+    vec2 dir = vec2(stepX, stepY);
+    vec4 sum = texture2D(tex, texCoord) * 0.2270270;
+    sum += (texture2D(tex, texCoord + dir * 1.3846154) + texture2D(tex, texCoord - dir * 1.3846154)) * 0.3162162;
+    sum += (texture2D(tex, texCoord + dir * 3.2307692) + texture2D(tex, texCoord - dir * 3.2307692)) * 0.0702703;
+    gl_FragColor = sum;
+}
@@ -0,0 +1,10 @@
+attribute vec3 in_Position;
+attribute vec4 in_Color;
+varying vec4 color;
+
+void main(void)
+{
+    gl_PointSize = 1.0;
+    color = in_Color;
+    set_vp(vec4(in_Position, 1.0));
+}
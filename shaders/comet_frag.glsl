@@ -1,7 +1,7 @@
-uniform vec3 color;
+varying vec3 tailColor;
 varying float shade;
 
 void main(void)
 {
-    gl_FragColor = vec4(color, shade);
+    gl_FragColor = vec4(tailColor, shade);
 }
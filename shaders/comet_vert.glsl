@@ -1,15 +1,36 @@
+// Template tail: squared distance along the tail and radius, relative to
+// the tail length and radius, and sine and cosine of the angle around it
 attribute vec4 in_Position;
-attribute vec3 in_Normal;
+// Weights of the tail axis and the radial direction in the normal
+attribute vec2 in_TexCoord0;
 attribute float in_Brightness;
 
-uniform vec3 color;
-uniform vec3 viewDir;
-uniform float fadeFactor;
+// Per comet parameters
+attribute vec4 in_CometPosition; // nucleus position, tail length
+attribute vec4 in_CometAxis;     // direction away from the sun, tail start offset
+attribute vec4 in_CometBasis;    // direction orthogonal to the axis, fade factor
+attribute vec4 in_CometColor;
 
+varying vec3 tailColor;
 varying float shade;
 
+const float DustTailRadiusRatio = 0.1;
+
 void main(void)
 {
-    shade = abs(dot(viewDir.xyz, in_Normal.xyz) * in_Brightness * fadeFactor);
-    set_vp(in_Position);
+    vec3 v = in_CometAxis.xyz;
+    vec3 u = in_CometBasis.xyz;
+    vec3 w = cross(u, v);
+    float tailLength = in_CometPosition.w;
+
+    vec3 radial = u * in_Position.z + w * in_Position.w;
+    vec3 normal = normalize(radial * in_TexCoord0.y + v * in_TexCoord0.x);
+    vec3 p = in_CometPosition.xyz +
+             v * (tailLength * in_Position.x - in_CometAxis.w) +
+             radial * (tailLength * DustTailRadiusRatio * in_Position.y);
+
+    vec3 viewDir = normalize(in_CometPosition.xyz);
+    shade = abs(dot(viewDir, normal) * in_Brightness * in_CometBasis.w);
+    tailColor = in_CometColor.rgb;
+    set_vp(vec4(p, 1.0));
 }
@@ -0,0 +1,23 @@
+varying vec2 texCoord;
+varying float intensity;
+
+uniform samplerCube tex;
+uniform float halfAperture;
+
+void main(void)
+{
+    // Point of the fisheye view, within the unit circle
+    vec2 p = texCoord * 2.0 - 1.0;
+    float r = length(p);
+    if (r > 1.0)
+    {
+        gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    // Direction in the camera space, which looks down the -z axis
+    float theta = r * halfAperture;
+    vec2 d = r > 0.0 ? p / r : vec2(0.0);
+    vec3 dir = vec3(sin(theta) * d, -cos(theta));
+    gl_FragColor = vec4(textureCube(tex, dir).rgb * intensity, 1.0);
+}
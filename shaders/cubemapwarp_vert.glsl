@@ -0,0 +1,15 @@
+attribute vec2 in_Position;
+attribute vec2 in_TexCoord0;
+attribute float in_Intensity;
+
+varying vec2 texCoord;
+varying float intensity;
+
+uniform float screenRatio;
+
+void main(void)
+{
+    gl_Position = vec4(in_Position.x * screenRatio, in_Position.y, 0.0, 1.0);
+    texCoord = in_TexCoord0;
+    intensity = in_Intensity;
+}
@@ -1,16 +1,16 @@
 
-uniform mat4 m;
+// One element per instance, see GalaxyInstancesPerDraw in galaxy.cpp
+uniform mat4 m[32];
+// x = size, y = brightness, z = minimum feature size
+uniform vec4 params[32];
 uniform mat3 viewMat;
 
-uniform float size;
-uniform float brightness;
-uniform float minimumFeatureSize;
-
 in Vertex
 {
     vec3  color;
     float size;
     float brightness;
+    flat int instance;
 } vertex[];
 
 out vec4 v_Color;
@@ -18,10 +18,11 @@ out vec2 v_TexCoord;
 
 void main()
 {
-    float s = size * vertex[0].size;
-    if (s >= minimumFeatureSize)
+    vec4 instance = params[vertex[0].instance];
+    float s = instance.x * vertex[0].size;
+    if (s >= instance.z)
     {
-        vec4 p = m * gl_in[0].gl_Position;
+        vec4 p = m[vertex[0].instance] * gl_in[0].gl_Position;
         float screenFrac = s / length(p);
         if (screenFrac < 0.1)
         {
@@ -32,7 +33,7 @@ void main()
             vec4 v1 = vec4(viewMat * vec3(-1.0, -1.0, 0.0) * s, 0.0);
             vec4 v2 = vec4(viewMat * vec3( 1.0,  1.0, 0.0) * s, 0.0);
             vec4 v3 = vec4(viewMat * vec3( 1.0, -1.0, 0.0) * s, 0.0);
-            float alpha = (0.1 - screenFrac) * vertex[0].brightness * brightness;
+            float alpha = (0.1 - screenFrac) * vertex[0].brightness * instance.y;
             vec4 color = vec4(vertex[0].color, alpha);
 
             gl_Position = MVPMatrix * (p + v0);
@@ -10,6 +10,7 @@ out Vertex
     vec3  color;
     float size;
     float brightness;
+    flat int instance;
 } vertex;
 
 void main()
@@ -17,5 +18,6 @@ void main()
     gl_Position = in_Position;
     vertex.size = in_Size;
     vertex.brightness = in_Brightness;
+    vertex.instance = gl_InstanceID;
     vertex.color = texture(colorTex, vec2(in_ColorIndex, 0.0)).rgb;
 }
@@ -0,0 +1,10 @@
+in vec4 color;
+
+uniform sampler2D starTex;
+
+out vec4 v_FragColor;
+
+void main(void)
+{
+    v_FragColor = vec4(color.rgb, color.a * texture(starTex, gl_PointCoord.xy).r);
+}
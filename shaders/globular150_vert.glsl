@@ -0,0 +1,46 @@
+in vec3 in_Position;
+in vec3 in_TexCoord0; // reuse it for starSize, relStarDensity and colorIndex
+
+uniform sampler2D colorTex;
+// One element per instance, see GlobularInstancesPerDraw in globular.cpp
+uniform mat4 m[32];
+// x = brightness, y = pixelWeight, z = scale, w = number of stars
+uniform vec4 params[32];
+
+const float clipDistance = 100.0; // observer distance [ly] from globular, where we
+                                  // start "morphing" the star-sprite sizes towards
+                                  // their physical values
+
+out vec4 color;
+
+void main(void)
+{
+    vec4 instance = params[gl_InstanceID];
+
+    // The star sprites follow the four tidal vertices; those beyond the
+    // star count of this instance are moved out of the clip volume.
+    if (float(gl_VertexID - 4) >= instance.w)
+    {
+        gl_PointSize = 1.0;
+        color = vec4(0.0);
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+        return;
+    }
+
+    float starSize = in_TexCoord0.s;
+    float relStarDensity = in_TexCoord0.t;
+    float colorIndex = in_TexCoord0.p;
+
+    vec4 p = m[gl_InstanceID] * vec4(in_Position, 1.0);
+    float br = 2.0 * instance.x;
+
+    float s = br * starSize * instance.z;
+
+    // "Morph" the star-sprite sizes at close observer distance such that
+    // the overdense globular core is dissolved upon closing in.
+    float obsDistanceToStarRatio = length(p.xyz) / clipDistance;
+    gl_PointSize = s * min(obsDistanceToStarRatio, 1.0);
+
+    color = vec4(texture(colorTex, vec2(colorIndex, 0.0)).rgb, min(1.0, br * (1.0 - instance.y * relStarDensity)));
+    set_vp(p);
+}
@@ -0,0 +1,11 @@
+uniform sampler2D starTex;
+uniform float textured;
+varying vec4 color;
+
+void main(void)
+{
+    if (textured > 0.5)
+        gl_FragColor = texture2D(starTex, gl_PointCoord) * color;
+    else
+        gl_FragColor = color;
+}
@@ -0,0 +1,93 @@
+attribute vec3 in_Position;
+attribute vec4 in_Color;
+attribute vec2 in_TexCoord0; // absolute magnitude and extinction
+
+uniform vec3 observerPos;
+uniform float limitingMag;
+uniform float faintestMag;
+uniform float brightnessScale;
+uniform float brightnessBias;
+uniform float satPoint;
+uniform float baseSize;
+uniform float pointScale;
+uniform float minDistance;
+uniform float maxDistance;
+uniform float scaledDiscs; // 1.0 for scaled disc stars
+uniform float basicPoints; // 1.0 for fixed size points
+uniform float glare;       // 1.0 when drawing the glare pass
+
+varying vec4 color;
+
+const float LY_PER_PARSEC = 3.26167;
+const float INV_LN10 = 0.4342945;
+const float MaxScaledDiscStarSize = 8.0;
+const float GlareOpacity = 0.65;
+
+void cull()
+{
+    gl_PointSize = 0.0;
+    color = vec4(0.0);
+    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+}
+
+void main(void)
+{
+    vec3 relPos = in_Position - observerPos;
+    float distance = length(relPos);
+
+    // Stars with an alpha of zero are handled on the CPU, as are the stars
+    // closer than minDistance.
+    if (in_Color.a == 0.0 || distance < minDistance || distance > maxDistance)
+    {
+        cull();
+        return;
+    }
+
+    float appMag = in_TexCoord0.x - 5.0 + 5.0 * INV_LN10 * log(distance / LY_PER_PARSEC) + in_TexCoord0.y * distance;
+    if (appMag >= limitingMag)
+    {
+        cull();
+        return;
+    }
+
+    // Same as Renderer::calculatePointSize()
+    float alpha = max(0.0, (faintestMag - appMag) * brightnessScale + brightnessBias);
+    float discSize = baseSize;
+    float glareSize = 0.0;
+    float glareAlpha = 0.0;
+    if (alpha > 1.0)
+    {
+        if (scaledDiscs > 0.5)
+        {
+            float discScale = min(MaxScaledDiscStarSize, pow(2.0, 0.3 * (satPoint - appMag)));
+            discSize *= max(1.0, discScale);
+            glareAlpha = min(0.5, discScale / 4.0);
+            glareSize = discSize * 3.0;
+        }
+        else
+        {
+            float discScale = min(100.0, satPoint - appMag + 2.0);
+            glareAlpha = min(GlareOpacity, (discScale - 2.0) / 4.0);
+            glareSize = 2.0 * discScale * baseSize;
+        }
+        alpha = 1.0;
+    }
+
+    if (glare > 0.5)
+    {
+        if (glareSize == 0.0)
+        {
+            cull();
+            return;
+        }
+        gl_PointSize = glareSize;
+        color = vec4(in_Color.rgb, glareAlpha);
+    }
+    else
+    {
+        gl_PointSize = basicPoints > 0.5 ? pointScale : discSize;
+        color = vec4(in_Color.rgb, alpha);
+    }
+
+    set_vp(vec4(relPos, 1.0));
+}
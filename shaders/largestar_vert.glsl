@@ -1,16 +1,19 @@
-attribute vec2 in_Position;
+attribute vec3 in_Position;
+attribute vec4 in_Color;
+attribute float in_PointSize;
 attribute vec2 in_TexCoord0;
 
-uniform float pointWidth;
-uniform float pointHeight;
-uniform vec3 center;
+uniform float pixelWidth;
+uniform float pixelHeight;
 
 varying vec2 texCoord;
+varying vec4 color;
 
 void main(void)
 {
     texCoord = in_TexCoord0.st;
-    set_vp(vec4(center, 1.0));
-    vec2 transformed = vec2(in_Position.x * pointWidth, in_Position.y * pointHeight);
-    gl_Position.xy += transformed * gl_Position.w;
+    color = in_Color;
+    set_vp(vec4(in_Position, 1.0));
+    vec2 offset = vec2(in_TexCoord0.s - 0.5, 0.5 - in_TexCoord0.t) * in_PointSize;
+    gl_Position.xy += vec2(offset.x * pixelWidth, offset.y * pixelHeight) * gl_Position.w;
 }
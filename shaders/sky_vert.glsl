@@ -0,0 +1,93 @@
+attribute vec2 in_Position; // angle around the limb and ring index
+
+// Planet center relative to the eye, the rotation from the planet to the
+// view frame and the view vector in the planet frame
+uniform vec3 center;
+uniform mat3 invRotation;
+uniform vec3 eyeVec;
+uniform vec3 recipSemiAxes;
+// Axes of the plane of the limb, scaled by the distance to the center
+uniform vec3 uAxis;
+uniform vec3 vAxis;
+uniform vec3 zenith;
+uniform float horizonHeight;
+uniform float horizonRings;
+uniform float rings;
+
+uniform vec3 sunDirection;
+uniform vec3 botColor;
+uniform vec3 topColor;
+uniform vec3 sunsetColor;
+uniform float sunset;
+uniform float minOpacity;
+uniform float fade;
+uniform float lit;
+
+varying vec4 color;
+
+// The point where the ray from the eye in the direction of the plane
+// through the eye and w touches the ellipsoid
+vec3 ellipsoidTangent(vec3 w, vec3 e, vec3 e_, float ee)
+{
+    vec3 w_ = w * recipSemiAxes;
+    float ww = dot(w_, w_);
+    float ew = dot(w_, e_);
+
+    float a = 4.0 * (ew * ew - ee * ww + ee + 2.0 * ew + ww);
+    float b = -8.0 * (ee + ew);
+    float c = 4.0 * ee;
+
+    float discriminant = abs(b * b - 4.0 * a * c);
+    float t = (-b + sqrt(discriminant)) / (2.0 * a);
+
+    vec3 v = -e * (1.0 - t) + w * t;
+    vec3 v_ = v * recipSemiAxes;
+    float a1 = dot(v_, v_);
+    float b1 = 2.0 * dot(v_, e_);
+    float t1 = -b1 / (2.0 * a1);
+
+    return e + v * t1;
+}
+
+void main(void)
+{
+    float theta = in_Position.x;
+    float ring = in_Position.y;
+
+    vec3 e = -eyeVec;
+    vec3 e_ = e * recipSemiAxes;
+    float ee = dot(e_, e_);
+
+    // The point of the limb of the planet in this direction
+    vec3 w = cos(theta) * uAxis + sin(theta) * vAxis;
+    vec3 limb = invRotation * ellipsoidTangent(w, e, e_, ee);
+    float limbDist = length(limb);
+    vec3 limbEyeDir = normalize(limb + center);
+
+    float h = min(1.0, ring / horizonRings);
+    float hh = sqrt(h);
+    float u = ring <= horizonRings ? 0.0 : (ring - horizonRings) / (rings - horizonRings);
+    float r = mix(1.0 - horizonHeight * 0.05, 1.0 + horizonHeight, h);
+    vec3 p = center + mix(limb, zenith, u) * r;
+
+    vec3 viewDir = normalize(p);
+    float brightness = 1.0;
+    float coloration = 0.0;
+    if (lit > 0.0)
+    {
+        float cosSunAngle = dot(viewDir, sunDirection);
+        float cosAltitude = dot(viewDir, limbEyeDir);
+        if (sunset > 0.0 && cosSunAngle > 0.7 && cosAltitude > 0.98)
+            coloration = (1.0 / 0.30) * (cosSunAngle - 0.70) * 50.0 * (cosAltitude - 0.98) * sunset;
+
+        brightness = clamp((dot(limb, sunDirection) / limbDist + 0.2) * 2.0, 0.0, 1.0);
+    }
+
+    float atten = 1.0 - hh;
+    vec3 c = mix(botColor, topColor, hh);
+    brightness *= minOpacity + (1.0 - minOpacity) * fade * atten;
+    c = mix(c, sunsetColor, coloration);
+
+    color = clamp(vec4(brightness * c, fade * atten), 0.0, 1.0);
+    set_vp(vec4(p, 1.0));
+}
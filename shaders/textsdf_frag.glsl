@@ -0,0 +1,13 @@
+varying vec2 texCoord;
+varying vec4 color;
+
+uniform sampler2D atlasTex;
+uniform float distanceScale;
+
+void main(void)
+{
+    // The outline is at 0.5, distanceScale converts the distance from it
+    // to pixels on the screen
+    float distance = texture2D(atlasTex, texCoord).a - 0.5;
+    gl_FragColor = vec4(color.rgb, clamp(distance * distanceScale + 0.5, 0.0, 1.0) * color.a);
+}
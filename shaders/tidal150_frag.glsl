@@ -0,0 +1,11 @@
+in vec2 texCoord;
+in vec4 color;
+
+uniform sampler2D tidalTex;
+
+out vec4 v_FragColor;
+
+void main(void)
+{
+    v_FragColor = vec4(color.rgb, color.a * texture(tidalTex, texCoord).r);
+}
@@ -0,0 +1,25 @@
+in vec3 in_Position;
+in vec3 in_TexCoord0; // reuse [3] as colorIndex
+
+uniform sampler2D colorTex;
+uniform mat3 viewMat;
+// One element per instance, see GlobularInstancesPerDraw in globular.cpp
+// xyz = offset, w = tidalSize
+uniform vec4 offsets[32];
+// x = brightness, y = pixelWeight
+uniform vec4 params[32];
+
+out vec2 texCoord;
+out vec4 color;
+
+void main(void)
+{
+    vec4 offset = offsets[gl_InstanceID];
+    vec4 instance = params[gl_InstanceID];
+
+    vec3 p = viewMat * in_Position.xyz * offset.w + offset.xyz;
+    texCoord = in_TexCoord0.st;
+    float colorIndex = in_TexCoord0.p;
+    color = vec4(texture(colorTex, vec2(colorIndex, 0.0)).rgb, min(1.0, 2.0 * instance.x * instance.y));
+    set_vp(vec4(p, 1.0));
+}
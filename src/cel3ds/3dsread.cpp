@@ -495,7 +495,7 @@ bool processTriangleMeshChunk(std::istream& in, M3DChunkType chunkType, std::int
 }
 
 
-bool processModelChunk(std::istream& in, M3DChunkType chunkType, std::int32_t contentSize, M3DModel& model)
+bool processModelChunk(std::istream& in, M3DChunkType chunkType, std::int32_t contentSize, M3DSceneHandler& handler)
 {
     if (chunkType != M3DChunkType::TriangleMesh)
     {
@@ -505,7 +505,7 @@ bool processModelChunk(std::istream& in, M3DChunkType chunkType, std::int32_t co
     GetLogger()->debug("Processing TriangleMesh chunk\n");
     M3DTriangleMesh triMesh;
     if (!readChunks(in, contentSize, triMesh, processTriangleMeshChunk)) { return false; }
-    model.addTriMesh(std::move(triMesh));
+    handler.triangleMesh(std::move(triMesh));
     return true;
 }
 
@@ -716,51 +716,50 @@ bool processMaterialChunk(std::istream& in, M3DChunkType chunkType, std::int32_t
 }
 
 
-bool readNamedObject(std::istream& in, std::int32_t contentSize, M3DScene& scene)
+bool readNamedObject(std::istream& in, std::int32_t contentSize, M3DSceneHandler& handler)
 {
     std::string name;
     if (!readString(in, contentSize, name)) { return false; }
-    M3DModel model;
-    model.setName(name);
-    if (!readChunks(in, contentSize, model, processModelChunk)) { return false; }
-    scene.addModel(std::move(model));
+    handler.beginObject(name);
+    if (!readChunks(in, contentSize, handler, processModelChunk)) { return false; }
+    handler.endObject();
     return true;
 }
 
 
-bool readMaterialEntry(std::istream& in, std::int32_t contentSize, M3DScene& scene)
+bool readMaterialEntry(std::istream& in, std::int32_t contentSize, M3DSceneHandler& handler)
 {
     M3DMaterial material;
     if (!readChunks(in, contentSize, material, processMaterialChunk)) { return false; }
-    scene.addMaterial(std::move(material));
+    handler.material(std::move(material));
     return true;
 }
 
 
-bool readBackgroundColor(std::istream& in, std::int32_t contentSize, M3DScene& scene)
+bool readBackgroundColor(std::istream& in, std::int32_t contentSize, M3DSceneHandler& handler)
 {
     M3DColor color;
     if (!readChunks(in, contentSize, color, processColorChunk)) { return false; }
-    scene.setBackgroundColor(color);
+    handler.backgroundColor(color);
     return true;
 }
 
 
-bool processMeshdataChunk(std::istream& in, M3DChunkType chunkType, std::int32_t contentSize, M3DScene& scene)
+bool processMeshdataChunk(std::istream& in, M3DChunkType chunkType, std::int32_t contentSize, M3DSceneHandler& handler)
 {
     switch (chunkType)
     {
     case M3DChunkType::NamedObject:
         GetLogger()->debug("Processing NamedObject chunk\n");
-        return readNamedObject(in, contentSize, scene);
+        return readNamedObject(in, contentSize, handler);
 
     case M3DChunkType::MaterialEntry:
         GetLogger()->debug("Processing MaterialEntry chunk\n");
-        return readMaterialEntry(in, contentSize, scene);
+        return readMaterialEntry(in, contentSize, handler);
 
     case M3DChunkType::BackgroundColor:
         GetLogger()->debug("Processing BackgroundColor chunk\n");
-        return readBackgroundColor(in, contentSize, scene);
+        return readBackgroundColor(in, contentSize, handler);
 
     default:
         return skipChunk(in, chunkType, contentSize);
@@ -768,7 +767,7 @@ bool processMeshdataChunk(std::istream& in, M3DChunkType chunkType, std::int32_t
 }
 
 
-bool processTopLevelChunk(std::istream& in, M3DChunkType chunkType, std::int32_t contentSize, M3DScene& scene)
+bool processTopLevelChunk(std::istream& in, M3DChunkType chunkType, std::int32_t contentSize, M3DSceneHandler& handler)
 {
     if (chunkType != M3DChunkType::Meshdata)
     {
@@ -776,32 +775,76 @@ bool processTopLevelChunk(std::istream& in, M3DChunkType chunkType, std::int32_t
     }
 
     GetLogger()->debug("Processing Meshdata chunk\n");
-    return readChunks(in, contentSize, scene, processMeshdataChunk);
+    return readChunks(in, contentSize, handler, processMeshdataChunk);
 }
 
+
+// Collects the contents of the file into a scene
+class SceneBuilder : public M3DSceneHandler
+{
+ public:
+    explicit SceneBuilder(M3DScene& _scene) : scene(_scene) {}
+
+    void material(M3DMaterial&& material) override { scene.addMaterial(std::move(material)); }
+
+    void beginObject(const std::string& name) override
+    {
+        model = M3DModel();
+        model.setName(name);
+    }
+
+    void triangleMesh(M3DTriangleMesh&& triMesh) override { model.addTriMesh(std::move(triMesh)); }
+    void endObject() override { scene.addModel(std::move(model)); }
+    void backgroundColor(const M3DColor& color) override { scene.setBackgroundColor(color); }
+
+ private:
+    M3DScene& scene;
+    M3DModel model;
+};
+
 } // end unnamed namespace
 
 
-std::unique_ptr<M3DScene> Read3DSFile(std::istream& in)
+bool Read3DSFile(std::istream& in, M3DSceneHandler& handler)
 {
     M3DChunkType chunkType;
     if (!readChunkType(in, chunkType) || chunkType != M3DChunkType::Magic)
     {
         GetLogger()->error("Read3DSFile: Wrong magic number in header\n");
-        return nullptr;
+        return false;
     }
 
     std::int32_t chunkSize;
     if (!celutil::readLE<std::int32_t>(in, chunkSize) || chunkSize < chunkHeaderSize)
     {
         GetLogger()->error("Read3DSFile: Error reading 3DS file top level chunk size\n");
-        return nullptr;
+        return false;
     }
 
     GetLogger()->verbose("3DS file, {} bytes\n", chunkSize + chunkHeaderSize);
 
+    return readChunks(in, chunkSize - chunkHeaderSize, handler, processTopLevelChunk);
+}
+
+
+bool Read3DSFile(const fs::path& filename, M3DSceneHandler& handler)
+{
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in.good())
+    {
+        GetLogger()->error("Read3DSFile: Error opening {}\n", filename);
+        return false;
+    }
+
+    return Read3DSFile(in, handler);
+}
+
+
+std::unique_ptr<M3DScene> Read3DSFile(std::istream& in)
+{
     auto scene = std::make_unique<M3DScene>();
-    if (!readChunks(in, chunkSize - chunkHeaderSize, *scene, processTopLevelChunk))
+    SceneBuilder builder(*scene);
+    if (!Read3DSFile(in, builder))
     {
         return nullptr;
     }
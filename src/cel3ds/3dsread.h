@@ -11,9 +11,32 @@
 
 #include <iosfwd>
 #include <memory>
+#include <string>
 #include <celcompat/filesystem.h>
 
+class M3DColor;
+class M3DMaterial;
 class M3DScene;
+class M3DTriangleMesh;
+
+// Receives the contents of a 3DS file in the order they are read, so that
+// a file can be converted without holding all of its meshes at once. The
+// triangle meshes of a named object are passed between beginObject() and
+// endObject().
+class M3DSceneHandler
+{
+ public:
+    virtual ~M3DSceneHandler() = default;
+
+    virtual void material(M3DMaterial&&) = 0;
+    virtual void beginObject(const std::string& /* name */) {}
+    virtual void triangleMesh(M3DTriangleMesh&&) = 0;
+    virtual void endObject() {}
+    virtual void backgroundColor(const M3DColor&) {}
+};
 
 std::unique_ptr<M3DScene> Read3DSFile(std::istream& in);
 std::unique_ptr<M3DScene> Read3DSFile(const fs::path& filename);
+
+bool Read3DSFile(std::istream& in, M3DSceneHandler& handler);
+bool Read3DSFile(const fs::path& filename, M3DSceneHandler& handler);
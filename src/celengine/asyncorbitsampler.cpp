@@ -0,0 +1,88 @@
+// asyncorbitsampler.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Samples orbits for the renderer's orbit cache on background threads.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "asyncorbitsampler.h"
+
+#include <iterator>
+#include <utility>
+
+#include <celephem/orbit.h>
+#include "orbitsampler.h"
+
+
+AsyncOrbitSampler::AsyncOrbitSampler(unsigned int nThreads)
+{
+    for (unsigned int i = 0; i < nThreads; ++i)
+        workers.emplace_back(&AsyncOrbitSampler::run, this);
+}
+
+AsyncOrbitSampler::~AsyncOrbitSampler()
+{
+    {
+        std::scoped_lock lock(mutex);
+        stopRequested = true;
+    }
+    requestReady.notify_all();
+
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void
+AsyncOrbitSampler::request(const celestia::ephem::Orbit* orbit, double startTime, double endTime, float priority)
+{
+    {
+        std::scoped_lock lock(mutex);
+        requests.push(Request{ orbit, startTime, endTime, priority });
+    }
+    requestReady.notify_one();
+}
+
+void
+AsyncOrbitSampler::clear()
+{
+    std::scoped_lock lock(mutex);
+    requests = {};
+    finished.clear();
+    ++generation;
+}
+
+void
+AsyncOrbitSampler::collect(std::vector<Result>& results)
+{
+    std::scoped_lock lock(mutex);
+    std::move(finished.begin(), finished.end(), std::back_inserter(results));
+    finished.clear();
+}
+
+void
+AsyncOrbitSampler::run()
+{
+    std::unique_lock lock(mutex);
+    for (;;)
+    {
+        requestReady.wait(lock, [this]() { return stopRequested || !requests.empty(); });
+        if (stopRequested)
+            return;
+
+        Request request = requests.top();
+        requests.pop();
+        std::uint32_t requestGeneration = generation;
+
+        lock.unlock();
+        OrbitSampler sampler;
+        request.orbit->sample(request.startTime, request.endTime, sampler);
+        lock.lock();
+
+        if (requestGeneration == generation)
+            finished.push_back(Result{ request.orbit, std::move(sampler.samples) });
+    }
+}
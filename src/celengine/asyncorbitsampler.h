@@ -0,0 +1,79 @@
+// asyncorbitsampler.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Samples orbits for the renderer's orbit cache on background threads.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "curveplot.h"
+
+namespace celestia::ephem
+{
+class Orbit;
+}
+
+// Only orbits which may be evaluated from several threads at once (see
+// Orbit::isThreadSafe) can be sampled in the background. The orbits must
+// outlive the requests for them.
+class AsyncOrbitSampler
+{
+ public:
+    struct Result
+    {
+        const celestia::ephem::Orbit* orbit;
+        std::vector<CurvePlotSample> samples;
+    };
+
+    explicit AsyncOrbitSampler(unsigned int nThreads);
+    ~AsyncOrbitSampler();
+
+    AsyncOrbitSampler(const AsyncOrbitSampler&) = delete;
+    AsyncOrbitSampler& operator=(const AsyncOrbitSampler&) = delete;
+
+    // Queue the orbit to be sampled over [startTime, endTime]. The requests
+    // with the highest priority are sampled first.
+    void request(const celestia::ephem::Orbit* orbit, double startTime, double endTime, float priority);
+
+    // Drop the queued requests and the results not collected yet; orbits
+    // which are being sampled are dropped once done.
+    void clear();
+
+    // Append the orbits sampled since the last call to results.
+    void collect(std::vector<Result>& results);
+
+ private:
+    struct Request
+    {
+        const celestia::ephem::Orbit* orbit;
+        double startTime;
+        double endTime;
+        float priority;
+
+        bool operator<(const Request& other) const { return priority < other.priority; }
+    };
+
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable requestReady;
+    std::priority_queue<Request> requests;
+    std::vector<Result> finished;
+    // Incremented by clear() to drop the requests being processed
+    std::uint32_t generation{ 0 };
+    bool stopRequested{ false };
+
+    std::vector<std::thread> workers;
+};
@@ -30,6 +30,8 @@ using namespace celmath;
 using celestia::render::LineRenderer;
 using celestia::render::VertexObject;
 
+LineRenderer *AxesReferenceMark::labelRenderer = nullptr;
+
 // draw a simple circle or annulus
 #define DRAW_ANNULUS 0
 
@@ -338,19 +340,8 @@ AxesReferenceMark::render(Renderer* renderer,
     prog->setMVPMatrices(projection, zModelView);
     RenderArrow(arrowVo);
 
-    LineRenderer lr(*renderer);
-    lr.startUpdate();
-    // X
-    lr.addSegment({0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 1.0f});
-    lr.addSegment({1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f});
-    // Y
-    lr.addSegment({0.0f, 0.0f, 1.0f}, {0.5f, 0.0f, 0.5f});
-    lr.addSegment({1.0f, 0.0f, 1.0f}, {0.5f, 0.0f, 0.5f});
-    lr.addSegment({0.5f, 0.0f, 0.0f}, {0.5f, 0.0f, 0.5f});
-    // Z
-    lr.addSegment({0.0f, 0.0f, 1.0f}, {1.0f, 0.0f, 1.0f});
-    lr.addSegment({1.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 0.0f});
-    lr.addSegment({0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f});
+    InitializeLabels(*renderer);
+    LineRenderer& lr = *labelRenderer;
 
     Eigen::Matrix4f mv;
     // X
@@ -367,6 +358,36 @@ AxesReferenceMark::render(Renderer* renderer,
 }
 
 
+void
+AxesReferenceMark::InitializeLabels(const Renderer& renderer)
+{
+    if (labelRenderer != nullptr)
+        return;
+
+    labelRenderer = new LineRenderer(renderer, 1.0f, LineRenderer::PrimType::Lines, LineRenderer::StorageType::Static);
+    LineRenderer& lr = *labelRenderer;
+    // X
+    lr.addSegment({0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 1.0f});
+    lr.addSegment({1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f});
+    // Y
+    lr.addSegment({0.0f, 0.0f, 1.0f}, {0.5f, 0.0f, 0.5f});
+    lr.addSegment({1.0f, 0.0f, 1.0f}, {0.5f, 0.0f, 0.5f});
+    lr.addSegment({0.5f, 0.0f, 0.0f}, {0.5f, 0.0f, 0.5f});
+    // Z
+    lr.addSegment({0.0f, 0.0f, 1.0f}, {1.0f, 0.0f, 1.0f});
+    lr.addSegment({1.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 0.0f});
+    lr.addSegment({0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f});
+}
+
+
+void
+AxesReferenceMark::deinit()
+{
+    delete labelRenderer;
+    labelRenderer = nullptr;
+}
+
+
 /****** VelocityVectorArrow implementation ******/
 
 VelocityVectorArrow::VelocityVectorArrow(const Body& _body) :
@@ -15,6 +15,7 @@
 #include <celengine/referencemark.h>
 #include <celengine/selection.h>
 #include <celengine/shadermanager.h>
+#include <celrender/linerenderer.h>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
@@ -82,6 +83,8 @@ class AxesReferenceMark : public ReferenceMark
 
     virtual Eigen::Quaterniond getOrientation(double tdb) const = 0;
 
+    static void deinit();
+
  protected:
     const Body& body;
 
@@ -89,6 +92,10 @@ class AxesReferenceMark : public ReferenceMark
     float size;
     float opacity;
     ShaderProperties shadprop;
+
+    // The letters labelling the axes, shared by all axes
+    static celestia::render::LineRenderer *labelRenderer;
+    static void InitializeLabels(const Renderer&);
 };
 
 
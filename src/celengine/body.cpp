@@ -10,18 +10,23 @@
 #include <cstdlib>
 #include <cassert>
 #include <algorithm>
+#include <atomic>
 #include <celcompat/numbers.h>
 #include <celmath/mathlib.h>
 #include <celutil/gettext.h>
+#include <celutil/memoryreport.h>
 #include <celutil/utf8.h>
 #include "geometry.h"
 #include "meshmanager.h"
 #include "body.h"
+#include "bodystatecache.h"
 #include "atmosphere.h"
 #include "frame.h"
 #include "timeline.h"
 #include "timelinephase.h"
 #include "frametree.h"
+#include "lazybodycatalog.h"
+#include "locationindex.h"
 #include "referencemark.h"
 #include "selection.h"
 
@@ -29,6 +34,12 @@ using namespace Eigen;
 using namespace std;
 using namespace celmath;
 
+namespace
+{
+// Counts the changes to the name indices of all planetary systems
+std::atomic<std::uint64_t> nameGeneration{ 0 };
+}
+
 
 Body::Body(PlanetarySystem* _system, const string& _name) :
     system(_system),
@@ -212,6 +223,7 @@ void Body::markChanged()
 {
     if (timeline)
         timeline->markChanged();
+    GetBodyStateCache().clear();
 }
 
 
@@ -579,6 +591,26 @@ void Body::setAtmosphere(const Atmosphere& _atmosphere)
  *  general getPosition().
  */
 UniversalCoord Body::getPosition(double tdb) const
+{
+    BodyStateCache& cache = GetBodyStateCache();
+    if (const auto* entry = cache.find(this, tdb);
+        entry != nullptr && (entry->flags & BodyStateCache::Position) != 0)
+    {
+        return entry->position;
+    }
+
+    UniversalCoord position = computePosition(tdb);
+    if (auto* entry = cache.insert(this, tdb); entry != nullptr)
+    {
+        entry->position = position;
+        entry->flags |= BodyStateCache::Position;
+    }
+
+    return position;
+}
+
+
+UniversalCoord Body::computePosition(double tdb) const
 {
     Vector3d position = Vector3d::Zero();
 
@@ -589,12 +621,12 @@ UniversalCoord Body::getPosition(double tdb) const
     while (frame->getCenter().getType() == Selection::Type_Body)
     {
         phase = frame->getCenter().body()->timeline->findPhase(tdb);
-        position += frame->getOrientation(tdb).conjugate() * p;
+        position += frame->getCachedOrientation(tdb).conjugate() * p;
         p = phase->orbit()->positionAtTime(tdb);
         frame = phase->orbitFrame();
     }
 
-    position += frame->getOrientation(tdb).conjugate() * p;
+    position += frame->getCachedOrientation(tdb).conjugate() * p;
 
     if (frame->getCenter().star())
         return frame->getCenter().star()->getPosition(tdb).offsetKm(position);
@@ -607,8 +639,52 @@ UniversalCoord Body::getPosition(double tdb) const
  */
 Quaterniond Body::getOrientation(double tdb) const
 {
+    BodyStateCache& cache = GetBodyStateCache();
+    if (const auto* entry = cache.find(this, tdb);
+        entry != nullptr && (entry->flags & BodyStateCache::Orientation) != 0)
+    {
+        return entry->orientation;
+    }
+
     auto phase = timeline->findPhase(tdb);
-    return phase->rotationModel()->orientationAtTime(tdb) * phase->bodyFrame()->getOrientation(tdb);
+    Quaterniond orientation = phase->rotationModel()->orientationAtTime(tdb) * phase->bodyFrame()->getCachedOrientation(tdb);
+    if (auto* entry = cache.insert(this, tdb); entry != nullptr)
+    {
+        entry->orientation = orientation;
+        entry->flags |= BodyStateCache::Orientation;
+    }
+
+    return orientation;
+}
+
+
+bool Body::isPositionThreadSafe() const
+{
+    for (unsigned int i = 0; i < timeline->phaseCount(); i++)
+    {
+        const auto& phase = timeline->getPhase(i);
+        if (!phase->orbit()->isThreadSafe() ||
+            !phase->orbitFrame()->isThreadSafe() ||
+            !IsPositionThreadSafe(phase->orbitFrame()->getCenter()))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+bool Body::isOrientationThreadSafe() const
+{
+    for (unsigned int i = 0; i < timeline->phaseCount(); i++)
+    {
+        const auto& phase = timeline->getPhase(i);
+        if (!phase->rotationModel()->isThreadSafe() || !phase->bodyFrame()->isThreadSafe())
+            return false;
+    }
+
+    return true;
 }
 
 
@@ -621,7 +697,7 @@ Vector3d Body::getVelocity(double tdb) const
     auto orbitFrame = phase->orbitFrame();
 
     Vector3d v = phase->orbit()->velocityAtTime(tdb);
-    v = orbitFrame->getOrientation(tdb).conjugate() * v + orbitFrame->getCenter().getVelocity(tdb);
+    v = orbitFrame->getCachedOrientation(tdb).conjugate() * v + orbitFrame->getCenter().getVelocity(tdb);
 
     if (!orbitFrame->isInertial())
     {
@@ -642,7 +718,7 @@ Vector3d Body::getAngularVelocity(double tdb) const
     Vector3d v = phase->rotationModel()->angularVelocityAtTime(tdb);
 
     auto bodyFrame = phase->bodyFrame();
-    v = bodyFrame->getOrientation(tdb).conjugate() * v;
+    v = bodyFrame->getCachedOrientation(tdb).conjugate() * v;
     if (!bodyFrame->isInertial())
     {
         v += bodyFrame->getAngularVelocity(tdb);
@@ -670,9 +746,32 @@ Matrix4d Body::getLocalToAstrocentric(double tdb) const
  */
 Vector3d Body::getAstrocentricPosition(double tdb) const
 {
+    BodyStateCache& cache = GetBodyStateCache();
+    if (const auto* entry = cache.find(this, tdb);
+        entry != nullptr && (entry->flags & BodyStateCache::AstrocentricPosition) != 0)
+    {
+        return entry->astrocentricPosition;
+    }
+
     // TODO: Switch the iterative method used in getPosition
     auto phase = timeline->findPhase(tdb);
-    return phase->orbitFrame()->convertToAstrocentric(phase->orbit()->positionAtTime(tdb), tdb);
+    Vector3d position = phase->orbitFrame()->convertToAstrocentric(phase->orbit()->positionAtTime(tdb), tdb);
+    cacheAstrocentricPosition(tdb, position);
+    return position;
+}
+
+
+/*! Remember the astrocentric position of the body at tdb until the next
+ *  frame; used by the renderer, which computes the positions as it walks
+ *  down the frame trees.
+ */
+void Body::cacheAstrocentricPosition(double tdb, const Vector3d& position) const
+{
+    if (auto* entry = GetBodyStateCache().insert(this, tdb); entry != nullptr)
+    {
+        entry->astrocentricPosition = position;
+        entry->flags |= BodyStateCache::AstrocentricPosition;
+    }
 }
 
 
@@ -681,7 +780,7 @@ Vector3d Body::getAstrocentricPosition(double tdb) const
 Quaterniond Body::getEclipticToFrame(double tdb) const
 {
     auto phase = timeline->findPhase(tdb);
-    return phase->bodyFrame()->getOrientation(tdb);
+    return phase->bodyFrame()->getCachedOrientation(tdb);
 }
 
 
@@ -690,8 +789,22 @@ Quaterniond Body::getEclipticToFrame(double tdb) const
  */
 Quaterniond Body::getEclipticToEquatorial(double tdb) const
 {
+    BodyStateCache& cache = GetBodyStateCache();
+    if (const auto* entry = cache.find(this, tdb);
+        entry != nullptr && (entry->flags & BodyStateCache::EquatorOrientation) != 0)
+    {
+        return entry->equatorOrientation;
+    }
+
     auto phase = timeline->findPhase(tdb);
-    return phase->rotationModel()->equatorOrientationAtTime(tdb) * phase->bodyFrame()->getOrientation(tdb);
+    Quaterniond orientation = phase->rotationModel()->equatorOrientationAtTime(tdb) * phase->bodyFrame()->getCachedOrientation(tdb);
+    if (auto* entry = cache.insert(this, tdb); entry != nullptr)
+    {
+        entry->equatorOrientation = orientation;
+        entry->flags |= BodyStateCache::EquatorOrientation;
+    }
+
+    return orientation;
 }
 
 
@@ -700,8 +813,8 @@ Quaterniond Body::getEclipticToEquatorial(double tdb) const
  */
 Quaterniond Body::getEclipticToBodyFixed(double tdb) const
 {
-    auto phase = timeline->findPhase(tdb);
-    return phase->rotationModel()->orientationAtTime(tdb) * phase->bodyFrame()->getOrientation(tdb);
+    // The same as the orientation, which is cached for the frame
+    return getOrientation(tdb);
 }
 
 
@@ -910,6 +1023,27 @@ const string& Body::getInfoURL() const
     return infoURL;
 }
 
+
+std::size_t Body::getMemoryUsage() const
+{
+    using celestia::util::stringMemory;
+    using celestia::util::vectorMemory;
+
+    std::size_t size = sizeof(Body) + vectorMemory(names) + stringMemory(localizedName) + stringMemory(infoURL);
+    for (const auto& name : names)
+        size += stringMemory(name);
+    if (atmosphere != nullptr)
+        size += sizeof(Atmosphere);
+    if (rings != nullptr)
+        size += sizeof(RingSystem);
+    if (altSurfaces != nullptr)
+        size += altSurfaces->size() * (sizeof(AltSurfaceTable::value_type) + sizeof(Surface));
+    if (locations != nullptr)
+        size += sizeof(*locations) + locations->size() * (sizeof(Location*) + sizeof(Location));
+    size += deferredLocations.capacity() * sizeof(LocationDefinition);
+    return size;
+}
+
 void Body::setInfoURL(const string& _infoURL)
 {
     infoURL = _infoURL;
@@ -962,17 +1096,51 @@ void Body::addLocation(Location* loc)
         locations = new vector<Location*>();
     locations->push_back(loc);
     loc->setParentBody(this);
+    locationIndex.reset();
+}
+
+
+void Body::addLocation(LocationDefinition&& definition)
+{
+    deferredLocations.push_back(std::move(definition));
+}
+
+
+// Create all the locations deferred, in one go as they're needed together
+// to be shown or searched
+void Body::createDeferredLocations() const
+{
+    if (deferredLocations.empty())
+        return;
+
+    if (!locations)
+        locations = new vector<Location*>();
+    locations->reserve(locations->size() + deferredLocations.size());
+    for (const LocationDefinition& definition : deferredLocations)
+    {
+        Location* location = Location::create(definition, *this);
+        location->setParentBody(const_cast<Body*>(this));
+        locations->push_back(location);
+    }
+
+    deferredLocations.clear();
+    deferredLocations.shrink_to_fit();
+    locationIndex.reset();
+    // The positions of the new locations on a mesh aren't computed yet
+    locationsComputed = false;
 }
 
 
 vector<Location*>* Body::getLocations() const
 {
+    createDeferredLocations();
     return locations;
 }
 
 
 Location* Body::findLocation(std::string_view name, bool i18n) const
 {
+    createDeferredLocations();
     if (!locations)
         return nullptr;
 
@@ -995,6 +1163,7 @@ Location* Body::findLocation(std::string_view name, bool i18n) const
 // a user) loading of meshes is preferred.
 void Body::computeLocations()
 {
+    createDeferredLocations();
     if (locationsComputed)
         return;
 
@@ -1005,7 +1174,11 @@ void Body::computeLocations()
         return;
     Geometry* g = GetGeometryManager()->find(geometry);
     if (!g)
+    {
+        // Try again once a model loading in the background is ready
+        locationsComputed = GetGeometryManager()->getState(geometry) != ResourceState::Loading;
         return;
+    }
 
     // TODO: Implement separate radius and bounding radius so that this hack is
     // not necessary.
@@ -1029,6 +1202,20 @@ void Body::computeLocations()
             location->setPosition(v);
         }
     }
+
+    locationIndex.reset();
+}
+
+
+const LocationIndex* Body::getLocationIndex() const
+{
+    createDeferredLocations();
+    if (locations == nullptr)
+        return nullptr;
+
+    if (locationIndex == nullptr)
+        locationIndex = std::make_unique<LocationIndex>(*locations);
+    return locationIndex.get();
 }
 
 
@@ -1228,6 +1415,31 @@ PlanetarySystem::PlanetarySystem(Star* _star) :
 }
 
 
+PlanetarySystem::~PlanetarySystem() = default;
+
+
+LazyBodyCatalog* PlanetarySystem::getOrCreateLazyBodies(Universe& universe)
+{
+    if (lazyBodies == nullptr)
+        lazyBodies = std::make_unique<LazyBodyCatalog>(this, &universe);
+    return lazyBodies.get();
+}
+
+
+void PlanetarySystem::addMemoryUsage(celestia::util::MemoryReport& report) const
+{
+    for (const Body* body : satellites)
+    {
+        report.add("Bodies", body->getMemoryUsage(), 1);
+        if (const PlanetarySystem* children = body->getSatellites(); children != nullptr)
+            children->addMemoryUsage(report);
+    }
+
+    if (lazyBodies != nullptr)
+        report.add("Minor bodies", lazyBodies->getMemoryUsage(), lazyBodies->size());
+}
+
+
 /*! Add a new alias for an object. If an object with the specified
  *  alias already exists in the planetary system, the old entry will
  *  be replaced.
@@ -1236,7 +1448,7 @@ void PlanetarySystem::addAlias(Body* body, const string& alias)
 {
     assert(body->getSystem() == this);
 
-    objectIndex.insert(make_pair(alias, body));
+    addName(body, alias);
 }
 
 
@@ -1248,12 +1460,48 @@ void PlanetarySystem::removeAlias(const Body* body, const string& alias)
 {
     assert(body->getSystem() == this);
 
-    ObjectIndex::iterator iter = objectIndex.find(alias);
+    removeName(body, alias);
+}
+
+
+std::uint64_t PlanetarySystem::getNameGeneration()
+{
+    return nameGeneration.load(std::memory_order_relaxed);
+}
+
+
+// Both indices keep the first body added under a name, and names which
+// aren't valid UTF-8 are only in the ordered one.
+void PlanetarySystem::addName(Body* body, const string& name)
+{
+    objectIndex.insert(make_pair(name, body));
+
+    string normalized;
+    if (UTF8NormalizeString(name, normalized))
+        normalizedIndex.try_emplace(std::move(normalized), body);
+
+    nameGeneration.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void PlanetarySystem::removeName(const Body* body, const string& name)
+{
+    ObjectIndex::iterator iter = objectIndex.find(name);
     if (iter != objectIndex.end())
     {
         if (iter->second == body)
             objectIndex.erase(iter);
     }
+
+    string normalized;
+    if (UTF8NormalizeString(name, normalized))
+    {
+        auto normIter = normalizedIndex.find(normalized);
+        if (normIter != normalizedIndex.end() && normIter->second == body)
+            normalizedIndex.erase(normIter);
+    }
+
+    nameGeneration.fetch_add(1, std::memory_order_relaxed);
 }
 
 
@@ -1270,7 +1518,7 @@ void PlanetarySystem::addBodyToNameIndex(Body* body)
     const vector<string>& names = body->getNames();
     for (const auto& name : names)
     {
-        objectIndex.insert(make_pair(name, body));
+        addName(body, name);
     }
 }
 
@@ -1284,7 +1532,7 @@ void PlanetarySystem::removeBodyFromNameIndex(const Body* body)
     const vector<string>& names = body->getNames();
     for (const auto& name : names)
     {
-        removeAlias(body, name);
+        removeName(body, name);
     }
 }
 
@@ -1318,13 +1566,24 @@ void PlanetarySystem::replaceBody(Body* oldBody, Body* newBody)
  *    as resolving an object name in an ssc file--it should be false. Otherwise,
  *    object lookup will behave differently based on the locale.
  */
-Body* PlanetarySystem::find(std::string_view _name, bool deepSearch, bool i18n) const
+Body* PlanetarySystem::findInIndex(std::string_view name) const
 {
-    auto firstMatch = objectIndex.find(_name);
-    if (firstMatch != objectIndex.end())
+    string normalized;
+    if (UTF8NormalizeString(name, normalized))
     {
-        Body* matchedBody = firstMatch->second;
+        auto iter = normalizedIndex.find(normalized);
+        return iter == normalizedIndex.end() ? nullptr : iter->second;
+    }
+
+    auto iter = objectIndex.find(name);
+    return iter == objectIndex.end() ? nullptr : iter->second;
+}
 
+
+Body* PlanetarySystem::find(std::string_view _name, bool deepSearch, bool i18n) const
+{
+    if (Body* matchedBody = findInIndex(_name); matchedBody != nullptr)
+    {
         if (i18n)
             return matchedBody;
         // Ignore localized names
@@ -1332,6 +1591,13 @@ Body* PlanetarySystem::find(std::string_view _name, bool deepSearch, bool i18n)
             return matchedBody;
     }
 
+    // Looking up a lazily loaded body by name creates it
+    if (lazyBodies != nullptr)
+    {
+        if (auto index = lazyBodies->find(_name); index != LazyBodyCatalog::InvalidIndex)
+            return lazyBodies->materialize(index);
+    }
+
     if (deepSearch)
     {
         for (const auto sat : satellites)
@@ -1393,6 +1659,9 @@ void PlanetarySystem::getCompletion(std::vector<std::string>& completion,
         }
     }
 
+    if (lazyBodies != nullptr)
+        lazyBodies->getCompletion(completion, _name);
+
     // Scan child objects
     if (deepSearch)
     {
@@ -23,9 +23,11 @@
 #include <string>
 #include <string_view>
 #include <vector>
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <list>
+#include <unordered_map>
 
 class Selection;
 class ReferenceFrame;
@@ -33,13 +35,21 @@ class Body;
 class FrameTree;
 class ReferenceMark;
 class Atmosphere;
+class LazyBodyCatalog;
+class LocationIndex;
+class Universe;
+
+namespace celestia::util
+{
+class MemoryReport;
+}
 
 class PlanetarySystem
 {
  public:
     PlanetarySystem(Body* _primary);
     PlanetarySystem(Star* _star);
-    ~PlanetarySystem() = default;
+    ~PlanetarySystem();
 
     Star* getStar() const { return star; };
     Body* getPrimaryBody() const { return primary; };
@@ -66,9 +76,25 @@ class PlanetarySystem
     Body* find(std::string_view, bool deepSearch = false, bool i18n = false) const;
     void getCompletion(std::vector<std::string>& completion, std::string_view _name, bool i18n, bool rec = true) const;
 
+    // Minor bodies of the system whose creation is deferred; null unless
+    // some have been loaded.
+    LazyBodyCatalog* getLazyBodies() const { return lazyBodies.get(); }
+    LazyBodyCatalog* getOrCreateLazyBodies(Universe& universe);
+
+    // Add the memory taken by the bodies of the system and of their
+    // satellites to report
+    void addMemoryUsage(celestia::util::MemoryReport& report) const;
+
+    // Changed whenever a body or alias is added to or removed from any
+    // planetary system, so that lookups by name can be cached
+    static std::uint64_t getNameGeneration();
+
  private:
+    void addName(Body* body, const std::string& name);
+    void removeName(const Body* body, const std::string& name);
     void addBodyToNameIndex(Body* body);
     void removeBodyFromNameIndex(const Body* body);
+    Body* findInIndex(std::string_view name) const;
 
  private:
     using ObjectIndex = std::map<std::string, Body*, UTF8StringOrderingPredicate>;
@@ -78,6 +104,9 @@ class PlanetarySystem
     Body* primary{nullptr};
     std::vector<Body*> satellites;
     ObjectIndex objectIndex;  // index of bodies by name
+    // The same index hashed by the normalized names, for find()
+    std::unordered_map<std::string, Body*> normalizedIndex;
+    std::unique_ptr<LazyBodyCatalog> lazyBodies;
 };
 
 
@@ -244,6 +273,8 @@ class Body : public AstroObject
     int getClassification() const;
     void setClassification(int);
     const std::string& getInfoURL() const;
+    // Bytes taken by the body, its names, surfaces and locations
+    std::size_t getMemoryUsage() const;
     void setInfoURL(const std::string&);
 
     PlanetarySystem* getSatellites() const;
@@ -294,6 +325,7 @@ class Body : public AstroObject
 
     Eigen::Matrix4d getLocalToAstrocentric(double) const;
     Eigen::Vector3d getAstrocentricPosition(double) const;
+    void cacheAstrocentricPosition(double, const Eigen::Vector3d&) const;
     Eigen::Quaterniond getEquatorialToBodyFixed(double) const;
     Eigen::Quaterniond getEclipticToFrame(double) const;
     Eigen::Quaterniond getEclipticToEquatorial(double) const;
@@ -306,6 +338,11 @@ class Body : public AstroObject
 
     Eigen::Vector3d eclipticToPlanetocentric(const Eigen::Vector3d& ecl, double tdb) const;
 
+    // Return true if the position, or the orientation, may be computed from
+    // several threads at once during all phases of the timeline.
+    bool isPositionThreadSafe() const;
+    bool isOrientationThreadSafe() const;
+
     bool extant(double) const;
     void setLifespan(double, double);
     void getLifespan(double&, double&) const;
@@ -314,10 +351,17 @@ class Body : public AstroObject
     void addAlternateSurface(const std::string&, Surface*);
     std::vector<std::string>* getAlternateSurfaceNames() const;
 
+    // The locations deferred by addLocation(LocationDefinition&&) are
+    // created by the methods returning them
+    bool hasLocations() const { return locations != nullptr || !deferredLocations.empty(); }
     std::vector<Location*>* getLocations() const;
     void addLocation(Location*);
+    void addLocation(LocationDefinition&&);
     Location* findLocation(std::string_view, bool i18n = false) const;
     void computeLocations();
+    // Spatial index of the locations, built when first needed and after
+    // locations are added or moved; nullptr if there are no locations.
+    const LocationIndex* getLocationIndex() const;
 
     bool isVisible() const { return visible; }
     void setVisible(bool _visible);
@@ -369,6 +413,7 @@ class Body : public AstroObject
  private:
     void setName(const std::string& name);
     void recomputeCullingRadius();
+    UniversalCoord computePosition(double tdb) const;
 
  private:
     std::vector<std::string> names{ 1 };
@@ -411,8 +456,12 @@ class Body : public AstroObject
     typedef std::map<std::string, Surface*> AltSurfaceTable;
     AltSurfaceTable *altSurfaces{ nullptr };
 
-    std::vector<Location*>* locations{ nullptr };
+    void createDeferredLocations() const;
+
+    mutable std::vector<Location*>* locations{ nullptr };
+    mutable std::vector<LocationDefinition> deferredLocations;
     mutable bool locationsComputed{ false };
+    mutable std::unique_ptr<LocationIndex> locationIndex;
 
     std::list<ReferenceMark*>* referenceMarks{ nullptr };
 
@@ -0,0 +1,162 @@
+// bodypositions.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Positions of several bodies at several times, computed together.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "bodypositions.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "body.h"
+#include "frame.h"
+#include "selection.h"
+#include "star.h"
+#include "timeline.h"
+#include "timelinephase.h"
+
+namespace
+{
+
+// Times evaluated at once by a thread
+constexpr std::size_t TimesPerChunk = 64;
+
+// Position of a body relative to the object at the root of its frames,
+// usually a star
+struct RootOffset
+{
+    Eigen::Vector3d offset;
+    Selection root;
+};
+
+// Position of a body in the frame of its orbit, rotated to the axes of the
+// universal frame, and the center of the frame
+RootOffset
+getLocalOffset(const Body* body, double t)
+{
+    const auto& phase = body->getTimeline()->findPhase(t);
+    auto frame = phase->orbitFrame();
+    return { frame->getOrientation(t).conjugate() * phase->orbit()->positionAtTime(t), frame->getCenter() };
+}
+
+} // end unnamed namespace
+
+
+BodyPositionBatch::BodyPositionBatch(const std::vector<const Body*>& bodies)
+{
+    for (const Body* body : bodies)
+    {
+        addNode(body);
+        requested.push_back(nodeIndices.at(body));
+    }
+}
+
+
+void
+BodyPositionBatch::addNode(const Body* body)
+{
+    if (nodeIndices.count(body) != 0)
+        return;
+
+    // Entered before the centers to stop at cycles, which only broken
+    // catalogs would have
+    nodeIndices.emplace(body, nodes.size());
+
+    bool threadSafe = true;
+    const Timeline* timeline = body->getTimeline();
+    for (unsigned int i = 0; i < timeline->phaseCount(); i++)
+    {
+        const auto& phase = timeline->getPhase(i);
+        threadSafe = threadSafe && phase->orbit()->isThreadSafe() && phase->orbitFrame()->isThreadSafe();
+
+        Selection center = phase->orbitFrame()->getCenter();
+        if (center.getType() == Selection::Type_Body)
+            addNode(center.body());
+    }
+
+    nodeIndices[body] = nodes.size();
+    nodes.push_back({ body, threadSafe });
+}
+
+
+void
+BodyPositionBatch::compute(const std::vector<double>& times, std::vector<UniversalCoord>& positions) const
+{
+    const std::size_t nTimes = times.size();
+    std::vector<RootOffset> offsets(nodes.size() * nTimes);
+
+    // The bodies which can only be computed on this thread first; the
+    // others are computed by the workers, which then add up the offsets
+    // of all the bodies along the frames.
+    for (std::size_t i = 0; i < nodes.size(); i++)
+    {
+        if (nodes[i].threadSafe)
+            continue;
+        for (std::size_t j = 0; j < nTimes; j++)
+            offsets[i * nTimes + j] = getLocalOffset(nodes[i].body, times[j]);
+    }
+
+    std::atomic<std::size_t> nextChunk{ 0 };
+    auto worker = [&]()
+    {
+        for (;;)
+        {
+            std::size_t first = nextChunk.fetch_add(1, std::memory_order_relaxed) * TimesPerChunk;
+            if (first >= nTimes)
+                break;
+
+            std::size_t last = std::min(first + TimesPerChunk, nTimes);
+            for (std::size_t i = 0; i < nodes.size(); i++)
+            {
+                for (std::size_t j = first; j < last; j++)
+                {
+                    RootOffset& node = offsets[i * nTimes + j];
+                    if (nodes[i].threadSafe)
+                        node = getLocalOffset(nodes[i].body, times[j]);
+
+                    // The centers come before the bodies relative to them,
+                    // so their offsets are already resolved.
+                    if (node.root.getType() == Selection::Type_Body)
+                    {
+                        const RootOffset& center = offsets[nodeIndices.at(node.root.body()) * nTimes + j];
+                        node.offset += center.offset;
+                        node.root = center.root;
+                    }
+                }
+            }
+        }
+    };
+
+    std::size_t nChunks = (nTimes + TimesPerChunk - 1) / TimesPerChunk;
+    unsigned int nThreads = static_cast<unsigned int>(std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()), nChunks));
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < nThreads; i++)
+        workers.emplace_back(worker);
+    worker();
+    for (auto& thread : workers)
+        thread.join();
+
+    // The roots may be stars with orbits, so they are positioned here
+    positions.resize(requested.size() * nTimes);
+    for (std::size_t n = 0; n < requested.size(); n++)
+    {
+        for (std::size_t j = 0; j < nTimes; j++)
+        {
+            const RootOffset& node = offsets[requested[n] * nTimes + j];
+            UniversalCoord rootPosition = node.root.star() != nullptr
+                ? node.root.star()->getPosition(times[j])
+                : node.root.getPosition(times[j]);
+            positions[n * nTimes + j] = rootPosition.offsetKm(node.offset);
+        }
+    }
+}
@@ -0,0 +1,55 @@
+// bodypositions.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Positions of several bodies at several times, computed together.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "univcoord.h"
+
+class Body;
+
+/*! Computes the positions of a set of bodies over a set of times. The
+ *  bodies the set is positioned relative to are resolved once, when the
+ *  batch is created, and the position of each of them is only computed
+ *  once per time, however many bodies are relative to it. The times are
+ *  split between threads, except for the bodies with orbits or frames
+ *  which aren't thread safe, evaluated beforehand on the calling thread.
+ *
+ *  The batch refers to the bodies, so it should not outlive them.
+ */
+class BodyPositionBatch
+{
+ public:
+    explicit BodyPositionBatch(const std::vector<const Body*>& bodies);
+
+    // Set positions[i * times.size() + j] to the position of the i-th body
+    // at times[j], as Body::getPosition() would.
+    void compute(const std::vector<double>& times, std::vector<UniversalCoord>& positions) const;
+
+ private:
+    struct Node
+    {
+        const Body* body;
+        bool threadSafe;
+    };
+
+    void addNode(const Body* body);
+
+    // Bodies and the bodies they are positioned relative to, in any phase
+    // of their timelines; each comes after the ones it's relative to.
+    std::vector<Node> nodes;
+    std::unordered_map<const Body*, std::size_t> nodeIndices;
+    // Index of the requested bodies in the nodes
+    std::vector<std::size_t> requested;
+};
@@ -0,0 +1,141 @@
+// bodystatecache.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Positions and orientations of solar system bodies, and transforms of
+// reference frames, computed during the current frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "bodystatecache.h"
+
+#include <cstring>
+#include <functional>
+
+namespace
+{
+
+constexpr std::size_t InitialCapacity = 1024;
+
+} // end unnamed namespace
+
+
+BodyStateCache::BodyStateCache() :
+    entries(InitialCapacity),
+    owner(std::this_thread::get_id())
+{
+}
+
+
+void
+BodyStateCache::invalidate()
+{
+    clear();
+    owner = std::this_thread::get_id();
+}
+
+
+void
+BodyStateCache::clear()
+{
+    // Entries from earlier generations count as empty slots
+    if (++generation == 0)
+    {
+        for (Entry& entry : entries)
+            entry.generation = 0;
+        generation = 1;
+    }
+
+    used = 0;
+}
+
+
+void
+BodyStateCache::clearIfOwner()
+{
+    if (std::this_thread::get_id() == owner)
+        clear();
+}
+
+
+std::size_t
+BodyStateCache::slot(const void* object, double tdb) const
+{
+    std::uint64_t tdbBits;
+    std::memcpy(&tdbBits, &tdb, sizeof(tdbBits));
+    std::size_t h = std::hash<const void*>()(object) ^ (std::hash<std::uint64_t>()(tdbBits) * 0x9e3779b97f4a7c15ull);
+    return h & (entries.size() - 1);
+}
+
+
+const BodyStateCache::Entry*
+BodyStateCache::find(const void* object, double tdb) const
+{
+    if (std::this_thread::get_id() != owner)
+        return nullptr;
+
+    // Open addressing with linear probing; the table is never more than
+    // half full, so there is always an empty slot to stop at.
+    for (std::size_t i = slot(object, tdb);; i = (i + 1) & (entries.size() - 1))
+    {
+        const Entry& entry = entries[i];
+        if (entry.generation != generation)
+            return nullptr;
+        if (entry.object == object && entry.tdb == tdb)
+            return &entry;
+    }
+}
+
+
+BodyStateCache::Entry*
+BodyStateCache::insert(const void* object, double tdb)
+{
+    if (std::this_thread::get_id() != owner)
+        return nullptr;
+
+    if ((used + 1) * 2 > entries.size())
+        grow();
+
+    for (std::size_t i = slot(object, tdb);; i = (i + 1) & (entries.size() - 1))
+    {
+        Entry& entry = entries[i];
+        if (entry.generation != generation)
+        {
+            entry.object = object;
+            entry.tdb = tdb;
+            entry.generation = generation;
+            entry.flags = 0;
+            ++used;
+            return &entry;
+        }
+        if (entry.object == object && entry.tdb == tdb)
+            return &entry;
+    }
+}
+
+
+void
+BodyStateCache::grow()
+{
+    std::vector<Entry> oldEntries(entries.size() * 2);
+    oldEntries.swap(entries);
+    used = 0;
+
+    for (const Entry& oldEntry : oldEntries)
+    {
+        if (oldEntry.generation != generation)
+            continue;
+        *insert(oldEntry.object, oldEntry.tdb) = oldEntry;
+    }
+}
+
+
+BodyStateCache&
+GetBodyStateCache()
+{
+    static BodyStateCache cache;
+    return cache;
+}
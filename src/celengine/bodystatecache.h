@@ -0,0 +1,93 @@
+// bodystatecache.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Positions and orientations of solar system bodies, and transforms of
+// reference frames, computed during the current frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "univcoord.h"
+
+// The rendering, labelling, orbit and picking code all evaluate the same
+// bodies at the same time within a frame, and a body comes up again for
+// each object positioned relative to it. The cache holds on to the results,
+// keyed by body or frame and time, until invalidate() is called at the start
+// of the next frame.
+//
+// The cache is only used from the thread which last invalidated it; on any
+// other thread lookups miss and stores are dropped, so the state is
+// computed as if there was no cache.
+class BodyStateCache
+{
+ public:
+    enum : std::uint8_t
+    {
+        AstrocentricPosition = 0x01,
+        Position             = 0x02,
+        Orientation          = 0x04,
+        EquatorOrientation   = 0x08,
+        // Entries of reference frames store the astrocentric position of
+        // the frame's center in astrocentricPosition and the frame's
+        // orientation in orientation.
+        FrameOrigin          = 0x10,
+        FrameOrientation     = 0x20,
+    };
+
+    struct Entry
+    {
+        const void* object{ nullptr };
+        double tdb{ 0.0 };
+        std::uint32_t generation{ 0 };
+        std::uint8_t flags{ 0 };
+        Eigen::Vector3d astrocentricPosition;
+        UniversalCoord position;
+        Eigen::Quaterniond orientation;
+        Eigen::Quaterniond equatorOrientation;
+    };
+
+    BodyStateCache();
+
+    // Drop all entries and make the calling thread the one using the cache.
+    void invalidate();
+
+    // Drop all entries, e.g. after a body's trajectory changed; the cache
+    // mustn't be in use on another thread.
+    void clear();
+
+    // Drop all entries when called from the thread using the cache; used
+    // when an object with entries is destroyed, as another one may be
+    // created at the same address.
+    void clearIfOwner();
+
+    // Return the entry for the body or frame at tdb, or nullptr if there is
+    // none. The pointer is only valid until the next call to insert().
+    const Entry* find(const void* object, double tdb) const;
+
+    // Return the entry for the body or frame at tdb, adding an empty one if
+    // needed, or nullptr when the cache isn't usable from this thread.
+    Entry* insert(const void* object, double tdb);
+
+ private:
+    std::size_t slot(const void* object, double tdb) const;
+    void grow();
+
+    std::vector<Entry> entries;
+    std::size_t used{ 0 };
+    std::uint32_t generation{ 1 };
+    std::thread::id owner;
+};
+
+BodyStateCache& GetBodyStateCache();
@@ -0,0 +1,298 @@
+// camerapath.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Key-framed camera paths, recorded or built by scripts and played back
+// by an observer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "camerapath.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+Eigen::Vector3d
+quaternionLog(const Eigen::Quaterniond& q)
+{
+    double s = q.vec().norm();
+    if (s < 1.0e-12)
+        return q.vec();
+    return q.vec() * (std::atan2(s, q.w()) / s);
+}
+
+Eigen::Quaterniond
+quaternionExp(const Eigen::Vector3d& v)
+{
+    double angle = v.norm();
+    if (angle < 1.0e-12)
+        return Eigen::Quaterniond(1.0, v.x(), v.y(), v.z()).normalized();
+
+    Eigen::Vector3d axis = v * (std::sin(angle) / angle);
+    return Eigen::Quaterniond(std::cos(angle), axis.x(), axis.y(), axis.z());
+}
+
+// Inner control point of squad at q1, between q0 and q2
+Eigen::Quaterniond
+squadControl(const Eigen::Quaterniond& q0,
+             const Eigen::Quaterniond& q1,
+             const Eigen::Quaterniond& q2)
+{
+    Eigen::Quaterniond inv = q1.conjugate();
+    Eigen::Vector3d v = quaternionLog(inv * q2) + quaternionLog(inv * q0);
+    return (q1 * quaternionExp(v * -0.25)).normalized();
+}
+
+// Hermite basis weights of the tangent at the start, the end point and
+// the tangent at the end of a segment; the start point is the origin.
+struct HermiteWeights
+{
+    explicit HermiteWeights(double u) :
+        m0(u * u * u - 2.0 * u * u + u),
+        p1(-2.0 * u * u * u + 3.0 * u * u),
+        m1(u * u * u - u * u)
+    {
+    }
+
+    double m0;
+    double p1;
+    double m1;
+};
+
+} // end unnamed namespace
+
+
+bool
+CameraPath::addKey(const Key& key)
+{
+    if (!keys.empty() && key.time <= keys.back().time)
+        return false;
+
+    keys.push_back(key);
+    // Keep the orientations in the same hemisphere, so that the spline
+    // takes the short way between them
+    if (keys.size() > 1 && keys[keys.size() - 2].orientation.dot(key.orientation) < 0.0)
+        keys.back().orientation.coeffs() = -key.orientation.coeffs();
+
+    std::size_t n = keys.size();
+    orientationControls.push_back(keys.back().orientation);
+    if (n >= 3)
+    {
+        orientationControls[n - 2] = squadControl(keys[n - 3].orientation,
+                                                  keys[n - 2].orientation,
+                                                  keys[n - 1].orientation);
+    }
+
+    if (n == 1)
+    {
+        distances.assign(1, 0.0);
+        return true;
+    }
+
+    // The new key changes the tangent at the key before, which ends the
+    // segment before the new one
+    updateLengths(n >= 3 ? n - 3 : 0);
+    return true;
+}
+
+
+void
+CameraPath::removeKeysBefore(double time)
+{
+    if (keys.size() < 3)
+        return;
+
+    // The key before the segment is needed for its tangent
+    std::size_t segment = findSegment(time);
+    if (segment < 2)
+        return;
+
+    std::size_t count = segment - 1;
+    keys.erase(keys.begin(), keys.begin() + count);
+    orientationControls.erase(orientationControls.begin(), orientationControls.begin() + count);
+    distances.erase(distances.begin(), distances.begin() + count * SamplesPerSegment);
+}
+
+
+void
+CameraPath::clear()
+{
+    keys.clear();
+    orientationControls.clear();
+    distances.clear();
+}
+
+
+double
+CameraPath::getStartTime() const
+{
+    return keys.empty() ? 0.0 : keys.front().time;
+}
+
+
+double
+CameraPath::getEndTime() const
+{
+    return keys.empty() ? 0.0 : keys.back().time;
+}
+
+
+double
+CameraPath::getStartDistance() const
+{
+    return distances.empty() ? 0.0 : distances.front();
+}
+
+
+double
+CameraPath::getEndDistance() const
+{
+    return distances.empty() ? 0.0 : distances.back();
+}
+
+
+CameraPath::Key
+CameraPath::evaluate(double time) const
+{
+    if (keys.empty())
+        return Key();
+
+    time = std::clamp(time, getStartTime(), getEndTime());
+    if (keys.size() == 1)
+        return keys.front();
+
+    std::size_t i = findSegment(time);
+    const Key& k0 = keys[i];
+    const Key& k1 = keys[i + 1];
+    double u = std::clamp((time - k0.time) / (k1.time - k0.time), 0.0, 1.0);
+
+    Key key;
+    key.time = time;
+    key.position = k0.position;
+    key.position = key.position.offsetKm(segmentOffset(i, u));
+
+    Eigen::Quaterniond q = k0.orientation.slerp(u, k1.orientation);
+    Eigen::Quaterniond s = orientationControls[i].slerp(u, orientationControls[i + 1]);
+    key.orientation = q.slerp(2.0 * u * (1.0 - u), s).normalized();
+
+    auto fovTangent = [this](std::size_t k)
+    {
+        std::size_t prev = k > 0 ? k - 1 : k;
+        std::size_t next = k + 1 < keys.size() ? k + 1 : k;
+        return static_cast<double>(keys[next].fov - keys[prev].fov) / (keys[next].time - keys[prev].time);
+    };
+
+    double dt = k1.time - k0.time;
+    HermiteWeights w(u);
+    key.fov = k0.fov + static_cast<float>(w.m0 * dt * fovTangent(i) +
+                                          w.p1 * static_cast<double>(k1.fov - k0.fov) +
+                                          w.m1 * dt * fovTangent(i + 1));
+    return key;
+}
+
+
+double
+CameraPath::getDistance(double time) const
+{
+    if (keys.size() < 2)
+        return getStartDistance();
+
+    time = std::clamp(time, getStartTime(), getEndTime());
+    std::size_t i = findSegment(time);
+    double u = (time - keys[i].time) / (keys[i + 1].time - keys[i].time) * SamplesPerSegment;
+    std::size_t j = std::min(static_cast<std::size_t>(std::max(u, 0.0)), SamplesPerSegment - 1);
+    double f = std::clamp(u - static_cast<double>(j), 0.0, 1.0);
+
+    std::size_t k = i * SamplesPerSegment + j;
+    return distances[k] + (distances[k + 1] - distances[k]) * f;
+}
+
+
+double
+CameraPath::getTime(double distance) const
+{
+    if (keys.size() < 2)
+        return getStartTime();
+
+    distance = std::clamp(distance, getStartDistance(), getEndDistance());
+    auto it = std::upper_bound(distances.begin(), distances.end(), distance);
+    std::size_t k = static_cast<std::size_t>(std::max(it - distances.begin() - 1, std::ptrdiff_t(0)));
+    k = std::min(k, distances.size() - 2);
+
+    double span = distances[k + 1] - distances[k];
+    double f = span > 0.0 ? (distance - distances[k]) / span : 0.0;
+
+    std::size_t i = k / SamplesPerSegment;
+    double u = (static_cast<double>(k % SamplesPerSegment) + f) / SamplesPerSegment;
+    return keys[i].time + (keys[i + 1].time - keys[i].time) * u;
+}
+
+
+// The segment of the keys starting at i and i + 1 which contains time,
+// or the first or last segment for times outside the path
+std::size_t
+CameraPath::findSegment(double time) const
+{
+    auto it = std::upper_bound(keys.begin(), keys.end(), time,
+                               [](double t, const Key& key) { return t < key.time; });
+    auto i = static_cast<std::size_t>(std::max(it - keys.begin() - 1, std::ptrdiff_t(0)));
+    return std::min(i, keys.size() - 2);
+}
+
+
+// Velocity at key i in km/s, from the keys on each side
+Eigen::Vector3d
+CameraPath::tangent(std::size_t i) const
+{
+    std::size_t prev = i > 0 ? i - 1 : i;
+    std::size_t next = i + 1 < keys.size() ? i + 1 : i;
+    return keys[next].position.offsetFromKm(keys[prev].position) / (keys[next].time - keys[prev].time);
+}
+
+
+// Offset in km from key i of the point at u in [0, 1] of the segment
+// from key i to key i + 1
+Eigen::Vector3d
+CameraPath::segmentOffset(std::size_t i, double u) const
+{
+    double dt = keys[i + 1].time - keys[i].time;
+    HermiteWeights w(u);
+    return tangent(i) * (w.m0 * dt) +
+           keys[i + 1].position.offsetFromKm(keys[i].position) * w.p1 +
+           tangent(i + 1) * (w.m1 * dt);
+}
+
+
+void
+CameraPath::updateLengths(std::size_t firstSegment)
+{
+    std::size_t segments = keys.size() - 1;
+    distances.resize(segments * SamplesPerSegment + 1);
+
+    for (std::size_t i = firstSegment; i < segments; i++)
+    {
+        // Tangents are computed once per segment rather than per sample
+        double dt = keys[i + 1].time - keys[i].time;
+        Eigen::Vector3d m0 = tangent(i) * dt;
+        Eigen::Vector3d p1 = keys[i + 1].position.offsetFromKm(keys[i].position);
+        Eigen::Vector3d m1 = tangent(i + 1) * dt;
+
+        std::size_t k = i * SamplesPerSegment;
+        double distance = distances[k];
+        Eigen::Vector3d last = Eigen::Vector3d::Zero();
+        for (std::size_t j = 1; j <= SamplesPerSegment; j++)
+        {
+            HermiteWeights w(static_cast<double>(j) / SamplesPerSegment);
+            Eigen::Vector3d p = m0 * w.m0 + p1 * w.p1 + m1 * w.m1;
+            distance += (p - last).norm();
+            distances[k + j] = distance;
+            last = p;
+        }
+    }
+}
@@ -0,0 +1,92 @@
+// camerapath.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Key-framed camera paths, recorded or built by scripts and played back
+// by an observer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "univcoord.h"
+
+/*! A camera path through key frames giving the position, orientation and
+ *  field of view of the camera at increasing times. Positions follow a
+ *  Catmull-Rom spline with tangents scaled to the times of the keys, so
+ *  the camera moves smoothly through keys which aren't evenly spaced, and
+ *  orientations are interpolated with squad. Positions are interpolated
+ *  as offsets in km from the key starting each segment, which keeps the
+ *  precision of the universal coordinates over distances of any scale.
+ *
+ *  The length of the path is tabulated as keys are added, so that it can
+ *  be played at a constant speed; distances are measured from the first
+ *  key ever added, so they don't change when old keys are removed. Keys
+ *  may be added while the path is played and the ones passed removed,
+ *  which lets a path be streamed without growing.
+ */
+class CameraPath
+{
+ public:
+    struct Key
+    {
+        // Seconds from the start of the path
+        double time{ 0.0 };
+        // Position and orientation in the frame the path is played in
+        UniversalCoord position{ 0.0, 0.0, 0.0 };
+        Eigen::Quaterniond orientation{ Eigen::Quaterniond::Identity() };
+        // Vertical field of view in radians
+        float fov{ 0.0f };
+    };
+
+    // Length samples of each segment between two keys
+    static constexpr std::size_t SamplesPerSegment = 16;
+
+    CameraPath() = default;
+    ~CameraPath() = default;
+
+    // Add a key after the last one; false if it isn't later
+    bool addKey(const Key& key);
+    // Remove the keys which are no longer needed to evaluate the path at
+    // times from time on
+    void removeKeysBefore(double time);
+    void clear();
+
+    const std::vector<Key>& getKeys() const { return keys; }
+    bool empty() const { return keys.empty(); }
+
+    double getStartTime() const;
+    double getEndTime() const;
+    // Distances in km along the path of the first and last keys
+    double getStartDistance() const;
+    double getEndDistance() const;
+
+    // The camera at a time, clamped to the times of the keys
+    Key evaluate(double time) const;
+    // The distance along the path at a time and the time at a distance,
+    // clamped to the keys
+    double getDistance(double time) const;
+    double getTime(double distance) const;
+
+ private:
+    std::size_t findSegment(double time) const;
+    Eigen::Vector3d tangent(std::size_t i) const;
+    Eigen::Vector3d segmentOffset(std::size_t i, double u) const;
+    void updateLengths(std::size_t firstSegment);
+
+    std::vector<Key> keys;
+    // Inner control points of the orientation spline, one per key
+    std::vector<Eigen::Quaterniond> orientationControls;
+    // Distance along the path at each length sample, SamplesPerSegment per
+    // segment and one for the last key
+    std::vector<double> distances;
+};
@@ -0,0 +1,127 @@
+// closestarindex.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "closestarindex.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// Gathers the stars for the cache, as processCloseObjects finds them
+class CloseStarCollector : public StarHandler
+{
+ public:
+    explicit CloseStarCollector(std::vector<const Star*>& stars) : m_stars(stars) {}
+
+    void process(const Star& star, float /*distance*/, float /*appMag*/) override
+    {
+        m_stars.push_back(&star);
+    }
+
+ private:
+    std::vector<const Star*>& m_stars;
+};
+
+} // end unnamed namespace
+
+
+void
+CloseStarIndex::findCloseStars(const StarOctree& octree,
+                               const Eigen::Vector3f& position,
+                               float radius,
+                               std::vector<const Star*>& stars)
+{
+    // Reuse the cached stars as long as the query sphere lies within the
+    // cached one
+    if (m_radius < 0.0f || (position - m_center).norm() + radius > m_radius)
+        rebuild(octree, position, radius);
+
+    float radiusSquared = radius * radius;
+    Eigen::Vector3f origin = m_center - Eigen::Vector3f::Constant(m_radius);
+    int minX = cellCoordinate(position.x() - radius, origin.x());
+    int maxX = cellCoordinate(position.x() + radius, origin.x());
+    int minY = cellCoordinate(position.y() - radius, origin.y());
+    int maxY = cellCoordinate(position.y() + radius, origin.y());
+    int minZ = cellCoordinate(position.z() - radius, origin.z());
+    int maxZ = cellCoordinate(position.z() + radius, origin.z());
+
+    for (int z = minZ; z <= maxZ; ++z)
+    {
+        for (int y = minY; y <= maxY; ++y)
+        {
+            // Cells along x are adjacent in m_stars
+            int cell = (z * GridSize + y) * GridSize;
+            std::uint32_t end = m_cellStart[cell + maxX + 1];
+            for (std::uint32_t i = m_cellStart[cell + minX]; i < end; ++i)
+            {
+                if ((position - m_stars[i]->getPosition()).squaredNorm() < radiusSquared)
+                    stars.push_back(m_stars[i]);
+            }
+        }
+    }
+}
+
+
+void
+CloseStarIndex::clear()
+{
+    m_radius = -1.0f;
+    m_queryRadius = 0.0f;
+    m_cellStart.clear();
+    m_stars.clear();
+}
+
+
+void
+CloseStarIndex::rebuild(const StarOctree& octree, const Eigen::Vector3f& position, float radius)
+{
+    // Make the cached sphere large enough for the observer to move by
+    // the largest query radius before it has to be rebuilt.
+    m_queryRadius = std::max(m_queryRadius, radius);
+    m_center = position;
+    m_radius = 2.0f * m_queryRadius;
+    m_cellSize = 2.0f * m_radius / static_cast<float>(GridSize);
+
+    std::vector<const Star*> stars;
+    CloseStarCollector collector(stars);
+    octree.processCloseObjects(collector, m_center, m_radius, STAR_OCTREE_ROOT_SIZE);
+
+    // Counting sort of the stars by cell
+    Eigen::Vector3f origin = m_center - Eigen::Vector3f::Constant(m_radius);
+    std::vector<int> cells;
+    cells.reserve(stars.size());
+    m_cellStart.assign(GridSize * GridSize * GridSize + 1, 0);
+    for (const Star* star : stars)
+    {
+        const Eigen::Vector3f& pos = star->getPosition();
+        int cell = (cellCoordinate(pos.z(), origin.z()) * GridSize +
+                    cellCoordinate(pos.y(), origin.y())) * GridSize +
+                   cellCoordinate(pos.x(), origin.x());
+        cells.push_back(cell);
+        ++m_cellStart[cell + 1];
+    }
+
+    for (std::size_t i = 1; i < m_cellStart.size(); ++i)
+        m_cellStart[i] += m_cellStart[i - 1];
+
+    m_stars.resize(stars.size());
+    std::vector<std::uint32_t> next(m_cellStart.begin(), m_cellStart.end() - 1);
+    for (std::size_t i = 0; i < stars.size(); ++i)
+        m_stars[next[cells[i]]++] = stars[i];
+}
+
+
+int
+CloseStarIndex::cellCoordinate(float x, float origin) const
+{
+    auto cell = static_cast<int>(std::floor((x - origin) / m_cellSize));
+    return std::clamp(cell, 0, GridSize - 1);
+}
@@ -0,0 +1,55 @@
+// closestarindex.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "staroctree.h"
+
+// Cache for the short range star queries made every frame around the
+// observer (light sources, closest star, near stars). The stars within a
+// sphere somewhat larger than the query are gathered from the octree once
+// and binned into a uniform grid; queries fully inside that sphere are then
+// answered from the grid cells they overlap, and the cache is only rebuilt
+// when the observer has moved far enough to leave it.
+class CloseStarIndex
+{
+ public:
+    // Queries with a larger radius go straight to the octree
+    static constexpr float MaxCachedRadius = 100.0f;
+
+    // Append the stars within radius of position to stars. The radius
+    // mustn't be larger than MaxCachedRadius.
+    void findCloseStars(const StarOctree& octree,
+                        const Eigen::Vector3f& position,
+                        float radius,
+                        std::vector<const Star*>& stars);
+
+    void clear();
+
+ private:
+    static constexpr int GridSize = 8;
+
+    void rebuild(const StarOctree& octree, const Eigen::Vector3f& position, float radius);
+    int cellCoordinate(float x, float origin) const;
+
+    Eigen::Vector3f m_center{ Eigen::Vector3f::Zero() };
+    float m_radius{ -1.0f };
+    float m_cellSize{ 0.0f };
+    // Largest radius queried, used to size the cached sphere
+    float m_queryRadius{ 0.0f };
+
+    // Stars of cell i are m_stars[m_cellStart[i]] up to m_stars[m_cellStart[i + 1]]
+    std::vector<std::uint32_t> m_cellStart;
+    std::vector<const Star*> m_stars;
+};
@@ -52,6 +52,7 @@ bool Console::setRowCount(int _nRows)
     if (_nRows == nRows)
         return true;
 
+    std::scoped_lock lock(mutex);
     text.resize((nColumns + 1) * _nRows, L'\0');
     nRows = _nRows;
 
@@ -85,6 +86,7 @@ void Console::render(int rowHeight)
     if (font == nullptr)
         return;
 
+    std::scoped_lock lock(mutex);
     font->bind();
     font->setMVPMatrices(projection);
     savePos();
@@ -143,6 +145,7 @@ void Console::newline()
 
 void Console::print(wchar_t c)
 {
+    std::scoped_lock lock(mutex);
     switch (c)
     {
     case '\n':
@@ -232,6 +235,7 @@ void Console::restorePos()
 
 void Console::scroll(int lines)
 {
+    std::scoped_lock lock(mutex);
     int topRow = getWindowRow();
     int height = getHeight();
 
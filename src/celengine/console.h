@@ -10,6 +10,7 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <streambuf>
 #include <string>
@@ -82,6 +83,8 @@ class Console : public std::ostream
     int getHeight() const;
     int getWidth() const;
 
+    // Guards the text, which the log may write on its own thread
+    std::mutex mutex;
     std::wstring text{ };
     int nRows;
     int nColumns;
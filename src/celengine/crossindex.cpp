@@ -0,0 +1,337 @@
+// crossindex.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "crossindex.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include <celutil/binarywrite.h>
+#include <celutil/bytes.h>
+#include <celutil/gettext.h>
+#include <celutil/logger.h>
+#include <celutil/timer.h>
+
+using namespace std::string_view_literals;
+using celestia::util::GetLogger;
+
+namespace celutil = celestia::util;
+
+namespace
+{
+
+constexpr inline std::string_view CROSSINDEX_MAGIC = "CELINDEX"sv;
+constexpr inline std::uint16_t CROSSINDEX_VERSION_UNSORTED = 0x0100;
+constexpr inline std::uint16_t CROSSINDEX_VERSION_SORTED   = 0x0200;
+
+#pragma pack(push, 1)
+// cross-index header structure
+struct CrossIndexHeader
+{
+    CrossIndexHeader() = delete;
+    char magic[8];
+    std::uint16_t version;
+};
+
+static_assert(std::is_standard_layout_v<CrossIndexHeader>);
+
+// version 2 header, followed by the records sorted by catalog number and
+// then by Celestia catalog number
+struct SortedCrossIndexHeader
+{
+    SortedCrossIndexHeader() = delete;
+    char magic[8];
+    std::uint16_t version;
+    std::uint32_t counter;
+};
+
+static_assert(std::is_standard_layout_v<SortedCrossIndexHeader>);
+
+// cross-index record structure
+struct CrossIndexRecord
+{
+    CrossIndexRecord() = delete;
+    std::uint32_t catalogNumber;
+    std::uint32_t celCatalogNumber;
+};
+
+static_assert(std::is_standard_layout_v<CrossIndexRecord>);
+
+#pragma pack(pop)
+
+std::uint32_t
+readField(const char* records, std::uint32_t index, std::size_t offset)
+{
+    std::uint32_t value;
+    std::memcpy(&value, records + static_cast<std::size_t>(index) * sizeof(CrossIndexRecord) + offset, sizeof(value));
+    LE_TO_CPU_INT32(value, value);
+    return value;
+}
+
+// Find the first record whose field at offset isn't less than key. The
+// catalog numbers are close to uniformly spread, so the probes are
+// interpolated from the keys at the ends of the range; every other probe
+// bisects it instead, which bounds the search at twice that of a binary
+// search when they aren't.
+std::uint32_t
+lowerBound(const char* records, std::uint32_t count, std::size_t offset, std::uint32_t key)
+{
+    std::uint32_t low = 0;
+    std::uint32_t high = count;
+    bool interpolate = true;
+    while (low < high)
+    {
+        std::uint32_t probe;
+        if (interpolate)
+        {
+            std::uint32_t lowKey = readField(records, low, offset);
+            if (key <= lowKey)
+                return low;
+            std::uint32_t highKey = readField(records, high - 1, offset);
+            if (key > highKey)
+                return high;
+
+            // lowKey < key <= highKey
+            auto span = static_cast<std::uint64_t>(high - 1 - low);
+            probe = low + static_cast<std::uint32_t>(span * (key - lowKey) / (highKey - lowKey));
+        }
+        else
+        {
+            probe = low + (high - low) / 2;
+        }
+        interpolate = !interpolate;
+
+        if (readField(records, probe, offset) < key)
+            low = probe + 1;
+        else
+            high = probe;
+    }
+
+    return low;
+}
+
+} // end unnamed namespace
+
+
+std::unique_ptr<CrossIndex>
+CrossIndex::read(std::istream& in)
+{
+    Timer timer{};
+
+    // Verify that the star database file has a correct header
+    std::array<char, sizeof(CrossIndexHeader)> header;
+    if (!in.read(header.data(), header.size()).good())
+        return nullptr;
+
+    // Verify the magic string
+    if (std::string_view(header.data() + offsetof(CrossIndexHeader, magic), CROSSINDEX_MAGIC.size()) != CROSSINDEX_MAGIC)
+    {
+        GetLogger()->error(_("Bad header for cross index\n"));
+        return nullptr;
+    }
+
+    // Verify the version
+    std::uint16_t version;
+    std::memcpy(&version, header.data() + offsetof(CrossIndexHeader, version), sizeof(version));
+    LE_TO_CPU_INT16(version, version);
+    if (version == CROSSINDEX_VERSION_SORTED)
+    {
+        std::uint32_t counter;
+        if (!in.read(reinterpret_cast<char*>(&counter), sizeof(counter)).good())
+            return nullptr;
+        LE_TO_CPU_INT32(counter, counter);
+
+        std::unique_ptr<CrossIndex> xindex(new CrossIndex());
+        xindex->m_records.resize(static_cast<std::size_t>(counter) * 2 * sizeof(CrossIndexRecord));
+        if (!in.read(xindex->m_records.data(), xindex->m_records.size()).good())
+        {
+            GetLogger()->error(_("Loading cross index failed - unexpected EOF\n"));
+            return nullptr;
+        }
+
+        xindex->m_data = xindex->m_records.data();
+        xindex->m_size = counter;
+        return xindex;
+    }
+
+    if (version != CROSSINDEX_VERSION_UNSORTED)
+    {
+        GetLogger()->error(_("Bad version for cross index\n"));
+        return nullptr;
+    }
+
+    std::vector<Entry> entries;
+
+    constexpr std::uint32_t BUFFER_RECORDS = UINT32_C(4096) / sizeof(CrossIndexRecord);
+    std::vector<char> buffer(sizeof(CrossIndexRecord) * BUFFER_RECORDS);
+    bool hasMoreRecords = true;
+    while (hasMoreRecords)
+    {
+        in.read(buffer.data(), buffer.size());
+        std::size_t remainingRecords = BUFFER_RECORDS;
+        if (in.bad())
+        {
+            GetLogger()->error(_("Loading cross index failed\n"));
+            return nullptr;
+        }
+        if (in.eof())
+        {
+            auto bytesRead = static_cast<std::uint32_t>(in.gcount());
+            remainingRecords = bytesRead / sizeof(CrossIndexRecord);
+            // disallow partial records
+            if (bytesRead % sizeof(CrossIndexRecord) != 0)
+            {
+                GetLogger()->error(_("Loading cross index failed - unexpected EOF\n"));
+                return nullptr;
+            }
+
+            hasMoreRecords = false;
+        }
+
+        entries.reserve(entries.size() + remainingRecords);
+
+        const char* ptr = buffer.data();
+        while (remainingRecords-- > 0)
+        {
+            Entry ent;
+            std::memcpy(&ent.catalogNumber, ptr + offsetof(CrossIndexRecord, catalogNumber), sizeof(ent.catalogNumber));
+            LE_TO_CPU_INT32(ent.catalogNumber, ent.catalogNumber);
+
+            std::memcpy(&ent.celCatalogNumber, ptr + offsetof(CrossIndexRecord, celCatalogNumber), sizeof(ent.celCatalogNumber));
+            LE_TO_CPU_INT32(ent.celCatalogNumber, ent.celCatalogNumber);
+
+            entries.push_back(ent);
+            ptr += sizeof(CrossIndexRecord);
+        }
+    }
+
+    GetLogger()->debug("Loaded xindex in {} ms\n", timer.getTime());
+
+    return fromEntries(std::move(entries));
+}
+
+
+std::unique_ptr<CrossIndex>
+CrossIndex::open(const fs::path& path)
+{
+    // Version 2 files are used in place, others are read
+    auto file = celutil::MappedFile::open(path);
+    if (file == nullptr || file->size() < sizeof(SortedCrossIndexHeader))
+        return nullptr;
+
+    const char* data = file->data();
+    std::uint16_t version;
+    std::memcpy(&version, data + offsetof(SortedCrossIndexHeader, version), sizeof(version));
+    LE_TO_CPU_INT16(version, version);
+    if (std::string_view(data + offsetof(SortedCrossIndexHeader, magic), CROSSINDEX_MAGIC.size()) != CROSSINDEX_MAGIC
+        || version != CROSSINDEX_VERSION_SORTED)
+    {
+        file.reset();
+        std::ifstream in(path, std::ios::in | std::ios::binary);
+        return in.good() ? read(in) : nullptr;
+    }
+
+    std::uint32_t counter;
+    std::memcpy(&counter, data + offsetof(SortedCrossIndexHeader, counter), sizeof(counter));
+    LE_TO_CPU_INT32(counter, counter);
+    if (file->size() != sizeof(SortedCrossIndexHeader) + static_cast<std::uint64_t>(counter) * 2 * sizeof(CrossIndexRecord))
+    {
+        GetLogger()->error(_("Loading cross index failed - unexpected EOF\n"));
+        return nullptr;
+    }
+
+    std::unique_ptr<CrossIndex> xindex(new CrossIndex());
+    xindex->m_data = data + sizeof(SortedCrossIndexHeader);
+    xindex->m_size = counter;
+    xindex->m_file = std::move(file);
+    return xindex;
+}
+
+
+bool
+CrossIndex::write(std::ostream& out, std::vector<Entry> entries)
+{
+    if (!out.write(CROSSINDEX_MAGIC.data(), CROSSINDEX_MAGIC.size()).good()
+        || !celutil::writeLE<std::uint16_t>(out, CROSSINDEX_VERSION_SORTED)
+        || !celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(entries.size())))
+    {
+        return false;
+    }
+
+    auto xindex = fromEntries(std::move(entries));
+    return out.write(xindex->m_data, xindex->m_records.size()).good();
+}
+
+
+AstroCatalog::IndexNumber
+CrossIndex::findCelestiaNumber(AstroCatalog::IndexNumber catalogNumber) const
+{
+    std::uint32_t i = lowerBound(m_data, m_size, offsetof(CrossIndexRecord, catalogNumber), catalogNumber);
+    if (i == m_size || readField(m_data, i, offsetof(CrossIndexRecord, catalogNumber)) != catalogNumber)
+        return AstroCatalog::InvalidIndex;
+
+    return readField(m_data, i, offsetof(CrossIndexRecord, celCatalogNumber));
+}
+
+
+AstroCatalog::IndexNumber
+CrossIndex::findCatalogNumber(AstroCatalog::IndexNumber celCatalogNumber) const
+{
+    const char* byCelestia = m_data + static_cast<std::size_t>(m_size) * sizeof(CrossIndexRecord);
+    std::uint32_t i = lowerBound(byCelestia, m_size, offsetof(CrossIndexRecord, celCatalogNumber), celCatalogNumber);
+    if (i == m_size || readField(byCelestia, i, offsetof(CrossIndexRecord, celCatalogNumber)) != celCatalogNumber)
+        return AstroCatalog::InvalidIndex;
+
+    return readField(byCelestia, i, offsetof(CrossIndexRecord, catalogNumber));
+}
+
+
+std::unique_ptr<CrossIndex>
+CrossIndex::fromEntries(std::vector<Entry>&& entries)
+{
+    std::unique_ptr<CrossIndex> xindex(new CrossIndex());
+    xindex->m_size = static_cast<std::uint32_t>(entries.size());
+    xindex->m_records.resize(entries.size() * 2 * sizeof(CrossIndexRecord));
+
+    char* ptr = xindex->m_records.data();
+    auto writeRecords = [&ptr](const std::vector<Entry>& sorted)
+    {
+        for (const Entry& entry : sorted)
+        {
+            std::uint32_t catalogNumber;
+            std::uint32_t celCatalogNumber;
+            LE_TO_CPU_INT32(catalogNumber, entry.catalogNumber);
+            LE_TO_CPU_INT32(celCatalogNumber, entry.celCatalogNumber);
+            std::memcpy(ptr + offsetof(CrossIndexRecord, catalogNumber), &catalogNumber, sizeof(catalogNumber));
+            std::memcpy(ptr + offsetof(CrossIndexRecord, celCatalogNumber), &celCatalogNumber, sizeof(celCatalogNumber));
+            ptr += sizeof(CrossIndexRecord);
+        }
+    };
+
+    // Stable sorts of the entries in file order keep the first entry in the
+    // file first among equal numbers.
+    std::vector<Entry> byCelestia = entries;
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const Entry& a, const Entry& b) { return a.catalogNumber < b.catalogNumber; });
+    writeRecords(entries);
+    std::stable_sort(byCelestia.begin(), byCelestia.end(),
+                     [](const Entry& a, const Entry& b) { return a.celCatalogNumber < b.celCatalogNumber; });
+    writeRecords(byCelestia);
+
+    xindex->m_data = xindex->m_records.data();
+    return xindex;
+}
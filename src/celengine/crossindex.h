@@ -0,0 +1,71 @@
+// crossindex.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celutil/mappedfile.h>
+#include "astroobj.h"
+
+// Cross index between the numbers of another star catalog (HD, SAO,
+// Gliese) and Celestia catalog numbers. The records are kept sorted by
+// both numbers, so lookups in either direction are searches.
+//
+// Version 2 files, as written by makexindex, store both orders and are
+// mapped as they are. Version 1 files hold the records in no particular
+// order and are sorted at load.
+class CrossIndex
+{
+ public:
+    struct Entry
+    {
+        AstroCatalog::IndexNumber catalogNumber;
+        AstroCatalog::IndexNumber celCatalogNumber;
+    };
+
+    ~CrossIndex() = default;
+    CrossIndex(const CrossIndex&) = delete;
+    CrossIndex& operator=(const CrossIndex&) = delete;
+
+    // Both return nullptr if the cross index can't be read
+    static std::unique_ptr<CrossIndex> read(std::istream&);
+    static std::unique_ptr<CrossIndex> open(const fs::path&);
+
+    // Write entries in the version 2 format
+    static bool write(std::ostream&, std::vector<Entry> entries);
+
+    // Where the catalogs have several numbers for one star, these return
+    // the first in the file.
+    AstroCatalog::IndexNumber findCelestiaNumber(AstroCatalog::IndexNumber catalogNumber) const;
+    AstroCatalog::IndexNumber findCatalogNumber(AstroCatalog::IndexNumber celCatalogNumber) const;
+
+    std::uint32_t size() const { return m_size; }
+    // The pages of a mapped file aren't counted, as they can be dropped
+    // and read again by the system
+    std::size_t getMemoryUsage() const { return sizeof(*this) + m_records.capacity(); }
+
+ private:
+    CrossIndex() = default;
+
+    static std::unique_ptr<CrossIndex> fromEntries(std::vector<Entry>&& entries);
+
+    // Records as stored in version 2 files: m_size sorted by catalog number
+    // followed by m_size sorted by Celestia catalog number, either in
+    // m_records or in the mapped file.
+    const char* m_data{ nullptr };
+    std::uint32_t m_size{ 0 };
+    std::vector<char> m_records;
+    std::unique_ptr<celestia::util::MappedFile> m_file;
+};
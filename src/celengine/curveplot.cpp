@@ -116,6 +116,10 @@ cubicHermiteCoefficients(const Eigen::Vector4d& p0,
 
 const Eigen::Matrix4f ModelViewMatrix(Eigen::Matrix4f::Identity());
 
+// Line strips are drawn one at a time, with a draw call per strip. Between
+// beginBatch() and endBatch() the strips of all the curves rendered are
+// instead turned into separate segments sharing one stream buffer, so they
+// can be drawn with a single call.
 class HighPrec_VertexBuffer
 {
 public:
@@ -126,6 +130,9 @@ public:
         color = _color;
         renderer = &_renderer;
 
+        if (batching)
+            return;
+
         if (lr == nullptr)
         {
             lr = new LineRenderer(*renderer, OrbitThickness, LineRenderer::PrimType::LineStrip, LineRenderer::StorageType::Stream, LineRenderer::VertexFormat::P3F_C4UB);
@@ -136,22 +143,42 @@ public:
 
     void finish()
     {
-        lr->finish();
+        if (!batching)
+            lr->finish();
     }
 
     inline void vertex(const Eigen::Vector4d& v, float opacity = 1.0f)
     {
         Eigen::Vector3f pos = v.head(3).cast<float>();
-        lr->addVertex(pos, {color, color.alpha() * opacity});
+        Color vertexColor(color, color.alpha() * opacity);
+        if (batching)
+        {
+            if (currentStripLength > 0)
+            {
+                batchLr->addVertex(lastPos, lastColor);
+                batchLr->addVertex(pos, vertexColor);
+                batchVertexCount += 2;
+            }
+            lastPos = pos;
+            lastColor = vertexColor;
+        }
+        else
+        {
+            lr->addVertex(pos, vertexColor);
+        }
         ++currentStripLength;
     }
 
     inline void end()
     {
-        if (currentStripLength > 1)
-            stripLengths.push_back(currentStripLength);
-        else if (currentStripLength == 1)
-            lr->dropLast(); // Abandon line strips that contains only one point
+        // Batched strips have already been split into segments
+        if (!batching)
+        {
+            if (currentStripLength > 1)
+                stripLengths.push_back(currentStripLength);
+            else if (currentStripLength == 1)
+                lr->dropLast(); // Abandon line strips that contains only one point
+        }
         currentStripLength = 0;
     }
 
@@ -160,6 +187,12 @@ public:
         if (currentStripLength > 1)
             end();
 
+        if (batching)
+        {
+            currentStripLength = 0;
+            return;
+        }
+
         Matrices m = { &renderer->getCurrentProjectionMatrix(), &ModelViewMatrix };
         unsigned int startIndex = 0;
         lr->prerender(); // this will allocate a new GPU buffer if required
@@ -173,10 +206,43 @@ public:
         currentStripLength = 0;
     }
 
+    void beginBatch(const Renderer& _renderer)
+    {
+        renderer = &_renderer;
+        if (batchLr == nullptr)
+        {
+            batchLr = new LineRenderer(*renderer, OrbitThickness, LineRenderer::PrimType::Lines, LineRenderer::StorageType::Stream, LineRenderer::VertexFormat::P3F_C4UB);
+            batchLr->setVertexCount(VertexBufferCapacity * 2);
+        }
+        batchLr->startUpdate();
+        batchVertexCount = 0;
+        currentStripLength = 0;
+        batching = true;
+    }
+
+    void endBatch()
+    {
+        if (!batching)
+            return;
+        batching = false;
+
+        if (batchVertexCount > 0)
+        {
+            Matrices m = { &renderer->getCurrentProjectionMatrix(), &ModelViewMatrix };
+            batchLr->prerender();
+            batchLr->render(m, static_cast<int>(batchVertexCount));
+            batchLr->finish();
+        }
+        batchLr->clear();
+        batchVertexCount = 0;
+    }
+
     void deinit()
     {
         delete lr;
         lr = nullptr;
+        delete batchLr;
+        batchLr = nullptr;
     }
 
 private:
@@ -185,6 +251,12 @@ private:
     LineRenderer *lr { nullptr };
     const Renderer *renderer { nullptr };
     Color color;
+
+    bool batching { false };
+    LineRenderer *batchLr { nullptr };
+    unsigned int batchVertexCount { 0 };
+    Eigen::Vector3f lastPos;
+    Color lastColor;
 };
 
 
@@ -349,6 +421,23 @@ CurvePlot::deinit()
     vbuf.deinit();
 }
 
+/** Start collecting the curves rendered into a single batch. All curves
+  * rendered until endBatch() is called must use the same projection.
+  */
+void
+CurvePlot::beginBatch(const Renderer &renderer)
+{
+    vbuf.beginBatch(renderer);
+}
+
+/** Draw all curves rendered since beginBatch() with one draw call.
+  */
+void
+CurvePlot::endBatch()
+{
+    vbuf.endBatch();
+}
+
 /** Add a new sample to the path. If the sample time is less than the first time,
   * it is added at the end. If it is greater than the last time, it is appended
   * to the path. The sample is ignored if it has a time in between the first and
@@ -29,6 +29,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <deque>
 
 #include <Eigen/Core>
@@ -102,9 +103,13 @@ class CurvePlot
     bool empty() const { return m_samples.empty(); }
 
     unsigned int sampleCount() const { return static_cast<unsigned int>(m_samples.size()); }
+    std::size_t getMemoryUsage() const { return sizeof(*this) + m_samples.size() * sizeof(CurvePlotSample); }
 
     static void deinit();
 
+    static void beginBatch(const Renderer &renderer);
+    static void endBatch();
+
  private:
     std::deque<CurvePlotSample>     m_samples;
     const Renderer                 &m_renderer;
@@ -12,6 +12,7 @@
 
 #include <celmath/intersect.h>
 #include <celmath/sphere.h>
+#include <celutil/memoryreport.h>
 #include "deepskyobj.h"
 
 Eigen::Vector3d DeepSkyObject::getPosition() const
@@ -59,6 +60,11 @@ const std::string& DeepSkyObject::getInfoURL() const
     return infoURL;
 }
 
+std::size_t DeepSkyObject::getMemoryUsage() const
+{
+    return celestia::util::stringMemory(infoURL);
+}
+
 void DeepSkyObject::setInfoURL(const std::string& s)
 {
     infoURL = s;
@@ -136,6 +142,23 @@ void DeepSkyObject::hsv2rgb( float *r, float *g, float *b, float h, float s, flo
     }
 }
 
+// FIXME: infourl class
+void DeepSkyObject::setInfoURL(const std::string& url, const fs::path& resPath)
+{
+    std::string modifiedURL;
+    if (url.find(':') == std::string::npos && !resPath.empty())
+    {
+        // Relative URL, the base directory is the current one,
+        // not the main installation directory
+        if (resPath.c_str()[1] == ':')
+            // Absolute Windows path, file:/// is required
+            modifiedURL = "file:///" + resPath.string() + "/" + url;
+        else
+            modifiedURL = resPath.string() + "/" + url;
+    }
+    setInfoURL(modifiedURL.empty() ? url : modifiedURL);
+}
+
 bool DeepSkyObject::load(const AssociativeArray* params, const fs::path& resPath)
 {
     // Get position
@@ -165,22 +188,8 @@ bool DeepSkyObject::load(const AssociativeArray* params, const fs::path& resPath
     if (auto absMagValue = params->getNumber<float>("AbsMag"); absMagValue.has_value())
         setAbsoluteMagnitude(*absMagValue);
 
-    // FIXME: infourl class
     if (const std::string* infoURLValue = params->getString("InfoURL"); infoURLValue != nullptr)
-    {
-        std::string modifiedURL;
-        if (infoURLValue->find(':') == std::string::npos)
-        {
-            // Relative URL, the base directory is the current one,
-            // not the main installation directory
-            if (resPath.c_str()[1] == ':')
-                // Absolute Windows path, file:/// is required
-                modifiedURL = "file:///" + resPath.string() + "/" + *infoURLValue;
-            else if (!resPath.empty())
-                modifiedURL = resPath.string() + "/" + *infoURLValue;
-        }
-        setInfoURL(modifiedURL.empty() ? *infoURLValue : modifiedURL);
-    }
+        setInfoURL(*infoURLValue, resPath);
 
     if (auto visibleValue = params->getBoolean("Visible"); visibleValue.has_value())
     {
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <iosfwd>
 #include <string>
 #include <vector>
@@ -68,6 +69,8 @@ class DeepSkyObject : public AstroObject
 
     const std::string& getInfoURL() const;
     void setInfoURL(const std::string&);
+    // Same as above, with a relative URL taken relative to resPath
+    void setInfoURL(const std::string&, const fs::path& resPath);
 
     bool isVisible() const { return visible; }
     void setVisible(bool _visible) { visible = _visible; }
@@ -77,6 +80,10 @@ class DeepSkyObject : public AstroObject
 
     virtual const char* getObjTypeName() const = 0;
 
+    // Bytes taken by the object; derived classes add their size to those
+    // allocated by the members of DeepSkyObject
+    virtual std::size_t getMemoryUsage() const;
+
     virtual bool pick(const Eigen::ParametrizedLine<double, 3>& ray,
                       double& distanceToPicker,
                       double& cosAngleToBoundCenter) const = 0;
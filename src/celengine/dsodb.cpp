@@ -11,21 +11,44 @@
 //
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
 #include <cmath>
+#include <cstddef>
+#include <fstream>
 #include <memory>
 
+#include <celutil/bytes.h>
 #include <celutil/gettext.h>
+#include <celutil/jobsystem.h>
 #include <celutil/logger.h>
+#include <celutil/memoryreport.h>
 #include <celutil/tokenizer.h>
 #include "galaxy.h"
 #include "globular.h"
 #include "parser.h"
 #include "dsodb.h"
 #include "dsoname.h"
+#include "dsosdat.h"
 #include "nebula.h"
 #include "opencluster.h"
+#include "starsdat.h"
 #include "value.h"
 
+using celestia::engine::DSOsDatEntry;
+using celestia::engine::DSOsDatHeader;
+using celestia::engine::DSOsDatRecord;
+using celestia::engine::DSOsDatType;
+using celestia::engine::DSOSDAT_CLICKABLE;
+using celestia::engine::DSOSDAT_HAS_CORE_RADIUS;
+using celestia::engine::DSOSDAT_HAS_DETAIL;
+using celestia::engine::DSOSDAT_HAS_KING_CONCENTRATION;
+using celestia::engine::DSOSDAT_MAGIC;
+using celestia::engine::DSOSDAT_VERSION;
+using celestia::engine::DSOSDAT_VISIBLE;
+using celestia::engine::readRecordField;
+using celestia::engine::unpackDSOsDatEntry;
 using celestia::util::GetLogger;
 
 constexpr const float DSO_OCTREE_MAGNITUDE   = 8.0f;
@@ -34,22 +57,30 @@ constexpr const float DSO_OCTREE_MAGNITUDE   = 8.0f;
 
 //constexpr char FILE_HEADER[]                 = "CEL_DSOs";
 
+// Objects added after finish() are merged into the main octree once they
+// outnumber this fraction of its objects
+constexpr const int ADDED_DSOS_MERGE_RATIO   = 8;
+
 
 DSODatabase::~DSODatabase()
 {
     delete [] DSOs;
     delete [] catalogNumberIndex;
+    delete octreeRoot;
+    delete [] octreeDSOs;
+    delete addedOctreeRoot;
+    delete [] addedOctreeDSOs;
 }
 
 
 DeepSkyObject* DSODatabase::find(const AstroCatalog::IndexNumber catalogNumber) const
 {
     DeepSkyObject** dso = std::lower_bound(catalogNumberIndex,
-                                           catalogNumberIndex + nDSOs,
+                                           catalogNumberIndex + nIndexedDSOs,
                                            catalogNumber,
                                            [](const DeepSkyObject* const& dso, AstroCatalog::IndexNumber catNum) { return dso->getIndex() < catNum; });
 
-    if (dso != catalogNumberIndex + nDSOs && (*dso)->getIndex() == catalogNumber)
+    if (dso != catalogNumberIndex + nIndexedDSOs && (*dso)->getIndex() == catalogNumber)
         return *dso;
     else
         return nullptr;
@@ -72,11 +103,14 @@ DeepSkyObject* DSODatabase::find(std::string_view name, bool i18n) const
 }
 
 
-void DSODatabase::getCompletion(std::vector<std::string>& completion, std::string_view name, bool i18n) const
+void DSODatabase::getCompletion(std::vector<std::string>& completion,
+                               std::string_view name,
+                               bool i18n,
+                               std::size_t maxResults) const
 {
     // only named DSOs are supported by completion.
     if (!name.empty() && namesDB != nullptr)
-        namesDB->getCompletion(completion, name, i18n);
+        namesDB->getCompletion(completion, name, i18n, maxResults);
 }
 
 
@@ -86,16 +120,16 @@ std::string DSODatabase::getDSOName(const DeepSkyObject* const & dso, bool i18n)
 
     if (namesDB != nullptr)
     {
-        DSONameDatabase::NumberIndex::const_iterator iter = namesDB->getFirstNameIter(catalogNumber);
-        if (iter != namesDB->getFinalNameIter() && iter->first == catalogNumber)
+        auto iter = namesDB->getFirstNameIter(catalogNumber);
+        if (iter != namesDB->getFinalNameIter())
         {
             if (i18n)
             {
-                const char *local = D_(iter->second.c_str());
-                if (iter->second != local)
+                const char *local = D_((*iter).data());
+                if (*iter != local)
                     return local;
             }
-            return iter->second;
+            return std::string(*iter);
         }
     }
 
@@ -109,15 +143,15 @@ std::string DSODatabase::getDSONameList(const DeepSkyObject* const & dso, const
 
     auto catalogNumber   = dso->getIndex();
 
-    DSONameDatabase::NumberIndex::const_iterator iter = namesDB->getFirstNameIter(catalogNumber);
+    auto iter = namesDB->getFirstNameIter(catalogNumber);
 
     unsigned int count = 0;
-    while (iter != namesDB->getFinalNameIter() && iter->first == catalogNumber && count < maxNames)
+    while (iter != namesDB->getFinalNameIter() && count < maxNames)
     {
         if (count != 0)
             dsoNames.append(" / ");
 
-        dsoNames.append(D_(iter->second.c_str()));
+        dsoNames.append(D_((*iter).data()));
         ++iter;
         ++count;
     }
@@ -126,16 +160,54 @@ std::string DSODatabase::getDSONameList(const DeepSkyObject* const & dso, const
 }
 
 
-void DSODatabase::findVisibleDSOs(DSOHandler& dsoHandler,
-                                  const Eigen::Vector3d& obsPos,
-                                  const Eigen::Quaternionf& obsOrient,
-                                  float fovY,
-                                  float aspectRatio,
-                                  float limitingMag,
-                                  OctreeProcStats *stats) const
+namespace
+{
+
+// Number of octree levels processed on the calling thread before the
+// remaining subtrees are shared out for a parallel traversal
+constexpr unsigned int ParallelSplitLevel = 3;
+
+bool
+compareCatalogNumbers(const DeepSkyObject* dso0, const DeepSkyObject* dso1)
+{
+    return dso0->getIndex() < dso1->getIndex();
+}
+
+// Sort count objects into a new octree, which references them in the
+// order of a new sortedObjects array
+DSOOctree*
+createOctree(DeepSkyObject* const* objects, int count, DeepSkyObject**& sortedObjects)
+{
+    float absMag = astro::appToAbsMag(DSO_OCTREE_MAGNITUDE, DSO_OCTREE_ROOT_SIZE * (float) sqrt(3.0));
+
+    // TODO: investigate using a different center--it's possible that more
+    // objects end up straddling the base level nodes when the center of the
+    // octree is at the origin.
+    DynamicDSOOctree* root = new DynamicDSOOctree(Eigen::Vector3d::Zero(), absMag);
+    for (int i = 0; i < count; ++i)
+    {
+        root->insertObject(objects[i], DSO_OCTREE_ROOT_SIZE);
+    }
+
+    sortedObjects = new DeepSkyObject*[count];
+    DeepSkyObject** firstDSO = sortedObjects;
+    DSOOctree* octree = nullptr;
+
+    // The spatial sorting part is useless for DSOs since we
+    // are storing pointers to objects and not the objects themselves:
+    root->rebuildAndSort(octree, firstDSO);
+
+    delete root;
+    return octree;
+}
+
+// Compute the bounding planes of an infinite view frustum
+void computeFrustumPlanes(Eigen::Hyperplane<double, 3>* frustumPlanes,
+                          const Eigen::Vector3d& obsPos,
+                          const Eigen::Quaternionf& obsOrient,
+                          float fovY,
+                          float aspectRatio)
 {
-    // Compute the bounding planes of an infinite view frustum
-    Eigen::Hyperplane<double, 3> frustumPlanes[5];
     Eigen::Vector3d planeNormals[5];
 
     Eigen::Quaterniond obsOrientd = obsOrient.cast<double>();
@@ -154,6 +226,21 @@ void DSODatabase::findVisibleDSOs(DSOHandler& dsoHandler,
         planeNormals[i]    = rot * planeNormals[i].normalized();
         frustumPlanes[i]   = Eigen::Hyperplane<double, 3>(planeNormals[i], obsPos);
     }
+}
+
+} // end unnamed namespace
+
+
+void DSODatabase::findVisibleDSOs(DSOHandler& dsoHandler,
+                                  const Eigen::Vector3d& obsPos,
+                                  const Eigen::Quaternionf& obsOrient,
+                                  float fovY,
+                                  float aspectRatio,
+                                  float limitingMag,
+                                  OctreeProcStats *stats) const
+{
+    Eigen::Hyperplane<double, 3> frustumPlanes[5];
+    computeFrustumPlanes(frustumPlanes, obsPos, obsOrient, fovY, aspectRatio);
 
     octreeRoot->processVisibleObjects(dsoHandler,
                                       obsPos,
@@ -161,6 +248,77 @@ void DSODatabase::findVisibleDSOs(DSOHandler& dsoHandler,
                                       limitingMag,
                                       DSO_OCTREE_ROOT_SIZE,
                                       stats);
+    if (addedOctreeRoot != nullptr)
+    {
+        addedOctreeRoot->processVisibleObjects(dsoHandler,
+                                               obsPos,
+                                               frustumPlanes,
+                                               limitingMag,
+                                               DSO_OCTREE_ROOT_SIZE,
+                                               stats);
+    }
+}
+
+
+void DSODatabase::findVisibleDSOs(celestia::util::array_view<DSOHandler*> dsoHandlers,
+                                  const Eigen::Vector3d& obsPos,
+                                  const Eigen::Quaternionf& obsOrient,
+                                  float fovY,
+                                  float aspectRatio,
+                                  float limitingMag) const
+{
+    assert(!dsoHandlers.empty());
+    if (dsoHandlers.size() == 1)
+    {
+        findVisibleDSOs(*dsoHandlers[0], obsPos, obsOrient, fovY, aspectRatio, limitingMag);
+        return;
+    }
+
+    Eigen::Hyperplane<double, 3> frustumPlanes[5];
+    computeFrustumPlanes(frustumPlanes, obsPos, obsOrient, fovY, aspectRatio);
+
+    std::vector<DSOOctree::Subtree> subtrees;
+    octreeRoot->processVisibleObjects(*dsoHandlers[0],
+                                      obsPos,
+                                      frustumPlanes,
+                                      limitingMag,
+                                      DSO_OCTREE_ROOT_SIZE,
+                                      ParallelSplitLevel,
+                                      subtrees);
+
+    std::atomic<std::size_t> nextSubtree{ 0 };
+    auto traverse = [&](DSOHandler* handler)
+    {
+        for (;;)
+        {
+            std::size_t i = nextSubtree.fetch_add(1, std::memory_order_relaxed);
+            if (i >= subtrees.size())
+                break;
+
+            subtrees[i].node->processVisibleObjects(*handler,
+                                                    obsPos,
+                                                    frustumPlanes,
+                                                    limitingMag,
+                                                    subtrees[i].scale);
+        }
+    };
+
+    celestia::util::GetJobSystem()->parallelFor(0, dsoHandlers.size(), 1,
+                                                [&](std::size_t first, std::size_t last)
+                                                {
+                                                    for (std::size_t i = first; i < last; ++i)
+                                                        traverse(dsoHandlers[i]);
+                                                });
+
+    // Few objects are added after loading, so they aren't worth splitting
+    if (addedOctreeRoot != nullptr)
+    {
+        addedOctreeRoot->processVisibleObjects(*dsoHandlers[0],
+                                               obsPos,
+                                               frustumPlanes,
+                                               limitingMag,
+                                               DSO_OCTREE_ROOT_SIZE);
+    }
 }
 
 
@@ -172,6 +330,13 @@ void DSODatabase::findCloseDSOs(DSOHandler& dsoHandler,
                                     obsPos,
                                     radius,
                                     DSO_OCTREE_ROOT_SIZE);
+    if (addedOctreeRoot != nullptr)
+    {
+        addedOctreeRoot->processCloseObjects(dsoHandler,
+                                             obsPos,
+                                             radius,
+                                             DSO_OCTREE_ROOT_SIZE);
+    }
 }
 
 
@@ -181,6 +346,22 @@ DSONameDatabase* DSODatabase::getNameDatabase() const
 }
 
 
+void DSODatabase::addMemoryUsage(celestia::util::MemoryReport& report) const
+{
+    std::size_t bytes = static_cast<std::size_t>(capacity + nIndexedDSOs + nOctreeDSOs) * sizeof(DeepSkyObject*);
+    for (int i = 0; i < nDSOs; ++i)
+        bytes += DSOs[i]->getMemoryUsage();
+    if (octreeRoot != nullptr)
+        bytes += octreeRoot->getMemoryUsage();
+    if (addedOctreeRoot != nullptr)
+        bytes += addedOctreeRoot->getMemoryUsage() + static_cast<std::size_t>(nDSOs - nOctreeDSOs) * sizeof(DeepSkyObject*);
+    report.add("Deep sky objects", bytes, static_cast<std::size_t>(nDSOs));
+
+    if (namesDB != nullptr)
+        report.add("Deep sky object names", namesDB->getMemoryUsage(), namesDB->getNameCount());
+}
+
+
 void DSODatabase::setNameDatabase(DSONameDatabase* _namesDB)
 {
     namesDB    = _namesDB;
@@ -190,7 +371,25 @@ void DSODatabase::setNameDatabase(DSONameDatabase* _namesDB)
 bool DSODatabase::load(std::istream& in, const fs::path& resourcePath)
 {
     Tokenizer tokenizer(&in);
-    Parser    parser(&tokenizer);
+    return load(tokenizer, resourcePath);
+}
+
+
+bool DSODatabase::load(Tokenizer& tokenizer, const fs::path& resourcePath)
+{
+    bool ok = loadObjects(tokenizer, resourcePath);
+    // The objects read before an error are kept
+    if (octreeRoot != nullptr)
+        addLoadedDSOs();
+    return ok;
+}
+
+
+bool DSODatabase::loadObjects(Tokenizer& tokenizer, const fs::path& resourcePath)
+{
+    // Object properties are only used while loading each object
+    celestia::util::Arena arena;
+    Parser    parser(&tokenizer, &arena);
 
 #ifdef ENABLE_NLS
     std::string s = resourcePath.string();
@@ -200,6 +399,8 @@ bool DSODatabase::load(std::istream& in, const fs::path& resourcePath)
 
     while (tokenizer.nextToken() != Tokenizer::TokenEnd)
     {
+        arena.reset();
+
         std::string objType;
         if (auto tokenValue = tokenizer.getNameValue(); tokenValue.has_value())
         {
@@ -247,57 +448,8 @@ bool DSODatabase::load(std::istream& in, const fs::path& resourcePath)
         {
             obj->loadCategories(objParams, DataDisposition::Add, resourcePath.string());
 
-            // Ensure that the DSO array is large enough
-            if (nDSOs == capacity)
-            {
-                // Grow the array by 5%--this may be too little, but the
-                // assumption here is that there will be small numbers of
-                // DSOs in text files added to a big collection loaded from
-                // a binary file.
-                capacity = static_cast<int>(capacity * 1.05);
-
-                // 100 DSOs seems like a reasonable minimum
-                if (capacity < 100)
-                    capacity = 100;
-
-                DeepSkyObject** newDSOs = new DeepSkyObject*[capacity];
-
-                if (DSOs != nullptr)
-                {
-                    std::copy(DSOs, DSOs + nDSOs, newDSOs);
-                    delete[] DSOs;
-                }
-                DSOs = newDSOs;
-            }
-
-            DSOs[nDSOs++] = obj;
-
             obj->setIndex(objCatalogNumber);
-
-            if (namesDB != nullptr && !objName.empty())
-            {
-                // List of names will replace any that already exist for
-                // this DSO.
-                namesDB->erase(objCatalogNumber);
-
-                // Iterate through the string for names delimited
-                // by ':', and insert them into the DSO database.
-                // Note that db->add() will skip empty names.
-                std::string::size_type startPos = 0;
-                while (startPos != std::string::npos)
-                {
-                    std::string::size_type next    = objName.find(':', startPos);
-                    std::string::size_type length  = std::string::npos;
-                    if (next != std::string::npos)
-                    {
-                        length = next - startPos;
-                        ++next;
-                    }
-                    std::string DSOName = objName.substr(startPos, length);
-                    namesDB->add(objCatalogNumber, DSOName);
-                    startPos   = next;
-                }
-            }
+            addDSO(obj, objName);
         }
         else
         {
@@ -309,13 +461,173 @@ bool DSODatabase::load(std::istream& in, const fs::path& resourcePath)
 }
 
 
-bool DSODatabase::loadBinary(std::istream&)
+bool DSODatabase::loadBinary(std::istream& in, const fs::path& resourcePath)
 {
-    // TODO: define a binary dso file format
+    std::vector<DSOsDatEntry> entries;
+    if (!readDSOsDat(in, entries))
+        return false;
+
+#ifdef ENABLE_NLS
+    std::string s = resourcePath.string();
+    const char *d = s.c_str();
+    bindtextdomain(d, d); // domain name is the same as resource path
+#endif
+
+    reserve(entries.size());
+    for (const DSOsDatEntry& entry : entries)
+        addEntry(entry, resourcePath);
+
+    if (octreeRoot != nullptr)
+        addLoadedDSOs();
+
     return true;
 }
 
 
+void DSODatabase::reserve(std::size_t count)
+{
+    // Reserve room for the whole file up front instead of growing by 5%
+    if (capacity >= nDSOs + static_cast<int>(count))
+        return;
+
+    capacity = nDSOs + static_cast<int>(count);
+    DeepSkyObject** newDSOs = new DeepSkyObject*[capacity];
+    if (DSOs != nullptr)
+    {
+        std::copy(DSOs, DSOs + nDSOs, newDSOs);
+        delete[] DSOs;
+    }
+    DSOs = newDSOs;
+}
+
+
+void DSODatabase::addEntry(const DSOsDatEntry& entry, const fs::path& resourcePath)
+{
+    DeepSkyObject* obj = nullptr;
+    switch (entry.type)
+    {
+    case DSOsDatType::Galaxy:
+        {
+            auto galaxy = new Galaxy();
+            galaxy->setDetail(entry.detail);
+            galaxy->setGalaxyType(static_cast<GalaxyType>(entry.galaxyType));
+            galaxy->setForm(entry.customTemplate);
+            obj = galaxy;
+        }
+        break;
+    case DSOsDatType::Globular:
+        obj = new Globular();
+        break;
+    case DSOsDatType::Nebula:
+        {
+            auto nebula = new Nebula();
+            if (!entry.mesh.empty())
+                nebula->setMesh(entry.mesh, resourcePath);
+            obj = nebula;
+        }
+        break;
+    case DSOsDatType::OpenCluster:
+        obj = new OpenCluster();
+        break;
+    }
+
+    obj->setPosition(entry.position);
+    obj->setOrientation(entry.orientation);
+    obj->setRadius(entry.radius);
+    obj->setAbsoluteMagnitude(entry.absMag);
+    if (!entry.infoURL.empty())
+        obj->setInfoURL(entry.infoURL, resourcePath);
+    obj->setVisible((entry.flags & DSOSDAT_VISIBLE) != 0);
+    obj->setClickable((entry.flags & DSOSDAT_CLICKABLE) != 0);
+
+    if (entry.type == DSOsDatType::Globular)
+    {
+        // The tidal radius depends on the position, so the structure
+        // is set last.
+        auto globular = static_cast<Globular*>(obj);
+        if ((entry.flags & DSOSDAT_HAS_DETAIL) != 0)
+            globular->setDetail(entry.detail);
+        globular->setStructure((entry.flags & DSOSDAT_HAS_CORE_RADIUS) != 0
+                                   ? entry.coreRadius
+                                   : globular->getCoreRadius(),
+                               (entry.flags & DSOSDAT_HAS_KING_CONCENTRATION) != 0
+                                   ? entry.kingConcentration
+                                   : globular->getKingConcentration());
+    }
+
+    for (const std::string& category : entry.categories)
+        obj->addToCategory(category, true, resourcePath.string());
+
+    obj->setIndex(nextAutoCatalogNumber--);
+    addDSO(obj, entry.name);
+}
+
+
+bool DSODatabase::isBinary(const fs::path& path)
+{
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    std::array<char, sizeof(DSOsDatHeader)> header;
+    if (!in.read(header.data(), header.size()).good())
+        return false;
+
+    return std::string_view(header.data() + offsetof(DSOsDatHeader, magic), DSOSDAT_MAGIC.size()) == DSOSDAT_MAGIC;
+}
+
+
+void DSODatabase::addDSO(DeepSkyObject* obj, const std::string& names)
+{
+    // Ensure that the DSO array is large enough
+    if (nDSOs == capacity)
+    {
+        // Grow the array by 5%--this may be too little, but the
+        // assumption here is that there will be small numbers of
+        // DSOs in text files added to a big collection loaded from
+        // a binary file.
+        capacity = static_cast<int>(capacity * 1.05);
+
+        // 100 DSOs seems like a reasonable minimum
+        if (capacity < 100)
+            capacity = 100;
+
+        DeepSkyObject** newDSOs = new DeepSkyObject*[capacity];
+
+        if (DSOs != nullptr)
+        {
+            std::copy(DSOs, DSOs + nDSOs, newDSOs);
+            delete[] DSOs;
+        }
+        DSOs = newDSOs;
+    }
+
+    DSOs[nDSOs++] = obj;
+
+    if (namesDB != nullptr && !names.empty())
+    {
+        // List of names will replace any that already exist for
+        // this DSO.
+        namesDB->erase(obj->getIndex());
+
+        // Iterate through the string for names delimited
+        // by ':', and insert them into the DSO database.
+        // Note that db->add() will skip empty names.
+        std::string::size_type startPos = 0;
+        while (startPos != std::string::npos)
+        {
+            std::string::size_type next    = names.find(':', startPos);
+            std::string::size_type length  = std::string::npos;
+            if (next != std::string::npos)
+            {
+                length = next - startPos;
+                ++next;
+            }
+            std::string DSOName = names.substr(startPos, length);
+            namesDB->add(obj->getIndex(), DSOName);
+            startPos   = next;
+        }
+    }
+}
+
+
 void DSODatabase::finish()
 {
     buildOctree();
@@ -336,39 +648,67 @@ void DSODatabase::finish()
 void DSODatabase::buildOctree()
 {
     GetLogger()->debug("Sorting DSOs into octree . . .\n");
-    float absMag             = astro::appToAbsMag(DSO_OCTREE_MAGNITUDE, DSO_OCTREE_ROOT_SIZE * (float) sqrt(3.0));
 
-    // TODO: investigate using a different center--it's possible that more
-    // objects end up straddling the base level nodes when the center of the
-    // octree is at the origin.
-    DynamicDSOOctree* root   = new DynamicDSOOctree(Eigen::Vector3d::Zero(), absMag);
-    for (int i = 0; i < nDSOs; ++i)
-    {
-        root->insertObject(DSOs[i], DSO_OCTREE_ROOT_SIZE);
-    }
-
-    GetLogger()->debug("Spatially sorting DSOs for improved locality of reference . . .\n");
-    DeepSkyObject** sortedDSOs    = new DeepSkyObject*[nDSOs];
-    DeepSkyObject** firstDSO      = sortedDSOs;
-
-    // The spatial sorting part is useless for DSOs since we
-    // are storing pointers to objects and not the objects themselves:
-    root->rebuildAndSort(octreeRoot, firstDSO);
+    delete octreeRoot;
+    delete[] octreeDSOs;
+    octreeRoot  = createOctree(DSOs, nDSOs, octreeDSOs);
+    nOctreeDSOs = nDSOs;
 
     GetLogger()->debug("{} DSOs total.\nOctree has {} nodes and {} DSOs.\n",
-                       static_cast<int>(firstDSO - sortedDSOs),
+                       nOctreeDSOs,
                        1 + octreeRoot->countChildren(),
                        octreeRoot->countObjects());
 
-    // Clean up . . .
-    delete[] DSOs;
-    delete   root;
+    // The added objects are part of the main octree now
+    delete addedOctreeRoot;
+    delete[] addedOctreeDSOs;
+    addedOctreeRoot = nullptr;
+    addedOctreeDSOs = nullptr;
+}
+
 
-    DSOs = sortedDSOs;
+// The objects added since the main octree was built are the last ones of
+// the DSOs array
+void DSODatabase::buildAddedOctree()
+{
+    delete addedOctreeRoot;
+    delete[] addedOctreeDSOs;
+    addedOctreeRoot = createOctree(DSOs + nOctreeDSOs, nDSOs - nOctreeDSOs, addedOctreeDSOs);
+}
+
+
+/*! Index the objects loaded after finish() and sort them into the octree
+ *  of added objects, which holds few enough of them to be rebuilt each
+ *  time. Once they're too many, they're merged into the main octree.
+ */
+void DSODatabase::addLoadedDSOs()
+{
+    if (nDSOs == nIndexedDSOs)
+        return;
+
+    DeepSkyObject** newIndex = new DeepSkyObject*[nDSOs];
+    std::copy(catalogNumberIndex, catalogNumberIndex + nIndexedDSOs, newIndex);
+    std::copy(DSOs + nIndexedDSOs, DSOs + nDSOs, newIndex + nIndexedDSOs);
+    std::sort(newIndex + nIndexedDSOs, newIndex + nDSOs, compareCatalogNumbers);
+    std::inplace_merge(newIndex, newIndex + nIndexedDSOs, newIndex + nDSOs, compareCatalogNumbers);
+
+    GetLogger()->debug("Adding {} DSOs to the database\n", nDSOs - nIndexedDSOs);
+
+    delete[] catalogNumberIndex;
+    catalogNumberIndex = newIndex;
+    nIndexedDSOs = nDSOs;
+
+    if (nDSOs - nOctreeDSOs > nOctreeDSOs / ADDED_DSOS_MERGE_RATIO)
+        buildOctree();
+    else
+        buildAddedOctree();
+
+    calcAvgAbsMag();
 }
 
 void DSODatabase::calcAvgAbsMag()
 {
+    avgAbsMag = 0.0f;
     uint32_t nDSOeff = size();
     for (int i = 0; i < nDSOs; ++i)
     {
@@ -381,7 +721,8 @@ void DSODatabase::calcAvgAbsMag()
         else if (nDSOeff > 1)
             nDSOeff--;
     }
-    avgAbsMag /= static_cast<float>(nDSOeff);
+    if (nDSOeff > 0)
+        avgAbsMag /= static_cast<float>(nDSOeff);
 }
 
 
@@ -392,13 +733,15 @@ void DSODatabase::buildIndexes()
 
     GetLogger()->debug("Building catalog number indexes . . .\n");
 
+    delete[] catalogNumberIndex;
     catalogNumberIndex = new DeepSkyObject*[nDSOs];
     for (int i = 0; i < nDSOs; ++i)
         catalogNumberIndex[i] = DSOs[i];
+    nIndexedDSOs = nDSOs;
 
     std::sort(catalogNumberIndex,
               catalogNumberIndex + nDSOs,
-              [](const DeepSkyObject* dso0, const DeepSkyObject* dso1) { return dso0->getIndex() < dso1->getIndex(); });
+              compareCatalogNumbers);
 }
 
 
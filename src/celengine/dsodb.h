@@ -12,8 +12,10 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <iosfwd>
+#include <limits>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -23,8 +25,20 @@
 
 #include <celcompat/filesystem.h>
 #include <celengine/dsooctree.h>
+#include <celutil/array_view.h>
+
+namespace celestia::util
+{
+class MemoryReport;
+}
 
 class DSONameDatabase;
+class Tokenizer;
+
+namespace celestia::engine
+{
+struct DSOsDatEntry;
+}
 
 constexpr inline unsigned int MAX_DSO_NAMES = 10;
 
@@ -45,7 +59,10 @@ class DSODatabase
     DeepSkyObject* find(const AstroCatalog::IndexNumber catalogNumber) const;
     DeepSkyObject* find(std::string_view, bool i18n) const;
 
-    void getCompletion(std::vector<std::string>&, std::string_view, bool i18n) const;
+    void getCompletion(std::vector<std::string>&,
+                       std::string_view,
+                       bool i18n,
+                       std::size_t maxResults = std::numeric_limits<std::size_t>::max()) const;
 
     void findVisibleDSOs(DSOHandler& dsoHandler,
                          const Eigen::Vector3d& obsPosition,
@@ -55,6 +72,15 @@ class DSODatabase
                          float limitingMag,
                          OctreeProcStats * = nullptr) const;
 
+    // Traverse the octree with one thread per handler; the handlers are
+    // invoked concurrently, each on a separate thread.
+    void findVisibleDSOs(celestia::util::array_view<DSOHandler*> dsoHandlers,
+                         const Eigen::Vector3d& obsPosition,
+                         const Eigen::Quaternionf& obsOrientation,
+                         float fovY,
+                         float aspectRatio,
+                         float limitingMag) const;
+
     void findCloseDSOs(DSOHandler& dsoHandler,
                        const Eigen::Vector3d& obsPosition,
                        float radius) const;
@@ -65,17 +91,35 @@ class DSODatabase
     DSONameDatabase* getNameDatabase() const;
     void setNameDatabase(DSONameDatabase*);
 
+    // Add the memory taken by the objects and their names to report
+    void addMemoryUsage(celestia::util::MemoryReport& report) const;
+
+    // Objects loaded after finish(), e.g. by scripts loading catalog
+    // fragments, are added without rebuilding the whole octree.
     bool load(std::istream&, const fs::path& resourcePath = fs::path());
-    bool loadBinary(std::istream&);
+    bool load(Tokenizer&, const fs::path& resourcePath = fs::path());
+    // Load a catalog compiled by makedsodb; relative paths stored in it are
+    // resolved against resourcePath.
+    bool loadBinary(std::istream&, const fs::path& resourcePath = fs::path());
+    // Create a single object from a parsed catalog entry; used to merge
+    // catalogs which were read elsewhere, a few objects at a time.
+    void addEntry(const celestia::engine::DSOsDatEntry&, const fs::path& resourcePath = fs::path());
+    void reserve(std::size_t);
     void finish();
 
+    static bool isBinary(const fs::path&);
+
     static DSODatabase* read(std::istream&);
 
     float getAverageAbsoluteMagnitude() const;
 
 private:
+    bool loadObjects(Tokenizer&, const fs::path& resourcePath);
+    void addDSO(DeepSkyObject*, const std::string& names);
+    void addLoadedDSOs();
     void buildIndexes();
     void buildOctree();
+    void buildAddedOctree();
     void calcAvgAbsMag();
 
     int              nDSOs{ 0 };
@@ -83,7 +127,16 @@ private:
     DeepSkyObject**  DSOs{ nullptr };
     DSONameDatabase* namesDB{ nullptr };
     DeepSkyObject**  catalogNumberIndex{ nullptr };
+    int              nIndexedDSOs{ 0 };
+    // The octree references its objects in the order of octreeDSOs, as
+    // the DSOs array may be reallocated when objects are added.
     DSOOctree*       octreeRoot{ nullptr };
+    DeepSkyObject**  octreeDSOs{ nullptr };
+    int              nOctreeDSOs{ 0 };
+    // Objects added after finish() are kept in an octree of their own
+    // until they're numerous enough to be merged into the main one
+    DSOOctree*       addedOctreeRoot{ nullptr };
+    DeepSkyObject**  addedOctreeDSOs{ nullptr };
     AstroCatalog::IndexNumber nextAutoCatalogNumber{ 0xfffffffe };
 
     float            avgAbsMag{ 0.0f };
@@ -65,6 +65,53 @@ template<> DynamicDSOOctree::ExclusionFactorDecayFunction*
            DynamicDSOOctree::decayFunction = dsoAbsoluteMagnitudeDecayFunction;
 
 
+namespace
+{
+
+// Test the cubic octree node against each one of the five
+// planes that define the infinite view frustum.
+bool dsoNodeInFrustum(const Vector3d& cellCenterPos,
+                      const Hyperplane<double, 3>* frustumPlanes,
+                      double scale)
+{
+    for (unsigned int i = 0; i < 5; ++i)
+    {
+        const Hyperplane<double, 3>& plane = frustumPlanes[i];
+
+        double r = scale * plane.normal().cwiseAbs().sum();
+        if (plane.signedDistance(cellCenterPos) < -r)
+            return false;
+    }
+
+    return true;
+}
+
+
+void processNodeDSOs(DSOHandler& processor,
+                     DeepSkyObject* const* firstObject,
+                     unsigned int nObjects,
+                     const Vector3d& obsPosition,
+                     float limitingFactor,
+                     double dimmest)
+{
+    for (unsigned int i=0; i<nObjects; ++i)
+    {
+        DeepSkyObject* _obj = firstObject[i];
+        float  absMag      = _obj->getAbsoluteMagnitude();
+        if (absMag < dimmest)
+        {
+            double distance    = (obsPosition - _obj->getPosition()).norm() - _obj->getBoundingSphereRadius();
+            float appMag = (float) ((distance >= 32.6167) ? astro::absToAppMag((double) absMag, distance) : absMag);
+
+            if ( appMag < limitingFactor)
+                processor.process(_obj, distance, absMag);
+        }
+    }
+}
+
+} // end unnamed namespace
+
+
 // total specialization of the StaticOctree template process*() methods for DSOs:
 template<>
 void DSOOctree::processVisibleObjects(DSOHandler&    processor,
@@ -83,17 +130,8 @@ void DSOOctree::processVisibleObjects(DSOHandler&    processor,
     }
 #endif
     // See if this node lies within the view frustum
-
-    // Test the cubic octree node against each one of the five
-    // planes that define the infinite view frustum.
-    for (unsigned int i = 0; i < 5; ++i)
-    {
-        const Hyperplane<double, 3>& plane = frustumPlanes[i];
-
-        double r = scale * plane.normal().cwiseAbs().sum();
-        if (plane.signedDistance(cellCenterPos) < -r)
-            return;
-    }
+    if (!dsoNodeInFrustum(cellCenterPos, frustumPlanes, scale))
+        return;
 
     // Compute the distance to node; this is equal to the distance to
     // the cellCenterPos of the node minus the boundingRadius of the node, scale * SQRT3.
@@ -102,23 +140,11 @@ void DSOOctree::processVisibleObjects(DSOHandler&    processor,
     // Process the objects in this node
     double dimmest     = minDistance > 0.0 ? astro::appToAbsMag((double) limitingFactor, minDistance) : 1000.0;
 
-    for (unsigned int i=0; i<nObjects; ++i)
-    {
 #ifdef OCTREE_DEBUG
-        if (stats != nullptr)
-            stats->objects++;
+    if (stats != nullptr)
+        stats->objects += nObjects;
 #endif
-        DeepSkyObject* _obj = _firstObject[i];
-        float  absMag      = _obj->getAbsoluteMagnitude();
-        if (absMag < dimmest)
-        {
-            double distance    = (obsPosition - _obj->getPosition()).norm() - _obj->getBoundingSphereRadius();
-            float appMag = (float) ((distance >= 32.6167) ? astro::absToAppMag((double) absMag, distance) : absMag);
-
-            if ( appMag < limitingFactor)
-                processor.process(_obj, distance, absMag);
-        }
-    }
+    processNodeDSOs(processor, _firstObject, nObjects, obsPosition, limitingFactor, dimmest);
 
     // See if any of the objects in child nodes are potentially included
     // that we need to recurse deeper.
@@ -149,6 +175,50 @@ void DSOOctree::processVisibleObjects(DSOHandler&    processor,
 }
 
 
+template<>
+void DSOOctree::processVisibleObjects(DSOHandler&                  processor,
+                                      const PointType&             obsPosition,
+                                      const Hyperplane<double, 3>* frustumPlanes,
+                                      float                        limitingFactor,
+                                      double                       scale,
+                                      unsigned int                 splitLevel,
+                                      std::vector<Subtree>&        subtrees) const
+{
+    if (splitLevel == 0)
+    {
+        // The frustum and magnitude tests for this node are left to
+        // whoever traverses the subtree.
+        subtrees.push_back({ this, scale });
+        return;
+    }
+
+    if (!dsoNodeInFrustum(cellCenterPos, frustumPlanes, scale))
+        return;
+
+    double minDistance = (obsPosition - cellCenterPos).norm() - scale * DSOOctree::SQRT3;
+    double dimmest     = minDistance > 0.0 ? astro::appToAbsMag((double) limitingFactor, minDistance) : 1000.0;
+
+    processNodeDSOs(processor, _firstObject, nObjects, obsPosition, limitingFactor, dimmest);
+
+    if (_children == nullptr)
+        return;
+
+    if (minDistance <= 0.0 || astro::absToAppMag((double) exclusionFactor, minDistance) <= limitingFactor)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            _children[i]->processVisibleObjects(processor,
+                                                obsPosition,
+                                                frustumPlanes,
+                                                limitingFactor,
+                                                scale * 0.5f,
+                                                splitLevel - 1,
+                                                subtrees);
+        }
+    }
+}
+
+
 template<>
 void DSOOctree::processCloseObjects(DSOHandler&    processor,
                                     const PointType& obsPosition,
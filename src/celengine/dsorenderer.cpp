@@ -10,6 +10,9 @@
 
 #include <celengine/dsodb.h>
 #include <celengine/deepskyobj.h>
+#include <celengine/galaxy.h>
+#include <celengine/globular.h>
+#include <celengine/skyoccluders.h>
 #include <celmath/geomutil.h>
 #include <celmath/vecgl.h>
 #include "glsupport.h"
@@ -52,69 +55,106 @@ void DSORenderer::process(DeepSkyObject* const &dso,
     if (frustum.testSphere(center, (float) dsoRadius) == Frustum::Outside)
         return;
 
+    if (occluders != nullptr && occluders->hides(relPos, relPos.norm(), (float) dsoRadius))
+        return;
+
     float appMag;
     if (distanceToDSO >= pc10)
         appMag = (float) astro::absToAppMag((double) absMag, distanceToDSO);
     else
         appMag = absMag + (float) (enhance * tanh(distanceToDSO/pc10 - 1.0));
 
-    if ((renderFlags & dso->getRenderMask()) != 0)
-    {
-        dsosProcessed++;
+    // Input: display looks satisfactory for 0.2 < brightness < O(1.0)
+    // Ansatz: brightness = a - b * appMag(distanceToDSO), emulating eye sensitivity...
+    // determine a,b such that
+    // a - b * absMag = absMag / avgAbsMag ~ 1; a - b * faintestMag = 0.2.
+    // The 2nd eq. guarantees that the faintest galaxies are still visible.
 
-        // Input: display looks satisfactory for 0.2 < brightness < O(1.0)
-        // Ansatz: brightness = a - b * appMag(distanceToDSO), emulating eye sensitivity...
-        // determine a,b such that
-        // a - b * absMag = absMag / avgAbsMag ~ 1; a - b * faintestMag = 0.2.
-        // The 2nd eq. guarantees that the faintest galaxies are still visible.
+    float typeAvgAbsMag = avgAbsMag;
+    if (dso->getRenderMask() == Renderer::ShowGlobulars)
+        typeAvgAbsMag = -6.86f; // average over 150 globulars in globulars.dsc.
+    else if (dso->getRenderMask() == Renderer::ShowGalaxies)
+        typeAvgAbsMag = -19.04f; // average over 10937 galaxies in galaxies.dsc.
 
-        if (!strcmp(dso->getObjTypeName(), "globular"))
-            avgAbsMag = -6.86f; // average over 150 globulars in globulars.dsc.
-        else if (!strcmp(dso->getObjTypeName(), "galaxy"))
-            avgAbsMag = -19.04f; // average over 10937 galaxies in galaxies.dsc.
+    float r = absMag / typeAvgAbsMag;
+    float brightness = r - (r - 0.2f) * (absMag - appMag) / (absMag - faintestMag);
 
-        float r = absMag / avgAbsMag;
-        float brightness = r - (r - 0.2f) * (absMag - appMag) / (absMag - faintestMag);
+    // obviously, brightness(appMag = absMag) = r and
+    // brightness(appMag = faintestMag) = 0.2, as desired.
 
-        // obviously, brightness(appMag = absMag) = r and
-        // brightness(appMag = faintestMag) = 0.2, as desired.
+    brightness *= 2.3f * (faintestMag - 4.75f) / renderer->getFaintestAM45deg();
 
-        brightness *= 2.3f * (faintestMag - 4.75f) / renderer->getFaintestAM45deg();
+    if (brightness < 0)
+        brightness = 0;
 
-        if (brightness < 0)
-            brightness = 0;
+    VisibleDSO visible{ dso, distanceToDSO, appMag, brightness, relPos };
+    if (visibleDSOs != nullptr)
+        visibleDSOs->push_back(visible);
+    else
+        render(visible);
+}
 
-        Matrix4f mv = celmath::translate(renderer->getModelViewMatrix(), relPos);
-        Matrix4f pr;
+void DSORenderer::render(const VisibleDSO& visible)
+{
+    DeepSkyObject* dso = visible.dso;
+    double distanceToDSO = visible.distance;
+    float appMag = visible.appMag;
+    const Vector3f& relPos = visible.relPos;
 
-        if (dsoRadius < 1000.0)
-        {
-            // Small objects may be prone to clipping; give them special
-            // handling.  We don't want to always set the projection
-            // matrix, since that could be expensive with large galaxy
-            // catalogs.
-            auto nearZ = (float)(distanceToDSO / 2);
-            auto farZ = (float)(distanceToDSO + dsoRadius * 2 * CubeCornerToCenterDistance);
-            if (nearZ < dsoRadius * 0.001)
-            {
-                nearZ = (float)(dsoRadius * 0.001);
-                farZ = nearZ * 10000.0f;
-            }
+    if ((renderFlags & dso->getRenderMask()) != 0)
+    {
+        dsosProcessed++;
 
-            float t = renderer->getAspectRatio();
-            if (renderer->getProjectionMode() == Renderer::ProjectionMode::FisheyeMode)
-                pr = Ortho(-t, t, -1.0f, 1.0f, nearZ, farZ);
-            else
-                pr = Perspective(fov, t, nearZ, farZ);
+        double dsoRadius = dso->getBoundingSphereRadius();
+        if (queueInstances && dsoRadius >= 1000.0 && dso->getRenderMask() == Renderer::ShowGalaxies)
+        {
+            static_cast<const Galaxy*>(dso)->queueRender(relPos, visible.brightness, pixelSize);
         }
         else
         {
-            pr = renderer->getProjectionMatrix();
-        }
+            Matrix4f mv = celmath::translate(renderer->getModelViewMatrix(), relPos);
+            Matrix4f pr;
+            bool queued = false;
 
-        dso->render(relPos, observer->getOrientationf(), brightness,
-                    pixelSize, { &pr, &mv }, renderer);
+            if (dsoRadius < 1000.0)
+            {
+                // Small objects may be prone to clipping; give them special
+                // handling.  We don't want to always set the projection
+                // matrix, since that could be expensive with large galaxy
+                // catalogs.
+                auto nearZ = (float)(distanceToDSO / 2);
+                auto farZ = (float)(distanceToDSO + dsoRadius * 2 * CubeCornerToCenterDistance);
+                if (nearZ < dsoRadius * 0.001)
+                {
+                    nearZ = (float)(dsoRadius * 0.001);
+                    farZ = nearZ * 10000.0f;
+                }
+
+                float t = renderer->getAspectRatio();
+                if (renderer->getProjectionMode() == Renderer::ProjectionMode::FisheyeMode)
+                    pr = Ortho(-t, t, -1.0f, 1.0f, nearZ, farZ);
+                else
+                    pr = Perspective(fov, t, nearZ, farZ);
+
+                if (queueInstances && dso->getRenderMask() == Renderer::ShowGlobulars)
+                {
+                    static_cast<const Globular*>(dso)->queueRender(relPos, observer->getOrientationf(),
+                                                                    visible.brightness, pixelSize,
+                                                                    nearZ, farZ, { &pr, &mv }, renderer);
+                    queued = true;
+                }
+            }
+            else
+            {
+                pr = renderer->getProjectionMatrix();
+            }
 
+            if (!queued)
+            {
+                dso->render(relPos, observer->getOrientationf(), visible.brightness,
+                            pixelSize, { &pr, &mv }, renderer);
+            }
+        }
     } // renderFlags check
 
     // Only render those labels that are in front of the camera:
@@ -175,12 +215,13 @@ void DSORenderer::process(DeepSkyObject* const &dso,
             labelColor.alpha(distr * labelColor.alpha());
 
             renderer->addBackgroundAnnotation(rep,
-                                              dsoDB->getDSOName(dso, true),
+                                              renderer->getLabelCache().getDSOLabel(*dsoDB, dso),
                                               labelColor,
                                               relPos,
                                               Renderer::LabelHorizontalAlignment::Start,
                                               Renderer::LabelVerticalAlignment::Center,
-                                              symbolSize);
+                                              symbolSize,
+                                              -appMagEff);
         }
     }     // labels enabled
 }
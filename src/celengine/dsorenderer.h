@@ -10,25 +10,54 @@
 
 #pragma once
 
+#include <vector>
+
 #include <Eigen/Core>
 #include <celmath/frustum.h>
 #include "objectrenderer.h"
 
 class DeepSkyObject;
+class SkyOccluders;
+
+// A DSO which passed the culling tests, along with what's needed to
+// render and label it.
+struct VisibleDSO
+{
+    DeepSkyObject*  dso;
+    double          distance;
+    float           appMag;
+    float           brightness;
+    Eigen::Vector3f relPos;
+};
 
 class DSORenderer : public ObjectRenderer<DeepSkyObject*, double>
 {
  public:
     DSORenderer();
 
-    void process(DeepSkyObject* const &, double, float);
+    void process(DeepSkyObject* const &, double, float) override;
+
+    // Render and label a DSO collected by process
+    void render(const VisibleDSO&);
 
  public:
     Eigen::Vector3d     obsPos;
     Eigen::Matrix3f     orientationMatrixT;
     celmath::Frustum    frustum         { 45.0_deg, 1.0f, 1.0f };
     DSODatabase*        dsoDB           { nullptr };
+    // Bodies hiding the DSOs behind them
+    const SkyOccluders* occluders       { nullptr };
 
     float               avgAbsMag       { 0.0f };
     uint32_t            dsosProcessed   { 0 };
+
+    // When set, the visible DSOs are collected here instead of being
+    // rendered, so that process doesn't touch GL or any renderer state
+    // and can run on a worker thread.
+    std::vector<VisibleDSO>* visibleDSOs { nullptr };
+
+    // When set, galaxies drawn with the default projection and globular
+    // clusters are queued with queueRender rather than drawn one at a time,
+    // to be drawn by Galaxy::renderQueued and Globular::renderQueued.
+    bool                queueInstances  { false };
 };
@@ -0,0 +1,435 @@
+// dsosdat.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Record layout of the binary deep sky object database files.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "dsosdat.h"
+
+#include <array>
+#include <cstddef>
+#include <istream>
+#include <limits>
+#include <ostream>
+
+#include <celutil/binarywrite.h>
+#include <celutil/bytes.h>
+#include <celutil/logger.h>
+#include <celutil/stringutils.h>
+#include <celutil/tokenizer.h>
+#include "astro.h"
+#include "galaxy.h"
+#include "hash.h"
+#include "opencluster.h"
+#include "parser.h"
+#include "starsdat.h"
+#include "value.h"
+
+using celestia::util::GetLogger;
+
+namespace celutil = celestia::util;
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+void
+readCategories(const Hash* params, std::vector<std::string>& categories)
+{
+    if (const std::string* category = params->getString("Category"); category != nullptr)
+    {
+        categories.push_back(*category);
+        return;
+    }
+
+    const Value* value = params->getValue("Category");
+    if (value == nullptr)
+        return;
+
+    if (const ValueArray* array = value->getArray(); array != nullptr)
+    {
+        for (const auto& item : *array)
+        {
+            if (const std::string* category = item.getString(); category != nullptr)
+                categories.push_back(*category);
+        }
+    }
+}
+
+} // end unnamed namespace
+
+bool
+readDSCEntry(std::string_view objType, const Hash* params, DSOsDatEntry& entry)
+{
+    if (compareIgnoringCase(objType, "Galaxy") == 0)
+        entry.type = DSOsDatType::Galaxy;
+    else if (compareIgnoringCase(objType, "Globular") == 0)
+        entry.type = DSOsDatType::Globular;
+    else if (compareIgnoringCase(objType, "Nebula") == 0)
+        entry.type = DSOsDatType::Nebula;
+    else if (compareIgnoringCase(objType, "OpenCluster") == 0)
+        entry.type = DSOsDatType::OpenCluster;
+    else
+        return false;
+
+    // The common properties are read by DeepSkyObject::load; an open
+    // cluster has no others. Without a resource path the info URL is kept
+    // as it is.
+    OpenCluster common;
+    if (!common.load(params, fs::path()))
+        return false;
+
+    entry.flags = 0;
+    if (common.isVisible())
+        entry.flags |= DSOSDAT_VISIBLE;
+    if (common.isClickable())
+        entry.flags |= DSOSDAT_CLICKABLE;
+
+    entry.position = common.getPosition();
+    entry.orientation = common.getOrientation();
+    entry.radius = common.getRadius();
+    entry.absMag = common.getAbsoluteMagnitude();
+    entry.infoURL = common.getInfoURL();
+
+    switch (entry.type)
+    {
+    case DSOsDatType::Galaxy:
+        {
+            entry.detail = params->getNumber<float>("Detail").value_or(1.0f);
+
+            Galaxy galaxy;
+            const std::string* typeName = params->getString("Type");
+            galaxy.setType(typeName == nullptr ? std::string() : *typeName);
+            entry.galaxyType = static_cast<std::uint8_t>(galaxy.getGalaxyType());
+
+            if (const std::string* customTemplate = params->getString("CustomTemplate"); customTemplate != nullptr)
+                entry.customTemplate = *customTemplate;
+        }
+        break;
+
+    case DSOsDatType::Globular:
+        if (auto detail = params->getNumber<float>("Detail"); detail.has_value())
+        {
+            entry.flags |= DSOSDAT_HAS_DETAIL;
+            entry.detail = *detail;
+        }
+        if (auto coreRadius = params->getAngle<float>("CoreRadius", 1.0 / MINUTES_PER_DEG); coreRadius.has_value())
+        {
+            entry.flags |= DSOSDAT_HAS_CORE_RADIUS;
+            entry.coreRadius = *coreRadius;
+        }
+        if (auto king = params->getNumber<float>("KingConcentration"); king.has_value())
+        {
+            entry.flags |= DSOSDAT_HAS_KING_CONCENTRATION;
+            entry.kingConcentration = *king;
+        }
+        break;
+
+    case DSOsDatType::Nebula:
+        if (const std::string* mesh = params->getString("Mesh"); mesh != nullptr)
+            entry.mesh = *mesh;
+        break;
+
+    case DSOsDatType::OpenCluster:
+        break;
+    }
+
+    readCategories(params, entry.categories);
+    return true;
+}
+
+namespace
+{
+
+bool
+writeProperty(std::ostream& out, DSOsDatProperty tag, std::string_view value)
+{
+    return celutil::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(tag))
+        && celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(value.size()))
+        && out.write(value.data(), static_cast<std::streamsize>(value.size())).good();
+}
+
+template<typename F>
+void
+forEachProperty(const DSOsDatEntry& entry, F&& f)
+{
+    if (!entry.name.empty())
+        f(DSOsDatProperty::Name, entry.name);
+    if (!entry.infoURL.empty())
+        f(DSOsDatProperty::InfoURL, entry.infoURL);
+    if (!entry.customTemplate.empty())
+        f(DSOsDatProperty::CustomTemplate, entry.customTemplate);
+    if (!entry.mesh.empty())
+        f(DSOsDatProperty::Mesh, entry.mesh);
+    for (const std::string& category : entry.categories)
+        f(DSOsDatProperty::Category, category);
+}
+
+constexpr std::size_t PropertyHeaderSize = sizeof(std::uint8_t) + sizeof(std::uint32_t);
+
+std::size_t
+propertiesSize(const DSOsDatEntry& entry)
+{
+    std::size_t size = 0;
+    forEachProperty(entry,
+                    [&size](DSOsDatProperty, std::string_view value) { size += PropertyHeaderSize + value.size(); });
+    return size;
+}
+
+} // end unnamed namespace
+
+bool
+readDSCEntries(std::istream& in, std::vector<DSOsDatEntry>& entries)
+{
+    Tokenizer tokenizer(&in);
+    Parser    parser(&tokenizer);
+
+    while (tokenizer.nextToken() != Tokenizer::TokenEnd)
+    {
+        std::string objType;
+        if (auto tokenValue = tokenizer.getNameValue(); tokenValue.has_value())
+        {
+            objType = *tokenValue;
+        }
+        else
+        {
+            GetLogger()->error("Error parsing deep sky catalog file.\n");
+            return false;
+        }
+
+        tokenizer.nextToken();
+        DSOsDatEntry entry;
+        if (auto tokenValue = tokenizer.getStringValue(); tokenValue.has_value())
+        {
+            entry.name = *tokenValue;
+        }
+        else
+        {
+            GetLogger()->error("Error parsing deep sky catalog file: bad name.\n");
+            return false;
+        }
+
+        const Value objParamsValue = parser.readValue();
+        const Hash* objParams = objParamsValue.getHash();
+        if (objParams == nullptr)
+        {
+            GetLogger()->error("Error parsing deep sky catalog entry {}\n", entry.name);
+            return false;
+        }
+
+        if (!readDSCEntry(objType, objParams, entry))
+        {
+            GetLogger()->warn("Bad Deep Sky Object definition--will continue parsing file.\n");
+            return false;
+        }
+
+        entries.push_back(std::move(entry));
+    }
+
+    return true;
+}
+
+bool
+writeDSOsDat(std::ostream& out, const std::vector<DSOsDatEntry>& entries)
+{
+    if (entries.size() > std::numeric_limits<std::uint32_t>::max())
+        return false;
+
+    std::size_t totalSize = 0;
+    for (const DSOsDatEntry& entry : entries)
+        totalSize += propertiesSize(entry);
+    if (totalSize > std::numeric_limits<std::uint32_t>::max())
+        return false;
+
+    if (!out.write(DSOSDAT_MAGIC.data(), DSOSDAT_MAGIC.size()).good()
+        || !celutil::writeLE<std::uint16_t>(out, DSOSDAT_VERSION)
+        || !celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(entries.size()))
+        || !celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(totalSize)))
+    {
+        return false;
+    }
+
+    std::uint32_t offset = 0;
+    for (const DSOsDatEntry& entry : entries)
+    {
+        auto size = static_cast<std::uint32_t>(propertiesSize(entry));
+        bool ok = celutil::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(entry.type))
+            && celutil::writeLE<std::uint8_t>(out, entry.flags)
+            && celutil::writeLE<std::uint8_t>(out, entry.galaxyType)
+            && celutil::writeLE<std::uint8_t>(out, 0)
+            && celutil::writeLE<double>(out, entry.position.x())
+            && celutil::writeLE<double>(out, entry.position.y())
+            && celutil::writeLE<double>(out, entry.position.z())
+            && celutil::writeLE<float>(out, entry.orientation.x())
+            && celutil::writeLE<float>(out, entry.orientation.y())
+            && celutil::writeLE<float>(out, entry.orientation.z())
+            && celutil::writeLE<float>(out, entry.orientation.w())
+            && celutil::writeLE<float>(out, entry.radius)
+            && celutil::writeLE<float>(out, entry.absMag)
+            && celutil::writeLE<float>(out, entry.detail)
+            && celutil::writeLE<float>(out, entry.coreRadius)
+            && celutil::writeLE<float>(out, entry.kingConcentration)
+            && celutil::writeLE<std::uint32_t>(out, offset)
+            && celutil::writeLE<std::uint32_t>(out, size);
+        if (!ok)
+            return false;
+
+        offset += size;
+    }
+
+    bool ok = true;
+    for (const DSOsDatEntry& entry : entries)
+    {
+        forEachProperty(entry,
+                        [&](DSOsDatProperty tag, std::string_view value) { ok = ok && writeProperty(out, tag, value); });
+    }
+
+    return ok;
+}
+
+bool
+unpackDSOsDatEntry(const char* ptr, std::string_view properties, DSOsDatEntry& entry)
+{
+    auto objType = readRecordField<std::uint8_t>(ptr, offsetof(DSOsDatRecord, objType));
+    if (objType > static_cast<std::uint8_t>(DSOsDatType::OpenCluster))
+        return false;
+    entry.type = static_cast<DSOsDatType>(objType);
+    entry.flags = readRecordField<std::uint8_t>(ptr, offsetof(DSOsDatRecord, flags));
+    entry.galaxyType = readRecordField<std::uint8_t>(ptr, offsetof(DSOsDatRecord, galaxyType));
+    if (entry.galaxyType > static_cast<std::uint8_t>(GalaxyType::E7))
+        return false;
+
+    auto x = readRecordField<double>(ptr, offsetof(DSOsDatRecord, x));
+    LE_TO_CPU_DOUBLE(x, x);
+    auto y = readRecordField<double>(ptr, offsetof(DSOsDatRecord, y));
+    LE_TO_CPU_DOUBLE(y, y);
+    auto z = readRecordField<double>(ptr, offsetof(DSOsDatRecord, z));
+    LE_TO_CPU_DOUBLE(z, z);
+    entry.position = Eigen::Vector3d(x, y, z);
+
+    auto readFloat = [ptr](std::size_t offset)
+    {
+        auto value = readRecordField<float>(ptr, offset);
+        LE_TO_CPU_FLOAT(value, value);
+        return value;
+    };
+
+    entry.orientation = Eigen::Quaternionf(readFloat(offsetof(DSOsDatRecord, orientationW)),
+                                           readFloat(offsetof(DSOsDatRecord, orientationX)),
+                                           readFloat(offsetof(DSOsDatRecord, orientationY)),
+                                           readFloat(offsetof(DSOsDatRecord, orientationZ)));
+    entry.radius = readFloat(offsetof(DSOsDatRecord, radius));
+    entry.absMag = readFloat(offsetof(DSOsDatRecord, absMag));
+    entry.detail = readFloat(offsetof(DSOsDatRecord, detail));
+    entry.coreRadius = readFloat(offsetof(DSOsDatRecord, coreRadius));
+    entry.kingConcentration = readFloat(offsetof(DSOsDatRecord, kingConcentration));
+
+    auto offset = readRecordField<std::uint32_t>(ptr, offsetof(DSOsDatRecord, propertiesOffset));
+    LE_TO_CPU_INT32(offset, offset);
+    auto size = readRecordField<std::uint32_t>(ptr, offsetof(DSOsDatRecord, propertiesSize));
+    LE_TO_CPU_INT32(size, size);
+    if (offset > properties.size() || size > properties.size() - offset)
+        return false;
+
+    entry.name.clear();
+    entry.infoURL.clear();
+    entry.customTemplate.clear();
+    entry.mesh.clear();
+    entry.categories.clear();
+
+    std::string_view remaining = properties.substr(offset, size);
+    while (!remaining.empty())
+    {
+        if (remaining.size() < PropertyHeaderSize)
+            return false;
+
+        auto tag = readRecordField<std::uint8_t>(remaining.data(), 0);
+        auto length = readRecordField<std::uint32_t>(remaining.data(), sizeof(std::uint8_t));
+        LE_TO_CPU_INT32(length, length);
+        remaining.remove_prefix(PropertyHeaderSize);
+        if (length > remaining.size())
+            return false;
+
+        std::string_view value = remaining.substr(0, length);
+        remaining.remove_prefix(length);
+        switch (static_cast<DSOsDatProperty>(tag))
+        {
+        case DSOsDatProperty::Name:
+            entry.name = value;
+            break;
+        case DSOsDatProperty::InfoURL:
+            entry.infoURL = value;
+            break;
+        case DSOsDatProperty::CustomTemplate:
+            entry.customTemplate = value;
+            break;
+        case DSOsDatProperty::Mesh:
+            entry.mesh = value;
+            break;
+        case DSOsDatProperty::Category:
+            entry.categories.emplace_back(value);
+            break;
+        default:
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+readDSOsDat(std::istream& in, std::vector<DSOsDatEntry>& entries)
+{
+    std::uint32_t nDSOsInFile = 0;
+    std::uint32_t propertiesSize = 0;
+    {
+        std::array<char, sizeof(DSOsDatHeader)> header;
+        if (!in.read(header.data(), header.size()).good())
+            return false;
+
+        if (std::string_view(header.data() + offsetof(DSOsDatHeader, magic), DSOSDAT_MAGIC.size()) != DSOSDAT_MAGIC)
+            return false;
+
+        auto version = readRecordField<std::uint16_t>(header.data(), offsetof(DSOsDatHeader, version));
+        LE_TO_CPU_INT16(version, version);
+        if (version != DSOSDAT_VERSION)
+            return false;
+
+        nDSOsInFile = readRecordField<std::uint32_t>(header.data(), offsetof(DSOsDatHeader, counter));
+        LE_TO_CPU_INT32(nDSOsInFile, nDSOsInFile);
+        propertiesSize = readRecordField<std::uint32_t>(header.data(), offsetof(DSOsDatHeader, propertiesSize));
+        LE_TO_CPU_INT32(propertiesSize, propertiesSize);
+    }
+
+    std::vector<char> records(static_cast<std::size_t>(nDSOsInFile) * sizeof(DSOsDatRecord));
+    std::string properties(propertiesSize, '\0');
+    if (!in.read(records.data(), static_cast<std::streamsize>(records.size())).good()
+        || !in.read(properties.data(), static_cast<std::streamsize>(properties.size())).good())
+    {
+        GetLogger()->error("Error reading deep sky catalog file: truncated file.\n");
+        return false;
+    }
+
+    entries.reserve(entries.size() + nDSOsInFile);
+    for (std::uint32_t i = 0; i < nDSOsInFile; ++i)
+    {
+        DSOsDatEntry& entry = entries.emplace_back();
+        if (!unpackDSOsDatEntry(records.data() + i * sizeof(DSOsDatRecord), properties, entry))
+        {
+            GetLogger()->error("Bad record {} in deep sky catalog file.\n", i);
+            entries.pop_back();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // end namespace celestia::engine
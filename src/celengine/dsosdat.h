@@ -0,0 +1,145 @@
+// dsosdat.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Record layout of the binary deep sky object database files.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+class AssociativeArray;
+
+namespace celestia::engine
+{
+
+constexpr inline std::string_view DSOSDAT_MAGIC = "CELDSOBJ";
+constexpr inline std::uint16_t DSOSDAT_VERSION = 0x0100;
+
+enum class DSOsDatType : std::uint8_t
+{
+    Galaxy      = 0,
+    Globular    = 1,
+    Nebula      = 2,
+    OpenCluster = 3,
+};
+
+// Record flags; the Has* flags mark optional properties which were given,
+// the others keep the object's defaults.
+enum DSOsDatFlags : std::uint8_t
+{
+    DSOSDAT_VISIBLE                = 0x01,
+    DSOSDAT_CLICKABLE              = 0x02,
+    DSOSDAT_HAS_DETAIL             = 0x04,
+    DSOSDAT_HAS_CORE_RADIUS        = 0x08,
+    DSOSDAT_HAS_KING_CONCENTRATION = 0x10,
+};
+
+// Tags of the string properties stored in the property blob after the
+// records. Each property is a tag byte followed by the string length as a
+// 32-bit integer and the string itself; a record refers to a contiguous
+// range of properties. Only the names are found on most objects.
+enum class DSOsDatProperty : std::uint8_t
+{
+    Name           = 1,
+    InfoURL        = 2,
+    CustomTemplate = 3,
+    Mesh           = 4,
+    Category       = 5,
+};
+
+#pragma pack(push, 1)
+// dsos.dat header structure; it is followed by the records and then by the
+// property blob.
+struct DSOsDatHeader
+{
+    DSOsDatHeader() = delete;
+    char magic[8];
+    std::uint16_t version;
+    std::uint32_t counter;
+    std::uint32_t propertiesSize;
+};
+
+static_assert(std::is_standard_layout_v<DSOsDatHeader>);
+
+// dsos.dat record structure, with the same units as the objects use:
+// light years and arcminutes for the globular core radius.
+struct DSOsDatRecord
+{
+    DSOsDatRecord() = delete;
+    std::uint8_t objType;
+    std::uint8_t flags;
+    std::uint8_t galaxyType;
+    std::uint8_t reserved;
+    double x;
+    double y;
+    double z;
+    float orientationX;
+    float orientationY;
+    float orientationZ;
+    float orientationW;
+    float radius;
+    float absMag;
+    float detail;
+    float coreRadius;
+    float kingConcentration;
+    std::uint32_t propertiesOffset;
+    std::uint32_t propertiesSize;
+};
+
+static_assert(std::is_standard_layout_v<DSOsDatRecord>);
+#pragma pack(pop)
+
+// The contents of a record along with its properties
+struct DSOsDatEntry
+{
+    DSOsDatType type{ DSOsDatType::OpenCluster };
+    std::uint8_t flags{ DSOSDAT_VISIBLE | DSOSDAT_CLICKABLE };
+    std::uint8_t galaxyType{ 0 };
+    Eigen::Vector3d position{ Eigen::Vector3d::Zero() };
+    Eigen::Quaternionf orientation{ Eigen::Quaternionf::Identity() };
+    float radius{ 1.0f };
+    float absMag{ 0.0f };
+    float detail{ 1.0f };
+    float coreRadius{ 0.0f };
+    float kingConcentration{ 0.0f };
+    std::string name;
+    std::string infoURL;
+    std::string customTemplate;
+    std::string mesh;
+    std::vector<std::string> categories;
+};
+
+// Parse a deep sky catalog (.dsc) file into entries, exactly as
+// DSODatabase::load would read the objects, but without creating them.
+// Relative URLs and paths are kept as they are.
+bool readDSCEntries(std::istream& in, std::vector<DSOsDatEntry>& entries);
+
+// Read the properties of one object of a deep sky catalog; objType is
+// Galaxy, Globular, Nebula or OpenCluster. Catalog generators use it to
+// build entries from the properties a catalog file would give.
+bool readDSCEntry(std::string_view objType, const AssociativeArray* params, DSOsDatEntry& entry);
+
+bool writeDSOsDat(std::ostream& out, const std::vector<DSOsDatEntry>& entries);
+
+// Decode the record at ptr, looking up its properties in the properties
+// blob. Returns false if the record is inconsistent.
+bool unpackDSOsDatEntry(const char* ptr, std::string_view properties, DSOsDatEntry& entry);
+
+// Read the whole of a binary deep sky database, appending its entries.
+bool readDSOsDat(std::istream& in, std::vector<DSOsDatEntry>& entries);
+
+} // end namespace celestia::engine
@@ -13,6 +13,7 @@
 #include <cassert>
 #include <celengine/star.h>
 #include <celengine/body.h>
+#include <celengine/bodystatecache.h>
 #include <celengine/deepskyobj.h>
 #include <celengine/location.h>
 #include <celengine/frame.h>
@@ -33,6 +34,58 @@ ReferenceFrame::ReferenceFrame(Selection center) :
 {
 }
 
+
+ReferenceFrame::~ReferenceFrame()
+{
+    GetBodyStateCache().clearIfOwner();
+}
+
+
+Quaterniond
+ReferenceFrame::getCachedOrientation(double tjd) const
+{
+    BodyStateCache& cache = GetBodyStateCache();
+    if (const auto* entry = cache.find(this, tjd);
+        entry != nullptr && (entry->flags & BodyStateCache::FrameOrientation) != 0)
+    {
+        return entry->orientation;
+    }
+
+    Quaterniond orientation = getOrientation(tjd);
+    if (auto* entry = cache.insert(this, tjd); entry != nullptr)
+    {
+        entry->orientation = orientation;
+        entry->flags |= BodyStateCache::FrameOrientation;
+    }
+
+    return orientation;
+}
+
+
+Vector3d
+ReferenceFrame::getAstrocentricOrigin(double tjd) const
+{
+    // Stars are the origin of astrocentric coordinates
+    if (centerObject.getType() != Selection::Type_Body)
+        return Vector3d::Zero();
+
+    BodyStateCache& cache = GetBodyStateCache();
+    if (const auto* entry = cache.find(this, tjd);
+        entry != nullptr && (entry->flags & BodyStateCache::FrameOrigin) != 0)
+    {
+        return entry->astrocentricPosition;
+    }
+
+    Vector3d origin = centerObject.body()->getAstrocentricPosition(tjd);
+    if (auto* entry = cache.insert(this, tjd); entry != nullptr)
+    {
+        entry->astrocentricPosition = origin;
+        entry->flags |= BodyStateCache::FrameOrigin;
+    }
+
+    return origin;
+}
+
 // High-precision rotation using 64.64 fixed point path. Rotate uc by
 // the rotation specified by unit quaternion q.
 static UniversalCoord rotate(const UniversalCoord& uc, const Quaterniond& q)
@@ -58,14 +111,14 @@ UniversalCoord
 ReferenceFrame::convertFromUniversal(const UniversalCoord& uc, double tjd) const
 {
     UniversalCoord uc1 = uc - centerObject.getPosition(tjd);
-    return rotate(uc1, getOrientation(tjd).conjugate());
+    return rotate(uc1, getCachedOrientation(tjd).conjugate());
 }
 
 
 Quaterniond
 ReferenceFrame::convertFromUniversal(const Quaterniond& q, double tjd) const
 {
-    return q * getOrientation(tjd).conjugate();
+    return q * getCachedOrientation(tjd).conjugate();
 }
 
 
@@ -83,28 +136,24 @@ ReferenceFrame::convertFromUniversal(const Quaterniond& q, double tjd) const
 UniversalCoord
 ReferenceFrame::convertToUniversal(const UniversalCoord& uc, double tjd) const
 {
-    return centerObject.getPosition(tjd) + rotate(uc, getOrientation(tjd));
+    return centerObject.getPosition(tjd) + rotate(uc, getCachedOrientation(tjd));
 }
 
 
 Quaterniond
 ReferenceFrame::convertToUniversal(const Quaterniond& q, double tjd) const
 {
-    return q * getOrientation(tjd);
+    return q * getCachedOrientation(tjd);
 }
 
 
 Vector3d
 ReferenceFrame::convertFromAstrocentric(const Vector3d& p, double tjd) const
 {
-    if (centerObject.getType() == Selection::Type_Body)
+    if (centerObject.getType() == Selection::Type_Body ||
+        centerObject.getType() == Selection::Type_Star)
     {
-        Vector3d center = centerObject.body()->getAstrocentricPosition(tjd);
-        return getOrientation(tjd) * (p - center);
-    }
-    else if (centerObject.getType() == Selection::Type_Star)
-    {
-        return getOrientation(tjd) * p;
+        return getCachedOrientation(tjd) * (p - getAstrocentricOrigin(tjd));
     }
     else
     {
@@ -119,14 +168,10 @@ ReferenceFrame::convertFromAstrocentric(const Vector3d& p, double tjd) const
 Vector3d
 ReferenceFrame::convertToAstrocentric(const Vector3d& p, double tjd) const
 {
-    if (centerObject.getType() == Selection::Type_Body)
-    {
-        Vector3d center = centerObject.body()->getAstrocentricPosition(tjd);
-        return center + getOrientation(tjd).conjugate() * p;
-    }
-    else if (centerObject.getType() == Selection::Type_Star)
+    if (centerObject.getType() == Selection::Type_Body ||
+        centerObject.getType() == Selection::Type_Star)
     {
-        return getOrientation(tjd).conjugate() * p;
+        return getAstrocentricOrigin(tjd) + getCachedOrientation(tjd).conjugate() * p;
     }
     else
     {
@@ -318,6 +363,13 @@ BodyFixedFrame::isInertial() const
 }
 
 
+bool
+BodyFixedFrame::isThreadSafe() const
+{
+    return IsOrientationThreadSafe(fixObject);
+}
+
+
 unsigned int
 BodyFixedFrame::nestingDepth(unsigned int depth,
                              unsigned int maxDepth,
@@ -422,6 +474,13 @@ BodyMeanEquatorFrame::isInertial() const
 }
 
 
+bool
+BodyMeanEquatorFrame::isThreadSafe() const
+{
+    return IsOrientationThreadSafe(equatorObject);
+}
+
+
 unsigned int
 BodyMeanEquatorFrame::nestingDepth(unsigned int depth,
                                    unsigned int maxDepth,
@@ -444,12 +503,7 @@ BodyMeanEquatorFrame::nestingDepth(unsigned int depth,
 /*** CachingFrame ***/
 
 CachingFrame::CachingFrame(Selection _center) :
-    ReferenceFrame(_center),
-    lastTime(-1.0e50),
-    lastOrientation(Quaterniond::Identity()),
-    lastAngularVelocity(0.0, 0.0, 0.0),
-    orientationCacheValid(false),
-    angularVelocityCacheValid(false)
+    ReferenceFrame(_center)
 {
 }
 
@@ -457,39 +511,31 @@ CachingFrame::CachingFrame(Selection _center) :
 Quaterniond
 CachingFrame::getOrientation(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastOrientation = computeOrientation(tjd);
-        orientationCacheValid = true;
-        angularVelocityCacheValid = false;
-    }
-    else if (!orientationCacheValid)
-    {
-        lastOrientation = computeOrientation(tjd);
-        orientationCacheValid = true;
-    }
+    auto& context = celestia::ephem::EvaluationContext::current();
+    if (const auto* state = context.findOrientation(cacheId, tjd); state != nullptr && state->orientationValid)
+        return state->orientation;
 
-    return lastOrientation;
+    // computeOrientation evaluates other objects, which may replace the
+    // entry, so it's only looked up once the orientation is known.
+    Quaterniond orientation = computeOrientation(tjd);
+    auto& state = context.insertOrientation(cacheId, tjd);
+    state.orientation = orientation;
+    state.orientationValid = true;
+    return orientation;
 }
 
 
 Vector3d CachingFrame::getAngularVelocity(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        orientationCacheValid = false;
-        angularVelocityCacheValid = true;
-    }
-    else if (!angularVelocityCacheValid)
-    {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        angularVelocityCacheValid = true;
-    }
+    auto& context = celestia::ephem::EvaluationContext::current();
+    if (const auto* state = context.findOrientation(cacheId, tjd); state != nullptr && state->angularVelocityValid)
+        return state->angularVelocity;
 
-    return lastAngularVelocity;
+    Vector3d angularVelocity = computeAngularVelocity(tjd);
+    auto& state = context.insertOrientation(cacheId, tjd);
+    state.angularVelocity = angularVelocity;
+    state.angularVelocityValid = true;
+    return angularVelocity;
 }
 
 
@@ -639,6 +685,13 @@ TwoVectorFrame::isInertial() const
 }
 
 
+bool
+TwoVectorFrame::isThreadSafe() const
+{
+    return primaryVector.isThreadSafe() && secondaryVector.isThreadSafe();
+}
+
+
 unsigned int
 TwoVectorFrame::nestingDepth(unsigned int depth,
                              unsigned int maxDepth,
@@ -768,6 +821,22 @@ FrameVector::direction(double tjd) const
 }
 
 
+bool
+FrameVector::isThreadSafe() const
+{
+    switch (vecType)
+    {
+    case RelativePosition:
+    case RelativeVelocity:
+        return IsPositionThreadSafe(observer) && IsPositionThreadSafe(target);
+    case ConstantVector:
+        return frame == nullptr || frame->isThreadSafe();
+    default:
+        return true;
+    }
+}
+
+
 unsigned int
 FrameVector::nestingDepth(unsigned int depth,
                           unsigned int maxDepth) const
@@ -801,3 +870,48 @@ FrameVector::nestingDepth(unsigned int depth,
         return depth;
     }
 }
+
+
+bool
+IsPositionThreadSafe(const Selection& object)
+{
+    switch (object.getType())
+    {
+    case Selection::Type_Star:
+        for (const Star* star = object.star(); star != nullptr; star = star->getOrbitBarycenter())
+        {
+            if (star->getOrbit() == nullptr)
+                return true;
+            if (!star->getOrbit()->isThreadSafe())
+                return false;
+        }
+        return true;
+    case Selection::Type_Body:
+        return object.body()->isPositionThreadSafe();
+    case Selection::Type_Location:
+        if (const Body* body = object.location()->getParentBody(); body != nullptr)
+            return body->isPositionThreadSafe() && body->isOrientationThreadSafe();
+        return true;
+    default:
+        return true;
+    }
+}
+
+
+bool
+IsOrientationThreadSafe(const Selection& object)
+{
+    switch (object.getType())
+    {
+    case Selection::Type_Star:
+        return object.star()->getRotationModel()->isThreadSafe();
+    case Selection::Type_Body:
+        return object.body()->isOrientationThreadSafe();
+    case Selection::Type_Location:
+        if (const Body* body = object.location()->getParentBody(); body != nullptr)
+            return body->isOrientationThreadSafe();
+        return true;
+    default:
+        return true;
+    }
+}
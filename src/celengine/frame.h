@@ -13,6 +13,7 @@
 
 #include <celengine/astro.h>
 #include <celengine/selection.h>
+#include <celephem/evalcontext.h>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include "shared.h"
@@ -29,7 +30,7 @@ class ReferenceFrame
     SHARED_TYPES(ReferenceFrame)
 
     ReferenceFrame(Selection center);
-    virtual ~ReferenceFrame() {};
+    virtual ~ReferenceFrame();
 
     UniversalCoord convertFromUniversal(const UniversalCoord& uc, double tjd) const;
     UniversalCoord convertToUniversal(const UniversalCoord& uc, double tjd) const;
@@ -44,8 +45,17 @@ class ReferenceFrame
     virtual Eigen::Quaterniond getOrientation(double tjd) const = 0;
     virtual Eigen::Vector3d getAngularVelocity(double tdb) const;
 
+    // Same as getOrientation(), memoized in the body state cache until the
+    // time changes. The conversions use it, so converting through a chain
+    // of frames costs a lookup for each frame once it has been evaluated.
+    Eigen::Quaterniond getCachedOrientation(double tjd) const;
+
     virtual bool isInertial() const = 0;
 
+    // Return true if getOrientation() may be called from several threads
+    // at once, i.e. the objects and models it depends on are thread safe.
+    virtual bool isThreadSafe() const { return false; }
+
     enum FrameType
     {
         PositionFrame = 1,
@@ -59,12 +69,16 @@ class ReferenceFrame
                                       FrameType frameType) const = 0;
 
  private:
+    // The astrocentric position of the center, memoized with the orientation
+    Eigen::Vector3d getAstrocentricOrigin(double tjd) const;
+
     Selection centerObject;
 };
 
 
 /*! Base class for complex frames where there may be some benefit
- *  to caching the last calculated orientation.
+ *  to caching the last calculated orientation. The cache is kept in the
+ *  evaluation context of each thread.
  */
 class CachingFrame : public ReferenceFrame
 {
@@ -80,11 +94,7 @@ class CachingFrame : public ReferenceFrame
     virtual Eigen::Vector3d computeAngularVelocity(double tjd) const;
 
  private:
-    mutable double lastTime;
-    mutable Eigen::Quaterniond lastOrientation;
-    mutable Eigen::Vector3d lastAngularVelocity;
-    mutable bool orientationCacheValid;
-    mutable bool angularVelocityCacheValid;
+    celestia::ephem::CacheId cacheId;
 };
 
 
@@ -103,6 +113,7 @@ class J2000EclipticFrame : public ReferenceFrame
     }
 
     virtual bool isInertial() const;
+    bool isThreadSafe() const override { return true; }
 
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
@@ -120,6 +131,7 @@ class J2000EquatorFrame : public ReferenceFrame
     virtual ~J2000EquatorFrame() {};
     Eigen::Quaterniond getOrientation(double tjd) const;
     virtual bool isInertial() const;
+    bool isThreadSafe() const override { return true; }
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
                                       FrameType frameType) const;
@@ -142,6 +154,7 @@ class BodyFixedFrame : public ReferenceFrame
     Eigen::Quaterniond getOrientation(double tjd) const;
     virtual Eigen::Vector3d getAngularVelocity(double tjd) const;
     virtual bool isInertial() const;
+    bool isThreadSafe() const override;
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
                                       FrameType frameType) const;
@@ -162,6 +175,7 @@ class BodyMeanEquatorFrame : public ReferenceFrame
     Eigen::Quaterniond getOrientation(double tjd) const;
     virtual Eigen::Vector3d getAngularVelocity(double tjd) const;
     virtual bool isInertial() const;
+    bool isThreadSafe() const override;
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
                                       FrameType frameType) const;
@@ -184,6 +198,8 @@ class FrameVector
 
     Eigen::Vector3d direction(double tjd) const;
 
+    bool isThreadSafe() const;
+
     /*! Frames can be defined in reference to other frames; this method
      *  counts the depth of such nesting, up to some specified maximum
      *  level. This method is used to test for circular references in
@@ -242,6 +258,7 @@ class TwoVectorFrame : public CachingFrame
 
     Eigen::Quaterniond computeOrientation(double tjd) const;
     virtual bool isInertial() const;
+    bool isThreadSafe() const override;
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
                                       FrameType frameType) const;
@@ -257,4 +274,10 @@ class TwoVectorFrame : public CachingFrame
     int tertiaryAxis;
 };
 
+
+// Return true if the position, or the orientation, of the object may be
+// computed from several threads at once.
+bool IsPositionThreadSafe(const Selection& object);
+bool IsOrientationThreadSafe(const Selection& object);
+
 #endif // _CELENGINE_FRAME_H_
@@ -8,8 +8,17 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <celrender/texturememory.h>
 #include "framebuffer.h"
 
+using celestia::render::TextureMemoryCategory;
+
+namespace
+{
+// Drivers store both RGB8 color and depth textures in four bytes per texel
+constexpr std::size_t BytesPerTexel = 4;
+}
+
 FramebufferObject::FramebufferObject(GLuint width, GLuint height, unsigned int attachments) :
     m_width(width),
     m_height(height),
@@ -30,23 +39,33 @@ FramebufferObject::FramebufferObject(FramebufferObject &&other) :
     m_colorTexId(other.m_colorTexId),
     m_depthTexId(other.m_depthTexId),
     m_fboId(other.m_fboId),
-    m_status(other.m_status)
+    m_status(other.m_status),
+    m_memorySize(other.m_memorySize)
 {
-    other.m_fboId  = 0;
-    other.m_status = GL_FRAMEBUFFER_UNSUPPORTED;
+    other.m_colorTexId = 0;
+    other.m_depthTexId = 0;
+    other.m_fboId      = 0;
+    other.m_status     = GL_FRAMEBUFFER_UNSUPPORTED;
+    other.m_memorySize = 0;
 }
 
 FramebufferObject& FramebufferObject::operator=(FramebufferObject &&other)
 {
+    cleanup();
+
     m_width        = other.m_width;
     m_height       = other.m_height;
     m_colorTexId   = other.m_colorTexId;
     m_depthTexId   = other.m_depthTexId;
     m_fboId        = other.m_fboId;
     m_status       = other.m_status;
+    m_memorySize   = other.m_memorySize;
 
-    other.m_fboId  = 0;
-    other.m_status = GL_FRAMEBUFFER_UNSUPPORTED;
+    other.m_colorTexId = 0;
+    other.m_depthTexId = 0;
+    other.m_fboId      = 0;
+    other.m_status     = GL_FRAMEBUFFER_UNSUPPORTED;
+    other.m_memorySize = 0;
     return *this;
 }
 
@@ -94,6 +113,7 @@ FramebufferObject::generateColorTexture()
 #else
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, m_width, m_height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
 #endif
+    addMemory(static_cast<std::size_t>(m_width) * m_height * BytesPerTexel);
 
     // Unbind the texture
     glBindTexture(GL_TEXTURE_2D, 0);
@@ -130,6 +150,7 @@ FramebufferObject::generateDepthTexture()
     // Do we need to set GL_DEPTH_COMPONENT24 here?
 
     glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, m_width, m_height, 0, GL_DEPTH_COMPONENT, CEL_DEPTH_FORMAT, nullptr);
+    addMemory(static_cast<std::size_t>(m_width) * m_height * BytesPerTexel);
 
     // Unbind the texture
     glBindTexture(GL_TEXTURE_2D, 0);
@@ -196,17 +217,30 @@ FramebufferObject::cleanup()
     if (m_fboId != 0)
     {
         glDeleteFramebuffers(1, &m_fboId);
+        m_fboId = 0;
     }
 
     if (m_colorTexId != 0)
     {
         glDeleteTextures(1, &m_colorTexId);
+        m_colorTexId = 0;
     }
 
     if (m_depthTexId != 0)
     {
         glDeleteTextures(1, &m_depthTexId);
+        m_depthTexId = 0;
     }
+
+    celestia::render::removeTextureMemory(TextureMemoryCategory::Framebuffers, m_memorySize);
+    m_memorySize = 0;
+}
+
+void
+FramebufferObject::addMemory(std::size_t size)
+{
+    m_memorySize += size;
+    celestia::render::addTextureMemory(TextureMemoryCategory::Framebuffers, size);
 }
 
 bool
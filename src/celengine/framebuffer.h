@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <cstddef>
+
 #include "glsupport.h"
 
 class FramebufferObject
@@ -51,6 +53,7 @@ class FramebufferObject
     void generateDepthTexture();
     void generateFbo(unsigned int attachments);
     void cleanup();
+    void addMemory(std::size_t);
 
  private:
     GLuint m_width;
@@ -59,6 +62,7 @@ class FramebufferObject
     GLuint m_depthTexId;
     GLuint m_fboId;
     GLenum m_status;
+    std::size_t m_memorySize{ 0 };
 };
 
 bool FramebufferObject::isSupported()
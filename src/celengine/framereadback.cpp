@@ -0,0 +1,150 @@
+// framereadback.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Reading back rendered frames without waiting for the GPU.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "framereadback.h"
+
+#include <cassert>
+
+using celestia::PixelFormat;
+
+namespace gl = celestia::gl;
+
+namespace
+{
+
+int
+bytesPerPixel(PixelFormat format)
+{
+    return format == PixelFormat::RGB
+#ifndef GL_ES
+           || format == PixelFormat::BGR
+#endif
+           ? 3 : 4;
+}
+
+} // end unnamed namespace
+
+
+FrameReadback::FrameReadback(int width, int height, PixelFormat format, std::size_t ringSize) :
+    m_width(width),
+    m_height(height),
+    m_format(format),
+    // Rows are aligned to GL_PACK_ALIGNMENT, which is left at four
+    m_rowSize(((width * bytesPerPixel(format)) + 3) & ~3)
+{
+    if (!isSupported() || ringSize == 0)
+        return;
+
+    m_buffers.resize(ringSize);
+    glGenBuffers(static_cast<GLsizei>(m_buffers.size()), m_buffers.data());
+    for (GLuint buffer : m_buffers)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, m_rowSize * height, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (glGetError() != GL_NO_ERROR)
+    {
+        glDeleteBuffers(static_cast<GLsizei>(m_buffers.size()), m_buffers.data());
+        m_buffers.clear();
+    }
+}
+
+
+FrameReadback::~FrameReadback()
+{
+    if (!isValid())
+        return;
+
+    while (m_mapped > 0)
+        release();
+    glDeleteBuffers(static_cast<GLsizei>(m_buffers.size()), m_buffers.data());
+}
+
+
+bool
+FrameReadback::isSupported()
+{
+#ifdef GL_ES
+    return gl::checkVersion(gl::GLES_3_0);
+#else
+    // Pixel buffer objects are part of OpenGL 2.1
+    return true;
+#endif
+}
+
+
+bool
+FrameReadback::read(int x, int y)
+{
+    assert(isValid() && !isFull());
+
+    std::size_t index = (m_first + m_pending) % m_buffers.size();
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffers[index]);
+    glReadPixels(x, y, m_width, m_height, static_cast<GLenum>(m_format), GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (glGetError() != GL_NO_ERROR)
+        return false;
+
+    ++m_pending;
+    return true;
+}
+
+
+const unsigned char*
+FrameReadback::map(std::ptrdiff_t& stride)
+{
+    assert(isValid() && m_mapped < m_pending);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffers[(m_first + m_mapped) % m_buffers.size()]);
+#ifdef GL_ES
+    void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, m_rowSize * m_height, GL_MAP_READ_BIT);
+#else
+    void* data = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+#endif
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (data == nullptr)
+        return nullptr;
+
+    ++m_mapped;
+    auto* rows = static_cast<const unsigned char*>(data);
+
+#ifndef GL_ES
+    // The renderer enables the extension whenever it's available
+    if (gl::MESA_pack_invert)
+    {
+        stride = m_rowSize;
+        return rows;
+    }
+#endif
+
+    stride = -m_rowSize;
+    return rows + m_rowSize * (m_height - 1);
+}
+
+
+void
+FrameReadback::release()
+{
+    assert(m_pending > 0);
+
+    if (m_mapped > 0)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffers[m_first]);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        --m_mapped;
+    }
+
+    m_first = (m_first + 1) % m_buffers.size();
+    --m_pending;
+}
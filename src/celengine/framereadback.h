@@ -0,0 +1,75 @@
+// framereadback.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Reading back rendered frames without waiting for the GPU.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "glsupport.h"
+#include "pixelformat.h"
+
+/*! Reads back frames through a ring of pixel pack buffers. Reading a frame
+ *  into a buffer only queues the transfer; if the buffer is mapped after a
+ *  few more frames have been queued, the GPU has finished with it by then,
+ *  so the caller doesn't wait for the frame to be rendered. Frames are
+ *  mapped and released in the order they were read, and several can be
+ *  mapped at once, e.g. while they're being encoded on another thread.
+ *
+ *  The rows of a mapped frame are in the order GL returns them: bottom to
+ *  top, unless MESA_pack_invert is enabled. Instead of flipping them, the
+ *  caller is given the address of the top row and a stride, which is
+ *  negative for rows stored bottom up.
+ */
+class FrameReadback
+{
+ public:
+    static constexpr std::size_t DefaultRingSize = 3;
+
+    FrameReadback(int width, int height, celestia::PixelFormat format,
+                  std::size_t ringSize = DefaultRingSize);
+    ~FrameReadback();
+
+    FrameReadback(const FrameReadback&) = delete;
+    FrameReadback& operator=(const FrameReadback&) = delete;
+
+    static bool isSupported();
+    bool isValid() const { return !m_buffers.empty(); }
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+    // Queue a read of the frame with its lower left corner at (x, y). The
+    // ring must not be full.
+    bool read(int x, int y);
+
+    // Number of frames read and not yet released, and how many of them are
+    // mapped
+    std::size_t pending() const { return m_pending; }
+    std::size_t mapped() const { return m_mapped; }
+    bool isFull() const { return m_pending == m_buffers.size(); }
+
+    // Map the oldest frame not mapped yet, returning the address of its top
+    // row, or nullptr on failure. The frame must be released after use.
+    const unsigned char* map(std::ptrdiff_t& stride);
+    // Release the oldest frame, unmapping it if it's mapped.
+    void release();
+
+ private:
+    int m_width;
+    int m_height;
+    celestia::PixelFormat m_format;
+    std::ptrdiff_t m_rowSize;
+    std::vector<GLuint> m_buffers;
+    std::size_t m_first{ 0 };
+    std::size_t m_pending{ 0 };
+    std::size_t m_mapped{ 0 };
+};
@@ -39,6 +39,13 @@
  * objects themselves. Change tracking is performed whenever the frame tree
  * is modified: adding a node, removing a node, or changing the radius of an
  * object will all cause the tree to be marked as changed.
+ *
+ * The bounds are kept up to date incrementally, so that a change to one body
+ * of a system with many thousands doesn't scan all of them. Adding a child
+ * or changing one grows the bounds at once; only the trees of the changed
+ * children are computed again. The bounds don't shrink until an exact
+ * recomputation, which is done after loading a catalog, or until a child is
+ * removed.
  */
 
 using namespace std;
@@ -61,7 +68,8 @@ FrameTree::FrameTree(Star* star) :
 FrameTree::FrameTree(Body* body) :
     starParent(nullptr),
     bodyParent(body),
-    m_changed(true),
+    // Marked changed by its first child, so that the parent tree learns it
+    m_changed(false),
     // Default frame for a solar system body is the mean equatorial frame of the body.
     defaultFrame(new BodyMeanEquatorFrame(Selection(body), Selection(body)))
 {
@@ -79,10 +87,35 @@ FrameTree::getDefaultReferenceFrame() const
 
 
 /*! Mark this node of the frame hierarchy as changed. The changed flag
- *  is propagated up toward the root of the tree.
+ *  is propagated up toward the root of the tree. All children are scanned
+ *  when the bounding sphere is next computed.
  */
 void
 FrameTree::markChanged()
+{
+    m_rescan = true;
+    changedChildren.clear();
+    propagateChange();
+}
+
+
+/*! Mark a child of this node as changed, either its body or its own tree.
+ */
+void
+FrameTree::markChanged(const TimelinePhase& phase)
+{
+    if (!m_rescan)
+    {
+        growBounds(phase);
+        changedChildren.push_back(&phase);
+        m_loose = true;
+    }
+    propagateChange();
+}
+
+
+void
+FrameTree::propagateChange()
 {
     if (!m_changed)
     {
@@ -93,6 +126,45 @@ FrameTree::markChanged()
 }
 
 
+/*! Grow the bounds of this tree to those of a child and its tree.
+ */
+void
+FrameTree::growBounds(const TimelinePhase& phase)
+{
+    const Body* body = phase.body();
+    double r = body->getCullingRadius() + phase.orbit()->getBoundingRadius();
+    m_maxChildRadius = max(m_maxChildRadius, static_cast<double>(body->getRadius()));
+    m_containsSecondaryIlluminators = m_containsSecondaryIlluminators || body->isSecondaryIlluminator();
+    m_childClassMask |= body->getClassification();
+
+    if (const FrameTree* tree = body->getFrameTree(); tree != nullptr)
+    {
+        r += tree->m_boundingSphereRadius;
+        m_maxChildRadius = max(m_maxChildRadius, tree->m_maxChildRadius);
+        m_containsSecondaryIlluminators = m_containsSecondaryIlluminators || tree->containsSecondaryIlluminators();
+        m_childClassMask |= tree->childClassMask();
+    }
+
+    m_threadSafe = m_threadSafe && isThreadSafe(phase);
+    m_boundingSphereRadius = max(m_boundingSphereRadius, r);
+}
+
+
+/*! Add a child to the bounds and counts of this tree.
+ */
+void
+FrameTree::addChildBounds(unsigned int child)
+{
+    const TimelinePhase& phase = *children[child];
+    ++m_bodyCount;
+    if (MinorBodyBVH::isMinorBody(*this, child))
+        ++m_minorBodyCount;
+    if (const FrameTree* tree = phase.body()->getFrameTree(); tree != nullptr)
+        m_bodyCount += tree->m_bodyCount;
+    growBounds(phase);
+}
+
+
 /*! Mark this node of the frame hierarchy as updated. The changed flag
  *  is marked false in this node and in all child nodes that
  *  were marked changed.
@@ -113,39 +185,66 @@ FrameTree::markUpdated()
  *  as having changed. The bounding sphere is large enough to accommodate
  *  the orbits (and radii) of all child bodies. This method also recomputes
  *  the maximum child radius, secondary illuminator status, and child
- *  class mask.
+ *  class mask. Unless exact is true, only the trees of the changed children
+ *  are computed again, and the bounds may be larger than needed.
  */
 void
-FrameTree::recomputeBoundingSphere()
+FrameTree::recomputeBoundingSphere(bool exact)
 {
-    if (m_changed)
+    if (!m_changed && !(exact && m_loose))
+        return;
+
+    if (m_rescan || (exact && m_loose))
     {
         m_boundingSphereRadius = 0.0;
         m_maxChildRadius = 0.0;
         m_containsSecondaryIlluminators = false;
         m_childClassMask = 0;
+        m_bodyCount = 0;
+        m_minorBodyCount = 0;
+        m_threadSafe = true;
+
+        for (unsigned int i = 0; i < children.size(); i++)
+        {
+            if (FrameTree* tree = children[i]->body()->getFrameTree(); tree != nullptr)
+                tree->recomputeBoundingSphere(exact);
+            addChildBounds(i);
+        }
 
-        for (const auto &phase : children)
+        m_rescan = false;
+        m_loose = false;
+    }
+    else
+    {
+        for (const TimelinePhase* phase : changedChildren)
         {
-            double bodyRadius = phase->body()->getRadius();
-            double r = phase->body()->getCullingRadius() + phase->orbit()->getBoundingRadius();
-            m_maxChildRadius = max(m_maxChildRadius, bodyRadius);
-            m_containsSecondaryIlluminators = m_containsSecondaryIlluminators || phase->body()->isSecondaryIlluminator();
-            m_childClassMask |= phase->body()->getClassification();
-
-            FrameTree* tree = phase->body()->getFrameTree();
-            if (tree != nullptr)
+            if (FrameTree* tree = phase->body()->getFrameTree(); tree != nullptr)
             {
-                tree->recomputeBoundingSphere();
-                r += tree->m_boundingSphereRadius;
-                m_maxChildRadius = max(m_maxChildRadius, tree->m_maxChildRadius);
-                m_containsSecondaryIlluminators = m_containsSecondaryIlluminators || tree->containsSecondaryIlluminators();
-                m_childClassMask |= tree->childClassMask();
+                unsigned int bodyCount = tree->m_bodyCount;
+                tree->recomputeBoundingSphere(exact);
+                m_bodyCount += tree->m_bodyCount - bodyCount;
             }
-
-            m_boundingSphereRadius = max(m_boundingSphereRadius, r);
+            growBounds(*phase);
         }
     }
+    changedChildren.clear();
+    m_changed = false;
+
+    if (m_minorBodyCount < MinorBodyBVH::MinBodies)
+        m_minorBodies = nullptr;
+    else if (m_minorBodies == nullptr)
+        m_minorBodies = std::make_unique<MinorBodyBVH>();
+}
+
+
+bool
+FrameTree::isThreadSafe(const TimelinePhase& phase)
+{
+    if (!phase.orbit()->isThreadSafe() || !phase.orbitFrame()->isThreadSafe())
+        return false;
+
+    const FrameTree* tree = phase.body()->getFrameTree();
+    return tree == nullptr || tree->isThreadSafe();
 }
 
 
@@ -155,7 +254,9 @@ void
 FrameTree::addChild(const TimelinePhase::SharedConstPtr &phase)
 {
     children.push_back(phase);
-    markChanged();
+    if (!m_rescan)
+        addChildBounds(static_cast<unsigned int>(children.size() - 1));
+    propagateChange();
 }
 
 
@@ -17,6 +17,7 @@
 #include <vector>
 #include <cstddef>
 #include "frame.h"
+#include "minorbodybvh.h"
 #include "timelinephase.h"
 
 class Star;
@@ -45,8 +46,9 @@ public:
     unsigned int childCount() const;
 
     void markChanged();
+    void markChanged(const TimelinePhase& phase);
     void markUpdated();
-    void recomputeBoundingSphere();
+    void recomputeBoundingSphere(bool exact = false);
 
     bool isRoot() const
     {
@@ -89,16 +91,61 @@ public:
         return m_childClassMask;
     }
 
+    /*! Return the number of bodies in the tree, including those in
+     *  the trees of its children.
+     */
+    unsigned int bodyCount() const
+    {
+        return m_bodyCount;
+    }
+
+    /*! Return whether the positions of all bodies in the tree can be
+     *  computed from several threads at once.
+     */
+    bool isThreadSafe() const
+    {
+        return m_threadSafe;
+    }
+
+    /*! Return whether the position of the body of this phase, and of
+     *  all bodies in its tree, can be computed from several threads at
+     *  once.
+     */
+    static bool isThreadSafe(const TimelinePhase& phase);
+
+    /*! Return the bounding volume hierarchy over the minor bodies of
+     *  the tree, or nullptr if there are too few of them to need one.
+     *  It's up to the caller to bring it up to date.
+     */
+    MinorBodyBVH* getMinorBodyBVH() const
+    {
+        return m_minorBodies.get();
+    }
+
 private:
+    void propagateChange();
+    void growBounds(const TimelinePhase& phase);
+    void addChildBounds(unsigned int child);
+
     Star* starParent;
     Body* bodyParent;
     std::vector<TimelinePhase::SharedConstPtr> children;
+    // Children whose bodies or trees changed since the bounds were updated
+    std::vector<const TimelinePhase*> changedChildren;
 
     double m_boundingSphereRadius{ 0.0 };
     double m_maxChildRadius{ 0.0 };
     bool m_containsSecondaryIlluminators{ false };
     bool m_changed{ false };
+    // Whether all children have to be scanned again, after one was removed
+    bool m_rescan{ true };
+    // Whether the bounds may be larger than needed, after a child changed
+    bool m_loose{ false };
+    bool m_threadSafe{ true };
     int m_childClassMask{ 0 };
+    unsigned int m_bodyCount{ 0 };
+    unsigned int m_minorBodyCount{ 0 };
+    std::unique_ptr<MinorBodyBVH> m_minorBodies;
 
     ReferenceFrame::SharedConstPtr defaultFrame;
 };
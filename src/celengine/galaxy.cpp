@@ -12,11 +12,18 @@
 #include <array>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
 #include <map>
 #include <optional>
+#include <string_view>
+#include <system_error>
+#include <tuple>
 #include <utility>
 #include <vector>
 
+#include <fmt/format.h>
 #include <fmt/printf.h>
 
 #include <celmath/ellipsoid.h>
@@ -24,7 +31,12 @@
 #include <celmath/randutils.h>
 #include <celmath/ray.h>
 #include <celmath/vecgl.h>
+#include <celrender/renderstats.h>
 #include <celrender/vertexobject.h>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/diskcache.h>
+#include <celutil/fsutils.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
 #include "galaxy.h"
@@ -36,6 +48,8 @@
 
 using celestia::render::VertexObject;
 
+namespace celutil = celestia::util;
+
 namespace
 {
 
@@ -75,8 +89,22 @@ constexpr unsigned int IRR_GALAXY_POINTS = 3500;
 constexpr float RADIUS_CORRECTION     = 0.025f;
 constexpr float MAX_SPIRAL_THICKNESS  = 0.06f;
 
+// The blobs of a form make up progressive levels of detail: blob 0 alone
+// is level 0, and the blobs [2^(n-1), 2^n) form level n, drawn with their
+// sprite size scaled by spriteScaleFactor^n. A galaxy draws only the levels
+// whose sprites cover at least its minimum feature size; that is a prefix of
+// the blobs whose length follows from the galaxy's size on screen.
 constexpr float spriteScaleFactor = 1.0f / 1.55f;
 
+// Forms built from template images are cached in the writeable data
+// directory; the cache is discarded when the image changes.
+constexpr std::string_view FormCacheMagic = "CELGXFRM";
+constexpr std::uint16_t FormCacheVersion = 0x0100;
+
+// Galaxies drawn by a single instanced draw call; this matches the size of
+// the uniform arrays in galaxy150_geom.glsl.
+constexpr int GalaxyInstancesPerDraw = 32;
+
 struct GalaxyTypeName
 {
     const char* name;
@@ -185,6 +213,7 @@ void draw(std::size_t vCount, const GalaxyVertex *v, std::size_t iCount, const G
                           4, GL_UNSIGNED_BYTE, GL_TRUE,
                           sizeof(GalaxyVertex), reinterpret_cast<const void*>(offsetof(GalaxyVertex, texCoord)));
     glDrawElements(GL_TRIANGLES, iCount, GL_UNSIGNED_SHORT, nullptr);
+    celestia::render::countDrawCall(GL_TRIANGLES, iCount);
 
     glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
     glDisableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
@@ -376,6 +405,133 @@ std::optional<GalacticForm> buildGalacticForm(const fs::path& filename)
     return galacticForm;
 }
 
+#ifndef PORTABLE_BUILD
+struct FormCacheKey
+{
+    std::uint64_t size;
+    std::int64_t  modified;
+};
+
+std::optional<FormCacheKey> getFormCacheKey(const fs::path& filename)
+{
+    std::error_code ec;
+    auto size = fs::file_size(filename, ec);
+    if (ec)
+        return std::nullopt;
+    auto modified = fs::last_write_time(filename, ec);
+    if (ec)
+        return std::nullopt;
+
+    return FormCacheKey{ static_cast<std::uint64_t>(size),
+                         static_cast<std::int64_t>(modified.time_since_epoch().count()) };
+}
+
+fs::path getFormCachePath(const fs::path& filename)
+{
+    std::error_code ec;
+    fs::path absolutePath = fs::absolute(filename, ec);
+    if (ec)
+        return fs::path();
+
+    static celutil::DiskCache cache(celutil::WriteableDataPath() / "cache" / "galaxies", FormCacheVersion);
+    return cache.getKeyPath(filename.stem().string(), absolutePath.string(), ".dat");
+}
+
+bool readFormCache(const fs::path& cachePath, const FormCacheKey& key, BlobVector& blobs)
+{
+    if (!celutil::DiskCache::use(cachePath))
+        return false;
+
+    std::ifstream in(cachePath, std::ios::in | std::ios::binary);
+    if (!in.good())
+        return false;
+
+    std::array<char, FormCacheMagic.size()> magic;
+    std::uint16_t version;
+    std::uint64_t size;
+    std::int64_t modified;
+    std::uint32_t count;
+    if (!in.read(magic.data(), magic.size()).good()
+        || std::string_view(magic.data(), magic.size()) != FormCacheMagic
+        || !celutil::readLE<std::uint16_t>(in, version) || version != FormCacheVersion
+        || !celutil::readLE<std::uint64_t>(in, size) || size != key.size
+        || !celutil::readLE<std::int64_t>(in, modified) || modified != key.modified
+        || !celutil::readLE<std::uint32_t>(in, count))
+    {
+        return false;
+    }
+
+    blobs.resize(count);
+    for (Blob& b : blobs)
+    {
+        if (!celutil::readLE<float>(in, b.position.x())
+            || !celutil::readLE<float>(in, b.position.y())
+            || !celutil::readLE<float>(in, b.position.z())
+            || !celutil::readLE<std::uint8_t>(in, b.colorIndex)
+            || !celutil::readLE<std::uint8_t>(in, b.brightness))
+        {
+            blobs.clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void writeFormCache(const fs::path& cachePath, const FormCacheKey& key, const BlobVector& blobs)
+{
+    bool ok = celutil::DiskCache::write(cachePath, [&key, &blobs](const fs::path& path)
+    {
+        std::ofstream out(path, std::ios::out | std::ios::binary);
+        bool written = out.write(FormCacheMagic.data(), FormCacheMagic.size()).good()
+            && celutil::writeLE<std::uint16_t>(out, FormCacheVersion)
+            && celutil::writeLE<std::uint64_t>(out, key.size)
+            && celutil::writeLE<std::int64_t>(out, key.modified)
+            && celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(blobs.size()));
+        for (auto it = blobs.begin(); written && it != blobs.end(); ++it)
+        {
+            written = celutil::writeLE<float>(out, it->position.x())
+                && celutil::writeLE<float>(out, it->position.y())
+                && celutil::writeLE<float>(out, it->position.z())
+                && celutil::writeLE<std::uint8_t>(out, it->colorIndex)
+                && celutil::writeLE<std::uint8_t>(out, it->brightness);
+        }
+        out.close();
+        return written && out.good();
+    });
+
+    if (!ok)
+        celutil::GetLogger()->warn("Failed to write the galaxy form cache {}\n", cachePath);
+}
+#endif
+
+// Load a form from its template image, or from the cache if it is up to date
+std::optional<GalacticForm> loadGalacticForm(const fs::path& filename)
+{
+#ifndef PORTABLE_BUILD
+    auto key = getFormCacheKey(filename);
+    fs::path cachePath = key.has_value() ? getFormCachePath(filename) : fs::path();
+    if (!cachePath.empty())
+    {
+        std::optional<GalacticForm> galacticForm(std::in_place);
+        if (readFormCache(cachePath, *key, galacticForm->blobs))
+        {
+            galacticForm->scale = Eigen::Vector3f::Ones();
+            return galacticForm;
+        }
+    }
+#endif
+
+    std::optional<GalacticForm> galacticForm = buildGalacticForm(filename);
+
+#ifndef PORTABLE_BUILD
+    if (galacticForm.has_value() && !cachePath.empty())
+        writeFormCache(cachePath, *key, galacticForm->blobs);
+#endif
+
+    return galacticForm;
+}
+
 class GalacticFormManager
 {
  private:
@@ -415,7 +571,7 @@ std::size_t GalacticFormManager::getCustomForm(const fs::path& path)
 
     std::size_t result = galacticForms.size();
     customForms[path] = result;
-    galacticForms.push_back(buildGalacticForm(path));
+    galacticForms.push_back(loadGalacticForm(path));
     return result;
 }
 
@@ -457,34 +613,40 @@ void GalacticFormManager::initializeStandardForms()
 
     // Spiral Galaxies, 7 classical Hubble types
 
-    galacticForms.push_back(buildGalacticForm("models/S0.png"));
-    galacticForms.push_back(buildGalacticForm("models/Sa.png"));
-    galacticForms.push_back(buildGalacticForm("models/Sb.png"));
-    galacticForms.push_back(buildGalacticForm("models/Sc.png"));
-    galacticForms.push_back(buildGalacticForm("models/SBa.png"));
-    galacticForms.push_back(buildGalacticForm("models/SBb.png"));
-    galacticForms.push_back(buildGalacticForm("models/SBc.png"));
+    galacticForms.push_back(loadGalacticForm("models/S0.png"));
+    galacticForms.push_back(loadGalacticForm("models/Sa.png"));
+    galacticForms.push_back(loadGalacticForm("models/Sb.png"));
+    galacticForms.push_back(loadGalacticForm("models/Sc.png"));
+    galacticForms.push_back(loadGalacticForm("models/SBa.png"));
+    galacticForms.push_back(loadGalacticForm("models/SBb.png"));
+    galacticForms.push_back(loadGalacticForm("models/SBc.png"));
 
     // Elliptical Galaxies , 8 classical Hubble types, E0..E7,
     //
     // To save space: generate spherical E0 template from S0 disk
     // via rescaling by (1.0f, 3.8f, 1.0f).
 
+    std::optional<GalacticForm> e0Form = loadGalacticForm("models/E0.png");
+    if (e0Form.has_value())
+    {
+        for (Blob& blob : e0Form->blobs)
+        {
+            blob.colorIndex = static_cast<std::uint8_t>(std::ceil(0.76f * static_cast<float>(blob.colorIndex)));
+        }
+    }
+
     for (unsigned int eform = 0; eform <= 7; ++eform)
     {
         float ell = 1.0f - static_cast<float>(eform) / 8.0f;
 
         // note the correct x,y-alignment of 'ell' scaling!!
-        // build all elliptical templates from rescaling E0
-        std::optional<GalacticForm> ellipticalForm = buildGalacticForm("models/E0.png");
-        if (ellipticalForm.has_value())
+        // build all elliptical templates from rescaling E0, sharing its blobs
+        std::optional<GalacticForm> ellipticalForm;
+        if (e0Form.has_value())
         {
+            ellipticalForm.emplace();
+            ellipticalForm->blobs = e0Form->blobs;
             ellipticalForm->scale = Eigen::Vector3f(ell, ell, 1.0f);
-
-            for (Blob& blob : ellipticalForm->blobs)
-            {
-                blob.colorIndex = static_cast<std::uint8_t>(std::ceil(0.76f * static_cast<float>(blob.colorIndex)));
-            }
         }
 
         galacticForms.push_back(std::move(ellipticalForm));
@@ -501,6 +663,7 @@ GalacticFormManager* getGalacticFormManager()
 
 
 float Galaxy::lightGain = 0.0f;
+float Galaxy::detailScale = 1.0f;
 
 float Galaxy::getDetail() const
 {
@@ -512,6 +675,16 @@ void Galaxy::setDetail(float d)
     detail = d;
 }
 
+GalaxyType Galaxy::getGalaxyType() const
+{
+    return type;
+}
+
+void Galaxy::setGalaxyType(GalaxyType t)
+{
+    type = t;
+}
+
 const char* Galaxy::getType() const
 {
     return GalaxyTypeNames[static_cast<std::size_t>(type)].name;
@@ -621,33 +794,28 @@ float Galaxy::getBrightnessCorrection(const Eigen::Vector3f &offset) const
     return (4.0f * lightGain + 1.0f) * btot * brightness_corr;
 }
 
-void Galaxy::render(const Eigen::Vector3f& offset,
-                    const Eigen::Quaternionf& viewerOrientation,
-                    float brightness,
-                    float pixelSize,
-                    const Matrices& ms,
-                    Renderer* renderer)
+// A galaxy ready to be drawn
+struct Galaxy::Instance
 {
-    if (celestia::gl::hasGeomShader())
-        renderGL3(offset, viewerOrientation, brightness, pixelSize, ms, renderer);
-    else
-        renderGL2(offset, viewerOrientation, brightness, pixelSize, ms, renderer);
-}
+    std::size_t     form;
+    int             detailPoints;   // number of blobs at the galaxy's detail level
+    int             nPoints;        // of those, the number large enough to be seen
+    Eigen::Matrix4f m;
+    float           size;
+    float           brightness;
+    float           minimumFeatureSize;
+};
 
-void Galaxy::renderGL2(const Eigen::Vector3f& offset,
-                       const Eigen::Quaternionf& viewerOrientation,
-                       float brightness,
-                       float pixelSize,
-                       const Matrices& ms,
-                       Renderer* renderer) const
-{
-    auto *prog = renderer->getShaderManager().getShader("galaxy");
-    if (prog == nullptr)
-        return;
+std::vector<Galaxy::Instance> Galaxy::renderQueue;
 
+bool Galaxy::getInstance(const Eigen::Vector3f& offset,
+                         float brightness,
+                         float pixelSize,
+                         Instance& instance) const
+{
     const GalacticForm* galacticForm = getGalacticFormManager()->getForm(form);
     if (galacticForm == nullptr)
-        return;
+        return false;
 
     /* We'll first see if the galaxy's apparent size is big enough to
        be noticeable on screen; if it's not we'll break right here,
@@ -659,26 +827,100 @@ void Galaxy::renderGL2(const Eigen::Vector3f& offset,
     float size = 2.0f * getRadius();
 
     if (size < minimumFeatureSize)
-        return;
-
-    BindTextures();
+        return false;
 
-    Eigen::Matrix3f viewMat = viewerOrientation.conjugate().toRotationMatrix();
-    Eigen::Vector3f v0 = viewMat * Eigen::Vector3f(-1, -1, 0) * size;
-    Eigen::Vector3f v1 = viewMat * Eigen::Vector3f( 1, -1, 0) * size;
-    Eigen::Vector3f v2 = viewMat * Eigen::Vector3f( 1,  1, 0) * size;
-    Eigen::Vector3f v3 = viewMat * Eigen::Vector3f(-1,  1, 0) * size;
-
-    Eigen::Matrix4f m = (
+    instance.form = form;
+    instance.m = (
         Eigen::Translation3f(offset) *
         Eigen::Affine3f(getOrientation().conjugate()) *
         Eigen::Scaling(galacticForm->scale * size)
     ).matrix();
+    instance.size = size;
+    instance.brightness = brightness * getBrightnessCorrection(offset);
+    instance.minimumFeatureSize = minimumFeatureSize;
 
     const BlobVector& points = galacticForm->blobs;
-    auto nPoints = static_cast<unsigned>(static_cast<float>(points.size()) * std::clamp(getDetail(), 0.0f, 1.0f));
+    instance.detailPoints = static_cast<int>(static_cast<float>(points.size()) * std::clamp(getDetail() * detailScale, 0.0f, 1.0f));
+    instance.nPoints = instance.detailPoints;
+
+    // find proper nPoints count
+    if (minimumFeatureSize > 0.0f)
+    {
+        auto power = static_cast<unsigned>(logf(minimumFeatureSize/size)/logf(spriteScaleFactor));
+        if (power < std::numeric_limits<decltype(instance.nPoints)>::digits)
+            instance.nPoints = std::min(instance.nPoints, 1 << power);
+    }
+
+    return true;
+}
+
+void Galaxy::render(const Eigen::Vector3f& offset,
+                    const Eigen::Quaternionf& viewerOrientation,
+                    float brightness,
+                    float pixelSize,
+                    const Matrices& ms,
+                    Renderer* renderer)
+{
+    Instance instance;
+    if (!getInstance(offset, brightness, pixelSize, instance))
+        return;
+
+    // The instance transform includes the offset
+    Eigen::Matrix4f mv = celmath::translate(*ms.modelview, Eigen::Vector3f(-offset));
+    Matrices m = { ms.projection, &mv };
+
+    if (celestia::gl::hasGeomShader())
+        renderGL3(&instance, 1, viewerOrientation, m, renderer);
+    else
+        renderGL2(&instance, 1, viewerOrientation, m, renderer);
+}
+
+void Galaxy::queueRender(const Eigen::Vector3f& offset,
+                         float brightness,
+                         float pixelSize) const
+{
+    Instance instance;
+    if (getInstance(offset, brightness, pixelSize, instance))
+        renderQueue.push_back(instance);
+}
+
+void Galaxy::renderQueued(const Eigen::Quaternionf& viewerOrientation,
+                          Renderer* renderer)
+{
+    if (renderQueue.empty())
+        return;
+
+    // Group the galaxies by form, so that consecutive instances can share
+    // a draw call, and by level of detail, so that small galaxies don't
+    // share a draw with large ones which need many more blobs.
+    std::stable_sort(renderQueue.begin(), renderQueue.end(),
+                     [](const Instance& a, const Instance& b)
+                     {
+                         return std::tie(a.form, a.detailPoints, a.nPoints) < std::tie(b.form, b.detailPoints, b.nPoints);
+                     });
+
+    Matrices m = { &renderer->getProjectionMatrix(), &renderer->getModelViewMatrix() };
+    if (celestia::gl::hasGeomShader())
+        renderGL3(renderQueue.data(), renderQueue.size(), viewerOrientation, m, renderer);
+    else
+        renderGL2(renderQueue.data(), renderQueue.size(), viewerOrientation, m, renderer);
+
+    renderQueue.clear();
+}
+
+void Galaxy::renderGL2(const Instance* instances,
+                       std::size_t count,
+                       const Eigen::Quaternionf& viewerOrientation,
+                       const Matrices& ms,
+                       Renderer* renderer)
+{
+    auto *prog = renderer->getShaderManager().getShader("galaxy");
+    if (prog == nullptr)
+        return;
 
-    brightness *= getBrightnessCorrection(offset);
+    BindTextures();
+
+    Eigen::Matrix3f viewMat = viewerOrientation.conjugate().toRotationMatrix();
 
     static GalaxyVertex *g_vertices = nullptr;
     static GLushort *g_indices = nullptr;
@@ -688,8 +930,7 @@ void Galaxy::renderGL2(const Eigen::Vector3f& offset,
         g_indices = new GLushort[MAX_INDICES];
 
     prog->use();
-    Eigen::Matrix4f mv = celmath::translate(*ms.modelview, Eigen::Vector3f(-offset));
-    prog->setMVPMatrices(*ms.projection, mv);
+    prog->setMVPMatrices(*ms.projection, *ms.modelview);
     prog->samplerParam("galaxyTex") = 0;
     prog->samplerParam("colorTex") = 1;
 
@@ -699,49 +940,64 @@ void Galaxy::renderGL2(const Eigen::Vector3f& offset,
     ps.smoothLines = true;
     renderer->setPipelineState(ps);
 
+    // The quads of all the instances are collected in the same buffer,
+    // only drawn when it's full.
     std::size_t vertex = 0, index = 0;
     GLushort j = 0;
-    for (unsigned int i = 0, pow2 = 1; i < nPoints; ++i)
+    for (std::size_t k = 0; k < count; ++k)
     {
-        if ((i & pow2) != 0)
-        {
-            pow2 <<= 1;
-            size *= spriteScaleFactor;
-            v0 *= spriteScaleFactor;
-            v1 *= spriteScaleFactor;
-            v2 *= spriteScaleFactor;
-            v3 *= spriteScaleFactor;
-            if (size < minimumFeatureSize)
-                break;
-        }
+        const Instance& instance = instances[k];
+        const GalacticForm* galacticForm = getGalacticFormManager()->getForm(instance.form);
 
-        const Blob& b = points[i];
-        Eigen::Vector3f p  = (m * Eigen::Vector4f(b.position.x(), b.position.y(), b.position.z(), 1.0f)).head(3);
+        float size = instance.size;
+        Eigen::Vector3f v0 = viewMat * Eigen::Vector3f(-1, -1, 0) * size;
+        Eigen::Vector3f v1 = viewMat * Eigen::Vector3f( 1, -1, 0) * size;
+        Eigen::Vector3f v2 = viewMat * Eigen::Vector3f( 1,  1, 0) * size;
+        Eigen::Vector3f v3 = viewMat * Eigen::Vector3f(-1,  1, 0) * size;
 
-        float screenFrac = size / p.norm();
-        if (screenFrac < 0.1f)
+        const BlobVector& points = galacticForm->blobs;
+        for (int i = 0, pow2 = 1; i < instance.detailPoints; ++i)
         {
-            float a = std::min(255.0f, (0.1f - screenFrac) * static_cast<float>(b.brightness) * brightness);
-            auto alpha = static_cast<std::uint8_t>(a); // encode as byte
-            g_vertices[vertex++] = { p + v0, { std::uint8_t(0), std::uint8_t(0), b.colorIndex, alpha } };
-            g_vertices[vertex++] = { p + v1, { std::uint8_t(255), std::uint8_t(0), b.colorIndex, alpha } };
-            g_vertices[vertex++] = { p + v2, { std::uint8_t(255), std::uint8_t(255), b.colorIndex, alpha } };
-            g_vertices[vertex++] = { p + v3, { std::uint8_t(0), std::uint8_t(255), b.colorIndex, alpha } };
-
-            g_indices[index++] = j;
-            g_indices[index++] = j + 1;
-            g_indices[index++] = j + 2;
-            g_indices[index++] = j;
-            g_indices[index++] = j + 2;
-            g_indices[index++] = j + 3;
-            j += 4;
-
-            if (vertex + 4 > MAX_VERTICES)
+            if ((i & pow2) != 0)
             {
-                draw(vertex, g_vertices, index, g_indices);
-                index = 0;
-                vertex = 0;
-                j = 0;
+                pow2 <<= 1;
+                size *= spriteScaleFactor;
+                v0 *= spriteScaleFactor;
+                v1 *= spriteScaleFactor;
+                v2 *= spriteScaleFactor;
+                v3 *= spriteScaleFactor;
+                if (size < instance.minimumFeatureSize)
+                    break;
+            }
+
+            const Blob& b = points[i];
+            Eigen::Vector3f p  = (instance.m * Eigen::Vector4f(b.position.x(), b.position.y(), b.position.z(), 1.0f)).head(3);
+
+            float screenFrac = size / p.norm();
+            if (screenFrac < 0.1f)
+            {
+                float a = std::min(255.0f, (0.1f - screenFrac) * static_cast<float>(b.brightness) * instance.brightness);
+                auto alpha = static_cast<std::uint8_t>(a); // encode as byte
+                g_vertices[vertex++] = { p + v0, { std::uint8_t(0), std::uint8_t(0), b.colorIndex, alpha } };
+                g_vertices[vertex++] = { p + v1, { std::uint8_t(255), std::uint8_t(0), b.colorIndex, alpha } };
+                g_vertices[vertex++] = { p + v2, { std::uint8_t(255), std::uint8_t(255), b.colorIndex, alpha } };
+                g_vertices[vertex++] = { p + v3, { std::uint8_t(0), std::uint8_t(255), b.colorIndex, alpha } };
+
+                g_indices[index++] = j;
+                g_indices[index++] = j + 1;
+                g_indices[index++] = j + 2;
+                g_indices[index++] = j;
+                g_indices[index++] = j + 2;
+                g_indices[index++] = j + 3;
+                j += 4;
+
+                if (vertex + 4 > MAX_VERTICES)
+                {
+                    draw(vertex, g_vertices, index, g_indices);
+                    index = 0;
+                    vertex = 0;
+                    j = 0;
+                }
             }
         }
     }
@@ -754,48 +1010,21 @@ void Galaxy::renderGL2(const Eigen::Vector3f& offset,
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
-void Galaxy::renderGL3(const Eigen::Vector3f& offset,
+void Galaxy::renderGL3(const Instance* instances,
+                       std::size_t count,
                        const Eigen::Quaternionf& viewerOrientation,
-                       float brightness,
-                       float pixelSize,
                        const Matrices& ms,
-                       Renderer* renderer) const
+                       Renderer* renderer)
 {
     ShaderManager::GeomShaderParams params = {GL_POINTS, GL_TRIANGLE_STRIP, 4};
     auto *prog = renderer->getShaderManager().getShaderGL3("galaxy150", &params);
     if (prog == nullptr)
         return;
 
-    const GalacticForm* galacticForm = getGalacticFormManager()->getForm(form);
-    if (galacticForm == nullptr)
-        return;
-
-    /* We'll first see if the galaxy's apparent size is big enough to
-       be noticeable on screen; if it's not we'll break right here,
-       avoiding all the overhead of the matrix transformations and
-       GL state changes: */
-    float distanceToDSO = std::max(0.0f, offset.norm() - getRadius());
-
-    float minimumFeatureSize = pixelSize * distanceToDSO;
-    float size = 2.0f * getRadius();
-
-    if (size < minimumFeatureSize)
-        return;
-
     BindTextures();
 
     Eigen::Matrix3f viewMat = viewerOrientation.conjugate().toRotationMatrix();
 
-    Eigen::Matrix4f m = (
-        Eigen::Translation3f(offset) *
-        Eigen::Affine3f(getOrientation().conjugate()) *
-        Eigen::Scaling(galacticForm->scale * size)
-    ).matrix();
-
-    brightness *= getBrightnessCorrection(offset);
-
-    Eigen::Matrix4f mv = celmath::translate(*ms.modelview, Eigen::Vector3f(-offset));
-
     Renderer::PipelineState ps;
     ps.blending = true;
     ps.blendFunc = {GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA};
@@ -803,38 +1032,57 @@ void Galaxy::renderGL3(const Eigen::Vector3f& offset,
     renderer->setPipelineState(ps);
 
     prog->use();
-    prog->setMVPMatrices(*ms.projection, mv);
+    prog->setMVPMatrices(*ms.projection, *ms.modelview);
     prog->samplerParam("galaxyTex")        = 0;
     prog->samplerParam("colorTex")         = 1;
-    prog->floatParam("size")               = size;
-    prog->floatParam("brightness")         = brightness;
-    prog->floatParam("minimumFeatureSize") = minimumFeatureSize;
-    prog->mat4Param("m")                   = m;
     prog->mat3Param("viewMat")             = viewMat;
 
-    const BlobVector& points = galacticForm->blobs;
-    auto nPoints = static_cast<int>(static_cast<float>(points.size()) * std::clamp(getDetail(), 0.0f, 1.0f));
+    Mat4ArrayShaderParameter transformParam = prog->mat4ArrayParam("m");
+    Vec4ArrayShaderParameter instanceParam  = prog->vec4ArrayParam("params");
+    std::array<Eigen::Matrix4f, GalaxyInstancesPerDraw> transforms;
+    std::array<Eigen::Vector4f, GalaxyInstancesPerDraw> instanceParams;
 
-    // find proper nPoints count
-    if (minimumFeatureSize > 0.0f)
+    std::size_t k = 0;
+    while (k < count)
     {
-        auto power = static_cast<unsigned>(logf(minimumFeatureSize/size)/logf(spriteScaleFactor));
-        if (power < std::numeric_limits<decltype(nPoints)>::digits)
-            nPoints = std::min(nPoints, 1 << power);
-    }
+        std::size_t form = instances[k].form;
+        const GalacticForm* galacticForm = getGalacticFormManager()->getForm(form);
+        VertexObject& vo = galacticForm->vo;
+        vo.bind();
+        if (!vo.initialized())
+        {
+            auto s = prog->attribIndex("in_Size");
+            auto c = prog->attribIndex("in_ColorIndex");
+            auto b = prog->attribIndex("in_Brightness");
+            initGalaxyData(vo, galacticForm->blobs, s, c, b);
+        }
 
-    VertexObject& vo = galacticForm->vo;
-    vo.bind();
-    if (!vo.initialized())
-    {
-        auto s = prog->attribIndex("in_Size");
-        auto c = prog->attribIndex("in_ColorIndex");
-        auto b = prog->attribIndex("in_Brightness");
-        initGalaxyData(vo, points, s, c, b);
+        // Draw the following instances of the same form and detail together;
+        // the blobs too small for some of them are discarded by the shader.
+        while (k < count && instances[k].form == form)
+        {
+            int detailPoints = instances[k].detailPoints;
+            int nPoints = 0;
+            int nInstances = 0;
+            for (; k < count && nInstances < GalaxyInstancesPerDraw; ++k, ++nInstances)
+            {
+                const Instance& instance = instances[k];
+                if (instance.form != form || instance.detailPoints != detailPoints)
+                    break;
+
+                transforms[nInstances] = instance.m;
+                instanceParams[nInstances] = Eigen::Vector4f(instance.size, instance.brightness, instance.minimumFeatureSize, 0.0f);
+                nPoints = std::max(nPoints, instance.nPoints);
+            }
+
+            transformParam.set(transforms.data(), nInstances);
+            instanceParam.set(instanceParams.data(), nInstances);
+            vo.drawInstanced(GL_POINTS, nPoints, nInstances);
+        }
+
+        vo.unbind();
     }
 
-    vo.draw(GL_POINTS, nPoints);
-    vo.unbind();
     glActiveTexture(GL_TEXTURE0);
 }
 
@@ -868,6 +1116,16 @@ void Galaxy::setLightGain(float lg)
     lightGain = std::clamp(lg, 0.0f, 1.0f);
 }
 
+float Galaxy::getDetailScale()
+{
+    return detailScale;
+}
+
+void Galaxy::setDetailScale(float scale)
+{
+    detailScale = std::clamp(scale, 0.0f, 1.0f);
+}
+
 std::ostream& operator<<(std::ostream& s, const GalaxyType& sc)
 {
     return s << GalaxyTypeNames[static_cast<std::size_t>(sc)].name;
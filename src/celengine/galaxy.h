@@ -13,6 +13,7 @@
 #include <cstdint>
 #include <cstddef>
 #include <string>
+#include <vector>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -56,6 +57,13 @@ class Galaxy : public DeepSkyObject
     float getDetail() const;
     void setDetail(float);
 
+    GalaxyType getGalaxyType() const;
+    void setGalaxyType(GalaxyType);
+    // Select the form drawn from the custom template image in the models
+    // directory, or the standard form of the galaxy type if the template
+    // name is empty.
+    void setForm(const std::string&);
+
     bool pick(const Eigen::ParametrizedLine<double, 3>& ray,
               double& distanceToPicker,
               double& cosAngleToBoundCenter) const override;
@@ -67,35 +75,54 @@ class Galaxy : public DeepSkyObject
                 const Matrices& m,
                 Renderer* r) override;
 
+    // Queue the galaxy to be drawn by the next call to renderQueued, with
+    // the renderer's projection and modelview matrices. Queued galaxies of
+    // the same form are drawn together.
+    void queueRender(const Eigen::Vector3f& offset,
+                     float brightness,
+                     float pixelSize) const;
+    static void renderQueued(const Eigen::Quaternionf& viewerOrientation,
+                             Renderer* r);
+
     static void  increaseLightGain();
     static void  decreaseLightGain();
     static float getLightGain();
     static void  setLightGain(float);
+    // Factor of the detail of all galaxies, for drawing fewer blobs when
+    // frames take too long
+    static float getDetailScale();
+    static void  setDetailScale(float);
 
     std::uint64_t getRenderMask() const override;
     unsigned int getLabelMask() const override;
 
     const char* getObjTypeName() const override;
+    std::size_t getMemoryUsage() const override { return sizeof(Galaxy) + DeepSkyObject::getMemoryUsage(); }
 
  private:
-    void setForm(const std::string&);
     float getBrightnessCorrection(const Eigen::Vector3f &) const;
-    void renderGL3(const Eigen::Vector3f& offset,
-                   const Eigen::Quaternionf& viewerOrientation,
-                   float brightness,
-                   float pixelSize,
-                   const Matrices& m,
-                   Renderer* r) const;
-    void renderGL2(const Eigen::Vector3f& offset,
-                   const Eigen::Quaternionf& viewerOrientation,
-                   float brightness,
-                   float pixelSize,
-                   const Matrices& m,
-                   Renderer* r) const;
+
+    struct Instance;
+    bool getInstance(const Eigen::Vector3f& offset,
+                     float brightness,
+                     float pixelSize,
+                     Instance& instance) const;
+    static void renderGL3(const Instance* instances,
+                          std::size_t count,
+                          const Eigen::Quaternionf& viewerOrientation,
+                          const Matrices& m,
+                          Renderer* r);
+    static void renderGL2(const Instance* instances,
+                          std::size_t count,
+                          const Eigen::Quaternionf& viewerOrientation,
+                          const Matrices& m,
+                          Renderer* r);
 
     float       detail{ 1.0f };
     GalaxyType  type{ GalaxyType::Irr };
     std::size_t form{ 0 };
 
     static float lightGain;
+    static float detailScale;
+    static std::vector<Instance> renderQueue;
 };
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <cstddef>
+
 #include <Eigen/Geometry>
 
 #include <celmodel/material.h>
@@ -47,8 +49,39 @@ public:
         return false;
     }
 
+    /*! Return true if copies of the geometry with different transforms
+     *  can be drawn together by instancing.
+     */
+    virtual bool isInstanceable() const
+    {
+        return false;
+    }
+
+    /*! Return true if the shape of the geometry changes over time, so
+     *  that what was drawn at one time can't stand in for another.
+     */
+    virtual bool isAnimated() const
+    {
+        return false;
+    }
+
     /*! Load all textures used by the model. */
     virtual void loadTextures()
     {
     }
+
+    /*! Create the OpenGL buffers of the geometry ahead of its first
+     *  rendering; requires a current OpenGL context.
+     */
+    virtual void createBuffers()
+    {
+    }
+
+    /*! Return the bytes of main memory taken by the geometry, not
+     *  including those of its OpenGL buffers.
+     */
+    virtual std::size_t getMemoryUsage() const
+    {
+        return 0;
+    }
 };
@@ -315,6 +315,105 @@ static void render_hollow_marker(const Renderer &renderer,
     lr->finish();
 }
 
+// The lines of the hollow markers of a frame, drawn together
+static LineRenderer* getMarkerBatch(const Renderer &renderer)
+{
+    static LineRenderer *lr = nullptr;
+
+    if (lr == nullptr)
+    {
+        lr = new LineRenderer(renderer, 1.0f, LineRenderer::PrimType::Lines,
+                              LineRenderer::StorageType::Stream, LineRenderer::VertexFormat::P3F_C4UB);
+        lr->setHints(LineRenderer::DISABLE_FISHEYE_TRANFORMATION);
+        lr->startUpdate();
+    }
+    return lr;
+}
+
+static int addLines(LineRenderer &lr, const GLfloat *data, int count,
+                    const Vector3f &center, float s, const Color &color)
+{
+    for (int i = 0; i < count * 2; i += 2)
+        lr.addVertex(Vector3f(center.x() + data[i] * s, center.y() + data[i + 1] * s, center.z()), color);
+    return count;
+}
+
+static int addCircle(LineRenderer &lr, const GLfloat *data, int count,
+                     const Vector3f &center, float s, const Color &color)
+{
+    for (int i = 0; i < count; i++)
+    {
+        int j = i * 2;
+        int k = ((i + 1) % count) * 2;
+        lr.addVertex(Vector3f(center.x() + data[j] * s, center.y() + data[j + 1] * s, center.z()), color);
+        lr.addVertex(Vector3f(center.x() + data[k] * s, center.y() + data[k + 1] * s, center.z()), color);
+    }
+    return count * 2;
+}
+
+/*! Add the lines of a hollow marker symbol centered at position, in view
+ *  coordinates, to those drawn by renderMarkerBatch(). Returns false for
+ *  the other symbols, which have to be drawn with renderMarker().
+ */
+bool Renderer::addMarkerToBatch(celestia::MarkerRepresentation::Symbol symbol,
+                                float size,
+                                const Color &color,
+                                const Vector3f &position)
+{
+    LineRenderer &lr = *getMarkerBatch(*this);
+    float s = size / 2.0f * getScaleFactor();
+
+    switch (symbol)
+    {
+    case MarkerRepresentation::Square:
+        markerBatchCount += addLines(lr, Square, SquareCount, position, s, color);
+        return true;
+
+    case MarkerRepresentation::Triangle:
+        markerBatchCount += addLines(lr, Triangle, TriangleCount, position, s, color);
+        return true;
+
+    case MarkerRepresentation::Diamond:
+        markerBatchCount += addLines(lr, Diamond, DiamondCount, position, s, color);
+        return true;
+
+    case MarkerRepresentation::Plus:
+        markerBatchCount += addLines(lr, Plus, PlusCount, position, s, color);
+        return true;
+
+    case MarkerRepresentation::X:
+        markerBatchCount += addLines(lr, X, XCount, position, s, color);
+        return true;
+
+    case MarkerRepresentation::Circle:
+        initializeCircles();
+        if (size <= 40.0f) // TODO: this should be configurable
+            markerBatchCount += addCircle(lr, SmallCircle, SmallCircleCount, position, s, color);
+        else
+            markerBatchCount += addCircle(lr, LargeCircle, LargeCircleCount, position, s, color);
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+/*! Draw the markers added by addMarkerToBatch() since the last call.
+ */
+void Renderer::renderMarkerBatch(const Matrices &m)
+{
+    LineRenderer &lr = *getMarkerBatch(*this);
+    if (markerBatchCount > 0)
+    {
+        lr.prerender();
+        lr.render(m, markerBatchCount);
+        lr.finish();
+    }
+    lr.clear();
+    lr.startUpdate();
+    markerBatchCount = 0;
+}
+
 void Renderer::renderMarker(celestia::MarkerRepresentation::Symbol symbol,
                             float size,
                             const Color &color,
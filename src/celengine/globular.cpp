@@ -12,8 +12,10 @@
 // of the License, or (at your option) any later version.
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <utility>
@@ -21,9 +23,11 @@
 #include <fmt/printf.h>
 
 #include <celmath/ellipsoid.h>
+#include <celmath/geomutil.h>
 #include <celmath/intersect.h>
 #include <celmath/randutils.h>
 #include <celmath/ray.h>
+#include <celmath/vecgl.h>
 #include <celrender/vertexobject.h>
 #include <celutil/color.h>
 #include <celutil/gettext.h>
@@ -61,6 +65,10 @@ Color colorTable[256];
 
 constexpr unsigned int GLOBULAR_POINTS  = 8192;
 
+// One element of the uniform arrays per instance, see globular150_vert.glsl
+// and tidal150_vert.glsl
+constexpr int GlobularInstancesPerDraw = 32;
+
 constexpr float LumiShape = 3.0f;
 
 // min/max c-values of globular cluster data
@@ -472,6 +480,30 @@ GlobularInfoManager* getGlobularInfoManager()
     return globularInfoManager;
 }
 
+// Set the King concentration bin used to evaluate the center cloud texture
+// and the star densities of a form
+void setKingBin(std::size_t form)
+{
+    // Use same 8 c-bins as in globularForms below!
+    CBin = MinC + (static_cast<float>(form) + 0.5f) * BinWidth; // center value of (ic+1)th c-bin
+
+    RRatio = std::pow(10.0f, CBin);
+    XI = 1.0f / std::sqrt(1.0f + RRatio * RRatio);
+}
+
+Texture* getColorTex()
+{
+    static Texture* colorTex = nullptr;
+    if (colorTex == nullptr)
+    {
+        colorTex = CreateProceduralTexture(256, 1, celestia::PixelFormat::RGBA,
+                                           colorTextureEval,
+                                           Texture::EdgeClamp,
+                                           Texture::NoMipMaps).release();
+    }
+    return colorTex;
+}
+
 unsigned int cSlot(float conc)
 {
     // map the physical range of c, minC <= c <= maxC,
@@ -543,29 +575,48 @@ bool Globular::load(const AssociativeArray* params, const fs::path& resPath)
     if (auto detailVal = params->getNumber<float>("Detail"); detailVal.has_value())
         detail = *detailVal;
 
-    if (auto coreRadius = params->getAngle<float>("CoreRadius", 1.0 / MINUTES_PER_DEG); coreRadius.has_value())
-        r_c = *coreRadius;
+    auto coreRadius = params->getAngle<float>("CoreRadius", 1.0 / MINUTES_PER_DEG);
+    auto king = params->getNumber<float>("KingConcentration");
+    setStructure(coreRadius.value_or(r_c), king.value_or(c));
 
-    if (auto king = params->getNumber<float>("KingConcentration"); king.has_value())
-        c = *king;
+    return true;
+}
 
+void Globular::setStructure(float coreRadius, float kingConcentration)
+{
+    r_c = coreRadius;
+    c = kingConcentration;
     formIndex = cSlot(c);
     recomputeTidalRadius();
-
-    return true;
 }
 
-void Globular::render(const Eigen::Vector3f& offset,
-                      const Eigen::Quaternionf& viewerOrientation,
-                      float brightness,
-                      float pixelSize,
-                      const Matrices& m,
-                      Renderer* renderer)
+struct Globular::Instance
 {
-    GlobularInfoManager* globularInfoManager = getGlobularInfoManager();
-    const auto* form = globularInfoManager->getForm(formIndex);
+    std::size_t     form;
+    Eigen::Matrix4f m;              // star positions to the observer's frame
+    Eigen::Vector3f offset;
+    float           tidalSize;
+    float           brightness;
+    float           pixelWeight;
+    float           scale;          // sprite scale factor
+    int             nPoints;
+};
+
+std::vector<Globular::Instance> Globular::renderQueue;
+float Globular::queueNearZ = std::numeric_limits<float>::max();
+float Globular::queueFarZ = 0.0f;
+
+bool Globular::getInstance(const Eigen::Vector3f& offset,
+                           const Eigen::Quaternionf& viewerOrientation,
+                           float brightness,
+                           float pixelSize,
+                           const Matrices& m,
+                           Renderer* renderer,
+                           Instance& instance) const
+{
+    const auto* form = getGlobularInfoManager()->getForm(formIndex);
     if (form == nullptr)
-        return;
+        return false;
 
     float distanceToDSO = std::max(0.0f, offset.norm() - getRadius());
 
@@ -581,12 +632,7 @@ void Globular::render(const Eigen::Vector3f& offset,
      */
 
     if (DiskSizeInPixels < 1.0f)
-        return;
-
-    auto *tidalProg = renderer->getShaderManager().getShader("tidal");
-    auto *globProg  = renderer->getShaderManager().getShader("globular");
-    if (tidalProg == nullptr || globProg == nullptr)
-        return;
+        return false;
 
     /*
      * When resolution (zoom) varies, the blended texture opacity is controlled by the
@@ -599,47 +645,110 @@ void Globular::render(const Eigen::Vector3f& offset,
     if (DiskSizeInPixels >= P1)
         pixelWeight = 1.0f/(P2 + (1.0f - P2) * DiskSizeInPixels / P1);
 
-    // Use same 8 c-bins as in globularForms below!
-    CBin = MinC + (static_cast<float>(formIndex) + 0.5f) * BinWidth; // center value of (ic+1)th c-bin
+    Eigen::Matrix3f viewMat = viewerOrientation.conjugate().toRotationMatrix();
+    float size = CalculateSpriteSize(renderer, (*m.projection) * (*m.modelview), viewMat);
 
-    RRatio = std::pow(10.0f, CBin);
-    XI = 1.0f / std::sqrt(1.0f + RRatio * RRatio);
+    float tidalSize = 2.0f * tidalRadius;
 
-    static Texture *colorTex;
-    if (colorTex == nullptr)
-    {
-        colorTex = CreateProceduralTexture(256, 1, celestia::PixelFormat::RGBA,
-                                           colorTextureEval,
-                                           Texture::EdgeClamp,
-                                           Texture::NoMipMaps).release();
-    }
-    glActiveTexture(GL_TEXTURE1);
-    colorTex->bind();
+    instance.form = formIndex;
+    instance.m = (Eigen::Translation3f(offset) *
+                  Eigen::Affine3f(getOrientation().conjugate().toRotationMatrix() * Eigen::Scaling(tidalSize))).matrix();
+    instance.offset = offset;
+    instance.tidalSize = tidalSize;
+    instance.brightness = brightness;
+    instance.pixelWeight = pixelWeight;
+    instance.scale = size * static_cast<float>(renderer->getScreenDpi()) / 96.0f;
+    instance.nPoints = CalculateSpriteCount(form, detail, brightness, minimumFeatureSize);
 
-    float tidalSize = 2.0f * tidalRadius;
+    return true;
+}
 
-    /* Render central cloud sprite (centerTex). It fades away when
-     * distance from center or resolution increases sufficiently.
-     */
+void Globular::render(const Eigen::Vector3f& offset,
+                      const Eigen::Quaternionf& viewerOrientation,
+                      float brightness,
+                      float pixelSize,
+                      const Matrices& ms,
+                      Renderer* renderer)
+{
+    Instance instance;
+    if (!getInstance(offset, viewerOrientation, brightness, pixelSize, ms, renderer, instance))
+        return;
 
-    VertexObject& vo = form->vo;
-    vo.bind();
-    if (!vo.initialized())
-        initGlobularData(vo, form->gblobs);
+    // The instance transform includes the offset
+    Eigen::Matrix4f mv = celmath::translate(*ms.modelview, Eigen::Vector3f(-offset));
+    Matrices m = { ms.projection, &mv };
 
-    glActiveTexture(GL_TEXTURE0);
-    globularInfoManager->getCenterTex(formIndex)->bind();
+    if (celestia::gl::hasGeomShader())
+        renderGL3(&instance, 1, viewerOrientation, m, renderer);
+    else
+        renderGL2(&instance, 1, viewerOrientation, m, renderer);
+}
 
-    Eigen::Matrix3f viewMat = viewerOrientation.conjugate().toRotationMatrix();
+void Globular::queueRender(const Eigen::Vector3f& offset,
+                           const Eigen::Quaternionf& viewerOrientation,
+                           float brightness,
+                           float pixelSize,
+                           float nearZ,
+                           float farZ,
+                           const Matrices& m,
+                           Renderer* renderer) const
+{
+    Instance instance;
+    if (!getInstance(offset, viewerOrientation, brightness, pixelSize, m, renderer, instance))
+        return;
 
-    tidalProg->use();
-    tidalProg->setMVPMatrices(*m.projection, *m.modelview);
-    tidalProg->mat3Param("viewMat")      = viewMat;
-    tidalProg->floatParam("brightness")  = brightness;
-    tidalProg->floatParam("pixelWeight") = pixelWeight;
-    tidalProg->floatParam("tidalSize")   = tidalSize;
-    tidalProg->samplerParam("tidalTex")  = 0;
-    tidalProg->samplerParam("colorTex")  = 1;
+    renderQueue.push_back(instance);
+    queueNearZ = std::min(queueNearZ, nearZ);
+    queueFarZ = std::max(queueFarZ, farZ);
+}
+
+void Globular::renderQueued(const Eigen::Quaternionf& viewerOrientation,
+                            float fov,
+                            Renderer* renderer)
+{
+    if (renderQueue.empty())
+        return;
+
+    // Group the clusters by form, keeping them in their original order
+    // otherwise.
+    std::stable_sort(renderQueue.begin(), renderQueue.end(),
+                     [](const Instance& a, const Instance& b) { return a.form < b.form; });
+
+    // Without depth testing only the clipping depends on the depth range,
+    // so a single projection works for all the clusters.
+    float t = renderer->getAspectRatio();
+    Eigen::Matrix4f pr = renderer->getProjectionMode() == Renderer::ProjectionMode::FisheyeMode
+        ? celmath::Ortho(-t, t, -1.0f, 1.0f, queueNearZ, queueFarZ)
+        : celmath::Perspective(fov, t, queueNearZ, queueFarZ);
+    Matrices m = { &pr, &renderer->getModelViewMatrix() };
+
+    if (celestia::gl::hasGeomShader())
+        renderGL3(renderQueue.data(), renderQueue.size(), viewerOrientation, m, renderer);
+    else
+        renderGL2(renderQueue.data(), renderQueue.size(), viewerOrientation, m, renderer);
+
+    renderQueue.clear();
+    queueNearZ = std::numeric_limits<float>::max();
+    queueFarZ = 0.0f;
+}
+
+void Globular::renderGL2(const Instance* instances,
+                         std::size_t count,
+                         const Eigen::Quaternionf& viewerOrientation,
+                         const Matrices& ms,
+                         Renderer* renderer)
+{
+    auto *tidalProg = renderer->getShaderManager().getShader("tidal");
+    auto *globProg  = renderer->getShaderManager().getShader("globular");
+    if (tidalProg == nullptr || globProg == nullptr)
+        return;
+
+    GlobularInfoManager* globularInfoManager = getGlobularInfoManager();
+
+    glActiveTexture(GL_TEXTURE1);
+    getColorTex()->bind();
+
+    Eigen::Matrix3f viewMat = viewerOrientation.conjugate().toRotationMatrix();
 
     Renderer::PipelineState ps;
     ps.blending = true;
@@ -647,42 +756,180 @@ void Globular::render(const Eigen::Vector3f& offset,
     ps.smoothLines = true;
     renderer->setPipelineState(ps);
 
-    vo.draw(GL_TRIANGLE_FAN, 4);
+#ifndef GL_ES
+    glEnable(GL_POINT_SPRITE);
+    glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+#endif
 
-    /*! Next, render globular cluster via distinct "star" sprites (globularTex)
-     * for sufficiently large resolution and distance from center of globular.
-     *
-     * This RGBA texture fades away when resolution decreases (e.g. via automag!),
-     * or when distance from globular center decreases.
-     */
-    globularInfoManager->getGlobularTex()->bind();
+    std::size_t k = 0;
+    while (k < count)
+    {
+        std::size_t formIndex = instances[k].form;
+        const auto* form = globularInfoManager->getForm(formIndex);
+        setKingBin(formIndex);
+
+        VertexObject& vo = form->vo;
+        vo.bind();
+        if (!vo.initialized())
+            initGlobularData(vo, form->gblobs);
+
+        // Each cluster is drawn in full before the next one, as the tidal
+        // and star programs have per cluster uniforms.
+        for (; k < count && instances[k].form == formIndex; ++k)
+        {
+            const Instance& instance = instances[k];
+            Eigen::Matrix4f mv = celmath::translate(*ms.modelview, instance.offset);
+
+            /* Render central cloud sprite (centerTex). It fades away when
+             * distance from center or resolution increases sufficiently.
+             */
+            glActiveTexture(GL_TEXTURE0);
+            globularInfoManager->getCenterTex(formIndex)->bind();
+
+            tidalProg->use();
+            tidalProg->setMVPMatrices(*ms.projection, mv);
+            tidalProg->mat3Param("viewMat")      = viewMat;
+            tidalProg->floatParam("brightness")  = instance.brightness;
+            tidalProg->floatParam("pixelWeight") = instance.pixelWeight;
+            tidalProg->floatParam("tidalSize")   = instance.tidalSize;
+            tidalProg->samplerParam("tidalTex")  = 0;
+            tidalProg->samplerParam("colorTex")  = 1;
+
+            vo.draw(GL_TRIANGLE_FAN, 4);
+
+            /*! Next, render globular cluster via distinct "star" sprites (globularTex)
+             * for sufficiently large resolution and distance from center of globular.
+             *
+             * This RGBA texture fades away when resolution decreases (e.g. via automag!),
+             * or when distance from globular center decreases.
+             */
+            globularInfoManager->getGlobularTex()->bind();
+
+            globProg->use();
+            globProg->setMVPMatrices(*ms.projection, mv);
+            globProg->mat3Param("m")            = instance.m.topLeftCorner<3, 3>();
+            globProg->vec3Param("offset")       = instance.offset;
+            globProg->floatParam("brightness")  = instance.brightness;
+            globProg->floatParam("pixelWeight") = instance.pixelWeight;
+            globProg->floatParam("scale")       = instance.scale;
+            globProg->samplerParam("starTex")   = 0;
+            globProg->samplerParam("colorTex")  = 1;
+
+            vo.draw(GL_POINTS, instance.nPoints, 4);
+        }
 
-    Eigen::Matrix3f mx = getOrientation().conjugate().toRotationMatrix() * Eigen::Scaling(tidalSize);
+        vo.unbind();
+    }
 
-    float size = CalculateSpriteSize(renderer, (*m.projection) * (*m.modelview), viewMat);
+#ifndef GL_ES
+    glDisable(GL_POINT_SPRITE);
+    glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
+#endif
+}
+
+void Globular::renderGL3(const Instance* instances,
+                         std::size_t count,
+                         const Eigen::Quaternionf& viewerOrientation,
+                         const Matrices& ms,
+                         Renderer* renderer)
+{
+    auto *tidalProg = renderer->getShaderManager().getShaderGL3("tidal150");
+    auto *globProg  = renderer->getShaderManager().getShaderGL3("globular150");
+    if (tidalProg == nullptr || globProg == nullptr)
+        return;
+
+    GlobularInfoManager* globularInfoManager = getGlobularInfoManager();
+
+    glActiveTexture(GL_TEXTURE1);
+    getColorTex()->bind();
+
+    Eigen::Matrix3f viewMat = viewerOrientation.conjugate().toRotationMatrix();
+
+    Renderer::PipelineState ps;
+    ps.blending = true;
+    ps.blendFunc = {GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA};
+    ps.smoothLines = true;
+    renderer->setPipelineState(ps);
+
+    tidalProg->use();
+    tidalProg->setMVPMatrices(*ms.projection, *ms.modelview);
+    tidalProg->mat3Param("viewMat")     = viewMat;
+    tidalProg->samplerParam("tidalTex") = 0;
+    tidalProg->samplerParam("colorTex") = 1;
+    Vec4ArrayShaderParameter tidalOffsetParam = tidalProg->vec4ArrayParam("offsets");
+    Vec4ArrayShaderParameter tidalInstanceParam = tidalProg->vec4ArrayParam("params");
 
     globProg->use();
-    globProg->setMVPMatrices(*m.projection, *m.modelview);
-    globProg->mat3Param("m")            = mx;
-    globProg->vec3Param("offset")       = offset;
-    globProg->floatParam("brightness")  = brightness;
-    globProg->floatParam("pixelWeight") = pixelWeight;
-    globProg->floatParam("scale")       = size * static_cast<float>(renderer->getScreenDpi()) / 96.0f;
-    globProg->samplerParam("starTex")   = 0;
-    globProg->samplerParam("colorTex")  = 1;
+    globProg->setMVPMatrices(*ms.projection, *ms.modelview);
+    globProg->samplerParam("starTex")  = 0;
+    globProg->samplerParam("colorTex") = 1;
+    Mat4ArrayShaderParameter transformParam = globProg->mat4ArrayParam("m");
+    Vec4ArrayShaderParameter instanceParam = globProg->vec4ArrayParam("params");
+
+    std::array<Eigen::Matrix4f, GlobularInstancesPerDraw> transforms;
+    std::array<Eigen::Vector4f, GlobularInstancesPerDraw> offsets;
+    std::array<Eigen::Vector4f, GlobularInstancesPerDraw> instanceParams;
 
 #ifndef GL_ES
     glEnable(GL_POINT_SPRITE);
     glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
 #endif
 
-    vo.draw(GL_POINTS, CalculateSpriteCount(form, detail, brightness, minimumFeatureSize), 4);
+    std::size_t k = 0;
+    while (k < count)
+    {
+        std::size_t formIndex = instances[k].form;
+        const auto* form = globularInfoManager->getForm(formIndex);
+        setKingBin(formIndex);
+
+        VertexObject& vo = form->vo;
+        vo.bind();
+        if (!vo.initialized())
+            initGlobularData(vo, form->gblobs);
+
+        // The clusters of a form share the vertex buffer and the center
+        // cloud texture, so they are drawn together; the stars beyond
+        // each cluster's count are culled by the shader.
+        while (k < count && instances[k].form == formIndex)
+        {
+            int nPoints = 0;
+            int nInstances = 0;
+            for (; k < count && nInstances < GlobularInstancesPerDraw && instances[k].form == formIndex; ++k, ++nInstances)
+            {
+                const Instance& instance = instances[k];
+                transforms[nInstances] = instance.m;
+                offsets[nInstances] = Eigen::Vector4f(instance.offset.x(), instance.offset.y(), instance.offset.z(), instance.tidalSize);
+                instanceParams[nInstances] = Eigen::Vector4f(instance.brightness,
+                                                            instance.pixelWeight,
+                                                            instance.scale,
+                                                            static_cast<float>(instance.nPoints));
+                nPoints = std::max(nPoints, instance.nPoints);
+            }
+
+            glActiveTexture(GL_TEXTURE0);
+            globularInfoManager->getCenterTex(formIndex)->bind();
+
+            tidalProg->use();
+            tidalOffsetParam.set(offsets.data(), nInstances);
+            tidalInstanceParam.set(instanceParams.data(), nInstances);
+            vo.drawInstanced(GL_TRIANGLE_FAN, 4, nInstances);
+
+            globularInfoManager->getGlobularTex()->bind();
+
+            globProg->use();
+            transformParam.set(transforms.data(), nInstances);
+            instanceParam.set(instanceParams.data(), nInstances);
+            vo.drawInstanced(GL_POINTS, nPoints, nInstances, 4);
+        }
+
+        vo.unbind();
+    }
 
-    vo.unbind();
 #ifndef GL_ES
     glDisable(GL_POINT_SPRITE);
     glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
 #endif
+    glActiveTexture(GL_TEXTURE0);
 }
 
 std::uint64_t Globular::getRenderMask() const
@@ -41,6 +41,16 @@ class Globular : public DeepSkyObject
 
     float getBoundingSphereRadius() const override { return tidalRadius; }
 
+    float getDetail() const { return detail; }
+    void setDetail(float d) { detail = d; }
+
+    // Core radius in arcminutes
+    float getCoreRadius() const { return r_c; }
+    float getKingConcentration() const { return c; }
+    // The tidal radius depends on the distance, so this has to be done
+    // after setting the position.
+    void setStructure(float coreRadius, float kingConcentration);
+
     bool pick(const Eigen::ParametrizedLine<double, 3>& ray,
               double& distanceToPicker,
               double& cosAngleToBoundCenter) const override;
@@ -52,9 +62,28 @@ class Globular : public DeepSkyObject
                 const Matrices& m,
                 Renderer* r) override;
 
+    // Queue the cluster to be drawn by the next call to renderQueued. The
+    // matrices are those it would be rendered with; nearZ and farZ give
+    // the depth range it needs. Queued clusters of the same form are drawn
+    // together.
+    void queueRender(const Eigen::Vector3f& offset,
+                     const Eigen::Quaternionf& viewerOrientation,
+                     float brightness,
+                     float pixelSize,
+                     float nearZ,
+                     float farZ,
+                     const Matrices& m,
+                     Renderer* r) const;
+    // Draw the queued clusters with the renderer's modelview matrix and a
+    // projection covering the depth ranges of all of them.
+    static void renderQueued(const Eigen::Quaternionf& viewerOrientation,
+                             float fov,
+                             Renderer* r);
+
     std::uint64_t getRenderMask() const override;
     unsigned int getLabelMask() const override;
     const char* getObjTypeName() const override;
+    std::size_t getMemoryUsage() const override { return sizeof(Globular) + DeepSkyObject::getMemoryUsage(); }
 
  private:
     // Reference values ( = data base averages) of core radius, King concentration
@@ -64,9 +93,32 @@ class Globular : public DeepSkyObject
 
     void recomputeTidalRadius();
 
+    struct Instance;
+    bool getInstance(const Eigen::Vector3f& offset,
+                     const Eigen::Quaternionf& viewerOrientation,
+                     float brightness,
+                     float pixelSize,
+                     const Matrices& m,
+                     Renderer* r,
+                     Instance& instance) const;
+    static void renderGL3(const Instance* instances,
+                          std::size_t count,
+                          const Eigen::Quaternionf& viewerOrientation,
+                          const Matrices& m,
+                          Renderer* r);
+    static void renderGL2(const Instance* instances,
+                          std::size_t count,
+                          const Eigen::Quaternionf& viewerOrientation,
+                          const Matrices& m,
+                          Renderer* r);
+
     float detail{ 1.0f };
     float r_c{ R_c_ref };
     float c{ C_ref };
     float tidalRadius{ 0.0f };
     std::size_t formIndex{ static_cast<std::size_t>(-1) };
+
+    static std::vector<Instance> renderQueue;
+    static float queueNearZ;
+    static float queueFarZ;
 };
@@ -7,6 +7,7 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <celrender/renderstats.h>
 #include <celutil/logger.h>
 #include "glshader.h"
 
@@ -224,6 +225,43 @@ Mat4ShaderParameter::operator=(const Eigen::Matrix4f& v)
 }
 
 
+Vec4ArrayShaderParameter::Vec4ArrayShaderParameter() :
+    slot(-1)
+{
+}
+
+Vec4ArrayShaderParameter::Vec4ArrayShaderParameter(GLuint obj, const char* name)
+{
+    slot = glGetUniformLocation(obj, name);
+}
+
+void
+Vec4ArrayShaderParameter::set(const Eigen::Vector4f* values, int count)
+{
+    // Eigen fixed size vectors are tightly packed
+    if (slot != -1 && count > 0)
+        glUniform4fv(slot, count, values[0].data());
+}
+
+
+Mat4ArrayShaderParameter::Mat4ArrayShaderParameter() :
+    slot(-1)
+{
+}
+
+Mat4ArrayShaderParameter::Mat4ArrayShaderParameter(GLuint obj, const char* name)
+{
+    slot = glGetUniformLocation(obj, name);
+}
+
+void
+Mat4ArrayShaderParameter::set(const Eigen::Matrix4f* values, int count)
+{
+    if (slot != -1 && count > 0)
+        glUniformMatrix4fv(slot, count, GL_FALSE, values[0].data());
+}
+
+
 //************* GLProgram **************
 
 GLProgram::GLProgram(GLuint _id) :
@@ -232,8 +270,14 @@ GLProgram::GLProgram(GLuint _id) :
 }
 
 
+GLuint GLProgram::current = 0;
+
+
 GLProgram::~GLProgram()
 {
+    // A new program may get the same id
+    if (current == id)
+        current = 0;
     glDeleteProgram(id);
 }
 
@@ -241,7 +285,20 @@ GLProgram::~GLProgram()
 void
 GLProgram::use() const
 {
+    if (current == id)
+        return;
+
     glUseProgram(id);
+    current = id;
+    ++celestia::render::frameStats.programChanges;
+}
+
+
+void
+GLProgram::useNone()
+{
+    glUseProgram(0);
+    current = 0;
 }
 
 
@@ -256,7 +313,29 @@ GLShaderStatus
 GLProgram::link()
 {
     glLinkProgram(id);
+    return getLinkStatus();
+}
+
+
+void
+GLProgram::startLink()
+{
+    glLinkProgram(id);
+}
+
+
+bool
+GLProgram::isLinkComplete() const
+{
+    GLint complete = GL_TRUE;
+    glGetProgramiv(id, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete == GL_TRUE;
+}
+
 
+GLShaderStatus
+GLProgram::getLinkStatus() const
+{
     GLint linkSuccess;
     glGetProgramiv(id, GL_LINK_STATUS, &linkSuccess);
     if (linkSuccess != GL_TRUE)
@@ -273,6 +352,33 @@ GLProgram::link()
 }
 
 
+void
+GLProgram::setBinaryRetrievable()
+{
+    if (celestia::gl::ARB_get_program_binary)
+        glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+
+bool
+GLProgram::getBinary(GLenum& format, std::vector<char>& binary) const
+{
+    if (!celestia::gl::ARB_get_program_binary)
+        return false;
+
+    GLint length = 0;
+    glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return false;
+
+    binary.resize(length);
+    GLsizei written = 0;
+    glGetProgramBinary(id, length, &written, &format, binary.data());
+    binary.resize(written);
+    return written > 0;
+}
+
+
 //************* GLShaderLoader ************
 
 GLShaderStatus
@@ -521,3 +627,58 @@ GLShaderLoader::CreateProgram(const std::string& vsSource,
 
     return CreateProgram(vsSourceVec, gsSourceVec, fsSourceVec, progOut);
 }
+
+
+GLShaderStatus
+GLShaderLoader::CreateProgramAsync(const std::string& vsSource,
+                                   const std::string& fsSource,
+                                   GLProgram** progOut)
+{
+    GLuint progid = glCreateProgram();
+    auto* prog = new GLProgram(progid);
+
+    auto compile = [progid](GLenum type, const std::string& source)
+    {
+        GLuint shader = glCreateShader(type);
+        const char* sourceString = source.c_str();
+        glShaderSource(shader, 1, &sourceString, nullptr);
+        glCompileShader(shader);
+        glAttachShader(progid, shader);
+        // The shader is only flagged for deletion as long as it's attached
+        glDeleteShader(shader);
+    };
+
+    compile(GL_VERTEX_SHADER, vsSource);
+    compile(GL_FRAGMENT_SHADER, fsSource);
+
+    *progOut = prog;
+
+    return ShaderStatus_OK;
+}
+
+
+GLShaderStatus
+GLShaderLoader::CreateProgramFromBinary(GLenum format,
+                                        const std::vector<char>& binary,
+                                        GLProgram** progOut)
+{
+    if (!celestia::gl::ARB_get_program_binary || binary.empty())
+        return ShaderStatus_EmptyProgram;
+
+    GLuint progid = glCreateProgram();
+    auto* prog = new GLProgram(progid);
+
+    glProgramBinary(progid, format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+    GLint linkSuccess;
+    glGetProgramiv(progid, GL_LINK_STATUS, &linkSuccess);
+    if (linkSuccess != GL_TRUE)
+    {
+        delete prog;
+        return ShaderStatus_LinkError;
+    }
+
+    *progOut = prog;
+
+    return ShaderStatus_OK;
+}
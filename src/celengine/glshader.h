@@ -84,13 +84,29 @@ class GLProgram
     virtual ~GLProgram();
 
     GLShaderStatus link();
-
+    // Start linking without waiting for the result; isLinkComplete()
+    // tells when getLinkStatus() won't block any more. Requires
+    // KHR_parallel_shader_compile.
+    void startLink();
+    bool isLinkComplete() const;
+    GLShaderStatus getLinkStatus() const;
+
+    // Ask the driver to keep the binary of the program once it is linked,
+    // so that getBinary() can retrieve it. Must be called before link().
+    void setBinaryRetrievable();
+    bool getBinary(GLenum& format, std::vector<char>& binary) const;
+
+    // Programs already in use aren't made current again
     void use() const;
+    // Stop using any program; for fixed function drawing
+    static void useNone();
     GLuint getID() const { return id; }
 
  private:
     GLuint id;
 
+    static GLuint current;
+
  friend class GLShaderLoader;
 };
 
@@ -173,6 +189,33 @@ class Mat4ShaderParameter
 };
 
 
+// Uniform arrays, set count elements at a time starting with the first
+class Vec4ArrayShaderParameter
+{
+ public:
+    Vec4ArrayShaderParameter();
+    Vec4ArrayShaderParameter(GLuint obj, const char* name);
+
+    void set(const Eigen::Vector4f* values, int count);
+
+ private:
+    int slot;
+};
+
+
+class Mat4ArrayShaderParameter
+{
+ public:
+    Mat4ArrayShaderParameter();
+    Mat4ArrayShaderParameter(GLuint obj, const char* name);
+
+    void set(const Eigen::Matrix4f* values, int count);
+
+ private:
+    int slot;
+};
+
+
 class GLShaderLoader
 {
  public:
@@ -208,6 +251,16 @@ class GLShaderLoader
                                         const std::string& fsSource,
                                         const std::string& gsSource,
                                         GLProgram**);
+    // Create a program from the sources without waiting for the shaders
+    // to compile; compile errors are reported when it is linked.
+    static GLShaderStatus CreateProgramAsync(const std::string& vsSource,
+                                             const std::string& fsSource,
+                                             GLProgram**);
+    // Create a linked program from a binary previously returned by
+    // GLProgram::getBinary(). Fails if the driver no longer accepts it.
+    static GLShaderStatus CreateProgramFromBinary(GLenum format,
+                                                  const std::vector<char>& binary,
+                                                  GLProgram**);
 };
 
 
@@ -11,8 +11,17 @@ bool OES_geometry_shader            = false;
 #else
 bool ARB_vertex_array_object        = false;
 bool ARB_framebuffer_object         = false;
+bool ARB_timer_query                = false;
+bool ARB_direct_state_access        = false;
+bool ARB_multi_draw_indirect        = false;
 #endif
+bool ARB_buffer_storage             = false;
+bool ARB_clip_control               = false;
+bool ARB_get_program_binary         = false;
+bool ARB_half_float_vertex          = false;
+bool ARB_instanced_arrays          = false;
 bool ARB_shader_texture_lod         = false;
+bool KHR_parallel_shader_compile    = false;
 bool EXT_texture_compression_s3tc   = false;
 bool EXT_texture_filter_anisotropic = false;
 bool MESA_pack_invert               = false;
@@ -48,8 +57,50 @@ bool init(util::array_view<std::string> ignore) noexcept
 #else
     ARB_vertex_array_object        = check_extension(ignore, "GL_ARB_vertex_array_object");
     ARB_framebuffer_object         = check_extension(ignore, "GL_ARB_framebuffer_object") || check_extension(ignore, "GL_EXT_framebuffer_object");
+    ARB_timer_query                = checkVersion(GL_3_3) || check_extension(ignore, "GL_ARB_timer_query");
+    // Only the extensions, so that IgnoreGLExtensions selects the older
+    // paths on drivers of all versions
+    ARB_direct_state_access        = check_extension(ignore, "GL_ARB_direct_state_access");
+    ARB_multi_draw_indirect        = check_extension(ignore, "GL_ARB_multi_draw_indirect");
 #endif
     ARB_shader_texture_lod         = check_extension(ignore, "GL_ARB_shader_texture_lod");
+    KHR_parallel_shader_compile    = check_extension(ignore, "GL_KHR_parallel_shader_compile");
+#ifdef GL_ES
+    ARB_get_program_binary         = checkVersion(GLES_3_0);
+#else
+    ARB_get_program_binary         = check_extension(ignore, "GL_ARB_get_program_binary");
+#endif
+#ifdef GL_ES
+    ARB_buffer_storage             = checkVersion(GLES_3_0) && check_extension(ignore, "GL_EXT_buffer_storage");
+#else
+    // Persistent mappings are only useful with fences
+    ARB_buffer_storage             = (checkVersion(GL_3_2) || check_extension(ignore, "GL_ARB_sync")) &&
+                                     check_extension(ignore, "GL_ARB_buffer_storage");
+#endif
+#ifdef GL_ES
+    ARB_clip_control               = check_extension(ignore, "GL_EXT_clip_control");
+#else
+    ARB_clip_control               = check_extension(ignore, "GL_ARB_clip_control");
+#endif
+#ifdef GL_ES
+    ARB_half_float_vertex          = checkVersion(GLES_3_0);
+#else
+    ARB_half_float_vertex          = checkVersion(GL_3_0) || check_extension(ignore, "GL_ARB_half_float_vertex");
+#endif
+#ifdef GL_ES
+    ARB_instanced_arrays           = checkVersion(GLES_3_0);
+#else
+    ARB_instanced_arrays           = checkVersion(GL_3_3) ||
+                                     (check_extension(ignore, "GL_ARB_instanced_arrays") &&
+                                      check_extension(ignore, "GL_ARB_draw_instanced"));
+#endif
+    if (ARB_get_program_binary)
+    {
+        // Some drivers support the API but no binary formats
+        GLint nFormats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nFormats);
+        ARB_get_program_binary = nFormats > 0;
+    }
     EXT_texture_compression_s3tc   = check_extension(ignore, "GL_EXT_texture_compression_s3tc");
     EXT_texture_filter_anisotropic = check_extension(ignore, "GL_EXT_texture_filter_anisotropic") || check_extension(ignore, "GL_ARB_texture_filter_anisotropic");
     MESA_pack_invert               = check_extension(ignore, "GL_MESA_pack_invert");
@@ -91,6 +142,26 @@ bool hasGeomShader() noexcept
 #endif
 }
 
+bool hasIndirectDraws() noexcept
+{
+#ifdef GL_ES
+    return false;
+#else
+    return ARB_direct_state_access && ARB_multi_draw_indirect;
+#endif
+}
+
+bool hasReverseDepth() noexcept
+{
+#ifdef GL_ES
+    return ARB_clip_control && checkVersion(GLES_3_0);
+#else
+    // Float depth buffers and multisampled framebuffer blits are core in
+    // GL 3.0
+    return ARB_clip_control && ARB_framebuffer_object && checkVersion(GL_3_0);
+#endif
+}
+
 void enableGeomShaders() noexcept
 {
     EnableGeomShaders = true;
@@ -33,7 +33,13 @@ enum Version
     GLES_3_2 = 32,
 };
 
+extern bool ARB_buffer_storage;
+extern bool ARB_clip_control;
+extern bool ARB_get_program_binary;
+extern bool ARB_half_float_vertex;
+extern bool ARB_instanced_arrays;
 extern bool ARB_shader_texture_lod;
+extern bool KHR_parallel_shader_compile;
 extern bool EXT_texture_compression_s3tc;
 extern bool EXT_texture_filter_anisotropic;
 extern bool MESA_pack_invert;
@@ -44,6 +50,9 @@ extern bool OES_geometry_shader;
 #else
 extern bool ARB_vertex_array_object;
 extern bool ARB_framebuffer_object;
+extern bool ARB_timer_query;
+extern bool ARB_direct_state_access;
+extern bool ARB_multi_draw_indirect;
 #endif
 extern GLint maxPointSize;
 extern GLint maxTextureSize;
@@ -53,6 +62,12 @@ extern GLint maxTextureAnisotropy;
 bool init(util::array_view<std::string> = {}) noexcept;
 bool checkVersion(int) noexcept;
 bool hasGeomShader() noexcept;
+// Whether batches of draw calls are issued with indirect draws from buffers
+// created with direct state access (GL 4.5), rather than one by one
+bool hasIndirectDraws() noexcept;
+// Whether views can be drawn to framebuffers with floating point depth
+// buffers with a [0, 1] clip range, as reverse depth needs
+bool hasReverseDepth() noexcept;
 void enableGeomShaders() noexcept;
 void disableGeomShaders() noexcept;
 
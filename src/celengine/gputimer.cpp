@@ -0,0 +1,99 @@
+// gputimer.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Measuring the GPU time of frames without waiting for the GPU.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "gputimer.h"
+
+namespace gl = celestia::gl;
+
+GPUTimer::GPUTimer()
+{
+    if (isSupported())
+        glGenQueries(static_cast<GLsizei>(m_queries.size()), m_queries.data());
+}
+
+
+GPUTimer::~GPUTimer()
+{
+    if (!isValid())
+        return;
+
+#ifndef GL_ES
+    if (m_active)
+        glEndQuery(GL_TIME_ELAPSED);
+#endif
+    glDeleteQueries(static_cast<GLsizei>(m_queries.size()), m_queries.data());
+}
+
+
+bool
+GPUTimer::isSupported()
+{
+#ifdef GL_ES
+    // Disjoint timer queries need their results checked for interruptions
+    return false;
+#else
+    return gl::ARB_timer_query;
+#endif
+}
+
+
+void
+GPUTimer::begin()
+{
+    if (!isValid() || m_active)
+        return;
+
+    collect();
+    // When the ring is full, the frame isn't timed
+    if (m_pending == m_queries.size())
+        return;
+
+#ifndef GL_ES
+    glBeginQuery(GL_TIME_ELAPSED, m_queries[(m_first + m_pending) % m_queries.size()]);
+#endif
+    m_active = true;
+}
+
+
+void
+GPUTimer::end()
+{
+    if (!m_active)
+        return;
+
+#ifndef GL_ES
+    glEndQuery(GL_TIME_ELAPSED);
+#endif
+    m_active = false;
+    ++m_pending;
+}
+
+
+void
+GPUTimer::collect()
+{
+#ifndef GL_ES
+    while (m_pending > 0)
+    {
+        GLuint query = m_queries[m_first];
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == GL_FALSE)
+            break;
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+        m_latest = static_cast<double>(elapsed) * 1.0e-9;
+        m_first = (m_first + 1) % m_queries.size();
+        --m_pending;
+    }
+#endif
+}
@@ -0,0 +1,53 @@
+// gputimer.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Measuring the GPU time of frames without waiting for the GPU.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include "glsupport.h"
+
+/*! Times frames on the GPU with a ring of time elapsed queries. The result
+ *  of a query is only read once it's available, a frame or two later, so
+ *  the latest time known lags behind the frames drawn. Only one frame can
+ *  be timed at a time, and the GL doesn't allow the queries to be nested.
+ */
+class GPUTimer
+{
+ public:
+    static constexpr std::size_t RingSize = 4;
+
+    GPUTimer();
+    ~GPUTimer();
+
+    GPUTimer(const GPUTimer&) = delete;
+    GPUTimer& operator=(const GPUTimer&) = delete;
+
+    static bool isSupported();
+    bool isValid() const { return m_queries[0] != 0; }
+
+    void begin();
+    void end();
+
+    // GPU time in seconds of the latest frame whose result is available,
+    // negative if there is none yet
+    double latest() const { return m_latest; }
+
+ private:
+    void collect();
+
+    std::array<GLuint, RingSize> m_queries{};
+    std::size_t m_first{ 0 };
+    std::size_t m_pending{ 0 };
+    bool m_active{ false };
+    double m_latest{ -1.0 };
+};
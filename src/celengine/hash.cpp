@@ -8,6 +8,12 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_set>
+
 #include <celmath/mathlib.h>
 #include <celutil/color.h>
 #include <celutil/fsutils.h>
@@ -18,25 +24,67 @@
 namespace celutil = celestia::util;
 
 
+namespace
+{
+
+// Return a view of a copy of the key that lives as long as the program.
+// Objects share the few property names used in catalogs, so keys are
+// stored once rather than with every object.
+std::string_view
+internKey(std::string_view key)
+{
+    static std::shared_mutex mutex;
+    static std::deque<std::string> storage;
+    static std::unordered_set<std::string_view> keys;
+
+    {
+        std::shared_lock lock(mutex);
+        if (auto it = keys.find(key); it != keys.end())
+            return *it;
+    }
+
+    std::unique_lock lock(mutex);
+    if (auto it = keys.find(key); it != keys.end())
+        return *it;
+
+    // The strings in a deque aren't moved as it grows
+    std::string_view interned = storage.emplace_back(key);
+    keys.insert(interned);
+    return interned;
+}
+
+} // end unnamed namespace
+
+
 // Define these here: at declaration the vector member contains an incomplete type
 AssociativeArray::~AssociativeArray() = default;
 
 
+AssociativeArray::AssociativeArray(celutil::Arena* arena) :
+    keys(celutil::ArenaAllocator<std::string_view>(arena)),
+    values(celutil::ArenaAllocator<Value>(arena))
+{
+}
+
+
 const Value* AssociativeArray::getValue(std::string_view key) const
 {
-    auto iter = assoc.find(key);
-    if (iter == assoc.end())
+    auto iter = std::find(keys.begin(), keys.end(), key);
+    if (iter == keys.end())
         return nullptr;
 
-    return &values[iter->second];
+    return &values[static_cast<std::size_t>(iter - keys.begin())];
 }
 
 
-void AssociativeArray::addValue(std::string&& key, Value&& val)
+void AssociativeArray::addValue(std::string_view key, Value&& val)
 {
-    std::size_t index = values.size();
-    if (assoc.try_emplace(std::move(key), index).second)
-        values.emplace_back(std::move(val));
+    // The first definition of a key is kept
+    if (std::find(keys.begin(), keys.end(), key) != keys.end())
+        return;
+
+    keys.push_back(internKey(key));
+    values.push_back(std::move(val));
 }
 
 
@@ -12,7 +12,6 @@
 
 #include <cstddef>
 #include <cstdint>
-#include <map>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -24,6 +23,7 @@
 #include <Eigen/Geometry>
 
 #include <celcompat/filesystem.h>
+#include <celutil/arena.h>
 
 
 class Color;
@@ -32,9 +32,9 @@ class Value;
 class AssociativeArray
 {
  public:
-    using AssocType = std::map<std::string, std::size_t, std::less<>>;
-
     AssociativeArray() = default;
+    // Keep the properties in an arena, which must outlive the array
+    explicit AssociativeArray(celestia::util::Arena*);
     ~AssociativeArray();
     AssociativeArray(AssociativeArray&&) = delete;
     AssociativeArray(const AssociativeArray&) = delete;
@@ -42,7 +42,7 @@ class AssociativeArray
     AssociativeArray& operator=(AssociativeArray&) = delete;
 
     const Value* getValue(std::string_view) const;
-    void addValue(std::string&&, Value&&);
+    void addValue(std::string_view, Value&&);
 
     template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
     std::optional<T> getNumber(std::string_view key) const
@@ -140,17 +140,19 @@ class AssociativeArray
     template<typename T>
     void for_all(T action) const
     {
-        for (const auto& [key, value] : assoc)
+        for (std::size_t i = 0; i < keys.size(); i++)
         {
-            action(key, values[value]);
+            action(keys[i], values[i]);
         }
     }
 
  private:
-    // At this point, Value is an incomplete type. C++17 allows us to store
-    // this in a vector but not a map, so use the map to store vector indices
-    std::vector<Value> values;
-    AssocType assoc;
+    // The keys and values in the order they were read. Catalog objects have
+    // at most a few dozen properties, and a linear search of their keys is
+    // faster than the lookups and allocations of a tree. Keys are interned,
+    // as the same few property names are used by all objects.
+    std::vector<std::string_view, celestia::util::ArenaAllocator<std::string_view>> keys;
+    std::vector<Value, celestia::util::ArenaAllocator<Value>> values;
 
     std::optional<double> getNumberImpl(std::string_view) const;
     std::optional<Eigen::Vector3d> getVector3Impl(std::string_view) const;
@@ -9,6 +9,9 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <thread>
+#include <vector>
 #include <celengine/glsupport.h>
 #include <celutil/logger.h>
 #include <celutil/filetype.h>
@@ -57,6 +60,72 @@ int formatComponents(PixelFormat fmt)
     }
 }
 
+// Height maps with at least this many pixels are converted on several threads
+constexpr int ParallelMinPixels = 1024 * 1024;
+
+// Run body(firstRow, endRow) over bands of rows, on several threads for
+// large images
+template<typename F>
+void forEachRowBand(int height, int width, F&& body)
+{
+    unsigned int nThreads = std::thread::hardware_concurrency();
+    if (nThreads < 2 || static_cast<long long>(width) * height < ParallelMinPixels)
+    {
+        body(0, height);
+        return;
+    }
+
+    nThreads = min(nThreads, static_cast<unsigned int>(height));
+    int bandHeight = (height + static_cast<int>(nThreads) - 1) / static_cast<int>(nThreads);
+    std::vector<std::thread> workers;
+    for (int firstRow = bandHeight; firstRow < height; firstRow += bandHeight)
+        workers.emplace_back([&body, firstRow, bandHeight, height]() { body(firstRow, min(firstRow + bandHeight, height)); });
+    body(0, min(bandHeight, height));
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+float decodeNormal(uint8_t c)
+{
+    return (static_cast<float>(c) - 128.0f) * (1.0f / 127.0f);
+}
+
+// Fill mip level mip of a normal map from the level above it
+void downsampleNormals(Image& normalMap, int mip)
+{
+    int srcWidth = max(normalMap.getWidth() >> (mip - 1), 1);
+    int srcHeight = max(normalMap.getHeight() >> (mip - 1), 1);
+    int mipWidth = max(srcWidth / 2, 1);
+    int mipHeight = max(srcHeight / 2, 1);
+
+    forEachRowBand(mipHeight, mipWidth, [&](int firstRow, int endRow)
+    {
+        for (int y = firstRow; y < endRow; y++)
+        {
+            const uint8_t* src0 = normalMap.getPixelRow(mip - 1, min(y * 2, srcHeight - 1));
+            const uint8_t* src1 = normalMap.getPixelRow(mip - 1, min(y * 2 + 1, srcHeight - 1));
+            uint8_t* dst = normalMap.getPixelRow(mip, y);
+            for (int x = 0; x < mipWidth; x++)
+            {
+                int x0 = min(x * 2, srcWidth - 1) * 4;
+                int x1 = min(x * 2 + 1, srcWidth - 1) * 4;
+                float n[3];
+                for (int c = 0; c < 3; c++)
+                {
+                    n[c] = decodeNormal(src0[x0 + c]) + decodeNormal(src0[x1 + c])
+                         + decodeNormal(src1[x0 + c]) + decodeNormal(src1[x1 + c]);
+                }
+
+                float mag = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                float rmag = mag > 0.0f ? 1.0f / mag : 0.0f;
+                for (int c = 0; c < 3; c++)
+                    dst[x * 4 + c] = static_cast<uint8_t>(128.0f + 127.0f * n[c] * rmag);
+                dst[x * 4 + 3] = 255;
+            }
+        }
+    });
+}
+
 int calcMipLevelSize(PixelFormat fmt, int w, int h, int mip)
 {
     w = max(w >> mip, 1);
@@ -146,7 +215,7 @@ const uint8_t* Image::getPixels() const
 
 uint8_t* Image::getPixelRow(int mip, int row)
 {
-    /*int w = max(width >> mip, 1); Unused*/
+    int w = max(width >> mip, 1);
     int h = max(height >> mip, 1);
     if (mip >= mipLevels || row >= h)
         return nullptr;
@@ -155,7 +224,8 @@ uint8_t* Image::getPixelRow(int mip, int row)
     if (isCompressed())
         return nullptr;
 
-    return getMipLevel(mip) + row * pitch;
+    // Rows of smaller mip levels are padded on their own
+    return getMipLevel(mip) + row * pad(w * components);
 }
 
 uint8_t* Image::getPixelRow(int row)
@@ -229,29 +299,37 @@ bool Image::hasAlpha() const
  * input should be used.  If not, the first color channel of the input image
  * is the one only one used when generating normals.  This produces the
  * expected results for grayscale values in RGB images.
+ *
+ * If mipMaps is set, the normal map gets a full set of mip levels, averaging
+ * and renormalizing the normals of each 2x2 block of the level above.
  */
 std::unique_ptr<Image>
-Image::computeNormalMap(float scale, bool wrap) const
+Image::computeNormalMap(float scale, bool wrap, bool mipMaps) const
 {
     // Can't do anything with compressed input; there are probably some other
     // formats that should be rejected as well . . .
     if (isCompressed())
         return nullptr;
 
-    auto normalMap = std::make_unique<Image>(PixelFormat::RGBA, width, height);
+    int mipCount = 1;
+    if (mipMaps)
+    {
+        for (int w = width, h = height; w > 1 || h > 1; w = max(w / 2, 1), h = max(h / 2, 1))
+            mipCount++;
+    }
 
-    uint8_t* nmPixels = normalMap->getPixels();
-    int nmPitch = normalMap->getPitch();
+    auto normalMap = std::make_unique<Image>(PixelFormat::RGBA, width, height, mipCount);
+    const float rowScale = (1.0f / 255.0f) * scale;
 
-    // Compute normals using differences between adjacent texels.
-    for (int i = 0; i < height; i++)
+    // Compute normals using differences between adjacent texels. The
+    // previous row and column are the next ones for the first row and
+    // column, unless the map wraps.
+    forEachRowBand(height, width, [&](int firstRow, int endRow)
     {
-        for (int j = 0; j < width; j++)
+        for (int i = firstRow; i < endRow; i++)
         {
             int i0 = i;
-            int j0 = j;
             int i1 = i - 1;
-            int j1 = j - 1;
             if (i1 < 0)
             {
                 if (wrap)
@@ -260,40 +338,45 @@ Image::computeNormalMap(float scale, bool wrap) const
                 }
                 else
                 {
-                    i0++;
-                    i1++;
+                    i0 = min(1, height - 1);
+                    i1 = 0;
                 }
             }
-            if (j1 < 0)
-            {
-                if (wrap)
-                {
-                    j1 = width - 1;
-                }
-                else
-                {
-                    j0++;
-                    j1++;
-                }
-            }
-
-            auto h00 = (int) pixels[i0 * pitch + j0 * components];
-            auto h10 = (int) pixels[i0 * pitch + j1 * components];
-            auto h01 = (int) pixels[i1 * pitch + j0 * components];
-
-            float dx = (float) (h10 - h00) * (1.0f / 255.0f) * scale;
-            float dy = (float) (h01 - h00) * (1.0f / 255.0f) * scale;
 
-            auto mag = (float) sqrt(dx * dx + dy * dy + 1.0f);
-            float rmag = 1.0f / mag;
+            const uint8_t* row0 = pixels.get() + i0 * pitch;
+            const uint8_t* row1 = pixels.get() + i1 * pitch;
+            uint8_t* nmRow = normalMap->getPixelRow(i);
 
-            int n = i * nmPitch + j * 4;
-            nmPixels[n]     = (uint8_t) (128 + 127 * dx * rmag);
-            nmPixels[n + 1] = (uint8_t) (128 + 127 * dy * rmag);
-            nmPixels[n + 2] = (uint8_t) (128 + 127 * rmag);
-            nmPixels[n + 3] = 255;
+            auto computeNormal = [&](int j, int j0, int j1)
+            {
+                float h00 = row0[j0 * components];
+                float h10 = row0[j1 * components];
+                float h01 = row1[j0 * components];
+
+                float dx = (h10 - h00) * rowScale;
+                float dy = (h01 - h00) * rowScale;
+                float rmag = 1.0f / std::sqrt(dx * dx + dy * dy + 1.0f);
+
+                uint8_t* n = nmRow + j * 4;
+                n[0] = static_cast<uint8_t>(128.0f + 127.0f * dx * rmag);
+                n[1] = static_cast<uint8_t>(128.0f + 127.0f * dy * rmag);
+                n[2] = static_cast<uint8_t>(128.0f + 127.0f * rmag);
+                n[3] = 255;
+            };
+
+            if (wrap)
+                computeNormal(0, 0, width - 1);
+            else
+                computeNormal(0, min(1, width - 1), 0);
+
+            // Branch-free for the rest of the row
+            for (int j = 1; j < width; j++)
+                computeNormal(j, j, j - 1);
         }
-    }
+    });
+
+    for (int mip = 1; mip < mipCount; mip++)
+        downsampleNormals(*normalMap, mip);
 
     return normalMap;
 }
@@ -325,6 +408,9 @@ std::unique_ptr<Image> LoadImageFromFile(const fs::path& filename)
     case ContentType::DXT5NormalMap:
         img = LoadDDSImage(filename);
         break;
+    case ContentType::KTX2:
+        img = LoadKTXImage(filename);
+        break;
     default:
         GetLogger()->error("{}: unrecognized or unsupported image file type.\n", filename);
         break;
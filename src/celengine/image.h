@@ -49,7 +49,7 @@ class Image
     bool isCompressed() const;
     bool hasAlpha() const;
 
-    std::unique_ptr<Image> computeNormalMap(float scale, bool wrap) const;
+    std::unique_ptr<Image> computeNormalMap(float scale, bool wrap, bool mipMaps = false) const;
 
     enum
     {
@@ -0,0 +1,101 @@
+// labelcache.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Labels of stars and deep sky objects, kept across frames.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "labelcache.h"
+
+#include <cstddef>
+#include <utility>
+
+#include "deepskyobj.h"
+#include "dsodb.h"
+#include "dsoname.h"
+#include "star.h"
+#include "stardb.h"
+#include "starname.h"
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+// The labels are dropped when there are more than this, as the stars
+// labeled change when travelling
+constexpr std::size_t MaxLabels = 65536;
+
+} // end unnamed namespace
+
+
+void
+LabelCache::Catalog::update(const NameDatabase* namesDB)
+{
+    std::uint32_t namesGeneration = namesDB == nullptr ? 0 : namesDB->getGeneration();
+    if (namesDB != names || namesGeneration != generation || labels.size() > MaxLabels)
+    {
+        labels.clear();
+        names = namesDB;
+        generation = namesGeneration;
+    }
+}
+
+
+LabelCache::Label&
+LabelCache::Catalog::add(AstroCatalog::IndexNumber catalogNumber, std::string&& text)
+{
+    Label& label = labels[catalogNumber];
+    label.text = std::move(text);
+    // Names which aren't valid UTF-8 are rendered as no text, as they were
+    // when shaped in every frame
+    if (!TextLayout::shape(label.text, label.shaped))
+        label.shaped.lines.clear();
+    return label;
+}
+
+
+void
+LabelCache::update(const StarDatabase* starDB, const DSODatabase* dsoDB)
+{
+    stars.update(starDB == nullptr ? nullptr : starDB->getNameDatabase());
+    dsos.update(dsoDB == nullptr ? nullptr : dsoDB->getNameDatabase());
+}
+
+
+void
+LabelCache::clear()
+{
+    stars.labels.clear();
+    dsos.labels.clear();
+}
+
+
+const LabelCache::Label*
+LabelCache::getStarLabel(const StarDatabase& starDB, const Star& star)
+{
+    AstroCatalog::IndexNumber catalogNumber = star.getIndex();
+    if (auto it = stars.labels.find(catalogNumber); it != stars.labels.end())
+        return &it->second;
+
+    return &stars.add(catalogNumber, starDB.getStarName(star, true));
+}
+
+
+const LabelCache::Label*
+LabelCache::getDSOLabel(const DSODatabase& dsoDB, const DeepSkyObject* dso)
+{
+    AstroCatalog::IndexNumber catalogNumber = dso->getIndex();
+    auto it = dsos.labels.find(catalogNumber);
+    const Label& label = it == dsos.labels.end()
+        ? dsos.add(catalogNumber, dsoDB.getDSOName(dso, true))
+        : it->second;
+    return label.text.empty() ? nullptr : &label;
+}
+
+} // end namespace celestia::engine
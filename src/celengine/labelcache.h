@@ -0,0 +1,68 @@
+// labelcache.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Labels of stars and deep sky objects, kept across frames.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include <celengine/astroobj.h>
+#include <celengine/textlayout.h>
+
+class DeepSkyObject;
+class DSODatabase;
+class NameDatabase;
+class Star;
+class StarDatabase;
+
+namespace celestia::engine
+{
+
+/*! Labels of stars and deep sky objects by catalog number, with their
+ *  names localized and shaped for rendering once rather than in every
+ *  frame they are shown in. The labels stay valid until the next call to
+ *  update, which drops them when the names change or when there are too
+ *  many, so update must not be called while annotations refer to them.
+ */
+class LabelCache
+{
+ public:
+    struct Label
+    {
+        std::string text;
+        TextLayout::ShapedText shaped;
+    };
+
+    // Check whether the names changed since the last frame
+    void update(const StarDatabase* starDB, const DSODatabase* dsoDB);
+    void clear();
+
+    const Label* getStarLabel(const StarDatabase& starDB, const Star& star);
+    // Return nullptr for objects without a name
+    const Label* getDSOLabel(const DSODatabase& dsoDB, const DeepSkyObject* dso);
+
+ private:
+    struct Catalog
+    {
+        const NameDatabase* names{ nullptr };
+        std::uint32_t generation{ 0 };
+        std::unordered_map<AstroCatalog::IndexNumber, Label> labels;
+
+        void update(const NameDatabase* namesDB);
+        Label& add(AstroCatalog::IndexNumber catalogNumber, std::string&& text);
+    };
+
+    Catalog stars;
+    Catalog dsos;
+};
+
+} // end namespace celestia::engine
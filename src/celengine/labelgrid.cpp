@@ -0,0 +1,128 @@
+// labelgrid.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Finding overlaps between the labels placed on the screen.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "labelgrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+bool
+intersects(const LabelGrid::Box& a, const LabelGrid::Box& b)
+{
+    return a.left < b.right && b.left < a.right && a.bottom < b.top && b.bottom < a.top;
+}
+
+} // end unnamed namespace
+
+
+void
+LabelGrid::reset(int _width, int _height, int _cellSize)
+{
+    width = std::max(_width, 0);
+    height = std::max(_height, 0);
+    cellSize = std::max(_cellSize, 1);
+    columns = (width + cellSize - 1) / cellSize;
+    rows = (height + cellSize - 1) / cellSize;
+
+    boxes.clear();
+    auto cellCount = static_cast<std::size_t>(columns) * static_cast<std::size_t>(rows);
+    if (cells.size() > cellCount)
+        cells.resize(cellCount);
+    for (auto& cell : cells)
+        cell.clear();
+    cells.resize(cellCount);
+}
+
+
+void
+LabelGrid::add(const Box& box)
+{
+    CellRange range;
+    if (getCells(box, range))
+        insert(box, range);
+}
+
+
+bool
+LabelGrid::tryAdd(const Box& box)
+{
+    if (overlaps(box))
+        return false;
+
+    add(box);
+    return true;
+}
+
+
+bool
+LabelGrid::overlaps(const Box& box) const
+{
+    CellRange range;
+    if (!getCells(box, range))
+        return false;
+
+    for (int row = range.firstRow; row <= range.lastRow; row++)
+    {
+        for (int column = range.firstColumn; column <= range.lastColumn; column++)
+        {
+            for (std::uint32_t index : cells[row * columns + column])
+            {
+                if (intersects(box, boxes[index]))
+                    return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+
+bool
+LabelGrid::getCells(const Box& box, CellRange& range) const
+{
+    if (!(box.right > 0.0f && box.left < static_cast<float>(width) &&
+          box.top > 0.0f && box.bottom < static_cast<float>(height) &&
+          box.left < box.right && box.bottom < box.top))
+    {
+        return false;
+    }
+
+    auto cell = [this](float x, int count)
+    {
+        return std::clamp(static_cast<int>(std::floor(x / static_cast<float>(cellSize))), 0, count - 1);
+    };
+    range.firstColumn = cell(box.left, columns);
+    range.lastColumn = cell(box.right, columns);
+    range.firstRow = cell(box.bottom, rows);
+    range.lastRow = cell(box.top, rows);
+    return true;
+}
+
+
+void
+LabelGrid::insert(const Box& box, const CellRange& range)
+{
+    auto index = static_cast<std::uint32_t>(boxes.size());
+    boxes.push_back(box);
+    for (int row = range.firstRow; row <= range.lastRow; row++)
+    {
+        for (int column = range.firstColumn; column <= range.lastColumn; column++)
+            cells[row * columns + column].push_back(index);
+    }
+}
+
+} // end namespace celestia::engine
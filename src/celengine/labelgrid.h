@@ -0,0 +1,72 @@
+// labelgrid.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Finding overlaps between the labels placed on the screen.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace celestia::engine
+{
+
+/*! The boxes of the labels placed on the screen so far, binned into a grid
+ *  of square cells so that a new box is only checked against the boxes in
+ *  the cells it covers. Boxes are in pixels, with y up.
+ */
+class LabelGrid
+{
+ public:
+    static constexpr int DefaultCellSize = 64;
+
+    struct Box
+    {
+        float left;
+        float bottom;
+        float right;
+        float top;
+    };
+
+    // Remove all the boxes and cover a screen of width by height pixels
+    void reset(int width, int height, int cellSize = DefaultCellSize);
+
+    // Add a box whatever it overlaps
+    void add(const Box& box);
+    // Add a box unless it overlaps one added before, returning whether it
+    // was added. Boxes entirely off the screen are never added but don't
+    // overlap anything either.
+    bool tryAdd(const Box& box);
+
+    bool overlaps(const Box& box) const;
+
+ private:
+    struct CellRange
+    {
+        int firstColumn;
+        int firstRow;
+        int lastColumn;
+        int lastRow;
+    };
+
+    bool getCells(const Box& box, CellRange& range) const;
+    void insert(const Box& box, const CellRange& range);
+
+    int width{ 0 };
+    int height{ 0 };
+    int cellSize{ DefaultCellSize };
+    int columns{ 0 };
+    int rows{ 0 };
+    std::vector<Box> boxes;
+    // Indices into boxes of those covering each cell, row by row. The
+    // vectors are kept from frame to frame so they don't allocate again.
+    std::vector<std::vector<std::uint32_t>> cells;
+};
+
+} // end namespace celestia::engine
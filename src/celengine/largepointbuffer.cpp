@@ -0,0 +1,139 @@
+// largepointbuffer.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <cstddef>
+#include "glsupport.h"
+#include <celutil/color.h>
+#include "largepointbuffer.h"
+#include "render.h"
+#include "shadermanager.h"
+#include "texture.h"
+
+namespace
+{
+
+constexpr float CornerTexCoords[][2] =
+{
+    { 0.0f, 0.0f },
+    { 0.0f, 1.0f },
+    { 1.0f, 1.0f },
+
+    { 0.0f, 0.0f },
+    { 1.0f, 1.0f },
+    { 1.0f, 0.0f },
+};
+
+} // end unnamed namespace
+
+LargePointBuffer::LargePointBuffer(const Renderer &renderer,
+                                   capacity_t capacity) :
+    m_renderer(renderer),
+    m_capacity(capacity),
+    m_vertices(std::make_unique<PointVertex[]>(capacity * VerticesPerPoint)),
+    m_vao(renderer.getStreamBuffer())
+{
+}
+
+void LargePointBuffer::addPoint(const Eigen::Vector3f &pos,
+                                const Color &color,
+                                float size)
+{
+    PointVertex* vertices = &m_vertices[m_nPoints * VerticesPerPoint];
+    for (unsigned int i = 0; i < VerticesPerPoint; i++)
+    {
+        vertices[i].position = pos;
+        vertices[i].size = size;
+        color.get(vertices[i].color);
+        vertices[i].texCoord[0] = CornerTexCoords[i][0];
+        vertices[i].texCoord[1] = CornerTexCoords[i][1];
+    }
+
+    if (++m_nPoints == m_capacity)
+        render();
+}
+
+void LargePointBuffer::render()
+{
+    if (m_nPoints == 0)
+        return;
+
+    auto *prog = m_renderer.getShaderManager().getShader("largestar");
+    if (prog == nullptr)
+    {
+        m_nPoints = 0;
+        return;
+    }
+
+    prog->use();
+    prog->samplerParam("starTex") = 0;
+    prog->setMVPMatrices(m_renderer.getCurrentProjectionMatrix(), m_renderer.getCurrentModelViewMatrix());
+    prog->floatParam("pixelWidth") = 2.0f / static_cast<float>(m_renderer.getWindowWidth());
+    prog->floatParam("pixelHeight") = 2.0f / static_cast<float>(m_renderer.getWindowHeight());
+
+    if (m_texture != nullptr)
+        m_texture->bind();
+
+    setupVertexArrayObject();
+    auto count = static_cast<GLsizei>(m_nPoints * VerticesPerPoint);
+    GLint first = m_vao.stream(m_vertices.get(), count, sizeof(PointVertex));
+    if (first >= 0)
+        m_vao.draw(GL_TRIANGLES, count, first);
+    m_vao.unbind();
+
+    m_nPoints = 0;
+}
+
+void LargePointBuffer::setupVertexArrayObject()
+{
+    if (m_vao.initialized())
+    {
+        m_vao.bindWritable();
+    }
+    else
+    {
+        m_vao.bind();
+
+        m_vao.setVertexAttribArray(
+            CelestiaGLProgram::VertexCoordAttributeIndex,
+            3,
+            GL_FLOAT,
+            false,
+            sizeof(PointVertex),
+            offsetof(PointVertex, position));
+
+        m_vao.setVertexAttribArray(
+            CelestiaGLProgram::ColorAttributeIndex,
+            4,
+            GL_UNSIGNED_BYTE,
+            true,
+            sizeof(PointVertex),
+            offsetof(PointVertex, color));
+
+        m_vao.setVertexAttribArray(
+            CelestiaGLProgram::PointSizeAttributeIndex,
+            1,
+            GL_FLOAT,
+            false,
+            sizeof(PointVertex),
+            offsetof(PointVertex, size));
+
+        m_vao.setVertexAttribArray(
+            CelestiaGLProgram::TextureCoord0AttributeIndex,
+            2,
+            GL_FLOAT,
+            false,
+            sizeof(PointVertex),
+            offsetof(PointVertex, texCoord));
+    }
+}
+
+void LargePointBuffer::setTexture(Texture *texture)
+{
+    m_texture = texture;
+}
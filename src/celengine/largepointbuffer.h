@@ -0,0 +1,61 @@
+// largepointbuffer.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <memory>
+#include <Eigen/Core>
+#include <celrender/vertexobject.h>
+
+class Color;
+class Renderer;
+class Texture;
+
+// LargePointBuffer collects the points which are larger than the largest
+// point sprite the hardware supports, and draws them as textured
+// billboards all at once.
+class LargePointBuffer
+{
+public:
+    using capacity_t = unsigned int;
+
+    LargePointBuffer(const Renderer &renderer, capacity_t capacity);
+    ~LargePointBuffer() = default;
+    LargePointBuffer() = delete;
+    LargePointBuffer(const LargePointBuffer&) = delete;
+    LargePointBuffer(LargePointBuffer&&) = delete;
+    LargePointBuffer& operator=(const LargePointBuffer&) = delete;
+    LargePointBuffer& operator=(LargePointBuffer&&) = delete;
+
+    void render();
+    void addPoint(const Eigen::Vector3f &pos, const Color &color, float size);
+    void setTexture(Texture* texture);
+
+private:
+    // Each point is a quad of two triangles; its vertices differ only by
+    // the corner texture coordinates.
+    static constexpr unsigned int VerticesPerPoint = 6;
+
+    struct PointVertex
+    {
+        Eigen::Vector3f position;
+        float size;
+        unsigned char color[4];
+        float texCoord[2];
+    };
+
+    const Renderer                 &m_renderer;
+    capacity_t                      m_capacity;
+    capacity_t                      m_nPoints               { 0 };
+    std::unique_ptr<PointVertex[]>  m_vertices;
+    Texture                        *m_texture               { nullptr };
+    celestia::render::VertexObject  m_vao;
+
+    void setupVertexArrayObject();
+};
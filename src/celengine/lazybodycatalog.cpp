@@ -0,0 +1,248 @@
+// lazybodycatalog.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Minor bodies whose Body objects are only created when needed.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "lazybodycatalog.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+#include <celmath/mathlib.h>
+#include <celutil/memoryreport.h>
+#include <celutil/utf8.h>
+#include "astro.h"
+#include "hash.h"
+#include "solarsys.h"
+#include "value.h"
+
+namespace
+{
+
+std::uint32_t
+hashName(std::string_view name)
+{
+    // Names which UTF8StringCompare finds equal have the same folded form
+    std::string folded;
+    if (!UTF8FoldCase(name, folded))
+        folded = name;
+    return static_cast<std::uint32_t>(std::hash<std::string>()(folded));
+}
+
+} // end unnamed namespace
+
+
+LazyBodyCatalog::LazyBodyCatalog(PlanetarySystem* _system, Universe* _universe) :
+    system(_system),
+    universe(_universe)
+{
+}
+
+
+bool
+LazyBodyCatalog::add(const Definition& definition)
+{
+    const EllipticalOrbitElements& orbit = definition.orbit;
+    if (!orbits.add(orbit.pericenterDistance,
+                    orbit.eccentricity,
+                    orbit.inclination,
+                    orbit.ascendingNode,
+                    orbit.argOfPeriapsis,
+                    orbit.meanAnomalyAtEpoch,
+                    orbit.period,
+                    orbit.epoch))
+    {
+        return false;
+    }
+
+    auto index = static_cast<std::uint32_t>(bodies.size());
+
+    nameOffsets.push_back(static_cast<std::uint32_t>(names.size()));
+    for (const auto& name : definition.names)
+    {
+        if (name.empty())
+            continue;
+        names.append(name);
+        names.push_back('\0');
+        insertName(name, index);
+    }
+
+    radii.push_back(definition.radius);
+    geomAlbedos.push_back(definition.geomAlbedo);
+    bodies.push_back(nullptr);
+    return true;
+}
+
+
+// Return the name at offset in the names string, and move the offset to the
+// next name; the result is empty once all names of the entry have been read.
+std::string_view
+LazyBodyCatalog::getName(std::uint32_t index, std::uint32_t& offset) const
+{
+    std::uint32_t end = index + 1 < size() ? nameOffsets[index + 1] : static_cast<std::uint32_t>(names.size());
+    if (offset >= end)
+        return {};
+
+    std::string_view name(names.data() + offset);
+    offset += static_cast<std::uint32_t>(name.size()) + 1;
+    return name;
+}
+
+
+void
+LazyBodyCatalog::insertName(std::string_view name, std::uint32_t index)
+{
+    if ((nameCount + 1) * 2 > nameSlots.size())
+        growNameTable();
+
+    std::uint32_t hash = hashName(name);
+    std::size_t mask = nameSlots.size() - 1;
+    std::size_t slot = hash & mask;
+    while (nameSlots[slot].index != InvalidIndex)
+        slot = (slot + 1) & mask;
+
+    nameSlots[slot].hash = hash;
+    nameSlots[slot].index = index;
+    ++nameCount;
+}
+
+
+void
+LazyBodyCatalog::growNameTable()
+{
+    std::vector<NameSlot> oldSlots(std::max<std::size_t>(nameSlots.size() * 2, 1024));
+    oldSlots.swap(nameSlots);
+
+    std::size_t mask = nameSlots.size() - 1;
+    for (const auto& oldSlot : oldSlots)
+    {
+        if (oldSlot.index == InvalidIndex)
+            continue;
+
+        std::size_t slot = oldSlot.hash & mask;
+        while (nameSlots[slot].index != InvalidIndex)
+            slot = (slot + 1) & mask;
+        nameSlots[slot] = oldSlot;
+    }
+}
+
+
+std::uint32_t
+LazyBodyCatalog::find(std::string_view name) const
+{
+    if (nameSlots.empty())
+        return InvalidIndex;
+
+    std::uint32_t hash = hashName(name);
+    std::size_t mask = nameSlots.size() - 1;
+    for (std::size_t slot = hash & mask; nameSlots[slot].index != InvalidIndex; slot = (slot + 1) & mask)
+    {
+        if (nameSlots[slot].hash != hash)
+            continue;
+
+        std::uint32_t index = nameSlots[slot].index;
+        std::uint32_t offset = nameOffsets[index];
+        for (auto entryName = getName(index, offset); !entryName.empty(); entryName = getName(index, offset))
+        {
+            if (UTF8StringCompare(entryName, name) == 0)
+                return index;
+        }
+    }
+
+    return InvalidIndex;
+}
+
+
+void
+LazyBodyCatalog::getCompletion(std::vector<std::string>& completion, std::string_view name) const
+{
+    int nameLength = UTF8Length(name);
+    for (std::uint32_t index = 0; index < size(); index++)
+    {
+        // The names of created bodies are completed by their system
+        if (bodies[index] != nullptr)
+            continue;
+
+        std::uint32_t offset = nameOffsets[index];
+        for (auto entryName = getName(index, offset); !entryName.empty(); entryName = getName(index, offset))
+        {
+            if (!UTF8StringCompare(entryName, name, nameLength))
+                completion.emplace_back(entryName);
+        }
+    }
+}
+
+
+Body*
+LazyBodyCatalog::materialize(std::uint32_t index)
+{
+    if (bodies[index] != nullptr)
+        return bodies[index];
+
+    // The body is created from the properties it was defined with, so that
+    // it ends up the same as if its creation hadn't been deferred.
+    auto orbitData = std::make_unique<Hash>();
+    const double kmPerAU = KM_PER_AU<double>;
+    orbitData->addValue("PericenterDistance", Value(orbits.getPericenterDistance(index) / kmPerAU));
+    orbitData->addValue("Period", Value(orbits.getPeriod(index) / DAYS_PER_YEAR));
+    orbitData->addValue("Eccentricity", Value(orbits.getEccentricity(index)));
+    orbitData->addValue("Inclination", Value(celmath::radToDeg(orbits.getInclination(index))));
+    orbitData->addValue("AscendingNode", Value(celmath::radToDeg(orbits.getAscendingNode(index))));
+    orbitData->addValue("ArgOfPericenter", Value(celmath::radToDeg(orbits.getArgOfPeriapsis(index))));
+    orbitData->addValue("MeanAnomaly", Value(celmath::radToDeg(orbits.getMeanAnomalyAtEpoch(index))));
+    orbitData->addValue("Epoch", Value(orbits.getEpoch(index)));
+
+    Hash objectData;
+    objectData.addValue("Class", Value("asteroid"));
+    objectData.addValue("Radius", Value(static_cast<double>(radii[index])));
+    objectData.addValue("GeomAlbedo", Value(static_cast<double>(geomAlbedos[index])));
+    objectData.addValue("EllipticalOrbit", Value(std::move(orbitData)));
+
+    std::vector<std::string> bodyNames;
+    std::uint32_t offset = nameOffsets[index];
+    for (auto name = getName(index, offset); !name.empty(); name = getName(index, offset))
+        bodyNames.emplace_back(name);
+
+    bodies[index] = LoadSolarSystemBody(bodyNames, system, *universe, &objectData);
+    return bodies[index];
+}
+
+
+std::size_t
+LazyBodyCatalog::getMemoryUsage() const
+{
+    using celestia::util::vectorMemory;
+    return celestia::util::stringMemory(names) + vectorMemory(nameOffsets) + vectorMemory(nameSlots) +
+           vectorMemory(radii) + vectorMemory(geomAlbedos) + orbits.getMemoryUsage() + vectorMemory(bodies);
+}
+
+
+float
+LazyBodyCatalog::getReflectivity(std::uint32_t index) const
+{
+    // As set by CreateBody from GeomAlbedo
+    return std::min(geomAlbedos[index], 1.0f);
+}
+
+
+double
+LazyBodyCatalog::getBoundingRadius(std::uint32_t index) const
+{
+    return orbits.getBoundingRadius(index);
+}
+
+
+void
+LazyBodyCatalog::computePositions(double tdb,
+                                  std::vector<Eigen::Vector3d>& positions,
+                                  unsigned int nThreads) const
+{
+    orbits.computePositions(tdb, positions, nThreads);
+}
@@ -0,0 +1,112 @@
+// lazybodycatalog.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Minor bodies whose Body objects are only created when needed.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celephem/ellipticalorbitarray.h>
+#include "parseobject.h"
+
+class Body;
+class PlanetarySystem;
+class Universe;
+
+// Keeps the asteroids of a star's planetary system that are defined with
+// nothing but an elliptical orbit, a radius and an albedo, without creating
+// Body objects for them. The orbits are kept in an EllipticalOrbitArray, so
+// that the renderer can compute the positions of all of them together and
+// draw them as points.
+//
+// A body is created, as if it had been read from its catalog, when it is
+// needed on its own: when it's looked up by name, picked, or large or bright
+// enough on screen to be shown as more than a point. It then takes part in
+// the frame tree like any other body, and its entry here only refers to it.
+class LazyBodyCatalog
+{
+ public:
+    static constexpr std::uint32_t InvalidIndex = std::numeric_limits<std::uint32_t>::max();
+
+    struct Definition
+    {
+        std::vector<std::string> names;
+        float radius{ 1.0f };
+        float geomAlbedo{ 0.5f };
+        EllipticalOrbitElements orbit;
+    };
+
+    LazyBodyCatalog(PlanetarySystem* system, Universe* universe);
+    ~LazyBodyCatalog() = default;
+
+    LazyBodyCatalog(const LazyBodyCatalog&) = delete;
+    LazyBodyCatalog& operator=(const LazyBodyCatalog&) = delete;
+
+    // Returns false if the orbit isn't an ellipse.
+    bool add(const Definition& definition);
+
+    std::uint32_t size() const { return static_cast<std::uint32_t>(radii.size()); }
+    // Bytes taken by the entries, not including the bodies created for them
+    std::size_t getMemoryUsage() const;
+    std::uint32_t find(std::string_view name) const;
+    void getCompletion(std::vector<std::string>& completion, std::string_view name) const;
+
+    // The body created for an entry, or nullptr if it hasn't been created.
+    Body* getBody(std::uint32_t index) const { return bodies[index]; }
+    // Create the body of an entry if necessary.
+    Body* materialize(std::uint32_t index);
+
+    float getRadius(std::uint32_t index) const { return radii[index]; }
+    float getReflectivity(std::uint32_t index) const;
+    // Largest distance of the body from the star
+    double getBoundingRadius(std::uint32_t index) const;
+
+    // Compute the positions of all entries, relative to the star in the
+    // frame of its planetary system, using up to nThreads threads. Those of
+    // the bodies already created are computed too, but should be ignored.
+    void computePositions(double tdb,
+                          std::vector<Eigen::Vector3d>& positions,
+                          unsigned int nThreads = 1) const;
+
+ private:
+    struct NameSlot
+    {
+        std::uint32_t hash;
+        std::uint32_t index{ InvalidIndex };
+    };
+
+    std::string_view getName(std::uint32_t index, std::uint32_t& offset) const;
+    void insertName(std::string_view name, std::uint32_t index);
+    void growNameTable();
+
+    PlanetarySystem* system;
+    Universe* universe;
+
+    // Names of each entry ending with NULs, those of entry i starting at
+    // nameOffsets[i]
+    std::string names;
+    std::vector<std::uint32_t> nameOffsets;
+    std::vector<NameSlot> nameSlots;
+    std::uint32_t nameCount{ 0 };
+
+    std::vector<float> radii;
+    std::vector<float> geomAlbedos;
+
+    celestia::ephem::EllipticalOrbitArray orbits;
+
+    std::vector<Body*> bodies;
+};
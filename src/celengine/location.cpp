@@ -105,6 +105,20 @@ const std::string& Location::getName(bool i18n) const
 }
 
 
+Location* Location::create(const LocationDefinition& definition, const Body& body)
+{
+    auto* location = new Location();
+    location->setName(definition.name);
+    location->setPosition(body.planetocentricToCartesian(definition.longLat).cast<float>());
+    location->setSize(definition.size);
+    location->setImportance(definition.importance);
+    location->setFeatureType(definition.featureType);
+    location->setLabelColor(definition.labelColor);
+    location->setLabelColorOverridden(definition.overrideLabelColor);
+    return location;
+}
+
+
 void Location::setName(const string& _name)
 {
     name = _name;
@@ -17,6 +17,7 @@
 
 class Selection;
 class Body;
+struct LocationDefinition;
 
 class Location : public AstroObject
 {
@@ -124,6 +125,9 @@ public:
     };
 
     static FeatureType parseFeatureType(const std::string&);
+    // Create a location of the body as defined, without adding it to the
+    // body's locations
+    static Location* create(const LocationDefinition&, const Body&);
 
     FeatureType getFeatureType() const;
     void setFeatureType(FeatureType);
@@ -141,4 +145,19 @@ public:
     std::string infoURL;
 };
 
+/*! The properties of a location read from a catalog. Bodies keep them
+ *  until their locations are first needed, rather than creating lots of
+ *  Location objects for surface features which may never be shown.
+ */
+struct LocationDefinition
+{
+    std::string name;
+    Eigen::Vector3d longLat{ Eigen::Vector3d::Zero() };
+    float size{ 1.0f };
+    float importance{ -1.0f };
+    Location::FeatureType featureType{ Location::Other };
+    bool overrideLabelColor{ false };
+    Color labelColor{ 1.0f, 1.0f, 1.0f };
+};
+
 #endif // _CELENGINE_LOCATION_H_
@@ -0,0 +1,207 @@
+// locationindex.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Spatial index of the locations on a body.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "locationindex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <celcompat/numbers.h>
+#include "location.h"
+
+namespace
+{
+
+// Aim for about this many locations in each cell
+constexpr std::size_t LocationsPerCell = 16;
+constexpr int MaxGridSize = 32;
+
+// Cell of the grid of size n on the faces of the cube containing direction
+// v, which must not be zero
+int
+getCellIndex(const Eigen::Vector3d& v, int n)
+{
+    Eigen::Index axis;
+    v.cwiseAbs().maxCoeff(&axis);
+    double major = v[axis];
+    double s = v[(axis + 1) % 3] / std::abs(major);
+    double t = v[(axis + 2) % 3] / std::abs(major);
+
+    int face = static_cast<int>(axis) * 2 + (major < 0.0 ? 1 : 0);
+    int i = std::clamp(static_cast<int>((s + 1.0) * 0.5 * n), 0, n - 1);
+    int j = std::clamp(static_cast<int>((t + 1.0) * 0.5 * n), 0, n - 1);
+    return (face * n + j) * n + i;
+}
+
+double
+angleBetweenUnitVectors(const Eigen::Vector3d& a, const Eigen::Vector3d& b)
+{
+    return std::acos(std::clamp(a.dot(b), -1.0, 1.0));
+}
+
+} // end unnamed namespace
+
+
+LocationIndex::LocationIndex(const std::vector<Location*>& locations)
+{
+    auto gridSize = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(locations.size()) /
+                                                         static_cast<double>(6 * LocationsPerCell))));
+    gridSize = std::clamp(gridSize, 1, MaxGridSize);
+
+    // Locations at the center of the body get the last cell
+    int centerCell = 6 * gridSize * gridSize;
+    std::vector<int> cellIndices;
+    cellIndices.reserve(locations.size());
+    for (const Location* location : locations)
+    {
+        Eigen::Vector3d position = location->getPosition().cast<double>();
+        cellIndices.push_back(position.isZero(0.0) ? centerCell : getCellIndex(position, gridSize));
+    }
+
+    std::vector<std::uint32_t> order(locations.size());
+    for (std::uint32_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(),
+              [&](std::uint32_t a, std::uint32_t b)
+              {
+                  if (cellIndices[a] != cellIndices[b])
+                      return cellIndices[a] < cellIndices[b];
+                  float importanceA = getImportance(*locations[a]);
+                  float importanceB = getImportance(*locations[b]);
+                  return importanceA != importanceB ? importanceA > importanceB : a < b;
+              });
+
+    entries.reserve(locations.size());
+    for (auto first = order.begin(); first != order.end();)
+    {
+        int cellIndex = cellIndices[*first];
+        auto last = std::find_if(first, order.end(),
+                                 [&](std::uint32_t i) { return cellIndices[i] != cellIndex; });
+
+        Cell& cell = cells.emplace_back();
+        cell.first = static_cast<std::uint32_t>(entries.size());
+        cell.last = cell.first + static_cast<std::uint32_t>(last - first);
+        cell.featureTypes = 0;
+        cell.minRadius = std::numeric_limits<double>::infinity();
+        cell.maxRadius = 0.0;
+
+        Eigen::Vector3d directionSum = Eigen::Vector3d::Zero();
+        for (auto it = first; it != last; ++it)
+        {
+            const Location* location = locations[*it];
+            entries.push_back({ getImportance(*location), location });
+
+            Eigen::Vector3d position = location->getPosition().cast<double>();
+            double radius = position.norm();
+            if (radius > 0.0)
+                directionSum += position / radius;
+            cell.minRadius = std::min(cell.minRadius, radius);
+            cell.maxRadius = std::max(cell.maxRadius, radius);
+            cell.featureTypes |= location->getFeatureType();
+        }
+
+        if (cellIndex == centerCell || directionSum.isZero(0.0))
+        {
+            cell.direction = Eigen::Vector3d::UnitX();
+            cell.angularRadius = celestia::numbers::pi;
+        }
+        else
+        {
+            cell.direction = directionSum.normalized();
+            cell.angularRadius = 0.0;
+            for (auto it = first; it != last; ++it)
+            {
+                Eigen::Vector3d direction = locations[*it]->getPosition().cast<double>().normalized();
+                cell.angularRadius = std::max(cell.angularRadius, angleBetweenUnitVectors(direction, cell.direction));
+            }
+        }
+
+        first = last;
+    }
+}
+
+
+float
+LocationIndex::getImportance(const Location& location)
+{
+    float importance = location.getImportance();
+    return importance < 0.0f ? location.getSize() : importance;
+}
+
+
+void
+LocationIndex::find(const Query& query, std::vector<const Location*>& result) const
+{
+    auto firstResult = static_cast<std::ptrdiff_t>(result.size());
+
+    const Eigen::Vector3d& observer = query.observerPosition;
+    double observerDistance = observer.norm();
+    Eigen::Vector3d observerDirection = observerDistance > 0.0
+        ? Eigen::Vector3d(observer / observerDistance)
+        : Eigen::Vector3d::UnitX();
+
+    // Angular distance from the observer direction of the horizon of the
+    // occluding sphere
+    double occluderRadius = query.occluderRadius;
+    bool testHorizon = occluderRadius > 0.0 && observerDistance > occluderRadius;
+    double observerHorizon = testHorizon ? std::acos(occluderRadius / observerDistance) : 0.0;
+
+    for (const Cell& cell : cells)
+    {
+        if ((cell.featureTypes & query.featureMask) == 0)
+            continue;
+
+        // Smallest angle between the observer direction and a location of
+        // the cell
+        double angle = observerDistance > 0.0
+            ? std::max(0.0, angleBetweenUnitVectors(cell.direction, observerDirection) - cell.angularRadius)
+            : 0.0;
+
+        // A point at distance r from the center is hidden by the sphere
+        // unless it's within acos(R / r) of the observer's horizon.
+        if (testHorizon)
+        {
+            double pointRadius = std::max(cell.maxRadius * query.pointRadiusScale, query.minPointRadius);
+            if (pointRadius <= occluderRadius ||
+                angle > observerHorizon + std::acos(occluderRadius / pointRadius))
+            {
+                continue;
+            }
+        }
+
+        // The locations of the cell are at least minDistance away from the
+        // observer, and sorted by importance, so the scan stops at the first
+        // one too small at that distance.
+        double cosAngle = std::cos(angle);
+        double closestRadius = std::clamp(observerDistance * cosAngle, cell.minRadius, cell.maxRadius);
+        double minDistance = std::sqrt(std::max(0.0, observerDistance * observerDistance +
+                                                     closestRadius * closestRadius -
+                                                     2.0 * observerDistance * closestRadius * cosAngle));
+        double cellMinImportance = query.minImportancePerDistance * minDistance;
+
+        for (std::uint32_t i = cell.first; i < cell.last; i++)
+        {
+            const Entry& entry = entries[i];
+            if (entry.importance <= cellMinImportance)
+                break;
+            if ((entry.location->getFeatureType() & query.featureMask) == 0)
+                continue;
+
+            double distance = (entry.location->getPosition().cast<double>() - observer).norm();
+            if (entry.importance > query.minImportancePerDistance * distance)
+                result.push_back(entry.location);
+        }
+    }
+
+    std::stable_sort(result.begin() + firstResult, result.end(),
+                     [](const Location* a, const Location* b) { return getImportance(*a) > getImportance(*b); });
+}
@@ -0,0 +1,85 @@
+// locationindex.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Spatial index of the locations on a body.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+class Location;
+
+/*! Groups the locations of a body by direction from its center, into the
+ *  cells of a grid on the faces of a cube projected onto the sphere. Each
+ *  cell keeps the cone and the range of distances from the center that its
+ *  locations lie in, and its locations sorted by decreasing importance, so
+ *  that cells beyond the horizon of an observer and the locations too small
+ *  to be labeled can be skipped without looking at them.
+ */
+class LocationIndex
+{
+public:
+    struct Query
+    {
+        // Position of the observer in the body-fixed frame, in km
+        Eigen::Vector3d observerPosition{ Eigen::Vector3d::Zero() };
+        // Radius of a sphere inside the body, which hides the points
+        // behind it; zero for no horizon culling
+        double occluderRadius{ 0.0 };
+        // The distance from the center of the points tested against the
+        // horizon is at least this many times that of the location, and
+        // at least minPointRadius.
+        double pointRadiusScale{ 1.0 };
+        double minPointRadius{ 0.0 };
+        // Locations whose importance is below this many times their
+        // distance from the observer are skipped.
+        double minImportancePerDistance{ 0.0 };
+        std::uint64_t featureMask{ ~UINT64_C(0) };
+    };
+
+    explicit LocationIndex(const std::vector<Location*>& locations);
+    ~LocationIndex() = default;
+
+    LocationIndex(const LocationIndex&) = delete;
+    LocationIndex& operator=(const LocationIndex&) = delete;
+
+    // Append the locations which may be visible to result, in order of
+    // decreasing importance.
+    void find(const Query& query, std::vector<const Location*>& result) const;
+
+    // The importance of a location if set, otherwise its size
+    static float getImportance(const Location& location);
+
+private:
+    struct Entry
+    {
+        float importance;
+        const Location* location;
+    };
+
+    struct Cell
+    {
+        Eigen::Vector3d direction;
+        // Largest angle between a location of the cell and direction
+        double angularRadius;
+        // Range of the distances of the locations from the body center
+        double minRadius;
+        double maxRadius;
+        std::uint64_t featureTypes;
+        std::uint32_t first;
+        std::uint32_t last;
+    };
+
+    std::vector<Cell> cells;
+    std::vector<Entry> entries;
+};
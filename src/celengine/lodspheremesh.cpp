@@ -20,6 +20,7 @@
 #include <celengine/texture.h>
 #include <celmath/frustum.h>
 #include <celmath/mathlib.h>
+#include <celrender/renderstats.h>
 #include <celutil/arrayvector.h>
 #include <celutil/array_view.h>
 
@@ -43,6 +44,10 @@ static_assert(nIndices < std::numeric_limits<unsigned short>::max());
 //     tex coords - 2 floats * MAX_SPHERE_MESH_TEXTURES
 constexpr const int MaxVertexSize = 3 + 3 + LODSphereMesh::MAX_SPHERE_MESH_TEXTURES * 2;
 
+// Vertices of static patches have a position, a tangent and one pair of
+// texture coordinates, shared by all textures
+constexpr const int StaticVertexSize = 3 + 3 + 2;
+
 
 using ThetaArray = std::array<float, thetaDivisions + 1>;
 using PhiArray   = std::array<float, phiDivisions + 1>;
@@ -283,6 +288,8 @@ LODSphereMesh::~LODSphereMesh()
 {
     glDeleteBuffers(vertexBuffers.size(), vertexBuffers.data());
     glDeleteBuffers(1, &indexBuffer);
+    for (const auto& [key, buffer] : staticPatches)
+        glDeleteBuffers(1, &buffer);
 }
 
 
@@ -326,7 +333,7 @@ void LODSphereMesh::render(unsigned int attributes,
                            int nTextures)
 {
     int lod = 64;
-    int lodBias = getSphereLOD(pixWidth);
+    int lodBias = getSphereLOD(pixWidth) + lodOffset;
 
     if (lodBias < 0)
         lod /= (1 << (-lodBias));
@@ -428,34 +435,72 @@ void LODSphereMesh::render(unsigned int attributes,
     int nRings = phiExtent / ri.step;
     int nSlices = thetaExtent / ri.step;
 
-    indices.clear();
-    int expectedIndices = 2 * (nRings * (nSlices + 1) + std::max(nRings - 1, 0));
-    indices.reserve(expectedIndices);
-    for (i = 0; i < nRings; i++)
+    // All sections have the same size. As many as fit in the buffers are
+    // drawn with one strip, joined by degenerate triangles; the section
+    // strips have an even length, which keeps the winding of the next one.
+    int sectionVertexCount = (nRings + 1) * (nSlices + 1);
+    sectionIndexCount = 2 * (nRings * (nSlices + 1) + std::max(nRings - 1, 0));
+    sectionsPerBatch = std::max(1, std::min(maxVertices / sectionVertexCount,
+                                            (nIndices + 2) / (sectionIndexCount + 2)));
+    nBatchedSections = 0;
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+
+    // The indices only depend on the section size
+    if (nRings != indexRings || nSlices != indexSlices)
     {
-        if (i > 0)
+        indices.clear();
+        int expectedIndices = sectionsPerBatch * (sectionIndexCount + 2) - 2;
+        indices.reserve(expectedIndices);
+        for (int section = 0; section < sectionsPerBatch; section++)
         {
-            indices.push_back(static_cast<unsigned short>(i * (nSlices + 1) + 0));
-        }
-        for (int j = 0; j <= nSlices; j++)
-        {
-            indices.push_back(static_cast<unsigned short>(i * (nSlices + 1) + j));
-            indices.push_back(static_cast<unsigned short>((i + 1) * (nSlices + 1) + j));
+            int base = section * sectionVertexCount;
+            if (section > 0)
+            {
+                indices.push_back(indices.back());
+                indices.push_back(static_cast<unsigned short>(base));
+            }
+
+            for (i = 0; i < nRings; i++)
+            {
+                if (i > 0)
+                {
+                    indices.push_back(static_cast<unsigned short>(base + i * (nSlices + 1) + 0));
+                }
+                for (int j = 0; j <= nSlices; j++)
+                {
+                    indices.push_back(static_cast<unsigned short>(base + i * (nSlices + 1) + j));
+                    indices.push_back(static_cast<unsigned short>(base + (i + 1) * (nSlices + 1) + j));
+                }
+                if (i < nRings - 1)
+                {
+                    indices.push_back(static_cast<unsigned short>(base + (i + 1) * (nSlices + 1) + nSlices));
+                }
+            }
         }
-        if (i < nRings - 1)
+
+        assert(expectedIndices == indices.size());
+
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
+                        0,
+                        indices.size() * sizeof(unsigned short),
+                        indices.data());
+        indexRings = nRings;
+        indexSlices = nSlices;
+    }
+
+    // The sections of static patches all use the whole textures
+    drawStaticPatches = useStaticPatches && canUseStaticPatches(ri);
+    if (drawStaticPatches)
+    {
+        for (i = 0; i < nTextures; i++)
         {
-            indices.push_back(static_cast<unsigned short>((i + 1) * (nSlices + 1) + nSlices));
+            if (nTextures > 1)
+                glActiveTexture(GL_TEXTURE0 + i);
+            tex[i]->bind();
         }
     }
 
-    assert(expectedIndices == indices.size());
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
-                    0,
-                    indices.size() * sizeof(unsigned short),
-                    indices.data());
-
     // Compute the size of a vertex
     vertexSize = 3;
     if ((attributes & Tangents) != 0)
@@ -521,6 +566,8 @@ void LODSphereMesh::render(unsigned int attributes,
         }
     }
 
+    flushSections(ri);
+
     glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
     if ((attributes & Normals) != 0)
         glDisableVertexAttribArray(CelestiaGLProgram::NormalAttributeIndex);
@@ -628,32 +675,10 @@ LODSphereMesh::renderSection(int phi0, int theta0, int extent,
                              const RenderInfo& ri)
 
 {
-    auto stride = static_cast<GLsizei>(vertexSize * sizeof(float));
-    int texCoordOffset = ((ri.attributes & Tangents) != 0) ? 6 : 3;
-    float* vertexBase = nullptr;
-
-    glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
-                          3, GL_FLOAT, GL_FALSE,
-                          stride, vertexBase);
-    if ((ri.attributes & Normals) != 0)
-    {
-        glVertexAttribPointer(CelestiaGLProgram::NormalAttributeIndex,
-                              3, GL_FLOAT, GL_FALSE,
-                              stride, vertexBase);
-    }
-
-    for (int tc = 0; tc < nTexturesUsed; tc++)
+    if (drawStaticPatches)
     {
-        glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex + tc,
-                              2, GL_FLOAT, GL_FALSE,
-                              stride, vertexBase + (tc * 2) + texCoordOffset);
-    }
-
-    if ((ri.attributes & Tangents) != 0)
-    {
-        glVertexAttribPointer(CelestiaGLProgram::TangentAttributeIndex,
-                              3, GL_FLOAT, GL_FALSE,
-                              stride, vertexBase + 3); // 3 == tangentOffset
+        renderStaticSection(phi0, theta0, extent, ri);
+        return;
     }
 
     // assert(ri.step >= minStep);
@@ -667,8 +692,9 @@ LODSphereMesh::renderSection(int phi0, int theta0, int extent,
 
     TextureCoords tc{ nTexturesUsed };
 
-    // Set the current texture.  This is necessary because the texture
-    // may be split into subtextures.
+    // Find the subtextures of the section, which may be split from the
+    // texture.
+    std::array<unsigned int, MAX_SPHERE_MESH_TEXTURES> sectionTextures = subtextures;
     for (int tex = 0; tex < nTexturesUsed; tex++)
     {
         tc.du[tex] = 1.0f / static_cast<float>(thetaDivisions);
@@ -700,8 +726,6 @@ LODSphereMesh::renderSection(int phi0, int theta0, int extent,
             u /= patchesPerUSubtex;
             v /= patchesPerVSubtex;
 
-            if (nTexturesUsed > 1)
-                glActiveTexture(GL_TEXTURE0 + tex);
             TextureTile tile = textures[tex]->getTile(ri.texLOD[tex],
                                                       uTexSplit - u - 1,
                                                       vTexSplit - v - 1);
@@ -709,38 +733,91 @@ LODSphereMesh::renderSection(int phi0, int theta0, int extent,
             tc.dv[tex] *= tile.dv;
             tc.u0[tex] = tc.u0[tex] * tile.du + tile.u;
             tc.v0[tex] = tc.v0[tex] * tile.dv + tile.v;
-
-            // We track the current texture to avoid unnecessary and costly
-            // texture state changes.
-            if (tile.texID != subtextures[tex])
-            {
-                glBindTexture(GL_TEXTURE_2D, tile.texID);
-                subtextures[tex] = tile.texID;
-            }
+            sectionTextures[tex] = tile.texID;
         }
     }
 
-    vertices.clear();
+    // Tiles of a virtual texture in the same atlas share the texture
+    if (sectionTextures != subtextures)
+    {
+        flushSections(ri);
+        subtextures = sectionTextures;
+    }
+
     int perVertexFloats = (ri.attributes & Tangents) == 0 ? 3 : 6;
     int expectedVertices = ((phi1 - phi0) / ri.step + 1) *
                            ((theta1 - theta0) / ri.step + 1) * (perVertexFloats + nTexturesUsed * 2);
-    assert(expectedVertices <= maxVertices * MaxVertexSize);
-    vertices.reserve(expectedVertices);
+    std::size_t sectionStart = vertices.size();
+    assert(sectionStart + expectedVertices <= maxVertices * MaxVertexSize);
+    vertices.reserve(sectionStart + expectedVertices);
     if ((ri.attributes & Tangents) == 0)
         createVertices<false>(vertices, phi0, phi1, theta0, theta1, ri.step, tc);
     else
         createVertices<true>(vertices, phi0, phi1, theta0, theta1, ri.step, tc);
 
-    assert(expectedVertices == vertices.size());
+    assert(sectionStart + expectedVertices == vertices.size());
+
+    nBatchedSections++;
+    if (nBatchedSections == sectionsPerBatch)
+        flushSections(ri);
+}
+
+
+void
+LODSphereMesh::flushSections(const RenderInfo& ri)
+{
+    if (nBatchedSections == 0)
+        return;
+
+    auto stride = static_cast<GLsizei>(vertexSize * sizeof(float));
+    int texCoordOffset = ((ri.attributes & Tangents) != 0) ? 6 : 3;
+    float* vertexBase = nullptr;
+
+    glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
+                          3, GL_FLOAT, GL_FALSE,
+                          stride, vertexBase);
+    if ((ri.attributes & Normals) != 0)
+    {
+        glVertexAttribPointer(CelestiaGLProgram::NormalAttributeIndex,
+                              3, GL_FLOAT, GL_FALSE,
+                              stride, vertexBase);
+    }
+
+    for (int tc = 0; tc < nTexturesUsed; tc++)
+    {
+        glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex + tc,
+                              2, GL_FLOAT, GL_FALSE,
+                              stride, vertexBase + (tc * 2) + texCoordOffset);
+    }
+
+    if ((ri.attributes & Tangents) != 0)
+    {
+        glVertexAttribPointer(CelestiaGLProgram::TangentAttributeIndex,
+                              3, GL_FLOAT, GL_FALSE,
+                              stride, vertexBase + 3); // 3 == tangentOffset
+    }
+
+    // Bound here rather than when the subtextures change, as loading a
+    // tile of a virtual texture binds it
+    for (int tex = 0; tex < nTexturesUsed; tex++)
+    {
+        if (textures[tex] == nullptr)
+            continue;
+        if (nTexturesUsed > 1)
+            glActiveTexture(GL_TEXTURE0 + tex);
+        glBindTexture(GL_TEXTURE_2D, subtextures[tex]);
+    }
 
     glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(float), vertices.data());
 
-    int nRings = phiExtent / ri.step;
-    int nSlices = thetaExtent / ri.step;
     glDrawElements(GL_TRIANGLE_STRIP,
-                   nRings * (nSlices + 2) * 2 - 2,
+                   nBatchedSections * (sectionIndexCount + 2) - 2,
                    GL_UNSIGNED_SHORT,
                    nullptr);
+    celestia::render::countDrawCall(GL_TRIANGLE_STRIP, nBatchedSections * (sectionIndexCount + 2) - 2);
+
+    vertices.clear();
+    nBatchedSections = 0;
 
     // Cycle through the vertex buffers
     currentVB++;
@@ -748,3 +825,93 @@ LODSphereMesh::renderSection(int phi0, int theta0, int extent,
         currentVB = 0;
     glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[currentVB]);
 }
+
+
+// Static patches have the texture coordinates of textures which aren't
+// split, so that the same vertices serve all of them.
+bool
+LODSphereMesh::canUseStaticPatches(const RenderInfo& ri) const
+{
+    for (int tex = 0; tex < nTexturesUsed; tex++)
+    {
+        if (textures[tex] == nullptr)
+            continue;
+
+        if (textures[tex]->getUTileCount(ri.texLOD[tex]) != 1 ||
+            textures[tex]->getVTileCount(ri.texLOD[tex]) != 1)
+            return false;
+
+        TextureTile tile = textures[tex]->getTile(ri.texLOD[tex], 0, 0);
+        if (tile.u != 0.0f || tile.v != 0.0f || tile.du != 1.0f || tile.dv != 1.0f)
+            return false;
+    }
+
+    return true;
+}
+
+
+GLuint
+LODSphereMesh::getStaticPatch(int phi0, int theta0, int extent, int step)
+{
+    PatchKey key{ step, phi0, theta0, extent };
+    if (auto iter = staticPatches.find(key); iter != staticPatches.end())
+        return iter->second;
+
+    TextureCoords tc{ 1 };
+    tc.du[0] = 1.0f / static_cast<float>(thetaDivisions);
+    tc.dv[0] = 1.0f / static_cast<float>(phiDivisions);
+    tc.u0[0] = 1.0f;
+    tc.v0[0] = 1.0f;
+
+    std::vector<float> patchVertices;
+    patchVertices.reserve(static_cast<std::size_t>((extent / 2 / step + 1) * (extent / step + 1) * StaticVertexSize));
+    createVertices<true>(patchVertices, phi0, phi0 + extent / 2, theta0, theta0 + extent, step, tc);
+
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER,
+                 patchVertices.size() * sizeof(float),
+                 patchVertices.data(),
+                 GL_STATIC_DRAW);
+
+    staticPatches.try_emplace(key, buffer);
+    return buffer;
+}
+
+
+void
+LODSphereMesh::renderStaticSection(int phi0, int theta0, int extent,
+                                   const RenderInfo& ri)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, getStaticPatch(phi0, theta0, extent, ri.step));
+
+    auto stride = static_cast<GLsizei>(StaticVertexSize * sizeof(float));
+    float* vertexBase = nullptr;
+    glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
+                          3, GL_FLOAT, GL_FALSE,
+                          stride, vertexBase);
+    if ((ri.attributes & Normals) != 0)
+    {
+        glVertexAttribPointer(CelestiaGLProgram::NormalAttributeIndex,
+                              3, GL_FLOAT, GL_FALSE,
+                              stride, vertexBase);
+    }
+
+    if ((ri.attributes & Tangents) != 0)
+    {
+        glVertexAttribPointer(CelestiaGLProgram::TangentAttributeIndex,
+                              3, GL_FLOAT, GL_FALSE,
+                              stride, vertexBase + 3);
+    }
+
+    for (int tc = 0; tc < nTexturesUsed; tc++)
+    {
+        glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex + tc,
+                              2, GL_FLOAT, GL_FALSE,
+                              stride, vertexBase + 6);
+    }
+
+    glDrawElements(GL_TRIANGLE_STRIP, sectionIndexCount, GL_UNSIGNED_SHORT, nullptr);
+    celestia::render::countDrawCall(GL_TRIANGLE_STRIP, sectionIndexCount);
+}
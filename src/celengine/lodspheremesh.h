@@ -12,6 +12,8 @@
 
 #include <array>
 #include <cstddef>
+#include <map>
+#include <tuple>
 #include <vector>
 
 #include <Eigen/Core>
@@ -47,6 +49,15 @@ public:
     void render(const celmath::Frustum&, float pixWidth,
                 Texture** tex, int nTextures);
 
+    // Keep the vertices of each section in a vertex buffer when it's first
+    // drawn rather than computing and uploading them every frame. Only
+    // used when none of the textures is split into tiles.
+    void setStaticPatches(bool enable) { useStaticPatches = enable; }
+
+    // Added to the level of detail picked from the size of a sphere on
+    // screen; each step down halves the number of slices and rings.
+    void setLODOffset(int offset) { lodOffset = offset; }
+
     enum
     {
         Normals    = 0x01,
@@ -77,12 +88,22 @@ public:
                        const RenderInfo&);
 
     void renderSection(int phi0, int theta0, int extent, const RenderInfo&);
+    void renderStaticSection(int phi0, int theta0, int extent, const RenderInfo&);
+    void flushSections(const RenderInfo&);
+    bool canUseStaticPatches(const RenderInfo&) const;
+    GLuint getStaticPatch(int phi0, int theta0, int extent, int step);
 
     int vertexSize{ 0 };
 
     std::vector<float> vertices{};
     std::vector<unsigned short> indices{};
 
+    // Consecutive sections with the same subtextures are drawn together;
+    // vertices holds those not drawn yet.
+    int nBatchedSections{ 0 };
+    int sectionsPerBatch{ 1 };
+    int sectionIndexCount{ 0 };
+
     int nTexturesUsed{ 0 };
     std::array<Texture*, MAX_SPHERE_MESH_TEXTURES> textures{};
     std::array<unsigned int, MAX_SPHERE_MESH_TEXTURES> subtextures{};
@@ -91,4 +112,17 @@ public:
     GLuint currentVB{ 0 };
     std::array<GLuint, NUM_SPHERE_VERTEX_BUFFERS> vertexBuffers{};
     GLuint indexBuffer{ 0 };
+
+    // Section size of the indices in indexBuffer
+    int indexRings{ -1 };
+    int indexSlices{ -1 };
+
+    // Vertex buffers of the sections, by step, phi0, theta0 and extent.
+    // They are the same for all spheres, and take at most about 23 MB for
+    // the whole sphere at every level of detail.
+    using PatchKey = std::tuple<int, int, int, int>;
+    std::map<PatchKey, GLuint> staticPatches;
+    bool useStaticPatches{ false };
+    int lodOffset{ 0 };
+    bool drawStaticPatches{ false };
 };
@@ -10,18 +10,31 @@
 
 #include "meshmanager.h"
 
+#include <cmath>
 #include <cstdint>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <ios>
+#include <map>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <system_error>
 #include <utility>
 #include <vector>
 
+#include <fmt/format.h>
+
 #include <cel3ds/3dsmodel.h>
 #include <cel3ds/3dsread.h>
+#include <celmodel/meshoptimize.h>
+#include <celmodel/meshsimplify.h>
 #include <celmodel/model.h>
 #include <celmodel/modelfile.h>
+#include <celutil/diskcache.h>
 #include <celutil/filetype.h>
+#include <celutil/fsutils.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
 #include <celutil/tokenizer.h>
@@ -92,9 +105,106 @@ LoadCelestiaMesh(const fs::path& filename)
 }
 
 
+// Texture handles of the materials of a model being loaded. Models loaded
+// on the thread using the texture manager get its handles right away. The
+// texture manager may only be used by that thread, so models loaded in the
+// background get handles into a table of their own instead, which are
+// replaced by resolve() once loading is finished.
+class TextureTable
+{
+ public:
+    TextureTable(const fs::path& _texPath, bool _local) : texPath(_texPath), local(_local) {}
+
+    const fs::path& getTexturePath() const { return texPath; }
+
+    ResourceHandle getHandle(const fs::path& name)
+    {
+        if (!local)
+            return GetTextureManager()->getHandle(TextureInfo(name, texPath, TextureInfo::WrapTexture));
+
+        auto [iter, inserted] = handles.try_emplace(name, static_cast<ResourceHandle>(names.size()));
+        if (inserted)
+            names.push_back(name);
+        return iter->second;
+    }
+
+    fs::path getSource(ResourceHandle handle) const
+    {
+        if (local)
+            return handle >= 0 && static_cast<std::size_t>(handle) < names.size() ? names[handle] : fs::path();
+
+        const TextureInfo* info = GetTextureManager()->getResourceInfo(handle);
+        return info == nullptr ? fs::path() : info->getSource();
+    }
+
+    // Replace the handles of the table with those of the texture manager
+    void resolve(cmod::Model& model) const
+    {
+        if (!local)
+            return;
+
+        for (unsigned int i = 0; i < model.getMaterialCount(); i++)
+        {
+            cmod::Material material = model.getMaterial(i)->clone();
+            for (ResourceHandle& handle : material.maps)
+            {
+                if (handle != InvalidResource)
+                    handle = GetTextureManager()->getHandle(TextureInfo(getSource(handle), texPath, TextureInfo::WrapTexture));
+            }
+            model.setMaterial(i, std::move(material));
+        }
+    }
+
+ private:
+    fs::path texPath;
+    bool local;
+    std::vector<fs::path> names;
+    std::map<fs::path, ResourceHandle> handles;
+};
+
+
+// Material groups of 3DS meshes refer to materials by name, and the
+// materials may come after the meshes in the file. Groups first get an
+// index for each distinct name, replaced once all materials are known.
+class MaterialNames
+{
+ public:
+    unsigned int getGroupIndex(const std::string& name)
+    {
+        auto [iter, inserted] = groupIndices.try_emplace(name, static_cast<unsigned int>(groupNames.size()));
+        if (inserted)
+            groupNames.push_back(name);
+        return iter->second;
+    }
+
+    void addMaterial(const std::string& name, unsigned int index)
+    {
+        // The first material with a name is used
+        materialIndices.try_emplace(name, index);
+    }
+
+    // Groups whose material is missing use the first one
+    std::vector<unsigned int> getMaterialMap() const
+    {
+        std::vector<unsigned int> materialMap;
+        materialMap.reserve(groupNames.size());
+        for (const std::string& name : groupNames)
+        {
+            auto iter = materialIndices.find(name);
+            materialMap.push_back(iter == materialIndices.end() ? 0u : iter->second);
+        }
+        return materialMap;
+    }
+
+ private:
+    std::map<std::string, unsigned int> groupIndices;
+    std::vector<std::string> groupNames;
+    std::map<std::string, unsigned int> materialIndices;
+};
+
+
 cmod::Mesh
-ConvertTriangleMesh(const M3DTriangleMesh& mesh,
-                    const M3DScene& scene)
+ConvertTriangleMesh(const M3DTriangleMesh& mesh, MaterialNames& materialNames)
 {
     int nFaces     = mesh.getFaceCount();
     int nVertices  = mesh.getVertexCount();
@@ -134,24 +244,19 @@ ConvertTriangleMesh(const M3DTriangleMesh& mesh,
         vertexSize += 2;
     }
 
-    // bool smooth = (mesh.getSmoothingGroupCount() == nFaces);
-
+    // generate face normals, and list the faces using each vertex as
+    // ranges of a single array
     std::vector<Eigen::Vector3f> faceNormals;
     faceNormals.reserve(nFaces);
-    std::vector<Eigen::Vector3f> vertexNormals;
-    vertexNormals.reserve(nFaces * 3);
-    std::vector<int> faceCounts(nVertices, 0);
-    std::vector<std::vector<int>> vertexFaces(nVertices);
-
-    // generate face normals
+    std::vector<int> faceStart(nVertices + 1, 0);
     for (int i = 0; i < nFaces; i++)
     {
         std::uint16_t v0, v1, v2;
         mesh.getFace(i, v0, v1, v2);
 
-        faceCounts[v0]++;
-        faceCounts[v1]++;
-        faceCounts[v2]++;
+        faceStart[v0 + 1]++;
+        faceStart[v1 + 1]++;
+        faceStart[v2 + 1]++;
 
         Eigen::Vector3f p0 = mesh.getVertex(v0);
         Eigen::Vector3f p1 = mesh.getVertex(v1);
@@ -159,75 +264,20 @@ ConvertTriangleMesh(const M3DTriangleMesh& mesh,
         faceNormals.push_back((p1 - p0).cross(p2 - p1).normalized());
     }
 
-#if 0
-    if (!smooth)
-    {
-        for (int i = 0; i < nFaces; i++)
-        {
-            vertexNormals.push_back(faceNormals[i]);
-            vertexNormals.push_back(faceNormals[i]);
-            vertexNormals.push_back(faceNormals[i]);
-        }
-    }
-    else
-#endif
+    std::partial_sum(faceStart.begin(), faceStart.end(), faceStart.begin());
+    std::vector<int> vertexFaces(faceStart[nVertices]);
+    std::vector<int> faceEnd(faceStart.begin(), faceStart.end() - 1);
+    for (int i = 0; i < nFaces; i++)
     {
-        // allocate space for vertex face indices
-        for (int i = 0; i < nVertices; i++)
-        {
-            vertexFaces[i].resize(faceCounts[i] + 1);
-            vertexFaces[i][0] = faceCounts[i];
-        }
-
-        for (int i = 0; i < nFaces; i++)
-        {
-            std::uint16_t v0, v1, v2;
-            mesh.getFace(i, v0, v1, v2);
-            vertexFaces[v0][faceCounts[v0]--] = i;
-            vertexFaces[v1][faceCounts[v1]--] = i;
-            vertexFaces[v2][faceCounts[v2]--] = i;
-        }
-
-        // average face normals to compute the vertex normals
-        for (int i = 0; i < nFaces; i++)
-        {
-            std::uint16_t v0, v1, v2;
-            mesh.getFace(i, v0, v1, v2);
-            // uint32_t smoothingGroups = mesh.getSmoothingGroups(i);
-
-            Eigen::Vector3f v = Eigen::Vector3f::Zero();
-            for (int j = 1; j <= vertexFaces[v0][0]; j++)
-            {
-                int k = vertexFaces[v0][j];
-                // if (k == i || (smoothingGroups & mesh.getSmoothingGroups(k)) != 0)
-                if (faceNormals[i].dot(faceNormals[k]) > 0.5f)
-                    v += faceNormals[k];
-            }
-            vertexNormals.push_back(v.normalized());
-
-            v = Eigen::Vector3f::Zero();
-            for (int j = 1; j <= vertexFaces[v1][0]; j++)
-            {
-                int k = vertexFaces[v1][j];
-                // if (k == i || (smoothingGroups & mesh.getSmoothingGroups(k)) != 0)
-                if (faceNormals[i].dot(faceNormals[k]) > 0.5f)
-                    v += faceNormals[k];
-            }
-            vertexNormals.push_back(v.normalized());
-
-            v = Eigen::Vector3f::Zero();
-            for (int j = 1; j <= vertexFaces[v2][0]; j++)
-            {
-                int k = vertexFaces[v2][j];
-                // if (k == i || (smoothingGroups & mesh.getSmoothingGroups(k)) != 0)
-                if (faceNormals[i].dot(faceNormals[k]) > 0.5f)
-                    v += faceNormals[k];
-            }
-            vertexNormals.push_back(v.normalized());
-        }
+        std::uint16_t v0, v1, v2;
+        mesh.getFace(i, v0, v1, v2);
+        vertexFaces[faceEnd[v0]++] = i;
+        vertexFaces[faceEnd[v1]++] = i;
+        vertexFaces[faceEnd[v2]++] = i;
     }
 
-    // Create the vertex data
+    // Create the vertex data. The vertex normals average the normals of
+    // the faces around the vertex which are within 60 degrees of the face.
     static_assert(sizeof(float) == sizeof(cmod::VWord), "Float does not match vertex data word size");
     std::vector<cmod::VWord> vertexData(nFaces * 3 * vertexSize);
 
@@ -239,7 +289,14 @@ ConvertTriangleMesh(const M3DTriangleMesh& mesh,
         for (unsigned int j = 0; j < 3; j++)
         {
             Eigen::Vector3f position = mesh.getVertex(triVert[j]);
-            Eigen::Vector3f normal = vertexNormals[i * 3 + j];
+            Eigen::Vector3f normal = Eigen::Vector3f::Zero();
+            for (int k = faceStart[triVert[j]]; k < faceStart[triVert[j] + 1]; k++)
+            {
+                const Eigen::Vector3f& faceNormal = faceNormals[vertexFaces[k]];
+                if (faceNormals[i].dot(faceNormal) > 0.5f)
+                    normal += faceNormal;
+            }
+            normal.normalize();
 
             int dataOffset = (i * 3 + j) * vertexSize;
             std::memcpy(vertexData.data() + dataOffset, position.data(), sizeof(float) * 3);
@@ -275,144 +332,425 @@ ConvertTriangleMesh(const M3DTriangleMesh& mesh,
             indices.push_back(faceIndex * 3 + 2);
         }
 
-        // Lookup the material index
-        std::uint32_t materialIndex = 0;
-        for (std::uint32_t j = 0; j < scene.getMaterialCount(); ++j)
-        {
-            if (matGroup->materialName == scene.getMaterial(j)->getName())
-            {
-                materialIndex = j;
-                break;
-            }
-        }
-
-        newMesh.addGroup(cmod::PrimitiveGroupType::TriList, materialIndex, std::move(indices));
+        newMesh.addGroup(cmod::PrimitiveGroupType::TriList,
+                         materialNames.getGroupIndex(matGroup->materialName),
+                         std::move(indices));
     }
 
     return newMesh;
 }
 
 
-std::unique_ptr<cmod::Model>
-Convert3DSModel(const M3DScene& scene, const fs::path& texPath)
+cmod::Material
+Convert3DSMaterial(const M3DMaterial& material, TextureTable& textures)
 {
-    auto model = std::make_unique<cmod::Model>();
+    cmod::Material newMaterial;
 
-    // Convert the materials
-    for (std::uint32_t i = 0; i < scene.getMaterialCount(); i++)
-    {
-        const M3DMaterial* material = scene.getMaterial(i);
-        cmod::Material newMaterial;
+    M3DColor diffuse = material.getDiffuseColor();
+    newMaterial.diffuse = cmod::Color(diffuse.red, diffuse.green, diffuse.blue);
+    newMaterial.opacity = material.getOpacity();
 
-        M3DColor diffuse = material->getDiffuseColor();
-        newMaterial.diffuse = cmod::Color(diffuse.red, diffuse.green, diffuse.blue);
-        newMaterial.opacity = material->getOpacity();
+    M3DColor specular = material.getSpecularColor();
+    newMaterial.specular = cmod::Color(specular.red, specular.green, specular.blue);
 
-        M3DColor specular = material->getSpecularColor();
-        newMaterial.specular = cmod::Color(specular.red, specular.green, specular.blue);
+    float shininess = material.getShininess();
 
-        float shininess = material->getShininess();
+    // Map the 3DS file's shininess from percentage (0-100) to
+    // range that OpenGL uses for the specular exponent. The
+    // current equation is just a guess at the mapping that
+    // 3DS actually uses.
+    newMaterial.specularPower = std::pow(2.0f, 1.0f + 0.1f * shininess);
+    if (newMaterial.specularPower > 128.0f)
+        newMaterial.specularPower = 128.0f;
 
-        // Map the 3DS file's shininess from percentage (0-100) to
-        // range that OpenGL uses for the specular exponent. The
-        // current equation is just a guess at the mapping that
-        // 3DS actually uses.
-        newMaterial.specularPower = std::pow(2.0f, 1.0f + 0.1f * shininess);
-        if (newMaterial.specularPower > 128.0f)
-            newMaterial.specularPower = 128.0f;
+    if (!material.getTextureMap().empty())
+    {
+        ResourceHandle tex = textures.getHandle(material.getTextureMap());
+        newMaterial.setMap(cmod::TextureSemantic::DiffuseMap, tex);
+    }
 
-        if (!material->getTextureMap().empty())
-        {
-            ResourceHandle tex = GetTextureManager()->getHandle(TextureInfo(material->getTextureMap(), texPath, TextureInfo::WrapTexture));
-            newMaterial.setMap(cmod::TextureSemantic::DiffuseMap, tex);
-        }
+    return newMaterial;
+}
+
+
+// Converts a 3DS file while it is read, so only one of its meshes is held
+// at a time. Some confusing terminology: a 3ds 'scene' is the same as a
+// Celestia model, and a 3ds 'model' is the same as a Celestia mesh.
+class Model3DSBuilder : public M3DSceneHandler
+{
+ public:
+    explicit Model3DSBuilder(TextureTable& _textures) :
+        textures(_textures),
+        model(std::make_unique<cmod::Model>())
+    {}
 
-        model->addMaterial(std::move(newMaterial));
+    void material(M3DMaterial&& material) override
+    {
+        materialNames.addMaterial(material.getName(), model->getMaterialCount());
+        model->addMaterial(Convert3DSMaterial(material, textures));
     }
 
-    // Convert all models in the scene. Some confusing terminology: a 3ds 'scene' is the same
-    // as a Celestia model, and a 3ds 'model' is the same as a Celestia mesh.
-    for (std::uint32_t i = 0; i < scene.getModelCount(); i++)
+    void triangleMesh(M3DTriangleMesh&& mesh) override
     {
-        const M3DModel* model3ds = scene.getModel(i);
-        if (model3ds)
-        {
-            for (unsigned int j = 0; j < model3ds->getTriMeshCount(); j++)
-            {
-                const M3DTriangleMesh* mesh = model3ds->getTriMesh(j);
-                if (mesh)
-                {
-                    cmod::Mesh cmodmesh = ConvertTriangleMesh(*mesh, scene);
-                    if (cmodmesh.getGroupCount() > 0)
-                        model->addMesh(std::move(cmodmesh));
-                    else
-                        GetLogger()->warn("Skipping mesh with 0 primitive groups!\n");
-                }
-            }
-        }
+        cmod::Mesh cmodmesh = ConvertTriangleMesh(mesh, materialNames);
+        if (cmodmesh.getGroupCount() > 0)
+            model->addMesh(std::move(cmodmesh));
+        else
+            GetLogger()->warn("Skipping mesh with 0 primitive groups!\n");
     }
 
-    return model;
+    std::unique_ptr<cmod::Model> finish()
+    {
+        std::vector<unsigned int> materialMap = materialNames.getMaterialMap();
+        for (unsigned int i = 0; i < model->getMeshCount(); i++)
+            model->getMesh(i)->remapMaterials(materialMap);
+        return std::move(model);
+    }
+
+ private:
+    TextureTable& textures;
+    std::unique_ptr<cmod::Model> model;
+    MaterialNames materialNames;
+};
+
+
+// Textures of models are resolved relative to the add-on directory if the
+// model was found there
+fs::path
+getTexturePath(const GeometryInfo::ResourceKey& key, ContentType fileType, const fs::path& path)
+{
+    if (fileType == ContentType::_3DStudio && !key.resolvedToPath)
+        return fs::path();
+    return path;
 }
 
 
 std::unique_ptr<cmod::Model>
-Load3DSModel(const GeometryInfo::ResourceKey& key, const fs::path& path)
+Load3DSModel(const GeometryInfo::ResourceKey& key, TextureTable& textures)
 {
-    std::unique_ptr<M3DScene> scene = Read3DSFile(key.resolvedPath);
-    if (scene == nullptr)
+    Model3DSBuilder builder(textures);
+    if (!Read3DSFile(key.resolvedPath, builder))
         return nullptr;
 
-    std::unique_ptr<cmod::Model> model = Convert3DSModel(*scene, key.resolvedToPath ? path : fs::path());
+    return builder.finish();
+}
 
-    if (key.isNormalized)
-        model->normalize(key.center);
-    else
-        model->transform(key.center, key.scale);
 
-    return model;
+std::unique_ptr<cmod::Model>
+LoadCMODModel(const fs::path& filename, TextureTable& textures)
+{
+    return cmod::LoadModel(filename, [&](const fs::path& name) { return textures.getHandle(name); });
+}
+
+
+#ifndef PORTABLE_BUILD
+// Cache file names without an extension, derived from the source file, its
+// modification time and the variant of the model which is cached
+fs::path
+getModelCachePath(const fs::path& filename, std::string_view variant)
+{
+    static celestia::util::DiskCache cache(celestia::util::WriteableDataPath() / "cache" / "models", 1);
+    return cache.getPath(filename, variant, "");
+}
+
+
+// Models are cached before they are transformed, so one cache file serves
+// all placements of a model. Optimized models keep their original key.
+fs::path
+getConvertedCachePath(const fs::path& filename, const fs::path& texPath, bool optimized)
+{
+    fs::path cachePath = getModelCachePath(filename,
+                                           optimized ? texPath.string() : fmt::format("{}|converted", texPath.string()));
+    if (!cachePath.empty())
+        cachePath += ".cmod";
+    return cachePath;
+}
+
+
+// The model is written whole, so that a model loaded on another thread at
+// the same time never sees a partly written file.
+bool
+saveCachedModel(const cmod::Model& model, const fs::path& cachePath, const TextureTable& textures)
+{
+    return celestia::util::DiskCache::write(cachePath, [&](const fs::path& path)
+    {
+        std::ofstream out(path, std::ios::out | std::ios::binary);
+        if (!out.good())
+            return false;
+
+        bool saved = cmod::SaveModelBinary(&model, out,
+                                           [&](ResourceHandle handle) { return textures.getSource(handle); });
+        out.close();
+        return saved && out.good();
+    });
+}
+#endif
+
+
+// Models with fewer triangles are always drawn in full detail
+constexpr unsigned int MinLODTriangles = 4096;
+constexpr unsigned int MaxLODLevels = 3;
+// Each level has about a quarter of the triangles of the previous one
+constexpr float LODRatio = 0.25f;
+
+struct LevelOfDetail
+{
+    std::unique_ptr<cmod::Model> model;
+    float error;
+};
+
+
+// Each level is simplified from the previous one, so the errors add up
+std::vector<LevelOfDetail>
+generateLevelsOfDetail(const cmod::Model& model)
+{
+    std::vector<LevelOfDetail> levels;
+    const cmod::Model* previous = &model;
+    float error = 0.0f;
+    while (levels.size() < MaxLODLevels && previous->getPrimitiveCount() >= MinLODTriangles)
+    {
+        float stepError;
+        std::unique_ptr<cmod::Model> simplified = cmod::SimplifyModel(*previous, LODRatio, stepError);
+
+        // Models with many borders and seams can't be reduced much
+        if (simplified->getPrimitiveCount() > previous->getPrimitiveCount() / 4 * 3)
+            break;
+
+        error += stepError;
+        simplified->determineOpacity();
+        levels.push_back(LevelOfDetail{ std::move(simplified), error });
+        previous = levels.back().model.get();
+    }
+
+    GetLogger()->verbose("   Generated {} levels of detail\n", levels.size());
+    return levels;
+}
+
+
+#ifndef PORTABLE_BUILD
+// The levels of detail are generated after the model is transformed, so
+// their cache depends on the placement of the model.
+fs::path
+getLODCachePath(const GeometryInfo::ResourceKey& key, const fs::path& texPath)
+{
+    return getModelCachePath(key.resolvedPath,
+                             fmt::format("{}|{}|{}|{}|{}|{}|lod",
+                                         texPath.string(),
+                                         key.center.x(), key.center.y(), key.center.z(),
+                                         key.scale,
+                                         key.isNormalized ? 1 : 0));
+}
+
+
+fs::path
+getLODLevelPath(const fs::path& cachePath, std::size_t level)
+{
+    fs::path levelPath = cachePath;
+    levelPath += fmt::format("-{}.cmod", level + 1);
+    return levelPath;
 }
 
 
+// The index file lists the number of levels and their errors
+bool
+loadCachedLevelsOfDetail(const fs::path& cachePath,
+                         TextureTable& textures,
+                         std::vector<LevelOfDetail>& levels)
+{
+    fs::path indexPath = cachePath;
+    indexPath += ".lods";
+    if (!celestia::util::DiskCache::use(indexPath))
+        return false;
+    std::ifstream index(indexPath);
+    if (!index.good())
+        return false;
+
+    std::size_t count = 0;
+    if (!(index >> count) || count > MaxLODLevels)
+        return false;
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        float error;
+        if (!(index >> error))
+            return false;
+
+        fs::path levelPath = getLODLevelPath(cachePath, i);
+        celestia::util::DiskCache::use(levelPath);
+        std::unique_ptr<cmod::Model> model = LoadCMODModel(levelPath, textures);
+        if (model == nullptr)
+            return false;
+
+        model->determineOpacity();
+        levels.push_back(LevelOfDetail{ std::move(model), error });
+    }
+
+    return true;
+}
+
+
+void
+saveCachedLevelsOfDetail(const std::vector<LevelOfDetail>& levels,
+                         const fs::path& cachePath,
+                         const TextureTable& textures)
+{
+    for (std::size_t i = 0; i < levels.size(); i++)
+    {
+        if (!saveCachedModel(*levels[i].model, getLODLevelPath(cachePath, i), textures))
+            return;
+    }
+
+    // Written last, so that the levels are only used once all are saved
+    fs::path indexPath = cachePath;
+    indexPath += ".lods";
+    celestia::util::DiskCache::write(indexPath, [&levels](const fs::path& path)
+    {
+        std::ofstream index(path);
+        index << levels.size() << '\n';
+        for (const LevelOfDetail& level : levels)
+            index << fmt::format("{}\n", level.error);
+        return index.good();
+    });
+}
+#endif
+
+
+// Read and condition a model, then place it as the key requests
 std::unique_ptr<cmod::Model>
-LoadCMODModel(const GeometryInfo::ResourceKey& key, const fs::path& path)
+loadModel(const GeometryInfo::ResourceKey& key, ContentType fileType, TextureTable& textures, bool optimize)
 {
-    std::ifstream in(key.resolvedPath, std::ios::binary);
-    if (!in.good())
-        return nullptr;
+    std::unique_ptr<cmod::Model> model = nullptr;
 
-    std::unique_ptr<cmod::Model> model = cmod::LoadModel(
-        in,
-        [&](const fs::path& name)
+#ifndef PORTABLE_BUILD
+    // Procedural meshes are cheap to generate again. Conversions of 3DS
+    // files are always cached, so later runs use the binary cmod loader.
+    fs::path cachePath;
+    if ((optimize && fileType != ContentType::CelestiaMesh) || fileType == ContentType::_3DStudio)
+    {
+        cachePath = getConvertedCachePath(key.resolvedPath, textures.getTexturePath(), optimize);
+        if (!cachePath.empty() && celestia::util::DiskCache::use(cachePath))
         {
-            return GetTextureManager()->getHandle(TextureInfo(name, path, TextureInfo::WrapTexture));
-        });
+            model = LoadCMODModel(cachePath, textures);
+            if (model == nullptr)
+            {
+                GetLogger()->warn("Removing invalid model cache file {}\n", cachePath);
+                std::error_code ec;
+                fs::remove(cachePath, ec);
+            }
+        }
+    }
+#endif
 
     if (model == nullptr)
-        return nullptr;
+    {
+        switch (fileType)
+        {
+        case ContentType::_3DStudio:
+            model = Load3DSModel(key, textures);
+            break;
+        case ContentType::CelestiaModel:
+            model = LoadCMODModel(key.resolvedPath, textures);
+            break;
+        case ContentType::CelestiaMesh:
+            model = LoadCelestiaMesh(key.resolvedPath);
+            break;
+        default:
+            GetLogger()->error(_("Unknown model format '{}'\n"), key.resolvedPath);
+            return nullptr;
+        }
+
+        if (model == nullptr)
+        {
+            GetLogger()->error(_("Error loading model '{}'\n"), key.resolvedPath);
+            return nullptr;
+        }
+
+        // Condition the model for optimal rendering
+        // Many models tend to have a lot of duplicate materials; eliminate
+        // them, since unnecessarily setting material parameters can adversely
+        // impact rendering performance. Ideally uniquification of materials
+        // would be performed just once when the model was created, but
+        // that's not the case.
+        std::uint32_t originalMaterialCount = model->getMaterialCount();
+        model->uniquifyMaterials();
+
+        // Sort the submeshes roughly by opacity.  This will eliminate a
+        // good number of the errors caused when translucent triangles are
+        // rendered before geometry that they cover.
+        model->sortMeshes(cmod::Model::OpacityComparator());
+
+        if (optimize)
+            cmod::OptimizeModel(*model);
+
+#ifndef PORTABLE_BUILD
+        if (!cachePath.empty())
+            saveCachedModel(*model, cachePath, textures);
+#endif
+
+        // Display some statics for the model
+        GetLogger()->verbose(_("   Model statistics: {} vertices, {} primitives, {} materials ({} unique)\n"),
+                             model->getVertexCount(),
+                             model->getPrimitiveCount(),
+                             originalMaterialCount,
+                             model->getMaterialCount());
+    }
 
     if (key.isNormalized)
         model->normalize(key.center);
     else
         model->transform(key.center, key.scale);
 
+    model->determineOpacity();
     return model;
 }
 
 
-std::unique_ptr<cmod::Model>
-LoadCMSModel(const GeometryInfo::ResourceKey& key)
+std::vector<LevelOfDetail>
+loadLevelsOfDetail(const cmod::Model& model,
+                   const GeometryInfo::ResourceKey& key,
+                   ContentType fileType,
+                   TextureTable& textures)
 {
-    std::unique_ptr<cmod::Model> model = LoadCelestiaMesh(key.resolvedPath);
-    if (model == nullptr)
-        return nullptr;
+    std::vector<LevelOfDetail> levels;
+    if (model.getPrimitiveCount() < MinLODTriangles)
+        return levels;
+
+#ifndef PORTABLE_BUILD
+    fs::path cachePath;
+    if (fileType != ContentType::CelestiaMesh)
+        cachePath = getLODCachePath(key, textures.getTexturePath());
+    if (cachePath.empty() || !loadCachedLevelsOfDetail(cachePath, textures, levels))
+    {
+        levels = generateLevelsOfDetail(model);
+        if (!cachePath.empty())
+            saveCachedLevelsOfDetail(levels, cachePath, textures);
+    }
+#else
+    levels = generateLevelsOfDetail(model);
+#endif
 
-    if (key.isNormalized)
-        model->normalize(key.center);
-    else
-        model->transform(key.center, key.scale);
+    return levels;
+}
 
-    return model;
+
+// A model loaded in the background, waiting for its textures and buffers
+struct DecodedModel
+{
+    explicit DecodedModel(const fs::path& texPath) : textures(texPath, true) {}
+
+    TextureTable textures;
+    std::unique_ptr<cmod::Model> model;
+    std::vector<LevelOfDetail> levels;
+};
+
+
+std::unique_ptr<ModelGeometry>
+createGeometry(std::unique_ptr<cmod::Model>&& model, std::vector<LevelOfDetail>&& levels)
+{
+    auto geometry = std::make_unique<ModelGeometry>(std::move(model));
+    for (LevelOfDetail& level : levels)
+        geometry->addLevelOfDetail(std::move(level.model), level.error);
+    return geometry;
 }
 
 } // end unnamed namespace
@@ -445,56 +783,70 @@ GeometryInfo::resolve(const fs::path& baseDir) const
 }
 
 
+bool GeometryInfo::optimizeModels = false;
+bool GeometryInfo::levelsOfDetail = false;
+
+
+void
+GeometryInfo::setOptimizeModels(bool optimize)
+{
+    optimizeModels = optimize;
+}
+
+
+void
+GeometryInfo::setLevelsOfDetail(bool enable)
+{
+    levelsOfDetail = enable;
+}
+
+
+
+
 std::unique_ptr<Geometry>
 GeometryInfo::load(const ResourceKey& key) const
 {
     GetLogger()->info(_("Loading model: {}\n"), key.resolvedPath);
-    std::unique_ptr<cmod::Model> model = nullptr;
-
-    switch (ContentType fileType = DetermineFileType(key.resolvedPath); fileType)
-    {
-    case ContentType::_3DStudio:
-        model = Load3DSModel(key, path);
-        break;
-    case ContentType::CelestiaModel:
-        model = LoadCMODModel(key, path);
-        break;
-    case ContentType::CelestiaMesh:
-        model = LoadCMSModel(key);
-        break;
-    default:
-        GetLogger()->error(_("Unknown model format '{}'\n"), key.resolvedPath);
-        return nullptr;
-    }
 
+    ContentType fileType = DetermineFileType(key.resolvedPath);
+    TextureTable textures(getTexturePath(key, fileType, path), false);
+    std::unique_ptr<cmod::Model> model = loadModel(key, fileType, textures, optimizeModels);
     if (model == nullptr)
-    {
-        GetLogger()->error(_("Error loading model '{}'\n"), key.resolvedPath);
         return nullptr;
-    }
 
-    // Condition the model for optimal rendering
-    // Many models tend to have a lot of duplicate materials; eliminate
-    // them, since unnecessarily setting material parameters can adversely
-    // impact rendering performance. Ideally uniquification of materials
-    // would be performed just once when the model was created, but
-    // that's not the case.
-    std::uint32_t originalMaterialCount = model->getMaterialCount();
-    model->uniquifyMaterials();
+    std::vector<LevelOfDetail> levels;
+    if (levelsOfDetail)
+        levels = loadLevelsOfDetail(*model, key, fileType, textures);
 
-    // Sort the submeshes roughly by opacity.  This will eliminate a
-    // good number of the errors caused when translucent triangles are
-    // rendered before geometry that they cover.
-    model->sortMeshes(cmod::Model::OpacityComparator());
+    return createGeometry(std::move(model), std::move(levels));
+}
 
-    model->determineOpacity();
 
-    // Display some statics for the model
-    GetLogger()->verbose(_("   Model statistics: {} vertices, {} primitives, {} materials ({} unique)\n"),
-                         model->getVertexCount(),
-                         model->getPrimitiveCount(),
-                         originalMaterialCount,
-                         model->getMaterialCount());
+std::function<std::unique_ptr<Geometry>()>
+GeometryInfo::decode(const ResourceKey& key) const
+{
+    GetLogger()->info(_("Loading model: {}\n"), key.resolvedPath);
+
+    // std::function needs a copyable function, so the decoded model is
+    // shared with it
+    ContentType fileType = DetermineFileType(key.resolvedPath);
+    auto decoded = std::make_shared<DecodedModel>(getTexturePath(key, fileType, path));
+    decoded->model = loadModel(key, fileType, decoded->textures, optimizeModels);
+    if (decoded->model == nullptr)
+        return nullptr;
+
+    if (levelsOfDetail)
+        decoded->levels = loadLevelsOfDetail(*decoded->model, key, fileType, decoded->textures);
 
-    return std::make_unique<ModelGeometry>(std::move(model));
+    return [decoded]()
+    {
+        decoded->textures.resolve(*decoded->model);
+        for (LevelOfDetail& level : decoded->levels)
+            decoded->textures.resolve(*level.model);
+
+        std::unique_ptr<ModelGeometry> geometry = createGeometry(std::move(decoded->model),
+                                                                 std::move(decoded->levels));
+        geometry->createBuffers();
+        return geometry;
+    };
 }
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <tuple>
 #include <utility>
@@ -53,6 +54,9 @@ class GeometryInfo
     float scale;
     bool isNormalized;
 
+    static bool optimizeModels;
+    static bool levelsOfDetail;
+
     friend bool operator<(const GeometryInfo&, const GeometryInfo&);
 
  public:
@@ -81,6 +85,15 @@ class GeometryInfo
 
     ResourceKey resolve(const fs::path&) const;
     std::unique_ptr<Geometry> load(const ResourceKey&) const;
+    // For asynchronous loading: reads and prepares the model, leaving the
+    // texture handles and the vertex buffers to the returned function
+    std::function<std::unique_ptr<Geometry>()> decode(const ResourceKey&) const;
+
+    // Optimize models for the vertex cache and overdraw when loading them
+    static void setOptimizeModels(bool);
+    // Generate simplified versions of large models, drawn when they are
+    // small on screen
+    static void setLevelsOfDetail(bool);
 };
 
 inline bool operator<(const GeometryInfo& g0, const GeometryInfo& g1)
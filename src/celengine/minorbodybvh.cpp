@@ -0,0 +1,266 @@
+// minorbodybvh.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Bounding volume hierarchy over the minor bodies of a frame tree.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "minorbodybvh.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <celephem/orbit.h>
+#include "body.h"
+#include "frame.h"
+#include "frametree.h"
+#include "timelinephase.h"
+
+namespace
+{
+
+constexpr std::uint32_t MaxLeafBodies = 8;
+
+// Full rebuilds happen every RebuildInterval refits; in between, bodies
+// drift apart within the nodes and the bounds get looser.
+constexpr unsigned int RebuildInterval = 8;
+
+// Bounds are valid for a fraction of the shortest orbital period in the
+// tree, within these limits in days.
+constexpr double WindowPeriodFraction = 1.0 / 64.0;
+constexpr double MinWindowDuration = 1.0 / 24.0;
+constexpr double MaxWindowDuration = 30.0;
+
+// The speed between the samples may be larger than at the samples
+// themselves, e.g. around the pericenter.
+constexpr double SpeedMargin = 2.0;
+
+} // end unnamed namespace
+
+
+bool
+MinorBodyBVH::isMinorBody(const FrameTree& tree, unsigned int child)
+{
+    const TimelinePhase& phase = *tree.getChild(child);
+    const Body* body = phase.body();
+    return (body->getClassification() & (Body::Asteroid | Body::Comet | Body::MinorMoon)) != 0 &&
+           body->getFrameTree() == nullptr &&
+           body->getReferenceMarks() == nullptr &&
+           phase.orbitFrame()->isInertial();
+}
+
+
+void
+MinorBodyBVH::update(const FrameTree& tree, double tdb)
+{
+    if (tree.childCount() != childCount)
+    {
+        build(tree, tdb);
+    }
+    else if (tdb < windowStart || tdb > windowEnd)
+    {
+        if (++refitCount % RebuildInterval == 0 || !refit(tree, tdb))
+            build(tree, tdb);
+    }
+}
+
+
+// Compute the sphere which contains the body over the window centered on
+// tdb. Returns false if the body isn't active at tdb.
+bool
+MinorBodyBVH::computeBounds(const FrameTree& tree, BodyBounds& bounds, double tdb) const
+{
+    const TimelinePhase& phase = *tree.getChild(bounds.child);
+    if (!phase.includes(tdb))
+        return false;
+
+    const auto* orbit = phase.orbit();
+    Eigen::Quaterniond toAstrocentric = phase.orbitFrame()->getOrientation(tdb).conjugate();
+
+    Eigen::Vector3d p = orbit->positionAtTime(tdb);
+    double maxSpeed = 0.0;
+    for (int i = -2; i <= 2; i++)
+        maxSpeed = std::max(maxSpeed, orbit->velocityAtTime(tdb + windowDuration * i * 0.5).norm());
+
+    // Bodies on closed orbits never get further than the bounding radius
+    // from the center.
+    double drift = std::min(maxSpeed * SpeedMargin * windowDuration,
+                            p.norm() + orbit->getBoundingRadius());
+
+    bounds.phase = &phase;
+    bounds.position = toAstrocentric * p;
+    bounds.bodyRadius = phase.body()->getCullingRadius();
+    bounds.radius = drift + bounds.bodyRadius;
+    bounds.illuminatorRadius = phase.body()->isSecondaryIlluminator() ? phase.body()->getRadius() : 0.0f;
+    bounds.classification = phase.body()->getClassification();
+    bounds.orbitClassification = phase.body()->getOrbitClassification();
+    return true;
+}
+
+
+void
+MinorBodyBVH::build(const FrameTree& tree, double tdb)
+{
+    childCount = tree.childCount();
+    refitCount = 0;
+    nodes.clear();
+    bodies.clear();
+    covered.assign(childCount, false);
+    candidateStamps.assign(childCount, 0);
+    cullStamp = 0;
+
+    double shortestPeriod = MaxWindowDuration / WindowPeriodFraction;
+    for (unsigned int i = 0; i < childCount; i++)
+    {
+        if (!isMinorBody(tree, i) || !tree.getChild(i)->includes(tdb))
+            continue;
+
+        const auto* orbit = tree.getChild(i)->orbit();
+        if (orbit->isPeriodic())
+            shortestPeriod = std::min(shortestPeriod, orbit->getPeriod());
+        bodies.push_back({ i });
+    }
+
+    windowDuration = std::clamp(shortestPeriod * WindowPeriodFraction, MinWindowDuration, MaxWindowDuration);
+    windowStart = tdb - windowDuration;
+    windowEnd = tdb + windowDuration;
+
+    for (BodyBounds& bounds : bodies)
+    {
+        computeBounds(tree, bounds, tdb);
+        covered[bounds.child] = true;
+    }
+
+    if (!bodies.empty())
+    {
+        nodes.reserve(bodies.size() * 4 / MaxLeafBodies + 1);
+        nodes.emplace_back();
+        buildNode(0, 0, static_cast<std::uint32_t>(bodies.size()));
+    }
+}
+
+
+// Recompute the bounds of the bodies and nodes, keeping the structure of
+// the hierarchy. Returns false if the tree changed and needs a rebuild.
+bool
+MinorBodyBVH::refit(const FrameTree& tree, double tdb)
+{
+    windowStart = tdb - windowDuration;
+    windowEnd = tdb + windowDuration;
+
+    for (BodyBounds& bounds : bodies)
+    {
+        if (tree.getChild(bounds.child).get() != bounds.phase ||
+            !computeBounds(tree, bounds, tdb))
+        {
+            return false;
+        }
+    }
+
+    // Children always come after their parents
+    for (auto i = static_cast<std::uint32_t>(nodes.size()); i-- > 0;)
+        fitNode(i);
+
+    return true;
+}
+
+
+// Split the bodies [first, last) at the median along the longest axis of
+// their positions, filling in the node at index.
+void
+MinorBodyBVH::buildNode(std::uint32_t index, std::uint32_t first, std::uint32_t last)
+{
+    if (last - first <= MaxLeafBodies)
+    {
+        nodes[index].first = first;
+        nodes[index].count = last - first;
+        fitNode(index);
+        return;
+    }
+
+    Eigen::Vector3d lower = bodies[first].position;
+    Eigen::Vector3d upper = lower;
+    for (std::uint32_t i = first + 1; i < last; i++)
+    {
+        lower = lower.cwiseMin(bodies[i].position);
+        upper = upper.cwiseMax(bodies[i].position);
+    }
+
+    Eigen::Index axis;
+    (upper - lower).maxCoeff(&axis);
+    std::uint32_t middle = first + (last - first) / 2;
+    std::nth_element(bodies.begin() + first, bodies.begin() + middle, bodies.begin() + last,
+                     [axis](const BodyBounds& b0, const BodyBounds& b1)
+                     { return b0.position[axis] < b1.position[axis]; });
+
+    auto children = static_cast<std::uint32_t>(nodes.size());
+    nodes[index].first = children;
+    nodes[index].count = 0;
+    nodes.resize(nodes.size() + 2);
+
+    buildNode(children, first, middle);
+    buildNode(children + 1, middle, last);
+    fitNode(index);
+}
+
+
+void
+MinorBodyBVH::fitNode(std::uint32_t index)
+{
+    Node& node = nodes[index];
+    node.maxBodyRadius = 0.0f;
+    node.maxIlluminatorRadius = 0.0f;
+    node.classMask = 0;
+    node.orbitClassMask = 0;
+
+    auto fit = [&node](auto begin, auto end, auto center, auto radius)
+    {
+        Eigen::Vector3d lower = center(*begin) - Eigen::Vector3d::Constant(radius(*begin));
+        Eigen::Vector3d upper = center(*begin) + Eigen::Vector3d::Constant(radius(*begin));
+        for (auto it = begin; it != end; ++it)
+        {
+            lower = lower.cwiseMin(center(*it) - Eigen::Vector3d::Constant(radius(*it)));
+            upper = upper.cwiseMax(center(*it) + Eigen::Vector3d::Constant(radius(*it)));
+        }
+
+        node.center = (lower + upper) * 0.5;
+        node.radius = 0.0;
+        for (auto it = begin; it != end; ++it)
+            node.radius = std::max(node.radius, (center(*it) - node.center).norm() + radius(*it));
+    };
+
+    if (node.count > 0)
+    {
+        auto begin = bodies.begin() + node.first;
+        auto end = begin + node.count;
+        fit(begin, end,
+            [](const BodyBounds& b) { return b.position; },
+            [](const BodyBounds& b) { return b.radius; });
+        for (auto it = begin; it != end; ++it)
+        {
+            node.maxBodyRadius = std::max(node.maxBodyRadius, it->bodyRadius);
+            node.maxIlluminatorRadius = std::max(node.maxIlluminatorRadius, it->illuminatorRadius);
+            node.classMask |= it->classification;
+            node.orbitClassMask |= it->orbitClassification;
+        }
+    }
+    else
+    {
+        auto begin = nodes.begin() + node.first;
+        auto end = begin + 2;
+        fit(begin, end,
+            [](const Node& n) { return n.center; },
+            [](const Node& n) { return n.radius; });
+        for (auto it = begin; it != end; ++it)
+        {
+            node.maxBodyRadius = std::max(node.maxBodyRadius, it->maxBodyRadius);
+            node.maxIlluminatorRadius = std::max(node.maxIlluminatorRadius, it->maxIlluminatorRadius);
+            node.classMask |= it->classMask;
+            node.orbitClassMask |= it->orbitClassMask;
+        }
+    }
+}
@@ -0,0 +1,140 @@
+// minorbodybvh.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Bounding volume hierarchy over the minor bodies of a frame tree.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+class FrameTree;
+
+// Groups the asteroids, comets and minor moons of a frame tree by position
+// so that the renderer can reject whole groups of them that are outside the
+// view or too small and faint to be seen, instead of evaluating each orbit.
+//
+// Node bounds are valid over a window of time around the time they were
+// computed: each body's sphere is grown by how far the body may move within
+// the window. Once the time leaves the window the hierarchy is refit with
+// new positions, and every few refits rebuilt from scratch. Positions are
+// relative to the center of the frame tree, in astrocentric axes.
+//
+// Only bodies on inertial orbit frames which have no satellites or reference
+// marks are included; see covers().
+class MinorBodyBVH
+{
+ public:
+    struct Node
+    {
+        Eigen::Vector3d center;
+        double radius;
+        // Largest culling radius of the bodies below the node
+        float maxBodyRadius;
+        // Largest radius of the secondary illuminators below the node, zero
+        // if there are none
+        float maxIlluminatorRadius;
+        // Union of the classifications and orbit classifications of the
+        // bodies below the node
+        int classMask;
+        int orbitClassMask;
+        // Children of an inner node are at first and first + 1; a leaf
+        // holds count bodies starting at first in the body list.
+        std::uint32_t first;
+        std::uint32_t count;
+    };
+
+    // Smallest number of minor bodies for a tree to get a hierarchy
+    static constexpr unsigned int MinBodies = 256;
+
+    // Return true if the child of the tree is one of the bodies which can
+    // be kept in a hierarchy.
+    static bool isMinorBody(const FrameTree& tree, unsigned int child);
+
+    // Bring the hierarchy up to date for the tree at time tdb.
+    void update(const FrameTree& tree, double tdb);
+
+    // Visit the nodes from the root down, skipping the nodes below those for
+    // which test returns false. The bodies of the leaves that pass the test
+    // are the candidates of this traversal; all others are culled.
+    template<typename Test> void cull(Test test, std::uint32_t stamp)
+    {
+        cullStamp = stamp;
+        if (nodes.empty())
+            return;
+
+        std::vector<std::uint32_t> stack{ 0 };
+        while (!stack.empty())
+        {
+            const Node& node = nodes[stack.back()];
+            stack.pop_back();
+            if (!test(node))
+                continue;
+
+            if (node.count == 0)
+            {
+                stack.push_back(node.first);
+                stack.push_back(node.first + 1);
+                continue;
+            }
+
+            for (std::uint32_t i = node.first; i < node.first + node.count; i++)
+                candidateStamps[bodies[i].child] = stamp;
+        }
+    }
+
+    // Return true if the child of the tree was rejected by the traversal
+    // with the stamp, which must be the last one.
+    bool isCulled(unsigned int child, std::uint32_t stamp) const
+    {
+        return stamp == cullStamp &&
+               child < candidateStamps.size() &&
+               covered[child] &&
+               candidateStamps[child] != stamp;
+    }
+
+    bool covers(unsigned int child) const
+    {
+        return child < covered.size() && covered[child];
+    }
+
+    const std::vector<Node>& getNodes() const { return nodes; }
+
+ private:
+    struct BodyBounds
+    {
+        unsigned int child{ 0 };
+        const void* phase{ nullptr };
+        Eigen::Vector3d position{ Eigen::Vector3d::Zero() };
+        double radius{ 0.0 };
+        float bodyRadius{ 0.0f };
+        float illuminatorRadius{ 0.0f };
+        int classification{ 0 };
+        int orbitClassification{ 0 };
+    };
+
+    void build(const FrameTree& tree, double tdb);
+    bool refit(const FrameTree& tree, double tdb);
+    bool computeBounds(const FrameTree& tree, BodyBounds& bounds, double tdb) const;
+    void buildNode(std::uint32_t index, std::uint32_t first, std::uint32_t last);
+    void fitNode(std::uint32_t index);
+
+    std::vector<Node> nodes;
+    std::vector<BodyBounds> bodies;
+    std::vector<bool> covered;
+    std::vector<std::uint32_t> candidateStamps;
+    unsigned int childCount{ 0 };
+    double windowStart{ 0.0 };
+    double windowEnd{ -1.0 };
+    double windowDuration{ 0.0 };
+    unsigned int refitCount{ 0 };
+    std::uint32_t cullStamp{ 0 };
+};
@@ -10,6 +10,8 @@
 
 #include <vector>
 #include <utility>
+#include <Eigen/Geometry>
+#include <celmodel/meshquantize.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
 #include "glsupport.h"
@@ -35,6 +37,10 @@ public:
 
     std::vector<GLuint> vbos; // vertex buffer objects
     std::vector<GLuint> vios; // vertex index objects
+    // Layout of the vertices in the buffers, which differs from the mesh
+    // when attributes have to be converted for the driver
+    std::vector<cmod::VertexDescription> vertexDescs;
+    bool initialized{ false };
 };
 
 
@@ -55,108 +61,197 @@ ModelGeometry::~ModelGeometry() = default;
 bool
 ModelGeometry::pick(const Eigen::ParametrizedLine<double, 3>& r, double& distance) const
 {
-    return m_model->pick(r.origin(), r.direction(), distance);
+    std::call_once(m_bvhBuilt, [this] { m_bvh = std::make_unique<cmod::ModelBVH>(*m_model); });
+    return m_bvh->pick(r.origin(), r.direction(), distance);
 }
 
 
-/*! Render the model; the time parameter is ignored right now
- *  since this class doesn't currently support animation.
- */
+namespace
+{
+
+// Largest error of a level of detail on screen, in pixels
+constexpr float LODPixelError = 1.0f;
+
+// The vertex data is placed in vertex buffer objects for a huge rendering
+// performance boost.  This can consume a great deal of memory, since we're
+// duplicating the vertex data.  TODO: investigate the possibility of
+// deleting the original data.  We can always map read-only later on for
+// things like picking, but this could be a low performance path.
 void
-ModelGeometry::render(RenderContext& rc, double /* t */)
-{
-    // The first time the mesh is rendered, we will try and place the
-    // vertex data in a vertex buffer object and potentially get a huge
-    // rendering performance boost.  This can consume a great deal of
-    // memory, since we're duplicating the vertex data.  TODO: investigate
-    // the possibility of deleting the original data.  We can always map
-    // read-only later on for things like picking, but this could be a low
-    // performance path.
-    if (!m_vbInitialized)
+createModelBuffers(const cmod::Model& model, ModelOpenGLData& glData)
+{
+    if (glData.initialized)
+        return;
+
+    glData.initialized = true;
+
+    for (unsigned int i = 0; i < model.getMeshCount(); ++i)
     {
-        m_vbInitialized = true;
+        const cmod::Mesh* mesh = model.getMesh(i);
 
-        for (unsigned int i = 0; i < m_model->getMeshCount(); ++i)
+        // Drivers without half float vertex attributes get floats
+        cmod::Mesh converted;
+        if (!celestia::gl::ARB_half_float_vertex)
         {
-            const cmod::Mesh* mesh = m_model->getMesh(i);
-            const cmod::VertexDescription& vertexDesc = mesh->getVertexDescription();
-
-            GLuint vboId = 0;
-            glGenBuffers(1, &vboId);
-            glBindBuffer(GL_ARRAY_BUFFER, vboId);
-            glBufferData(GL_ARRAY_BUFFER,
-                         mesh->getVertexCount() * vertexDesc.strideBytes,
-                         mesh->getVertexData(),
-                         GL_STATIC_DRAW);
-
-            GLuint vioId = 0;
-            glGenBuffers(1, &vioId);
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vioId);
-
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                         mesh->getIndexCount() * sizeof(GL_UNSIGNED_INT),
-                         nullptr,
-                         GL_STATIC_DRAW);
-
-            for (unsigned int offset = 0, groupIndex = 0; groupIndex < mesh->getGroupCount(); ++groupIndex)
+            const cmod::VertexDescription& desc = mesh->getVertexDescription();
+            for (const cmod::VertexAttribute& attr : desc.attributes)
             {
-                const auto* group = mesh->getGroup(groupIndex);
-                auto size = group->indices.size() * sizeof(GL_UNSIGNED_INT);
-                glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, size, group->indices.data());
-                offset += size;
+                if (attr.format != cmod::VertexAttributeFormat::Half2)
+                    continue;
+                if (converted.getVertexCount() == 0)
+                    converted = mesh->clone();
+                cmod::ConvertVertexAttribute(converted, attr.semantic, cmod::VertexAttributeFormat::Float2);
             }
 
-            m_glData->vbos.push_back(vboId);
-            m_glData->vios.push_back(vioId);
+            if (converted.getVertexCount() > 0)
+                mesh = &converted;
+        }
+
+        const cmod::VertexDescription& vertexDesc = mesh->getVertexDescription();
+
+        GLuint vboId = 0;
+        glGenBuffers(1, &vboId);
+        glBindBuffer(GL_ARRAY_BUFFER, vboId);
+        glBufferData(GL_ARRAY_BUFFER,
+                     mesh->getVertexCount() * vertexDesc.strideBytes,
+                     mesh->getVertexData(),
+                     GL_STATIC_DRAW);
+
+        GLuint vioId = 0;
+        glGenBuffers(1, &vioId);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vioId);
+
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                     mesh->getIndexCount() * sizeof(GL_UNSIGNED_INT),
+                     nullptr,
+                     GL_STATIC_DRAW);
+
+        for (unsigned int offset = 0, groupIndex = 0; groupIndex < mesh->getGroupCount(); ++groupIndex)
+        {
+            const auto* group = mesh->getGroup(groupIndex);
+            auto size = group->indices.size() * sizeof(GL_UNSIGNED_INT);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, size, group->indices.data());
+            offset += size;
         }
+
+        glData.vbos.push_back(vboId);
+        glData.vios.push_back(vioId);
+        glData.vertexDescs.push_back(vertexDesc.clone());
     }
 
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+
+void
+renderModel(RenderContext& rc, const cmod::Model& model, ModelOpenGLData& glData, double t)
+{
+    // Buffers of models not loaded in the background are created the first
+    // time the model is rendered
+    createModelBuffers(model, glData);
+
     unsigned int lastMaterial = ~0u;
-    unsigned int materialCount = m_model->getMaterialCount();
+    unsigned int materialCount = model.getMaterialCount();
 
     // Iterate over all meshes in the model
-    for (unsigned int meshIndex = 0; meshIndex < m_model->getMeshCount(); ++meshIndex)
+    for (unsigned int meshIndex = 0; meshIndex < model.getMeshCount(); ++meshIndex)
     {
-        const cmod::Mesh* mesh = m_model->getMesh(meshIndex);
+        const cmod::Mesh* mesh = model.getMesh(meshIndex);
         GLuint vboId = 0;
         GLuint vioId = 0;
 
-        if (meshIndex < m_glData->vbos.size())
+        if (meshIndex < glData.vbos.size())
         {
-            vboId = m_glData->vbos[meshIndex];
-            vioId = m_glData->vios[meshIndex];
+            vboId = glData.vbos[meshIndex];
+            vioId = glData.vios[meshIndex];
         }
         else
         {
-            GetLogger()->error(_("Mesh index {} is higher than VBO count {}!"), meshIndex, m_glData->vbos.size());
+            GetLogger()->error(_("Mesh index {} is higher than VBO count {}!"), meshIndex, glData.vbos.size());
         }
 
+        const cmod::VertexDescription& vertexDesc = meshIndex < glData.vertexDescs.size()
+            ? glData.vertexDescs[meshIndex]
+            : mesh->getVertexDescription();
+
         glBindBuffer(GL_ARRAY_BUFFER, vboId);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vioId);
-        rc.setVertexArrays(mesh->getVertexDescription(), nullptr);
+        rc.setVertexArrays(vertexDesc, nullptr);
+
+        // Quantized positions are mapped to the model by the mesh transform
+        const cmod::TransformTrack* track = model.getTrack(mesh->getTrackIndex());
+        if (track != nullptr || mesh->hasQuantizedPositions())
+        {
+            Eigen::Matrix4f transform = track != nullptr
+                ? track->evaluate(t).matrix()
+                : Eigen::Matrix4f::Identity();
+            if (mesh->hasQuantizedPositions())
+            {
+                Eigen::Affine3f dequantize = Eigen::Translation3f(mesh->getPositionOffset())
+                                           * Eigen::Scaling(mesh->getPositionScale());
+                transform = transform * dequantize.matrix();
+            }
+            rc.setMeshTransform(&transform);
+        }
+        else
+        {
+            rc.setMeshTransform(nullptr);
+        }
 
         // Iterate over all primitive groups in the mesh
         for (unsigned int groupIndex = 0; groupIndex < mesh->getGroupCount(); ++groupIndex)
         {
             const cmod::PrimitiveGroup* group = mesh->getGroup(groupIndex);
-            rc.updateShader(mesh->getVertexDescription(), group->prim);
+            rc.updateShader(vertexDesc, group->prim);
 
             // Set up the material
             const cmod::Material* material = nullptr;
             unsigned int materialIndex = group->materialIndex;
             if (materialIndex != lastMaterial && materialIndex < materialCount)
             {
-                material = m_model->getMaterial(materialIndex);
+                material = model.getMaterial(materialIndex);
             }
 
             rc.setMaterial(material);
             rc.drawGroup(*group);
         }
     }
+    rc.setMeshTransform(nullptr);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
+} // end unnamed namespace
+
+
+/*! Render the model at time t in seconds, which sets the pose of meshes
+ *  animated by transform tracks. The coarsest level of detail whose
+ *  error is invisible at the pixel scale of the render context is drawn.
+ */
+void
+ModelGeometry::render(RenderContext& rc, double t)
+{
+    float pixelsPerUnit = rc.getPixelsPerUnit();
+    for (auto lod = m_lods.rbegin(); lod != m_lods.rend(); ++lod)
+    {
+        if (lod->error * pixelsPerUnit <= LODPixelError)
+        {
+            renderModel(rc, *lod->model, *lod->glData, t);
+            return;
+        }
+    }
+
+    renderModel(rc, *m_model, *m_glData, t);
+}
+
+
+void
+ModelGeometry::addLevelOfDetail(std::unique_ptr<cmod::Model>&& model, float error)
+{
+    m_lods.push_back(LevelOfDetail{ std::move(model), error, std::make_unique<ModelOpenGLData>() });
+}
+
 
 bool
 ModelGeometry::isOpaque() const
@@ -172,6 +267,32 @@ ModelGeometry::isNormalized() const
 }
 
 
+// Meshes are posed by transform tracks
+bool
+ModelGeometry::isAnimated() const
+{
+    return m_model->getTrackCount() > 0;
+}
+
+
+// Point sprites are sized by the scale of a single object
+bool
+ModelGeometry::isInstanceable() const
+{
+    for (unsigned int i = 0; i < m_model->getMeshCount(); ++i)
+    {
+        const cmod::Mesh* mesh = m_model->getMesh(i);
+        for (unsigned int j = 0; j < mesh->getGroupCount(); ++j)
+        {
+            if (mesh->getGroup(j)->prim == cmod::PrimitiveGroupType::SpriteList)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+
 bool
 ModelGeometry::usesTextureType(cmod::TextureSemantic t) const
 {
@@ -179,6 +300,25 @@ ModelGeometry::usesTextureType(cmod::TextureSemantic t) const
 }
 
 
+void
+ModelGeometry::createBuffers()
+{
+    createModelBuffers(*m_model, *m_glData);
+    for (LevelOfDetail& lod : m_lods)
+        createModelBuffers(*lod.model, *lod.glData);
+}
+
+
+std::size_t
+ModelGeometry::getMemoryUsage() const
+{
+    std::size_t size = sizeof(ModelGeometry) + m_model->getMemoryUsage();
+    for (const LevelOfDetail& lod : m_lods)
+        size += sizeof(LevelOfDetail) + lod.model->getMemoryUsage();
+    return size;
+}
+
+
 void
 ModelGeometry::loadTextures()
 {
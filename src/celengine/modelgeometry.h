@@ -11,9 +11,12 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include <Eigen/Geometry>
 
+#include <celmodel/meshbvh.h>
 #include <celmodel/model.h>
 #include "geometry.h"
 
@@ -40,11 +43,33 @@ class ModelGeometry : public Geometry
     bool usesTextureType(cmod::TextureSemantic) const override;
     bool isOpaque() const override;
     bool isNormalized() const override;
+    bool isInstanceable() const override;
+    bool isAnimated() const override;
 
     void loadTextures() override;
+    void createBuffers() override;
+    std::size_t getMemoryUsage() const override;
+
+    /*! Add a simplified version of the model, drawn instead whenever its
+     *  error, in model units, is less than a pixel on screen. Levels have
+     *  to be added from the finest to the coarsest.
+     */
+    void addLevelOfDetail(std::unique_ptr<cmod::Model>&& model, float error);
+    unsigned int getLevelOfDetailCount() const { return static_cast<unsigned int>(m_lods.size()); }
 
  private:
+    struct LevelOfDetail
+    {
+        std::unique_ptr<cmod::Model> model;
+        float error;
+        std::unique_ptr<ModelOpenGLData> glData;
+    };
+
     std::unique_ptr<cmod::Model> m_model;
-    bool m_vbInitialized{ false };
     std::unique_ptr<ModelOpenGLData> m_glData;
+    std::vector<LevelOfDetail> m_lods;
+
+    // Built on the first pick, since most models are never picked
+    mutable std::once_flag m_bvhBuilt;
+    mutable std::unique_ptr<cmod::ModelBVH> m_bvh;
 };
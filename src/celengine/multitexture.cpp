@@ -7,12 +7,27 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+
+#include <celcompat/numbers.h>
 #include "multitexture.h"
 #include "texmanager.h"
 
 using namespace std;
 
 
+// Widths assumed for the resolutions whose textures haven't been found yet
+static const float NominalWidths[3] = { 2048.0f, 4096.0f, 8192.0f };
+
+// An object switches to a lower resolution only once that has this many
+// times the texels needed, so that it doesn't switch back and forth as its
+// size changes around a threshold
+static const float DownscaleMargin = 1.25f;
+
+unsigned int MultiResTexture::maxResolution = hires;
+bool MultiResTexture::useAutoResolution = false;
+
+
 MultiResTexture::MultiResTexture()
 {
     tex[lores] = InvalidResource;
@@ -61,13 +76,42 @@ void MultiResTexture::setTexture(const string& source,
 }
 
 
-Texture* MultiResTexture::find(unsigned int resolution)
+void MultiResTexture::setPackedTexture(const string& source,
+                                       const string& alphaSource,
+                                       const fs::path& path,
+                                       unsigned int flags)
 {
     TextureManager* texMan = GetTextureManager();
+    for (unsigned int resolution : { lores, medres, hires })
+    {
+        TextureInfo info(source, path, flags, resolution);
+        info.setAlphaSource(alphaSource);
+        tex[resolution] = texMan->getHandle(info);
+    }
+}
+
+
+// Textures are loaded in order of screen size per texel, as each resolution
+// has about four times as many texels as the one below.
+static float getLoadingPriority(unsigned int resolution, float sizeInPixels)
+{
+    return sizeInPixels / static_cast<float>(1u << (2 * resolution));
+}
+
 
-    Texture* res = texMan->find(tex[resolution]);
+Texture* MultiResTexture::find(unsigned int resolution, float sizeInPixels)
+{
+    TextureManager* texMan = GetTextureManager();
+    resolution = min(resolution, maxResolution);
+    if (useAutoResolution && sizeInPixels > 0.0f)
+        resolution = selectResolution(resolution, sizeInPixels);
+
+    Texture* res = texMan->find(tex[resolution], getLoadingPriority(resolution, sizeInPixels));
     if (res != nullptr)
+    {
+        widths[resolution] = res->getWidth();
         return res;
+    }
 
     // Preferred resolution isn't available; try the second choice
     // Set these to some defaults to avoid GCC complaints
@@ -90,14 +134,54 @@ Texture* MultiResTexture::find(unsigned int resolution)
         break;
     }
 
+    // Don't fall back for good on a texture which may still load
+    if (texMan->getState(tex[resolution]) == ResourceState::Loading)
+    {
+        for (unsigned int standIn : { secondChoice, lastResort })
+        {
+            if (texMan->getState(tex[standIn]) == ResourceState::Loaded)
+                return texMan->find(tex[standIn]);
+        }
+        return nullptr;
+    }
+
     tex[resolution] = tex[secondChoice];
-    res = texMan->find(tex[resolution]);
-    if (res != nullptr)
+    res = texMan->find(tex[resolution], getLoadingPriority(secondChoice, sizeInPixels));
+    if (res != nullptr || texMan->getState(tex[resolution]) == ResourceState::Loading)
         return res;
 
     tex[resolution] = tex[lastResort];
 
-    return texMan->find(tex[resolution]);
+    return texMan->find(tex[resolution], getLoadingPriority(lastResort, sizeInPixels));
+}
+
+
+unsigned int MultiResTexture::selectResolution(unsigned int resolution, float sizeInPixels)
+{
+    // The width of the texture wraps around the object
+    float neededWidth = 2.0f * celestia::numbers::pi_v<float> * sizeInPixels;
+
+    unsigned int selected = resolution;
+    for (unsigned int r = lores; r < resolution; ++r)
+    {
+        float margin = r < autoResolution ? DownscaleMargin : 1.0f;
+        if (getWidth(r) >= neededWidth * margin)
+        {
+            selected = r;
+            break;
+        }
+    }
+
+    // The textures of the other resolutions are left to the texture
+    // memory budget to unload once they're no longer drawn
+    autoResolution = selected;
+    return selected;
+}
+
+
+float MultiResTexture::getWidth(unsigned int resolution) const
+{
+    return widths[resolution] != 0 ? static_cast<float>(widths[resolution]) : NominalWidths[resolution];
 }
 
 
@@ -107,3 +191,27 @@ bool MultiResTexture::isValid() const
             tex[medres] != InvalidResource ||
             tex[hires] != InvalidResource);
 }
+
+
+void MultiResTexture::setMaxResolution(unsigned int resolution)
+{
+    maxResolution = min(resolution, static_cast<unsigned int>(hires));
+}
+
+
+unsigned int MultiResTexture::getMaxResolution()
+{
+    return maxResolution;
+}
+
+
+void MultiResTexture::setAutoResolution(bool enable)
+{
+    useAutoResolution = enable;
+}
+
+
+bool MultiResTexture::getAutoResolution()
+{
+    return useAutoResolution;
+}
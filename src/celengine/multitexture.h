@@ -23,6 +23,7 @@ enum {
 };
 
 
+
 class MultiResTexture
 {
  public:
@@ -39,12 +40,42 @@ class MultiResTexture
                     const fs::path& path,
                     float bumpHeight,
                     unsigned int flags);
-    Texture* find(unsigned int resolution);
+    // A texture whose alpha channel is the grayscale image alphaSource
+    void setPackedTexture(const std::string& source,
+                          const std::string& alphaSource,
+                          const fs::path& path,
+                          unsigned int flags);
+    // While the texture is loaded in the background, another resolution
+    // which is already loaded stands in for it. sizeInPixels, the size of
+    // the textured object on screen, sets the loading priority.
+    Texture* find(unsigned int resolution, float sizeInPixels = 0.0f);
 
     bool isValid() const;
 
+    // Find textures of at most this resolution, whatever is requested, to
+    // use less memory
+    static void setMaxResolution(unsigned int);
+    static unsigned int getMaxResolution();
+
+    // Find the textures of the lowest resolution with about a texel per
+    // pixel for the size in pixels passed, up to the resolution requested,
+    // so that small objects don't load their largest textures
+    static void setAutoResolution(bool);
+    static bool getAutoResolution();
+
  public:
     ResourceHandle tex[3];
+
+ private:
+    unsigned int selectResolution(unsigned int resolution, float sizeInPixels);
+    float getWidth(unsigned int resolution) const;
+
+    // Widths of the textures found for each resolution, zero until found
+    int widths[3]{ 0, 0, 0 };
+    unsigned int autoResolution{ lores };
+
+    static unsigned int maxResolution;
+    static bool useAutoResolution;
 };
 
 #endif // _CELENGINE_MULTITEXTURE_H_
@@ -1,14 +1,111 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
 #ifdef DEBUG
 #include <celutil/logger.h>
 #endif
+#include <celutil/binarywrite.h>
 #include <celutil/gettext.h>
 #include <celutil/greek.h>
+#include <celutil/memoryreport.h>
 #include <celutil/utf8.h>
 #include "name.h"
 
+namespace celutil = celestia::util;
+
+namespace
+{
+
+constexpr std::string_view NAMESDAT_MAGIC = "CELNAMES";
+constexpr std::uint16_t NAMESDAT_VERSION = 0x0100;
+// Written little endian, so a compiled database can only be mapped on a
+// little endian host.
+constexpr std::uint32_t NAMESDAT_BYTE_ORDER = 0x01020304;
+
+#pragma pack(push, 1)
+// Compiled name database header; it is followed by the entries, the name
+// and number hash tables, the completion index, the names and the
+// completion keys.
+struct NamesDatHeader
+{
+    char magic[8];
+    std::uint16_t version;
+    std::uint16_t reserved;
+    std::uint32_t byteOrder;
+    std::uint32_t namesSize;
+    std::uint32_t entryCount;
+    std::uint32_t nameSlotCount;
+    std::uint32_t nameCount;
+    std::uint32_t numberSlotCount;
+    std::uint32_t numberCount;
+    std::uint32_t completionCount;
+    std::uint32_t completionKeysSize;
+};
+#pragma pack(pop)
+
+// Keeps the arrays that follow aligned
+static_assert(sizeof(NamesDatHeader) % sizeof(std::uint32_t) == 0);
+
+bool isPowerOfTwo(std::uint32_t n)
+{
+    return (n & (n - 1)) == 0;
+}
+
+std::uint32_t hashIgnoringCase(std::string_view name)
+{
+    // FNV-1a over the characters as compared by compareIgnoringCase
+    std::uint32_t hash = 2166136261u;
+    for (char c : name)
+    {
+        hash ^= static_cast<std::uint32_t>(std::toupper(static_cast<unsigned char>(c)));
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+std::size_t hashNumber(AstroCatalog::IndexNumber catalogNumber)
+{
+    // Fold the high bits down, as the slot is taken from the low ones
+    std::uint32_t hash = catalogNumber * 2654435761u;
+    return static_cast<std::size_t>(hash ^ (hash >> 16));
+}
+
+} // end unnamed namespace
+
+std::string_view NameDatabase::NameIterator::operator*() const
+{
+    return db->getEntryName(entry);
+}
+
+NameDatabase::NameIterator& NameDatabase::NameIterator::operator++()
+{
+    entry = entry < db->entries.size() ? db->entries[entry].next : InvalidEntry;
+    return *this;
+}
+
 std::uint32_t NameDatabase::getNameCount() const
 {
-    return nameIndex.size();
+    return nameCount;
+}
+
+std::size_t NameDatabase::getMemoryUsage() const
+{
+    using celestia::util::stringMemory;
+    using celestia::util::vectorMemory;
+
+    std::scoped_lock lock(indexMutex);
+    return stringMemory(ownedNames) +
+           vectorMemory(ownedEntries) +
+           vectorMemory(ownedNameSlots) +
+           vectorMemory(ownedNumberSlots) +
+           vectorMemory(localizedSlots) +
+           vectorMemory(ownedCompletionEntries) +
+           stringMemory(ownedCompletionKeys) +
+           vectorMemory(localizedCompletionEntries) +
+           stringMemory(localizedCompletionKeys);
 }
 
 void NameDatabase::add(const AstroCatalog::IndexNumber catalogNumber, const std::string& name, bool /*replaceGreek*/)
@@ -20,33 +117,61 @@ void NameDatabase::add(const AstroCatalog::IndexNumber catalogNumber, const std:
         if ((tmp = getCatalogNumberByName(name, false)) != AstroCatalog::InvalidIndex)
             celestia::util::GetLogger()->debug("Duplicated name '{}' on object with catalog numbers: {} and {}\n", name, tmp, catalogNumber);
 #endif
+        detach();
+
         // Add the new name
-        //nameIndex.insert(NameIndex::value_type(name, catalogNumber));
         std::string fname = ReplaceGreekLetterAbbr(name);
 
-        nameIndex[fname] = catalogNumber;
-        std::string lname = D_(fname.c_str());
-        if (lname != fname)
-            localizedNameIndex[lname] = catalogNumber;
-        numberIndex.insert(NumberIndex::value_type(catalogNumber, fname));
+        auto entry = static_cast<std::uint32_t>(ownedEntries.size());
+        NameEntry& nameEntry = ownedEntries.emplace_back();
+        nameEntry.offset = static_cast<std::uint32_t>(ownedNames.size());
+        nameEntry.length = static_cast<std::uint32_t>(fname.size());
+        nameEntry.catalogNumber = catalogNumber;
+        ownedNames.append(fname);
+        ownedNames.push_back('\0');
+
+        if (catalogNumber != AstroCatalog::InvalidIndex)
+        {
+            NumberSlot* slot = insertNumber(catalogNumber);
+            if (slot->first == InvalidEntry)
+                slot->first = entry;
+            else
+                ownedEntries[slot->last].next = entry;
+            slot->last = entry;
+        }
+
+        updateViews();
+        insertName(ownedNameSlots, nameCount, fname, entry, catalogNumber, false);
+        updateViews();
+
+        // The localized names are indexed when first looked up
+        completionIndexValid = false;
+        ++generation;
     }
 }
 void NameDatabase::erase(const AstroCatalog::IndexNumber catalogNumber)
 {
-    numberIndex.erase(catalogNumber);
+    // The names stay in the name index, as they did with the multimap
+    if (findNumberSlot(catalogNumber) == nullptr)
+        return;
+
+    detach();
+    auto slot = const_cast<NumberSlot*>(findNumberSlot(catalogNumber));
+    slot->first = slot->last = InvalidEntry;
+    ++generation;
 }
 
 AstroCatalog::IndexNumber NameDatabase::getCatalogNumberByName(std::string_view name, bool i18n) const
 {
-    auto iter = nameIndex.find(name);
-    if (iter != nameIndex.end())
-        return iter->second;
+    if (const NameSlot* slot = findName(nameSlots, name, false); slot != nullptr)
+        return slot->catalogNumber;
 
     if (i18n)
     {
-        iter = localizedNameIndex.find(name);
-        if (iter != localizedNameIndex.end())
-            return iter->second;
+        std::scoped_lock lock(indexMutex);
+        updateLocalizedIndex();
+        if (const NameSlot* slot = findName(localizedSlots, name, true); slot != nullptr)
+            return slot->catalogNumber;
     }
 
     auto replacedGreek = ReplaceGreekLetterAbbr(name);
@@ -56,68 +181,475 @@ AstroCatalog::IndexNumber NameDatabase::getCatalogNumberByName(std::string_view
     return AstroCatalog::InvalidIndex;
 }
 
-// Return the first name matching the catalog number or end()
+// Return the first name matching the catalog number or an empty string
 // if there are no matching names.  The first name *should* be the
 // proper name of the OBJ, if one exists. This requires the
 // OBJ name database file to have the proper names listed before
-// other designations.  Also, the STL implementation must
-// preserve this order when inserting the names into the multimap
-// (not certain whether or not this behavior is in the STL spec.
-// but it works on the implementations I've tried so far.)
+// other designations.
 std::string NameDatabase::getNameByCatalogNumber(const AstroCatalog::IndexNumber catalogNumber) const
 {
     if (catalogNumber == AstroCatalog::InvalidIndex)
         return "";
 
-    NumberIndex::const_iterator iter = numberIndex.lower_bound(catalogNumber);
-
-    if (iter != numberIndex.end() && iter->first == catalogNumber)
-        return iter->second;
+    auto iter = getFirstNameIter(catalogNumber);
+    if (iter != getFinalNameIter())
+        return std::string(*iter);
 
     return "";
 }
 
 
 // Return the first name matching the catalog number or end()
-// if there are no matching names.  The first name *should* be the
-// proper name of the OBJ, if one exists. This requires the
-// OBJ name database file to have the proper names listed before
-// other designations.  Also, the STL implementation must
-// preserve this order when inserting the names into the multimap
-// (not certain whether or not this behavior is in the STL spec.
-// but it works on the implementations I've tried so far.)
-NameDatabase::NumberIndex::const_iterator NameDatabase::getFirstNameIter(const AstroCatalog::IndexNumber catalogNumber) const
+// if there are no matching names.  The names are iterated in the order
+// they were added.
+NameDatabase::NameIterator NameDatabase::getFirstNameIter(const AstroCatalog::IndexNumber catalogNumber) const
+{
+    const NumberSlot* slot = findNumberSlot(catalogNumber);
+    return NameIterator(this, slot == nullptr ? InvalidEntry : slot->first);
+}
+
+NameDatabase::NameIterator NameDatabase::getFinalNameIter() const
+{
+    return NameIterator(this, InvalidEntry);
+}
+
+void NameDatabase::getCompletion(std::vector<std::string>& completion,
+                                 std::string_view name,
+                                 bool i18n,
+                                 std::size_t maxResults) const
 {
-    NumberIndex::const_iterator iter = numberIndex.lower_bound(catalogNumber);
+    std::string prefix;
+    if (!UTF8FoldCase(ReplaceGreekLetter(name), prefix))
+        return;
+
+    std::scoped_lock lock(indexMutex);
+    if (!completionIndexValid)
+        buildCompletionIndex();
+    if (i18n)
+    {
+        updateLocalizedIndex();
+        if (!localizedCompletionValid)
+        {
+            addCompletions(localizedCompletionEntries, localizedCompletionKeys, localizedSlots, true);
+            localizedCompletionValid = true;
+        }
+    }
 
-    if (iter == numberIndex.end() || iter->first != catalogNumber)
-        return getFinalNameIter();
+    struct Match
+    {
+        std::string_view key;
+        std::uint32_t entry;
+        bool localized;
+    };
+
+    // The names starting with the prefix form a contiguous range of the
+    // sorted keys.
+    std::vector<Match> matches;
+    auto findMatches = [&prefix, &matches](const celutil::array_view<CompletionEntry>& index,
+                                           std::string_view keys,
+                                           bool localized)
+    {
+        auto getKey = [keys](const CompletionEntry& entry)
+        {
+            return entry.keyOffset > keys.size() ? std::string_view() : keys.substr(entry.keyOffset, entry.keyLength);
+        };
+        auto first = std::lower_bound(index.begin(), index.end(), prefix,
+                                      [&getKey](const CompletionEntry& entry, std::string_view key)
+                                      {
+                                          return getKey(entry) < key;
+                                      });
+        for (auto iter = first; iter != index.end(); ++iter)
+        {
+            std::string_view key = getKey(*iter);
+            if (key.substr(0, prefix.size()) != prefix)
+                break;
+            matches.push_back({ key, iter->entry, localized });
+        }
+    };
+
+    findMatches(completionEntries, completionKeys, false);
+    if (i18n)
+        findMatches(localizedCompletionEntries, localizedCompletionKeys, true);
+
+    // Shortest first, which puts exact matches at the front; names of the
+    // same length remain sorted.
+    auto rank = [](const Match& a, const Match& b)
+    {
+        if (a.key.size() != b.key.size())
+            return a.key.size() < b.key.size();
+        if (a.key != b.key)
+            return a.key < b.key;
+        return std::make_pair(a.localized, a.entry) < std::make_pair(b.localized, b.entry);
+    };
+    if (matches.size() > maxResults)
+    {
+        std::partial_sort(matches.begin(), matches.begin() + maxResults, matches.end(), rank);
+        matches.resize(maxResults);
+    }
     else
-        return iter;
+    {
+        std::sort(matches.begin(), matches.end(), rank);
+    }
+
+    completion.reserve(completion.size() + matches.size());
+    for (const Match& match : matches)
+        completion.emplace_back(getEntryKey(match.entry, match.localized));
 }
 
-NameDatabase::NumberIndex::const_iterator NameDatabase::getFinalNameIter() const
+bool NameDatabase::isBinary(const fs::path& path)
 {
-    return numberIndex.end();
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    NamesDatHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)).good())
+        return false;
+
+    return std::string_view(header.magic, sizeof(header.magic)) == NAMESDAT_MAGIC;
 }
 
-void NameDatabase::getCompletion(std::vector<std::string>& completion, std::string_view name, bool i18n) const
+bool NameDatabase::loadBinary(const fs::path& path)
 {
-    std::string name2 = ReplaceGreekLetter(name);
+    if (!entries.empty())
+        return false;
 
-    const int name_length = UTF8Length(name2);
+    auto file = celutil::MappedFile::open(path);
+    if (file == nullptr || file->size() < sizeof(NamesDatHeader))
+        return false;
 
-    for (const auto &[n, _] : nameIndex)
+    NamesDatHeader header;
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::string_view(header.magic, sizeof(header.magic)) != NAMESDAT_MAGIC
+        || header.byteOrder != NAMESDAT_BYTE_ORDER
+        || header.version != NAMESDAT_VERSION
+        || !isPowerOfTwo(header.nameSlotCount)
+        || !isPowerOfTwo(header.numberSlotCount)
+        || header.nameCount > header.nameSlotCount / 2
+        || header.numberCount > header.numberSlotCount / 2)
     {
-        if (!UTF8StringCompare(n, name2, name_length, true))
-            completion.push_back(n);
+        return false;
     }
-    if (i18n)
+
+    std::uint64_t expectedSize = sizeof(NamesDatHeader)
+                               + static_cast<std::uint64_t>(header.entryCount) * sizeof(NameEntry)
+                               + static_cast<std::uint64_t>(header.nameSlotCount) * sizeof(NameSlot)
+                               + static_cast<std::uint64_t>(header.numberSlotCount) * sizeof(NumberSlot)
+                               + static_cast<std::uint64_t>(header.completionCount) * sizeof(CompletionEntry)
+                               + header.namesSize
+                               + header.completionKeysSize;
+    if (file->size() != expectedSize)
+        return false;
+
+    // The names are passed to gettext, so they must stay NUL terminated
+    const char* ptr = file->data() + sizeof(NamesDatHeader);
+    const char* namesPtr = file->data() + (file->size() - header.namesSize - header.completionKeysSize);
+    if (header.namesSize > 0 && namesPtr[header.namesSize - 1] != '\0')
+        return false;
+
+    auto mapArray = [&ptr](auto& view, std::uint32_t count)
     {
-        for (const auto &[n, _] : localizedNameIndex)
+        using T = typename std::remove_reference_t<decltype(view)>::element_type;
+        view = celutil::array_view<T>(reinterpret_cast<const T*>(ptr), count);
+        ptr += static_cast<std::size_t>(count) * sizeof(T);
+    };
+    mapArray(entries, header.entryCount);
+    mapArray(nameSlots, header.nameSlotCount);
+    mapArray(numberSlots, header.numberSlotCount);
+    mapArray(completionEntries, header.completionCount);
+    names = std::string_view(ptr, header.namesSize);
+    completionKeys = std::string_view(ptr + header.namesSize, header.completionKeysSize);
+
+    nameCount = header.nameCount;
+    numberCount = header.numberCount;
+    completionIndexValid = true;
+    mappedFile = std::move(file);
+    ++generation;
+
+    return true;
+}
+
+bool NameDatabase::writeBinary(std::ostream& out) const
+{
+    std::scoped_lock lock(indexMutex);
+    if (!completionIndexValid)
+        buildCompletionIndex();
+
+    if (!out.write(NAMESDAT_MAGIC.data(), NAMESDAT_MAGIC.size()).good()
+        || !celutil::writeLE<std::uint16_t>(out, NAMESDAT_VERSION)
+        || !celutil::writeLE<std::uint16_t>(out, 0)
+        || !celutil::writeLE<std::uint32_t>(out, NAMESDAT_BYTE_ORDER)
+        || !celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(names.size()))
+        || !celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(entries.size()))
+        || !celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(nameSlots.size()))
+        || !celutil::writeLE<std::uint32_t>(out, nameCount)
+        || !celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(numberSlots.size()))
+        || !celutil::writeLE<std::uint32_t>(out, numberCount)
+        || !celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(completionEntries.size()))
+        || !celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(completionKeys.size())))
+    {
+        return false;
+    }
+
+    for (const NameEntry& entry : entries)
+    {
+        if (!celutil::writeLE<std::uint32_t>(out, entry.offset)
+            || !celutil::writeLE<std::uint32_t>(out, entry.length)
+            || !celutil::writeLE<std::uint32_t>(out, entry.catalogNumber)
+            || !celutil::writeLE<std::uint32_t>(out, entry.next))
         {
-            if (!UTF8StringCompare(n, name2, name_length, true))
-                completion.push_back(n);
+            return false;
         }
     }
+
+    for (const NameSlot& slot : nameSlots)
+    {
+        if (!celutil::writeLE<std::uint32_t>(out, slot.hash)
+            || !celutil::writeLE<std::uint32_t>(out, slot.entry)
+            || !celutil::writeLE<std::uint32_t>(out, slot.catalogNumber))
+        {
+            return false;
+        }
+    }
+
+    for (const NumberSlot& slot : numberSlots)
+    {
+        if (!celutil::writeLE<std::uint32_t>(out, slot.catalogNumber)
+            || !celutil::writeLE<std::uint32_t>(out, slot.first)
+            || !celutil::writeLE<std::uint32_t>(out, slot.last))
+        {
+            return false;
+        }
+    }
+
+    for (const CompletionEntry& entry : completionEntries)
+    {
+        if (!celutil::writeLE<std::uint32_t>(out, entry.keyOffset)
+            || !celutil::writeLE<std::uint32_t>(out, entry.keyLength)
+            || !celutil::writeLE<std::uint32_t>(out, entry.entry)
+            || !celutil::writeLE<std::uint32_t>(out, entry.localized))
+        {
+            return false;
+        }
+    }
+
+    return out.write(names.data(), names.size()).good()
+        && out.write(completionKeys.data(), completionKeys.size()).good();
+}
+
+std::string_view NameDatabase::getEntryName(std::uint32_t entry) const
+{
+    // Bounds are checked here rather than when a compiled database is
+    // mapped, which would read the whole file.
+    if (entry >= entries.size() || entries[entry].offset >= names.size())
+        return {};
+    return names.substr(entries[entry].offset, entries[entry].length);
+}
+
+std::string_view NameDatabase::getEntryKey(std::uint32_t entry, bool localized) const
+{
+    std::string_view name = getEntryName(entry);
+    if (!localized || name.empty())
+        return name;
+    return D_(name.data());
+}
+
+const NameDatabase::NameSlot* NameDatabase::findName(const celutil::array_view<NameSlot>& slots,
+                                                     std::string_view name,
+                                                     bool localized) const
+{
+    if (slots.empty())
+        return nullptr;
+
+    std::uint32_t hash = hashIgnoringCase(name);
+    std::size_t mask = slots.size() - 1;
+    std::size_t i = hash & mask;
+    for (std::size_t probes = 0; probes < slots.size(); ++probes, i = (i + 1) & mask)
+    {
+        const NameSlot& slot = slots[i];
+        if (slot.entry == InvalidEntry)
+            break;
+        if (slot.hash == hash && compareIgnoringCase(getEntryKey(slot.entry, localized), name) == 0)
+            return &slot;
+    }
+
+    return nullptr;
+}
+
+const NameDatabase::NumberSlot* NameDatabase::findNumberSlot(AstroCatalog::IndexNumber catalogNumber) const
+{
+    if (numberSlots.empty() || catalogNumber == AstroCatalog::InvalidIndex)
+        return nullptr;
+
+    std::size_t mask = numberSlots.size() - 1;
+    std::size_t i = hashNumber(catalogNumber) & mask;
+    for (std::size_t probes = 0; probes < numberSlots.size(); ++probes, i = (i + 1) & mask)
+    {
+        const NumberSlot& slot = numberSlots[i];
+        if (slot.catalogNumber == catalogNumber)
+            return &slot;
+        if (slot.catalogNumber == AstroCatalog::InvalidIndex)
+            break;
+    }
+
+    return nullptr;
+}
+
+// Copy a mapped database to memory before changing it
+void NameDatabase::detach()
+{
+    if (mappedFile == nullptr)
+        return;
+
+    ownedNames.assign(names);
+    ownedEntries.assign(entries.begin(), entries.end());
+    ownedNameSlots.assign(nameSlots.begin(), nameSlots.end());
+    ownedNumberSlots.assign(numberSlots.begin(), numberSlots.end());
+    updateViews();
+    mappedFile.reset();
+
+    completionIndexValid = false;
+}
+
+void NameDatabase::updateViews()
+{
+    names = ownedNames;
+    entries = ownedEntries;
+    nameSlots = ownedNameSlots;
+    numberSlots = ownedNumberSlots;
+}
+
+void NameDatabase::insertName(std::vector<NameSlot>& slots,
+                              std::uint32_t& count,
+                              std::string_view name,
+                              std::uint32_t entry,
+                              AstroCatalog::IndexNumber catalogNumber,
+                              bool localized) const
+{
+    // Keep the load factor at most 1/2
+    if ((count + 1) * 2 > slots.size())
+    {
+        std::vector<NameSlot> oldSlots(std::max(slots.size() * 2, std::size_t(64)));
+        oldSlots.swap(slots);
+        std::size_t mask = slots.size() - 1;
+        for (const NameSlot& slot : oldSlots)
+        {
+            if (slot.entry == InvalidEntry)
+                continue;
+            std::size_t i = slot.hash & mask;
+            while (slots[i].entry != InvalidEntry)
+                i = (i + 1) & mask;
+            slots[i] = slot;
+        }
+    }
+
+    std::uint32_t hash = hashIgnoringCase(name);
+    std::size_t mask = slots.size() - 1;
+    std::size_t i = hash & mask;
+    for (;; i = (i + 1) & mask)
+    {
+        NameSlot& slot = slots[i];
+        if (slot.entry == InvalidEntry)
+            break;
+        // An existing name keeps its spelling and gets the new number
+        if (slot.hash == hash && compareIgnoringCase(getEntryKey(slot.entry, localized), name) == 0)
+        {
+            slot.catalogNumber = catalogNumber;
+            return;
+        }
+    }
+
+    slots[i].hash = hash;
+    slots[i].entry = entry;
+    slots[i].catalogNumber = catalogNumber;
+    ++count;
+}
+
+NameDatabase::NumberSlot* NameDatabase::insertNumber(AstroCatalog::IndexNumber catalogNumber)
+{
+    if ((numberCount + 1) * 2 > ownedNumberSlots.size())
+    {
+        std::vector<NumberSlot> oldSlots(std::max(ownedNumberSlots.size() * 2, std::size_t(64)));
+        oldSlots.swap(ownedNumberSlots);
+        std::size_t mask = ownedNumberSlots.size() - 1;
+        for (const NumberSlot& slot : oldSlots)
+        {
+            if (slot.catalogNumber == AstroCatalog::InvalidIndex)
+                continue;
+            std::size_t i = hashNumber(slot.catalogNumber) & mask;
+            while (ownedNumberSlots[i].catalogNumber != AstroCatalog::InvalidIndex)
+                i = (i + 1) & mask;
+            ownedNumberSlots[i] = slot;
+        }
+    }
+
+    std::size_t mask = ownedNumberSlots.size() - 1;
+    for (std::size_t i = hashNumber(catalogNumber) & mask;; i = (i + 1) & mask)
+    {
+        NumberSlot& slot = ownedNumberSlots[i];
+        if (slot.catalogNumber == catalogNumber)
+            return &slot;
+        if (slot.catalogNumber == AstroCatalog::InvalidIndex)
+        {
+            slot.catalogNumber = catalogNumber;
+            ++numberCount;
+            return &slot;
+        }
+    }
+}
+
+// Index the localized names of the entries added since the last call,
+// with indexMutex held.
+void NameDatabase::updateLocalizedIndex() const
+{
+    for (; localizedEntryCount < entries.size(); ++localizedEntryCount)
+    {
+        std::string_view name = getEntryName(localizedEntryCount);
+        if (name.empty())
+            continue;
+
+        std::string_view lname = D_(name.data());
+        if (lname != name)
+        {
+            insertName(localizedSlots, localizedCount, lname, localizedEntryCount,
+                       entries[localizedEntryCount].catalogNumber, true);
+            localizedCompletionValid = false;
+        }
+    }
+}
+
+void NameDatabase::buildCompletionIndex() const
+{
+    addCompletions(ownedCompletionEntries, ownedCompletionKeys, nameSlots, false);
+    completionEntries = ownedCompletionEntries;
+    completionKeys = ownedCompletionKeys;
+    completionIndexValid = true;
+}
+
+void NameDatabase::addCompletions(std::vector<CompletionEntry>& index,
+                                  std::string& keys,
+                                  const celutil::array_view<NameSlot>& slots,
+                                  bool localized) const
+{
+    index.clear();
+    keys.clear();
+
+    for (const NameSlot& slot : slots)
+    {
+        if (slot.entry == InvalidEntry)
+            continue;
+        auto offset = static_cast<std::uint32_t>(keys.size());
+        // Names with invalid sequences can only be completed up to them
+        UTF8FoldCase(getEntryKey(slot.entry, localized), keys);
+        auto length = static_cast<std::uint32_t>(keys.size() - offset);
+        index.push_back({ offset, length, slot.entry, localized ? 1u : 0u });
+    }
+
+    // Names with the same key are kept in the order they were added so
+    // that they are ranked the same way every time.
+    std::string_view keyView = keys;
+    std::sort(index.begin(), index.end(),
+              [keyView](const CompletionEntry& a, const CompletionEntry& b)
+              {
+                  std::string_view keyA = keyView.substr(a.keyOffset, a.keyLength);
+                  std::string_view keyB = keyView.substr(b.keyOffset, b.keyLength);
+                  return keyA != keyB ? keyA < keyB : a.entry < b.entry;
+              });
 }
@@ -12,12 +12,21 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
-#include <map>
+#include <iosfwd>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <string_view>
+#include <vector>
 
+#include <celcompat/filesystem.h>
 #include <celengine/astroobj.h>
+#include <celutil/array_view.h>
+#include <celutil/mappedfile.h>
 #include <celutil/stringutils.h>
 
 // TODO: this can be "detemplatized" by creating e.g. a global-scope enum InvalidCatalogNumber since there
@@ -25,14 +34,42 @@
 class NameDatabase
 {
  public:
-    using NameIndex = std::map<std::string, AstroCatalog::IndexNumber, CompareIgnoringCasePredicate>;
-    using NumberIndex = std::multimap<AstroCatalog::IndexNumber, std::string>;
+    // Names given to a catalog number, in the order they were added. The
+    // names are NUL terminated.
+    class NameIterator
+    {
+     public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = std::string_view;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const std::string_view*;
+        using reference         = std::string_view;
+
+        std::string_view operator*() const;
+        NameIterator& operator++();
+        bool operator==(const NameIterator& other) const { return entry == other.entry; }
+        bool operator!=(const NameIterator& other) const { return entry != other.entry; }
+
+     private:
+        NameIterator(const NameDatabase* _db, std::uint32_t _entry) : db(_db), entry(_entry) {}
+
+        const NameDatabase* db;
+        std::uint32_t entry;
+
+        friend class NameDatabase;
+    };
 
  public:
     NameDatabase() {};
 
 
     std::uint32_t getNameCount() const;
+    // Changes whenever names are added, erased or loaded, so that copies of
+    // the names kept elsewhere can tell when they are out of date
+    std::uint32_t getGeneration() const { return generation; }
+    // Bytes taken by the names and their indexes; those of a mapped file
+    // aren't counted
+    std::size_t getMemoryUsage() const;
 
     void add(const AstroCatalog::IndexNumber, const std::string&, bool parseGreek = true);
 
@@ -42,13 +79,118 @@ class NameDatabase
     AstroCatalog::IndexNumber getCatalogNumberByName(std::string_view, bool i18n) const;
     std::string getNameByCatalogNumber(const AstroCatalog::IndexNumber) const;
 
-    NumberIndex::const_iterator getFirstNameIter(const AstroCatalog::IndexNumber catalogNumber) const;
-    NumberIndex::const_iterator getFinalNameIter() const;
+    NameIterator getFirstNameIter(const AstroCatalog::IndexNumber catalogNumber) const;
+    NameIterator getFinalNameIter() const;
+
+    // Append the names starting with name, ignoring case and accents, to
+    // completion: exact matches first, then the others from the shortest,
+    // up to maxResults of them.
+    void getCompletion(std::vector<std::string>& completion,
+                       std::string_view name,
+                       bool i18n,
+                       std::size_t maxResults = std::numeric_limits<std::size_t>::max()) const;
+
+    // Compiled name databases hold the index below as it is in memory, so
+    // they can be mapped and used without parsing. Localized names depend
+    // on the locale at run time and are indexed on the first lookup that
+    // asks for them. Adding names to a mapped database copies it to memory.
+    static bool isBinary(const fs::path&);
+    bool loadBinary(const fs::path&);
+    bool writeBinary(std::ostream&) const;
+
+ private:
+    static constexpr std::uint32_t InvalidEntry = std::numeric_limits<std::uint32_t>::max();
+
+    // One for each name added, the text being kept in the names string.
+    struct NameEntry
+    {
+        std::uint32_t             offset;
+        std::uint32_t             length;
+        AstroCatalog::IndexNumber catalogNumber;
+        std::uint32_t             next{ InvalidEntry }; // next name of the same number
+    };
+
+    // Open addressing hash tables from names, compared ignoring case as in
+    // compareIgnoringCase, to catalog numbers. The slots of the localized
+    // table refer to the entry of the untranslated name.
+    struct NameSlot
+    {
+        std::uint32_t             hash;
+        std::uint32_t             entry{ InvalidEntry };
+        AstroCatalog::IndexNumber catalogNumber;
+    };
+
+    // Open addressing hash table from catalog numbers to the list of their
+    // names. Erased numbers keep their slot with an empty list.
+    struct NumberSlot
+    {
+        AstroCatalog::IndexNumber catalogNumber{ AstroCatalog::InvalidIndex };
+        std::uint32_t             first{ InvalidEntry };
+        std::uint32_t             last{ InvalidEntry };
+    };
+
+    // Names sorted by their case folded form (see UTF8FoldCase).
+    struct CompletionEntry
+    {
+        std::uint32_t keyOffset;
+        std::uint32_t keyLength;
+        std::uint32_t entry;
+        std::uint32_t localized;
+    };
+
+    std::string_view getEntryName(std::uint32_t entry) const;
+    std::string_view getEntryKey(std::uint32_t entry, bool localized) const;
+    const NameSlot* findName(const celestia::util::array_view<NameSlot>& slots,
+                             std::string_view name,
+                             bool localized) const;
+    const NumberSlot* findNumberSlot(AstroCatalog::IndexNumber catalogNumber) const;
+
+    void detach();
+    void updateViews();
+    void insertName(std::vector<NameSlot>& slots,
+                    std::uint32_t& count,
+                    std::string_view name,
+                    std::uint32_t entry,
+                    AstroCatalog::IndexNumber catalogNumber,
+                    bool localized) const;
+    NumberSlot* insertNumber(AstroCatalog::IndexNumber catalogNumber);
+
+    void updateLocalizedIndex() const;
+    void buildCompletionIndex() const;
+    void addCompletions(std::vector<CompletionEntry>& index,
+                        std::string& keys,
+                        const celestia::util::array_view<NameSlot>& slots,
+                        bool localized) const;
+
+    // The arrays used for lookups, which are either the ones below or
+    // those of the mapped file.
+    std::string_view                          names;
+    celestia::util::array_view<NameEntry>     entries;
+    celestia::util::array_view<NameSlot>      nameSlots;
+    celestia::util::array_view<NumberSlot>    numberSlots;
+    mutable celestia::util::array_view<CompletionEntry> completionEntries;
+    mutable std::string_view                  completionKeys;
+    std::uint32_t                             nameCount{ 0 };
+    std::uint32_t                             numberCount{ 0 };
+    std::uint32_t                             generation{ 0 };
 
-    void getCompletion(std::vector<std::string>& completion, std::string_view name, bool i18n) const;
+    std::string                               ownedNames;
+    std::vector<NameEntry>                    ownedEntries;
+    std::vector<NameSlot>                     ownedNameSlots;
+    std::vector<NumberSlot>                   ownedNumberSlots;
+    std::unique_ptr<celestia::util::MappedFile> mappedFile;
 
- protected:
-    NameIndex   nameIndex;
-    NameIndex   localizedNameIndex;
-    NumberIndex numberIndex;
+    // Built when first needed, under indexMutex: the localized names of the
+    // entries before localizedEntryCount, and the completion index if it
+    // isn't mapped.
+    mutable std::vector<NameSlot>             localizedSlots;
+    mutable std::uint32_t                     localizedCount{ 0 };
+    mutable std::uint32_t                     localizedEntryCount{ 0 };
+    mutable std::vector<CompletionEntry>      ownedCompletionEntries;
+    mutable std::string                       ownedCompletionKeys;
+    mutable bool                              completionIndexValid{ false };
+    mutable std::vector<CompletionEntry>      localizedCompletionEntries;
+    mutable std::string                       localizedCompletionKeys;
+    mutable bool                              localizedCompletionValid{ false };
+    mutable std::mutex                        indexMutex;
 };
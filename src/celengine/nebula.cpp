@@ -69,17 +69,20 @@ bool Nebula::pick(const Eigen::ParametrizedLine<double, 3>& ray,
 bool Nebula::load(const AssociativeArray* params, const fs::path& resPath)
 {
     if (const std::string* t = params->getString("Mesh"); t != nullptr)
-    {
-        fs::path geometryFileName(*t);
-        ResourceHandle geometryHandle =
-            GetGeometryManager()->getHandle(GeometryInfo(geometryFileName, resPath));
-        setGeometry(geometryHandle);
-    }
+        setMesh(*t, resPath);
 
     return DeepSkyObject::load(params, resPath);
 }
 
 
+void Nebula::setMesh(const fs::path& mesh, const fs::path& resPath)
+{
+    ResourceHandle geometryHandle =
+        GetGeometryManager()->getHandle(GeometryInfo(mesh, resPath));
+    setGeometry(geometryHandle);
+}
+
+
 void Nebula::render(const Vector3f& /*offset*/,
                     const Quaternionf& /*unused*/,
                     float /*unused*/,
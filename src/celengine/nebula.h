@@ -37,9 +37,12 @@ class Nebula : public DeepSkyObject
     unsigned int getLabelMask() const override;
 
     void setGeometry(ResourceHandle);
+    // Set the geometry to the mesh file, relative to resPath
+    void setMesh(const fs::path& mesh, const fs::path& resPath);
     ResourceHandle getGeometry() const;
 
     const char* getObjTypeName() const override;
+    std::size_t getMemoryUsage() const override { return sizeof(Nebula) + DeepSkyObject::getMemoryUsage(); }
 
  public:
     enum NebulaType
@@ -13,6 +13,7 @@
 #include <celmath/mathlib.h>
 #include <celmath/solve.h>
 #include "body.h"
+#include "camerapath.h"
 #include "frametree.h"
 #include "location.h"
 #include "observer.h"
@@ -79,6 +80,12 @@ Observer::Observer(const Observer& o) :
     beginAccelTime(o.beginAccelTime),
     observerMode(o.observerMode),
     journey(o.journey),
+    path(o.path),
+    pathFrame(o.pathFrame),
+    pathStartTime(o.pathStartTime),
+    pathStart(o.pathStart),
+    pathSpeed(o.pathSpeed),
+    pathStreaming(o.pathStreaming),
     trackObject(o.trackObject),
     trackingOrientation(o.trackingOrientation),
     fov(o.fov),
@@ -104,6 +111,13 @@ Observer& Observer::operator=(const Observer& o)
     beginAccelTime = o.beginAccelTime;
     observerMode = o.observerMode;
     journey = o.journey;
+    // A recording isn't copied, so that only one observer adds its keys
+    path = o.path;
+    pathFrame = o.pathFrame;
+    pathStartTime = o.pathStartTime;
+    pathStart = o.pathStart;
+    pathSpeed = o.pathSpeed;
+    pathStreaming = o.pathStreaming;
     trackObject = o.trackObject;
     trackingOrientation = o.trackingOrientation;
     fov = o.fov;
@@ -420,6 +434,10 @@ void Observer::update(double dt, double timeScale)
             setVelocity(Vector3d::Zero());
         }
     }
+    else if (observerMode == FollowingPath)
+    {
+        updatePath();
+    }
 
     if (getVelocity() != targetVelocity)
     {
@@ -456,6 +474,63 @@ void Observer::update(double dt, double timeScale)
 
         setOrientation(LookAt<double>(Vector3d::Zero(), viewDir, up));
     }
+
+    if (recordedPath != nullptr && realTime - lastRecordingTime >= recordingInterval)
+        recordPathKey();
+}
+
+
+void Observer::updatePath()
+{
+    // Positions on the path are set from the real time elapsed, which
+    // advances by a fixed step per frame when rendering offline, so paths
+    // are played the same way on every run
+    double elapsed = realTime - pathStartTime;
+    double pathTime;
+    bool atEnd;
+    if (pathSpeed > 0.0)
+    {
+        double distance = pathStart + elapsed * pathSpeed;
+        atEnd = distance >= path->getEndDistance();
+        pathTime = path->getTime(distance);
+    }
+    else
+    {
+        pathTime = pathStart + elapsed;
+        atEnd = pathTime >= path->getEndTime();
+    }
+
+    CameraPath::Key key = path->evaluate(pathTime);
+    if (pathFrame == frame)
+    {
+        position = key.position;
+        orientation = key.orientation;
+    }
+    else
+    {
+        position = frame->convertFromUniversal(pathFrame->convertToUniversal(key.position, simTime), simTime);
+        orientation = frame->convertFromUniversal(pathFrame->convertToUniversal(key.orientation, simTime), simTime);
+    }
+    fov = key.fov;
+
+    if (atEnd && !pathStreaming)
+    {
+        observerMode = Free;
+        path = nullptr;
+        pathFrame = nullptr;
+    }
+}
+
+
+void Observer::recordPathKey()
+{
+    CameraPath::Key key;
+    key.time = realTime - recordingStartTime;
+    key.position = recordingFrame->convertFromUniversal(positionUniv, simTime);
+    key.orientation = recordingFrame->convertFromUniversal(orientationUniv, simTime);
+    key.fov = fov;
+    recordedPath->addKey(key);
+    lastRecordingTime = realTime;
 }
 
 
@@ -471,6 +546,15 @@ void Observer::setTrackedObject(const Selection& sel)
 }
 
 
+bool Observer::isUpdateThreadSafe() const
+{
+    return frame->isThreadSafe() &&
+           (pathFrame == nullptr || pathFrame->isThreadSafe()) &&
+           IsPositionThreadSafe(trackObject) &&
+           IsPositionThreadSafe(journey.centerObject);
+}
+
+
 const string& Observer::getDisplayedSurface() const
 {
     return displayedSurface;
@@ -1278,6 +1362,52 @@ void Observer::cancelMotion()
 }
 
 
+void Observer::followPath(const std::shared_ptr<const CameraPath> &newPath,
+                          double speed,
+                          bool streaming)
+{
+    if (newPath == nullptr || newPath->empty())
+    {
+        if (observerMode == FollowingPath)
+            observerMode = Free;
+        path = nullptr;
+        pathFrame = nullptr;
+        return;
+    }
+
+    path = newPath;
+    pathFrame = frame;
+    pathStartTime = realTime;
+    pathSpeed = std::max(speed, 0.0);
+    pathStart = pathSpeed > 0.0 ? path->getStartDistance() : path->getStartTime();
+    pathStreaming = streaming;
+    observerMode = FollowingPath;
+    targetSpeed = 0.0;
+    targetVelocity = Vector3d::Zero();
+    setVelocity(Vector3d::Zero());
+    setAngularVelocity(Vector3d::Zero());
+}
+
+
+void Observer::recordPath(const std::shared_ptr<CameraPath> &newPath, double interval)
+{
+    recordedPath = newPath;
+    if (recordedPath == nullptr)
+    {
+        recordingFrame = nullptr;
+        return;
+    }
+
+    // Keys are added after those the path already has
+    recordingFrame = frame;
+    recordingInterval = std::max(interval, 0.0);
+    recordingStartTime = realTime;
+    if (!recordedPath->empty())
+        recordingStartTime -= recordedPath->getEndTime() + recordingInterval;
+    recordPathKey();
+}
+
+
 void Observer::centerSelection(const Selection& selection, double centerTime)
 {
     if (!selection.empty())
@@ -1482,6 +1612,13 @@ ObserverFrame::getFrame() const
 }
 
 
+bool
+ObserverFrame::isThreadSafe() const
+{
+    return frame->isThreadSafe() && IsPositionThreadSafe(frame->getCenter());
+}
+
+
 UniversalCoord
 ObserverFrame::convertFromUniversal(const UniversalCoord& uc, double tjd) const
 {
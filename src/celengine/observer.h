@@ -18,6 +18,7 @@
 #ifndef _CELENGINE_OBSERVER_H_
 #define _CELENGINE_OBSERVER_H_
 
+#include <memory>
 #include <celcompat/numbers.h>
 #include <celmath/mathlib.h>
 #include <celengine/frame.h>
@@ -25,6 +26,8 @@
 #include <Eigen/Geometry>
 #include "shared.h"
 
+class CameraPath;
+
 class ObserverFrame
 {
 public:
@@ -71,6 +74,10 @@ public:
 
     const ReferenceFrame::SharedConstPtr &getFrame() const;
 
+    // Return true if the frame and its center may be evaluated from
+    // several threads at once
+    bool isThreadSafe() const;
+
     UniversalCoord convertFromUniversal(const UniversalCoord &uc, double tjd) const;
     UniversalCoord convertToUniversal(const UniversalCoord &uc, double tjd) const;
     Eigen::Quaterniond convertFromUniversal(const Eigen::Quaterniond &q, double tjd) const;
@@ -151,6 +158,10 @@ public:
     Selection getTrackedObject() const;
     void setTrackedObject(const Selection&);
 
+    // Return true if update() may run on one thread while the objects it
+    // follows, tracks or travels to are evaluated on another
+    bool isUpdateThreadSafe() const;
+
     const std::string &getDisplayedSurface() const;
     void setDisplayedSurface(const std::string&);
 
@@ -203,6 +214,18 @@ public:
     void chase(const Selection&);
     void cancelMotion();
 
+    // Play a path whose keys are in the current frame, from its first key.
+    // With a speed in km/s the path is played at that constant speed
+    // rather than at the times of its keys. A streamed path waits at its
+    // last key for more keys instead of ending there; keys may be added to
+    // it and its past keys removed between updates.
+    void followPath(const std::shared_ptr<const CameraPath> &path,
+                    double speed = 0.0,
+                    bool streaming = false);
+    // Add a key of the observer in the current frame to path every
+    // interval seconds of real time; a null path stops the recording.
+    void recordPath(const std::shared_ptr<CameraPath> &path, double interval);
+
     void reverseOrientation();
 
     void setFrame(ObserverFrame::CoordinateSystem cs, const Selection &refObj, const Selection &targetObj);
@@ -221,6 +244,7 @@ public:
     {
         Free                    = 0,
         Travelling              = 1,
+        FollowingPath           = 2,
     };
 
     ObserverMode getMode() const;
@@ -281,6 +305,8 @@ public:
                                    JourneyParams &jparams,
                                    double centerTime);
 
+    void updatePath();
+    void recordPathKey();
     void updateUniversal();
     void convertFrameCoordinates(const ObserverFrame::SharedConstPtr &newFrame);
 
@@ -309,6 +335,22 @@ public:
 
     ObserverMode     	observerMode{ Free };
     JourneyParams    	journey;
+
+    // Path played, in pathFrame, from the real time pathStartTime and the
+    // path time or distance pathStart
+    std::shared_ptr<const CameraPath> path;
+    ObserverFrame::SharedConstPtr pathFrame;
+    double pathStartTime{ 0.0 };
+    double pathStart{ 0.0 };
+    double pathSpeed{ 0.0 };
+    bool pathStreaming{ false };
+
+    std::shared_ptr<CameraPath> recordedPath;
+    ObserverFrame::SharedConstPtr recordingFrame;
+    double recordingStartTime{ 0.0 };
+    double recordingInterval{ 0.0 };
+    double lastRecordingTime{ 0.0 };
+
     Selection        	trackObject;
 
     Eigen::Quaterniond 	trackingOrientation{ Eigen::Quaternionf::Identity() };   // orientation prior to selecting tracking
@@ -0,0 +1,43 @@
+// occluderindex.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "occluderindex.h"
+
+#include <algorithm>
+
+void
+OccluderList::add(const Body* body, const Eigen::Vector3d& position, double radius, bool hasRings)
+{
+    m_occluders.push_back({ body, position, radius, hasRings });
+}
+
+void
+OccluderList::finish()
+{
+    std::stable_sort(m_occluders.begin(), m_occluders.end(),
+                     [](const Occluder& a, const Occluder& b) { return a.radius > b.radius; });
+}
+
+const OccluderList*
+OccluderIndex::find(const PlanetarySystem* system, double now) const
+{
+    auto it = m_lists.find(system);
+    if (it == m_lists.end() || it->second.time != now)
+        return nullptr;
+    return &it->second.list;
+}
+
+OccluderList&
+OccluderIndex::insert(const PlanetarySystem* system, double now)
+{
+    Entry& entry = m_lists[system];
+    entry.time = now;
+    entry.list.clear();
+    return entry.list;
+}
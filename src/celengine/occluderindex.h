@@ -0,0 +1,111 @@
+// occluderindex.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+class Body;
+class PlanetarySystem;
+
+// Shadows shallower than this aren't drawn
+constexpr float MinEclipseShadowDepth = 1.0f / 256.0f;
+
+// The bodies of a planetary system which can cast eclipse shadows, with
+// their positions at one time, largest first. A receiver only needs to look
+// at the casters large enough relative to it, and of those only at the ones
+// near enough for their shadow to be deep enough to draw: the depth is the
+// square of the ratio of the apparent radius of the caster to that of the
+// light, so it bounds the distance between the two.
+class OccluderList
+{
+ public:
+    struct Occluder
+    {
+        const Body* body;
+        Eigen::Vector3d position;
+        double radius;
+        // Ring shadows are drawn regardless of the distance
+        bool hasRings;
+    };
+
+    void clear() { m_occluders.clear(); }
+    void add(const Body* body, const Eigen::Vector3d& position, double radius, bool hasRings);
+    // Sort the occluders once all are added
+    void finish();
+
+    bool empty() const { return m_occluders.empty(); }
+    std::size_t size() const { return m_occluders.size(); }
+
+    // Call f for each occluder with a radius of at least minRadius which
+    // may cast a shadow on the receiver, lit by a light of the apparent
+    // radius lightRadius as seen from the receiver
+    template<typename F>
+    void forEachCandidate(const Eigen::Vector3d& receiverPosition,
+                          double receiverRadius,
+                          double minRadius,
+                          float lightRadius,
+                          F&& f) const
+    {
+        // Beyond reach * radius from the receiver, the shadow of the caster
+        // is too shallow; point lights have no limit
+        double reach = lightRadius > 0.0f
+            ? 1.0 / (std::sqrt(static_cast<double>(MinEclipseShadowDepth)) * static_cast<double>(lightRadius))
+            : -1.0;
+
+        for (const auto& occluder : m_occluders)
+        {
+            if (occluder.radius < minRadius)
+                break;
+
+            if (!occluder.hasRings && reach > 0.0)
+            {
+                double maxDistance = receiverRadius + occluder.radius * reach;
+                if ((occluder.position - receiverPosition).squaredNorm() > maxDistance * maxDistance)
+                    continue;
+            }
+
+            f(occluder);
+        }
+    }
+
+ private:
+    std::vector<Occluder> m_occluders;
+};
+
+// The occluder lists of the planetary systems containing the receivers
+// drawn in a frame; all views of a frame drawn at the same time share them.
+class OccluderIndex
+{
+ public:
+    // Drop all lists, at the start of each frame
+    void invalidate() { m_lists.clear(); }
+
+    // Return the list of the system at now, or nullptr if it hasn't been
+    // built yet
+    const OccluderList* find(const PlanetarySystem* system, double now) const;
+
+    // Return an empty list for the system at now, replacing the one there
+    // may be for another time
+    OccluderList& insert(const PlanetarySystem* system, double now);
+
+ private:
+    struct Entry
+    {
+        double time;
+        OccluderList list;
+    };
+
+    std::unordered_map<const PlanetarySystem*, Entry> m_lists;
+};
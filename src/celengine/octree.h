@@ -13,6 +13,13 @@
 #ifndef _CELENGINE_OCTREE_H_
 #define _CELENGINE_OCTREE_H_
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <thread>
+#include <utility>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <celengine/observer.h>
@@ -25,6 +32,11 @@
 // OBJ's limiting property defined by the octree particular specialization: ie. we use [absolute magnitude] for star octrees, etc.
 // For details, see notes below.
 
+// Packed copy of the object properties used when culling objects, in the
+// same order as the objects in the octree. Defined by the specializations
+// which support it; see staroctree.h.
+template <class OBJ> struct OctreeCullingData;
+
 struct OctreeProcStats
 {
     size_t nodes { 0 };
@@ -39,6 +51,20 @@ template <class OBJ, class PREC> class OctreeProcessor
     virtual ~OctreeProcessor() {};
 
     virtual void process(const OBJ& obj, PREC distance, float appMag) = 0;
+
+    // Process the objects of a node which passed the culling tests, given as
+    // indices into the node's object range with their distances and apparent
+    // magnitudes. Processors for which a virtual call per object is too
+    // costly can override this.
+    virtual void processBatch(const OBJ*          firstObject,
+                              const unsigned int* indices,
+                              const PREC*         distances,
+                              const float*        appMags,
+                              unsigned int        count)
+    {
+        for (unsigned int i = 0; i < count; ++i)
+            process(firstObject[indices[i]], distances[i], appMags[i]);
+    }
 };
 
 
@@ -73,7 +99,29 @@ private:
     void insertObject  (const OBJ&, const PREC);
     void rebuildAndSort(StaticOctree<OBJ, PREC>*&, OBJ*&);
 
+    // Insert many objects at once, using up to nThreads threads. The upper
+    // levels are built by sorting the objects into the child nodes in
+    // parallel chunks; once a subtree has few enough objects left they are
+    // inserted one by one, with separate subtrees built concurrently.
+    void insertObjects(std::vector<const OBJ*>&& objects, const PREC scale, unsigned int nThreads);
+
  private:
+   // Subtree left to be built by insertObjects
+   struct InsertTask
+   {
+       DynamicOctree* node;
+       PREC           scale;
+       ObjectList     objects;
+   };
+
+   void partitionObjects(ObjectList&& objects,
+                         const PREC scale,
+                         unsigned int nThreads,
+                         std::vector<InsertTask>& tasks);
+
+   // Subtrees with fewer objects than this are built by a single thread
+   static constexpr std::size_t PARALLEL_INSERT_THRESHOLD = 16384;
+
    static unsigned int SPLIT_THRESHOLD;
 
    static LimitingFactorPredicate*      limitingFactorPredicate;
@@ -137,6 +185,67 @@ template <class OBJ, class PREC> class StaticOctree
                                PREC                              scale,
                                OctreeProcStats * = nullptr) const;
 
+    // Same as above, but with the per-object tests performed on the packed
+    // object properties in cullingData rather than on the objects.
+    void processVisibleObjects(OctreeProcessor<OBJ, PREC>&       processor,
+                               const PointType&                  obsPosition,
+                               const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                               float                             limitingFactor,
+                               PREC                              scale,
+                               const OctreeCullingData<OBJ>&     cullingData,
+                               OctreeProcStats * = nullptr) const;
+
+    // A subtree of the octree along with the scale of its root node, as
+    // collected by processVisibleObjects when splitting the traversal.
+    struct Subtree
+    {
+        const StaticOctree* node;
+        PREC                scale;
+    };
+
+    // Split variant of processVisibleObjects: objects in the nodes above
+    // splitLevel are passed to the processor as usual, but instead of
+    // descending below splitLevel the visible nodes found there are
+    // appended to subtrees. Each of these can then be traversed
+    // independently (e.g. on a separate thread) by calling
+    // processVisibleObjects on it with the recorded scale.
+    // cullingData is used as in the corresponding processVisibleObjects.
+    void processVisibleObjects(OctreeProcessor<OBJ, PREC>&       processor,
+                               const PointType&                  obsPosition,
+                               const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                               float                             limitingFactor,
+                               PREC                              scale,
+                               const OctreeCullingData<OBJ>&     cullingData,
+                               unsigned int                      splitLevel,
+                               std::vector<Subtree>&             subtrees) const;
+
+    // Same as above, for octrees without packed object properties.
+    void processVisibleObjects(OctreeProcessor<OBJ, PREC>&       processor,
+                               const PointType&                  obsPosition,
+                               const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                               float                             limitingFactor,
+                               PREC                              scale,
+                               unsigned int                      splitLevel,
+                               std::vector<Subtree>&             subtrees) const;
+
+    // A contiguous range of objects in the octree's sorted object array
+    struct ObjectRange
+    {
+        const OBJ*   firstObject;
+        unsigned int nObjects;
+    };
+
+    // Node level variant of processVisibleObjects: the objects themselves
+    // aren't examined; the object ranges of all the nodes which would have
+    // been processed are appended to ranges instead, for when the per-object
+    // tests are done elsewhere (e.g. on the GPU). Ranges of adjacent nodes
+    // are merged.
+    void findVisibleNodes(const PointType&                  obsPosition,
+                          const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                          float                             limitingFactor,
+                          PREC                              scale,
+                          std::vector<ObjectRange>&         ranges) const;
+
     void processCloseObjects(OctreeProcessor<OBJ, PREC>&        processor,
                              const PointType&                   obsPosition,
                              PREC                               boundingRadius,
@@ -144,9 +253,23 @@ template <class OBJ, class PREC> class StaticOctree
 
     int countChildren() const;
     int countObjects()  const;
+    // Bytes taken by the nodes, not including the objects
+    std::size_t getMemoryUsage() const;
 
     void computeStatistics(std::vector<OctreeLevelStatistics>& stats, unsigned int level = 0);
 
+    // Accessors used to store the octree structure in a file or to traverse
+    // it from outside
+    const PointType& getCellCenterPos() const { return cellCenterPos; }
+    float getExclusionFactor() const { return exclusionFactor; }
+    unsigned int getObjectCount() const { return nObjects; }
+    const OBJ* getFirstObject() const { return _firstObject; }
+    const StaticOctree* getChild(int i) const { return _children == nullptr ? nullptr : _children[i]; }
+
+    // Used when loading a stored octree: the node takes ownership of the
+    // array of eight children.
+    void setChildren(StaticOctree** children);
+
  private:
     static const PREC SQRT3;
 
@@ -240,6 +363,117 @@ inline void DynamicOctree<OBJ, PREC>::insertObject(const OBJ& obj, const PREC sc
 }
 
 
+template <class OBJ, class PREC>
+inline void DynamicOctree<OBJ, PREC>::insertObjects(std::vector<const OBJ*>&& objects,
+                                                    const PREC scale,
+                                                    unsigned int nThreads)
+{
+    std::vector<InsertTask> tasks;
+    partitionObjects(std::move(objects), scale, nThreads, tasks);
+
+    // Start with the largest subtrees for a better balance
+    std::sort(tasks.begin(), tasks.end(),
+              [](const InsertTask& a, const InsertTask& b) { return a.objects.size() > b.objects.size(); });
+
+    std::atomic<std::size_t> nextTask{ 0 };
+    auto build = [&tasks, &nextTask]()
+    {
+        for (;;)
+        {
+            std::size_t i = nextTask.fetch_add(1, std::memory_order_relaxed);
+            if (i >= tasks.size())
+                break;
+
+            for (const OBJ* obj : tasks[i].objects)
+                tasks[i].node->insertObject(*obj, tasks[i].scale);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < std::min(static_cast<std::size_t>(nThreads), tasks.size()); ++i)
+        workers.emplace_back(build);
+
+    build();
+
+    for (auto& worker : workers)
+        worker.join();
+}
+
+
+template <class OBJ, class PREC>
+inline void DynamicOctree<OBJ, PREC>::partitionObjects(ObjectList&& objects,
+                                                       const PREC scale,
+                                                       unsigned int nThreads,
+                                                       std::vector<InsertTask>& tasks)
+{
+    if (objects.empty())
+        return;
+
+    if (nThreads <= 1 || objects.size() < PARALLEL_INSERT_THRESHOLD)
+    {
+        tasks.push_back(InsertTask{ this, scale, std::move(objects) });
+        return;
+    }
+
+    // With this many objects insertObject would split the node anyway
+    if (_children == nullptr)
+    {
+        if (_objects == nullptr)
+            _objects = new ObjectList;
+        split(scale * (PREC) 0.5);
+    }
+
+    // Each chunk of objects is sorted into the ones kept in this node (the
+    // last list) and the ones for each child. Concatenating the lists of the
+    // chunks preserves the order in which the objects were given.
+    std::vector<std::array<ObjectList, 9>> chunkLists(nThreads);
+    std::size_t chunkSize = (objects.size() + nThreads - 1) / nThreads;
+    auto sortChunk = [&](unsigned int chunk)
+    {
+        std::size_t end = std::min(objects.size(), (chunk + 1) * chunkSize);
+        for (std::size_t i = chunk * chunkSize; i < end; ++i)
+        {
+            const OBJ& obj = *objects[i];
+            if (limitingFactorPredicate(obj, exclusionFactor) ||
+                straddlingPredicate(cellCenterPos, obj, exclusionFactor))
+            {
+                chunkLists[chunk][8].push_back(&obj);
+            }
+            else
+            {
+                DynamicOctree* child = this->getChild(obj, cellCenterPos);
+                chunkLists[chunk][std::find(_children, _children + 8, child) - _children].push_back(&obj);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < nThreads; ++i)
+        workers.emplace_back(sortChunk, i);
+
+    sortChunk(0);
+
+    for (auto& worker : workers)
+        worker.join();
+
+    objects.clear();
+    objects.shrink_to_fit();
+
+    std::array<ObjectList, 8> childObjects;
+    for (const auto& lists : chunkLists)
+    {
+        for (const OBJ* obj : lists[8])
+            add(*obj);
+        for (int i = 0; i < 8; ++i)
+            childObjects[i].insert(childObjects[i].end(), lists[i].begin(), lists[i].end());
+    }
+    chunkLists.clear();
+
+    for (int i = 0; i < 8; ++i)
+        _children[i]->partitionObjects(std::move(childObjects[i]), scale * (PREC) 0.5, nThreads, tasks);
+}
+
+
 template <class OBJ, class PREC>
 inline void DynamicOctree<OBJ, PREC>::add(const OBJ& obj)
 {
@@ -359,6 +593,14 @@ inline StaticOctree<OBJ, PREC>::~StaticOctree()
 }
 
 
+template <class OBJ, class PREC>
+inline void StaticOctree<OBJ, PREC>::setChildren(StaticOctree** children)
+{
+    assert(_children == nullptr);
+    _children = children;
+}
+
+
 template <class OBJ, class PREC>
 inline int StaticOctree<OBJ, PREC>::countChildren() const
 {
@@ -384,6 +626,22 @@ inline int StaticOctree<OBJ, PREC>::countObjects() const
 }
 
 
+template <class OBJ, class PREC>
+inline std::size_t StaticOctree<OBJ, PREC>::getMemoryUsage() const
+{
+    std::size_t size = sizeof(*this);
+
+    if (_children != nullptr)
+    {
+        size += 8 * sizeof(StaticOctree*);
+        for (int i = 0; i < 8; ++i)
+            size += _children[i]->getMemoryUsage();
+    }
+
+    return size;
+}
+
+
 template <class OBJ, class PREC>
 void StaticOctree<OBJ, PREC>::computeStatistics(std::vector<OctreeLevelStatistics>& stats, unsigned int level)
 {
@@ -39,6 +39,7 @@ class OpenCluster : public DeepSkyObject
     unsigned int getLabelMask() const override;
 
     const char* getObjTypeName() const override;
+    std::size_t getMemoryUsage() const override { return sizeof(OpenCluster) + DeepSkyObject::getMemoryUsage(); }
 
  public:
     enum ClusterType
@@ -8,6 +8,7 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <cstring>
 #include <Eigen/Core>
 #include <celmath/geomutil.h>
@@ -41,10 +42,14 @@ void Overlay::begin()
     ps.blendFunc = {GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA};
     ps.depthMask = true;
     renderer.setPipelineState(ps);
+
+    textBlockIndex = 0;
 }
 
 void Overlay::end()
 {
+    // Forget the blocks which weren't drawn this frame
+    textBlocks.resize(textBlockIndex);
 }
 
 
@@ -56,29 +61,211 @@ void Overlay::setWindowSize(int w, int h)
 
 void Overlay::setFont(const std::shared_ptr<TextureFont>& f)
 {
-    layout->setFont(f);
+    font = f;
+    if (inText)
+    {
+        TextOp op{ TextOp::Type::SetFont };
+        op.font = f;
+        current.ops.push_back(std::move(op));
+    }
+    else
+    {
+        layout->setFont(f);
+    }
 }
 
 void Overlay::setTextAlignment(TextLayout::HorizontalAlignment halign)
 {
-    layout->setHorizontalAlignment(halign);
+    alignment = halign;
+    if (inText)
+    {
+        TextOp op{ TextOp::Type::SetAlignment };
+        op.alignment = halign;
+        current.ops.push_back(std::move(op));
+    }
+    else
+    {
+        layout->setHorizontalAlignment(halign);
+    }
 }
 
 void Overlay::beginText()
 {
     savePos();
-    layout->begin(projection);
+    inText = true;
+    current.start = layout->getCurrentPosition();
+    current.font = font;
+    current.alignment = alignment;
+    current.color = color;
+    current.ops.clear();
 }
 
 void Overlay::endText()
 {
-    layout->end();
+    inText = false;
+
+    if (textBlockIndex == textBlocks.size())
+        textBlocks.emplace_back();
+    TextBlock& block = textBlocks[textBlockIndex++];
+
+    if (isUnchanged(block))
+    {
+        drawText(block);
+        // Leave the state as laying out the text would
+        for (const auto& op : block.ops)
+            applyTextOp(op);
+    }
+    else
+    {
+        block.start = current.start;
+        block.font = current.font;
+        block.alignment = current.alignment;
+        block.color = current.color;
+        block.ops.swap(current.ops);
+        layOutText(block);
+    }
+
     restorePos();
 }
 
 void Overlay::print_impl(const std::string& s)
 {
-    layout->render(s);
+    if (!inText)
+        return;
+
+    TextOp op{ TextOp::Type::Print };
+    op.text = s;
+    current.ops.push_back(std::move(op));
+}
+
+bool Overlay::TextOp::operator==(const TextOp& other) const
+{
+    if (type != other.type)
+        return false;
+
+    switch (type)
+    {
+    case Type::Print:
+        return text == other.text;
+    case Type::SetColor:
+        return color == other.color;
+    case Type::SetFont:
+        return font == other.font;
+    case Type::SetAlignment:
+        return alignment == other.alignment;
+    case Type::MoveBy:
+        return dx == other.dx && dy == other.dy;
+    default:
+        return true;
+    }
+}
+
+// The ops which change the state of the layout are carried out the same
+// whether or not the text is drawn from the cache
+void Overlay::applyTextOp(const TextOp& op)
+{
+    switch (op.type)
+    {
+    case TextOp::Type::SetFont:
+        layout->setFont(op.font);
+        break;
+    case TextOp::Type::SetAlignment:
+        layout->setHorizontalAlignment(op.alignment);
+        break;
+    case TextOp::Type::MoveBy:
+        layout->moveRelative(op.dx, op.dy);
+        break;
+    case TextOp::Type::SavePos:
+        savePos();
+        break;
+    case TextOp::Type::RestorePos:
+        restorePos();
+        break;
+    default:
+        break;
+    }
+}
+
+bool Overlay::isUnchanged(const TextBlock& block) const
+{
+    if (block.start != current.start || block.font != current.font ||
+        block.alignment != current.alignment || !(block.color == current.color) ||
+        block.ops != current.ops)
+    {
+        return false;
+    }
+
+    return std::all_of(block.segments.begin(), block.segments.end(),
+                       [](const TextSegment& segment) { return segment.font->isValid(segment.geometry); });
+}
+
+// The text is rendered with the colors in the vertices, so that they are
+// kept in the geometry, and each font has its own
+void Overlay::layOutText(TextBlock& block)
+{
+    block.segments.clear();
+    if (block.font == nullptr)
+    {
+        for (const auto& op : block.ops)
+            applyTextOp(op);
+        return;
+    }
+
+    layout->begin(projection);
+    layout->setColor(block.color);
+    block.segments.push_back({ block.font, {} });
+    block.font->beginCapture();
+
+    Color textColor = block.color;
+    for (const auto& op : block.ops)
+    {
+        switch (op.type)
+        {
+        case TextOp::Type::Print:
+            layout->render(op.text);
+            break;
+        case TextOp::Type::SetColor:
+            textColor = op.color;
+            layout->setColor(textColor);
+            break;
+        case TextOp::Type::SetFont:
+            if (op.font != block.segments.back().font)
+            {
+                // Setting the font renders the rest of the line first
+                layout->setFont(op.font);
+                block.segments.back().font->endCapture(block.segments.back().geometry);
+                block.segments.push_back({ op.font, {} });
+                if (op.font == nullptr)
+                    break;
+                op.font->beginCapture();
+                layout->setColor(textColor);
+            }
+            break;
+        default:
+            applyTextOp(op);
+            break;
+        }
+    }
+
+    layout->end();
+    if (block.segments.back().font != nullptr)
+        block.segments.back().font->endCapture(block.segments.back().geometry);
+    else
+        block.segments.pop_back();
+}
+
+void Overlay::drawText(const TextBlock& block)
+{
+    for (const auto& segment : block.segments)
+    {
+        if (segment.geometry.vertices.empty())
+            continue;
+
+        segment.font->bind();
+        segment.font->setMVPMatrices(projection);
+        segment.font->draw(segment.geometry);
+        segment.font->unbind();
+    }
 }
 
 void Overlay::drawRectangle(const celestia::Rect& r)
@@ -88,34 +275,61 @@ void Overlay::drawRectangle(const celestia::Rect& r)
 
 void Overlay::setColor(float r, float g, float b, float a)
 {
-    layout->flush();
-    glVertexAttrib4f(CelestiaGLProgram::ColorAttributeIndex, r, g, b, a);
+    setColor(Color(r, g, b, a));
 }
 
 void Overlay::setColor(const Color& c)
 {
-    layout->flush();
+    // The color attribute is still set for what is drawn after the text
     glVertexAttrib4f(CelestiaGLProgram::ColorAttributeIndex,
                      c.red(), c.green(), c.blue(), c.alpha());
+    color = c;
+    if (inText)
+    {
+        TextOp op{ TextOp::Type::SetColor };
+        op.color = c;
+        current.ops.push_back(std::move(op));
+    }
 }
 
 void Overlay::moveBy(float dx, float dy)
 {
-    layout->moveRelative(dx, dy);
+    if (inText)
+    {
+        TextOp op{ TextOp::Type::MoveBy };
+        op.dx = dx;
+        op.dy = dy;
+        current.ops.push_back(std::move(op));
+    }
+    else
+    {
+        layout->moveRelative(dx, dy);
+    }
 }
 
 void Overlay::moveBy(int dx, int dy)
 {
-    layout->moveRelative(static_cast<float>(dx), static_cast<float>(dy));
+    moveBy(static_cast<float>(dx), static_cast<float>(dy));
 }
 
 void Overlay::savePos()
 {
+    if (inText)
+    {
+        current.ops.push_back(TextOp{ TextOp::Type::SavePos });
+        return;
+    }
     posStack.push_back(layout->getCurrentPosition());
 }
 
 void Overlay::restorePos()
 {
+    if (inText)
+    {
+        current.ops.push_back(TextOp{ TextOp::Type::RestorePos });
+        return;
+    }
+
     if (!posStack.empty())
     {
         auto [x, y] = posStack.back();
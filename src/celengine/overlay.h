@@ -10,13 +10,16 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 #include <fmt/printf.h>
 #include <Eigen/Core>
 #include <celengine/textlayout.h>
+#include <celttf/truetypefont.h>
+#include <celutil/color.h>
 
-class Color;
 class Overlay;
 class Renderer;
 
@@ -25,6 +28,11 @@ namespace celestia
 class Rect;
 }
 
+/*! Draws the text of the HUD. The text printed between beginText and
+ *  endText is kept with the vertices it was rendered to, and the blocks of
+ *  text which are printed the same as in the previous frame, in the same
+ *  order, are drawn from these without laying them out again.
+ */
 class Overlay
 {
  public:
@@ -68,7 +76,53 @@ class Overlay
     }
 
  private:
+    // What is done between beginText and endText, which is carried out in
+    // endText unless the block is the same as in the previous frame
+    struct TextOp
+    {
+        enum class Type
+        {
+            Print,
+            SetColor,
+            SetFont,
+            SetAlignment,
+            MoveBy,
+            SavePos,
+            RestorePos,
+        };
+
+        Type type;
+        std::string text{};
+        Color color{};
+        std::shared_ptr<TextureFont> font{};
+        celestia::engine::TextLayout::HorizontalAlignment alignment{};
+        float dx{ 0.0f };
+        float dy{ 0.0f };
+
+        bool operator==(const TextOp&) const;
+    };
+
+    struct TextSegment
+    {
+        std::shared_ptr<TextureFont> font;
+        TextureFont::Geometry geometry;
+    };
+
+    struct TextBlock
+    {
+        std::pair<float, float> start;
+        std::shared_ptr<TextureFont> font;
+        celestia::engine::TextLayout::HorizontalAlignment alignment;
+        Color color;
+        std::vector<TextOp> ops;
+        std::vector<TextSegment> segments;
+    };
+
     void print_impl(const std::string&);
+    void applyTextOp(const TextOp&);
+    bool isUnchanged(const TextBlock&) const;
+    void layOutText(TextBlock&);
+    void drawText(const TextBlock&);
 
     int windowWidth{ 1 };
     int windowHeight{ 1 };
@@ -79,4 +133,15 @@ class Overlay
 
     std::vector<std::pair<float, float>> posStack;
     Eigen::Matrix4f projection;
+
+    // The state at beginText, and what was done since
+    bool inText{ false };
+    TextBlock current;
+    std::shared_ptr<TextureFont> font;
+    celestia::engine::TextLayout::HorizontalAlignment alignment{ celestia::engine::TextLayout::HorizontalAlignment::Left };
+    Color color;
+
+    // The blocks of the previous frames, in the order they were drawn in
+    std::vector<TextBlock> textBlocks;
+    std::size_t textBlockIndex{ 0 };
 };
@@ -0,0 +1,697 @@
+// pagedstarcatalog.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "pagedstarcatalog.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <string_view>
+
+#include <celcompat/numbers.h>
+#include <celutil/bytes.h>
+#include <celutil/gettext.h>
+#include <celutil/logger.h>
+#include "astro.h"
+#include "star.h"
+#include "starsdat.h"
+#include "stellarclass.h"
+
+using celestia::util::GetLogger;
+
+namespace celengine = celestia::engine;
+
+namespace
+{
+
+// Subtrees with at most this many stars are loaded as a single page
+constexpr std::uint32_t PageStarLimit = 16384;
+
+// Sanity limit for the depth of the octree
+constexpr std::size_t MaxDepth = 64;
+
+// Number of node records read at once when scanning the node table
+constexpr std::uint32_t NodeBufferSize = 4096;
+
+struct StarRange
+{
+    std::uint32_t fileStar;
+    std::uint32_t nStars;
+};
+
+std::streamoff
+nodeOffset(std::uint32_t node)
+{
+    return static_cast<std::streamoff>(sizeof(celengine::SortedStarsDatHeader))
+         + static_cast<std::streamoff>(node) * static_cast<std::streamoff>(sizeof(celengine::StarsDatNode));
+}
+
+std::streamoff
+starOffset(std::uint32_t nNodes, std::uint32_t star)
+{
+    return nodeOffset(nNodes)
+         + static_cast<std::streamoff>(star) * static_cast<std::streamoff>(sizeof(celengine::StarsDatRecord));
+}
+
+bool
+readAt(std::istream& in, std::streamoff offset, char* data, std::size_t size)
+{
+    in.clear();
+    return in.seekg(offset).good() && in.read(data, static_cast<std::streamsize>(size)).good();
+}
+
+bool
+readStars(std::istream& in, std::uint32_t nNodes, std::uint32_t fileStar, std::uint32_t nStars, Star* stars)
+{
+    std::vector<char> buffer(static_cast<std::size_t>(nStars) * sizeof(celengine::StarsDatRecord));
+    if (!readAt(in, starOffset(nNodes, fileStar), buffer.data(), buffer.size()))
+        return false;
+
+    const char* ptr = buffer.data();
+    for (std::uint32_t i = 0; i < nStars; ++i)
+    {
+        if (!celengine::unpackStarsDatRecord(ptr, stars[i]))
+            return false;
+        ptr += sizeof(celengine::StarsDatRecord);
+    }
+
+    return true;
+}
+
+// As readStars, but leaving the details of the stars unset, for use on the
+// loader thread. Their packed spectral types are returned instead, after
+// checking that they are valid.
+bool
+readStarFields(std::istream& in,
+               std::uint32_t nNodes,
+               std::uint32_t fileStar,
+               std::uint32_t nStars,
+               Star* stars,
+               std::uint16_t* spectralTypes)
+{
+    std::vector<char> buffer(static_cast<std::size_t>(nStars) * sizeof(celengine::StarsDatRecord));
+    if (!readAt(in, starOffset(nNodes, fileStar), buffer.data(), buffer.size()))
+        return false;
+
+    const char* ptr = buffer.data();
+    for (std::uint32_t i = 0; i < nStars; ++i)
+    {
+        celengine::unpackStarsDatRecordFields(ptr, stars[i], spectralTypes[i]);
+        StellarClass sc;
+        if (!sc.unpackV1(spectralTypes[i]))
+            return false;
+        ptr += sizeof(celengine::StarsDatRecord);
+    }
+
+    return true;
+}
+
+// Quantized positions are at most this far from the actual ones, in light
+// years, unless the node needs 32 bit positions.
+constexpr float MaxPositionError = 5.0e-4f;
+
+} // end unnamed namespace
+
+
+PagedStarCatalog::~PagedStarCatalog()
+{
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+
+    if (m_loader.joinable())
+        m_loader.join();
+}
+
+
+std::unique_ptr<PagedStarCatalog>
+PagedStarCatalog::open(const fs::path& path, std::size_t memoryBudget, bool quantized)
+{
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in.good())
+        return nullptr;
+
+    std::array<char, sizeof(celengine::SortedStarsDatHeader)> header;
+    if (!in.read(header.data(), header.size()).good())
+        return nullptr;
+
+    if (std::string_view(header.data() + offsetof(celengine::SortedStarsDatHeader, magic),
+                         celengine::STARSDAT_MAGIC.size()) != celengine::STARSDAT_MAGIC)
+    {
+        return nullptr;
+    }
+
+    auto version = celengine::readRecordField<std::uint16_t>(header.data(), offsetof(celengine::SortedStarsDatHeader, version));
+    LE_TO_CPU_INT16(version, version);
+    if (version != celengine::SORTED_STARSDAT_VERSION)
+        return nullptr;
+
+    std::unique_ptr<PagedStarCatalog> catalog(new PagedStarCatalog);
+    catalog->m_path = path;
+    catalog->m_memoryBudget = memoryBudget;
+    catalog->m_quantized = quantized;
+
+    auto nStars = celengine::readRecordField<std::uint32_t>(header.data(), offsetof(celengine::SortedStarsDatHeader, counter));
+    LE_TO_CPU_INT32(nStars, nStars);
+    auto nNodes = celengine::readRecordField<std::uint32_t>(header.data(), offsetof(celengine::SortedStarsDatHeader, nodeCount));
+    LE_TO_CPU_INT32(nNodes, nNodes);
+    if (nNodes == 0 || nNodes >= PageBit)
+        return nullptr;
+
+    catalog->m_nStars = nStars;
+    catalog->m_nNodes = nNodes;
+
+    if (!catalog->buildTopLevels(in))
+    {
+        GetLogger()->error(_("Bad octree in paged star database {}\n"), path);
+        return nullptr;
+    }
+
+    GetLogger()->info(_("{} stars in paged star database, {} pages\n"), nStars, catalog->m_pages.size());
+
+    catalog->m_loader = std::thread(&PagedStarCatalog::loaderMain, catalog.get());
+    return catalog;
+}
+
+
+// Split the octree stored in the file into the resident top levels and the
+// pages below them.
+bool
+PagedStarCatalog::buildTopLevels(std::istream& in)
+{
+    // The total number of nodes and stars in the subtree of each node,
+    // accumulated with an explicit stack while scanning the nodes in
+    // depth-first order.
+    std::vector<std::uint32_t> subtreeNodes(m_nNodes);
+    std::vector<std::uint64_t> subtreeStars(m_nNodes);
+    {
+        struct OpenNode
+        {
+            std::uint32_t index;
+            unsigned int  childrenLeft;
+        };
+
+        std::vector<OpenNode> stack;
+        std::vector<char> buffer(static_cast<std::size_t>(NodeBufferSize) * sizeof(celengine::StarsDatNode));
+        const char* ptr = nullptr;
+        const char* end = nullptr;
+        if (!in.seekg(nodeOffset(0)).good())
+            return false;
+
+        for (std::uint32_t i = 0; i < m_nNodes; ++i)
+        {
+            if (ptr == end)
+            {
+                std::uint32_t count = std::min(NodeBufferSize, m_nNodes - i);
+                std::size_t size = static_cast<std::size_t>(count) * sizeof(celengine::StarsDatNode);
+                if (!in.read(buffer.data(), static_cast<std::streamsize>(size)).good())
+                    return false;
+                ptr = buffer.data();
+                end = ptr + size;
+            }
+
+            celengine::StarsDatNodeInfo info = celengine::unpackStarsDatNode(ptr);
+            ptr += sizeof(celengine::StarsDatNode);
+
+            // Only the root may be without a parent
+            if (i > 0 && stack.empty())
+                return false;
+            if (!stack.empty())
+                --stack.back().childrenLeft;
+
+            subtreeNodes[i] = 1;
+            subtreeStars[i] = info.nStars;
+            stack.push_back({ i, info.hasChildren ? 8u : 0u });
+            if (stack.size() > MaxDepth)
+                return false;
+
+            while (!stack.empty() && stack.back().childrenLeft == 0)
+            {
+                std::uint32_t closed = stack.back().index;
+                stack.pop_back();
+                if (!stack.empty())
+                {
+                    subtreeNodes[stack.back().index] += subtreeNodes[closed];
+                    subtreeStars[stack.back().index] += subtreeStars[closed];
+                }
+            }
+        }
+
+        if (!stack.empty() || subtreeStars[0] != m_nStars)
+            return false;
+    }
+
+    std::vector<StarRange> residentRanges;
+    std::uint32_t nResidentStars = 0;
+    bool ok = true;
+
+    // Returns the reference to the node or page for the subtree of node,
+    // whose first star in the file is fileStar.
+    auto build = [&](auto& self, std::uint32_t node, std::uint32_t fileStar) -> std::uint32_t
+    {
+        if (subtreeStars[node] == 0)
+            return NoChild;
+
+        std::array<char, sizeof(celengine::StarsDatNode)> record;
+        if (!readAt(in, nodeOffset(node), record.data(), record.size()))
+        {
+            ok = false;
+            return NoChild;
+        }
+        celengine::StarsDatNodeInfo info = celengine::unpackStarsDatNode(record.data());
+
+        if (subtreeStars[node] <= PageStarLimit)
+        {
+            Page& page = m_pages.emplace_back();
+            page.cellCenterPos = info.cellCenterPos;
+            page.firstNode = node;
+            page.nNodes = subtreeNodes[node];
+            page.firstStar = fileStar;
+            page.nStars = static_cast<std::uint32_t>(subtreeStars[node]);
+            return PageBit | static_cast<std::uint32_t>(m_pages.size() - 1);
+        }
+
+        auto index = static_cast<std::uint32_t>(m_nodes.size());
+        Node& newNode = m_nodes.emplace_back();
+        newNode.cellCenterPos = info.cellCenterPos;
+        newNode.exclusionFactor = info.exclusionFactor;
+        newNode.firstStar = nResidentStars;
+        newNode.nStars = info.nStars;
+        newNode.hasChildren = info.hasChildren;
+        std::fill(std::begin(newNode.children), std::end(newNode.children), NoChild);
+
+        residentRanges.push_back({ fileStar, info.nStars });
+        nResidentStars += info.nStars;
+
+        if (info.hasChildren)
+        {
+            std::uint32_t child = node + 1;
+            std::uint32_t childStar = fileStar + info.nStars;
+            for (int i = 0; i < 8; ++i)
+            {
+                std::uint32_t ref = self(self, child, childStar);
+                m_nodes[index].children[i] = ref;
+                childStar += static_cast<std::uint32_t>(subtreeStars[child]);
+                child += subtreeNodes[child];
+            }
+        }
+
+        return index;
+    };
+
+    m_root = build(build, 0, 0);
+    if (!ok || m_root == NoChild || m_pages.size() >= PageBit)
+        return false;
+
+    m_residentStars = std::make_unique<Star[]>(nResidentStars);
+    for (const Node& node : m_nodes)
+    {
+        const StarRange& range = residentRanges[&node - m_nodes.data()];
+        if (range.nStars > 0 &&
+            !readStars(in, m_nNodes, range.fileStar, range.nStars, m_residentStars.get() + node.firstStar))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+std::unique_ptr<PagedStarCatalog::PageData>
+PagedStarCatalog::loadPage(std::istream& in, const Page& page) const
+{
+    std::vector<char> nodes(static_cast<std::size_t>(page.nNodes) * sizeof(celengine::StarsDatNode));
+    if (!readAt(in, nodeOffset(page.firstNode), nodes.data(), nodes.size()))
+        return nullptr;
+
+    auto data = std::make_unique<PageData>();
+    data->stars = std::make_unique<Star[]>(page.nStars);
+    data->spectralTypes.resize(page.nStars);
+    if (!readStarFields(in, m_nNodes, page.firstStar, page.nStars, data->stars.get(), data->spectralTypes.data()))
+        return nullptr;
+
+    const char* nodePtr = nodes.data();
+    std::uint32_t nodesRemaining = page.nNodes;
+    Star* firstStar = data->stars.get();
+    Star* lastStar = firstStar + page.nStars;
+    data->root.reset(celengine::readStarsDatOctree(nodePtr, nodesRemaining, firstStar, lastStar));
+    if (data->root == nullptr || nodesRemaining != 0 || firstStar != lastStar)
+        return nullptr;
+
+    data->size = static_cast<std::size_t>(page.nStars) * sizeof(Star)
+               + static_cast<std::size_t>(page.nNodes) * (sizeof(StarOctree) + 8 * sizeof(StarOctree*));
+    return data;
+}
+
+
+std::unique_ptr<PagedStarCatalog::PageData>
+PagedStarCatalog::loadQuantizedPage(std::istream& in, const Page& page) const
+{
+    std::vector<char> nodeRecords(static_cast<std::size_t>(page.nNodes) * sizeof(celengine::StarsDatNode));
+    if (!readAt(in, nodeOffset(page.firstNode), nodeRecords.data(), nodeRecords.size()))
+        return nullptr;
+
+    auto stars = std::make_unique<Star[]>(page.nStars);
+    auto data = std::make_unique<PageData>();
+    data->spectralTypes.resize(page.nStars);
+    if (!readStarFields(in, m_nNodes, page.firstStar, page.nStars, stars.get(), data->spectralTypes.data()))
+        return nullptr;
+
+    // Rebuild the node hierarchy, closing the subtrees with an explicit
+    // stack as in buildTopLevels.
+    struct OpenNode
+    {
+        std::uint32_t index;
+        unsigned int  childrenLeft;
+    };
+    std::vector<OpenNode> stack;
+    data->nodes.resize(page.nNodes);
+    std::uint32_t nextStar = 0;
+    for (std::uint32_t i = 0; i < page.nNodes; ++i)
+    {
+        celengine::StarsDatNodeInfo info = celengine::unpackStarsDatNode(nodeRecords.data() + i * sizeof(celengine::StarsDatNode));
+        if ((i > 0 && stack.empty()) || info.nStars > page.nStars - nextStar)
+            return nullptr;
+        if (!stack.empty())
+            --stack.back().childrenLeft;
+
+        QuantizedNode& node = data->nodes[i];
+        node.cellCenterPos = info.cellCenterPos;
+        node.exclusionFactor = info.exclusionFactor;
+        node.firstStar = nextStar;
+        node.nStars = info.nStars;
+        nextStar += info.nStars;
+
+        stack.push_back({ i, info.hasChildren ? 8u : 0u });
+        if (stack.size() > MaxDepth)
+            return nullptr;
+        while (!stack.empty() && stack.back().childrenLeft == 0)
+        {
+            data->nodes[stack.back().index].subtreeEnd = i + 1;
+            stack.pop_back();
+        }
+    }
+
+    if (!stack.empty() || nextStar != page.nStars)
+        return nullptr;
+
+    data->catalogNumbers.resize(page.nStars);
+    data->absMags.resize(page.nStars);
+    for (QuantizedNode& node : data->nodes)
+    {
+        // Stars normally lie within their node, but quantize relative to
+        // the actual extent to be safe.
+        float extent = 0.0f;
+        for (std::uint32_t i = node.firstStar; i < node.firstStar + node.nStars; ++i)
+            extent = std::max(extent, (stars[i].getPosition() - node.cellCenterPos).cwiseAbs().maxCoeff());
+
+        constexpr auto Max16 = static_cast<float>(INT16_MAX);
+        constexpr auto Max32 = static_cast<float>(INT32_MAX / 2);
+        node.widePositions = extent / Max16 > 2.0f * MaxPositionError;
+        node.positionStep = std::max(extent, 1.0e-6f) / (node.widePositions ? Max32 : Max16);
+        node.firstPosition = static_cast<std::uint32_t>(node.widePositions ? data->positions32.size()
+                                                                           : data->positions16.size());
+
+        for (std::uint32_t i = node.firstStar; i < node.firstStar + node.nStars; ++i)
+        {
+            const Star& star = stars[i];
+            data->catalogNumbers[i] = star.getIndex();
+            data->absMags[i] = static_cast<std::int16_t>(std::round(star.getAbsoluteMagnitude() * 256.0f));
+
+            Eigen::Vector3f q = (star.getPosition() - node.cellCenterPos) / node.positionStep;
+            for (int j = 0; j < 3; ++j)
+            {
+                if (node.widePositions)
+                    data->positions32.push_back(static_cast<std::int32_t>(std::lround(q[j])));
+                else
+                    data->positions16.push_back(static_cast<std::int16_t>(std::lround(q[j])));
+            }
+        }
+    }
+
+    data->positions16.shrink_to_fit();
+    data->positions32.shrink_to_fit();
+    data->size = data->nodes.size() * sizeof(QuantizedNode)
+               + data->catalogNumbers.size() * sizeof(std::uint32_t)
+               + data->absMags.size() * sizeof(std::int16_t)
+               + data->spectralTypes.size() * sizeof(std::uint16_t)
+               + data->positions16.size() * sizeof(std::int16_t)
+               + data->positions32.size() * sizeof(std::int32_t);
+    return data;
+}
+
+
+const celestia::util::IntrusivePtr<StarDetails>&
+PagedStarCatalog::getDetails(std::uint16_t spectralType)
+{
+    if (m_details.empty())
+        m_details.resize(UINT16_MAX + 1);
+
+    celestia::util::IntrusivePtr<StarDetails>& details = m_details[spectralType];
+    if (details == nullptr)
+    {
+        StellarClass sc;
+        if (sc.unpackV1(spectralType))
+            details = StarDetails::GetStarDetails(sc);
+    }
+
+    return details;
+}
+
+
+void
+PagedStarCatalog::loaderMain()
+{
+    std::ifstream in(m_path, std::ios::in | std::ios::binary);
+
+    for (;;)
+    {
+        std::uint32_t index;
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stopping || !m_requests.empty(); });
+            if (m_stopping)
+                return;
+
+            index = m_requests.front();
+            m_requests.pop_front();
+        }
+
+        std::unique_ptr<PageData> data = m_quantized ? loadQuantizedPage(in, m_pages[index])
+                                                     : loadPage(in, m_pages[index]);
+
+        std::scoped_lock lock(m_mutex);
+        m_loaded.emplace_back(index, std::move(data));
+    }
+}
+
+
+void
+PagedStarCatalog::update()
+{
+    ++m_frame;
+    m_decodedStars.clear();
+
+    std::vector<std::pair<std::uint32_t, std::unique_ptr<PageData>>> loaded;
+    {
+        std::scoped_lock lock(m_mutex);
+        loaded.swap(m_loaded);
+    }
+
+    for (auto& [index, data] : loaded)
+    {
+        Page& page = m_pages[index];
+        page.pending = false;
+        if (data == nullptr)
+        {
+            GetLogger()->error(_("Error reading page {} of paged star database {}\n"), index, m_path);
+            page.failed = true;
+            continue;
+        }
+
+        if (data->stars != nullptr)
+        {
+            for (std::uint32_t i = 0; i < page.nStars; ++i)
+                data->stars[i].setDetails(celestia::util::IntrusivePtr<StarDetails>(getDetails(data->spectralTypes[i])));
+            data->spectralTypes = {};
+        }
+
+        page.data = std::move(data);
+        page.lastUsedFrame = m_frame;
+        m_lru.push_front(index);
+        page.lruPosition = m_lru.begin();
+        m_loadedSize += page.data->size;
+    }
+
+    // Evict the least recently used pages, but keep the ones used in the
+    // last frame even when over budget to avoid reloading them every frame.
+    while (m_loadedSize > m_memoryBudget && !m_lru.empty())
+    {
+        Page& page = m_pages[m_lru.back()];
+        if (page.lastUsedFrame + 1 >= m_frame)
+            break;
+
+        m_lru.pop_back();
+        m_loadedSize -= page.data->size;
+        page.data.reset();
+    }
+}
+
+
+void
+PagedStarCatalog::processNode(StarHandler& processor,
+                              std::uint32_t ref,
+                              const Eigen::Vector3f& obsPosition,
+                              const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                              float limitingMag,
+                              float scale)
+{
+    if (ref == NoChild)
+        return;
+
+    if ((ref & PageBit) != 0)
+    {
+        std::uint32_t index = ref & ~PageBit;
+        Page& page = m_pages[index];
+        if (page.data != nullptr)
+        {
+            page.lastUsedFrame = m_frame;
+            m_lru.splice(m_lru.begin(), m_lru, page.lruPosition);
+            if (page.data->root != nullptr)
+                page.data->root->processVisibleObjects(processor, obsPosition, frustumPlanes, limitingMag, scale);
+            else
+                processQuantizedNode(processor, *page.data, 0, obsPosition, frustumPlanes, limitingMag, scale);
+        }
+        else if (!page.failed && starNodeInFrustum(page.cellCenterPos, frustumPlanes, scale))
+        {
+            m_wanted.emplace_back((obsPosition - page.cellCenterPos).squaredNorm(), index);
+        }
+        return;
+    }
+
+    const Node& node = m_nodes[ref];
+    if (!starNodeInFrustum(node.cellCenterPos, frustumPlanes, scale))
+        return;
+
+    float minDistance = (obsPosition - node.cellCenterPos).norm() - scale * celestia::numbers::sqrt3_v<float>;
+    float dimmest     = minDistance > 0 ? astro::appToAbsMag(limitingMag, minDistance) : 1000;
+
+    processNodeStars(processor, m_residentStars.get() + node.firstStar, node.nStars, obsPosition, limitingMag, dimmest);
+
+    if (!node.hasChildren)
+        return;
+
+    if (minDistance <= 0 || astro::absToAppMag(node.exclusionFactor, minDistance) <= limitingMag)
+    {
+        for (std::uint32_t child : node.children)
+            processNode(processor, child, obsPosition, frustumPlanes, limitingMag, scale * 0.5f);
+    }
+}
+
+
+// Traversal of the quantized pages, with the same tests as the traversal of
+// the StarOctree nodes. The file stars have neither orbits nor extinction,
+// so the apparent magnitude is computed before decoding the Star.
+void
+PagedStarCatalog::processQuantizedNode(StarHandler& processor,
+                                       const PageData& data,
+                                       std::uint32_t index,
+                                       const Eigen::Vector3f& obsPosition,
+                                       const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                                       float limitingMag,
+                                       float scale)
+{
+    const QuantizedNode& node = data.nodes[index];
+    if (!starNodeInFrustum(node.cellCenterPos, frustumPlanes, scale))
+        return;
+
+    float minDistance = (obsPosition - node.cellCenterPos).norm() - scale * celestia::numbers::sqrt3_v<float>;
+    float dimmest     = minDistance > 0 ? astro::appToAbsMag(limitingMag, minDistance) : 1000;
+
+    for (std::uint32_t i = 0; i < node.nStars; ++i)
+    {
+        std::uint32_t star = node.firstStar + i;
+        float absMag = static_cast<float>(data.absMags[star]) / 256.0f;
+        if (absMag >= dimmest)
+            continue;
+
+        std::size_t position = node.firstPosition + 3 * static_cast<std::size_t>(i);
+        Eigen::Vector3f offset = node.widePositions
+            ? Eigen::Vector3f(static_cast<float>(data.positions32[position]),
+                              static_cast<float>(data.positions32[position + 1]),
+                              static_cast<float>(data.positions32[position + 2]))
+            : Eigen::Vector3f(static_cast<float>(data.positions16[position]),
+                              static_cast<float>(data.positions16[position + 1]),
+                              static_cast<float>(data.positions16[position + 2]));
+        Eigen::Vector3f starPosition = node.cellCenterPos + offset * node.positionStep;
+
+        float distance = (obsPosition - starPosition).norm();
+        float appMag   = astro::absToAppMag(absMag, distance);
+        if (appMag >= limitingMag)
+            continue;
+
+        Star& decoded = m_decodedStars.emplace_back();
+        decoded.setPosition(starPosition);
+        decoded.setAbsoluteMagnitude(absMag);
+        decoded.setIndex(data.catalogNumbers[star]);
+        decoded.setDetails(celestia::util::IntrusivePtr<StarDetails>(getDetails(data.spectralTypes[star])));
+        processor.process(decoded, distance, appMag);
+    }
+
+    if (node.subtreeEnd == index + 1)
+        return;
+
+    if (minDistance <= 0 || astro::absToAppMag(node.exclusionFactor, minDistance) <= limitingMag)
+    {
+        for (std::uint32_t child = index + 1; child < node.subtreeEnd; child = data.nodes[child].subtreeEnd)
+            processQuantizedNode(processor, data, child, obsPosition, frustumPlanes, limitingMag, scale * 0.5f);
+    }
+}
+
+
+void
+PagedStarCatalog::findVisibleStars(StarHandler& processor,
+                                   const Eigen::Vector3f& obsPosition,
+                                   const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                                   float limitingMag)
+{
+    m_wanted.clear();
+    processNode(processor, m_root, obsPosition, frustumPlanes, limitingMag, STAR_OCTREE_ROOT_SIZE);
+
+    std::sort(m_wanted.begin(), m_wanted.end());
+
+    // The requests still queued from the previous frame are replaced, so
+    // that the loader only works on pages which are still in view.
+    bool haveRequests;
+    {
+        std::scoped_lock lock(m_mutex);
+        for (std::uint32_t index : m_requests)
+            m_pages[index].pending = false;
+        m_requests.clear();
+
+        for (const auto& wanted : m_wanted)
+        {
+            Page& page = m_pages[wanted.second];
+            if (!page.pending)
+            {
+                page.pending = true;
+                m_requests.push_back(wanted.second);
+            }
+        }
+
+        haveRequests = !m_requests.empty();
+    }
+
+    if (haveRequests)
+        m_condition.notify_one();
+}
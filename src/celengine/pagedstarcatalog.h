@@ -0,0 +1,198 @@
+// pagedstarcatalog.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celcompat/filesystem.h>
+#include <celutil/intrusiveptr.h>
+#include "staroctree.h"
+
+// A star catalog too large to be kept in memory, read from a sorted star
+// database file (see StarDatabase::writeSortedBinary). The top levels of
+// its octree stay resident, while the subtrees below them are loaded as
+// pages on a background thread when a traversal reaches them. The least
+// recently used pages are dropped when the catalog is over its memory
+// budget. Until a page has been loaded its stars are missing, leaving
+// just the brighter stars of the coarser nodes above it.
+//
+// Pages may be held in a quantized layout, which takes about a third of
+// the memory: positions in 16 bit (or for large nodes 32 bit) fixed point
+// relative to the node center, with the magnitudes and spectral types as
+// stored in the file. The stars of these pages are decoded to Star objects
+// only when they pass the culling tests.
+//
+// The stars are not part of the StarDatabase: they can't be found by
+// name or catalog number, and the ones from pages are only valid until the
+// next call to update(), so they must not be held across frames.
+class PagedStarCatalog
+{
+ public:
+    ~PagedStarCatalog();
+    PagedStarCatalog(const PagedStarCatalog&) = delete;
+    PagedStarCatalog& operator=(const PagedStarCatalog&) = delete;
+
+    // Returns nullptr if the file can't be read or isn't a sorted star
+    // database. memoryBudget is the maximum size of the loaded pages in
+    // bytes; quantized selects the quantized page layout.
+    static std::unique_ptr<PagedStarCatalog> open(const fs::path& path,
+                                                  std::size_t memoryBudget,
+                                                  bool quantized = true);
+
+    // Take in the pages loaded since the previous call and evict the least
+    // recently used pages over budget. Must be called from the thread doing
+    // the traversals, before each frame.
+    void update();
+
+    // Pass the potentially visible stars on to the processor, as
+    // StarOctree::processVisibleObjects, and request the missing pages in
+    // view, nearest first.
+    void findVisibleStars(StarHandler& processor,
+                          const Eigen::Vector3f& obsPosition,
+                          const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                          float limitingMag);
+
+    std::uint32_t size() const { return m_nStars; }
+    std::size_t getLoadedSize() const { return m_loadedSize; }
+
+ private:
+    PagedStarCatalog() = default;
+
+    // Child references are either indices into m_nodes, or indices into
+    // m_pages with PageBit set.
+    static constexpr std::uint32_t PageBit = UINT32_C(0x80000000);
+    static constexpr std::uint32_t NoChild = UINT32_C(0xffffffff);
+
+    struct Node
+    {
+        Eigen::Vector3f cellCenterPos;
+        float           exclusionFactor;
+        std::uint32_t   firstStar;
+        std::uint32_t   nStars;
+        std::uint32_t   children[8];
+        bool            hasChildren;
+    };
+
+    // Node of a page in the quantized layout, in depth-first order. The
+    // children of a node follow it up to subtreeEnd, each followed by its
+    // own descendants.
+    struct QuantizedNode
+    {
+        Eigen::Vector3f cellCenterPos;
+        float           exclusionFactor;
+        float           positionStep;
+        std::uint32_t   firstStar;
+        std::uint32_t   nStars;
+        std::uint32_t   firstPosition;
+        std::uint32_t   subtreeEnd;
+        bool            widePositions;
+    };
+
+    struct PageData
+    {
+        // Full layout
+        std::unique_ptr<Star[]>     stars;
+        std::unique_ptr<StarOctree> root;
+
+        // Quantized layout; the positions are stored as x, y, z triples,
+        // in positions16 or positions32 depending on the node.
+        std::vector<QuantizedNode>  nodes;
+        std::vector<std::uint32_t>  catalogNumbers;
+        std::vector<std::int16_t>   absMags;
+        std::vector<std::int16_t>   positions16;
+        std::vector<std::int32_t>   positions32;
+
+        // Packed spectral types of the stars. The details of the stars of
+        // the full layout are set from these on the traversal thread
+        // (see update()), as StarDetails can't be shared across threads.
+        std::vector<std::uint16_t>  spectralTypes;
+
+        std::size_t                 size{ 0 };
+    };
+
+    struct Page
+    {
+        // Location of the subtree in the file; only these are read by the
+        // loader thread.
+        Eigen::Vector3f cellCenterPos;
+        std::uint32_t   firstNode;
+        std::uint32_t   nNodes;
+        std::uint32_t   firstStar;
+        std::uint32_t   nStars;
+
+        std::unique_ptr<PageData>          data;
+        std::list<std::uint32_t>::iterator lruPosition;
+        std::uint64_t                      lastUsedFrame{ 0 };
+        bool                               pending{ false };
+        bool                               failed{ false };
+    };
+
+    bool buildTopLevels(std::istream& in);
+    void processNode(StarHandler& processor,
+                     std::uint32_t ref,
+                     const Eigen::Vector3f& obsPosition,
+                     const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                     float limitingMag,
+                     float scale);
+
+    void processQuantizedNode(StarHandler& processor,
+                              const PageData& data,
+                              std::uint32_t index,
+                              const Eigen::Vector3f& obsPosition,
+                              const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                              float limitingMag,
+                              float scale);
+
+    std::unique_ptr<PageData> loadPage(std::istream& in, const Page& page) const;
+    std::unique_ptr<PageData> loadQuantizedPage(std::istream& in, const Page& page) const;
+    const celestia::util::IntrusivePtr<StarDetails>& getDetails(std::uint16_t spectralType);
+    void loaderMain();
+
+    fs::path                     m_path;
+    std::uint32_t                m_nStars{ 0 };
+    std::uint32_t                m_nNodes{ 0 };
+    std::size_t                  m_memoryBudget{ 0 };
+    bool                         m_quantized{ true };
+
+    std::uint32_t                m_root{ NoChild };
+    std::vector<Node>            m_nodes;
+    std::unique_ptr<Star[]>      m_residentStars;
+    std::vector<Page>            m_pages;
+
+    // Used on the traversal thread only
+    std::list<std::uint32_t>     m_lru;
+    std::size_t                  m_loadedSize{ 0 };
+    std::uint64_t                m_frame{ 1 };
+    std::vector<std::pair<float, std::uint32_t>> m_wanted;
+    // Details by packed spectral type
+    std::vector<celestia::util::IntrusivePtr<StarDetails>> m_details;
+    // Stars decoded from quantized pages in the current frame
+    std::deque<Star>             m_decodedStars;
+
+    // Shared with the loader thread
+    std::thread                  m_loader;
+    std::mutex                   m_mutex;
+    std::condition_variable      m_condition;
+    std::deque<std::uint32_t>    m_requests;
+    std::vector<std::pair<std::uint32_t, std::unique_ptr<PageData>>> m_loaded;
+    bool                         m_stopping{ false };
+};
@@ -22,9 +22,12 @@
 #include <celephem/customorbit.h>
 #include <celephem/customrotation.h>
 #ifdef USE_SPICE
+#include <celephem/chebyshevorbit.h>
 #include <celephem/spiceorbit.h>
 #include <celephem/spicerotation.h>
 #endif
+#include <celephem/samporbit.h>
+#include <celephem/samporient.h>
 #include <celephem/scriptorbit.h>
 #include <celephem/scriptrotation.h>
 #include <celmath/geomutil.h>
@@ -109,7 +112,7 @@ ParseDate(const Hash* hash, const string& name, double& jd)
 
 
 /*!
- * Create a new Keplerian orbit from an ssc property table:
+ * Read the elements of a Keplerian orbit from an ssc property table:
  *
  * \code EllipticalOrbit
  * {
@@ -142,9 +145,9 @@ ParseDate(const Hash* hash, const string& name, double& jd)
  *     Period is in Julian days
  *     SemiMajorAxis or PericenterDistance is in kilometers.
  */
-static std::unique_ptr<celestia::ephem::Orbit>
-CreateEllipticalOrbit(const Hash* orbitData,
-                      bool usePlanetUnits)
+std::optional<EllipticalOrbitElements>
+ParseEllipticalOrbit(const Hash* orbitData,
+                     bool usePlanetUnits)
 {
 
     // default units for planets are AU and years, otherwise km and days
@@ -166,7 +169,7 @@ CreateEllipticalOrbit(const Hash* orbitData,
         else
         {
             GetLogger()->error("SemiMajorAxis/PericenterDistance missing!  Skipping planet . . .\n");
-            return nullptr;
+            return std::nullopt;
         }
     }
 
@@ -178,7 +181,7 @@ CreateEllipticalOrbit(const Hash* orbitData,
     else
     {
         GetLogger()->error("Period missing!  Skipping planet . . .\n");
-        return nullptr;
+        return std::nullopt;
     }
 
     auto eccentricity = orbitData->getNumber<double>("Eccentricity").value_or(0.0);
@@ -217,14 +220,35 @@ CreateEllipticalOrbit(const Hash* orbitData,
     if (semiMajorAxis.has_value())
         pericenterDistance = *semiMajorAxis * (1.0 - eccentricity);
 
-    return std::make_unique<celestia::ephem::EllipticalOrbit>(pericenterDistance,
-                                                              eccentricity,
-                                                              degToRad(inclination),
-                                                              degToRad(ascendingNode),
-                                                              degToRad(argOfPericenter),
-                                                              degToRad(anomalyAtEpoch),
-                                                              period,
-                                                              epoch);
+    EllipticalOrbitElements elements;
+    elements.pericenterDistance = pericenterDistance;
+    elements.eccentricity = eccentricity;
+    elements.inclination = degToRad(inclination);
+    elements.ascendingNode = degToRad(ascendingNode);
+    elements.argOfPeriapsis = degToRad(argOfPericenter);
+    elements.meanAnomalyAtEpoch = degToRad(anomalyAtEpoch);
+    elements.period = period;
+    elements.epoch = epoch;
+    return elements;
+}
+
+
+static std::unique_ptr<celestia::ephem::Orbit>
+CreateEllipticalOrbit(const Hash* orbitData,
+                      bool usePlanetUnits)
+{
+    auto elements = ParseEllipticalOrbit(orbitData, usePlanetUnits);
+    if (!elements.has_value())
+        return nullptr;
+
+    return std::make_unique<celestia::ephem::EllipticalOrbit>(elements->pericenterDistance,
+                                                              elements->eccentricity,
+                                                              elements->inclination,
+                                                              elements->ascendingNode,
+                                                              elements->argOfPeriapsis,
+                                                              elements->meanAnomalyAtEpoch,
+                                                              elements->period,
+                                                              elements->epoch);
 }
 
 
@@ -344,6 +368,9 @@ CreateFixedPosition(const Hash* trajData, const Selection& centralObject, bool u
 
 
 #ifdef USE_SPICE
+// Longest coverage of a precomputed SPICE orbit, in days
+constexpr double MaxPrecomputedSpiceRange = 100.0 * 365.25;
+
 /**
  * Parse a string list--either a single string or an array of strings is permitted.
  */
@@ -396,6 +423,8 @@ ParseStringList(const Hash* table,
  *      Period <number>                # optional
  *      Beginning <number>             # optional
  *      Ending <number>                # optional
+ *      Precompute <boolean>           # optional (defaults to false)
+ *      Tolerance <number>             # optional (defaults to 1 m)
  *  } \endcode
  *
  *  The Kernel property specifies one or more SPK files that must be loaded. Any
@@ -412,8 +441,11 @@ ParseStringList(const Hash* table,
  *  specified, the valid range is computed from the coverage window in the SPICE
  *  kernel pool. If the coverage window is noncontiguous, the first interval is
  *  used.
+ *  If Precompute is true, the whole valid range is fitted with Chebyshev
+ *  polynomials within Tolerance of SPICE on a background thread, and SPICE is
+ *  only called for the parts not fitted yet. The orbit is then thread safe.
  */
-static std::unique_ptr<celestia::ephem::SpiceOrbit>
+static std::unique_ptr<celestia::ephem::Orbit>
 CreateSpiceOrbit(const Hash* orbitData,
                  const fs::path& path,
                  bool usePlanetUnits)
@@ -520,10 +552,27 @@ CreateSpiceOrbit(const Hash* orbitData,
     {
         // Error using SPICE library; destroy the orbit; hopefully a
         // fallback is defined in the SSC file.
-        orbit = nullptr;
+        return nullptr;
     }
 
-    return orbit;
+    if (!orbitData->getBoolean("Precompute").value_or(false))
+        return orbit;
+
+    double begin = 0.0;
+    double end = 0.0;
+    orbit->getValidRange(begin, end);
+    if (end - begin > MaxPrecomputedSpiceRange)
+    {
+        GetLogger()->warn("Coverage of SPICE orbit for {} is too long to be precomputed.\n", *targetBodyName);
+        return orbit;
+    }
+
+    // Windows of a day fit the flybys of most spacecraft kernels in a few
+    // pieces.
+    auto tolerance = orbitData->getLength<double>("Tolerance", 1.0, distanceScale).value_or(0.001);
+    auto precomputed = std::make_unique<celestia::ephem::ChebyshevOrbit>(std::move(orbit), 1.0, tolerance);
+    precomputed->precompute(begin, end);
+    return precomputed;
 }
 
 
@@ -537,6 +586,8 @@ CreateSpiceOrbit(const Hash* orbitData,
  *      Period <number>                # optional (units are hours)
  *      Beginning <number>             # optional
  *      Ending <number>                # optional
+ *      Precompute <boolean>           # optional (defaults to false)
+ *      Tolerance <number>             # optional (degrees, defaults to 1e-4)
  *  } \endcode
  *
  *  The Kernel property specifies one or more SPICE kernel files that must be
@@ -554,6 +605,10 @@ CreateSpiceOrbit(const Hash* orbitData,
  *  that the rotation is aperiodic. It is not essential to provide the rotation
  *  period; it is only used by Celestia for displaying object information such
  *  as sidereal day length.
+ *  If Precompute is true, the rotation is sampled over its time range on a
+ *  background thread until interpolating between the samples is within
+ *  Tolerance of SPICE; the samples are used instead of SPICE once done. It
+ *  requires Beginning and Ending.
  */
 static std::unique_ptr<celestia::ephem::SpiceRotation>
 CreateSpiceRotation(const Hash* rotationData,
@@ -644,7 +699,13 @@ CreateSpiceRotation(const Hash* rotationData,
     if (!rotation->init(path, kernelList.cbegin(), kernelList.cend()))
     {
         // Error using SPICE library; destroy the rotation.
-        rotation = nullptr;
+        return nullptr;
+    }
+
+    if (rotationData->getBoolean("Precompute").value_or(false))
+    {
+        auto tolerance = rotationData->getAngle<double>("Tolerance").value_or(1.0e-4);
+        rotation->precompute(celmath::degToRad(tolerance));
     }
 
     return rotation;
@@ -652,6 +713,54 @@ CreateSpiceRotation(const Hash* rotationData,
 #endif
 
 
+#if defined(CELX)
+// Scripted objects are only tabulated over this much time at most
+constexpr double MaxTabulatedScriptRange = 100.0 * 365.25;
+
+/*! Get the time range over which a scripted object is tabulated: Beginning
+ *  and Ending if given, otherwise the valid range the script reports.
+ */
+template<typename T>
+static bool
+GetTabulationRange(const Hash* data, const T& model, double& begin, double& end)
+{
+    model.getValidRange(begin, end);
+    ParseDate(data, "Beginning", begin);
+    ParseDate(data, "Ending", end);
+
+    if (!(end > begin))
+    {
+        GetLogger()->warn("Scripted object has no time range to tabulate.\n");
+        return false;
+    }
+    if (end - begin > MaxTabulatedScriptRange)
+    {
+        GetLogger()->warn("Time range of scripted object is too long to be tabulated.\n");
+        return false;
+    }
+    return true;
+}
+#endif
+
+
+/*! Create a new trajectory computed by a Lua function.
+ *
+ *  \code ScriptedOrbit
+ *  {
+ *      Module <string>                # optional
+ *      Function <string>
+ *      Tabulate <boolean>             # optional (defaults to false)
+ *      Tolerance <number>             # optional (km, defaults to 1 m)
+ *      Beginning <date>               # optional
+ *      Ending <date>                  # optional
+ *      ...                            # parameters passed to the function
+ *  }
+ *  \endcode
+ *
+ *  If Tabulate is true, the function is sampled once while loading, over
+ *  Beginning to Ending or the range the script gives, into a trajectory
+ *  within Tolerance of it; the script isn't called afterwards.
+ */
 static celestia::ephem::Orbit*
 CreateScriptedOrbit(const Hash* orbitData,
                     const fs::path& path)
@@ -675,7 +784,20 @@ CreateScriptedOrbit(const Hash* orbitData,
     //Value* pathValue = new Value(path.string());
     //orbitData->addValue("AddonPath", *pathValue);
 
-    return celestia::ephem::CreateScriptedOrbit(moduleName, *funcName, *orbitData, path).release();
+    auto orbit = celestia::ephem::CreateScriptedOrbit(moduleName, *funcName, *orbitData, path);
+    if (orbit == nullptr || !orbitData->getBoolean("Tabulate").value_or(false))
+        return orbit.release();
+
+    // Sampled on the loading thread, as the Lua state isn't thread safe
+    double begin = 0.0;
+    double end = 0.0;
+    if (!GetTabulationRange(orbitData, *orbit, begin, end))
+        return orbit.release();
+
+    auto tolerance = orbitData->getLength<double>("Tolerance").value_or(0.001);
+    if (auto tabulated = celestia::ephem::TabulateOrbit(*orbit, begin, end, tolerance); tabulated != nullptr)
+        return tabulated.release();
+    return orbit.release();
 #endif
 }
 
@@ -943,6 +1065,22 @@ CreatePrecessingRotationModel(const Hash* rotationData,
 }
 
 
+/*! Create a new rotation model computed by a Lua function.
+ *
+ *  \code ScriptedRotation
+ *  {
+ *      Module <string>                # optional
+ *      Function <string>
+ *      Tabulate <boolean>             # optional (defaults to false)
+ *      Tolerance <number>             # optional (degrees, defaults to 1e-4)
+ *      Beginning <date>               # optional
+ *      Ending <date>                  # optional
+ *      ...                            # parameters passed to the function
+ *  }
+ *  \endcode
+ *
+ *  Tabulate works as for ScriptedOrbit.
+ */
 static std::unique_ptr<celestia::ephem::RotationModel>
 CreateScriptedRotation(const Hash* rotationData,
                        const fs::path& path)
@@ -966,7 +1104,22 @@ CreateScriptedRotation(const Hash* rotationData,
     //Value* pathValue = new Value(path.string());
     //rotationData->addValue("AddonPath", *pathValue);
 
-    return celestia::ephem::CreateScriptedRotation(moduleName, *funcName, *rotationData, path);
+    auto rotation = celestia::ephem::CreateScriptedRotation(moduleName, *funcName, *rotationData, path);
+    if (rotation == nullptr || !rotationData->getBoolean("Tabulate").value_or(false))
+        return rotation;
+
+    double begin = 0.0;
+    double end = 0.0;
+    if (!GetTabulationRange(rotationData, *rotation, begin, end))
+        return rotation;
+
+    auto tolerance = rotationData->getAngle<double>("Tolerance").value_or(1.0e-4);
+    if (auto tabulated = celestia::ephem::TabulateRotation(*rotation, begin, end, celmath::degToRad(tolerance));
+        tabulated != nullptr)
+    {
+        return tabulated;
+    }
+    return rotation;
 #endif
 }
 
@@ -14,6 +14,7 @@
 
 #include <string>
 #include <memory>
+#include <optional>
 #include <celephem/orbit.h>
 #include <celephem/rotation.h>
 #include <celcompat/filesystem.h>
@@ -35,6 +36,23 @@ enum class DataDisposition
 
 bool ParseDate(const Hash* hash, const std::string& name, double& jd);
 
+// Elements of an EllipticalOrbit definition, in kilometers, days and
+// radians
+struct EllipticalOrbitElements
+{
+    double pericenterDistance;
+    double eccentricity;
+    double inclination;
+    double ascendingNode;
+    double argOfPeriapsis;
+    double meanAnomalyAtEpoch;
+    double period;
+    double epoch;
+};
+
+std::optional<EllipticalOrbitElements> ParseEllipticalOrbit(const Hash* orbitData,
+                                                            bool usePlanetUnits);
+
 celestia::ephem::Orbit* CreateOrbit(const Selection& centralObject,
                                     const Hash* planetData,
                                     const fs::path& path,
@@ -8,6 +8,8 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 #include <map>
+#include <memory>
+#include <string>
 #include <string_view>
 #include <utility>
 #include <variant>
@@ -124,16 +126,35 @@ Parser::Parser(Tokenizer* _tokenizer) :
 }
 
 
-std::unique_ptr<ValueArray> Parser::readArray()
+Parser::Parser(Tokenizer* _tokenizer, celestia::util::Arena* _arena) :
+    tokenizer(_tokenizer),
+    arena(_arena)
+{
+}
+
+
+Value Parser::readArray()
 {
     Tokenizer::TokenType tok = tokenizer->nextToken();
     if (tok != Tokenizer::TokenBeginArray)
     {
         tokenizer->pushBack();
-        return nullptr;
+        return Value();
     }
 
-    auto array = std::make_unique<ValueArray>();
+    std::unique_ptr<ValueArray> heapArray;
+    ValueArray* array;
+    Value result;
+    if (arena == nullptr)
+    {
+        heapArray = std::make_unique<ValueArray>();
+        array = heapArray.get();
+    }
+    else
+    {
+        array = arena->create<ValueArray>(celestia::util::ArenaAllocator<Value>(arena));
+        result = Value::fromArena(array);
+    }
 
     Value v = readValue();
     while (!v.isNull())
@@ -146,23 +167,35 @@ std::unique_ptr<ValueArray> Parser::readArray()
     if (tok != Tokenizer::TokenEndArray)
     {
         tokenizer->pushBack();
-        return nullptr;
+        return Value();
     }
 
-    return array;
+    return heapArray == nullptr ? std::move(result) : Value(std::move(heapArray));
 }
 
 
-std::unique_ptr<Hash> Parser::readHash()
+Value Parser::readHash()
 {
     Tokenizer::TokenType tok = tokenizer->nextToken();
     if (tok != Tokenizer::TokenBeginGroup)
     {
         tokenizer->pushBack();
-        return nullptr;
+        return Value();
     }
 
-    auto hash = std::make_unique<Hash>();
+    std::unique_ptr<Hash> heapHash;
+    Hash* hash;
+    Value result;
+    if (arena == nullptr)
+    {
+        heapHash = std::make_unique<Hash>();
+        hash = heapHash.get();
+    }
+    else
+    {
+        hash = arena->create<Hash>(arena);
+        result = Value::fromArena(hash);
+    }
 
     tok = tokenizer->nextToken();
     while (tok != Tokenizer::TokenEndGroup)
@@ -175,7 +208,7 @@ std::unique_ptr<Hash> Parser::readHash()
         else
         {
             tokenizer->pushBack();
-            return nullptr;
+            return Value();
         }
 
         Value::Units units = readUnits(*tokenizer);
@@ -183,16 +216,16 @@ std::unique_ptr<Hash> Parser::readHash()
         Value value = readValue();
         if (value.isNull())
         {
-            return nullptr;
+            return Value();
         }
 
         value.setUnits(units);
-        hash->addValue(std::move(name), std::move(value));
+        hash->addValue(name, std::move(value));
 
         tok = tokenizer->nextToken();
     }
 
-    return hash;
+    return heapHash == nullptr ? std::move(result) : Value(std::move(heapHash));
 }
 
 
@@ -205,7 +238,9 @@ Value Parser::readValue()
         return Value(*tokenizer->getNumberValue());
 
     case Tokenizer::TokenString:
-        return Value(*tokenizer->getStringValue());
+        if (arena == nullptr)
+            return Value(*tokenizer->getStringValue());
+        return Value::fromArena(arena->create<std::string>(*tokenizer->getStringValue()));
 
     case Tokenizer::TokenName:
         if (tokenizer->getNameValue() == "false")
@@ -220,23 +255,11 @@ Value Parser::readValue()
 
     case Tokenizer::TokenBeginArray:
         tokenizer->pushBack();
-        {
-            std::unique_ptr<ValueArray> array = readArray();
-            if (array == nullptr)
-                return Value();
-            else
-                return Value(std::move(array));
-        }
+        return readArray();
 
     case Tokenizer::TokenBeginGroup:
         tokenizer->pushBack();
-        {
-            std::unique_ptr<Hash> hash = readHash();
-            if (hash == nullptr)
-                return Value();
-            else
-                return Value(std::move(hash));
-        }
+        return readHash();
 
     default:
         tokenizer->pushBack();
@@ -12,6 +12,7 @@
 
 #include <memory>
 
+#include <celutil/arena.h>
 #include "hash.h"
 #include "value.h"
 
@@ -22,12 +23,16 @@ class Parser
 {
  public:
     Parser(Tokenizer*);
+    // Build the values in an arena; they must be destroyed before it is
+    // reset or destroyed.
+    Parser(Tokenizer*, celestia::util::Arena*);
 
     Value readValue();
 
  private:
     Tokenizer* tokenizer;
+    celestia::util::Arena* arena{ nullptr };
 
-    std::unique_ptr<ValueArray> readArray();
-    std::unique_ptr<Hash> readHash();
+    Value readArray();
+    Value readHash();
 };
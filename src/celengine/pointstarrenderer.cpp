@@ -8,9 +8,11 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <celengine/skyoccluders.h>
 #include <celengine/starcolors.h>
 #include <celengine/star.h>
 #include <celengine/univcoord.h>
+#include <celrender/starbloom.h>
 #include "pointstarvertexbuffer.h"
 #include "render.h"
 #include "pointstarrenderer.h"
@@ -18,13 +20,28 @@
 using namespace std;
 using namespace Eigen;
 
-// Convert a position in the universal coordinate system to astrocentric
-// coordinates, taking into account possible orbital motion of the star.
-static Vector3d astrocentricPosition(const UniversalCoord& pos,
-                                     const Star& star,
-                                     double t)
+void PointStarBatch::clear()
 {
-    return pos.offsetFromKm(star.getPosition(t));
+    stars.clear();
+    glares.clear();
+    labels.clear();
+    deferred.clear();
+}
+
+const Color*
+StarColorCache::getColors(const StarCullingData& cullingData, const ColorTemperatureTable& table)
+{
+    std::size_t nStars = cullingData.temperature.size();
+    if (m_table != &table || m_stars != cullingData.stars || m_colors.size() != nStars)
+    {
+        m_colors.resize(nStars);
+        for (std::size_t i = 0; i < nStars; ++i)
+            m_colors[i] = table.lookupColor(cullingData.temperature[i]);
+        m_table = &table;
+        m_stars = cullingData.stars;
+    }
+
+    return m_colors.data();
 }
 
 PointStarRenderer::PointStarRenderer() :
@@ -37,12 +54,27 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
     if (distance > distanceLimit)
         return;
 
-    Vector3f starPos = star.getPosition();
+    Vector3f starPos;
+    float    orbitalRadius;
+    Color    starColor;
+    if (cullingData != nullptr && cullingData->contains(&star))
+    {
+        // Avoid touching the star and its details in the common case
+        std::size_t i = cullingData->indexOf(&star);
+        starPos = Vector3f(cullingData->positionX[i], cullingData->positionY[i], cullingData->positionZ[i]);
+        orbitalRadius = cullingData->orbitalRadius[i];
+        starColor = starColors != nullptr ? starColors[i] : colorTemp->lookupColor(cullingData->temperature[i]);
+    }
+    else
+    {
+        starPos = star.getPosition();
+        orbitalRadius = star.getOrbitalRadius();
+        starColor = colorTemp->lookupColor(star.getTemperature());
+    }
 
     // Calculate the difference at double precision *before* converting to float.
     // This is very important for stars that are far from the origin.
     Vector3f relPos = (starPos.cast<double>() - obsPos).cast<float>();
-    float    orbitalRadius = star.getOrbitalRadius();
     bool     hasOrbit = orbitalRadius > 0.0f;
 
     // A very rough check to see if the star may be visible: is the star in
@@ -53,7 +85,6 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
     // cost of a normalize per star.
     if (relPos.dot(viewNormal) > 0.0f || relPos.x() * relPos.x() < 0.1f || hasOrbit)
     {
-        Color starColor = colorTemp->lookupColor(star.getTemperature());
         float discSizeInPixels = 0.0f;
         float orbitSizeInPixels = 0.0f;
 
@@ -72,14 +103,22 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
         // and use the most inexpensive test possible . . .
         if (distance < SolarSystemMaxDistance || orbitSizeInPixels > 1.0f)
         {
-            // Compute the position of the observer relative to the star.
+            // Evaluating the star's orbit isn't safe off the render thread.
+            if (batch != nullptr)
+            {
+                batch->deferred.push_back({ &star, distance, appMag });
+                return;
+            }
+
+            // Compute the position of the star relative to the observer.
             // This is a much more accurate (and expensive) distance
             // calculation than the previous one which used the observer's
-            // position rounded off to floats.
-            Vector3d hPos = astrocentricPosition(observer->getPosition(),
-                                                 star,
-                                                 observer->getTime());
-            relPos = hPos.cast<float>() * -astro::kilometersToLightYears(1.0f);
+            // position rounded off to floats. The near stars of the frame
+            // already have it.
+            Vector3d offset;
+            if (!renderer->getNearStarOffset(&star, offset))
+                offset = star.getPosition(observer->getTime()).offsetFromKm(observer->getPosition());
+            relPos = offset.cast<float>() * astro::kilometersToLightYears(1.0f);
             distance = relPos.norm();
 
             // Recompute apparent magnitude using new distance computation
@@ -93,6 +132,10 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
         // planets.
         if (distance > SolarSystemMaxDistance)
         {
+            // No point nor label for the stars behind a planet
+            if (occluders != nullptr && occluders->hides(relPos, distance))
+                return;
+
             float pointSize, alpha, glareSize, glareAlpha;
             float size = BaseStarDiscSize * static_cast<float>(renderer->getScreenDpi()) / 96.0f;
             renderer->calculatePointSize(appMag,
@@ -102,10 +145,25 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
                                          glareSize,
                                          glareAlpha);
 
-            if (glareSize != 0.0f)
-                glareVertexBuffer->addStar(relPos, Color(starColor, glareAlpha), glareSize);
-            if (pointSize != 0.0f)
-                starVertexBuffer->addStar(relPos, Color(starColor, alpha), pointSize);
+            if (batch != nullptr)
+            {
+                if (glareSize != 0.0f)
+                    batch->glares.push_back({ relPos, Color(starColor, glareAlpha), glareSize });
+                if (pointSize != 0.0f)
+                    batch->stars.push_back({ relPos, Color(starColor, alpha), pointSize });
+            }
+            else
+            {
+                if (glareSize != 0.0f)
+                {
+                    if (bloom != nullptr)
+                        bloom->addStar(relPos, Color(starColor, glareAlpha), glareSize);
+                    else
+                        glareVertexBuffer->addStar(relPos, Color(starColor, glareAlpha), glareSize);
+                }
+                if (pointSize != 0.0f)
+                    starVertexBuffer->addStar(relPos, Color(starColor, alpha), pointSize);
+            }
 
             // Place labels for stars brighter than the specified label threshold brightness
             if (((labelMode & Renderer::StarLabels) != 0) && appMag < labelThresholdMag)
@@ -115,10 +173,17 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
                 {
                     float distr = min(1.0f, 3.5f * (labelThresholdMag - appMag)/labelThresholdMag);
                     Color color = Color(Renderer::StarLabelColor, distr * Renderer::StarLabelColor.alpha());
-                    renderer->addBackgroundAnnotation(nullptr,
-                                                      starDB->getStarName(star, true),
-                                                      color,
-                                                      relPos);
+                    if (batch != nullptr)
+                        batch->labels.push_back({ &star, color, relPos, appMag });
+                    else
+                        renderer->addBackgroundAnnotation(nullptr,
+                                                          renderer->getLabelCache().getStarLabel(*starDB, star),
+                                                          color,
+                                                          relPos,
+                                                          Renderer::LabelHorizontalAlignment::Start,
+                                                          Renderer::LabelVerticalAlignment::Bottom,
+                                                          0.0f,
+                                                          -appMag);
                 }
             }
         }
@@ -152,10 +217,20 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
                 pos = pos * (1.0f - star.getRadius() * 1.01f / pos.norm());
 
                 renderer->addSortedAnnotation(nullptr,
-                                              starDB->getStarName(star, true),
+                                              renderer->getLabelCache().getStarLabel(*starDB, star),
                                               Renderer::StarLabelColor,
                                               pos);
             }
         }
     }
 }
+
+void PointStarRenderer::processBatch(const Star* firstStar,
+                                     const unsigned int* indices,
+                                     const float* distances,
+                                     const float* appMags,
+                                     unsigned int count)
+{
+    for (unsigned int i = 0; i < count; ++i)
+        PointStarRenderer::process(firstStar[indices[i]], distances[i], appMags[i]);
+}
@@ -12,14 +12,22 @@
 
 #include <Eigen/Core>
 #include <vector>
+#include <celutil/color.h>
 #include "objectrenderer.h"
 #include "renderlistentry.h"
+#include "staroctree.h"
 
 class ColorTemperatureTable;
+class SkyOccluders;
 class PointStarVertexBuffer;
 class Star;
 class StarDatabase;
 
+namespace celestia::render
+{
+class StarBloom;
+}
+
 // TODO: move these variables to PointStarRenderer class
 // without adding a variable. Requires C++17
 constexpr inline float StarDistanceLimit     = 1.0e6f;
@@ -28,6 +36,58 @@ constexpr inline float BaseStarDiscSize      = 5.0f;
 constexpr inline float MaxScaledDiscStarSize = 8.0f;
 constexpr inline float GlareOpacity          = 0.65f;
 
+// Output of a PointStarRenderer running on a worker thread. Filling it
+// doesn't touch GL or any renderer state, so the contents are merged into
+// the vertex buffers and annotation lists on the render thread afterwards.
+struct PointStarBatch
+{
+    struct Vertex
+    {
+        Eigen::Vector3f position;
+        Color color;
+        float size;
+    };
+
+    struct Label
+    {
+        const Star* star;
+        Color color;
+        Eigen::Vector3f position;
+        float appMag;
+    };
+
+    // Stars which need a precise astrocentric position or have to go into
+    // the render list are handed back unprocessed.
+    struct Deferred
+    {
+        const Star* star;
+        float distance;
+        float appMag;
+    };
+
+    std::vector<Vertex>   stars;
+    std::vector<Vertex>   glares;
+    std::vector<Label>    labels;
+    std::vector<Deferred> deferred;
+
+    void clear();
+};
+
+// Colors of the stars of a StarCullingData in a color temperature table,
+// in the order of the culling data arrays, so that the renderer reads a
+// packed color per star rather than looking up its temperature. They're
+// computed again when the table changes.
+class StarColorCache
+{
+ public:
+    const Color* getColors(const StarCullingData& cullingData, const ColorTemperatureTable& table);
+
+ private:
+    std::vector<Color> m_colors;
+    const Star* m_stars{ nullptr };
+    const ColorTemperatureTable* m_table{ nullptr };
+};
+
 class PointStarRenderer : public ObjectRenderer<Star, float>
 {
  public:
@@ -40,7 +100,12 @@ class PointStarRenderer : public ObjectRenderer<Star, float>
 #endif
 
     PointStarRenderer();
-    void process(const Star &star, float distance, float appMag);
+    void process(const Star &star, float distance, float appMag) override;
+    void processBatch(const Star* firstStar,
+                      const unsigned int* indices,
+                      const float* distances,
+                      const float* appMags,
+                      unsigned int count) override;
 
     Eigen::Vector3d obsPos;
     Eigen::Vector3f viewNormal;
@@ -48,7 +113,17 @@ class PointStarRenderer : public ObjectRenderer<Star, float>
     PointStarVertexBuffer* starVertexBuffer     { nullptr };
     PointStarVertexBuffer* glareVertexBuffer    { nullptr };
     const StarDatabase* starDB                  { nullptr };
+    const StarCullingData* cullingData          { nullptr };
+    // Colors of the stars of the culling data
+    const Color* starColors                     { nullptr };
     const ColorTemperatureTable* colorTemp      { nullptr };
+    // Bodies hiding the stars beyond the solar system max distance
+    const SkyOccluders* occluders               { nullptr };
+    // When set, the glares are drawn by it rather than as sprites
+    celestia::render::StarBloom* bloom          { nullptr };
     float SolarSystemMaxDistance                { 1.0f };
     float cosFOV                                { 1.0f };
+    // When set, output is collected here instead of being sent to the
+    // vertex buffers and renderer.
+    PointStarBatch* batch                       { nullptr };
 };
@@ -23,7 +23,7 @@ PointStarVertexBuffer::PointStarVertexBuffer(const Renderer &renderer,
     m_renderer(renderer),
     m_capacity(capacity),
     m_vertices(std::make_unique<StarVertex[]>(capacity)),
-    m_vao(sizeof(StarVertex) * capacity, GL_STREAM_DRAW)
+    m_vao(renderer.getStreamBuffer())
 {
 }
 
@@ -49,9 +49,9 @@ void PointStarVertexBuffer::render()
         makeCurrent();
         if (m_texture != nullptr)
             m_texture->bind();
-        m_vao.allocate(nullptr); // orphan the buffer
-        m_vao.setBufferData(m_vertices.get(), 0, m_nStars * sizeof(StarVertex));
-        m_vao.draw(GL_POINTS, m_nStars);
+        GLint first = m_vao.stream(m_vertices.get(), m_nStars, sizeof(StarVertex));
+        if (first >= 0)
+            m_vao.draw(GL_POINTS, m_nStars, first);
         m_nStars = 0;
     }
 }
@@ -0,0 +1,119 @@
+// qualitygovernor.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Lowering the level of detail when frames take longer than a budget.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "qualitygovernor.h"
+
+#include <algorithm>
+
+QualityGovernor::QualityGovernor(double budget) :
+    budget(budget)
+{
+}
+
+
+void
+QualityGovernor::setBudget(double seconds)
+{
+    budget = seconds;
+    reset();
+}
+
+
+void
+QualityGovernor::reset()
+{
+    m_level = 0;
+    slowFrames = 0;
+    fastFrames = 0;
+    stillFrames = 0;
+}
+
+
+bool
+QualityGovernor::update(double cpuTime, double gpuTime, bool cameraMoving)
+{
+    int oldLevel = m_level;
+
+    stillFrames = cameraMoving ? 0 : std::min(stillFrames + 1, StillFrames);
+    if (stillFrames == StillFrames)
+    {
+        m_level = 0;
+        slowFrames = 0;
+        fastFrames = 0;
+        return m_level != oldLevel;
+    }
+
+    // The slower of the two limits the frame rate. The quality
+    // isn't lowered while the camera is still.
+    double frameTime = std::max(cpuTime, gpuTime);
+    if (frameTime > budget)
+    {
+        fastFrames = 0;
+        if (cameraMoving && ++slowFrames >= DegradeFrames)
+        {
+            m_level = std::min(m_level + 1, MaxLevel);
+            slowFrames = 0;
+        }
+    }
+    else if (frameTime < budget * RecoverFraction)
+    {
+        slowFrames = 0;
+        if (++fastFrames >= RecoverFrames)
+        {
+            m_level = std::max(m_level - 1, 0);
+            fastFrames = 0;
+        }
+    }
+    else
+    {
+        // Within the band between the two, the level is right
+        slowFrames = 0;
+        fastFrames = 0;
+    }
+
+    return m_level != oldLevel;
+}
+
+
+float
+QualityGovernor::starMagnitudeOffset() const
+{
+    return 0.5f * static_cast<float>(m_level);
+}
+
+
+float
+QualityGovernor::orbitSubdivisionScale() const
+{
+    return 1.0f + 0.5f * static_cast<float>(m_level);
+}
+
+
+float
+QualityGovernor::galaxyDetail() const
+{
+    return 1.0f / static_cast<float>(1 << m_level);
+}
+
+
+int
+QualityGovernor::sphereLODBias() const
+{
+    return -((m_level + 1) / 2);
+}
+
+
+unsigned int
+QualityGovernor::shadowMapSize(unsigned int fullSize) const
+{
+    // Shadows are only coarsened once the cheaper settings aren't enough
+    return m_level < 3 ? fullSize : fullSize >> (m_level - 2);
+}
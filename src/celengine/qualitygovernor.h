@@ -0,0 +1,64 @@
+// qualitygovernor.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Lowering the level of detail when frames take longer than a budget.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+// Picks a quality level from the CPU and GPU times of the frames drawn.
+// Level 0 is full quality, each level above it draws less detail. The
+// level goes up after a few frames over the budget and comes down after
+// many frames well within it, so that it doesn't swing back and forth
+// between two levels. When the camera has been still for a while, full
+// quality is restored and kept whatever the frames take, as a slow frame
+// rate doesn't matter for a still view.
+class QualityGovernor
+{
+ public:
+    static constexpr int MaxLevel = 4;
+
+    // Frames over the budget before lowering the quality
+    static constexpr int DegradeFrames = 5;
+    // Frames within RecoverFraction of the budget before raising it again
+    static constexpr int RecoverFrames = 60;
+    static constexpr double RecoverFraction = 0.6;
+    // Frames without camera motion before restoring full quality
+    static constexpr int StillFrames = 10;
+
+    explicit QualityGovernor(double budget = 1.0 / 60.0);
+
+    double getBudget() const { return budget; }
+    void setBudget(double seconds);
+
+    // Account for a frame which took cpuTime seconds on the CPU and gpuTime
+    // on the GPU, negative when it isn't known. Returns true if the level
+    // changed.
+    bool update(double cpuTime, double gpuTime, bool cameraMoving);
+    void reset();
+
+    int level() const { return m_level; }
+
+    // Magnitudes subtracted from the limiting magnitude of the stars
+    float starMagnitudeOffset() const;
+    // Factor of the pixel size under which orbit paths are subdivided
+    float orbitSubdivisionScale() const;
+    // Fraction of the blobs of galaxies drawn
+    float galaxyDetail() const;
+    // Added to the level of detail of spheres, zero or negative
+    int sphereLODBias() const;
+    // Shadow map size to use instead of a full quality one
+    unsigned int shadowMapSize(unsigned int fullSize) const;
+
+ private:
+    double budget;
+    int m_level{ 0 };
+    int slowFrames{ 0 };
+    int fastFrames{ 0 };
+    int stillFrames{ 0 };
+};
@@ -11,6 +11,7 @@
 #include <algorithm>
 #include <cstddef>
 
+#include <celrender/renderstats.h>
 #include <celutil/color.h>
 #include "atmosphere.h"
 #include "body.h"
@@ -45,6 +46,9 @@ constexpr GLenum GLComponentTypes[static_cast<std::size_t>(cmod::VertexAttribute
      GL_FLOAT,          // Float3
      GL_FLOAT,          // Float4,
      GL_UNSIGNED_BYTE,  // UByte4
+     GL_SHORT,          // Short4
+     GL_HALF_FLOAT,     // Half2
+     GL_SHORT,          // Octahedral
 };
 
 constexpr int GLComponentCounts[static_cast<std::size_t>(cmod::VertexAttributeFormat::FormatMax)] =
@@ -54,6 +58,9 @@ constexpr int GLComponentCounts[static_cast<std::size_t>(cmod::VertexAttributeFo
      3,  // Float3
      4,  // Float4,
      4,  // UByte4
+     4,  // Short4
+     2,  // Half2
+     2,  // Octahedral
 };
 
 
@@ -66,17 +73,27 @@ setStandardVertexArrays(const cmod::VertexDescription& desc,
     const cmod::VertexAttribute& color0    = desc.getAttribute(cmod::VertexAttributeSemantic::Color0);
     const cmod::VertexAttribute& texCoord0 = desc.getAttribute(cmod::VertexAttributeSemantic::Texture0);
 
-    // Can't render anything unless we have positions
-    if (position.format != cmod::VertexAttributeFormat::Float3)
+    // Can't render anything unless we have positions. Short4 positions
+    // are in [-1, 1] and w = 1; the mesh transform maps them to the model.
+    switch (position.format)
+    {
+    case cmod::VertexAttributeFormat::Float3:
+        glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+        glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
+                              3, GL_FLOAT, GL_FALSE, desc.strideBytes,
+                              vertexData + position.offsetWords);
+        break;
+    case cmod::VertexAttributeFormat::Short4:
+        glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+        glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
+                              4, GL_SHORT, GL_TRUE, desc.strideBytes,
+                              vertexData + position.offsetWords);
+        break;
+    default:
         return;
+    }
 
-    // Set up the vertex arrays
-    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
-                          3, GL_FLOAT, GL_FALSE, desc.strideBytes,
-                          vertexData + position.offsetWords);
-
-    // Set up the normal array
+    // Set up the normal array; octahedral normals are decoded by the shader
     switch (normal.format)
     {
     case cmod::VertexAttributeFormat::Float3:
@@ -86,6 +103,18 @@ setStandardVertexArrays(const cmod::VertexDescription& desc,
                               GL_FALSE, desc.strideBytes,
                               vertexData + normal.offsetWords);
         break;
+    case cmod::VertexAttributeFormat::Short4:
+        glEnableVertexAttribArray(CelestiaGLProgram::NormalAttributeIndex);
+        glVertexAttribPointer(CelestiaGLProgram::NormalAttributeIndex,
+                              3, GL_SHORT, GL_TRUE, desc.strideBytes,
+                              vertexData + normal.offsetWords);
+        break;
+    case cmod::VertexAttributeFormat::Octahedral:
+        glEnableVertexAttribArray(CelestiaGLProgram::NormalAttributeIndex);
+        glVertexAttribPointer(CelestiaGLProgram::NormalAttributeIndex,
+                              2, GL_SHORT, GL_TRUE, desc.strideBytes,
+                              vertexData + normal.offsetWords);
+        break;
     default:
         glDisableVertexAttribArray(CelestiaGLProgram::NormalAttributeIndex);
         break;
@@ -118,6 +147,7 @@ setStandardVertexArrays(const cmod::VertexDescription& desc,
     case cmod::VertexAttributeFormat::Float2:
     case cmod::VertexAttributeFormat::Float3:
     case cmod::VertexAttributeFormat::Float4:
+    case cmod::VertexAttributeFormat::Half2:
         glEnableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
         glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex,
                               GLComponentCounts[static_cast<std::size_t>(texCoord0.format)],
@@ -149,6 +179,13 @@ setExtendedVertexArrays(const cmod::VertexDescription& desc,
                                       desc.strideBytes,
                                       vertexData + tangent.offsetWords);
         break;
+    case cmod::VertexAttributeFormat::Short4:
+        glEnableVertexAttribArray(CelestiaGLProgram::TangentAttributeIndex);
+        glVertexAttribPointer(CelestiaGLProgram::TangentAttributeIndex,
+                                      3, GL_SHORT, GL_TRUE,
+                                      desc.strideBytes,
+                                      vertexData + tangent.offsetWords);
+        break;
     default:
         glDisableVertexAttribArray(CelestiaGLProgram::TangentAttributeIndex);
         break;
@@ -243,6 +280,20 @@ RenderContext::getPointScale() const
 }
 
 
+void
+RenderContext::setPixelsPerUnit(float _pixelsPerUnit)
+{
+    pixelsPerUnit = _pixelsPerUnit;
+}
+
+
+float
+RenderContext::getPixelsPerUnit() const
+{
+    return pixelsPerUnit;
+}
+
+
 void
 RenderContext::setCameraOrientation(const Eigen::Quaternionf& q)
 {
@@ -257,6 +308,43 @@ RenderContext::getCameraOrientation() const
 }
 
 
+void
+RenderContext::setInstanceCount(int _instanceCount)
+{
+    instanceCount = _instanceCount;
+}
+
+
+int
+RenderContext::getInstanceCount() const
+{
+    return instanceCount;
+}
+
+
+void
+RenderContext::setMeshTransform(const Eigen::Matrix4f* transform)
+{
+    if (transform == nullptr && !animatedMesh)
+        return;
+
+    animatedMesh = transform != nullptr;
+    if (animatedMesh)
+        meshTransform = *transform;
+
+    // The shader and the transform uniform are set up by makeCurrent()
+    if (getMaterial() != nullptr)
+        makeCurrent(*getMaterial());
+}
+
+
+const Eigen::Matrix4f*
+RenderContext::getMeshTransform() const
+{
+    return animatedMesh ? &meshTransform : nullptr;
+}
+
+
 void
 RenderContext::drawGroup(const cmod::PrimitiveGroup& group)
 {
@@ -282,10 +370,24 @@ RenderContext::drawGroup(const cmod::PrimitiveGroup& group)
         glActiveTexture(GL_TEXTURE0);
     }
 
-    glDrawElements(GLPrimitiveModes[static_cast<int>(group.prim)],
-                   group.indicesCount,
-                   GL_UNSIGNED_INT,
-                   reinterpret_cast<void*>(group.indicesOffset*sizeof(GLuint))); //NOSONAR
+    if (instanceCount > 0)
+    {
+        glDrawElementsInstanced(GLPrimitiveModes[static_cast<int>(group.prim)],
+                                group.indicesCount,
+                                GL_UNSIGNED_INT,
+                                reinterpret_cast<void*>(group.indicesOffset*sizeof(GLuint)), //NOSONAR
+                                instanceCount);
+    }
+    else
+    {
+        glDrawElements(GLPrimitiveModes[static_cast<int>(group.prim)],
+                       group.indicesCount,
+                       GL_UNSIGNED_INT,
+                       reinterpret_cast<void*>(group.indicesOffset*sizeof(GLuint))); //NOSONAR
+    }
+    celestia::render::countDrawCall(GLPrimitiveModes[static_cast<int>(group.prim)],
+                                    group.indicesCount,
+                                    std::max(instanceCount, 1));
 #ifndef GL_ES
     if (drawPoints)
     {
@@ -313,8 +415,11 @@ RenderContext::updateShader(const cmod::VertexDescription& desc, cmod::Primitive
     // or disappear in the new set of vertex arrays.
     bool usePointSizeNow = (desc.getAttribute(cmod::VertexAttributeSemantic::PointSize).format
                             == cmod::VertexAttributeFormat::Float1);
-    bool useNormalsNow = (desc.getAttribute(cmod::VertexAttributeSemantic::Normal).format
-                          == cmod::VertexAttributeFormat::Float3);
+    cmod::VertexAttributeFormat normalFormat = desc.getAttribute(cmod::VertexAttributeSemantic::Normal).format;
+    bool useNormalsNow = (normalFormat == cmod::VertexAttributeFormat::Float3 ||
+                          normalFormat == cmod::VertexAttributeFormat::Short4 ||
+                          normalFormat == cmod::VertexAttributeFormat::Octahedral);
+    bool useOctahedralNormalsNow = (normalFormat == cmod::VertexAttributeFormat::Octahedral);
     bool useColorsNow = (desc.getAttribute(cmod::VertexAttributeSemantic::Color0).format
                          != cmod::VertexAttributeFormat::InvalidFormat);
     bool useTexCoordsNow = (desc.getAttribute(cmod::VertexAttributeSemantic::Texture0).format
@@ -324,12 +429,14 @@ RenderContext::updateShader(const cmod::VertexDescription& desc, cmod::Primitive
     if (usePointSizeNow         != usePointSize       ||
         useStaticPointSizeNow   != useStaticPointSize ||
         useNormalsNow           != useNormals         ||
+        useOctahedralNormalsNow != useOctahedralNormals ||
         useColorsNow            != useColors          ||
         useTexCoordsNow         != useTexCoords)
     {
         usePointSize = usePointSizeNow;
         useStaticPointSize = useStaticPointSizeNow;
         useNormals = useNormalsNow;
+        useOctahedralNormals = useOctahedralNormalsNow;
         useColors = useColorsNow;
         useTexCoords = useTexCoordsNow;
         if (getMaterial() != nullptr)
@@ -395,18 +502,10 @@ GLSL_RenderContext::initLightingEnvironment()
     shaderProps.nLights = std::min(lightingState.nLights, MaxShaderLights);
 
     // Set the shadow information.
-    // Track the total number of shadows; if there are too many, we'll have
-    // to fall back to multipass.
-    unsigned int totalShadows = 0;
     for (unsigned int li = 0; li < lightingState.nLights; li++)
     {
-        if (lightingState.shadows[li] && !lightingState.shadows[li]->empty())
-        {
-            unsigned int nShadows = static_cast<unsigned int>(std::min(static_cast<std::size_t>(MaxShaderEclipseShadows),
-                                                                       lightingState.shadows[li]->size()));
-            shaderProps.setEclipseShadowCountForLight(li, nShadows);
-            totalShadows += nShadows;
-        }
+        if (lightingState.shadows[li] != nullptr)
+            shaderProps.setEclipseShadowsForLight(li, lightingState.shadows[li]->size());
     }
 
 }
@@ -564,6 +663,19 @@ GLSL_RenderContext::makeCurrent(const cmod::Material& m)
     if (hasShadowMap)
         shaderProps.texUsage |= ShaderProperties::ShadowMapTexture;
 
+    bool hasCascadeShadowMap = hasShadowMap && cascadeShadowMap != 0 && cascadeShadowMapWidth != 0 && cascadeLightMatrix != nullptr;
+    if (hasCascadeShadowMap)
+        shaderProps.texUsage |= ShaderProperties::ShadowMapCascade;
+
+    if (getInstanceCount() > 0)
+        shaderProps.texUsage |= ShaderProperties::InstancedTransforms;
+
+    if (getMeshTransform() != nullptr)
+        shaderProps.texUsage |= ShaderProperties::MeshTransform;
+
+    if (useNormals && useOctahedralNormals)
+        shaderProps.texUsage |= ShaderProperties::OctahedralNormals;
+
     // Get a shader for the current rendering configuration
     assert(renderer != nullptr);
     CelestiaGLProgram* prog = renderer->getShaderManager().getShader(shaderProps);
@@ -572,6 +684,8 @@ GLSL_RenderContext::makeCurrent(const cmod::Material& m)
 
     prog->use();
     prog->setMVPMatrices(*projectionMatrix, *modelViewMatrix);
+    if (getMeshTransform() != nullptr)
+        prog->MeshMatrix = *getMeshTransform();
 
     for (unsigned int i = 0; i < nTextures; i++)
     {
@@ -591,6 +705,17 @@ GLSL_RenderContext::makeCurrent(const cmod::Material& m)
         shadowBias.col(3) = Eigen::Vector4f(0.5f, 0.5f, 0.5f, 1.0f);
         prog->ShadowMatrix0 = shadowBias * (*lightMatrix);
         prog->floatParam("shadowMapSize") = static_cast<float>(shadowMapWidth);
+
+        if (hasCascadeShadowMap)
+        {
+            glActiveTexture(GL_TEXTURE0 + nTextures + 1);
+            glBindTexture(GL_TEXTURE_2D, cascadeShadowMap);
+#if GL_ONLY_SHADOWS
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE);
+#endif
+            prog->ShadowMatrix1 = shadowBias * (*cascadeLightMatrix);
+            prog->floatParam("shadowMapSize1") = static_cast<float>(cascadeShadowMapWidth);
+        }
     }
 
     // setLightParameters() expects opacity in the alpha channel of the diffuse color
@@ -712,6 +837,14 @@ GLSL_RenderContext::setShadowMap(GLuint _shadowMap, GLuint _width, const Eigen::
     lightMatrix    = _lightMatrix;
 }
 
+void
+GLSL_RenderContext::setCascadeShadowMap(GLuint _shadowMap, GLuint _width, const Eigen::Matrix4f *_lightMatrix)
+{
+    cascadeShadowMap      = _shadowMap;
+    cascadeShadowMapWidth = _width;
+    cascadeLightMatrix    = _lightMatrix;
+}
+
 /***** GLSL-Unlit render context ******/
 
 GLSLUnlit_RenderContext::GLSLUnlit_RenderContext(Renderer* renderer,
@@ -779,6 +912,9 @@ GLSLUnlit_RenderContext::makeCurrent(const cmod::Material& m)
     if (useColors)
         shaderProps.texUsage |= ShaderProperties::VertexColors;
 
+    if (getMeshTransform() != nullptr)
+        shaderProps.texUsage |= ShaderProperties::MeshTransform;
+
     // Get a shader for the current rendering configuration
     assert(renderer != nullptr);
     CelestiaGLProgram* prog = renderer->getShaderManager().getShader(shaderProps);
@@ -787,6 +923,8 @@ GLSLUnlit_RenderContext::makeCurrent(const cmod::Material& m)
 
     prog->use();
     prog->setMVPMatrices(*projectionMatrix, *modelViewMatrix);
+    if (getMeshTransform() != nullptr)
+        prog->MeshMatrix = *getMeshTransform();
 
     for (unsigned int i = 0; i < nTextures; i++)
     {
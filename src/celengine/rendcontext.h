@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <limits>
+
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
@@ -56,14 +58,30 @@ class RenderContext
     void setPointScale(float);
     float getPointScale() const;
 
+    // Size on screen of one unit of the geometry in pixels, for choosing a
+    // level of detail. Without one the full detail is drawn.
+    void setPixelsPerUnit(float);
+    float getPixelsPerUnit() const;
+
     void setCameraOrientation(const Eigen::Quaternionf& q);
     Eigen::Quaternionf getCameraOrientation() const;
 
+    // Number of instances drawn by each draw call, placed by the instance
+    // attributes set up by the caller; zero for a single object.
+    void setInstanceCount(int);
+    int getInstanceCount() const;
+
+    // Transform of the mesh drawn next within its model, taken from the
+    // mesh's transform track; nullptr for a static mesh.
+    void setMeshTransform(const Eigen::Matrix4f*);
+    const Eigen::Matrix4f* getMeshTransform() const;
+
  protected:
     Renderer* renderer { nullptr };
     bool usePointSize{ false };
     bool useStaticPointSize{ false };
     bool useNormals{ true };
+    bool useOctahedralNormals{ false };
     bool useColors{ false };
     bool useTexCoords{ true };
 
@@ -72,6 +90,10 @@ class RenderContext
     bool locked{ false };
     RenderPass renderPass{ PrimaryPass };
     float pointScale{ 1.0f };
+    float pixelsPerUnit{ std::numeric_limits<float>::max() };
+    int instanceCount{ 0 };
+    bool animatedMesh{ false };
+    Eigen::Matrix4f meshTransform{ Eigen::Matrix4f::Identity() };
     Eigen::Quaternionf cameraOrientation;  // required for drawing billboards
 };
 
@@ -110,6 +132,8 @@ class GLSL_RenderContext : public RenderContext
     void setLunarLambert(float);
     void setAtmosphere(const Atmosphere*);
     void setShadowMap(GLuint, GLuint, const Eigen::Matrix4f*);
+    // The finer map used where it covers the model
+    void setCascadeShadowMap(GLuint, GLuint, const Eigen::Matrix4f*);
 
  private:
     void initLightingEnvironment();
@@ -132,6 +156,9 @@ class GLSL_RenderContext : public RenderContext
     const Eigen::Matrix4f *lightMatrix { nullptr };
     GLuint shadowMap { 0 };
     GLuint shadowMapWidth { 0 };
+    const Eigen::Matrix4f *cascadeLightMatrix { nullptr };
+    GLuint cascadeShadowMap { 0 };
+    GLuint cascadeShadowMapWidth { 0 };
 };
 
 
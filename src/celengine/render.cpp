@@ -22,19 +22,26 @@
 #include "render.h"
 #include "boundaries.h"
 #include "dsorenderer.h"
+#include "galaxy.h"
+#include "globular.h"
 #include "asterism.h"
 #include "astro.h"
 #include "glshader.h"
 #include "shadermanager.h"
 #include "spheremesh.h"
 #include "lodspheremesh.h"
+#include "terrainmesh.h"
 #include "geometry.h"
 #include "texmanager.h"
+#include "virtualtex.h"
 #include "meshmanager.h"
+#include "trajmanager.h"
 #include "renderinfo.h"
 #include "renderglsl.h"
 #include "axisarrow.h"
+#include "bodystatecache.h"
 #include "frametree.h"
+#include "gputimer.h"
 #include "timelinephase.h"
 #include "skygrid.h"
 #include "modelgeometry.h"
@@ -43,8 +50,17 @@
 #include "rectangle.h"
 #include "framebuffer.h"
 #include "planetgrid.h"
+#include "visibleregion.h"
+#include "largepointbuffer.h"
+#include "lazybodycatalog.h"
+#include "locationindex.h"
 #include "pointstarvertexbuffer.h"
+#include "pagedstarcatalog.h"
 #include "pointstarrenderer.h"
+#include "starvisibilitycache.h"
+#include "occluderindex.h"
+#include "asyncorbitsampler.h"
+#include "minorbodybvh.h"
 #include "orbitsampler.h"
 #include "rendcontext.h"
 #include "textlayout.h"
@@ -59,20 +75,34 @@
 #include <celrender/boundariesrenderer.h>
 #include <celrender/cometrenderer.h>
 #include <celrender/eclipticlinerenderer.h>
+#include <celrender/floatdepthtarget.h>
+#include <celrender/frameprofiler.h>
+#include <celrender/gpustarrenderer.h>
 #include <celrender/linerenderer.h>
+#include <celrender/pickrenderer.h>
+#include <celrender/renderstats.h>
+#include <celrender/starbloom.h>
+#include <celrender/streambuffer.h>
+#include <celrender/texturememory.h>
 #include <celrender/vertexobject.h>
 #include <celutil/arrayvector.h>
+#include <celutil/fsutils.h>
+#include <celutil/jobsystem.h>
 #include <celutil/logger.h>
+#include <celutil/memoryreport.h>
 #include <celutil/utf8.h>
 #include <celutil/timer.h>
 #include <celttf/truetypefont.h>
 #include "glsupport.h"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstring>
 #include <cassert>
 #include <sstream>
 #include <iomanip>
 #include <numeric>
+#include <thread>
 #ifdef _MSC_VER
 #include <malloc.h>
 #ifndef alloca
@@ -91,7 +121,15 @@ using celestia::render::AtmosphereRenderer;
 using celestia::render::BoundariesRenderer;
 using celestia::render::CometRenderer;
 using celestia::render::EclipticLineRenderer;
+using celestia::render::FloatDepthTarget;
+using celestia::render::FrameProfiler;
+using celestia::render::GPUStarRenderer;
 using celestia::render::LineRenderer;
+using celestia::render::PickRenderer;
+using celestia::render::ProfilePass;
+using celestia::render::ProfileScope;
+using celestia::render::StarBloom;
+using celestia::render::StreamBuffer;
 using celestia::render::VertexObject;
 
 #define FOV           45.0f
@@ -121,6 +159,26 @@ static const float MaxFarNearRatio      = 2000000.0f;
 
 static const float MinRelativeOccluderRadius = 0.005f;
 
+// Time spent each frame on creating the textures decoded in the background
+static const std::chrono::steady_clock::duration TextureUploadBudget = std::chrono::milliseconds(4);
+
+// Time spent each frame on creating the buffers of the models loaded in the
+// background
+static const std::chrono::steady_clock::duration ModelUploadBudget = std::chrono::milliseconds(4);
+
+// Frames a texture must go undrawn before it's unloaded to keep within the
+// texture memory budget, and frames over budget before the texture
+// resolution is lowered
+static const unsigned int TextureIdleFrames = 120;
+
+// Size of the ring buffer the points and stars drawn each frame are
+// streamed through
+static const GLsizeiptr StreamBufferSize = 4 * 1024 * 1024;
+
+// The minimum apparent size of a body in pixels before the stars and deep
+// sky objects behind it are culled
+static const float MinSkyOccluderSize = 32.0f;
+
 // The minimum apparent size of an objects orbit in pixels before we display
 // a label for it.  This minimizes label clutter.
 static const float MinOrbitSizeForLabel = 20.0f;
@@ -129,6 +187,10 @@ static const float MinOrbitSizeForLabel = 20.0f;
 // a label for it.
 static const float MinFeatureSizeForLabel = 20.0f;
 
+// The maximum number of surface features labeled on a body; the most
+// important ones are kept.
+static const std::size_t MaxLocationLabels = 250;
+
 /* The maximum distance of the observer to the origin of coordinates before
    asterism lines and labels start to linearly fade out (in light years) */
 static const float MaxAsterismLabelsConstDist  = 6.0f;
@@ -145,6 +207,7 @@ static bool commonDataInitialized = false;
 
 
 LODSphereMesh* g_lodSphere = nullptr;
+TerrainMesh* g_terrainMesh = nullptr;
 
 static Texture* gaussianDiscTex = nullptr;
 static Texture* gaussianGlareTex = nullptr;
@@ -159,6 +222,13 @@ static const int MinSkySlices = 30;
 static const unsigned int OrbitCacheCullThreshold = 200;
 // Age in frames at which unused orbit paths may be eliminated from the cache
 static const uint32_t OrbitCacheRetireAge = 16;
+// Number of segments of the outline drawn while an orbit is sampled in the
+// background
+static const int CoarseOrbitSegments = 32;
+
+// Smallest number of bodies in a solar system for it to be traversed by
+// several threads when building the render list
+static const unsigned int MinParallelRenderListBodies = 64;
 
 Color Renderer::StarLabelColor          (0.471f, 0.356f, 0.682f);
 Color Renderer::PlanetLabelColor        (0.407f, 0.333f, 0.964f);
@@ -274,9 +344,20 @@ Renderer::Renderer() :
     colorTemp(nullptr),
     settingsChanged(true),
     objectAnnotationSetOpen(false),
+    m_shadowMapCache(std::make_unique<ShadowMapCache>(2)),
+    m_shadowMaps(2),
     m_atmosphereRenderer(std::make_unique<AtmosphereRenderer>(*this)),
     m_cometRenderer(std::make_unique<CometRenderer>(*this)),
-    m_eclipticLineRenderer(std::make_unique<EclipticLineRenderer>(*this))
+    m_eclipticLineRenderer(std::make_unique<EclipticLineRenderer>(*this)),
+    m_profiler(std::make_unique<FrameProfiler>()),
+    m_gpuStarRenderer(std::make_unique<GPUStarRenderer>(*this)),
+    m_pickRenderer(std::make_unique<PickRenderer>(*this)),
+    m_streamBuffer(std::make_unique<StreamBuffer>(StreamBufferSize)),
+    m_starVisibilityCache(std::make_unique<StarVisibilityCache>()),
+    m_starColorCache(std::make_unique<StarColorCache>()),
+    m_occluderIndex(std::make_unique<OccluderIndex>()),
+    m_largePointBuffer(std::make_unique<LargePointBuffer>(*this, 256)),
+    m_largeGlareBuffer(std::make_unique<LargePointBuffer>(*this, 256))
 {
     pointStarVertexBuffer = new PointStarVertexBuffer(*this, 2048);
     glareVertexBuffer = new PointStarVertexBuffer(*this, 2048);
@@ -288,6 +369,8 @@ Renderer::Renderer() :
     }
     shaderManager = new ShaderManager();
     m_VertexObjects.fill(nullptr);
+    for (auto& grid : m_skyGrids)
+        grid = std::make_unique<SkyGrid>();
 }
 
 
@@ -305,6 +388,8 @@ Renderer::~Renderer()
     CurvePlot::deinit();
     PlanetographicGrid::deinit();
     SkyGrid::deinit();
+    AxesReferenceMark::deinit();
+    VisibleRegion::deinit();
 }
 
 
@@ -314,7 +399,34 @@ Renderer::DetailOptions::DetailOptions() :
     eclipseTextureSize(128),
     orbitWindowEnd(0.5),
     orbitPeriodsShown(1.0),
-    linearFadeFraction(0.0)
+    linearFadeFraction(0.0),
+    starRenderThreads(1),
+    dsoRenderThreads(1),
+    orbitSamplingThreads(1),
+    renderListThreads(1),
+    textureLoadingThreads(0),
+    modelLoadingThreads(0),
+    virtualTextureMemoryBudget(std::size_t(512) << 20),
+    tileCacheSize(std::uintmax_t(1024) << 20),
+    textureMemoryBudget(0),
+    autoTextureResolution(false),
+    gpuStarCatalog(false),
+    shaderCache(true),
+    shaderWarmUp(false),
+    asyncShaderCompile(false),
+    compressTextures(false),
+    staticSphereMeshes(false),
+    optimizeModels(false),
+    modelLevelsOfDetail(false),
+    frameTimeBudget(0.0),
+    declutterLabels(false),
+    distanceFieldFonts(false),
+    shadowMapCacheSize(0),
+    shadowCascadeSize(0),
+    ringShadowTextureSize(0),
+    gpuPicking(false),
+    reverseDepth(false),
+    starBloom(false)
 {
 }
 
@@ -544,6 +656,34 @@ bool Renderer::init(int winWidth, int winHeight, DetailOptions& _detailOptions)
 {
     detailOptions = _detailOptions;
 
+    if (detailOptions.orbitSamplingThreads > 0)
+        orbitSampler = std::make_unique<AsyncOrbitSampler>(detailOptions.orbitSamplingThreads);
+    GetTextureManager()->enableAsyncLoading(detailOptions.textureLoadingThreads);
+    VirtualTexture::setMemoryBudget(detailOptions.virtualTextureMemoryBudget);
+#ifndef PORTABLE_BUILD
+    VirtualTexture::setTileCache(util::WriteableDataPath() / "cache" / "tiles", detailOptions.tileCacheSize);
+#endif
+    VirtualTexture::setLoadingThreads(detailOptions.textureLoadingThreads);
+    MultiResTexture::setAutoResolution(detailOptions.autoTextureResolution);
+    TextureInfo::setCompressAll(detailOptions.compressTextures);
+    GeometryInfo::setOptimizeModels(detailOptions.optimizeModels);
+    GeometryInfo::setLevelsOfDetail(detailOptions.modelLevelsOfDetail);
+    TextureFont::setDistanceFields(detailOptions.distanceFieldFonts);
+    GetGeometryManager()->enableAsyncLoading(detailOptions.modelLoadingThreads);
+
+    // Each model may need maps for both cascades
+    std::size_t shadowMapCount = std::max(detailOptions.shadowMapCacheSize, 2u);
+    m_shadowMapCache = std::make_unique<ShadowMapCache>(shadowMapCount);
+    m_shadowMaps = std::vector<ShadowMap>(shadowMapCount);
+
+    shaderManager->setAsyncCompile(detailOptions.asyncShaderCompile);
+#ifndef PORTABLE_BUILD
+    if (detailOptions.shaderCache)
+        shaderManager->enableProgramCache(util::WriteableDataPath() / "cache" / "shaders");
+    if (detailOptions.shaderWarmUp)
+        shaderManager->warmUp();
+#endif
+
     m_atmosphereRenderer->initGL();
     m_cometRenderer->initGL();
 
@@ -551,12 +691,21 @@ bool Renderer::init(int winWidth, int winHeight, DetailOptions& _detailOptions)
     if (!commonDataInitialized)
     {
         g_lodSphere = new LODSphereMesh();
+        g_terrainMesh = new TerrainMesh();
 
         gaussianDiscTex = BuildGaussianDiscTexture(8);
         gaussianGlareTex = BuildGaussianGlareTexture(9);
 
         commonDataInitialized = true;
     }
+    g_lodSphere->setStaticPatches(detailOptions.staticSphereMeshes);
+
+    if (detailOptions.frameTimeBudget > 0.0)
+    {
+        qualityGovernor.setBudget(detailOptions.frameTimeBudget);
+        if (GPUTimer::isSupported())
+            gpuTimer = std::make_unique<GPUTimer>();
+    }
 
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
@@ -633,6 +782,11 @@ float Renderer::getPointHeight() const
     return 2.0f / windowHeight * getScaleFactor();
 }
 
+float Renderer::getPixelSize() const
+{
+    return pixelSize;
+}
+
 void Renderer::setFaintestAM45deg(float _faintestAutoMag45deg)
 {
     faintestAutoMag45deg = _faintestAutoMag45deg;
@@ -705,6 +859,7 @@ void Renderer::setRenderFlags(uint64_t _renderFlags)
 {
     renderFlags = _renderFlags;
     updateBodyVisibilityMask();
+    m_starVisibilityCache->invalidate();
     markSettingsChanged();
 }
 
@@ -870,15 +1025,28 @@ void Renderer::getLabelAlignmentInfo(const Annotation &annotation, const Texture
     }
 }
 
+std::string_view Renderer::copyToFrameArena(std::string_view text)
+{
+    if (text.empty())
+        return {};
+
+    auto* data = static_cast<char*>(m_frameArena.allocate(text.size(), 1));
+    std::copy(text.begin(), text.end(), data);
+    celestia::render::frameStats.arenaBytes += static_cast<unsigned long>(text.size());
+    return { data, text.size() };
+}
+
 void Renderer::addAnnotation(vector<Annotation>& annotations,
                              const celestia::MarkerRepresentation* markerRep,
-                             const string& labelText,
+                             std::string_view labelText,
+                             const LabelCache::Label* label,
                              Color color,
                              const Vector3f& pos,
                              LabelHorizontalAlignment halign,
                              LabelVerticalAlignment valign,
                              float size,
-                             bool special)
+                             bool special,
+                             float priority)
 {
     GLint view[4] = { 0, 0, windowWidth, windowHeight };
     Vector3f win;
@@ -899,51 +1067,80 @@ void Renderer::addAnnotation(vector<Annotation>& annotations,
 
         Annotation a;
         if (!special || markerRep == nullptr)
-             a.labelText = labelText;
+        {
+            a.labelText = copyToFrameArena(labelText);
+            a.label = label;
+        }
         a.markerRep = markerRep;
         a.color = color;
         a.position = win;
         a.halign = halign;
         a.valign = valign;
         a.size = size;
+        a.priority = priority;
         annotations.push_back(a);
     }
 }
 
 
 void Renderer::addForegroundAnnotation(const celestia::MarkerRepresentation* markerRep,
-                                       const string& labelText,
+                                       std::string_view labelText,
                                        Color color,
                                        const Vector3f& pos,
                                        LabelHorizontalAlignment halign,
                                        LabelVerticalAlignment valign,
                                        float size)
 {
-    addAnnotation(foregroundAnnotations, markerRep, labelText, color, pos, halign, valign, size);
+    addAnnotation(foregroundAnnotations, markerRep, labelText, nullptr, color, pos, halign, valign, size);
 }
 
 
 void Renderer::addBackgroundAnnotation(const celestia::MarkerRepresentation* markerRep,
-                                       const string& labelText,
+                                       std::string_view labelText,
                                        Color color,
                                        const Vector3f& pos,
                                        LabelHorizontalAlignment halign,
                                        LabelVerticalAlignment valign,
                                        float size)
 {
-    addAnnotation(backgroundAnnotations, markerRep, labelText, color, pos, halign, valign, size);
+    addAnnotation(backgroundAnnotations, markerRep, labelText, nullptr, color, pos, halign, valign, size);
+}
+
+
+void Renderer::addSortedAnnotation(const celestia::MarkerRepresentation* markerRep,
+                                   std::string_view labelText,
+                                   Color color,
+                                   const Vector3f& pos,
+                                   LabelHorizontalAlignment halign,
+                                   LabelVerticalAlignment valign,
+                                   float size)
+{
+    addAnnotation(depthSortedAnnotations, markerRep, labelText, nullptr, color, pos, halign, valign, size, true);
+}
+
+
+void Renderer::addBackgroundAnnotation(const celestia::MarkerRepresentation* markerRep,
+                                       const LabelCache::Label* label,
+                                       Color color,
+                                       const Vector3f& pos,
+                                       LabelHorizontalAlignment halign,
+                                       LabelVerticalAlignment valign,
+                                       float size,
+                                       float priority)
+{
+    addAnnotation(backgroundAnnotations, markerRep, {}, label, color, pos, halign, valign, size, false, priority);
 }
 
 
 void Renderer::addSortedAnnotation(const celestia::MarkerRepresentation* markerRep,
-                                   const string& labelText,
+                                   const LabelCache::Label* label,
                                    Color color,
                                    const Vector3f& pos,
                                    LabelHorizontalAlignment halign,
                                    LabelVerticalAlignment valign,
                                    float size)
 {
-    addAnnotation(depthSortedAnnotations, markerRep, labelText, color, pos, halign, valign, size, true);
+    addAnnotation(depthSortedAnnotations, markerRep, {}, label, color, pos, halign, valign, size, true);
 }
 
 
@@ -999,7 +1196,7 @@ void Renderer::endObjectAnnotations()
 
 
 void Renderer::addObjectAnnotation(const celestia::MarkerRepresentation* markerRep,
-                                   const string& labelText,
+                                   std::string_view labelText,
                                    Color color,
                                    const Vector3f& pos,
                                    LabelHorizontalAlignment halign,
@@ -1008,7 +1205,7 @@ void Renderer::addObjectAnnotation(const celestia::MarkerRepresentation* markerR
     assert(objectAnnotationSetOpen);
     if (objectAnnotationSetOpen)
     {
-        addAnnotation(objectAnnotations, markerRep, labelText, color, pos, halign, valign);
+        addAnnotation(objectAnnotations, markerRep, labelText, nullptr, color, pos, halign, valign);
     }
 }
 
@@ -1062,6 +1259,64 @@ Vector4f renderOrbitColor(const Body *body, bool selected, float opacity)
     return Vector4f(orbitColor.red(), orbitColor.green(), orbitColor.blue(), opacity * orbitColor.alpha());
 }
 
+// Replace the coarse outlines of the orbits sampled in the background
+void Renderer::updateOrbitCache()
+{
+    if (orbitSampler == nullptr)
+        return;
+
+    std::vector<AsyncOrbitSampler::Result> results;
+    orbitSampler->collect(results);
+    for (const auto& result : results)
+    {
+        // The orbit may have been retired from the cache in the meantime
+        if (pendingOrbits.erase(result.orbit) == 0)
+            continue;
+
+        auto cached = orbitCache.find(result.orbit);
+        if (cached == orbitCache.end())
+            continue;
+
+        auto plot = new CurvePlot(*this);
+        plot->setLastUsed(cached->second->lastUsed());
+        for (const auto& sample : result.samples)
+            plot->addSample(sample);
+
+        delete cached->second;
+        cached->second = plot;
+    }
+}
+
+// Keep the textures within the memory budget: unload those not drawn
+// lately, high resolution ones first. While that isn't enough, find lower
+// resolution textures so that the higher ones become unused.
+void Renderer::manageTextureMemory()
+{
+    TextureManager* textureManager = GetTextureManager();
+    textureManager->advanceUsage();
+    if (detailOptions.textureMemoryBudget == 0)
+        return;
+
+    std::size_t budget = detailOptions.textureMemoryBudget;
+    texturesEvicted += textureManager->evict(render::getTotalTextureMemory(), budget, TextureIdleFrames,
+                                             [](const Texture& tex) { return tex.getMemorySize(); },
+                                             [](const TextureInfo& info) { return info.getResolution(); });
+
+    std::size_t used = render::getTotalTextureMemory();
+    unsigned int maxResolution = MultiResTexture::getMaxResolution();
+    if (used <= budget)
+    {
+        framesOverTextureBudget = 0;
+        if (used <= budget / 2 && maxResolution < hires)
+            MultiResTexture::setMaxResolution(maxResolution + 1);
+    }
+    else if (++framesOverTextureBudget > TextureIdleFrames && maxResolution > lores)
+    {
+        MultiResTexture::setMaxResolution(maxResolution - 1);
+        framesOverTextureBudget = 0;
+    }
+}
+
 void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
                            double t,
                            const Quaterniond& cameraOrientation,
@@ -1075,6 +1330,51 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
 
     const auto* orbit = body != nullptr ? body->getOrbit(t) : orbitPath.star->getOrbit();
 
+    //*** Orbit rendering parameters
+
+    // The 'window' is the interval of time for which the orbit will be drawn.
+
+    // End of the orbit window relative to the current simulation time. Units
+    // are orbital periods. The default value is 0.5.
+    const double OrbitWindowEnd     = detailOptions.orbitWindowEnd;
+
+    // Number of orbit periods shown. The orbit window is:
+    //    [ t + (OrbitWindowEnd - OrbitPeriodsShown) * T, t + OrbitWindowEnd * T ]
+    // where t is the current simulation time and T is the orbital period.
+    // The default value is 1.0.
+    const double OrbitPeriodsShown  = detailOptions.orbitPeriodsShown;
+
+    // Fraction of the window over which the orbit fades from opaque to transparent.
+    // Fading is disabled when this value is zero.
+    // The default value is 0.0.
+    const double LinearFadeFraction = detailOptions.linearFadeFraction;
+
+    // Extra size of the internal sample cache.
+    const double WindowSlack        = 0.2;
+
+    //***
+
+    // Sample the orbit in the background, drawing a coarse outline of it
+    // until then. The orbits which look the largest are sampled first.
+    bool sampleInBackground = orbitSampler != nullptr && orbit->isThreadSafe();
+    auto periodicWindowEnd = [&]() { return t + orbit->getPeriod() * (OrbitWindowEnd + WindowSlack); };
+    auto periodicWindowStart = [&]() { return periodicWindowEnd() - orbit->getPeriod() * (OrbitPeriodsShown + 2.0 * WindowSlack); };
+    auto requestSamples = [&](CurvePlot* plot, double startTime, double endTime)
+    {
+        std::vector<double> times;
+        times.reserve(CoarseOrbitSegments + 1);
+        for (int i = 0; i <= CoarseOrbitSegments; i++)
+            times.push_back(startTime + (endTime - startTime) * i / CoarseOrbitSegments);
+
+        OrbitSampler coarseSampler;
+        orbit->sampleAtTimes(times, coarseSampler);
+        coarseSampler.insertForward(plot);
+
+        float priority = orbitPath.radius / max(std::abs(orbitPath.centerZ), orbitPath.radius);
+        orbitSampler->request(orbit, startTime, endTime, priority);
+        pendingOrbits.insert(orbit);
+    };
+
     CurvePlot* cachedOrbit = nullptr;
     OrbitCache::iterator cached = orbitCache.find(orbit);
     if (cached != orbitCache.end())
@@ -1087,38 +1387,18 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
     if (cachedOrbit == nullptr)
     {
         double startTime = t;
-#if 0
-        int nSamples = detailOptions.orbitPathSamplePoints;
-#endif
 
-        // Adjust the number of samples used for aperiodic orbits--these aren't
-        // true orbits, but are sampled trajectories, generally of spacecraft.
-        // Better control is really needed--some sort of adaptive sampling would
-        // be ideal.
+        // Aperiodic orbits aren't true orbits, but sampled trajectories,
+        // generally of spacecraft; they're drawn over their valid range if
+        // they have one. The number of samples is picked by the adaptive
+        // sampling of the orbit.
         if (!orbit->isPeriodic())
         {
             double begin = 0.0, end = 0.0;
             orbit->getValidRange(begin, end);
 
             if (begin != end)
-            {
                 startTime = begin;
-#if 0
-                nSamples = (int) (orbit->getPeriod() * 100.0);
-                nSamples = std::clamp(nSamples, 100, 1000);
-#endif
-            }
-#if 0
-            else
-            {
-                // If the orbit is aperiodic and doesn't have a
-                // finite duration, we don't render it. A compromise
-                // would be to pick some time window centered at the
-                // current time, but we'd have to pick some arbitrary
-                // duration.
-                nSamples = 0;
-            }
-#endif
         }
         else
         {
@@ -1128,11 +1408,21 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
         cachedOrbit = new CurvePlot(*this);
         cachedOrbit->setLastUsed(frameCount);
 
-        OrbitSampler sampler;
-        orbit->sample(startTime,
-                      startTime + orbit->getPeriod(),
-                      sampler);
-        sampler.insertForward(cachedOrbit);
+        if (sampleInBackground)
+        {
+            if (orbit->isPeriodic())
+                requestSamples(cachedOrbit, periodicWindowStart(), periodicWindowEnd());
+            else
+                requestSamples(cachedOrbit, startTime, startTime + orbit->getPeriod());
+        }
+        else
+        {
+            OrbitSampler sampler;
+            orbit->sample(startTime,
+                          startTime + orbit->getPeriod(),
+                          sampler);
+            sampler.insertForward(cachedOrbit);
+        }
 
         // If the orbit cache is full, first try and eliminate some old orbits
         if (orbitCache.size() > OrbitCacheCullThreshold)
@@ -1145,9 +1435,15 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
                     // Tricky code to eliminate a node in the orbit cache without screwing
                     // up the iterator. Should work in all STL implementations.
                     if (frameCount - iter->second->lastUsed() > OrbitCacheRetireAge)
+                    {
+                        pendingOrbits.erase(iter->first);
+                        delete iter->second;
                         orbitCache.erase(iter++);
+                    }
                     else
+                    {
                         ++iter;
+                    }
                 }
                 lastOrbitCacheFlush = frameCount;
             }
@@ -1159,34 +1455,11 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
     if (cachedOrbit->empty())
         return;
 
-    //*** Orbit rendering parameters
-
-    // The 'window' is the interval of time for which the orbit will be drawn.
-
-    // End of the orbit window relative to the current simulation time. Units
-    // are orbital periods. The default value is 0.5.
-    const double OrbitWindowEnd     = detailOptions.orbitWindowEnd;
-
-    // Number of orbit periods shown. The orbit window is:
-    //    [ t + (OrbitWindowEnd - OrbitPeriodsShown) * T, t + OrbitWindowEnd * T ]
-    // where t is the current simulation time and T is the orbital period.
-    // The default value is 1.0.
-    const double OrbitPeriodsShown  = detailOptions.orbitPeriodsShown;
-
-    // Fraction of the window over which the orbit fades from opaque to transparent.
-    // Fading is disabled when this value is zero.
-    // The default value is 0.0.
-    const double LinearFadeFraction = detailOptions.linearFadeFraction;
-
-    // Extra size of the internal sample cache.
-    const double WindowSlack        = 0.2;
-
-    //***
-
     // 'Periodic' orbits are generally not strictly periodic because of perturbations
     // from other bodies. Here we update the trajectory samples to make sure that the
     // orbit covers a time range centered at the current time and covering a full revolution.
-    if (orbit->isPeriodic())
+    // The coarse outlines are left alone until replaced by the background samples.
+    if (orbit->isPeriodic() && pendingOrbits.count(orbit) == 0)
     {
         double period = orbit->getPeriod();
         double endTime = t + period * OrbitWindowEnd;
@@ -1197,7 +1470,18 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
         double newWindowStart = startTime - period * WindowSlack;
         double newWindowEnd = endTime + period * WindowSlack;
 
-        if (startTime < currentWindowStart)
+        if (sampleInBackground && (startTime >= currentWindowEnd || endTime <= currentWindowStart))
+        {
+            // After a jump in time none of the samples can be reused; resample
+            // the whole window in the background.
+            auto plot = new CurvePlot(*this);
+            plot->setLastUsed(frameCount);
+            requestSamples(plot, newWindowStart, newWindowEnd);
+            delete cachedOrbit;
+            cachedOrbit = plot;
+            orbitCache[orbit] = plot;
+        }
+        else if (startTime < currentWindowStart)
         {
             // Remove samples at the end of the time window
             cachedOrbit->removeSamplesAfter(newWindowEnd);
@@ -1248,7 +1532,7 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
     glEnable(GL_LINE_STIPPLE);
 #endif
 
-    double subdivisionThreshold = pixelSize * 40.0;
+    double subdivisionThreshold = pixelSize * 40.0 * qualityGovernor.orbitSubdivisionScale();
 
     Eigen::Vector3d viewFrustumPlaneNormals[4];
     for (int i = 0; i < 4; i++)
@@ -1317,16 +1601,6 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
 }
 
 
-// Convert a position in the universal coordinate system to astrocentric
-// coordinates, taking into account possible orbital motion of the star.
-static Vector3d astrocentricPosition(const UniversalCoord& pos,
-                                     const Star& star,
-                                     double t)
-{
-    return pos.offsetFromKm(star.getPosition(t));
-}
-
-
 void Renderer::autoMag(float& faintestMag)
 {
     float fieldCorr;
@@ -1362,13 +1636,11 @@ static Color legacyTintColor(float temp)
 }
 
 
-// Set up the light sources for rendering a solar system.  The positions of
-// all nearby stars are converted from universal to viewer-centered
-// coordinates.
+// Set up the light sources for rendering a solar system from the nearby
+// stars and their viewer-centered positions.
 static void
 setupLightSources(const vector<const Star*>& nearStars,
-                  const UniversalCoord& observerPos,
-                  double t,
+                  const vector<Vector3d>& nearStarOffsets,
                   vector<LightSource>& lightSources,
                   float tintSaturation,
                   bool useBlackbodyColors)
@@ -1381,15 +1653,16 @@ setupLightSources(const vector<const Star*>& nearStars,
 
     lightSources.clear();
 
-    for (const auto star : nearStars)
+    for (std::size_t i = 0; i < nearStars.size(); i++)
     {
+        const Star* star = nearStars[i];
         if (star->getVisibility())
         {
-            Vector3d v = star->getPosition(t).offsetFromKm(observerPos);
             LightSource ls;
-            ls.position = v;
+            ls.position = nearStarOffsets[i];
             ls.luminosity = star->getLuminosity();
             ls.radius = star->getRadius();
+            ls.irradianceScale = 0.0f;
 
             float temp = star->getTemperature();
             if (temp <= DARK_POINT)
@@ -1416,6 +1689,7 @@ setupLightSources(const vector<const Star*>& nearStars,
                 ls.color = legacyTintColor(temp);
             }
 
+            ls.irradianceScale = ls.luminosity / square(astro::kilometersToAU(1.0f));
             lightSources.push_back(ls);
         }
     }
@@ -1440,10 +1714,34 @@ setupSecondaryLightSources(vector<SecondaryIlluminator>& secondaryIlluminators,
         }
 
         i.reflectedIrradiance *= i.body->getReflectivity();
+
+        float radius2 = square(i.radius);
+        i.minDistanceSquared = 0.01f * radius2;
+        i.irradianceScale = i.reflectedIrradiance * radius2;
+        i.color = i.body->getSurface().color;
     }
 }
 
 
+// Bodies drawn entirely with opaque geometry; atmospheres, clouds and rings
+// are blended.
+bool Renderer::isStateSortable(const RenderListEntry& rle)
+{
+    return rle.renderableType == RenderListEntry::RenderableBody &&
+           rle.body->getAtmosphere() == nullptr &&
+           rle.body->getRings() == nullptr;
+}
+
+
+// Entries with the same key share the model or the base texture
+std::pair<ResourceHandle, ResourceHandle>
+Renderer::getStateSortKey(const RenderListEntry& rle) const
+{
+    const Body& body = *rle.body;
+    return { body.getGeometry(), body.getSurface().baseTexture.tex[textureResolution] };
+}
+
+
 // Render an item from the render list
 void Renderer::renderItem(const RenderListEntry& rle,
                           const Observer& observer,
@@ -1476,10 +1774,8 @@ void Renderer::renderItem(const RenderListEntry& rle,
     case RenderListEntry::RenderableCometTail:
         renderCometTail(*rle.body,
                         rle.position,
-                        observer,
                         rle.radius,
-                        rle.discSizeInPixels,
-                        m);
+                        rle.discSizeInPixels);
         break;
 
     case RenderListEntry::RenderableReferenceMark:
@@ -1491,12 +1787,123 @@ void Renderer::renderItem(const RenderListEntry& rle,
                             m);
         break;
 
+    case RenderListEntry::RenderableLazyBody:
+        // The surface color of a body without a texture
+        renderObjectAsPoint(rle.position,
+                            rle.radius,
+                            rle.appMag,
+                            rle.discSizeInPixels,
+                            Color(1.0f, 1.0f, 1.0f),
+                            false, false);
+        break;
+
     default:
         break;
     }
 }
 
 
+void Renderer::beginFrame()
+{
+    startFrame();
+    inFrame = true;
+
+    if (detailOptions.frameTimeBudget > 0.0)
+    {
+        frameStartTime = std::chrono::steady_clock::now();
+        if (gpuTimer != nullptr)
+            gpuTimer->begin();
+    }
+}
+
+void Renderer::endFrame()
+{
+    inFrame = false;
+
+    if (detailOptions.frameTimeBudget <= 0.0)
+        return;
+
+    // The GPU time is that of an earlier frame, as the result of this one
+    // isn't available yet
+    double gpuTime = -1.0;
+    if (gpuTimer != nullptr)
+    {
+        gpuTimer->end();
+        gpuTime = gpuTimer->latest();
+    }
+    std::chrono::duration<double> cpuTime = std::chrono::steady_clock::now() - frameStartTime;
+
+    // Views which were not drawn this time count as a camera motion
+    cameraMoved = cameraMoved || frameCameraIndex != frameCameras.size();
+    frameCameras.erase(frameCameras.begin() + frameCameraIndex, frameCameras.end());
+
+    if (qualityGovernor.update(cpuTime.count(), gpuTime, cameraMoved))
+        applyQualityLevel();
+}
+
+bool Renderer::requestPick(const Eigen::Vector3f& pickRay, float tolerance)
+{
+    if (!detailOptions.gpuPicking || !PickRenderer::isSupported())
+        return false;
+
+    m_pickRequested = true;
+    m_pickRay = pickRay;
+    m_pickTolerance = tolerance;
+    return true;
+}
+
+bool Renderer::getPickResult(Selection& sel) const
+{
+    return m_pickRenderer->getResult(sel);
+}
+
+bool Renderer::getNearStarOffset(const Star* star, Vector3d& offset) const
+{
+    // There are only a few near stars
+    auto it = std::find(nearStars.begin(), nearStars.end(), star);
+    if (it == nearStars.end())
+        return false;
+
+    offset = nearStarOffsets[static_cast<std::size_t>(it - nearStars.begin())];
+    return true;
+}
+
+int Renderer::getQualityLevel() const
+{
+    return qualityGovernor.level();
+}
+
+// Set the level of detail of the things done outside of the renderer
+void Renderer::applyQualityLevel()
+{
+    Galaxy::setDetailScale(qualityGovernor.galaxyDetail());
+    g_lodSphere->setLODOffset(qualityGovernor.sphereLODBias());
+
+    unsigned int shadowMapSize = qualityGovernor.shadowMapSize(m_fullShadowMapSize);
+    if (shadowMapSize != m_shadowMapSize)
+        resizeShadowMap(shadowMapSize);
+}
+
+// Per frame housekeeping, and dropping the work shared by the views of the
+// last frame
+void Renderer::startFrame()
+{
+    frameCount++;
+    m_pickRenderer->update(frameCount);
+    m_streamBuffer->beginFrame();
+    m_occluderIndex->invalidate();
+    updateOrbitCache();
+    GetTextureManager()->finishLoading(TextureUploadBudget);
+    ImageTexture::uploadPendingLevels(TextureUploadBudget);
+    GetGeometryManager()->finishLoading(ModelUploadBudget);
+    manageTextureMemory();
+
+    nearStarsValid = false;
+    lazyBodyPositionsCatalog = nullptr;
+    frameCameraIndex = 0;
+    cameraMoved = false;
+}
+
 void Renderer::render(const Observer& observer,
                       const Universe& universe,
                       float faintestMagNight,
@@ -1514,9 +1921,13 @@ void Renderer::draw(const Observer& observer,
     double now = observer.getTime();
     realTime = observer.getRealTime();
 
-    frameCount++;
+    if (!inFrame)
+        startFrame();
     settingsChanged = false;
 
+    // The labels of the last frame have all been drawn
+    labelCache.update(universe.getStarCatalog(), universe.getDSOCatalog());
+
     // Compute the size of a pixel
     setFieldOfView(radToDeg(observer.getFOV()));
     pixelSize = calcPixelSize(fov, (float) windowHeight);
@@ -1531,6 +1942,26 @@ void Renderer::draw(const Observer& observer,
 
     m_cameraOrientation = observer.getOrientationf();
 
+    // Check whether the camera of this view moved since the last frame
+    UniversalCoord cameraPosition = observer.getPosition();
+    if (frameCameraIndex == frameCameras.size())
+    {
+        frameCameras.emplace_back(cameraPosition, m_cameraOrientation);
+        cameraMoved = true;
+    }
+    else
+    {
+        auto& [lastPosition, lastOrientation] = frameCameras[frameCameraIndex];
+        if (lastPosition.offsetFromKm(cameraPosition) != Eigen::Vector3d::Zero() ||
+            lastOrientation.coeffs() != m_cameraOrientation.coeffs())
+        {
+            cameraMoved = true;
+            lastPosition = cameraPosition;
+            lastOrientation = m_cameraOrientation;
+        }
+    }
+    ++frameCameraIndex;
+
     // Get the view frustum used for culling in camera space.
     Frustum frustum(degToRad(fov), getAspectRatio(), MinNearPlaneDistance);
 
@@ -1553,6 +1984,7 @@ void Renderer::draw(const Observer& observer,
     foregroundAnnotations.clear();
     backgroundAnnotations.clear();
     objectAnnotations.clear();
+    m_frameArena.reset();
 
     // Put all solar system bodies into the render list.  Stars close and
     // large enough to have discernible surface detail are also placed in
@@ -1561,7 +1993,6 @@ void Renderer::draw(const Observer& observer,
     orbitPathList.clear();
     lightSourceList.clear();
     secondaryIlluminators.clear();
-    nearStars.clear();
 
     // See if we want to use AutoMag.
     if ((renderFlags & ShowAutoMag) != 0)
@@ -1579,8 +2010,15 @@ void Renderer::draw(const Observer& observer,
     {
         buildNearSystemsLists(universe, observer, xfrustum, now);
     }
+    else
+    {
+        nearStars.clear();
+        nearStarOffsets.clear();
+        nearStarsValid = false;
+    }
 
     setupSecondaryLightSources(secondaryIlluminators, lightSourceList);
+    buildSkyOccluders();
 
     // Scan through the render list to see if we're inside a planetary
     // atmosphere.  If so, we need to adjust the sky color as well as the
@@ -1612,6 +2050,23 @@ void Renderer::draw(const Observer& observer,
 
     ambientColor = Color(ambientLightLevel, ambientLightLevel, ambientLightLevel);
 
+    // Reverse depth gains nothing with the fixed point depth buffers of
+    // the windows, so the view is drawn offscreen
+    m_reverseDepthView = false;
+    if (detailOptions.reverseDepth && gl::hasReverseDepth() &&
+        getProjectionMode() != ProjectionMode::FisheyeMode)
+    {
+        if (m_floatDepthTarget == nullptr)
+            m_floatDepthTarget = std::make_unique<FloatDepthTarget>();
+        m_reverseDepthView = m_floatDepthTarget->bind(m_viewport[0], m_viewport[1],
+                                                      m_viewport[2], m_viewport[3]);
+        if (!m_reverseDepthView)
+        {
+            GetLogger()->warn("Reverse depth disabled, falling back to depth partitions.\n");
+            detailOptions.reverseDepth = false;
+        }
+    }
+
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -1621,13 +2076,15 @@ void Renderer::draw(const Observer& observer,
     // Render deep sky objects
     if ((renderFlags & ShowDeepSpaceObjects) != 0 && universe.getDSOCatalog() != nullptr)
     {
+        ProfileScope scope(*m_profiler, ProfilePass::DeepSkyObjects);
         renderDeepSkyObjects(universe, observer, faintestMag);
     }
 
     // Render stars
     if ((renderFlags & ShowStars) != 0 && universe.getStarCatalog() != nullptr)
     {
-        renderPointStars(*universe.getStarCatalog(), faintestMag, observer);
+        ProfileScope scope(*m_profiler, ProfilePass::PointStars);
+        renderPointStars(*universe.getStarCatalog(), faintestMag - qualityGovernor.starMagnitudeOffset(), observer);
     }
 
     // Translate the camera before rendering the asterisms and boundaries
@@ -1672,17 +2129,18 @@ void Renderer::draw(const Observer& observer,
 
     removeInvisibleItems(frustum);
 
-    // Sort the annotations
-    sort(depthSortedAnnotations.begin(), depthSortedAnnotations.end());
-
-    // Sort the orbit paths
-    sort(orbitPathList.begin(), orbitPathList.end());
+    // Sort the annotations and the orbit paths front to back, as their
+    // operator< does
+    annotationSorter.sort(depthSortedAnnotations,
+                          [](const Annotation& a) { return util::FloatSortKey(-a.position.z()); });
+    orbitPathSorter.sort(orbitPathList,
+                         [](const OrbitPathListEntry& o) { return util::FloatSortKey(o.radius - o.centerZ); });
 
 #ifndef GL_ES
     glPolygonMode(GL_FRONT_AND_BACK, (GLenum) renderMode);
 #endif
 
-    int nIntervals = buildDepthPartitions();
+    int nIntervals = m_reverseDepthView ? buildReverseDepthPartition() : buildDepthPartitions();
     renderSolarSystemObjects(observer, nIntervals, now);
 
     renderForegroundAnnotations(FontNormal);
@@ -1692,60 +2150,22 @@ void Renderer::draw(const Observer& observer,
         renderSelectionPointer(observer, now, xfrustum, sel);
     }
 
+    if (m_pickRequested)
+    {
+        m_pickRequested = false;
+        m_pickRenderer->render(observer, universe, m_pickRay, m_pickTolerance / pixelSize, frameCount);
+    }
+
 #ifndef GL_ES
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 #endif
-}
 
-static
-void renderLargePoint(Renderer &renderer,
-                      const Vector3f &position,
-                      const Color &color,
-                      float size,
-                      const Matrices &mvp)
-{
-    Renderer::PipelineState ps;
-    ps.blending = true;
-    ps.blendFunc = {GL_SRC_ALPHA, GL_ONE};
-    ps.depthTest = true;
-    renderer.setPipelineState(ps);
-
-    auto *prog = renderer.getShaderManager().getShader("largestar");
-    if (prog == nullptr)
-        return;
-
-    // Draw billboard for large points
-    prog->use();
-    prog->samplerParam("starTex") = 0;
-    prog->setMVPMatrices(*mvp.projection, *mvp.modelview);
-    prog->vec4Param("color") = color.toVector4();
-    prog->vec3Param("center") = position;
-    prog->floatParam("pointWidth") = size / renderer.getWindowWidth() * 2.0f;
-    prog->floatParam("pointHeight") = size / renderer.getWindowHeight() * 2.0f;
-
-    auto &vo = renderer.getVertexObject(VOType::LargeStar, GL_ARRAY_BUFFER, 0, GL_STATIC_DRAW);
-    vo.bind();
-    if (!vo.initialized())
-    {
-        const float texCoords[] = {
-            // offset     // texCoords
-            -0.5f,  0.5f, 0.0f, 0.0f,
-            -0.5f, -0.5f, 0.0f, 1.0f,
-             0.5f, -0.5f, 1.0f, 1.0f,
-
-            -0.5f,  0.5f, 0.0f, 0.0f,
-             0.5f, -0.5f, 1.0f, 1.0f,
-             0.5f,  0.5f, 1.0f, 0.0f,
-        };
-        vo.allocate(sizeof(texCoords), texCoords);
-        vo.setVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex,
-                                2, GL_FLOAT, false, 4 * sizeof(float), 0);
-        vo.setVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex,
-                                2, GL_FLOAT, false, 4 * sizeof(float), 2 * sizeof(float));
+    if (m_reverseDepthView && !m_floatDepthTarget->unbind())
+    {
+        GetLogger()->warn("Unable to copy the view drawn with reverse depth, falling back to depth partitions.\n");
+        detailOptions.reverseDepth = false;
     }
-
-    vo.draw(GL_TRIANGLES, 6);
-    vo.unbind();
+    m_reverseDepthView = false;
 }
 
 static Eigen::Vector3f
@@ -1819,8 +2239,7 @@ void Renderer::renderObjectAsPoint(const Vector3f& position,
                                    float discSizeInPixels,
                                    const Color &color,
                                    bool useHalos,
-                                   bool emissive,
-                                   const Matrices &mvp)
+                                   bool emissive)
 {
     const bool useScaledDiscs = starStyle == ScaledDiscStars;
     float maxDiscSize = useScaledDiscs ? MaxScaledDiscStarSize : 1.0f;
@@ -1849,17 +2268,10 @@ void Renderer::renderObjectAsPoint(const Vector3f& position,
         if (glareSize != 0.0f)
             glareSize = std::max(glareSize, pointSize * discSizeInPixels / scale * 3.0f);
 
-        Renderer::PipelineState ps;
-        ps.blending = true;
-        ps.blendFunc = {GL_SRC_ALPHA, GL_ONE};
-        ps.depthTest = true;
-        setPipelineState(ps);
-
-        if (starStyle != PointStars)
-            gaussianDiscTex->bind();
-
+        // The points are only collected here; they're drawn together once
+        // the depth interval is done.
         if (pointSize > gl::maxPointSize)
-            renderLargePoint(*this, position, {color, alpha}, pointSize, mvp);
+            m_largePointBuffer->addPoint(position, {color, alpha}, pointSize);
         else
             pointStarVertexBuffer->addStar(position, {color, alpha}, pointSize);
 
@@ -1872,9 +2284,8 @@ void Renderer::renderObjectAsPoint(const Vector3f& position,
         if (useHalos && glareAlpha > 0.0f)
         {
             Eigen::Vector3f center = calculateQuadCenter(m_cameraOrientation, position, radius);
-            gaussianGlareTex->bind();
             if (glareSize > gl::maxPointSize)
-                renderLargePoint(*this, center, {color, glareAlpha}, glareSize, mvp);
+                m_largeGlareBuffer->addPoint(center, {color, glareAlpha}, glareSize);
             else
                 glareVertexBuffer->addStar(center, {color, glareAlpha}, glareSize);
         }
@@ -1962,9 +2373,9 @@ Renderer::locationsToAnnotations(const Body& body,
                                  const Vector3d& bodyPosition,
                                  const Quaterniond& bodyOrientation)
 {
-    const vector<Location*>* locations = body.getLocations();
+    const LocationIndex* locationIndex = body.getLocationIndex();
 
-    if (locations == nullptr)
+    if (locationIndex == nullptr)
         return;
 
     Vector3f semiAxes = body.getSemiAxes();
@@ -1983,84 +2394,102 @@ Renderer::locationsToAnnotations(const Body& body,
 
     Matrix3d bodyMatrix = bodyOrientation.conjugate().toRotationMatrix();
 
-    for (const auto location : *locations)
+    // Only the locations on the side of the body facing the observer and
+    // large enough to be labeled are looked at, most important first. The
+    // sphere inscribed in the ellipsoid hides no label that the ray test
+    // below lets through.
+    LocationIndex::Query query;
+    query.observerPosition = viewRayOrigin;
+    query.occluderRadius = semiAxes.minCoeff();
+    query.pointRadiusScale = 1.0 + labelOffset;
+    query.minPointRadius = body.isEllipsoid() ? 0.0 : boundingRadius * 1.01;
+    query.minImportancePerDistance = static_cast<double>(minFeatureSize) * static_cast<double>(pixelSize);
+    query.featureMask = locationFilter;
+
+    locationCandidates.clear();
+    locationIndex->find(query, locationCandidates);
+
+    std::size_t nLabels = 0;
+    for (const auto location : locationCandidates)
     {
+        if (nLabels == MaxLocationLabels)
+            break;
+
         auto featureType = location->getFeatureType();
-        if ((featureType & locationFilter) != 0)
-        {
-            // Get the position of the location with respect to the planet center
-            Vector3f ppos = location->getPosition();
 
-            // Compute the bodycentric position of the location
-            Vector3d locPos = ppos.cast<double>();
+        // Get the position of the location with respect to the planet center
+        Vector3f ppos = location->getPosition();
 
-            // Get the planetocentric position of the label.  Add a slight scale factor
-            // to keep the point from being exactly on the surface.
-            Vector3d pcLabelPos = locPos * (1.0 + labelOffset);
+        // Compute the bodycentric position of the location
+        Vector3d locPos = ppos.cast<double>();
 
-            // Get the camera space label position
-            Vector3d labelPos = bodyCenter + bodyMatrix * locPos;
+        // Get the planetocentric position of the label.  Add a slight scale factor
+        // to keep the point from being exactly on the surface.
+        Vector3d pcLabelPos = locPos * (1.0 + labelOffset);
 
-            float effSize = location->getImportance();
-            if (effSize < 0.0f)
-                effSize = location->getSize();
+        // Get the camera space label position
+        Vector3d labelPos = bodyCenter + bodyMatrix * locPos;
 
-            float pixSize = effSize / (float) (labelPos.norm() * pixelSize);
+        float effSize = location->getImportance();
+        if (effSize < 0.0f)
+            effSize = location->getSize();
 
-            if (pixSize > minFeatureSize && labelPos.dot(viewNormal) > 0.0)
+        float pixSize = effSize / (float) (labelPos.norm() * pixelSize);
+
+        if (pixSize > minFeatureSize && labelPos.dot(viewNormal) > 0.0)
+        {
+            // Labels on non-ellipsoidal bodies need special handling; the
+            // ellipsoid visibility test will always fail for them, since they
+            // will lie on the surface of the mesh, which is inside the
+            // the bounding ellipsoid. The following code projects location positions
+            // onto the bounding sphere.
+            if (!body.isEllipsoid())
             {
-                // Labels on non-ellipsoidal bodies need special handling; the
-                // ellipsoid visibility test will always fail for them, since they
-                // will lie on the surface of the mesh, which is inside the
-                // the bounding ellipsoid. The following code projects location positions
-                // onto the bounding sphere.
-                if (!body.isEllipsoid())
-                {
-                    double r = locPos.norm();
-                    if (r < boundingRadius)
-                        pcLabelPos = locPos * (boundingRadius * 1.01 / r);
-                }
+                double r = locPos.norm();
+                if (r < boundingRadius)
+                    pcLabelPos = locPos * (boundingRadius * 1.01 / r);
+            }
 
-                double t = 0.0;
+            double t = 0.0;
 
-                // Test for an intersection of the eye-to-location ray with
-                // the planet ellipsoid.  If we hit the planet first, then
-                // the label is obscured by the planet.  An exact calculation
-                // for irregular objects would be too expensive, and the
-                // ellipsoid approximation works reasonably well for them.
-                Eigen::ParametrizedLine<double, 3> testRay(viewRayOrigin, pcLabelPos - viewRayOrigin);
-                bool hit = testIntersection(testRay, bodyEllipsoid, t);
+            // Test for an intersection of the eye-to-location ray with
+            // the planet ellipsoid.  If we hit the planet first, then
+            // the label is obscured by the planet.  An exact calculation
+            // for irregular objects would be too expensive, and the
+            // ellipsoid approximation works reasonably well for them.
+            Eigen::ParametrizedLine<double, 3> testRay(viewRayOrigin, pcLabelPos - viewRayOrigin);
+            bool hit = testIntersection(testRay, bodyEllipsoid, t);
 
-                if (!hit || t >= 1.0)
-                {
-                    // Calculate the intersection of the eye-to-label ray with the plane perpendicular to
-                    // the view normal that touches the front of the object's bounding sphere
-                    double planetZ = viewNormal.dot(bodyCenter) - boundingRadius;
-                    if (planetZ < -nearDist * 1.001)
-                        planetZ = -nearDist * 1.001;
-                    double z = viewNormal.dot(labelPos);
-                    labelPos *= planetZ / z;
-
-                    celestia::MarkerRepresentation* locationMarker = nullptr;
-                    if (featureType & Location::City)
-                        locationMarker = &cityRep;
-                    else if (featureType & (Location::LandingSite | Location::Observatory))
-                        locationMarker = &observatoryRep;
-                    else if (featureType & (Location::Crater | Location::Patera))
-                        locationMarker = &craterRep;
-                    else if (featureType & (Location::Mons | Location::Tholus))
-                        locationMarker = &mountainRep;
-                    else if (featureType & (Location::EruptiveCenter))
-                        locationMarker = &genericLocationRep;
-
-                    Color labelColor = location->isLabelColorOverridden() ? location->getLabelColor() : LocationLabelColor;
-                    addObjectAnnotation(locationMarker,
-                                        location->getName(true),
-                                        labelColor,
-                                        labelPos.cast<float>(),
-                                        LabelHorizontalAlignment::Start,
-                                        LabelVerticalAlignment::Bottom);
-                }
+            if (!hit || t >= 1.0)
+            {
+                // Calculate the intersection of the eye-to-label ray with the plane perpendicular to
+                // the view normal that touches the front of the object's bounding sphere
+                double planetZ = viewNormal.dot(bodyCenter) - boundingRadius;
+                if (planetZ < -nearDist * 1.001)
+                    planetZ = -nearDist * 1.001;
+                double z = viewNormal.dot(labelPos);
+                labelPos *= planetZ / z;
+
+                celestia::MarkerRepresentation* locationMarker = nullptr;
+                if (featureType & Location::City)
+                    locationMarker = &cityRep;
+                else if (featureType & (Location::LandingSite | Location::Observatory))
+                    locationMarker = &observatoryRep;
+                else if (featureType & (Location::Crater | Location::Patera))
+                    locationMarker = &craterRep;
+                else if (featureType & (Location::Mons | Location::Tholus))
+                    locationMarker = &mountainRep;
+                else if (featureType & (Location::EruptiveCenter))
+                    locationMarker = &genericLocationRep;
+
+                Color labelColor = location->isLabelColorOverridden() ? location->getLabelColor() : LocationLabelColor;
+                addObjectAnnotation(locationMarker,
+                                    location->getName(true),
+                                    labelColor,
+                                    labelPos.cast<float>(),
+                                    LabelHorizontalAlignment::Start,
+                                    LabelVerticalAlignment::Bottom);
+                ++nLabels;
             }
         }
     }
@@ -2128,22 +2557,23 @@ setupObjectLighting(const vector<LightSource>& suns,
     if (nLights == 0)
         return;
 
+    // The per-light terms shared by all objects of the system were set up
+    // with the light sources; only the direction and distance remain
     unsigned int i;
     for (i = 0; i < nLights; i++)
     {
         Vector3d dir = suns[i].position - objPosition_eye.cast<double>();
+        double distance2 = dir.squaredNorm();
+        double distance = std::sqrt(distance2);
 
-        ls.lights[i].direction_eye = dir.cast<float>();
-        float distance = ls.lights[i].direction_eye.norm();
-        ls.lights[i].direction_eye *= 1.0f / distance;
-        distance = astro::kilometersToAU((float) dir.norm());
-        ls.lights[i].irradiance = suns[i].luminosity / (distance * distance);
+        ls.lights[i].direction_eye = (dir / distance).cast<float>();
+        ls.lights[i].irradiance = suns[i].irradianceScale / (float) distance2;
         ls.lights[i].color = suns[i].color;
 
         // Store the position and apparent size because we'll need them for
         // testing for eclipses.
         ls.lights[i].position = dir;
-        ls.lights[i].apparentSize = (float) (suns[i].radius / dir.norm());
+        ls.lights[i].apparentSize = (float) (suns[i].radius / distance);
         ls.lights[i].castsShadows = true;
     }
 
@@ -2158,12 +2588,12 @@ setupObjectLighting(const vector<LightSource>& suns,
         for (auto& illuminator : secondaryIlluminators)
         {
             Vector3d toIllum = illuminator.position_v - objpos;  // reflector-to-object vector
-            float distSquared = (float) toIllum.squaredNorm() / square(illuminator.radius);
+            auto distSquared = (float) toIllum.squaredNorm();
 
-            if (distSquared > 0.01f)
+            if (distSquared > illuminator.minDistanceSquared)
             {
                 // Irradiance falls off with distance^2
-                float irr = illuminator.reflectedIrradiance / distSquared;
+                float irr = illuminator.irradianceScale / distSquared;
 
                 // Phase effects will always leave the irradiance unaffected or reduce it;
                 // don't bother calculating them if we've already found a brighter secondary
@@ -2195,7 +2625,7 @@ setupObjectLighting(const vector<LightSource>& suns,
             ls.lights[i].direction_eye = toIllum.cast<float>();
             ls.lights[i].direction_eye.normalize();
             ls.lights[i].irradiance = maxIrr;
-            ls.lights[i].color = secondaryIlluminators[maxIrrSource].body->getSurface().color;
+            ls.lights[i].color = secondaryIlluminators[maxIrrSource].color;
             ls.lights[i].apparentSize = 0.0f;
             ls.lights[i].castsShadows = false;
             i++;
@@ -2229,9 +2659,9 @@ setupObjectLighting(const vector<LightSource>& suns,
     //
     // TODO: Skip this step when high dynamic range rendering to floating point
     //   buffers is enabled.
-    float minVisibleFraction = 1.0f / 10000.0f;
-    float minDisplayableValue = 1.0f / 255.0f;
-    float gamma = log(minDisplayableValue) / log(minVisibleFraction);
+    constexpr float minVisibleFraction = 1.0f / 10000.0f;
+    constexpr float minDisplayableValue = 1.0f / 255.0f;
+    static const float gamma = log(minDisplayableValue) / log(minVisibleFraction);
     float minVisibleIrradiance = minVisibleFraction * totalIrradiance;
 
     Matrix3f m = objOrientation.toRotationMatrix();
@@ -2271,6 +2701,14 @@ setupObjectLighting(const vector<LightSource>& suns,
 }
 
 
+// Whether the specular map of the surface is packed into its base texture
+static bool
+hasPackedAlpha(const Texture* baseTex)
+{
+    return baseTex != nullptr && (baseTex->getFormatOptions() & Texture::PackedAlpha) != 0;
+}
+
+
 void Renderer::renderObject(const Vector3f& pos,
                             float distance,
                             double now,
@@ -2298,25 +2736,35 @@ void Renderer::renderObject(const Vector3f& pos,
     // Get the object's geometry; nullptr indicates that object is an
     // ellipsoid.
     Geometry* geometry = nullptr;
+    bool geometryLoading = false;
     if (obj.geometry != InvalidResource)
     {
-        // This is a model loaded from a file
-        geometry = GetGeometryManager()->find(obj.geometry);
+        // This is a model loaded from a file; objects are drawn as
+        // ellipsoids while their model is loaded in the background.
+        geometry = GetGeometryManager()->find(obj.geometry, discSizeInPixels);
+        geometryLoading = geometry == nullptr &&
+                          GetGeometryManager()->getState(obj.geometry) == ResourceState::Loading;
     }
 
     // Get the textures . . .
     if (obj.surface->baseTexture.tex[textureResolution] != InvalidResource)
-        ri.baseTex = obj.surface->baseTexture.find(textureResolution);
+        ri.baseTex = obj.surface->baseTexture.find(textureResolution, discSizeInPixels);
     if ((obj.surface->appearanceFlags & Surface::ApplyBumpMap) != 0 &&
         obj.surface->bumpTexture.tex[textureResolution] != InvalidResource)
-        ri.bumpTex = obj.surface->bumpTexture.find(textureResolution);
+        ri.bumpTex = obj.surface->bumpTexture.find(textureResolution, discSizeInPixels);
     if ((obj.surface->appearanceFlags & Surface::ApplyNightMap) != 0 &&
         (renderFlags & ShowNightMaps) != 0)
-        ri.nightTex = obj.surface->nightTexture.find(textureResolution);
-    if ((obj.surface->appearanceFlags & Surface::SeparateSpecularMap) != 0)
-        ri.glossTex = obj.surface->specularTexture.find(textureResolution);
+        ri.nightTex = obj.surface->nightTexture.find(textureResolution, discSizeInPixels);
+    if ((obj.surface->appearanceFlags & Surface::SeparateSpecularMap) != 0 && !hasPackedAlpha(ri.baseTex))
+        ri.glossTex = obj.surface->specularTexture.find(textureResolution, discSizeInPixels);
     if ((obj.surface->appearanceFlags & Surface::ApplyOverlay) != 0)
-        ri.overlayTex = obj.surface->overlayTexture.find(textureResolution);
+        ri.overlayTex = obj.surface->overlayTexture.find(textureResolution, discSizeInPixels);
+    if ((obj.surface->appearanceFlags & Surface::ApplyHeightMap) != 0 &&
+        obj.surface->heightMap.tex[textureResolution] != InvalidResource)
+    {
+        ri.heightTex = obj.surface->heightMap.find(textureResolution, discSizeInPixels);
+        ri.heightScale = obj.surface->heightScale / obj.radius;
+    }
 
     // Scaling will be nonuniform for nonspherical planets. As long as the
     // deviation from spherical isn't too large, the nonuniform scale factor
@@ -2363,6 +2811,7 @@ void Renderer::renderObject(const Vector3f& pos,
     ri.orientation = getCameraOrientation() * obj.orientation.conjugate();
 
     ri.pixWidth = discSizeInPixels;
+    ri.pixelsPerUnit = scaleFactors.maxCoeff() / (max(nearPlaneDistance, altitude) * pixelSize);
 
     // Set up the colors
     if (ri.baseTex == nullptr ||
@@ -2446,15 +2895,15 @@ void Renderer::renderObject(const Vector3f& pos,
         if ((renderFlags & ShowCloudMaps) != 0)
         {
             if (atmosphere->cloudTexture.tex[textureResolution] != InvalidResource)
-                cloudTex = atmosphere->cloudTexture.find(textureResolution);
+                cloudTex = atmosphere->cloudTexture.find(textureResolution, discSizeInPixels);
             if (atmosphere->cloudNormalMap.tex[textureResolution] != InvalidResource)
-                cloudNormalMap = atmosphere->cloudNormalMap.find(textureResolution);
+                cloudNormalMap = atmosphere->cloudNormalMap.find(textureResolution, discSizeInPixels);
         }
         if (atmosphere->cloudSpeed != 0.0f)
             cloudTexOffset = (float) (-pfmod(now * atmosphere->cloudSpeed / (2 * celestia::numbers::pi), 1.0));
     }
 
-    if (obj.geometry == InvalidResource)
+    if (obj.geometry == InvalidResource || geometryLoading)
     {
         // A null model indicates that this body is a sphere
         if (lit)
@@ -2519,7 +2968,8 @@ void Renderer::renderObject(const Vector3f& pos,
                              textureResolution,
                              (renderFlags & ShowRingShadows) != 0 && lit,
                              segmentSizeInPixels,
-                             ringsMVP, true, this);
+                             ringsMVP, true,
+                             detailOptions.ringShadowTextureSize, this);
         }
     }
 
@@ -2596,8 +3046,9 @@ void Renderer::renderObject(const Vector3f& pos,
             // the viewer.
             if (distance > radius * 1.1f)
             {
+                float offset = isDepthReversed() ? 1.0f : -1.0f;
                 glEnable(GL_POLYGON_OFFSET_FILL);
-                glPolygonOffset(-1.0f, -1.0f);
+                glPolygonOffset(offset, offset);
             }
 
             if (lit)
@@ -2640,7 +3091,8 @@ void Renderer::renderObject(const Vector3f& pos,
                              textureResolution,
                              (renderFlags & ShowRingShadows) != 0 && lit,
                              segmentSizeInPixels,
-                             ringsMVP, false, this);
+                             ringsMVP, false,
+                             detailOptions.ringShadowTextureSize, this);
         }
     }
 }
@@ -2736,7 +3188,7 @@ bool Renderer::testEclipse(const Body& receiver,
             shadow.caster = &caster;
 
             // Ignore transits that don't produce a visible shadow.
-            if (shadow.maxDepth > 1.0f / 256.0f)
+            if (shadow.maxDepth > MinEclipseShadowDepth)
                 shadows.push_back(shadow);
 
             isReceiverShadowed = true;
@@ -2795,6 +3247,110 @@ bool Renderer::testEclipse(const Body& receiver,
 }
 
 
+// Gather the bodies of a system which may cast eclipse shadows, once per
+// frame and time
+const OccluderList&
+Renderer::getOccluders(const PlanetarySystem& system, double now)
+{
+    if (const OccluderList* occluders = m_occluderIndex->find(&system, now); occluders != nullptr)
+        return *occluders;
+
+    OccluderList& occluders = m_occluderIndex->insert(&system, now);
+    int nBodies = system.getSystemSize();
+    for (int i = 0; i < nBodies; i++)
+    {
+        const Body* body = system.getBody(i);
+        if (body->hasVisibleGeometry() &&
+            (body->getClassification() & bodyVisibilityMask) != 0 &&
+            body->extant(now) &&
+            body->isEllipsoid())
+        {
+            occluders.add(body,
+                          body->getAstrocentricPosition(now),
+                          body->getRadius(),
+                          body->getRings() != nullptr);
+        }
+    }
+    occluders.finish();
+    return occluders;
+}
+
+
+// Add the eclipse shadows cast on a body by the bodies of a system
+void Renderer::testEclipses(const Body& receiver,
+                            const PlanetarySystem& casters,
+                            LightingState& lights,
+                            unsigned int lightIndex,
+                            double now)
+{
+    const OccluderList& occluders = getOccluders(casters, now);
+    if (occluders.empty())
+        return;
+
+    occluders.forEachCandidate(receiver.getAstrocentricPosition(now),
+                               receiver.getRadius(),
+                               receiver.getRadius() * MinRelativeOccluderRadius,
+                               lights.lights[lightIndex].apparentSize,
+                               [&](const OccluderList::Occluder& occluder)
+                               {
+                                   if (occluder.body != &receiver)
+                                       testEclipse(receiver, *occluder.body, lights, lightIndex, now);
+                               });
+}
+
+
+// Add the eclipse shadows cast on a body by its parent bodies and the
+// other bodies of its system
+void Renderer::testEclipses(const Body& body,
+                            LightingState& lights,
+                            double now)
+{
+    PlanetarySystem* system = body.getSystem();
+    if (system == nullptr)
+        return;
+
+    if (system->getPrimaryBody() == nullptr)
+    {
+        // The body is a planet.  Check for eclipse shadows
+        // from all of its satellites.
+        PlanetarySystem* satellites = body.getSatellites();
+        if (satellites != nullptr)
+        {
+            for (unsigned int li = 0; li < lights.nLights; li++)
+            {
+                if (lights.lights[li].castsShadows)
+                    testEclipses(body, *satellites, lights, li, now);
+            }
+        }
+    }
+    else
+    {
+        for (unsigned int li = 0; li < lights.nLights; li++)
+        {
+            if (lights.lights[li].castsShadows)
+            {
+                // The body is a moon.  Check for eclipse shadows from
+                // the parent planet and all satellites in the system.
+                // Traverse up the hierarchy so that any parent objects
+                // of the parent are also considered (TODO: their child
+                // objects will not be checked for shadows.)
+                Body* planet = system->getPrimaryBody();
+                while (planet != nullptr)
+                {
+                    testEclipse(body, *planet, lights, li, now);
+                    if (planet->getSystem() != nullptr)
+                        planet = planet->getSystem()->getPrimaryBody();
+                    else
+                        planet = nullptr;
+                }
+
+                testEclipses(body, *system, lights, li, now);
+            }
+        }
+    }
+}
+
+
 void Renderer::renderPlanet(Body& body,
                             const Vector3f& pos,
                             float distance,
@@ -2836,14 +3392,14 @@ void Renderer::renderPlanet(Body& body,
 
         rp.orientation = body.getGeometryOrientation() * q.cast<float>();
 
-        if (body.getLocations() != nullptr && (labelMode & LocationLabels) != 0)
+        if ((labelMode & LocationLabels) != 0 && body.hasLocations())
             body.computeLocations();
 
         Vector3f scaleFactors;
         bool isNormalized = false;
         Geometry* geometry = nullptr;
         if (rp.geometry != InvalidResource)
-            geometry = GetGeometryManager()->find(rp.geometry);
+            geometry = GetGeometryManager()->find(rp.geometry, discSizeInPixels);
         if (geometry == nullptr || geometry->isNormalized())
         {
             scaleFactors = rp.semiAxes * rp.radius;
@@ -2889,63 +3445,8 @@ void Renderer::renderPlanet(Body& body,
         }
 
         // Calculate eclipse circumstances
-        if ((renderFlags & ShowEclipseShadows) != 0 &&
-            body.getSystem() != nullptr)
-        {
-            PlanetarySystem* system = body.getSystem();
-            if (system->getPrimaryBody() == nullptr)
-            {
-                // The body is a planet.  Check for eclipse shadows
-                // from all of its satellites.
-                PlanetarySystem* satellites = body.getSatellites();
-                if (satellites != nullptr)
-                {
-                    int nSatellites = satellites->getSystemSize();
-                    for (unsigned int li = 0; li < lights.nLights; li++)
-                    {
-                        if (lights.lights[li].castsShadows)
-                        {
-                            for (int i = 0; i < nSatellites; i++)
-                            {
-                                testEclipse(body, *satellites->getBody(i), lights, li, now);
-                            }
-                        }
-                    }
-                }
-            }
-            else
-            {
-                for (unsigned int li = 0; li < lights.nLights; li++)
-                {
-                    if (lights.lights[li].castsShadows)
-                    {
-                        // The body is a moon.  Check for eclipse shadows from
-                        // the parent planet and all satellites in the system.
-                        // Traverse up the hierarchy so that any parent objects
-                        // of the parent are also considered (TODO: their child
-                        // objects will not be checked for shadows.)
-                        Body* planet = system->getPrimaryBody();
-                        while (planet != nullptr)
-                        {
-                            testEclipse(body, *planet, lights, li, now);
-                            if (planet->getSystem() != nullptr)
-                                planet = planet->getSystem()->getPrimaryBody();
-                            else
-                                planet = nullptr;
-                        }
-
-                        int nSatellites = system->getSystemSize();
-                        for (int i = 0; i < nSatellites; i++)
-                        {
-                            if (system->getBody(i) != &body)
-                            {
-                                testEclipse(body, *system->getBody(i), lights, li, now);
-                            }
-                        }
-                    }
-                }
-            }
-        }
+        if ((renderFlags & ShowEclipseShadows) != 0)
+            testEclipses(body, lights, now);
 
         // Sort out the ring shadows; only one ring shadow source is supported right now. This means
         // that exotic cases with shadows from two ring different ring systems aren't handled.
@@ -3032,7 +3533,7 @@ void Renderer::renderPlanet(Body& body,
                      nearPlaneDistance, farPlaneDistance,
                      rp, lights, m);
 
-        if (body.getLocations() != nullptr && (labelMode & LocationLabels) != 0)
+        if ((labelMode & LocationLabels) != 0 && body.hasLocations())
         {
             // Set up location markers for this body
             using namespace celestia;
@@ -3056,11 +3557,182 @@ void Renderer::renderPlanet(Body& body,
                             appMag,
                             discSizeInPixels,
                             body.getSurface().color,
-                            false, false, m);
+                            false, false);
     }
 }
 
 
+struct Renderer::ModelInstanceInfo
+{
+    Geometry* geometry{ nullptr };
+    LightingState lights;
+    ModelInstance instance;
+    float pixelsPerUnit{ 0.0f };
+};
+
+
+// Set up a body for drawing as an instance of its model. Bodies that need
+// a state of their own are drawn one at a time: those shown as points or
+// with an unlit, retextured or lunar-Lambert surface, location labels,
+// more or less than one light source, or eclipse shadows.
+bool Renderer::getModelInstance(const RenderListEntry& rle,
+                                double now,
+                                float nearPlaneDistance,
+                                ModelInstanceInfo& info)
+{
+    const Body& body = *rle.body;
+    if (body.getGeometry() == InvalidResource || !body.hasVisibleGeometry())
+        return false;
+    if ((labelMode & LocationLabels) != 0 && body.hasLocations())
+        return false;
+
+    float altitude = rle.distance - body.getRadius();
+    float discSizeInPixels = body.getRadius() / (max(nearPlaneDistance, altitude) * pixelSize);
+    float maxDiscSize = (starStyle == ScaledDiscStars) ? MaxScaledDiscStarSize : 1.0f;
+    if (discSizeInPixels < maxDiscSize)
+        return false;
+
+    const Surface* surface = &body.getSurface();
+    if (!displayedSurface.empty() && body.getAlternateSurface(displayedSurface) != nullptr)
+        surface = body.getAlternateSurface(displayedSurface);
+    if ((surface->appearanceFlags & Surface::Emissive) != 0 ||
+        surface->baseTexture.tex[textureResolution] != InvalidResource ||
+        surface->lunarLambert != 0.0f)
+    {
+        return false;
+    }
+
+    info.geometry = GetGeometryManager()->find(body.getGeometry(), discSizeInPixels);
+    if (info.geometry == nullptr || !info.geometry->isInstanceable())
+        return false;
+
+    Vector3f scaleFactors = info.geometry->isNormalized()
+        ? body.getSemiAxes()
+        : Vector3f::Constant(body.getGeometryScale());
+
+    Quaterniond q = body.getRotationModel(now)->spin(now) *
+                    body.getEclipticToEquatorial(now);
+    Quaternionf orientation = body.getGeometryOrientation() * q.cast<float>();
+
+    info.lights = LightingState();
+    setupObjectLighting(lightSourceList,
+                        secondaryIlluminators,
+                        orientation,
+                        scaleFactors,
+                        rle.position,
+                        info.geometry->isNormalized(),
+                        info.lights);
+    if (info.lights.nLights != 1)
+        return false;
+    info.lights.ambientColor = ambientColor.toVector3();
+
+    if ((renderFlags & ShowEclipseShadows) != 0)
+    {
+        eclipseShadows[0].clear();
+        info.lights.shadows[0] = &eclipseShadows[0];
+        testEclipses(body, info.lights, now);
+        if (!eclipseShadows[0].empty())
+            return false;
+        info.lights.shadows[0] = nullptr;
+    }
+
+    Affine3f transform = Translation3f(rle.position) * orientation.conjugate() * Scaling(scaleFactors);
+    for (int i = 0; i < 3; i++)
+        info.instance.transform[i] = transform.matrix().row(i).transpose();
+    info.instance.lightDirection << info.lights.lights[0].direction_obj, 0.0f;
+
+    info.pixelsPerUnit = scaleFactors.maxCoeff() / (max(nearPlaneDistance, altitude) * pixelSize);
+
+    return true;
+}
+
+
+// Draw the bodies starting at items[first] that share its model and light
+// source together, as instances of the model. Returns the number of items
+// drawn, zero if the first item has to be drawn on its own.
+std::size_t Renderer::renderModelInstances(const std::vector<const RenderListEntry*>& items,
+                                           std::size_t first,
+                                           const Observer& observer,
+                                           float nearPlaneDistance,
+                                           const Matrices& m)
+{
+#ifdef USE_GLSL_STRUCTS
+    // The instance light direction replaces the light uniform by its name
+    return 0;
+#else
+    if (!gl::ARB_instanced_arrays)
+        return 0;
+
+    // Shadow maps are rendered for each object
+    if (hasShadowMaps())
+        return 0;
+
+    ResourceHandle geometryHandle = items[first]->body->getGeometry();
+    if (first + 1 >= items.size() || items[first + 1]->body->getGeometry() != geometryHandle)
+        return 0;
+
+    double now = observer.getTime();
+    ModelInstanceInfo info;
+    if (!getModelInstance(*items[first], now, nearPlaneDistance, info))
+        return 0;
+
+    // Instances share the light color, so the irradiance of the light may
+    // only vary a little between them.
+    constexpr float MaxIrradianceVariation = 0.01f;
+    const DirectionalLight& light = info.lights.lights[0];
+
+    std::vector<ModelInstance> instances{ info.instance };
+    float pixelsPerUnit = info.pixelsPerUnit;
+    std::size_t last = first + 1;
+    ModelInstanceInfo next;
+    for (; last < items.size(); ++last)
+    {
+        if (items[last]->body->getGeometry() != geometryHandle ||
+            !getModelInstance(*items[last], now, nearPlaneDistance, next) ||
+            next.geometry != info.geometry ||
+            next.lights.lights[0].color != light.color ||
+            std::abs(next.lights.lights[0].irradiance - light.irradiance) > light.irradiance * MaxIrradianceVariation)
+        {
+            break;
+        }
+
+        instances.push_back(next.instance);
+        // The level of detail of the closest instance is drawn
+        pixelsPerUnit = max(pixelsPerUnit, next.pixelsPerUnit);
+    }
+
+    if (instances.size() < 2)
+        return 0;
+
+    RenderInfo ri;
+    ri.pixelsPerUnit = pixelsPerUnit;
+    renderGeometryInstanced_GLSL(info.geometry, ri, info.lights,
+                                 instances.data(), instances.size(),
+                                 astro::daysToSecs(now - astro::J2000),
+                                 m, this);
+    glActiveTexture(GL_TEXTURE0);
+
+    for (std::size_t i = first; i < last; i++)
+    {
+        const RenderListEntry& rle = *items[i];
+        if (rle.body->isVisibleAsPoint())
+        {
+            float altitude = rle.distance - rle.body->getRadius();
+            float discSizeInPixels = rle.body->getRadius() / (max(nearPlaneDistance, altitude) * pixelSize);
+            renderObjectAsPoint(rle.position,
+                                rle.body->getRadius(),
+                                rle.appMag,
+                                discSizeInPixels,
+                                rle.body->getSurface().color,
+                                false, false);
+        }
+    }
+
+    return last - first;
+#endif
+}
+
+
 void Renderer::renderStar(const Star& star,
                           const Vector3f& pos,
                           float distance,
@@ -3132,8 +3804,7 @@ void Renderer::renderStar(const Star& star,
                         appMag,
                         discSizeInPixels,
                         color,
-                        star.hasCorona(), true,
-                        m);
+                        star.hasCorona(), true);
 }
 
 
@@ -3151,12 +3822,10 @@ static float cometDustTailLength(float distanceToSun,
 
 void Renderer::renderCometTail(const Body& body,
                                const Vector3f& pos,
-                               const Observer& observer,
                                float dustTailLength,
-                               float discSizeInPixels,
-                               const Matrices &m)
+                               float discSizeInPixels)
 {
-    m_cometRenderer->render(body, observer, pos, dustTailLength, discSizeInPixels, m);
+    m_cometRenderer->queue(body, pos, dustTailLength, discSizeInPixels);
 }
 
 
@@ -3298,70 +3967,415 @@ static bool isBodyVisible(const Body* body, int bodyVisibilityMask)
     }
 }
 
+static bool hasVisibleGeometry(const RenderListEntry& rle)
+{
+    return rle.renderableType == RenderListEntry::RenderableBody &&
+           rle.body->getGeometry() != InvalidResource &&
+           rle.discSizeInPixels > 1;
+}
+
+// Models loaded in the background are requested here first, so those
+// larger on screen are loaded first
+static bool isGeometryOpaque(const RenderListEntry& rle)
+{
+    const Geometry* geometry = GetGeometryManager()->find(rle.body->getGeometry(), rle.discSizeInPixels);
+    return geometry == nullptr || geometry->isOpaque();
+}
+
+// With a batch the entries are added to it instead of the render list, and
+// only the render thread looks up the geometry opacity.
 void Renderer::addRenderListEntries(RenderListEntry& rle,
                                     Body& body,
-                                    bool isLabeled)
+                                    bool isLabeled,
+                                    RenderListBatch* batch)
 {
+    std::vector<RenderListEntry>& entries = batch == nullptr ? renderList : batch->renderList;
     bool visibleAsPoint = rle.appMag < faintestPlanetMag && body.isVisibleAsPoint();
 
     if (rle.discSizeInPixels > 1 || visibleAsPoint || isLabeled)
     {
         rle.renderableType = RenderListEntry::RenderableBody;
         rle.body = &body;
+        rle.isOpaque = batch != nullptr || !hasVisibleGeometry(rle) || isGeometryOpaque(rle);
+        rle.radius = body.getRadius();
+        entries.push_back(rle);
+    }
+
+    if (body.getClassification() == Body::Comet && (renderFlags & ShowCometTails) != 0)
+    {
+        float radius = cometDustTailLength(rle.sun.norm(), body.getRadius());
+        float discSize = (radius / rle.distance) / pixelSize;
+        if (discSize > 1)
+        {
+            rle.renderableType = RenderListEntry::RenderableCometTail;
+            rle.body = &body;
+            rle.isOpaque = false;
+            rle.radius = radius;
+            rle.discSizeInPixels = discSize;
+            entries.push_back(rle);
+        }
+    }
+
+    const list<ReferenceMark*>* refMarks = body.getReferenceMarks();
+    if (refMarks != nullptr)
+    {
+        for (const auto rm : *refMarks)
+        {
+            rle.renderableType = RenderListEntry::RenderableReferenceMark;
+            rle.refMark = rm;
+            rle.isOpaque = rm->isOpaque();
+            rle.radius = rm->boundingSphereRadius();
+            entries.push_back(rle);
+        }
+    }
+}
+
+
+void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
+                                const Frustum& viewFrustum,
+                                const Vector3d& viewPlaneNormal,
+                                const Vector3d& frameCenter,
+                                const FrameTree* tree,
+                                const Observer& observer,
+                                double now)
+{
+    if (tree == nullptr)
+        return;
+
+    ++minorBodyCullStamp;
+    cullMinorBodies(astrocentricObserverPos, viewFrustum, frameCenter, tree, now);
+
+    unsigned int nThreads = detailOptions.renderListThreads;
+    if (nThreads == 0)
+        nThreads = celestia::util::GetJobSystem()->threadCount();
+
+    if (nThreads > 1 && tree->bodyCount() >= MinParallelRenderListBodies &&
+        buildRenderListsParallel(astrocentricObserverPos, viewFrustum, viewPlaneNormal,
+                                 frameCenter, tree, observer, now, nThreads))
+    {
+        return;
+    }
+
+    buildRenderLists(astrocentricObserverPos, viewFrustum, viewPlaneNormal,
+                     frameCenter, tree, 0, tree->childCount(), observer, now, nullptr);
+}
+
+
+// Reject the groups of minor bodies of the tree that are outside the view
+// frustum, or too small and faint to be seen even at their closest; the
+// traversal below skips their bodies without evaluating their orbits.
+void Renderer::cullMinorBodies(const Vector3d& astrocentricObserverPos,
+                               const Frustum& viewFrustum,
+                               const Vector3d& frameCenter,
+                               const FrameTree* tree,
+                               double now)
+{
+    MinorBodyBVH* bvh = tree->getMinorBodyBVH();
+    if (bvh == nullptr)
+        return;
+
+    bvh->update(*tree, now);
+
+    int labelClassMask = translateLabelModeToClassMask(labelMode);
+    bool showCometTails = (renderFlags & ShowCometTails) != 0;
+    Vector3d center_v = frameCenter - astrocentricObserverPos;
+
+    bvh->cull([&](const MinorBodyBVH::Node& node)
+    {
+        // Secondary illuminators light up the bodies around them even when
+        // they're out of view themselves.
+        Vector3d pos_v = center_v + node.center;
+        double influenceRadius = node.radius + node.maxIlluminatorRadius * PLANETSHINE_DISTANCE_LIMIT_FACTOR;
+        if (viewFrustum.testSphere(pos_v.cast<float>(), (float) influenceRadius) == Frustum::Outside)
+            return false;
+
+        // Labeled bodies and comet tails may be visible however small the
+        // bodies are.
+        if ((node.orbitClassMask & labelClassMask) != 0 ||
+            (showCometTails && (node.classMask & Body::Comet) != 0))
+        {
+            return true;
+        }
+
+        double minPossibleDistance = pos_v.norm() - node.radius;
+        if (minPossibleDistance <= 1.0)
+            return true;
+
+        if (node.maxBodyRadius / minPossibleDistance / pixelSize > 1.0 ||
+            node.maxIlluminatorRadius / minPossibleDistance / pixelSize > PLANETSHINE_PIXEL_SIZE_LIMIT)
+        {
+            return true;
+        }
+
+        float lum = 0.0f;
+        for (const auto& lightSource : lightSourceList)
+        {
+            double sunDistance = std::max((pos_v - lightSource.position).norm() - node.radius, 1.0);
+            lum += luminosityAtOpposition(lightSource.luminosity, (float) sunDistance, node.maxBodyRadius);
+        }
+        return astro::lumToAppMag(lum, astro::kilometersToLightYears(minPossibleDistance)) < faintestPlanetMag;
+    }, minorBodyCullStamp);
+}
+
+
+// Add the bodies of a lazy body catalog which are visible as points to the
+// render list, from the positions of all of them computed together. Those
+// which need to be shown as more than a point, labeled or have their orbit
+// drawn are created instead, a few per frame, and are handled by the frame
+// tree traversal from the next frame on.
+void Renderer::buildLazyBodyLists(const Vector3d& astrocentricObserverPos,
+                                  const Frustum& viewFrustum,
+                                  const Observer& observer,
+                                  const FrameTree* tree,
+                                  LazyBodyCatalog& lazyBodies,
+                                  double now)
+{
+    constexpr unsigned int MaxCreatedPerFrame = 64;
+
+    if ((bodyVisibilityMask & Body::Asteroid) == 0)
+        return;
+
+    unsigned int nThreads = detailOptions.renderListThreads;
+    if (nThreads == 0)
+        nThreads = celestia::util::GetJobSystem()->threadCount();
+    if (lazyBodyPositionsCatalog != &lazyBodies || lazyBodyPositionsTime != now ||
+        lazyBodyPositions.size() != lazyBodies.size())
+    {
+        lazyBodies.computePositions(now, lazyBodyPositions, nThreads);
+        lazyBodyPositionsCatalog = inFrame ? &lazyBodies : nullptr;
+        lazyBodyPositionsTime = now;
+    }
+
+    Quaterniond toAstrocentric = tree->getDefaultReferenceFrame()->getOrientation(now).conjugate();
+    Vector3f viewMatZ = observer.getOrientationf().toRotationMatrix().row(2);
+    bool isLabeled = (translateLabelModeToClassMask(labelMode) & Body::Asteroid) != 0;
+    bool showOrbits = (renderFlags & ShowOrbits) != 0 && (orbitMask & Body::Asteroid) != 0;
+
+    std::vector<std::uint32_t> toCreate;
+    for (std::uint32_t i = 0; i < lazyBodies.size(); i++)
+    {
+        if (lazyBodies.getBody(i) != nullptr)
+            continue;
+
+        Vector3d pos_s = toAstrocentric * lazyBodyPositions[i];
+        Vector3d pos_v = pos_s - astrocentricObserverPos;
+        double dist_v = pos_v.norm();
+        float radius = lazyBodies.getRadius(i);
+
+        if (showOrbits &&
+            lazyBodies.getBoundingRadius(i) / (dist_v * pixelSize) > minOrbitSize)
+        {
+            toCreate.push_back(i);
+            continue;
+        }
+
+        if (viewFrustum.testSphere(pos_v.cast<float>(), radius) == Frustum::Outside)
+            continue;
+
+        float discSize = (radius / (float) dist_v) / pixelSize;
+        if (discSize > 1.0f)
+        {
+            toCreate.push_back(i);
+            continue;
+        }
+
+        // Same as Body::getApparentMagnitude
+        float appMag = 100.0f;
+        for (const auto& lightSource : lightSourceList)
+        {
+            Vector3d sunPos = pos_v - lightSource.position;
+            double distanceToSun = sunPos.norm();
+            auto illuminatedFraction = (float) (1.0 + (pos_v / dist_v).dot(sunPos / distanceToSun)) / 2.0f;
+            float lum = luminosityAtOpposition(lightSource.luminosity, (float) distanceToSun, radius) *
+                        lazyBodies.getReflectivity(i) * illuminatedFraction;
+            appMag = std::min(appMag, astro::lumToAppMag(lum, (float) astro::kilometersToLightYears(dist_v)));
+        }
+
+        if (appMag >= faintestPlanetMag)
+            continue;
+
+        if (isLabeled)
+        {
+            toCreate.push_back(i);
+            continue;
+        }
+
+        RenderListEntry rle;
+        rle.renderableType = RenderListEntry::RenderableLazyBody;
+        rle.body = nullptr;
+        rle.position = pos_v.cast<float>();
+        rle.sun = -pos_s.cast<float>();
+        rle.distance = (float) dist_v;
+        rle.centerZ = rle.position.dot(viewMatZ);
+        rle.radius = radius;
+        rle.discSizeInPixels = discSize;
+        rle.appMag = appMag;
+        rle.isOpaque = true;
+        renderList.push_back(rle);
+    }
+
+    // The nearest first, as they're the most noticeable
+    if (toCreate.size() > MaxCreatedPerFrame)
+    {
+        auto distance = [&](std::uint32_t i)
+        {
+            return (toAstrocentric * lazyBodyPositions[i] - astrocentricObserverPos).squaredNorm();
+        };
+        std::partial_sort(toCreate.begin(), toCreate.begin() + MaxCreatedPerFrame, toCreate.end(),
+                          [&](std::uint32_t a, std::uint32_t b) { return distance(a) < distance(b); });
+        toCreate.resize(MaxCreatedPerFrame);
+    }
+
+    for (auto i : toCreate)
+        lazyBodies.materialize(i);
+}
+
+
+// Evaluate the children of the tree in parallel: each of the ones which
+// are thread safe, along with its own tree, is a work item for the worker
+// threads. The rest are handled on the calling thread in the meantime.
+// Returns false, without doing anything, if there is too little parallel
+// work.
+bool Renderer::buildRenderListsParallel(const Vector3d& astrocentricObserverPos,
+                                        const Frustum& viewFrustum,
+                                        const Vector3d& viewPlaneNormal,
+                                        const Vector3d& frameCenter,
+                                        const FrameTree* tree,
+                                        const Observer& observer,
+                                        double now,
+                                        unsigned int nThreads)
+{
+    // Contiguous runs of thread safe children, split so that there are a
+    // few runs per thread to balance the load
+    struct ChildRange
+    {
+        unsigned int first;
+        unsigned int last;
+    };
+
+    unsigned int nChildren = tree->childCount();
+    const MinorBodyBVH* bvh = tree->getMinorBodyBVH();
+    std::vector<bool> threadSafe(nChildren);
+    std::vector<bool> culled(nChildren);
+    unsigned int safeBodies = 0;
+    for (unsigned int i = 0; i < nChildren; i++)
+    {
+        culled[i] = bvh != nullptr && bvh->isCulled(i, minorBodyCullStamp);
+        if (culled[i])
+            continue;
+
+        const TimelinePhase& phase = *tree->getChild(i);
+        threadSafe[i] = FrameTree::isThreadSafe(phase);
+        if (threadSafe[i])
+        {
+            const FrameTree* subtree = phase.body()->getFrameTree();
+            safeBodies += 1 + (subtree != nullptr ? subtree->bodyCount() : 0);
+        }
+    }
+
+    if (safeBodies < MinParallelRenderListBodies)
+        return false;
+
+    unsigned int maxRangeBodies = std::max(1u, safeBodies / (nThreads * 4));
+    std::vector<ChildRange> ranges;
+    unsigned int rangeBodies = 0;
+    bool continueRange = false;
+    for (unsigned int i = 0; i < nChildren; i++)
+    {
+        // Culled children in between don't break up a range; they're
+        // skipped again by the traversal.
+        if (culled[i])
+            continue;
 
-        if (body.getGeometry() != InvalidResource && rle.discSizeInPixels > 1)
+        if (!threadSafe[i])
         {
-            Geometry* geometry = GetGeometryManager()->find(body.getGeometry());
-            if (geometry == nullptr)
-                rle.isOpaque = true;
-            else
-                rle.isOpaque = geometry->isOpaque();
+            continueRange = false;
+            continue;
         }
-        else
+
+        if (!continueRange || rangeBodies >= maxRangeBodies)
         {
-            rle.isOpaque = true;
+            ranges.push_back({ i, i });
+            rangeBodies = 0;
         }
-        rle.radius = body.getRadius();
-        renderList.push_back(rle);
+
+        continueRange = true;
+        ranges.back().last = i + 1;
+        const FrameTree* subtree = tree->getChild(i)->body()->getFrameTree();
+        rangeBodies += 1 + (subtree != nullptr ? subtree->bodyCount() : 0);
     }
 
-    if (body.getClassification() == Body::Comet && (renderFlags & ShowCometTails) != 0)
+    if (renderListBatches.size() < ranges.size())
+        renderListBatches.resize(ranges.size());
+
+    std::atomic<std::size_t> nextRange{ 0 };
+    auto worker = [&]()
     {
-        float radius = cometDustTailLength(rle.sun.norm(), body.getRadius());
-        float discSize = (radius / rle.distance) / pixelSize;
-        if (discSize > 1)
+        for (;;)
         {
-            rle.renderableType = RenderListEntry::RenderableCometTail;
-            rle.body = &body;
-            rle.isOpaque = false;
-            rle.radius = radius;
-            rle.discSizeInPixels = discSize;
-            renderList.push_back(rle);
+            std::size_t n = nextRange.fetch_add(1, std::memory_order_relaxed);
+            if (n >= ranges.size())
+                break;
+
+            RenderListBatch& batch = renderListBatches[n];
+            batch.renderList.clear();
+            batch.secondaryIlluminators.clear();
+            buildRenderLists(astrocentricObserverPos, viewFrustum, viewPlaneNormal,
+                             frameCenter, tree, ranges[n].first, ranges[n].last,
+                             observer, now, &batch);
+        }
+    };
+
+    // The workers run as jobs while this thread builds the lists of the
+    // bodies which aren't thread safe
+    celestia::util::JobSystem* jobSystem = celestia::util::GetJobSystem();
+    celestia::util::JobSystem::Counter workers;
+    for (unsigned int i = 1; i < std::min(nThreads, static_cast<unsigned int>(ranges.size())); i++)
+        jobSystem->submit(worker, &workers);
+
+    for (unsigned int i = 0; i < nChildren; i++)
+    {
+        if (!threadSafe[i] && !culled[i])
+        {
+            buildRenderLists(astrocentricObserverPos, viewFrustum, viewPlaneNormal,
+                             frameCenter, tree, i, i + 1, observer, now, nullptr);
         }
     }
+    worker();
+    jobSystem->wait(workers);
 
-    const list<ReferenceMark*>* refMarks = body.getReferenceMarks();
-    if (refMarks != nullptr)
+    for (std::size_t n = 0; n < ranges.size(); n++)
     {
-        for (const auto rm : *refMarks)
+        RenderListBatch& batch = renderListBatches[n];
+        for (RenderListEntry& rle : batch.renderList)
         {
-            rle.renderableType = RenderListEntry::RenderableReferenceMark;
-            rle.refMark = rm;
-            rle.isOpaque = rm->isOpaque();
-            rle.radius = rm->boundingSphereRadius();
+            if (hasVisibleGeometry(rle))
+                rle.isOpaque = isGeometryOpaque(rle);
             renderList.push_back(rle);
         }
+        secondaryIlluminators.insert(secondaryIlluminators.end(),
+                                     batch.secondaryIlluminators.begin(),
+                                     batch.secondaryIlluminators.end());
     }
+
+    return true;
 }
 
 
+// Evaluate the children of the tree from firstChild up to lastChild, and
+// the trees below them. With a batch, the entries are added to it instead
+// of the render list; this is safe to run from a worker thread for the
+// children which are FrameTree::isThreadSafe.
 void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
                                 const Frustum& viewFrustum,
                                 const Vector3d& viewPlaneNormal,
                                 const Vector3d& frameCenter,
                                 const FrameTree* tree,
+                                unsigned int firstChild,
+                                unsigned int lastChild,
                                 const Observer& observer,
-                                double now)
+                                double now,
+                                RenderListBatch* batch)
 {
     int labelClassMask = translateLabelModeToClassMask(labelMode);
 
@@ -3369,10 +4383,14 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
     Vector3f viewMatZ = viewMat.row(2);
     double invCosViewAngle = 1.0 / cosViewConeAngle;
     double sinViewAngle = sqrt(1.0 - square(cosViewConeAngle));
+    const MinorBodyBVH* bvh = tree->getMinorBodyBVH();
 
-    unsigned int nChildren = tree != nullptr ? tree->childCount() : 0;
-    for (unsigned int i = 0; i < nChildren; i++)
+    for (unsigned int i = firstChild; i < lastChild; i++)
     {
+        // Skip the minor bodies which can't be visible
+        if (bvh != nullptr && bvh->isCulled(i, minorBodyCullStamp))
+            continue;
+
         auto phase = tree->getChild(i);
 
         // No need to do anything if the phase isn't active now
@@ -3384,10 +4402,26 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
         // pos_s: sun-relative position of object
         // pos_v: viewer-relative position of object
 
-        // Get the position of the body relative to the sun.
-        Vector3d p = phase->orbit()->positionAtTime(now);
-        auto frame = phase->orbitFrame();
-        Vector3d pos_s = frameCenter + frame->getOrientation(now).conjugate() * p;
+        // Get the position of the body relative to the sun. Views after
+        // the first of a frame find it in the cache.
+        Vector3d pos_s;
+        if (const auto* cached = GetBodyStateCache().find(body, now);
+            cached != nullptr && (cached->flags & BodyStateCache::AstrocentricPosition) != 0)
+        {
+            pos_s = cached->astrocentricPosition;
+        }
+        else
+        {
+            Vector3d p = phase->orbit()->positionAtTime(now);
+            auto frame = phase->orbitFrame();
+            pos_s = frameCenter + frame->getOrientation(now).conjugate() * p;
+
+            // The orbit, label and picking code look up the same position
+            // later in the frame; this only works on the thread running the
+            // frame.
+            if (batch == nullptr)
+                body->cacheAstrocentricPosition(now, pos_s);
+        }
 
         // We now have the positions of the observer and the planet relative
         // to the sun.  From these, compute the position of the body
@@ -3427,7 +4461,10 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
                         illum.body = body;
                         illum.position_v = pos_v;
                         illum.radius = body->getRadius();
-                        secondaryIlluminators.push_back(illum);
+                        if (batch == nullptr)
+                            secondaryIlluminators.push_back(illum);
+                        else
+                            batch->secondaryIlluminators.push_back(illum);
                     }
                 }
                 else
@@ -3490,7 +4527,7 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
                 // defined relative to the SSB.)
                 rle.sun = -pos_s.cast<float>();
 
-                addRenderListEntries(rle, *body, isLabeled);
+                addRenderListEntries(rle, *body, isLabeled, batch);
             }
         }
 
@@ -3568,13 +4605,20 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
 
             if (traverseSubtree)
             {
+                // The hierarchies are only updated on the render thread;
+                // elsewhere all of the subtree's bodies are considered.
+                if (batch == nullptr)
+                    cullMinorBodies(astrocentricObserverPos, viewFrustum, pos_s, subtree, now);
                 buildRenderLists(astrocentricObserverPos,
                                  viewFrustum,
                                  viewPlaneNormal,
                                  pos_s,
                                  subtree,
+                                 0,
+                                 subtree->childCount(),
                                  observer,
-                                 now);
+                                 now,
+                                 batch);
             }
         } // end subtree traverse
     }
@@ -3601,6 +4645,19 @@ void Renderer::buildOrbitLists(const Vector3d& astrocentricObserverPos,
 
         Body* body = phase->body();
 
+        // Only show orbits for major bodies or selected objects.
+        Body::VisibilityPolicy orbitVis = body->getOrbitVisibility();
+        bool showOrbit = body->isVisible() &&
+            (body == highlightObject.body() ||
+             orbitVis == Body::AlwaysVisible ||
+             (orbitVis == Body::UseClassVisibility && (body->getOrbitClassification() & orbitMask) != 0));
+
+        // The position isn't needed for bodies whose orbit isn't shown and
+        // have no satellites, most of the minor bodies.
+        const FrameTree* subtree = body->getFrameTree();
+        if (!showOrbit && subtree == nullptr)
+            continue;
+
         // pos_s: sun-relative position of object
         // pos_v: viewer-relative position of object
 
@@ -3612,13 +4669,7 @@ void Renderer::buildOrbitLists(const Vector3d& astrocentricObserverPos,
         // relative to the observer.
         Vector3d pos_v = pos_s - astrocentricObserverPos;
 
-        // Only show orbits for major bodies or selected objects.
-        Body::VisibilityPolicy orbitVis = body->getOrbitVisibility();
-
-        if (body->isVisible() &&
-            (body == highlightObject.body() ||
-             orbitVis == Body::AlwaysVisible ||
-             (orbitVis == Body::UseClassVisibility && (body->getOrbitClassification() & orbitMask) != 0)))
+        if (showOrbit)
         {
             Vector3d orbitOrigin = Vector3d::Zero();
             Selection centerObject = phase->orbitFrame()->getCenter();
@@ -3632,7 +4683,7 @@ void Renderer::buildOrbitLists(const Vector3d& astrocentricObserverPos,
 
             // Compute the size of the orbit in pixels
             double originDistance = pos_v.norm();
-            double boundingRadius = body->getOrbit(now)->getBoundingRadius();
+            double boundingRadius = phase->orbit()->getBoundingRadius();
             auto orbitRadiusInPixels = (float) (boundingRadius / (originDistance * pixelSize));
 
             if (orbitRadiusInPixels > minOrbitSize)
@@ -3649,7 +4700,6 @@ void Renderer::buildOrbitLists(const Vector3d& astrocentricObserverPos,
             }
         }
 
-        const FrameTree* subtree = body->getFrameTree();
         if (subtree != nullptr)
         {
             // Only try to render orbits of child objects when:
@@ -3718,26 +4768,32 @@ void Renderer::buildLabelLists(const Frustum& viewFrustum,
     Body* lastPrimary = nullptr;
     Sphered primarySphere;
 
-    for (auto &ri : renderList)
+    labelSpheres.clear();
+    for (const auto &ri : renderList)
+        labelSpheres.add(ri.position, ri.radius);
+    viewFrustum.testSpheres(labelSpheres, labelAspects);
+
+    for (std::size_t i = 0; i < renderList.size(); i++)
     {
+        auto &ri = renderList[i];
         if (ri.renderableType != RenderListEntry::RenderableBody)
             continue;
 
         if ((ri.body->getOrbitClassification() & labelClassMask) == 0)
             continue;
 
-        if (viewFrustum.testSphere(ri.position, ri.radius) == Frustum::Outside)
+        if (labelAspects[i] == Frustum::Outside)
             continue;
 
         const Body* body = ri.body;
-        auto boundingRadiusSize = (float) (body->getOrbit(now)->getBoundingRadius() / ri.distance) / pixelSize;
+        const auto& phase = body->getTimeline()->findPhase(now);
+        auto boundingRadiusSize = (float) (phase->orbit()->getBoundingRadius() / ri.distance) / pixelSize;
         if (boundingRadiusSize <= minOrbitSize)
             continue;
 
         if (body->getName().empty())
             continue;
 
-        auto phase = body->getTimeline()->findPhase(now);
         Body* primary = phase->orbitFrame()->getCenter().body();
         if (primary != nullptr && (primary->getClassification() & Body::Invisible) != 0)
         {
@@ -3892,6 +4948,7 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
 
     starRenderer.renderer          = this;
     starRenderer.starDB            = &starDB;
+    starRenderer.cullingData       = &starDB.getCullingData();
     starRenderer.observer          = &observer;
     starRenderer.obsPos            = obsPos;
     starRenderer.viewNormal        = observer.getOrientationf().conjugate() * -Vector3f::UnitZ();
@@ -3912,6 +4969,15 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
     starRenderer.labelThresholdMag = 1.2f * max(1.0f, (faintestMag - 4.0f) * (1.0f - 0.5f * (float) log10(effDistanceToScreen)));
 
     starRenderer.colorTemp = colorTemp;
+    starRenderer.starColors = m_starColorCache->getColors(starDB.getCullingData(), *colorTemp);
+    starRenderer.occluders = m_skyOccluders.empty() ? nullptr : &m_skyOccluders;
+    if (detailOptions.starBloom && !detailOptions.gpuStarCatalog)
+    {
+        if (m_starBloom == nullptr)
+            m_starBloom = std::make_unique<StarBloom>(*m_streamBuffer);
+        m_starBloom->clear();
+        starRenderer.bloom = m_starBloom.get();
+    }
 
     gaussianDiscTex->bind();
     starRenderer.starVertexBuffer->setTexture(gaussianDiscTex);
@@ -3931,25 +4997,76 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
     ps.blendFunc = {GL_SRC_ALPHA, GL_ONE};
     setPipelineState(ps);
 
-#ifdef OCTREE_DEBUG
-    m_starProcStats.nodes = 0;
-    m_starProcStats.height = 0;
-    m_starProcStats.objects = 0;
+    unsigned int nThreads = detailOptions.starRenderThreads;
+    if (nThreads == 0)
+        nThreads = celestia::util::GetJobSystem()->threadCount();
+
+#ifndef OCTREE_DEBUG
+    if (detailOptions.gpuStarCatalog)
+    {
+        m_gpuStarRenderer->render(starDB,
+                                  starRenderer,
+                                  observer,
+                                  faintestMagNight,
+                                  gaussianDiscTex,
+                                  gaussianGlareTex);
+    }
+    else if (nThreads > 1)
+    {
+        renderPointStarsParallel(starRenderer,
+                                 starDB,
+                                 faintestMagNight,
+                                 observer,
+                                 nThreads);
+    }
+    else
 #endif
-    starDB.findVisibleStars(starRenderer,
-                            obsPos.cast<float>(),
-                            observer.getOrientationf(),
-                            degToRad(fov),
-                            getAspectRatio(),
-                            faintestMagNight,
+    {
 #ifdef OCTREE_DEBUG
-                            &m_starProcStats);
+        m_starProcStats.nodes = 0;
+        m_starProcStats.height = 0;
+        m_starProcStats.objects = 0;
+        starDB.findVisibleStars(starRenderer,
+                                obsPos.cast<float>(),
+                                observer.getOrientationf(),
+                                degToRad(fov),
+                                getAspectRatio(),
+                                faintestMagNight,
+                                &m_starProcStats);
 #else
-                            nullptr);
+        StarHandler* handler = &starRenderer;
+        starDB.findVisibleStars(celestia::util::array_view<StarHandler*>(&handler, 1),
+                                obsPos.cast<float>(),
+                                observer.getOrientationf(),
+                                degToRad(fov),
+                                getAspectRatio(),
+                                faintestMagNight,
+                                *m_starVisibilityCache);
 #endif
+    }
+
+    if (PagedStarCatalog* pagedCatalog = starDB.getPagedCatalog(); pagedCatalog != nullptr)
+    {
+        // The paged stars aren't covered by the packed star properties
+        pagedCatalog->update();
+        starRenderer.cullingData = nullptr;
+        starDB.findVisiblePagedStars(starRenderer,
+                                     obsPos.cast<float>(),
+                                     observer.getOrientationf(),
+                                     degToRad(fov),
+                                     getAspectRatio(),
+                                     faintestMagNight);
+    }
 
     starRenderer.starVertexBuffer->finish();
     starRenderer.glareVertexBuffer->finish();
+
+    // Point sizes are still set by the vertex shader for the bloom
+    if (starRenderer.bloom != nullptr && !m_starBloom->render(*this))
+    {
+        GetLogger()->warn("Star bloom disabled, falling back to glare sprites.\n");
+        detailOptions.starBloom = false;
+    }
     PointStarVertexBuffer::disable();
 
 #ifndef GL_ES
@@ -3958,6 +5075,64 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
 #endif
 }
 
+void Renderer::renderPointStarsParallel(PointStarRenderer& starRenderer,
+                                        const StarDatabase& starDB,
+                                        float faintestMagNight,
+                                        const Observer& observer,
+                                        unsigned int nThreads)
+{
+    // The calling thread renders directly with starRenderer while the
+    // workers collect their output in batches, which are merged below.
+    while (starBatches.size() < nThreads - 1)
+        starBatches.push_back(std::make_unique<PointStarBatch>());
+
+    std::vector<PointStarRenderer> workers(nThreads - 1, starRenderer);
+    std::vector<StarHandler*> handlers;
+    handlers.reserve(nThreads);
+    handlers.push_back(&starRenderer);
+    for (unsigned int i = 0; i < nThreads - 1; i++)
+    {
+        starBatches[i]->clear();
+        workers[i].batch = starBatches[i].get();
+        handlers.push_back(&workers[i]);
+    }
+
+    starDB.findVisibleStars(handlers,
+                            observer.getPosition().toLy().cast<float>(),
+                            observer.getOrientationf(),
+                            degToRad(fov),
+                            getAspectRatio(),
+                            faintestMagNight,
+                            *m_starVisibilityCache);
+
+    for (unsigned int i = 0; i < nThreads - 1; i++)
+    {
+        const PointStarBatch& batch = *starBatches[i];
+        for (const auto& v : batch.glares)
+        {
+            if (starRenderer.bloom != nullptr)
+                starRenderer.bloom->addStar(v.position, v.color, v.size);
+            else
+                glareVertexBuffer->addStar(v.position, v.color, v.size);
+        }
+        for (const auto& v : batch.stars)
+            pointStarVertexBuffer->addStar(v.position, v.color, v.size);
+        for (const auto& label : batch.labels)
+        {
+            addBackgroundAnnotation(nullptr,
+                                    labelCache.getStarLabel(starDB, *label.star),
+                                    label.color,
+                                    label.position,
+                                    LabelHorizontalAlignment::Start,
+                                    LabelVerticalAlignment::Bottom,
+                                    0.0f,
+                                    -label.appMag);
+        }
+        for (const auto& d : batch.deferred)
+            starRenderer.process(*d.star, d.distance, d.appMag);
+    }
+}
+
 void Renderer::renderDeepSkyObjects(const Universe& universe,
                                     const Observer& observer,
                                     const float     faintestMagNight)
@@ -3980,6 +5155,7 @@ void Renderer::renderDeepSkyObjects(const Universe& universe,
     dsoRenderer.faintestMag      = faintestMag;
     dsoRenderer.renderFlags      = renderFlags;
     dsoRenderer.labelMode        = labelMode;
+    dsoRenderer.occluders        = m_skyOccluders.empty() ? nullptr : &m_skyOccluders;
 
     dsoRenderer.frustum = Frustum(degToRad(fov),
                                   getAspectRatio(),
@@ -4002,18 +5178,52 @@ void Renderer::renderDeepSkyObjects(const Universe& universe,
     m_dsoProcStats.height = 0;
 #endif
 
+    dsoRenderer.queueInstances = true;
+
+#ifdef OCTREE_DEBUG
     dsoDB->findVisibleDSOs(dsoRenderer,
                            obsPos,
                            observer.getOrientationf(),
                            degToRad(fov),
                            getAspectRatio(),
                            2 * faintestMagNight,
-#ifdef OCTREE_DEBUG
                            &m_dsoProcStats);
 #else
-                            nullptr);
+    unsigned int nThreads = detailOptions.dsoRenderThreads;
+    if (nThreads == 0)
+        nThreads = celestia::util::GetJobSystem()->threadCount();
+
+    // As for the stars, the calling thread renders directly with
+    // dsoRenderer while the workers only collect the visible DSOs, which
+    // are rendered below.
+    std::vector<std::vector<VisibleDSO>> visibleDSOs(nThreads - 1);
+    std::vector<DSORenderer> workers(nThreads - 1, dsoRenderer);
+    std::vector<DSOHandler*> handlers;
+    handlers.reserve(nThreads);
+    handlers.push_back(&dsoRenderer);
+    for (unsigned int i = 0; i < nThreads - 1; i++)
+    {
+        workers[i].visibleDSOs = &visibleDSOs[i];
+        handlers.push_back(&workers[i]);
+    }
+
+    dsoDB->findVisibleDSOs(handlers,
+                           obsPos,
+                           observer.getOrientationf(),
+                           degToRad(fov),
+                           getAspectRatio(),
+                           2 * faintestMagNight);
+
+    for (const auto& batch : visibleDSOs)
+    {
+        for (const VisibleDSO& visible : batch)
+            dsoRenderer.render(visible);
+    }
 #endif
 
+    Galaxy::renderQueued(observer.getOrientationf(), this);
+    Globular::renderQueued(observer.getOrientationf(), fov, this);
+
     // clog << "DSOs processed: " << dsoRenderer.dsosProcessed << endl;
 }
 
@@ -4028,7 +5238,7 @@ void Renderer::renderSkyGrids(const Observer& observer)
 {
     if ((renderFlags & ShowCelestialSphere) != 0)
     {
-        SkyGrid grid;
+        SkyGrid& grid = *m_skyGrids[0];
         grid.setOrientation(Quaterniond(AngleAxis<double>(astro::J2000Obliquity, Vector3d::UnitX())));
         grid.setLineColor(EquatorialGridColor);
         grid.setLabelColor(EquatorialGridLabelColor);
@@ -4037,7 +5247,7 @@ void Renderer::renderSkyGrids(const Observer& observer)
 
     if ((renderFlags & ShowGalacticGrid) != 0)
     {
-        SkyGrid galacticGrid;
+        SkyGrid& galacticGrid = *m_skyGrids[1];
         galacticGrid.setOrientation((astro::eclipticToEquatorial() * astro::equatorialToGalactic()).conjugate());
         galacticGrid.setLineColor(GalacticGridColor);
         galacticGrid.setLabelColor(GalacticGridLabelColor);
@@ -4047,7 +5257,7 @@ void Renderer::renderSkyGrids(const Observer& observer)
 
     if ((renderFlags & ShowEclipticGrid) != 0)
     {
-        SkyGrid grid;
+        SkyGrid& grid = *m_skyGrids[2];
         grid.setOrientation(Quaterniond::Identity());
         grid.setLineColor(EclipticGridColor);
         grid.setLabelColor(EclipticGridLabelColor);
@@ -4063,7 +5273,7 @@ void Renderer::renderSkyGrids(const Observer& observer)
 
         if (body != nullptr)
         {
-            SkyGrid grid;
+            SkyGrid& grid = *m_skyGrids[3];
             grid.setLineColor(HorizonGridColor);
             grid.setLabelColor(HorizonGridLabelColor);
             grid.setLongitudeUnits(SkyGrid::LongitudeDegrees);
@@ -4175,9 +5385,11 @@ Renderer::renderAnnotationMarker(const Annotation &a,
     Matrix4f mv = celmath::translate(*m.modelview, (float)(int)a.position.x(), (float)(int)a.position.y(), depth);
     Matrices mm = { m.projection, &mv };
 
+    // Hollow symbols are drawn together by renderMarkerBatch()
     if (markerRep.symbol() == celestia::MarkerRepresentation::Crosshair)
         renderCrosshair(size, realTime, a.color, mm);
-    else
+    else if (!addMarkerToBatch(markerRep.symbol(), size, markerRep.color(),
+                               Vector3f((float)(int)a.position.x(), (float)(int)a.position.y(), depth)))
         markerRep.render(*this, size, mm);
 
     if (!markerRep.label().empty())
@@ -4212,7 +5424,10 @@ Renderer::renderAnnotationLabel(const Annotation &a,
 
     layout.begin(*m.projection, mv);
     layout.moveAbsolute(0.0f, 0.0f);
-    layout.render(a.labelText);
+    if (a.label != nullptr)
+        layout.render(a.label->shaped);
+    else
+        layout.render(a.labelText);
     layout.end();
 }
 
@@ -4224,29 +5439,119 @@ void Renderer::renderAnnotations(const vector<Annotation>& annotations,
     if (font == nullptr)
         return;
 
+    ProfileScope scope(*m_profiler, ProfilePass::Annotations);
+
     TextLayout layout{ screenDpi };
     layout.setFont(font);
 
     Matrix4f mv = Matrix4f::Identity();
     Matrices m = { &m_orthoProjMatrix, &mv };
 
-    for (int i = 0; i < (int) annotations.size(); i++)
+    for (const auto& a : annotations)
     {
-        if (annotations[i].markerRep != nullptr)
-        {
-            renderAnnotationMarker(annotations[i], layout, 0.0f, m);
-        }
+        if (a.markerRep != nullptr)
+            renderAnnotationMarker(a, layout, 0.0f, m);
+    }
+    renderMarkerBatch(m);
 
-        if (!annotations[i].labelText.empty())
-        {
-            TextLayout::HorizontalAlignment alignment = TextLayout::HorizontalAlignment::Left;
-            float hOffset = 0.0f;
-            float vOffset = 0.0f;
+    // The labels are all at the same depth, so they are drawn after the
+    // markers in a single batch, each with its color in the vertices
+    layout.begin(m_orthoProjMatrix);
+    for (const auto& a : annotations)
+    {
+        if (!a.hasLabel())
+            continue;
+
+        TextLayout::HorizontalAlignment alignment = TextLayout::HorizontalAlignment::Left;
+        float hOffset = 0.0f;
+        float vOffset = 0.0f;
+        getLabelAlignmentInfo(a, font.get(), alignment, hOffset, vOffset);
+
+        layout.setHorizontalAlignment(alignment);
+        layout.moveAbsolute((int)a.position.x() + hOffset + PixelOffset,
+                            (int)a.position.y() + vOffset + PixelOffset);
+        layout.setColor(a.color);
+        if (a.label != nullptr)
+            layout.render(a.label->shaped);
+        else
+            layout.render(a.labelText);
+        layout.finishLine();
+    }
+    layout.end();
+}
 
-            getLabelAlignmentInfo(annotations[i], font.get(), alignment, hOffset, vOffset);
 
-            layout.setHorizontalAlignment(alignment);
-            renderAnnotationLabel(annotations[i], layout, hOffset, vOffset, 0.0f, m);
+// The box covered by the label of an annotation, as placed by
+// renderAnnotations
+celestia::engine::LabelGrid::Box
+Renderer::getLabelBox(const Annotation& a, const TextureFont* font) const
+{
+    TextLayout::HorizontalAlignment alignment = TextLayout::HorizontalAlignment::Left;
+    float hOffset = 0.0f;
+    float vOffset = 0.0f;
+    getLabelAlignmentInfo(a, font, alignment, hOffset, vOffset);
+
+    int width = 0;
+    std::size_t lines = 1;
+    if (a.label != nullptr)
+    {
+        for (const auto& line : a.label->shaped.lines)
+            width = std::max(width, font->getWidth(line));
+        lines = std::max(a.label->shaped.lines.size(), lines);
+    }
+    else
+    {
+        width = TextLayout::getTextWidth(a.labelText, font);
+        lines += std::count(a.labelText.begin(), a.labelText.end(), '\n');
+    }
+
+    float x = (int)a.position.x() + hOffset + PixelOffset;
+    float y = (int)a.position.y() + vOffset + PixelOffset;
+    if (alignment == TextLayout::HorizontalAlignment::Right)
+        x -= static_cast<float>(width);
+    else if (alignment == TextLayout::HorizontalAlignment::Center)
+        x -= static_cast<float>(width) / 2.0f;
+
+    return { x,
+             y - static_cast<float>(font->getMaxDescent()) - static_cast<float>((lines - 1) * font->getHeight()),
+             x + static_cast<float>(width),
+             y + static_cast<float>(font->getMaxAscent()) };
+}
+
+
+// Hide the labels which overlap one of a higher priority, or one shown
+// whatever its priority. The markers are kept.
+void Renderer::declutterAnnotations(vector<Annotation>& annotations, FontStyle fs)
+{
+    auto font = getFont(fs);
+    if (font == nullptr)
+        return;
+
+    labelOrder.clear();
+    for (std::uint32_t i = 0; i < static_cast<std::uint32_t>(annotations.size()); i++)
+    {
+        if (annotations[i].hasLabel())
+            labelOrder.push_back(i);
+    }
+    std::stable_sort(labelOrder.begin(), labelOrder.end(),
+                     [&annotations](std::uint32_t i0, std::uint32_t i1)
+                     {
+                         return annotations[i0].priority > annotations[i1].priority;
+                     });
+
+    labelGrid.reset(windowWidth, windowHeight);
+    for (std::uint32_t i : labelOrder)
+    {
+        Annotation& a = annotations[i];
+        auto box = getLabelBox(a, font.get());
+        if (a.priority == AnnotationAlwaysShown)
+        {
+            labelGrid.add(box);
+        }
+        else if (!labelGrid.tryAdd(box))
+        {
+            a.label = nullptr;
+            a.labelText = {};
         }
     }
 }
@@ -4262,6 +5567,8 @@ Renderer::renderBackgroundAnnotations(FontStyle fs)
     ps.smoothLines = true;
     setPipelineState(ps);
 
+    if (detailOptions.declutterLabels)
+        declutterAnnotations(backgroundAnnotations, fs);
     renderAnnotations(backgroundAnnotations, fs);
     backgroundAnnotations.clear();
 }
@@ -4313,6 +5620,8 @@ Renderer::renderAnnotations(vector<Annotation>::iterator startIter,
     if (font == nullptr)
         return endIter;
 
+    ProfileScope scope(*m_profiler, ProfilePass::Annotations);
+
     TextLayout layout{ screenDpi };
     layout.setFont(font);
 
@@ -4332,16 +5641,25 @@ Renderer::renderAnnotations(vector<Annotation>::iterator startIter,
     vector<Annotation>::iterator iter = startIter;
     for (; iter != endIter && iter->position.z() > nearDist; ++iter)
     {
-        // Compute normalized device z
-        float z = fisheye ? (1.0f - (iter->position.z() - nearDist) / d0 * 2.0f) : (d1 + d2 / -iter->position.z());
-        float ndc_z = std::clamp(z, -1.0f, 1.0f);
+        // Compute normalized device z; the orthographic projection negates
+        // it, and with reverse depth the clip range is [0, 1].
+        float ndc_z;
+        if (m_depthReversed)
+        {
+            ndc_z = std::clamp(-nearDist / iter->position.z(), -1.0f, 0.0f);
+        }
+        else
+        {
+            float z = fisheye ? (1.0f - (iter->position.z() - nearDist) / d0 * 2.0f) : (d1 + d2 / -iter->position.z());
+            ndc_z = std::clamp(z, -1.0f, 1.0f);
+        }
 
         if (iter->markerRep != nullptr)
         {
             renderAnnotationMarker(*iter, layout, ndc_z, m);
         }
 
-        if (!iter->labelText.empty())
+        if (iter->hasLabel())
         {
             TextLayout::HorizontalAlignment alignment = TextLayout::HorizontalAlignment::Left;
             float labelHOffset = 0.0f;
@@ -4353,6 +5671,7 @@ Renderer::renderAnnotations(vector<Annotation>::iterator startIter,
             renderAnnotationLabel(*iter, layout, labelHOffset, labelVOffset, ndc_z, m);
         }
     }
+    renderMarkerBatch(m);
 
     return iter;
 }
@@ -4403,7 +5722,7 @@ void Renderer::markersToAnnotations(const celestia::MarkerList& markers,
                 }
             }
 
-            addAnnotation(*a, &(marker.representation()), "",
+            addAnnotation(*a, &(marker.representation()), "", nullptr,
                           marker.representation().color(),
                           offset.cast<float>(),
                           LabelHorizontalAlignment::Start, LabelVerticalAlignment::Top, symbolSize);
@@ -4429,8 +5748,9 @@ void Renderer::loadTextures(Body* body)
 {
     Surface& surface = body->getSurface();
 
+    Texture* baseTex = nullptr;
     if (surface.baseTexture.tex[textureResolution] != InvalidResource)
-        surface.baseTexture.find(textureResolution);
+        baseTex = surface.baseTexture.find(textureResolution);
     if ((surface.appearanceFlags & Surface::ApplyBumpMap) != 0 &&
         surface.bumpTexture.tex[textureResolution] != InvalidResource)
         surface.bumpTexture.find(textureResolution);
@@ -4438,7 +5758,8 @@ void Renderer::loadTextures(Body* body)
         (renderFlags & ShowNightMaps) != 0)
         surface.nightTexture.find(textureResolution);
     if ((surface.appearanceFlags & Surface::SeparateSpecularMap) != 0 &&
-        surface.specularTexture.tex[textureResolution] != InvalidResource)
+        surface.specularTexture.tex[textureResolution] != InvalidResource &&
+        !hasPackedAlpha(baseTex))
         surface.specularTexture.find(textureResolution);
 
     if ((renderFlags & ShowCloudMaps) != 0 &&
@@ -4467,7 +5788,12 @@ void Renderer::loadTextures(Body* body)
 
 void Renderer::invalidateOrbitCache()
 {
+    for (const auto& [orbit, plot] : orbitCache)
+        delete plot;
     orbitCache.clear();
+    pendingOrbits.clear();
+    if (orbitSampler != nullptr)
+        orbitSampler->clear();
 }
 
 
@@ -4480,6 +5806,26 @@ bool Renderer::settingsHaveChanged() const
 void Renderer::markSettingsChanged()
 {
     settingsChanged = true;
+    if (settingsBatchDepth > 0)
+        settingsBatchChanged = true;
+    else
+        notifyWatchers();
+}
+
+
+void Renderer::beginSettingsBatch()
+{
+    settingsBatchDepth++;
+}
+
+
+void Renderer::endSettingsBatch()
+{
+    assert(settingsBatchDepth > 0);
+    if (--settingsBatchDepth > 0 || !settingsBatchChanged)
+        return;
+
+    settingsBatchChanged = false;
     notifyWatchers();
 }
 
@@ -4752,6 +6098,7 @@ static void draw_rectangle_solid(const Renderer &renderer,
     prog->setMVPMatrices(p, m);
 
     glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+    celestia::render::countDrawCall(GL_TRIANGLE_FAN, 4);
 
     glDisableVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex);
     if (r.tex != nullptr)
@@ -4872,6 +6219,21 @@ bool Renderer::getInfo(map<string, string>& info) const
     info["MaxCubeMapSize"] = to_string(maxCubeMapSize);
 #endif
 
+    info["TextureMemory"] = to_string(render::getTextureMemory(render::TextureMemoryCategory::Textures) >> 20);
+    info["FontTextureMemory"] = to_string(render::getTextureMemory(render::TextureMemoryCategory::Fonts) >> 20);
+    info["FramebufferMemory"] = to_string(render::getTextureMemory(render::TextureMemoryCategory::Framebuffers) >> 20);
+    if (detailOptions.textureMemoryBudget != 0)
+    {
+        info["TextureMemoryBudget"] = to_string(detailOptions.textureMemoryBudget >> 20);
+        info["TexturesEvicted"] = to_string(texturesEvicted);
+        info["MaxTextureResolution"] = to_string(MultiResTexture::getMaxResolution());
+    }
+
+    celestia::util::MemoryReport memoryReport;
+    addMemoryUsage(memoryReport);
+    for (const auto& entry : memoryReport.getEntries())
+        info["Memory." + entry.category] = to_string(entry.bytes);
+
     s = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
     if (s != nullptr)
         info["Extensions"] = s;
@@ -4879,6 +6241,29 @@ bool Renderer::getInfo(map<string, string>& info) const
     return true;
 }
 
+void Renderer::addMemoryUsage(celestia::util::MemoryReport& report) const
+{
+    std::size_t orbitBytes = 0;
+    for (const auto& [orbit, plot] : orbitCache)
+        orbitBytes += plot->getMemoryUsage();
+    report.add("Orbit cache", orbitBytes, orbitCache.size());
+
+    auto [nModels, modelBytes] = GetGeometryManager()->getLoadedSize(
+        [](const Geometry& geometry) { return geometry.getMemoryUsage(); });
+    report.add("Models", modelBytes, nModels);
+
+    auto [nTrajectories, trajectoryBytes] = GetTrajectoryManager()->getLoadedSize(
+        [](const celestia::ephem::Orbit& trajectory) { return trajectory.getMemoryUsage(); });
+    report.add("Trajectories", trajectoryBytes, nTrajectories);
+
+    // The images of the textures are only kept by the driver, so these are
+    // estimates of video memory, including the virtual texture tiles
+    std::size_t nTextures = GetTextureManager()->getLoadedSize([](const Texture&) { return 0; }).first;
+    report.add("Textures (GPU)", render::getTextureMemory(render::TextureMemoryCategory::Textures), nTextures);
+    report.add("Font textures (GPU)", render::getTextureMemory(render::TextureMemoryCategory::Fonts));
+    report.add("Framebuffers (GPU)", render::getTextureMemory(render::TextureMemoryCategory::Framebuffers));
+}
+
 VertexObject&
 Renderer::getVertexObject(VOType owner, GLenum /*type*/, GLsizeiptr size, GLenum stream)
 {
@@ -4889,37 +6274,63 @@ Renderer::getVertexObject(VOType owner, GLenum /*type*/, GLsizeiptr size, GLenum
     return *m_VertexObjects[i];
 }
 
-FramebufferObject*
-Renderer::getShadowFBO(int index) const
+unsigned int
+Renderer::getShadowMapSize(int cascade) const
 {
-    return index == 0 ? m_shadowFBO.get() : nullptr;
+    return cascade == 0 ? m_shadowMapSize : m_cascadeShadowMapSize;
 }
 
-void
-Renderer::createShadowFBO()
+Renderer::ShadowMap*
+Renderer::getShadowMap(const Geometry* caster,
+                       int lightIndex,
+                       int cascade,
+                       const ShadowMapCache::View& view,
+                       bool animated,
+                       bool& needsRender)
 {
-    m_shadowFBO = std::make_unique<FramebufferObject>(m_shadowMapSize,
-                                                      m_shadowMapSize,
-                                                      FramebufferObject::DepthAttachment);
-    if (!m_shadowFBO->isValid())
+    // Without a cache, the maps are only kept for the object being drawn
+    bool keep = detailOptions.shadowMapCacheSize != 0 && !animated;
+    ShadowMapCache::Slot slot = m_shadowMapCache->find(caster, lightIndex, cascade, view, !keep, frameCount);
+    ShadowMap& map = m_shadowMaps[slot.index];
+    needsRender = slot.needsRender;
+    if (map.fbo == nullptr || map.fbo->width() != view.size)
     {
-        GetLogger()->warn("Error creating shadow FBO.\n");
-        m_shadowFBO = nullptr;
+        map.fbo = std::make_unique<FramebufferObject>(view.size, view.size,
+                                                      FramebufferObject::DepthAttachment);
+        if (!map.fbo->isValid())
+        {
+            GetLogger()->warn("Error creating shadow FBO.\n");
+            resizeShadowMap(0);
+            return nullptr;
+        }
+        needsRender = true;
     }
+
+    return &map;
 }
 
 void
 Renderer::setShadowMapSize(unsigned size)
+{
+    m_fullShadowMapSize = size;
+    resizeShadowMap(qualityGovernor.shadowMapSize(size));
+}
+
+void
+Renderer::resizeShadowMap(unsigned size)
 {
     if (!FramebufferObject::isSupported())
         return;
     m_shadowMapSize = std::min(size, static_cast<unsigned>(gl::maxTextureSize));
-    if (m_shadowFBO != nullptr && m_shadowMapSize == m_shadowFBO->width())
-        return;
-    if (m_shadowMapSize == 0)
-        m_shadowFBO = nullptr;
-    else
-        createShadowFBO();
+    m_cascadeShadowMapSize = m_shadowMapSize == 0
+        ? 0u
+        : std::min(qualityGovernor.shadowMapSize(detailOptions.shadowCascadeSize),
+                   static_cast<unsigned>(gl::maxTextureSize));
+
+    // The maps are created again at the new size when they're next used
+    m_shadowMapCache->clear();
+    for (ShadowMap& map : m_shadowMaps)
+        map.fbo = nullptr;
 }
 
 void
@@ -4944,6 +6355,7 @@ Renderer::removeInvisibleItems(const Frustum &frustum)
 
         case RenderListEntry::RenderableCometTail:
         case RenderListEntry::RenderableReferenceMark:
+        case RenderListEntry::RenderableLazyBody:
             radius = ri.radius;
             cullRadius = radius;
             convex = false;
@@ -5040,7 +6452,8 @@ Renderer::removeInvisibleItems(const Frustum &frustum)
     // ideal for performance; should render opaque objects front to
     // back, then translucent objects back to front. However, the
     // amount of overdraw in Celestia is typically low.)
-    sort(renderList.begin(), renderList.end());
+    renderListSorter.sort(renderList,
+                          [](const RenderListEntry& rle) { return util::FloatSortKey(rle.radius - rle.centerZ); });
 }
 
 bool
@@ -5146,22 +6559,40 @@ Renderer::buildNearSystemsLists(const Universe &universe,
     UniversalCoord observerPos = observer.getPosition();
     Eigen::Quaterniond observerOrient = observer.getOrientation();
 
-    universe.getNearStars(observerPos, SolarSystemMaxDistance, nearStars);
+    if (!nearStarsValid || nearStarsTime != now ||
+        !observerPos.offsetFromKm(nearStarsPosition).isZero(0.0))
+    {
+        nearStars.clear();
+        universe.getNearStars(observerPos, SolarSystemMaxDistance, nearStars);
+        nearStarsValid = inFrame;
+        nearStarsPosition = observerPos;
+        nearStarsTime = now;
+
+        // The high precision subtraction, and the evaluation of the orbits
+        // of the stars, done once for the light sources, the render lists
+        // and the star and comet renderers
+        std::vector<UniversalCoord> nearStarPositions;
+        nearStarPositions.reserve(nearStars.size());
+        for (const Star* star : nearStars)
+            nearStarPositions.push_back(star->getPosition(now));
+        nearStarOffsets.resize(nearStars.size());
+        UniversalCoord::offsetsFromKm(observerPos, nearStarPositions, nearStarOffsets.data());
+    }
 
     // Set up direct light sources (i.e. just stars at the moment)
     // Skip if only star orbits to be shown
     if ((renderFlags & ShowSolarSystemObjects) != 0)
         setupLightSources(nearStars,
-                          observerPos,
-                          now,
+                          nearStarOffsets,
                           lightSourceList,
                           tintSaturation,
                           colorTemp->type() == ColorTableType::Blackbody_D65);
 
     // Traverse the frame trees of each nearby solar system and
     // build the list of objects to be rendered.
-    for (const auto sun : nearStars)
+    for (std::size_t i = 0; i < nearStars.size(); i++)
     {
+        const Star* sun = nearStars[i];
         addStarOrbitToRenderList(*sun, observer, now);
         // Skip if only star orbits to be shown
         if ((renderFlags & ShowSolarSystemObjects) == 0)
@@ -5183,12 +6614,17 @@ Renderer::buildNearSystemsLists(const Universe &universe,
         }
 
         // Compute the position of the observer in astrocentric coordinates
-        Vector3d astrocentricObserverPos = astrocentricPosition(observerPos, *sun, now);
+        Vector3d astrocentricObserverPos = -nearStarOffsets[i];
 
         // Build render lists for bodies and orbits paths
         buildRenderLists(astrocentricObserverPos, xfrustum,
                          observerOrient.conjugate() * -Vector3d::UnitZ(),
                          Vector3d::Zero(), solarSysTree, observer, now);
+        if (LazyBodyCatalog* lazyBodies = solarSystem->getPlanets()->getLazyBodies(); lazyBodies != nullptr)
+        {
+            buildLazyBodyLists(astrocentricObserverPos, xfrustum, observer,
+                               solarSysTree, *lazyBodies, now);
+        }
         if ((renderFlags & ShowOrbits) != 0)
         {
             buildOrbitLists(astrocentricObserverPos, observerOrient,
@@ -5343,11 +6779,61 @@ Renderer::buildDepthPartitions()
     return nIntervals;
 }
 
+int
+Renderer::buildReverseDepthPartition()
+{
+    // A floating point depth buffer with a reversed projection has about
+    // the same relative precision at all distances, so a single partition
+    // holds everything. It spans the same range as the partitions above,
+    // but starts at the minimum near plane distance.
+    depthPartitions.clear();
+
+    DepthBufferPartition partition;
+    partition.index = 0;
+    partition.nearZ = -MinNearPlaneDistance;
+    partition.farZ = renderList.empty() ? -1e12f : renderList.back().farZ * 1.01f;
+    if (!orbitPathList.empty())
+    {
+        partition.farZ = min(partition.farZ,
+                             orbitPathList.back().centerZ - orbitPathList.back().radius);
+    }
+    depthPartitions.push_back(partition);
+
+    return 1;
+}
+
+void
+Renderer::buildSkyOccluders()
+{
+    // Only bodies covering a good part of the view are worth testing the
+    // stars and DSOs against. The render list holds just the solar system
+    // objects at this point, so everything tested is far behind them.
+    m_skyOccluders.clear();
+    for (const RenderListEntry& rle : renderList)
+    {
+        if (rle.renderableType != RenderListEntry::RenderableBody || !rle.isOpaque ||
+            rle.discSizeInPixels < MinSkyOccluderSize || !rle.body->isEllipsoid())
+            continue;
+
+        m_skyOccluders.add(rle.position, rle.body->getSemiAxes().minCoeff());
+    }
+}
+
 void
 Renderer::renderSolarSystemObjects(const Observer &observer,
                                    int nIntervals,
                                    double now)
 {
+    if (m_reverseDepthView)
+    {
+        // Everything drawn so far is in the background
+        Renderer::PipelineState ps;
+        ps.depthMask = true;
+        setPipelineState(ps);
+        setDepthReversed(true);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
     // Render everything that wasn't culled.
     auto annotation = depthSortedAnnotations.begin();
     float intervalSize = 1.0f / static_cast<float>(max(1, nIntervals));
@@ -5371,6 +6857,8 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
         Matrix4f proj;
         if (getProjectionMode() == Renderer::ProjectionMode::FisheyeMode)
             proj = Ortho(-aspectRatio, aspectRatio, -1.0f, 1.0f, nearPlaneDistance, farPlaneDistance);
+        else if (m_reverseDepthView)
+            proj = ReverseInfinitePerspective(fov, aspectRatio, nearPlaneDistance);
         else
             proj = Perspective(fov, aspectRatio, nearPlaneDistance, farPlaneDistance);
         Matrices m = { &proj, &m_modelMatrix };
@@ -5384,25 +6872,62 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
 
         int firstInInterval = i;
 
-        // Render just the opaque objects in the first pass
-        while (i >= 0 && renderList[i].farZ < depthPartitions[interval].nearZ)
         {
-            // This interval should completely contain the item
-            // Unless it's just a point?
-            // assert(renderList[i].nearZ <= depthPartitions[interval].near);
+            ProfileScope scope(*m_profiler, ProfilePass::SolarSystemObjects);
+
+            // Render just the opaque objects in the first pass
+            opaqueItems.clear();
+            orderedOpaqueItems.clear();
+            while (i >= 0 && renderList[i].farZ < depthPartitions[interval].nearZ)
+            {
+                // This interval should completely contain the item
+                // Unless it's just a point?
+                // assert(renderList[i].nearZ <= depthPartitions[interval].near);
+
+                // Treat objects that are smaller than one pixel as transparent and
+                // render them in the second pass.
+                if (renderList[i].isOpaque && renderList[i].discSizeInPixels > 1.0f)
+                {
+                    if (isStateSortable(renderList[i]))
+                        opaqueItems.push_back(&renderList[i]);
+                    else
+                        orderedOpaqueItems.push_back(&renderList[i]);
+                }
 
-            // Treat objects that are smaller than one pixel as transparent and
-            // render them in the second pass.
-            if (renderList[i].isOpaque && renderList[i].discSizeInPixels > 1.0f)
-                renderItem(renderList[i], observer, nearPlaneDistance, farPlaneDistance, m);
+                i--;
+            }
 
-            i--;
+            // The depth test makes the order of fully opaque bodies irrelevant,
+            // so they're drawn first, grouped by model and texture to save
+            // state changes. Objects with translucent parts follow in depth
+            // order, so that those parts blend over everything behind them.
+            std::stable_sort(opaqueItems.begin(), opaqueItems.end(),
+                             [this](const RenderListEntry* rle0, const RenderListEntry* rle1)
+                             { return getStateSortKey(*rle0) < getStateSortKey(*rle1); });
+            // Bodies sharing a model are drawn together by instancing where
+            // they can be.
+            for (std::size_t k = 0; k < opaqueItems.size();)
+            {
+                std::size_t nDrawn = renderModelInstances(opaqueItems, k, observer, nearPlaneDistance, m);
+                if (nDrawn == 0)
+                {
+                    renderItem(*opaqueItems[k], observer, nearPlaneDistance, farPlaneDistance, m);
+                    nDrawn = 1;
+                }
+                k += nDrawn;
+            }
+            for (const RenderListEntry* rle : orderedOpaqueItems)
+                renderItem(*rle, observer, nearPlaneDistance, farPlaneDistance, m);
         }
 
         // Render orbit paths
         if (!orbitPathList.empty())
         {
-            // Scan through the list of orbits and render any that overlap this interval
+            ProfileScope scope(*m_profiler, ProfilePass::Orbits);
+
+            // Scan through the list of orbits and render any that overlap this
+            // interval; they're all drawn together once the scan is done.
+            CurvePlot::beginBatch(*this);
             for (const auto& orbit : orbitPathList)
             {
                 // Test for overlap
@@ -5420,35 +6945,48 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
                                 farPlaneDistance);
                 }
             }
+            CurvePlot::endBatch();
         }
 
-        // Render transparent objects in the second pass
-        i = firstInInterval;
-        while (i >= 0 && renderList[i].farZ < depthPartitions[interval].nearZ)
         {
-            if (!renderList[i].isOpaque || renderList[i].discSizeInPixels <= 1.0f)
-                renderItem(renderList[i], observer, nearPlaneDistance, farPlaneDistance, m);
+            ProfileScope scope(*m_profiler, ProfilePass::SolarSystemObjects);
 
-            i--;
-        }
+            // Render transparent objects in the second pass
+            i = firstInInterval;
+            while (i >= 0 && renderList[i].farZ < depthPartitions[interval].nearZ)
+            {
+                if (!renderList[i].isOpaque || renderList[i].discSizeInPixels <= 1.0f)
+                    renderItem(renderList[i], observer, nearPlaneDistance, farPlaneDistance, m);
 
-        Renderer::PipelineState ps;
-        ps.blending = true;
-        ps.blendFunc = {GL_SRC_ALPHA, GL_ONE};
-        ps.depthTest = true;
-        setPipelineState(ps);
+                i--;
+            }
 
-        PointStarVertexBuffer::enable();
-        glareVertexBuffer->startSprites();
-        glareVertexBuffer->render();
-        glareVertexBuffer->finish();
-        if (starStyle == PointStars)
-            pointStarVertexBuffer->startBasicPoints();
-        else
-            pointStarVertexBuffer->startSprites();
-        pointStarVertexBuffer->render();
-        pointStarVertexBuffer->finish();
-        PointStarVertexBuffer::disable();
+            // Comet tails of the interval are queued by renderItem
+            m_cometRenderer->renderQueued(m);
+
+            Renderer::PipelineState ps;
+            ps.blending = true;
+            ps.blendFunc = {GL_SRC_ALPHA, GL_ONE};
+            ps.depthTest = true;
+            setPipelineState(ps);
+
+            PointStarVertexBuffer::enable();
+            glareVertexBuffer->startSprites();
+            glareVertexBuffer->render();
+            glareVertexBuffer->finish();
+            if (starStyle == PointStars)
+                pointStarVertexBuffer->startBasicPoints();
+            else
+                pointStarVertexBuffer->startSprites();
+            pointStarVertexBuffer->render();
+            pointStarVertexBuffer->finish();
+            PointStarVertexBuffer::disable();
+
+            m_largeGlareBuffer->setTexture(gaussianGlareTex);
+            m_largeGlareBuffer->render();
+            m_largePointBuffer->setTexture(gaussianDiscTex);
+            m_largePointBuffer->render();
+        }
 
         // Render annotations in this interval
         annotation = renderSortedAnnotations(annotation,
@@ -5460,9 +6998,29 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
 
     // reset the depth range
     glDepthRange(0, 1);
+    setDepthReversed(false);
     setDefaultProjectionMatrix();
 }
 
+void
+Renderer::setDepthReversed(bool reversed)
+{
+    if (reversed == m_depthReversed)
+        return;
+
+    // LEQUAL and GEQUAL rather than LESS and GREATER as for multipass
+    // rendering
+#ifdef GL_ES
+    glClipControlEXT(GL_LOWER_LEFT_EXT, reversed ? GL_ZERO_TO_ONE_EXT : GL_NEGATIVE_ONE_TO_ONE_EXT);
+    glClearDepthf(reversed ? 0.0f : 1.0f);
+#else
+    glClipControl(GL_LOWER_LEFT, reversed ? GL_ZERO_TO_ONE : GL_NEGATIVE_ONE_TO_ONE);
+    glClearDepth(reversed ? 0.0 : 1.0);
+#endif
+    glDepthFunc(reversed ? GL_GEQUAL : GL_LEQUAL);
+    m_depthReversed = reversed;
+}
+
 void
 Renderer::setPipelineState(const Renderer::PipelineState &ps) noexcept
 {
@@ -5473,11 +7031,13 @@ Renderer::setPipelineState(const Renderer::PipelineState &ps) noexcept
         else
             glDisable(GL_BLEND);
         m_pipelineState.blending = ps.blending;
+        ++celestia::render::frameStats.stateChanges;
     }
     if (ps.blending && (ps.blendFunc.src != m_pipelineState.blendFunc.src || ps.blendFunc.dst != m_pipelineState.blendFunc.dst))
     {
         glBlendFuncSeparate(ps.blendFunc.src, ps.blendFunc.dst, GL_ZERO, GL_ONE);
         m_pipelineState.blendFunc = ps.blendFunc;
+        ++celestia::render::frameStats.stateChanges;
     }
     if (ps.depthTest != m_pipelineState.depthTest)
     {
@@ -5486,11 +7046,13 @@ Renderer::setPipelineState(const Renderer::PipelineState &ps) noexcept
         else
             glDisable(GL_DEPTH_TEST);
         m_pipelineState.depthTest = ps.depthTest;
+        ++celestia::render::frameStats.stateChanges;
     }
     if (ps.depthMask != m_pipelineState.depthMask)
     {
         glDepthMask(ps.depthMask ? GL_TRUE : GL_FALSE);
         m_pipelineState.depthMask = ps.depthMask;
+        ++celestia::render::frameStats.stateChanges;
     }
     if (ps.smoothLines != m_pipelineState.smoothLines)
     {
@@ -5501,6 +7063,7 @@ Renderer::setPipelineState(const Renderer::PipelineState &ps) noexcept
             glDisable(GL_LINE_SMOOTH);
 #endif
         m_pipelineState.smoothLines = ps.smoothLines;
+        ++celestia::render::frameStats.stateChanges;
     }
 }
 
@@ -10,31 +10,59 @@
 
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <list>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include <Eigen/Core>
 
 #include <celengine/lightenv.h>
+#include <celengine/labelcache.h>
+#include <celengine/labelgrid.h>
+#include <celengine/qualitygovernor.h>
 #include <celengine/universe.h>
 #include <celengine/selection.h>
+#include <celengine/shadowmapcache.h>
+#include <celengine/skyoccluders.h>
 #include <celengine/starcolors.h>
 #include <celengine/rendcontext.h>
 #include <celengine/renderlistentry.h>
 #include <celengine/textlayout.h>
+#include <celmath/frustum.h>
 #include <celrender/vertexobject.h>
+#include <celutil/arena.h>
+#include <celutil/radixsort.h>
 
 class RendererWatcher;
 class FrameTree;
+class LazyBodyCatalog;
 class ReferenceMark;
+class SkyGrid;
+class AsyncOrbitSampler;
 class CurvePlot;
+class LargePointBuffer;
 class PointStarVertexBuffer;
+class PointStarRenderer;
+struct PointStarBatch;
 class Observer;
+class OccluderIndex;
+class OccluderList;
+class StarColorCache;
+class StarVisibilityCache;
 class Surface;
 class TextureFont;
 class FramebufferObject;
+class Geometry;
+class GPUTimer;
 
 namespace celestia
 {
@@ -46,12 +74,17 @@ class AtmosphereRenderer;
 class BoundariesRenderer;
 class CometRenderer;
 class EclipticLineRenderer;
+class FloatDepthTarget;
+class FrameProfiler;
+class GPUStarRenderer;
+class PickRenderer;
+class StarBloom;
+class StreamBuffer;
 }
-}
-
-namespace celmath
+namespace util
 {
-class Frustum;
+class MemoryReport;
+}
 }
 
 struct Matrices
@@ -67,6 +100,9 @@ struct LightSource
     Color color;
     float luminosity;
     float radius;
+    // Luminosity over the square of a kilometer in AU; divided by the
+    // square of the distance in km, it gives the irradiance at an object
+    float irradianceScale;
 };
 
 
@@ -76,6 +112,22 @@ struct SecondaryIlluminator
     Eigen::Vector3d position_v;       // viewer relative position
     float           radius;           // radius in km
     float           reflectedIrradiance;  // albedo times total irradiance from direct sources
+
+    // Set once a frame with the reflected irradiance, so that lighting each
+    // object only needs its distance to the illuminator
+    float           minDistanceSquared;   // illuminators closer than this are ignored
+    float           irradianceScale;      // reflected irradiance times radius squared
+    Color           color;
+};
+
+
+// Output of a frame tree traversal running on a worker thread. The opacity
+// of body geometry isn't looked up there, as that may load the geometry;
+// it's done on the render thread when the batch is merged.
+struct RenderListBatch
+{
+    std::vector<RenderListEntry> renderList;
+    std::vector<SecondaryIlluminator> secondaryIlluminators;
 };
 
 
@@ -129,6 +181,97 @@ class Renderer
         double orbitWindowEnd;
         double orbitPeriodsShown;
         double linearFadeFraction;
+        // Number of threads used to traverse the star octree, as jobs of
+        // the shared job system; zero selects its number of threads.
+        unsigned int starRenderThreads;
+        // Same as starRenderThreads, for the deep sky object octree
+        unsigned int dsoRenderThreads;
+        // Number of threads sampling orbits in the background; with zero,
+        // an orbit is sampled when it's first drawn.
+        unsigned int orbitSamplingThreads;
+        // Number of jobs computing the positions of the bodies of large
+        // solar systems for the render list; zero selects the number of
+        // threads of the job system.
+        unsigned int renderListThreads;
+        // Number of threads reading and decoding textures and virtual
+        // texture tiles in the background; with zero, a texture is loaded
+        // when it's first used.
+        unsigned int textureLoadingThreads;
+        // Number of threads reading and preparing models in the
+        // background; with zero, a model is loaded when it's first drawn.
+        unsigned int modelLoadingThreads;
+        // Video memory in bytes for the tiles of all virtual textures
+        std::size_t virtualTextureMemoryBudget;
+        // Disk space in bytes for the downloaded tiles of remote virtual
+        // textures
+        std::uintmax_t tileCacheSize;
+        // Video memory in bytes for all textures; textures which haven't
+        // been drawn lately are unloaded to keep within it. Zero means no
+        // limit.
+        std::size_t textureMemoryBudget;
+        // Draw each object with the lowest texture resolution giving about
+        // a texel per pixel at its size on screen, up to the resolution
+        // set, rather than with the resolution set.
+        bool autoTextureResolution;
+        // Keep the star catalog in GPU memory and compute the point star
+        // brightness and size in a shader.
+        bool gpuStarCatalog;
+        // Keep the linked shader programs on disk for later runs.
+        bool shaderCache;
+        // Build the shader programs used in earlier runs at startup
+        // rather than when they are first needed.
+        bool shaderWarmUp;
+        // Compile the missing lit shader programs in the background,
+        // drawing with simpler ones in the meantime.
+        bool asyncShaderCompile;
+        // Compress color textures to DXT1/DXT5 when loading them, keeping
+        // the result in a disk cache.
+        bool compressTextures;
+        // Keep the vertices of planet spheres in GPU memory instead of
+        // computing them for every frame.
+        bool staticSphereMeshes;
+        // Reorder the triangles and vertices of models for the vertex
+        // cache and overdraw when loading them, keeping the result in a
+        // disk cache.
+        bool optimizeModels;
+        // Draw simplified versions of large models when they are small on
+        // screen.
+        bool modelLevelsOfDetail;
+        // Target time in seconds for the frames bracketed by beginFrame()
+        // and endFrame(). When they take longer, less detail is drawn until
+        // the camera stops moving. Zero keeps full quality.
+        double frameTimeBudget;
+        // Hide the background labels which overlap one of a higher
+        // priority.
+        bool declutterLabels;
+        // Render text from distance fields of the glyphs, which scale to
+        // all font sizes, keeping them in a disk cache.
+        bool distanceFieldFonts;
+        // Number of shadow maps kept, rendered again only when the light
+        // turns relative to their caster. With zero, maps are rendered for
+        // each object in every frame.
+        unsigned int shadowMapCacheSize;
+        // Size of the shadow maps of the finer cascade drawn on large
+        // models seen from close by; zero disables the cascade.
+        unsigned int shadowCascadeSize;
+        // Size of the textures the shadow of a planet on its rings is
+        // baked into, baked again only when the light moves relative to
+        // the rings. With zero, the shadow is computed for each pixel.
+        unsigned int ringShadowTextureSize;
+        // Pick the object under the mouse from the IDs of the objects
+        // around it drawn into a small offscreen tile, read back a few
+        // frames later, instead of searching the catalogs.
+        bool gpuPicking;
+        // Draw the views to framebuffers with floating point depth buffers
+        // and the solar system objects with a reversed projection in a
+        // single depth interval, rather than in intervals with their own
+        // part of the depth buffer. Falls back to the intervals where
+        // clip control is missing and with the fisheye projection.
+        bool reverseDepth;
+        // Draw the glares of the point stars as a blur of their light at
+        // a low resolution instead of a sprite per star, so their cost
+        // doesn't grow with the number of bright stars.
+        bool starBloom;
     };
 
     enum class ProjectionMode
@@ -158,8 +301,29 @@ class Renderer
               const Universe&,
               float faintestVisible,
               const Selection& sel);
+    // Bracket the views drawn for one frame, so that the work which doesn't
+    // depend on the view, e.g. finding the nearby stars from an observer
+    // position or the positions of the bodies, is only done once for all
+    // of them. Without it, each view drawn counts as a frame of its own.
+    void beginFrame();
+    void endFrame();
+    // Draw the IDs of the objects around a pick ray in camera coordinates
+    // with the next view drawn, with the tolerance as for
+    // Simulation::pickObject. Returns false without GPU picking, when the
+    // objects have to be picked on the CPU instead.
+    bool requestPick(const Eigen::Vector3f& pickRay, float tolerance);
+    // The object found by the latest pick read back; false if none was
+    // read back yet.
+    bool getPickResult(Selection& sel) const;
+    // Quality level picked by the frame time governor, 0 for full quality
+    int getQualityLevel() const;
+    // Times the passes of the frames while it's enabled
+    celestia::render::FrameProfiler& getProfiler() { return *m_profiler; }
 
     bool getInfo(std::map<std::string, std::string>& info) const;
+    // Add the memory taken by the orbit cache, the loaded models and
+    // trajectories, and the textures to report
+    void addMemoryUsage(celestia::util::MemoryReport& report) const;
 
     enum {
         NoLabels            = 0x000,
@@ -283,6 +447,8 @@ class Renderer
     float getScaleFactor() const;
     float getPointWidth() const;
     float getPointHeight() const;
+    // Angular size of a pixel in radians
+    float getPixelSize() const;
 
     // GL wrappers
     void getViewport(int* x, int* y, int* w, int* h) const;
@@ -316,12 +482,28 @@ class Renderer
                       float size,
                       const Color &color,
                       const Matrices &m);
+    bool addMarkerToBatch(celestia::MarkerRepresentation::Symbol symbol,
+                          float size,
+                          const Color &color,
+                          const Eigen::Vector3f &position);
+    void renderMarkerBatch(const Matrices &m);
 
     celestia::util::array_view<const Star*> getNearStars() const
     {
         return nearStars;
     }
 
+    // Positions in km of the near stars relative to the observer, in the
+    // order of getNearStars(), computed once per observer position and time
+    celestia::util::array_view<Eigen::Vector3d> getNearStarOffsets() const
+    {
+        return nearStarOffsets;
+    }
+
+    // The position of a near star relative to the observer; false if the
+    // star isn't one of them
+    bool getNearStarOffset(const Star* star, Eigen::Vector3d& offset) const;
+
     const Eigen::Matrix4f& getModelViewMatrix() const
     {
         return m_modelMatrix;
@@ -375,6 +557,9 @@ class Renderer
     void loadTextures(Body*);
 
     // Label related methods
+    // Priority of the annotations which are never hidden by decluttering
+    static constexpr float AnnotationAlwaysShown = std::numeric_limits<float>::infinity();
+
     enum class LabelHorizontalAlignment : std::uint8_t
     {
         Center,
@@ -389,9 +574,16 @@ class Renderer
         Top,
     };
 
+    // The text of the annotation is either a label from the label cache or
+    // a string of its own
     struct Annotation
     {
-        std::string labelText;
+        // Copied into the frame arena
+        std::string_view labelText;
+        const celestia::engine::LabelCache::Label* label{ nullptr };
+        // When decluttering, labels are placed from the highest priority
+        // and those overlapping a label already placed are hidden
+        float priority{ AnnotationAlwaysShown };
         const celestia::MarkerRepresentation* markerRep;
         Color color;
         Eigen::Vector3f position;
@@ -400,38 +592,61 @@ class Renderer
         float size;
 
         bool operator<(const Annotation&) const;
+        bool hasLabel() const { return label != nullptr || !labelText.empty(); }
     };
 
     void addForegroundAnnotation(const celestia::MarkerRepresentation* markerRep,
-                                 const std::string& labelText,
+                                 std::string_view labelText,
                                  Color color,
                                  const Eigen::Vector3f& position,
                                  LabelHorizontalAlignment halign = LabelHorizontalAlignment::Start,
                                  LabelVerticalAlignment valign = LabelVerticalAlignment::Bottom,
                                  float size = 0.0f);
     void addBackgroundAnnotation(const celestia::MarkerRepresentation* markerRep,
-                                 const std::string& labelText,
+                                 std::string_view labelText,
                                  Color color,
                                  const Eigen::Vector3f& position,
                                  LabelHorizontalAlignment halign = LabelHorizontalAlignment::Start,
                                  LabelVerticalAlignment valign = LabelVerticalAlignment::Bottom,
                                  float size = 0.0f);
     void addSortedAnnotation(const celestia::MarkerRepresentation* markerRep,
-                             const std::string& labelText,
+                             std::string_view labelText,
+                             Color color,
+                             const Eigen::Vector3f& position,
+                             LabelHorizontalAlignment halign = LabelHorizontalAlignment::Start,
+                             LabelVerticalAlignment valign = LabelVerticalAlignment::Bottom,
+                             float size = 0.0f);
+    // Annotations with labels from getLabelCache, which are only valid
+    // for the current frame
+    void addBackgroundAnnotation(const celestia::MarkerRepresentation* markerRep,
+                                 const celestia::engine::LabelCache::Label* label,
+                                 Color color,
+                                 const Eigen::Vector3f& position,
+                                 LabelHorizontalAlignment halign = LabelHorizontalAlignment::Start,
+                                 LabelVerticalAlignment valign = LabelVerticalAlignment::Bottom,
+                                 float size = 0.0f,
+                                 float priority = AnnotationAlwaysShown);
+    void addSortedAnnotation(const celestia::MarkerRepresentation* markerRep,
+                             const celestia::engine::LabelCache::Label* label,
                              Color color,
                              const Eigen::Vector3f& position,
                              LabelHorizontalAlignment halign = LabelHorizontalAlignment::Start,
                              LabelVerticalAlignment valign = LabelVerticalAlignment::Bottom,
                              float size = 0.0f);
 
+    celestia::engine::LabelCache& getLabelCache() { return labelCache; }
+
     ShaderManager& getShaderManager() const { return *shaderManager; }
 
+    // Ring buffer shared by the vertex data streamed each frame
+    celestia::render::StreamBuffer& getStreamBuffer() const { return *m_streamBuffer; }
+
     celestia::render::VertexObject& getVertexObject(VOType, GLenum, GLsizeiptr, GLenum);
 
     // Callbacks for renderables; these belong in a special renderer interface
     // only visible in object's render methods.
     void beginObjectAnnotations();
-    void addObjectAnnotation(const celestia::MarkerRepresentation* markerRep, const std::string& labelText, Color, const Eigen::Vector3f&, LabelHorizontalAlignment halign, LabelVerticalAlignment valign);
+    void addObjectAnnotation(const celestia::MarkerRepresentation* markerRep, std::string_view labelText, Color, const Eigen::Vector3f&, LabelHorizontalAlignment halign, LabelVerticalAlignment valign);
     void endObjectAnnotations();
     const Eigen::Quaternionf& getCameraOrientation() const;
     float getNearPlaneDistance() const;
@@ -462,12 +677,39 @@ class Renderer
 
     bool settingsHaveChanged() const;
     void markSettingsChanged();
+    // Between these, the watchers are notified of the changes once, at the
+    // end; batches can be nested.
+    void beginSettingsBatch();
+    void endSettingsBatch();
 
     void addWatcher(RendererWatcher*);
     void removeWatcher(RendererWatcher*);
     void notifyWatchers() const;
 
-    FramebufferObject* getShadowFBO(int) const;
+    struct ShadowMap
+    {
+        std::unique_ptr<FramebufferObject> fbo;
+        // Projection of the object space of the caster to the map
+        Eigen::Matrix4f lightMatrix;
+    };
+
+    bool hasShadowMaps() const { return m_shadowMapSize != 0; }
+    // Whether depths are currently reversed, with a [0, 1] clip range and
+    // the greater depths in front; offscreen passes such as the shadow
+    // maps switch back to the standard conventions while they draw.
+    bool isDepthReversed() const { return m_depthReversed; }
+    void setDepthReversed(bool reversed);
+    // Size of the maps of a cascade: 0 covers the whole model, 1 the part
+    // nearest to the viewer, with size 0 when it's disabled
+    unsigned int getShadowMapSize(int cascade) const;
+    // The shadow map of a cascade of the caster lit by a light, with
+    // needsRender set if it has to be drawn before it's used
+    ShadowMap* getShadowMap(const Geometry* caster,
+                            int lightIndex,
+                            int cascade,
+                            const ShadowMapCache::View& view,
+                            bool animated,
+                            bool& needsRender);
 
  public:
     struct RenderProperties
@@ -500,6 +742,11 @@ class Renderer
     void renderPointStars(const StarDatabase& starDB,
                           float faintestVisible,
                           const Observer& observer);
+    void renderPointStarsParallel(PointStarRenderer& starRenderer,
+                                  const StarDatabase& starDB,
+                                  float faintestVisible,
+                                  const Observer& observer,
+                                  unsigned int nThreads);
     void renderDeepSkyObjects(const Universe&,
                               const Observer&,
                               float faintestMagNight);
@@ -526,6 +773,35 @@ class Renderer
                           const FrameTree* tree,
                           const Observer& observer,
                           double now);
+    void buildRenderLists(const Eigen::Vector3d& astrocentricObserverPos,
+                          const celmath::Frustum& viewFrustum,
+                          const Eigen::Vector3d& viewPlaneNormal,
+                          const Eigen::Vector3d& frameCenter,
+                          const FrameTree* tree,
+                          unsigned int firstChild,
+                          unsigned int lastChild,
+                          const Observer& observer,
+                          double now,
+                          RenderListBatch* batch);
+    void cullMinorBodies(const Eigen::Vector3d& astrocentricObserverPos,
+                         const celmath::Frustum& viewFrustum,
+                         const Eigen::Vector3d& frameCenter,
+                         const FrameTree* tree,
+                         double now);
+    void buildLazyBodyLists(const Eigen::Vector3d& astrocentricObserverPos,
+                            const celmath::Frustum& viewFrustum,
+                            const Observer& observer,
+                            const FrameTree* tree,
+                            LazyBodyCatalog& lazyBodies,
+                            double now);
+    bool buildRenderListsParallel(const Eigen::Vector3d& astrocentricObserverPos,
+                                  const celmath::Frustum& viewFrustum,
+                                  const Eigen::Vector3d& viewPlaneNormal,
+                                  const Eigen::Vector3d& frameCenter,
+                                  const FrameTree* tree,
+                                  const Observer& observer,
+                                  double now,
+                                  unsigned int nThreads);
     void buildOrbitLists(const Eigen::Vector3d& astrocentricObserverPos,
                          const Eigen::Quaterniond& observerOrientation,
                          const celmath::Frustum& viewFrustum,
@@ -534,11 +810,14 @@ class Renderer
     void buildLabelLists(const celmath::Frustum& viewFrustum,
                          double now);
     int buildDepthPartitions();
+    int buildReverseDepthPartition();
+    void buildSkyOccluders();
 
 
     void addRenderListEntries(RenderListEntry& rle,
                               Body& body,
-                              bool isLabeled);
+                              bool isLabeled,
+                              RenderListBatch* batch);
 
     void addStarOrbitToRenderList(const Star& star,
                                   const Observer& observer,
@@ -563,6 +842,17 @@ class Renderer
                       float, float,
                       const Matrices&);
 
+    struct ModelInstanceInfo;
+    bool getModelInstance(const RenderListEntry& rle,
+                          double now,
+                          float nearPlaneDistance,
+                          ModelInstanceInfo& info);
+    std::size_t renderModelInstances(const std::vector<const RenderListEntry*>& items,
+                                     std::size_t first,
+                                     const Observer& observer,
+                                     float nearPlaneDistance,
+                                     const Matrices&);
+
     void renderStar(const Star& star,
                     const Eigen::Vector3f& pos,
                     float distance,
@@ -580,10 +870,8 @@ class Renderer
 
     void renderCometTail(const Body& body,
                          const Eigen::Vector3f& pos,
-                         const Observer& observer,
                          float dustTailLength,
-                         float discSizeInPixels,
-                         const Matrices&);
+                         float discSizeInPixels);
 
     void calculatePointSize(float appMag,
                             float size,
@@ -598,8 +886,7 @@ class Renderer
                              float discSizeInPixels,
                              const Color& color,
                              bool useHalos,
-                             bool emissive,
-                             const Matrices&);
+                             bool emissive);
 
     void locationsToAnnotations(const Body& body,
                                 const Eigen::Vector3d& bodyPosition,
@@ -611,27 +898,43 @@ class Renderer
                     float nearPlaneDistance,
                     float farPlaneDistance,
                     const Matrices&);
+    static bool isStateSortable(const RenderListEntry&);
+    std::pair<ResourceHandle, ResourceHandle> getStateSortKey(const RenderListEntry&) const;
 
     bool testEclipse(const Body& receiver,
                      const Body& caster,
                      LightingState& lightingState,
                      unsigned int lightIndex,
                      double now);
+    void testEclipses(const Body& body,
+                      LightingState& lights,
+                      double now);
+    void testEclipses(const Body& receiver,
+                      const PlanetarySystem& casters,
+                      LightingState& lights,
+                      unsigned int lightIndex,
+                      double now);
+    const OccluderList& getOccluders(const PlanetarySystem& system, double now);
 
     void labelConstellations(const AsterismList& asterisms,
                              const Observer& observer);
 
     void getLabelAlignmentInfo(const Annotation &annotation, const TextureFont *font, celestia::engine::TextLayout::HorizontalAlignment &halign, float &hOffset, float &vOffset) const;
 
+    // Copy a string into the frame arena, valid until the next view is
+    // drawn
+    std::string_view copyToFrameArena(std::string_view);
     void addAnnotation(std::vector<Annotation>&,
                        const celestia::MarkerRepresentation*,
-                       const std::string& labelText,
+                       std::string_view labelText,
+                       const celestia::engine::LabelCache::Label* label,
                        Color color,
                        const Eigen::Vector3f& position,
                        LabelHorizontalAlignment halign = LabelHorizontalAlignment::Start,
                        LabelVerticalAlignment = LabelVerticalAlignment::Bottom,
                        float size = 0.0f,
-                       bool special = false);
+                       bool special = false,
+                       float priority = AnnotationAlwaysShown);
     void renderAnnotationMarker(const Annotation &a,
                                 celestia::engine::TextLayout &layout,
                                 float depth,
@@ -644,6 +947,8 @@ class Renderer
                                const Matrices&);
     void renderAnnotations(const std::vector<Annotation>&,
                            FontStyle fs);
+    celestia::engine::LabelGrid::Box getLabelBox(const Annotation&, const TextureFont*) const;
+    void declutterAnnotations(std::vector<Annotation>&, FontStyle fs);
     void renderBackgroundAnnotations(FontStyle fs);
     void renderForegroundAnnotations(FontStyle fs);
     std::vector<Annotation>::iterator renderSortedAnnotations(std::vector<Annotation>::iterator,
@@ -669,6 +974,10 @@ class Renderer
                                          float &saturationMag,
                                          double now);
 
+    void updateOrbitCache();
+    void manageTextureMemory();
+    void startFrame();
+    void applyQualityLevel();
     void renderOrbit(const OrbitPathListEntry&,
                      double now,
                      const Eigen::Quaterniond& cameraOrientation,
@@ -682,7 +991,7 @@ class Renderer
 
     void updateBodyVisibilityMask();
 
-    void createShadowFBO();
+    void resizeShadowMap(unsigned);
 
  private:
     ShaderManager* shaderManager{ nullptr };
@@ -721,16 +1030,68 @@ class Renderer
     Eigen::Quaternionf m_cameraOrientation;
     PointStarVertexBuffer* pointStarVertexBuffer;
     PointStarVertexBuffer* glareVertexBuffer;
+    // Per-thread output of the parallel star traversal, kept between frames
+    // to reuse the allocations
+    std::vector<std::unique_ptr<PointStarBatch>> starBatches;
+    // Same for the parallel frame tree traversal
+    std::vector<RenderListBatch> renderListBatches;
+    // Discs of the large bodies of the render list, which hide the stars
+    // and deep sky objects behind them
+    SkyOccluders m_skyOccluders;
+    // Identifies the minor body culling of the current render list build
+    std::uint32_t minorBodyCullStamp{ 0 };
+    // Positions of the lazily loaded bodies of a system
+    std::vector<Eigen::Vector3d> lazyBodyPositions;
+    // Within beginFrame() and endFrame(), the nearby stars and the lazy
+    // body positions are reused by the views with the same observer
+    // position and time
+    bool inFrame{ false };
+    bool nearStarsValid{ false };
+    UniversalCoord nearStarsPosition;
+    double nearStarsTime{ 0.0 };
+    const LazyBodyCatalog* lazyBodyPositionsCatalog{ nullptr };
+    double lazyBodyPositionsTime{ 0.0 };
+    // Frame time governor, fed with the times of the bracketed frames. The
+    // cameras of the views of the last frame, in drawing order, tell
+    // whether any of them moved.
+    QualityGovernor qualityGovernor;
+    std::unique_ptr<GPUTimer> gpuTimer;
+    std::chrono::steady_clock::time_point frameStartTime;
+    std::vector<std::pair<UniversalCoord, Eigen::Quaternionf>> frameCameras;
+    std::size_t frameCameraIndex{ 0 };
+    bool cameraMoved{ false };
+    // Locations considered for labeling on the body being rendered
+    std::vector<const Location*> locationCandidates;
     std::vector<RenderListEntry> renderList;
+    // Opaque entries of the current depth interval, in drawing order
+    std::vector<const RenderListEntry*> opaqueItems;
+    std::vector<const RenderListEntry*> orderedOpaqueItems;
     std::vector<SecondaryIlluminator> secondaryIlluminators;
     std::vector<DepthBufferPartition> depthPartitions;
     std::vector<Annotation> backgroundAnnotations;
     std::vector<Annotation> foregroundAnnotations;
     std::vector<Annotation> depthSortedAnnotations;
     std::vector<Annotation> objectAnnotations;
+    // Label strings of the annotations, reclaimed at the start of each
+    // view; the annotation vectors keep their capacity between frames
+    celestia::util::Arena m_frameArena;
+    celestia::engine::LabelCache labelCache;
+    celestia::engine::LabelGrid labelGrid;
+    std::vector<std::uint32_t> labelOrder;
+    // Vertices of the hollow markers added since they were last drawn
+    int markerBatchCount{ 0 };
+    // The spheres of the render list entries, tested together for labels
+    celmath::SphereBatch labelSpheres;
+    std::vector<celmath::Frustum::Aspect> labelAspects;
     std::vector<OrbitPathListEntry> orbitPathList;
+    // The render list, the depth sorted annotations and the orbit paths
+    // are sorted by their depths, with the memory kept between frames
+    celestia::util::KeySorter<RenderListEntry> renderListSorter;
+    celestia::util::KeySorter<Annotation> annotationSorter;
+    celestia::util::KeySorter<OrbitPathListEntry> orbitPathSorter;
     LightingState::EclipseShadowVector eclipseShadows[MaxLights];
     std::vector<const Star*> nearStars;
+    std::vector<Eigen::Vector3d> nearStarOffsets;
 
     std::vector<LightSource> lightSourceList;
 
@@ -744,6 +1105,8 @@ class Renderer
     bool useCompressedTextures{ false };
     unsigned int textureResolution;
     DetailOptions detailOptions;
+    unsigned int framesOverTextureBudget{ 0 };
+    std::size_t texturesEvicted{ 0 };
 
     uint32_t frameCount;
 
@@ -756,6 +1119,9 @@ class Renderer
     typedef std::map<const celestia::ephem::Orbit*, CurvePlot*> OrbitCache;
     OrbitCache orbitCache;
     uint32_t lastOrbitCacheFlush;
+    std::unique_ptr<AsyncOrbitSampler> orbitSampler;
+    // Cached orbits drawn as a coarse outline until sampled in the background
+    std::unordered_set<const celestia::ephem::Orbit*> pendingOrbits;
 
     float minOrbitSize;
     float distanceLimit;
@@ -767,6 +1133,8 @@ class Renderer
     Selection highlightObject;
 
     bool settingsChanged;
+    int settingsBatchDepth{ 0 };
+    bool settingsBatchChanged{ false };
 
     // True if we're in between a begin/endObjectAnnotations
     bool objectAnnotationSetOpen;
@@ -778,9 +1146,13 @@ class Renderer
     // visibility culling of solar systems.
     float SolarSystemMaxDistance{ 1.0f };
 
-    // Size of a texture used in shadow mapping
+    // Size of a texture used in shadow mapping, and the size set before the
+    // quality governor reduced it
     unsigned m_shadowMapSize { 0 };
-    std::unique_ptr<FramebufferObject> m_shadowFBO;
+    unsigned m_fullShadowMapSize { 0 };
+    unsigned m_cascadeShadowMapSize { 0 };
+    std::unique_ptr<ShadowMapCache> m_shadowMapCache;
+    std::vector<ShadowMap> m_shadowMaps;
 
     std::array<celestia::render::VertexObject*, static_cast<size_t>(VOType::Count)> m_VertexObjects;
 
@@ -792,6 +1164,29 @@ class Renderer
     std::unique_ptr<celestia::render::AtmosphereRenderer> m_atmosphereRenderer;
     std::unique_ptr<celestia::render::CometRenderer> m_cometRenderer;
     std::unique_ptr<celestia::render::EclipticLineRenderer> m_eclipticLineRenderer;
+    std::unique_ptr<celestia::render::FloatDepthTarget> m_floatDepthTarget;
+    std::unique_ptr<celestia::render::FrameProfiler> m_profiler;
+    std::unique_ptr<celestia::render::GPUStarRenderer> m_gpuStarRenderer;
+    std::unique_ptr<celestia::render::PickRenderer> m_pickRenderer;
+    std::unique_ptr<celestia::render::StarBloom> m_starBloom;
+    std::unique_ptr<celestia::render::StreamBuffer> m_streamBuffer;
+    // Whether the view being drawn uses reverse depth, and the current
+    // depth conventions
+    bool m_reverseDepthView{ false };
+    bool m_depthReversed{ false };
+    // Pick ray and tolerance requested for the next view drawn
+    bool m_pickRequested{ false };
+    Eigen::Vector3f m_pickRay{ -Eigen::Vector3f::UnitZ() };
+    float m_pickTolerance{ 0.0f };
+    // Equatorial, galactic, ecliptic and horizon grids, kept between frames
+    // so that they only have to be laid out again when the view changes
+    std::array<std::unique_ptr<SkyGrid>, 4> m_skyGrids;
+    std::unique_ptr<StarVisibilityCache> m_starVisibilityCache;
+    std::unique_ptr<StarColorCache> m_starColorCache;
+    std::unique_ptr<OccluderIndex> m_occluderIndex;
+    // Points and glares too large for point sprites
+    std::unique_ptr<LargePointBuffer> m_largePointBuffer;
+    std::unique_ptr<LargePointBuffer> m_largeGlareBuffer;
 
     // Location markers
  public:
@@ -851,6 +1246,8 @@ class Renderer
     static Color SelectionCursorColor;
 
     friend class PointStarRenderer;
+    friend class celestia::render::GPUStarRenderer;
+    friend class celestia::render::PickRenderer;
 };
 
 
@@ -21,6 +21,7 @@
 #include <celmath/geomutil.h>
 #include <celmath/mathlib.h>
 #include <celmodel/material.h>
+#include <celrender/renderstats.h>
 #include <celutil/arrayvector.h>
 #include <celutil/color.h>
 #include "atmosphere.h"
@@ -33,8 +34,10 @@
 #include "render.h"
 #include "renderglsl.h"
 #include "renderinfo.h"
+#include "ringshadowcache.h"
 #include "shadermanager.h"
 #include "shadowmap.h" // GL_ONLY_SHADOWS definition
+#include "terrainmesh.h"
 #include "texture.h"
 
 using namespace celestia;
@@ -43,6 +46,9 @@ using namespace celestia;
 namespace
 {
 
+// Streamed per instance attributes of instanced models
+GLuint modelInstanceBuffer = 0;
+
 // Calculate the matrix used to render the model from the
 // perspective of the light.
 Eigen::Matrix4f directionalLightMatrix(const Eigen::Vector3f& lightDirection)
@@ -62,12 +68,12 @@ Eigen::Matrix4f directionalLightMatrix(const Eigen::Vector3f& lightDirection)
 
 /*! Render a mesh object
  *  Parameters:
+ *    view : the light direction and the part of the model in the map
  *    tsec : animation clock time in seconds
  */
 void renderGeometryShadow_GLSL(Geometry* geometry,
                                FramebufferObject* shadowFbo,
-                               const LightingState& ls,
-                               int lightIndex,
+                               const ShadowMapCache::View& view,
                                double tsec,
                                Renderer* renderer,
                                Eigen::Matrix4f *lightMatrix)
@@ -76,6 +82,10 @@ void renderGeometryShadow_GLSL(Geometry* geometry,
     if (prog == nullptr)
         return;
 
+    // The shadow maps use the standard depth conventions
+    bool depthReversed = renderer->isDepthReversed();
+    renderer->setDepthReversed(false);
+
     GLint oldFboId;
     glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFboId);
     shadowFbo->bind();
@@ -100,8 +110,10 @@ void renderGeometryShadow_GLSL(Geometry* geometry,
     glEnable(GL_POLYGON_OFFSET_FILL);
     glPolygonOffset(.001f, .001f);
 
-    Eigen::Matrix4f projMat = celmath::Ortho(-1.f, 1.f, -1.f, 1.f, -1.f, 1.f);
-    Eigen::Matrix4f modelViewMat = directionalLightMatrix(ls.lights[lightIndex].direction_obj);
+    Eigen::Matrix4f projMat = celmath::Ortho(view.center.x() - view.extent, view.center.x() + view.extent,
+                                             view.center.y() - view.extent, view.center.y() + view.extent,
+                                             -1.f, 1.f);
+    Eigen::Matrix4f modelViewMat = directionalLightMatrix(view.lightDirection);
     *lightMatrix = projMat * modelViewMat;
     prog->setMVPMatrices(projMat, modelViewMat);
     geometry->render(rc, tsec);
@@ -111,6 +123,57 @@ void renderGeometryShadow_GLSL(Geometry* geometry,
     glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
     glCullFace(GL_BACK);
     shadowFbo->unbind(oldFboId);
+    renderer->setDepthReversed(depthReversed);
+}
+
+// Find or render the shadow maps of a model lit by the first light: one of
+// the whole model, and when the model is large on screen and the viewer
+// near it, a finer one of the part nearest to the viewer. Returns the
+// number of maps.
+int getShadowMaps_GLSL(Geometry* geometry,
+                       const RenderInfo& ri,
+                       const LightingState& ls,
+                       double tsec,
+                       Renderer* renderer,
+                       std::array<const Renderer::ShadowMap*, 2>& maps)
+{
+    // Distance of the viewer from the center of the model, in units of
+    // its radius, within which the finer cascade is drawn
+    constexpr float MaxFineCascadeDistance = 4.0f;
+
+    const Eigen::Vector3f& lightDirection = ls.lights[0].direction_obj;
+    std::array<ShadowMapCache::View, 2> views;
+    views[0] = { lightDirection, Eigen::Vector2f::Zero(), 1.0f, renderer->getShadowMapSize(0) };
+    int nCascades = 1;
+
+    unsigned int fineSize = renderer->getShadowMapSize(1);
+    float eyeDistance = ri.eyePos_obj.norm();
+    if (fineSize != 0 && ri.pixWidth > static_cast<float>(views[0].size) && eyeDistance < MaxFineCascadeDistance)
+    {
+        // The point of the bounding sphere nearest to the viewer, in light
+        // space
+        Eigen::Vector3f nearest = eyeDistance > 1.0f ? Eigen::Vector3f(ri.eyePos_obj / eyeDistance) : ri.eyePos_obj;
+        Eigen::Vector2f center = (directionalLightMatrix(lightDirection).topLeftCorner<3, 3>() * nearest).head<2>();
+        views[1] = { lightDirection,
+                     ShadowMapCache::snapCenter(center, FineShadowCascadeExtent),
+                     FineShadowCascadeExtent,
+                     fineSize };
+        nCascades = 2;
+    }
+
+    bool animated = geometry->isAnimated();
+    for (int cascade = 0; cascade < nCascades; cascade++)
+    {
+        bool needsRender = false;
+        Renderer::ShadowMap* map = renderer->getShadowMap(geometry, 0, cascade, views[cascade], animated, needsRender);
+        if (map == nullptr)
+            return cascade;
+        if (needsRender)
+            renderGeometryShadow_GLSL(geometry, map->fbo.get(), views[cascade], tsec, renderer, &map->lightMatrix);
+        maps[cascade] = map;
+    }
+
+    return nCascades;
 }
 
 } // end unnamed namespace
@@ -238,18 +301,10 @@ void renderEllipsoid_GLSL(const RenderInfo& ri,
     }
 
     // Set the shadow information.
-    // Track the total number of shadows; if there are too many, we'll have
-    // to fall back to multipass.
-    unsigned int totalShadows = 0;
-
     for (unsigned int li = 0; li < ls.nLights; li++)
     {
-        if (ls.shadows[li] && !ls.shadows[li]->empty())
-        {
-            auto nShadows = std::min(MaxShaderEclipseShadows, static_cast<unsigned int>(ls.shadows[li]->size()));
-            shadprop.setEclipseShadowCountForLight(li, nShadows);
-            totalShadows += nShadows;
-        }
+        if (ls.shadows[li] != nullptr)
+            shadprop.setEclipseShadowsForLight(li, ls.shadows[li]->size());
     }
 
     if (ls.shadowingRingSystem)
@@ -290,6 +345,12 @@ void renderEllipsoid_GLSL(const RenderInfo& ri,
         }
     }
 
+    // Surfaces with a height map are drawn as displaced terrain, unless one
+    // of the textures is split into tiles
+    bool displaced = ri.heightTex != nullptr &&
+                     TerrainMesh::canRender(textures.data(), static_cast<int>(textures.size()));
+    if (displaced)
+        shadprop.texUsage |= ShaderProperties::TerrainDisplacement;
 
     // Get a shader for the current rendering configuration
     CelestiaGLProgram* prog = renderer->getShaderManager().getShader(shadprop);
@@ -350,6 +411,18 @@ void renderEllipsoid_GLSL(const RenderInfo& ri,
 
     auto endTextures = std::remove(textures.begin(), textures.end(), nullptr);
     textures.erase(endTextures, textures.end());
+    if (displaced)
+    {
+        // The height map follows the ring shadow texture
+        auto heightTexUnit = static_cast<unsigned int>(textures.size());
+        if ((shadprop.texUsage & ShaderProperties::RingShadowTexture) != 0)
+            heightTexUnit++;
+        g_terrainMesh->render(*prog, frustum, ls.eyePos_obj, renderer->getPixelSize(),
+                              ri.heightTex, ri.heightScale, heightTexUnit,
+                              textures.data(), static_cast<int>(textures.size()));
+        return;
+    }
+
     g_lodSphere->render(attributes,
                         frustum, ri.pixWidth,
                         textures.data(), static_cast<int>(textures.size()));
@@ -374,10 +447,10 @@ void renderGeometry_GLSL(Geometry* geometry,
                          const Matrices &m,
                          Renderer* renderer)
 {
-    auto *shadowBuffer = renderer->getShadowFBO(0);
-    Eigen::Matrix4f lightMatrix(Eigen::Matrix4f::Identity());
+    std::array<const Renderer::ShadowMap*, 2> shadowMaps{ nullptr, nullptr };
+    int nShadowMaps = 0;
 
-    if (shadowBuffer != nullptr && shadowBuffer->isValid())
+    if (renderer->hasShadowMaps())
     {
         std::array<int, 4> viewport;
         renderer->getViewport(viewport);
@@ -396,8 +469,7 @@ void renderGeometry_GLSL(Geometry* geometry,
         fmt::printf("bias: %f bits: %f clear: %f range: %f - %f, scale:%f\n", bias, bits, clear, range[0], range[1], scale);
 #endif
 
-        renderGeometryShadow_GLSL(geometry, shadowBuffer, ls, 0,
-                                  tsec, renderer, &lightMatrix);
+        nShadowMaps = getShadowMaps_GLSL(geometry, ri, ls, tsec, renderer, shadowMaps);
         renderer->setViewport(viewport);
 #ifdef DEPTH_BUFFER_DEBUG
         glDisable(GL_DEPTH_TEST);
@@ -407,12 +479,12 @@ void renderGeometry_GLSL(Geometry* geometry,
         glMatrixMode(GL_MODELVIEW);
         glPushMatrix();
         glLoadIdentity();
-        glUseProgram(0);
+        GLProgram::useNone();
         glColor4f(1, 1, 1, 1);
 
         glActiveTexture(GL_TEXTURE0);
         glEnable(GL_TEXTURE_2D);
-        glBindTexture(GL_TEXTURE_2D, shadowBuffer->depthTexture());
+        glBindTexture(GL_TEXTURE_2D, shadowMaps[0]->fbo->depthTexture());
 #if GL_ONLY_SHADOWS
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
 #endif
@@ -447,13 +519,16 @@ void renderGeometry_GLSL(Geometry* geometry,
         rc.setAtmosphere(atmosphere);
     }
 
-    if (shadowBuffer != nullptr && shadowBuffer->isValid())
+    if (nShadowMaps > 0)
     {
-        rc.setShadowMap(shadowBuffer->depthTexture(), shadowBuffer->width(), &lightMatrix);
+        rc.setShadowMap(shadowMaps[0]->fbo->depthTexture(), shadowMaps[0]->fbo->width(), &shadowMaps[0]->lightMatrix);
+        if (nShadowMaps > 1)
+            rc.setCascadeShadowMap(shadowMaps[1]->fbo->depthTexture(), shadowMaps[1]->fbo->width(), &shadowMaps[1]->lightMatrix);
     }
 
     rc.setCameraOrientation(ri.orientation);
     rc.setPointScale(ri.pointScale);
+    rc.setPixelsPerUnit(ri.pixelsPerUnit);
 
     // Handle extended material attributes (per model only, not per submesh)
     rc.setLunarLambert(ri.lunarLambert);
@@ -484,6 +559,68 @@ void renderGeometry_GLSL(Geometry* geometry,
 }
 
 
+/*! Render copies of a mesh object with one draw call per primitive group.
+ *  The lighting state is shared by the instances except for the light
+ *  direction, so they must be lit by the same single light source with
+ *  no shadows. m.modelview is the camera transform; the instances add
+ *  their own.
+ */
+void renderGeometryInstanced_GLSL(Geometry* geometry,
+                                  const RenderInfo& ri,
+                                  const LightingState& ls,
+                                  const ModelInstance* instances,
+                                  std::size_t nInstances,
+                                  double tsec,
+                                  const Matrices &m,
+                                  Renderer* renderer)
+{
+    constexpr std::array<GLuint, 4> attributes =
+    {
+        CelestiaGLProgram::InstanceTransform0AttributeIndex,
+        CelestiaGLProgram::InstanceTransform1AttributeIndex,
+        CelestiaGLProgram::InstanceTransform2AttributeIndex,
+        CelestiaGLProgram::InstanceLightAttributeIndex,
+    };
+
+    if (modelInstanceBuffer == 0)
+        glGenBuffers(1, &modelInstanceBuffer);
+
+    glBindBuffer(GL_ARRAY_BUFFER, modelInstanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, nInstances * sizeof(ModelInstance), instances, GL_STREAM_DRAW);
+    for (std::size_t i = 0; i < attributes.size(); i++)
+    {
+        glEnableVertexAttribArray(attributes[i]);
+        glVertexAttribPointer(attributes[i], 4, GL_FLOAT, GL_FALSE, sizeof(ModelInstance),
+                              reinterpret_cast<const void*>(i * sizeof(Eigen::Vector4f))); //NOSONAR
+        glVertexAttribDivisor(attributes[i], 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    {
+        // The scale and orientation are only used by eclipse shadows and
+        // atmospheres, which instances don't have.
+        GLSL_RenderContext rc(renderer, ls, 1.0f, Eigen::Quaternionf::Identity(), m.modelview, m.projection);
+        rc.setInstanceCount(static_cast<int>(nInstances));
+        rc.setCameraOrientation(ri.orientation);
+        rc.setPointScale(ri.pointScale);
+        rc.setPixelsPerUnit(ri.pixelsPerUnit);
+
+        Renderer::PipelineState ps;
+        ps.depthMask = true;
+        ps.depthTest = true;
+        renderer->setPipelineState(ps);
+
+        geometry->render(rc, tsec);
+    }
+
+    for (GLuint attribute : attributes)
+    {
+        glVertexAttribDivisor(attribute, 0);
+        glDisableVertexAttribArray(attribute);
+    }
+}
+
+
 /*! Render a mesh object without lighting.
  *  Parameters:
  *    tsec : animation clock time in seconds
@@ -500,6 +637,7 @@ void renderGeometry_GLSL_Unlit(Geometry* geometry,
 {
     GLSLUnlit_RenderContext rc(renderer, geometryScale, m.modelview, m.projection);
     rc.setPointScale(ri.pointScale);
+    rc.setPixelsPerUnit(ri.pixelsPerUnit);
 
     Renderer::PipelineState ps;
     ps.depthMask = true;
@@ -576,18 +714,10 @@ void renderClouds_GLSL(const RenderInfo& ri,
     }
 
     // Set the shadow information.
-    // Track the total number of shadows; if there are too many, we'll have
-    // to fall back to multipass.
-    unsigned int totalShadows = 0;
     for (unsigned int li = 0; li < ls.nLights; li++)
     {
-        if (ls.shadows[li] && !ls.shadows[li]->empty())
-        {
-            unsigned int nShadows = std::min(MaxShaderEclipseShadows,
-                                             static_cast<unsigned int>(ls.shadows[li]->size()));
-            shadprop.setEclipseShadowCountForLight(li, nShadows);
-            totalShadows += nShadows;
-        }
+        if (ls.shadows[li] != nullptr)
+            shadprop.setEclipseShadowsForLight(li, ls.shadows[li]->size());
     }
 
     // Get a shader for the current rendering configuration
@@ -714,6 +844,7 @@ static void renderRingSystem(GLuint *vboId,
     glCullFace(GL_FRONT);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, (nSections+1)*2);
     glCullFace(GL_BACK);
+    celestia::render::frameStats.drawCalls += 2;
 
     glDisableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
     glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
@@ -731,8 +862,47 @@ class GLRingRenderData : public RingRenderData
     }
 
     std::array<GLuint, 4> vboId {{ 0, 0, 0, 0 }};
+    std::unique_ptr<RingShadowCache> shadowCache;
+    std::unique_ptr<Texture> shadowTexture;
 };
 
+// Return the texture of the planet's shadow on the rings for a light,
+// baking it again if the light has moved too far since it was last baked.
+static Texture*
+ringShadowTexture(GLRingRenderData& data,
+                  const DirectionalLight& light,
+                  float outerRadius,
+                  float planetOblateness,
+                  unsigned int size)
+{
+    if (data.shadowCache == nullptr || data.shadowCache->size() != size)
+    {
+        data.shadowCache = std::make_unique<RingShadowCache>(size);
+        data.shadowTexture = nullptr;
+    }
+
+    RingShadowCache::Key key
+    {
+        std::abs(light.direction_obj.y()),
+        light.apparentSize,
+        outerRadius,
+        planetOblateness
+    };
+    if (!data.shadowCache->canReuse(key))
+    {
+        data.shadowCache->bake(key);
+
+        auto imageSize = static_cast<int>(size);
+        Image img(celestia::PixelFormat::LUMINANCE, imageSize, imageSize);
+        const std::vector<std::uint8_t>& pixels = data.shadowCache->pixels();
+        for (int row = 0; row < imageSize; row++)
+            std::copy_n(pixels.data() + static_cast<std::size_t>(row) * size, size, img.getPixelRow(row));
+        data.shadowTexture = std::make_unique<ImageTexture>(img, Texture::EdgeClamp, Texture::NoMipMaps);
+    }
+
+    return data.shadowTexture.get();
+}
+
 // Render a planetary ring system
 void renderRings_GLSL(RingSystem& rings,
                       RenderInfo& ri,
@@ -744,12 +914,22 @@ void renderRings_GLSL(RingSystem& rings,
                       float segmentSizeInPixels,
                       const Matrices &m,
                       bool inside,
+                      unsigned int shadowTextureSize,
                       Renderer* renderer)
 {
     float inner = rings.innerRadius / planetRadius;
     float outer = rings.outerRadius / planetRadius;
     Texture* ringsTex = rings.texture.find(textureResolution);
 
+    if (rings.renderData == nullptr)
+        rings.renderData = std::make_shared<GLRingRenderData>();
+    auto data = static_cast<GLRingRenderData*>(rings.renderData.get());
+
+    // The shadow of the planet for the first light may be baked
+    Texture* shadowTex = nullptr;
+    if (renderShadow && shadowTextureSize > 0 && ls.nLights > 0)
+        shadowTex = ringShadowTexture(*data, ls.lights[0], outer, planetOblateness, shadowTextureSize);
+
     ShaderProperties shadprop;
     // Set up the shader properties for ring rendering
     {
@@ -765,6 +945,8 @@ void renderRings_GLSL(RingSystem& rings,
 
         if (ringsTex != nullptr)
             shadprop.texUsage = ShaderProperties::DiffuseTexture;
+        if (shadowTex != nullptr)
+            shadprop.texUsage |= ShaderProperties::EclipseShadowTexture;
     }
 
 
@@ -784,6 +966,16 @@ void renderRings_GLSL(RingSystem& rings,
     {
         const DirectionalLight& light = ls.lights[li];
 
+        if (li == 0 && shadowTex != nullptr)
+        {
+            Eigen::Vector4f texGenS;
+            Eigen::Vector4f texGenT;
+            RingShadowCache::texGen(light.direction_obj, outer, texGenS, texGenT);
+            prog->shadows[li][0].texGenS = texGenS;
+            prog->shadows[li][0].texGenT = texGenT;
+            continue;
+        }
+
         // Compute the projection vectors based on the sun direction.
         // I'm being a little careless here--if the sun direction lies
         // along the y-axis, this will fail.  It's unlikely that a
@@ -844,9 +1036,12 @@ void renderRings_GLSL(RingSystem& rings,
     if (ringsTex != nullptr)
         ringsTex->bind();
 
-    if (rings.renderData == nullptr)
-        rings.renderData = std::make_shared<GLRingRenderData>();
-    auto data = static_cast<GLRingRenderData*>(rings.renderData.get());
+    if (shadowTex != nullptr)
+    {
+        glActiveTexture(ringsTex != nullptr ? GL_TEXTURE1 : GL_TEXTURE0);
+        shadowTex->bind();
+        glActiveTexture(GL_TEXTURE0);
+    }
 
     unsigned nSections = 180;
     std::size_t i = 0;
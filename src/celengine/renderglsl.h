@@ -12,6 +12,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 #include <Eigen/Core>
@@ -34,6 +35,15 @@ namespace celmath
 class Frustum;
 }
 
+// Per instance attributes of a model drawn by instancing: the rows of the
+// transform from model coordinates to the camera frame, and the direction
+// of the light in model coordinates.
+struct ModelInstance
+{
+    Eigen::Vector4f transform[3];
+    Eigen::Vector4f lightDirection;
+};
+
 void renderEllipsoid_GLSL(const RenderInfo& ri,
                           const LightingState& ls,
                           Atmosphere* atmosphere,
@@ -58,6 +68,15 @@ void renderGeometry_GLSL(Geometry* geometry,
                          const Matrices &m,
                          Renderer* renderer);
 
+void renderGeometryInstanced_GLSL(Geometry* geometry,
+                                  const RenderInfo& ri,
+                                  const LightingState& ls,
+                                  const ModelInstance* instances,
+                                  std::size_t nInstances,
+                                  double tsec,
+                                  const Matrices &m,
+                                  Renderer* renderer);
+
 void renderClouds_GLSL(const RenderInfo& ri,
                        const LightingState& ls,
                        Atmosphere* atmosphere,
@@ -82,6 +101,7 @@ void renderRings_GLSL(RingSystem& rings,
                       float segmentSizeInPixels,
                       const Matrices &m,
                       bool inside,
+                      unsigned int shadowTextureSize,
                       Renderer* renderer);
 
 void renderGeometry_GLSL_Unlit(Geometry* geometry,
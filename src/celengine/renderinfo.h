@@ -16,6 +16,7 @@
 
 
 class LODSphereMesh;
+class TerrainMesh;
 class Texture;
 
 
@@ -27,6 +28,7 @@ struct RenderInfo
     Texture* nightTex{ nullptr };
     Texture* glossTex{ nullptr };
     Texture* overlayTex{ nullptr };
+    Texture* heightTex{ nullptr };
     Color specularColor{ 0.0f, 0.0f, 0.0f };
     float specularPower{ 0.0f };
     Eigen::Vector3f sunDir_eye{ Eigen::Vector3f::UnitZ() };
@@ -36,10 +38,13 @@ struct RenderInfo
     Color sunColor{ 1.0f, 1.0f, 1.0f };
     Color ambientColor{ 0.0f, 0.0f, 0.0f };
     float lunarLambert{ 0.0f };
+    float heightScale{ 0.0f };      // relief of the height map, in units of radius
     Eigen::Quaternionf orientation{ Eigen::Quaternionf::Identity() };
     float pixWidth{ 1.0f };
     float pointScale{ 1.0f };
+    float pixelsPerUnit{ 1.0f };    // screen size of a unit of the geometry
 };
 
 extern LODSphereMesh* g_lodSphere;
+extern TerrainMesh* g_terrainMesh;
 
@@ -24,6 +24,8 @@ struct RenderListEntry
         RenderableBody,
         RenderableCometTail,
         RenderableReferenceMark,
+        // A body of a LazyBodyCatalog, only drawn as a point
+        RenderableLazyBody,
     };
 
     union
@@ -0,0 +1,160 @@
+// ringshadowcache.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "ringshadowcache.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <Eigen/Geometry>
+
+#include <celcompat/numbers.h>
+
+namespace
+{
+
+// Half width of the texture across the shadow; the shadow of the planet is
+// two radii wide
+constexpr float HalfWidth = 1.05f;
+
+// Part of the ring nearer to the light than the planet covered by the
+// texture, as a fraction of the outer radius, so that the edge texels the
+// rest of it is clamped to are lit
+constexpr float SunwardMargin = 1.0f / 16.0f;
+
+// Area of intersection of two circles of radius r0 and r1 whose centers
+// are d apart
+float
+intersectionArea(float r0, float r1, float d)
+{
+    if (d >= r0 + r1)
+        return 0.0f;
+
+    if (d <= std::abs(r0 - r1))
+    {
+        float r = std::min(r0, r1);
+        return celestia::numbers::pi_v<float> * r * r;
+    }
+
+    float a0 = std::acos(std::clamp((d * d + r0 * r0 - r1 * r1) / (2.0f * d * r0), -1.0f, 1.0f));
+    float a1 = std::acos(std::clamp((d * d + r1 * r1 - r0 * r0) / (2.0f * d * r1), -1.0f, 1.0f));
+    float k = (-d + r0 + r1) * (d + r0 - r1) * (d - r0 + r1) * (d + r0 + r1);
+    return r0 * r0 * a0 + r1 * r1 * a1 - 0.5f * std::sqrt(std::max(k, 0.0f));
+}
+
+} // end unnamed namespace
+
+RingShadowCache::RingShadowCache(unsigned int size) :
+    m_size(size)
+{
+}
+
+bool
+RingShadowCache::canReuse(const Key& wanted) const
+{
+    if (m_pixels.empty() ||
+        m_key.outerRadius != wanted.outerRadius ||
+        m_key.oblateness != wanted.oblateness)
+    {
+        return false;
+    }
+
+    // The shadow edge at the outer radius moves by half a texel; while the
+    // light is low, the shadow reaches beyond the rings and only its sides
+    // move.
+    float texel = 1.0f / static_cast<float>(m_size);
+    float elevationTolerance = 0.5f * texel * std::max(wanted.lightElevation, 1.0f / wanted.outerRadius);
+    // The penumbra at the outer radius is 2 * sunRadius * outerRadius wide
+    float sunRadiusTolerance = 0.25f * texel;
+
+    return std::abs(m_key.lightElevation - wanted.lightElevation) <= elevationTolerance &&
+           std::abs(m_key.sunRadius - wanted.sunRadius) <= sunRadiusTolerance;
+}
+
+void
+RingShadowCache::bake(const Key& key)
+{
+    m_key = key;
+    m_pixels.resize(static_cast<std::size_t>(m_size) * m_size);
+
+    // Bake for a light in the xy plane shining towards +x, so that the
+    // texture's s axis is z and its t axis x.
+    float elevation = std::clamp(key.lightElevation, 0.0f, 1.0f);
+    Eigen::Vector3f lightDirection(-std::sqrt(1.0f - elevation * elevation), elevation, 0.0f);
+    float margin = key.outerRadius * SunwardMargin;
+
+    auto size = static_cast<float>(m_size);
+    for (unsigned int j = 0; j < m_size; j++)
+    {
+        float along = (static_cast<float>(j) + 0.5f) / size * (key.outerRadius + margin) - margin;
+        std::uint8_t* row = m_pixels.data() + static_cast<std::size_t>(j) * m_size;
+        if (along < 0.0f)
+        {
+            // All of the ring nearer to the light than the planet is lit
+            std::fill_n(row, m_size, std::uint8_t(255));
+            continue;
+        }
+
+        for (unsigned int i = 0; i < m_size; i++)
+        {
+            float across = ((static_cast<float>(i) + 0.5f) / size * 2.0f - 1.0f) * HalfWidth;
+            float lit = sunlitFraction(Eigen::Vector3f(along, 0.0f, across), lightDirection,
+                                       key.sunRadius, key.oblateness);
+            row[i] = static_cast<std::uint8_t>(lit * 255.0f + 0.5f);
+        }
+    }
+}
+
+void
+RingShadowCache::texGen(const Eigen::Vector3f& lightDirection,
+                        float outerRadius,
+                        Eigen::Vector4f& texGenS,
+                        Eigen::Vector4f& texGenT)
+{
+    // Across the shadow, and away from the light in the ring plane
+    Eigen::Vector3f across = Eigen::Vector3f::UnitY().cross(lightDirection);
+    if (across.squaredNorm() < 1.0e-12f)
+        across = Eigen::Vector3f::UnitX();
+    across.normalize();
+    Eigen::Vector3f along = Eigen::Vector3f::UnitY().cross(across);
+
+    float margin = outerRadius * SunwardMargin;
+    texGenS.head(3) = across / (2.0f * HalfWidth);
+    texGenS[3] = 0.5f;
+    texGenT.head(3) = along / (outerRadius + margin);
+    texGenT[3] = margin / (outerRadius + margin);
+}
+
+float
+RingShadowCache::sunlitFraction(const Eigen::Vector3f& position,
+                                const Eigen::Vector3f& lightDirection,
+                                float sunRadius,
+                                float oblateness)
+{
+    // Stretch the polar axis to make the planet a unit sphere
+    float polarScale = 1.0f / (1.0f - oblateness);
+    Eigen::Vector3f point(position.x(), position.y() * polarScale, position.z());
+    Eigen::Vector3f light = Eigen::Vector3f(lightDirection.x(),
+                                            lightDirection.y() * polarScale,
+                                            lightDirection.z()).normalized();
+
+    float distance = point.norm();
+    if (distance <= 1.0f)
+        return 0.0f;
+
+    // Angular radius of the planet and angle between it and the sun
+    float planetRadius = std::asin(1.0f / distance);
+    float separation = std::acos(std::clamp(-point.dot(light) / distance, -1.0f, 1.0f));
+
+    if (sunRadius <= 0.0f)
+        return separation >= planetRadius ? 1.0f : 0.0f;
+
+    float sunArea = celestia::numbers::pi_v<float> * sunRadius * sunRadius;
+    return 1.0f - intersectionArea(sunRadius, planetRadius, separation) / sunArea;
+}
@@ -0,0 +1,73 @@
+// ringshadowcache.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+// The shadow of a planet on its rings, baked into a texture in the ring
+// plane. The texture is aligned with the light, so it depends on the light
+// elevation above the rings and on the apparent size of the sun but not on
+// the rotation of the planet, and it only has to be baked again once the
+// shadow edge would move by more than half a texel.
+//
+// Positions are in the frame of the planet in units of its equatorial
+// radius, with the rings in the xz plane.
+class RingShadowCache
+{
+ public:
+    struct Key
+    {
+        // Sine of the elevation of the light above the ring plane
+        float lightElevation;
+        // Angular radius of the sun in radians
+        float sunRadius;
+        float outerRadius;
+        float oblateness;
+    };
+
+    explicit RingShadowCache(unsigned int size);
+
+    unsigned int size() const { return m_size; }
+    bool empty() const { return m_pixels.empty(); }
+
+    // The key the texture was last baked for
+    const Key& key() const { return m_key; }
+
+    // Texture rows of the unshadowed fraction of sunlight, from 0 to 255
+    const std::vector<std::uint8_t>& pixels() const { return m_pixels; }
+
+    // Whether the texture baked for the key can stand in for one baked for
+    // the wanted key
+    bool canReuse(const Key& wanted) const;
+
+    void bake(const Key& key);
+
+    // Texture coordinate generation planes mapping positions in the ring
+    // plane to the texture for a light direction
+    static void texGen(const Eigen::Vector3f& lightDirection,
+                       float outerRadius,
+                       Eigen::Vector4f& texGenS,
+                       Eigen::Vector4f& texGenT);
+
+    // Fraction of the disc of the sun seen from a point which isn't hidden
+    // by the planet
+    static float sunlitFraction(const Eigen::Vector3f& position,
+                                const Eigen::Vector3f& lightDirection,
+                                float sunRadius,
+                                float oblateness);
+
+ private:
+    unsigned int m_size;
+    Key m_key{ 0.0f, 0.0f, 0.0f, 0.0f };
+    std::vector<std::uint8_t> m_pixels;
+};
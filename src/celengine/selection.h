@@ -10,6 +10,8 @@
 #ifndef _CELENGINE_SELECTION_H_
 #define _CELENGINE_SELECTION_H_
 
+#include <cstddef>
+#include <functional>
 #include <string>
 #include <celengine/univcoord.h>
 #include <Eigen/Core>
@@ -104,4 +106,16 @@ inline bool operator!=(const Selection& s0, const Selection& s1)
     return s0.type < s1.type || s0.obj < s1.obj;
 }*/
 
+namespace std
+{
+template<>
+struct hash<Selection>
+{
+    std::size_t operator()(const Selection& sel) const noexcept
+    {
+        return std::hash<const void*>()(sel.object()) ^ static_cast<std::size_t>(sel.getType());
+    }
+};
+}
+
 #endif // _CELENGINE_SELECTION_H_
@@ -0,0 +1,190 @@
+// shadercache.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <array>
+#include <fstream>
+#include <system_error>
+#include <fmt/format.h>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/logger.h>
+#include "glsupport.h"
+#include "glshader.h"
+#include "shadercache.h"
+#include "shadermanager.h"
+
+namespace celutil = celestia::util;
+using celutil::GetLogger;
+
+namespace
+{
+
+constexpr std::string_view ProgramCacheMagic = "CELSHBIN";
+constexpr std::uint16_t ProgramCacheVersion = 0x0100;
+
+constexpr const char* PropertiesFilename = "properties.txt";
+
+// Binaries are a few hundred kilobytes at most; anything larger is a
+// corrupted file.
+constexpr std::uint32_t MaxBinarySize = 16 * 1024 * 1024;
+
+std::uint64_t
+hashBytes(std::uint64_t hash, std::string_view bytes)
+{
+    // FNV-1a
+    for (char c : bytes)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string
+getGLString(GLenum name)
+{
+    const auto* s = reinterpret_cast<const char*>(glGetString(name));
+    return s == nullptr ? std::string() : std::string(s);
+}
+
+} // end unnamed namespace
+
+
+ShaderCache::ShaderCache(const fs::path& directory) :
+    cache(directory, ProgramCacheVersion)
+{
+    driver = fmt::format("{}\n{}\n{}\n",
+                         getGLString(GL_VENDOR),
+                         getGLString(GL_RENDERER),
+                         getGLString(GL_VERSION));
+}
+
+
+std::uint64_t
+ShaderCache::getKey(std::initializer_list<std::string_view> sources) const
+{
+    std::uint64_t hash = hashBytes(14695981039346656037ull, driver);
+    for (auto source : sources)
+    {
+        // Include the lengths so that moving text from one stage to the
+        // next changes the key.
+        hash = hashBytes(hash, fmt::format("{}\n", source.size()));
+        hash = hashBytes(hash, source);
+    }
+    return hash;
+}
+
+
+fs::path
+ShaderCache::getPath(std::uint64_t key) const
+{
+    return cache.getDirectory() / fmt::format("{:016x}.bin", key);
+}
+
+
+GLProgram*
+ShaderCache::load(std::uint64_t key) const
+{
+    if (!celestia::gl::ARB_get_program_binary)
+        return nullptr;
+
+    fs::path path = getPath(key);
+    if (!celutil::DiskCache::use(path))
+        return nullptr;
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in.good())
+        return nullptr;
+
+    std::array<char, ProgramCacheMagic.size()> magic;
+    std::uint16_t version;
+    std::uint64_t storedKey;
+    std::uint32_t format;
+    std::uint32_t size;
+    std::vector<char> binary;
+    bool ok = in.read(magic.data(), magic.size()).good()
+        && std::string_view(magic.data(), magic.size()) == ProgramCacheMagic
+        && celutil::readLE<std::uint16_t>(in, version) && version == ProgramCacheVersion
+        && celutil::readLE<std::uint64_t>(in, storedKey) && storedKey == key
+        && celutil::readLE<std::uint32_t>(in, format)
+        && celutil::readLE<std::uint32_t>(in, size) && size > 0 && size <= MaxBinarySize;
+    if (ok)
+    {
+        binary.resize(size);
+        ok = in.read(binary.data(), size).good();
+    }
+
+    GLProgram* prog = nullptr;
+    if (ok && GLShaderLoader::CreateProgramFromBinary(format, binary, &prog) == ShaderStatus_OK)
+        return prog;
+
+    in.close();
+    std::error_code ec;
+    fs::remove(path, ec);
+    return nullptr;
+}
+
+
+void
+ShaderCache::store(std::uint64_t key, const GLProgram& prog) const
+{
+    GLenum format;
+    std::vector<char> binary;
+    if (!prog.getBinary(format, binary) || binary.size() > MaxBinarySize)
+        return;
+
+    fs::path path = getPath(key);
+    bool ok = celutil::DiskCache::write(path, [key, format, &binary](const fs::path& tempPath)
+    {
+        std::ofstream out(tempPath, std::ios::out | std::ios::binary);
+        bool written = out.write(ProgramCacheMagic.data(), ProgramCacheMagic.size()).good()
+            && celutil::writeLE<std::uint16_t>(out, ProgramCacheVersion)
+            && celutil::writeLE<std::uint64_t>(out, key)
+            && celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(format))
+            && celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(binary.size()))
+            && out.write(binary.data(), binary.size()).good();
+        out.close();
+        return written && out.good();
+    });
+
+    if (!ok)
+        GetLogger()->warn("Failed to write the shader cache {}\n", path);
+}
+
+
+std::vector<ShaderProperties>
+ShaderCache::loadProperties() const
+{
+    std::vector<ShaderProperties> properties;
+    std::ifstream in(cache.getDirectory() / PropertiesFilename);
+    if (!in.good())
+        return properties;
+
+    ShaderProperties props;
+    while (in >> props.nLights >> props.lightModel >> props.texUsage
+              >> props.effects >> props.shadowCounts >> props.fishEyeOverride)
+    {
+        properties.push_back(props);
+    }
+
+    return properties;
+}
+
+
+void
+ShaderCache::storeProperties(const ShaderProperties& props) const
+{
+    std::error_code ec;
+    fs::create_directories(cache.getDirectory(), ec);
+    if (ec)
+        return;
+
+    std::ofstream out(cache.getDirectory() / PropertiesFilename, std::ios::out | std::ios::app);
+    out << props.nLights << ' ' << props.lightModel << ' ' << props.texUsage << ' '
+        << props.effects << ' ' << props.shadowCounts << ' ' << props.fishEyeOverride << '\n';
+}
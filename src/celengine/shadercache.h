@@ -0,0 +1,54 @@
+// shadercache.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Persistent cache of linked shader program binaries.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celutil/diskcache.h>
+
+class GLProgram;
+class ShaderProperties;
+
+// Programs are stored in one file each, named after a hash of their
+// sources and of the GL vendor, renderer and version strings; a driver
+// update leaves the old files unused. Binaries the driver rejects are
+// removed so that the program is compiled and stored again.
+//
+// The cache also keeps the list of shader properties programs were
+// generated for, so that they can be built ahead of time on the next run.
+class ShaderCache
+{
+ public:
+    // Requires a current GL context
+    explicit ShaderCache(const fs::path& directory);
+
+    std::uint64_t getKey(std::initializer_list<std::string_view> sources) const;
+
+    // Return a linked program created from the binary stored for the key,
+    // or nullptr if there is none or the driver won't use it.
+    GLProgram* load(std::uint64_t key) const;
+    void store(std::uint64_t key, const GLProgram& prog) const;
+
+    std::vector<ShaderProperties> loadProperties() const;
+    void storeProperties(const ShaderProperties& props) const;
+
+ private:
+    fs::path getPath(std::uint64_t key) const;
+
+    celestia::util::DiskCache cache;
+    std::string driver;
+};
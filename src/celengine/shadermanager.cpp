@@ -23,6 +23,7 @@
 #include <fmt/format.h>
 
 #include <celcompat/filesystem.h>
+#include <celutil/loadtrace.h>
 #include <celutil/logger.h>
 #include "atmosphere.h"
 #include "glsupport.h"
@@ -88,6 +89,9 @@ const char * const GeomHeaderGL3 = VertexHeader;
 const char *VPFunction =
     "#ifdef FISHEYE\n"
     "vec4 calc_vp(vec4 in_Position)\n{\n"
+    "#ifdef INSTANCED\n"
+    "    in_Position = instanceTransform(in_Position);\n"
+    "#endif\n"
     "    float PID2 = 1.570796326794896619231322;\n"
     "    vec4 inPos = ModelViewMatrix * in_Position;\n"
     "    float l = length(inPos.xy);\n"
@@ -101,6 +105,9 @@ const char *VPFunction =
     "}\n"
     "#else\n"
     "vec4 calc_vp(vec4 in_Position)\n{\n"
+    "#ifdef INSTANCED\n"
+    "    in_Position = instanceTransform(in_Position);\n"
+    "#endif\n"
     "    return MVPMatrix * in_Position;\n"
     "}\n"
     "#endif\n"
@@ -123,10 +130,32 @@ const char* LineVertexPosition =
     "gl_Position.xy += transform;\n"
     "gl_Position *= w;\n";
 
+// The quad of an instanced segment: in_ScaleFactor holds the side of the
+// line, which end of the segment the vertex is at and whether the quad is
+// extended by half the line width beyond the end, which fills the gaps at
+// the joins of line strips.
+const char* InstancedLineVertexPosition =
+    "vec4 thisPos = calc_vp(mix(in_Position, in_PositionNext, in_ScaleFactor.y));\n"
+    "vec4 nextPos = calc_vp(mix(in_PositionNext, in_Position, in_ScaleFactor.y));\n"
+    "float w = thisPos.w;\n"
+    "thisPos /= w;\n"
+    "nextPos /= nextPos.w;\n"
+    "vec2 direction = normalize(nextPos.xy - thisPos.xy);\n"
+    "vec2 lineWidth = vec2(lineWidthX, lineWidthY);\n"
+    "gl_Position = thisPos;\n"
+    "gl_Position.xy += vec2(direction.y, -direction.x) * lineWidth * in_ScaleFactor.x;\n"
+    "gl_Position.xy -= direction * lineWidth * (0.5 * in_ScaleFactor.z);\n"
+    "gl_Position *= w;\n"
+    "lineEdge = 2.0 * in_ScaleFactor.x * (1.0 - 2.0 * in_ScaleFactor.y);\n";
+
 
 std::string VertexPosition(const ShaderProperties& props)
 {
-    return (props.texUsage & ShaderProperties::LineAsTriangles) ? LineVertexPosition : NormalVertexPosition;
+    if ((props.texUsage & ShaderProperties::LineAsTriangles) == 0)
+        return NormalVertexPosition;
+    if ((props.texUsage & ShaderProperties::InstancedLines) != 0)
+        return InstancedLineVertexPosition;
+    return LineVertexPosition;
 }
 
 const char* FragmentHeader = "";
@@ -1321,8 +1350,12 @@ TextureSamplerDeclarations(const ShaderProperties& props)
     {
 #if GL_ONLY_SHADOWS
         source += DeclareUniform("shadowMapTex0", Shader_Sampler2DShadow);
+        if (props.texUsage & ShaderProperties::ShadowMapCascade)
+            source += DeclareUniform("shadowMapTex1", Shader_Sampler2DShadow);
 #else
         source += DeclareUniform("shadowMapTex0", Shader_Sampler2D);
+        if (props.texUsage & ShaderProperties::ShadowMapCascade)
+            source += DeclareUniform("shadowMapTex1", Shader_Sampler2D);
 #endif
     }
 
@@ -1368,6 +1401,8 @@ TextureCoordDeclarations(const ShaderProperties& props)
     if (props.texUsage & ShaderProperties::ShadowMapTexture)
     {
         source += DeclareVarying("shadowTexCoord0", Shader_Vector4);
+        if (props.texUsage & ShaderProperties::ShadowMapCascade)
+            source += DeclareVarying("shadowTexCoord1", Shader_Vector4);
         source += DeclareVarying("cosNormalLightDir", Shader_Float);
     }
 
@@ -1405,25 +1440,190 @@ StaticPointSize()
 }
 
 static std::string
-LineDeclaration()
+LineDeclaration(const ShaderProperties& props)
 {
     std::string source;
     source += DeclareAttribute("in_PositionNext", Shader_Vector4);
-    source += DeclareAttribute("in_ScaleFactor", Shader_Float);
+    if ((props.texUsage & ShaderProperties::InstancedLines) != 0)
+    {
+        source += DeclareAttribute("in_ScaleFactor", Shader_Vector3);
+        source += DeclareVarying("lineEdge", Shader_Float);
+    }
+    else
+    {
+        source += DeclareAttribute("in_ScaleFactor", Shader_Float);
+    }
     source += DeclareUniform("lineWidthX", Shader_Float);
     source += DeclareUniform("lineWidthY", Shader_Float);
     return source;
 }
 
+// Vertices of terrain chunks are positions on a grid of the chunk, which
+// are displaced by the height map and morphed to the grid of the parent
+// chunk as the distance approaches the end of the chunk's range. The
+// computed attributes replace the vertex attributes in the rest of the
+// shader.
+const char* TerrainVertexFunction = R"glsl(
+uniform sampler2D heightTex;
+uniform vec4 terrainBounds;
+uniform vec4 heightTexRect;
+uniform float heightTexLOD;
+uniform float heightScale;
+uniform float skirtDepth;
+uniform float morphStart;
+uniform float morphScale;
+uniform float gridSize;
+
+vec4 terrain_Position;
+vec3 terrain_Normal;
+vec3 terrain_Tangent;
+vec4 terrain_TexCoord;
+
+vec3 terrainDirection(vec2 uv)
+{
+    float theta = (1.0 - uv.x) * 6.283185307179586;
+    float phi = (0.5 - uv.y) * 3.141592653589793;
+    return vec3(cos(phi) * cos(theta), sin(phi), cos(phi) * sin(theta));
+}
+
+vec3 terrainPoint(vec2 grid)
+{
+    vec2 t = grid / gridSize;
+    float h = texture2DLod(heightTex, heightTexRect.xy + t * heightTexRect.zw, heightTexLOD).r;
+    return terrainDirection(terrainBounds.xy + t * terrainBounds.zw) * (1.0 + h * heightScale);
+}
+
+void computeTerrainVertex()
+{
+    vec2 grid = in_Position.xy;
+    float morph = clamp((distance(eyePosition, terrainPoint(grid)) - morphStart) * morphScale, 0.0, 1.0);
+    grid -= fract(grid * 0.5) * 2.0 * morph;
+
+    vec2 uv = terrainBounds.xy + grid / gridSize * terrainBounds.zw;
+    vec3 p = terrainPoint(grid);
+    vec3 n = cross(terrainPoint(grid + vec2(0.0, 1.0)) - terrainPoint(grid - vec2(0.0, 1.0)),
+                   terrainPoint(grid + vec2(1.0, 0.0)) - terrainPoint(grid - vec2(1.0, 0.0)));
+    // The grid rows at the poles are degenerate
+    terrain_Normal = dot(n, n) > 1.0e-12 ? normalize(n) : normalize(p);
+
+    float theta = (1.0 - uv.x) * 6.283185307179586;
+    vec3 t = vec3(sin(theta), 0.0, -cos(theta));
+    terrain_Tangent = normalize(t - terrain_Normal * dot(t, terrain_Normal));
+
+    p -= normalize(p) * (in_Position.z * skirtDepth);
+    terrain_Position = vec4(p, 1.0);
+    terrain_TexCoord = vec4(uv, 0.0, 1.0);
+}
+
+#define in_Position terrain_Position
+#define in_Normal terrain_Normal
+#define in_Tangent terrain_Tangent
+#define in_TexCoord0 terrain_TexCoord
+#define in_TexCoord1 terrain_TexCoord
+#define in_TexCoord2 terrain_TexCoord
+#define in_TexCoord3 terrain_TexCoord
+)glsl";
+
+// Normals stored in two components are unfolded from the octahedron onto
+// the sphere before anything else uses them.
+const char* OctahedralNormalFunction = R"glsl(
+vec3 oct_Normal;
+
+void computeOctahedralNormal()
+{
+    vec3 n = vec3(in_Normal.xy, 1.0 - abs(in_Normal.x) - abs(in_Normal.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    oct_Normal = normalize(n);
+}
+
+#define in_Normal oct_Normal
+)glsl";
+
+// The vertices of an animated mesh are moved by the current transform of
+// its track before anything else uses them, so lighting is still computed
+// in model coordinates. The matrix also maps quantized positions to the
+// model, so it may scale, and normals are renormalized.
 std::string
-CalculateShadow()
+MeshTransformFunction(const ShaderProperties& props)
+{
+    std::string source = R"glsl(
+uniform mat4 MeshMatrix;
+
+vec4 mesh_Position;
+vec3 mesh_Normal;
+)glsl";
+    if (props.usesTangentSpaceLighting())
+        source += "vec3 mesh_Tangent;\n";
+
+    source += "\nvoid computeMeshTransform()\n{\n";
+    source += "    mesh_Position = MeshMatrix * in_Position;\n";
+    source += "    mesh_Normal = normalize(vec3(MeshMatrix * vec4(in_Normal, 0.0)));\n";
+    if (props.usesTangentSpaceLighting())
+        source += "    mesh_Tangent = normalize(vec3(MeshMatrix * vec4(in_Tangent, 0.0)));\n";
+    source += "}\n\n";
+
+    source += "#define in_Position mesh_Position\n";
+    source += "#define in_Normal mesh_Normal\n";
+    if (props.usesTangentSpaceLighting())
+        source += "#define in_Tangent mesh_Tangent\n";
+
+    return source;
+}
+
+// Instances of a model are placed by the rows of their transform to the
+// camera frame, with the translation in w, and lit by a light direction of
+// their own. The eye position in model coordinates is the inverse
+// transform of the origin, from the adjugate of the upper 3x3 part.
+const char* InstanceVertexFunction = R"glsl(
+attribute vec4 in_InstanceTransform0;
+attribute vec4 in_InstanceTransform1;
+attribute vec4 in_InstanceTransform2;
+attribute vec4 in_InstanceLight;
+
+vec3 instance_EyePosition;
+
+vec4 instanceTransform(vec4 p)
+{
+    return vec4(dot(in_InstanceTransform0, p),
+                dot(in_InstanceTransform1, p),
+                dot(in_InstanceTransform2, p),
+                p.w);
+}
+
+void computeInstance()
+{
+    vec3 r0 = in_InstanceTransform0.xyz;
+    vec3 r1 = in_InstanceTransform1.xyz;
+    vec3 r2 = in_InstanceTransform2.xyz;
+    vec3 c0 = cross(r1, r2);
+    vec3 t = vec3(in_InstanceTransform0.w, in_InstanceTransform1.w, in_InstanceTransform2.w);
+    instance_EyePosition = -(c0 * t.x + cross(r2, r0) * t.y + cross(r0, r1) * t.z) / dot(r0, c0);
+}
+
+#define eyePosition instance_EyePosition
+#define INSTANCED
+)glsl";
+
+// The per pixel specular model without tangent space lighting reads the
+// half vector, which depends on the instance
+bool
+UsesInstanceHalfVector(const ShaderProperties& props)
+{
+    return (props.texUsage & ShaderProperties::InstancedTransforms) != 0 &&
+           (props.lightModel & ShaderProperties::PerPixelSpecularModel) != 0 &&
+           !props.usesTangentSpaceLighting();
+}
+
+std::string
+CalculateShadow(const ShaderProperties& props)
 {
     std::string source;
 #if GL_ONLY_SHADOWS
     source += R"glsl(
-float calculateShadow()
+float sampleShadowMap(sampler2DShadow shadowMapTex, vec3 shadowTexCoord, float texelSize)
 {
-    float texelSize = 1.0 / shadowMapSize;
     float s = 0.0;
     float bias = max(0.005 * (1.0 - cosNormalLightDir), 0.0005);
 )glsl";
@@ -1433,28 +1633,39 @@ float calculateShadow()
     float sampleWeight = 1.0f / (float) (ShadowSampleKernelWidth * ShadowSampleKernelWidth);
     source += fmt::format("    for (float y = {:f}; y <= {:f}; y += 1.0)\n", firstSample, lastSample);
     source += fmt::format("        for (float x = {:f}; x <= {:f}; x += 1.0)\n", firstSample, lastSample);
-    source += "            s += shadow2D(shadowMapTex0, shadowTexCoord0.xyz + vec3(x * texelSize, y * texelSize, bias)).z;\n";
+    source += "            s += shadow2D(shadowMapTex, shadowTexCoord + vec3(x * texelSize, y * texelSize, bias)).z;\n";
     source += fmt::format("    return s * {:f};\n", sampleWeight);
     source += "}\n";
 #else
     source += R"glsl(
-float calculateShadow()
+float sampleShadowMap(sampler2D shadowMapTex, vec3 shadowTexCoord, float texelSize)
 {
-    float texelSize = 1.0 / shadowMapSize;
     float s = 0.0;
     float bias = max(0.005 * (1.0 - cosNormalLightDir), 0.0005);
     for(float x = -1.0; x <= 1.0; x += 1.0)
     {
         for(float y = -1.0; y <= 1.0; y += 1.0)
         {
-            float pcfDepth = texture2D(shadowMapTex0, shadowTexCoord0.xy + vec2(x * texelSize, y * texelSize)).r;
-            s += shadowTexCoord0.z - bias > pcfDepth ? 1.0 : 0.0;
+            float pcfDepth = texture2D(shadowMapTex, shadowTexCoord.xy + vec2(x * texelSize, y * texelSize)).r;
+            s += shadowTexCoord.z - bias > pcfDepth ? 1.0 : 0.0;
         }
     }
     return 1.0 - s / 9.0;
 }
 )glsl";
 #endif
+
+    source += "float calculateShadow()\n{\n";
+    if (props.texUsage & ShaderProperties::ShadowMapCascade)
+    {
+        // The finer cascade is used where the filter kernel stays within it
+        source += "    vec2 cascadeOffset = abs(shadowTexCoord1.xy - 0.5);\n";
+        source += fmt::format("    if (max(cascadeOffset.x, cascadeOffset.y) < 0.5 - {:f} / shadowMapSize1)\n",
+                              static_cast<float>(ShadowSampleKernelWidth));
+        source += "        return sampleShadowMap(shadowMapTex1, shadowTexCoord1.xyz, 1.0 / shadowMapSize1);\n";
+    }
+    source += "    return sampleShadowMap(shadowMapTex0, shadowTexCoord0.xyz, 1.0 / shadowMapSize);\n";
+    source += "}\n";
     return source;
 }
 
@@ -1473,6 +1684,10 @@ BindAttribLocations(const GLProgram *prog)
     glBindAttribLocation(prog->getID(), CelestiaGLProgram::ScaleFactorAttributeIndex,   "in_ScaleFactor");
     glBindAttribLocation(prog->getID(), CelestiaGLProgram::TangentAttributeIndex,       "in_Tangent");
     glBindAttribLocation(prog->getID(), CelestiaGLProgram::PointSizeAttributeIndex,     "in_PointSize");
+    glBindAttribLocation(prog->getID(), CelestiaGLProgram::InstanceTransform0AttributeIndex, "in_InstanceTransform0");
+    glBindAttribLocation(prog->getID(), CelestiaGLProgram::InstanceTransform1AttributeIndex, "in_InstanceTransform1");
+    glBindAttribLocation(prog->getID(), CelestiaGLProgram::InstanceTransform2AttributeIndex, "in_InstanceTransform2");
+    glBindAttribLocation(prog->getID(), CelestiaGLProgram::InstanceLightAttributeIndex,      "in_InstanceLight");
 }
 
 std::optional<std::string>
@@ -1605,6 +1820,14 @@ ShaderProperties::setEclipseShadowCountForLight(unsigned int lightIndex, unsigne
 }
 
 
+void
+ShaderProperties::setEclipseShadowsForLight(unsigned int lightIndex, std::size_t shadowCount)
+{
+    if (lightIndex < MaxShaderLights)
+        setEclipseShadowCountForLight(lightIndex, shadowCount > 0 ? MaxShaderEclipseShadows : 0);
+}
+
+
 bool
 ShaderProperties::hasRingShadowForLight(unsigned int lightIndex) const
 {
@@ -1782,6 +2005,11 @@ ShaderManager::~ShaderManager()
 
     dynamicShaders.clear();
 
+    for(const auto& shader : pendingShaders)
+        delete shader.second.program;
+
+    pendingShaders.clear();
+
     for(const auto& shader : staticShaders)
         delete shader.second;
 
@@ -1797,14 +2025,39 @@ ShaderManager::getShader(const ShaderProperties& props)
         // Shader already exists
         return iter->second;
     }
-    else
+
+    CelestiaGLProgram* prog = nullptr;
+    if (auto pending = pendingShaders.find(props); pending != pendingShaders.end())
     {
-        // Create a new shader and add it to the table of created shaders
-        CelestiaGLProgram* prog = buildProgram(props);
-        dynamicShaders[props] = prog;
+        // Synchronous compiles wait for the link to complete
+        if (useAsyncCompile() && !pending->second.program->isLinkComplete())
+            return findSubstitute(props);
 
-        return prog;
+        prog = finishProgram(props, pending->second);
+        pendingShaders.erase(pending);
     }
+    else if (useAsyncCompile() && props.nLights > 0)
+    {
+        // Only lit programs are big enough to be worth compiling in the
+        // background; the others are quicker to build than to wait for.
+        prog = startProgram(props);
+        if (prog == nullptr)
+            return findSubstitute(props);
+    }
+    else
+    {
+        celestia::util::LoadScope scope("shader", fmt::format("light model {}, {} lights", props.lightModel, props.nLights));
+        prog = buildProgram(props);
+    }
+
+    // Add the new shader to the table of created shaders
+    dynamicShaders[props] = prog;
+
+    // Remember the properties for the warm-up of the next run
+    if (programCache != nullptr && cachedProperties.insert(props).second)
+        programCache->storeProperties(props);
+
+    return prog;
 }
 
 CelestiaGLProgram*
@@ -1832,6 +2085,7 @@ ShaderManager::getShader(const std::string& name)
         return iter->second;
     }
 
+    celestia::util::LoadScope scope("shader", name);
     fs::path dir("shaders");
     auto vsName = dir / fmt::format("{}_vert.glsl", name);
     auto fsName = dir / fmt::format("{}_frag.glsl", name);
@@ -1842,6 +2096,7 @@ ShaderManager::getShader(const std::string& name)
     auto fs = ReadShaderFile(fsName);
     if (!fs.has_value())
         return getShader(name, errorVertexShaderSource, errorFragmentShaderSource);
+    scope.addBytes(vs->size() + fs->size());
 
     // Create a new shader and add it to the table of created shaders
     auto *prog = buildProgram(*vs, *fs);
@@ -1859,6 +2114,7 @@ ShaderManager::getShaderGL3(const std::string& name, const GeomShaderParams* par
         return iter->second;
     }
 
+    celestia::util::LoadScope scope("shader", name);
     fs::path dir("shaders");
     auto vsName = dir / fmt::format("{}_vert.glsl", name);
     auto fsName = dir / fmt::format("{}_frag.glsl", name);
@@ -1869,6 +2125,7 @@ ShaderManager::getShaderGL3(const std::string& name, const GeomShaderParams* par
     auto fs = ReadShaderFile(fsName);
     if (!fs.has_value())
         return getShader(name, errorVertexShaderSource, errorFragmentShaderSource);
+    scope.addBytes(vs->size() + fs->size());
 
     CelestiaGLProgram *prog = nullptr;
 
@@ -1909,7 +2166,7 @@ ShaderManager::getShaderGL3(const std::string& name, const std::string& vs, cons
 }
 
 
-GLVertexShader*
+std::string
 ShaderManager::buildVertexShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -2026,10 +2283,31 @@ ShaderManager::buildVertexShader(const ShaderProperties& props)
     }
 
     if (props.hasShadowMap())
+    {
         source += "uniform mat4 ShadowMatrix0;\n";
+        if (props.texUsage & ShaderProperties::ShadowMapCascade)
+            source += "uniform mat4 ShadowMatrix1;\n";
+    }
 
     if (props.texUsage & ShaderProperties::LineAsTriangles)
-        source += LineDeclaration();
+        source += LineDeclaration(props);
+
+    if (props.texUsage & ShaderProperties::OctahedralNormals)
+        source += OctahedralNormalFunction;
+
+    if (props.texUsage & ShaderProperties::MeshTransform)
+        source += MeshTransformFunction(props);
+
+    if (props.texUsage & ShaderProperties::TerrainDisplacement)
+        source += TerrainVertexFunction;
+
+    if (props.texUsage & ShaderProperties::InstancedTransforms)
+    {
+        source += InstanceVertexFunction;
+        source += "#define " + LightProperty(0, "direction") + " in_InstanceLight.xyz\n";
+        if (UsesInstanceHalfVector(props))
+            source += DeclareVarying("instance_HalfVector", Shader_Vector3);
+    }
 
     if (props.fishEyeOverride != ShaderProperties::FisheyeOverrideModeDisabled && fisheyeEnabled)
         source += "#define FISHEYE\n";
@@ -2038,6 +2316,17 @@ ShaderManager::buildVertexShader(const ShaderProperties& props)
 
     // Begin main() function
     source += "\nvoid main(void)\n{\n";
+    if (props.texUsage & ShaderProperties::OctahedralNormals)
+        source += "computeOctahedralNormal();\n";
+    if (props.texUsage & ShaderProperties::MeshTransform)
+        source += "computeMeshTransform();\n";
+    if (props.texUsage & ShaderProperties::TerrainDisplacement)
+        source += "computeTerrainVertex();\n";
+    if (props.texUsage & ShaderProperties::InstancedTransforms)
+        source += "computeInstance();\n";
+    if (UsesInstanceHalfVector(props))
+        source += "instance_HalfVector = normalize(" + LightProperty(0, "direction") + " + normalize(eyePosition));\n";
+
     if (props.isViewDependent() || props.hasScattering())
     {
         source += "vec3 eyeDir = normalize(eyePosition - in_Position.xyz);\n";
@@ -2251,20 +2540,22 @@ ShaderManager::buildVertexShader(const ShaderProperties& props)
         source += StaticPointSize();
 
     if (props.hasShadowMap())
+    {
         source += "shadowTexCoord0 = ShadowMatrix0 * vec4(in_Position.xyz, 1.0);\n";
+        if (props.texUsage & ShaderProperties::ShadowMapCascade)
+            source += "shadowTexCoord1 = ShadowMatrix1 * vec4(in_Position.xyz, 1.0);\n";
+    }
 
     source += VertexPosition(props);
     source += "}\n";
 
     DumpVSSource(source);
 
-    GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs);
-    return status == ShaderStatus_OK ? vs : nullptr;
+    return source;
 }
 
 
-GLFragmentShader*
+std::string
 ShaderManager::buildFragmentShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -2290,6 +2581,12 @@ ShaderManager::buildFragmentShader(const ShaderProperties& props)
     source += TextureSamplerDeclarations(props);
     source += TextureCoordDeclarations(props);
 
+    if (props.texUsage & ShaderProperties::InstancedLines)
+    {
+        source += DeclareVarying("lineEdge", Shader_Float);
+        source += DeclareUniform("lineFeather", Shader_Float);
+    }
+
     // Declare lighting parameters
     if (props.usesTangentSpaceLighting())
     {
@@ -2431,10 +2728,17 @@ ShaderManager::buildFragmentShader(const ShaderProperties& props)
     if (props.hasShadowMap())
     {
         source += DeclareUniform("shadowMapSize", Shader_Float);
-        source += CalculateShadow();
+        if (props.texUsage & ShaderProperties::ShadowMapCascade)
+            source += DeclareUniform("shadowMapSize1", Shader_Float);
+        source += CalculateShadow(props);
     }
 
     source += DeclareLights(props);
+    if (UsesInstanceHalfVector(props))
+    {
+        source += DeclareVarying("instance_HalfVector", Shader_Vector3);
+        source += "#define " + LightProperty(0, "halfVector") + " instance_HalfVector\n";
+    }
 
     source += "\nvoid main(void)\n{\n";
     source += "vec4 color;\n";
@@ -2699,18 +3003,22 @@ ShaderManager::buildFragmentShader(const ShaderProperties& props)
         source += "gl_FragColor.rgb = gl_FragColor.rgb * scatterEx + " + VarScatterInFS() + ";\n";
     }
 
+    // Antialiased edges of instanced lines
+    if (props.texUsage & ShaderProperties::InstancedLines)
+    {
+        source += "gl_FragColor.a *= clamp((1.0 - abs(lineEdge)) * lineFeather, 0.0, 1.0);\n";
+    }
+
     source += "}\n";
 
     DumpFSSource(source);
 
-    GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs);
-    return status == ShaderStatus_OK ? fs : nullptr;
+    return source;
 }
 
 
 #if 0
-GLVertexShader*
+std::string
 ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -2761,13 +3069,11 @@ ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
 
     DumpVSSource(source);
 
-    GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs);
-    return status == ShaderStatus_OK ? vs : nullptr;
+    return source;
 }
 
 
-GLFragmentShader*
+std::string
 ShaderManager::buildRingsFragmentShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -2847,14 +3153,12 @@ ShaderManager::buildRingsFragmentShader(const ShaderProperties& props)
 
     DumpFSSource(source);
 
-    GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs);
-    return status == ShaderStatus_OK ? fs : nullptr;
+    return source;
 }
 #endif
 
 
-GLVertexShader*
+std::string
 ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -2874,7 +3178,7 @@ ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
         source += "varying vec2 diffTexCoord;\n";
 
     if (props.texUsage & ShaderProperties::LineAsTriangles)
-        source += LineDeclaration();
+        source += LineDeclaration(props);
 
     if (props.fishEyeOverride != ShaderProperties::FisheyeOverrideModeDisabled && fisheyeEnabled)
         source += "#define FISHEYE\n";
@@ -2901,13 +3205,11 @@ ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
 
     DumpVSSource(source);
 
-    GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs);
-    return status == ShaderStatus_OK ? vs : nullptr;
+    return source;
 }
 
 
-GLFragmentShader*
+std::string
 ShaderManager::buildRingsFragmentShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -2928,6 +3230,9 @@ ShaderManager::buildRingsFragmentShader(const ShaderProperties& props)
         source += "uniform sampler2D diffTex;\n";
     }
 
+    if (props.texUsage & ShaderProperties::EclipseShadowTexture)
+        source += DeclareUniform("eclipseShadowTex", Shader_Sampler2D);
+
     if (props.hasEclipseShadows())
     {
         source += "varying vec4 shadowDepths;\n";
@@ -2983,8 +3288,18 @@ ShaderManager::buildRingsFragmentShader(const ShaderProperties& props)
         source += assign("intensity", mix(sh_float("intensity"), sh_float("intensity") * (1.0f - sh_float("opticalDepth")), sh_float("litSide")));
         if (props.getEclipseShadowCountForLight(i) > 0)
         {
-            source += "shadow = 1.0;\n";
-            source += Shadow(i, 0);
+            if (i == 0 && (props.texUsage & ShaderProperties::EclipseShadowTexture) != 0)
+            {
+                // The texture generation planes map to the baked shadow
+                source += "shadow = texture2D(eclipseShadowTex, vec2(dot(vec4(position_obj, 1.0), " +
+                    IndexedParameter("shadowTexGenS", i, 0) + "), dot(vec4(position_obj, 1.0), " +
+                    IndexedParameter("shadowTexGenT", i, 0) + "))).r;\n";
+            }
+            else
+            {
+                source += "shadow = 1.0;\n";
+                source += Shadow(i, 0);
+            }
             source += "shadow = min(1.0, shadow + step(0.0, " + ShadowDepth(i) + "));\n";
 #if 0
             source += "diff.rgb += (shadow * " + SeparateDiffuse(i) + ") * " +
@@ -3012,13 +3327,11 @@ ShaderManager::buildRingsFragmentShader(const ShaderProperties& props)
 
     DumpFSSource(source);
 
-    GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs);
-    return status == ShaderStatus_OK ? fs : nullptr;
+    return source;
 }
 
 
-GLVertexShader*
+std::string
 ShaderManager::buildAtmosphereVertexShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -3038,7 +3351,7 @@ ShaderManager::buildAtmosphereVertexShader(const ShaderProperties& props)
     source += "varying vec3 eyeDir_obj;\n";
 
     if (props.texUsage & ShaderProperties::LineAsTriangles)
-        source += LineDeclaration();
+        source += LineDeclaration(props);
 
     if (props.fishEyeOverride != ShaderProperties::FisheyeOverrideModeDisabled && fisheyeEnabled)
         source += "#define FISHEYE\n";
@@ -3059,13 +3372,11 @@ ShaderManager::buildAtmosphereVertexShader(const ShaderProperties& props)
 
     DumpVSSource(source);
 
-    GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs);
-    return status == ShaderStatus_OK ? vs : nullptr;
+    return source;
 }
 
 
-GLFragmentShader*
+std::string
 ShaderManager::buildAtmosphereFragmentShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -3116,15 +3427,13 @@ ShaderManager::buildAtmosphereFragmentShader(const ShaderProperties& props)
 
     DumpFSSource(source);
 
-    GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs);
-    return status == ShaderStatus_OK ? fs : nullptr;
+    return source;
 }
 
 
 // The emissive shader ignores all lighting and uses the diffuse color
 // as the final fragment color.
-GLVertexShader*
+std::string
 ShaderManager::buildEmissiveVertexShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -3152,7 +3461,10 @@ ShaderManager::buildEmissiveVertexShader(const ShaderProperties& props)
     source += DeclareVarying("v_TexCoord0", Shader_Vector2);
 
     if (props.texUsage & ShaderProperties::LineAsTriangles)
-        source += LineDeclaration();
+        source += LineDeclaration(props);
+
+    if (props.texUsage & ShaderProperties::MeshTransform)
+        source += MeshTransformFunction(props);
 
     if (props.fishEyeOverride != ShaderProperties::FisheyeOverrideModeDisabled && fisheyeEnabled)
         source += "#define FISHEYE\n";
@@ -3161,6 +3473,8 @@ ShaderManager::buildEmissiveVertexShader(const ShaderProperties& props)
 
     // Begin main() function
     source += "\nvoid main(void)\n{\n";
+    if (props.texUsage & ShaderProperties::MeshTransform)
+        source += "computeMeshTransform();\n";
 
     // Optional texture coordinates (generated automatically for point
     // sprites.)
@@ -3191,13 +3505,11 @@ ShaderManager::buildEmissiveVertexShader(const ShaderProperties& props)
 
     DumpVSSource(source);
 
-    GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs);
-    return status == ShaderStatus_OK ? vs : nullptr;
+    return source;
 }
 
 
-GLFragmentShader*
+std::string
 ShaderManager::buildEmissiveFragmentShader(const ShaderProperties& props)
 {
     std::string source(VersionHeader);
@@ -3247,14 +3559,12 @@ ShaderManager::buildEmissiveFragmentShader(const ShaderProperties& props)
 
     DumpFSSource(source);
 
-    GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs);
-    return status == ShaderStatus_OK ? fs : nullptr;
+    return source;
 }
 
 
 // Build the vertex shader used for rendering particle systems.
-GLVertexShader*
+std::string
 ShaderManager::buildParticleVertexShader(const ShaderProperties& props)
 {
     std::ostringstream source;
@@ -3284,7 +3594,7 @@ ShaderManager::buildParticleVertexShader(const ShaderProperties& props)
     }
 
     if (props.texUsage & ShaderProperties::LineAsTriangles)
-        source << LineDeclaration();
+        source << LineDeclaration(props);
 
     if (props.fishEyeOverride != ShaderProperties::FisheyeOverrideModeDisabled && fisheyeEnabled)
         source << "#define FISHEYE\n";
@@ -3329,13 +3639,11 @@ ShaderManager::buildParticleVertexShader(const ShaderProperties& props)
 
     DumpVSSource(source);
 
-    GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source.str(), &vs);
-    return status == ShaderStatus_OK ? vs : nullptr;
+    return source.str();
 }
 
 
-GLFragmentShader*
+std::string
 ShaderManager::buildParticleFragmentShader(const ShaderProperties& props)
 {
     std::ostringstream source;
@@ -3397,20 +3705,12 @@ ShaderManager::buildParticleFragmentShader(const ShaderProperties& props)
 
     DumpFSSource(source);
 
-    GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source.str(), &fs);
-    return status == ShaderStatus_OK ? fs : nullptr;
+    return source.str();
 }
 
-CelestiaGLProgram*
-ShaderManager::buildProgram(const ShaderProperties& props)
+void
+ShaderManager::buildSources(const ShaderProperties& props, std::string& vs, std::string& fs)
 {
-    GLProgram* prog = nullptr;
-    GLShaderStatus status;
-
-    GLVertexShader* vs = nullptr;
-    GLFragmentShader* fs = nullptr;
-
     if (props.lightModel == ShaderProperties::RingIllumModel)
     {
         vs = buildRingsVertexShader(props);
@@ -3436,35 +3736,152 @@ ShaderManager::buildProgram(const ShaderProperties& props)
         vs = buildVertexShader(props);
         fs = buildFragmentShader(props);
     }
+}
 
-    if (vs != nullptr && fs != nullptr)
+CelestiaGLProgram*
+ShaderManager::buildProgram(const ShaderProperties& props)
+{
+    GLProgram* prog = nullptr;
+
+    std::string vs;
+    std::string fs;
+    buildSources(props, vs, fs);
+
+    GLShaderStatus status = linkProgram(vs, nullptr, fs, &prog);
+    if (status != ShaderStatus_OK)
     {
-        status = GLShaderLoader::CreateProgram(*vs, *fs, &prog);
-        if (status == ShaderStatus_OK)
-        {
-            BindAttribLocations(prog);
-            status = prog->link();
-        }
+        // If the shader creation failed for some reason, substitute the
+        // error shader.
+        if (CreateErrorShader(&prog, fisheyeEnabled) != ShaderStatus_OK)
+            return nullptr;
     }
-    else
+
+    return new CelestiaGLProgram(*prog, props);
+}
+
+// Start compiling the program for the properties in the background.
+// Returns nullptr if it's pending, or the program if it could be loaded
+// from the program cache right away.
+CelestiaGLProgram*
+ShaderManager::startProgram(const ShaderProperties& props)
+{
+    std::string vs;
+    std::string fs;
+    buildSources(props, vs, fs);
+
+    PendingProgram pending;
+    if (programCache != nullptr)
     {
-        status = ShaderStatus_CompileError;
+        pending.cacheKey = programCache->getKey({ vs, fs });
+        if (GLProgram* prog = programCache->load(pending.cacheKey); prog != nullptr)
+            return new CelestiaGLProgram(*prog, props);
     }
 
-    delete vs;
-    delete fs;
+    GLShaderLoader::CreateProgramAsync(vs, fs, &pending.program);
+    BindAttribLocations(pending.program);
+    if (programCache != nullptr)
+        pending.program->setBinaryRetrievable();
+    pending.program->startLink();
 
-    if (status != ShaderStatus_OK)
+    pendingShaders.try_emplace(props, pending);
+    return nullptr;
+}
+
+CelestiaGLProgram*
+ShaderManager::finishProgram(const ShaderProperties& props, const PendingProgram& pending)
+{
+    GLProgram* prog = pending.program;
+    if (prog->getLinkStatus() != ShaderStatus_OK)
     {
-        // If the shader creation failed for some reason, substitute the
-        // error shader.
+        delete prog;
+        prog = nullptr;
         if (CreateErrorShader(&prog, fisheyeEnabled) != ShaderStatus_OK)
             return nullptr;
     }
+    else if (programCache != nullptr)
+    {
+        programCache->store(pending.cacheKey, *prog);
+    }
 
     return new CelestiaGLProgram(*prog, props);
 }
 
+// A program can stand in for another while that one is compiled if it has
+// the same light model and lights, and a subset of its textures, shadows
+// and effects; the uniforms it lacks are simply not set.
+bool
+ShaderManager::canSubstitute(const ShaderProperties& candidate, const ShaderProperties& props)
+{
+    // These change how the vertex attributes are interpreted
+    constexpr unsigned long PrimitiveFlags = ShaderProperties::PointSprite |
+                                             ShaderProperties::StaticPointSize |
+                                             ShaderProperties::LineAsTriangles |
+                                             ShaderProperties::InstancedLines |
+                                             ShaderProperties::InstancedTransforms |
+                                             ShaderProperties::MeshTransform |
+                                             ShaderProperties::OctahedralNormals;
+
+    if (candidate.lightModel != props.lightModel ||
+        candidate.nLights != props.nLights ||
+        candidate.fishEyeOverride != props.fishEyeOverride ||
+        (candidate.texUsage & PrimitiveFlags) != (props.texUsage & PrimitiveFlags) ||
+        (candidate.texUsage & ~props.texUsage) != 0 ||
+        (candidate.effects & ~props.effects) != 0)
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < MaxShaderLights; i++)
+    {
+        if (candidate.getEclipseShadowCountForLight(i) > props.getEclipseShadowCountForLight(i))
+            return false;
+    }
+
+    constexpr std::uint32_t OtherShadowMask = ShaderProperties::AnyRingShadowMask |
+                                              ShaderProperties::AnySelfShadowMask |
+                                              ShaderProperties::AnyCloudShadowMask;
+    return (candidate.shadowCounts & ~props.shadowCounts & OtherShadowMask) == 0;
+}
+
+// Find the existing program with the most features which can stand in for
+// the one with the properties, if there's any.
+CelestiaGLProgram*
+ShaderManager::findSubstitute(const ShaderProperties& props) const
+{
+    auto countBits = [](std::uint32_t bits)
+    {
+        int count = 0;
+        for (; bits != 0; bits &= bits - 1)
+            count++;
+        return count;
+    };
+
+    CelestiaGLProgram* substitute = nullptr;
+    int bestScore = -1;
+    for (const auto& [candidate, prog] : dynamicShaders)
+    {
+        if (prog == nullptr || !canSubstitute(candidate, props))
+            continue;
+
+        int score = countBits(static_cast<std::uint32_t>(candidate.texUsage)) +
+                    countBits(candidate.shadowCounts) +
+                    countBits(candidate.effects);
+        if (score > bestScore)
+        {
+            substitute = prog;
+            bestScore = score;
+        }
+    }
+
+    return substitute;
+}
+
+bool
+ShaderManager::useAsyncCompile() const
+{
+    return asyncCompile && !forceSynchronous && celestia::gl::KHR_parallel_shader_compile;
+}
+
 CelestiaGLProgram*
 ShaderManager::buildProgram(const std::string& vs, const std::string& fs)
 {
@@ -3476,12 +3893,7 @@ ShaderManager::buildProgram(const std::string& vs, const std::string& fs)
     DumpVSSource(_vs);
     DumpFSSource(_fs);
 
-    status = GLShaderLoader::CreateProgram(_vs, _fs, &prog);
-    if (status == ShaderStatus_OK)
-    {
-        BindAttribLocations(prog);
-        status = prog->link();
-    }
+    status = linkProgram(_vs, nullptr, _fs, &prog);
 
     if (status != ShaderStatus_OK)
     {
@@ -3505,12 +3917,7 @@ ShaderManager::buildProgramGL3(const std::string& vs, const std::string& fs)
     DumpVSSource(_vs);
     DumpFSSource(_fs);
 
-    status = GLShaderLoader::CreateProgram(_vs, _fs, &prog);
-    if (status == ShaderStatus_OK)
-    {
-        BindAttribLocations(prog);
-        status = prog->link();
-    }
+    status = linkProgram(_vs, nullptr, _fs, &prog);
 
     if (status != ShaderStatus_OK)
     {
@@ -3546,12 +3953,7 @@ ShaderManager::buildProgramGL3(const std::string& vs, const std::string& gs, con
     DumpGSSource(_gs);
     DumpFSSource(_fs);
 
-    status = GLShaderLoader::CreateProgram(_vs, _gs, _fs, &prog);
-    if (status == ShaderStatus_OK)
-    {
-        BindAttribLocations(prog);
-        status = prog->link();
-    }
+    status = linkProgram(_vs, &_gs, _fs, &prog);
 
     if (status != ShaderStatus_OK)
     {
@@ -3564,6 +3966,68 @@ ShaderManager::buildProgramGL3(const std::string& vs, const std::string& gs, con
     return new CelestiaGLProgram(*prog);
 }
 
+// Compile and link a program from its sources, or load it from the program
+// cache if it was stored there before.
+GLShaderStatus
+ShaderManager::linkProgram(const std::string& vs, const std::string* gs, const std::string& fs, GLProgram** prog)
+{
+    std::uint64_t key = 0;
+    if (programCache != nullptr)
+    {
+        key = gs == nullptr ? programCache->getKey({ vs, fs }) : programCache->getKey({ vs, *gs, fs });
+        *prog = programCache->load(key);
+        if (*prog != nullptr)
+            return ShaderStatus_OK;
+    }
+
+    GLShaderStatus status = gs == nullptr
+        ? GLShaderLoader::CreateProgram(vs, fs, prog)
+        : GLShaderLoader::CreateProgram(vs, *gs, fs, prog);
+    if (status != ShaderStatus_OK)
+        return status;
+
+    BindAttribLocations(*prog);
+    if (programCache != nullptr)
+        (*prog)->setBinaryRetrievable();
+    status = (*prog)->link();
+
+    if (status == ShaderStatus_OK && programCache != nullptr)
+        programCache->store(key, **prog);
+
+    return status;
+}
+
+void ShaderManager::enableProgramCache(const fs::path& directory)
+{
+    if (!celestia::gl::ARB_get_program_binary)
+        return;
+
+    programCache = std::make_unique<ShaderCache>(directory);
+    for (const auto& props : programCache->loadProperties())
+        cachedProperties.insert(props);
+}
+
+void ShaderManager::setAsyncCompile(bool enabled)
+{
+    asyncCompile = enabled;
+    if (enabled && celestia::gl::KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xffffffff);
+}
+
+void ShaderManager::setForceSynchronous(bool force)
+{
+    forceSynchronous = force;
+}
+
+void ShaderManager::warmUp()
+{
+    if (programCache == nullptr)
+        return;
+
+    for (const auto& props : cachedProperties)
+        getShader(props);
+}
+
 void ShaderManager::setFisheyeEnabled(bool enabled)
 {
     fisheyeEnabled = enabled;
@@ -3639,6 +4103,20 @@ CelestiaGLProgram::mat4Param(const std::string& paramName)
 }
 
 
+Vec4ArrayShaderParameter
+CelestiaGLProgram::vec4ArrayParam(const std::string& paramName)
+{
+    return Vec4ArrayShaderParameter(program->getID(), paramName.c_str());
+}
+
+
+Mat4ArrayShaderParameter
+CelestiaGLProgram::mat4ArrayParam(const std::string& paramName)
+{
+    return Mat4ArrayShaderParameter(program->getID(), paramName.c_str());
+}
+
+
 int
 CelestiaGLProgram::attribIndex(const std::string& paramName) const
 {
@@ -3719,6 +4197,13 @@ CelestiaGLProgram::initParameters()
     if (props.texUsage & ShaderProperties::ShadowMapTexture)
     {
         ShadowMatrix0       = mat4Param("ShadowMatrix0");
+        if (props.texUsage & ShaderProperties::ShadowMapCascade)
+            ShadowMatrix1   = mat4Param("ShadowMatrix1");
+    }
+
+    if (props.texUsage & ShaderProperties::MeshTransform)
+    {
+        MeshMatrix          = mat4Param("MeshMatrix");
     }
 
     if (props.hasScattering())
@@ -3749,6 +4234,24 @@ CelestiaGLProgram::initParameters()
         lineWidthX           = floatParam("lineWidthX");
         lineWidthY           = floatParam("lineWidthY");
     }
+
+    if (props.texUsage & ShaderProperties::InstancedLines)
+    {
+        lineFeather          = floatParam("lineFeather");
+    }
+
+    if (props.texUsage & ShaderProperties::TerrainDisplacement)
+    {
+        eyePosition          = vec3Param("eyePosition");
+        terrainBounds        = vec4Param("terrainBounds");
+        heightTexRect        = vec4Param("heightTexRect");
+        heightTexLOD         = floatParam("heightTexLOD");
+        heightScale          = floatParam("heightScale");
+        skirtDepth           = floatParam("skirtDepth");
+        morphStart           = floatParam("morphStart");
+        morphScale           = floatParam("morphScale");
+        gridSize             = floatParam("gridSize");
+    }
 }
 
 
@@ -3821,6 +4324,26 @@ CelestiaGLProgram::initSamplers()
         if (slot != -1)
             glUniform1i(slot, nSamplers++);
     }
+
+    if (props.texUsage & ShaderProperties::ShadowMapCascade)
+    {
+        int slot = glGetUniformLocation(program->getID(), "shadowMapTex1");
+        if (slot != -1)
+            glUniform1i(slot, nSamplers++);
+    }
+    if (props.texUsage & ShaderProperties::TerrainDisplacement)
+    {
+        int slot = glGetUniformLocation(program->getID(), "heightTex");
+        if (slot != -1)
+            glUniform1i(slot, nSamplers++);
+    }
+
+    if (props.texUsage & ShaderProperties::EclipseShadowTexture)
+    {
+        int slot = glGetUniformLocation(program->getID(), "eclipseShadowTex");
+        if (slot != -1)
+            glUniform1i(slot, nSamplers++);
+    }
 }
 
 
@@ -3951,6 +4474,16 @@ CelestiaGLProgram::setEclipseShadowParameters(const LightingState& ls,
                 shadowParams.texGenS = m.row(0);
                 shadowParams.texGenT = m.row(1);
             }
+
+            // With no depth the remaining slots leave the light unchanged
+            for (unsigned int i = nShadows; i < MaxShaderEclipseShadows; i++)
+            {
+                CelestiaGLProgramShadow& shadowParams = shadows[li][i];
+                shadowParams.falloff = 0.0f;
+                shadowParams.maxDepth = 0.0f;
+                shadowParams.texGenS = Eigen::Vector4f::Zero();
+                shadowParams.texGenT = Eigen::Vector4f::Zero();
+            }
         }
     }
 }
@@ -9,15 +9,20 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <map>
+#include <memory>
+#include <set>
 #include <string>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
+#include <celcompat/filesystem.h>
 #include <celutil/color.h>
 #include <celengine/glshader.h>
+#include <celengine/shadercache.h>
 
 
 class Atmosphere;
@@ -34,6 +39,11 @@ class ShaderProperties
 
     unsigned int getEclipseShadowCountForLight(unsigned int lightIndex) const;
     void setEclipseShadowCountForLight(unsigned int lightIndex, unsigned int shadowCount);
+    // Select the eclipse shadow slots for the shadows cast on an object by
+    // a light. Shaders evaluate either none or all MaxShaderEclipseShadows
+    // of them, so that the number of shadows doesn't multiply the number
+    // of shader programs; unused slots are set to cast no shadow.
+    void setEclipseShadowsForLight(unsigned int lightIndex, std::size_t shadowCount);
     bool hasEclipseShadows() const;
     bool hasRingShadowForLight(unsigned int lightIndex) const;
     void setRingShadowForLight(unsigned int lightIndex, bool enabled);
@@ -72,6 +82,19 @@ class ShaderProperties
      SharedTextureCoords     =  0x8000,
      StaticPointSize         = 0x10000,
      LineAsTriangles         = 0x20000,
+     TerrainDisplacement     = 0x40000,
+     InstancedTransforms     = 0x80000,
+     MeshTransform           = 0x100000,
+     ShadowMapCascade        = 0x200000,
+     // Lines as instanced segments: with LineAsTriangles, the segment end
+     // points are per instance attributes and in_ScaleFactor is the
+     // position on a template quad
+     InstancedLines          = 0x400000,
+     // The planet's shadow on its rings for the first light is read from
+     // a texture baked in the ring plane
+     EclipseShadowTexture    = 0x800000,
+     // in_Normal.xy is an octahedral encoding of the normal
+     OctahedralNormals       = 0x1000000,
  };
 
  enum
@@ -197,6 +220,11 @@ class CelestiaGLProgram
         IntensityAttributeIndex     = 9,
         NextVCoordAttributeIndex    = 10,
         ScaleFactorAttributeIndex   = 11,
+        // Rows of the transform of a model instance, and its light direction
+        InstanceTransform0AttributeIndex = 12,
+        InstanceTransform1AttributeIndex = 13,
+        InstanceTransform2AttributeIndex = 14,
+        InstanceLightAttributeIndex      = 15,
     };
 
  public:
@@ -263,12 +291,34 @@ class CelestiaGLProgram
     // Used to draw line as triangles
     FloatShaderParameter lineWidthX;
     FloatShaderParameter lineWidthY;
+    // Cross-line distance from the edge over which instanced lines fade
+    // out, in units of their half width
+    FloatShaderParameter lineFeather;
+
+    // Terrain chunk parameters: the chunk's rectangle in texture
+    // coordinates of the whole surface and of the height map tile, the
+    // height of the full height map value and the skirt depth in units of
+    // object radius, and the distance range over which the chunk morphs to
+    // its parent's grid, as start distance and inverse length.
+    Vec4ShaderParameter terrainBounds;
+    Vec4ShaderParameter heightTexRect;
+    FloatShaderParameter heightTexLOD;
+    FloatShaderParameter heightScale;
+    FloatShaderParameter skirtDepth;
+    FloatShaderParameter morphStart;
+    FloatShaderParameter morphScale;
+    FloatShaderParameter gridSize;
 
     // Color sent as a uniform
     Vec4ShaderParameter color;
 
-    // Matrix used to project to light space
+    // Matrices used to project to the light space of the shadow map and
+    // of its finer cascade
     Mat4ShaderParameter ShadowMatrix0;
+    Mat4ShaderParameter ShadowMatrix1;
+
+    // Transform of an animated mesh within its model
+    Mat4ShaderParameter MeshMatrix;
 
     CelestiaGLProgramShadow shadows[MaxShaderLights][MaxShaderEclipseShadows];
 
@@ -279,6 +329,8 @@ class CelestiaGLProgram
     Vec4ShaderParameter vec4Param(const std::string&);
     Mat3ShaderParameter mat3Param(const std::string&);
     Mat4ShaderParameter mat4Param(const std::string&);
+    Vec4ArrayShaderParameter vec4ArrayParam(const std::string&);
+    Mat4ArrayShaderParameter mat4ArrayParam(const std::string&);
 
     Mat4ShaderParameter ModelViewMatrix;
     Mat4ShaderParameter ProjectionMatrix;
@@ -317,29 +369,66 @@ class ShaderManager
 
     void setFisheyeEnabled(bool enabled);
 
+    // Store the linked programs in the directory and reuse them on later
+    // runs. Does nothing if the driver can't return program binaries.
+    void enableProgramCache(const fs::path& directory);
+    // Build the programs for all the shader properties recorded by the
+    // program cache in earlier runs.
+    void warmUp();
+
+    // With asynchronous compiles, which need KHR_parallel_shader_compile,
+    // a missing lit program is compiled in the background; until it's
+    // ready getShader() returns a similar program with fewer features, or
+    // nullptr if there's none. Forcing synchronous compiles, e.g. while
+    // recording a movie, makes getShader() wait for the program again.
+    void setAsyncCompile(bool enabled);
+    void setForceSynchronous(bool force);
+
  private:
     CelestiaGLProgram* buildProgram(const ShaderProperties&);
     CelestiaGLProgram* buildProgram(const std::string&, const std::string&);
     CelestiaGLProgram* buildProgramGL3(const std::string&, const std::string&);
     CelestiaGLProgram* buildProgramGL3(const std::string&, const std::string&, const std::string&, const GeomShaderParams* = nullptr);
 
-    GLVertexShader* buildVertexShader(const ShaderProperties&);
-    GLFragmentShader* buildFragmentShader(const ShaderProperties&);
+    std::string buildVertexShader(const ShaderProperties&);
+    std::string buildFragmentShader(const ShaderProperties&);
+
+    std::string buildRingsVertexShader(const ShaderProperties&);
+    std::string buildRingsFragmentShader(const ShaderProperties&);
 
-    GLVertexShader* buildRingsVertexShader(const ShaderProperties&);
-    GLFragmentShader* buildRingsFragmentShader(const ShaderProperties&);
+    std::string buildAtmosphereVertexShader(const ShaderProperties&);
+    std::string buildAtmosphereFragmentShader(const ShaderProperties&);
 
-    GLVertexShader* buildAtmosphereVertexShader(const ShaderProperties&);
-    GLFragmentShader* buildAtmosphereFragmentShader(const ShaderProperties&);
+    std::string buildEmissiveVertexShader(const ShaderProperties&);
+    std::string buildEmissiveFragmentShader(const ShaderProperties&);
 
-    GLVertexShader* buildEmissiveVertexShader(const ShaderProperties&);
-    GLFragmentShader* buildEmissiveFragmentShader(const ShaderProperties&);
+    std::string buildParticleVertexShader(const ShaderProperties&);
+    std::string buildParticleFragmentShader(const ShaderProperties&);
 
-    GLVertexShader* buildParticleVertexShader(const ShaderProperties&);
-    GLFragmentShader* buildParticleFragmentShader(const ShaderProperties&);
+    struct PendingProgram
+    {
+        GLProgram* program{ nullptr };
+        std::uint64_t cacheKey{ 0 };
+    };
+
+    void buildSources(const ShaderProperties&, std::string& vs, std::string& fs);
+    GLShaderStatus linkProgram(const std::string& vs, const std::string* gs, const std::string& fs, GLProgram** prog);
+
+    CelestiaGLProgram* startProgram(const ShaderProperties&);
+    CelestiaGLProgram* finishProgram(const ShaderProperties&, const PendingProgram&);
+    static bool canSubstitute(const ShaderProperties& candidate, const ShaderProperties& props);
+    CelestiaGLProgram* findSubstitute(const ShaderProperties&) const;
+    bool useAsyncCompile() const;
 
     std::map<ShaderProperties, CelestiaGLProgram*> dynamicShaders;
     std::map<std::string, CelestiaGLProgram*> staticShaders;
 
+    std::unique_ptr<ShaderCache> programCache;
+    std::set<ShaderProperties> cachedProperties;
+    std::map<ShaderProperties, PendingProgram> pendingShaders;
+
+    bool asyncCompile{ false };
+    bool forceSynchronous{ false };
+
     bool fisheyeEnabled { false };
 };
@@ -0,0 +1,88 @@
+// shadowmapcache.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "shadowmapcache.h"
+
+#include <cassert>
+
+ShadowMapCache::ShadowMapCache(std::size_t capacity) :
+    m_entries(capacity)
+{
+}
+
+void
+ShadowMapCache::clear()
+{
+    for (Entry& entry : m_entries)
+        entry = Entry{};
+}
+
+ShadowMapCache::Slot
+ShadowMapCache::find(const void* caster, int lightIndex, int cascade,
+                     const View& view, bool animated, std::uint32_t frame)
+{
+    assert(!m_entries.empty());
+
+    std::size_t target = m_entries.size();
+    std::size_t oldest = m_entries.size();
+    for (std::size_t i = 0; i < m_entries.size(); i++)
+    {
+        Entry& entry = m_entries[i];
+        if (entry.caster == caster && entry.lightIndex == lightIndex && entry.cascade == cascade)
+        {
+            if (!animated && canReuse(entry.view, view))
+            {
+                entry.lastUsed = frame;
+                return { i, false };
+            }
+
+            // Another object sharing the caster's geometry may have
+            // claimed the entry in this frame; otherwise the caster moved
+            // and its old map is of no more use.
+            if (entry.lastUsed != frame && target == m_entries.size())
+                target = i;
+        }
+        else if (entry.caster == nullptr)
+        {
+            if (target == m_entries.size())
+                target = i;
+        }
+        else if (oldest == m_entries.size() || entry.lastUsed < m_entries[oldest].lastUsed)
+        {
+            oldest = i;
+        }
+    }
+
+    if (target == m_entries.size())
+        target = oldest == m_entries.size() ? 0 : oldest;
+
+    // Maps are used right after they're rendered, so even an entry claimed
+    // earlier in the frame can be taken over.
+    m_entries[target] = Entry{ caster, lightIndex, cascade, view, frame };
+    return { target, true };
+}
+
+bool
+ShadowMapCache::canReuse(const View& cached, const View& wanted)
+{
+    if (cached.size != wanted.size || cached.extent != wanted.extent || cached.center != wanted.center)
+        return false;
+
+    // Half a texel at the edge of the model, as an angle in radians
+    float tolerance = wanted.extent / static_cast<float>(wanted.size);
+    float cosAngle = cached.lightDirection.dot(wanted.lightDirection);
+    return cosAngle >= 1.0f - 0.5f * tolerance * tolerance;
+}
+
+Eigen::Vector2f
+ShadowMapCache::snapCenter(const Eigen::Vector2f& center, float extent)
+{
+    float step = 0.5f * extent;
+    return (center / step).array().round().matrix() * step;
+}
@@ -0,0 +1,76 @@
+// shadowmapcache.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+// Half width of the finer shadow map cascade drawn on large models seen
+// from close by, in units of the model radius
+constexpr float FineShadowCascadeExtent = 0.25f;
+
+// Keeps track of which shadow map of a small pool was last rendered for
+// which caster and light, so that a map is only rendered again once the
+// light has turned by more than half a texel relative to the caster. The
+// maps themselves are held by the renderer, by slot index.
+class ShadowMapCache
+{
+ public:
+    // The part of a caster covered by a shadow map, in its object space
+    struct View
+    {
+        Eigen::Vector3f lightDirection;
+        // Center and half width of the map in light space, in units of
+        // the model radius
+        Eigen::Vector2f center;
+        float extent;
+        unsigned int size;
+    };
+
+    struct Slot
+    {
+        std::size_t index;
+        bool needsRender;
+    };
+
+    explicit ShadowMapCache(std::size_t capacity);
+
+    std::size_t capacity() const { return m_entries.size(); }
+    void clear();
+
+    // Find the slot holding the map of a cascade of the caster lit by a
+    // light, claiming one for it if there is none that can be reused. Maps
+    // of animated casters are always rendered again.
+    Slot find(const void* caster, int lightIndex, int cascade,
+              const View& view, bool animated, std::uint32_t frame);
+
+    // Whether a map rendered for the cached view can stand in for one of
+    // the wanted view
+    static bool canReuse(const View& cached, const View& wanted);
+
+    // Snap the center of a cascade to a grid of a quarter of its width, so
+    // that small movements of the viewer don't require a new map
+    static Eigen::Vector2f snapCenter(const Eigen::Vector2f& center, float extent);
+
+ private:
+    struct Entry
+    {
+        const void* caster{ nullptr };
+        int lightIndex{ 0 };
+        int cascade{ 0 };
+        View view{};
+        std::uint32_t lastUsed{ 0 };
+    };
+
+    std::vector<Entry> m_entries;
+};
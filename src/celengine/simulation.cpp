@@ -14,6 +14,7 @@
 #include <celutil/array_view.h>
 #include <celutil/strnatcmp.h>
 #include "body.h"
+#include "bodystatecache.h"
 #include "location.h"
 #include "render.h"
 #include "simulation.h"
@@ -62,7 +63,7 @@ void Simulation::draw(Renderer& renderer)
 }
 
 
-void Simulation::render(Renderer& renderer, Observer& observer)
+void Simulation::render(Renderer& renderer, const Observer& observer)
 {
     renderer.render(observer,
                     *universe,
@@ -115,6 +116,15 @@ double Simulation::getArrivalTime() const
 
 // Tick the simulation by dt seconds
 void Simulation::update(double dt)
+{
+    // Body positions are cached for the duration of a frame
+    GetBodyStateCache().invalidate();
+
+    advance(dt);
+}
+
+
+void Simulation::advance(double dt)
 {
     realTime += dt;
 
@@ -128,6 +138,13 @@ void Simulation::update(double dt)
 }
 
 
+bool Simulation::isAdvanceThreadSafe() const
+{
+    return std::all_of(observers.begin(), observers.end(),
+                       [](const Observer* observer) { return observer->isUpdateThreadSafe(); });
+}
+
+
 Selection Simulation::getSelection() const
 {
     return selection;
@@ -337,6 +354,20 @@ void Simulation::cancelMotion()
     activeObserver->cancelMotion();
 }
 
+
+void Simulation::followPath(const std::shared_ptr<const CameraPath>& path,
+                            double speed,
+                            bool streaming)
+{
+    activeObserver->followPath(path, speed, streaming);
+}
+
+
+void Simulation::recordPath(const std::shared_ptr<CameraPath>& path, double interval)
+{
+    activeObserver->recordPath(path, interval);
+}
+
 void Simulation::centerSelection(double centerTime)
 {
     activeObserver->centerSelection(selection, centerTime);
@@ -38,9 +38,17 @@ class Simulation
     double getArrivalTime() const;
 
     void update(double dt);
+    // Advance the observers as update(), without invalidating the body
+    // state cache, so that it may run on a thread other than the one
+    // drawing the frame.
+    void advance(double dt);
+    // Return true if advance() may run on another thread while the frame is
+    // drawn, i.e. no observer depends on an orbit, rotation model or frame
+    // which isn't thread safe
+    bool isAdvanceThreadSafe() const;
     void render(Renderer&);
     void draw(Renderer&);
-    void render(Renderer&, Observer&);
+    void render(Renderer&, const Observer&);
 
     Selection pickObject(const Eigen::Vector3f& pickRay, uint64_t renderFlags, float tolerance = 0.0f);
 
@@ -88,6 +96,10 @@ class Simulation
     void phaseLock();
     void chase();
     void cancelMotion();
+    void followPath(const std::shared_ptr<const CameraPath>& path,
+                    double speed = 0.0,
+                    bool streaming = false);
+    void recordPath(const std::shared_ptr<CameraPath>& path, double interval);
 
     Observer& getObserver();
     void setObserverPosition(const UniversalCoord&);
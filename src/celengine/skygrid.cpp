@@ -41,6 +41,14 @@ constexpr double MAX_VISIBLE_ARCS = 10.0;
 // Number of line segments used to approximate one arc of the celestial sphere
 constexpr int ARC_SUBDIVISIONS = 100;
 
+// The template arcs span 2*pi/2^level radians, for levels down to an arc
+// of a few milliarcseconds. Each has twice the subdivisions of a visible
+// arc, so that the part of it drawn has no fewer, and one more vertex
+// than can be drawn for the tangent of triangulated lines at its end.
+constexpr int ARC_LEVELS = 32;
+constexpr int TEMPLATE_ARC_SUBDIVISIONS = 2 * ARC_SUBDIVISIONS;
+constexpr int TEMPLATE_ARC_VERTICES = TEMPLATE_ARC_SUBDIVISIONS + 2;
+
 // Size of the cross indicating the north and south poles
 const double POLAR_CROSS_SIZE = 0.01;
 
@@ -329,19 +337,70 @@ SkyGrid::meridianSpacing(double idealSpacing) const
 }
 
 
+// Build the template arcs: arcs of the unit circle in the xy plane of the
+// standard coordinates, starting at the x axis.
+static void
+initArcTemplates(LineRenderer& lineRenderer)
+{
+    lineRenderer.setVertexCount(ARC_LEVELS * TEMPLATE_ARC_VERTICES);
+    for (int level = 0; level < ARC_LEVELS; level++)
+    {
+        double step = 2.0 * celestia::numbers::pi / std::ldexp(1.0, level) / (double) TEMPLATE_ARC_SUBDIVISIONS;
+        for (int j = 0; j < TEMPLATE_ARC_VERTICES; j++)
+        {
+            double t = j * step;
+            lineRenderer.addVertex((float) std::cos(t), (float) std::sin(t), 0.0f);
+        }
+    }
+}
+
+
 void
-SkyGrid::render(Renderer& renderer,
-                const Observer& observer,
-                int windowWidth,
-                int windowHeight)
+SkyGrid::addArc(const Matrix4d& transform, double span)
 {
+    // Use the shortest template arc at least as long as the arc
+    int level = (int) std::floor(std::log2(2.0 * celestia::numbers::pi / span));
+    level = std::clamp(level, 0, ARC_LEVELS - 1);
+    double step = 2.0 * celestia::numbers::pi / std::ldexp(1.0, level) / (double) TEMPLATE_ARC_SUBDIVISIONS;
+    int count = std::clamp((int) std::ceil(span / step) + 1, 2, TEMPLATE_ARC_SUBDIVISIONS + 1);
+
+    m_arcs.push_back({ transform.cast<float>(), level * TEMPLATE_ARC_VERTICES, count });
+}
+
+
+bool
+SkyGrid::layoutValid(const Quaterniond& cameraOrientation, double vfov, double aspectRatio) const
+{
+    return m_hasLayout &&
+           m_layoutCameraOrientation.coeffs() == cameraOrientation.coeffs() &&
+           m_layoutOrientation.coeffs() == m_orientation.coeffs() &&
+           m_layoutFov == vfov &&
+           m_layoutAspectRatio == aspectRatio &&
+           m_layoutLongitudeUnits == m_longitudeUnits &&
+           m_layoutLongitudeDirection == m_longitudeDirection;
+}
+
+
+void
+SkyGrid::layout(const Quaterniond& cameraOrientation,
+                const Matrix3f& observerOrientation,
+                double vfov,
+                double viewAspectRatio)
+{
+    m_hasLayout = true;
+    m_layoutCameraOrientation = cameraOrientation;
+    m_layoutOrientation = m_orientation;
+    m_layoutFov = vfov;
+    m_layoutAspectRatio = viewAspectRatio;
+    m_layoutLongitudeUnits = m_longitudeUnits;
+    m_layoutLongitudeDirection = m_longitudeDirection;
+    m_arcs.clear();
+    m_labels.clear();
+
     // 90 degree rotation about the x-axis used to transform coordinates
     // to Celestia's system.
     Quaterniond xrot90 = XRotation(-celestia::numbers::pi / 2.0);
 
-    double vfov = observer.getFOV();
-    double viewAspectRatio = (double) windowWidth / (double) windowHeight;
-
     // Calculate the cosine of half the maximum field of view. We'll use this for
     // fast testing of marker visibility. The stored field of view is the
     // vertical field of view; we want the field of view as measured on the
@@ -352,7 +411,7 @@ SkyGrid::render(Renderer& renderer,
     double cosHalfFov = 1.0 / diag;
     double halfFov = acos(cosHalfFov);
 
-    auto polarCrossSize = (float) (POLAR_CROSS_SIZE * halfFov);
+    m_polarCrossSize = (float) (POLAR_CROSS_SIZE * halfFov);
 
     // We want to avoid drawing more of the grid than we have to. The following code
     // determines the region of the grid intersected by the view frustum. We're
@@ -368,7 +427,6 @@ SkyGrid::render(Renderer& renderer,
     Vector3d c2(-w,  h, -1.0);
     Vector3d c3( w,  h, -1.0);
 
-    Quaterniond cameraOrientation = observer.getOrientation();
     Matrix3d r = (cameraOrientation * xrot90 * m_orientation.conjugate() * xrot90.conjugate()).toRotationMatrix().transpose();
 
     // Transform the frustum corners by the camera and grid
@@ -484,36 +542,17 @@ SkyGrid::render(Renderer& renderer,
     Quaterniond q = xrot90 * m_orientation * xrot90.conjugate();
     Quaternionf orientationf = q.cast<float>();
 
-    // Radius of sphere is arbitrary, with the constraint that it shouldn't
-    // intersect the near or far plane of the view frustum.
-    Matrix4f m = renderer.getModelViewMatrix() *
-                 celmath::rotate((xrot90 * m_orientation.conjugate() * xrot90.conjugate()).cast<float>()) *
-                 celmath::scale(1000.0f);
-    Matrices matrices = {&renderer.getProjectionMatrix(), &m};
-
-    double arcStep = (maxTheta - minTheta) / (double) ARC_SUBDIVISIONS;
-    double theta0 = minTheta;
-
-    int count = 0;
-    if (g_gridRenderer == nullptr)
-        g_gridRenderer = new LineRenderer(renderer, 1.0f, LineRenderer::PrimType::LineStrip, LineRenderer::StorageType::Stream);
-    g_gridRenderer->startUpdate();
-
     for (int dec = startDec; dec <= endDec; dec += decIncrement)
     {
-        count++;
         double phi = celestia::numbers::pi * (double) dec / (double) DEG_MIN_SEC_TOTAL;
         double cosPhi = cos(phi);
         double sinPhi = sin(phi);
 
-        for (int j = 0; j <= ARC_SUBDIVISIONS; j++)
-        {
-            double theta = theta0 + j * arcStep;
-            auto x = (float) (cosPhi * std::cos(theta));
-            auto y = (float) (cosPhi * std::sin(theta));
-            auto z = (float) sinPhi;
-            g_gridRenderer->addVertex(x, z, -y);  // convert to Celestia coords
-        }
+        // A parallel is a template arc scaled down to the radius of the
+        // circle of latitude, and raised to its height.
+        addArc(celmath::translate(Vector3d(0.0, 0.0, sinPhi)) * celmath::scale(Vector3d(cosPhi, cosPhi, 1.0)) *
+               celmath::rotate(AngleAxisd(minTheta, Vector3d::UnitZ())),
+               maxTheta - minTheta);
 
         // Place labels at the intersections of the view frustum planes
         // and the parallels.
@@ -533,31 +572,14 @@ SkyGrid::render(Renderer& renderer,
                 Vector3f p0(toCelestiaCoords(isect0).cast<float>());
                 Vector3f p1(toCelestiaCoords(isect1).cast<float>());
 
-#ifdef DEBUG_LABEL_PLACEMENT
-                glPointSize(5.0);
-                glBegin(GL_POINTS);
-                glColor4f(1.0f, 0.0f, 0.0f, 1.0f);
-                glVertex3fv(p0.data());
-                glVertex3fv(p1.data());
-                glColor(m_lineColor);
-                glEnd();
-#endif
-
-                Matrix3f m = observer.getOrientationf().toRotationMatrix();
                 p0 = orientationf.conjugate() * p0;
                 p1 = orientationf.conjugate() * p1;
-                Renderer::LabelHorizontalAlignment hAlign = getCoordLabelHAlign(k);
-                Renderer::LabelVerticalAlignment vAlign = getCoordLabelVAlign(k);
-
-                if ((m * p0).z() < 0.0)
-                {
-                    renderer.addBackgroundAnnotation(nullptr, labelText, m_labelColor, p0, hAlign, vAlign);
-                }
-
-                if ((m * p1).z() < 0.0)
-                {
-                    renderer.addBackgroundAnnotation(nullptr, labelText, m_labelColor, p1, hAlign, vAlign);
-                }
+
+                if ((observerOrientation * p0).z() < 0.0)
+                    m_labels.push_back({ labelText, p0, k });
+
+                if ((observerOrientation * p1).z() < 0.0)
+                    m_labels.push_back({ labelText, p1, k });
             }
         }
     }
@@ -569,26 +591,21 @@ SkyGrid::render(Renderer& renderer,
     double maxMeridianAngle = celestia::numbers::pi / 2.0 * (1.0 - 2.0 * (double) decIncrement / (double) DEG_MIN_SEC_TOTAL);
     minDec = std::max(minDec, -maxMeridianAngle);
     maxDec = std::min(maxDec,  maxMeridianAngle);
-    arcStep = (maxDec - minDec) / (double) ARC_SUBDIVISIONS;
-    double phi0 = minDec;
 
     double cosMaxMeridianAngle = cos(maxMeridianAngle);
 
     for (int ra = startRa; ra <= endRa; ra += raIncrement)
     {
-        count++;
         double theta = 2.0 * celestia::numbers::pi * (double) ra / (double) totalLongitudeUnits;
         double cosTheta = cos(theta);
         double sinTheta = sin(theta);
 
-        for (int j = 0; j <= ARC_SUBDIVISIONS; j++)
-        {
-            double phi = phi0 + j * arcStep;
-            auto x = (float) (cos(phi) * cosTheta);
-            auto y = (float) (cos(phi) * sinTheta);
-            auto z = (float) sin(phi);
-            g_gridRenderer->addVertex(x, z, -y);  // convert to Celestia coords
-        }
+        // A meridian is a template arc turned into the plane of the
+        // meridian to start at its lowest visible latitude.
+        addArc(celmath::rotate(AngleAxisd(theta, Vector3d::UnitZ())) *
+               celmath::rotate(AngleAxisd(celestia::numbers::pi / 2.0, Vector3d::UnitX())) *
+               celmath::rotate(AngleAxisd(minDec, Vector3d::UnitZ())),
+               maxDec - minDec);
 
         // Place labels at the intersections of the view frustum planes
         // and the meridians.
@@ -608,34 +625,57 @@ SkyGrid::render(Renderer& renderer,
                 Vector3f p0(toCelestiaCoords(isect0).cast<float>());
                 Vector3f p1(toCelestiaCoords(isect1).cast<float>());
 
-#ifdef DEBUG_LABEL_PLACEMENT
-                glPointSize(5.0);
-                glBegin(GL_POINTS);
-                glColor4f(1.0f, 0.0f, 0.0f, 1.0f);
-                glVertex3fv(p0.data());
-                glVertex3fv(p1.data());
-                glColor(m_lineColor);
-                glEnd();
-#endif
-
-                Matrix3f m = observer.getOrientationf().toRotationMatrix();
                 p0 = orientationf.conjugate() * p0;
                 p1 = orientationf.conjugate() * p1;
-                Renderer::LabelHorizontalAlignment hAlign = getCoordLabelHAlign(k);
-                Renderer::LabelVerticalAlignment vAlign = getCoordLabelVAlign(k);
-
-                if ((m * p0).z() < 0.0 && axis0.dot(isect0) >= cosMaxMeridianAngle)
-                {
-                    renderer.addBackgroundAnnotation(nullptr, labelText, m_labelColor, p0, hAlign, vAlign);
-                }
-
-                if ((m * p1).z() < 0.0 && axis0.dot(isect1) >= cosMaxMeridianAngle)
-                {
-                    renderer.addBackgroundAnnotation(nullptr, labelText, m_labelColor, p1, hAlign, vAlign);
-                }
+
+                if ((observerOrientation * p0).z() < 0.0 && axis0.dot(isect0) >= cosMaxMeridianAngle)
+                    m_labels.push_back({ labelText, p0, k });
+
+                if ((observerOrientation * p1).z() < 0.0 && axis0.dot(isect1) >= cosMaxMeridianAngle)
+                    m_labels.push_back({ labelText, p1, k });
             }
         }
     }
+}
+
+
+void
+SkyGrid::render(Renderer& renderer,
+                const Observer& observer,
+                int windowWidth,
+                int windowHeight)
+{
+    Quaterniond cameraOrientation = observer.getOrientation();
+    double vfov = observer.getFOV();
+    double viewAspectRatio = (double) windowWidth / (double) windowHeight;
+
+    if (!layoutValid(cameraOrientation, vfov, viewAspectRatio))
+        layout(cameraOrientation, observer.getOrientationf().toRotationMatrix(), vfov, viewAspectRatio);
+
+    for (const Label& label : m_labels)
+    {
+        renderer.addBackgroundAnnotation(nullptr, label.text, m_labelColor, label.position,
+                                         getCoordLabelHAlign(label.planeIndex),
+                                         getCoordLabelVAlign(label.planeIndex));
+    }
+
+    // 90 degree rotation about the x-axis used to transform coordinates
+    // to Celestia's system.
+    Quaterniond xrot90 = XRotation(-celestia::numbers::pi / 2.0);
+
+    // Radius of sphere is arbitrary, with the constraint that it shouldn't
+    // intersect the near or far plane of the view frustum.
+    Matrix4f m = renderer.getModelViewMatrix() *
+                 celmath::rotate((xrot90 * m_orientation.conjugate() * xrot90.conjugate()).cast<float>()) *
+                 celmath::scale(1000.0f);
+
+    // The arcs are laid out in standard coordinates
+    Matrix4f toCelestia = Matrix4f::Zero();
+    toCelestia(0, 0) = 1.0f;
+    toCelestia(1, 2) = 1.0f;
+    toCelestia(2, 1) = -1.0f;
+    toCelestia(3, 3) = 1.0f;
+    Matrix4f gridMatrix = m * toCelestia;
 
     Renderer::PipelineState ps;
     ps.blending = true;
@@ -643,29 +683,35 @@ SkyGrid::render(Renderer& renderer,
     ps.smoothLines = true;
     renderer.setPipelineState(ps);
 
-    for (int offset = 0, i = 0; i < count; i++)
+    if (g_gridRenderer == nullptr)
+    {
+        g_gridRenderer = new LineRenderer(renderer, 1.0f, LineRenderer::PrimType::LineStrip, LineRenderer::StorageType::Static);
+        initArcTemplates(*g_gridRenderer);
+    }
+
+    for (const Arc& arc : m_arcs)
     {
-        g_gridRenderer->render(matrices, m_lineColor, ARC_SUBDIVISIONS + 1, offset);
-        offset += ARC_SUBDIVISIONS + 1;
+        Matrix4f mv = gridMatrix * arc.transform;
+        g_gridRenderer->render({ &renderer.getProjectionMatrix(), &mv }, m_lineColor, arc.count, arc.first);
     }
+    g_gridRenderer->finish();
 
     // Draw crosses indicating the north and south poles
     if (g_crossRenderer == nullptr)
-        g_crossRenderer = new LineRenderer(renderer, 1.0f, LineRenderer::PrimType::Lines, LineRenderer::StorageType::Stream);
-    g_crossRenderer->startUpdate();
-    g_crossRenderer->addVertex(-polarCrossSize,  1.0f,  0.0f);
-    g_crossRenderer->addVertex( polarCrossSize,  1.0f,  0.0f);
-    g_crossRenderer->addVertex( 0.0f,            1.0f, -polarCrossSize);
-    g_crossRenderer->addVertex( 0.0f,            1.0f,  polarCrossSize);
-    g_crossRenderer->addVertex(-polarCrossSize, -1.0f,  0.0f);
-    g_crossRenderer->addVertex( polarCrossSize, -1.0f,  0.0f);
-    g_crossRenderer->addVertex( 0.0f,           -1.0f, -polarCrossSize);
-    g_crossRenderer->addVertex( 0.0f,           -1.0f,  polarCrossSize);
-    g_crossRenderer->render(matrices, m_lineColor, 8);
-
-    g_gridRenderer->clear();
-    g_crossRenderer->clear();
-    g_gridRenderer->finish();
+    {
+        g_crossRenderer = new LineRenderer(renderer, 1.0f, LineRenderer::PrimType::Lines, LineRenderer::StorageType::Static);
+        g_crossRenderer->addVertex(-1.0f,  1.0f,  0.0f);
+        g_crossRenderer->addVertex( 1.0f,  1.0f,  0.0f);
+        g_crossRenderer->addVertex( 0.0f,  1.0f, -1.0f);
+        g_crossRenderer->addVertex( 0.0f,  1.0f,  1.0f);
+        g_crossRenderer->addVertex(-1.0f, -1.0f,  0.0f);
+        g_crossRenderer->addVertex( 1.0f, -1.0f,  0.0f);
+        g_crossRenderer->addVertex( 0.0f, -1.0f, -1.0f);
+        g_crossRenderer->addVertex( 0.0f, -1.0f,  1.0f);
+    }
+
+    Matrix4f crossMatrix = m * celmath::scale(Vector3f(m_polarCrossSize, 1.0f, m_polarCrossSize));
+    g_crossRenderer->render({ &renderer.getProjectionMatrix(), &crossMatrix }, m_lineColor, 8);
     g_crossRenderer->finish();
 }
 
@@ -13,6 +13,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <celrender/linerenderer.h>
@@ -21,6 +22,10 @@
 class Renderer;
 class Observer;
 
+// A grid is drawn from a static set of template arcs, each parallel and
+// meridian a sub-range of one of them under a transform of its own. The
+// arcs and labels visible in the view are only laid out again when the
+// view or the grid orientation changes.
 
 class SkyGrid
 {
@@ -99,6 +104,30 @@ public:
     static void deinit();
 
 private:
+    // A parallel or a meridian: vertices of a template arc transformed
+    // from the standard coordinates of the grid
+    struct Arc
+    {
+        Eigen::Matrix4f transform;
+        int first;
+        int count;
+    };
+
+    struct Label
+    {
+        std::string text;
+        Eigen::Vector3f position;
+        // The frustum plane the label lies on, selecting its alignment
+        int planeIndex;
+    };
+
+    bool layoutValid(const Eigen::Quaterniond& cameraOrientation, double vfov, double aspectRatio) const;
+    void layout(const Eigen::Quaterniond& cameraOrientation,
+                const Eigen::Matrix3f& observerOrientation,
+                double vfov,
+                double aspectRatio);
+    void addArc(const Eigen::Matrix4d& transform, double span);
+
     std::string latitudeLabel(int latitude, int latitudeStep) const;
     std::string longitudeLabel(int longitude, int longitudeStep) const;
     int parallelSpacing(double idealSpacing) const;
@@ -110,6 +139,18 @@ private:
     LongitudeUnits m_longitudeUnits{ LongitudeHours };
     LongitudeDirection m_longitudeDirection{ IncreasingCounterclockwise };
 
+    // The view the arcs and labels below were laid out for
+    bool m_hasLayout{ false };
+    Eigen::Quaterniond m_layoutCameraOrientation{ Eigen::Quaterniond::Identity() };
+    Eigen::Quaterniond m_layoutOrientation{ Eigen::Quaterniond::Identity() };
+    double m_layoutFov{ 0.0 };
+    double m_layoutAspectRatio{ 0.0 };
+    LongitudeUnits m_layoutLongitudeUnits{ LongitudeHours };
+    LongitudeDirection m_layoutLongitudeDirection{ IncreasingCounterclockwise };
+    float m_polarCrossSize{ 0.0f };
+    std::vector<Arc> m_arcs;
+    std::vector<Label> m_labels;
+
     static celestia::render::LineRenderer *g_gridRenderer;
     static celestia::render::LineRenderer *g_crossRenderer;
 };
@@ -0,0 +1,42 @@
+// skyoccluders.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "skyoccluders.h"
+
+#include <cmath>
+
+
+void
+SkyOccluders::add(const Eigen::Vector3f& position, float radius)
+{
+    float distance = position.norm();
+    if (radius <= 0.0f || distance <= radius)
+        return;
+
+    float angularRadius = std::asin(radius / distance);
+    m_occluders.push_back({ position / distance, std::cos(angularRadius), angularRadius });
+}
+
+bool
+SkyOccluders::hides(const Eigen::Vector3f& offset, float distance, float radius) const
+{
+    if (m_occluders.empty() || distance <= radius)
+        return false;
+
+    // The sphere is hidden if its disc is inside that of an occluder, i.e.
+    // its center is within the difference of the apparent radii
+    float sphereRadius = std::asin(radius / distance);
+    for (const Occluder& occluder : m_occluders)
+    {
+        float margin = occluder.angularRadius - sphereRadius;
+        if (margin > 0.0f && offset.dot(occluder.direction) > std::cos(margin) * distance)
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,60 @@
+// skyoccluders.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <Eigen/Core>
+
+// The discs of the large opaque bodies near the observer, as seen from it.
+// Stars, deep sky objects and their labels which lie behind one of them from
+// far beyond the solar system can be skipped before doing any work for
+// them; with the observer on a planet surface that's half the sky. The
+// discs are those of spheres inscribed in the bodies, so nothing visible
+// is ever culled.
+class SkyOccluders
+{
+ public:
+    void clear() { m_occluders.clear(); }
+    bool empty() const { return m_occluders.empty(); }
+    std::size_t size() const { return m_occluders.size(); }
+
+    // Add a sphere at the offset position from the observer; ignored if
+    // the observer is inside it
+    void add(const Eigen::Vector3f& position, float radius);
+
+    // Whether the point at the offset from the observer, of length distance,
+    // is hidden; it must be farther away than all occluders
+    bool hides(const Eigen::Vector3f& offset, float distance) const
+    {
+        for (const Occluder& occluder : m_occluders)
+        {
+            if (offset.dot(occluder.direction) > occluder.cosRadius * distance)
+                return true;
+        }
+        return false;
+    }
+
+    // Whether the whole sphere of the given radius at the offset from the
+    // observer is hidden
+    bool hides(const Eigen::Vector3f& offset, float distance, float radius) const;
+
+ private:
+    struct Occluder
+    {
+        Eigen::Vector3f direction;
+        // Cosine and angle of the apparent radius
+        float cosRadius;
+        float angularRadius;
+    };
+
+    std::vector<Occluder> m_occluders;
+};
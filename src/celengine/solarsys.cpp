@@ -31,6 +31,7 @@
 #include "hash.h"
 #include "frame.h"
 #include "frametree.h"
+#include "lazybodycatalog.h"
 #include "location.h"
 #include "meshmanager.h"
 #include "parseobject.h"
@@ -153,31 +154,21 @@ bool isFrameCircular(const ReferenceFrame& frame, ReferenceFrame::FrameType fram
 
 
 
-Location* CreateLocation(const Hash* locationData,
-                         Body* body)
+void GetLocationDefinition(const Hash* locationData,
+                           LocationDefinition& definition)
 {
-    Location* location = new Location();
-
-    auto longlat = locationData->getSphericalTuple("LongLat").value_or(Eigen::Vector3d::Zero());
-    Eigen::Vector3f position = body->planetocentricToCartesian(longlat).cast<float>();
-    location->setPosition(position);
-
-    auto size = locationData->getLength<float>("Size").value_or(1.0f);
-    location->setSize(size);
-
-    auto importance = locationData->getNumber<float>("Importance").value_or(-1.0f);
-    location->setImportance(importance);
+    definition.longLat = locationData->getSphericalTuple("LongLat").value_or(Eigen::Vector3d::Zero());
+    definition.size = locationData->getLength<float>("Size").value_or(1.0f);
+    definition.importance = locationData->getNumber<float>("Importance").value_or(-1.0f);
 
     if (const std::string* featureTypeName = locationData->getString("Type"); featureTypeName != nullptr)
-        location->setFeatureType(Location::parseFeatureType(*featureTypeName));
+        definition.featureType = Location::parseFeatureType(*featureTypeName);
 
     if (auto labelColor = locationData->getColor("LabelColor"); labelColor.has_value())
     {
-        location->setLabelColor(*labelColor);
-        location->setLabelColorOverridden(true);
+        definition.labelColor = *labelColor;
+        definition.overrideLabelColor = true;
     }
-
-    return location;
 }
 
 template<typename Dst, typename Flag>
@@ -209,13 +200,16 @@ void FillinSurface(const Hash* surfaceData,
     const std::string* specularTexture = surfaceData->getString("SpecularTexture");
     const std::string* normalTexture = surfaceData->getString("NormalMap");
     const std::string* overlayTexture = surfaceData->getString("OverlayTexture");
+    const std::string* heightMap = surfaceData->getString("HeightMap");
 
     unsigned int baseFlags = TextureInfo::WrapTexture | TextureInfo::AllowSplitting;
     unsigned int bumpFlags = TextureInfo::WrapTexture | TextureInfo::AllowSplitting;
     unsigned int nightFlags = TextureInfo::WrapTexture | TextureInfo::AllowSplitting;
     unsigned int specularFlags = TextureInfo::WrapTexture | TextureInfo::AllowSplitting;
+    unsigned int heightFlags = TextureInfo::WrapTexture | TextureInfo::AllowSplitting;
 
     auto bumpHeight = surfaceData->getNumber<float>("BumpHeight").value_or(2.5f);
+    surface->heightScale = surfaceData->getNumber<float>("HeightScale").value_or(10.0f);
 
     bool blendTexture = surfaceData->getBoolean("BlendTexture").value_or(false);
     bool emissive = surfaceData->getBoolean("Emissive").value_or(false);
@@ -230,9 +224,15 @@ void FillinSurface(const Hash* surfaceData,
     SetOrUnset(surface->appearanceFlags, Surface::ApplyNightMap, nightTexture != nullptr);
     SetOrUnset(surface->appearanceFlags, Surface::SeparateSpecularMap, specularTexture != nullptr);
     SetOrUnset(surface->appearanceFlags, Surface::ApplyOverlay, overlayTexture != nullptr);
+    SetOrUnset(surface->appearanceFlags, Surface::ApplyHeightMap, heightMap != nullptr);
     SetOrUnset(surface->appearanceFlags, Surface::SpecularReflection, surface->specularColor != Color(0.0f, 0.0f, 0.0f));
 
-    if (baseTexture != nullptr)
+    // A gray specular map is packed into the alpha channel of the base
+    // texture, unless that's its opacity; the separate map stays as the
+    // fallback when the images can't be combined
+    if (baseTexture != nullptr && specularTexture != nullptr && !blendTexture)
+        surface->baseTexture.setPackedTexture(*baseTexture, *specularTexture, path, baseFlags);
+    else if (baseTexture != nullptr)
         surface->baseTexture.setTexture(*baseTexture, path, baseFlags);
     if (nightTexture != nullptr)
         surface->nightTexture.setTexture(*nightTexture, path, nightFlags);
@@ -247,6 +247,8 @@ void FillinSurface(const Hash* surfaceData,
 
     if (overlayTexture != nullptr)
         surface->overlayTexture.setTexture(*overlayTexture, path, baseFlags);
+    if (heightMap != nullptr)
+        surface->heightMap.setTexture(*heightMap, path, heightFlags);
 }
 
 
@@ -1081,6 +1083,64 @@ Body* CreateReferencePoint(const std::string& name,
 
     return body;
 }
+
+
+// Read the definition of a body that can be kept in a LazyBodyCatalog:
+// an asteroid with nothing but an elliptical orbit, a radius and an albedo,
+// so that creating it later from these gives the same body. Returns false
+// for all other bodies.
+bool GetLazyBodyDefinition(const Hash* planetData,
+                           LazyBodyCatalog::Definition& definition)
+{
+    bool simple = true;
+    planetData->for_all([&simple](std::string_view key, const Value&)
+    {
+        if (key != "Class" && key != "Radius" && key != "GeomAlbedo" && key != "EllipticalOrbit")
+            simple = false;
+    });
+    if (!simple)
+        return false;
+
+    definition.radius = planetData->getLength<float>("Radius").value_or(1.0f);
+    if (const std::string* className = planetData->getString("Class"); className != nullptr)
+    {
+        if (GetClassificationId(*className) != Body::Asteroid)
+            return false;
+    }
+    else if (definition.radius >= 1000.0f)
+    {
+        // Would be guessed to be a planet
+        return false;
+    }
+
+    if (planetData->getValue("GeomAlbedo") != nullptr)
+    {
+        auto albedo = planetData->getNumber<float>("GeomAlbedo");
+        if (!albedo.has_value() || *albedo <= 0.0f)
+            return false;
+        definition.geomAlbedo = *albedo;
+    }
+
+    const Value* orbitValue = planetData->getValue("EllipticalOrbit");
+    const Hash* orbitData = orbitValue == nullptr ? nullptr : orbitValue->getHash();
+    if (orbitData == nullptr ||
+        (orbitData->getValue("SemiMajorAxis") == nullptr && orbitData->getValue("PericenterDistance") == nullptr) ||
+        orbitData->getValue("Period") == nullptr)
+    {
+        return false;
+    }
+
+    auto elements = ParseEllipticalOrbit(orbitData, true);
+    if (!elements.has_value() ||
+        !(elements->eccentricity >= 0.0 && elements->eccentricity < 1.0) ||
+        !(elements->pericenterDistance > 0.0) || elements->period == 0.0)
+    {
+        return false;
+    }
+
+    definition.orbit = *elements;
+    return true;
+}
 } // end unnamed namespace
 
 bool LoadSolarSystemObjects(std::istream& in,
@@ -1088,7 +1148,17 @@ bool LoadSolarSystemObjects(std::istream& in,
                             const fs::path& directory)
 {
     Tokenizer tokenizer(&in);
-    Parser parser(&tokenizer);
+    return LoadSolarSystemObjects(tokenizer, universe, directory);
+}
+
+bool LoadSolarSystemObjects(Tokenizer& tokenizer,
+                            Universe& universe,
+                            const fs::path& directory)
+{
+    // The properties of each object are discarded once it's created, so
+    // they are parsed into an arena which is reused for the next one
+    celestia::util::Arena arena;
+    Parser parser(&tokenizer, &arena);
 
 #ifdef ENABLE_NLS
     std::string s = directory.string();
@@ -1098,6 +1168,8 @@ bool LoadSolarSystemObjects(std::istream& in,
 
     while (tokenizer.nextToken() != Tokenizer::TokenEnd)
     {
+        arena.reset();
+
         // Read the disposition; if none is specified, the default is Add.
         DataDisposition disposition = DataDisposition::Add;
         if (auto tokenValue = tokenizer.getNameValue(); tokenValue.has_value())
@@ -1228,6 +1300,23 @@ bool LoadSolarSystemObjects(std::istream& in,
                 sscError(tokenizer, fmt::sprintf(_("parent body '%s' of '%s' not found.\n"), parentName, primaryName));
             }
 
+            // Creating the simple asteroids of a star is deferred until
+            // they're needed, if enabled
+            LazyBodyCatalog::Definition lazyDefinition;
+            if (parentSystem != nullptr &&
+                universe.getLazyMinorBodies() &&
+                parent.star() != nullptr &&
+                bodyType == NormalBody &&
+                disposition == DataDisposition::Add &&
+                !primaryName.empty() &&
+                parentSystem->find(primaryName) == nullptr &&
+                GetLazyBodyDefinition(objectData, lazyDefinition))
+            {
+                lazyDefinition.names = std::move(names);
+                parentSystem->getOrCreateLazyBodies(universe)->add(lazyDefinition);
+                continue;
+            }
+
             if (parentSystem != nullptr)
             {
                 Body* existingBody = parentSystem->find(primaryName);
@@ -1275,16 +1364,21 @@ bool LoadSolarSystemObjects(std::istream& in,
         {
             if (parent.body() != nullptr)
             {
-                Location* location = CreateLocation(objectData, parent.body());
-                location->loadCategories(objectData, disposition, directory.string());
-                if (location != nullptr)
+                LocationDefinition definition;
+                definition.name = primaryName;
+                GetLocationDefinition(objectData, definition);
+
+                // Only the locations in categories, which are kept by the
+                // Location objects, are created as they're read
+                if (objectData->getValue("Category") != nullptr)
                 {
-                    location->setName(primaryName);
+                    Location* location = Location::create(definition, *parent.body());
+                    location->loadCategories(objectData, disposition, directory.string());
                     parent.body()->addLocation(location);
                 }
                 else
                 {
-                    sscError(tokenizer, _("bad location"));
+                    parent.body()->addLocation(std::move(definition));
                 }
             }
             else
@@ -1294,11 +1388,35 @@ bool LoadSolarSystemObjects(std::istream& in,
         }
     }
 
+    // The bounds of the frame trees grew as the bodies were added; compute
+    // them exactly once the whole catalog is loaded
+    if (const SolarSystemCatalog* systems = universe.getSolarSystemCatalog(); systems != nullptr)
+    {
+        for (const auto& [index, system] : *systems)
+            system->getFrameTree()->recomputeBoundingSphere(true);
+    }
+
     // TODO: Return some notification if there's an error parsing the file
     return true;
 }
 
 
+Body* LoadSolarSystemBody(const std::vector<std::string>& names,
+                          PlanetarySystem* system,
+                          Universe& universe,
+                          const Hash* objectData)
+{
+    Body* body = CreateBody(names.front(), system, universe, nullptr, objectData,
+                            fs::path(), DataDisposition::Add, NormalBody);
+    if (body != nullptr)
+    {
+        for (const auto& name : names)
+            body->addAlias(name);
+    }
+    return body;
+}
+
+
 SolarSystem::SolarSystem(Star* _star) :
     star(_star),
     planets(nullptr),
@@ -12,15 +12,20 @@
 #include <cstdint>
 #include <iosfwd>
 #include <map>
+#include <string>
+#include <vector>
 
 #include <Eigen/Core>
 
 #include <celcompat/filesystem.h>
 
 
+class AssociativeArray;
+class Body;
 class FrameTree;
 class PlanetarySystem;
 class Star;
+class Tokenizer;
 class Universe;
 
 class SolarSystem
@@ -45,3 +50,13 @@ using SolarSystemCatalog = std::map<std::uint32_t, SolarSystem*>;
 bool LoadSolarSystemObjects(std::istream& in,
                             Universe& universe,
                             const fs::path& dir = fs::path());
+bool LoadSolarSystemObjects(Tokenizer& tokenizer,
+                            Universe& universe,
+                            const fs::path& dir = fs::path());
+
+// Create a body of a system from the properties of a Body entry which was
+// added to a LazyBodyCatalog instead, as the loader would have.
+Body* LoadSolarSystemBody(const std::vector<std::string>& names,
+                          PlanetarySystem* system,
+                          Universe& universe,
+                          const AssociativeArray* objectData);
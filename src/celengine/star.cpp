@@ -18,6 +18,8 @@
 
 #include <fmt/format.h>
 
+#include <celutil/memoryreport.h>
+
 using namespace std::string_view_literals;
 using celestia::util::IntrusivePtr;
 
@@ -1095,6 +1097,16 @@ StarDetails::shared() const
 }
 
 
+std::size_t
+StarDetails::getMemoryUsage() const
+{
+    std::size_t size = sizeof(StarDetails) + celestia::util::stringMemory(infoURL);
+    if (orbitingStars != nullptr)
+        size += sizeof(*orbitingStars) + celestia::util::vectorMemory(*orbitingStars);
+    return size;
+}
+
+
 void
 StarDetails::addOrbitingStar(Star* star)
 {
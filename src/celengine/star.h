@@ -86,6 +86,8 @@ class StarDetails
 
     bool shared() const;
     inline bool hasCorona() const;
+    // Bytes taken by the details, not including their orbit and rotation
+    std::size_t getMemoryUsage() const;
 
     enum
     {
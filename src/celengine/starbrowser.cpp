@@ -11,8 +11,8 @@
 
 #include <string>
 #include <algorithm>
-#include <set>
 #include "starbrowser.h"
+#include "starquery.h"
 
 using namespace Eigen;
 using namespace std;
@@ -79,112 +79,134 @@ struct SolarSystemPredicate
 };
 
 
-// Find the nearest/brightest/X-est N stars in a database.  The
-// supplied predicate determines which of two stars is a better match.
-template<class Pred> static std::vector<const Star*>*
-findStars(const StarDatabase& stardb, Pred pred, int nStars)
+// The celestial browser lists all stars, barycenters included
+struct NoStarFilter
 {
-    std::vector<const Star*>* finalStars = new std::vector<const Star*>();
-    if (nStars == 0)
-        return finalStars;
-    if(nStars > 500)
-        nStars = 500;
-
-    typedef std::multiset<const Star*, Pred> StarSet;
-    StarSet firstStars(pred);
-
-    int totalStars = stardb.size();
-    if (totalStars < nStars)
-        nStars = totalStars;
-
-    // We'll need at least nStars in the set, so first fill
-    // up the list indiscriminately.
-    int i = 0;
-    for (i = 0; i < nStars; i++)
-        firstStars.insert(stardb.getStar(i));
-
-    // From here on, only add a star to the set if it's
-    // a better match than the worst matching star already
-    // in the set.
-    const Star* lastStar = *--firstStars.end();
-    for (; i < totalStars; i++)
-    {
-        Star* star = stardb.getStar(i);
-        if (pred(star, lastStar))
-        {
-            firstStars.insert(star);
-            firstStars.erase(--firstStars.end());
-            lastStar = *--firstStars.end();
-        }
-    }
-
-    // Move the best matching stars into the vector
-    finalStars->reserve(nStars);
-    for (const auto& star : firstStars)
-        finalStars->push_back(star);
-
-    return finalStars;
-}
+    bool operator()(const Star*) const { return false; }
+};
 
 
-const Star* StarBrowser::nearestStar()
+static std::vector<const Star*>
+toConstStars(const std::vector<Star*>& stars)
 {
-    Universe* univ = appSim->getUniverse();
-    CloserStarPredicate closerPred;
-    closerPred.pos = pos;
-    std::vector<const Star*>* stars = findStars(*(univ->getStarCatalog()), closerPred, 1);
-    const Star *star = (*stars)[0];
-    delete stars;
-    return star;
+    return std::vector<const Star*>(stars.begin(), stars.end());
 }
 
 
-std::vector<const Star*>*
-StarBrowser::listStars(unsigned int nStars)
+// Find the nearest/brightest/X-est N stars in a database: call f with the
+// predicate selected in the browser, which determines which of two stars is
+// a better match, and the number of stars to find. Returns false if there
+// are no stars to look for.
+template<typename F> static bool
+withPredicate(const Universe& univ,
+              int predicate,
+              const Vector3f& pos,
+              const UniversalCoord& ucPos,
+              unsigned int nStars,
+              F&& f)
 {
-    Universe* univ = appSim->getUniverse();
+    nStars = min(nStars, 500u);
     switch(predicate)
     {
-    case BrighterStars:
+    case StarBrowser::BrighterStars:
         {
             BrighterStarPredicate brighterPred;
             brighterPred.pos = pos;
             brighterPred.ucPos = ucPos;
-            return findStars(*(univ->getStarCatalog()), brighterPred, nStars);
+            f(brighterPred, nStars);
         }
-        break;
+        return true;
 
-    case BrightestStars:
-        {
-            BrightestStarPredicate brightestPred;
-            return findStars(*(univ->getStarCatalog()), brightestPred, nStars);
-        }
-        break;
+    case StarBrowser::BrightestStars:
+        f(BrightestStarPredicate(), nStars);
+        return true;
 
-    case StarsWithPlanets:
+    case StarBrowser::StarsWithPlanets:
         {
-            SolarSystemCatalog* solarSystems = univ->getSolarSystemCatalog();
+            SolarSystemCatalog* solarSystems = univ.getSolarSystemCatalog();
             if (!solarSystems)
-                return nullptr;
+                return false;
             SolarSystemPredicate solarSysPred;
             solarSysPred.pos = pos;
             solarSysPred.solarSystems = solarSystems;
-            return findStars(*(univ->getStarCatalog()), solarSysPred,
-                             min((size_t) nStars, solarSystems->size()));
+            f(solarSysPred, min((size_t) nStars, solarSystems->size()));
         }
-        break;
+        return true;
 
-    case NearestStars:
+    case StarBrowser::NearestStars:
     default:
         {
             CloserStarPredicate closerPred;
             closerPred.pos = pos;
-            return findStars(*(univ->getStarCatalog()), closerPred, nStars);
+            f(closerPred, nStars);
         }
-        break;
+        return true;
     }
+}
+
 
-    return nullptr;  // keep compiler happy
+const Star* StarBrowser::nearestStar()
+{
+    Universe* univ = appSim->getUniverse();
+    CloserStarPredicate closerPred;
+    closerPred.pos = pos;
+    std::vector<Star*> stars = celestia::engine::findBestStars(*(univ->getStarCatalog()), closerPred, NoStarFilter(), 1);
+    return stars.empty() ? nullptr : stars.front();
+}
+
+
+std::vector<const Star*>*
+StarBrowser::listStars(unsigned int nStars)
+{
+    Universe* univ = appSim->getUniverse();
+    const StarDatabase& stardb = *(univ->getStarCatalog());
+    std::vector<const Star*>* stars = nullptr;
+    withPredicate(*univ, predicate, pos, ucPos, nStars,
+                  [&stardb, &stars](const auto& pred, std::size_t n)
+                  {
+                      stars = new std::vector<const Star*>(toConstStars(celestia::engine::findBestStars(stardb, pred, NoStarFilter(), n)));
+                  });
+    return stars;
+}
+
+
+bool
+StarBrowser::listStarsAsync(unsigned int nStars)
+{
+    if (query == nullptr)
+        query = std::make_unique<celestia::engine::StarQuery>();
+    else
+        query->cancel();
+
+    Universe* univ = appSim->getUniverse();
+    const StarDatabase& stardb = *(univ->getStarCatalog());
+    return withPredicate(*univ, predicate, pos, ucPos, nStars,
+                         [this, &stardb](const auto& pred, std::size_t n)
+                         {
+                             query->start(stardb, pred, NoStarFilter(), n);
+                         });
+}
+
+
+bool StarBrowser::starsReady() const
+{
+    return query != nullptr && query->ready();
+}
+
+
+std::vector<const Star*>
+StarBrowser::takeStars()
+{
+    if (query == nullptr)
+        return {};
+    return toConstStars(query->get());
+}
+
+
+void StarBrowser::cancelListStars()
+{
+    if (query != nullptr)
+        query->cancel();
 }
 
 
@@ -221,6 +243,9 @@ StarBrowser::StarBrowser(Simulation* _appSim, int pred) :
 }
 
 
+StarBrowser::~StarBrowser() = default;
+
+
 StarBrowser::StarBrowser() :
     pos(Vector3f::Zero()),
     ucPos(UniversalCoord::Zero()),
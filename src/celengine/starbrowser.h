@@ -12,10 +12,18 @@
 #ifndef _CELENGINE_STARBROWSER_H_
 #define _CELENGINE_STARBROWSER_H_
 
+#include <memory>
+#include <vector>
+
 #include "star.h"
 #include "stardb.h"
 #include "simulation.h"
 
+namespace celestia::engine
+{
+class StarQuery;
+}
+
 
 class StarBrowser
 {
@@ -29,7 +37,16 @@ class StarBrowser
 
     StarBrowser();
     StarBrowser(Simulation *_appSim, int pred = NearestStars);
+    ~StarBrowser();
     std::vector<const Star*>* listStars(unsigned int);
+    // Run listStars on a background thread, returning false if there is
+    // nothing to search for. The stars are returned by takeStars() once
+    // starsReady() is true; listing again or destroying the browser
+    // cancels the running search.
+    bool listStarsAsync(unsigned int);
+    bool starsReady() const;
+    std::vector<const Star*> takeStars();
+    void cancelListStars();
     void setSimulation(Simulation *_appSim);
     const Star *nearestStar(void);
     bool setPredicate(int pred);
@@ -45,6 +62,7 @@ class StarBrowser
  private:
     Simulation *appSim;
     int predicate;
+    std::unique_ptr<celestia::engine::StarQuery> query;
 };
 
 #endif // _CELENGINE_STARBROWSER_H_
@@ -12,35 +12,62 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <cstddef>
+#include <cstring>
+#include <fstream>
 #include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
 #include <set>
 #include <string_view>
 #include <system_error>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include <fmt/format.h>
 
 #include <celcompat/charconv.h>
+#include <celutil/binarywrite.h>
 #include <celutil/bytes.h>
 #include <celutil/gettext.h>
 #include <celutil/intrusiveptr.h>
+#include <celutil/jobsystem.h>
 #include <celutil/logger.h>
+#include <celutil/mappedfile.h>
+#include <celutil/memoryreport.h>
 #include <celutil/timer.h>
 #include <celutil/tokenizer.h>
 #include <celutil/stringutils.h>
 #include "meshmanager.h"
+#include "pagedstarcatalog.h"
 #include "parser.h"
 #include "starname.h"
+#include "starsdat.h"
+#include "starvisibilitycache.h"
 #include "value.h"
 
 using namespace std::string_view_literals;
 using celestia::util::GetLogger;
 using celestia::util::IntrusivePtr;
-
+using celestia::engine::SortedStarsDatHeader;
+using celestia::engine::StarsDatHeader;
+using celestia::engine::StarsDatNode;
+using celestia::engine::StarsDatRecord;
+using celestia::engine::STARSDAT_MAGIC;
+using celestia::engine::SORTED_STARSDAT_VERSION;
+using celestia::engine::readRecordField;
+using celestia::engine::unpackStarsDatRecord;
+using celestia::engine::unpackStarsDatRecordFields;
+using celestia::engine::writeStarsDatRecord;
+
+namespace celengine = celestia::engine;
 namespace celutil = celestia::util;
 
 namespace
@@ -55,20 +82,10 @@ constexpr inline std::string_view RossCatalogPrefix      = "Ross "sv;
 constexpr inline std::string_view LacailleCatalogPrefix  = "Lacaille "sv;
 #endif
 
-// The size of the root star octree node is also the maximum distance
-// distance from the Sun at which any star may be located. The current
-// setting of 1.0e7 light years is large enough to contain the entire
-// local group of galaxies. A larger value should be OK, but the
-// performance implications for octree traversal still need to be
-// investigated.
-constexpr inline float STAR_OCTREE_ROOT_SIZE   = 1000000000.0f;
-
 constexpr inline float STAR_OCTREE_MAGNITUDE   = 6.0f;
+const inline Eigen::Vector3f STAR_OCTREE_ROOT_CENTER{ 1000.0f, 1000.0f, 1000.0f };
 //constexpr const float STAR_EXTRA_ROOM        = 0.01f; // Reserve 1% capacity for extra stars
 
-constexpr inline std::string_view STARSDAT_MAGIC   = "CELSTARS"sv;
-constexpr inline std::string_view CROSSINDEX_MAGIC = "CELINDEX"sv;
-
 constexpr inline AstroCatalog::IndexNumber TYC3_MULTIPLIER = 1000000000u;
 constexpr inline AstroCatalog::IndexNumber TYC2_MULTIPLIER = 10000u;
 constexpr inline AstroCatalog::IndexNumber TYC123_MIN = 1u;
@@ -83,53 +100,94 @@ constexpr inline AstroCatalog::IndexNumber TYC3_MAX   = 3u;     // from TYC2
 constexpr inline AstroCatalog::IndexNumber TDSC_TYC3_MAX            = 4u;
 constexpr inline AstroCatalog::IndexNumber TDSC_TYC3_MAX_RANGE_TYC1 = 2907u;
 
-#pragma pack(push, 1)
-// stars.dat header structure
-struct StarsDatHeader
+
+// Exclusion factor of the octree root, the absolute magnitude of a star
+// at the limiting magnitude from the far corner of the root cell
+float
+starOctreeRootExclusionFactor()
 {
-    StarsDatHeader() = delete;
-    char magic[8];
-    std::uint16_t version;
-    std::uint32_t counter;
-};
+    return astro::appToAbsMag(STAR_OCTREE_MAGNITUDE,
+                              STAR_OCTREE_ROOT_SIZE * (float) sqrt(3.0));
+}
 
-static_assert(std::is_standard_layout_v<StarsDatHeader>);
+// Number of threads used to load the catalogs and build the octree
+unsigned int
+loaderThreadCount()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
 
-// stars.dat record structure
-struct StarsDatRecord
+// Call func(i) for each i in [0, nTasks), spread over up to nThreads
+// threads including the calling one.
+template<typename F>
+void
+runParallel(std::size_t nTasks, unsigned int nThreads, F&& func)
 {
-    StarsDatRecord() = delete;
-    AstroCatalog::IndexNumber catNo;
-    float x;
-    float y;
-    float z;
-    std::int16_t absMag;
-    std::uint16_t spectralType;
-};
+    std::atomic<std::size_t> nextTask{ 0 };
+    auto run = [&nextTask, nTasks, &func]()
+    {
+        for (;;)
+        {
+            std::size_t i = nextTask.fetch_add(1, std::memory_order_relaxed);
+            if (i >= nTasks)
+                break;
+            func(i);
+        }
+    };
 
-static_assert(std::is_standard_layout_v<StarsDatRecord>);
+    std::vector<std::thread> workers;
+    std::size_t nWorkers = std::min(static_cast<std::size_t>(nThreads), nTasks);
+    for (std::size_t i = 1; i < nWorkers; ++i)
+        workers.emplace_back(run);
 
-// cross-index header structure
-struct CrossIndexHeader
-{
-    CrossIndexHeader() = delete;
-    char magic[8];
-    std::uint16_t version;
-};
+    run();
 
-static_assert(std::is_standard_layout_v<CrossIndexHeader>);
+    for (auto& worker : workers)
+        worker.join();
+}
 
-// cross-index record structure
-struct CrossIndexRecord
+// Sort chunks of the range in parallel, then merge them pairwise, again in
+// parallel.
+template<typename T, typename Compare>
+void
+parallelSort(T* first, T* last, Compare comp, unsigned int nThreads)
 {
-    CrossIndexRecord() = delete;
-    std::uint32_t catalogNumber;
-    std::uint32_t celCatalogNumber;
-};
+    constexpr std::size_t MinChunkSize = 65536;
+
+    auto count = static_cast<std::size_t>(last - first);
+    std::size_t nChunks = std::min(static_cast<std::size_t>(nThreads), count / MinChunkSize);
+    if (nChunks <= 1)
+    {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    std::vector<T*> bounds;
+    bounds.reserve(nChunks + 1);
+    for (std::size_t i = 0; i < nChunks; ++i)
+        bounds.push_back(first + count * i / nChunks);
+    bounds.push_back(last);
 
-static_assert(std::is_standard_layout_v<CrossIndexRecord>);
+    runParallel(nChunks, nThreads,
+                [&bounds, &comp](std::size_t i) { std::sort(bounds[i], bounds[i + 1], comp); });
 
-#pragma pack(pop)
+    while (bounds.size() > 2)
+    {
+        runParallel((bounds.size() - 1) / 2, nThreads,
+                    [&bounds, &comp](std::size_t i)
+                    {
+                        std::inplace_merge(bounds[2 * i], bounds[2 * i + 1], bounds[2 * i + 2], comp);
+                    });
+
+        std::vector<T*> merged;
+        merged.reserve(bounds.size() / 2 + 1);
+        for (std::size_t i = 0; i < bounds.size(); i += 2)
+            merged.push_back(bounds[i]);
+        if (merged.back() != last)
+            merged.push_back(last);
+        bounds = std::move(merged);
+    }
+}
 
 bool parseSimpleCatalogNumber(std::string_view name,
                               std::string_view prefix,
@@ -307,12 +365,6 @@ void modifyStarDetails(Star* star,
 } // end unnamed namespace
 
 
-bool StarDatabase::CrossIndexEntry::operator<(const StarDatabase::CrossIndexEntry& e) const
-{
-    return catalogNumber < e.catalogNumber;
-}
-
-
 StarDatabase::StarDatabase()
 {
     crossIndexes.resize(MaxCatalog);
@@ -323,9 +375,6 @@ StarDatabase::~StarDatabase()
 {
     delete [] stars;
     delete [] catalogNumberIndex;
-
-    for (const auto index : crossIndexes)
-        delete index;
 }
 
 
@@ -341,8 +390,18 @@ Star* StarDatabase::find(AstroCatalog::IndexNumber catalogNumber) const
 
     if (star != catalogNumberIndex + nStars && (*star)->getIndex() == catalogNumber)
         return *star;
-    else
-        return nullptr;
+
+    for (const AddedStars& added : addedStars)
+    {
+        auto iter = std::lower_bound(added.catalogNumberIndex.begin(),
+                                     added.catalogNumberIndex.end(),
+                                     catalogNumber,
+                                     [](const Star* star, AstroCatalog::IndexNumber catNum) { return star->getIndex() < catNum; });
+        if (iter != added.catalogNumberIndex.end() && (*iter)->getIndex() == catalogNumber)
+            return *iter;
+    }
+
+    return nullptr;
 }
 
 
@@ -403,18 +462,11 @@ AstroCatalog::IndexNumber StarDatabase::crossIndex(const Catalog catalog, const
     if (static_cast<std::size_t>(catalog) >= crossIndexes.size())
         return AstroCatalog::InvalidIndex;
 
-    CrossIndex* xindex = crossIndexes[catalog];
+    const CrossIndex* xindex = crossIndexes[catalog].get();
     if (xindex == nullptr)
         return AstroCatalog::InvalidIndex;
 
-    // A simple linear search.  We could store cross indices sorted by
-    // both catalog numbers and trade memory for speed
-    auto iter = std::find_if(xindex->begin(), xindex->end(),
-                             [celCatalogNumber](CrossIndexEntry& o){ return celCatalogNumber == o.celCatalogNumber; });
-    if (iter != xindex->end())
-        return iter->catalogNumber;
-
-    return AstroCatalog::InvalidIndex;
+    return xindex->findCatalogNumber(celCatalogNumber);
 }
 
 
@@ -425,19 +477,11 @@ AstroCatalog::IndexNumber StarDatabase::searchCrossIndexForCatalogNumber(const C
     if (static_cast<unsigned int>(catalog) >= crossIndexes.size())
         return AstroCatalog::InvalidIndex;
 
-    CrossIndex* xindex = crossIndexes[catalog];
+    const CrossIndex* xindex = crossIndexes[catalog].get();
     if (xindex == nullptr)
         return AstroCatalog::InvalidIndex;
 
-    CrossIndexEntry xindexEnt;
-    xindexEnt.catalogNumber = number;
-
-    CrossIndex::iterator iter = lower_bound(xindex->begin(), xindex->end(),
-                                            xindexEnt);
-    if (iter == xindex->end() || iter->catalogNumber != number)
-        return AstroCatalog::InvalidIndex;
-    else
-        return iter->celCatalogNumber;
+    return xindex->findCelestiaNumber(number);
 }
 
 
@@ -451,11 +495,14 @@ Star* StarDatabase::searchCrossIndex(const Catalog catalog, const AstroCatalog::
 }
 
 
-void StarDatabase::getCompletion(std::vector<std::string>& completion, std::string_view name, bool i18n) const
+void StarDatabase::getCompletion(std::vector<std::string>& completion,
+                                std::string_view name,
+                                bool i18n,
+                                std::size_t maxResults) const
 {
     // only named stars are supported by completion.
     if (!name.empty() && namesDB != nullptr)
-        namesDB->getCompletion(completion, name, i18n);
+        namesDB->getCompletion(completion, name, i18n, maxResults);
 }
 
 
@@ -478,16 +525,16 @@ std::string StarDatabase::getStarName(const Star& star, bool i18n) const
 
     if (namesDB != nullptr)
     {
-        StarNameDatabase::NumberIndex::const_iterator iter = namesDB->getFirstNameIter(catalogNumber);
-        if (iter != namesDB->getFinalNameIter() && iter->first == catalogNumber)
+        auto iter = namesDB->getFirstNameIter(catalogNumber);
+        if (iter != namesDB->getFinalNameIter())
         {
             if (i18n)
             {
-                const char * local = D_(iter->second.c_str());
-                if (iter->second != local)
+                const char * local = D_((*iter).data());
+                if (*iter != local)
                     return local;
             }
-            return iter->second;
+            return std::string(*iter);
         }
     }
 
@@ -523,11 +570,11 @@ std::string StarDatabase::getStarNameList(const Star& star, const unsigned int m
 
     if (namesDB != nullptr)
     {
-        StarNameDatabase::NumberIndex::const_iterator iter = namesDB->getFirstNameIter(catalogNumber);
+        auto iter = namesDB->getFirstNameIter(catalogNumber);
 
-        while (iter != namesDB->getFinalNameIter() && iter->first == catalogNumber && nameSet.size() < maxNames)
+        while (iter != namesDB->getFinalNameIter() && nameSet.size() < maxNames)
         {
-            append(D_(iter->second.c_str()));
+            append(D_((*iter).data()));
             ++iter;
         }
     }
@@ -571,16 +618,16 @@ std::string StarDatabase::getStarNameList(const Star& star, const unsigned int m
 }
 
 
-void StarDatabase::findVisibleStars(StarHandler& starHandler,
-                                    const Eigen::Vector3f& position,
-                                    const Eigen::Quaternionf& orientation,
-                                    float fovY,
-                                    float aspectRatio,
-                                    float limitingMag,
-                                    OctreeProcStats *stats) const
+namespace
+{
+// Compute the bounding planes of an infinite view frustum
+void
+computeFrustumPlanes(Eigen::Hyperplane<float, 3>* frustumPlanes,
+                     const Eigen::Vector3f& position,
+                     const Eigen::Quaternionf& orientation,
+                     float fovY,
+                     float aspectRatio)
 {
-    // Compute the bounding planes of an infinite view frustum
-    Eigen::Hyperplane<float, 3> frustumPlanes[5];
     Eigen::Vector3f planeNormals[5];
     Eigen::Matrix3f rot = orientation.toRotationMatrix();
     float h = (float) tan(fovY / 2);
@@ -595,126 +642,330 @@ void StarDatabase::findVisibleStars(StarHandler& starHandler,
         planeNormals[i] = rot.transpose() * planeNormals[i].normalized();
         frustumPlanes[i] = Eigen::Hyperplane<float, 3>(planeNormals[i], position);
     }
+}
+
+// Depth of the octree level at which the parallel traversal hands subtrees
+// out to the worker threads. With up to 8^3 subtrees there are plenty of
+// work items to balance the load without making the split itself costly.
+constexpr unsigned int ParallelSplitLevel = 3;
+
+} // end unnamed namespace
+
+
+void StarDatabase::findVisibleStars(StarHandler& starHandler,
+                                    const Eigen::Vector3f& position,
+                                    const Eigen::Quaternionf& orientation,
+                                    float fovY,
+                                    float aspectRatio,
+                                    float limitingMag,
+                                    OctreeProcStats *stats) const
+{
+    Eigen::Hyperplane<float, 3> frustumPlanes[5];
+    computeFrustumPlanes(frustumPlanes, position, orientation, fovY, aspectRatio);
 
     octreeRoot->processVisibleObjects(starHandler,
                                       position,
                                       frustumPlanes,
                                       limitingMag,
                                       STAR_OCTREE_ROOT_SIZE,
+                                      cullingData,
                                       stats);
+    processVisibleAddedStars(starHandler, position, frustumPlanes, limitingMag, stats);
 }
 
 
-void StarDatabase::findCloseStars(StarHandler& starHandler,
-                                  const Eigen::Vector3f& position,
-                                  float radius) const
+void StarDatabase::findVisibleStars(celestia::util::array_view<StarHandler*> starHandlers,
+                                    const Eigen::Vector3f& position,
+                                    const Eigen::Quaternionf& orientation,
+                                    float fovY,
+                                    float aspectRatio,
+                                    float limitingMag) const
 {
-    octreeRoot->processCloseObjects(starHandler,
-                                    position,
-                                    radius,
-                                    STAR_OCTREE_ROOT_SIZE);
+    assert(!starHandlers.empty());
+    if (starHandlers.size() == 1)
+    {
+        findVisibleStars(*starHandlers[0], position, orientation, fovY, aspectRatio, limitingMag);
+        return;
+    }
+
+    Eigen::Hyperplane<float, 3> frustumPlanes[5];
+    computeFrustumPlanes(frustumPlanes, position, orientation, fovY, aspectRatio);
+
+    std::vector<StarOctree::Subtree> subtrees;
+    octreeRoot->processVisibleObjects(*starHandlers[0],
+                                      position,
+                                      frustumPlanes,
+                                      limitingMag,
+                                      STAR_OCTREE_ROOT_SIZE,
+                                      cullingData,
+                                      ParallelSplitLevel,
+                                      subtrees);
+
+    // Subtrees vary wildly in cost, so rather than partitioning them up
+    // front each thread keeps taking the next unprocessed one.
+    std::atomic<std::size_t> nextSubtree{ 0 };
+    auto traverse = [&](StarHandler* handler)
+    {
+        for (;;)
+        {
+            std::size_t i = nextSubtree.fetch_add(1, std::memory_order_relaxed);
+            if (i >= subtrees.size())
+                break;
+
+            subtrees[i].node->processVisibleObjects(*handler,
+                                                    position,
+                                                    frustumPlanes,
+                                                    limitingMag,
+                                                    subtrees[i].scale,
+                                                    cullingData);
+        }
+    };
+
+    // The first handler stays on the calling thread, the others run as
+    // jobs of the shared job system.
+    celestia::util::GetJobSystem()->parallelFor(0, starHandlers.size(), 1,
+                                                [&](std::size_t first, std::size_t last)
+                                                {
+                                                    for (std::size_t i = first; i < last; ++i)
+                                                        traverse(starHandlers[i]);
+                                                });
+
+    processVisibleAddedStars(*starHandlers[0], position, frustumPlanes, limitingMag, nullptr);
 }
 
 
-StarNameDatabase* StarDatabase::getNameDatabase() const
+void StarDatabase::findVisibleStars(celestia::util::array_view<StarHandler*> starHandlers,
+                                    const Eigen::Vector3f& position,
+                                    const Eigen::Quaternionf& orientation,
+                                    float fovY,
+                                    float aspectRatio,
+                                    float limitingMag,
+                                    StarVisibilityCache& cache) const
 {
-    return namesDB;
+    assert(!starHandlers.empty());
+
+    Eigen::Hyperplane<float, 3> frustumPlanes[5];
+    computeFrustumPlanes(frustumPlanes, position, orientation, fovY, aspectRatio);
+
+    cache.processVisibleStars(*octreeRoot,
+                              cullingData,
+                              starHandlers,
+                              position,
+                              orientation,
+                              frustumPlanes,
+                              fovY,
+                              aspectRatio,
+                              limitingMag);
+
+    // The octrees of added stars are small enough to be traversed anew
+    processVisibleAddedStars(*starHandlers[0], position, frustumPlanes, limitingMag, nullptr);
 }
 
 
-void StarDatabase::setNameDatabase(StarNameDatabase* _namesDB)
+void StarDatabase::findVisibleAddedStars(StarHandler& starHandler,
+                                         const Eigen::Vector3f& position,
+                                         const Eigen::Quaternionf& orientation,
+                                         float fovY,
+                                         float aspectRatio,
+                                         float limitingMag) const
 {
-    namesDB = _namesDB;
+    if (addedStars.empty())
+        return;
+
+    Eigen::Hyperplane<float, 3> frustumPlanes[5];
+    computeFrustumPlanes(frustumPlanes, position, orientation, fovY, aspectRatio);
+    processVisibleAddedStars(starHandler, position, frustumPlanes, limitingMag, nullptr);
 }
 
 
-bool StarDatabase::loadCrossIndex(const Catalog catalog, std::istream& in)
+void StarDatabase::processVisibleAddedStars(StarHandler& starHandler,
+                                            const Eigen::Vector3f& position,
+                                            const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                                            float limitingMag,
+                                            OctreeProcStats* stats) const
 {
-    Timer timer{};
+    for (const AddedStars& added : addedStars)
+    {
+        added.octree->processVisibleObjects(starHandler,
+                                            position,
+                                            frustumPlanes,
+                                            limitingMag,
+                                            STAR_OCTREE_ROOT_SIZE,
+                                            added.cullingData,
+                                            stats);
+    }
+}
 
-    if (static_cast<unsigned int>(catalog) >= crossIndexes.size())
-        return false;
 
-    if (crossIndexes[catalog] != nullptr)
-        delete crossIndexes[catalog];
+void StarDatabase::findVisibleStarRanges(std::vector<StarOctree::ObjectRange>& ranges,
+                                         const Eigen::Vector3f& position,
+                                         const Eigen::Quaternionf& orientation,
+                                         float fovY,
+                                         float aspectRatio,
+                                         float limitingMag) const
+{
+    Eigen::Hyperplane<float, 3> frustumPlanes[5];
+    computeFrustumPlanes(frustumPlanes, position, orientation, fovY, aspectRatio);
 
-    // Verify that the star database file has a correct header
-    {
-        std::array<char, sizeof(CrossIndexHeader)> header;
-        if (!in.read(header.data(), header.size()).good()) { return false; }
+    octreeRoot->findVisibleNodes(position,
+                                 frustumPlanes,
+                                 limitingMag,
+                                 STAR_OCTREE_ROOT_SIZE,
+                                 ranges);
+}
 
-        // Verify the magic string
-        if (std::string_view(header.data() + offsetof(CrossIndexHeader, magic), CROSSINDEX_MAGIC.size()) != CROSSINDEX_MAGIC)
+
+void StarDatabase::findCloseStars(StarHandler& starHandler,
+                                  const Eigen::Vector3f& position,
+                                  float radius) const
+{
+    if (radius > CloseStarIndex::MaxCachedRadius)
+    {
+        octreeRoot->processCloseObjects(starHandler, position, radius, STAR_OCTREE_ROOT_SIZE);
+    }
+    else
+    {
+        // The handler is called once the lock is released, so that it may
+        // query the database again, with the same distances and apparent
+        // magnitudes as processCloseObjects
+        std::vector<const Star*> closeStars;
         {
-            GetLogger()->error(_("Bad header for cross index\n"));
-            return false;
+            std::scoped_lock lock(closeStarMutex);
+            closeStarIndex.findCloseStars(*octreeRoot, position, radius, closeStars);
         }
 
-        // Verify the version
-        std::uint16_t version;
-        std::memcpy(&version, header.data() + offsetof(CrossIndexHeader, version), sizeof(version));
-        LE_TO_CPU_INT16(version, version);
-        if (version != 0x0100)
+        for (const Star* star : closeStars)
         {
-            GetLogger()->error(_("Bad version for cross index\n"));
-            return false;
+            float distance = (position - star->getPosition()).norm();
+            starHandler.process(*star, distance, star->getApparentMagnitude(distance));
         }
     }
 
-    CrossIndex* xindex = new CrossIndex();
+    for (const AddedStars& added : addedStars)
+        added.octree->processCloseObjects(starHandler, position, radius, STAR_OCTREE_ROOT_SIZE);
+}
+
+
+void StarDatabase::findVisiblePagedStars(StarHandler& starHandler,
+                                         const Eigen::Vector3f& position,
+                                         const Eigen::Quaternionf& orientation,
+                                         float fovY,
+                                         float aspectRatio,
+                                         float limitingMag) const
+{
+    if (pagedCatalog == nullptr)
+        return;
+
+    Eigen::Hyperplane<float, 3> frustumPlanes[5];
+    computeFrustumPlanes(frustumPlanes, position, orientation, fovY, aspectRatio);
+    pagedCatalog->findVisibleStars(starHandler, position, frustumPlanes, limitingMag);
+}
+
+
+PagedStarCatalog* StarDatabase::getPagedCatalog() const
+{
+    return pagedCatalog.get();
+}
+
+
+void StarDatabase::setPagedCatalog(std::unique_ptr<PagedStarCatalog>&& catalog)
+{
+    pagedCatalog = std::move(catalog);
+}
 
-    constexpr std::uint32_t BUFFER_RECORDS = UINT32_C(4096) / sizeof(CrossIndexRecord);
-    std::vector<char> buffer(sizeof(CrossIndexRecord) * BUFFER_RECORDS);
-    bool hasMoreRecords = true;
-    while (hasMoreRecords)
+
+StarNameDatabase* StarDatabase::getNameDatabase() const
+{
+    return namesDB;
+}
+
+
+void StarDatabase::addMemoryUsage(celestia::util::MemoryReport& report) const
+{
+    using celestia::util::vectorMemory;
+
+    std::size_t starBytes = static_cast<std::size_t>(nStars) * (sizeof(Star) + sizeof(Star*)) +
+                            cullingData.getMemoryUsage();
+    std::size_t starCount = nStars;
+    if (octreeRoot != nullptr)
+        starBytes += octreeRoot->getMemoryUsage();
+    if (binFileCatalogNumberIndex != nullptr)
+        starBytes += static_cast<std::size_t>(binFileStarCount) * sizeof(Star*);
+    if (pagedCatalog != nullptr)
     {
-        in.read(buffer.data(), buffer.size());
-        std::size_t remainingRecords = BUFFER_RECORDS;
-        if (in.bad())
-        {
-            GetLogger()->error(_("Loading cross index failed\n"));
-            delete xindex;
-            return false;
-        }
-        if (in.eof())
+        starBytes += pagedCatalog->getLoadedSize();
+        starCount += pagedCatalog->size();
+    }
+    for (const auto& added : addedStars)
+    {
+        starBytes += static_cast<std::size_t>(added.count) * sizeof(Star) +
+                     vectorMemory(added.catalogNumberIndex) +
+                     added.cullingData.getMemoryUsage();
+        if (added.octree != nullptr)
+            starBytes += added.octree->getMemoryUsage();
+        starCount += added.count;
+    }
+    for (const auto& chunk : loadingChunks)
+        starBytes += static_cast<std::size_t>(chunk.capacity) * sizeof(Star);
+    starBytes += vectorMemory(stcFileCatalogNumberIndex) + vectorMemory(barycenters);
+    report.add("Stars", starBytes, starCount);
+
+    // Shared details are those of the spectral types, which are few
+    std::size_t detailBytes = 0;
+    std::size_t detailCount = 0;
+    auto addDetails = [&detailBytes, &detailCount](const Star* first, std::uint32_t count)
+    {
+        for (std::uint32_t i = 0; i < count; ++i)
         {
-            auto bytesRead = static_cast<std::uint32_t>(in.gcount());
-            remainingRecords = bytesRead / sizeof(CrossIndexRecord);
-            // disallow partial records
-            if (bytesRead % sizeof(CrossIndexRecord) != 0)
+            const StarDetails* details = first[i].getDetails();
+            if (details != nullptr && !details->shared())
             {
-                GetLogger()->error(_("Loading cross index failed - unexpected EOF\n"));
-                delete xindex;
-                return false;
+                detailBytes += details->getMemoryUsage();
+                ++detailCount;
             }
-
-            hasMoreRecords = false;
         }
+    };
+    addDetails(stars, nStars);
+    for (const auto& added : addedStars)
+        addDetails(added.stars.get(), added.count);
+    report.add("Star details", detailBytes, detailCount);
 
-        xindex->reserve(xindex->size() + remainingRecords);
+    if (namesDB != nullptr)
+        report.add("Star names", namesDB->getMemoryUsage(), namesDB->getNameCount());
 
-        const char* ptr = buffer.data();
-        while (remainingRecords-- > 0)
-        {
-            CrossIndexEntry ent;
-            std::memcpy(&ent.catalogNumber, ptr + offsetof(CrossIndexRecord, catalogNumber), sizeof(ent.catalogNumber));
-            LE_TO_CPU_INT32(ent.catalogNumber, ent.catalogNumber);
+    std::size_t crossIndexBytes = 0;
+    for (const auto& crossIndex : crossIndexes)
+    {
+        if (crossIndex != nullptr)
+            crossIndexBytes += crossIndex->getMemoryUsage();
+    }
+    report.add("Cross indexes", crossIndexBytes, crossIndexes.size());
+}
 
-            std::memcpy(&ent.celCatalogNumber, ptr + offsetof(CrossIndexRecord, celCatalogNumber), sizeof(ent.celCatalogNumber));
-            LE_TO_CPU_INT32(ent.celCatalogNumber, ent.celCatalogNumber);
 
-            xindex->push_back(ent);
-            ptr += sizeof(CrossIndexRecord);
-        }
-    }
+void StarDatabase::setNameDatabase(StarNameDatabase* _namesDB)
+{
+    namesDB = _namesDB;
+}
 
-    GetLogger()->debug("Loaded xindex in {} ms\n", timer.getTime());
 
-    sort(xindex->begin(), xindex->end());
+bool StarDatabase::loadCrossIndex(const Catalog catalog, std::istream& in)
+{
+    if (static_cast<unsigned int>(catalog) >= crossIndexes.size())
+        return false;
 
-    crossIndexes[catalog] = xindex;
+    crossIndexes[catalog] = CrossIndex::read(in);
+    return crossIndexes[catalog] != nullptr;
+}
 
-    return true;
+
+bool StarDatabase::loadCrossIndex(const Catalog catalog, const fs::path& path)
+{
+    if (static_cast<unsigned int>(catalog) >= crossIndexes.size())
+        return false;
+
+    crossIndexes[catalog] = CrossIndex::open(path);
+    return crossIndexes[catalog] != nullptr;
 }
 
 
@@ -740,61 +991,56 @@ bool StarDatabase::loadBinary(std::istream& in)
         LE_TO_CPU_INT32(nStarsInFile, nStarsInFile);
     }
 
-    constexpr std::uint32_t BUFFER_RECORDS = UINT32_C(4096) / sizeof(StarsDatRecord);
-    std::vector<char> buffer(sizeof(StarsDatRecord) * BUFFER_RECORDS);
+    // The records are read in large blocks, each decoded in chunks on
+    // several threads straight into the stars loaded. The star details are
+    // shared between stars, so they are looked up afterwards on this thread.
+    constexpr std::uint32_t CHUNK_RECORDS = 16384;
+    const unsigned int nThreads = loaderThreadCount();
+    const std::uint32_t blockRecords = CHUNK_RECORDS * nThreads;
+
+    std::vector<char> buffer(sizeof(StarsDatRecord) * std::min(blockRecords, nStarsInFile));
+    std::vector<std::uint16_t> spectralTypes(std::min(blockRecords, nStarsInFile));
+    std::unordered_map<std::uint16_t, IntrusivePtr<StarDetails>> detailsCache;
+
+    Star* const fileStars = nStarsInFile > 0 ? allocateLoadingStars(nStarsInFile) : nullptr;
     std::uint32_t nStarsRemaining = nStarsInFile;
     while (nStarsRemaining > 0)
     {
-        std::uint32_t recordsToRead = std::min(BUFFER_RECORDS, nStarsRemaining);
+        std::uint32_t recordsToRead = std::min(blockRecords, nStarsRemaining);
+        Star* decoded = fileStars + (nStarsInFile - nStarsRemaining);
         if (!in.read(buffer.data(), sizeof(StarsDatRecord) * recordsToRead).good()) { return false; }
 
-        const char* ptr = buffer.data();
+        std::size_t nChunks = (recordsToRead + CHUNK_RECORDS - 1) / CHUNK_RECORDS;
+        runParallel(nChunks, nThreads,
+                    [&](std::size_t chunk)
+                    {
+                        auto begin = static_cast<std::uint32_t>(chunk) * CHUNK_RECORDS;
+                        auto end = std::min(begin + CHUNK_RECORDS, recordsToRead);
+                        for (std::uint32_t i = begin; i < end; ++i)
+                        {
+                            unpackStarsDatRecordFields(buffer.data() + sizeof(StarsDatRecord) * i,
+                                                       decoded[i],
+                                                       spectralTypes[i]);
+                        }
+                    });
+
         for (std::uint32_t i = 0; i < recordsToRead; ++i)
         {
-            AstroCatalog::IndexNumber catNo;
-            std::memcpy(&catNo, ptr + offsetof(StarsDatRecord, catNo), sizeof(catNo));
-            LE_TO_CPU_INT32(catNo, catNo);
-
-            float x;
-            std::memcpy(&x, ptr + offsetof(StarsDatRecord, x), sizeof(x));
-            LE_TO_CPU_FLOAT(x, x);
-
-            float y;
-            std::memcpy(&y, ptr + offsetof(StarsDatRecord, y), sizeof(y));
-            LE_TO_CPU_FLOAT(y, y);
-
-            float z;
-            std::memcpy(&z, ptr + offsetof(StarsDatRecord, z), sizeof(z));
-            LE_TO_CPU_FLOAT(z, z);
-
-            std::int16_t absMag;
-            std::memcpy(&absMag, ptr + offsetof(StarsDatRecord, absMag), sizeof(absMag));
-            LE_TO_CPU_INT16(absMag, absMag);
-
-            std::uint16_t spectralType;
-            std::memcpy(&spectralType, ptr + offsetof(StarsDatRecord, spectralType), sizeof(spectralType));
-            LE_TO_CPU_INT16(spectralType, spectralType);
-
-            Star star;
-            star.setPosition(x, y, z);
-            star.setAbsoluteMagnitude(static_cast<float>(absMag) / 256.0f);
-
-            IntrusivePtr<StarDetails> details = nullptr;
-            StellarClass sc;
-            if (sc.unpackV1(spectralType))
-                details = StarDetails::GetStarDetails(sc);
+            auto [it, inserted] = detailsCache.try_emplace(spectralTypes[i]);
+            if (inserted)
+            {
+                StellarClass sc;
+                if (sc.unpackV1(spectralTypes[i]))
+                    it->second = StarDetails::GetStarDetails(sc);
+            }
 
-            if (details == nullptr)
+            if (it->second == nullptr)
             {
                 GetLogger()->error(_("Bad spectral type in star database, star #{}\n"), nStars);
                 return false;
             }
 
-            star.setDetails(std::move(details));
-            star.setIndex(catNo);
-            unsortedStars.add(star);
-
-            ptr += sizeof(StarsDatRecord);
+            decoded[i].setDetails(IntrusivePtr<StarDetails>(it->second));
             nStars++;
         }
 
@@ -813,16 +1059,172 @@ bool StarDatabase::loadBinary(std::istream& in)
     // will be used to lookup stars during file loading. After loading is
     // complete, the stars are sorted into an octree and this list gets
     // replaced.
-    if (unsortedStars.size() > 0)
+    if (nStarsInFile > 0)
     {
-        binFileStarCount = unsortedStars.size();
+        binFileStarCount = nStarsInFile;
         binFileCatalogNumberIndex = new Star*[binFileStarCount];
         for (unsigned int i = 0; i < binFileStarCount; i++)
         {
-            binFileCatalogNumberIndex[i] = &unsortedStars[i];
+            binFileCatalogNumberIndex[i] = fileStars + i;
         }
-        std::sort(binFileCatalogNumberIndex, binFileCatalogNumberIndex + binFileStarCount,
-                  [](const Star* star0, const Star* star1) { return star0->getIndex() < star1->getIndex(); });
+        parallelSort(binFileCatalogNumberIndex, binFileCatalogNumberIndex + binFileStarCount,
+                     [](const Star* star0, const Star* star1) { return star0->getIndex() < star1->getIndex(); },
+                     nThreads);
+    }
+
+    return true;
+}
+
+
+bool StarDatabase::isSortedBinary(const fs::path& path)
+{
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    std::array<char, sizeof(SortedStarsDatHeader)> header;
+    if (!in.read(header.data(), header.size()).good())
+        return false;
+
+    if (std::string_view(header.data() + offsetof(SortedStarsDatHeader, magic), STARSDAT_MAGIC.size()) != STARSDAT_MAGIC)
+        return false;
+
+    auto version = readRecordField<std::uint16_t>(header.data(), offsetof(SortedStarsDatHeader, version));
+    LE_TO_CPU_INT16(version, version);
+    return version == SORTED_STARSDAT_VERSION;
+}
+
+
+bool StarDatabase::loadSortedBinary(const fs::path& path)
+{
+    Timer timer{};
+
+    if (nStars != 0)
+    {
+        GetLogger()->error(_("Sorted star database must be loaded first\n"));
+        return false;
+    }
+
+    // The file is mapped rather than read so that the records can be
+    // unpacked in place.
+    auto file = celutil::MappedFile::open(path);
+    if (file == nullptr || file->size() < sizeof(SortedStarsDatHeader))
+        return false;
+
+    const char* data = file->data();
+    if (std::string_view(data + offsetof(SortedStarsDatHeader, magic), STARSDAT_MAGIC.size()) != STARSDAT_MAGIC)
+        return false;
+
+    auto version = readRecordField<std::uint16_t>(data, offsetof(SortedStarsDatHeader, version));
+    LE_TO_CPU_INT16(version, version);
+    if (version != SORTED_STARSDAT_VERSION)
+        return false;
+
+    auto nStarsInFile = readRecordField<std::uint32_t>(data, offsetof(SortedStarsDatHeader, counter));
+    LE_TO_CPU_INT32(nStarsInFile, nStarsInFile);
+    auto nNodes = readRecordField<std::uint32_t>(data, offsetof(SortedStarsDatHeader, nodeCount));
+    LE_TO_CPU_INT32(nNodes, nNodes);
+
+    std::uint64_t expectedSize = sizeof(SortedStarsDatHeader)
+                               + static_cast<std::uint64_t>(nNodes) * sizeof(StarsDatNode)
+                               + static_cast<std::uint64_t>(nStarsInFile) * (sizeof(StarsDatRecord) + sizeof(std::uint32_t));
+    if (nStarsInFile == 0 || file->size() != expectedSize)
+        return false;
+
+    const char* nodePtr = data + sizeof(SortedStarsDatHeader);
+    const char* recordPtr = nodePtr + static_cast<std::size_t>(nNodes) * sizeof(StarsDatNode);
+    const char* indexPtr = recordPtr + static_cast<std::size_t>(nStarsInFile) * sizeof(StarsDatRecord);
+
+    auto sortedStars = std::make_unique<Star[]>(nStarsInFile);
+    for (std::uint32_t i = 0; i < nStarsInFile; ++i)
+    {
+        if (!unpackStarsDatRecord(recordPtr, sortedStars[i]))
+        {
+            GetLogger()->error(_("Bad spectral type in star database, star #{}\n"), i);
+            return false;
+        }
+
+        recordPtr += sizeof(StarsDatRecord);
+    }
+
+    Star* firstStar = sortedStars.get();
+    std::uint32_t nodesRemaining = nNodes;
+    std::unique_ptr<StarOctree> root(celengine::readStarsDatOctree(nodePtr,
+                                                                   nodesRemaining,
+                                                                   firstStar,
+                                                                   sortedStars.get() + nStarsInFile));
+    if (root == nullptr || nodesRemaining != 0 || firstStar != sortedStars.get() + nStarsInFile)
+    {
+        GetLogger()->error(_("Bad octree in star database\n"));
+        return false;
+    }
+
+    // The cell sizes aren't stored, so the octree can only be used if it
+    // was built for the same root cell; otherwise finish() rebuilds it.
+    if (root->getCellCenterPos() != STAR_OCTREE_ROOT_CENTER ||
+        root->getExclusionFactor() != starOctreeRootExclusionFactor())
+    {
+        GetLogger()->debug("Sorted star database octree has a different root cell\n");
+        sortedOctreeValid = false;
+    }
+
+    auto index = std::make_unique<Star*[]>(nStarsInFile);
+    for (std::uint32_t i = 0; i < nStarsInFile; ++i)
+    {
+        auto starIndex = readRecordField<std::uint32_t>(indexPtr, 0);
+        LE_TO_CPU_INT32(starIndex, starIndex);
+        indexPtr += sizeof(std::uint32_t);
+
+        if (starIndex >= nStarsInFile ||
+            (i > 0 && index[i - 1]->getIndex() > sortedStars[starIndex].getIndex()))
+        {
+            GetLogger()->error(_("Bad catalog number index in star database\n"));
+            return false;
+        }
+
+        index[i] = &sortedStars[starIndex];
+    }
+
+    stars = sortedStars.release();
+    octreeRoot = root.release();
+    nStars = nStarsInFile;
+    sortedStarCount = nStarsInFile;
+
+    // The sorted index doubles as the load time index of the binary
+    // catalog.
+    binFileStarCount = nStarsInFile;
+    binFileCatalogNumberIndex = index.release();
+
+    GetLogger()->debug("StarDatabase::loadSortedBinary: nStars = {}, nodes = {}, time = {} ms\n",
+                       nStarsInFile, nNodes, timer.getTime());
+    GetLogger()->info(_("{} stars in binary database\n"), nStars);
+
+    return true;
+}
+
+
+bool StarDatabase::writeSortedBinary(std::ostream& out) const
+{
+    if (octreeRoot == nullptr)
+        return false;
+
+    auto nNodes = static_cast<std::uint32_t>(1 + octreeRoot->countChildren());
+    if (!out.write(STARSDAT_MAGIC.data(), STARSDAT_MAGIC.size()).good()
+        || !celutil::writeLE<std::uint16_t>(out, SORTED_STARSDAT_VERSION)
+        || !celutil::writeLE<std::uint32_t>(out, nStars)
+        || !celutil::writeLE<std::uint32_t>(out, nNodes)
+        || !celengine::writeStarsDatOctree(out, *octreeRoot))
+    {
+        return false;
+    }
+
+    for (std::uint32_t i = 0; i < nStars; ++i)
+    {
+        if (!writeStarsDatRecord(out, stars[i]))
+            return false;
+    }
+
+    for (std::uint32_t i = 0; i < nStars; ++i)
+    {
+        if (!celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(catalogNumberIndex[i] - stars)))
+            return false;
     }
 
     return true;
@@ -833,32 +1235,50 @@ void StarDatabase::finish()
 {
     GetLogger()->info(_("Total star count: {}\n"), nStars);
 
-    buildOctree();
-    buildIndexes();
+    // The octree loaded from a sorted binary file can't be used if the stc
+    // files have added stars or changed how the existing ones are sorted.
+    if (octreeRoot != nullptr && (loadingStarCount > 0 || !sortedOctreeValid))
+    {
+        // The sorted stars are rebuilt in place rather than copied
+        GetLogger()->debug("Star catalogs modified the sorted star database, rebuilding octree\n");
+        loadingChunks.push_back({ std::unique_ptr<Star[]>(stars), sortedStarCount, sortedStarCount });
+        loadingStarCount += sortedStarCount;
+        stars = nullptr;
+
+        delete octreeRoot;
+        octreeRoot = nullptr;
+    }
+
+    closeStarIndex.clear();
+    if (octreeRoot == nullptr)
+    {
+        buildOctree();
+        buildIndexes();
+    }
+    else
+    {
+        catalogNumberIndex = binFileCatalogNumberIndex;
+        binFileCatalogNumberIndex = nullptr;
+    }
+    sortedStarCount = 0;
 
     // Delete the temporary indices used only during loading
     delete[] binFileCatalogNumberIndex;
+    binFileCatalogNumberIndex = nullptr;
     stcFileCatalogNumberIndex.clear();
+    stcFileCatalogNumberIndex.shrink_to_fit();
+    stcFileSortedCount = 0;
 
     // Resolve all barycenters; this can't be done before star sorting. There's
     // still a bug here: final orbital radii aren't available until after
     // the barycenters have been resolved, and these are required when building
     // the octree.  This will only rarely cause a problem, but it still needs
     // to be addressed.
-    for (const auto& b : barycenters)
-    {
-        Star* star = find(b.catNo);
-        Star* barycenter = find(b.barycenterCatNo);
-        assert(star != nullptr);
-        assert(barycenter != nullptr);
-        if (star != nullptr && barycenter != nullptr)
-        {
-            star->setOrbitBarycenter(barycenter);
-            barycenter->addOrbitingStar(star);
-        }
-    }
+    resolveBarycenters();
 
-    barycenters.clear();
+    // Built last, as the orbital radii aren't final until the barycenters
+    // have been resolved.
+    cullingData.build(stars, nStars);
 }
 
 
@@ -1300,7 +1720,26 @@ bool StarDatabase::applyOrbit(AstroCatalog::IndexNumber catalogNumber,
 bool StarDatabase::load(std::istream& in, const fs::path& resourcePath)
 {
     Tokenizer tokenizer(&in);
-    Parser parser(&tokenizer);
+    return load(tokenizer, resourcePath);
+}
+
+
+bool StarDatabase::load(Tokenizer& tokenizer, const fs::path& resourcePath)
+{
+    bool ok = loadStars(tokenizer, resourcePath);
+    // The stars read before an error are kept, as they are when loading the
+    // catalogs before finish()
+    if (catalogNumberIndex != nullptr)
+        addLoadedStars();
+    return ok;
+}
+
+
+bool StarDatabase::loadStars(Tokenizer& tokenizer, const fs::path& resourcePath)
+{
+    // Star properties are only used while creating each star
+    celutil::Arena arena;
+    Parser parser(&tokenizer, &arena);
 
 #ifdef ENABLE_NLS
     std::string s = resourcePath.string();
@@ -1310,6 +1749,8 @@ bool StarDatabase::load(std::istream& in, const fs::path& resourcePath)
 
     while (tokenizer.nextToken() != Tokenizer::TokenEnd)
     {
+        arena.reset();
+
         bool isStar = true;
 
         // Parse the disposition--either Add, Replace, or Modify. The disposition
@@ -1461,20 +1902,45 @@ bool StarDatabase::load(std::istream& in, const fs::path& resourcePath)
         }
         else
         {
+            // Stars of a sorted binary file must keep their place in the
+            // octree.
+            bool isSortedStar = sortedStarCount > 0 && star >= stars && star < stars + sortedStarCount;
+            Eigen::Vector3f position = Eigen::Vector3f::Zero();
+            float absMag = 0.0f;
+            float orbitalRadius = 0.0f;
+            if (isSortedStar)
+            {
+                position = star->getPosition();
+                absMag = star->getAbsoluteMagnitude();
+                orbitalRadius = star->getOrbitalRadius();
+            }
+
             ok = createStar(star, disposition, catalogNumber, starData, resourcePath, !isStar);
             star->loadCategories(starData, disposition, resourcePath.string());
+
+            if (isSortedStar &&
+                (star->getPosition() != position ||
+                 star->getAbsoluteMagnitude() != absMag ||
+                 star->getOrbitalRadius() != orbitalRadius))
+            {
+                sortedOctreeValid = false;
+            }
         }
 
         if (ok)
         {
             if (isNewStar)
             {
-                unsortedStars.add(*star);
-                nStars++;
+                Star* loadedStar = allocateLoadingStars(1);
+                *loadedStar = std::move(*star);
                 delete star;
 
+                // The stars added after finish() stay out of the star array
+                if (catalogNumberIndex == nullptr)
+                    nStars++;
+
                 // Add the new star to the temporary (load time) index.
-                stcFileCatalogNumberIndex[catalogNumber] = &unsortedStars[unsortedStars.size() - 1];
+                addStcFileStar(catalogNumber, loadedStar);
             }
 
             if (namesDB != nullptr && !objName.empty())
@@ -1514,29 +1980,86 @@ bool StarDatabase::load(std::istream& in, const fs::path& resourcePath)
 }
 
 
-void StarDatabase::buildOctree()
+/*! Allocate space for count stars loaded and not yet sorted into the
+ *  octree, in the last chunk if it has room for them or else in a new one.
+ */
+Star* StarDatabase::allocateLoadingStars(std::uint32_t count)
 {
-    // This should only be called once for the database
-    // ASSERT(octreeRoot == nullptr);
+    // Large enough for the stc files, which add stars one by one
+    constexpr std::uint32_t MinChunkCapacity = 4096;
 
-    GetLogger()->debug("Sorting stars into octree . . .\n");
-    float absMag = astro::appToAbsMag(STAR_OCTREE_MAGNITUDE,
-                                      STAR_OCTREE_ROOT_SIZE * (float) sqrt(3.0));
-    DynamicStarOctree* root = new DynamicStarOctree(Eigen::Vector3f(1000.0f, 1000.0f, 1000.0f),
-                                                    absMag);
-    for (unsigned int i = 0; i < unsortedStars.size(); ++i)
+    if (loadingChunks.empty() || loadingChunks.back().capacity - loadingChunks.back().count < count)
+    {
+        std::uint32_t capacity = std::max(count, MinChunkCapacity);
+        loadingChunks.push_back({ std::make_unique<Star[]>(capacity), 0, capacity });
+    }
+
+    LoadingChunk& chunk = loadingChunks.back();
+    Star* first = &chunk.stars[chunk.count];
+    chunk.count += count;
+    loadingStarCount += count;
+    return first;
+}
+
+
+void StarDatabase::addStcFileStar(AstroCatalog::IndexNumber catalogNumber, Star* star)
+{
+    // Stars added since the last merge, searched linearly
+    constexpr std::size_t MaxUnsortedStars = 256;
+
+    stcFileCatalogNumberIndex.emplace_back(catalogNumber, star);
+    if (stcFileCatalogNumberIndex.size() - stcFileSortedCount < MaxUnsortedStars)
+        return;
+
+    auto byCatalogNumber = [](const auto& entry0, const auto& entry1) { return entry0.first < entry1.first; };
+    auto sortedEnd = stcFileCatalogNumberIndex.begin() + stcFileSortedCount;
+    std::sort(sortedEnd, stcFileCatalogNumberIndex.end(), byCatalogNumber);
+    std::inplace_merge(stcFileCatalogNumberIndex.begin(), sortedEnd, stcFileCatalogNumberIndex.end(), byCatalogNumber);
+    stcFileSortedCount = stcFileCatalogNumberIndex.size();
+}
+
+
+/*! Sort the stars loaded into a new octree, copying them in its order to
+ *  sortedStars, and release the loading chunks.
+ */
+StarOctree* StarDatabase::sortLoadingStars(Star* sortedStars)
+{
+    DynamicStarOctree* root = new DynamicStarOctree(STAR_OCTREE_ROOT_CENTER,
+                                                    starOctreeRootExclusionFactor());
+    std::vector<const Star*> insertedStars;
+    insertedStars.reserve(loadingStarCount);
+    for (const LoadingChunk& chunk : loadingChunks)
     {
-        root->insertObject(unsortedStars[i], STAR_OCTREE_ROOT_SIZE);
+        for (std::uint32_t i = 0; i < chunk.count; ++i)
+            insertedStars.push_back(&chunk.stars[i]);
     }
+    root->insertObjects(std::move(insertedStars), STAR_OCTREE_ROOT_SIZE, loaderThreadCount());
 
     GetLogger()->debug("Spatially sorting stars for improved locality of reference . . .\n");
-    Star* sortedStars    = new Star[nStars];
-    Star* firstStar      = sortedStars;
-    root->rebuildAndSort(octreeRoot, firstStar);
+    StarOctree* octree = nullptr;
+    Star* firstStar = sortedStars;
+    root->rebuildAndSort(octree, firstStar);
+
+    // Clean up . . .
+    loadingChunks.clear();
+    loadingStarCount = 0;
+    delete root;
+
+    return octree;
+}
+
+
+void StarDatabase::buildOctree()
+{
+    // This should only be called once for the database
+    // ASSERT(octreeRoot == nullptr);
+
+    GetLogger()->debug("Sorting stars into octree . . .\n");
+    Star* sortedStars = new Star[nStars];
+    octreeRoot = sortLoadingStars(sortedStars);
 
-    // ASSERT((int) (firstStar - sortedStars) == nStars);
     GetLogger()->debug("{} stars total\nOctree has {} nodes and {} stars.\n",
-                       firstStar - sortedStars,
+                       nStars,
                        1 + octreeRoot->countChildren(), octreeRoot->countObjects());
 #ifdef PROFILE_OCTREE
     vector<OctreeLevelStatistics> stats;
@@ -1554,15 +2077,66 @@ void StarDatabase::buildOctree()
     }
 #endif
 
-    // Clean up . . .
-    //delete[] stars;
-    unsortedStars.clear();
-    delete root;
-
     stars = sortedStars;
 }
 
 
+/*! Stars loaded after finish() would all have to be moved to sort them into
+ *  the main octree, and pointers to stars are kept everywhere. Instead, the
+ *  stars of each catalog loaded then are sorted into a small octree of
+ *  their own, which the queries traverse after the main one.
+ */
+void StarDatabase::addLoadedStars()
+{
+    bool hasNewStars = loadingStarCount > 0;
+    if (hasNewStars)
+    {
+        AddedStars added;
+        added.count = loadingStarCount;
+        added.stars = std::make_unique<Star[]>(added.count);
+        added.octree.reset(sortLoadingStars(added.stars.get()));
+
+        added.catalogNumberIndex.reserve(added.count);
+        for (std::uint32_t i = 0; i < added.count; ++i)
+            added.catalogNumberIndex.push_back(&added.stars[i]);
+        std::sort(added.catalogNumberIndex.begin(), added.catalogNumberIndex.end(),
+                  [](const Star* star0, const Star* star1) { return star0->getIndex() < star1->getIndex(); });
+
+        GetLogger()->debug("Added {} stars in an octree of {} nodes\n",
+                           added.count, 1 + added.octree->countChildren());
+        addedStars.push_back(std::move(added));
+    }
+
+    stcFileCatalogNumberIndex.clear();
+    stcFileSortedCount = 0;
+
+    // As in finish(), the culling data is built once the orbital radii are
+    // final
+    resolveBarycenters();
+    if (hasNewStars)
+        addedStars.back().cullingData.build(addedStars.back().stars.get(), addedStars.back().count);
+}
+
+
+void StarDatabase::resolveBarycenters()
+{
+    for (const auto& b : barycenters)
+    {
+        Star* star = find(b.catNo);
+        Star* barycenter = find(b.barycenterCatNo);
+        assert(star != nullptr);
+        assert(barycenter != nullptr);
+        if (star != nullptr && barycenter != nullptr)
+        {
+            star->setOrbitBarycenter(barycenter);
+            barycenter->addOrbitingStar(star);
+        }
+    }
+
+    barycenters.clear();
+}
+
+
 void StarDatabase::buildIndexes()
 {
     // This should only be called once for the database
@@ -1574,8 +2148,9 @@ void StarDatabase::buildIndexes()
     for (int i = 0; i < nStars; ++i)
         catalogNumberIndex[i] = &stars[i];
 
-    std::sort(catalogNumberIndex, catalogNumberIndex + nStars,
-              [](const Star* star0, const Star* star1) { return star0->getIndex() < star1->getIndex(); });
+    parallelSort(catalogNumberIndex, catalogNumberIndex + nStars,
+                 [](const Star* star0, const Star* star1) { return star0->getIndex() < star1->getIndex(); },
+                 loaderThreadCount());
 }
 
 
@@ -1583,12 +2158,10 @@ void StarDatabase::buildIndexes()
  *  find(). The final catalog number index for stars cannot be built until
  *  after all stars have been loaded. During catalog loading, there are two
  *  separate indexes: one for the binary catalog and another index for stars
- *  loaded from stc files. They binary catalog index is a sorted array, while
- *  the stc catalog index is an STL map. Since the binary file can be quite
- *  large, we want to avoid creating a map with as many nodes as there are
- *  stars. Stc files should collectively contain many fewer stars, and stars
- *  in an stc file may reference each other (barycenters). Thus, a dynamic
- *  structure like a map is both practical and essential.
+ *  loaded from stc files. The binary catalog index is a sorted array. Stars
+ *  in an stc file may reference each other (barycenters), so the stc index
+ *  grows as they're loaded: the latest stars are searched linearly, and
+ *  merged into its sorted part once there are a few of them.
  */
 Star* StarDatabase::findWhileLoading(AstroCatalog::IndexNumber catalogNumber) const
 {
@@ -1604,11 +2177,24 @@ Star* StarDatabase::findWhileLoading(AstroCatalog::IndexNumber catalogNumber) co
             return *star;
     }
 
-    // Next check for stars loaded from an stc file
-    std::map<AstroCatalog::IndexNumber, Star*>::const_iterator iter = stcFileCatalogNumberIndex.find(catalogNumber);
-    if (iter != stcFileCatalogNumberIndex.end())
+    // Then, once loading is complete, for the stars of the database
+    if (catalogNumberIndex != nullptr)
     {
+        if (Star* star = find(catalogNumber); star != nullptr)
+            return star;
+    }
+
+    // Next check for stars loaded from an stc file
+    auto sortedEnd = stcFileCatalogNumberIndex.begin() + stcFileSortedCount;
+    auto iter = std::lower_bound(stcFileCatalogNumberIndex.begin(), sortedEnd, catalogNumber,
+                                 [](const auto& entry, AstroCatalog::IndexNumber catNum) { return entry.first < catNum; });
+    if (iter != sortedEnd && iter->first == catalogNumber)
         return iter->second;
+
+    for (iter = sortedEnd; iter != stcFileCatalogNumberIndex.end(); ++iter)
+    {
+        if (iter->first == catalogNumber)
+            return iter->second;
     }
 
     // Star not found
@@ -10,12 +10,16 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <iosfwd>
-#include <map>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 #include <Eigen/Core>
@@ -23,13 +27,23 @@
 
 #include <celcompat/filesystem.h>
 #include <celengine/parseobject.h>
-#include <celutil/blockarray.h>
+#include <celutil/array_view.h>
 #include "astroobj.h"
+#include "closestarindex.h"
+#include "crossindex.h"
 #include "hash.h"
 #include "staroctree.h"
 
 
+namespace celestia::util
+{
+class MemoryReport;
+}
+
+class PagedStarCatalog;
 class StarNameDatabase;
+class StarVisibilityCache;
+class Tokenizer;
 
 
 constexpr inline unsigned int MAX_STAR_NAMES = 10;
@@ -47,7 +61,10 @@ class StarDatabase
     Star* find(std::string_view, bool i18n) const;
     AstroCatalog::IndexNumber findCatalogNumberByName(std::string_view, bool i18n) const;
 
-    void getCompletion(std::vector<std::string>&, std::string_view, bool i18n) const;
+    void getCompletion(std::vector<std::string>&,
+                       std::string_view,
+                       bool i18n,
+                       std::size_t maxResults = std::numeric_limits<std::size_t>::max()) const;
 
     void findVisibleStars(StarHandler& starHandler,
                           const Eigen::Vector3f& obsPosition,
@@ -57,19 +74,95 @@ class StarDatabase
                           float limitingMag,
                           OctreeProcStats * = nullptr) const;
 
+    // Parallel traversal: the top levels of the octree are processed by the
+    // first handler on the calling thread, and the visible subtrees below
+    // them are shared out between all the handlers, each of the others
+    // running on a thread of its own. Those handlers must therefore not
+    // touch any state shared with the caller.
+    void findVisibleStars(celestia::util::array_view<StarHandler*> starHandlers,
+                          const Eigen::Vector3f& obsPosition,
+                          const Eigen::Quaternionf& obsOrientation,
+                          float fovY,
+                          float aspectRatio,
+                          float limitingMag) const;
+
+    // Same as above, using and updating cache to avoid classifying the
+    // octree nodes anew each frame while the view barely changes.
+    void findVisibleStars(celestia::util::array_view<StarHandler*> starHandlers,
+                          const Eigen::Vector3f& obsPosition,
+                          const Eigen::Quaternionf& obsOrientation,
+                          float fovY,
+                          float aspectRatio,
+                          float limitingMag,
+                          StarVisibilityCache& cache) const;
+
+    // Find the ranges of the star array which may contain visible stars,
+    // without testing the individual stars; see
+    // StarOctree::findVisibleNodes.
+    void findVisibleStarRanges(std::vector<StarOctree::ObjectRange>& ranges,
+                               const Eigen::Vector3f& obsPosition,
+                               const Eigen::Quaternionf& obsOrientation,
+                               float fovY,
+                               float aspectRatio,
+                               float limitingMag) const;
+
+    // Queries of up to CloseStarIndex::MaxCachedRadius are answered from a
+    // cache of the stars around the previous query position.
     void findCloseStars(StarHandler& starHandler,
                         const Eigen::Vector3f& obsPosition,
                         float radius) const;
 
+    // Only the stars added after finish() which may be visible; these are
+    // included in findVisibleStars and findCloseStars, but not in the star
+    // array nor in findVisibleStarRanges.
+    void findVisibleAddedStars(StarHandler& starHandler,
+                               const Eigen::Vector3f& obsPosition,
+                               const Eigen::Quaternionf& obsOrientation,
+                               float fovY,
+                               float aspectRatio,
+                               float limitingMag) const;
+
+    // Stars of the optional paged catalog which may be visible; these are
+    // not included in the other queries. See PagedStarCatalog.
+    void findVisiblePagedStars(StarHandler& starHandler,
+                               const Eigen::Vector3f& obsPosition,
+                               const Eigen::Quaternionf& obsOrientation,
+                               float fovY,
+                               float aspectRatio,
+                               float limitingMag) const;
+
+    PagedStarCatalog* getPagedCatalog() const;
+    void setPagedCatalog(std::unique_ptr<PagedStarCatalog>&&);
+
     std::string getStarName(const Star&, bool i18n = false) const;
     std::string getStarNameList(const Star&, const unsigned int maxNames = MAX_STAR_NAMES) const;
 
+    inline const StarCullingData& getCullingData() const;
+
     StarNameDatabase* getNameDatabase() const;
     void setNameDatabase(StarNameDatabase*);
 
+    // Add the memory taken by the stars, their details, names and cross
+    // indexes to report
+    void addMemoryUsage(celestia::util::MemoryReport& report) const;
+
+    // Stars loaded after finish(), e.g. by scripts loading catalog
+    // fragments, are added without rebuilding the octree.
     bool load(std::istream&, const fs::path& resourcePath = fs::path());
+    bool load(Tokenizer&, const fs::path& resourcePath = fs::path());
     bool loadBinary(std::istream&);
 
+    // Star database files of the sorted format store the stars already in
+    // octree order, along with the octree nodes and the catalog number
+    // index, so that they can be used without sorting. Such a file must be
+    // the first star catalog loaded.
+    static bool isSortedBinary(const fs::path&);
+    bool loadSortedBinary(const fs::path&);
+    // Write the database in the sorted format. Only the fields of the
+    // stars.dat records are stored, so this is meant for databases loaded
+    // from a stars.dat file alone.
+    bool writeSortedBinary(std::ostream&) const;
+
     enum Catalog
     {
         HenryDraper = 0,
@@ -82,17 +175,9 @@ class StarDatabase
     // a HIPPARCOS stars.
     static constexpr AstroCatalog::IndexNumber MAX_HIPPARCOS_NUMBER = 999999;
 
-    struct CrossIndexEntry
-    {
-        AstroCatalog::IndexNumber catalogNumber;
-        AstroCatalog::IndexNumber celCatalogNumber;
-
-        bool operator<(const CrossIndexEntry&) const;
-    };
-
-    using CrossIndex = std::vector<CrossIndexEntry>;
-
     bool loadCrossIndex(const Catalog, std::istream&);
+    // Maps sorted cross index files rather than reading them
+    bool loadCrossIndex(const Catalog, const fs::path&);
     AstroCatalog::IndexNumber searchCrossIndexForCatalogNumber(const Catalog, const AstroCatalog::IndexNumber number) const;
     Star* searchCrossIndex(const Catalog, const AstroCatalog::IndexNumber number) const;
     AstroCatalog::IndexNumber crossIndex(const Catalog, const AstroCatalog::IndexNumber number) const;
@@ -127,8 +212,19 @@ private:
                     const CustomStarDetails& customDetails,
                     std::optional<Eigen::Vector3f>& barycenterPosition);
 
+    bool loadStars(Tokenizer&, const fs::path& resourcePath);
+    Star* allocateLoadingStars(std::uint32_t count);
+    void addStcFileStar(AstroCatalog::IndexNumber catalogNumber, Star* star);
+    StarOctree* sortLoadingStars(Star* sortedStars);
     void buildOctree();
     void buildIndexes();
+    void addLoadedStars();
+    void resolveBarycenters();
+    void processVisibleAddedStars(StarHandler& starHandler,
+                                  const Eigen::Vector3f& obsPosition,
+                                  const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                                  float limitingMag,
+                                  OctreeProcStats* stats) const;
     Star* findWhileLoading(AstroCatalog::IndexNumber catalogNumber) const;
 
     std::uint32_t nStars{ 0 };
@@ -137,18 +233,54 @@ private:
     StarNameDatabase* namesDB{ nullptr };
     Star**            catalogNumberIndex{ nullptr };
     StarOctree*       octreeRoot{ nullptr };
+    StarCullingData   cullingData;
+    std::unique_ptr<PagedStarCatalog> pagedCatalog;
+    // Cache for findCloseStars, guarded by closeStarMutex
+    mutable CloseStarIndex closeStarIndex;
+    mutable std::mutex     closeStarMutex;
     AstroCatalog::IndexNumber nextAutoCatalogNumber{ 0xfffffffe };
 
-    std::vector<CrossIndex*> crossIndexes;
+    std::vector<std::unique_ptr<CrossIndex>> crossIndexes;
+
+    // Stars added by the catalogs loaded after finish(), one octree for
+    // each, as they can't be sorted into the main octree without moving
+    // all the stars
+    struct AddedStars
+    {
+        std::unique_ptr<Star[]> stars;
+        std::uint32_t count{ 0 };
+        std::unique_ptr<StarOctree> octree;
+        StarCullingData cullingData;
+        // Sorted by catalog number
+        std::vector<Star*> catalogNumberIndex;
+    };
+    std::vector<AddedStars> addedStars;
 
     // These values are used by the star database loader; they are
     // not used after loading is complete.
-    BlockArray<Star> unsortedStars;
+    // Stars loaded and not yet sorted into the octree. The chunks are
+    // never reallocated, so pointers to the stars stay valid while
+    // loading.
+    struct LoadingChunk
+    {
+        std::unique_ptr<Star[]> stars;
+        std::uint32_t count{ 0 };
+        std::uint32_t capacity{ 0 };
+    };
+    std::vector<LoadingChunk> loadingChunks;
+    std::uint32_t loadingStarCount{ 0 };
     // List of stars loaded from binary file, sorted by catalog number
     Star** binFileCatalogNumberIndex{ nullptr };
     unsigned int binFileStarCount{ 0 };
-    // Catalog number -> star mapping for stars loaded from stc files
-    std::map<AstroCatalog::IndexNumber, Star*> stcFileCatalogNumberIndex;
+    // Catalog numbers of the stars loaded from stc files, sorted up to
+    // stcFileSortedCount and followed by the latest ones unsorted
+    std::vector<std::pair<AstroCatalog::IndexNumber, Star*>> stcFileCatalogNumberIndex;
+    std::size_t stcFileSortedCount{ 0 };
+    // Number of stars loaded from a sorted binary file; these are already
+    // in the octree, which remains usable as long as no stars are added and
+    // none of them are moved or changed in brightness.
+    std::uint32_t sortedStarCount{ 0 };
+    bool sortedOctreeValid{ true };
 
     struct BarycenterUsage
     {
@@ -168,3 +300,8 @@ std::uint32_t StarDatabase::size() const
 {
     return nStars;
 }
+
+const StarCullingData& StarDatabase::getCullingData() const
+{
+    return cullingData;
+}
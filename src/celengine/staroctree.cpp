@@ -10,7 +10,11 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <cmath>
 #include <celengine/staroctree.h>
+#include <celmath/mathlib.h>
+#include <celutil/memoryreport.h>
 
 using namespace Eigen;
 
@@ -83,6 +87,195 @@ template<> DynamicStarOctree::ExclusionFactorDecayFunction*
            DynamicStarOctree::decayFunction = starAbsoluteMagnitudeDecayFunction;
 
 
+// Test the cubic octree node against each one of the five planes that
+// define the infinite view frustum.
+bool starNodeInFrustum(const Vector3f&             cellCenterPos,
+                       const Hyperplane<float, 3>* frustumPlanes,
+                       float                       scale)
+{
+    for (unsigned int i = 0; i < 5; ++i)
+    {
+        const Hyperplane<float, 3>& plane = frustumPlanes[i];
+        float r = scale * plane.normal().cwiseAbs().sum();
+        if (plane.signedDistance(cellCenterPos) < -r)
+            return false;
+    }
+
+    return true;
+}
+
+
+// Pass the stars of a node which are brighter than limitingFactor on to the
+// processor; dimmest is the faintest absolute magnitude which may be visible
+// from the nearest point of the node.
+void processNodeStars(StarHandler&    processor,
+                      const Star*     firstObject,
+                      unsigned int    nObjects,
+                      const Vector3f& obsPosition,
+                      float           limitingFactor,
+                      float           dimmest)
+{
+    for (unsigned int i = 0; i < nObjects; ++i)
+    {
+        const Star& obj = firstObject[i];
+
+        if (obj.getAbsoluteMagnitude() < dimmest)
+        {
+            float distance    = (obsPosition - obj.getPosition()).norm();
+            float appMag      = obj.getApparentMagnitude(distance);
+
+            if (appMag < limitingFactor || (distance < MAX_STAR_ORBIT_RADIUS && obj.getOrbit()))
+                processor.process(obj, distance, appMag);
+        }
+    }
+}
+
+
+// Stars are culled from the packed arrays in blocks. A first, branch free
+// pass computes the squared distances and a conservative visibility mask for
+// the whole block, which the compiler can vectorize. The apparent magnitudes
+// of the block are computed with fastLog10 in place of std::log10; its error
+// of about 1e-6 of the logarithm stays well under 1e-4 magnitudes. The stars
+// which survive both tests are then handed to the processor in a single
+// call.
+constexpr unsigned int CullBlockSize = 64;
+
+// Same as above, reading the star properties from the packed arrays. The
+// stars behind the observer are also rejected here, with the exception of
+// nearby stars and stars with orbits.
+void processNodeStars(StarHandler&                processor,
+                      const StarCullingData&      cullingData,
+                      const Star*                 firstObject,
+                      unsigned int                nObjects,
+                      const Vector3f&             obsPosition,
+                      const Hyperplane<float, 3>& viewPlane,
+                      float                       limitingFactor,
+                      float                       dimmest)
+{
+    std::size_t first = cullingData.indexOf(firstObject);
+    const float* posX       = cullingData.positionX.data() + first;
+    const float* posY       = cullingData.positionY.data() + first;
+    const float* posZ       = cullingData.positionZ.data() + first;
+    const float* absMag     = cullingData.absMag.data() + first;
+    const float* extinction = cullingData.extinction.data() + first;
+    const std::uint8_t* flags = cullingData.flags.data() + first;
+
+    const float ox = obsPosition.x();
+    const float oy = obsPosition.y();
+    const float oz = obsPosition.z();
+    const float vx = viewPlane.normal().x();
+    const float vy = viewPlane.normal().y();
+    const float vz = viewPlane.normal().z();
+    const float maxOrbitRadius2 = MAX_STAR_ORBIT_RADIUS * MAX_STAR_ORBIT_RADIUS;
+    // absToAppMag without the distance term
+    const float appMagOffset = -5.0f - 5.0f * std::log10(LY_PER_PARSEC<float>);
+
+    float        distance2[CullBlockSize];
+    float        blockAppMags[CullBlockSize];
+    std::uint8_t candidate[CullBlockSize];
+    unsigned int indices[CullBlockSize];
+    float        distances[CullBlockSize];
+    float        appMags[CullBlockSize];
+
+    for (unsigned int block = 0; block < nObjects; block += CullBlockSize)
+    {
+        unsigned int blockSize = std::min(CullBlockSize, nObjects - block);
+
+        for (unsigned int j = 0; j < blockSize; ++j)
+        {
+            unsigned int i = block + j;
+            float dx = posX[i] - ox;
+            float dy = posY[i] - oy;
+            float dz = posZ[i] - oz;
+            float d2 = dx * dx + dy * dy + dz * dz;
+            bool inFront = dx * vx + dy * vy + dz * vz >= 0.0f;
+            bool nearby  = d2 < maxOrbitRadius2;
+            bool orbit   = (flags[i] & StarCullingData::HasOrbit) != 0;
+            distance2[j] = d2;
+            candidate[j] = (absMag[i] < dimmest) & (inFront | nearby | orbit);
+        }
+
+        // The magnitudes of the whole block, without branches or calls to
+        // log10, and the distances in place of their squares
+        for (unsigned int j = 0; j < blockSize; ++j)
+        {
+            unsigned int i = block + j;
+            float distance = std::sqrt(distance2[j]);
+            blockAppMags[j] = absMag[i] + appMagOffset + 5.0f * celmath::fastLog10(distance) +
+                              extinction[i] * distance;
+            distance2[j] = distance;
+        }
+
+        unsigned int count = 0;
+        for (unsigned int j = 0; j < blockSize; ++j)
+        {
+            if (candidate[j] == 0)
+                continue;
+
+            unsigned int i = block + j;
+            float distance = distance2[j];
+            float appMag   = blockAppMags[j];
+
+            if (appMag < limitingFactor ||
+                (distance < MAX_STAR_ORBIT_RADIUS && (flags[i] & StarCullingData::HasOrbit) != 0))
+            {
+                indices[count]   = i;
+                distances[count] = distance;
+                appMags[count]   = appMag;
+                ++count;
+            }
+        }
+
+        if (count > 0)
+            processor.processBatch(firstObject, indices, distances, appMags, count);
+    }
+}
+
+
+void StarCullingData::build(const Star* firstStar, std::uint32_t nStars)
+{
+    stars = firstStar;
+
+    positionX.resize(nStars);
+    positionY.resize(nStars);
+    positionZ.resize(nStars);
+    absMag.resize(nStars);
+    extinction.resize(nStars);
+    temperature.resize(nStars);
+    orbitalRadius.resize(nStars);
+    flags.resize(nStars);
+    orbitingStars.clear();
+
+    for (std::uint32_t i = 0; i < nStars; ++i)
+    {
+        const Star& star = firstStar[i];
+        Vector3f pos = star.getPosition();
+        positionX[i] = pos.x();
+        positionY[i] = pos.y();
+        positionZ[i] = pos.z();
+        absMag[i] = star.getAbsoluteMagnitude();
+        extinction[i] = star.getExtinction();
+        temperature[i] = star.getTemperature();
+        orbitalRadius[i] = star.getOrbitalRadius();
+        flags[i] = 0;
+        if (star.getOrbit() != nullptr)
+        {
+            flags[i] |= HasOrbit;
+            orbitingStars.push_back(i);
+        }
+    }
+}
+
+
+std::size_t StarCullingData::getMemoryUsage() const
+{
+    using celestia::util::vectorMemory;
+    return vectorMemory(positionX) + vectorMemory(positionY) + vectorMemory(positionZ) +
+           vectorMemory(absMag) + vectorMemory(extinction) + vectorMemory(temperature) +
+           vectorMemory(orbitalRadius) + vectorMemory(flags) + vectorMemory(orbitingStars);
+}
+
+
 // total specialization of the StaticOctree template process*() methods for stars:
 template<>
 void StarOctree::processVisibleObjects(StarHandler&    processor,
@@ -101,16 +294,8 @@ void StarOctree::processVisibleObjects(StarHandler&    processor,
     }
 #endif
     // See if this node lies within the view frustum
-
-    // Test the cubic octree node against each one of the five
-    // planes that define the infinite view frustum.
-    for (unsigned int i = 0; i < 5; ++i)
-    {
-        const Hyperplane<float, 3>& plane = frustumPlanes[i];
-        float r = scale * plane.normal().cwiseAbs().sum();
-        if (plane.signedDistance(cellCenterPos) < -r)
-            return;
-    }
+    if (!starNodeInFrustum(cellCenterPos, frustumPlanes, scale))
+        return;
 
     // Compute the distance to node; this is equal to the distance to
     // the cellCenterPos of the node minus the boundingRadius of the node, scale * SQRT3.
@@ -119,23 +304,11 @@ void StarOctree::processVisibleObjects(StarHandler&    processor,
     // Process the objects in this node
     float dimmest     = minDistance > 0 ? astro::appToAbsMag(limitingFactor, minDistance) : 1000;
 
-    for (unsigned int i=0; i<nObjects; ++i)
-    {
 #ifdef OCTREE_DEBUG
-        if (stats != nullptr)
-            stats->objects++;
+    if (stats != nullptr)
+        stats->objects += nObjects;
 #endif
-        const Star& obj = _firstObject[i];
-
-        if (obj.getAbsoluteMagnitude() < dimmest)
-        {
-            float distance    = (obsPosition - obj.getPosition()).norm();
-            float appMag      = obj.getApparentMagnitude(distance);
-
-            if (appMag < limitingFactor || (distance < MAX_STAR_ORBIT_RADIUS && obj.getOrbit()))
-                processor.process(obj, distance, appMag);
-        }
-    }
+    processNodeStars(processor, _firstObject, nObjects, obsPosition, limitingFactor, dimmest);
 
     // See if any of the objects in child nodes are potentially included
     // that we need to recurse deeper.
@@ -167,6 +340,151 @@ void StarOctree::processVisibleObjects(StarHandler&    processor,
 }
 
 
+template<>
+void StarOctree::processVisibleObjects(StarHandler&           processor,
+                                       const Vector3f&        obsPosition,
+                                       const Hyperplane<float, 3>* frustumPlanes,
+                                       float                  limitingFactor,
+                                       float                  scale,
+                                       const StarCullingData& cullingData,
+                                       OctreeProcStats        *stats) const
+{
+#ifdef OCTREE_DEBUG
+    size_t h;
+    if (stats != nullptr)
+    {
+        h = stats->height + 1;
+        stats->nodes++;
+    }
+#endif
+    if (!starNodeInFrustum(cellCenterPos, frustumPlanes, scale))
+        return;
+
+    float minDistance = (obsPosition - cellCenterPos).norm() - scale * StarOctree::SQRT3;
+    float dimmest     = minDistance > 0 ? astro::appToAbsMag(limitingFactor, minDistance) : 1000;
+
+#ifdef OCTREE_DEBUG
+    if (stats != nullptr)
+        stats->objects += nObjects;
+#endif
+    processNodeStars(processor, cullingData, _firstObject, nObjects, obsPosition, frustumPlanes[4], limitingFactor, dimmest);
+
+    if (_children == nullptr)
+        return;
+
+    if (minDistance <= 0 || astro::absToAppMag(exclusionFactor, minDistance) <= limitingFactor)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            _children[i]->processVisibleObjects(processor,
+                                                obsPosition,
+                                                frustumPlanes,
+                                                limitingFactor,
+                                                scale * 0.5f,
+                                                cullingData,
+                                                stats);
+#ifdef OCTREE_DEBUG
+            if (stats != nullptr && stats->height > h)
+                h = stats->height;
+#endif
+        }
+#ifdef OCTREE_DEBUG
+        if (stats != nullptr)
+            stats->height = h;
+#endif
+    }
+}
+
+
+template<>
+void StarOctree::processVisibleObjects(StarHandler&           processor,
+                                       const Vector3f&        obsPosition,
+                                       const Hyperplane<float, 3>* frustumPlanes,
+                                       float                  limitingFactor,
+                                       float                  scale,
+                                       const StarCullingData& cullingData,
+                                       unsigned int           splitLevel,
+                                       std::vector<Subtree>&  subtrees) const
+{
+    if (splitLevel == 0)
+    {
+        // The frustum and magnitude tests for this node are left to
+        // whoever traverses the subtree.
+        subtrees.push_back({ this, scale });
+        return;
+    }
+
+    if (!starNodeInFrustum(cellCenterPos, frustumPlanes, scale))
+        return;
+
+    float minDistance = (obsPosition - cellCenterPos).norm() - scale * StarOctree::SQRT3;
+    float dimmest     = minDistance > 0 ? astro::appToAbsMag(limitingFactor, minDistance) : 1000;
+
+    processNodeStars(processor, cullingData, _firstObject, nObjects, obsPosition, frustumPlanes[4], limitingFactor, dimmest);
+
+    if (_children == nullptr)
+        return;
+
+    if (minDistance <= 0 || astro::absToAppMag(exclusionFactor, minDistance) <= limitingFactor)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            _children[i]->processVisibleObjects(processor,
+                                                obsPosition,
+                                                frustumPlanes,
+                                                limitingFactor,
+                                                scale * 0.5f,
+                                                cullingData,
+                                                splitLevel - 1,
+                                                subtrees);
+        }
+    }
+}
+
+
+template<>
+void StarOctree::findVisibleNodes(const Vector3f&             obsPosition,
+                                  const Hyperplane<float, 3>* frustumPlanes,
+                                  float                       limitingFactor,
+                                  float                       scale,
+                                  std::vector<ObjectRange>&   ranges) const
+{
+    if (!starNodeInFrustum(cellCenterPos, frustumPlanes, scale))
+        return;
+
+    if (nObjects > 0)
+    {
+        // Objects of a node are immediately followed by those of its
+        // subtree, so visible neighbours usually merge into one range.
+        if (!ranges.empty() &&
+            ranges.back().firstObject + ranges.back().nObjects == _firstObject)
+        {
+            ranges.back().nObjects += nObjects;
+        }
+        else
+        {
+            ranges.push_back({ _firstObject, nObjects });
+        }
+    }
+
+    if (_children == nullptr)
+        return;
+
+    float minDistance = (obsPosition - cellCenterPos).norm() - scale * StarOctree::SQRT3;
+    if (minDistance <= 0 || astro::absToAppMag(exclusionFactor, minDistance) <= limitingFactor)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            _children[i]->findVisibleNodes(obsPosition,
+                                           frustumPlanes,
+                                           limitingFactor,
+                                           scale * 0.5f,
+                                           ranges);
+        }
+    }
+}
+
+
 template<>
 void StarOctree::processCloseObjects(StarHandler&    processor,
                                      const Vector3f& obsPosition,
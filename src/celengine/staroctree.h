@@ -13,12 +13,87 @@
 #ifndef _CELENGINE_STAROCTREE_H_
 #define _CELENGINE_STAROCTREE_H_
 
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 #include <celengine/star.h>
 #include <celengine/octree.h>
 
 
-typedef DynamicOctree  <Star, float> DynamicStarOctree;
-typedef StaticOctree   <Star, float> StarOctree;
-typedef OctreeProcessor<Star, float> StarHandler;
+// Structure of arrays copy of the star properties read by the octree
+// traversal and point star rendering. The arrays are in the same order as
+// the (octree sorted) star array, so the loops over a node's stars stream
+// through contiguous memory instead of loading whole Star objects and
+// chasing the pointers to their StarDetails.
+template<> struct OctreeCullingData<Star>
+{
+    enum : std::uint8_t
+    {
+        HasOrbit = 0x01,
+    };
+
+    void build(const Star* firstStar, std::uint32_t nStars);
+    std::size_t getMemoryUsage() const;
+
+    std::size_t indexOf(const Star* star) const
+    {
+        return static_cast<std::size_t>(star - stars);
+    }
+
+    // False for the stars of other arrays, e.g. stars added to the
+    // database after loading
+    bool contains(const Star* star) const
+    {
+        return star >= stars && star < stars + positionX.size();
+    }
+
+    const Star* stars{ nullptr };
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> positionZ;
+    std::vector<float> absMag;
+    std::vector<float> extinction;
+    std::vector<float> temperature;
+    std::vector<float> orbitalRadius;
+    std::vector<std::uint8_t> flags;
+    // Indices of all the stars with the HasOrbit flag
+    std::vector<std::uint32_t> orbitingStars;
+};
+
+
+typedef DynamicOctree    <Star, float> DynamicStarOctree;
+typedef StaticOctree     <Star, float> StarOctree;
+typedef OctreeProcessor  <Star, float> StarHandler;
+typedef OctreeCullingData<Star>        StarCullingData;
+
+// The size of the root star octree node is also the maximum distance
+// distance from the Sun at which any star may be located. The current
+// setting of 1.0e7 light years is large enough to contain the entire
+// local group of galaxies. A larger value should be OK, but the
+// performance implications for octree traversal still need to be
+// investigated.
+constexpr inline float STAR_OCTREE_ROOT_SIZE   = 1000000000.0f;
+
+// Node level steps of the star octree traversal, for traversals of star
+// octrees which aren't held by a single StarOctree.
+bool starNodeInFrustum(const Eigen::Vector3f&             cellCenterPos,
+                       const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                       float                              scale);
+void processNodeStars(StarHandler&           processor,
+                      const Star*            firstObject,
+                      unsigned int           nObjects,
+                      const Eigen::Vector3f& obsPosition,
+                      float                  limitingFactor,
+                      float                  dimmest);
+// Same as above, reading the star properties from cullingData; viewPlane
+// is the near plane of the frustum.
+void processNodeStars(StarHandler&                       processor,
+                      const StarCullingData&             cullingData,
+                      const Star*                        firstObject,
+                      unsigned int                       nObjects,
+                      const Eigen::Vector3f&             obsPosition,
+                      const Eigen::Hyperplane<float, 3>& viewPlane,
+                      float                              limitingFactor,
+                      float                              dimmest);
 
 #endif  // _CELENGINE_STAROCTREE_H_
@@ -0,0 +1,258 @@
+// starquery.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Parallel and asynchronous searches for the best matching stars of a
+// star database, used by the star browsers.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "star.h"
+#include "stardb.h"
+
+namespace celestia::engine
+{
+
+namespace detail
+{
+
+// Stars compared equal by the predicate are kept in database order, so the
+// result doesn't depend on how the database was split.
+template<typename Pred>
+struct StarOrder
+{
+    Pred pred;
+
+    bool operator()(const Star* star0, const Star* star1) const
+    {
+        if (pred(star0, star1))
+            return true;
+        if (pred(star1, star0))
+            return false;
+        return star0 < star1;
+    }
+};
+
+// Keep the best nStars stars of candidates, in no particular order.
+template<typename Order>
+void
+pruneStars(std::vector<Star*>& candidates, std::size_t nStars, const Order& order)
+{
+    if (candidates.size() <= nStars)
+        return;
+    std::nth_element(candidates.begin(), candidates.begin() + (nStars - 1), candidates.end(), order);
+    candidates.resize(nStars);
+}
+
+} // end namespace celestia::engine::detail
+
+// Find the best nStars stars of the database, sorted from the best match
+// to the worst. pred(star0, star1) returns true if star0 is the better
+// match; stars for which filter returns true are left out. The database is
+// split into chunks searched by up to nThreads threads (one per core when
+// zero), each with its own copies of the predicates. If cancelled becomes
+// true the search stops early and returns no stars.
+template<typename Pred, typename Filter>
+std::vector<Star*>
+findBestStars(const StarDatabase& stardb,
+              const Pred& pred,
+              const Filter& filter,
+              std::size_t nStars,
+              unsigned int nThreads = 0,
+              const std::atomic<bool>* cancelled = nullptr)
+{
+    constexpr std::uint32_t MinChunkSize = 65536;
+    constexpr std::uint32_t CancelCheckInterval = 4096;
+
+    std::vector<Star*> bestStars;
+    std::uint32_t totalStars = stardb.size();
+    if (nStars == 0 || totalStars == 0)
+        return bestStars;
+
+    if (nThreads == 0)
+        nThreads = std::max(1u, std::thread::hardware_concurrency());
+    auto nChunks = std::max(1u, std::min(nThreads, totalStars / MinChunkSize));
+
+    auto isCancelled = [cancelled]()
+    {
+        return cancelled != nullptr && cancelled->load(std::memory_order_relaxed);
+    };
+
+    // Each chunk holds on to at most twice nStars candidates; once full,
+    // they're pruned and the worst remaining one becomes the threshold a
+    // star has to beat.
+    auto searchChunk = [&](std::uint32_t first, std::uint32_t last, std::vector<Star*>& candidates)
+    {
+        detail::StarOrder<Pred> order{ pred };
+        Filter chunkFilter(filter);
+        const Star* threshold = nullptr;
+
+        candidates.reserve(std::min(static_cast<std::size_t>(last - first), nStars * 2));
+        for (std::uint32_t i = first; i < last; ++i)
+        {
+            if ((i - first) % CancelCheckInterval == 0 && isCancelled())
+                return;
+
+            Star* star = stardb.getStar(i);
+            if (threshold != nullptr && !order(star, threshold))
+                continue;
+            if (chunkFilter(star))
+                continue;
+
+            candidates.push_back(star);
+            if (candidates.size() == nStars * 2)
+            {
+                detail::pruneStars(candidates, nStars, order);
+                threshold = candidates.back();
+            }
+        }
+
+        detail::pruneStars(candidates, nStars, order);
+    };
+
+    std::vector<std::vector<Star*>> chunkStars(nChunks);
+    std::vector<std::thread> workers;
+    for (std::uint32_t i = 1; i < nChunks; ++i)
+    {
+        workers.emplace_back(searchChunk,
+                             static_cast<std::uint32_t>(static_cast<std::uint64_t>(totalStars) * i / nChunks),
+                             static_cast<std::uint32_t>(static_cast<std::uint64_t>(totalStars) * (i + 1) / nChunks),
+                             std::ref(chunkStars[i]));
+    }
+    searchChunk(0, static_cast<std::uint32_t>(totalStars / nChunks), chunkStars[0]);
+
+    for (auto& worker : workers)
+        worker.join();
+
+    if (isCancelled())
+        return bestStars;
+
+    for (const auto& stars : chunkStars)
+        bestStars.insert(bestStars.end(), stars.begin(), stars.end());
+
+    detail::StarOrder<Pred> order{ pred };
+    auto bestEnd = bestStars.begin() + std::min(nStars, bestStars.size());
+    std::partial_sort(bestStars.begin(), bestEnd, bestStars.end(), order);
+    bestStars.erase(bestEnd, bestStars.end());
+
+    return bestStars;
+}
+
+// Find the stars of the range [first, last) of the database for which
+// filter returns false, in database order. The range is split as by
+// findBestStars.
+template<typename Filter>
+std::vector<Star*>
+findStars(const StarDatabase& stardb,
+          std::uint32_t first,
+          std::uint32_t last,
+          const Filter& filter,
+          unsigned int nThreads = 0)
+{
+    constexpr std::uint32_t MinChunkSize = 65536;
+
+    std::vector<Star*> stars;
+    last = std::min(last, stardb.size());
+    if (first >= last)
+        return stars;
+
+    if (nThreads == 0)
+        nThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::uint32_t nRange = last - first;
+    auto nChunks = std::max(1u, std::min(nThreads, nRange / MinChunkSize));
+
+    auto searchChunk = [&](std::uint32_t chunk, std::vector<Star*>& found)
+    {
+        Filter chunkFilter(filter);
+        auto chunkFirst = first + static_cast<std::uint32_t>(static_cast<std::uint64_t>(nRange) * chunk / nChunks);
+        auto chunkLast = first + static_cast<std::uint32_t>(static_cast<std::uint64_t>(nRange) * (chunk + 1) / nChunks);
+        for (std::uint32_t i = chunkFirst; i < chunkLast; ++i)
+        {
+            Star* star = stardb.getStar(i);
+            if (!chunkFilter(star))
+                found.push_back(star);
+        }
+    };
+
+    std::vector<std::vector<Star*>> chunkStars(nChunks);
+    std::vector<std::thread> workers;
+    for (std::uint32_t i = 1; i < nChunks; ++i)
+        workers.emplace_back(searchChunk, i, std::ref(chunkStars[i]));
+    searchChunk(0, chunkStars[0]);
+
+    for (auto& worker : workers)
+        worker.join();
+
+    std::size_t nFound = 0;
+    for (const auto& found : chunkStars)
+        nFound += found.size();
+    stars.reserve(nFound);
+    for (const auto& found : chunkStars)
+        stars.insert(stars.end(), found.begin(), found.end());
+
+    return stars;
+}
+
+// A findBestStars search running on a background thread. Starting another
+// search, or destroying the query, cancels the running one. The database
+// must not change while the search is running.
+class StarQuery
+{
+ public:
+    StarQuery() = default;
+    ~StarQuery() { cancel(); }
+
+    StarQuery(const StarQuery&) = delete;
+    StarQuery& operator=(const StarQuery&) = delete;
+
+    template<typename Pred, typename Filter>
+    void start(const StarDatabase& stardb, Pred pred, Filter filter, std::size_t nStars)
+    {
+        cancel();
+        cancelled = false;
+        result = std::async(std::launch::async,
+                            [this, &stardb, pred = std::move(pred), filter = std::move(filter), nStars]()
+                            { return findBestStars(stardb, pred, filter, nStars, 0, &cancelled); });
+    }
+
+    // Stop the running search, waiting for it to finish.
+    void cancel()
+    {
+        if (!result.valid())
+            return;
+        cancelled = true;
+        result.wait();
+        result = {};
+    }
+
+    bool running() const { return result.valid(); }
+
+    bool ready() const
+    {
+        return result.valid() && result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    // The stars found by the search, waiting for it to finish if needed.
+    std::vector<Star*> get() { return result.valid() ? result.get() : std::vector<Star*>(); }
+
+ private:
+    std::atomic<bool> cancelled{ false };
+    std::future<std::vector<Star*>> result;
+};
+
+} // end namespace celestia::engine
@@ -0,0 +1,186 @@
+// starsdat.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Record layout of the binary star database files.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "starsdat.h"
+
+#include <cmath>
+#include <memory>
+#include <ostream>
+#include <utility>
+
+#include <celutil/binarywrite.h>
+#include <celutil/bytes.h>
+#include <celutil/intrusiveptr.h>
+#include "star.h"
+#include "stellarclass.h"
+
+namespace celutil = celestia::util;
+
+namespace celestia::engine
+{
+
+namespace
+{
+
+// Sanity limit for the depth of octrees read from sorted star files
+constexpr unsigned int SORTED_STARSDAT_MAX_DEPTH = 64;
+
+StarOctree*
+readOctreeNode(const char*& nodePtr,
+               std::uint32_t& nodesRemaining,
+               Star*& firstStar,
+               const Star* lastStar,
+               unsigned int depth)
+{
+    if (nodesRemaining == 0 || depth > SORTED_STARSDAT_MAX_DEPTH)
+        return nullptr;
+
+    StarsDatNodeInfo info = unpackStarsDatNode(nodePtr);
+    nodePtr += sizeof(StarsDatNode);
+    --nodesRemaining;
+
+    if (info.nStars > static_cast<std::size_t>(lastStar - firstStar))
+        return nullptr;
+
+    auto node = std::make_unique<StarOctree>(info.cellCenterPos, info.exclusionFactor, firstStar, info.nStars);
+    firstStar += info.nStars;
+
+    if (info.hasChildren)
+    {
+        auto children = std::make_unique<StarOctree*[]>(8);
+        for (int i = 0; i < 8; ++i)
+        {
+            children[i] = readOctreeNode(nodePtr, nodesRemaining, firstStar, lastStar, depth + 1);
+            if (children[i] == nullptr)
+            {
+                for (int j = 0; j < i; ++j)
+                    delete children[j];
+                return nullptr;
+            }
+        }
+
+        node->setChildren(children.release());
+    }
+
+    return node.release();
+}
+
+} // end unnamed namespace
+
+StarsDatNodeInfo
+unpackStarsDatNode(const char* ptr)
+{
+    auto x = readRecordField<float>(ptr, offsetof(StarsDatNode, x));
+    LE_TO_CPU_FLOAT(x, x);
+    auto y = readRecordField<float>(ptr, offsetof(StarsDatNode, y));
+    LE_TO_CPU_FLOAT(y, y);
+    auto z = readRecordField<float>(ptr, offsetof(StarsDatNode, z));
+    LE_TO_CPU_FLOAT(z, z);
+    auto exclusionFactor = readRecordField<float>(ptr, offsetof(StarsDatNode, exclusionFactor));
+    LE_TO_CPU_FLOAT(exclusionFactor, exclusionFactor);
+    auto nStars = readRecordField<std::uint32_t>(ptr, offsetof(StarsDatNode, nStars));
+    LE_TO_CPU_INT32(nStars, nStars);
+    auto hasChildren = readRecordField<std::uint8_t>(ptr, offsetof(StarsDatNode, hasChildren));
+
+    return { Eigen::Vector3f(x, y, z), exclusionFactor, nStars, hasChildren != 0 };
+}
+
+void
+unpackStarsDatRecordFields(const char* ptr, Star& star, std::uint16_t& spectralType)
+{
+    auto catNo = readRecordField<AstroCatalog::IndexNumber>(ptr, offsetof(StarsDatRecord, catNo));
+    LE_TO_CPU_INT32(catNo, catNo);
+    auto x = readRecordField<float>(ptr, offsetof(StarsDatRecord, x));
+    LE_TO_CPU_FLOAT(x, x);
+    auto y = readRecordField<float>(ptr, offsetof(StarsDatRecord, y));
+    LE_TO_CPU_FLOAT(y, y);
+    auto z = readRecordField<float>(ptr, offsetof(StarsDatRecord, z));
+    LE_TO_CPU_FLOAT(z, z);
+    auto absMag = readRecordField<std::int16_t>(ptr, offsetof(StarsDatRecord, absMag));
+    LE_TO_CPU_INT16(absMag, absMag);
+    spectralType = readRecordField<std::uint16_t>(ptr, offsetof(StarsDatRecord, spectralType));
+    LE_TO_CPU_INT16(spectralType, spectralType);
+
+    star.setPosition(x, y, z);
+    star.setAbsoluteMagnitude(static_cast<float>(absMag) / 256.0f);
+    star.setIndex(catNo);
+}
+
+bool
+unpackStarsDatRecord(const char* ptr, Star& star)
+{
+    std::uint16_t spectralType;
+    unpackStarsDatRecordFields(ptr, star, spectralType);
+
+    celutil::IntrusivePtr<StarDetails> details = nullptr;
+    StellarClass sc;
+    if (sc.unpackV1(spectralType))
+        details = StarDetails::GetStarDetails(sc);
+
+    if (details == nullptr)
+        return false;
+
+    star.setDetails(std::move(details));
+    return true;
+}
+
+bool
+writeStarsDatRecord(std::ostream& out, const Star& star)
+{
+    const Eigen::Vector3f& pos = star.getPosition();
+    auto absMag = static_cast<std::int16_t>(std::round(star.getAbsoluteMagnitude() * 256.0f));
+    std::uint16_t spectralType = StellarClass::parse(star.getSpectralType()).packV1();
+
+    return celutil::writeLE<AstroCatalog::IndexNumber>(out, star.getIndex())
+        && celutil::writeLE<float>(out, pos.x())
+        && celutil::writeLE<float>(out, pos.y())
+        && celutil::writeLE<float>(out, pos.z())
+        && celutil::writeLE<std::int16_t>(out, absMag)
+        && celutil::writeLE<std::uint16_t>(out, spectralType);
+}
+
+StarOctree*
+readStarsDatOctree(const char*& nodePtr,
+                   std::uint32_t& nodesRemaining,
+                   Star*& firstStar,
+                   const Star* lastStar)
+{
+    return readOctreeNode(nodePtr, nodesRemaining, firstStar, lastStar, 0);
+}
+
+bool
+writeStarsDatOctree(std::ostream& out, const StarOctree& node)
+{
+    const Eigen::Vector3f& center = node.getCellCenterPos();
+    bool hasChildren = node.getChild(0) != nullptr;
+    if (!(celutil::writeLE<float>(out, center.x())
+          && celutil::writeLE<float>(out, center.y())
+          && celutil::writeLE<float>(out, center.z())
+          && celutil::writeLE<float>(out, node.getExclusionFactor())
+          && celutil::writeLE<std::uint32_t>(out, node.getObjectCount())
+          && celutil::writeLE<std::uint8_t>(out, hasChildren ? 1 : 0)))
+    {
+        return false;
+    }
+
+    if (hasChildren)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            if (!writeStarsDatOctree(out, *node.getChild(i)))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+} // end namespace celestia::engine
@@ -0,0 +1,128 @@
+// starsdat.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Record layout of the binary star database files.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iosfwd>
+#include <string_view>
+#include <type_traits>
+
+#include <Eigen/Core>
+
+#include "astroobj.h"
+#include "staroctree.h"
+
+class Star;
+
+namespace celestia::engine
+{
+
+constexpr inline std::string_view STARSDAT_MAGIC = "CELSTARS";
+constexpr inline std::uint16_t SORTED_STARSDAT_VERSION = 0x0200;
+
+#pragma pack(push, 1)
+// stars.dat header structure
+struct StarsDatHeader
+{
+    StarsDatHeader() = delete;
+    char magic[8];
+    std::uint16_t version;
+    std::uint32_t counter;
+};
+
+static_assert(std::is_standard_layout_v<StarsDatHeader>);
+
+// stars.dat record structure
+struct StarsDatRecord
+{
+    StarsDatRecord() = delete;
+    AstroCatalog::IndexNumber catNo;
+    float x;
+    float y;
+    float z;
+    std::int16_t absMag;
+    std::uint16_t spectralType;
+};
+
+static_assert(std::is_standard_layout_v<StarsDatRecord>);
+
+// sorted stars.dat header structure; it is followed by the octree nodes,
+// the star records in octree order and the indices of the stars sorted by
+// catalog number.
+struct SortedStarsDatHeader
+{
+    SortedStarsDatHeader() = delete;
+    char magic[8];
+    std::uint16_t version;
+    std::uint32_t counter;
+    std::uint32_t nodeCount;
+};
+
+static_assert(std::is_standard_layout_v<SortedStarsDatHeader>);
+
+// sorted stars.dat octree node structure, stored in depth-first order with
+// each node followed by its eight children (if any). The stars of a node
+// thus directly precede those of its subtree.
+struct StarsDatNode
+{
+    StarsDatNode() = delete;
+    float x;
+    float y;
+    float z;
+    float exclusionFactor;
+    std::uint32_t nStars;
+    std::uint8_t hasChildren;
+};
+
+static_assert(std::is_standard_layout_v<StarsDatNode>);
+#pragma pack(pop)
+
+template<typename T>
+T
+readRecordField(const char* ptr, std::size_t offset)
+{
+    T value;
+    std::memcpy(&value, ptr + offset, sizeof(T));
+    return value;
+}
+
+struct StarsDatNodeInfo
+{
+    Eigen::Vector3f cellCenterPos;
+    float exclusionFactor;
+    std::uint32_t nStars;
+    bool hasChildren;
+};
+
+StarsDatNodeInfo unpackStarsDatNode(const char* ptr);
+
+// Returns false if the record has an invalid spectral type
+bool unpackStarsDatRecord(const char* ptr, Star& star);
+
+// Same as above, but leaves the star details unset and returns the packed
+// spectral type instead. Unlike unpackStarsDatRecord this doesn't touch the
+// shared StarDetails, so it may be called from several threads at once.
+void unpackStarsDatRecordFields(const char* ptr, Star& star, std::uint16_t& spectralType);
+bool writeStarsDatRecord(std::ostream& out, const Star& star);
+
+// Recreate an octree node and its descendants from their records starting
+// at nodePtr, assigning the stars following firstStar to them. Returns
+// nullptr if the records are inconsistent.
+StarOctree* readStarsDatOctree(const char*& nodePtr,
+                               std::uint32_t& nodesRemaining,
+                               Star*& firstStar,
+                               const Star* lastStar);
+bool writeStarsDatOctree(std::ostream& out, const StarOctree& node);
+
+} // end namespace celestia::engine
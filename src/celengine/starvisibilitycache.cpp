@@ -0,0 +1,214 @@
+// starvisibilitycache.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "starvisibilitycache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+#include <celutil/jobsystem.h>
+#include "astro.h"
+
+namespace
+{
+
+constexpr float SQRT3 = 1.732050807568877f;
+
+// Number of entries handed to a thread at once
+constexpr std::size_t EntryBatchSize = 16;
+
+enum class TestResult
+{
+    Fail,
+    Pass,
+    Uncertain,
+};
+
+// The exact tests only differ from those of the traversal in
+// StarOctree::processVisibleObjects in that they are made on nodes passed
+// in from outside.
+bool
+shouldDescend(const StarOctree& node, float minDistance, float limitingMag)
+{
+    return minDistance <= 0.0f || astro::absToAppMag(node.getExclusionFactor(), minDistance) <= limitingMag;
+}
+
+} // end unnamed namespace
+
+
+void
+StarVisibilityCache::processVisibleStars(const StarOctree& root,
+                                         const StarCullingData& cullingData,
+                                         celestia::util::array_view<StarHandler*> handlers,
+                                         const Eigen::Vector3f& obsPosition,
+                                         const Eigen::Quaternionf& obsOrientation,
+                                         const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                                         float fovY,
+                                         float aspectRatio,
+                                         float limitingMag)
+{
+    if (!isValid(root, obsPosition, obsOrientation, fovY, aspectRatio, limitingMag))
+    {
+        m_entries.clear();
+        m_position = obsPosition;
+        m_orientation = obsOrientation;
+        m_fovY = fovY;
+        m_aspectRatio = aspectRatio;
+        m_limitingMag = limitingMag;
+        m_root = &root;
+        classify(root, STAR_OCTREE_ROOT_SIZE, frustumPlanes, limitingMag);
+        m_valid = true;
+    }
+
+    // Retest the uncertain nodes, skipping the subtrees of those which fail
+    m_visible.clear();
+    auto nEntries = static_cast<std::uint32_t>(m_entries.size());
+    for (std::uint32_t i = 0; i < nEntries;)
+    {
+        const Entry& entry = m_entries[i];
+        if ((entry.flags & TestFrustum) != 0 &&
+            !starNodeInFrustum(entry.node->getCellCenterPos(), frustumPlanes, entry.scale))
+        {
+            i = entry.subtreeEnd;
+            continue;
+        }
+
+        m_visible.push_back(i);
+
+        if ((entry.flags & TestDescend) != 0)
+        {
+            float minDistance = (obsPosition - entry.node->getCellCenterPos()).norm() - entry.scale * SQRT3;
+            if (!shouldDescend(*entry.node, minDistance, limitingMag))
+            {
+                i = entry.subtreeEnd;
+                continue;
+            }
+        }
+
+        ++i;
+    }
+
+    std::atomic<std::size_t> nextBatch{ 0 };
+    auto process = [&](StarHandler* handler)
+    {
+        for (;;)
+        {
+            std::size_t first = nextBatch.fetch_add(EntryBatchSize, std::memory_order_relaxed);
+            if (first >= m_visible.size())
+                break;
+
+            std::size_t last = std::min(first + EntryBatchSize, m_visible.size());
+            for (std::size_t i = first; i < last; ++i)
+            {
+                const Entry& entry = m_entries[m_visible[i]];
+                const StarOctree& node = *entry.node;
+                if (node.getObjectCount() == 0)
+                    continue;
+
+                float minDistance = (obsPosition - node.getCellCenterPos()).norm() - entry.scale * SQRT3;
+                float dimmest = minDistance > 0.0f ? astro::appToAbsMag(limitingMag, minDistance) : 1000.0f;
+                processNodeStars(*handler,
+                                 cullingData,
+                                 node.getFirstObject(),
+                                 node.getObjectCount(),
+                                 obsPosition,
+                                 frustumPlanes[4],
+                                 limitingMag,
+                                 dimmest);
+            }
+        }
+    };
+
+    celestia::util::GetJobSystem()->parallelFor(0, handlers.size(), 1,
+                                                [&](std::size_t first, std::size_t last)
+                                                {
+                                                    for (std::size_t i = first; i < last; ++i)
+                                                        process(handlers[i]);
+                                                });
+}
+
+
+bool
+StarVisibilityCache::isValid(const StarOctree& root,
+                             const Eigen::Vector3f& obsPosition,
+                             const Eigen::Quaternionf& obsOrientation,
+                             float fovY,
+                             float aspectRatio,
+                             float limitingMag) const
+{
+    return m_valid &&
+           m_root == &root &&
+           m_fovY == fovY &&
+           m_aspectRatio == aspectRatio &&
+           m_limitingMag == limitingMag &&
+           (obsPosition - m_position).norm() <= MaxPositionChange &&
+           obsOrientation.angularDistance(m_orientation) <= MaxRotation;
+}
+
+
+void
+StarVisibilityCache::classify(const StarOctree& node,
+                              float scale,
+                              const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                              float limitingMag)
+{
+    const Eigen::Vector3f& center = node.getCellCenterPos();
+    Eigen::Vector3f offset = center - m_position;
+    float distance = offset.norm();
+
+    // A node is culled when it lies completely behind one of the frustum
+    // planes. Moving the observer by up to MaxPositionChange and rotating
+    // the view by up to MaxRotation shifts the planes relative to the
+    // points of the node by at most margin.
+    TestResult inFrustum = TestResult::Pass;
+    if ((offset.cwiseAbs().array() > scale - MaxPositionChange).any())
+    {
+        float margin = MaxPositionChange + MaxRotation * (distance + scale * SQRT3);
+        for (unsigned int i = 0; i < 5; ++i)
+        {
+            const Eigen::Hyperplane<float, 3>& plane = frustumPlanes[i];
+            float r = scale * plane.normal().cwiseAbs().sum();
+            float d = plane.signedDistance(center);
+            if (d < -r - margin)
+                return;
+            if (d < -r + margin)
+                inFrustum = TestResult::Uncertain;
+        }
+    }
+    // else the observer remains inside the node, which can't be culled
+
+    float minDistance = distance - scale * SQRT3;
+    TestResult descend;
+    if (shouldDescend(node, minDistance + MaxPositionChange, limitingMag))
+        descend = TestResult::Pass;
+    else if (!shouldDescend(node, minDistance - MaxPositionChange, limitingMag))
+        descend = TestResult::Fail;
+    else
+        descend = TestResult::Uncertain;
+
+    auto index = static_cast<std::uint32_t>(m_entries.size());
+    std::uint8_t flags = 0;
+    if (inFrustum == TestResult::Uncertain)
+        flags |= TestFrustum;
+    if (descend == TestResult::Uncertain)
+        flags |= TestDescend;
+    m_entries.push_back({ &node, scale, index + 1, flags });
+
+    if (descend != TestResult::Fail)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            if (const StarOctree* child = node.getChild(i); child != nullptr)
+                classify(*child, scale * 0.5f, frustumPlanes, limitingMag);
+        }
+    }
+
+    m_entries[index].subtreeEnd = static_cast<std::uint32_t>(m_entries.size());
+}
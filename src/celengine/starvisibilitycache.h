@@ -0,0 +1,92 @@
+// starvisibilitycache.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celutil/array_view.h>
+#include "staroctree.h"
+
+// Frame to frame cache of the star octree traversal for a nearly stationary
+// observer. The nodes are classified once against a frustum and a position
+// widened by the reuse tolerances: nodes which would be culled for any view
+// within the tolerances are left out, and only the nodes close to the
+// frustum or magnitude boundaries are retested in the following frames. The
+// stars themselves are always tested exactly, so the result is the same as
+// that of a full traversal.
+class StarVisibilityCache
+{
+ public:
+    // Maximum observer movement (in light years) and rotation (in radians)
+    // for which the cached nodes stay valid
+    static constexpr float MaxPositionChange = 1.0e-3f;
+    static constexpr float MaxRotation = 0.01f;
+
+    // Force the nodes to be classified again in the next frame
+    void invalidate() { m_valid = false; }
+
+    // Pass the visible stars to the handlers, as
+    // StarDatabase::findVisibleStars; the stars of the visible nodes are
+    // shared out between the handlers, which run on their own threads
+    // except for the first one.
+    void processVisibleStars(const StarOctree& root,
+                             const StarCullingData& cullingData,
+                             celestia::util::array_view<StarHandler*> handlers,
+                             const Eigen::Vector3f& obsPosition,
+                             const Eigen::Quaternionf& obsOrientation,
+                             const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                             float fovY,
+                             float aspectRatio,
+                             float limitingMag);
+
+ private:
+    enum : std::uint8_t
+    {
+        TestFrustum = 0x01,
+        TestDescend = 0x02,
+    };
+
+    // Nodes in depth first order; the descendants of entry i are the
+    // entries up to subtreeEnd.
+    struct Entry
+    {
+        const StarOctree* node;
+        float             scale;
+        std::uint32_t     subtreeEnd;
+        std::uint8_t      flags;
+    };
+
+    bool isValid(const StarOctree& root,
+                 const Eigen::Vector3f& obsPosition,
+                 const Eigen::Quaternionf& obsOrientation,
+                 float fovY,
+                 float aspectRatio,
+                 float limitingMag) const;
+    void classify(const StarOctree& node,
+                  float scale,
+                  const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                  float limitingMag);
+
+    std::vector<Entry> m_entries;
+    // Entries of the nodes to process in the current frame
+    std::vector<std::uint32_t> m_visible;
+
+    bool m_valid{ false };
+    const StarOctree* m_root{ nullptr };
+    Eigen::Vector3f m_position{ Eigen::Vector3f::Zero() };
+    Eigen::Quaternionf m_orientation{ Eigen::Quaternionf::Identity() };
+    float m_fovY{ 0.0f };
+    float m_aspectRatio{ 0.0f };
+    float m_limitingMag{ 0.0f };
+};
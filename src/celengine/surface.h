@@ -26,7 +26,9 @@ class Surface
         bumpTexture(),
         nightTexture(),
         overlayTexture(),
+        heightMap(),
         bumpHeight(0.0f),
+        heightScale(0.0f),
         lunarLambert(0.0f)
     {};
 
@@ -41,6 +43,7 @@ class Surface
         Emissive             = 0x80,
         SeparateSpecularMap  = 0x100,
         ApplyOverlay         = 0x200,
+        ApplyHeightMap       = 0x400,
     };
 
     uint32_t appearanceFlags;
@@ -52,7 +55,9 @@ class Surface
     MultiResTexture nightTexture;   // artificial lights to show on night side
     MultiResTexture specularTexture;// specular mask
     MultiResTexture overlayTexture; // overlay texture, applied last
+    MultiResTexture heightMap;      // elevation, displacing the surface
     float bumpHeight;               // scale of bump map relief
+    float heightScale;              // height in km of the highest height map value
     float lunarLambert;             // mix between Lambertian and Lommel-Seeliger (lunar-like) photometric functions
 };
 
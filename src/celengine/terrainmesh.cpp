@@ -0,0 +1,370 @@
+// terrainmesh.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team
+//
+// Chunked level of detail for planet surfaces displaced by height maps.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "terrainmesh.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#include <celcompat/numbers.h>
+#include <celengine/shadermanager.h>
+#include <celengine/texture.h>
+#include <celmath/frustum.h>
+#include <celmath/mathlib.h>
+
+namespace
+{
+
+constexpr int GridVertices = (TerrainMesh::GridSize + 1) * (TerrainMesh::GridSize + 1);
+constexpr int SkirtVertices = 4 * (TerrainMesh::GridSize + 1);
+static_assert(GridVertices + SkirtVertices < std::numeric_limits<unsigned short>::max());
+
+// Deepest level of the quadtree, whatever the height map resolution
+constexpr int MaxTerrainLevel = 24;
+
+// Chunks of the first levels are too large for their bounding spheres to
+// be worth testing against the frustum
+constexpr int MinCulledLevel = 2;
+
+// Same mapping from texture coordinates to the unit sphere as the one
+// of LODSphereMesh
+Eigen::Vector3f
+surfacePoint(float u, float v)
+{
+    float theta = (1.0f - u) * 2.0f * celestia::numbers::pi_v<float>;
+    float phi = (0.5f - v) * celestia::numbers::pi_v<float>;
+    float sphi, cphi, stheta, ctheta;
+    celmath::sincos(phi, sphi, cphi);
+    celmath::sincos(theta, stheta, ctheta);
+    return Eigen::Vector3f(cphi * ctheta, sphi, cphi * stheta);
+}
+
+// The angle between vertices of chunks at a level, which is the same
+// along both sides
+float
+vertexSpacing(int level)
+{
+    return celestia::numbers::pi_v<float> /
+           static_cast<float>((1 << level) * TerrainMesh::GridSize);
+}
+
+// Index of a grid vertex
+unsigned short
+gridIndex(int x, int y)
+{
+    return static_cast<unsigned short>(y * (TerrainMesh::GridSize + 1) + x);
+}
+
+void
+addSkirt(std::vector<unsigned short>& indices,
+         unsigned short a, unsigned short b,
+         unsigned short skirtA, unsigned short skirtB)
+{
+    // Skirts are seen from either side, depending on which of the
+    // neighbouring chunks is higher
+    indices.insert(indices.end(), { a, b, skirtA, b, skirtB, skirtA });
+    indices.insert(indices.end(), { a, skirtA, b, b, skirtA, skirtB });
+}
+
+} // end unnamed namespace
+
+
+TerrainMesh::~TerrainMesh()
+{
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+}
+
+
+bool
+TerrainMesh::canRender(Texture** tex, int nTextures)
+{
+    return std::all_of(tex, tex + nTextures,
+                       [](const Texture* t) { return t == nullptr ||
+                                                     (t->getLODCount() == 1 &&
+                                                      t->getUTileCount(0) == 1 &&
+                                                      t->getVTileCount(0) == 1); });
+}
+
+
+bool
+TerrainMesh::initBuffers()
+{
+    if (buffersInitialized)
+        return vertexBuffer != 0;
+    buffersInitialized = true;
+
+    // The grid coordinates of the vertices, with a third coordinate set to
+    // one for skirt vertices. Skirt vertices follow the grid ones, along
+    // the top, bottom, left and right edges.
+    std::vector<float> vertices;
+    vertices.reserve((GridVertices + SkirtVertices) * 3);
+    for (int y = 0; y <= GridSize; y++)
+    {
+        for (int x = 0; x <= GridSize; x++)
+            vertices.insert(vertices.end(), { static_cast<float>(x), static_cast<float>(y), 0.0f });
+    }
+
+    std::array<std::array<int, 2>, 4> edgeStart{ { { 0, 0 }, { 0, GridSize }, { 0, 0 }, { GridSize, 0 } } };
+    std::array<std::array<int, 2>, 4> edgeStep{ { { 1, 0 }, { 1, 0 }, { 0, 1 }, { 0, 1 } } };
+    for (int edge = 0; edge < 4; edge++)
+    {
+        for (int i = 0; i <= GridSize; i++)
+        {
+            vertices.insert(vertices.end(),
+                            { static_cast<float>(edgeStart[edge][0] + i * edgeStep[edge][0]),
+                              static_cast<float>(edgeStart[edge][1] + i * edgeStep[edge][1]),
+                              1.0f });
+        }
+    }
+
+    // Triangles are counterclockwise seen from outside the sphere, where x
+    // goes west and y goes south.
+    std::vector<unsigned short> indices;
+    indices.reserve(GridSize * GridSize * 6 + 4 * GridSize * 12);
+    for (int y = 0; y < GridSize; y++)
+    {
+        for (int x = 0; x < GridSize; x++)
+        {
+            indices.insert(indices.end(), { gridIndex(x, y), gridIndex(x, y + 1), gridIndex(x + 1, y) });
+            indices.insert(indices.end(), { gridIndex(x + 1, y + 1), gridIndex(x + 1, y), gridIndex(x, y + 1) });
+        }
+    }
+
+    for (int edge = 0; edge < 4; edge++)
+    {
+        int skirtBase = GridVertices + edge * (GridSize + 1);
+        for (int i = 0; i < GridSize; i++)
+        {
+            int x = edgeStart[edge][0] + i * edgeStep[edge][0];
+            int y = edgeStart[edge][1] + i * edgeStep[edge][1];
+            addSkirt(indices,
+                     gridIndex(x, y),
+                     gridIndex(x + edgeStep[edge][0], y + edgeStep[edge][1]),
+                     static_cast<unsigned short>(skirtBase + i),
+                     static_cast<unsigned short>(skirtBase + i + 1));
+        }
+    }
+    indexCount = static_cast<int>(indices.size());
+
+    while (glGetError() != GL_NO_ERROR);
+    glGenBuffers(1, &vertexBuffer);
+    glGenBuffers(1, &indexBuffer);
+    if (glGetError() != GL_NO_ERROR)
+    {
+        glDeleteBuffers(1, &vertexBuffer);
+        glDeleteBuffers(1, &indexBuffer);
+        vertexBuffer = indexBuffer = 0;
+        return false;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    return true;
+}
+
+
+void
+TerrainMesh::render(CelestiaGLProgram& prog,
+                    const celmath::Frustum& frustum,
+                    const Eigen::Vector3f& eyePos,
+                    float pixelSize,
+                    Texture* heightTex,
+                    float heightScale,
+                    unsigned int heightTexUnit,
+                    Texture** tex,
+                    int nTextures)
+{
+    if (!initBuffers())
+        return;
+
+    SelectionInfo si{ frustum, eyePos, heightScale, 0, 0, {} };
+
+    // Chunks of the coarsest levels are split until each one lies within
+    // a single tile of the height map.
+    while ((2 << si.minLevel) < heightTex->getUTileCount(0) ||
+           (1 << si.minLevel) < heightTex->getVTileCount(0))
+    {
+        si.minLevel++;
+    }
+
+    // There's no point in a vertex spacing finer than that of the texels of
+    // the most detailed level of the height map.
+    int heightTexWidth = heightTex->getWidth() << (heightTex->getLODCount() - 1);
+    while (si.maxLevel < MaxTerrainLevel && (2 << (si.maxLevel + 1)) * GridSize <= heightTexWidth)
+        si.maxLevel++;
+    si.maxLevel = std::max(si.maxLevel, si.minLevel);
+
+    // A chunk is split when it's closer than the distance at which its
+    // vertex spacing is pixelError pixels on screen.
+    si.ranges.resize(si.maxLevel + 1);
+    for (int level = 0; level <= si.maxLevel; level++)
+        si.ranges[level] = vertexSpacing(level) / (pixelSize * pixelError);
+
+    chunks.clear();
+    selectChunks(0, 0, 0, si);
+    selectChunks(0, 1, 0, si);
+    if (chunks.empty())
+        return;
+
+    for (int i = 0; i < nTextures; i++)
+    {
+        tex[i]->beginUsage();
+        glActiveTexture(GL_TEXTURE0 + i);
+        tex[i]->bind();
+    }
+    heightTex->beginUsage();
+    glActiveTexture(GL_TEXTURE0 + heightTexUnit);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+    glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
+                          3, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+    prog.heightScale = heightScale;
+    prog.gridSize = static_cast<float>(GridSize);
+
+    for (const Chunk& chunk : chunks)
+        renderChunk(prog, chunk, si, heightTex);
+
+    glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    heightTex->endUsage();
+    for (int i = 0; i < nTextures; i++)
+        tex[i]->endUsage();
+    glActiveTexture(GL_TEXTURE0);
+}
+
+
+void
+TerrainMesh::selectChunks(int level, int u, int v, const SelectionInfo& si)
+{
+    float du = 1.0f / static_cast<float>(2 << level);
+    float dv = 1.0f / static_cast<float>(1 << level);
+
+    // Bounding sphere of points of the chunk on the sphere and at the top
+    // of the relief
+    std::array<Eigen::Vector3f, 9> points;
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            points[i * 3 + j] = surfacePoint((static_cast<float>(u) + static_cast<float>(j) * 0.5f) * du,
+                                             (static_cast<float>(v) + static_cast<float>(i) * 0.5f) * dv);
+        }
+    }
+
+    Eigen::Vector3f center = Eigen::Vector3f::Zero();
+    for (const Eigen::Vector3f& p : points)
+        center += p;
+    center *= (1.0f + si.heightScale * 0.5f) / static_cast<float>(points.size());
+
+    float radius = 0.0f;
+    for (const Eigen::Vector3f& p : points)
+    {
+        radius = std::max({ radius,
+                            (p - center).norm(),
+                            (p * (1.0f + si.heightScale) - center).norm() });
+    }
+
+    if (level >= MinCulledLevel &&
+        si.frustum.testSphere(center, radius) == celmath::Frustum::Outside)
+    {
+        return;
+    }
+
+    float distance = std::max(0.0f, (si.eyePos - center).norm() - radius);
+    if (level < si.minLevel || (level < si.maxLevel && distance < si.ranges[level]))
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            for (int j = 0; j < 2; j++)
+                selectChunks(level + 1, u * 2 + j, v * 2 + i, si);
+        }
+        return;
+    }
+
+    chunks.push_back(Chunk{ level, u, v });
+}
+
+
+void
+TerrainMesh::renderChunk(CelestiaGLProgram& prog,
+                         const Chunk& chunk,
+                         const SelectionInfo& si,
+                         Texture* heightTex)
+{
+    int uChunks = 2 << chunk.level;
+    int vChunks = 1 << chunk.level;
+
+    // Use the most detailed level of the height map with at most one tile
+    // per chunk. Virtual textures load missing tiles in the background and
+    // return a part of a coarser tile until then.
+    int lod = 0;
+    while (lod + 1 < heightTex->getLODCount() &&
+           heightTex->getUTileCount(lod + 1) <= uChunks &&
+           heightTex->getVTileCount(lod + 1) <= vChunks)
+    {
+        lod++;
+    }
+
+    int chunksPerUTile = uChunks / heightTex->getUTileCount(lod);
+    int chunksPerVTile = vChunks / heightTex->getVTileCount(lod);
+    TextureTile tile = heightTex->getTile(lod, chunk.u / chunksPerUTile, chunk.v / chunksPerVTile);
+    glBindTexture(GL_TEXTURE_2D, tile.texID);
+
+    float tileDU = tile.du / static_cast<float>(chunksPerUTile);
+    float tileDV = tile.dv / static_cast<float>(chunksPerVTile);
+    prog.heightTexRect = Eigen::Vector4f(tile.u + static_cast<float>(chunk.u % chunksPerUTile) * tileDU,
+                                         tile.v + static_cast<float>(chunk.v % chunksPerVTile) * tileDV,
+                                         tileDU, tileDV);
+
+    // Sample the mipmap with about one texel per quad
+    float texelsPerQuad = static_cast<float>(heightTex->getWidth() << lod) /
+                          static_cast<float>(uChunks * GridSize);
+    prog.heightTexLOD = std::max(0.0f, std::log2(texelsPerQuad));
+
+    float du = 1.0f / static_cast<float>(uChunks);
+    float dv = 1.0f / static_cast<float>(vChunks);
+    prog.terrainBounds = Eigen::Vector4f(static_cast<float>(chunk.u) * du,
+                                         static_cast<float>(chunk.v) * dv,
+                                         du, dv);
+
+    // Morph to the parent grid over the last quarter of the parent range.
+    // Chunks of the levels which are always split have nothing to morph to.
+    if (chunk.level > si.minLevel)
+    {
+        float end = si.ranges[chunk.level - 1];
+        float start = end * 0.75f;
+        prog.morphStart = start;
+        prog.morphScale = 1.0f / (end - start);
+    }
+    else
+    {
+        prog.morphStart = std::numeric_limits<float>::max();
+        prog.morphScale = 0.0f;
+    }
+
+    float spacing = vertexSpacing(chunk.level);
+    prog.skirtDepth = std::min(si.heightScale, 2.0f * spacing);
+
+    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, nullptr);
+}
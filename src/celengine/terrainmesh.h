@@ -0,0 +1,104 @@
+// terrainmesh.h
+//
+// Copyright (C) 2023-present, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celengine/glsupport.h>
+
+class CelestiaGLProgram;
+class Texture;
+
+namespace celmath
+{
+class Frustum;
+}
+
+// Planet surfaces displaced by a height map, drawn as a quadtree of chunks
+// of the longitude/latitude grid. The chunks have the layout of virtual
+// texture tiles: two root chunks for the western and eastern hemispheres,
+// each split into four children at the next level. Chunks are refined
+// until their vertex spacing is small enough on screen, and morph to the
+// grid of their parent at the far end of their range so that neighbours
+// of different levels meet. Skirts along the chunk edges hide the
+// remaining cracks.
+class TerrainMesh
+{
+public:
+    // Number of quads along each side of a chunk
+    static constexpr int GridSize = 32;
+
+    TerrainMesh() = default;
+    ~TerrainMesh();
+
+    TerrainMesh(const TerrainMesh&) = delete;
+    TerrainMesh& operator=(const TerrainMesh&) = delete;
+    TerrainMesh(TerrainMesh&&) = delete;
+    TerrainMesh& operator=(TerrainMesh&&) = delete;
+
+    // Draw a unit sphere with a program built with the TerrainDisplacement
+    // shader property. eyePos and the frustum are in object space, and
+    // pixelSize is the size of a pixel in radians. The height map is bound
+    // to heightTexUnit, the textures to the units from zero.
+    void render(CelestiaGLProgram& prog,
+                const celmath::Frustum& frustum,
+                const Eigen::Vector3f& eyePos,
+                float pixelSize,
+                Texture* heightTex,
+                float heightScale,
+                unsigned int heightTexUnit,
+                Texture** tex,
+                int nTextures);
+
+    // Chunks are only textured with whole textures, not with tiles
+    static bool canRender(Texture** tex, int nTextures);
+
+    // Size in pixels which the vertex spacing of chunks is refined to
+    void setPixelError(float error) { pixelError = error; }
+    float getPixelError() const { return pixelError; }
+
+    int getChunkCount() const { return static_cast<int>(chunks.size()); }
+
+private:
+    struct Chunk
+    {
+        int level;
+        int u;
+        int v;
+    };
+
+    struct SelectionInfo
+    {
+        const celmath::Frustum& frustum;
+        Eigen::Vector3f eyePos;
+        float heightScale;
+        int minLevel;
+        int maxLevel;
+        std::vector<float> ranges;
+    };
+
+    void selectChunks(int level, int u, int v, const SelectionInfo&);
+    void renderChunk(CelestiaGLProgram& prog,
+                     const Chunk& chunk,
+                     const SelectionInfo&,
+                     Texture* heightTex);
+    bool initBuffers();
+
+    std::vector<Chunk> chunks;
+
+    float pixelError{ 4.0f };
+
+    bool buffersInitialized{ false };
+    GLuint vertexBuffer{ 0 };
+    GLuint indexBuffer{ 0 };
+    int indexCount{ 0 };
+};
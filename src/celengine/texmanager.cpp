@@ -11,15 +11,29 @@
 
 #include <array>
 #include <cstddef>
+#include <cstdint>
 #include <fstream>
+#include <functional>
+#include <string>
 #include <string_view>
+#include <system_error>
+#include <utility>
 
+#include <fmt/format.h>
+
+#include <celimage/dxtencode.h>
+#include <celimage/imageformats.h>
+#include <celutil/diskcache.h>
+#include <celutil/filetype.h>
 #include <celutil/fsutils.h>
 #include <celutil/logger.h>
+#include "glsupport.h"
 
 using namespace std::string_view_literals;
 using celestia::util::GetLogger;
 
+namespace gl = celestia::gl;
+
 namespace
 {
 
@@ -35,6 +49,7 @@ constexpr std::array extensions =
 #ifdef USE_LIBAVIF
     "avif"sv,
 #endif
+    "ktx2"sv,
     "png"sv,
     "jpg"sv,
     "jpeg"sv,
@@ -43,8 +58,154 @@ constexpr std::array extensions =
     "ctx"sv,
 };
 
+#ifndef PORTABLE_BUILD
+// The cache file name is derived from the source path, size and modification
+// time, so stale entries are never picked up after the source changes
+fs::path
+getCompressedCachePath(const fs::path& filename, bool mipmaps)
+{
+    static celestia::util::DiskCache cache(celestia::util::WriteableDataPath() / "cache" / "textures", 1);
+    return cache.getPath(filename, mipmaps ? "mipmaps" : "", ".dds");
+}
+#endif
+
+// Load an image, compressing it to DXT1/DXT5. The result is cached so the
+// encoding cost is only paid the first time a texture is used.
+std::unique_ptr<Image>
+loadCompressedImage(const fs::path& filename, bool mipmaps)
+{
+#ifndef PORTABLE_BUILD
+    fs::path cachePath = getCompressedCachePath(filename, mipmaps);
+    if (!cachePath.empty())
+    {
+        if (celestia::util::DiskCache::use(cachePath))
+        {
+            std::unique_ptr<Image> cached(LoadDDSImage(cachePath));
+            if (cached != nullptr && cached->isCompressed())
+                return cached;
+            std::error_code ec;
+            fs::remove(cachePath, ec);
+        }
+    }
+#endif
+
+    std::unique_ptr<Image> img = LoadImageFromFile(filename);
+    if (img == nullptr || img->isCompressed())
+        return img;
+
+    // Oversized images are split into tiles by the texture code, leave them
+    // uncompressed
+    if (img->getWidth() > gl::maxTextureSize || img->getHeight() > gl::maxTextureSize)
+        return img;
+
+    std::unique_ptr<Image> compressed = CompressImageDXT(*img, mipmaps);
+    if (compressed == nullptr)
+        return img;
+
+    GetLogger()->debug("Compressed texture {} to {}\n", filename,
+                       compressed->getFormat() == celestia::PixelFormat::DXT1 ? "DXT1" : "DXT5");
+
+#ifndef PORTABLE_BUILD
+    if (!cachePath.empty())
+    {
+        celestia::util::DiskCache::write(cachePath,
+                                         [&compressed](const fs::path& path) { return SaveDDSImage(path, *compressed); });
+    }
+#endif
+
+    return compressed;
+}
+
+// The resolved key of a texture with a packed alpha channel is the path
+// of the texture and that of the alpha image joined by a newline, which
+// isn't part of any file name found by resolve()
+constexpr auto PackedKeySeparator = '\n';
+
+std::pair<fs::path, fs::path>
+splitPackedKey(const fs::path& key)
+{
+    const auto& native = key.native();
+    auto pos = native.rfind(static_cast<fs::path::value_type>(PackedKeySeparator));
+    if (pos == fs::path::string_type::npos)
+        return { key, fs::path() };
+    return { fs::path(native.substr(0, pos)), fs::path(native.substr(pos + 1)) };
+}
+
+bool
+isGray(const Image& img)
+{
+    if (img.getFormat() == celestia::PixelFormat::LUMINANCE)
+        return true;
+    if (img.getFormat() != celestia::PixelFormat::RGB && img.getFormat() != celestia::PixelFormat::RGBA)
+        return false;
+
+    int components = img.getComponents();
+    const std::uint8_t* pixels = img.getPixels();
+    for (int y = 0; y < img.getHeight(); y++)
+    {
+        const std::uint8_t* row = pixels + static_cast<std::size_t>(y) * img.getPitch();
+        for (int x = 0; x < img.getWidth(); x++)
+        {
+            const std::uint8_t* pixel = row + x * components;
+            if (pixel[0] != pixel[1] || pixel[0] != pixel[2])
+                return false;
+        }
+    }
+    return true;
+}
+
+// A copy of the color image base with the gray image mask as its alpha
+// channel, or nullptr if they differ in size or format
+std::unique_ptr<Image>
+packAlpha(const Image& base, const Image& mask)
+{
+    using celestia::PixelFormat;
+
+    if (base.getWidth() != mask.getWidth() || base.getHeight() != mask.getHeight() ||
+        base.getMipLevelCount() != 1 || mask.getMipLevelCount() != 1 || !isGray(mask))
+    {
+        return nullptr;
+    }
+
+    PixelFormat format;
+    switch (base.getFormat())
+    {
+    case PixelFormat::RGB:
+    case PixelFormat::RGBA:
+        format = PixelFormat::RGBA;
+        break;
+    case PixelFormat::BGR:
+    case PixelFormat::BGRA:
+        format = PixelFormat::BGRA;
+        break;
+    default:
+        return nullptr;
+    }
+
+    auto packed = std::make_unique<Image>(format, base.getWidth(), base.getHeight());
+    int baseComponents = base.getComponents();
+    int maskComponents = mask.getComponents();
+    for (int y = 0; y < base.getHeight(); y++)
+    {
+        const std::uint8_t* baseRow = base.getPixels() + static_cast<std::size_t>(y) * base.getPitch();
+        const std::uint8_t* maskRow = mask.getPixels() + static_cast<std::size_t>(y) * mask.getPitch();
+        std::uint8_t* packedRow = packed->getPixelRow(y);
+        for (int x = 0; x < base.getWidth(); x++)
+        {
+            packedRow[x * 4]     = baseRow[x * baseComponents];
+            packedRow[x * 4 + 1] = baseRow[x * baseComponents + 1];
+            packedRow[x * 4 + 2] = baseRow[x * baseComponents + 2];
+            packedRow[x * 4 + 3] = maskRow[x * maskComponents];
+        }
+    }
+
+    return packed;
+}
+
 } // end unnamed namespace
 
+bool TextureInfo::compressAll = false;
+
 TextureManager*
 GetTextureManager()
 {
@@ -56,6 +217,29 @@ GetTextureManager()
 
 fs::path
 TextureInfo::resolve(const fs::path& baseDir) const
+{
+    if (alphaSource.empty())
+        return resolveFile(baseDir);
+
+    // Virtual textures and those compressed at load time are left unpacked;
+    // they share the resolved key of the plain texture
+    fs::path filename = resolveFile(baseDir);
+    if (shouldCompress() || DetermineFileType(filename) == ContentType::CelestiaTexture)
+        return filename;
+
+    TextureInfo alphaInfo(alphaSource, path, flags, resolution);
+    fs::path alphaFilename = alphaInfo.resolveFile(baseDir);
+    if (DetermineFileType(alphaFilename) == ContentType::CelestiaTexture)
+        return filename;
+
+    filename += PackedKeySeparator;
+    filename += alphaFilename;
+    return filename;
+}
+
+
+fs::path
+TextureInfo::resolveFile(const fs::path& baseDir) const
 {
     bool wildcard = source.extension() == ".*";
 
@@ -89,22 +273,112 @@ TextureInfo::resolve(const fs::path& baseDir) const
 }
 
 
+Texture::AddressMode
+TextureInfo::getAddressMode() const
+{
+    if (flags & WrapTexture)
+        return Texture::Wrap;
+    if (flags & BorderClamp)
+        return Texture::BorderClamp;
+    return Texture::EdgeClamp;
+}
+
+
+Texture::MipMapMode
+TextureInfo::getMipMapMode() const
+{
+    return (flags & NoMipMaps) ? Texture::NoMipMaps : Texture::DefaultMipMaps;
+}
+
+
+void
+TextureInfo::setCompressAll(bool compress)
+{
+    compressAll = compress;
+}
+
+
+bool
+TextureInfo::shouldCompress() const
+{
+    // Normal maps lose too much precision in DXT1/DXT5
+    return bumpHeight == 0.0f
+        && (compressAll || (flags & CompressTexture) != 0)
+        && gl::EXT_texture_compression_s3tc;
+}
+
+
+std::unique_ptr<Image>
+TextureInfo::loadImage(const fs::path& name) const
+{
+    if (bumpHeight != 0.0f)
+    {
+        GetLogger()->debug("Decoding bump map: {}\n", name);
+        return LoadNormalMapImageFromFile(name, bumpHeight, getAddressMode());
+    }
+
+    GetLogger()->debug("Decoding texture: {}\n", name);
+    if (shouldCompress())
+        return loadCompressedImage(name, getMipMapMode() != Texture::NoMipMaps);
+    return LoadImageFromFile(name);
+}
+
+
+// Load the image file and pack the alpha image into it; packed is set if
+// they could be combined
+std::unique_ptr<Image>
+TextureInfo::loadPackedImage(const fs::path& name, const fs::path& alphaName, bool& packed) const
+{
+    GetLogger()->debug("Decoding texture: {} with alpha {}\n", name, alphaName);
+    packed = false;
+    std::unique_ptr<Image> img = LoadImageFromFile(name);
+    if (img == nullptr || img->isCompressed())
+        return img;
+
+    std::unique_ptr<Image> alphaImg = LoadImageFromFile(alphaName);
+    if (alphaImg == nullptr || alphaImg->isCompressed())
+        return img;
+
+    std::unique_ptr<Image> packedImg = packAlpha(*img, *alphaImg);
+    if (packedImg == nullptr)
+    {
+        GetLogger()->debug("Can't pack {} into the alpha channel of {}\n", alphaName, name);
+        return img;
+    }
+
+    packed = true;
+    return packedImg;
+}
+
+
 std::unique_ptr<Texture>
 TextureInfo::load(const fs::path& name) const
 {
-    Texture::AddressMode addressMode = Texture::EdgeClamp;
-    Texture::MipMapMode mipMode = Texture::DefaultMipMaps;
-
-    if (flags & WrapTexture)
-        addressMode = Texture::Wrap;
-    else if (flags & BorderClamp)
-        addressMode = Texture::BorderClamp;
+    Texture::AddressMode addressMode = getAddressMode();
+    Texture::MipMapMode mipMode = getMipMapMode();
 
-    if (flags & NoMipMaps)
-        mipMode = Texture::NoMipMaps;
+    if (auto [filename, alphaName] = splitPackedKey(name); !alphaName.empty())
+    {
+        bool packed;
+        std::unique_ptr<Image> img = loadPackedImage(filename, alphaName, packed);
+        if (img == nullptr)
+            return nullptr;
+        std::unique_ptr<Texture> tex = CreateTextureFromFileImage(*img, filename, addressMode, mipMode);
+        if (tex != nullptr && packed)
+            tex->setFormatOptions(Texture::PackedAlpha);
+        return tex;
+    }
 
     if (bumpHeight == 0.0f)
     {
+        if (shouldCompress() && DetermineFileType(name) != ContentType::CelestiaTexture)
+        {
+            std::unique_ptr<Image> img = loadImage(name);
+            if (img == nullptr)
+                return nullptr;
+            return CreateTextureFromFileImage(std::move(img), name, addressMode, mipMode);
+        }
+
         GetLogger()->debug("Loading texture: {}\n", name);
         return LoadTextureFromFile(name, addressMode, mipMode);
     }
@@ -112,3 +386,40 @@ TextureInfo::load(const fs::path& name) const
     GetLogger()->debug("Loading bump map: {}\n", name);
     return LoadHeightMapFromFile(name, bumpHeight, addressMode);
 }
+
+
+std::function<std::unique_ptr<Texture>()>
+TextureInfo::decode(const fs::path& name) const
+{
+    // Virtual textures load their tiles on demand anyway
+    if (DetermineFileType(name) == ContentType::CelestiaTexture)
+        return [info = *this, name]() { return info.load(name); };
+
+    Texture::AddressMode addressMode = getAddressMode();
+
+    if (auto [filename, alphaName] = splitPackedKey(name); !alphaName.empty())
+    {
+        bool packed;
+        std::shared_ptr<Image> img = loadPackedImage(filename, alphaName, packed);
+        if (img == nullptr)
+            return {};
+        return [img, filename = filename, packed, addressMode, mipMode = getMipMapMode()]()
+        {
+            std::unique_ptr<Texture> tex = CreateTextureFromFileImage(*img, filename, addressMode, mipMode);
+            if (tex != nullptr && packed)
+                tex->setFormatOptions(Texture::PackedAlpha);
+            return tex;
+        };
+    }
+
+    std::shared_ptr<Image> img = loadImage(name);
+    if (img == nullptr)
+        return {};
+
+    // Normal maps are always mipmapped, as in LoadHeightMapFromFile
+    Texture::MipMapMode mipMode = bumpHeight == 0.0f ? getMipMapMode() : Texture::DefaultMipMaps;
+    return [img, name, addressMode, mipMode]()
+    {
+        return CreateTextureFromFileImage(img, name, addressMode, mipMode);
+    };
+}
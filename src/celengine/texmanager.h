@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <tuple>
 
@@ -22,6 +23,8 @@ class TextureInfo
  private:
     fs::path source;
     fs::path path;
+    // Image whose brightness is packed into the alpha channel of the texture
+    fs::path alphaSource;
     unsigned int flags;
     float bumpHeight;
     unsigned int resolution;
@@ -71,14 +74,41 @@ class TextureInfo
         bumpHeight(0.0f),
         resolution(_resolution) {};
 
+    const fs::path& getSource() const { return source; }
+
+    // Pack the grayscale image found like the texture into its alpha
+    // channel, so that one texture is bound in place of two. If the images
+    // can't be combined, the texture is loaded as usual and doesn't have
+    // the Texture::PackedAlpha format option.
+    void setAlphaSource(const fs::path& _alphaSource) { alphaSource = _alphaSource; }
+
     fs::path resolve(const fs::path&) const;
     std::unique_ptr<Texture> load(const fs::path&) const;
+    // For asynchronous loading: reads the image, leaving the creation of
+    // the texture to the returned function
+    std::function<std::unique_ptr<Texture>()> decode(const fs::path&) const;
+
+    unsigned int getResolution() const { return resolution; }
+
+    // Compress all color textures to DXT1/DXT5 at load time rather than only
+    // those flagged with CompressTexture
+    static void setCompressAll(bool);
+
+ private:
+    fs::path resolveFile(const fs::path&) const;
+    Texture::AddressMode getAddressMode() const;
+    Texture::MipMapMode getMipMapMode() const;
+    std::unique_ptr<Image> loadImage(const fs::path&) const;
+    bool shouldCompress() const;
+    std::unique_ptr<Image> loadPackedImage(const fs::path&, const fs::path&, bool&) const;
+
+    static bool compressAll;
 };
 
 inline bool operator<(const TextureInfo& ti0, const TextureInfo& ti1)
 {
-    return std::tie(ti0.resolution, ti0.source, ti0.path) <
-           std::tie(ti1.resolution, ti1.source, ti1.path);
+    return std::tie(ti0.resolution, ti0.source, ti0.path, ti0.alphaSource) <
+           std::tie(ti1.resolution, ti1.source, ti1.path, ti1.alphaSource);
 }
 
 using TextureManager = ResourceManager<TextureInfo>;
@@ -7,6 +7,8 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <deque>
+#include <unordered_map>
 #include <vector>
 
 #ifdef USE_ICU
@@ -21,6 +23,29 @@
 namespace celestia::engine
 {
 
+namespace
+{
+
+#ifdef USE_ICU
+// The bidirectional reordering and shaping take several conversions and
+// allocations, so the text shaped for the labels and the overlay, most of
+// which doesn't change between frames, is kept
+constexpr std::size_t MaxShapedStrings = 1024;
+
+struct ShapedStringCache
+{
+    // The map refers to the strings kept here, so that it's searched by a
+    // string_view without making a string
+    std::deque<std::string> keys;
+    std::unordered_map<std::string_view, TextLayout::ShapedText> entries;
+};
+
+// One for each thread rendering text, each of which has its own fonts
+thread_local ShapedStringCache shapedStrings;
+#endif
+
+} // end unnamed namespace
+
 TextLayout::TextLayout(int screenDpi, HorizontalAlignment halign) : screenDpi(static_cast<float>(screenDpi)), horizontalAlignment(halign)
 {
 }
@@ -130,29 +155,43 @@ void TextLayout::render(std::string_view text)
     if (!began)
         return;
 
-    std::vector<std::wstring> lines;
-    if (!processString(text, lines) || lines.empty())
-        return;
+#ifdef USE_ICU
+    if (const ShapedText *shaped = findShaped(text); shaped != nullptr)
+        renderLines(shaped->lines.data(), shaped->lines.size());
+#else
+    // Decoding is cheap, so the lines are decoded again into the buffers
+    // of the last text, which are reused without allocating
+    std::size_t count = 0;
+    if (processString(text, lineBuffer, count))
+        renderLines(lineBuffer.data(), count);
+#endif
+}
+
+void TextLayout::render(const ShapedText &text)
+{
+    if (began)
+        renderLines(text.lines.data(), text.lines.size());
+}
 
-    for (size_t i = 0; i < lines.size(); i += 1)
+void TextLayout::renderLines(const std::wstring *lines, std::size_t count)
+{
+    for (size_t i = 0; i < count; i += 1)
     {
-        auto lineToRender = lines[i];
+        const std::wstring &line = lines[i];
         if (i == 0)
         {
             // Combine the current line with the first line
             if (layoutDirectionFollowTextAlignment && horizontalAlignment == HorizontalAlignment::Right)
-            {
-                lineToRender += currentLine;
-            }
+                currentLine.insert(0, line);
             else
+                currentLine.append(line);
+
+            // If this line is still continuing, do not render yet
+            if (count != 1)
             {
-                lineToRender = currentLine + lineToRender;
-            }
-            if (lines.size() == 1)
-            {
-                // This line is still continuing, clear line and do not render yet
-                currentLine = lineToRender;
-                lineToRender = L"";
+                if (!currentLine.empty())
+                    renderLine(currentLine);
+                currentLine.clear();
             }
         }
         else
@@ -160,18 +199,34 @@ void TextLayout::render(std::string_view text)
             // Reset to line start, and go to the next line
             positionX = alignmentEdgeX;
             positionY -= static_cast<float>(font->getHeight());
-            if (i == lines.size() - 1)
+            if (i == count - 1)
+            {
+                // Last line (and size != 1), do not render
+                currentLine.assign(line);
+            }
+            else if (!line.empty())
             {
-                // Last line (and size != 1), clear line do not render
-                currentLine = lines[i];
-                lineToRender = L"";
+                renderLine(line);
             }
         }
-        if (!lineToRender.empty())
-            renderLine(lineToRender);
     }
 }
 
+void TextLayout::setColor(const Color &color)
+{
+    if (!began)
+        return;
+
+    // The text of the current line takes the color when it's rendered
+    flushInternal(false);
+    font->setColor(color);
+}
+
+void TextLayout::finishLine()
+{
+    flushInternal(false);
+}
+
 void TextLayout::flush()
 {
     flushInternal(true);
@@ -200,16 +255,34 @@ int TextLayout::getLineHeight() const
 
 int TextLayout::getTextWidth(std::string_view text, const TextureFont *font)
 {
-    std::vector<std::wstring> lines;
-    if (font == nullptr || !processString(text, lines))
+    if (font == nullptr)
+        return 0;
+
+#ifdef USE_ICU
+    const ShapedText *shaped = findShaped(text);
+    if (shaped == nullptr)
+        return 0;
+    const std::vector<std::wstring> &lines = shaped->lines;
+    std::size_t count = lines.size();
+#else
+    thread_local std::vector<std::wstring> lines;
+    std::size_t count = 0;
+    if (!processString(text, lines, count))
         return 0;
+#endif
 
     int maxLineWidth = 0;
-    for (const auto& line : lines)
-        maxLineWidth = std::max(maxLineWidth, font->getWidth(line));
+    for (std::size_t i = 0; i < count; i++)
+        maxLineWidth = std::max(maxLineWidth, font->getWidth(lines[i]));
     return maxLineWidth;
 }
 
+bool TextLayout::shape(std::string_view text, ShapedText &shaped)
+{
+    shaped.lines.clear();
+    return processString(text, shaped.lines);
+}
+
 float TextLayout::getPixelSize(float size, Unit unit) const
 {
     if (unit == Unit::DP)
@@ -258,6 +331,73 @@ void TextLayout::flushInternal(bool flushFont)
         font->flush();
 }
 
+/// The shaped text from the cache, shaping it if it isn't there; nullptr
+/// if the text isn't valid
+const TextLayout::ShapedText *TextLayout::findShaped([[maybe_unused]] std::string_view text)
+{
+#ifdef USE_ICU
+    ShapedStringCache &cache = shapedStrings;
+    if (auto it = cache.entries.find(text); it != cache.entries.end())
+        return &it->second;
+
+    ShapedText shaped;
+    if (!processString(text, shaped.lines))
+        return nullptr;
+
+    if (cache.entries.size() >= MaxShapedStrings)
+    {
+        cache.entries.clear();
+        cache.keys.clear();
+    }
+    const std::string &key = cache.keys.emplace_back(text);
+    return &cache.entries.emplace(key, std::move(shaped)).first->second;
+#else
+    return nullptr;
+#endif
+}
+
+#ifndef USE_ICU
+/// Split the text into the first count lines of output, reusing the
+/// memory of the strings already there
+bool TextLayout::processString(std::string_view input, std::vector<std::wstring> &output, std::size_t &count)
+{
+    auto nextLine = [&output, &count]() -> std::wstring&
+    {
+        if (count == output.size())
+            output.emplace_back();
+        std::wstring &line = output[count++];
+        line.clear();
+        return line;
+    };
+
+    count = 0;
+    auto len = static_cast<int>(input.length());
+    int i = 0;
+    std::wstring *line = nullptr;
+    while (i < len)
+    {
+        wchar_t ch = 0;
+        if (!UTF8Decode(input, i, ch))
+            return false;
+        i += UTF8EncodedSize(ch);
+
+        if (ch == L'\n')
+        {
+            if (line == nullptr)
+                nextLine();
+            // The line after the break, empty unless more text follows
+            line = &nextLine();
+            continue;
+        }
+
+        if (line == nullptr)
+            line = &nextLine();
+        line->push_back(ch);
+    }
+    return true;
+}
+#endif
+
 bool TextLayout::processString(std::string_view input, std::vector<std::wstring> &output)
 {
 #ifdef USE_ICU
@@ -286,38 +426,12 @@ bool TextLayout::processString(std::string_view input, std::vector<std::wstring>
             return false;
         output.push_back(line);
     }
+    return true;
 #else
-    // Loop through all characters
-    auto len                = input.length();
-    bool validChar          = true;
-    int  i                  = 0;
-    bool endsWithLineBreak  = false;
-
-    std::wstring currentLine;
-    while (i < len && validChar)
-    {
-        wchar_t ch = 0;
-        validChar  = UTF8Decode(input, i, ch);
-        if (!validChar)
-            return false;
-        i += UTF8EncodedSize(ch);
-
-        if (ch == L'\n')
-        {
-            output.push_back(currentLine);
-            currentLine.clear();
-            endsWithLineBreak = true;
-            continue;
-        }
-
-        currentLine.push_back(ch);
-        endsWithLineBreak = false;
-    }
-
-    if (!currentLine.empty() || endsWithLineBreak)
-        output.push_back(currentLine);
+    output.clear();
+    std::size_t count = 0;
+    return processString(input, output, count);
 #endif
-    return true;
 }
 
 }
@@ -9,9 +9,15 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 #include <celttf/truetypefont.h>
 
+class Color;
+
 namespace celestia::engine
 {
 /**
@@ -46,6 +52,14 @@ class TextLayout
         DP, // density independeny pixel, scaled according to screenDpi
     };
 
+    /// Text split into lines of characters ready for the font, after the
+    /// bidirectional reordering and shaping, for text which is kept and
+    /// rendered in many frames
+    struct ShapedText
+    {
+        std::vector<std::wstring> lines;
+    };
+
     explicit TextLayout(int screenDpi = 96, HorizontalAlignment halign = HorizontalAlignment::Left);
 
     TextLayout(const TextLayout&) = delete;
@@ -88,6 +102,19 @@ class TextLayout
     /// @param text the text to render
     void render(std::string_view text);
 
+    /// Render text shaped by shape, must be called after begin
+    /// @param text the shaped text to render
+    void render(const ShapedText &text);
+
+    /// Set the color of the text rendered next, stored with the text so that
+    /// text of different colors is drawn at once, must be called after begin
+    /// @param color the color of the text
+    void setColor(const Color &color);
+
+    /// Render the rest of the current line, so that the text rendered next
+    /// starts a new one even at the same position, must be called after begin
+    void finishLine();
+
     /// This ensures all the text is submitted and rendered, must be called after begin
     void flush();
 
@@ -103,6 +130,12 @@ class TextLayout
     /// @return the max width of all the lines in the text in the desired font
     static int getTextWidth(std::string_view text, const TextureFont *font);
 
+    /// Split UTF-8 text into lines and convert them for rendering
+    /// @param text the text to shape
+    /// @param shaped the shaped text
+    /// @return false if the text isn't valid UTF-8
+    static bool shape(std::string_view text, ShapedText &shaped);
+
  private:
     float screenDpi;
     std::shared_ptr<TextureFont> font;
@@ -114,6 +147,8 @@ class TextLayout
     float alignmentEdgeX{ 0.0f };
 
     std::wstring currentLine;
+    // Lines of the text rendered last, whose memory is reused by the next
+    std::vector<std::wstring> lineBuffer;
     Eigen::Matrix4f modelview{ Eigen::Matrix4f::Identity() };
     Eigen::Matrix4f projection{ Eigen::Matrix4f::Identity() };
 
@@ -122,9 +157,12 @@ class TextLayout
 
     float getPixelSize(float size, Unit unit) const;
 
+    void renderLines(const std::wstring *lines, std::size_t count);
     void renderLine(std::wstring_view line);
     void flushInternal(bool flushFont);
 
+    static const ShapedText *findShaped(std::string_view text);
+    static bool processString(std::string_view input, std::vector<std::wstring> &output, std::size_t &count);
     static bool processString(std::string_view input, std::vector<std::wstring> &output);
 };
 
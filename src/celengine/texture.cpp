@@ -10,12 +10,14 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <chrono>
 #include <cstdlib>
 #include <cmath>
 
 #include <Eigen/Core>
 #include "glsupport.h"
 
+#include <celrender/texturememory.h>
 #include <celutil/filetype.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
@@ -28,6 +30,7 @@ using namespace celestia;
 using namespace Eigen;
 using namespace std;
 using celestia::util::GetLogger;
+using celestia::render::TextureMemoryCategory;
 
 struct TextureCaps
 {
@@ -155,6 +158,43 @@ static int getCompressedBlockSize(PixelFormat format)
 }
 
 
+static std::size_t getBytesPerPixel(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::RGBA:
+    case PixelFormat::BGRA:
+        return 4;
+    case PixelFormat::RGB:
+    case PixelFormat::BGR:
+        return 3;
+    case PixelFormat::LUM_ALPHA:
+        return 2;
+    default:
+        return 1;
+    }
+}
+
+
+// The memory taken by the levels of the image which are uploaded, and by
+// the mipmaps generated from its base level
+static std::size_t GetImageMemorySize(const Image& img, bool mipmap, bool precomputedMipMaps)
+{
+    std::size_t size = img.getMipLevelSize(0);
+    if (precomputedMipMaps)
+    {
+        for (int mip = 1; mip < img.getMipLevelCount(); mip++)
+            size += img.getMipLevelSize(mip);
+    }
+    else if (mipmap)
+    {
+        size += size / 3;
+    }
+
+    return size;
+}
+
+
 static GLenum GetGLTexAddressMode(Texture::AddressMode addressMode)
 {
     switch (addressMode)
@@ -189,42 +229,64 @@ static void SetBorderColor(Color borderColor, GLenum target)
 }
 
 
-// Load a prebuilt set of mipmaps; assumes that the image contains
-// a complete set of mipmap levels.
-static void LoadMipmapSet(const Image& img, GLenum target)
+static void LoadMipLevel(const Image& img, GLenum target, int mip)
 {
     int internalFormat = getInternalFormat(img.getFormat());
+    unsigned int mipWidth  = max((unsigned int) img.getWidth() >> mip, 1u);
+    unsigned int mipHeight = max((unsigned int) img.getHeight() >> mip, 1u);
+
+    if (img.isCompressed())
+    {
+        glCompressedTexImage2D(target,
+                               mip,
+                               internalFormat,
+                               mipWidth, mipHeight,
+                               0,
+                               img.getMipLevelSize(mip),
+                               img.getMipLevel(mip));
+    }
+    else
+    {
+        glTexImage2D(target,
+                     mip,
+                     internalFormat,
+                     mipWidth, mipHeight,
+                     0,
+                     (GLenum) img.getFormat(),
+                     GL_UNSIGNED_BYTE,
+                     img.getMipLevel(mip));
+    }
+}
+
+
+// Load a prebuilt set of mipmaps; assumes that the image contains
+// a complete set of mipmap levels. Only the levels from firstLevel down
+// are loaded, and sampled until the finer ones are.
+static void LoadMipmapSet(const Image& img, GLenum target, int firstLevel = 0)
+{
 #ifndef GL_ES
     glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, img.getMipLevelCount()-1);
 #endif
+    if (firstLevel > 0)
+        glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, firstLevel);
 
-    for (int mip = 0; mip < img.getMipLevelCount(); mip++)
-    {
-        unsigned int mipWidth  = max((unsigned int) img.getWidth() >> mip, 1u);
-        unsigned int mipHeight = max((unsigned int) img.getHeight() >> mip, 1u);
+    for (int mip = firstLevel; mip < img.getMipLevelCount(); mip++)
+        LoadMipLevel(img, target, mip);
+}
 
-        if (img.isCompressed())
-        {
-            glCompressedTexImage2D(target,
-                                   mip,
-                                   internalFormat,
-                                   mipWidth, mipHeight,
-                                   0,
-                                   img.getMipLevelSize(mip),
-                                   img.getMipLevel(mip));
-        }
-        else
-        {
-            glTexImage2D(target,
-                         mip,
-                         internalFormat,
-                         mipWidth, mipHeight,
-                         0,
-                         (GLenum) img.getFormat(),
-                         GL_UNSIGNED_BYTE,
-                         img.getMipLevel(mip));
-        }
-    }
+
+// Textures larger than this are uploaded a mip level at a time, finest
+// last, starting with the first level of at most this size
+constexpr int ProgressiveUploadSize = 512;
+
+// Whether the mip levels sampled can be clamped with GL_TEXTURE_BASE_LEVEL
+static bool CanClampBaseLevel()
+{
+#ifdef GL_ES
+    return gl::checkVersion(gl::GLES_3);
+#else
+    return true;
+#endif
 }
 
 
@@ -285,6 +347,12 @@ Texture::Texture(int w, int h, int d) :
 }
 
 
+Texture::~Texture()
+{
+    celestia::render::removeTextureMemory(TextureMemoryCategory::Textures, memorySize);
+}
+
+
 int Texture::getLODCount() const
 {
     return 1;
@@ -344,11 +412,47 @@ void Texture::setFormatOptions(unsigned int opts)
 }
 
 
+void Texture::setMemorySize(std::size_t size)
+{
+    celestia::render::removeTextureMemory(TextureMemoryCategory::Textures, memorySize);
+    memorySize = size;
+    celestia::render::addTextureMemory(TextureMemoryCategory::Textures, memorySize);
+}
+
+
+std::vector<ImageTexture*> ImageTexture::pending;
+bool ImageTexture::forceSynchronous = false;
+
+
 ImageTexture::ImageTexture(const Image& img,
                            AddressMode addressMode,
                            MipMapMode mipMapMode) :
     Texture(img.getWidth(), img.getHeight()),
     glName(0)
+{
+    create(img, addressMode, mipMapMode, false);
+}
+
+
+ImageTexture::ImageTexture(std::shared_ptr<const Image> img,
+                           AddressMode addressMode,
+                           MipMapMode mipMapMode) :
+    Texture(img->getWidth(), img->getHeight()),
+    glName(0)
+{
+    create(*img, addressMode, mipMapMode, !forceSynchronous);
+    if (baseLevel > 0)
+    {
+        pendingImage = std::move(img);
+        pending.push_back(this);
+    }
+}
+
+
+void ImageTexture::create(const Image& img,
+                          AddressMode addressMode,
+                          MipMapMode mipMapMode,
+                          bool progressive)
 {
     glGenTextures(1, (GLuint*) &glName);
     glBindTexture(GL_TEXTURE_2D, glName);
@@ -393,7 +497,16 @@ ImageTexture::ImageTexture(const Image& img,
     {
         if (precomputedMipMaps)
         {
-            LoadMipmapSet(img, GL_TEXTURE_2D);
+            if (progressive && CanClampBaseLevel())
+            {
+                int size = max(img.getWidth(), img.getHeight());
+                while (size > ProgressiveUploadSize)
+                {
+                    size >>= 1;
+                    baseLevel++;
+                }
+            }
+            LoadMipmapSet(img, GL_TEXTURE_2D, baseLevel);
         }
         else if (mipMapMode == DefaultMipMaps)
         {
@@ -416,16 +529,64 @@ ImageTexture::ImageTexture(const Image& img,
 
     alpha = img.hasAlpha();
     compressed = img.isCompressed();
+    setMemorySize(GetImageMemorySize(img, mipmap, precomputedMipMaps));
 }
 
 
 ImageTexture::~ImageTexture()
 {
+    if (pendingImage != nullptr)
+        pending.erase(std::find(pending.begin(), pending.end(), this));
     if (glName != 0)
         glDeleteTextures(1, (const GLuint*) &glName);
 }
 
 
+void ImageTexture::uploadNextLevel()
+{
+    baseLevel--;
+    glBindTexture(GL_TEXTURE_2D, glName);
+    LoadMipLevel(*pendingImage, GL_TEXTURE_2D, baseLevel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, baseLevel);
+    if (baseLevel == 0)
+        pendingImage = nullptr;
+}
+
+
+bool ImageTexture::uploadPendingLevels(std::chrono::steady_clock::duration budget)
+{
+    auto startTime = std::chrono::steady_clock::now();
+    bool uploaded = false;
+
+    // The coarsest pending level of all textures goes first, so that each
+    // gets sharper at the same pace
+    while (!pending.empty())
+    {
+        if (uploaded && !forceSynchronous && std::chrono::steady_clock::now() - startTime > budget)
+            break;
+
+        auto next = std::max_element(pending.begin(), pending.end(),
+                                     [](const ImageTexture* t0, const ImageTexture* t1)
+                                     { return t0->baseLevel < t1->baseLevel; });
+        ImageTexture* texture = *next;
+        texture->uploadNextLevel();
+        if (texture->pendingImage == nullptr)
+            pending.erase(next);
+        uploaded = true;
+    }
+
+    return uploaded;
+}
+
+
+void ImageTexture::setForceSynchronous(bool force)
+{
+    forceSynchronous = force;
+    if (force)
+        uploadPendingLevels(std::chrono::steady_clock::duration::zero());
+}
+
+
 void ImageTexture::bind()
 {
     glBindTexture(GL_TEXTURE_2D, glName);
@@ -615,6 +776,7 @@ TiledTexture::TiledTexture(const Image& img,
         }
     }
 
+    setMemorySize(static_cast<std::size_t>(uSplit * vSplit) * GetImageMemorySize(*tile, mipmap, precomputedMipMaps));
     delete tile;
 }
 
@@ -739,6 +901,8 @@ CubeMap::CubeMap(celestia::util::array_view<const Image*> faces) :
     if (genMipmaps && FramebufferObject::isSupported())
         glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
     DumpTextureMipmapInfo(GL_TEXTURE_CUBE_MAP_POSITIVE_X);
+
+    setMemorySize(6 * GetImageMemorySize(*faces[0], mipmap, precomputedMipMaps));
 }
 
 
@@ -764,6 +928,116 @@ const TextureTile CubeMap::getTile(int lod, int u, int v)
 }
 
 
+TextureAtlas::TextureAtlas(PixelFormat _format, int _slotSize, int _slotsPerSide) :
+    format(_format),
+    slotSize(_slotSize),
+    slotsPerSide(_slotsPerSide),
+    used(static_cast<std::size_t>(_slotsPerSide * _slotsPerSide), false)
+{
+    glGenTextures(1, (GLuint*) &glName);
+    glBindTexture(GL_TEXTURE_2D, glName);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+#ifndef GL_ES
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+#endif
+
+    if (gl::EXT_texture_filter_anisotropic && texCaps.preferredAnisotropy > 1)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, texCaps.preferredAnisotropy);
+    }
+
+    int size = slotSize * slotsPerSide;
+    int internalFormat = getInternalFormat(format);
+    if (format == PixelFormat::DXT1 || format == PixelFormat::DXT3 || format == PixelFormat::DXT5)
+    {
+        memorySize = static_cast<std::size_t>((size / 4) * (size / 4) * getCompressedBlockSize(format));
+        glCompressedTexImage2D(GL_TEXTURE_2D, 0, internalFormat,
+                               size, size, 0,
+                               static_cast<GLsizei>(memorySize),
+                               nullptr);
+    }
+    else
+    {
+        memorySize = static_cast<std::size_t>(size) * static_cast<std::size_t>(size) * getBytesPerPixel(format);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat,
+                     size, size, 0,
+                     (GLenum) format, GL_UNSIGNED_BYTE,
+                     nullptr);
+    }
+    celestia::render::addTextureMemory(TextureMemoryCategory::Textures, memorySize);
+}
+
+
+TextureAtlas::~TextureAtlas()
+{
+    if (glName != 0)
+        glDeleteTextures(1, (const GLuint*) &glName);
+    celestia::render::removeTextureMemory(TextureMemoryCategory::Textures, memorySize);
+}
+
+
+bool TextureAtlas::accepts(const Image& img) const
+{
+    return img.getFormat() == format &&
+           img.getWidth() == slotSize &&
+           img.getHeight() == slotSize;
+}
+
+
+int TextureAtlas::add(const Image& img)
+{
+    if (isFull() || !accepts(img))
+        return -1;
+
+    auto slot = static_cast<int>(std::find(used.begin(), used.end(), false) - used.begin());
+    used[slot] = true;
+    ++nUsed;
+
+    int x = (slot % slotsPerSide) * slotSize;
+    int y = (slot / slotsPerSide) * slotSize;
+    glBindTexture(GL_TEXTURE_2D, glName);
+    if (img.isCompressed())
+    {
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, x, y, slotSize, slotSize,
+                                  getInternalFormat(format),
+                                  img.getMipLevelSize(0),
+                                  img.getMipLevel(0));
+    }
+    else
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, slotSize, slotSize,
+                        (GLenum) format, GL_UNSIGNED_BYTE,
+                        img.getMipLevel(0));
+    }
+
+    return slot;
+}
+
+
+void TextureAtlas::remove(int slot)
+{
+    if (slot < 0 || slot >= static_cast<int>(used.size()) || !used[slot])
+        return;
+
+    used[slot] = false;
+    --nUsed;
+}
+
+
+TextureTile TextureAtlas::getTile(int slot) const
+{
+    auto size = static_cast<float>(slotSize * slotsPerSide);
+    float u = (static_cast<float>((slot % slotsPerSide) * slotSize) + 0.5f) / size;
+    float v = (static_cast<float>((slot / slotsPerSide) * slotSize) + 0.5f) / size;
+    float d = (static_cast<float>(slotSize) - 1.0f) / size;
+    return TextureTile(glName, u, v, d, d);
+}
+
+
 void CubeMap::setBorderColor(Color borderColor)
 {
     bind();
@@ -887,10 +1161,12 @@ CreateProceduralCubeMap(int size,
 }
 
 
+// The image is kept by progressively uploaded textures if source is set
 static std::unique_ptr<Texture>
 CreateTextureFromImage(const Image& img,
                        Texture::AddressMode addressMode,
-                       Texture::MipMapMode mipMode)
+                       Texture::MipMapMode mipMode,
+                       const std::shared_ptr<const Image>& source = nullptr)
 {
     std::unique_ptr<Texture> tex = nullptr;
 
@@ -908,7 +1184,10 @@ CreateTextureFromImage(const Image& img,
     {
         GetLogger()->info(_("Creating ordinary texture: {}x{}\n"),
                           img.getWidth(), img.getHeight());
-        tex = std::make_unique<ImageTexture>(img, addressMode, mipMode);
+        if (source != nullptr)
+            tex = std::make_unique<ImageTexture>(source, addressMode, mipMode);
+        else
+            tex = std::make_unique<ImageTexture>(img, addressMode, mipMode);
     }
 
     return tex;
@@ -928,19 +1207,30 @@ LoadTextureFromFile(const fs::path& filename,
 
     // All other texture types are handled by first loading an image, then
     // creating a texture from that image.
-    std::unique_ptr<Image> img = LoadImageFromFile(filename);
+    std::shared_ptr<const Image> img = LoadImageFromFile(filename);
     if (img == nullptr)
         return nullptr;
 
-    std::unique_ptr<Texture> tex = CreateTextureFromImage(*img, addressMode, mipMode);
+    return CreateTextureFromFileImage(std::move(img), filename, addressMode, mipMode);
+}
+
+
+static std::unique_ptr<Texture>
+CreateTextureFromFileImage(const Image& img,
+                           const fs::path& filename,
+                           Texture::AddressMode addressMode,
+                           Texture::MipMapMode mipMode,
+                           const std::shared_ptr<const Image>& source)
+{
+    std::unique_ptr<Texture> tex = CreateTextureFromImage(img, addressMode, mipMode, source);
 
-    if (contentType == ContentType::DXT5NormalMap)
+    if (tex != nullptr && DetermineFileType(filename) == ContentType::DXT5NormalMap)
     {
         // If the texture came from a .dxt5nm file then mark it as a dxt5
         // compressed normal map. There's no separate OpenGL format for dxt5
         // normal maps, so the file extension is the only thing that
         // distinguishes it from a plain old dxt5 texture.
-        if (img->getFormat() == PixelFormat::DXT5)
+        if (img.getFormat() == PixelFormat::DXT5)
         {
             tex->setFormatOptions(Texture::DXT5NormalMap);
         }
@@ -950,20 +1240,53 @@ LoadTextureFromFile(const fs::path& filename,
 }
 
 
+std::unique_ptr<Texture>
+CreateTextureFromFileImage(const Image& img,
+                           const fs::path& filename,
+                           Texture::AddressMode addressMode,
+                           Texture::MipMapMode mipMode)
+{
+    return CreateTextureFromFileImage(img, filename, addressMode, mipMode, nullptr);
+}
+
+
+std::unique_ptr<Texture>
+CreateTextureFromFileImage(std::shared_ptr<const Image> img,
+                           const fs::path& filename,
+                           Texture::AddressMode addressMode,
+                           Texture::MipMapMode mipMode)
+{
+    const Image& image = *img;
+    return CreateTextureFromFileImage(image, filename, addressMode, mipMode, img);
+}
+
+
 // Load a height map texture from a file and convert it to a normal map.
 std::unique_ptr<Texture>
 LoadHeightMapFromFile(const fs::path& filename,
                       float height,
                       Texture::AddressMode addressMode)
 {
-    std::unique_ptr<Image> img = LoadImageFromFile(filename);
-    if (img == nullptr)
-        return nullptr;
-    std::unique_ptr<Image> normalMap = img->computeNormalMap(height,
-                                                             addressMode == Texture::Wrap);
+    std::unique_ptr<Image> normalMap = LoadNormalMapImageFromFile(filename, height, addressMode);
     if (normalMap == nullptr)
         return nullptr;
 
     return CreateTextureFromImage(*normalMap, addressMode,
                                   Texture::DefaultMipMaps);
 }
+
+
+std::unique_ptr<Image>
+LoadNormalMapImageFromFile(const fs::path& filename,
+                           float height,
+                           Texture::AddressMode addressMode)
+{
+    std::unique_ptr<Image> img = LoadImageFromFile(filename);
+    if (img == nullptr)
+        return nullptr;
+
+    // Build the mipmaps along with the normals rather than leaving them to
+    // the driver. Tiled textures don't take uncompressed mipmaps.
+    bool mipMaps = img->getWidth() <= gl::maxTextureSize && img->getHeight() <= gl::maxTextureSize;
+    return img->computeNormalMap(height, addressMode == Texture::Wrap, mipMaps);
+}
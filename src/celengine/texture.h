@@ -9,9 +9,12 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <celutil/color.h>
 #include <celcompat/filesystem.h>
@@ -50,7 +53,7 @@ class Texture
 {
  public:
     Texture(int w, int h, int d = 1);
-    virtual ~Texture() = default;
+    virtual ~Texture();
 
     virtual const TextureTile getTile(int lod, int u, int v) = 0;
     virtual void bind() = 0;
@@ -72,9 +75,13 @@ class Texture
     int getHeight() const;
     int getDepth() const;
 
-    bool hasAlpha() const { return alpha; }
+    // Packed alpha channels are masks, not opacities
+    bool hasAlpha() const { return alpha && (formatOptions & PackedAlpha) == 0; }
     bool isCompressed() const { return compressed; }
 
+    // The estimated GPU memory taken by the texture, in bytes
+    std::size_t getMemorySize() const { return memorySize; }
+
     /*! Identical formats may need to be treated in slightly different
      *  fashions. One (and currently the only) example is the DXT5 compressed
      *  normal map format, which is an ordinary DXT5 texture but requires some
@@ -100,10 +107,16 @@ class Texture
 
     // Format option flags
     enum {
-        DXT5NormalMap = 1
+        DXT5NormalMap = 1,
+        // The alpha channel holds the specular mask of the base texture,
+        // read from a separate image when it was loaded
+        PackedAlpha   = 2,
     };
 
  protected:
+    // Account for the GPU memory taken by the texture
+    void setMemorySize(std::size_t);
+
     bool alpha{ false };
     bool compressed{ false };
 
@@ -113,6 +126,7 @@ class Texture
     int depth;
 
     unsigned int formatOptions{ 0 };
+    std::size_t memorySize{ 0 };
 };
 
 
@@ -120,6 +134,10 @@ class ImageTexture : public Texture
 {
  public:
     ImageTexture(const Image& img, AddressMode, MipMapMode);
+    // Large images with a complete set of mipmaps are first uploaded from
+    // a coarse level down, with the finer levels following in
+    // uploadPendingLevels(); the image is kept until then.
+    ImageTexture(std::shared_ptr<const Image> img, AddressMode, MipMapMode);
     ~ImageTexture();
 
     virtual const TextureTile getTile(int lod, int u, int v);
@@ -128,8 +146,24 @@ class ImageTexture : public Texture
 
     unsigned int getName() const;
 
+    // Upload the next finer mip level of the textures not complete yet,
+    // until the time spent exceeds budget; at least one level is uploaded
+    // if any is pending. Returns true if any level was uploaded.
+    static bool uploadPendingLevels(std::chrono::steady_clock::duration budget);
+    // Upload all mip levels at once, as while recording a movie
+    static void setForceSynchronous(bool force);
+
  private:
+    void create(const Image& img, AddressMode, MipMapMode, bool progressive);
+    void uploadNextLevel();
+
     unsigned int glName;
+    // The image of the mip levels not uploaded yet, finer than baseLevel
+    std::shared_ptr<const Image> pendingImage;
+    int baseLevel{ 0 };
+
+    static std::vector<ImageTexture*> pending;
+    static bool forceSynchronous;
 };
 
 
@@ -168,6 +202,44 @@ class CubeMap : public Texture
 };
 
 
+// A texture divided into a grid of square slots, each holding one image of
+// the slot size, without mipmaps. The images of an atlas can be drawn
+// without binding another texture.
+class TextureAtlas
+{
+ public:
+    TextureAtlas(celestia::PixelFormat format, int slotSize, int slotsPerSide);
+    ~TextureAtlas();
+
+    TextureAtlas(const TextureAtlas&) = delete;
+    TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+    // Whether the image has the format and size of the slots
+    bool accepts(const Image& img) const;
+
+    // Copy the image to a free slot and return its number, or -1 if the
+    // atlas is full or doesn't accept the image
+    int add(const Image& img);
+    void remove(int slot);
+
+    bool isEmpty() const { return nUsed == 0; }
+    bool isFull() const { return nUsed == static_cast<int>(used.size()); }
+
+    // The area of the slot, inset by half a texel so that filtering
+    // doesn't blend in the neighboring slots
+    TextureTile getTile(int slot) const;
+
+ private:
+    unsigned int glName{ 0 };
+    celestia::PixelFormat format;
+    int slotSize;
+    int slotsPerSide;
+    std::vector<bool> used;
+    int nUsed{ 0 };
+    std::size_t memorySize{ 0 };
+};
+
+
 std::unique_ptr<Texture>
 CreateProceduralTexture(int width, int height,
                         celestia::PixelFormat format,
@@ -195,3 +267,25 @@ std::unique_ptr<Texture>
 LoadHeightMapFromFile(const fs::path& filename,
                       float height,
                       Texture::AddressMode addressMode = Texture::EdgeClamp);
+
+// LoadTextureFromFile and LoadHeightMapFromFile in two steps: the image is
+// read (and converted to a normal map) first, which doesn't need the GL
+// context and may be done on another thread, then the texture is created.
+// Not for virtual textures.
+std::unique_ptr<Texture>
+CreateTextureFromFileImage(const Image& img,
+                           const fs::path& filename,
+                           Texture::AddressMode addressMode = Texture::EdgeClamp,
+                           Texture::MipMapMode mipMode = Texture::DefaultMipMaps);
+// As above, with the finer mip levels of large images uploaded
+// progressively by ImageTexture::uploadPendingLevels()
+std::unique_ptr<Texture>
+CreateTextureFromFileImage(std::shared_ptr<const Image> img,
+                           const fs::path& filename,
+                           Texture::AddressMode addressMode = Texture::EdgeClamp,
+                           Texture::MipMapMode mipMode = Texture::DefaultMipMaps);
+
+std::unique_ptr<Image>
+LoadNormalMapImageFromFile(const fs::path& filename,
+                           float height,
+                           Texture::AddressMode addressMode = Texture::EdgeClamp);
@@ -0,0 +1,245 @@
+// tilecache.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "tilecache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#ifdef USE_CURL
+#include <curl/curl.h>
+#endif
+
+#include <celutil/logger.h>
+
+using celestia::util::GetLogger;
+
+namespace
+{
+// When over the maximum size, delete files down to this fraction of it, so
+// that it isn't exceeded again by the very next tile
+constexpr double TrimTarget = 0.9;
+
+// Suffix of the files being downloaded, which are renamed once complete
+constexpr char PartialSuffix[] = ".part";
+
+#ifdef USE_CURL
+constexpr long DownloadTimeout = 60L;
+
+std::size_t
+writeData(char* data, std::size_t size, std::size_t count, void* userData)
+{
+    auto* out = static_cast<std::ofstream*>(userData);
+    out->write(data, static_cast<std::streamsize>(size * count));
+    return out->good() ? size * count : 0;
+}
+
+bool
+downloadWithCurl(const std::string& url, const fs::path& path)
+{
+    std::ofstream out(path, std::ios::out | std::ios::binary);
+    if (!out.good())
+    {
+        GetLogger()->error("Can't write tile cache file {}\n", path);
+        return false;
+    }
+
+    CURL* curl = curl_easy_init();
+    if (curl == nullptr)
+        return false;
+
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeData);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &out);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, DownloadTimeout);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, "Celestia");
+
+    CURLcode result = curl_easy_perform(curl);
+    curl_easy_cleanup(curl);
+    if (result != CURLE_OK)
+    {
+        GetLogger()->warn("Failed to download tile {}: {}\n", url, curl_easy_strerror(result));
+        return false;
+    }
+
+    out.close();
+    return out.good();
+}
+#else
+bool
+downloadUnsupported(const std::string& url, const fs::path&)
+{
+    static std::atomic<bool> warned{ false };
+    if (!warned.exchange(true))
+        GetLogger()->warn("Celestia was built without libcurl, can't download tile {}\n", url);
+    return false;
+}
+#endif
+
+bool
+isCacheFile(const fs::directory_entry& entry)
+{
+    std::error_code ec;
+    return entry.is_regular_file(ec) && entry.path().extension() != PartialSuffix;
+}
+} // end unnamed namespace
+
+
+TileCache::TileCache(const fs::path& _directory, std::uintmax_t _maxSize, Downloader _downloader) :
+    directory(_directory),
+    maxSize(_maxSize),
+    downloader(std::move(_downloader))
+{
+#ifdef USE_CURL
+    // Reference counted by libcurl, so balanced by the destructor
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+#endif
+    if (!downloader)
+    {
+#ifdef USE_CURL
+        downloader = downloadWithCurl;
+#else
+        downloader = downloadUnsupported;
+#endif
+    }
+
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+    for (const auto& entry : fs::directory_iterator(directory, ec))
+    {
+        if (isCacheFile(entry))
+            size += entry.file_size(ec);
+        else if (entry.path().extension() == PartialSuffix)
+            fs::remove(entry.path(), ec);
+    }
+
+    std::scoped_lock lock(mutex);
+    if (size > maxSize)
+        trim();
+}
+
+
+TileCache::~TileCache()
+{
+#ifdef USE_CURL
+    curl_global_cleanup();
+#endif
+}
+
+
+fs::path TileCache::fetch(const std::string& url, const fs::path& extension)
+{
+    fs::path path = directory / cacheFileName(url, extension);
+    std::error_code ec;
+
+    std::unique_lock lock(mutex);
+    bool waited = pending.count(url) != 0;
+    downloadFinished.wait(lock, [this, &url]() { return pending.count(url) == 0; });
+    if (fs::exists(path, ec))
+    {
+        // Files fetched lately are the last to be trimmed
+        fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+        return path;
+    }
+
+    // The download waited for failed; don't try again at once
+    if (waited)
+        return fs::path();
+
+    pending.insert(url);
+    lock.unlock();
+
+    fs::path partialPath = path;
+    partialPath += PartialSuffix;
+    bool downloaded = downloader(url, partialPath);
+    std::uintmax_t fileSize = 0;
+    if (downloaded)
+    {
+        fs::rename(partialPath, path, ec);
+        downloaded = !ec;
+        if (downloaded)
+            fileSize = fs::file_size(path, ec);
+    }
+    if (!downloaded)
+        fs::remove(partialPath, ec);
+
+    lock.lock();
+    pending.erase(url);
+    size += fileSize;
+    if (size > maxSize)
+        trim();
+    lock.unlock();
+    downloadFinished.notify_all();
+
+    return downloaded ? path : fs::path();
+}
+
+
+std::uintmax_t TileCache::getSize() const
+{
+    std::scoped_lock lock(mutex);
+    return size;
+}
+
+
+// Delete the files fetched least recently; called with the mutex locked
+void TileCache::trim()
+{
+    struct CacheFile
+    {
+        fs::path path;
+        fs::file_time_type lastFetched;
+        std::uintmax_t size;
+    };
+
+    std::vector<CacheFile> files;
+    std::error_code ec;
+    size = 0;
+    for (const auto& entry : fs::directory_iterator(directory, ec))
+    {
+        if (!isCacheFile(entry))
+            continue;
+        CacheFile& file = files.emplace_back();
+        file.path = entry.path();
+        file.lastFetched = entry.last_write_time(ec);
+        file.size = entry.file_size(ec);
+        size += file.size;
+    }
+
+    std::sort(files.begin(), files.end(),
+              [](const CacheFile& f0, const CacheFile& f1) { return f0.lastFetched < f1.lastFetched; });
+
+    auto target = static_cast<std::uintmax_t>(static_cast<double>(maxSize) * TrimTarget);
+    for (const CacheFile& file : files)
+    {
+        if (size <= target)
+            break;
+        if (fs::remove(file.path, ec))
+            size -= file.size;
+    }
+}
+
+
+// The hash of the URL is short and safe in file names
+fs::path TileCache::cacheFileName(const std::string& url, const fs::path& extension)
+{
+    auto hash = std::hash<std::string>()(url);
+    fs::path name = fmt::format("{:016x}", static_cast<std::uint64_t>(hash));
+    name += extension;
+    return name;
+}
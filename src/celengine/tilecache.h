@@ -0,0 +1,63 @@
+// tilecache.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include <celcompat/filesystem.h>
+
+// Copies of the tiles of remote virtual textures on disk. Tiles are
+// downloaded when first fetched and kept in the cache directory under a
+// hash of their URL; once the files take more than the maximum size, those
+// fetched least recently are deleted. Fetches of a URL already being
+// downloaded, from other loader threads, wait for that download rather
+// than starting their own.
+class TileCache
+{
+ public:
+    // Write the resource at the URL to the file, returning whether it
+    // succeeded
+    using Downloader = std::function<bool(const std::string&, const fs::path&)>;
+
+    // Without a downloader, tiles are downloaded with libcurl when Celestia
+    // is built with it
+    TileCache(const fs::path& directory, std::uintmax_t maxSize, Downloader downloader = {});
+    ~TileCache();
+
+    TileCache(const TileCache&) = delete;
+    TileCache& operator=(const TileCache&) = delete;
+
+    // Path of the file in the cache holding the resource at the URL,
+    // downloading it if needed; empty if the download failed. The
+    // extension is that of the file type of the resource.
+    fs::path fetch(const std::string& url, const fs::path& extension);
+
+    std::uintmax_t getSize() const;
+
+    static fs::path cacheFileName(const std::string& url, const fs::path& extension);
+
+ private:
+    void trim();
+
+    fs::path directory;
+    std::uintmax_t maxSize;
+    Downloader downloader;
+
+    mutable std::mutex mutex;
+    std::condition_variable downloadFinished;
+    // URLs being downloaded
+    std::set<std::string> pending;
+    std::uintmax_t size{ 0 };
+};
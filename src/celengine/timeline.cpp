@@ -10,6 +10,8 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+
 #include "celengine/timeline.h"
 #include "celengine/timelinephase.h"
 #include "celengine/frametree.h"
@@ -45,6 +47,7 @@ Timeline::appendPhase(TimelinePhase::SharedConstPtr &phase)
     }
 
     phases.push_back(phase);
+    endTimes.push_back(phase->endTime());
 
     return true;
 }
@@ -54,23 +57,41 @@ const TimelinePhase::SharedConstPtr&
 Timeline::findPhase(double t) const
 {
     // Find the phase containing time t. The overwhelming common case is
-    // nPhases = 1, so we special case that. Otherwise, we do a simple linear search,
-    // as the number of phases in a timeline should always be quite small.
+    // nPhases = 1, so we special case that. Mission timelines may have
+    // hundreds of phases, so otherwise we try the phase found last and the
+    // one after it, as the time usually changes little between lookups,
+    // and then search the end times.
     if (phases.size() == 1)
     {
         return phases[0];
     }
-    else
+
+    // Phase i contains the times from the end of phase i - 1 to its own end;
+    // the first phase also contains the times before it, and the last phase
+    // those after it.
+    auto contains = [this, t](std::size_t i)
     {
-        for (const auto& phase : phases)
+        return (i == 0 || t >= endTimes[i - 1]) && (i + 1 == endTimes.size() || t < endTimes[i]);
+    };
+
+    std::size_t last = lastPhase.load(std::memory_order_relaxed);
+    if (last < phases.size())
+    {
+        if (contains(last))
+            return phases[last];
+        if (last + 1 < phases.size() && contains(last + 1))
         {
-            if (t < phase->endTime())
-                return phase;
+            lastPhase.store(last + 1, std::memory_order_relaxed);
+            return phases[last + 1];
         }
-
-        // Time is greater than the end time of the final phase. Just return the final phase.
-        return phases.back();
     }
+
+    // The first phase ending after t; if there is none, t is greater than
+    // the end time of the final phase, so just return the final phase.
+    auto it = std::upper_bound(endTimes.begin(), endTimes.end() - 1, t);
+    auto index = static_cast<std::size_t>(it - endTimes.begin());
+    lastPhase.store(index, std::memory_order_relaxed);
+    return phases[index];
 }
 
 
@@ -123,11 +144,11 @@ Timeline::markChanged()
 {
     if (phases.size() == 1)
     {
-        phases[0]->getFrameTree()->markChanged();
+        phases[0]->getFrameTree()->markChanged(*phases[0]);
     }
     else
     {
         for (const auto &phase : phases)
-            phase->getFrameTree()->markChanged();
+            phase->getFrameTree()->markChanged(*phase);
     }
 }
@@ -13,6 +13,8 @@
 #ifndef _CELENGINE_TIMELINE_H_
 #define _CELENGINE_TIMELINE_H_
 
+#include <atomic>
+#include <cstddef>
 #include <memory>
 #include <vector>
 #include "timelinephase.h"
@@ -36,6 +38,10 @@ public:
 
 private:
     std::vector<TimelinePhase::SharedConstPtr> phases;
+    // End times of the phases, searched by findPhase()
+    std::vector<double> endTimes;
+    // The phase last found, which is usually the one wanted next
+    mutable std::atomic<std::size_t> lastPhase{ 0 };
 };
 
 #endif // _CELENGINE_TIMELINE_H_
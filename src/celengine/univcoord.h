@@ -14,8 +14,11 @@
 
 #pragma once
 
+#include <cstddef>
+
 #include <Eigen/Core>
 
+#include <celutil/array_view.h>
 #include <celutil/r128.h>
 #include <celutil/r128util.h>
 
@@ -33,12 +36,14 @@ class UniversalCoord
     }
 
     UniversalCoord(double _x, double _y, double _z) :
-        x(_x), y(_y), z(_z)
+        x(celestia::util::fixedFromDouble(_x)),
+        y(celestia::util::fixedFromDouble(_y)),
+        z(celestia::util::fixedFromDouble(_z))
     {
     }
 
     explicit UniversalCoord(const Eigen::Vector3d& v) :
-        x(v.x()), y(v.y()), z(v.z())
+        UniversalCoord(v.x(), v.y(), v.z())
     {
     }
 
@@ -72,9 +77,20 @@ class UniversalCoord
       */
     Eigen::Vector3d offsetFromKm(const UniversalCoord& uc) const
     {
-        return Eigen::Vector3d(static_cast<double>(x - uc.x),
-                               static_cast<double>(y - uc.y),
-                               static_cast<double>(z - uc.z)) * astro::microLightYearsToKilometers(1.0);
+        return offsetFromUly(uc) * astro::microLightYearsToKilometers(1.0);
+    }
+
+    /** Compute the offsets in kilometers of several coordinates from the same
+      * origin, as offsetFromKm() does; offsets must have room for all of them.
+      */
+    static void offsetsFromKm(const UniversalCoord& origin,
+                              celestia::util::array_view<UniversalCoord> coords,
+                              Eigen::Vector3d* offsets)
+    {
+        const double scale = astro::microLightYearsToKilometers(1.0);
+        const UniversalCoord* uc = coords.data();
+        for (std::size_t i = 0, n = coords.size(); i < n; ++i)
+            offsets[i] = uc[i].offsetFromUly(origin) * scale;
     }
 
     /** Get the offset in light years of this coordinate from a point (also with
@@ -84,9 +100,11 @@ class UniversalCoord
     Eigen::Vector3f offsetFromLy(const Eigen::Vector3f& v) const
     {
         Eigen::Vector3f vUly = v * 1.0e6f;
-        Eigen::Vector3f offsetUly(static_cast<float>(static_cast<double>(x - R128(vUly.x()))),
-                                  static_cast<float>(static_cast<double>(y - R128(vUly.y()))),
-                                  static_cast<float>(static_cast<double>(z - R128(vUly.z()))));
+        using celestia::util::fixedDifferenceToDouble;
+        using celestia::util::fixedFromDouble;
+        Eigen::Vector3f offsetUly(static_cast<float>(fixedDifferenceToDouble(x, fixedFromDouble(vUly.x()))),
+                                  static_cast<float>(fixedDifferenceToDouble(y, fixedFromDouble(vUly.y()))),
+                                  static_cast<float>(fixedDifferenceToDouble(z, fixedFromDouble(vUly.z()))));
         return offsetUly * 1.0e-6f;
     }
 
@@ -100,9 +118,10 @@ class UniversalCoord
       */
     Eigen::Vector3d offsetFromUly(const UniversalCoord& uc) const
     {
-        return Eigen::Vector3d(static_cast<double>(x - uc.x),
-                               static_cast<double>(y - uc.y),
-                               static_cast<double>(z - uc.z));
+        using celestia::util::fixedDifferenceToDouble;
+        return Eigen::Vector3d(fixedDifferenceToDouble(x, uc.x),
+                               fixedDifferenceToDouble(y, uc.y),
+                               fixedDifferenceToDouble(z, uc.z));
     }
 
     /** Get the value of the coordinate in light years. The result is truncated to
@@ -110,9 +129,10 @@ class UniversalCoord
       */
     Eigen::Vector3d toLy() const
     {
-        return Eigen::Vector3d(static_cast<double>(x),
-                               static_cast<double>(y),
-                               static_cast<double>(z)) * 1.0e-6;
+        using celestia::util::fixedToDouble;
+        return Eigen::Vector3d(fixedToDouble(x),
+                               fixedToDouble(y),
+                               fixedToDouble(z)) * 1.0e-6;
     }
 
     double distanceFromKm(const UniversalCoord& uc)
@@ -174,10 +194,12 @@ public:
 
 inline UniversalCoord operator+(const UniversalCoord& uc0, const UniversalCoord& uc1)
 {
-    return UniversalCoord(uc0.x + uc1.x, uc0.y + uc1.y, uc0.z + uc1.z);
+    using celestia::util::addFixed;
+    return UniversalCoord(addFixed(uc0.x, uc1.x), addFixed(uc0.y, uc1.y), addFixed(uc0.z, uc1.z));
 }
 
 inline UniversalCoord operator-(const UniversalCoord& uc0, const UniversalCoord& uc1)
 {
-    return UniversalCoord(uc0.x - uc1.x, uc0.y - uc1.y, uc0.z - uc1.z);
+    using celestia::util::subtractFixed;
+    return UniversalCoord(subtractFixed(uc0.x, uc1.x), subtractFixed(uc0.y, uc1.y), subtractFixed(uc0.z, uc1.z));
 }
@@ -23,6 +23,7 @@
 #include "body.h"
 #include "boundaries.h"
 #include "frametree.h"
+#include "lazybodycatalog.h"
 #include "location.h"
 #include "meshmanager.h"
 #include "render.h"
@@ -40,6 +41,24 @@ namespace
 
 constexpr double ANGULAR_RES = 3.5e-6;
 
+// The key of a path in the cache of Universe::findPath()
+std::string
+pathCacheKey(std::string_view s, celutil::array_view<const Selection> contexts, bool i18n)
+{
+    std::string key;
+    key.reserve(s.size() + 2 + contexts.size() * (sizeof(void*) + 1));
+    key.append(s);
+    key += '\0';
+    key += i18n ? '1' : '0';
+    for (const auto& context : contexts)
+    {
+        const AstroObject* object = context.object();
+        key.append(reinterpret_cast<const char*>(&object), sizeof(object));
+        key += static_cast<char>(context.getType());
+    }
+    return key;
+}
+
 } // end unnamed namespace
 
 
@@ -63,6 +82,8 @@ StarDatabase* Universe::getStarCatalog() const
 void Universe::setStarCatalog(StarDatabase* catalog)
 {
     starCatalog = catalog;
+    std::scoped_lock lock(pathCacheMutex);
+    clearPathCache();
 }
 
 
@@ -71,9 +92,27 @@ SolarSystemCatalog* Universe::getSolarSystemCatalog() const
     return solarSystemCatalog;
 }
 
+void Universe::addMemoryUsage(celutil::MemoryReport& report) const
+{
+    if (starCatalog != nullptr)
+        starCatalog->addMemoryUsage(report);
+    if (dsoCatalog != nullptr)
+        dsoCatalog->addMemoryUsage(report);
+    if (solarSystemCatalog == nullptr)
+        return;
+
+    for (const auto& [catalogNumber, solarSystem] : *solarSystemCatalog)
+    {
+        if (const PlanetarySystem* planets = solarSystem->getPlanets(); planets != nullptr)
+            planets->addMemoryUsage(report);
+    }
+}
+
 void Universe::setSolarSystemCatalog(SolarSystemCatalog* catalog)
 {
     solarSystemCatalog = catalog;
+    std::scoped_lock lock(pathCacheMutex);
+    clearPathCache();
 }
 
 
@@ -85,6 +124,8 @@ DSODatabase* Universe::getDSOCatalog() const
 void Universe::setDSOCatalog(DSODatabase* catalog)
 {
     dsoCatalog = catalog;
+    std::scoped_lock lock(pathCacheMutex);
+    clearPathCache();
 }
 
 
@@ -184,49 +225,62 @@ void Universe::markObject(const Selection& sel,
                           bool occludable,
                           celestia::MarkerSizing sizing)
 {
-    auto iter = std::find_if(markers->begin(), markers->end(),
-                             [&sel](celestia::Marker& m) { return m.object() == sel; });
-    if (iter != markers->end())
+    celestia::Marker marker(sel);
+    marker.setRepresentation(rep);
+    marker.setPriority(priority);
+    marker.setOccludable(occludable);
+    marker.setSizing(sizing);
+
+    if (auto iter = markerIndex.find(sel); iter != markerIndex.end())
     {
         // Handle the case when the object is already marked.  If the
         // priority is higher or equal to the existing marker, replace it.
         // Otherwise, do nothing.
-        if (priority >= iter->priority())
-            markers->erase(iter);
-        else
-            return;
+        celestia::Marker& existing = (*markers)[iter->second];
+        if (priority >= existing.priority())
+            existing = marker;
+        return;
     }
 
-    celestia::Marker marker(sel);
-    marker.setRepresentation(rep);
-    marker.setPriority(priority);
-    marker.setOccludable(occludable);
-    marker.setSizing(sizing);
+    markerIndex.emplace(sel, markers->size());
     markers->push_back(marker);
 }
 
 
 void Universe::unmarkObject(const Selection& sel, int priority)
 {
-    auto iter = std::find_if(markers->begin(), markers->end(),
-                             [&sel](celestia::Marker& m) { return m.object() == sel; });
-    if (iter != markers->end() && priority >= iter->priority())
-        markers->erase(iter);
+    auto iter = markerIndex.find(sel);
+    if (iter == markerIndex.end())
+        return;
+
+    std::size_t index = iter->second;
+    if (priority < (*markers)[index].priority())
+        return;
+
+    // Move the last marker into the place of the one removed, so that the
+    // indices of the others don't change
+    markerIndex.erase(iter);
+    if (index + 1 < markers->size())
+    {
+        (*markers)[index] = std::move(markers->back());
+        markerIndex[(*markers)[index].object()] = index;
+    }
+    markers->pop_back();
 }
 
 
 void Universe::unmarkAll()
 {
-    markers->erase(markers->begin(), markers->end());
+    markers->clear();
+    markerIndex.clear();
 }
 
 
 bool Universe::isMarked(const Selection& sel, int priority) const
 {
-    auto iter = std::find_if(markers->begin(), markers->end(),
-                             [&sel](celestia::Marker& m) { return m.object() == sel; });
-    if (iter != markers->end())
-        return iter->priority() >= priority;
+    auto iter = markerIndex.find(sel);
+    if (iter != markerIndex.end())
+        return (*markers)[iter->second].priority() >= priority;
 
     return false;
 }
@@ -423,6 +477,50 @@ static bool ExactPlanetPickTraversal(Body* body, void* info)
     return true;
 }
 
+// Same as ApproxPlanetPickTraversal for the bodies of a lazy body catalog
+// which haven't been created; the body closest to the pick ray is created
+// if it's closer than the one already found and within the tolerance.
+static void ApproxLazyBodyPick(LazyBodyCatalog& lazyBodies,
+                               const FrameTree& tree,
+                               double sinTol2,
+                               PlanetPickInfo& pickInfo)
+{
+    std::vector<Vector3d> positions;
+    lazyBodies.computePositions(pickInfo.jd, positions);
+    Quaterniond toAstrocentric = tree.getDefaultReferenceFrame()->getOrientation(pickInfo.jd).conjugate();
+
+    std::uint32_t closest = LazyBodyCatalog::InvalidIndex;
+    for (std::uint32_t i = 0; i < lazyBodies.size(); i++)
+    {
+        if (lazyBodies.getBody(i) != nullptr)
+            continue;
+
+        Vector3d bodyDir = toAstrocentric * positions[i] - pickInfo.pickRay.origin();
+        double distance = bodyDir.norm();
+
+        auto appOrbitRadius = (float) (lazyBodies.getBoundingRadius(i) / distance);
+        if (std::max((double) pickInfo.atanTolerance, ANGULAR_RES) > appOrbitRadius)
+            continue;
+
+        bodyDir.normalize();
+        Vector3d bodyMiss = bodyDir - pickInfo.pickRay.direction();
+        double sinAngle2 = bodyMiss.norm() / 2.0;
+
+        if (sinAngle2 <= pickInfo.sinAngle2Closest)
+        {
+            pickInfo.sinAngle2Closest = std::max(sinAngle2, ANGULAR_RES);
+            pickInfo.closestApproxDistance = distance;
+            closest = i;
+        }
+    }
+
+    if (closest != LazyBodyCatalog::InvalidIndex && pickInfo.sinAngle2Closest <= sinTol2)
+    {
+        if (Body* body = lazyBodies.materialize(closest); body != nullptr)
+            pickInfo.closestBody = body;
+    }
+}
+
 // Recursively traverse a frame tree; call the specified callback function for each
 // body in the tree. The callback function returns a boolean indicating whether
 // traversal should continue.
@@ -514,6 +612,8 @@ Selection Universe::pickPlanet(SolarSystem& solarSystem,
     // to make distant planets visible on the screen at all, their apparent
     // size has to be greater than their actual disc size.
     traverseFrameTree(solarSystem.getFrameTree(), when, ApproxPlanetPickTraversal, (void*) &pickInfo);
+    if (LazyBodyCatalog* lazyBodies = solarSystem.getPlanets()->getLazyBodies(); lazyBodies != nullptr)
+        ApproxLazyBodyPick(*lazyBodies, *solarSystem.getFrameTree(), sinTol2, pickInfo);
 
     if (pickInfo.sinAngle2Closest <= sinTol2)
         return Selection(pickInfo.closestBody);
@@ -1061,6 +1161,56 @@ Selection Universe::find(std::string_view s,
 Selection Universe::findPath(std::string_view s,
                              celutil::array_view<const Selection> contexts,
                              bool i18n) const
+{
+    // Paths are resolved again every frame by scripts, markers and the
+    // console, so the latest results are kept until the names change
+    std::string key = pathCacheKey(s, contexts, i18n);
+    {
+        std::scoped_lock lock(pathCacheMutex);
+        if (pathCacheGeneration != PlanetarySystem::getNameGeneration())
+        {
+            clearPathCache();
+        }
+        else if (auto iter = pathCacheIndex.find(key); iter != pathCacheIndex.end())
+        {
+            pathCache.splice(pathCache.begin(), pathCache, iter->second);
+            return iter->second->sel;
+        }
+    }
+
+    Selection sel = findPathUncached(s, contexts, i18n);
+
+    // Finding a lazily loaded body creates it, which changes the names
+    std::scoped_lock lock(pathCacheMutex);
+    if (pathCacheGeneration != PlanetarySystem::getNameGeneration())
+        clearPathCache();
+    if (pathCacheIndex.find(key) == pathCacheIndex.end())
+    {
+        if (pathCache.size() >= MaxCachedPaths)
+        {
+            pathCacheIndex.erase(pathCache.back().key);
+            pathCache.pop_back();
+        }
+        pathCache.push_front({ std::move(key), sel });
+        pathCacheIndex.emplace(pathCache.front().key, pathCache.begin());
+    }
+
+    return sel;
+}
+
+
+// Must be called with pathCacheMutex locked
+void Universe::clearPathCache() const
+{
+    pathCacheIndex.clear();
+    pathCache.clear();
+    pathCacheGeneration = PlanetarySystem::getNameGeneration();
+}
+
+
+Selection Universe::findPathUncached(std::string_view s,
+                                     celutil::array_view<const Selection> contexts,
+                                     bool i18n) const
 {
     std::string_view::size_type pos = s.find('/', 0);
 
@@ -11,8 +11,11 @@
 #pragma once
 
 #include <cstdint>
+#include <list>
+#include <mutex>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 
@@ -50,6 +53,15 @@ class Universe
     ConstellationBoundaries* getBoundaries() const;
     void setBoundaries(ConstellationBoundaries*);
 
+    // When enabled, the simple asteroids of solar system catalogs loaded
+    // afterwards are kept in a LazyBodyCatalog until they're needed.
+    bool getLazyMinorBodies() const { return lazyMinorBodies; }
+    void setLazyMinorBodies(bool enable) { lazyMinorBodies = enable; }
+
+    // Add the memory taken by the catalogs of stars, deep sky objects and
+    // solar system bodies to report
+    void addMemoryUsage(celestia::util::MemoryReport& report) const;
+
     Selection pick(const UniversalCoord& origin,
                    const Eigen::Vector3f& direction,
                    double when,
@@ -104,6 +116,10 @@ class Universe
     Selection findObjectInContext(const Selection& sel,
                                   std::string_view name,
                                   bool i18n = false) const;
+    Selection findPathUncached(std::string_view s,
+                               celestia::util::array_view<const Selection> contexts,
+                               bool i18n) const;
+    void clearPathCache() const;
 
     Selection pickPlanet(SolarSystem& solarSystem,
                          const UniversalCoord& origin,
@@ -131,6 +147,23 @@ class Universe
     AsterismList* asterisms{nullptr};
     ConstellationBoundaries* boundaries{nullptr};
     celestia::MarkerList* markers;
+    // Index of the marker of each marked object in the marker list
+    std::unordered_map<Selection, std::size_t> markerIndex;
 
     std::vector<const Star*> closeStars;
+    bool lazyMinorBodies{ false };
+
+    // The most recently resolved paths, keyed by the path, the i18n flag
+    // and the contexts searched; cleared when a catalog or the names of
+    // any planetary system change.
+    struct PathCacheEntry
+    {
+        std::string key;
+        Selection sel;
+    };
+    static constexpr std::size_t MaxCachedPaths = 64;
+    mutable std::mutex pathCacheMutex;
+    mutable std::list<PathCacheEntry> pathCache;
+    mutable std::unordered_map<std::string_view, std::list<PathCacheEntry>::iterator> pathCacheIndex;
+    mutable std::uint64_t pathCacheGeneration{ 0 };
 };
@@ -15,6 +15,7 @@
 Value::Value(Value&& other) noexcept
     : type(other.type),
       units(other.units),
+      inArena(other.inArena),
       data(other.data)
 {
     other.type = ValueType::NullType;
@@ -25,22 +26,10 @@ Value& Value::operator=(Value&& other) noexcept
 {
     if (this != &other)
     {
-        switch (type)
-        {
-        case ValueType::StringType:
-            delete data.s; //NOSONAR
-            break;
-        case ValueType::ArrayType:
-            delete data.a; //NOSONAR
-            break;
-        case ValueType::HashType:
-            delete data.h; //NOSONAR
-            break;
-        default:
-            break;
-        }
+        destroy();
         type = other.type;
         units = other.units;
+        inArena = other.inArena;
         data = other.data;
         other.type = ValueType::NullType;
     }
@@ -51,16 +40,63 @@ Value& Value::operator=(Value&& other) noexcept
 
 Value::~Value()
 {
+    destroy();
+}
+
+
+Value Value::fromArena(const std::string* s)
+{
+    Value v;
+    v.type = ValueType::StringType;
+    v.inArena = true;
+    v.data.s = s;
+    return v;
+}
+
+
+Value Value::fromArena(const ValueArray* a)
+{
+    Value v;
+    v.type = ValueType::ArrayType;
+    v.inArena = true;
+    v.data.a = a;
+    return v;
+}
+
+
+Value Value::fromArena(const Hash* h)
+{
+    Value v;
+    v.type = ValueType::HashType;
+    v.inArena = true;
+    v.data.h = h;
+    return v;
+}
+
+
+void Value::destroy()
+{
+    using std::string;
+
     switch (type)
     {
     case ValueType::StringType:
-        delete data.s;
+        if (inArena)
+            data.s->~string();
+        else
+            delete data.s; //NOSONAR
         break;
     case ValueType::ArrayType:
-        delete data.a;
+        if (inArena)
+            data.a->~ValueArray();
+        else
+            delete data.a; //NOSONAR
         break;
     case ValueType::HashType:
-        delete data.h;
+        if (inArena)
+            data.h->~Hash();
+        else
+            delete data.h; //NOSONAR
         break;
     default:
         break;
@@ -19,6 +19,7 @@
 #include <utility>
 #include <vector>
 
+#include <celutil/arena.h>
 #include "astro.h"
 #include "hash.h"
 
@@ -33,13 +34,15 @@ enum class ValueType : std::uint8_t
 };
 
 class Value;
-using ValueArray = std::vector<Value>;
+using ValueArray = std::vector<Value, celestia::util::ArenaAllocator<Value>>;
 
 // Value acts as a custom variant type which stores the units data in what
 // would otherwise be padding between the discriminant and the union data.
 // Single ownership of the contained value is enforced via the constructors,
 // which either obtain ownership by releasing a unique-ptr, or create a new
 // copied object.
+// Values created from an arena point to objects allocated from it: they
+// are destroyed with the value, but their memory belongs to the arena.
 // Lines that trigger Sonar rules forbidding manual memory management are
 // marked as NOSONAR, as the use of new/delete is inherent to the functioning
 // of the class.
@@ -99,6 +102,10 @@ class Value //NOSONAR
         data.d = b ? 1.0 : 0.0;
     }
 
+    static Value fromArena(const std::string* s);
+    static Value fromArena(const ValueArray* a);
+    static Value fromArena(const Hash* h);
+
     void setUnits(Units _units) { units = _units; }
 
     ValueType getType() const
@@ -154,7 +161,10 @@ class Value //NOSONAR
         const Hash        *h;
     };
 
+    void destroy();
+
     ValueType type { ValueType::NullType };
     Units units{ };
+    bool inArena{ false };
     Data data;
 };
@@ -8,22 +8,71 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <Eigen/Geometry>
+#include <celcompat/numbers.h>
+#include <celutil/logger.h>
 #include "viewporteffect.h"
 #include "framebuffer.h"
+#include "observer.h"
 #include "render.h"
 #include "shadermanager.h"
+#include "simulation.h"
 #include "mapmanager.h"
 
 using celestia::render::VertexObject;
+using celestia::util::GetLogger;
 
 static const Renderer::PipelineState ps;
 
+namespace
+{
+// Target of each face of a cube map, starting from
+// GL_TEXTURE_CUBE_MAP_POSITIVE_X
+constexpr int PositiveZFace = 4;
+constexpr int NegativeZFace = 5;
+
+// Rotations from the camera space of the observer, which looks down the -z
+// axis, to the views of the faces of the cube map. The rows are the right,
+// up and backward directions of each face, oriented as GL samples it, so
+// the cube map is sampled with directions in the camera space.
+const std::array<Eigen::Quaterniond, 6>&
+faceRotations()
+{
+    static const std::array<Eigen::Quaterniond, 6> rotations = []
+    {
+        static const double faces[6][9] =
+        {
+            {  0,  0, -1,   0, -1,  0,  -1,  0,  0 },
+            {  0,  0,  1,   0, -1,  0,   1,  0,  0 },
+            {  1,  0,  0,   0,  0,  1,   0, -1,  0 },
+            {  1,  0,  0,   0,  0, -1,   0,  1,  0 },
+            {  1,  0,  0,   0, -1,  0,   0,  0, -1 },
+            { -1,  0,  0,   0, -1,  0,   0,  0,  1 },
+        };
+
+        std::array<Eigen::Quaterniond, 6> result;
+        for (int face = 0; face < 6; face++)
+            result[face] = Eigen::Quaterniond(Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor>>(faces[face]));
+        return result;
+    }();
+    return rotations;
+}
+} // end unnamed namespace
+
 bool ViewportEffect::preprocess(Renderer* renderer, FramebufferObject* fbo)
 {
     glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFboId);
     return fbo->bind();
 }
 
+bool ViewportEffect::renderScene(Renderer*, Simulation*, const Observer&)
+{
+    return false;
+}
+
 bool ViewportEffect::prerender(Renderer* renderer, FramebufferObject* fbo)
 {
     if (!fbo->unbind(oldFboId))
@@ -39,6 +88,11 @@ bool ViewportEffect::distortXY(float &x, float &y)
     return true;
 }
 
+bool ViewportEffect::isFisheye() const
+{
+    return false;
+}
+
 PassthroughViewportEffect::PassthroughViewportEffect() :
     ViewportEffect(),
     vo(0, GL_STATIC_DRAW)
@@ -156,3 +210,226 @@ bool WarpMeshViewportEffect::distortXY(float &x, float &y)
     y = v / 2;
     return true;
 }
+
+CubemapViewportEffect::CubemapViewportEffect(float aperture, WarpMesh *mesh) :
+    ViewportEffect(),
+    vo(0, GL_STATIC_DRAW),
+    aperture(aperture),
+    mesh(mesh),
+    faceObserver(std::make_unique<Observer>())
+{
+}
+
+CubemapViewportEffect::~CubemapViewportEffect()
+{
+    destroyFramebuffer();
+}
+
+bool CubemapViewportEffect::renderScene(Renderer* renderer, Simulation* sim, const Observer& observer)
+{
+    std::array<int, 4> viewport;
+    renderer->getViewport(viewport);
+
+    // Match the resolution of the faces to that of the middle of the
+    // fisheye view
+    int size = static_cast<int>(std::ceil(2.0f * static_cast<float>(std::min(viewport[2], viewport[3])) / aperture));
+    if (!initializeFramebuffer(size))
+        return false;
+
+    GLint oldFboId = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFboId);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    // The faces are plain perspective views, whatever the projection mode
+    auto projectionMode = renderer->getProjectionMode();
+    if (projectionMode != Renderer::ProjectionMode::PerspectiveMode)
+        renderer->setProjectionMode(Renderer::ProjectionMode::PerspectiveMode);
+
+    renderer->setRenderRegion(0, 0, faceSize, faceSize);
+    *faceObserver = observer;
+    faceObserver->setFOV(celestia::numbers::pi_v<float> / 2.0f);
+    for (int face = 0; face < 6; face++)
+    {
+        if (!isFaceVisible(face))
+            continue;
+
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, texture, 0);
+        faceObserver->setOrientation(faceRotations()[face] * observer.getOrientation());
+        sim->render(*renderer, *faceObserver);
+    }
+
+    if (projectionMode != Renderer::ProjectionMode::PerspectiveMode)
+        renderer->setProjectionMode(projectionMode);
+    renderer->setRenderRegion(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glBindFramebuffer(GL_FRAMEBUFFER, oldFboId);
+    return true;
+}
+
+bool CubemapViewportEffect::render(Renderer* renderer, FramebufferObject*, int width, int height)
+{
+    CelestiaGLProgram *prog = renderer->getShaderManager().getShader("cubemapwarp");
+    if (prog == nullptr || texture == 0)
+        return false;
+
+    vo.bind();
+    if (!vo.initialized())
+        initializeVO(vo);
+
+    prog->use();
+    prog->samplerParam("tex") = 0;
+    prog->floatParam("screenRatio") = (float)height / width;
+    prog->floatParam("halfAperture") = aperture / 2.0f;
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+    renderer->setPipelineState(ps);
+    draw(vo);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    vo.unbind();
+    return true;
+}
+
+bool CubemapViewportEffect::distortXY(float &x, float &y)
+{
+    // Find the point of the fisheye view, within the unit circle
+    float u = x * 2.0f;
+    float v = y * 2.0f;
+    if (mesh != nullptr)
+    {
+        if (!mesh->mapVertex(x * 2, y * 2, &u, &v))
+            return false;
+        u = u * 2.0f - 1.0f;
+        v = v * 2.0f - 1.0f;
+    }
+
+    // The pick rays of fisheye views are for an aperture of 180 degrees
+    float scale = aperture / (2.0f * celestia::numbers::pi_v<float>);
+    x = u * scale;
+    y = v * scale;
+    return true;
+}
+
+bool CubemapViewportEffect::isFisheye() const
+{
+    return true;
+}
+
+bool CubemapViewportEffect::initializeFramebuffer(int size)
+{
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_CUBE_MAP_TEXTURE_SIZE, &maxSize);
+    size = std::min(size, static_cast<int>(maxSize));
+    if (size == faceSize && framebuffer != 0)
+        return true;
+
+    destroyFramebuffer();
+    if (size <= 0)
+        return false;
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    for (int face = 0; face < 6; face++)
+    {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGBA, size, size, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+#ifndef GL_ES
+    // Filter across the edges of the faces
+    if (celestia::gl::checkVersion(celestia::gl::GL_3_2))
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+#endif
+
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+#ifdef GL_ES
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, size, size);
+#else
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+#endif
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    GLint oldFboId = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFboId);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_CUBE_MAP_POSITIVE_X + NegativeZFace, texture, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, oldFboId);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        GetLogger()->error("Error creating cube map FBO of {}x{}.\n", size, size);
+        destroyFramebuffer();
+        return false;
+    }
+
+    faceSize = size;
+    return true;
+}
+
+void CubemapViewportEffect::destroyFramebuffer()
+{
+    if (framebuffer != 0)
+        glDeleteFramebuffers(1, &framebuffer);
+    if (depthBuffer != 0)
+        glDeleteRenderbuffers(1, &depthBuffer);
+    if (texture != 0)
+        glDeleteTextures(1, &texture);
+    framebuffer = 0;
+    depthBuffer = 0;
+    texture = 0;
+    faceSize = 0;
+}
+
+bool CubemapViewportEffect::isFaceVisible(int face) const
+{
+    // A face is only sampled beyond the angle from the view direction of
+    // the nearest direction along which it's the major axis
+    float halfAperture = aperture / 2.0f;
+    if (face == NegativeZFace)
+        return true;
+    if (face == PositiveZFace)
+        return halfAperture > std::acos(-1.0f / std::sqrt(3.0f));
+    return halfAperture > celestia::numbers::pi_v<float> / 4.0f;
+}
+
+void CubemapViewportEffect::initializeVO(VertexObject& vo)
+{
+    if (mesh != nullptr)
+    {
+        std::vector<float> scopedData = mesh->scopedDataForRendering();
+        vo.allocate(static_cast<GLsizeiptr>(scopedData.size() * sizeof(float)), scopedData.data());
+    }
+    else
+    {
+        static float quadVertices[] = {
+            // positions   // texCoords  // intensity
+            -1.0f,  1.0f,  0.0f, 1.0f,   1.0f,
+            -1.0f, -1.0f,  0.0f, 0.0f,   1.0f,
+             1.0f, -1.0f,  1.0f, 0.0f,   1.0f,
+
+            -1.0f,  1.0f,  0.0f, 1.0f,   1.0f,
+             1.0f, -1.0f,  1.0f, 0.0f,   1.0f,
+             1.0f,  1.0f,  1.0f, 1.0f,   1.0f
+        };
+        vo.allocate(sizeof(quadVertices), quadVertices);
+    }
+    vo.setVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex,
+                            2, GL_FLOAT, false, 5 * sizeof(float), 0);
+    vo.setVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex,
+                            2, GL_FLOAT, false, 5 * sizeof(float), 2 * sizeof(float));
+    vo.setVertexAttribArray(CelestiaGLProgram::IntensityAttributeIndex,
+                            1, GL_FLOAT, false, 5 * sizeof(float), 4 * sizeof(float));
+}
+
+void CubemapViewportEffect::draw(VertexObject& vo)
+{
+    vo.draw(GL_TRIANGLES, mesh != nullptr ? mesh->count() : 6);
+}
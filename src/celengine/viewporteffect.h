@@ -10,13 +10,16 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 #include <celengine/glsupport.h>
 #include <celrender/vertexobject.h>
 
 class FramebufferObject;
+class Observer;
 class Renderer;
 class CelestiaGLProgram;
+class Simulation;
 class WarpMesh;
 
 class ViewportEffect
@@ -25,9 +28,16 @@ class ViewportEffect
     virtual ~ViewportEffect() = default;
 
     virtual bool preprocess(Renderer*, FramebufferObject*);
+    // Render the scene seen by the observer, for effects which need more
+    // than the single view of it rendered into the framebuffer. Returns
+    // false if the caller is to render it.
+    virtual bool renderScene(Renderer*, Simulation*, const Observer&);
     virtual bool prerender(Renderer*, FramebufferObject*);
     virtual bool render(Renderer*, FramebufferObject*, int width, int height) = 0;
     virtual bool distortXY(float& x, float& y);
+    // Whether the coordinates returned by distortXY() are those of a
+    // fisheye view rather than a perspective one
+    virtual bool isFisheye() const;
 
  private:
     GLint oldFboId;
@@ -65,3 +75,41 @@ class WarpMeshViewportEffect : public ViewportEffect
     void initializeVO(celestia::render::VertexObject&);
     void draw(celestia::render::VertexObject&);
 };
+
+/*! Renders the scene into the faces of a cube map, each a perspective view
+ *  of 90 degrees, and warps them to a fisheye view of the given aperture,
+ *  either filling a circle in the middle of the viewport or through a warp
+ *  mesh for projectors. Unlike the fisheye projection mode, the geometry
+ *  isn't distorted in the vertex shaders, so it doesn't need to be finely
+ *  tessellated. The faces are drawn within the same frame of the renderer,
+ *  so the work which doesn't depend on the view is shared between them.
+ */
+class CubemapViewportEffect : public ViewportEffect
+{
+ public:
+    CubemapViewportEffect(float aperture, WarpMesh *mesh = nullptr);
+    ~CubemapViewportEffect() override;
+
+    bool renderScene(Renderer*, Simulation*, const Observer&) override;
+    bool render(Renderer*, FramebufferObject*, int width, int height) override;
+    bool distortXY(float& x, float& y) override;
+    bool isFisheye() const override;
+
+ private:
+    celestia::render::VertexObject vo;
+    // full aperture in radians
+    float aperture;
+    WarpMesh *mesh;
+    std::unique_ptr<Observer> faceObserver;
+
+    int faceSize{ 0 };
+    GLuint texture{ 0 };
+    GLuint depthBuffer{ 0 };
+    GLuint framebuffer{ 0 };
+
+    bool initializeFramebuffer(int size);
+    void destroyFramebuffer();
+    bool isFaceVisible(int face) const;
+    void initializeVO(celestia::render::VertexObject&);
+    void draw(celestia::render::VertexObject&);
+};
@@ -7,12 +7,18 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <cmath>
 #include <cassert>
 #include <cmath>
+#include <condition_variable>
 #include <istream>
 #include <fstream>
+#include <queue>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <utility>
 #include <fmt/format.h>
 #include <celcompat/filesystem.h>
@@ -21,6 +27,7 @@
 #include <celutil/tokenizer.h>
 #include "glsupport.h"
 #include "parser.h"
+#include "tilecache.h"
 #include "virtualtex.h"
 
 
@@ -29,6 +36,139 @@ using celestia::util::GetLogger;
 
 static const int MaxResolutionLevels = 13;
 
+// Tiles drawn within this many beginUsage() calls of any virtual texture
+// are never evicted; they are probably still in view.
+static const std::uint32_t MinIdleUsages = 60;
+
+// When over budget, evict down to this fraction of it, so that it isn't
+// exceeded again by the very next tile
+static const double EvictionTarget = 0.9;
+
+// Load priorities: tiles in view come first, coarse ones before fine ones,
+// then the prefetched tiles
+static const float VisibleTilePriority = 1000.0f;
+static const float PrefetchTilePriority = 100.0f;
+
+// Tiles are prefetched where the view will be in this many frames at its
+// current speed, but no further than MaxPrefetchOffset tiles away
+static const double PrefetchFrames = 8.0;
+static const double MaxPrefetchOffset = 2.0;
+static const unsigned int MaxPrefetchTilesPerFrame = 16;
+// Frames for which the next level of detail is prefetched after the view
+// moved to a finer level
+static const unsigned int ZoomPrefetchFrames = 30;
+
+// Largest width and height of the atlases holding tiles
+static const int MaxAtlasSize = 4096;
+
+
+class VirtualTexture::TileLoader
+{
+ public:
+    explicit TileLoader(unsigned int nThreads);
+    ~TileLoader();
+
+    TileLoader(const TileLoader&) = delete;
+    TileLoader& operator=(const TileLoader&) = delete;
+
+    void request(const std::shared_ptr<LoadedTiles>& destination,
+                 Tile* tile,
+                 unsigned int lod,
+                 fs::path&& path,
+                 std::string&& url,
+                 float priority);
+
+ private:
+    struct Request
+    {
+        std::shared_ptr<LoadedTiles> destination;
+        Tile* tile;
+        unsigned int lod;
+        fs::path path;
+        // Empty unless the tile is downloaded
+        std::string url;
+        float priority;
+
+        bool operator<(const Request& other) const { return priority < other.priority; }
+    };
+
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable requestReady;
+    std::priority_queue<Request> requests;
+    bool stopRequested{ false };
+
+    std::vector<std::thread> workers;
+};
+
+
+VirtualTexture::TileLoader::TileLoader(unsigned int nThreads)
+{
+    for (unsigned int i = 0; i < nThreads; ++i)
+        workers.emplace_back(&TileLoader::run, this);
+}
+
+
+VirtualTexture::TileLoader::~TileLoader()
+{
+    {
+        std::scoped_lock lock(mutex);
+        stopRequested = true;
+    }
+    requestReady.notify_all();
+
+    for (auto& worker : workers)
+        worker.join();
+}
+
+
+void VirtualTexture::TileLoader::request(const std::shared_ptr<LoadedTiles>& destination,
+                                         Tile* tile,
+                                         unsigned int lod,
+                                         fs::path&& path,
+                                         std::string&& url,
+                                         float priority)
+{
+    {
+        std::scoped_lock lock(mutex);
+        requests.push(Request{ destination, tile, lod, std::move(path), std::move(url), priority });
+    }
+    requestReady.notify_one();
+}
+
+
+void VirtualTexture::TileLoader::run()
+{
+    std::unique_lock lock(mutex);
+    for (;;)
+    {
+        requestReady.wait(lock, [this]() { return stopRequested || !requests.empty(); });
+        if (stopRequested)
+            return;
+
+        Request request = requests.top();
+        requests.pop();
+
+        lock.unlock();
+        std::unique_ptr<Image> img = loadTileImage(request.path, request.url);
+        {
+            std::scoped_lock loadedLock(request.destination->mutex);
+            request.destination->tiles.push_back(LoadedTile{ request.tile, request.lod, std::move(img) });
+        }
+        lock.lock();
+    }
+}
+
+
+std::unique_ptr<VirtualTexture::TileLoader> VirtualTexture::loader;
+bool VirtualTexture::forceSynchronous = false;
+std::unique_ptr<TileCache> VirtualTexture::tileCache;
+std::vector<VirtualTexture*> VirtualTexture::instances;
+std::size_t VirtualTexture::memoryBudget = std::size_t(512) << 20;
+std::size_t VirtualTexture::residentSize = 0;
+std::uint32_t VirtualTexture::usageClock = 0;
+
 
 // Virtual textures are composed of tiles that are loaded from the hard drive
 // as they become visible.  Hidden tiles may be evicted from graphics memory
@@ -61,23 +201,71 @@ VirtualTexture::VirtualTexture(const fs::path& _tilePath,
                                unsigned int _baseSplit,
                                unsigned int _tileSize,
                                const string& _tilePrefix,
-                               const string& _tileType) :
+                               const string& _tileType,
+                               const string& _tileURL,
+                               unsigned int _maxLevel) :
     Texture(_tileSize << (_baseSplit + 1), _tileSize << _baseSplit),
     tilePath(_tilePath),
     tilePrefix(_tilePrefix),
+    tileURL(_tileURL),
     baseSplit(_baseSplit),
     tileSize(_tileSize),
     ticks(0),
-    nResolutionLevels(0)
+    nResolutionLevels(0),
+    loadedTiles(std::make_shared<LoadedTiles>())
 {
     assert(tileSize != 0 && isPow2(tileSize));
     tileTree[0] = new TileQuadtreeNode();
     tileTree[1] = new TileQuadtreeNode();
     tileExt = fmt::format(".{:s}", _tileType);
-    populateTileTree();
+    if (tileURL.empty())
+    {
+        populateTileTree();
+    }
+    else
+    {
+        // The tiles of remote textures are added to the tree as they're
+        // drawn, as there's no listing them
+        nResolutionLevels = _maxLevel + baseSplit + 1;
+        if (baseSplit == 0)
+        {
+            tileTree[0]->tile = new Tile();
+            tileTree[1]->tile = new Tile();
+        }
+    }
 
     if (DetermineFileType(tileExt, true) == ContentType::DXT5NormalMap)
         setFormatOptions(Texture::DXT5NormalMap);
+
+    instances.push_back(this);
+}
+
+
+VirtualTexture::~VirtualTexture()
+{
+    for (Tile* tile : residentTiles)
+    {
+        residentSize -= tile->size;
+        delete tile->tex;
+        tile->tex = nullptr;
+    }
+
+    deleteTileTree(tileTree[0]);
+    deleteTileTree(tileTree[1]);
+
+    instances.erase(std::remove(instances.begin(), instances.end(), this), instances.end());
+}
+
+
+void VirtualTexture::deleteTileTree(TileQuadtreeNode* node)
+{
+    if (node == nullptr)
+        return;
+
+    for (TileQuadtreeNode* child : node->children)
+        deleteTileTree(child);
+    delete node->tile;
+    delete node;
 }
 
 
@@ -98,19 +286,44 @@ const TextureTile VirtualTexture::getTile(int lod, int u, int v)
     Tile* tile = node->tile;
     unsigned int tileLOD = 0;
 
+    // The coarsest tile and the finest resident tile, which stand in for
+    // the one we want while it's loaded in the background
+    Tile* baseTile = tile;
+    unsigned int baseLOD = 0;
+    Tile* residentTile = tile != nullptr && tile->isResident() ? tile : nullptr;
+    unsigned int residentLOD = 0;
+
     for (int n = 0; n < lod; n++)
     {
         unsigned int mask = 1 << (lod - n - 1);
         unsigned int child = (((v & mask) << 1) | (u & mask)) >> (lod - n - 1);
         //int child = (((v << 1) | u) >> (lod - n - 1)) & 3;
         if (!node->children[child])
-            break;
+        {
+            // Stop at tiles missing from the server, whose parent stands
+            // in for them and their children
+            if (tileURL.empty() || (tile != nullptr && tile->loadFailed))
+                break;
+            node->children[child] = new TileQuadtreeNode();
+            if (static_cast<unsigned int>(n + 1) >= baseSplit)
+                node->children[child]->tile = new Tile();
+        }
 
         node = node->children[child];
         if (node->tile != nullptr)
         {
             tile = node->tile;
             tileLOD = n + 1;
+            if (baseTile == nullptr)
+            {
+                baseTile = tile;
+                baseLOD = tileLOD;
+            }
+            if (tile->isResident())
+            {
+                residentTile = tile;
+                residentLOD = tileLOD;
+            }
         }
     }
 
@@ -121,14 +334,36 @@ const TextureTile VirtualTexture::getTile(int lod, int u, int v)
     // Make the tile resident.
     unsigned int tileU = u >> (lod - tileLOD);
     unsigned int tileV = v >> (lod - tileLOD);
-    makeResident(tile, tileLOD, tileU, tileV);
+    if (loader == nullptr || forceSynchronous)
+    {
+        makeResident(tile, tileLOD, tileU, tileV);
+    }
+    else
+    {
+        drawnTiles.push_back(TileLocation{ static_cast<unsigned int>(lod),
+                                           static_cast<unsigned int>(u),
+                                           static_cast<unsigned int>(v) });
+        requestTile(tile, tileLOD, tileU, tileV, VisibleTilePriority - static_cast<float>(tileLOD));
+        if (residentTile == nullptr && baseTile != tile)
+        {
+            requestTile(baseTile, baseLOD, u >> (lod - baseLOD), v >> (lod - baseLOD),
+                        VisibleTilePriority - static_cast<float>(baseLOD));
+        }
+
+        if (!tile->isResident() && residentTile != nullptr)
+        {
+            tile = residentTile;
+            tileLOD = residentLOD;
+        }
+    }
 
     // It's possible that we failed to make the tile resident, either
     // because the texture file was bad, or there was an unresolvable
     // out of memory situation.  In that case there is nothing else to
     // do but return a texture tile with a null texture name.
-    if (!tile->tex)
+    if (!tile->isResident())
         return TextureTile(0);
+    tile->lastUsed = usageClock;
 
     // Set up the texture subrect to be the entire texture
     float texU = 0.0f;
@@ -143,7 +378,13 @@ const TextureTile VirtualTexture::getTile(int lod, int u, int v)
     texU = (u & ((1 << lodDiff) - 1)) * texDU;
     texV = (v & ((1 << lodDiff) - 1)) * texDV;
 
-    return TextureTile(tile->tex->getName(), texU, texV, texDU, texDV);
+    if (tile->atlas == nullptr)
+        return TextureTile(tile->tex->getName(), texU, texV, texDU, texDV);
+
+    TextureTile slot = tile->atlas->getTile(tile->atlasSlot);
+    return TextureTile(slot.texID,
+                       slot.u + texU * slot.du, slot.v + texV * slot.dv,
+                       texDU * slot.du, texDV * slot.dv);
 }
 
 
@@ -175,12 +416,39 @@ int VirtualTexture::getVTileCount(int lod) const
 void VirtualTexture::beginUsage()
 {
     ticks++;
+    usageClock++;
     tilesRequested = 0;
+    drawnTiles.clear();
+    if (loader != nullptr)
+        finishLoadedTiles();
 }
 
 
 void VirtualTexture::endUsage()
 {
+    if (loader != nullptr)
+        prefetchTiles();
+}
+
+
+void VirtualTexture::setLoadingThreads(unsigned int nThreads)
+{
+    if (nThreads == 0)
+        loader = nullptr;
+    else
+        loader = std::make_unique<TileLoader>(nThreads);
+}
+
+
+void VirtualTexture::setForceSynchronous(bool force)
+{
+    forceSynchronous = force;
+}
+
+
+void VirtualTexture::setTileCache(const fs::path& directory, std::uintmax_t maxSize)
+{
+    tileCache = std::make_unique<TileCache>(directory, maxSize);
 }
 
 
@@ -194,48 +462,439 @@ unsigned int VirtualTexture::tileIndex(unsigned int lod,
 #endif
 
 
-ImageTexture* VirtualTexture::loadTileTexture(unsigned int lod, unsigned int u, unsigned int v)
+fs::path VirtualTexture::getTileFilePath(unsigned int lod, unsigned int u, unsigned int v) const
 {
     lod >>= baseSplit;
     assert(lod < (unsigned)MaxResolutionLevels);
 
-    auto path = tilePath /
-                fmt::format("level{:d}", lod) /
-                fmt::format("{:s}{:d}_{:d}{:s}", tilePrefix, u, v, tileExt.string());
+    return tilePath /
+           fmt::format("level{:d}", lod) /
+           fmt::format("{:s}{:d}_{:d}{:s}", tilePrefix, u, v, tileExt.string());
+}
 
-    std::unique_ptr<Image> img = LoadImageFromFile(path);
-    if (img == nullptr)
+
+// The URL template of remote textures has the placeholders {level}, {u} and
+// {v} for the level and column and row of the tile, numbered as in the
+// directories of local ones.
+std::string VirtualTexture::getTileURL(unsigned int lod, unsigned int u, unsigned int v) const
+{
+    const std::pair<std::string_view, unsigned int> placeholders[] =
+    {
+        { "{level}", lod - baseSplit },
+        { "{u}", u },
+        { "{v}", v },
+    };
+
+    std::string url;
+    std::size_t pos = 0;
+    while (pos < tileURL.size())
+    {
+        auto it = std::find_if(std::begin(placeholders), std::end(placeholders),
+                               [this, pos](const auto& p) { return tileURL.compare(pos, p.first.size(), p.first) == 0; });
+        if (it == std::end(placeholders))
+        {
+            url += tileURL[pos++];
+            continue;
+        }
+        url += std::to_string(it->second);
+        pos += it->first.size();
+    }
+
+    return url;
+}
+
+
+// Read a tile from its file, or from the tile cache if it has a URL, where
+// the path only gives the file type. Called from the loader threads.
+std::unique_ptr<Image> VirtualTexture::loadTileImage(const fs::path& path, const std::string& url)
+{
+    if (url.empty())
+        return LoadImageFromFile(path);
+    if (tileCache == nullptr)
         return nullptr;
 
-    ImageTexture* tex = nullptr;
+    fs::path cachedPath = tileCache->fetch(url, path.extension());
+    return cachedPath.empty() ? nullptr : LoadImageFromFile(cachedPath);
+}
+
+
+void VirtualTexture::addTileTexture(Tile* tile, unsigned int lod, const Image* img)
+{
+    if (img == nullptr)
+    {
+        tile->loadFailed = true;
+        return;
+    }
+
+    if (!isPow2(img->getWidth()) || !isPow2(img->getHeight()))
+    {
+        tile->loadFailed = true;
+        return;
+    }
 
     // Only use mip maps for the LOD 0; for higher LODs, the function of mip
     // mapping is built into the texture.
-    MipMapMode mipMapMode = lod == 0 ? DefaultMipMaps : NoMipMaps;
-
-    if (isPow2(img->getWidth()) && isPow2(img->getHeight()))
-        tex = new ImageTexture(*img, EdgeClamp, mipMapMode);
+    MipMapMode mipMapMode = (lod >> baseSplit) == 0 ? DefaultMipMaps : NoMipMaps;
 
     // TODO: Virtual textures can have tiles in different formats, some
     // compressed and some not. The compression flag doesn't make much
     // sense for them.
     compressed = img->isCompressed();
 
-    return tex;
+    // Generated mipmaps take another third
+    std::size_t size = static_cast<std::size_t>(img->getSize());
+    if (mipMapMode == DefaultMipMaps && img->getMipLevelCount() == 1)
+        size += size / 3;
+
+    // Evict other tiles in order to make this one fit
+    if (residentSize + size > memoryBudget)
+        evictTiles(size);
+
+    if (mipMapMode == DefaultMipMaps || !addToAtlas(tile, *img))
+        tile->tex = new ImageTexture(*img, EdgeClamp, mipMapMode);
+
+    tile->size = size;
+    tile->lod = lod;
+    tile->lastUsed = usageClock;
+    residentTiles.push_back(tile);
+    residentSize += size;
+}
+
+
+// Tiles of the same atlas are drawn with the same texture bound, which
+// lets LODSphereMesh draw them together.
+bool VirtualTexture::addToAtlas(Tile* tile, const Image& img)
+{
+    for (auto& atlas : atlases)
+    {
+        if (!atlas->isFull() && atlas->accepts(img))
+        {
+            tile->atlasSlot = atlas->add(img);
+            tile->atlas = atlas.get();
+            return true;
+        }
+    }
+
+    int slotsPerSide = std::min(static_cast<int>(celestia::gl::maxTextureSize), MaxAtlasSize) / img.getWidth();
+    if (img.getWidth() != img.getHeight() || img.getMipLevelCount() != 1 || slotsPerSide < 2)
+        return false;
+
+    auto atlas = std::make_unique<TextureAtlas>(img.getFormat(), img.getWidth(), slotsPerSide);
+    tile->atlasSlot = atlas->add(img);
+    if (tile->atlasSlot < 0)
+        return false;
+
+    tile->atlas = atlas.get();
+    atlases.push_back(std::move(atlas));
+    return true;
 }
 
 
 void VirtualTexture::makeResident(Tile* tile, unsigned int lod, unsigned int u, unsigned int v)
 {
-    if (tile->tex == nullptr && !tile->loadFailed)
+    if (!tile->isResident() && !tile->loadFailed)
+    {
+        std::unique_ptr<Image> img = loadTileImage(getTileFilePath(lod, u, v),
+                                                   tileURL.empty() ? std::string() : getTileURL(lod, u, v));
+        addTileTexture(tile, lod, img.get());
+    }
+}
+
+
+void VirtualTexture::requestTile(Tile* tile, unsigned int lod, unsigned int u, unsigned int v, float priority)
+{
+    if (tile->isResident() || tile->loadFailed || tile->queuedPriority >= priority)
+        return;
+
+    // A tile requested again with a higher priority is queued twice; the
+    // second load is dropped
+    tile->queuedPriority = priority;
+    loader->request(loadedTiles, tile, lod, getTileFilePath(lod, u, v),
+                    tileURL.empty() ? std::string() : getTileURL(lod, u, v), priority);
+}
+
+
+void VirtualTexture::finishLoadedTiles()
+{
+    std::vector<LoadedTile> tiles;
+    {
+        std::scoped_lock lock(loadedTiles->mutex);
+        tiles.swap(loadedTiles->tiles);
+    }
+
+    for (const LoadedTile& loaded : tiles)
+    {
+        loaded.tile->queuedPriority = -1.0f;
+        if (!loaded.tile->isResident() && !loaded.tile->loadFailed)
+            addTileTexture(loaded.tile, loaded.lod, loaded.image.get());
+    }
+}
+
+
+// Request the tiles coming into view: the neighbors of the finest tiles
+// drawn, in the direction the view moved across the surface since the
+// previous frame, and their children for a while after the view moved to
+// a finer level of detail.
+void VirtualTexture::prefetchTiles()
+{
+    if (drawnTiles.empty())
+        return;
+
+    unsigned int finestLOD = 0;
+    for (const TileLocation& location : drawnTiles)
+        finestLOD = max(finestLOD, location.lod);
+
+    double centerU = 0.0;
+    double centerV = 0.0;
+    unsigned int nFinest = 0;
+    for (const TileLocation& location : drawnTiles)
+    {
+        if (location.lod != finestLOD)
+            continue;
+        centerU += location.u + 0.5;
+        centerV += location.v + 0.5;
+        ++nFinest;
+    }
+    centerU /= nFinest;
+    centerV /= nFinest;
+
+    // Motion in tiles of the finest level, the short way around in u
+    int lodChange = static_cast<int>(finestLOD) - static_cast<int>(lastFinestLOD);
+    double du = centerU - std::ldexp(lastCenterU, lodChange);
+    double dv = centerV - std::ldexp(lastCenterV, lodChange);
+    auto uTiles = static_cast<double>(2u << finestLOD);
+    if (du > uTiles * 0.5)
+        du -= uTiles;
+    else if (du < -uTiles * 0.5)
+        du += uTiles;
+
+    if (lodChange > 0)
+        zoomFrames = ZoomPrefetchFrames;
+    else if (zoomFrames > 0)
+        --zoomFrames;
+
+    bool moving = lodChange == 0;
+    lastCenterU = centerU;
+    lastCenterV = centerV;
+    lastFinestLOD = finestLOD;
+
+    int offsetU = 0;
+    int offsetV = 0;
+    if (moving)
+    {
+        offsetU = static_cast<int>(std::lround(std::clamp(du * PrefetchFrames, -MaxPrefetchOffset, MaxPrefetchOffset)));
+        offsetV = static_cast<int>(std::lround(std::clamp(dv * PrefetchFrames, -MaxPrefetchOffset, MaxPrefetchOffset)));
+    }
+
+    bool prefetchChildren = zoomFrames > 0 && finestLOD + 1 < nResolutionLevels;
+    if (offsetU == 0 && offsetV == 0 && !prefetchChildren)
+        return;
+
+    unsigned int nPrefetched = 0;
+    auto uMask = (2u << finestLOD) - 1;
+    auto vCount = static_cast<int>(1u << finestLOD);
+    for (const TileLocation& location : drawnTiles)
+    {
+        if (location.lod != finestLOD)
+            continue;
+        if (nPrefetched >= MaxPrefetchTilesPerFrame)
+            break;
+
+        int v = static_cast<int>(location.v) + offsetV;
+        if ((offsetU != 0 || offsetV != 0) && v >= 0 && v < vCount &&
+            prefetchTile(location.lod, (location.u + offsetU) & uMask, static_cast<unsigned int>(v)))
+        {
+            ++nPrefetched;
+        }
+
+        if (prefetchChildren)
+        {
+            for (unsigned int child = 0; child < 4; ++child)
+            {
+                if (prefetchTile(location.lod + 1, location.u * 2 + (child & 1), location.v * 2 + (child >> 1)))
+                    ++nPrefetched;
+            }
+        }
+    }
+}
+
+
+bool VirtualTexture::prefetchTile(unsigned int lod, unsigned int u, unsigned int v)
+{
+    Tile* tile = findTile(lod, u, v);
+    if (tile == nullptr && !tileURL.empty())
+        tile = addRemoteTile(lod, u, v);
+    if (tile == nullptr || tile->isResident() || tile->loadFailed || tile->queuedPriority >= 0.0f)
+        return false;
+
+    requestTile(tile, lod, u, v, PrefetchTilePriority - static_cast<float>(lod));
+    return true;
+}
+
+
+VirtualTexture::Tile* VirtualTexture::findTile(unsigned int lod, unsigned int u, unsigned int v)
+{
+    TileQuadtreeNode* node = tileTree[u >> lod];
+
+    for (unsigned int i = 0; i < lod && node != nullptr; i++)
+    {
+        unsigned int mask = 1 << (lod - i - 1);
+        unsigned int child = (((v & mask) << 1) | (u & mask)) >> (lod - i - 1);
+        node = node->children[child];
+    }
+
+    return node == nullptr ? nullptr : node->tile;
+}
+
+
+void VirtualTexture::evict(Tile* tile)
+{
+    residentSize -= tile->size;
+    delete tile->tex;
+    tile->tex = nullptr;
+    tile->size = 0;
+
+    if (TextureAtlas* atlas = tile->atlas; atlas != nullptr)
+    {
+        atlas->remove(tile->atlasSlot);
+        tile->atlas = nullptr;
+        tile->atlasSlot = -1;
+        if (atlas->isEmpty())
+        {
+            atlases.erase(std::find_if(atlases.begin(), atlases.end(),
+                                       [atlas](const auto& a) { return a.get() == atlas; }));
+        }
+    }
+
+    residentTiles.erase(std::find(residentTiles.begin(), residentTiles.end(), tile));
+}
+
+
+void VirtualTexture::evictTiles(std::size_t needed)
+{
+    struct Candidate
+    {
+        VirtualTexture* texture;
+        Tile* tile;
+    };
+
+    std::vector<Candidate> candidates;
+    for (VirtualTexture* texture : instances)
+    {
+        for (Tile* tile : texture->residentTiles)
+        {
+            if (usageClock - tile->lastUsed >= MinIdleUsages)
+                candidates.push_back({ texture, tile });
+        }
+    }
+
+    // The finest tiles cover the least area of the planet, and are the
+    // quickest to be loaded again
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& c0, const Candidate& c1)
+              {
+                  if (c0.tile->lod != c1.tile->lod)
+                      return c0.tile->lod > c1.tile->lod;
+                  return c0.tile->lastUsed < c1.tile->lastUsed;
+              });
+
+    auto target = static_cast<std::size_t>(static_cast<double>(memoryBudget) * EvictionTarget);
+    for (const Candidate& candidate : candidates)
+    {
+        if (residentSize + needed <= target)
+            break;
+        candidate.texture->evict(candidate.tile);
+    }
+}
+
+
+void VirtualTexture::setMemoryBudget(std::size_t bytes)
+{
+    memoryBudget = bytes;
+}
+
+
+std::size_t VirtualTexture::getResidentSize()
+{
+    return residentSize;
+}
+
+
+// Tile sets written by makevirtualtex come with an index of their tiles,
+// tiles.idx in the tile directory, which saves listing the directory of
+// every level:
+//
+// VirtualTextureIndex <tile prefix> <tile type>
+// level <n>
+// <v> <first u> <last u>
+// ...
+//
+// Each line after a level lists a run of tiles in a row of that level. The
+// index is ignored unless the prefix and type are those of the texture.
+bool VirtualTexture::loadTileIndex(unsigned int& maxLevel)
+{
+    std::ifstream in(tilePath / "tiles.idx");
+    if (!in.good())
+        return false;
+
+    std::string line;
+    std::string header;
+    std::string prefix;
+    std::string type;
+    std::getline(in, line);
+    std::istringstream headerLine(line);
+    if (!(headerLine >> header >> prefix >> type) ||
+        header != "VirtualTextureIndex" ||
+        prefix != tilePrefix ||
+        "." + type != tileExt.string())
     {
-        // Potentially evict other tiles in order to make this one fit
-        tile->tex = loadTileTexture(lod, u, v);
-        if (tile->tex == nullptr)
+        return false;
+    }
+
+    struct TileRun
+    {
+        unsigned int lod;
+        unsigned int v;
+        unsigned int firstU;
+        unsigned int lastU;
+    };
+
+    std::vector<TileRun> runs;
+    int level = -1;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string first;
+        if (!(fields >> first))
+            continue;
+
+        if (first == "level")
+        {
+            if (!(fields >> level) || level < 0 || level >= MaxResolutionLevels)
+                return false;
+            continue;
+        }
+
+        TileRun run;
+        run.lod = static_cast<unsigned int>(level) + baseSplit;
+        std::istringstream firstField(first);
+        if (level < 0 || !(firstField >> run.v) || !(fields >> run.firstU >> run.lastU) ||
+            run.v >= (1u << run.lod) || run.firstU > run.lastU || run.lastU >= (2u << run.lod))
         {
-            tile->loadFailed = true;
+            GetLogger()->warn("Bad tile index in {}, listing the tiles instead\n", tilePath);
+            return false;
         }
+        runs.push_back(run);
     }
+
+    for (const TileRun& run : runs)
+    {
+        maxLevel = max(maxLevel, run.lod);
+        for (unsigned int u = run.firstU; u <= run.lastU; u++)
+            addTileToTree(new Tile(), run.lod, u, run.v);
+    }
+
+    return true;
 }
 
 
@@ -244,6 +903,12 @@ void VirtualTexture::populateTileTree()
     // Count the number of resolution levels present
     unsigned int maxLevel = 0;
 
+    if (loadTileIndex(maxLevel))
+    {
+        nResolutionLevels = maxLevel + 1;
+        return;
+    }
+
     // Crash potential if the tile prefix contains a %, so disallow it
     string pattern;
     if (tilePrefix.find('%') == string::npos)
@@ -298,17 +963,66 @@ void VirtualTexture::addTileToTree(Tile* tile, unsigned int lod, unsigned int u,
 }
 
 
+// Add a tile of a remote texture to the tree before it's drawn, to prefetch
+// it. Only children of tiles which could be downloaded are added.
+VirtualTexture::Tile* VirtualTexture::addRemoteTile(unsigned int lod, unsigned int u, unsigned int v)
+{
+    if (lod < baseSplit || lod >= nResolutionLevels)
+        return nullptr;
+
+    if (lod > baseSplit)
+    {
+        const Tile* parent = findTile(lod - 1, u >> 1, v >> 1);
+        if (parent == nullptr || parent->loadFailed)
+            return nullptr;
+    }
+
+    Tile* tile = new Tile();
+    addTileToTree(tile, lod, u, v);
+    return tile;
+}
+
+
+// Remote virtual textures have a TileURL instead of an ImageDirectory,
+// and the number of their finest level in MaxLevel:
+//
+// VirtualTexture
+// {
+//     TileURL "https://example.org/earth/level{level}/tx_{u}_{v}.jpg"
+//     MaxLevel 8
+//     BaseSplit 0
+//     TileSize 512
+//     TileType "jpg"
+// }
+//
+// Their tiles are downloaded with the tile cache on the loader threads as
+// they come into view. Tiles which fail to download are left out, so that
+// their parent stands in for them.
 static std::unique_ptr<VirtualTexture>
 CreateVirtualTexture(const Hash* texParams,
                      const fs::path& path)
 {
     const std::string* imageDirectory = texParams->getString("ImageDirectory");
-    if (imageDirectory == nullptr)
+    const std::string* tileURL = texParams->getString("TileURL");
+    if (imageDirectory == nullptr && tileURL == nullptr)
     {
         GetLogger()->error("ImageDirectory missing in virtual texture.\n");
         return nullptr;
     }
 
+    unsigned int maxLevel = 0;
+    if (tileURL != nullptr)
+    {
+        std::optional<double> maxLevelVal = texParams->getNumber<double>("MaxLevel");
+        if (!maxLevelVal.has_value() || *maxLevelVal < 0.0 || *maxLevelVal != floor(*maxLevelVal) ||
+            *maxLevelVal >= MaxResolutionLevels)
+        {
+            GetLogger()->error("MaxLevel in remote virtual texture missing or has bad value\n");
+            return nullptr;
+        }
+        maxLevel = static_cast<unsigned int>(*maxLevelVal);
+    }
+
     std::optional<double> baseSplit = texParams->getNumber<double>("BaseSplit");
     if (!baseSplit.has_value() || *baseSplit < 0.0 || *baseSplit != floor(*baseSplit))
     {
@@ -345,7 +1059,7 @@ CreateVirtualTexture(const Hash* texParams,
 
     // if absolute directory notation for ImageDirectory used,
     // don't prepend the current add-on path.
-    fs::path directory(*imageDirectory);
+    fs::path directory = imageDirectory == nullptr ? fs::path() : fs::path(*imageDirectory);
 
     if (directory.is_relative())
         directory = path / directory;
@@ -353,7 +1067,9 @@ CreateVirtualTexture(const Hash* texParams,
                                             (unsigned int) *baseSplit,
                                             (unsigned int) *tileSize,
                                             tilePrefix,
-                                            tileType);
+                                            tileType,
+                                            tileURL == nullptr ? std::string() : *tileURL,
+                                            maxLevel);
 }
 
 
@@ -9,12 +9,17 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include <celcompat/filesystem.h>
 #include <celengine/texture.h>
 
+class TileCache;
 
 class VirtualTexture : public Texture
 {
@@ -23,8 +28,10 @@ class VirtualTexture : public Texture
                    unsigned int _baseSplit,
                    unsigned int _tileSize,
                    const std::string& _tilePrefix,
-                   const std::string& _tileType);
-    ~VirtualTexture() = default;
+                   const std::string& _tileType,
+                   const std::string& _tileURL = {},
+                   unsigned int _maxLevel = 0);
+    ~VirtualTexture();
 
     const TextureTile getTile(int lod, int u, int v) override;
     void bind() override;
@@ -35,15 +42,68 @@ class VirtualTexture : public Texture
     void beginUsage() override;
     void endUsage() override;
 
+    // The tiles of all virtual textures share a budget of video memory.
+    // Tiles which haven't been drawn lately are evicted, highest level of
+    // detail first, to keep within it.
+    static void setMemoryBudget(std::size_t bytes);
+    static std::size_t getResidentSize();
+
+    // Read and decode the tiles of all virtual textures on nThreads
+    // threads. Until a tile is loaded, the nearest coarser tile already
+    // loaded stands in for it. With zero threads, tiles are loaded when drawn.
+    static void setLoadingThreads(unsigned int nThreads);
+    // Load the tiles when drawn even with loading threads, as while
+    // recording a movie
+    static void setForceSynchronous(bool force);
+    // Keep the downloaded tiles of remote virtual textures in the
+    // directory, using up to maxSize bytes of disk space. Must be set
+    // before any tiles are loaded; without it remote tiles aren't loaded.
+    static void setTileCache(const fs::path& directory, std::uintmax_t maxSize);
+
  private:
     struct Tile
     {
         Tile() = default;
-        unsigned int lastUsed{ 0 };
+        // Value of usageClock when the tile was last drawn
+        std::uint32_t lastUsed{ 0 };
+        // Tiles without mipmaps are kept in an atlas, in slot atlasSlot,
+        // the others in their own texture
         ImageTexture* tex{ nullptr };
+        TextureAtlas* atlas{ nullptr };
+        int atlasSlot{ -1 };
+        std::size_t size{ 0 };
+        unsigned int lod{ 0 };
+        // Priority of the pending load request, negative if none
+        float queuedPriority{ -1.0f };
         bool loadFailed{ false };
+
+        bool isResident() const { return tex != nullptr || atlas != nullptr; }
+    };
+
+    struct TileLocation
+    {
+        unsigned int lod;
+        unsigned int u;
+        unsigned int v;
+    };
+
+    struct LoadedTile
+    {
+        Tile* tile;
+        unsigned int lod;
+        std::unique_ptr<Image> image;
+    };
+
+    // Tiles decoded by the loader threads; shared with them, so that it
+    // outlives a texture destroyed with loads pending
+    struct LoadedTiles
+    {
+        std::mutex mutex;
+        std::vector<LoadedTile> tiles;
     };
 
+    class TileLoader;
+
     struct TileQuadtreeNode
     {
         TileQuadtreeNode() = default;
@@ -52,9 +112,22 @@ class VirtualTexture : public Texture
     };
 
     void populateTileTree();
+    bool loadTileIndex(unsigned int& maxLevel);
     void addTileToTree(Tile* tile, unsigned int lod, unsigned int u, unsigned int v);
+    Tile* addRemoteTile(unsigned int lod, unsigned int u, unsigned int v);
     void makeResident(Tile* tile, unsigned int lod, unsigned int u, unsigned int v);
-    ImageTexture* loadTileTexture(unsigned int lod, unsigned int u, unsigned int v);
+    void requestTile(Tile* tile, unsigned int lod, unsigned int u, unsigned int v, float priority);
+    void finishLoadedTiles();
+    void prefetchTiles();
+    bool prefetchTile(unsigned int lod, unsigned int u, unsigned int v);
+    fs::path getTileFilePath(unsigned int lod, unsigned int u, unsigned int v) const;
+    std::string getTileURL(unsigned int lod, unsigned int u, unsigned int v) const;
+    static std::unique_ptr<Image> loadTileImage(const fs::path& path, const std::string& url);
+    void addTileTexture(Tile* tile, unsigned int lod, const Image* img);
+    bool addToAtlas(Tile* tile, const Image& img);
+    void evict(Tile* tile);
+    static void evictTiles(std::size_t needed);
+    static void deleteTileTree(TileQuadtreeNode* node);
 
     Tile* tiles{ nullptr };
     Tile* findTile(unsigned int lod,
@@ -64,6 +137,8 @@ class VirtualTexture : public Texture
     fs::path tilePath;
     fs::path tileExt;
     std::string tilePrefix;
+    // URL template of the tiles of remote textures, empty for local ones
+    std::string tileURL;
     unsigned int baseSplit{ 0 };
     unsigned int tileSize{ 0 };
     unsigned int ticks{ 0 };
@@ -77,6 +152,29 @@ class VirtualTexture : public Texture
     };
 
     TileQuadtreeNode* tileTree[2];
+    std::vector<Tile*> residentTiles;
+    std::vector<std::unique_ptr<TextureAtlas>> atlases;
+
+    std::shared_ptr<LoadedTiles> loadedTiles;
+    // Tiles drawn since beginUsage(), in the levels they were drawn at
+    std::vector<TileLocation> drawnTiles;
+    // Mean position of the finest tiles drawn in the previous frame, in
+    // tiles of that level
+    double lastCenterU{ 0.0 };
+    double lastCenterV{ 0.0 };
+    unsigned int lastFinestLOD{ 0 };
+    // Frames left to prefetch the next level of detail after zooming in
+    unsigned int zoomFrames{ 0 };
+
+    static std::unique_ptr<TileLoader> loader;
+    static bool forceSynchronous;
+    static std::unique_ptr<TileCache> tileCache;
+    static std::vector<VirtualTexture*> instances;
+    static std::size_t memoryBudget;
+    static std::size_t residentSize;
+    // Counts the beginUsage() calls of all virtual textures, as a clock
+    // shared by the tiles of all of them
+    static std::uint32_t usageClock;
 };
 
 
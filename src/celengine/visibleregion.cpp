@@ -25,6 +25,8 @@ using namespace Eigen;
 using namespace celmath;
 using celestia::render::LineRenderer;
 
+LineRenderer *VisibleRegion::outlineRenderer = nullptr;
+
 
 /*! Construct a new reference mark that shows the outline of the
  *  region on the surface of a body in which the target object is
@@ -76,6 +78,8 @@ VisibleRegion::setOpacity(float opacity)
 
 
 constexpr const unsigned maxSections = 360;
+// Greatest error of the cached outline, in pixels
+constexpr const double maxOutlineError = 0.25;
 
 void
 VisibleRegion::render(Renderer* renderer,
@@ -106,9 +110,12 @@ VisibleRegion::render(Renderer* renderer,
         return;
     opacity = min(opacity, 1.0f) * m_opacity;
 
-    // Base the amount of subdivision on the apparent size
+    // Base the amount of subdivision on the apparent size; a finer outline
+    // is kept until it has twice the sections needed
     auto nSections = (unsigned int) (30.0f + discSizeInPixels * 0.5f);
     nSections = min(nSections, maxSections);
+    if (m_outlineSections >= nSections && m_outlineSections <= nSections * 2)
+        nSections = m_outlineSections;
 
     Quaterniond q = m_body.getEclipticToBodyFixed(tdb);
     Quaternionf qf = q.cast<float>();
@@ -134,31 +141,50 @@ VisibleRegion::render(Renderer* renderer,
     if (lightDir.norm() > 10000.0)
         lightDir *= (10000.0 / lightDir.norm());
 
-    // Pick two orthogonal axes both normal to the light direction
-    Vector3d lightDirNorm = lightDir.normalized();
-
-    Vector3d uAxis = lightDirNorm.unitOrthogonal();
-    Vector3d vAxis = uAxis.cross(lightDirNorm);
+    // A change of the target direction by an angle moves the outline by up
+    // to that angle times the radius, i.e. half of the disc size in pixels
+    double tolerance = 2.0 * maxOutlineError / discSizeInPixels;
+    if (nSections != m_outlineSections
+        || semiAxes != m_outlineSemiAxes
+        || (lightDir - m_outlineTargetDir).norm() > tolerance * lightDir.norm())
+    {
+        // Pick two orthogonal axes both normal to the light direction
+        Vector3d lightDirNorm = lightDir.normalized();
+
+        Vector3d uAxis = lightDirNorm.unitOrthogonal();
+        Vector3d vAxis = uAxis.cross(lightDirNorm);
+
+        Vector3d recipSemiAxes = maxSemiAxis * semiAxes.cast<double>().cwiseInverse();
+        Vector3d e = -lightDir;
+        Vector3d e_ = e.cwiseProduct(recipSemiAxes);
+        double ee = e_.squaredNorm();
+
+        m_outline.clear();
+        for (unsigned i = 0; i <= nSections + 1; i++)
+        {
+            double theta = (double) i / (double) (nSections) * 2.0 * celestia::numbers::pi;
+            Vector3d w = cos(theta) * uAxis + sin(theta) * vAxis;
+
+            Vector3d toCenter = ellipsoidTangent(recipSemiAxes, w, e, e_, ee);
+            toCenter *= maxSemiAxis;
+            m_outline.push_back(toCenter.cast<float>());
+        }
+
+        m_outlineTargetDir = lightDir;
+        m_outlineSemiAxes = semiAxes;
+        m_outlineSections = nSections;
+    }
 
-    Vector3d recipSemiAxes = maxSemiAxis * semiAxes.cast<double>().cwiseInverse();
-    Vector3d e = -lightDir;
-    Vector3d e_ = e.cwiseProduct(recipSemiAxes);
-    double ee = e_.squaredNorm();
+    if (outlineRenderer == nullptr)
+        outlineRenderer = new LineRenderer(*renderer, 1.0f, LineRenderer::PrimType::LineStrip);
 
-    LineRenderer lr(*renderer, 1.0f, LineRenderer::PrimType::LineStrip);
+    LineRenderer& lr = *outlineRenderer;
+    lr.clear();
     lr.startUpdate();
+    for (const Vector3f& v : m_outline)
+        lr.addVertex(v);
 
-    for (unsigned i = 0; i <= nSections + 1; i++)
-    {
-        double theta = (double) i / (double) (nSections) * 2.0 * celestia::numbers::pi;
-        Vector3d w = cos(theta) * uAxis + sin(theta) * vAxis;
-
-        Vector3d toCenter = ellipsoidTangent(recipSemiAxes, w, e, e_, ee);
-        toCenter *= maxSemiAxis * scale;
-        lr.addVertex(Vector3f(toCenter.cast<float>()));
-    }
-
-    Affine3f transform = Translation3f(position) * qf.conjugate();
+    Affine3f transform = Translation3f(position) * qf.conjugate() * Scaling(scale);
     Matrix4f modelView = (*m.modelview) * transform.matrix();
 
     Renderer::PipelineState ps;
@@ -179,3 +205,11 @@ VisibleRegion::boundingSphereRadius() const
 {
     return m_body.getRadius();
 }
+
+
+void
+VisibleRegion::deinit()
+{
+    delete outlineRenderer;
+    outlineRenderer = nullptr;
+}
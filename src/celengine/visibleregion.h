@@ -13,11 +13,17 @@
 #ifndef _CELENGINE_VISIBLEREGION_H_
 #define _CELENGINE_VISIBLEREGION_H_
 
+#include <vector>
+#include <Eigen/Core>
 #include <celengine/referencemark.h>
 #include <celengine/selection.h>
 #include <celutil/color.h>
 
 class Body;
+namespace celestia::render
+{
+class LineRenderer;
+}
 
 
 /*! VisibleRegion is a reference mark that shows the outline of
@@ -42,11 +48,25 @@ public:
     float opacity() const;
     void setOpacity(float opacity);
 
+    static void deinit();
+
 private:
     const Body& m_body;
     const Selection m_target;
     Color m_color;
     float m_opacity;
+
+    // The outline in body-fixed coordinates, computed anew only once the
+    // direction or distance of the target, seen from the body, has moved
+    // it by a fraction of a pixel, or once more sections are needed.
+    mutable std::vector<Eigen::Vector3f> m_outline;
+    mutable Eigen::Vector3d m_outlineTargetDir{ Eigen::Vector3d::Zero() };
+    mutable Eigen::Vector3f m_outlineSemiAxes{ Eigen::Vector3f::Zero() };
+    mutable unsigned int m_outlineSections{ 0 };
+
+    // Shared by all visible regions, so that its buffer is kept from frame
+    // to frame
+    static celestia::render::LineRenderer *outlineRenderer;
 };
 
 #endif // _CELENGINE_TERMINATOR_H_
@@ -0,0 +1,463 @@
+// chebyshevorbit.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Serves positions of expensive orbits from piecewise Chebyshev fits.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "chebyshevorbit.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <celcompat/numbers.h>
+
+namespace celestia::ephem
+{
+
+namespace
+{
+
+// Degree of the fitted polynomials
+constexpr unsigned int Degree = 12;
+// Number of times a window may be halved to meet the tolerance
+constexpr unsigned int MaxDepth = 8;
+// Largest error, relative to the tolerance, considered as noise
+constexpr double NoiseLimit = 100.0;
+// Windows kept for each orbit besides the precomputed ones; the ones
+// farthest from the window in use are dropped first.
+constexpr std::size_t MaxWindows = 256;
+
+constexpr double WindowOrigin = 2451545.0;
+
+using Coefficients = std::array<Eigen::Vector3d, Degree + 1>;
+
+struct Piece
+{
+    double t0;
+    double t1;
+    Coefficients position;
+    // Coefficients of the derivative with respect to the normalized time
+    Coefficients velocity;
+};
+
+// Pieces covering a window, in order of time
+using Window = std::vector<Piece>;
+
+// Clenshaw evaluation of the sum of coefficients[k] * T_k(u)
+Eigen::Vector3d
+evaluateSeries(const Coefficients& coefficients, double u)
+{
+    Eigen::Vector3d b1 = Eigen::Vector3d::Zero();
+    Eigen::Vector3d b2 = Eigen::Vector3d::Zero();
+    for (unsigned int k = Degree; k >= 1; k--)
+    {
+        Eigen::Vector3d b0 = coefficients[k] + 2.0 * u * b1 - b2;
+        b2 = b1;
+        b1 = b0;
+    }
+
+    return coefficients[0] + u * b1 - b2;
+}
+
+// Fit [t0, t1] by interpolating at the Chebyshev nodes
+Piece
+fitPiece(const Orbit& source, double t0, double t1)
+{
+    constexpr unsigned int N = Degree + 1;
+    double mid = 0.5 * (t0 + t1);
+    double half = 0.5 * (t1 - t0);
+
+    std::array<Eigen::Vector3d, N> values;
+    for (unsigned int j = 0; j < N; j++)
+    {
+        double x = std::cos(celestia::numbers::pi * (j + 0.5) / N);
+        values[j] = source.positionAtTime(mid + half * x);
+    }
+
+    Piece piece;
+    piece.t0 = t0;
+    piece.t1 = t1;
+    for (unsigned int k = 0; k < N; k++)
+    {
+        Eigen::Vector3d c = Eigen::Vector3d::Zero();
+        for (unsigned int j = 0; j < N; j++)
+            c += values[j] * std::cos(celestia::numbers::pi * k * (j + 0.5) / N);
+        piece.position[k] = c * (k == 0 ? 1.0 / N : 2.0 / N);
+    }
+
+    // c'[k - 1] = c'[k + 1] + 2k c[k], with the constant term halved
+    piece.velocity[Degree] = Eigen::Vector3d::Zero();
+    Eigen::Vector3d next = Eigen::Vector3d::Zero();
+    for (unsigned int k = Degree; k >= 1; k--)
+    {
+        Eigen::Vector3d d = next + 2.0 * k * piece.position[k];
+        next = piece.velocity[k];
+        piece.velocity[k - 1] = d;
+    }
+    piece.velocity[0] *= 0.5;
+
+    return piece;
+}
+
+// Largest distance between the fit and the source at the extrema of the
+// Chebyshev polynomial of the fitted degree + 1, which lie between the
+// nodes and include the ends of the piece.
+double
+getFitError(const Orbit& source, const Piece& piece)
+{
+    double mid = 0.5 * (piece.t0 + piece.t1);
+    double half = 0.5 * (piece.t1 - piece.t0);
+    double maxError = 0.0;
+    for (unsigned int j = 0; j <= Degree + 1; j++)
+    {
+        double x = std::cos(celestia::numbers::pi * j / (Degree + 1));
+        Eigen::Vector3d error = evaluateSeries(piece.position, x) - source.positionAtTime(mid + half * x);
+        maxError = std::max(maxError, error.norm());
+    }
+
+    return maxError;
+}
+
+// Halve the range until the fits are within the tolerance. Halving reduces
+// the error of smooth orbits by orders of magnitude; when it doesn't and the
+// error is close to the tolerance, the error comes from rounding noise in
+// the source, and the fit of the whole range is kept. Larger errors are from
+// discontinuities, which are confined to ever shorter pieces.
+void
+fitRange(const Orbit& source, const Piece& piece, double error, double tolerance, unsigned int depth, Window& window)
+{
+    if (depth < MaxDepth && error > tolerance)
+    {
+        double mid = 0.5 * (piece.t0 + piece.t1);
+        Piece first = fitPiece(source, piece.t0, mid);
+        Piece second = fitPiece(source, mid, piece.t1);
+        double firstError = getFitError(source, first);
+        double secondError = getFitError(source, second);
+        if (std::max(firstError, secondError) < 0.5 * error || error > NoiseLimit * tolerance)
+        {
+            fitRange(source, first, firstError, tolerance, depth + 1, window);
+            fitRange(source, second, secondError, tolerance, depth + 1, window);
+            return;
+        }
+    }
+
+    window.push_back(piece);
+}
+
+} // end unnamed namespace
+
+
+class ChebyshevOrbit::Fitter : public std::enable_shared_from_this<ChebyshevOrbit::Fitter>
+{
+ public:
+    Fitter(std::unique_ptr<Orbit>&& _source, double _windowLength, double _tolerance) :
+        source(std::move(_source)),
+        windowLength(_windowLength),
+        tolerance(_tolerance)
+    {
+    }
+
+    const Orbit& getSource() const { return *source; }
+
+    // Evaluate the fit, or its derivative, at jd
+    Eigen::Vector3d evaluate(double jd, bool derivative);
+
+    // Fit the window unless it's already there
+    void fitWindow(std::int64_t index);
+
+    void precompute(double begin, double end);
+
+ private:
+    std::int64_t getWindowIndex(double jd) const
+    {
+        return static_cast<std::int64_t>(std::floor((jd - origin) / windowLength));
+    }
+
+    bool isPinned(std::int64_t index) const
+    {
+        return index >= pinnedBegin && index < pinnedEnd;
+    }
+
+    // Queue the neighbours of the window for the background thread; called
+    // with windowMutex held.
+    void prefetch(std::int64_t index);
+
+    std::unique_ptr<Orbit> source;
+    double windowLength;
+    double tolerance;
+    double origin{ WindowOrigin };
+
+    // Precomputed windows, which are never dropped
+    std::int64_t pinnedBegin{ 0 };
+    std::int64_t pinnedEnd{ 0 };
+
+    // Held while evaluating the source
+    std::mutex sourceMutex;
+
+    // Held while accessing the windows
+    std::mutex windowMutex;
+    std::map<std::int64_t, Window> windows;
+    std::set<std::int64_t> pending;
+    std::int64_t lastIndex{ 0 };
+    const Window* lastWindow{ nullptr };
+};
+
+
+namespace
+{
+
+// A thread fitting windows ahead of their use for all ChebyshevOrbits
+class FitQueue
+{
+ public:
+    static FitQueue& get()
+    {
+        static FitQueue queue;
+        return queue;
+    }
+
+    ~FitQueue()
+    {
+        {
+            std::scoped_lock lock(mutex);
+            stopRequested = true;
+        }
+        requestReady.notify_all();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    void request(std::weak_ptr<ChebyshevOrbit::Fitter> fitter, std::int64_t index)
+    {
+        {
+            std::scoped_lock lock(mutex);
+            requests.emplace_back(std::move(fitter), index);
+            if (!worker.joinable())
+                worker = std::thread(&FitQueue::run, this);
+        }
+        requestReady.notify_one();
+    }
+
+ private:
+    FitQueue() = default;
+
+    void run()
+    {
+        for (;;)
+        {
+            std::pair<std::weak_ptr<ChebyshevOrbit::Fitter>, std::int64_t> request;
+            {
+                std::unique_lock lock(mutex);
+                requestReady.wait(lock, [this] { return stopRequested || !requests.empty(); });
+                if (stopRequested)
+                    return;
+                request = std::move(requests.front());
+                requests.pop_front();
+            }
+
+            // Orbits destroyed since the request are skipped
+            if (auto fitter = request.first.lock(); fitter != nullptr)
+                fitter->fitWindow(request.second);
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable requestReady;
+    std::deque<std::pair<std::weak_ptr<ChebyshevOrbit::Fitter>, std::int64_t>> requests;
+    bool stopRequested{ false };
+    std::thread worker;
+};
+
+} // end unnamed namespace
+
+
+void
+ChebyshevOrbit::Fitter::prefetch(std::int64_t index)
+{
+    for (std::int64_t neighbour : { index + 1, index - 1 })
+    {
+        if (windows.count(neighbour) == 0 && pending.insert(neighbour).second)
+            FitQueue::get().request(weak_from_this(), neighbour);
+    }
+}
+
+
+void
+ChebyshevOrbit::Fitter::fitWindow(std::int64_t index)
+{
+    std::scoped_lock sourceLock(sourceMutex);
+    {
+        std::scoped_lock lock(windowMutex);
+        if (windows.count(index) != 0)
+        {
+            pending.erase(index);
+            return;
+        }
+    }
+
+    double t0 = origin + static_cast<double>(index) * windowLength;
+    Piece piece = fitPiece(*source, t0, t0 + windowLength);
+    Window window;
+    fitRange(*source, piece, getFitError(*source, piece), tolerance, 0, window);
+
+    std::scoped_lock lock(windowMutex);
+    pending.erase(index);
+    if (windows.size() >= MaxWindows + static_cast<std::size_t>(pinnedEnd - pinnedBegin))
+    {
+        // Drop the window farthest from the one in use. The pinned windows
+        // are contiguous, so at least one of the ends isn't pinned.
+        auto first = windows.begin();
+        auto last = std::prev(windows.end());
+        auto farthest = (lastIndex - first->first) > (last->first - lastIndex) ? first : last;
+        if (isPinned(farthest->first))
+            farthest = farthest == first ? last : first;
+        if (&farthest->second == lastWindow)
+            lastWindow = nullptr;
+        windows.erase(farthest);
+    }
+    windows.emplace(index, std::move(window));
+}
+
+
+void
+ChebyshevOrbit::Fitter::precompute(double begin, double end)
+{
+    auto count = std::max(static_cast<std::int64_t>(1),
+                          static_cast<std::int64_t>(std::ceil((end - begin) / windowLength)));
+    {
+        std::scoped_lock lock(windowMutex);
+        assert(windows.empty());
+        if (end > begin)
+            windowLength = (end - begin) / static_cast<double>(count);
+        origin = begin;
+        pinnedBegin = 0;
+        pinnedEnd = count;
+        for (std::int64_t index = 0; index < count; index++)
+            pending.insert(index);
+    }
+
+    for (std::int64_t index = 0; index < count; index++)
+        FitQueue::get().request(weak_from_this(), index);
+}
+
+
+Eigen::Vector3d
+ChebyshevOrbit::Fitter::evaluate(double jd, bool derivative)
+{
+    std::int64_t index = getWindowIndex(jd);
+
+    std::unique_lock lock(windowMutex);
+    if (lastWindow == nullptr || index != lastIndex)
+    {
+        // Another thread may drop the window again before we get it back
+        auto it = windows.find(index);
+        while (it == windows.end())
+        {
+            lock.unlock();
+            fitWindow(index);
+            lock.lock();
+            it = windows.find(index);
+        }
+
+        lastIndex = index;
+        lastWindow = &it->second;
+        prefetch(index);
+    }
+
+    // Pieces are few, so a linear search is fine
+    const Window& window = *lastWindow;
+    auto piece = window.begin();
+    while (piece + 1 != window.end() && jd >= piece->t1)
+        ++piece;
+
+    double half = 0.5 * (piece->t1 - piece->t0);
+    double u = (jd - piece->t0) / half - 1.0;
+    if (derivative)
+        return evaluateSeries(piece->velocity, u) / half;
+    return evaluateSeries(piece->position, u);
+}
+
+
+ChebyshevOrbit::ChebyshevOrbit(std::unique_ptr<Orbit>&& source, double windowLength, double tolerance) :
+    fitter(std::make_shared<Fitter>(std::move(source), windowLength, tolerance))
+{
+    assert(windowLength > 0.0);
+}
+
+ChebyshevOrbit::~ChebyshevOrbit() = default;
+
+void
+ChebyshevOrbit::precompute(double begin, double end)
+{
+    fitter->precompute(begin, end);
+}
+
+Eigen::Vector3d
+ChebyshevOrbit::positionAtTime(double jd) const
+{
+    return fitter->evaluate(jd, false);
+}
+
+Eigen::Vector3d
+ChebyshevOrbit::velocityAtTime(double jd) const
+{
+    return fitter->evaluate(jd, true);
+}
+
+double
+ChebyshevOrbit::getPeriod() const
+{
+    return fitter->getSource().getPeriod();
+}
+
+double
+ChebyshevOrbit::getBoundingRadius() const
+{
+    return fitter->getSource().getBoundingRadius();
+}
+
+bool
+ChebyshevOrbit::isPeriodic() const
+{
+    return fitter->getSource().isPeriodic();
+}
+
+void
+ChebyshevOrbit::getValidRange(double& begin, double& end) const
+{
+    fitter->getSource().getValidRange(begin, end);
+}
+
+
+std::unique_ptr<Orbit>
+CreateChebyshevOrbit(std::unique_ptr<Orbit>&& source)
+{
+    if (source == nullptr)
+        return nullptr;
+
+    // Orbits without a period are mostly planetary perturbations, which
+    // change over a few years at the fastest.
+    double period = source->getPeriod();
+    double windowLength = period > 0.0 ? period / 16.0 : 64.0;
+    double tolerance = source->getBoundingRadius() * 1.0e-8;
+    return std::make_unique<ChebyshevOrbit>(std::move(source), windowLength, tolerance);
+}
+
+} // end namespace celestia::ephem
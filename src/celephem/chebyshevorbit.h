@@ -0,0 +1,62 @@
+// chebyshevorbit.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Serves positions of expensive orbits from piecewise Chebyshev fits.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <memory>
+
+#include <Eigen/Core>
+
+#include "orbit.h"
+
+namespace celestia::ephem
+{
+
+/*! An orbit computed from Chebyshev polynomials fitted to a source orbit.
+ *  Time is split into windows of a fixed length, which are fitted when
+ *  they are first used; the neighbours of a window in use are fitted
+ *  ahead on a background thread. Within a window the fits are subdivided
+ *  until they are within the tolerance of the source at the Chebyshev
+ *  extrema. Velocities are the derivatives of the fits.
+ *
+ *  The source is only evaluated while holding a lock, so a ChebyshevOrbit
+ *  is thread safe even if its source isn't.
+ */
+class ChebyshevOrbit : public Orbit
+{
+ public:
+    ChebyshevOrbit(std::unique_ptr<Orbit>&& source, double windowLength, double tolerance);
+    ~ChebyshevOrbit() override;
+
+    // Fit all of [begin, end] on the background thread and keep it fitted,
+    // with windows adjusted to start and end on its bounds. Must be called
+    // before the orbit is first used.
+    void precompute(double begin, double end);
+
+    Eigen::Vector3d positionAtTime(double jd) const override;
+    Eigen::Vector3d velocityAtTime(double jd) const override;
+    double getPeriod() const override;
+    double getBoundingRadius() const override;
+    bool isPeriodic() const override;
+    bool isThreadSafe() const override { return true; }
+    void getValidRange(double& begin, double& end) const override;
+
+    class Fitter;
+
+ private:
+    std::shared_ptr<Fitter> fitter;
+};
+
+// Wrap the orbit with windows a sixteenth of its period long and a
+// tolerance of 1e-8 of its bounding radius.
+std::unique_ptr<Orbit> CreateChebyshevOrbit(std::unique_ptr<Orbit>&& source);
+
+} // end namespace celestia::ephem
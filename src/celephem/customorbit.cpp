@@ -13,7 +13,6 @@
 #include <cassert>
 #include <cstddef>
 #include <cmath>
-#include <fstream>
 #include <initializer_list>
 #include <map>
 #include <memory>
@@ -24,6 +23,7 @@
 #include <celmath/mathlib.h>
 #include <celmath/geomutil.h>
 #include <celutil/logger.h>
+#include "chebyshevorbit.h"
 #include "customorbittype.h"
 #include "jpleph.h"
 #include "orbit.h"
@@ -145,17 +145,20 @@ class PlanetOrbitMixin
 protected:
     constexpr PlanetOrbitMixin() noexcept = default;
 
-    static std::array<PlanetElements, 8> gPlanetElements;
-    void computePlanetElements(double, const int*, std::size_t) const;
-    void computePlanetCoords(int p, double map, double da, double dhl, double dl,
+    // The elements are computed into storage of the caller, so that
+    // several threads can evaluate the same orbit
+    using PlanetElementsArray = std::array<PlanetElements, 8>;
+
+    void computePlanetElements(double, const int*, std::size_t, PlanetElementsArray&) const;
+    void computePlanetCoords(const PlanetElementsArray& elements,
+                             int p, double map, double da, double dhl, double dl,
                              double dm, double dml, double dr, double ds,
                              double& eclLong, double& eclLat, double& distance) const;
 };
 
-std::array<PlanetElements, 8> PlanetOrbitMixin::gPlanetElements{ };
-
 void
-PlanetOrbitMixin::computePlanetElements(double t, const int* pList, std::size_t npList) const
+PlanetOrbitMixin::computePlanetElements(double t, const int* pList, std::size_t npList,
+                                        PlanetElementsArray& elements) const
 {
     // Parameter t represents the Julian centuries elapsed since 1900.
     // In other words, t = (jd - 2415020.0) / 36525.0
@@ -163,7 +166,7 @@ PlanetOrbitMixin::computePlanetElements(double t, const int* pList, std::size_t
     {
         int planet = pList[i];
         const StaticElements& ep = gElements[planet];
-        PlanetElements& pp = gPlanetElements[planet];
+        PlanetElements& pp = elements[planet];
         double aa = ep[1]*t;
         pp[0] = ep[0] + 360*(aa-(int)aa) + (ep[3]*t + ep[2])*t*t;
         pp[0] = celmath::pfmod(pp[0], 360.0);
@@ -179,22 +182,23 @@ PlanetOrbitMixin::computePlanetElements(double t, const int* pList, std::size_t
 }
 
 void
-PlanetOrbitMixin::computePlanetCoords(int p, double map, double da, double dhl, double dl,
+PlanetOrbitMixin::computePlanetCoords(const PlanetElementsArray& elements,
+                                      int p, double map, double da, double dhl, double dl,
                                       double dm, double dml, double dr, double ds,
                                       double& eclLong, double& eclLat, double& distance) const
 {
     double s, ma, nu, ea, lp, om, lo, slo, clo, inc, spsi, y;
 
-    s = gPlanetElements[p][3] + ds;
+    s = elements[p][3] + ds;
     ma = map + dm;
     astro::anomaly(ma, s, nu, ea);
-    distance = (gPlanetElements[p][6] + da)*(1 - s*s)/(1 + s*std::cos(nu));
-    lp = celmath::radToDeg(nu) + gPlanetElements[p][2] + celmath::radToDeg(dml - dm);
+    distance = (elements[p][6] + da)*(1 - s*s)/(1 + s*std::cos(nu));
+    lp = celmath::radToDeg(nu) + elements[p][2] + celmath::radToDeg(dml - dm);
     lp = celmath::degToRad(lp);
-    om = celmath::degToRad(gPlanetElements[p][5]);
+    om = celmath::degToRad(elements[p][5]);
     lo = lp - om;
     celmath::sincos(lo, slo, clo);
-    inc = celmath::degToRad(gPlanetElements[p][4]);
+    inc = celmath::degToRad(elements[p][4]);
     distance += dr;
     spsi = slo*std::sin(inc);
     y = slo*std::cos(inc);
@@ -441,13 +445,14 @@ class MercuryOrbit : public CachingOrbit, private PlanetOrbitMixin
         // Calculate the Julian centuries elapsed since 1900
         t = (jd - 2415020.0)/36525.0;
 
-        computePlanetElements(t, pList.data(), pList.size());
+        PlanetElementsArray elements;
+        computePlanetElements(t, pList.data(), pList.size(), elements);
 
         // Compute necessary planet mean anomalies
-        map[0] = celmath::degToRad(gPlanetElements[0][0] - gPlanetElements[0][2]);
-        map[1] = celmath::degToRad(gPlanetElements[1][0] - gPlanetElements[1][2]);
+        map[0] = celmath::degToRad(elements[0][0] - elements[0][2]);
+        map[1] = celmath::degToRad(elements[1][0] - elements[1][2]);
         map[2] = 0.0;
-        map[3] = celmath::degToRad(gPlanetElements[3][0] - gPlanetElements[3][2]);
+        map[3] = celmath::degToRad(elements[3][0] - elements[3][2]);
 
         // Compute perturbations
         dl = 2.04e-3*std::cos(5*map[1]-2*map[0]+2.1328e-1)+
@@ -460,7 +465,7 @@ class MercuryOrbit : public CachingOrbit, private PlanetOrbitMixin
              5.457e-6*std::cos(2*map[1]-2*map[0]-1.24246)+
              3.569e-6*std::cos(5*map[1]-map[0]-1.35699);
 
-        computePlanetCoords(p, map[p], da, dhl, dl, dm, dml, dr, ds,
+        computePlanetCoords(elements, p, map[p], da, dhl, dl, dm, dml, dr, ds,
                             eclLong, eclLat, distance);
 
         // Corrections for internal coordinate system
@@ -504,13 +509,14 @@ class VenusOrbit : public CachingOrbit, private PlanetOrbitMixin
 
         mas = meanAnomalySun(t);
 
-        computePlanetElements(t, pList.data(), pList.size());
+        PlanetElementsArray elements;
+        computePlanetElements(t, pList.data(), pList.size(), elements);
 
         //Compute necessary planet mean anomalies
         map[0] = 0.0;
-        map[1] = celmath::degToRad(gPlanetElements[1][0] - gPlanetElements[1][2]);
+        map[1] = celmath::degToRad(elements[1][0] - elements[1][2]);
         map[2] = 0.0;
-        map[3] = celmath::degToRad(gPlanetElements[3][0] - gPlanetElements[3][2]);
+        map[3] = celmath::degToRad(elements[3][0] - elements[3][2]);
 
         //Compute perturbations
         dml = celmath::degToRad(7.7e-4*std::sin(4.1406+t*2.6227));
@@ -530,7 +536,7 @@ class VenusOrbit : public CachingOrbit, private PlanetOrbitMixin
              3.283e-6*std::cos(4*mas-4*map[1]+1.10851)+
              3.074e-6*std::cos(2*map[3]-2*map[1]-9.62846e-1);
 
-        computePlanetCoords(p, map[p], da, dhl, dl, dm, dml, dr, ds,
+        computePlanetCoords(elements, p, map[p], da, dhl, dl, dm, dml, dr, ds,
                             eclLong, eclLat, distance);
 
         //Corrections for internal coordinate system
@@ -807,13 +813,14 @@ class MarsOrbit : public CachingOrbit, private PlanetOrbitMixin
 
         mas = meanAnomalySun(t);
 
-        computePlanetElements(t, pList.data(), pList.size());
+        PlanetElementsArray elements;
+        computePlanetElements(t, pList.data(), pList.size(), elements);
 
         //Compute necessary planet mean anomalies
         map[0] = 0.0;
-        map[1] = celmath::degToRad(gPlanetElements[1][0] - gPlanetElements[1][2]);
-        map[2] = celmath::degToRad(gPlanetElements[2][0] - gPlanetElements[2][2]);
-        map[3] = celmath::degToRad(gPlanetElements[3][0] - gPlanetElements[3][2]);
+        map[1] = celmath::degToRad(elements[1][0] - elements[1][2]);
+        map[2] = celmath::degToRad(elements[2][0] - elements[2][2]);
+        map[3] = celmath::degToRad(elements[3][0] - elements[3][2]);
 
         //Compute perturbations
         a = 3*map[3]-8*map[2]+4*mas;
@@ -843,7 +850,7 @@ class MarsOrbit : public CachingOrbit, private PlanetOrbitMixin
              4.571e-6*std::cos(2*mas-4*map[2]+4.27086)+
              4.409e-6*std::cos(3*map[3]-map[2]-2.02158);
 
-        computePlanetCoords(p, map[p], da, dhl, dl, dm, dml, dr, ds,
+        computePlanetCoords(elements, p, map[p], da, dhl, dl, dm, dml, dr, ds,
                             eclLong, eclLat, distance);
 
         //Corrections for internal coordinate system
@@ -890,12 +897,13 @@ class JupiterOrbit : public CachingOrbit, private PlanetOrbitMixin
         //Calculate the Julian centuries elapsed since 1900
         t = (jd - 2415020.0)/36525.0;
 
-        computePlanetElements(t, pList.data(), pList.size());
+        PlanetElementsArray elements;
+        computePlanetElements(t, pList.data(), pList.size(), elements);
 
-        map = celmath::degToRad(gPlanetElements[p][0] - gPlanetElements[p][2]);
+        map = celmath::degToRad(elements[p][0] - elements[p][2]);
 
         //Compute perturbations
-        s = gPlanetElements[p][3];
+        s = elements[p][3];
         auxJSun(t, &x1, &x2, &x3, &x4, &x5, &x6);
         x7 = x3-x2;
         celmath::sincos(x3, sx3, cx3);
@@ -947,7 +955,7 @@ class JupiterOrbit : public CachingOrbit, private PlanetOrbitMixin
              111*c2x7*cx3;
         da *= 1e-6;
 
-        computePlanetCoords(p, map, da, dhl, dl, dm, dml, dr, ds,
+        computePlanetCoords(elements, p, map, da, dhl, dl, dm, dml, dr, ds,
                             eclLong, eclLat, distance);
 
         //Corrections for internal coordinate system
@@ -995,12 +1003,13 @@ class SaturnOrbit : public CachingOrbit, private PlanetOrbitMixin
         //Calculate the Julian centuries elapsed since 1900
         t = (jd - 2415020.0)/36525.0;
 
-        computePlanetElements(t, pList.data(), pList.size());
+        PlanetElementsArray elements;
+        computePlanetElements(t, pList.data(), pList.size(), elements);
 
-        map = celmath::degToRad(gPlanetElements[p][0] - gPlanetElements[p][2]);
+        map = celmath::degToRad(elements[p][0] - elements[p][2]);
 
         //Compute perturbations
-        s = gPlanetElements[p][3];
+        s = elements[p][3];
         auxJSun(t, &x1, &x2, &x3, &x4, &x5, &x6);
         x7 = x3-x2;
         celmath::sincos(x3, sx3, cx3);
@@ -1074,7 +1083,7 @@ class SaturnOrbit : public CachingOrbit, private PlanetOrbitMixin
               1.261e-3*c2x7*s2x3+1.236e-3*s2x7*c2x3-2.075e-3*c2x7*c2x3;
         dhl = celmath::degToRad(dhl);
 
-        computePlanetCoords(p, map, da, dhl, dl, dm, dml, dr, ds,
+        computePlanetCoords(elements, p, map, da, dhl, dl, dm, dml, dr, ds,
                             eclLong, eclLat, distance);
 
         //Corrections for internal coordinate system
@@ -1121,12 +1130,13 @@ class UranusOrbit : public CachingOrbit, private PlanetOrbitMixin
         //Calculate the Julian centuries elapsed since 1900
         t = (jd - 2415020.0)/36525.0;
 
-        computePlanetElements(t, pList.data(), pList.size());
+        PlanetElementsArray elements;
+        computePlanetElements(t, pList.data(), pList.size(), elements);
 
-        map = celmath::degToRad(gPlanetElements[p][0] - gPlanetElements[p][2]);
+        map = celmath::degToRad(elements[p][0] - elements[p][2]);
 
         //Compute perturbations
-        s = gPlanetElements[p][3];
+        s = elements[p][3];
         auxJSun(t, &x1, &x2, &x3, &x4, &x5, &x6);
         x8 = celmath::pfmod(1.46205+3.81337*t, TWOPI);
         x9 = 2*x8-x4;
@@ -1162,7 +1172,7 @@ class UranusOrbit : public CachingOrbit, private PlanetOrbitMixin
              (1351*cx4+5702*sx4+1388*s2x4)*std::cos(x11);
         dr *= 1e-6;
 
-        computePlanetCoords(p, map, da, dhl, dl, dm, dml, dr, ds,
+        computePlanetCoords(elements, p, map, da, dhl, dl, dm, dml, dr, ds,
                             eclLong, eclLat, distance);
 
         //Corrections for internal coordinate system
@@ -1209,12 +1219,13 @@ class NeptuneOrbit : public CachingOrbit, private PlanetOrbitMixin
         //Calculate the Julian centuries elapsed since 1900
         t = (jd - 2415020.0)/36525.0;
 
-        computePlanetElements(t, pList.data(), pList.size());
+        PlanetElementsArray elements;
+        computePlanetElements(t, pList.data(), pList.size(), elements);
 
-        map = celmath::degToRad(gPlanetElements[p][0] - gPlanetElements[p][2]);
+        map = celmath::degToRad(elements[p][0] - elements[p][2]);
 
         //Compute perturbations
-        s = gPlanetElements[p][3];
+        s = elements[p][3];
         auxJSun(t, &x1, &x2, &x3, &x4, &x5, &x6);
         x8 = celmath::pfmod(1.46205+3.81337*t, TWOPI);
         x9 = 2*x8-x4;
@@ -1241,7 +1252,7 @@ class NeptuneOrbit : public CachingOrbit, private PlanetOrbitMixin
         dr = -40596+4992*std::cos(x10)+2744*std::cos(x11)+2044*std::cos(x12)+1051*c2x12;
         dr *= 1e-6;
 
-        computePlanetCoords(p, map, da, dhl, dl, dm, dml, dr, ds,
+        computePlanetCoords(elements, p, map, da, dhl, dl, dm, dml, dr, ds,
                             eclLong, eclLat, distance);
 
         //Corrections for internal coordinate system
@@ -1282,11 +1293,12 @@ class PlutoOrbit : public CachingOrbit, private PlanetOrbitMixin
         //Calculate the Julian centuries elapsed since 1900
         t = (jd - 2415020.0)/36525.0;
 
-        computePlanetElements(t, pList.data(), pList.size());
+        PlanetElementsArray elements;
+        computePlanetElements(t, pList.data(), pList.size(), elements);
 
-        map = celmath::degToRad(gPlanetElements[p][0] - gPlanetElements[p][2]);
+        map = celmath::degToRad(elements[p][0] - elements[p][2]);
 
-        computePlanetCoords(p, map, da, dhl, dl, dm, dml, dr, ds,
+        computePlanetCoords(elements, p, map, da, dhl, dl, dm, dml, dr, ds,
                             eclLong, eclLat, distance);
 
         //Corrections for internal coordinate system
@@ -3133,9 +3145,7 @@ std::unique_ptr<Orbit> CreateJPLEphOrbit(JPLEphemItem target,
     if (!jplephInitialized)
     {
         jplephInitialized = true;
-        std::ifstream in("data/jpleph.dat", std::ios::in | std::ios::binary);
-        if (in.good())
-            jpleph = JPLEphemeris::load(in);
+        jpleph = JPLEphemeris::load(fs::path("data/jpleph.dat"));
         if (jpleph != nullptr)
         {
             if (unsigned int deNumber = jpleph->getDENumber(); deNumber != 100)
@@ -3364,49 +3374,50 @@ std::unique_ptr<Orbit> GetCustomOrbit(std::string_view name)
     case CustomOrbitType::Htc20Calypso:
         return HTC20Orbit::CreateCalypsoOrbit();
 
-    // various planetary satellite orbits
+    // various planetary satellite orbits; the longer theories are served
+    // from Chebyshev fits
     case CustomOrbitType::Phobos:
         return std::make_unique<PhobosOrbit>();
     case CustomOrbitType::Deimos:
         return std::make_unique<DeimosOrbit>();
     case CustomOrbitType::Io:
-        return std::make_unique<IoOrbit>();
+        return CreateChebyshevOrbit(std::make_unique<IoOrbit>());
     case CustomOrbitType::Europa:
-        return std::make_unique<EuropaOrbit>();
+        return CreateChebyshevOrbit(std::make_unique<EuropaOrbit>());
     case CustomOrbitType::Ganymede:
-        return std::make_unique<GanymedeOrbit>();
+        return CreateChebyshevOrbit(std::make_unique<GanymedeOrbit>());
     case CustomOrbitType::Callisto:
-        return std::make_unique<CallistoOrbit>();
+        return CreateChebyshevOrbit(std::make_unique<CallistoOrbit>());
     case CustomOrbitType::Mimas:
-        return std::make_unique<MimasOrbit>();
+        return CreateChebyshevOrbit(std::make_unique<MimasOrbit>());
     case CustomOrbitType::Enceladus:
-        return std::make_unique<EnceladusOrbit>();
+        return CreateChebyshevOrbit(std::make_unique<EnceladusOrbit>());
     case CustomOrbitType::Tethys:
-        return std::make_unique<TethysOrbit>();
+        return CreateChebyshevOrbit(std::make_unique<TethysOrbit>());
     case CustomOrbitType::Dione:
-        return std::make_unique<DioneOrbit>();
+        return CreateChebyshevOrbit(std::make_unique<DioneOrbit>());
     case CustomOrbitType::Rhea:
-        return std::make_unique<RheaOrbit>();
+        return CreateChebyshevOrbit(std::make_unique<RheaOrbit>());
     case CustomOrbitType::Titan:
-        return std::make_unique<TitanOrbit>();
+        return CreateChebyshevOrbit(std::make_unique<TitanOrbit>());
     case CustomOrbitType::Hyperion:
-        return std::make_unique<HyperionOrbit>();
+        return CreateChebyshevOrbit(std::make_unique<HyperionOrbit>());
     case CustomOrbitType::Iapetus:
-        return std::make_unique<IapetusOrbit>();
+        return CreateChebyshevOrbit(std::make_unique<IapetusOrbit>());
     case CustomOrbitType::Phoebe:
-        return std::make_unique<PhoebeOrbit>();
+        return CreateChebyshevOrbit(std::make_unique<PhoebeOrbit>());
     case CustomOrbitType::Miranda:
-        return CreateUranianSatelliteOrbit(1);
+        return CreateChebyshevOrbit(CreateUranianSatelliteOrbit(1));
     case CustomOrbitType::Ariel:
-        return CreateUranianSatelliteOrbit(2);
+        return CreateChebyshevOrbit(CreateUranianSatelliteOrbit(2));
     case CustomOrbitType::Umbriel:
-        return CreateUranianSatelliteOrbit(3);
+        return CreateChebyshevOrbit(CreateUranianSatelliteOrbit(3));
     case CustomOrbitType::Titania:
-        return CreateUranianSatelliteOrbit(4);
+        return CreateChebyshevOrbit(CreateUranianSatelliteOrbit(4));
     case CustomOrbitType::Oberon:
-        return CreateUranianSatelliteOrbit(5);
+        return CreateChebyshevOrbit(CreateUranianSatelliteOrbit(5));
     case CustomOrbitType::Triton:
-        return std::make_unique<TritonOrbit>();
+        return CreateChebyshevOrbit(std::make_unique<TritonOrbit>());
     default:
         return CreateVSOP87Orbit(type);
     }
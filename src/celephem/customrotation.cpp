@@ -12,11 +12,17 @@
 
 #include "customrotation.h"
 
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstdint>
 #include <initializer_list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <vector>
 
 #include <Eigen/Geometry>
 
@@ -46,6 +52,16 @@ constexpr double IAU_SECULAR_TERM_VALID_CENTURIES = 50.0;
 // that range, the polynomial terms produce absurd results.
 constexpr double P03LP_VALID_CENTURIES = 5000.0;
 
+// The angles of IAU models with periodic terms are tabulated over windows
+// of time a step apart, and interpolated with cubics; the periodic terms
+// have periods of days at the shortest, so the error of the interpolation
+// is far below the precision of the models.
+constexpr double TableStep = 1.0 / 8.0;
+constexpr std::int64_t TableWindowSteps = 256;
+// A window is only tabulated after this many evaluations in it, so that
+// a time running fast doesn't fill tables that are used a few times
+constexpr unsigned int TableThreshold = 16;
+
 /*! Base class for IAU rotation models. All IAU rotation models are in the
  *  J2000.0 Earth equatorial frame.
  */
@@ -67,19 +83,28 @@ public:
         // Time argument of IAU rotation models is actually day since J2000.0 TT, but
         // Celestia uses TDB. The difference should be so minute as to be irrelevant.
         t = t - astro::J2000;
+        auto angles = getTabulatedAngles(t);
+        double w = angles.has_value() ? angles->meridian : meridian(t);
         if (flipped)
-            return celmath::YRotation( celmath::degToRad(180.0 + meridian(t)));
+            return celmath::YRotation( celmath::degToRad(180.0 + w));
         else
-            return celmath::YRotation(-celmath::degToRad(180.0 + meridian(t)));
+            return celmath::YRotation(-celmath::degToRad(180.0 + w));
     }
 
     Eigen::Quaterniond computeEquatorOrientation(double t) const override
     {
+        t = t - astro::J2000;
         double poleRA = 0.0;
         double poleDec = 0.0;
-
-        t = t - astro::J2000;
-        pole(t, poleRA, poleDec);
+        if (auto angles = getTabulatedAngles(t); angles.has_value())
+        {
+            poleRA = angles->ra;
+            poleDec = angles->dec;
+        }
+        else
+        {
+            pole(t, poleRA, poleDec);
+        }
         double node = poleRA + 90.0;
         double inclination = 90.0 - poleDec;
 
@@ -111,12 +136,109 @@ protected:
         flipped = _flipped;
     }
 
+    // Models without periodic terms are cheaper to evaluate than to
+    // interpolate.
+    void setTabulated(bool _tabulated)
+    {
+        tabulated = _tabulated;
+    }
+
 private:
+    struct Angles
+    {
+        double ra;
+        double dec;
+        double meridian;
+    };
+
+    struct TableWindow
+    {
+        std::int64_t index{ 0 };
+        // From one step before the window to two steps after it
+        std::vector<Angles> nodes;
+    };
+
+    Angles evaluate(double d) const
+    {
+        Angles angles;
+        pole(d, angles.ra, angles.dec);
+        angles.meridian = meridian(d);
+        return angles;
+    }
+
+    // Return the interpolated angles, or nothing if the window of time
+    // isn't tabulated.
+    std::optional<Angles> getTabulatedAngles(double d) const;
+
     double period;
     bool flipped;
+    bool tabulated{ true };
+
+    // Held while using the tables, which are shared by all threads
+    mutable std::mutex tableMutex;
+    mutable std::array<TableWindow, 2> windows;
+    mutable std::size_t nextWindow{ 0 };
+    mutable std::int64_t pendingIndex{ 0 };
+    mutable unsigned int pendingHits{ 0 };
 };
 
 
+std::optional<IAURotationModel::Angles>
+IAURotationModel::getTabulatedAngles(double d) const
+{
+    if (!tabulated)
+        return std::nullopt;
+
+    std::scoped_lock lock(tableMutex);
+    constexpr double windowLength = TableStep * static_cast<double>(TableWindowSteps);
+    auto index = static_cast<std::int64_t>(std::floor(d / windowLength));
+
+    const TableWindow* window = nullptr;
+    for (const TableWindow& w : windows)
+    {
+        if (!w.nodes.empty() && w.index == index)
+            window = &w;
+    }
+
+    if (window == nullptr)
+    {
+        if (index != pendingIndex)
+        {
+            pendingIndex = index;
+            pendingHits = 0;
+        }
+        if (++pendingHits < TableThreshold)
+            return std::nullopt;
+
+        TableWindow& w = windows[nextWindow];
+        nextWindow = (nextWindow + 1) % windows.size();
+        w.index = index;
+        w.nodes.resize(TableWindowSteps + 3);
+        double start = static_cast<double>(index) * windowLength;
+        for (std::int64_t n = 0; n < TableWindowSteps + 3; n++)
+            w.nodes[n] = evaluate(start + static_cast<double>(n - 1) * TableStep);
+        pendingHits = 0;
+        window = &w;
+    }
+
+    // Cubic through the four nodes around d
+    double x = (d - static_cast<double>(index) * windowLength) / TableStep;
+    auto n = std::clamp<std::int64_t>(static_cast<std::int64_t>(std::floor(x)), 0, TableWindowSteps - 1);
+    double u = x - static_cast<double>(n);
+    double w0 = -u * (u - 1.0) * (u - 2.0) / 6.0;
+    double w1 = (u + 1.0) * (u - 1.0) * (u - 2.0) / 2.0;
+    double w2 = -(u + 1.0) * u * (u - 2.0) / 2.0;
+    double w3 = (u + 1.0) * u * (u - 1.0) / 6.0;
+
+    const Angles* p = window->nodes.data() + n;
+    return Angles {
+        w0 * p[0].ra + w1 * p[1].ra + w2 * p[2].ra + w3 * p[3].ra,
+        w0 * p[0].dec + w1 * p[1].dec + w2 * p[2].dec + w3 * p[3].dec,
+        w0 * p[0].meridian + w1 * p[1].meridian + w2 * p[2].meridian + w3 * p[3].meridian,
+    };
+}
+
+
 
 /******* Earth rotation model *******/
 
@@ -217,6 +339,7 @@ public:
     {
         if (rotationRate < 0.0)
             setFlipped(true);
+        setTabulated(false);
     }
 
     void pole(double d, double& ra, double &dec) const override
@@ -0,0 +1,284 @@
+// ellipticalorbitarray.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Positions of many elliptical orbits computed together.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "ellipticalorbitarray.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+
+#include <Eigen/Geometry>
+
+#include <celcompat/numbers.h>
+#include <celmath/geomutil.h>
+#include <celutil/memoryreport.h>
+
+namespace celestia::ephem
+{
+
+namespace
+{
+
+// Don't start a thread for fewer orbits than this
+constexpr std::size_t MinOrbitsPerThread = 4096;
+
+// Halley's method from the starting value below converges to within a few
+// ulps in six steps for all eccentricities below one. Running the same
+// number of steps for every orbit keeps the kernel free of branches.
+constexpr int KeplerIterations = 6;
+
+constexpr double InvTwoPi = 0.5 / celestia::numbers::pi;
+constexpr double InvPi = 1.0 / celestia::numbers::pi;
+// pi split into a first part with 33 significant bits, so that k * Pi1 is
+// exact, and the remainder
+constexpr double Pi1 = 3.14159265346825122833;
+constexpr double Pi2 = 1.21542010130123844986e-10;
+
+// Round to the nearest integer without a library call
+inline double
+roundToInteger(double x)
+{
+    return static_cast<double>(static_cast<std::int64_t>(x + (x >= 0.0 ? 0.5 : -0.5)));
+}
+
+// Sine and cosine without branches or library calls, accurate to a few
+// ulps for |x| < 2^30. x is reduced to r in [-pi/2, pi/2] with x = r + k pi,
+// and sin(r) and cos(r) are evaluated with their Taylor series up to r^21
+// and r^20.
+inline void
+seriesSinCos(double x, double& sinx, double& cosx)
+{
+    auto k = static_cast<std::int32_t>(x * InvPi + (x >= 0.0 ? 0.5 : -0.5));
+    auto kd = static_cast<double>(k);
+    double r = (x - kd * Pi1) - kd * Pi2;
+    double r2 = r * r;
+
+    double s = 1.0 / 51090942171709440000.0;
+    s = s * r2 - 1.0 / 121645100408832000.0;
+    s = s * r2 + 1.0 / 355687428096000.0;
+    s = s * r2 - 1.0 / 1307674368000.0;
+    s = s * r2 + 1.0 / 6227020800.0;
+    s = s * r2 - 1.0 / 39916800.0;
+    s = s * r2 + 1.0 / 362880.0;
+    s = s * r2 - 1.0 / 5040.0;
+    s = s * r2 + 1.0 / 120.0;
+    s = s * r2 - 1.0 / 6.0;
+    s = s * r2 * r + r;
+
+    double c = 1.0 / 2432902008176640000.0;
+    c = c * r2 - 1.0 / 6402373705728000.0;
+    c = c * r2 + 1.0 / 20922789888000.0;
+    c = c * r2 - 1.0 / 87178291200.0;
+    c = c * r2 + 1.0 / 479001600.0;
+    c = c * r2 - 1.0 / 3628800.0;
+    c = c * r2 + 1.0 / 40320.0;
+    c = c * r2 - 1.0 / 720.0;
+    c = c * r2 + 1.0 / 24.0;
+    c = c * r2 - 0.5;
+    c = c * r2 + 1.0;
+
+    // sin(r + k pi) = (-1)^k sin(r), and likewise for the cosine
+    auto sign = static_cast<double>(1 - 2 * (k & 1));
+    sinx = sign * s;
+    cosx = sign * c;
+}
+
+} // end unnamed namespace
+
+
+bool
+EllipticalOrbitArray::add(double pericenterDistance,
+                          double eccentricity,
+                          double inclination,
+                          double ascendingNode,
+                          double argOfPeriapsis,
+                          double meanAnomalyAtEpoch,
+                          double period,
+                          double epoch)
+{
+    if (!(eccentricity >= 0.0 && eccentricity < 1.0) || period == 0.0)
+        return false;
+
+    pericenterDistances.push_back(pericenterDistance);
+    eccentricities.push_back(eccentricity);
+    inclinations.push_back(inclination);
+    ascendingNodes.push_back(ascendingNode);
+    argsOfPeriapsis.push_back(argOfPeriapsis);
+    meanAnomaliesAtEpoch.push_back(meanAnomalyAtEpoch);
+    periods.push_back(period);
+    epochs.push_back(epoch);
+
+    // Padding orbits are at the origin
+    if (count % BlockSize == 0)
+    {
+        std::size_t paddedSize = count + BlockSize;
+        semiMajorAxes.resize(paddedSize, 0.0);
+        semiMinorAxes.resize(paddedSize, 0.0);
+        meanMotions.resize(paddedSize, 0.0);
+        kernelEccentricities.resize(paddedSize, 0.0);
+        kernelMeanAnomalies.resize(paddedSize, 0.0);
+        kernelEpochs.resize(paddedSize, 0.0);
+        pericenterX.resize(paddedSize, 0.0);
+        pericenterY.resize(paddedSize, 0.0);
+        pericenterZ.resize(paddedSize, 0.0);
+        quadratureX.resize(paddedSize, 0.0);
+        quadratureY.resize(paddedSize, 0.0);
+        quadratureZ.resize(paddedSize, 0.0);
+    }
+
+    double a = pericenterDistance / (1.0 - eccentricity);
+    semiMajorAxes[count] = a;
+    semiMinorAxes[count] = a * std::sqrt(1.0 - eccentricity * eccentricity);
+    meanMotions[count] = 2.0 * celestia::numbers::pi / period;
+    kernelEccentricities[count] = eccentricity;
+    kernelMeanAnomalies[count] = meanAnomalyAtEpoch;
+    kernelEpochs[count] = epoch;
+
+    // The first two columns of the rotation to the plane of the orbit used
+    // by EllipticalOrbit, converted to Celestia's internal coordinate system
+    Eigen::Matrix3d orbitPlaneRotation = (celmath::ZRotation(ascendingNode) *
+                                          celmath::XRotation(inclination) *
+                                          celmath::ZRotation(argOfPeriapsis)).toRotationMatrix();
+    pericenterX[count] = orbitPlaneRotation(0, 0);
+    pericenterY[count] = orbitPlaneRotation(2, 0);
+    pericenterZ[count] = -orbitPlaneRotation(1, 0);
+    quadratureX[count] = orbitPlaneRotation(0, 1);
+    quadratureY[count] = orbitPlaneRotation(2, 1);
+    quadratureZ[count] = -orbitPlaneRotation(1, 1);
+
+    ++count;
+    return true;
+}
+
+
+double
+EllipticalOrbitArray::getBoundingRadius(std::size_t index) const
+{
+    return pericenterDistances[index] * ((1.0 + eccentricities[index]) / (1.0 - eccentricities[index]));
+}
+
+
+std::size_t
+EllipticalOrbitArray::getMemoryUsage() const
+{
+    using util::vectorMemory;
+    return vectorMemory(pericenterDistances) + vectorMemory(eccentricities) + vectorMemory(inclinations) +
+           vectorMemory(ascendingNodes) + vectorMemory(argsOfPeriapsis) + vectorMemory(meanAnomaliesAtEpoch) +
+           vectorMemory(periods) + vectorMemory(epochs);
+}
+
+
+void
+EllipticalOrbitArray::computePositions(double tdb,
+                                       std::size_t first,
+                                       std::size_t last,
+                                       Eigen::Vector3d* positions) const
+{
+    for (std::size_t block = first - first % BlockSize; block < last; block += BlockSize)
+    {
+        std::array<double, BlockSize> M;
+        std::array<double, BlockSize> E;
+        for (std::size_t j = 0; j < BlockSize; j++)
+        {
+            std::size_t i = block + j;
+            double e = kernelEccentricities[i];
+
+            // Reduce the mean anomaly to [-pi, pi]
+            double m = kernelMeanAnomalies[i] + (tdb - kernelEpochs[i]) * meanMotions[i];
+            double k = 2.0 * roundToInteger(m * InvTwoPi);
+            m = (m - k * Pi1) - k * Pi2;
+
+            // For e near one and small M, E - e sin(E) is close to e E^3 / 6,
+            // whose root is a much better starting value than the usual one;
+            // the smaller of the two is used. (The root is infinite, or NaN
+            // which std::min ignores, for circular orbits.)
+            double absM = m >= 0.0 ? m : -m;
+            double E0 = std::min(absM + 0.85 * e, std::cbrt(6.0 * absM / e));
+            M[j] = m;
+            E[j] = m >= 0.0 ? E0 : -E0;
+        }
+
+        for (int iter = 0; iter < KeplerIterations; iter++)
+        {
+            for (std::size_t j = 0; j < BlockSize; j++)
+            {
+                double e = kernelEccentricities[block + j];
+                double sinE;
+                double cosE;
+                seriesSinCos(E[j], sinE, cosE);
+
+                double f = E[j] - e * sinE - M[j];
+                double df = 1.0 - e * cosE;
+                double d2f = e * sinE;
+                E[j] -= f / (df - 0.5 * f * d2f / df);
+            }
+        }
+
+        std::array<double, BlockSize> x;
+        std::array<double, BlockSize> y;
+        std::array<double, BlockSize> z;
+        for (std::size_t j = 0; j < BlockSize; j++)
+        {
+            std::size_t i = block + j;
+            double sinE;
+            double cosE;
+            seriesSinCos(E[j], sinE, cosE);
+
+            double u = semiMajorAxes[i] * (cosE - kernelEccentricities[i]);
+            double v = semiMinorAxes[i] * sinE;
+            x[j] = pericenterX[i] * u + quadratureX[i] * v;
+            y[j] = pericenterY[i] * u + quadratureY[i] * v;
+            z[j] = pericenterZ[i] * u + quadratureZ[i] * v;
+        }
+
+        std::size_t begin = std::max(block, first);
+        std::size_t end = std::min(block + BlockSize, last);
+        for (std::size_t i = begin; i < end; i++)
+            positions[i - first] = Eigen::Vector3d(x[i - block], y[i - block], z[i - block]);
+    }
+}
+
+
+void
+EllipticalOrbitArray::computePositions(double tdb,
+                                       std::vector<Eigen::Vector3d>& positions,
+                                       unsigned int nThreads) const
+{
+    positions.resize(count);
+
+    std::size_t nChunks = std::min<std::size_t>(std::max(nThreads, 1u), count / MinOrbitsPerThread);
+    if (nChunks <= 1)
+    {
+        computePositions(tdb, 0, count, positions.data());
+        return;
+    }
+
+    // Chunks start on block boundaries, so that no block is computed twice
+    std::size_t chunkSize = (count / nChunks + BlockSize - 1) / BlockSize * BlockSize;
+    std::vector<std::thread> workers;
+    workers.reserve(nChunks - 1);
+    for (std::size_t first = chunkSize; first < count; first += chunkSize)
+    {
+        std::size_t last = std::min(first + chunkSize, count);
+        workers.emplace_back([this, tdb, first, last, &positions]
+        {
+            computePositions(tdb, first, last, positions.data() + first);
+        });
+    }
+
+    computePositions(tdb, 0, std::min(chunkSize, count), positions.data());
+    for (auto& worker : workers)
+        worker.join();
+}
+
+} // end namespace celestia::ephem
@@ -0,0 +1,109 @@
+// ellipticalorbitarray.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Positions of many elliptical orbits computed together.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace celestia::ephem
+{
+
+/*! The elements of a set of elliptical orbits in structure of arrays form.
+ *  The positions of all of them at a time are computed with the same
+ *  sequence of operations for every orbit, in blocks that the compiler can
+ *  vectorize, and optionally split across threads. Kepler's equation is
+ *  solved to close to double precision for all eccentricities, so the
+ *  results agree with EllipticalOrbit::positionAtTime to the accuracy of
+ *  the latter.
+ *
+ *  Only orbits with eccentricity below one are supported.
+ */
+class EllipticalOrbitArray
+{
+public:
+    // Orbits are processed in blocks of this size; the arrays are padded
+    // with empty orbits to a multiple of it.
+    static constexpr std::size_t BlockSize = 8;
+
+    EllipticalOrbitArray() = default;
+
+    // Parameters as for the EllipticalOrbit constructor. Returns false if
+    // the orbit isn't an ellipse.
+    bool add(double pericenterDistance,
+             double eccentricity,
+             double inclination,
+             double ascendingNode,
+             double argOfPeriapsis,
+             double meanAnomalyAtEpoch,
+             double period,
+             double epoch = 2451545.0);
+
+    std::size_t size() const { return count; }
+    // Bytes taken by the elements
+    std::size_t getMemoryUsage() const;
+
+    double getPericenterDistance(std::size_t index) const { return pericenterDistances[index]; }
+    double getEccentricity(std::size_t index) const { return eccentricities[index]; }
+    double getInclination(std::size_t index) const { return inclinations[index]; }
+    double getAscendingNode(std::size_t index) const { return ascendingNodes[index]; }
+    double getArgOfPeriapsis(std::size_t index) const { return argsOfPeriapsis[index]; }
+    double getMeanAnomalyAtEpoch(std::size_t index) const { return meanAnomaliesAtEpoch[index]; }
+    double getPeriod(std::size_t index) const { return periods[index]; }
+    double getEpoch(std::size_t index) const { return epochs[index]; }
+    double getBoundingRadius(std::size_t index) const;
+
+    // Compute the positions of the orbits in [first, last) at time tdb,
+    // storing that of orbit i in positions[i - first].
+    void computePositions(double tdb,
+                          std::size_t first,
+                          std::size_t last,
+                          Eigen::Vector3d* positions) const;
+
+    // Compute the positions of all orbits, using up to nThreads threads
+    // when there are enough orbits to make it worthwhile.
+    void computePositions(double tdb,
+                          std::vector<Eigen::Vector3d>& positions,
+                          unsigned int nThreads = 1) const;
+
+private:
+    std::size_t count{ 0 };
+
+    // Elements as passed to add()
+    std::vector<double> pericenterDistances;
+    std::vector<double> eccentricities;
+    std::vector<double> inclinations;
+    std::vector<double> ascendingNodes;
+    std::vector<double> argsOfPeriapsis;
+    std::vector<double> meanAnomaliesAtEpoch;
+    std::vector<double> periods;
+    std::vector<double> epochs;
+
+    // Values derived from them for the kernel; padded to the block size
+    std::vector<double> semiMajorAxes;
+    std::vector<double> semiMinorAxes;
+    std::vector<double> meanMotions;
+    std::vector<double> kernelEccentricities;
+    std::vector<double> kernelMeanAnomalies;
+    std::vector<double> kernelEpochs;
+    // Directions of the pericenter and of the point 90 degrees beyond it
+    // along the orbit, in Celestia's internal coordinate system
+    std::vector<double> pericenterX;
+    std::vector<double> pericenterY;
+    std::vector<double> pericenterZ;
+    std::vector<double> quadratureX;
+    std::vector<double> quadratureY;
+    std::vector<double> quadratureZ;
+};
+
+} // end namespace celestia::ephem
@@ -0,0 +1,95 @@
+// evalcontext.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Per-thread caches for the evaluation of orbits, rotation models and
+// reference frames.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "evalcontext.h"
+
+#include <atomic>
+#include <cstring>
+
+namespace celestia::ephem
+{
+
+namespace
+{
+
+// Slots of the tables of each thread, which must be powers of two. A
+// frame evaluates each body a few times at the same time, and there are
+// rarely more than a few thousand bodies in view.
+constexpr std::size_t OrbitSlots = 4096;
+constexpr std::size_t OrientationSlots = 2048;
+
+} // end unnamed namespace
+
+
+CacheId::CacheId()
+{
+    // 0 marks the empty slots
+    static std::atomic<std::uint64_t> nextId{ 1 };
+    id = nextId.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+EvaluationContext::EvaluationContext() :
+    orbits(OrbitSlots),
+    orientations(OrientationSlots)
+{
+}
+
+
+EvaluationContext&
+EvaluationContext::current()
+{
+    thread_local EvaluationContext context;
+    return context;
+}
+
+
+template<typename State>
+std::size_t
+EvaluationContext::Table<State>::index(std::uint64_t id, double t) const
+{
+    std::uint64_t tBits;
+    std::memcpy(&tBits, &t, sizeof(tBits));
+    std::uint64_t h = (id * 0x9e3779b97f4a7c15ull) ^ (tBits * 0xc2b2ae3d27d4eb4full);
+    return static_cast<std::size_t>(h ^ (h >> 32)) & (slots.size() - 1);
+}
+
+
+template<typename State>
+const State*
+EvaluationContext::Table<State>::find(const CacheId& id, double t) const
+{
+    const Slot& slot = slots[index(id.get(), t)];
+    return slot.id == id.get() && slot.t == t ? &slot.state : nullptr;
+}
+
+
+template<typename State>
+State&
+EvaluationContext::Table<State>::insert(const CacheId& id, double t)
+{
+    Slot& slot = slots[index(id.get(), t)];
+    if (slot.id != id.get() || slot.t != t)
+    {
+        slot.id = id.get();
+        slot.t = t;
+        slot.state = State();
+    }
+
+    return slot.state;
+}
+
+
+template class EvaluationContext::Table<EvaluationContext::OrbitState>;
+template class EvaluationContext::Table<EvaluationContext::OrientationState>;
+
+} // end namespace celestia::ephem
@@ -0,0 +1,114 @@
+// evalcontext.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Per-thread caches for the evaluation of orbits, rotation models and
+// reference frames.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+namespace celestia::ephem
+{
+
+/*! Identifies a caching object in the evaluation contexts. Every object
+ *  gets its own, copies included, and they are never reused, so entries
+ *  left behind by a destroyed object are never mistaken for another's.
+ */
+class CacheId
+{
+ public:
+    CacheId();
+    CacheId(const CacheId&) : CacheId() {}
+    CacheId& operator=(const CacheId&) { return *this; }
+
+    std::uint64_t get() const { return id; }
+
+ private:
+    std::uint64_t id;
+};
+
+
+/*! The states last computed by the caching orbits, rotation models and
+ *  frames on one thread. Keeping them here rather than in the objects
+ *  lets several threads evaluate the same objects at once, each one
+ *  reusing its own results. Entries are keyed by object and time, and a
+ *  new entry replaces the one in its slot.
+ */
+class EvaluationContext
+{
+ public:
+    struct OrbitState
+    {
+        Eigen::Vector3d position;
+        Eigen::Vector3d velocity;
+        bool positionValid{ false };
+        bool velocityValid{ false };
+    };
+
+    struct OrientationState
+    {
+        // Spin of rotation models, or orientation of frames
+        Eigen::Quaterniond orientation;
+        Eigen::Quaterniond equator;
+        Eigen::Vector3d angularVelocity;
+        bool orientationValid{ false };
+        bool equatorValid{ false };
+        bool angularVelocityValid{ false };
+    };
+
+    // Return the context of the calling thread
+    static EvaluationContext& current();
+
+    // Return the state of the object at t, or nullptr if there is none. The
+    // pointer is only valid until the next insertion of the same kind, so
+    // the state is computed before inserting it.
+    const OrbitState* findOrbit(const CacheId& id, double t) const { return orbits.find(id, t); }
+    const OrientationState* findOrientation(const CacheId& id, double t) const { return orientations.find(id, t); }
+
+    // Return the state of the object at t, replacing the entry in its slot
+    // with an empty one if it's another object's.
+    OrbitState& insertOrbit(const CacheId& id, double t) { return orbits.insert(id, t); }
+    OrientationState& insertOrientation(const CacheId& id, double t) { return orientations.insert(id, t); }
+
+ private:
+    EvaluationContext();
+
+    template<typename State>
+    class Table
+    {
+     public:
+        explicit Table(std::size_t size) : slots(size) {}
+
+        const State* find(const CacheId& id, double t) const;
+        State& insert(const CacheId& id, double t);
+
+     private:
+        struct Slot
+        {
+            std::uint64_t id{ 0 };
+            double t{ 0.0 };
+            State state;
+        };
+
+        std::size_t index(std::uint64_t id, double t) const;
+
+        std::vector<Slot> slots;
+    };
+
+    Table<OrbitState> orbits;
+    Table<OrientationState> orientations;
+};
+
+} // end namespace celestia::ephem
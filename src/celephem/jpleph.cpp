@@ -10,14 +10,19 @@
 // Load JPL's DE200, DE405, and DE406 ephemerides and compute planet
 // positions.
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cmath>
 #include <cstddef>
 #include <cstring>
+#include <fstream>
 #include <istream>
+#include <memory>
 #include <type_traits>
 
 #include <celutil/bytes.h>
+#include <celutil/mappedfile.h>
 #include "jpleph.h"
 
 namespace celestia::ephem
@@ -64,23 +69,6 @@ constexpr unsigned int LabelSize = 84;
 constexpr unsigned int INPOP_DE_COMPATIBLE = 100;
 constexpr unsigned int DE200 = 200;
 
-// Read a big-endian or little endian 32-bit unsigned integer
-std::uint32_t readUint(std::istream& in, bool swap)
-{
-    std::uint32_t ret;
-    in.read((char*) &ret, sizeof(std::uint32_t));
-    return swap ? bswap_32(ret) : ret;
-}
-
-// Read a big-endian or little endian 64-bit IEEE double.
-// If the native double format isn't IEEE 754, there will be troubles.
-double readDouble(std::istream& in, bool swap)
-{
-    double d;
-    in.read((char*) &d, sizeof(double));
-    return swap ? bswap_double(d) : d;
-}
-
 #pragma pack(push, 1)
 
 // These packed structs are only used for offset calculations, they should
@@ -131,9 +119,14 @@ struct JPLEFileHeader
 static_assert(std::is_standard_layout_v<JPLECoeff>);
 static_assert(std::is_standard_layout_v<JPLEFileHeader>);
 
+// The header is followed by the record size in INPOP files
+constexpr std::size_t HeaderReadSize = sizeof(JPLEFileHeader) + sizeof(std::uint32_t);
+
 } // end unnamed namespace
 
 
+JPLEphemeris::~JPLEphemeris() = default;
+
 unsigned int JPLEphemeris::getDENumber() const
 {
     return DENum;
@@ -192,41 +185,52 @@ Eigen::Vector3d JPLEphemeris::getPlanetPosition(JPLEphemItem planet, double tjd)
     // recNo is always >= 0:
     auto recNo = (unsigned int) ((tjd - startDate) / daysPerInterval);
     // Make sure we don't go past the end of the array if t == endDate
-    if (recNo >= records.size())
-        recNo = records.size() - 1;
-    const JPLEphRecord* rec = &records[recNo];
+    if (recNo >= nRecords)
+        recNo = nRecords - 1;
+
+    // Records are located by their index; only the start time and the
+    // coefficients of the requested item are decoded.
+    const char* rec = recordData + static_cast<std::size_t>(recNo) * recordSize * sizeof(double);
+    double t0;
+    getMaybeSwapDouble(t0, rec, swapBytes);
 
     auto planetIdx = static_cast<std::size_t>(planet);
+    const JPLEphCoeffInfo& info = coeffInfo[planetIdx];
 
-    assert(coeffInfo[planetIdx].nGranules >= 1);
-    assert(coeffInfo[planetIdx].nGranules <= 32);
-    assert(coeffInfo[planetIdx].nCoeffs <= MaxChebyshevCoeffs);
+    // checkRecords() made sure that the coefficients fit in the record
+    assert(info.nCoeffs >= 2);
+    assert(info.nCoeffs <= MaxChebyshevCoeffs);
 
     // u is the normalized time (in [-1, 1]) for interpolating
-    // coeffs is a pointer to the Chebyshev coefficients
     double u = 0.0;
-    const double* coeffs = nullptr;
+    std::size_t first = info.offset;
 
     // nGranules is unsigned int so it will be compared against FFFFFFFF:
-    if (coeffInfo[planetIdx].nGranules == (unsigned int) -1)
+    if (info.nGranules == (unsigned int) -1)
     {
-        coeffs = rec->coeffs.data() + coeffInfo[planetIdx].offset;
-        u = 2.0 * (tjd - rec->t0) / daysPerInterval - 1.0;
+        u = 2.0 * (tjd - t0) / daysPerInterval - 1.0;
     }
     else
     {
-        double daysPerGranule = daysPerInterval / coeffInfo[planetIdx].nGranules;
-        auto granule = (int) ((tjd - rec->t0) / daysPerGranule);
-        double granuleStartDate = rec->t0 + daysPerGranule * (double) granule;
-        coeffs = rec->coeffs.data() + coeffInfo[planetIdx].offset +
-                 granule * coeffInfo[planetIdx].nCoeffs * 3;
+        double daysPerGranule = daysPerInterval / info.nGranules;
+        auto granule = (unsigned int) std::max((tjd - t0) / daysPerGranule, 0.0);
+        if (granule >= info.nGranules)
+            granule = info.nGranules - 1;
+        double granuleStartDate = t0 + daysPerGranule * (double) granule;
+        first += static_cast<std::size_t>(granule) * info.nCoeffs * 3;
         u = 2.0 * (tjd - granuleStartDate) / daysPerGranule - 1.0;
     }
 
+    // The first two doubles of the record are its start and end time
+    const char* src = rec + (first + 2) * sizeof(double);
+    unsigned int nCoeffs = info.nCoeffs;
+    double coeffs[3 * MaxChebyshevCoeffs];
+    for (unsigned int i = 0; i < 3 * nCoeffs; i++)
+        getMaybeSwapDouble(coeffs[i], src + i * sizeof(double), swapBytes);
+
     // Evaluate the Chebyshev polynomials
     double sum[3];
     double cc[MaxChebyshevCoeffs];
-    unsigned int nCoeffs = coeffInfo[planetIdx].nCoeffs;
     for (int i = 0; i < 3; i++)
     {
         cc[0] = 1.0;
@@ -243,15 +247,11 @@ Eigen::Vector3d JPLEphemeris::getPlanetPosition(JPLEphemItem planet, double tjd)
 }
 
 
-JPLEphemeris* JPLEphemeris::load(std::istream& in)
+// Parse the header from the first HeaderReadSize bytes of the file
+JPLEphemeris* JPLEphemeris::parseHeader(const char* data)
 {
-    std::array<char, sizeof(JPLEFileHeader)> fh;
-    in.read(fh.data(), fh.size()); /* Flawfinder: ignore */
-    if (!in.good())
-        return nullptr;
-
     decltype(JPLEFileHeader::deNum) deNum;
-    std::memcpy(&deNum, fh.data() + offsetof(JPLEFileHeader, deNum), sizeof(deNum));
+    std::memcpy(&deNum, data + offsetof(JPLEFileHeader, deNum), sizeof(deNum));
     std::uint32_t deNum2 = bswap_32(deNum);
 
     bool swapBytes;
@@ -288,28 +288,28 @@ JPLEphemeris* JPLEphemeris::load(std::istream& in)
     eph->DENum = deNum;
 
     // Read the start time, end time, and time interval
-    getMaybeSwapDouble(eph->startDate,          fh.data() + offsetof(JPLEFileHeader, startDate),          swapBytes);
-    getMaybeSwapDouble(eph->endDate,            fh.data() + offsetof(JPLEFileHeader, endDate),            swapBytes);
-    getMaybeSwapDouble(eph->daysPerInterval,    fh.data() + offsetof(JPLEFileHeader, daysPerInterval),    swapBytes);
+    getMaybeSwapDouble(eph->startDate,          data + offsetof(JPLEFileHeader, startDate),          swapBytes);
+    getMaybeSwapDouble(eph->endDate,            data + offsetof(JPLEFileHeader, endDate),            swapBytes);
+    getMaybeSwapDouble(eph->daysPerInterval,    data + offsetof(JPLEFileHeader, daysPerInterval),    swapBytes);
     // kilometers per astronomical unit
-    getMaybeSwapDouble(eph->au,                 fh.data() + offsetof(JPLEFileHeader, au),                 swapBytes);
-    getMaybeSwapDouble(eph->earthMoonMassRatio, fh.data() + offsetof(JPLEFileHeader, earthMoonMassRatio), swapBytes);
+    getMaybeSwapDouble(eph->au,                 data + offsetof(JPLEFileHeader, au),                 swapBytes);
+    getMaybeSwapDouble(eph->earthMoonMassRatio, data + offsetof(JPLEFileHeader, earthMoonMassRatio), swapBytes);
 
     // Read the coefficient information for each item in the ephemeris
     eph->recordSize = 0;
     for (unsigned int i = 0; i < JPLEph_NItems; i++)
     {
-        const char* coeffInfo = fh.data() + offsetof(JPLEFileHeader, coeffInfo) + i * sizeof(JPLECoeff);
+        const char* coeffInfo = data + offsetof(JPLEFileHeader, coeffInfo) + i * sizeof(JPLECoeff);
         getMaybeSwapUint32(eph->coeffInfo[i].offset,    coeffInfo + offsetof(JPLECoeff, offset),    swapBytes);
         getMaybeSwapUint32(eph->coeffInfo[i].nCoeffs,   coeffInfo + offsetof(JPLECoeff, nCoeffs),   swapBytes);
         getMaybeSwapUint32(eph->coeffInfo[i].nGranules, coeffInfo + offsetof(JPLECoeff, nGranules), swapBytes);
         eph->coeffInfo[i].offset -= 3;
         // last item is the nutation ephemeris (only 2 components)
-        unsigned nRecords = i == JPLEph_NItems - 1 ? 2 : 3;
-        eph->recordSize += eph->coeffInfo[i].nCoeffs * eph->coeffInfo[i].nGranules * nRecords;
+        unsigned nComponents = i == JPLEph_NItems - 1 ? 2 : 3;
+        eph->recordSize += eph->coeffInfo[i].nCoeffs * eph->coeffInfo[i].nGranules * nComponents;
     }
 
-    const char* librationCoeffInfo = fh.data() + offsetof(JPLEFileHeader, librationCoeffInfo);
+    const char* librationCoeffInfo = data + offsetof(JPLEFileHeader, librationCoeffInfo);
     getMaybeSwapUint32(eph->librationCoeffInfo.offset,    librationCoeffInfo + offsetof(JPLECoeff, offset),    swapBytes);
     getMaybeSwapUint32(eph->librationCoeffInfo.nCoeffs,   librationCoeffInfo + offsetof(JPLECoeff, nCoeffs),   swapBytes);
     getMaybeSwapUint32(eph->librationCoeffInfo.nGranules, librationCoeffInfo + offsetof(JPLECoeff, nGranules), swapBytes);
@@ -318,48 +318,94 @@ JPLEphemeris* JPLEphemeris::load(std::istream& in)
 
     // if INPOP ephemeris, read record size
     if (deNum == INPOP_DE_COMPATIBLE)
-    {
-       eph->recordSize = readUint(in, eph->swapBytes);
-       // Skip past the rest of the record
-       in.ignore(eph->recordSize * 8 - sizeof(JPLEFileHeader) - sizeof(uint32_t));
-    }
-    else
-    {
-        // Skip past the rest of the record
-        in.ignore(eph->recordSize * 8 - sizeof(JPLEFileHeader));
-    }
+        getMaybeSwapUint32(eph->recordSize, data + sizeof(JPLEFileHeader), swapBytes);
 
-    // The next record contains constant values (which we don't need)
-    in.ignore(eph->recordSize * 8);
-    if (!in.good())
+    double nIntervals = (eph->endDate - eph->startDate) / eph->daysPerInterval;
+    if (!std::isfinite(nIntervals) || nIntervals < 1.0 || nIntervals > 1.0e9 || !eph->checkRecords())
     {
         delete eph;
         return nullptr;
     }
+    eph->nRecords = (unsigned int) nIntervals;
 
-    auto nRecords = (unsigned int) ((eph->endDate - eph->startDate) /
-                        eph->daysPerInterval);
-    eph->records.resize(nRecords);
-    for (unsigned int i = 0; i < nRecords; i++)
-    {
-        eph->records[i].t0 = readDouble(in, eph->swapBytes);
-        eph->records[i].t1 = readDouble(in, eph->swapBytes);
+    return eph;
+}
 
-        // Allocate coefficient array for this record; the first two
-        // 'coefficients' are actually the start and end time (t0 and t1)
-        eph->records[i].coeffs.reserve(eph->recordSize - 2);
-        for (unsigned int j = 0; j < eph->recordSize - 2; j++)
-            eph->records[i].coeffs.push_back(readDouble(in, eph->swapBytes));
 
-        // Make sure that we read this record successfully
-        if (!in.good())
+// Make sure that the header fits in the first record and that the
+// coefficients of every planet are within a record.
+bool JPLEphemeris::checkRecords() const
+{
+    if (static_cast<std::size_t>(recordSize) * sizeof(double) < HeaderReadSize)
+        return false;
+
+    // The last item is the nutation ephemeris, which isn't used
+    for (std::size_t i = 0; i < JPLEph_NItems - 1; i++)
+    {
+        const JPLEphCoeffInfo& info = coeffInfo[i];
+        std::uint64_t nGranules = info.nGranules == (unsigned int) -1 ? 1 : info.nGranules;
+        if (info.nCoeffs < 2 || info.nCoeffs > MaxChebyshevCoeffs || nGranules == 0 ||
+            std::uint64_t(info.offset) + nGranules * info.nCoeffs * 3 + 2 > recordSize)
         {
-            delete eph;
-            return nullptr;
+            return false;
         }
     }
 
-    return eph;
+    return true;
+}
+
+
+JPLEphemeris* JPLEphemeris::load(std::istream& in)
+{
+    std::array<char, HeaderReadSize> fh;
+    in.read(fh.data(), fh.size()); /* Flawfinder: ignore */
+    if (!in.good())
+        return nullptr;
+
+    std::unique_ptr<JPLEphemeris> eph(parseHeader(fh.data()));
+    if (eph == nullptr)
+        return nullptr;
+
+    // Skip past the rest of the header record; the next record contains
+    // constant values (which we don't need)
+    std::size_t recordBytes = static_cast<std::size_t>(eph->recordSize) * sizeof(double);
+    in.ignore(static_cast<std::streamsize>(recordBytes * 2 - fh.size()));
+
+    // Read all records at once, they're decoded when they are used
+    eph->recordBuffer.resize(recordBytes * eph->nRecords);
+    in.read(eph->recordBuffer.data(), static_cast<std::streamsize>(eph->recordBuffer.size())); /* Flawfinder: ignore */
+    if (!in.good())
+        return nullptr;
+
+    eph->recordData = eph->recordBuffer.data();
+    return eph.release();
+}
+
+
+JPLEphemeris* JPLEphemeris::load(const fs::path& path)
+{
+    auto file = util::MappedFile::open(path);
+    if (file == nullptr)
+    {
+        std::ifstream in(path, std::ios::in | std::ios::binary);
+        return in.good() ? load(in) : nullptr;
+    }
+
+    if (file->size() < HeaderReadSize)
+        return nullptr;
+
+    std::unique_ptr<JPLEphemeris> eph(parseHeader(file->data()));
+    if (eph == nullptr)
+        return nullptr;
+
+    // Records follow the header record and the constants record
+    std::size_t recordBytes = static_cast<std::size_t>(eph->recordSize) * sizeof(double);
+    if (file->size() / recordBytes < std::size_t(eph->nRecords) + 2)
+        return nullptr;
+
+    eph->recordData = file->data() + recordBytes * 2;
+    eph->file = std::move(file);
+    return eph.release();
 }
 
 } // end namespace celestia::ephem
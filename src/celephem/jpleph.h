@@ -16,10 +16,18 @@
 #include <cstddef>
 #include <cstdint>
 #include <iosfwd>
+#include <memory>
 #include <vector>
 
 #include <Eigen/Core>
 
+#include <celcompat/filesystem.h>
+
+namespace celestia::util
+{
+class MappedFile;
+}
+
 namespace celestia::ephem
 {
 
@@ -49,17 +57,6 @@ struct JPLEphCoeffInfo
 };
 
 
-struct JPLEphRecord
-{
-    JPLEphRecord() = default;
-    ~JPLEphRecord() = default;
-
-    double t0{ 0.0 };
-    double t1{ 0.0 };
-    std::vector<double> coeffs{ };
-};
-
-
 class JPLEphemeris
 {
 private:
@@ -68,10 +65,14 @@ private:
 public:
     static constexpr std::size_t JPLEph_NItems = 12;
 
-    ~JPLEphemeris() = default;
+    ~JPLEphemeris();
 
     Eigen::Vector3d getPlanetPosition(JPLEphemItem, double t) const;
 
+    // Map the file into memory; records are only read and byte swapped
+    // when a position within them is requested. Falls back to reading
+    // the file if it can't be mapped.
+    static JPLEphemeris* load(const fs::path&);
     static JPLEphemeris* load(std::istream&);
 
     unsigned int getDENumber() const;
@@ -95,7 +96,16 @@ private:
     unsigned int recordSize;  // number of doubles per record
     bool swapBytes;
 
-    std::vector<JPLEphRecord> records;
+    // Records as stored in the file, starting with the first record after
+    // the header and the constants. They are either mapped or read into
+    // recordBuffer.
+    std::unique_ptr<util::MappedFile> file;
+    std::vector<char> recordBuffer;
+    const char* recordData{ nullptr };
+    unsigned int nRecords{ 0 };
+
+    static JPLEphemeris* parseHeader(const char* data);
+    bool checkRecords() const;
 };
 
 } // end namespace celestia::ephem
@@ -185,13 +185,16 @@ StateVectorToOrbit(const Eigen::Vector3d& position,
   *
   * Subclasses of orbit should override this method as necessary. The default
   * implementation uses an adaptive sampling scheme with the following defaults:
-  *    tolerance: 1 km
+  *    tolerance: 1 km, or 1e-5 of the distance from the center if larger
+  *    turn angle: 10 degrees
   *    start step: T / 1e5
   *    min step: T / 1e7
-  *    max step: T / 100
+  *    max step: T / 8
   *
   * Where T is either the mean orbital period for periodic orbits or the valid
-  * time span for aperiodic trajectories.
+  * time span for aperiodic trajectories. Nearly circular orbits end up with a
+  * few dozen samples per period, while the samples of eccentric orbits are
+  * concentrated around the pericenter where the path curves the most.
   */
 void Orbit::sample(double startTime, double endTime, OrbitSampleProc& proc) const
 {
@@ -215,9 +218,11 @@ void Orbit::sample(double startTime, double endTime, OrbitSampleProc& proc) cons
         }
     }
 
-    AdaptiveSamplingParameters samplingParams;
+    AdaptiveSamplingParameters samplingParams{};
     samplingParams.tolerance = 1.0; // kilometers
-    samplingParams.maxStep = span / 100.0;
+    samplingParams.relativeTolerance = 1.0e-5;
+    samplingParams.maxTurnAngle = celmath::degToRad(10.0);
+    samplingParams.maxStep = span / 8.0;
     samplingParams.minStep = span / 1.0e7;
     samplingParams.startStep = span / 1.0e5;
 
@@ -225,16 +230,31 @@ void Orbit::sample(double startTime, double endTime, OrbitSampleProc& proc) cons
 }
 
 
+void Orbit::sampleAtTimes(const std::vector<double>& times, OrbitSampleProc& proc) const
+{
+    for (double t : times)
+        proc.sample(t, positionAtTime(t), velocityAtTime(t));
+}
+
+
 /** Adaptively sample the orbit over the range [ startTime, endTime ].
+  *
+  * A step is acceptable when the cubic through its end points misses the
+  * orbit position halfway through by no more than the tolerance, and when
+  * the direction of motion turns by no more than the maximum turn angle.
+  * Each step grows or shrinks from the previous one until it's the longest
+  * acceptable step.
   */
 void Orbit::adaptiveSample(double startTime, double endTime, OrbitSampleProc& proc, const AdaptiveSamplingParameters& samplingParams) const
 {
     double startStepSize = samplingParams.startStep;
     double maxStepSize   = samplingParams.maxStep;
     double minStepSize   = samplingParams.minStep;
-    double tolerance     = samplingParams.tolerance;
     double t = startTime;
     const double stepFactor = 1.25;
+    const double minTurnCos = samplingParams.maxTurnAngle > 0.0
+        ? std::cos(samplingParams.maxTurnAngle)
+        : -1.0;
 
     Eigen::Vector3d lastP = positionAtTime(t);
     Eigen::Vector3d lastV = velocityAtTime(t);
@@ -242,70 +262,67 @@ void Orbit::adaptiveSample(double startTime, double endTime, OrbitSampleProc& pr
     int sampCount = 0;
     int nTests = 0;
 
-    while (t < endTime)
+    Eigen::Vector3d p1;
+    Eigen::Vector3d v1;
+    auto withinTolerance = [&](double dt)
     {
-        // Make sure that we don't go past the end of the sample interval
-        maxStepSize = std::min(maxStepSize, endTime - t);
-        double dt = std::min(maxStepSize, startStepSize * 2.0);
-
-        Eigen::Vector3d p1 = positionAtTime(t + dt);
-        Eigen::Vector3d v1 = velocityAtTime(t + dt);
+        p1 = positionAtTime(t + dt);
+        v1 = velocityAtTime(t + dt);
+        ++nTests;
 
-        double tmid = t + dt / 2.0;
-        Eigen::Vector3d pTest = positionAtTime(tmid);
+        Eigen::Vector3d pTest = positionAtTime(t + dt / 2.0);
         Eigen::Vector3d pInterp = cubicInterpolate(lastP, lastV * dt,
                                                    p1, v1 * dt,
                                                    0.5);
-        ++nTests;
+        double tolerance = std::max(samplingParams.tolerance,
+                                    samplingParams.relativeTolerance * pTest.norm());
+        if ((pInterp - pTest).norm() > tolerance)
+            return false;
 
-        double positionError = (pInterp - pTest).norm();
+        // The direction of motion mustn't turn too much over the step
+        double speeds = lastV.norm() * v1.norm();
+        return speeds == 0.0 || lastV.dot(v1) >= minTurnCos * speeds;
+    };
 
-        // Error is greater than tolerance; decrease the step until the
-        // error is within the tolerance.
-        if (positionError > tolerance)
+    while (t < endTime)
+    {
+        // Make sure that we don't go past the end of the sample interval
+        maxStepSize = std::min(maxStepSize, endTime - t);
+        double dt = std::min(maxStepSize, startStepSize * 2.0);
+
+        if (!withinTolerance(dt))
         {
-            while (positionError > tolerance && dt > minStepSize)
+            // Decrease the step until it's within the tolerance.
+            while (dt > minStepSize)
             {
                 dt /= stepFactor;
-
-                p1 = positionAtTime(t + dt);
-                v1 = velocityAtTime(t + dt);
-
-                tmid = t + dt / 2.0;
-                pTest = positionAtTime(tmid);
-                pInterp = cubicInterpolate(lastP, lastV * dt,
-                                           p1, v1 * dt,
-                                           0.5);
-                nTests++;
-
-                positionError = (pInterp - pTest).norm();
+                if (withinTolerance(dt))
+                    break;
             }
         }
         else
         {
-            // Error is less than the tolerance; increase the step size until the
-            // tolerance is just exceeded.
-            while (positionError < tolerance && dt < maxStepSize)
+            // Increase the step size for as long as it stays within the
+            // tolerance.
+            Eigen::Vector3d acceptedP = p1;
+            Eigen::Vector3d acceptedV = v1;
+            while (dt < maxStepSize)
             {
-                dt *= stepFactor;
-
-                p1 = positionAtTime(t + dt);
-                v1 = velocityAtTime(t + dt);
-
-                tmid = t + dt / 2.0;
-                pTest = positionAtTime(tmid);
-                pInterp = cubicInterpolate(lastP, lastV * dt,
-                                           p1, v1 * dt,
-                                           0.5);
-                nTests++;
-
-                positionError = (pInterp - pTest).norm();
+                double nextDt = std::min(dt * stepFactor, maxStepSize);
+                if (!withinTolerance(nextDt))
+                    break;
+                dt = nextDt;
+                acceptedP = p1;
+                acceptedV = v1;
             }
+            p1 = acceptedP;
+            v1 = acceptedV;
         }
 
         t = t + dt;
         lastP = p1;
         lastV = v1;
+        startStepSize = dt;
 
         proc.sample(t, lastP, lastV);
         sampCount++;
@@ -495,39 +512,31 @@ double EllipticalOrbit::getBoundingRadius() const
 
 Eigen::Vector3d CachingOrbit::positionAtTime(double jd) const
 {
-    if (jd != lastTime)
-    {
-        lastTime = jd;
-        lastPosition = computePosition(jd);
-        positionCacheValid = true;
-        velocityCacheValid = false;
-    }
-    else if (!positionCacheValid)
-    {
-        lastPosition = computePosition(jd);
-        positionCacheValid = true;
-    }
+    EvaluationContext& context = EvaluationContext::current();
+    if (const auto* state = context.findOrbit(cacheId, jd); state != nullptr && state->positionValid)
+        return state->position;
 
-    return lastPosition;
+    // computePosition may evaluate other orbits, which may replace the
+    // entry, so it's only looked up once the position is known.
+    Eigen::Vector3d position = computePosition(jd);
+    auto& state = context.insertOrbit(cacheId, jd);
+    state.position = position;
+    state.positionValid = true;
+    return position;
 }
 
 
 Eigen::Vector3d CachingOrbit::velocityAtTime(double jd) const
 {
-    if (jd != lastTime)
-    {
-        lastVelocity = computeVelocity(jd);
-        lastTime = jd;  // must be set *after* call to computeVelocity
-        positionCacheValid = false;
-        velocityCacheValid = true;
-    }
-    else if (!velocityCacheValid)
-    {
-        lastVelocity = computeVelocity(jd);
-        velocityCacheValid = true;
-    }
+    EvaluationContext& context = EvaluationContext::current();
+    if (const auto* state = context.findOrbit(cacheId, jd); state != nullptr && state->velocityValid)
+        return state->velocity;
 
-    return lastVelocity;
+    Eigen::Vector3d velocity = computeVelocity(jd);
+    auto& state = context.insertOrbit(cacheId, jd);
+    state.velocity = velocity;
+    state.velocityValid = true;
+    return velocity;
 }
 
 
@@ -9,10 +9,14 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
+#include <vector>
 
 #include <Eigen/Core>
 
+#include "evalcontext.h"
+
 class Body;
 
 namespace celestia::ephem
@@ -42,8 +46,21 @@ class Orbit
 
     virtual void sample(double startTime, double endTime, OrbitSampleProc& proc) const;
 
+    // Pass the positions and velocities at the given times, which must be
+    // in increasing order, to proc. Orbits which can evaluate runs of times
+    // faster than one at a time override this.
+    virtual void sampleAtTimes(const std::vector<double>& times, OrbitSampleProc& proc) const;
+
     virtual bool isPeriodic() const { return true; };
 
+    // Return true if positions may be computed from several threads at
+    // once, which lets the renderer sample the orbit in the background.
+    virtual bool isThreadSafe() const { return false; }
+
+    // Return the bytes taken by an orbit loaded from a file with its
+    // samples; orbits computed from a few elements return 0.
+    virtual std::size_t getMemoryUsage() const { return 0; }
+
     // Return the time range over which the orbit is valid; if the orbit
     // is always valid, begin and end should be equal.
     virtual void getValidRange(double& begin, double& end) const
@@ -55,7 +72,13 @@ class Orbit
 protected:
     struct AdaptiveSamplingParameters
     {
+        // Position error allowed, the larger of an absolute error in
+        // kilometers and a fraction of the distance from the center
         double tolerance;
+        double relativeTolerance;
+        // Largest change in the direction of motion over one step, in
+        // radians; it's unlimited when zero.
+        double maxTurnAngle;
         double startStep;
         double minStep;
         double maxStep;
@@ -77,6 +100,7 @@ class EllipticalOrbit : public Orbit
     Eigen::Vector3d velocityAtTime(double) const override;
     double getPeriod() const override;
     double getBoundingRadius() const override;
+    bool isThreadSafe() const override { return true; }
 
  private:
     double eccentricAnomaly(double) const;
@@ -107,8 +131,8 @@ class OrbitSampleProc
  * orbits can be expensive to compute, with more than 50 periodic terms.
  * Celestia may need require position of a planet more than once per frame; in
  * order to avoid redundant calculation, the CachingOrbit class saves the
- * result of the last calculation and uses it if the time matches the cached
- * time.
+ * results in the evaluation context of the calling thread and uses them if
+ * the time matches the cached time.
  */
 class CachingOrbit : public Orbit
 {
@@ -122,12 +146,12 @@ class CachingOrbit : public Orbit
     Eigen::Vector3d positionAtTime(double jd) const override;
     Eigen::Vector3d velocityAtTime(double jd) const override;
 
+    // The cache is kept in the evaluation context of each thread, so
+    // caching orbits are thread safe as long as computePosition is.
+    bool isThreadSafe() const override { return true; }
+
  private:
-    mutable Eigen::Vector3d lastPosition;
-    mutable Eigen::Vector3d lastVelocity;
-    mutable double lastTime{ -1.0e30 };
-    mutable bool positionCacheValid{ false };
-    mutable bool velocityCacheValid{ false };
+    CacheId cacheId;
 };
 
 
@@ -148,6 +172,7 @@ class MixedOrbit : public Orbit
     double getPeriod() const override;
     double getBoundingRadius() const override;
     void sample(double startTime, double endTime, OrbitSampleProc& proc) const override;
+    bool isThreadSafe() const override { return primary->isThreadSafe(); }
 
  private:
     std::unique_ptr<Orbit> primary;
@@ -197,6 +222,7 @@ class FixedOrbit : public Orbit
     bool isPeriodic() const override;
     double getBoundingRadius() const override;
     void sample(double, double, OrbitSampleProc&) const override;
+    bool isThreadSafe() const override { return true; }
 
  private:
     Eigen::Vector3d position;
@@ -60,75 +60,53 @@ RotationModel::angularVelocityAtTime(double tdb) const
 
 /***** CachingRotationModel *****/
 
-CachingRotationModel::CachingRotationModel() :
-    lastTime(365.0),
-    spinCacheValid(false),
-    equatorCacheValid(false),
-    angularVelocityCacheValid(false)
-{
-}
+CachingRotationModel::CachingRotationModel() = default;
 
 
 Eigen::Quaterniond
 CachingRotationModel::spin(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastSpin = computeSpin(tjd);
-        spinCacheValid = true;
-        equatorCacheValid = false;
-        angularVelocityCacheValid = false;
-    }
-    else if (!spinCacheValid)
-    {
-        lastSpin = computeSpin(tjd);
-        spinCacheValid = true;
-    }
-
-    return lastSpin;
+    EvaluationContext& context = EvaluationContext::current();
+    if (const auto* state = context.findOrientation(cacheId, tjd); state != nullptr && state->orientationValid)
+        return state->orientation;
+
+    // The compute methods may evaluate other rotation models, which may
+    // replace the entry, so it's only looked up once the result is known.
+    Eigen::Quaterniond spin = computeSpin(tjd);
+    auto& state = context.insertOrientation(cacheId, tjd);
+    state.orientation = spin;
+    state.orientationValid = true;
+    return spin;
 }
 
 
 Eigen::Quaterniond
 CachingRotationModel::equatorOrientationAtTime(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastEquator = computeEquatorOrientation(tjd);
-        spinCacheValid = false;
-        equatorCacheValid = true;
-        angularVelocityCacheValid = false;
-    }
-    else if (!equatorCacheValid)
-    {
-        lastEquator = computeEquatorOrientation(tjd);
-        equatorCacheValid = true;
-    }
-
-    return lastEquator;
+    EvaluationContext& context = EvaluationContext::current();
+    if (const auto* state = context.findOrientation(cacheId, tjd); state != nullptr && state->equatorValid)
+        return state->equator;
+
+    Eigen::Quaterniond equator = computeEquatorOrientation(tjd);
+    auto& state = context.insertOrientation(cacheId, tjd);
+    state.equator = equator;
+    state.equatorValid = true;
+    return equator;
 }
 
 
 Eigen::Vector3d
 CachingRotationModel::angularVelocityAtTime(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        lastTime = tjd;
-        spinCacheValid = false;
-        equatorCacheValid = false;
-        angularVelocityCacheValid = true;
-    }
-    else if (!angularVelocityCacheValid)
-    {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        angularVelocityCacheValid = true;
-    }
-
-    return lastAngularVelocity;
+    EvaluationContext& context = EvaluationContext::current();
+    if (const auto* state = context.findOrientation(cacheId, tjd); state != nullptr && state->angularVelocityValid)
+        return state->angularVelocity;
+
+    Eigen::Vector3d angularVelocity = computeAngularVelocity(tjd);
+    auto& state = context.insertOrientation(cacheId, tjd);
+    state.angularVelocity = angularVelocity;
+    state.angularVelocityValid = true;
+    return angularVelocity;
 }
 
 
@@ -13,6 +13,8 @@
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
+#include "evalcontext.h"
+
 namespace celestia::ephem
 {
 
@@ -60,6 +62,10 @@ class RotationModel
 
     virtual bool isPeriodic() const = 0;
 
+    // Return true if the orientation may be computed from several threads
+    // at once.
+    virtual bool isThreadSafe() const { return false; }
+
     // Return the time range over which the orientation model is valid;
     // if the model is always valid, begin and end should be equal.
     virtual void getValidRange(double& begin, double& end) const
@@ -71,9 +77,10 @@ class RotationModel
 
 
 /*! CachingRotationModel is an abstract base class for complicated rotation
- *  models that are computationally expensive. The last calculated spin,
- *  equator orientation, and angular velocity are all cached and reused in
- *  order to avoid redundant calculation. Subclasses must override computeSpin(),
+ *  models that are computationally expensive. The spin, equator orientation,
+ *  and angular velocity calculated at recent times are cached by each thread
+ *  and reused in order to avoid redundant calculation; light time corrections
+ *  and several views make a frame alternate between nearby times. Subclasses must override computeSpin(),
  *  computeEquatorOrientation(), and getPeriod(). The default implementation
  *  of computeAngularVelocity uses differentiation to approximate the
  *  the instantaneous angular velocity. It may be overridden if there is some
@@ -96,14 +103,13 @@ class CachingRotationModel : public RotationModel
     double getPeriod() const override = 0;
     bool isPeriodic() const override = 0;
 
+    // The cache is kept in the evaluation context of each thread, so
+    // caching rotation models are thread safe as long as the compute
+    // methods are.
+    bool isThreadSafe() const override { return true; }
+
 private:
-    mutable Eigen::Quaterniond lastSpin;
-    mutable Eigen::Quaterniond lastEquator;
-    mutable Eigen::Vector3d lastAngularVelocity;
-    mutable double lastTime;
-    mutable bool spinCacheValid;
-    mutable bool equatorCacheValid;
-    mutable bool angularVelocityCacheValid;
+    CacheId cacheId;
 };
 
 
@@ -121,6 +127,7 @@ class ConstantOrientation : public RotationModel
 
     double getPeriod() const override { return 0.0; }
     bool isPeriodic() const override { return false; }
+    bool isThreadSafe() const override { return true; }
 
  private:
     Eigen::Quaterniond orientation;
@@ -145,6 +152,7 @@ class UniformRotationModel : public RotationModel
     Eigen::Quaterniond equatorOrientationAtTime(double tjd) const override;
     Eigen::Quaterniond spin(double tjd) const override;
     Eigen::Vector3d angularVelocityAtTime(double tjd) const override;
+    bool isThreadSafe() const override { return true; }
 
  private:
     double period;       // sidereal rotation period
@@ -173,6 +181,7 @@ class PrecessingRotationModel : public RotationModel
     double getPeriod() const override;
     Eigen::Quaterniond equatorOrientationAtTime(double tjd) const override;
     Eigen::Quaterniond spin(double tjd) const override;
+    bool isThreadSafe() const override { return true; }
 
  private:
     double period;       // sidereal rotation period (in Julian days)
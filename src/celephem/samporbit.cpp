@@ -14,14 +14,17 @@
 
 #include <algorithm>
 #include <array>
+#include <cassert>
 #include <cctype>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <istream>
 #include <limits>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 #include <Eigen/Core>
@@ -32,6 +35,8 @@
 #include <celutil/bytes.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include <celutil/mappedfile.h>
+#include <celutil/memoryreport.h>
 #include "orbit.h"
 #include "xyzvbinary.h"
 
@@ -50,33 +55,92 @@ namespace
 //static const double MaxSampleInterval = 50.0;
 //static const double SampleThresholdAngle = 2.0;
 
-// Position-only sample
-template<typename T> struct Sample
+/*! The times of the samples of a trajectory, with a table for finding
+ *  the samples around a time without searching all of them: the time
+ *  range is split into as many buckets of equal length as there are
+ *  samples, and each bucket holds the index of its first sample. Only
+ *  the samples within a bucket are searched.
+ */
+class SampleIndex
 {
-    double t;
-    Eigen::Matrix<T, 3, 1> position;
-};
+public:
+    void add(double t) { times.push_back(t); }
 
-// Position + velocity sample
-template<typename T> struct SampleXYZV
-{
-    double t;
-    Eigen::Matrix<T, 3, 1> position;
-    Eigen::Matrix<T, 3, 1> velocity;
+    // Build the bucket table once all samples have been added
+    void build();
+
+    std::size_t size() const { return times.size(); }
+    bool empty() const { return times.empty(); }
+    double operator[](std::size_t i) const { return times[i]; }
+    std::size_t getMemoryUsage() const { return util::vectorMemory(times) + util::vectorMemory(buckets); }
+
+    // Return the index of the first sample at or after t, or the number
+    // of samples if all are before t.
+    std::size_t find(double t) const;
+
+    // Same as find(t) for t not before the time of sample n - 1
+    std::size_t findFrom(double t, std::size_t n) const
+    {
+        while (n < times.size() && times[n] < t)
+            ++n;
+        return n;
+    }
+
+private:
+    std::size_t getBucket(double t) const
+    {
+        double b = (t - times.front()) * bucketsPerDay;
+        return b <= 0.0 ? 0 : std::min(static_cast<std::size_t>(b), buckets.size() - 2);
+    }
+
+    std::vector<double> times;
+    // Index of the first sample in each bucket, followed by the number of
+    // samples
+    std::vector<std::uint32_t> buckets;
+    double bucketsPerDay{ 0.0 };
 };
 
 
-template<typename T> bool operator<(const Sample<T>& a, const Sample<T>& b)
+void SampleIndex::build()
 {
-    return a.t < b.t;
+    buckets.clear();
+    if (times.size() < 2 || !(times.back() > times.front()))
+        return;
+
+    std::size_t nBuckets = times.size();
+    bucketsPerDay = static_cast<double>(nBuckets) / (times.back() - times.front());
+    buckets.resize(nBuckets + 1);
+
+    // The samples are assigned with getBucket(), as they will be looked up,
+    // so rounding can't put a sample in the wrong bucket.
+    std::size_t i = 0;
+    for (std::size_t b = 0; b <= nBuckets; b++)
+    {
+        while (i < times.size() && getBucket(times[i]) < b)
+            ++i;
+        buckets[b] = static_cast<std::uint32_t>(i);
+    }
+    buckets[nBuckets] = static_cast<std::uint32_t>(times.size());
 }
 
-template<typename T> bool operator<(const SampleXYZV<T>& a, const SampleXYZV<T>& b)
+
+std::size_t SampleIndex::find(double t) const
 {
-    return a.t < b.t;
+    if (times.empty() || t <= times.front())
+        return 0;
+    if (t > times.back())
+        return times.size();
+    if (buckets.empty())
+        return static_cast<std::size_t>(std::lower_bound(times.begin(), times.end(), t) - times.begin());
+
+    std::size_t b = getBucket(t);
+    auto first = times.begin() + buckets[b];
+    auto last = times.begin() + buckets[b + 1];
+    return static_cast<std::size_t>(std::lower_bound(first, last, t) - times.begin());
 }
 
 
+// Positions of a trajectory and the times they are at
 template<typename T> class SampledOrbit : public CachingOrbit
 {
 public:
@@ -84,6 +148,7 @@ public:
     ~SampledOrbit() override = default;
 
     void addSample(double t, const Eigen::Matrix<T, 3, 1>& position);
+    void finishSamples() { times.build(); }
 
     double getPeriod() const override;
     double getBoundingRadius() const override;
@@ -94,26 +159,37 @@ public:
     void getValidRange(double& begin, double& end) const override;
 
     void sample(double startTime, double endTime, OrbitSampleProc& proc) const override;
+    void sampleAtTimes(const std::vector<double>& t, OrbitSampleProc& proc) const override;
+    std::size_t getMemoryUsage() const override
+    {
+        return sizeof(*this) + times.getMemoryUsage() + util::vectorMemory(positions);
+    }
 
 private:
-    std::vector<Sample<T>> samples;
+    SampleIndex times;
+    std::vector<Eigen::Matrix<T, 3, 1>> positions;
     double boundingRadius;
     double period;
-    mutable int lastSample;
 
     TrajectoryInterpolation interpolation;
 
-    Eigen::Vector3d computePositionLinear(double jd, int n) const;
-    Eigen::Vector3d computePositionCubic(double jd, int n) const;
-    Eigen::Vector3d computeVelocityLinear(double jd, int n) const;
-    Eigen::Vector3d computeVelocityCubic(double jd, int n) const;
+    Eigen::Vector3d getPosition(std::size_t i) const { return positions[i].template cast<double>(); }
+
+    // Interpolate between samples n - 1 and n, where n is the result of
+    // times.find(jd)
+    Eigen::Vector3d interpolatePosition(double jd, std::size_t n) const;
+    Eigen::Vector3d interpolateVelocity(double jd, std::size_t n) const;
+
+    Eigen::Vector3d computePositionLinear(double jd, std::size_t n) const;
+    Eigen::Vector3d computePositionCubic(double jd, std::size_t n) const;
+    Eigen::Vector3d computeVelocityLinear(double jd, std::size_t n) const;
+    Eigen::Vector3d computeVelocityCubic(double jd, std::size_t n) const;
 };
 
 
 template<typename T> SampledOrbit<T>::SampledOrbit(TrajectoryInterpolation _interpolation) :
     boundingRadius(0.0),
     period(1.0),
-    lastSample(0),
     interpolation(_interpolation)
 {
 }
@@ -125,14 +201,13 @@ template<typename T> void SampledOrbit<T>::addSample(double t, const Eigen::Matr
     if (r > boundingRadius)
         boundingRadius = r;
 
-    Sample<T>& samp = samples.emplace_back();
-    samp.position = position;
-    samp.t = t;
+    times.add(t);
+    positions.push_back(position);
 }
 
 template<typename T> double SampledOrbit<T>::getPeriod() const
 {
-    return samples[samples.size() - 1].t - samples[0].t;
+    return times[times.size() - 1] - times[0];
 }
 
 
@@ -144,8 +219,8 @@ template<typename T> bool SampledOrbit<T>::isPeriodic() const
 
 template<typename T> void SampledOrbit<T>::getValidRange(double& begin, double& end) const
 {
-    begin = samples[0].t;
-    end = samples[samples.size() - 1].t;
+    begin = times[0];
+    end = times[times.size() - 1];
 }
 
 
@@ -175,57 +250,93 @@ Eigen::Vector3d cubicInterpolateVelocity(const Eigen::Vector3d& p0, const Eigen:
 }
 
 
-template <typename T> Eigen::Vector3d SampledOrbit<T>::computePosition(double jd) const
+// Position between two samples with positions and velocities
+Eigen::Vector3d interpolateXYZVPosition(TrajectoryInterpolation interpolation,
+                                        double t0, const Eigen::Vector3d& p0, const Eigen::Vector3d& v0,
+                                        double t1, const Eigen::Vector3d& p1, const Eigen::Vector3d& v1,
+                                        double jd)
 {
-    Eigen::Vector3d pos;
-    if (samples.size() == 0)
+    if (interpolation == TrajectoryInterpolation::Linear)
     {
-        pos = Eigen::Vector3d::Zero();
+        double t = (jd - t0) / (t1 - t0);
+        return p0 + t * (p1 - p0);
     }
-    else if (samples.size() == 1)
+
+    if (interpolation == TrajectoryInterpolation::Cubic)
     {
-        pos = samples[0].position.template cast<double>();
+        double h = t1 - t0;
+        double ih = 1.0 / h;
+        double t = (jd - t0) * ih;
+        return cubicInterpolate(p0, v0 * h, p1, v1 * h, t);
     }
-    else
+
+    // Unknown interpolation type
+    return Eigen::Vector3d::Zero();
+}
+
+
+// Velocity between two samples, the derivative of the interpolating
+// function for position
+Eigen::Vector3d interpolateXYZVVelocity(TrajectoryInterpolation interpolation,
+                                        double t0, const Eigen::Vector3d& p0, const Eigen::Vector3d& v0,
+                                        double t1, const Eigen::Vector3d& p1, const Eigen::Vector3d& v1,
+                                        double jd)
+{
+    if (interpolation == TrajectoryInterpolation::Linear)
     {
-        Sample<T> samp;
-        samp.t = jd;
-        int n = lastSample;
+        double hRecip = 1.0 / (t1 - t0);
+        return (p1 - p0) * hRecip * astro::daysToSecs(1.0);
+    }
 
-        if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
-        {
-            auto iter = std::lower_bound(samples.begin(), samples.end(), samp);
-            n = iter == samples.end()
-                ? n = samples.size()
-                : iter - samples.begin();
+    if (interpolation == TrajectoryInterpolation::Cubic)
+    {
+        double h = t1 - t0;
+        double ih = 1.0 / h;
+        double t = (jd - t0) * ih;
+        return cubicInterpolateVelocity(p0, v0 * h, p1, v1 * h, t) * ih;
+    }
 
-            lastSample = n;
-        }
+    // Unknown interpolation type
+    return Eigen::Vector3d::Zero();
+}
 
-        if (n == 0)
-        {
-            pos = samples[n].position.template cast<double>();
-        }
-        else if (n < (int) samples.size())
-        {
-            switch (interpolation)
-            {
-            case TrajectoryInterpolation::Linear:
-                pos = computePositionLinear(jd, n);
-                break;
-            case TrajectoryInterpolation::Cubic:
-                pos = computePositionCubic(jd, n);
-                break;
-            default: // Unknown interpolation type
-                pos = Eigen::Vector3d::Zero();
-                break;
-            }
-        }
-        else
+
+template <typename T> Eigen::Vector3d SampledOrbit<T>::computePosition(double jd) const
+{
+    return interpolatePosition(jd, times.find(jd));
+}
+
+
+template <typename T> Eigen::Vector3d SampledOrbit<T>::interpolatePosition(double jd, std::size_t n) const
+{
+    Eigen::Vector3d pos;
+    if (times.empty())
+    {
+        pos = Eigen::Vector3d::Zero();
+    }
+    else if (times.size() == 1 || n == 0)
+    {
+        pos = getPosition(0);
+    }
+    else if (n < times.size())
+    {
+        switch (interpolation)
         {
-            pos = samples[n - 1].position.template cast<double>();
+        case TrajectoryInterpolation::Linear:
+            pos = computePositionLinear(jd, n);
+            break;
+        case TrajectoryInterpolation::Cubic:
+            pos = computePositionCubic(jd, n);
+            break;
+        default: // Unknown interpolation type
+            pos = Eigen::Vector3d::Zero();
+            break;
         }
     }
+    else
+    {
+        pos = getPosition(n - 1);
+    }
 
     // Add correction for Celestia's coordinate system
     return Eigen::Vector3d(pos.x(), pos.z(), -pos.y());
@@ -233,48 +344,41 @@ template <typename T> Eigen::Vector3d SampledOrbit<T>::computePosition(double jd
 
 
 template<typename T> Eigen::Vector3d SampledOrbit<T>::computePositionLinear(double jd,
-                                                                            int n) const
+                                                                            std::size_t n) const
 {
-    Sample<T> s0 = samples[n - 1];
-    Sample<T> s1 = samples[n];
-
-    double t = (jd - s0.t) / (s1.t - s0.t);
-    return Eigen::Vector3d(celmath::lerp(t, (double) s0.position.x(), (double) s1.position.x()),
-                           celmath::lerp(t, (double) s0.position.y(), (double) s1.position.y()),
-                           celmath::lerp(t, (double) s0.position.z(), (double) s1.position.z()));
+    double t = (jd - times[n - 1]) / (times[n] - times[n - 1]);
+    Eigen::Vector3d p0 = getPosition(n - 1);
+    Eigen::Vector3d p1 = getPosition(n);
+    return Eigen::Vector3d(celmath::lerp(t, p0.x(), p1.x()),
+                           celmath::lerp(t, p0.y(), p1.y()),
+                           celmath::lerp(t, p0.z(), p1.z()));
 }
 
 
 template<typename T> Eigen::Vector3d SampledOrbit<T>::computePositionCubic(double jd,
-                                                                           int n) const
-{
-    Sample<T> s0 = n > 1
-        ? samples[n - 2]
-        : samples[n - 1];
-    Sample<T> s1 = samples[n - 1];
-    Sample<T> s2 = samples[n];
-    Sample<T> s3 = n < (int) samples.size() - 1
-        ? samples[n + 1]
-        : samples[n];
-
-    double h = s2.t - s1.t;
+                                                                           std::size_t n) const
+{
+    std::size_t i0 = n > 1 ? n - 2 : n - 1;
+    std::size_t i3 = n < times.size() - 1 ? n + 1 : n;
+
+    double h = times[n] - times[n - 1];
     double ih = 1.0 / h;
-    double t = (jd - s1.t) * ih;
-    Eigen::Vector3d p0 = s1.position.template cast<double>();
-    Eigen::Vector3d p1 = s2.position.template cast<double>();
+    double t = (jd - times[n - 1]) * ih;
+    Eigen::Vector3d p0 = getPosition(n - 1);
+    Eigen::Vector3d p1 = getPosition(n);
 
-    Eigen::Vector3d v10 = p0 - s0.position.template cast<double>();
+    Eigen::Vector3d v10 = p0 - getPosition(i0);
     Eigen::Vector3d v21 = p1 - p0;
-    Eigen::Vector3d v32 = s3.position.template cast<double>() - p1;
+    Eigen::Vector3d v32 = getPosition(i3) - p1;
 
     // Estimate velocities by averaging the differences at adjacent spans
     // (except at the end spans, where we just use a single velocity.)
     Eigen::Vector3d v0 = n > 1
-        ? (v10 * (0.5 / (s1.t - s0.t)) + v21 * (0.5 * ih)) * h
+        ? (v10 * (0.5 / (times[n - 1] - times[i0])) + v21 * (0.5 * ih)) * h
         : v21;
 
-    Eigen::Vector3d v1 = n < ((int) samples.size() - 1)
-        ? (v21 * (0.5 * ih) + v32 * (0.5 / (s3.t - s2.t))) * h
+    Eigen::Vector3d v1 = n < times.size() - 1
+        ? (v21 * (0.5 * ih) + v32 * (0.5 / (times[i3] - times[n]))) * h
         : v21;
 
     return cubicInterpolate(p0, v0, p1, v1, t);
@@ -282,49 +386,31 @@ template<typename T> Eigen::Vector3d SampledOrbit<T>::computePositionCubic(doubl
 
 
 template<typename T> Eigen::Vector3d SampledOrbit<T>::computeVelocity(double jd) const
+{
+    return interpolateVelocity(jd, times.find(jd));
+}
+
+
+template<typename T> Eigen::Vector3d SampledOrbit<T>::interpolateVelocity(double jd, std::size_t n) const
 {
     Eigen::Vector3d vel;
-    if (samples.size() < 2)
+    if (times.size() < 2 || n == 0 || n >= times.size())
     {
         vel = Eigen::Vector3d::Zero();
     }
     else
     {
-        Sample<T> samp;
-        samp.t = jd;
-        int n = lastSample;
-
-        if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
-        {
-            auto iter = std::lower_bound(samples.begin(), samples.end(), samp);
-            n = iter == samples.end()
-                ? samples.size()
-                : iter - samples.begin();
-            lastSample = n;
-        }
-
-        if (n == 0)
-        {
-            vel = Eigen::Vector3d::Zero();
-        }
-        else if (n < (int) samples.size())
-        {
-            switch (interpolation)
-            {
-            case TrajectoryInterpolation::Linear:
-                vel = computeVelocityLinear(jd, n);
-                break;
-            case TrajectoryInterpolation::Cubic:
-                vel = computeVelocityCubic(jd, n);
-                break;
-            default: // Unknown interpolation type
-                vel = Eigen::Vector3d::Zero();
-                break;
-            }
-        }
-        else
+        switch (interpolation)
         {
+        case TrajectoryInterpolation::Linear:
+            vel = computeVelocityLinear(jd, n);
+            break;
+        case TrajectoryInterpolation::Cubic:
+            vel = computeVelocityCubic(jd, n);
+            break;
+        default: // Unknown interpolation type
             vel = Eigen::Vector3d::Zero();
+            break;
         }
     }
 
@@ -332,47 +418,38 @@ template<typename T> Eigen::Vector3d SampledOrbit<T>::computeVelocity(double jd)
 }
 
 
-template<typename T> Eigen::Vector3d SampledOrbit<T>::computeVelocityLinear(double jd,
-                                                                            int n) const
+template<typename T> Eigen::Vector3d SampledOrbit<T>::computeVelocityLinear(double /*jd*/,
+                                                                            std::size_t n) const
 {
-    Sample<T> s0 = samples[n - 1];
-    Sample<T> s1 = samples[n];
-
-    double dtRecip = 1.0 / (s1.t - s0.t);
-    return (s1.position.template cast<double>() - s0.position.template cast<double>()) * dtRecip;
+    double dtRecip = 1.0 / (times[n] - times[n - 1]);
+    return (getPosition(n) - getPosition(n - 1)) * dtRecip;
 }
 
 
 template<typename T> Eigen::Vector3d SampledOrbit<T>::computeVelocityCubic(double jd,
-                                                                           int n) const
-{
-    Sample<T> s0 = n > 1
-        ? samples[n - 2]
-        : samples[n - 1];
-    Sample<T> s1 = samples[n - 1];
-    Sample<T> s2 = samples[n];
-    Sample<T> s3 = n < ((int) samples.size() - 1)
-        ? samples[n + 1]
-        : samples[n];
-
-    double h = s2.t - s1.t;
+                                                                           std::size_t n) const
+{
+    std::size_t i0 = n > 1 ? n - 2 : n - 1;
+    std::size_t i3 = n < times.size() - 1 ? n + 1 : n;
+
+    double h = times[n] - times[n - 1];
     double ih = 1.0 / h;
-    double t = (jd - s1.t) * ih;
-    Eigen::Vector3d p0 = s1.position.template cast<double>();
-    Eigen::Vector3d p1 = s2.position.template cast<double>();
+    double t = (jd - times[n - 1]) * ih;
+    Eigen::Vector3d p0 = getPosition(n - 1);
+    Eigen::Vector3d p1 = getPosition(n);
 
-    Eigen::Vector3d v10 = p0 - s0.position.template cast<double>();
+    Eigen::Vector3d v10 = p0 - getPosition(i0);
     Eigen::Vector3d v21 = p1 - p0;
-    Eigen::Vector3d v32 = s3.position.template cast<double>() - p1;
+    Eigen::Vector3d v32 = getPosition(i3) - p1;
 
     // Estimate velocities by averaging the differences at adjacent spans
     // (except at the end spans, where we just use a single velocity.)
     Eigen::Vector3d v0 = n > 1
-        ? (v10 * (0.5 / (s1.t - s0.t)) + v21 * (0.5 * ih)) * h
+        ? (v10 * (0.5 / (times[n - 1] - times[i0])) + v21 * (0.5 * ih)) * h
         : v21;
 
-    Eigen::Vector3d v1 = n < ((int) samples.size() - 1)
-        ? (v21 * (0.5 * ih) + v32 * (0.5 / (s3.t - s2.t))) * h
+    Eigen::Vector3d v1 = n < times.size() - 1
+        ? (v21 * (0.5 * ih) + v32 * (0.5 / (times[i3] - times[n]))) * h
         : v21;
 
     return cubicInterpolateVelocity(p0, v0, p1, v1, t) * (1.0 / h);
@@ -382,41 +459,55 @@ template<typename T> Eigen::Vector3d SampledOrbit<T>::computeVelocityCubic(doubl
 template<typename T> void SampledOrbit<T>::sample(double /* startTime */, double /* endTime */,
                                                   OrbitSampleProc& proc) const
 {
-    for (unsigned int i = 0; i < samples.size(); i++)
+    for (std::size_t i = 0; i < times.size(); i++)
     {
         Eigen::Vector3d v;
-        Eigen::Vector3d p = samples[i].position.template cast<double>();
+        Eigen::Vector3d p = getPosition(i);
 
-        if (samples.size() == 1)
+        if (times.size() == 1)
         {
             v = Eigen::Vector3d::Zero();
         }
         else if (i == 0)
         {
-            double dtRecip = 1.0 / (samples[i + 1].t - samples[i].t);
-            v = (samples[i + 1].position.template cast<double>() - p) * dtRecip;
+            double dtRecip = 1.0 / (times[i + 1] - times[i]);
+            v = (getPosition(i + 1) - p) * dtRecip;
         }
-        else if (i == samples.size() - 1)
+        else if (i == times.size() - 1)
         {
-            double dtRecip = 1.0 / (samples[i].t - samples[i - 1].t);
-            v = (p - samples[i - 1].position.template cast<double>()) * dtRecip;
+            double dtRecip = 1.0 / (times[i] - times[i - 1]);
+            v = (p - getPosition(i - 1)) * dtRecip;
         }
         else
         {
-            double dt0Recip = 1.0 / (samples[i + 1].t - samples[i].t);
-            Eigen::Vector3d v0 = (samples[i + 1].position.template cast<double>() - p) * dt0Recip;
-            double dt1Recip = 1.0 / (samples[i].t - samples[i - 1].t);
-            Eigen::Vector3d v1 = (p - samples[i - 1].position.template cast<double>()) * dt1Recip;
+            double dt0Recip = 1.0 / (times[i + 1] - times[i]);
+            Eigen::Vector3d v0 = (getPosition(i + 1) - p) * dt0Recip;
+            double dt1Recip = 1.0 / (times[i] - times[i - 1]);
+            Eigen::Vector3d v1 = (p - getPosition(i - 1)) * dt1Recip;
             v = (v0 + v1) * 0.5;
         }
 
-        proc.sample(samples[i].t,
+        proc.sample(times[i],
                     Eigen::Vector3d(p.x(), p.z(), -p.y()),
                     Eigen::Vector3d(v.x(), v.z(), -v.y()));
     }
 }
 
 
+// The samples are found by stepping forward from the one of the previous
+// time.
+template<typename T> void SampledOrbit<T>::sampleAtTimes(const std::vector<double>& t,
+                                                         OrbitSampleProc& proc) const
+{
+    std::size_t n = t.empty() ? 0 : times.find(t.front());
+    for (double jd : t)
+    {
+        n = times.findFrom(jd, n);
+        proc.sample(jd, interpolatePosition(jd, n), interpolateVelocity(jd, n));
+    }
+}
+
+
 // Sampled orbit with positions and velocities
 template <typename T> class SampledOrbitXYZV : public CachingOrbit
 {
@@ -427,6 +518,7 @@ public:
     void addSample(double t,
                    const Eigen::Matrix<T, 3, 1>& position,
                    const Eigen::Matrix<T, 3, 1>& velocity);
+    void finishSamples() { times.build(); }
 
     double getPeriod() const override;
     double getBoundingRadius() const override;
@@ -437,21 +529,31 @@ public:
     void getValidRange(double& begin, double& end) const override;
 
     void sample(double startTime, double endTime, OrbitSampleProc& proc) const override;
+    void sampleAtTimes(const std::vector<double>& t, OrbitSampleProc& proc) const override;
+    std::size_t getMemoryUsage() const override
+    {
+        return sizeof(*this) + times.getMemoryUsage() + util::vectorMemory(positions) + util::vectorMemory(velocities);
+    }
 
 private:
-    std::vector<SampleXYZV<T>> samples;
+    SampleIndex times;
+    std::vector<Eigen::Matrix<T, 3, 1>> positions;
+    std::vector<Eigen::Matrix<T, 3, 1>> velocities;
     double boundingRadius;
     double period;
-    mutable int lastSample;
 
     TrajectoryInterpolation interpolation;
+
+    // Interpolate between samples n - 1 and n, where n is the result of
+    // times.find(jd)
+    Eigen::Vector3d interpolatePosition(double jd, std::size_t n) const;
+    Eigen::Vector3d interpolateVelocity(double jd, std::size_t n) const;
 };
 
 
 template <typename T> SampledOrbitXYZV<T>::SampledOrbitXYZV(TrajectoryInterpolation _interpolation) :
     boundingRadius(0.0),
     period(1.0),
-    lastSample(0),
     interpolation(_interpolation)
 {
 }
@@ -468,18 +570,17 @@ template<typename T> void SampledOrbitXYZV<T>::addSample(double t,
     if (r > boundingRadius)
         boundingRadius = r;
 
-    SampleXYZV<T>& samp = samples.emplace_back();
-    samp.t = t;
-    samp.position = position;
-    samp.velocity = velocity;
+    times.add(t);
+    positions.push_back(position);
+    velocities.push_back(velocity);
 }
 
 template <typename T> double SampledOrbitXYZV<T>::getPeriod() const
 {
-    if (samples.empty())
+    if (times.empty())
         return 0.0;
 
-    return samples[samples.size() - 1].t - samples[0].t;
+    return times[times.size() - 1] - times[0];
 }
 
 
@@ -491,8 +592,8 @@ template <typename T> bool SampledOrbitXYZV<T>::isPeriodic() const
 
 template <typename T> void SampledOrbitXYZV<T>::getValidRange(double& begin, double& end) const
 {
-    begin = samples[0].t;
-    end = samples[samples.size() - 1].t;
+    begin = times[0];
+    end = times[times.size() - 1];
 }
 
 
@@ -503,148 +604,427 @@ template <typename T> double SampledOrbitXYZV<T>::getBoundingRadius() const
 
 
 template <typename T> Eigen::Vector3d SampledOrbitXYZV<T>::computePosition(double jd) const
+{
+    return interpolatePosition(jd, times.find(jd));
+}
+
+
+template <typename T> Eigen::Vector3d SampledOrbitXYZV<T>::interpolatePosition(double jd, std::size_t n) const
 {
     Eigen::Vector3d pos;
-    if (samples.size() == 0)
+    if (times.empty())
     {
         pos = Eigen::Vector3d::Zero();
     }
-    else if (samples.size() == 1)
+    else if (times.size() == 1 || n == 0)
+    {
+        pos = positions[0].template cast<double>();
+    }
+    else if (n < times.size())
     {
-        pos = samples[0].position.template cast<double>();
+        pos = interpolateXYZVPosition(interpolation,
+                                      times[n - 1],
+                                      positions[n - 1].template cast<double>(),
+                                      velocities[n - 1].template cast<double>(),
+                                      times[n],
+                                      positions[n].template cast<double>(),
+                                      velocities[n].template cast<double>(),
+                                      jd);
     }
     else
     {
-        SampleXYZV<T> samp;
-        samp.t = jd;
-        int n = lastSample;
+        pos = positions[n - 1].template cast<double>();
+    }
 
-        if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
-        {
-            auto iter = std::lower_bound(samples.begin(), samples.end(), samp);
-            if (iter == samples.end())
-                n = samples.size();
-            else
-                n = iter - samples.begin();
+    // Add correction for Celestia's coordinate system
+    return Eigen::Vector3d(pos.x(), pos.z(), -pos.y());
+}
 
-            lastSample = n;
-        }
 
-        if (n == 0)
-        {
-            pos = samples[n].position.template cast<double>();
-        }
-        else if (n < (int) samples.size())
-        {
-            SampleXYZV<T> s0 = samples[n - 1];
-            SampleXYZV<T> s1 = samples[n];
+template<typename T> Eigen::Vector3d SampledOrbitXYZV<T>::computeVelocity(double jd) const
+{
+    return interpolateVelocity(jd, times.find(jd));
+}
 
-            if (interpolation == TrajectoryInterpolation::Linear)
-            {
-                double t = (jd - s0.t) / (s1.t - s0.t);
 
-                Eigen::Vector3d p0 = s0.position.template cast<double>();
-                Eigen::Vector3d p1 = s1.position.template cast<double>();
-                pos = p0 + t * (p1 - p0);
-            }
-            else if (interpolation == TrajectoryInterpolation::Cubic)
-            {
-                double h = s1.t - s0.t;
-                double ih = 1.0 / h;
-                double t = (jd - s0.t) * ih;
-
-                Eigen::Vector3d p0 = s0.position.template cast<double>();
-                Eigen::Vector3d v0 = s0.velocity.template cast<double>();
-                Eigen::Vector3d p1 = s1.position.template cast<double>();
-                Eigen::Vector3d v1 = s1.velocity.template cast<double>();
-                pos = cubicInterpolate(p0, v0 * h, p1, v1 * h, t);
-            }
-            else
-            {
-                // Unknown interpolation type
-                pos = Eigen::Vector3d::Zero();
-            }
-        }
-        else
-        {
-            pos = samples[n - 1].position.template cast<double>();
-        }
+// Velocity is computed as the derivative of the interpolating function
+// for position.
+template<typename T> Eigen::Vector3d SampledOrbitXYZV<T>::interpolateVelocity(double jd, std::size_t n) const
+{
+    Eigen::Vector3d vel(Eigen::Vector3d::Zero());
+
+    if (times.size() >= 2 && n > 0 && n < times.size())
+    {
+        vel = interpolateXYZVVelocity(interpolation,
+                                      times[n - 1],
+                                      positions[n - 1].template cast<double>(),
+                                      velocities[n - 1].template cast<double>(),
+                                      times[n],
+                                      positions[n].template cast<double>(),
+                                      velocities[n].template cast<double>(),
+                                      jd);
     }
 
     // Add correction for Celestia's coordinate system
-    return Eigen::Vector3d(pos.x(), pos.z(), -pos.y());
+    return Eigen::Vector3d(vel.x(), vel.z(), -vel.y());
 }
 
 
-// Velocity is computed as the derivative of the interpolating function
-// for position.
-template<typename T> Eigen::Vector3d SampledOrbitXYZV<T>::computeVelocity(double jd) const
+template<typename T> void SampledOrbitXYZV<T>::sample(double /* startTime */, double /* endTime */,
+                                                      OrbitSampleProc& proc) const
 {
-    Eigen::Vector3d vel(Eigen::Vector3d::Zero());
+    for (std::size_t i = 0; i < times.size(); i++)
+    {
+        const auto& position = positions[i];
+        const auto& velocity = velocities[i];
+        proc.sample(times[i],
+                    Eigen::Vector3d(position.x(), position.z(), -position.y()),
+                    Eigen::Vector3d(velocity.x(), velocity.z(), -velocity.y()));
+    }
+}
+
 
-    if (samples.size() >= 2)
+template<typename T> void SampledOrbitXYZV<T>::sampleAtTimes(const std::vector<double>& t,
+                                                             OrbitSampleProc& proc) const
+{
+    std::size_t n = t.empty() ? 0 : times.find(t.front());
+    for (double jd : t)
     {
-        SampleXYZV<T> samp;
-        samp.t = jd;
-        int n = lastSample;
+        n = times.findFrom(jd, n);
+        proc.sample(jd, interpolatePosition(jd, n), interpolateVelocity(jd, n));
+    }
+}
 
-        if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
-        {
-            auto iter = std::lower_bound(samples.begin(), samples.end(), samp);
-            if (iter == samples.end())
-                n = samples.size();
-            else
-                n = iter - samples.begin();
 
-            lastSample = n;
-        }
+/*! A trajectory with positions and velocities read from a mapped binary
+ *  xyzv file when they are needed, so that only the pages around the times
+ *  in use are loaded. Records are found with the index block of the file
+ *  if it has one; otherwise the times of every IndexStride-th record are
+ *  read at load.
+ */
+class MappedSampledOrbitXYZV : public CachingOrbit
+{
+public:
+    MappedSampledOrbitXYZV(std::unique_ptr<util::MappedFile>&& _file,
+                           std::size_t _nRecords,
+                           TrajectoryInterpolation _interpolation);
+    ~MappedSampledOrbitXYZV() override = default;
 
-        if (n > 0 && n < (int) samples.size())
-        {
-            SampleXYZV<T> s0 = samples[n - 1];
-            SampleXYZV<T> s1 = samples[n];
+    // Read the index block, or the coarse index and bounding radius
+    void buildIndex();
 
-            if (interpolation == TrajectoryInterpolation::Linear)
-            {
-                double hRecip = 1.0 / (s1.t - s0.t);
-                vel = (s1.position.template cast<double>() - s0.position.template cast<double>()) *
-                      hRecip *
-                      astro::daysToSecs(1.0);
-            }
-            else if (interpolation == TrajectoryInterpolation::Cubic)
-            {
-                double h = s1.t - s0.t;
-                double ih = 1.0 / h;
-                double t = (jd - s0.t) * ih;
+    double getPeriod() const override;
+    double getBoundingRadius() const override;
+    Eigen::Vector3d computePosition(double jd) const override;
+    Eigen::Vector3d computeVelocity(double jd) const override;
 
-                Eigen::Vector3d p0 = s0.position.template cast<double>();
-                Eigen::Vector3d p1 = s1.position.template cast<double>();
-                Eigen::Vector3d v0 = s0.velocity.template cast<double>();
-                Eigen::Vector3d v1 = s1.velocity.template cast<double>();
+    bool isPeriodic() const override;
+    void getValidRange(double& begin, double& end) const override;
 
-                vel = cubicInterpolateVelocity(p0, v0 * h, p1, v1 * h, t) * ih;
-            }
-            else
-            {
-                // Unknown interpolation type
-                vel = Eigen::Vector3d::Zero();
-            }
+    void sample(double startTime, double endTime, OrbitSampleProc& proc) const override;
+    void sampleAtTimes(const std::vector<double>& t, OrbitSampleProc& proc) const override;
+    // The records stay in the mapped file, whose pages the system can drop
+    std::size_t getMemoryUsage() const override
+    {
+        return sizeof(*this) + util::vectorMemory(coarseTimes);
+    }
+
+private:
+    static constexpr std::size_t IndexStride = 1024;
+    // Records stepped over before a batched lookup searches instead
+    static constexpr std::size_t MaxSteps = 8;
+
+    double getTime(std::size_t i) const
+    {
+        double tdb;
+        std::memcpy(&tdb, records + i * sizeof(XYZVBinaryData) + offsetof(XYZVBinaryData, tdb), sizeof(tdb));
+        return tdb;
+    }
+
+    // Position in km and velocity in km/Julian day
+    void getRecord(std::size_t i, Eigen::Vector3d& position, Eigen::Vector3d& velocity) const;
+
+    bool readIndexBlock();
+
+    // Index of the first record at or after jd, or the number of records
+    std::size_t find(double jd) const;
+    // Same as find(jd) for jd not before the time of record n - 1
+    std::size_t findFrom(double jd, std::size_t n) const;
+    // Index of the first record in [first, last) at or after jd, or last
+    std::size_t search(double jd, std::size_t first, std::size_t last) const;
+
+    Eigen::Vector3d interpolatePosition(double jd, std::size_t n) const;
+    Eigen::Vector3d interpolateVelocity(double jd, std::size_t n) const;
+
+    std::unique_ptr<util::MappedFile> file;
+    const char* records;
+    std::size_t nRecords;
+    double boundingRadius{ 0.0 };
+
+    TrajectoryInterpolation interpolation;
+
+    // Index block of the file
+    const char* buckets{ nullptr };
+    std::size_t nBuckets{ 0 };
+    double indexStartTime{ 0.0 };
+    double bucketsPerDay{ 0.0 };
+
+    // Times of every IndexStride-th record, if there's no index block
+    std::vector<double> coarseTimes;
+};
+
+
+MappedSampledOrbitXYZV::MappedSampledOrbitXYZV(std::unique_ptr<util::MappedFile>&& _file,
+                                               std::size_t _nRecords,
+                                               TrajectoryInterpolation _interpolation) :
+    file(std::move(_file)),
+    records(file->data() + sizeof(XYZVBinaryHeader)),
+    nRecords(_nRecords),
+    interpolation(_interpolation)
+{
+    assert(nRecords > 0);
+}
+
+
+void MappedSampledOrbitXYZV::getRecord(std::size_t i,
+                                       Eigen::Vector3d& position,
+                                       Eigen::Vector3d& velocity) const
+{
+    const char* record = records + i * sizeof(XYZVBinaryData);
+    std::memcpy(position.data(), record + offsetof(XYZVBinaryData, position), sizeof(double) * 3);
+    std::memcpy(velocity.data(), record + offsetof(XYZVBinaryData, velocity), sizeof(double) * 3);
+
+    // Convert velocities from km/sec to km/Julian day
+    velocity *= astro::daysToSecs(1.0);
+}
+
+
+bool MappedSampledOrbitXYZV::readIndexBlock()
+{
+    std::size_t offset = sizeof(XYZVBinaryHeader) + nRecords * sizeof(XYZVBinaryData);
+    if (file->size() - offset < sizeof(XYZVBinaryIndex))
+        return false;
+
+    const char* index = file->data() + offset;
+    if (std::string_view(index + offsetof(XYZVBinaryIndex, magic), XYZV_INDEX_MAGIC.size()) != XYZV_INDEX_MAGIC)
+        return false;
+
+    std::uint64_t count;
+    std::memcpy(&count, index + offsetof(XYZVBinaryIndex, count), sizeof(count));
+    std::size_t available = (file->size() - offset - sizeof(XYZVBinaryIndex)) / sizeof(std::uint64_t);
+    if (count == 0 || count >= available)
+        return false;
+
+    std::memcpy(&indexStartTime, index + offsetof(XYZVBinaryIndex, startTime), sizeof(double));
+    std::memcpy(&bucketsPerDay, index + offsetof(XYZVBinaryIndex, bucketsPerDay), sizeof(double));
+    std::memcpy(&boundingRadius, index + offsetof(XYZVBinaryIndex, boundingRadius), sizeof(double));
+    if (!std::isfinite(indexStartTime) || !(bucketsPerDay > 0.0) || !std::isfinite(bucketsPerDay))
+        return false;
+
+    buckets = index + sizeof(XYZVBinaryIndex);
+    nBuckets = static_cast<std::size_t>(count);
+    return true;
+}
+
+
+void MappedSampledOrbitXYZV::buildIndex()
+{
+    if (readIndexBlock())
+        return;
+
+    // This reads the whole file once, but the pages are only cached by the
+    // system, and can be dropped again.
+    coarseTimes.reserve((nRecords + IndexStride - 1) / IndexStride);
+    for (std::size_t i = 0; i < nRecords; i++)
+    {
+        Eigen::Vector3d position;
+        Eigen::Vector3d velocity;
+        getRecord(i, position, velocity);
+        boundingRadius = std::max(boundingRadius, position.norm());
+        if (i % IndexStride == 0)
+            coarseTimes.push_back(getTime(i));
+    }
+}
+
+
+std::size_t MappedSampledOrbitXYZV::search(double jd, std::size_t first, std::size_t last) const
+{
+    while (first < last)
+    {
+        std::size_t mid = first + (last - first) / 2;
+        if (getTime(mid) < jd)
+            first = mid + 1;
+        else
+            last = mid;
+    }
+
+    return first;
+}
+
+
+std::size_t MappedSampledOrbitXYZV::find(double jd) const
+{
+    if (jd <= getTime(0))
+        return 0;
+    if (jd > getTime(nRecords - 1))
+        return nRecords;
+
+    std::size_t first = 0;
+    std::size_t last = nRecords;
+    if (buckets != nullptr)
+    {
+        double b = (jd - indexStartTime) * bucketsPerDay;
+        std::size_t bucket = b <= 0.0 ? 0 : std::min(static_cast<std::size_t>(b), nBuckets - 1);
+        std::uint64_t range[2];
+        std::memcpy(range, buckets + bucket * sizeof(std::uint64_t), sizeof(range));
+
+        // Records don't move, but the index could be wrong; it's only used
+        // if the result is certain to lie within the bucket.
+        if (range[0] <= range[1] && range[1] <= nRecords &&
+            (range[0] == 0 || getTime(range[0] - 1) < jd) &&
+            (range[1] == nRecords || getTime(range[1]) >= jd))
+        {
+            first = static_cast<std::size_t>(range[0]);
+            last = static_cast<std::size_t>(range[1]);
         }
     }
+    else
+    {
+        // The first coarse time is that of record 0, which is before jd
+        auto coarse = std::lower_bound(coarseTimes.begin(), coarseTimes.end(), jd);
+        std::size_t c = static_cast<std::size_t>(coarse - coarseTimes.begin());
+        first = (c - 1) * IndexStride + 1;
+        last = std::min(c * IndexStride, nRecords);
+    }
+
+    return search(jd, first, last);
+}
+
+
+std::size_t MappedSampledOrbitXYZV::findFrom(double jd, std::size_t n) const
+{
+    for (std::size_t steps = 0; n < nRecords && getTime(n) < jd; steps++)
+    {
+        if (steps == MaxSteps)
+            return find(jd);
+        ++n;
+    }
+
+    return n;
+}
+
+
+double MappedSampledOrbitXYZV::getPeriod() const
+{
+    return getTime(nRecords - 1) - getTime(0);
+}
+
+
+bool MappedSampledOrbitXYZV::isPeriodic() const
+{
+    return false;
+}
+
+
+void MappedSampledOrbitXYZV::getValidRange(double& begin, double& end) const
+{
+    begin = getTime(0);
+    end = getTime(nRecords - 1);
+}
+
+
+double MappedSampledOrbitXYZV::getBoundingRadius() const
+{
+    return boundingRadius;
+}
+
+
+Eigen::Vector3d MappedSampledOrbitXYZV::computePosition(double jd) const
+{
+    return interpolatePosition(jd, find(jd));
+}
+
+
+Eigen::Vector3d MappedSampledOrbitXYZV::interpolatePosition(double jd, std::size_t n) const
+{
+    Eigen::Vector3d p0;
+    Eigen::Vector3d v0;
+    Eigen::Vector3d pos;
+    if (n == 0)
+    {
+        getRecord(0, pos, v0);
+    }
+    else if (n < nRecords)
+    {
+        Eigen::Vector3d p1;
+        Eigen::Vector3d v1;
+        getRecord(n - 1, p0, v0);
+        getRecord(n, p1, v1);
+        pos = interpolateXYZVPosition(interpolation, getTime(n - 1), p0, v0, getTime(n), p1, v1, jd);
+    }
+    else
+    {
+        getRecord(n - 1, pos, v0);
+    }
+
+    // Add correction for Celestia's coordinate system
+    return Eigen::Vector3d(pos.x(), pos.z(), -pos.y());
+}
+
+
+Eigen::Vector3d MappedSampledOrbitXYZV::computeVelocity(double jd) const
+{
+    return interpolateVelocity(jd, find(jd));
+}
+
+
+Eigen::Vector3d MappedSampledOrbitXYZV::interpolateVelocity(double jd, std::size_t n) const
+{
+    Eigen::Vector3d vel(Eigen::Vector3d::Zero());
+    if (n > 0 && n < nRecords)
+    {
+        Eigen::Vector3d p0;
+        Eigen::Vector3d v0;
+        Eigen::Vector3d p1;
+        Eigen::Vector3d v1;
+        getRecord(n - 1, p0, v0);
+        getRecord(n, p1, v1);
+        vel = interpolateXYZVVelocity(interpolation, getTime(n - 1), p0, v0, getTime(n), p1, v1, jd);
+    }
 
     // Add correction for Celestia's coordinate system
     return Eigen::Vector3d(vel.x(), vel.z(), -vel.y());
 }
 
 
-template<typename T> void SampledOrbitXYZV<T>::sample(double /* startTime */, double /* endTime */,
-                                                      OrbitSampleProc& proc) const
+// Only the records in the time range, and those just outside of it, are
+// passed, so that the pages of the rest aren't loaded.
+void MappedSampledOrbitXYZV::sample(double startTime, double endTime, OrbitSampleProc& proc) const
 {
-    for (const auto& sample : samples)
+    std::size_t first = find(startTime);
+    if (first > 0)
+        --first;
+    std::size_t last = std::min(find(endTime) + 1, nRecords);
+
+    for (std::size_t i = first; i < last; i++)
     {
-        proc.sample(sample.t,
-                    Eigen::Vector3d(sample.position.x(), sample.position.z(), -sample.position.y()),
-                    Eigen::Vector3d(sample.velocity.x(), sample.velocity.z(), -sample.velocity.y()));
+        Eigen::Vector3d position;
+        Eigen::Vector3d velocity;
+        getRecord(i, position, velocity);
+        proc.sample(getTime(i),
+                    Eigen::Vector3d(position.x(), position.z(), -position.y()),
+                    Eigen::Vector3d(velocity.x(), velocity.z(), -velocity.y()));
+    }
+}
+
+
+void MappedSampledOrbitXYZV::sampleAtTimes(const std::vector<double>& t, OrbitSampleProc& proc) const
+{
+    std::size_t n = t.empty() ? 0 : find(t.front());
+    for (double jd : t)
+    {
+        n = findFrom(jd, n);
+        proc.sample(jd, interpolatePosition(jd, n), interpolateVelocity(jd, n));
     }
 }
 
@@ -741,6 +1121,7 @@ LoadSampledOrbit(const fs::path& filename, TrajectoryInterpolation interpolation
         }
     }
 
+    orbit->finishSamples();
     return orbit;
 }
 
@@ -802,28 +1183,22 @@ LoadSampledOrbitXYZV(const fs::path& filename, TrajectoryInterpolation interpola
         }
     }
 
+    orbit->finishSamples();
     return orbit;
 }
 
+// Check the header of a binary xyzv file and get the number of records
 bool
-ParseXYZVBinaryHeader(std::istream& in, const fs::path& filename)
+ParseXYZVBinaryHeader(const char* header, const fs::path& filename, std::uint64_t& count)
 {
-    std::array<char, sizeof(XYZVBinaryHeader)> header;
-
-    if (!in.read(header.data(), header.size())) /* Flawfinder: ignore */
-    {
-        GetLogger()->error(_("Error reading header of {}.\n"), filename);
-        return false;
-    }
-
-    if (std::string_view(header.data() + offsetof(XYZVBinaryHeader, magic), XYZV_MAGIC.size()) != XYZV_MAGIC)
+    if (std::string_view(header + offsetof(XYZVBinaryHeader, magic), XYZV_MAGIC.size()) != XYZV_MAGIC)
     {
         GetLogger()->error(_("Bad binary xyzv file {}.\n"), filename);
         return false;
     }
 
     decltype(XYZVBinaryHeader::byteOrder) byteOrder;
-    std::memcpy(&byteOrder, header.data() + offsetof(XYZVBinaryHeader, byteOrder), sizeof(byteOrder));
+    std::memcpy(&byteOrder, header + offsetof(XYZVBinaryHeader, byteOrder), sizeof(byteOrder));
     if (byteOrder != __BYTE_ORDER__)
     {
         GetLogger()->error(_("Unsupported byte order {}, expected {}.\n"),
@@ -832,7 +1207,7 @@ ParseXYZVBinaryHeader(std::istream& in, const fs::path& filename)
     }
 
     decltype(XYZVBinaryHeader::digits) digits;
-    std::memcpy(&digits, header.data() + offsetof(XYZVBinaryHeader, digits), sizeof(digits));
+    std::memcpy(&digits, header + offsetof(XYZVBinaryHeader, digits), sizeof(digits));
     if (digits != std::numeric_limits<double>::digits)
     {
         GetLogger()->error(_("Unsupported digits number {}, expected {}.\n"),
@@ -840,14 +1215,8 @@ ParseXYZVBinaryHeader(std::istream& in, const fs::path& filename)
         return false;
     }
 
-    decltype(XYZVBinaryHeader::count) count;
-    std::memcpy(&count, header.data() + offsetof(XYZVBinaryHeader, count), sizeof(count));
-    if (count == 0)
-    {
-        return false;
-    }
-
-    return true;
+    std::memcpy(&count, header + offsetof(XYZVBinaryHeader, count), sizeof(count));
+    return count != 0;
 }
 
 /* Load a binary xyzv sampled trajectory file.
@@ -862,12 +1231,22 @@ LoadSampledOrbitXYZVBinary(const fs::path& filename, TrajectoryInterpolation int
         return nullptr;
     }
 
-    ParseXYZVBinaryHeader(in, filename);
+    std::array<char, sizeof(XYZVBinaryHeader)> header;
+    if (!in.read(header.data(), header.size())) /* Flawfinder: ignore */
+    {
+        GetLogger()->error(_("Error reading header of {}.\n"), filename);
+        return nullptr;
+    }
+
+    std::uint64_t count;
+    if (!ParseXYZVBinaryHeader(header.data(), filename, count))
+        return nullptr;
 
     auto orbit = std::make_unique<SampledOrbitXYZV<T>>(interpolation);
     double lastSampleTime = -std::numeric_limits<T>::infinity();
 
-    while (in.good())
+    // The records may be followed by an index block
+    for (std::uint64_t i = 0; i < count; i++)
     {
         std::array<char, sizeof(XYZVBinaryData)> data;
         if (!in.read(data.data(), data.size())) /* Flawfinder: ignore */
@@ -893,9 +1272,186 @@ LoadSampledOrbitXYZVBinary(const fs::path& filename, TrajectoryInterpolation int
         }
     }
 
+    orbit->finishSamples();
     return orbit;
 }
 
+// Read a signed LEB128 varint in zigzag encoding
+bool
+ReadVarint(const char*& data, const char* end, std::int64_t& value)
+{
+    std::uint64_t bits = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7)
+    {
+        if (data == end)
+            return false;
+
+        auto byte = static_cast<std::uint8_t>(*data++);
+        bits |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            value = static_cast<std::int64_t>(bits >> 1) ^ -static_cast<std::int64_t>(bits & 1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Load a compressed binary xyzv trajectory. The knots are the ends of
+ * Hermite segments, so they are always interpolated as cubics.
+ */
+template <typename T> std::unique_ptr<SampledOrbitXYZV<T>>
+LoadCompressedOrbitXYZV(const char* data, std::size_t size, const fs::path& filename)
+{
+    if (size < sizeof(XYZVCompressedHeader))
+    {
+        GetLogger()->error(_("Error reading header of {}.\n"), filename);
+        return nullptr;
+    }
+
+    decltype(XYZVCompressedHeader::byteOrder) byteOrder;
+    std::memcpy(&byteOrder, data + offsetof(XYZVCompressedHeader, byteOrder), sizeof(byteOrder));
+    decltype(XYZVCompressedHeader::digits) digits;
+    std::memcpy(&digits, data + offsetof(XYZVCompressedHeader, digits), sizeof(digits));
+    if (byteOrder != __BYTE_ORDER__ || digits != std::numeric_limits<double>::digits)
+    {
+        GetLogger()->error(_("Unsupported byte order {} or digits number {} in {}.\n"),
+                           byteOrder, digits, filename);
+        return nullptr;
+    }
+
+    std::uint64_t count;
+    std::memcpy(&count, data + offsetof(XYZVCompressedHeader, count), sizeof(count));
+    double startTime;
+    std::memcpy(&startTime, data + offsetof(XYZVCompressedHeader, startTime), sizeof(startTime));
+    double timeQuantum;
+    std::memcpy(&timeQuantum, data + offsetof(XYZVCompressedHeader, timeQuantum), sizeof(timeQuantum));
+    double positionQuantum;
+    std::memcpy(&positionQuantum, data + offsetof(XYZVCompressedHeader, positionQuantum), sizeof(positionQuantum));
+    double velocityQuantum;
+    std::memcpy(&velocityQuantum, data + offsetof(XYZVCompressedHeader, velocityQuantum), sizeof(velocityQuantum));
+
+    if (count == 0)
+        return nullptr;
+
+    // Convert velocities from km/sec to km/Julian day
+    velocityQuantum *= astro::daysToSecs(1.0);
+
+    auto orbit = std::make_unique<SampledOrbitXYZV<T>>(TrajectoryInterpolation::Cubic);
+    const char* ptr = data + sizeof(XYZVCompressedHeader);
+    const char* end = data + size;
+    std::array<std::int64_t, 7> values{};
+    for (std::uint64_t i = 0; i < count; i++)
+    {
+        for (std::int64_t& value : values)
+        {
+            std::int64_t delta;
+            if (!ReadVarint(ptr, end, delta))
+            {
+                GetLogger()->error(_("Compressed xyzv file {} is truncated.\n"), filename);
+                return nullptr;
+            }
+            value += delta;
+        }
+
+        Eigen::Vector3d position(static_cast<double>(values[1]),
+                                 static_cast<double>(values[2]),
+                                 static_cast<double>(values[3]));
+        Eigen::Vector3d velocity(static_cast<double>(values[4]),
+                                 static_cast<double>(values[5]),
+                                 static_cast<double>(values[6]));
+        orbit->addSample(startTime + static_cast<double>(values[0]) * timeQuantum,
+                         (position * positionQuantum).cast<T>(),
+                         (velocity * velocityQuantum).cast<T>());
+    }
+
+    orbit->finishSamples();
+    return orbit;
+}
+
+/* Load a binary xyzv sampled trajectory file, mapping it if possible. The
+ * precision only applies if the file has to be read into memory, which
+ * compressed files always are.
+ */
+template <typename T> std::unique_ptr<Orbit>
+LoadXYZVBinary(const fs::path& filename, TrajectoryInterpolation interpolation)
+{
+    auto file = util::MappedFile::open(filename);
+    if (file == nullptr)
+        return LoadSampledOrbitXYZVBinary<T>(filename, interpolation);
+
+    if (std::string_view(file->data(), std::min(file->size(), XYZV_COMPRESSED_MAGIC.size())) == XYZV_COMPRESSED_MAGIC)
+        return LoadCompressedOrbitXYZV<T>(file->data(), file->size(), filename);
+
+    std::uint64_t count;
+    if (file->size() < sizeof(XYZVBinaryHeader) || !ParseXYZVBinaryHeader(file->data(), filename, count))
+        return nullptr;
+
+    if (count > (file->size() - sizeof(XYZVBinaryHeader)) / sizeof(XYZVBinaryData))
+    {
+        GetLogger()->error(_("Binary xyzv file {} is truncated.\n"), filename);
+        return nullptr;
+    }
+
+    auto orbit = std::make_unique<MappedSampledOrbitXYZV>(std::move(file),
+                                                          static_cast<std::size_t>(count),
+                                                          interpolation);
+    orbit->buildIndex();
+    return orbit;
+}
+
+
+// Tabulated orbits start with samples this fraction of the period or of the
+// range apart, and halve the intervals up to MaxTabulationDepth times where
+// they are out of tolerance.
+constexpr double TabulationStepFraction = 1.0 / 32.0;
+constexpr double MaxTabulationSteps = 65536.0;
+constexpr unsigned int MaxTabulationDepth = 16;
+
+struct TabulationSample
+{
+    double t;
+    Eigen::Vector3d position;
+    Eigen::Vector3d velocity;
+};
+
+
+// A sample of the source in the coordinate system of trajectory files
+TabulationSample tabulationSample(const Orbit& source, double t)
+{
+    Eigen::Vector3d p = source.positionAtTime(t);
+    Eigen::Vector3d v = source.velocityAtTime(t);
+    return { t, Eigen::Vector3d(p.x(), -p.z(), p.y()), Eigen::Vector3d(v.x(), -v.z(), v.y()) };
+}
+
+
+// Add the samples after s0 needed to interpolate up to s1
+void refineTabulation(const Orbit& source,
+                      const TabulationSample& s0,
+                      const TabulationSample& s1,
+                      double tolerance,
+                      unsigned int depth,
+                      SampledOrbitXYZV<double>& orbit)
+{
+    if (depth < MaxTabulationDepth)
+    {
+        TabulationSample mid = tabulationSample(source, 0.5 * (s0.t + s1.t));
+        Eigen::Vector3d p = interpolateXYZVPosition(TrajectoryInterpolation::Cubic,
+                                                    s0.t, s0.position, s0.velocity,
+                                                    s1.t, s1.position, s1.velocity,
+                                                    mid.t);
+        if ((p - mid.position).norm() > tolerance)
+        {
+            refineTabulation(source, s0, mid, tolerance, depth + 1, orbit);
+            refineTabulation(source, mid, s1, tolerance, depth + 1, orbit);
+            return;
+        }
+    }
+
+    orbit.addSample(s1.t, s1.position, s1.velocity);
+}
+
 } // end unnamed namespace
 
 /*! Load a trajectory file containing single precision positions.
@@ -925,7 +1481,7 @@ LoadXYZVTrajectorySinglePrec(const fs::path& filename, TrajectoryInterpolation i
     binname += "bin";
     if (fs::exists(binname))
     {
-        std::unique_ptr<Orbit> ret = LoadSampledOrbitXYZVBinary<float>(binname, interpolation);
+        std::unique_ptr<Orbit> ret = LoadXYZVBinary<float>(binname, interpolation);
         if (ret != nullptr) return ret;
     }
 
@@ -942,7 +1498,7 @@ LoadXYZVTrajectoryDoublePrec(const fs::path& filename, TrajectoryInterpolation i
     binname += "bin";
     if (fs::exists(binname))
     {
-        std::unique_ptr<Orbit> ret = LoadSampledOrbitXYZVBinary<double>(binname, interpolation);
+        std::unique_ptr<Orbit> ret = LoadXYZVBinary<double>(binname, interpolation);
         if (ret != nullptr) return ret;
     }
 
@@ -954,7 +1510,7 @@ LoadXYZVTrajectoryDoublePrec(const fs::path& filename, TrajectoryInterpolation i
 std::unique_ptr<Orbit>
 LoadXYZVBinarySinglePrec(const fs::path& filename, TrajectoryInterpolation interpolation)
 {
-    return LoadSampledOrbitXYZVBinary<float>(filename, interpolation);
+    return LoadXYZVBinary<float>(filename, interpolation);
 }
 
 
@@ -963,7 +1519,35 @@ LoadXYZVBinarySinglePrec(const fs::path& filename, TrajectoryInterpolation inter
 std::unique_ptr<Orbit>
 LoadXYZVBinaryDoublePrec(const fs::path& filename, TrajectoryInterpolation interpolation)
 {
-    return LoadSampledOrbitXYZVBinary<double>(filename, interpolation);
+    return LoadXYZVBinary<double>(filename, interpolation);
+}
+
+
+/*! Sample an orbit over a time range into a trajectory, so that it no
+ *  longer needs evaluating the source, for instance a script.
+ */
+std::unique_ptr<Orbit>
+TabulateOrbit(const Orbit& source, double begin, double end, double tolerance)
+{
+    if (!(end > begin) || !(tolerance > 0.0))
+        return nullptr;
+
+    double range = end - begin;
+    double step = (source.isPeriodic() ? std::min(source.getPeriod(), range) : range) * TabulationStepFraction;
+    double count = std::clamp(std::ceil(range / step), 1.0, MaxTabulationSteps);
+
+    auto orbit = std::make_unique<SampledOrbitXYZV<double>>(TrajectoryInterpolation::Cubic);
+    TabulationSample s0 = tabulationSample(source, begin);
+    orbit->addSample(s0.t, s0.position, s0.velocity);
+    for (double i = 1.0; i <= count; i += 1.0)
+    {
+        TabulationSample s1 = tabulationSample(source, begin + range * (i / count));
+        refineTabulation(source, s0, s1, tolerance, 0, *orbit);
+        s0 = s1;
+    }
+    orbit->finishSamples();
+
+    return orbit;
 }
 
 } // end namespace celestia::ephem
@@ -37,4 +37,9 @@ std::unique_ptr<Orbit> LoadXYZVTrajectorySinglePrec(const fs::path& filename, Tr
 std::unique_ptr<Orbit> LoadXYZVBinarySinglePrec(const fs::path& filename, TrajectoryInterpolation interpolation);
 std::unique_ptr<Orbit> LoadXYZVBinaryDoublePrec(const fs::path& filename, TrajectoryInterpolation interpolation);
 
+// Sample the source over [begin, end] into a trajectory with positions and
+// velocities, adding samples until cubic interpolation between them is
+// within tolerance km of the source.
+std::unique_ptr<Orbit> TabulateOrbit(const Orbit& source, double begin, double end, double tolerance);
+
 }
@@ -14,6 +14,8 @@
 #include "samporient.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <fstream>
 #include <vector>
 
@@ -80,6 +82,8 @@ public:
      *  should have monotonically increasing time values.
      */
     void addSample(double tjd, const Eigen::Quaternionf& q);
+    // Add a key already in Celestia's coordinate system
+    void addSpinSample(double tjd, const Eigen::Quaternionf& q);
 
     /*! The orientation of a sampled rotation model is entirely due
      *  to spin (i.e. there's no notion of an equatorial frame.)
@@ -90,13 +94,15 @@ public:
     double getPeriod() const override;
 
     void getValidRange(double& begin, double& end) const override;
+    bool isThreadSafe() const override { return true; }
 
 private:
     Eigen::Quaternionf getOrientation(double tjd) const;
 
 private:
     OrientationSampleVector samples;
-    mutable int lastSample{0};
+    // Only a hint for the search, so threads may overwrite each other's
+    mutable std::atomic<int> lastSample{0};
 
     enum InterpolationType
     {
@@ -122,6 +128,15 @@ SampledOrientation::addSample(double t, const Eigen::Quaternionf& q)
 }
 
 
+void
+SampledOrientation::addSpinSample(double t, const Eigen::Quaternionf& q)
+{
+    OrientationSample& samp = samples.emplace_back();
+    samp.t = t;
+    samp.q = q;
+}
+
+
 Eigen::Quaterniond
 SampledOrientation::spin(double tjd) const
 {
@@ -165,7 +180,7 @@ SampledOrientation::getOrientation(double tjd) const
     {
         OrientationSample samp;
         samp.t = tjd;
-        int n = lastSample;
+        int n = lastSample.load(std::memory_order_relaxed);
 
         // Do a binary search to find the samples that define the orientation
         // at the current time. Cache the previous sample used and avoid
@@ -180,7 +195,7 @@ SampledOrientation::getOrientation(double tjd) const
             else
                 n = iter - samples.begin();
 
-            lastSample = n;
+            lastSample.store(n, std::memory_order_relaxed);
         }
 
         if (n == 0)
@@ -217,6 +232,39 @@ SampledOrientation::getOrientation(double tjd) const
     return orientation;
 }
 
+
+// Tabulated rotations start with samples this fraction of the period or of
+// the range apart, and halve the intervals up to MaxTabulationDepth times
+// where they are out of tolerance.
+constexpr double TabulationStepFraction = 1.0 / 32.0;
+constexpr double MaxTabulationSteps = 65536.0;
+constexpr unsigned int MaxTabulationDepth = 16;
+
+
+// Add the samples after (t0, q0) needed to interpolate up to (t1, q1)
+void
+refineTabulation(const RotationModel& source,
+                 double t0, const Eigen::Quaternionf& q0,
+                 double t1, const Eigen::Quaternionf& q1,
+                 double tolerance,
+                 unsigned int depth,
+                 SampledOrientation& orientation)
+{
+    if (depth < MaxTabulationDepth)
+    {
+        double tmid = 0.5 * (t0 + t1);
+        Eigen::Quaternionf qmid = source.spin(tmid).cast<float>();
+        if (q0.slerp(0.5f, q1).angularDistance(qmid) > tolerance)
+        {
+            refineTabulation(source, t0, q0, tmid, qmid, tolerance, depth + 1, orientation);
+            refineTabulation(source, tmid, qmid, t1, q1, tolerance, depth + 1, orientation);
+            return;
+        }
+    }
+
+    orientation.addSpinSample(t1, q1);
+}
+
 } // end unnamed namespace
 
 
@@ -250,4 +298,35 @@ LoadSampledOrientation(const fs::path& filename)
     return sampOrientation;
 }
 
+
+/*! Sample a rotation model over a time range into key frames, so that it
+ *  no longer needs evaluating the source, for instance a script. Only the
+ *  spin is sampled, so the source must have no equatorial frame.
+ */
+std::unique_ptr<RotationModel>
+TabulateRotation(const RotationModel& source, double begin, double end, double tolerance)
+{
+    if (!(end > begin) || !(tolerance > 0.0))
+        return nullptr;
+
+    double range = end - begin;
+    double step = (source.isPeriodic() ? std::min(source.getPeriod(), range) : range) * TabulationStepFraction;
+    double count = std::clamp(std::ceil(range / step), 1.0, MaxTabulationSteps);
+
+    auto orientation = std::make_unique<SampledOrientation>();
+    double t0 = begin;
+    Eigen::Quaternionf q0 = source.spin(t0).cast<float>();
+    orientation->addSpinSample(t0, q0);
+    for (double i = 1.0; i <= count; i += 1.0)
+    {
+        double t1 = begin + range * (i / count);
+        Eigen::Quaternionf q1 = source.spin(t1).cast<float>();
+        refineTabulation(source, t0, q0, t1, q1, tolerance, 0, *orientation);
+        t0 = t1;
+        q0 = q1;
+    }
+
+    return orientation;
+}
+
 } // end namespace celestia::ephem
@@ -20,4 +20,8 @@ class RotationModel;
 
 std::unique_ptr<RotationModel> LoadSampledOrientation(const fs::path& filename);
 
+// Sample the spin of the source over [begin, end], adding samples until
+// interpolating between them is within tolerance radians of the source.
+std::unique_ptr<RotationModel> TabulateRotation(const RotationModel& source, double begin, double end, double tolerance);
+
 }
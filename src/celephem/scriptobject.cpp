@@ -9,14 +9,29 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <array>
 #include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
 #include <string_view>
+#include <system_error>
 
 #include <fmt/format.h>
 
+#include <celcompat/filesystem.h>
 #include <celengine/value.h>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/diskcache.h>
+#include <celutil/fsutils.h>
+#include <celutil/logger.h>
 #include "scriptobject.h"
 
+using celestia::util::GetLogger;
+
 using namespace std::string_view_literals;
 
 namespace celestia::ephem
@@ -55,25 +70,25 @@ private:
 public:
     explicit HashVisitor(lua_State* pState) : state{pState} {}
 
-    void operator()(const std::string& key, const Value& value)
+    void operator()(std::string_view key, const Value& value)
     {
         std::size_t percentPos = key.find('%');
-        if (percentPos == std::string::npos)
+        if (percentPos == std::string_view::npos)
         {
             switch (value.getType())
             {
             case ValueType::NumberType:
-                lua_pushstring(state, key.c_str());
+                lua_pushlstring(state, key.data(), key.size());
                 lua_pushnumber(state, *value.getNumber());
                 lua_settable(state, -3);
                 break;
             case ValueType::StringType:
-                lua_pushstring(state, key.c_str());
+                lua_pushlstring(state, key.data(), key.size());
                 lua_pushstring(state, value.getString()->c_str());
                 lua_settable(state, -3);
                 break;
             case ValueType::BooleanType:
-                lua_pushstring(state, key.c_str());
+                lua_pushlstring(state, key.data(), key.size());
                 lua_pushboolean(state, *value.getBoolean());
                 lua_settable(state, -3);
                 break;
@@ -84,6 +99,150 @@ public:
     }
 };
 
+#if LUA_VERSION_NUM >= 502 && !defined(PORTABLE_BUILD)
+// Modules required by scripted orbits and rotations are kept compiled in the
+// cache, so that loading a catalog with many of them doesn't parse the same
+// scripts again each run.
+constexpr std::string_view BytecodeCacheMagic = "CELLUAC"sv;
+constexpr std::uint16_t BytecodeCacheVersion = 0x0100;
+
+// The cache file name is derived from the script path, size and
+// modification time and from the Lua version, as bytecode is specific to it
+fs::path
+getBytecodeCachePath(const fs::path& path)
+{
+    static celestia::util::DiskCache cache(celestia::util::WriteableDataPath() / "cache" / "lua", BytecodeCacheVersion);
+    return cache.getPath(path, fmt::format("{}", LUA_VERSION_NUM), ".dat");
+}
+
+bool
+readBytecodeCache(const fs::path& cachePath, std::string& bytecode)
+{
+    if (!celestia::util::DiskCache::use(cachePath))
+        return false;
+
+    std::ifstream in(cachePath, std::ios::in | std::ios::binary);
+    if (!in.good())
+        return false;
+
+    std::array<char, BytecodeCacheMagic.size()> magic;
+    std::uint16_t version;
+    if (!in.read(magic.data(), magic.size()).good()
+        || std::string_view(magic.data(), magic.size()) != BytecodeCacheMagic
+        || !celestia::util::readLE<std::uint16_t>(in, version) || version != BytecodeCacheVersion)
+    {
+        return false;
+    }
+
+    bytecode.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return !bytecode.empty();
+}
+
+int
+bytecodeWriter(lua_State*, const void* p, std::size_t size, void* ud)
+{
+    static_cast<std::string*>(ud)->append(static_cast<const char*>(p), size);
+    return 0;
+}
+
+// Write the compiled chunk on the top of the stack to the cache
+void
+writeBytecodeCache(lua_State* l, const fs::path& cachePath)
+{
+    std::string bytecode;
+#if LUA_VERSION_NUM >= 503
+    if (lua_dump(l, bytecodeWriter, &bytecode, 0) != 0)
+#else
+    if (lua_dump(l, bytecodeWriter, &bytecode) != 0)
+#endif
+        return;
+
+    bool ok = celestia::util::DiskCache::write(cachePath, [&bytecode](const fs::path& path)
+    {
+        std::ofstream out(path, std::ios::out | std::ios::binary);
+        bool written = out.write(BytecodeCacheMagic.data(), BytecodeCacheMagic.size()).good()
+            && celestia::util::writeLE<std::uint16_t>(out, BytecodeCacheVersion)
+            && out.write(bytecode.data(), static_cast<std::streamsize>(bytecode.size())).good();
+        out.close();
+        return written && out.good();
+    });
+    if (!ok)
+        GetLogger()->warn("Failed to write the bytecode cache {}\n", cachePath);
+}
+
+// Push the chunk of a script file, from the cache when it holds a compiled
+// copy of the current version of the file.
+int
+loadCachedScript(lua_State* l, const char* filename)
+{
+    fs::path cachePath = getBytecodeCachePath(filename);
+    if (cachePath.empty())
+        return luaL_loadfilex(l, filename, nullptr);
+
+    std::string chunkName = fmt::format("@{}", filename);
+    if (std::string bytecode; readBytecodeCache(cachePath, bytecode))
+    {
+        if (luaL_loadbufferx(l, bytecode.data(), bytecode.size(), chunkName.c_str(), "b") == LUA_OK)
+            return LUA_OK;
+        lua_pop(l, 1);
+    }
+
+    int status = luaL_loadfilex(l, filename, nullptr);
+    if (status == LUA_OK)
+        writeBytecodeCache(l, cachePath);
+    return status;
+}
+
+// A package searcher in front of the one for Lua files, finding modules on
+// the same path. The errors are raised once the C++ objects are gone.
+int
+cachedScriptSearcher(lua_State* l)
+{
+    const char* name = luaL_checkstring(l, 1);
+    lua_getglobal(l, "package");
+    lua_getfield(l, -1, "searchpath");
+    lua_pushstring(l, name);
+    lua_getfield(l, -3, "path");
+    lua_call(l, 2, 1);
+    const char* filename = lua_tostring(l, -1);
+    if (filename == nullptr)
+        return 0;
+
+    if (loadCachedScript(l, filename) != LUA_OK)
+    {
+        return luaL_error(l, "error loading module '%s' from file '%s':\n\t%s",
+                          name, filename, lua_tostring(l, -1));
+    }
+
+    lua_pushstring(l, filename);
+    return 2;
+}
+
+void
+installCachedScriptSearcher(lua_State* l)
+{
+    lua_getglobal(l, "package");
+    if (lua_istable(l, -1))
+    {
+        lua_getfield(l, -1, "searchers");
+        if (lua_istable(l, -1))
+        {
+            // insert it second, after the searcher for preloaded modules
+            auto n = static_cast<lua_Integer>(lua_rawlen(l, -1));
+            for (lua_Integer i = n; i >= 2; i--)
+            {
+                lua_rawgeti(l, -1, i);
+                lua_rawseti(l, -2, i + 1);
+            }
+            lua_pushcfunction(l, cachedScriptSearcher);
+            lua_rawseti(l, -2, 2);
+        }
+        lua_pop(l, 1);
+    }
+    lua_pop(l, 1);
+}
+#endif
+
 } // end unnamed namespace
 
 /*! Set the script context for ScriptedOrbits and ScriptRotations
@@ -93,6 +252,10 @@ void
 SetScriptedObjectContext(lua_State* l)
 {
     getCurrentObjectState()->setContext(l);
+#if LUA_VERSION_NUM >= 502 && !defined(PORTABLE_BUILD)
+    if (l != nullptr)
+        installCachedScriptSearcher(l);
+#endif
 }
 
 
@@ -126,7 +289,7 @@ GetLuaTableEntry(lua_State* state,
                  const std::string& key)
 {
     lua_pushvalue(state, tableIndex);
-    lua_pushstring(state, key.c_str());
+    lua_pushlstring(state, key.data(), key.size());
     lua_gettable(state, -2);
     lua_remove(state, -2);
 }
@@ -44,6 +44,9 @@ class ScriptedRotation : public RotationModel
     double getPeriod() const override;
     void getValidRange(double& begin, double& end) const override;
 
+    // The Lua state may only be used from the thread running the scripts
+    bool isThreadSafe() const override { return false; }
+
  private:
     lua_State* luaState{ nullptr };
     std::string luaRotationObjectName;
@@ -38,6 +38,14 @@ ResidentKernelsSet* getResidentKernelsSet()
 
 } // end unnamed namespace
 
+std::recursive_mutex&
+GetSpiceMutex()
+{
+    static std::recursive_mutex* spiceMutex = new std::recursive_mutex;
+    return *spiceMutex;
+}
+
+
 /*! Perform one-time initialization of SPICE.
  */
 bool
@@ -45,6 +53,7 @@ InitializeSpice()
 {
     // Set the error behavior to the RETURN action, so that
     // Celestia do its own handling of SPICE errors.
+    std::scoped_lock lock(GetSpiceMutex());
     erract_c("SET", 0, (SpiceChar*)"RETURN");
 
     return true;
@@ -60,6 +69,8 @@ bool GetNaifId(const std::string& name, int* id)
     SpiceInt spiceID = 0;
     SpiceBoolean found = SPICEFALSE;
 
+    std::scoped_lock lock(GetSpiceMutex());
+
     // Don't call bodn2c on an empty string because SPICE generates
     // an error if we do.
     if (!name.empty())
@@ -94,6 +105,7 @@ bool LoadSpiceKernel(const fs::path& filepath)
     // Only load the kernel if it is not already resident. Note that this detection
     // of duplicate kernels will not work if a file was originally loaded through
     // a metakernel.
+    std::scoped_lock lock(GetSpiceMutex());
     if (!getResidentKernelsSet()->insert(filepath).second)
         return true;
 
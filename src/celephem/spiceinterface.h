@@ -11,6 +11,7 @@
 
 #pragma once
 
+#include <mutex>
 #include <string>
 
 #include <celcompat/filesystem.h>
@@ -25,4 +26,9 @@ bool InitializeSpice();
 bool GetNaifId(const std::string& name, int* id);
 bool LoadSpiceKernel(const fs::path& filepath);
 
+// CSPICE keeps global state, so every call into it must hold this lock.
+// It is recursive as the SPICE objects call the utility functions above
+// while holding it.
+std::recursive_mutex& GetSpiceMutex();
+
 }
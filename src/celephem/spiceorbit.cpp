@@ -9,6 +9,7 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <mutex>
 #include <utility>
 
 #include <SpiceUsr.h>
@@ -122,6 +123,8 @@ SpiceOrbit::init()
         return false;
     }
 
+    std::scoped_lock lock(GetSpiceMutex());
+
     SpiceInt spkCount = 0;
     ktotal_c("spk", &spkCount);
 
@@ -256,6 +259,7 @@ SpiceOrbit::computePosition(double jd) const
         double position[3];
         double lt;          // One way light travel time
 
+        std::scoped_lock lock(GetSpiceMutex());
         spkgps_c(targetID,
                  t,
                  "eclipj2000",
@@ -301,6 +305,7 @@ SpiceOrbit::computeVelocity(double jd) const
         double state[6];
         double lt;          // One way light travel time
 
+        std::scoped_lock lock(GetSpiceMutex());
         spkgeo_c(targetID,
                  t,
                  "eclipj2000",
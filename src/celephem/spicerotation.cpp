@@ -12,7 +12,11 @@
 
 #include "spicerotation.h"
 
+#include <algorithm>
+#include <cmath>
+#include <iterator>
 #include <limits>
+#include <mutex>
 
 #include <SpiceUsr.h>
 
@@ -32,6 +36,13 @@ namespace
 
 constexpr double MILLISEC = astro::secsToDays(0.001);
 
+// Largest distance between the samples of a precomputed rotation, and the
+// number of times it may be halved: 2^-16 days is a little over a second.
+constexpr double MaxSampleStep = 1.0;
+constexpr unsigned int MaxSampleDepth = 16;
+// Longest time range sampled, in days
+constexpr double MaxSampleRange = 100.0 * 365.25;
+
 } // end unnamed namespace
 
 /*! Create a new rotation model based on a SPICE frame. The
@@ -80,6 +91,14 @@ SpiceRotation::SpiceRotation(const std::string& frameName,
 }
 
 
+SpiceRotation::~SpiceRotation()
+{
+    m_stopSampling = true;
+    if (m_sampler.joinable())
+        m_sampler.join();
+}
+
+
 bool
 SpiceRotation::isPeriodic() const
 {
@@ -121,6 +140,7 @@ SpiceRotation::init()
     // adequate data in the kernel.
     double beginning = astro::daysToSecs(m_validIntervalBegin - astro::J2000);
     double xform[3][3];
+    std::scoped_lock lock(GetSpiceMutex());
     pxform_c(m_frameName.c_str(), m_frameName.c_str(), beginning, xform);
     if (failed_c())
     {
@@ -146,45 +166,128 @@ SpiceRotation::computeSpin(double jd) const
         jd = m_validIntervalEnd;
 
     if (m_spiceErr)
-    {
         return Eigen::Quaterniond::Identity();
+
+    if (!m_sampled.load(std::memory_order_acquire))
+        return computeSpiceSpin(jd);
+
+    auto s1 = std::upper_bound(m_samples.begin(), m_samples.end(), jd,
+                               [](double t, const Sample& s) { return t < s.t; });
+    if (s1 == m_samples.begin())
+        return s1->q;
+    if (s1 == m_samples.end())
+        return m_samples.back().q;
+
+    auto s0 = std::prev(s1);
+    return s0->q.slerp((jd - s0->t) / (s1->t - s0->t), s1->q);
+}
+
+
+void
+SpiceRotation::precompute(double tolerance)
+{
+    if (m_spiceErr || m_sampler.joinable())
+        return;
+
+    if (!(m_validIntervalEnd - m_validIntervalBegin <= MaxSampleRange))
+    {
+        GetLogger()->warn("Time range of SPICE rotation for frame {} is too long to be precomputed.\n",
+                          m_frameName);
+        return;
     }
-    else
+
+    m_sampler = std::thread(&SpiceRotation::sample, this, tolerance);
+}
+
+
+void
+SpiceRotation::sample(double tolerance)
+{
+    std::vector<Sample> samples;
+    double range = m_validIntervalEnd - m_validIntervalBegin;
+    auto count = std::max(1.0, std::ceil(range / MaxSampleStep));
+
+    Sample s0{ m_validIntervalBegin, computeSpiceSpin(m_validIntervalBegin) };
+    samples.push_back(s0);
+    for (double i = 1.0; i <= count; i += 1.0)
     {
-        // Input time for SPICE is seconds after J2000
-        double t = astro::daysToSecs(jd - astro::J2000);
-        double xform[3][3];
+        if (m_stopSampling)
+            return;
 
-        pxform_c(m_frameName.c_str(), m_baseFrameName.c_str(), t, xform);
+        double t = m_validIntervalBegin + range * (i / count);
+        Sample s1{ t, computeSpiceSpin(t) };
+        refine(s0, s1, tolerance, 0, samples);
+        s0 = s1;
+    }
 
-        if (failed_c())
-        {
-            // Print the error message
-            char errMsg[1024];
-            getmsg_c("long", sizeof(errMsg), errMsg);
-            GetLogger()->error("{}\n", errMsg);
+    m_samples = std::move(samples);
+    m_sampled.store(true, std::memory_order_release);
+    GetLogger()->info("Sampled SPICE rotation for frame {} at {} times\n", m_frameName, m_samples.size());
+}
 
-            // Reset the error state
-            reset_c();
-        }
 
-        // Eigen stores matrices in column-major order...
-        double matrixData[9] =
+// Append the samples after s0 needed to interpolate up to s1
+void
+SpiceRotation::refine(const Sample& s0,
+                      const Sample& s1,
+                      double tolerance,
+                      unsigned int depth,
+                      std::vector<Sample>& samples) const
+{
+    if (depth < MaxSampleDepth && !m_stopSampling)
+    {
+        double t = 0.5 * (s0.t + s1.t);
+        Sample mid{ t, computeSpiceSpin(t) };
+        if (s0.q.slerp(0.5, s1.q).angularDistance(mid.q) > tolerance)
         {
-            xform[0][0], xform[0][1], xform[0][2],
-            xform[1][0], xform[1][1], xform[1][2],
-            xform[2][0], xform[2][1], xform[2][2]
-        };
-
-        // ...but Celestia's rotations are reversed, thus the extra
-        // call to conjugate()
-        Eigen::Quaterniond q = Eigen::Quaterniond(Eigen::Map<Eigen::Matrix3d>(matrixData)).conjugate();
-
-        // Transform into Celestia's coordinate system
-        static const Eigen::Quaterniond Rx90 = celmath::XRotation(celestia::numbers::pi / 2.0);
-        static const Eigen::Quaterniond Ry180 = celmath::YRotation(celestia::numbers::pi);
-        return Ry180 * Rx90.conjugate() * q.conjugate() * Rx90;
+            refine(s0, mid, tolerance, depth + 1, samples);
+            refine(mid, s1, tolerance, depth + 1, samples);
+            return;
+        }
+    }
+
+    samples.push_back(s1);
+}
+
+
+Eigen::Quaterniond
+SpiceRotation::computeSpiceSpin(double jd) const
+{
+    // Input time for SPICE is seconds after J2000
+    double t = astro::daysToSecs(jd - astro::J2000);
+    double xform[3][3];
+
+    std::unique_lock lock(GetSpiceMutex());
+    pxform_c(m_frameName.c_str(), m_baseFrameName.c_str(), t, xform);
+
+    if (failed_c())
+    {
+        // Print the error message
+        char errMsg[1024];
+        getmsg_c("long", sizeof(errMsg), errMsg);
+        GetLogger()->error("{}\n", errMsg);
+
+        // Reset the error state
+        reset_c();
     }
+    lock.unlock();
+
+    // Eigen stores matrices in column-major order...
+    double matrixData[9] =
+    {
+        xform[0][0], xform[0][1], xform[0][2],
+        xform[1][0], xform[1][1], xform[1][2],
+        xform[2][0], xform[2][1], xform[2][2]
+    };
+
+    // ...but Celestia's rotations are reversed, thus the extra
+    // call to conjugate()
+    Eigen::Quaterniond q = Eigen::Quaterniond(Eigen::Map<Eigen::Matrix3d>(matrixData)).conjugate();
+
+    // Transform into Celestia's coordinate system
+    static const Eigen::Quaterniond Rx90 = celmath::XRotation(celestia::numbers::pi / 2.0);
+    static const Eigen::Quaterniond Ry180 = celmath::YRotation(celestia::numbers::pi);
+    return Ry180 * Rx90.conjugate() * q.conjugate() * Rx90;
 }
 
 } // end namespace celestia::ephem
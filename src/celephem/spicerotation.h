@@ -12,7 +12,10 @@
 
 #pragma once
 
+#include <atomic>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <Eigen/Geometry>
 
@@ -33,7 +36,7 @@ class SpiceRotation : public CachingRotationModel
     SpiceRotation(const std::string& frameName,
                   const std::string& baseFrameName,
                   double period);
-    virtual ~SpiceRotation() = default;
+    ~SpiceRotation() override;
 
     template<typename It>
     bool init(const fs::path& path, It begin, It end)
@@ -59,7 +62,23 @@ class SpiceRotation : public CachingRotationModel
 
     Eigen::Quaterniond computeSpin(double jd) const;
 
+    // Sample the rotation over its valid interval on a background thread,
+    // until interpolating between the samples is within tolerance (in
+    // radians). Once done, the rotation is computed without SPICE.
+    void precompute(double tolerance);
+
  private:
+    struct Sample
+    {
+        double t;
+        Eigen::Quaterniond q;
+    };
+
+    Eigen::Quaterniond computeSpiceSpin(double jd) const;
+    void sample(double tolerance);
+    void refine(const Sample& s0, const Sample& s1, double tolerance, unsigned int depth,
+                std::vector<Sample>& samples) const;
+
     const std::string m_frameName;
     const std::string m_baseFrameName;
     double m_period;
@@ -68,6 +87,12 @@ class SpiceRotation : public CachingRotationModel
     double m_validIntervalEnd;
     bool m_useDefaultTimeInterval;
 
+    // Written by the sampling thread until m_sampled is set
+    std::vector<Sample> m_samples;
+    std::atomic<bool> m_sampled{ false };
+    std::atomic<bool> m_stopSampling{ false };
+    std::thread m_sampler;
+
     bool loadRequiredKernel(const fs::path&, const std::string&);
     bool init();
 };
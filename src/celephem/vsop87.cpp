@@ -12,11 +12,14 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include <celcompat/numbers.h>
 #include <celmath/mathlib.h>
@@ -10989,28 +10992,312 @@ constexpr std::array sun_Z {
 };
 
 
-double SumSeries(const VSOPSeries& series, double t)
+enum class SeriesAccuracy
 {
-    if (series.nTerms < 1)
-        return 0.0;
+    // All terms of the truncated theory
+    Full,
+    // Only the terms needed for an error below CoarseTolerance, which is
+    // enough for drawing orbit paths
+    Coarse,
+};
+
+// Largest sum of the amplitudes of the terms left out of the coarse series,
+// in radians or AU
+constexpr double CoarseTolerance = 1.0e-7;
+
+// Terms are summed in blocks of fixed size so that the compiler can
+// vectorize the loops; series are padded with zero terms.
+constexpr std::size_t BlockSize = 8;
+
+constexpr double InvPi = 1.0 / celestia::numbers::pi;
+// pi split into a first part with 33 significant bits, so that k * Pi1 is
+// exact, and the remainder
+constexpr double Pi1 = 3.14159265346825122833;
+constexpr double Pi2 = 1.21542010130123844986e-10;
+
+// Cosine without branches or library calls, accurate to a few ulps for
+// |x| < 2^30. x is reduced to r in [-pi/2, pi/2] with x = r + k pi, and
+// cos(r) is evaluated with its Taylor series up to r^20, which has an
+// error below 2e-17 over that range.
+inline double
+seriesCos(double x)
+{
+    auto k = static_cast<std::int32_t>(x * InvPi + (x >= 0.0 ? 0.5 : -0.5));
+    auto kd = static_cast<double>(k);
+    double r = (x - kd * Pi1) - kd * Pi2;
+    double r2 = r * r;
+
+    double p = 1.0 / 2432902008176640000.0;
+    p = p * r2 - 1.0 / 6402373705728000.0;
+    p = p * r2 + 1.0 / 20922789888000.0;
+    p = p * r2 - 1.0 / 87178291200.0;
+    p = p * r2 + 1.0 / 479001600.0;
+    p = p * r2 - 1.0 / 3628800.0;
+    p = p * r2 + 1.0 / 40320.0;
+    p = p * r2 - 1.0 / 720.0;
+    p = p * r2 + 1.0 / 24.0;
+    p = p * r2 - 0.5;
+    p = p * r2 + 1.0;
+
+    // cos(r + k pi) = (-1)^k cos(r)
+    return static_cast<double>(1 - 2 * (k & 1)) * p;
+}
+
+/*! The terms of a series in structure of arrays form, sorted by decreasing
+ *  amplitude so that the coarse series is a prefix of the full one.
+ */
+class SortedSeries
+{
+public:
+    explicit SortedSeries(const VSOPSeries& series)
+    {
+        std::vector<VSOPTerm> terms(series.terms, series.terms + series.nTerms);
+        std::stable_sort(terms.begin(), terms.end(),
+                         [](const VSOPTerm& a, const VSOPTerm& b) { return std::abs(a.A) > std::abs(b.A); });
+
+        // Leave out the smallest terms as long as their amplitudes add up
+        // to less than the tolerance.
+        std::size_t nCoarse = terms.size();
+        for (double dropped = 0.0; nCoarse > 0; nCoarse--)
+        {
+            dropped += std::abs(terms[nCoarse - 1].A);
+            if (dropped > CoarseTolerance)
+                break;
+        }
+
+        std::size_t nPadded = roundUp(terms.size());
+        A.resize(nPadded, 0.0);
+        B.resize(nPadded, 0.0);
+        C.resize(nPadded, 0.0);
+        for (std::size_t i = 0; i < terms.size(); i++)
+        {
+            A[i] = terms[i].A;
+            B[i] = terms[i].B;
+            C[i] = terms[i].C;
+        }
+
+        nFullTerms = nPadded;
+        nCoarseTerms = roundUp(nCoarse);
+    }
+
+    std::size_t getTermCount(SeriesAccuracy accuracy) const
+    {
+        return accuracy == SeriesAccuracy::Coarse ? nCoarseTerms : nFullTerms;
+    }
+
+    double sum(double t, SeriesAccuracy accuracy) const
+    {
+        double x = 0.0;
+        std::size_t nTerms = getTermCount(accuracy);
+        for (std::size_t i = 0; i < nTerms; i += BlockSize)
+        {
+            std::array<double, BlockSize> values;
+            for (std::size_t j = 0; j < BlockSize; j++)
+                values[j] = A[i + j] * seriesCos(B[i + j] + C[i + j] * t);
+            for (double value : values)
+                x += value;
+        }
+
+        return x;
+    }
+
+    std::vector<double> A;
+    std::vector<double> B;
+    std::vector<double> C;
+
+private:
+    static std::size_t roundUp(std::size_t n)
+    {
+        return (n + BlockSize - 1) / BlockSize * BlockSize;
+    }
+
+    std::size_t nFullTerms;
+    std::size_t nCoarseTerms;
+};
+
+
+/*! Sums a series and its time derivative at evenly spaced times. Instead
+ *  of evaluating cosines, the phase of every term is rotated by the
+ *  constant angle C dt at each step; the phases are recomputed every
+ *  ReseedInterval steps so that rounding errors don't build up.
+ */
+class SeriesStepper
+{
+public:
+    static constexpr unsigned int ReseedInterval = 64;
+
+    SeriesStepper(const SortedSeries& _series, SeriesAccuracy accuracy, double t0, double _dt) :
+        series(_series),
+        nTerms(_series.getTermCount(accuracy)),
+        cosPhase(nTerms),
+        sinPhase(nTerms),
+        cosStep(nTerms),
+        sinStep(nTerms),
+        start(t0),
+        dt(_dt)
+    {
+        for (std::size_t i = 0; i < nTerms; i++)
+        {
+            cosStep[i] = std::cos(series.C[i] * dt);
+            sinStep[i] = std::sin(series.C[i] * dt);
+        }
+        reseed();
+    }
+
+    // Value and rate of change per unit of t at the current step
+    void evaluate(double& value, double& rate) const
+    {
+        value = 0.0;
+        rate = 0.0;
+        for (std::size_t i = 0; i < nTerms; i += BlockSize)
+        {
+            std::array<double, BlockSize> values;
+            std::array<double, BlockSize> rates;
+            for (std::size_t j = 0; j < BlockSize; j++)
+            {
+                values[j] = series.A[i + j] * cosPhase[i + j];
+                rates[j] = series.A[i + j] * series.C[i + j] * sinPhase[i + j];
+            }
+            for (std::size_t j = 0; j < BlockSize; j++)
+            {
+                value += values[j];
+                rate -= rates[j];
+            }
+        }
+    }
+
+    void advance()
+    {
+        if (++step % ReseedInterval == 0)
+        {
+            reseed();
+            return;
+        }
+
+        for (std::size_t i = 0; i < nTerms; i++)
+        {
+            double c = cosPhase[i] * cosStep[i] - sinPhase[i] * sinStep[i];
+            double s = sinPhase[i] * cosStep[i] + cosPhase[i] * sinStep[i];
+            cosPhase[i] = c;
+            sinPhase[i] = s;
+        }
+    }
+
+private:
+    void reseed()
+    {
+        double t = start + dt * step;
+        for (std::size_t i = 0; i < nTerms; i++)
+        {
+            double phase = series.B[i] + series.C[i] * t;
+            cosPhase[i] = std::cos(phase);
+            sinPhase[i] = std::sin(phase);
+        }
+    }
+
+    const SortedSeries& series;
+    std::size_t nTerms;
+    std::vector<double> cosPhase;
+    std::vector<double> sinPhase;
+    std::vector<double> cosStep;
+    std::vector<double> sinStep;
+    double start;
+    double dt;
+    unsigned int step{ 0 };
+};
+
 
+template<std::size_t N>
+std::vector<SortedSeries>
+sortSeries(const std::array<VSOPSeries, N>& series)
+{
+    return std::vector<SortedSeries>(series.begin(), series.end());
+}
+
+
+// Sum a polynomial in t whose coefficients are series
+double
+sumPolynomial(const std::vector<SortedSeries>& series, double t, SeriesAccuracy accuracy)
+{
     double x = 0.0;
-    const VSOPTerm* term = &series.terms[0];
-    for (int i = 0; i < series.nTerms; i++, term++)
-        x += term->A * std::cos(term->B + term->C * t);
+    double T = 1.0;
+    for (const SortedSeries& s : series)
+    {
+        x += s.sum(t, accuracy) * T;
+        T = t * T;
+    }
 
     return x;
 }
 
+
+// Steps through the series of a polynomial in t at the same times
+class PolynomialStepper
+{
+public:
+    PolynomialStepper(const std::vector<SortedSeries>& series, SeriesAccuracy accuracy, double _t0, double _dt) :
+        t0(_t0), dt(_dt)
+    {
+        steppers.reserve(series.size());
+        for (const SortedSeries& s : series)
+            steppers.emplace_back(s, accuracy, t0, dt);
+    }
+
+    // Value and rate of change per unit of t at the current step
+    void evaluate(double& value, double& rate) const
+    {
+        double t = t0 + dt * step;
+        double T = 1.0;
+        double dT = 0.0;
+        value = 0.0;
+        rate = 0.0;
+        for (const SeriesStepper& stepper : steppers)
+        {
+            double v;
+            double r;
+            stepper.evaluate(v, r);
+            value += v * T;
+            rate += r * T + v * dT;
+            dT = dT * t + T;
+            T = T * t;
+        }
+    }
+
+    void advance()
+    {
+        for (SeriesStepper& stepper : steppers)
+            stepper.advance();
+        ++step;
+    }
+
+private:
+    std::vector<SeriesStepper> steppers;
+    double t0;
+    double dt;
+    unsigned int step{ 0 };
+};
+
+
+// Heliocentric spherical coordinates in Celestia's coordinate system
+Eigen::Vector3d
+sphericalToCartesian(double l, double b, double r)
+{
+    // Corrections for internal coordinate system
+    b -= celestia::numbers::pi / 2;
+    l += celestia::numbers::pi;
+
+    return Eigen::Vector3d(std::cos(l) * std::sin(b) * r,
+                           std::cos(b) * r,
+                           -std::sin(l) * std::sin(b) * r);
+}
+
+
 class VSOP87Orbit : public CachingOrbit
 {
  private:
-    const VSOPSeries* vsL;
-    std::size_t nL;
-    const VSOPSeries* vsB;
-    std::size_t nB;
-    const VSOPSeries* vsR;
-    std::size_t nR;
+    std::vector<SortedSeries> vsL;
+    std::vector<SortedSeries> vsB;
+    std::vector<SortedSeries> vsR;
     double period;
     double boundingRadius;
 
@@ -11021,9 +11308,9 @@ class VSOP87Orbit : public CachingOrbit
                 const std::array<VSOPSeries, NR>& _vsR,
                 double _period,
                 double _boundingRadius) :
-        vsL(_vsL.data()), nL(_vsL.size()),
-        vsB(_vsB.data()), nB(_vsB.size()),
-        vsR(_vsR.data()), nR(_vsR.size()),
+        vsL(sortSeries(_vsL)),
+        vsB(sortSeries(_vsB)),
+        vsR(sortSeries(_vsR)),
         period(_period),
         boundingRadius(_boundingRadius)
     {
@@ -11045,68 +11332,64 @@ class VSOP87Orbit : public CachingOrbit
         // t is Julian millenia since J2000.0
         double t = (jd - 2451545.0) / 365250.0;
 
-        // Heliocentric coordinates
-        double l = 0.0; // longitude
-        double b = 0.0; // latitude
-        double r = 0.0; // radius
+        // Heliocentric longitude, latitude and radius
+        double l = sumPolynomial(vsL, t, SeriesAccuracy::Full);
+        double b = sumPolynomial(vsB, t, SeriesAccuracy::Full);
+        double r = sumPolynomial(vsR, t, SeriesAccuracy::Full) * KM_PER_AU<double>;
 
-        std::size_t i;
-        double T;
-
-        // Evaluate series for l
-        T = 1;
-        for (i = 0; i < nL; i++)
-        {
-            l += SumSeries(vsL[i], t) * T;
-            T = t * T;
-        }
-
-        // Evaluate series for b
-        T = 1;
-        for (i = 0; i < nB; i++)
-        {
-            b += SumSeries(vsB[i], t) * T;
-            T = t * T;
-        }
-
-        // Evaluate series for r
-        T = 1;
-        for (i = 0; i < nR; i++)
-        {
-            r += SumSeries(vsR[i], t) * T;
-            T = t * T;
-        }
-
-        r *= KM_PER_AU<double>;
-
-        // Corrections for internal coordinate system
-        b -= celestia::numbers::pi / 2;
-        l += celestia::numbers::pi;
-
-        return Eigen::Vector3d(std::cos(l) * std::sin(b) * r,
-                               std::cos(b) * r,
-                               -std::sin(l) * std::sin(b) * r);
+        return sphericalToCartesian(l, b, r);
     }
 
 
     /** Custom implementation of sample() for VSOP87 orbits. The default
       * implementation runs too slowly and produces too many samples.
+      * The orbit is sampled at about 150 evenly spaced times per period
+      * with the coarse series, stepping the phases of their terms.
       */
     void sample(double startTime, double endTime, OrbitSampleProc& proc) const override
     {
         double span = getPeriod();
-
-        AdaptiveSamplingParameters samplingParams{};
-        samplingParams.tolerance = 1.0; // kilometers
-
-        // startStep, minStep, and maxStep are all set to identical values,
-        // so the adaptive sampling function actuall behaves like uniform
-        // sampling.
-        samplingParams.startStep = span / 150.0;
-        samplingParams.minStep   = samplingParams.startStep;
-        samplingParams.maxStep   = samplingParams.startStep;
-
-        adaptiveSample(startTime, endTime, proc, samplingParams);
+        std::size_t nSteps = 0;
+        if (endTime > startTime)
+            nSteps = static_cast<std::size_t>(std::ceil((endTime - startTime) / (span / 150.0)));
+        double dt = nSteps > 0 ? (endTime - startTime) / static_cast<double>(nSteps) : 0.0;
+
+        // Steps in Julian millenia since J2000.0
+        double t0 = (startTime - 2451545.0) / 365250.0;
+        PolynomialStepper stepL(vsL, SeriesAccuracy::Coarse, t0, dt / 365250.0);
+        PolynomialStepper stepB(vsB, SeriesAccuracy::Coarse, t0, dt / 365250.0);
+        PolynomialStepper stepR(vsR, SeriesAccuracy::Coarse, t0, dt / 365250.0);
+
+        for (std::size_t i = 0; i <= nSteps; i++)
+        {
+            if (i > 0)
+            {
+                stepL.advance();
+                stepB.advance();
+                stepR.advance();
+            }
+
+            double l, b, r;
+            double dl, db, dr;
+            stepL.evaluate(l, dl);
+            stepB.evaluate(b, db);
+            stepR.evaluate(r, dr);
+            r *= KM_PER_AU<double>;
+            dr *= KM_PER_AU<double>;
+
+            Eigen::Vector3d position = sphericalToCartesian(l, b, r);
+
+            // Differentiate the conversion, with rates per day
+            double cosL = -std::cos(l);
+            double sinL = -std::sin(l);
+            double cosB = std::sin(b);
+            double sinB = -std::cos(b);
+            Eigen::Vector3d velocity(dr * cosL * sinB - r * sinL * sinB * dl + r * cosL * cosB * db,
+                                     dr * cosB - r * sinB * db,
+                                     -(dr * sinL * sinB + r * cosL * sinB * dl + r * sinL * cosB * db));
+
+            proc.sample(startTime + dt * static_cast<double>(i), position, velocity / 365250.0);
+        }
     }
 
 };
@@ -11116,12 +11399,9 @@ class VSOP87Orbit : public CachingOrbit
 class VSOP87OrbitRect : public CachingOrbit
 {
  private:
-    const VSOPSeries* vsX;
-    std::size_t nX;
-    const VSOPSeries* vsY;
-    std::size_t nY;
-    const VSOPSeries* vsZ;
-    std::size_t nZ;
+    std::vector<SortedSeries> vsX;
+    std::vector<SortedSeries> vsY;
+    std::vector<SortedSeries> vsZ;
     double period;
     double boundingRadius;
 
@@ -11132,9 +11412,9 @@ class VSOP87OrbitRect : public CachingOrbit
                     const std::array<VSOPSeries, NZ>& _vsZ,
                     double _period,
                     double _boundingRadius) :
-        vsX(_vsX.data()), nX(_vsX.size()),
-        vsY(_vsY.data()), nY(_vsY.size()),
-        vsZ(_vsZ.data()), nZ(_vsZ.size()),
+        vsX(sortSeries(_vsX)),
+        vsY(sortSeries(_vsY)),
+        vsZ(sortSeries(_vsZ)),
         period(_period),
         boundingRadius(_boundingRadius)
     {
@@ -11161,34 +11441,9 @@ class VSOP87OrbitRect : public CachingOrbit
         // t is Julian millenia since J2000.0
         double t = (jd - 2451545.0) / 365250.0;
 
-        Eigen::Vector3d v(Eigen::Vector3d::Zero());
-
-        std::size_t i;
-        double T;
-
-        // Evaluate series for x
-        T = 1;
-        for (i = 0; i < nX; i++)
-        {
-            v.x() += SumSeries(vsX[i], t) * T;
-            T = t * T;
-        }
-
-        // Evaluate series for y
-        T = 1;
-        for (i = 0; i < nY; i++)
-        {
-            v.y() += SumSeries(vsY[i], t) * T;
-            T = t * T;
-        }
-
-        // Evaluate series for z
-        T = 1;
-        for (i = 0; i < nZ; i++)
-        {
-            v.z() += SumSeries(vsZ[i], t) * T;
-            T = t * T;
-        }
+        Eigen::Vector3d v(sumPolynomial(vsX, t, SeriesAccuracy::Full),
+                          sumPolynomial(vsY, t, SeriesAccuracy::Full),
+                          sumPolynomial(vsZ, t, SeriesAccuracy::Full));
 
         v *= KM_PER_AU<double>;
 
@@ -28,12 +28,62 @@ struct XYZVBinaryData
     double velocity[3];
 };
 
+// Optional block after the records, written by xyzv2bin --index. Time is
+// split into buckets of equal length, starting at startTime; the block is
+// followed by count + 1 record numbers, the first record of each bucket and
+// then the number of records. The bucket of time t is
+// floor((t - startTime) * bucketsPerDay), clamped to [0, count - 1].
+struct XYZVBinaryIndex
+{
+    XYZVBinaryIndex() = delete;
+
+    char magic[8];
+    std::uint64_t count;
+    double startTime;
+    double bucketsPerDay;
+    double boundingRadius;
+};
+
+// Header of compressed files, written by xyzv2bin --compress. The
+// samples are knots of cubic Hermite segments within the tolerance of the
+// original trajectory. Each knot follows as seven signed LEB128 varints, the
+// zigzag encoded differences to the previous knot of the time, position and
+// velocity in units of the quanta; the first knot is relative to startTime
+// and zero.
+struct XYZVCompressedHeader
+{
+    XYZVCompressedHeader() = delete;
+
+    char magic[8];
+    std::uint16_t byteOrder;
+    std::uint16_t digits;
+    std::uint32_t reserved;
+    std::uint64_t count;
+    double startTime;
+    // Days
+    double timeQuantum;
+    // Kilometers
+    double positionQuantum;
+    // Kilometers per second
+    double velocityQuantum;
+    // Kilometers
+    double tolerance;
+};
+
 #pragma pack(pop)
 
 static_assert(std::is_standard_layout_v<XYZVBinaryHeader>);
 static_assert(std::is_standard_layout_v<XYZVBinaryData>);
+static_assert(std::is_standard_layout_v<XYZVBinaryIndex>);
+static_assert(std::is_standard_layout_v<XYZVCompressedHeader>);
 
 constexpr inline std::string_view XYZV_MAGIC{ "CELXYZV\0", 8 };
 static_assert(XYZV_MAGIC.size() == sizeof(XYZVBinaryHeader::magic));
 
+constexpr inline std::string_view XYZV_INDEX_MAGIC{ "CELXYZVI", 8 };
+static_assert(XYZV_INDEX_MAGIC.size() == sizeof(XYZVBinaryIndex::magic));
+
+constexpr inline std::string_view XYZV_COMPRESSED_MAGIC{ "CELXYZVC", 8 };
+static_assert(XYZV_COMPRESSED_MAGIC.size() == sizeof(XYZVCompressedHeader::magic));
+
 }
@@ -0,0 +1,291 @@
+// catalogstreamer.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Reads the deep sky and add-on catalogs on a background thread and merges
+// them into the universe a little at a time, at frame boundaries.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "catalogstreamer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <system_error>
+#include <utility>
+
+#include <celengine/dsodb.h>
+#include <celengine/dsoname.h>
+#include <celengine/solarsys.h>
+#include <celengine/universe.h>
+#include <celutil/filetype.h>
+#include <celutil/gettext.h>
+#include <celutil/logger.h>
+#include <celutil/tokenizer.h>
+
+using celestia::util::GetLogger;
+using celestia::engine::DSOsDatEntry;
+
+namespace
+{
+
+// Number of deep sky objects created between checks of the time budget
+constexpr std::size_t DSOsPerSlice = 256;
+
+std::vector<fs::path>
+listFiles(const fs::path& dir)
+{
+    std::vector<fs::path> entries;
+    std::error_code ec;
+    if (!fs::is_directory(dir, ec))
+        return entries;
+
+    auto iter = fs::recursive_directory_iterator(dir, ec);
+    for (; iter != end(iter); iter.increment(ec))
+    {
+        if (ec)
+            continue;
+        if (!fs::is_directory(iter->path(), ec))
+            entries.push_back(iter->path());
+    }
+    std::sort(entries.begin(), entries.end());
+    return entries;
+}
+
+} // end unnamed namespace
+
+
+CatalogStreamer::CatalogStreamer(const std::vector<fs::path>& dsoCatalogFiles,
+                                 const std::vector<fs::path>& extrasDirs,
+                                 const std::vector<fs::path>& skipExtras) :
+    dsoCatalogFiles(dsoCatalogFiles),
+    extrasDirs(extrasDirs),
+    skipExtras(skipExtras),
+    pendingDSOs(std::make_unique<DSODatabase>())
+{
+    pendingDSOs->setNameDatabase(new DSONameDatabase);
+}
+
+CatalogStreamer::~CatalogStreamer()
+{
+    stopRequested = true;
+    if (worker.joinable())
+        worker.join();
+
+    if (pendingDSOs != nullptr)
+        delete pendingDSOs->getNameDatabase();
+}
+
+void
+CatalogStreamer::start()
+{
+    worker = std::thread(&CatalogStreamer::run, this);
+}
+
+void
+CatalogStreamer::run()
+{
+    for (const auto& file : dsoCatalogFiles)
+    {
+        if (stopRequested)
+            break;
+        readDeepSkyCatalog(file, fs::path());
+    }
+
+    // Deep sky catalogs in the extras directories go first, as they do when
+    // everything is loaded at startup.
+    std::vector<std::vector<fs::path>> extras;
+    for (const auto& dir : extrasDirs)
+        extras.push_back(listFiles(dir));
+
+    auto skipped = [this](const fs::path& path)
+    {
+        if (std::find(skipExtras.begin(), skipExtras.end(), path) == skipExtras.end())
+            return false;
+        GetLogger()->info(_("Skipping catalog: {}\n"), path);
+        return true;
+    };
+
+    for (const auto& entries : extras)
+    {
+        for (const auto& fn : entries)
+        {
+            if (stopRequested)
+                break;
+            if (DetermineFileType(fn) == ContentType::CelestiaDeepSkyCatalog && !skipped(fn))
+                readDeepSkyCatalog(fn, fn.parent_path());
+        }
+    }
+
+    for (const auto& entries : extras)
+    {
+        for (const auto& fn : entries)
+        {
+            if (stopRequested)
+                break;
+            if (DetermineFileType(fn) == ContentType::CelestiaCatalog && !skipped(fn))
+                readSolarSystemCatalog(fn);
+        }
+    }
+
+    std::scoped_lock lock(mutex);
+    finished = true;
+}
+
+void
+CatalogStreamer::push(std::unique_ptr<Item>&& item)
+{
+    std::scoped_lock lock(mutex);
+    items.push_back(std::move(item));
+}
+
+void
+CatalogStreamer::readDeepSkyCatalog(const fs::path& path, const fs::path& resourcePath)
+{
+    GetLogger()->info(_("Loading deep sky object catalog: {}\n"), path);
+
+    auto item = std::make_unique<Item>();
+    item->kind = Item::Kind::DeepSky;
+    item->path = path;
+    item->resourcePath = resourcePath;
+
+    bool isBinary = DSODatabase::isBinary(path);
+    std::ifstream in(path, isBinary ? std::ios::in | std::ios::binary : std::ios::in);
+    if (!in.good())
+    {
+        GetLogger()->error(_("Error opening deepsky catalog file {}.\n"), path);
+        return;
+    }
+
+    // Like DSODatabase::load, keep the objects read before an error
+    if (!(isBinary ? celestia::engine::readDSOsDat(in, item->dsos)
+                   : celestia::engine::readDSCEntries(in, item->dsos)))
+    {
+        GetLogger()->error(_("Cannot read Deep Sky Objects database {}.\n"), path);
+    }
+
+    push(std::move(item));
+}
+
+void
+CatalogStreamer::readSolarSystemCatalog(const fs::path& path)
+{
+    // Binary mode, since the catalog may be compiled
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in.good())
+    {
+        GetLogger()->error(_("Error opening solar system catalog {}.\n"), path);
+        return;
+    }
+
+    auto item = std::make_unique<Item>();
+    item->kind = Item::Kind::SolarSystem;
+    item->path = path;
+    item->resourcePath = path.parent_path();
+    item->contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    push(std::move(item));
+}
+
+void
+CatalogStreamer::installDSOs(Universe& universe)
+{
+    if (pendingDSOs == nullptr)
+        return;
+
+    pendingDSOs->finish();
+
+    // Nothing can refer to the objects of the placeholder database, which
+    // is empty
+    DSODatabase* placeholder = universe.getDSOCatalog();
+    universe.setDSOCatalog(pendingDSOs.release());
+    if (placeholder != nullptr)
+    {
+        delete placeholder->getNameDatabase();
+        delete placeholder;
+    }
+
+    GetLogger()->info(_("Deep sky catalogs merged: {} objects\n"), universe.getDSOCatalog()->size());
+}
+
+bool
+CatalogStreamer::merge(Universe& universe, double budget)
+{
+    using clock = std::chrono::steady_clock;
+    auto deadline = clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(budget));
+
+    do
+    {
+        if (current == nullptr)
+        {
+            std::scoped_lock lock(mutex);
+            if (items.empty())
+            {
+                if (!finished)
+                    return false;
+                installDSOs(universe);
+                return true;
+            }
+
+            current = std::move(items.front());
+            items.pop_front();
+            currentEntry = 0;
+
+#ifdef ENABLE_NLS
+            if (current->kind == Item::Kind::DeepSky && !current->resourcePath.empty())
+            {
+                std::string s = current->resourcePath.string();
+                const char *d = s.c_str();
+                bindtextdomain(d, d); // domain name is the same as resource path
+            }
+#endif
+        }
+
+        if (current->kind == Item::Kind::DeepSky)
+        {
+            if (currentEntry == 0)
+                pendingDSOs->reserve(current->dsos.size());
+
+            std::size_t end = std::min(currentEntry + DSOsPerSlice, current->dsos.size());
+            for (; currentEntry < end; ++currentEntry)
+                pendingDSOs->addEntry(current->dsos[currentEntry], current->resourcePath);
+
+            if (currentEntry == current->dsos.size())
+                current.reset();
+        }
+        else
+        {
+            // The solar system catalogs come after all the deep sky ones.
+            installDSOs(universe);
+
+            GetLogger()->info(_("Loading solar system catalog: {}\n"), current->path);
+            if (TokenList::isTokenList(current->contents))
+            {
+                TokenList tokens;
+                if (tokens.read(current->contents))
+                {
+                    Tokenizer tokenizer(tokens);
+                    LoadSolarSystemObjects(tokenizer, universe, current->resourcePath);
+                }
+                else
+                {
+                    GetLogger()->error(_("Compiled catalog {} is damaged or from another version\n"), current->path);
+                }
+            }
+            else
+            {
+                std::istringstream in(current->contents);
+                LoadSolarSystemObjects(in, universe, current->resourcePath);
+            }
+            current.reset();
+        }
+    }
+    while (clock::now() < deadline);
+
+    return false;
+}
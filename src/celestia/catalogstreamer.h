@@ -0,0 +1,88 @@
+// catalogstreamer.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Reads the deep sky and add-on catalogs on a background thread and merges
+// them into the universe a little at a time, at frame boundaries.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celengine/dsosdat.h>
+
+class DSODatabase;
+class Universe;
+
+class CatalogStreamer
+{
+ public:
+    // The deep sky catalogs are read first, followed by the deep sky and
+    // solar system catalogs in the extras directories, in the order
+    // initSimulation would load them.
+    CatalogStreamer(const std::vector<fs::path>& dsoCatalogFiles,
+                    const std::vector<fs::path>& extrasDirs,
+                    const std::vector<fs::path>& skipExtras);
+    ~CatalogStreamer();
+
+    CatalogStreamer(const CatalogStreamer&) = delete;
+    CatalogStreamer& operator=(const CatalogStreamer&) = delete;
+
+    void start();
+
+    // Merge the catalogs read so far into the universe, spending about
+    // budget seconds of the frame. Must be called from the thread which
+    // owns the universe. Returns true once everything has been merged.
+    bool merge(Universe& universe, double budget);
+
+ private:
+    struct Item
+    {
+        enum class Kind
+        {
+            DeepSky,
+            SolarSystem,
+        };
+
+        Kind kind;
+        fs::path path;
+        fs::path resourcePath;
+        std::vector<celestia::engine::DSOsDatEntry> dsos;
+        std::string contents;
+    };
+
+    void run();
+    void push(std::unique_ptr<Item>&&);
+    void readDeepSkyCatalog(const fs::path& path, const fs::path& resourcePath);
+    void readSolarSystemCatalog(const fs::path& path);
+    void installDSOs(Universe&);
+
+    std::vector<fs::path> dsoCatalogFiles;
+    std::vector<fs::path> extrasDirs;
+    std::vector<fs::path> skipExtras;
+
+    std::thread worker;
+    std::atomic<bool> stopRequested{ false };
+
+    std::mutex mutex;
+    std::deque<std::unique_ptr<Item>> items;
+    bool finished{ false };
+
+    // Merged on the main thread
+    std::unique_ptr<Item> current;
+    std::size_t currentEntry{ 0 };
+    std::unique_ptr<DSODatabase> pendingDSOs;
+};
@@ -14,6 +14,10 @@
 // of the License, or (at your option) any later version.
 
 #include "celestiacore.h"
+#include "catalogstreamer.h"
+#include "clustersync.h"
+#include "controlserver.h"
+#include "simulationthread.h"
 #include "favorites.h"
 #include "textprintposition.h"
 #include "url.h"
@@ -21,16 +25,21 @@
 #include <celengine/astro.h>
 #include <celengine/asterism.h>
 #include <celengine/body.h>
+#include <celengine/bodystatecache.h>
 #include <celengine/boundaries.h>
 #include <celengine/dsoname.h>
 #include <celengine/location.h>
 #include <celengine/overlay.h>
+#include <celengine/pagedstarcatalog.h>
 #include <celengine/console.h>
 #include <celengine/starname.h>
 #include <celengine/textlayout.h>
 #include <celscript/legacy/execution.h>
 #include <celscript/legacy/cmdparser.h>
+#include <celengine/meshmanager.h>
 #include <celengine/multitexture.h>
+#include <celengine/texmanager.h>
+#include <celengine/virtualtex.h>
 #ifdef USE_SPICE
 #include <celephem/spiceinterface.h>
 #endif
@@ -40,12 +49,18 @@
 #include <celengine/framebuffer.h>
 #include <celimage/imageformats.h>
 #include <celmath/geomutil.h>
+#include <celrender/frameprofiler.h>
 #include <celutil/color.h>
+#include <celutil/diskcache.h>
 #include <celutil/filetype.h>
 #include <celutil/formatnum.h>
 #include <celutil/fsutils.h>
 #include <celutil/logger.h>
+#include <celutil/mappedfile.h>
 #include <celutil/gettext.h>
+#include <celutil/jobsystem.h>
+#include <celutil/loadtrace.h>
+#include <celutil/tokenizer.h>
 #include <celutil/utf8.h>
 #include <celcompat/filesystem.h>
 #include <Eigen/Geometry>
@@ -54,12 +69,21 @@
 #include <iomanip>
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <cctype>
 #include <cstring>
 #include <cassert>
 #include <ctime>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <set>
+#include <sstream>
+#include <system_error>
+#include <type_traits>
+#include <utility>
 #include <celengine/rectangle.h>
 #include <celengine/mapmanager.h>
 #include <fmt/ostream.h>
@@ -80,6 +104,9 @@ using namespace celestia;
 using namespace celestia::engine;
 using namespace celestia::scripts;
 using namespace celestia::util;
+using celestia::render::FrameProfiler;
+using celestia::render::ProfilePass;
+using celestia::render::ProfileScope;
 
 static const int DragThreshold = 3;
 
@@ -91,6 +118,8 @@ static const float RotationBraking = 10.0f;
 static const float RotationDecay = 2.0f;
 static const double MaximumTimeRate = 1.0e15;
 static const double MinimumTimeRate = 1.0e-15;
+// Time per frame spent merging catalogs in a staged startup, in seconds
+static const double CatalogMergeBudget = 0.004;
 static const float stdFOV = degToRad(45.0f);
 static const float MaximumFOVPerspective = degToRad(120.0f);
 static const float MaximumFOVFisheye = degToRad(179.99f);
@@ -239,6 +268,8 @@ CelestiaCore::CelestiaCore() :
 {
 
     CreateLogger();
+    // The load trace starts with the core
+    LoadTrace::get();
 
     for (int i = 0; i < KeyCount; i++)
     {
@@ -258,12 +289,16 @@ CelestiaCore::~CelestiaCore()
     if (movieCapture != nullptr)
         recordEnd();
 
+    // The log is written at once again while the console and log file exist
+    GetLogger()->stopAsync();
+
     delete timer;
     delete renderer;
 
     if (m_logfile.good())
         m_logfile.close();
 
+    celestia::util::DestroyJobSystem();
     DestroyLogger();
 }
 
@@ -545,16 +580,7 @@ void CelestiaCore::mouseButtonUp(float x, float y, int button)
         {
             pickView(x, y);
 
-            float pickX, pickY;
-            float aspectRatio = ((float) width / (float) height);
-            (*activeView)->mapWindowToView((float) x / (float) width,
-                                           (float) y / (float) height,
-                                           pickX, pickY);
-            pickX *= aspectRatio;
-            if (isViewportEffectUsed)
-                viewportEffect->distortXY(pickX, pickY);
-
-            Vector3f pickRay = renderer->getProjectionMode() == Renderer::ProjectionMode::FisheyeMode ? sim->getActiveObserver()->getPickRayFisheye(pickX, pickY) : sim->getActiveObserver()->getPickRay(pickX, pickY);
+            Vector3f pickRay = getPickRay(x, y);
 
             Selection oldSel = sim->getSelection();
             Selection newSel = sim->pickObject(pickRay, renderer->getRenderFlags(), pickTolerance);
@@ -565,16 +591,7 @@ void CelestiaCore::mouseButtonUp(float x, float y, int button)
         }
         else if (button == RightButton)
         {
-            float pickX, pickY;
-            float aspectRatio = ((float) width / (float) height);
-            (*activeView)->mapWindowToView((float) x / (float) width,
-                                           (float) y / (float) height,
-                                           pickX, pickY);
-            pickX *= aspectRatio;
-            if (isViewportEffectUsed)
-                viewportEffect->distortXY(pickX, pickY);
-
-            Vector3f pickRay = renderer->getProjectionMode() == Renderer::ProjectionMode::FisheyeMode ? sim->getActiveObserver()->getPickRayFisheye(pickX, pickY) : sim->getActiveObserver()->getPickRay(pickX, pickY);
+            Vector3f pickRay = getPickRay(x, y);
 
             Selection sel = sim->pickObject(pickRay, renderer->getRenderFlags(), pickTolerance);
             if (!sel.empty())
@@ -628,6 +645,10 @@ void CelestiaCore::mouseWheel(float motion, int modifiers)
 /// x and y are the pixel coordinates relative to the widget.
 void CelestiaCore::mouseMove(float x, float y)
 {
+    hoverX = x;
+    hoverY = y;
+    hoverValid = true;
+
     if (m_scriptHook != nullptr && m_scriptHook->call("mousemove", x, y))
         return;
 
@@ -833,6 +854,39 @@ void CelestiaCore::pickView(float x, float y)
     }
 }
 
+Vector3f CelestiaCore::getPickRay(float x, float y) const
+{
+    float pickX, pickY;
+    float aspectRatio = ((float) width / (float) height);
+    (*activeView)->mapWindowToView((float) x / (float) width,
+                                   (float) y / (float) height,
+                                   pickX, pickY);
+    pickX *= aspectRatio;
+    if (isViewportEffectUsed)
+        viewportEffect->distortXY(pickX, pickY);
+
+    bool fisheye = renderer->getProjectionMode() == Renderer::ProjectionMode::FisheyeMode ||
+                   (isViewportEffectUsed && viewportEffect->isFisheye());
+    return fisheye ? sim->getActiveObserver()->getPickRayFisheye(pickX, pickY) : sim->getActiveObserver()->getPickRay(pickX, pickY);
+}
+
+/// Returns the object under the mouse pointer, or an empty selection.
+/// With GPU picking it's the one read back from a pick drawn with an
+/// earlier frame; until one is read back, or without GPU picking, it's
+/// picked on the CPU like a click.
+Selection CelestiaCore::getHoveredObject()
+{
+    if (!hoverValid)
+        return Selection();
+
+    Selection sel;
+    if (hoverPicked && renderer->getPickResult(sel))
+        return sel;
+
+    float tolerance = sim->getActiveObserver()->getFOV() / height * pickTolerance;
+    return sim->pickObject(getPickRay(hoverX, hoverY), renderer->getRenderFlags(), tolerance);
+}
+
 void CelestiaCore::joystickAxis(int axis, float amount)
 {
     setViewChanged();
@@ -1302,7 +1356,7 @@ void CelestiaCore::charEntered(const char *c_p, int modifiers)
         }
         else
         {
-            if (sim->getObserverMode() == Observer::Travelling)
+            if (sim->getObserverMode() != Observer::Free)
                 sim->setObserverMode(Observer::Free);
             else
                 sim->setFrame(ObserverFrame::Universal, Selection());
@@ -1812,7 +1866,16 @@ void CelestiaCore::charEntered(const char *c_p, int modifiers)
         break;
 
     case '`':
-        showFPSCounter = !showFPSCounter;
+        // Cycle through the frame rate, the frame profile and neither
+        if (!showFPSCounter)
+            showFPSCounter = true;
+        else if (!showFrameProfile)
+            setFrameProfileShown(true);
+        else
+        {
+            showFPSCounter = false;
+            setFrameProfileShown(false);
+        }
         break;
 
     case '{':
@@ -1954,13 +2017,35 @@ void CelestiaCore::setStartURL(const string &url)
 
 void CelestiaCore::tick()
 {
+    // Finish the jobs which have to continue on the main thread
+    celestia::util::GetJobSystem()->update();
+
+    // Take the time step left by the last tick if no frame was drawn since
+    if (timeStepPending)
+    {
+        sim->update(pendingTimeStep);
+        timeStepPending = false;
+    }
+
     double lastTime = sysTime;
     sysTime = timer->getTime();
 
+    // A render node takes the state of the master's frame in place of the
+    // input, the scripts and the time step
+    if (clusterSync != nullptr && !clusterSync->isMaster())
+    {
+        clusterSync->receiveFrame(this);
+        return;
+    }
+
     // The time step is normally driven by the system clock; however, when
     // recording a movie, we fix the time step the frame rate of the movie.
     double dt = 0.0;
-    if (movieCapture != nullptr && recording)
+    if (fixedTimeStep > 0.0)
+    {
+        dt = fixedTimeStep;
+    }
+    else if (movieCapture != nullptr && recording)
     {
         dt = 1.0 / movieCapture->getFrameRate();
     }
@@ -1975,6 +2060,12 @@ void CelestiaCore::tick()
 
     currentTime += dt;
 
+    if (catalogStreamer != nullptr && catalogStreamer->merge(*universe, CatalogMergeBudget))
+    {
+        GetLogger()->info(_("All catalogs loaded.\n"));
+        catalogStreamer = nullptr;
+    }
+
     // Mouse wheel zoom
     if (zoomMotion != 0.0f)
     {
@@ -2141,7 +2232,59 @@ void CelestiaCore::tick()
     if (m_scriptHook != nullptr)
         m_scriptHook->call("tick", dt);
 
-    sim->update(dt);
+    // Commands sent by other programs take effect in the coming frame
+    if (controlServer != nullptr)
+        controlServer->processCommands(this);
+
+    if (simulationThread != nullptr)
+    {
+        // Taken on the simulation thread while the frame is drawn
+        pendingTimeStep = dt;
+        timeStepPending = true;
+    }
+    else
+    {
+        sim->update(dt);
+    }
+
+    if (clusterSync != nullptr)
+        clusterSync->sendFrame(this);
+}
+
+
+void CelestiaCore::setFixedTimeStep(double dt)
+{
+    fixedTimeStep = dt;
+}
+
+
+void CelestiaCore::setRenderOrigin(int x, int y)
+{
+    renderOriginX = x;
+    renderOriginY = y;
+}
+
+
+void CelestiaCore::finishLoadTrace()
+{
+    LoadTrace& trace = LoadTrace::get();
+    trace.stop();
+    startupDuration = trace.getDuration();
+    slowestLoad = trace.getSlowest();
+    GetLogger()->verbose("Started in {:.2f} s, slowest {} {} in {:.0f} ms\n",
+                         startupDuration, slowestLoad.category, slowestLoad.name,
+                         slowestLoad.duration * 1000.0);
+
+    if (config != nullptr && !config->loadTraceFile.empty() && !trace.write(config->loadTraceFile))
+        GetLogger()->error("Can't write the load trace {}\n", config->loadTraceFile);
+}
+
+
+void CelestiaCore::setFrameProfileShown(bool show)
+{
+    showFrameProfile = show;
+    FrameProfiler& profiler = renderer->getProfiler();
+    profiler.setEnabled(show || profiler.isTracing());
 }
 
 
@@ -2151,35 +2294,90 @@ void CelestiaCore::draw()
         return;
     viewChanged = false;
 
-    // Render each view
+    lastFrameStats = std::exchange(celestia::render::frameStats, {});
+
+    FrameProfiler& profiler = renderer->getProfiler();
+    profiler.beginFrame();
+
+    // Render each view; the views share the work which doesn't depend on
+    // the view
+    renderer->beginFrame();
+
+    if (hoverValid)
+        hoverRay = getPickRay(hoverX, hoverY);
+
+    // With a simulation thread, the views are drawn from copies of their
+    // observers while the time step of the last tick is taken. An observer
+    // depending on a model which isn't thread safe, such as a scripted
+    // orbit, is advanced before drawing instead.
+    bool stepping = simulationThread != nullptr && timeStepPending;
+    if (stepping && !sim->isAdvanceThreadSafe())
+    {
+        sim->update(pendingTimeStep);
+        timeStepPending = false;
+        stepping = false;
+    }
+    if (stepping)
+    {
+        GetBodyStateCache().invalidate();
+        for (const auto view : views)
+        {
+            if (view->type == View::ViewWindow)
+                observerSnapshots.emplace_back(view, view->isRootView() ? *sim->getActiveObserver() : *view->observer);
+        }
+        simulationThread->start(pendingTimeStep);
+        timeStepPending = false;
+    }
+
     for (const auto view : views)
         draw(view);
 
+    if (stepping)
+    {
+        simulationThread->wait();
+        observerSnapshots.clear();
+    }
+
+    renderer->endFrame();
+
     // Reset to render to the main window
     if (views.size() > 1)
-        renderer->setRenderRegion(0, 0, width, height, false);
+        renderer->setRenderRegion(-renderOriginX, -renderOriginY, width, height, false);
 
     bool toggleAA = renderer->isMSAAEnabled();
     if (toggleAA && (renderer->getRenderFlags() & Renderer::ShowCloudMaps))
         renderer->disableMSAA();
 
-    renderOverlay();
-    if (showConsole)
     {
-        console->setFont(font);
-        console->setColor(1.0f, 1.0f, 1.0f, 1.0f);
-        console->begin();
-        console->moveBy(safeAreaInsets.left, screenDpi / 25.4f * 53.0f);
-        console->render(Console::PageRows);
-        console->end();
+        ProfileScope scope(profiler, ProfilePass::Overlay);
+        renderOverlay();
+        if (showConsole)
+        {
+            console->setFont(font);
+            console->setColor(1.0f, 1.0f, 1.0f, 1.0f);
+            console->begin();
+            console->moveBy(safeAreaInsets.left, screenDpi / 25.4f * 53.0f);
+            console->render(Console::PageRows);
+            console->end();
+        }
     }
 
     if (toggleAA)
         renderer->enableMSAA();
 
+    profiler.endFrame(celestia::render::frameStats);
+
     if (movieCapture != nullptr && recording)
         movieCapture->captureFrame();
 
+    if (clusterSync != nullptr)
+        clusterSync->swapBarrier();
+
+    // The startup ends with the first frame, which loads the first shaders
+    // and textures
+    if (LoadTrace::get().isRecording())
+        finishLoadTrace();
+
     // Frame rate counter
     nFrames++;
     if (nFrames == 100 || sysTime - fpsCounterStartTime > 10.0)
@@ -2235,17 +2433,27 @@ void CelestiaCore::draw(View* view)
     }
     bool process = fbo != nullptr && viewportEffect->preprocess(renderer, fbo);
 
-    int x = view->x * width;
-    int y = view->y * height;
+    int x = static_cast<int>(view->x * width) - renderOriginX;
+    int y = static_cast<int>(view->y * height) - renderOriginY;
     int viewWidth = view->width * width;
     int viewHeight = view->height * height;
     // If we need to process, we draw to the FBO which starts at point zero
     renderer->setRenderRegion(process ? 0 : x, process ? 0 : y, viewWidth, viewHeight, !view->isRootView());
 
-    if (view->isRootView())
-        sim->render(*renderer);
-    else
-        sim->render(*renderer, *view->observer);
+    const Observer *observer = view->isRootView() ? sim->getActiveObserver() : view->observer;
+    for (const auto& [snapshotView, snapshot] : observerSnapshots)
+    {
+        if (snapshotView == view)
+            observer = &snapshot;
+    }
+    // Pick the object under the mouse pointer along with the active view
+    if (hoverValid && view == *activeView)
+    {
+        float tolerance = observer->getFOV() / height * pickTolerance;
+        hoverPicked = renderer->requestPick(hoverRay, tolerance);
+    }
+    if (!process || !viewportEffect->renderScene(renderer, sim, *observer))
+        sim->render(*renderer, *observer);
 
     // Viewport need to be reset to start from (x,y) instead of point zero
     if (process && (x != 0 || y != 0))
@@ -2527,6 +2735,16 @@ Renderer* CelestiaCore::getRenderer() const
     return renderer;
 }
 
+MemoryReport CelestiaCore::getMemoryReport() const
+{
+    MemoryReport report;
+    if (universe != nullptr)
+        universe->addMemoryUsage(report);
+    if (renderer != nullptr)
+        renderer->addMemoryUsage(report);
+    return report;
+}
+
 Simulation* CelestiaCore::getSimulation() const
 {
     return sim;
@@ -2667,6 +2885,41 @@ static void displayMass(Overlay& overlay, float mass, CelestiaCore::MeasurementS
         overlay.printf(_("Mass: %.2f Me\n"), mass);
 }
 
+// The GPU times lag a few frames behind, as they're read once the GPU has
+// finished with the frame
+static void displayFrameProfile(Overlay& overlay,
+                                const celestia::render::ProfiledFrame& frame,
+                                double startupDuration,
+                                const LoadEvent& slowestLoad,
+                                const MemoryReport& memoryReport)
+{
+    overlay.print(_("Startup: {:.2f} s, slowest: {} {:.0f} ms\n"),
+                  startupDuration, slowestLoad.name, slowestLoad.duration * 1000.0);
+
+    std::string largest;
+    for (const auto& entry : memoryReport.getLargest(3))
+        largest += fmt::format("{}{} {}", largest.empty() ? "" : ", ", entry.category, formatMemorySize(entry.bytes));
+    overlay.print(_("Memory: {} ({})\n"), formatMemorySize(memoryReport.getTotal()), largest);
+    overlay.printf(_("Frame %u: %.2f ms\n"), frame.number, frame.cpuFrameTime * 1000.0);
+    for (std::size_t i = 0; i < celestia::render::ProfilePassCount; i++)
+    {
+        const char* name = celestia::render::profilePassName(static_cast<ProfilePass>(i));
+        if (frame.gpuTimes[i] >= 0.0)
+            overlay.printf(_("%s: CPU %.2f ms, GPU %.2f ms\n"), name,
+                           frame.cpuTimes[i] * 1000.0, frame.gpuTimes[i] * 1000.0);
+        else
+            overlay.printf(_("%s: CPU %.2f ms\n"), name, frame.cpuTimes[i] * 1000.0);
+    }
+
+    const celestia::render::RenderStats& stats = frame.stats;
+    overlay.printf(_("Draw calls: %u, program changes: %u, state changes: %u\n"),
+                   stats.drawCalls, stats.programChanges, stats.stateChanges);
+    overlay.printf(_("Triangles: %lu, points: %lu, frame arena: %lu bytes\n"),
+                   stats.triangles, stats.points, stats.arenaBytes);
+    overlay.printf(_("Jobs: %u, stolen: %u, busy %.2f ms\n"),
+                   frame.jobs.jobs, frame.jobs.stolenJobs, frame.jobs.busyTime * 1000.0);
+}
+
 static void displaySpeed(Overlay& overlay, float speed, CelestiaCore::MeasurementSystem measurement)
 {
     FormattedNumber n;
@@ -3300,6 +3553,26 @@ void CelestiaCore::renderOverlay()
         overlay->restorePos();
     }
 
+    if (showFrameProfile)
+    {
+        // Above the speed, in the lower left corner
+        constexpr int ProfileLines = static_cast<int>(celestia::render::ProfilePassCount) + 6;
+        overlay->savePos();
+        overlay->moveBy(getSafeAreaStart(), getSafeAreaBottom(fontHeight * (ProfileLines + 2) + static_cast<int>(static_cast<float>(screenDpi) / 25.4f * 1.3f)));
+        overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
+
+        if (memoryReport.getEntries().empty() || currentTime - memoryReportTime >= 1.0)
+        {
+            memoryReport = getMemoryReport();
+            memoryReportTime = currentTime;
+        }
+
+        overlay->beginText();
+        displayFrameProfile(*overlay, renderer->getProfiler().lastFrame(), startupDuration, slowestLoad, memoryReport);
+        overlay->endText();
+        overlay->restorePos();
+    }
+
     Universe *u = sim->getUniverse();
 
     if (hudDetail > 0 && (overlayElements & ShowFrame))
@@ -3681,6 +3954,177 @@ void CelestiaCore::renderOverlay()
 }
 
 
+namespace
+{
+
+#ifndef PORTABLE_BUILD
+// As for compressed textures, the cache file name is derived from the
+// source path, size and modification time, so a changed catalog is never
+// read from a stale entry
+fs::path GetCatalogCachePath(const fs::path& filepath)
+{
+    static DiskCache cache(WriteableDataPath() / "cache" / "catalogs", 1);
+    return cache.getPath(filepath, "", ".tok");
+}
+#endif
+
+
+// Read the tokens of a catalog, from a mapping of the file when possible.
+// Catalogs compiled by compilecatalogs already are token lists.
+bool LexCatalogFile(const fs::path& filepath, TokenList& tokens, bool useCache)
+{
+    auto file = MappedFile::open(filepath);
+    if (file != nullptr && TokenList::isTokenList(std::string_view(file->data(), file->size())))
+    {
+        // Nothing is loaded from a list which can't be read
+        if (!tokens.read(std::string_view(file->data(), file->size())))
+            GetLogger()->error(_("Compiled catalog {} is damaged or from another version\n"), filepath);
+        return true;
+    }
+
+#ifndef PORTABLE_BUILD
+    fs::path cachePath = useCache ? GetCatalogCachePath(filepath) : fs::path();
+    if (!cachePath.empty())
+    {
+        if (auto cached = DiskCache::use(cachePath) ? MappedFile::open(cachePath) : nullptr;
+            cached != nullptr && tokens.read(std::string_view(cached->data(), cached->size())))
+        {
+            return true;
+        }
+    }
+#else
+    (void) useCache;
+#endif
+
+    if (file != nullptr)
+    {
+        Tokenizer tokenizer(std::string_view(file->data(), file->size()));
+        tokens = TokenList(tokenizer);
+    }
+    else
+    {
+        ifstream in(filepath, ios::in);
+        if (!in.good())
+            return false;
+
+        Tokenizer tokenizer(&in);
+        tokens = TokenList(tokenizer);
+    }
+
+#ifndef PORTABLE_BUILD
+    if (!cachePath.empty())
+    {
+        // Written on the cache thread, so that the first run isn't slowed
+        // down by writing the cache
+        std::ostringstream out(ios::out | ios::binary);
+        if (tokens.write(out))
+            DiskCache::writeLater(cachePath, out.str());
+    }
+#endif
+
+    return true;
+}
+
+
+// Return the files in the extras directories, in the order of the
+// directories and sorted within each one
+vector<fs::path> ListExtrasFiles(const vector<fs::path>& extrasDirs)
+{
+    vector<fs::path> files;
+    for (const auto& dir : extrasDirs)
+    {
+        if (!is_valid_directory(dir))
+            continue;
+
+        std::size_t first = files.size();
+        std::error_code ec;
+        auto iter = fs::recursive_directory_iterator(dir, ec);
+        for (; iter != end(iter); iter.increment(ec))
+        {
+            if (ec)
+                continue;
+            if (!fs::is_directory(iter->path(), ec))
+                files.push_back(iter->path());
+        }
+        std::sort(files.begin() + first, files.end());
+    }
+
+    return files;
+}
+
+
+// Lex the catalog files on worker threads while the calling thread loads
+// them in order: objects may be added, modified or replaced by later
+// files, so only the lexing can be done out of order. The workers stay at
+// most MaxLookahead files ahead, which bounds the tokens held in memory.
+template<typename Loader>
+void LoadCatalogFiles(const vector<fs::path>& files, Loader& loader, bool useCache)
+{
+    constexpr std::size_t MaxLookahead = 16;
+
+    struct Slot
+    {
+        TokenList tokens;
+        bool lexed{ false };
+        bool done{ false };
+    };
+
+    vector<Slot> slots(files.size());
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::size_t next = 0;
+    std::size_t loaded = 0;
+
+    auto worker = [&]()
+    {
+        for (;;)
+        {
+            std::unique_lock lock(mutex);
+            cv.wait(lock, [&]() { return next == files.size() || next < loaded + MaxLookahead; });
+            if (next == files.size())
+                return;
+            std::size_t i = next++;
+            lock.unlock();
+
+            TokenList tokens;
+            bool lexed = loader.isTextCatalog(files[i]) && LexCatalogFile(files[i], tokens, useCache);
+
+            lock.lock();
+            slots[i].tokens = std::move(tokens);
+            slots[i].lexed = lexed;
+            slots[i].done = true;
+            cv.notify_all();
+        }
+    };
+
+    unsigned int nThreads = static_cast<unsigned int>(std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                                                            files.size()));
+    vector<std::thread> threads;
+    for (unsigned int i = 0; i < nThreads; i++)
+        threads.emplace_back(worker);
+
+    for (std::size_t i = 0; i < files.size(); i++)
+    {
+        {
+            std::unique_lock lock(mutex);
+            cv.wait(lock, [&]() { return slots[i].done; });
+        }
+
+        loader.process(files[i], slots[i].lexed ? &slots[i].tokens : nullptr);
+
+        std::scoped_lock lock(mutex);
+        slots[i].tokens = TokenList();
+        loaded = i + 1;
+        cv.notify_all();
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+} // end unnamed namespace
+
+
 class SolarSystemLoader
 {
     Universe* universe;
@@ -3697,7 +4141,15 @@ class SolarSystemLoader
     {
     }
 
-    void process(const fs::path& filepath)
+    // Return true if the file is a catalog to be lexed ahead of process()
+    bool isTextCatalog(const fs::path& filepath) const
+    {
+        return DetermineFileType(filepath) == ContentType::CelestiaCatalog &&
+               find(begin(skip), end(skip), filepath) == end(skip);
+    }
+
+    // Load the file, from its tokens if they were read ahead
+    void process(const fs::path& filepath, const TokenList* tokens = nullptr)
     {
         if (DetermineFileType(filepath) != ContentType::CelestiaCatalog)
             return;
@@ -3710,6 +4162,26 @@ class SolarSystemLoader
         GetLogger()->info(_("Loading solar system catalog: {}\n"), filepath);
         if (notifier != nullptr)
             notifier->update(filepath.filename().string());
+        LoadScope scope = LoadScope::forFile("ssc", filepath);
+
+        if (tokens != nullptr)
+        {
+            Tokenizer tokenizer(*tokens);
+            LoadSolarSystemObjects(tokenizer,
+                                   *universe,
+                                   filepath.parent_path());
+            return;
+        }
+
+        // Catalogs are read in place when they can be mapped
+        if (auto file = MappedFile::open(filepath); file != nullptr)
+        {
+            Tokenizer tokenizer(std::string_view(file->data(), file->size()));
+            LoadSolarSystemObjects(tokenizer,
+                                   *universe,
+                                   filepath.parent_path());
+            return;
+        }
 
         ifstream solarSysFile(filepath, ios::in);
         if (solarSysFile.good())
@@ -3743,7 +4215,23 @@ template <class OBJDB> class CatalogLoader
     {
     }
 
-    void process(const fs::path& filepath)
+    // Return true if the file is a text catalog to be lexed ahead of process()
+    bool isTextCatalog(const fs::path& filepath) const
+    {
+        if (DetermineFileType(filepath) != contentType ||
+            find(begin(skip), end(skip), filepath) != end(skip))
+        {
+            return false;
+        }
+
+        if constexpr (std::is_same_v<OBJDB, DSODatabase>)
+            return !DSODatabase::isBinary(filepath);
+        else
+            return true;
+    }
+
+    // Load the file, from its tokens if they were read ahead
+    void process(const fs::path& filepath, const TokenList* tokens = nullptr)
     {
         if (DetermineFileType(filepath) != contentType)
             return;
@@ -3757,12 +4245,49 @@ template <class OBJDB> class CatalogLoader
         if (notifier != nullptr)
             notifier->update(filepath.filename().string());
 
+        std::string extension = filepath.extension().string();
+        LoadScope scope = LoadScope::forFile(extension.empty() ? extension : extension.substr(1), filepath);
+        std::uint32_t objectCount = objDB->size();
+        auto countObjects = [&]() { scope.setObjects(objDB->size() - objectCount); };
+
+        if (tokens != nullptr)
+        {
+            Tokenizer tokenizer(*tokens);
+            if (!objDB->load(tokenizer, filepath.parent_path()))
+                GetLogger()->error(_("Error reading {} catalog file: {}\n"), typeDesc, filepath);
+            countObjects();
+            return;
+        }
+
+        if constexpr (std::is_same_v<OBJDB, DSODatabase>)
+        {
+            // Deep sky catalogs in add-ons may be compiled with makedsodb
+            if (DSODatabase::isBinary(filepath))
+            {
+                ifstream catalogFile(filepath, ios::in | ios::binary);
+                if (!catalogFile.good() || !objDB->loadBinary(catalogFile, filepath.parent_path()))
+                    GetLogger()->error(_("Error reading {} catalog file: {}\n"), typeDesc, filepath);
+                countObjects();
+                return;
+            }
+        }
+
+        if (auto file = MappedFile::open(filepath); file != nullptr)
+        {
+            Tokenizer tokenizer(std::string_view(file->data(), file->size()));
+            if (!objDB->load(tokenizer, filepath.parent_path()))
+                GetLogger()->error(_("Error reading {} catalog file: {}\n"), typeDesc, filepath);
+            countObjects();
+            return;
+        }
+
         ifstream catalogFile(filepath, ios::in);
         if (catalogFile.good())
         {
             if (!objDB->load(catalogFile, filepath.parent_path()))
                 GetLogger()->error(_("Error reading {} catalog file: {}\n"), typeDesc, filepath);
         }
+        countObjects();
     }
 };
 
@@ -3774,7 +4299,9 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
                                   const vector<fs::path>& extrasDirs,
                                   ProgressNotifier* progressNotifier)
 {
-    if (!configFileName.empty())
+    LoadScope simulationScope(LoadScope::Phase, "simulation");
+
+    if (LoadScope scope(LoadScope::Phase, "configuration"); !configFileName.empty())
     {
         config = ReadCelestiaConfig(configFileName);
     }
@@ -3797,10 +4324,24 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
         return false;
     }
 
+    celestia::util::CreateJobSystem(config->jobThreads);
+#ifndef PORTABLE_BUILD
+    DiskCache::setMaxSize(static_cast<std::uintmax_t>(config->cacheSize) << 20);
+#endif
+
     // Set the console log size; ignore any request to use less than 100 lines
     if (config->consoleLogRows > 100)
         console->setRowCount(config->consoleLogRows);
 
+    if (config->logRateLimit > 0)
+    {
+        GetLogger()->setRateLimit(Level::Info, config->logRateLimit);
+        GetLogger()->setRateLimit(Level::Verbose, config->logRateLimit);
+        GetLogger()->setRateLimit(Level::Debug, config->logRateLimit);
+    }
+    if (config->asyncLogging)
+        GetLogger()->startAsync();
+
     if (!config->leapSecondsFile.empty())
         ReadLeapSecondsFile(config->leapSecondsFile, leapSeconds);
 
@@ -3844,11 +4385,12 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
         favorites = new FavoritesList();
 
     universe = new Universe();
+    universe->setLazyMinorBodies(config->lazyMinorBodies);
 
 
     /***** Load star catalogs *****/
 
-    if (!readStars(*config, progressNotifier))
+    if (LoadScope scope(LoadScope::Phase, "stars"); !readStars(*config, progressNotifier))
     {
         fatalError(_("Cannot read star database."), false);
         return false;
@@ -3857,57 +4399,62 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
 
     /***** Load the deep sky catalogs *****/
 
+    std::optional<LoadScope> phase;
+    phase.emplace(LoadScope::Phase, "deep sky objects");
+
     DSONameDatabase* dsoNameDB  = new DSONameDatabase;
     DSODatabase*     dsoDB      = new DSODatabase;
     dsoDB->setNameDatabase(dsoNameDB);
 
+    // In a staged startup the deep sky catalogs and the solar system
+    // catalogs of the add-ons are read in the background and merged by
+    // tick(); an empty database stands in for the deep sky objects until
+    // then.
+    if (config->stagedStartup)
+    {
+        catalogStreamer = std::make_unique<CatalogStreamer>(config->dsoCatalogFiles,
+                                                            config->extrasDirs,
+                                                            config->skipExtras);
+        catalogStreamer->start();
+    }
+
     // Load first the vector of dsoCatalogFiles in the data directory (deepsky.dsc, globulars.dsc,...):
 
     for (const auto& file : config->dsoCatalogFiles)
     {
+        if (catalogStreamer != nullptr)
+            break;
+
         if (progressNotifier)
             progressNotifier->update(file.string());
+        LoadScope scope = LoadScope::forFile("dsc", file);
+        std::uint32_t objectCount = dsoDB->size();
 
-        ifstream dsoFile(file, ios::in);
+        bool isBinary = DSODatabase::isBinary(file);
+        ifstream dsoFile(file, isBinary ? ios::in | ios::binary : ios::in);
         if (!dsoFile.good())
         {
             GetLogger()->error(_("Error opening deepsky catalog file {}.\n"), file);
         }
-        if (!dsoDB->load(dsoFile, ""))
+        if (!(isBinary ? dsoDB->loadBinary(dsoFile) : dsoDB->load(dsoFile, "")))
         {
             GetLogger()->error(_("Cannot read Deep Sky Objects database {}.\n"), file);
         }
+        scope.setObjects(dsoDB->size() - objectCount);
     }
 
     // Next, read all the deep sky files in the extras directories
+    if (catalogStreamer == nullptr)
     {
-        vector<fs::path> entries;
         DeepSkyLoader loader(dsoDB, "deep sky object",
                              ContentType::CelestiaDeepSkyCatalog,
                              progressNotifier,
                              config->skipExtras);
-        for (const auto& dir : config->extrasDirs)
-        {
-            if (!is_valid_directory(dir))
-                continue;
-
-            entries.clear();
-            std::error_code ec;
-            auto iter = fs::recursive_directory_iterator(dir, ec);
-            for (; iter != end(iter); iter.increment(ec))
-            {
-                if (ec)
-                    continue;
-                if (!fs::is_directory(iter->path(), ec))
-                    entries.push_back(iter->path());
-            }
-            std::sort(begin(entries), end(entries));
-            for (const auto& fn : entries)
-                loader.process(fn);
-        }
+        LoadCatalogFiles(ListExtrasFiles(config->extrasDirs), loader, config->cacheCatalogs);
     }
     dsoDB->finish();
     universe->setDSOCatalog(dsoDB);
+    phase.emplace(LoadScope::Phase, "solar systems");
 
 
     /***** Load the solar system catalogs *****/
@@ -3920,6 +4467,7 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
         {
             if (progressNotifier)
                 progressNotifier->update(file.string());
+            LoadScope scope = LoadScope::forFile("ssc", file);
 
             ifstream solarSysFile(file, ios::in);
             if (!solarSysFile.good())
@@ -3934,33 +4482,18 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
     }
 
     // Next, read all the solar system files in the extras directories
+    if (catalogStreamer == nullptr)
     {
-        vector<fs::path> entries;
         SolarSystemLoader loader(universe, progressNotifier, config->skipExtras);
-        for (const auto& dir : config->extrasDirs)
-        {
-            if (!is_valid_directory(dir))
-                continue;
-
-            entries.clear();
-            std::error_code ec;
-            auto iter = fs::recursive_directory_iterator(dir, ec);
-            for (; iter != end(iter); iter.increment(ec))
-            {
-                if (ec)
-                    continue;
-                if (!fs::is_directory(iter->path(), ec))
-                    entries.push_back(iter->path());
-            }
-            sort(begin(entries), end(entries));
-            for(const auto& fn : entries)
-                loader.process(fn);
-        }
+        LoadCatalogFiles(ListExtrasFiles(config->extrasDirs), loader, config->cacheCatalogs);
     }
 
+    phase.reset();
+
     // Load asterisms:
     if (!config->asterismsFile.empty())
     {
+        LoadScope scope = LoadScope::forFile("asterisms", config->asterismsFile);
         ifstream asterismsFile(config->asterismsFile, ios::in);
         if (!asterismsFile.good())
         {
@@ -3977,6 +4510,7 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
 
     if (!config->boundariesFile.empty())
     {
+        LoadScope scope = LoadScope::forFile("boundaries", config->boundariesFile);
         ifstream boundariesFile(config->boundariesFile, ios::in);
         if (!boundariesFile.good())
         {
@@ -4031,6 +4565,19 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
                     GetLogger()->error("Failed to read warp mesh file {}\n", config->warpMeshFile);
             }
         }
+        else if (config->viewportEffect == "cubemap")
+        {
+            WarpMesh *mesh = nullptr;
+            if (!config->warpMeshFile.empty())
+            {
+                WarpMeshManager *manager = GetWarpMeshManager();
+                mesh = manager->find(manager->getHandle(WarpMeshInfo(config->warpMeshFile)));
+                if (mesh == nullptr)
+                    GetLogger()->error("Failed to read warp mesh file {}\n", config->warpMeshFile);
+            }
+            if (mesh != nullptr || config->warpMeshFile.empty())
+                viewportEffect = unique_ptr<ViewportEffect>(new CubemapViewportEffect(degToRad(config->fisheyeAperture), mesh));
+        }
         else
         {
             GetLogger()->warn("Unknown viewport effect {}\n", config->viewportEffect);
@@ -4082,6 +4629,37 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
     }
 
     sim = new Simulation(universe);
+    if (config->simulationThread)
+        simulationThread = std::make_unique<SimulationThread>(sim);
+
+    if (compareIgnoringCase(config->clusterRole, "master") == 0)
+    {
+        clusterSync = ClusterSync::createMaster(static_cast<std::uint16_t>(config->clusterPort));
+    }
+    else if (compareIgnoringCase(config->clusterRole, "node") == 0)
+    {
+        ClusterSync::NodeView nodeView;
+        nodeView.yaw = config->clusterViewYaw;
+        nodeView.pitch = config->clusterViewPitch;
+        nodeView.roll = config->clusterViewRoll;
+        nodeView.fieldOfView = config->clusterFieldOfView;
+        clusterSync = ClusterSync::createNode(config->clusterHost,
+                                              static_cast<std::uint16_t>(config->clusterPort),
+                                              nodeView);
+        // The master's time steps are taken instead
+        simulationThread = nullptr;
+    }
+    else if (!config->clusterRole.empty())
+    {
+        GetLogger()->warn("Unknown cluster role {}\n", config->clusterRole);
+    }
+
+    // A render node follows the master, which is the one to control
+    if (config->controlPort != 0 && (clusterSync == nullptr || clusterSync->isMaster()))
+    {
+        controlServer = ControlServer::create(static_cast<std::uint16_t>(config->controlPort),
+                                              config->controlAllowRemote);
+    }
     if ((renderer->getRenderFlags() & Renderer::ShowAutoMag) == 0)
     {
         sim->setFaintestVisible(config->faintestVisible);
@@ -4112,6 +4690,7 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
 static std::shared_ptr<TextureFont>
 LoadFontHelper(const Renderer* renderer, const fs::path& p)
 {
+    LoadScope scope("font", p.string());
     if (p.is_absolute())
         return LoadTextureFont(renderer, p);
 
@@ -4132,6 +4711,35 @@ bool CelestiaCore::initRenderer()
     detailOptions.orbitWindowEnd = config->orbitWindowEnd;
     detailOptions.orbitPeriodsShown = config->orbitPeriodsShown;
     detailOptions.linearFadeFraction = config->linearFadeFraction;
+    detailOptions.starRenderThreads = config->starRenderThreads;
+    detailOptions.dsoRenderThreads = config->dsoRenderThreads;
+    detailOptions.orbitSamplingThreads = config->orbitSamplingThreads;
+    detailOptions.renderListThreads = config->renderListThreads;
+    detailOptions.textureLoadingThreads = config->textureLoadingThreads;
+    detailOptions.modelLoadingThreads = config->modelLoadingThreads;
+    detailOptions.virtualTextureMemoryBudget = static_cast<std::size_t>(config->virtualTextureMemoryBudget) << 20;
+    detailOptions.tileCacheSize = static_cast<std::uintmax_t>(config->tileCacheSize) << 20;
+    detailOptions.textureMemoryBudget = static_cast<std::size_t>(config->textureMemoryBudget) << 20;
+    detailOptions.autoTextureResolution = config->autoTextureResolution;
+    detailOptions.gpuStarCatalog = config->gpuStarCatalog;
+    detailOptions.shaderCache = config->shaderCache;
+    detailOptions.shaderWarmUp = config->shaderWarmUp;
+    detailOptions.asyncShaderCompile = config->asyncShaderCompile;
+    detailOptions.compressTextures = config->compressTextures;
+    detailOptions.staticSphereMeshes = config->staticSphereMeshes;
+    detailOptions.optimizeModels = config->optimizeModels;
+    detailOptions.modelLevelsOfDetail = config->modelLevelsOfDetail;
+    detailOptions.frameTimeBudget = config->frameTimeBudget / 1000.0;
+    detailOptions.declutterLabels = config->declutterLabels;
+    detailOptions.distanceFieldFonts = config->distanceFieldFonts;
+    detailOptions.shadowMapCacheSize = config->ShadowMapCacheSize;
+    detailOptions.shadowCascadeSize = config->ShadowMapCascadeSize;
+    detailOptions.ringShadowTextureSize = config->RingShadowTextureSize;
+    detailOptions.gpuPicking = config->gpuPicking;
+    detailOptions.reverseDepth = config->reverseDepth;
+    detailOptions.starBloom = config->starBloom;
+
+    LoadScope rendererScope(LoadScope::Phase, "renderer");
 
     // Prepare the scene for rendering.
     if (!renderer->init((int) width, (int) height, detailOptions))
@@ -4147,9 +4755,14 @@ bool CelestiaCore::initRenderer()
     }
 
     if (config->mainFont.empty())
+    {
+        LoadScope scope("font", "DejaVuSans.ttf,12");
         font = LoadTextureFont(renderer, "fonts/DejaVuSans.ttf,12");
+    }
     else
+    {
         font = LoadFontHelper(renderer, config->mainFont);
+    }
 
     if (font == nullptr)
         cout << _("Error loading font; text will not be visible.\n");
@@ -4184,16 +4797,14 @@ static void loadCrossIndex(StarDatabase* starDB,
                            StarDatabase::Catalog catalog,
                            const fs::path& filename)
 {
-    if (!filename.empty())
+    std::error_code ec;
+    if (!filename.empty() && fs::exists(filename, ec))
     {
-        ifstream xrefFile(filename, ios::in | ios::binary);
-        if (xrefFile.good())
-        {
-            if (!starDB->loadCrossIndex(catalog, xrefFile))
-                GetLogger()->error(_("Error reading cross index {}\n"), filename);
-            else
-                GetLogger()->info(_("Loaded cross index {}\n"), filename);
-        }
+        LoadScope scope = LoadScope::forFile("crossindex", filename);
+        if (!starDB->loadCrossIndex(catalog, filename))
+            GetLogger()->error(_("Error reading cross index {}\n"), filename);
+        else
+            GetLogger()->info(_("Loaded cross index {}\n"), filename);
     }
 }
 
@@ -4203,9 +4814,19 @@ bool CelestiaCore::readStars(const CelestiaConfig& cfg,
 {
     StarDetails::SetStarTextures(cfg.starTextures);
 
+    std::optional<LoadScope> namesScope(std::in_place, "names", cfg.starNamesFile.string());
     StarNameDatabase* starNameDB = nullptr;
-    ifstream starNamesFile(cfg.starNamesFile, ios::in);
-    if (starNamesFile.good())
+    if (NameDatabase::isBinary(cfg.starNamesFile))
+    {
+        starNameDB = new StarNameDatabase();
+        if (!starNameDB->loadBinary(cfg.starNamesFile))
+        {
+            GetLogger()->error(_("Error reading star names file\n"));
+            delete starNameDB;
+            starNameDB = nullptr;
+        }
+    }
+    else if (ifstream starNamesFile(cfg.starNamesFile, ios::in); starNamesFile.good())
     {
         starNameDB = StarNameDatabase::readNames(starNamesFile);
         if (starNameDB == nullptr)
@@ -4215,6 +4836,9 @@ bool CelestiaCore::readStars(const CelestiaConfig& cfg,
     {
         GetLogger()->error(_("Error opening {}\n"), cfg.starNamesFile);
     }
+    if (starNameDB != nullptr)
+        namesScope->setObjects(starNameDB->getNameCount());
+    namesScope.reset();
 
     // First load the binary star database file.  The majority of stars
     // will be defined here.
@@ -4223,23 +4847,35 @@ bool CelestiaCore::readStars(const CelestiaConfig& cfg,
     {
         if (progressNotifier)
             progressNotifier->update(cfg.starDatabaseFile.string());
+        LoadScope scope = LoadScope::forFile("stardb", cfg.starDatabaseFile);
 
-        ifstream starFile(cfg.starDatabaseFile, ios::in | ios::binary);
-        if (!starFile.good())
+        bool loaded;
+        if (StarDatabase::isSortedBinary(cfg.starDatabaseFile))
         {
-            GetLogger()->error(_("Error opening {}\n"), cfg.starDatabaseFile);
-            delete starDB;
-            delete starNameDB;
-            return false;
+            loaded = starDB->loadSortedBinary(cfg.starDatabaseFile);
+        }
+        else
+        {
+            ifstream starFile(cfg.starDatabaseFile, ios::in | ios::binary);
+            if (!starFile.good())
+            {
+                GetLogger()->error(_("Error opening {}\n"), cfg.starDatabaseFile);
+                delete starDB;
+                delete starNameDB;
+                return false;
+            }
+
+            loaded = starDB->loadBinary(starFile);
         }
 
-        if (!starDB->loadBinary(starFile))
+        if (!loaded)
         {
             GetLogger()->error(_("Error reading stars file\n"));
             delete starDB;
             delete starNameDB;
             return false;
         }
+        scope.setObjects(starDB->size());
     }
 
     if (starNameDB == nullptr)
@@ -4257,44 +4893,43 @@ bool CelestiaCore::readStars(const CelestiaConfig& cfg,
         if (file.empty())
             continue;
 
+        LoadScope scope = LoadScope::forFile("stc", file);
+        std::uint32_t starCount = starDB->size();
         ifstream starFile(file, ios::in);
         if (starFile.good())
+        {
             starDB->load(starFile);
+            scope.setObjects(starDB->size() - starCount);
+        }
         else
+        {
             GetLogger()->error(_("Error opening star catalog {}\n"), file);
+        }
     }
 
     // Now, read supplemental star files from the extras directories
     {
-        vector<fs::path> entries;
         StarLoader loader(starDB,
                           "star",
                           ContentType::CelestiaStarCatalog,
                           progressNotifier,
                           config->skipExtras);
-        for (const auto& dir : config->extrasDirs)
-        {
-            if (!is_valid_directory(dir))
-                continue;
-
-            entries.clear();
-            std::error_code ec;
-            auto iter = fs::recursive_directory_iterator(dir, ec);
-            for (; iter != end(iter); iter.increment(ec))
-            {
-                if (ec)
-                    continue;
-                if (!fs::is_directory(iter->path(), ec))
-                    entries.push_back(iter->path());
-            }
-            std::sort(begin(entries), end(entries));
-            for (const auto& fn : entries)
-                loader.process(fn);
-        }
+        LoadCatalogFiles(ListExtrasFiles(config->extrasDirs), loader, config->cacheCatalogs);
     }
 
     starDB->finish();
 
+    if (!cfg.pagedStarDatabaseFile.empty())
+    {
+        auto pagedCatalog = PagedStarCatalog::open(cfg.pagedStarDatabaseFile,
+                                                   static_cast<std::size_t>(cfg.pagedStarMemoryBudget) << 20,
+                                                   cfg.pagedStarQuantized);
+        if (pagedCatalog == nullptr)
+            GetLogger()->error(_("Error reading paged star database {}\n"), cfg.pagedStarDatabaseFile);
+        else
+            starDB->setPagedCatalog(std::move(pagedCatalog));
+    }
+
     universe->setStarCatalog(starDB);
 
     return true;
@@ -4550,6 +5185,12 @@ void CelestiaCore::recordBegin()
     {
         recording = true;
         movieCapture->recordingStatus(true);
+        // Every frame of a movie has to be complete
+        renderer->getShaderManager().setForceSynchronous(true);
+        GetTextureManager()->setForceSynchronous(true);
+        GetGeometryManager()->setForceSynchronous(true);
+        VirtualTexture::setForceSynchronous(true);
+        ImageTexture::setForceSynchronous(true);
     }
 }
 
@@ -4557,6 +5198,11 @@ void CelestiaCore::recordPause()
 {
     recording = false;
     if (movieCapture != nullptr) movieCapture->recordingStatus(false);
+    renderer->getShaderManager().setForceSynchronous(false);
+    GetTextureManager()->setForceSynchronous(false);
+    GetGeometryManager()->setForceSynchronous(false);
+    VirtualTexture::setForceSynchronous(false);
+    ImageTexture::setForceSynchronous(false);
 }
 
 void CelestiaCore::recordEnd()
@@ -4609,6 +5255,12 @@ void CelestiaCore::removeWatcher(CelestiaWatcher* watcher)
 
 void CelestiaCore::notifyWatchers(int property)
 {
+    if (notificationBatchDepth > 0)
+    {
+        pendingNotifications |= property;
+        return;
+    }
+
     for (const auto watcher : watchers)
     {
         watcher->notifyChange(this, property);
@@ -4616,6 +5268,32 @@ void CelestiaCore::notifyWatchers(int property)
 }
 
 
+void CelestiaCore::beginNotificationBatch()
+{
+    notificationBatchDepth++;
+}
+
+
+void CelestiaCore::endNotificationBatch()
+{
+    assert(notificationBatchDepth > 0);
+    if (--notificationBatchDepth > 0)
+        return;
+
+    // Watchers may only look at one property per call, so the pending ones
+    // are sent separately
+    int pending = pendingNotifications;
+    pendingNotifications = 0;
+    for (int property = 1; pending != 0; property <<= 1)
+    {
+        if ((pending & property) == 0)
+            continue;
+        pending &= ~property;
+        notifyWatchers(property);
+    }
+}
+
+
 bool CelestiaCore::goToUrl(const string& urlStr)
 {
     Url url(this);
@@ -4638,7 +5316,7 @@ void CelestiaCore::addToHistory()
         while (historyCurrent != history.size() - 1)
             history.pop_back();
     }
-    history.emplace_back(this);
+    history.emplace_back().capture(this);
     historyCurrent = history.size() - 1;
     notifyWatchers(HistoryChanged);
 }
@@ -4655,7 +5333,7 @@ void CelestiaCore::back()
         historyCurrent = history.size()-1;
     }
     historyCurrent--;
-    history[historyCurrent].goTo();
+    history[historyCurrent].restore(this);
     notifyWatchers(HistoryChanged|RenderFlagsChanged|LabelFlagsChanged);
 }
 
@@ -4665,29 +5343,29 @@ void CelestiaCore::forward()
     if (history.size() == 0) return;
     if (historyCurrent == history.size()-1) return;
     historyCurrent++;
-    history[historyCurrent].goTo();
+    history[historyCurrent].restore(this);
     notifyWatchers(HistoryChanged|RenderFlagsChanged|LabelFlagsChanged);
 }
 
 
-const vector<Url>& CelestiaCore::getHistory() const
+const vector<CelestiaStateSnapshot>& CelestiaCore::getHistory() const
 {
     return history;
 }
 
-vector<Url>::size_type CelestiaCore::getHistoryCurrent() const
+vector<CelestiaStateSnapshot>::size_type CelestiaCore::getHistoryCurrent() const
 {
     return historyCurrent;
 }
 
-void CelestiaCore::setHistoryCurrent(vector<Url>::size_type curr)
+void CelestiaCore::setHistoryCurrent(vector<CelestiaStateSnapshot>::size_type curr)
 {
     if (curr >= history.size()) return;
     if (historyCurrent == history.size()) {
         addToHistory();
     }
     historyCurrent = curr;
-    history[curr].goTo();
+    history[curr].restore(this);
     notifyWatchers(HistoryChanged|RenderFlagsChanged|LabelFlagsChanged);
 }
 
@@ -5030,6 +5708,7 @@ void CelestiaCore::setLayoutDirection(LayoutDirection value)
 
 void CelestiaCore::setLogFile(const fs::path &fn)
 {
+    GetLogger()->flush();
     m_logfile = std::ofstream(fn);
     if (m_logfile.good())
     {
@@ -17,6 +17,8 @@
 #include <string_view>
 #include <tuple>
 #include <celutil/filetype.h>
+#include <celutil/loadtrace.h>
+#include <celutil/memoryreport.h>
 #include <celutil/timer.h>
 #include <celutil/watcher.h>
 // #include <celutil/watchable.h>
@@ -29,7 +31,9 @@
 #include <celengine/simulation.h>
 #include <celengine/overlayimage.h>
 #include <celengine/viewporteffect.h>
+#include <celrender/renderstats.h>
 #include <celutil/tee.h>
+#include "celestiastate.h"
 #include "configfile.h"
 #include "favorites.h"
 #include "destination.h"
@@ -43,6 +47,10 @@
 #include <celscript/legacy/legacyscript.h>
 #include <celscript/common/scriptmaps.h>
 
+class CatalogStreamer;
+class ClusterSync;
+class ControlServer;
+class SimulationThread;
 class Url;
 // class CelestiaWatcher;
 class CelestiaCore;
@@ -240,9 +248,9 @@ class CelestiaCore // : public Watchable<CelestiaCore>
     void addToHistory();
     void back();
     void forward();
-    const std::vector<Url>& getHistory() const;
-    std::vector<Url>::size_type getHistoryCurrent() const;
-    void setHistoryCurrent(std::vector<Url>::size_type curr);
+    const std::vector<CelestiaStateSnapshot>& getHistory() const;
+    std::vector<CelestiaStateSnapshot>::size_type getHistoryCurrent() const;
+    void setHistoryCurrent(std::vector<CelestiaStateSnapshot>::size_type curr);
 
     // event processing methods
     void charEntered(const char*, int modifiers = 0);
@@ -255,15 +263,33 @@ class CelestiaCore // : public Watchable<CelestiaCore>
     void mouseMove(float, float, int);
     void mouseMove(float, float);
     void pickView(float, float);
+    // The object under the mouse pointer in the active view. When the
+    // renderer picks on the GPU, it's the one found a few frames ago.
+    Selection getHoveredObject();
     void joystickAxis(int axis, float amount);
     void joystickButton(int button, bool down);
     void resize(GLsizei w, GLsizei h);
     void draw();
     void draw(View*);
     void tick();
+    // Advance the simulation by dt seconds each tick instead of the time
+    // elapsed since the last one; zero restores the system clock.
+    void setFixedTimeStep(double dt);
+    // Draw the windows with their lower left corner at (-x, -y) of the
+    // viewport, to render a part of a window larger than the target.
+    void setRenderOrigin(int x, int y);
 
     Simulation* getSimulation() const;
     Renderer* getRenderer() const;
+    // Memory taken by the catalogs, the loaded resources and the caches of
+    // the renderer; walks all the catalogs, so it takes a few milliseconds
+    celestia::util::MemoryReport getMemoryReport() const;
+    // Draw call and state change counts of the last completed frame
+    const celestia::render::RenderStats& getFrameStats() const { return lastFrameStats; }
+    // Show the times of the passes of the frame in the overlay, which
+    // profiles the frames while it's shown
+    void setFrameProfileShown(bool);
+    bool getFrameProfileShown() const { return showFrameProfile; }
     void showText(std::string_view s,
                   int horig = 0, int vorig = 0,
                   int hoff = 0, int voff = 0,
@@ -302,6 +328,8 @@ class CelestiaCore // : public Watchable<CelestiaCore>
     void runScript(const fs::path& filename, bool i18n = true);
     void cancelScript();
     void resumeScript();
+    // Whether a script is loaded and hasn't finished yet
+    bool isScriptLoaded() const { return m_script != nullptr; }
 
     int getHudDetail();
     void setHudDetail(int);
@@ -358,6 +386,10 @@ class CelestiaCore // : public Watchable<CelestiaCore>
     CelestiaConfig* getConfig() const;
 
     void notifyWatchers(int);
+    // Between these, each property changed is notified once, at the end;
+    // batches can be nested.
+    void beginNotificationBatch();
+    void endNotificationBatch();
 
     void setLogFile(const fs::path&);
 
@@ -446,6 +478,7 @@ class CelestiaCore // : public Watchable<CelestiaCore>
  protected:
     bool readStars(const CelestiaConfig&, ProgressNotifier*);
     void renderOverlay();
+    void finishLoadTrace();
 #ifdef CELX
     bool initLuaHook(ProgressNotifier*);
 #endif // CELX
@@ -460,6 +493,7 @@ class CelestiaCore // : public Watchable<CelestiaCore>
 
     Simulation* sim{ nullptr };
     Renderer* renderer{ nullptr };
+    celestia::render::RenderStats lastFrameStats;
     Overlay* overlay{ nullptr };
     int width{ 1 };
     int height{ 1 };
@@ -517,12 +551,26 @@ class CelestiaCore // : public Watchable<CelestiaCore>
 
     // Frame rate counter variables
     bool showFPSCounter{ false };
+    bool showFrameProfile{ false };
+    // The time from the start to the first frame and the file loaded
+    // slowest then, from the load trace
+    double startupDuration{ 0.0 };
+    celestia::util::LoadEvent slowestLoad;
+    // Shown with the frame profile, refreshed every second
+    celestia::util::MemoryReport memoryReport;
+    double memoryReportTime{ 0.0 };
     int nFrames{ 0 };
     double fps{ 0.0 };
     double fpsCounterStartTime{ 0.0 };
 
     float oldFOV;
     float mouseMotion{ 0.0f };
+    // Last position of the mouse pointer, for hover picking
+    float hoverX{ 0.0f };
+    float hoverY{ 0.0f };
+    bool hoverValid{ false };
+    bool hoverPicked{ false };
+    Eigen::Vector3f hoverRay{ -Eigen::Vector3f::UnitZ() };
     double dollyMotion{ 0.0 };
     double dollyTime{ 0.0 };
     double zoomMotion{ 0.0 };
@@ -530,6 +578,10 @@ class CelestiaCore // : public Watchable<CelestiaCore>
 
     double sysTime{ 0.0 };
     double currentTime{ 0.0 };
+    double fixedTimeStep{ 0.0 };
+
+    int renderOriginX{ 0 };
+    int renderOriginY{ 0 };
 
     bool viewChanged{ true };
 
@@ -550,17 +602,24 @@ class CelestiaCore // : public Watchable<CelestiaCore>
 
     Alerter* alerter{ nullptr };
     std::vector<CelestiaWatcher*> watchers;
+    int notificationBatchDepth{ 0 };
+    int pendingNotifications{ 0 };
     CursorHandler* cursorHandler{ nullptr };
     CursorShape defaultCursorShape{ CelestiaCore::CrossCursor };
     ContextMenuHandler* contextMenuHandler{ nullptr };
     std::function<std::string(double)> customDateFormatter{ nullptr };
 
-    std::vector<Url> history;
-    std::vector<Url>::size_type historyCurrent{ 0 };
+    // Snapshots are captured without building any string, a Url is only
+    // made of one when it's needed
+    std::vector<CelestiaStateSnapshot> history;
+    std::vector<CelestiaStateSnapshot>::size_type historyCurrent{ 0 };
     std::string startURL;
 
     std::list<View*> views;
     std::list<View*>::iterator activeView{ views.begin() };
+    // Pick ray in camera coordinates through window coordinates x, y of
+    // the active view
+    Eigen::Vector3f getPickRay(float x, float y) const;
     bool showActiveViewFrame{ false };
     bool showViewFrames{ true };
     View *resizeSplit{ nullptr };
@@ -599,6 +658,24 @@ class CelestiaCore // : public Watchable<CelestiaCore>
 
     std::vector<astro::LeapSecondRecord> leapSeconds;
 
+    // Merges the remaining catalogs after startup when StagedStartup is set
+    std::unique_ptr<CatalogStreamer> catalogStreamer;
+
+    // Takes the time steps while the frames are drawn when SimulationThread
+    // is set; the views are drawn from copies of their observers then.
+    std::unique_ptr<SimulationThread> simulationThread;
+    double pendingTimeStep{ 0.0 };
+    bool timeStepPending{ false };
+    std::vector<std::pair<const View*, Observer>> observerSnapshots;
+
+    // Sends or receives the state of each frame when ClusterRole is set;
+    // the simulation of a render node only follows the master's.
+    std::unique_ptr<ClusterSync> clusterSync;
+
+    // Applies the commands of other programs between ticks when
+    // ControlPort is set
+    std::unique_ptr<ControlServer> controlServer;
+
 #ifdef CELX
     friend View* getViewByObserver(CelestiaCore*, Observer*);
     friend void getObservers(CelestiaCore*, std::vector<Observer*>&);
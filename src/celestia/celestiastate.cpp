@@ -22,38 +22,85 @@ CelestiaState::CelestiaState(CelestiaCore* appCore) :
 
 void CelestiaState::captureState()
 {
-    auto *sim = m_appCore->getSimulation();
-    auto *renderer = m_appCore->getRenderer();
-
-    auto frame = sim->getFrame();
+    CelestiaStateSnapshot snapshot;
+    snapshot.capture(m_appCore);
+    setState(snapshot);
+}
 
-    m_coordSys = frame->getCoordinateSystem();
+void CelestiaState::setState(const CelestiaStateSnapshot& snapshot)
+{
+    m_coordSys = snapshot.coordSys;
+    m_refBodyName.clear();
+    m_targetBodyName.clear();
     if (m_coordSys != ObserverFrame::Universal)
     {
-        m_refBodyName = Url::getEncodedObjectName(frame->getRefObject(), m_appCore);
+        m_refBodyName = Url::getEncodedObjectName(snapshot.refObject, m_appCore);
         if (m_coordSys == ObserverFrame::PhaseLock)
-            m_targetBodyName = Url::getEncodedObjectName(frame->getTargetObject(), m_appCore);
+            m_targetBodyName = Url::getEncodedObjectName(snapshot.targetObject, m_appCore);
     }
 
-    m_tdb = sim->getTime();
+    m_observerPosition = snapshot.observerPosition;
+    m_observerOrientation = snapshot.observerOrientation;
+    m_fieldOfView = snapshot.fieldOfView;
+    m_tdb = snapshot.tdb;
+    m_timeScale = snapshot.timeScale;
+    m_pauseState = snapshot.pauseState;
+    m_lightTimeDelay = snapshot.lightTimeDelay;
+    m_trackedBodyName = Url::getEncodedObjectName(snapshot.tracked, m_appCore);
+    m_selectedBodyName = Url::getEncodedObjectName(snapshot.selected, m_appCore);
+    m_labelMode = snapshot.labelMode;
+    m_renderFlags = snapshot.renderFlags;
+}
+
+void CelestiaStateSnapshot::capture(CelestiaCore* appCore)
+{
+    auto *sim = appCore->getSimulation();
+    auto *renderer = appCore->getRenderer();
+
+    const auto& frame = sim->getFrame();
+    coordSys = frame->getCoordinateSystem();
+    refObject = frame->getRefObject();
+    targetObject = frame->getTargetObject();
+
+    tdb = sim->getTime();
 
     // Store the position and orientation of the observer in the current
     // frame.
-    m_observerPosition = sim->getObserver().getPosition();
-    m_observerPosition = frame->convertFromUniversal(m_observerPosition, m_tdb);
-
-    Eigen::Quaterniond q = sim->getObserver().getOrientation();
-    q = frame->convertFromUniversal(q, m_tdb);
-    m_observerOrientation = q.cast<float>();
-
-    auto tracked = sim->getTrackedObject();
-    m_trackedBodyName = Url::getEncodedObjectName(tracked, m_appCore);
-    auto selected = sim->getSelection();
-    m_selectedBodyName = Url::getEncodedObjectName(selected, m_appCore);
-    m_fieldOfView = radToDeg(sim->getActiveObserver()->getFOV());
-    m_timeScale = static_cast<float>(sim->getTimeScale());
-    m_pauseState = sim->getPauseState();
-    m_lightTimeDelay = m_appCore->getLightDelayActive();
-    m_renderFlags = renderer->getRenderFlags();
-    m_labelMode = renderer->getLabelMode();
+    observerPosition = frame->convertFromUniversal(sim->getObserver().getPosition(), tdb);
+    observerOrientation = frame->convertFromUniversal(sim->getObserver().getOrientation(), tdb).cast<float>();
+
+    tracked = sim->getTrackedObject();
+    selected = sim->getSelection();
+    fieldOfView = radToDeg(sim->getActiveObserver()->getFOV());
+    timeScale = static_cast<float>(sim->getTimeScale());
+    pauseState = sim->getPauseState();
+    lightTimeDelay = appCore->getLightDelayActive();
+    renderFlags = renderer->getRenderFlags();
+    labelMode = renderer->getLabelMode();
+}
+
+void CelestiaStateSnapshot::restore(CelestiaCore* appCore) const
+{
+    auto *sim = appCore->getSimulation();
+    auto *renderer = appCore->getRenderer();
+
+    sim->update(0.0);
+    sim->setFrame(coordSys, refObject, targetObject);
+    sim->getActiveObserver()->setFOV(degToRad(fieldOfView));
+    appCore->setZoomFromFOV();
+    sim->setSelection(selected);
+    sim->setTrackedObject(tracked);
+
+    // The position and orientation are stored in frame coordinates
+    const auto& frame = sim->getFrame();
+    Eigen::Quaterniond q = frame->convertToUniversal(observerOrientation.cast<double>(), tdb);
+    sim->setTime(tdb);
+    sim->setObserverPosition(frame->convertToUniversal(observerPosition, tdb));
+    sim->setObserverOrientation(q.cast<float>());
+
+    sim->setTimeScale(timeScale);
+    sim->setPauseState(pauseState);
+    appCore->setLightDelayActive(lightTimeDelay);
+    renderer->setRenderFlags(renderFlags);
+    renderer->setLabelMode(labelMode);
 }
@@ -10,13 +10,47 @@
 
 #pragma once
 
+#include <cstdint>
 #include <map>
 #include <string>
 #include <Eigen/Geometry>
 #include <celengine/observer.h>
+#include <celengine/selection.h>
 
 class CelestiaCore;
 
+/*! CelestiaStateSnapshot holds the same state as a CelestiaState, with the
+ *  objects stored as Selections rather than names. Capturing it copies a
+ *  few values without building any strings, so that it may be taken on
+ *  every move, e.g. for the history; it's converted to a CelestiaState and
+ *  then a URL only when one is needed, e.g. for a bookmark.
+ */
+struct CelestiaStateSnapshot
+{
+    // Observer frame, and the position and orientation in the frame
+    ObserverFrame::CoordinateSystem coordSys                { ObserverFrame::Universal };
+    Selection                       refObject;
+    Selection                       targetObject;
+    UniversalCoord                  observerPosition        { 0.0, 0.0, 0.0 };
+    Eigen::Quaternionf              observerOrientation     { Eigen::Quaternionf::Identity() };
+    float                           fieldOfView             { 45.0f };
+
+    double                          tdb                     { 0.0 };
+    float                           timeScale               { 1.0f };
+    bool                            pauseState              { false };
+    bool                            lightTimeDelay          { false };
+
+    Selection                       tracked;
+    Selection                       selected;
+
+    int                             labelMode               { 0 };
+    std::uint64_t                   renderFlags             { 0 };
+
+    void capture(CelestiaCore* appCore);
+    // Set the simulation to the state, at its time
+    void restore(CelestiaCore* appCore) const;
+};
+
 /*! The CelestiaState class holds the current observer position, orientation,
  *  frame, time, and render settings. It is designed to be serialized as a cel
  *  URL, thus strings are stored for bodies instead of Selections.
@@ -36,6 +70,8 @@ class CelestiaState
     bool loadState(std::map<std::string, std::string> &params);
     void saveState(std::map<std::string, std::string> &params);
     void captureState();
+    // Take the state of a snapshot, naming its objects
+    void setState(const CelestiaStateSnapshot&);
 
  private:
     // Observer frame, position, and orientation. For multiview, there needs
@@ -0,0 +1,141 @@
+// clusterframe.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// State of a frame sent by the master of a cluster to its render nodes.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "clusterframe.h"
+
+#include <sstream>
+
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+
+namespace util = celestia::util;
+
+namespace
+{
+
+// Changed with the encoding, so that nodes of another version are refused
+constexpr std::uint32_t FrameMagic = 0x31464c43; // "CLF1"
+
+// Object names are at most this long
+constexpr std::uint32_t MaxNameLength = 4096;
+
+bool
+writeString(std::ostream& out, const std::string& s)
+{
+    return util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(s.size()))
+        && out.write(s.data(), static_cast<std::streamsize>(s.size())).good();
+}
+
+bool
+readString(std::istream& in, std::string& s)
+{
+    std::uint32_t length;
+    if (!util::readLE<std::uint32_t>(in, length) || length > MaxNameLength)
+        return false;
+
+    s.resize(length);
+    return length == 0 || in.read(s.data(), static_cast<std::streamsize>(length)).good();
+}
+
+bool
+writeR128(std::ostream& out, const R128& r)
+{
+    return util::writeLE<std::uint64_t>(out, r.lo) && util::writeLE<std::uint64_t>(out, r.hi);
+}
+
+bool
+readR128(std::istream& in, R128& r)
+{
+    std::uint64_t lo;
+    std::uint64_t hi;
+    if (!util::readLE<std::uint64_t>(in, lo) || !util::readLE<std::uint64_t>(in, hi))
+        return false;
+
+    r = R128(lo, hi);
+    return true;
+}
+
+} // end unnamed namespace
+
+std::string
+ClusterFrame::encode() const
+{
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    util::writeLE<std::uint32_t>(out, FrameMagic);
+    util::writeLE<std::uint64_t>(out, number);
+
+    util::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(coordSys));
+    writeString(out, refName);
+    writeString(out, targetName);
+    writeR128(out, observerPosition.x);
+    writeR128(out, observerPosition.y);
+    writeR128(out, observerPosition.z);
+    util::writeLE<float>(out, observerOrientation.w());
+    util::writeLE<float>(out, observerOrientation.x());
+    util::writeLE<float>(out, observerOrientation.y());
+    util::writeLE<float>(out, observerOrientation.z());
+    util::writeLE<float>(out, fieldOfView);
+
+    util::writeLE<double>(out, tdb);
+    util::writeLE<float>(out, timeScale);
+    util::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>((pauseState ? 1 : 0) | (lightTimeDelay ? 2 : 0)));
+
+    writeString(out, trackedName);
+    writeString(out, selectedName);
+
+    util::writeLE<std::int32_t>(out, static_cast<std::int32_t>(labelMode));
+    util::writeLE<std::uint64_t>(out, renderFlags);
+    return out.str();
+}
+
+bool
+ClusterFrame::decode(std::string_view data)
+{
+    std::istringstream in(std::string(data), std::ios::in | std::ios::binary);
+
+    std::uint32_t magic;
+    if (!util::readLE<std::uint32_t>(in, magic) || magic != FrameMagic)
+        return false;
+
+    std::uint8_t coordSysValue;
+    float w, x, y, z;
+    std::uint8_t timeFlags;
+    std::int32_t labelModeValue;
+    if (!util::readLE<std::uint64_t>(in, number)
+        || !util::readLE<std::uint8_t>(in, coordSysValue)
+        || !readString(in, refName)
+        || !readString(in, targetName)
+        || !readR128(in, observerPosition.x)
+        || !readR128(in, observerPosition.y)
+        || !readR128(in, observerPosition.z)
+        || !util::readLE<float>(in, w)
+        || !util::readLE<float>(in, x)
+        || !util::readLE<float>(in, y)
+        || !util::readLE<float>(in, z)
+        || !util::readLE<float>(in, fieldOfView)
+        || !util::readLE<double>(in, tdb)
+        || !util::readLE<float>(in, timeScale)
+        || !util::readLE<std::uint8_t>(in, timeFlags)
+        || !readString(in, trackedName)
+        || !readString(in, selectedName)
+        || !util::readLE<std::int32_t>(in, labelModeValue)
+        || !util::readLE<std::uint64_t>(in, renderFlags))
+    {
+        return false;
+    }
+
+    coordSys = static_cast<ObserverFrame::CoordinateSystem>(coordSysValue);
+    observerOrientation = Eigen::Quaternionf(w, x, y, z);
+    pauseState = (timeFlags & 1) != 0;
+    lightTimeDelay = (timeFlags & 2) != 0;
+    labelMode = labelModeValue;
+    return true;
+}
@@ -0,0 +1,53 @@
+// clusterframe.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// State of a frame sent by the master of a cluster to its render nodes.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <Eigen/Geometry>
+#include <celengine/observer.h>
+#include <celengine/univcoord.h>
+
+/*! ClusterFrame holds the state which a render node needs to draw the same
+ *  frame as the master: the time, the observer frame, position and
+ *  orientation, the selection and the render settings. Objects are stored
+ *  by name, as in a cel URL, since the Selections of the master have no
+ *  meaning on the nodes; its encoding is compact enough to be sent on
+ *  every frame.
+ */
+struct ClusterFrame
+{
+    std::uint64_t                   number                  { 0 };
+
+    ObserverFrame::CoordinateSystem coordSys                { ObserverFrame::Universal };
+    std::string                     refName;
+    std::string                     targetName;
+    UniversalCoord                  observerPosition        { 0.0, 0.0, 0.0 };
+    Eigen::Quaternionf              observerOrientation     { Eigen::Quaternionf::Identity() };
+    float                           fieldOfView             { 45.0f };
+
+    double                          tdb                     { 0.0 };
+    float                           timeScale               { 1.0f };
+    bool                            pauseState              { false };
+    bool                            lightTimeDelay          { false };
+
+    std::string                     trackedName;
+    std::string                     selectedName;
+
+    int                             labelMode               { 0 };
+    std::uint64_t                   renderFlags             { 0 };
+
+    std::string encode() const;
+    // Returns false if the data is truncated or not a frame
+    bool decode(std::string_view data);
+};
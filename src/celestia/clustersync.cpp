@@ -0,0 +1,457 @@
+// clustersync.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Frame-locked rendering of one simulation on several machines.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "clustersync.h"
+
+#include <cstring>
+#include <utility>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#endif
+
+#include <celmath/mathlib.h>
+#include <celutil/logger.h>
+#include "celestiacore.h"
+#include "celestiastate.h"
+#include "clusterframe.h"
+#include "netsocket.h"
+#include "url.h"
+
+using namespace celestia::net;
+using celestia::util::GetLogger;
+
+namespace
+{
+
+// A node not ready within this time is dropped by the master, and the
+// master not sending a frame within it is reconnected to by the node
+constexpr int ReceiveTimeout = 5000; // milliseconds
+constexpr auto ReconnectInterval = std::chrono::seconds(1);
+
+// Larger messages can only come from something else than a cluster machine
+constexpr std::uint32_t MaxMessageSize = 1 << 16;
+
+enum class MessageType : std::uint8_t
+{
+    Frame   = 1, // master to nodes: the state of a frame
+    Ready   = 2, // node to master: the frame is drawn
+    Swap    = 3, // master to nodes: all nodes have drawn the frame
+};
+
+// Frames are small and sent at once, so they're not delayed to be merged
+void
+setStreamOptions(SocketHandle s)
+{
+    setNoDelay(s);
+#ifdef _WIN32
+    DWORD timeout = ReceiveTimeout;
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+#else
+    timeval timeout{ ReceiveTimeout / 1000, (ReceiveTimeout % 1000) * 1000 };
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+#endif
+}
+
+} // end unnamed namespace
+
+
+// A TCP connection carrying messages framed as a 32 bit little endian
+// length, a type byte and the payload
+class ClusterConnection
+{
+ public:
+    explicit ClusterConnection(SocketHandle _socket) : socket(_socket) {}
+    ~ClusterConnection() { closeSocket(socket); }
+
+    ClusterConnection(const ClusterConnection&) = delete;
+    ClusterConnection& operator=(const ClusterConnection&) = delete;
+
+    SocketHandle getSocket() const { return socket; }
+
+    bool send(MessageType type, const std::string& payload);
+    bool send(MessageType type, std::uint64_t number);
+    // Wait for the next message of the type, skipping others
+    bool receive(MessageType type, std::string& payload);
+    bool receive(MessageType type, std::uint64_t& number);
+
+ private:
+    bool sendAll(const char* data, std::size_t size);
+    bool receiveAll(char* data, std::size_t size);
+
+    SocketHandle socket;
+};
+
+
+bool ClusterConnection::send(MessageType type, const std::string& payload)
+{
+    auto size = static_cast<std::uint32_t>(payload.size() + 1);
+    char header[5] =
+    {
+        static_cast<char>(size & 0xff),
+        static_cast<char>((size >> 8) & 0xff),
+        static_cast<char>((size >> 16) & 0xff),
+        static_cast<char>((size >> 24) & 0xff),
+        static_cast<char>(type),
+    };
+    return sendAll(header, sizeof(header)) && sendAll(payload.data(), payload.size());
+}
+
+
+bool ClusterConnection::send(MessageType type, std::uint64_t number)
+{
+    std::string payload(8, '\0');
+    for (int i = 0; i < 8; ++i)
+        payload[i] = static_cast<char>((number >> (i * 8)) & 0xff);
+    return send(type, payload);
+}
+
+
+bool ClusterConnection::receive(MessageType type, std::string& payload)
+{
+    for (;;)
+    {
+        unsigned char header[5];
+        if (!receiveAll(reinterpret_cast<char*>(header), sizeof(header)))
+            return false;
+
+        std::uint32_t size = static_cast<std::uint32_t>(header[0])
+                           | (static_cast<std::uint32_t>(header[1]) << 8)
+                           | (static_cast<std::uint32_t>(header[2]) << 16)
+                           | (static_cast<std::uint32_t>(header[3]) << 24);
+        if (size == 0 || size > MaxMessageSize)
+            return false;
+
+        payload.resize(size - 1);
+        if (size > 1 && !receiveAll(payload.data(), payload.size()))
+            return false;
+        if (header[4] == static_cast<unsigned char>(type))
+            return true;
+    }
+}
+
+
+bool ClusterConnection::receive(MessageType type, std::uint64_t& number)
+{
+    std::string payload;
+    if (!receive(type, payload) || payload.size() != 8)
+        return false;
+
+    number = 0;
+    for (int i = 0; i < 8; ++i)
+        number |= static_cast<std::uint64_t>(static_cast<unsigned char>(payload[i])) << (i * 8);
+    return true;
+}
+
+
+bool ClusterConnection::sendAll(const char* data, std::size_t size)
+{
+    while (size > 0)
+    {
+        auto sent = ::send(socket, data, static_cast<int>(size), sendFlags());
+        if (sent <= 0)
+            return false;
+        data += sent;
+        size -= static_cast<std::size_t>(sent);
+    }
+    return true;
+}
+
+
+// Fails once the receive timeout set on the socket expires
+bool ClusterConnection::receiveAll(char* data, std::size_t size)
+{
+    while (size > 0)
+    {
+        auto received = ::recv(socket, data, static_cast<int>(size), 0);
+        if (received <= 0)
+            return false;
+        data += received;
+        size -= static_cast<std::size_t>(received);
+    }
+    return true;
+}
+
+
+ClusterSync::ClusterSync(bool _master) :
+    master(_master)
+{
+}
+
+
+ClusterSync::~ClusterSync() = default;
+
+
+std::unique_ptr<ClusterSync> ClusterSync::createMaster(std::uint16_t port)
+{
+    if (!initSockets())
+        return nullptr;
+
+    SocketHandle s = listenOn(port);
+    if (s == InvalidSocket)
+    {
+        GetLogger()->error("Cluster master can't listen on port {}\n", port);
+        return nullptr;
+    }
+
+    // Nodes are accepted between frames without waiting for them
+    setBlocking(s, false);
+
+    std::unique_ptr<ClusterSync> sync(new ClusterSync(true));
+    sync->listener = std::make_unique<ClusterConnection>(s);
+    GetLogger()->info("Cluster master listening on port {}\n", port);
+    return sync;
+}
+
+
+std::unique_ptr<ClusterSync> ClusterSync::createNode(const std::string& host,
+                                                     std::uint16_t port,
+                                                     const NodeView& view)
+{
+    if (!initSockets())
+        return nullptr;
+
+    using celmath::degToRad;
+
+    std::unique_ptr<ClusterSync> sync(new ClusterSync(false));
+    sync->host = host;
+    sync->port = port;
+    sync->fieldOfView = view.fieldOfView;
+
+    // The observer orientation turns universal into view coordinates, so the
+    // view is turned by the inverse of the rotation of the node's camera
+    Eigen::Quaternionf camera = Eigen::AngleAxisf(degToRad(-view.yaw), Eigen::Vector3f::UnitY())
+                              * Eigen::AngleAxisf(degToRad(view.pitch), Eigen::Vector3f::UnitX())
+                              * Eigen::AngleAxisf(degToRad(-view.roll), Eigen::Vector3f::UnitZ());
+    sync->viewOffset = camera.conjugate();
+
+    sync->connectToMaster();
+    return sync;
+}
+
+
+void ClusterSync::acceptNodes()
+{
+    for (;;)
+    {
+        SocketHandle s = accept(listener->getSocket(), nullptr, nullptr);
+        if (s == InvalidSocket)
+            return;
+
+        setBlocking(s, true);
+        setStreamOptions(s);
+        nodes.push_back(std::make_unique<ClusterConnection>(s));
+        GetLogger()->info("Cluster node connected, {} connected\n", nodes.size());
+    }
+}
+
+
+bool ClusterSync::connectToMaster()
+{
+    lastConnectAttempt = std::chrono::steady_clock::now();
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    addrinfo* addresses = nullptr;
+    std::string service = std::to_string(port);
+    if (getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses) != 0)
+    {
+        GetLogger()->error("Can't resolve the cluster master {}\n", host);
+        return false;
+    }
+
+    for (const addrinfo* a = addresses; a != nullptr; a = a->ai_next)
+    {
+        SocketHandle s = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (s == InvalidSocket)
+            continue;
+        if (connect(s, a->ai_addr, static_cast<int>(a->ai_addrlen)) == 0)
+        {
+            setStreamOptions(s);
+            connection = std::make_unique<ClusterConnection>(s);
+            break;
+        }
+        closeSocket(s);
+    }
+    freeaddrinfo(addresses);
+
+    if (connection == nullptr)
+        GetLogger()->warn("Can't connect to the cluster master {}:{}\n", host, port);
+    else
+        GetLogger()->info("Connected to the cluster master {}:{}\n", host, port);
+    return connection != nullptr;
+}
+
+
+void ClusterSync::sendFrame(CelestiaCore* appCore)
+{
+    acceptNodes();
+    if (nodes.empty())
+        return;
+
+    CelestiaStateSnapshot snapshot;
+    snapshot.capture(appCore);
+
+    ClusterFrame frame;
+    frame.number = ++frameNumber;
+    frame.coordSys = snapshot.coordSys;
+    if (frame.coordSys != ObserverFrame::Universal)
+    {
+        frame.refName = Url::getEncodedObjectName(snapshot.refObject, appCore);
+        if (frame.coordSys == ObserverFrame::PhaseLock)
+            frame.targetName = Url::getEncodedObjectName(snapshot.targetObject, appCore);
+    }
+    frame.observerPosition = snapshot.observerPosition;
+    frame.observerOrientation = snapshot.observerOrientation;
+    frame.fieldOfView = snapshot.fieldOfView;
+    frame.tdb = snapshot.tdb;
+    frame.timeScale = snapshot.timeScale;
+    frame.pauseState = snapshot.pauseState;
+    frame.lightTimeDelay = snapshot.lightTimeDelay;
+    frame.trackedName = Url::getEncodedObjectName(snapshot.tracked, appCore);
+    frame.selectedName = Url::getEncodedObjectName(snapshot.selected, appCore);
+    frame.labelMode = snapshot.labelMode;
+    frame.renderFlags = snapshot.renderFlags;
+
+    std::string data = frame.encode();
+    framePending = true;
+    for (auto it = nodes.begin(); it != nodes.end();)
+    {
+        if ((*it)->send(MessageType::Frame, data))
+        {
+            ++it;
+        }
+        else
+        {
+            it = nodes.erase(it);
+            GetLogger()->warn("Cluster node disconnected, {} connected\n", nodes.size());
+        }
+    }
+}
+
+
+bool ClusterSync::receiveFrame(CelestiaCore* appCore)
+{
+    if (connection == nullptr)
+    {
+        if (std::chrono::steady_clock::now() - lastConnectAttempt < ReconnectInterval || !connectToMaster())
+            return false;
+    }
+
+    std::string data;
+    ClusterFrame frame;
+    if (!connection->receive(MessageType::Frame, data) || !frame.decode(data))
+    {
+        GetLogger()->warn("Lost the cluster master {}:{}\n", host, port);
+        connection.reset();
+        return false;
+    }
+
+    frameNumber = frame.number;
+    framePending = true;
+    applyFrame(appCore, frame);
+    return true;
+}
+
+
+void ClusterSync::applyFrame(CelestiaCore* appCore, const ClusterFrame& frame) const
+{
+    Simulation* sim = appCore->getSimulation();
+    auto findObject = [sim](const std::string& name)
+    {
+        return name.empty() ? Selection() : sim->findObjectFromPath(Url::decodeString(name));
+    };
+
+    CelestiaStateSnapshot snapshot;
+    snapshot.coordSys = frame.coordSys;
+    snapshot.refObject = findObject(frame.refName);
+    snapshot.targetObject = findObject(frame.targetName);
+    snapshot.observerPosition = frame.observerPosition;
+    snapshot.observerOrientation = frame.observerOrientation;
+    snapshot.fieldOfView = fieldOfView > 0.0f ? fieldOfView : frame.fieldOfView;
+    snapshot.tdb = frame.tdb;
+    snapshot.timeScale = frame.timeScale;
+    snapshot.pauseState = frame.pauseState;
+    snapshot.lightTimeDelay = frame.lightTimeDelay;
+    snapshot.tracked = findObject(frame.trackedName);
+    snapshot.selected = findObject(frame.selectedName);
+    snapshot.labelMode = frame.labelMode;
+    snapshot.renderFlags = frame.renderFlags;
+    snapshot.restore(appCore);
+
+    sim->setObserverOrientation(viewOffset * sim->getObserver().getOrientationf());
+}
+
+
+void ClusterSync::swapBarrier()
+{
+    if (!framePending)
+        return;
+    framePending = false;
+
+    if (master)
+    {
+        for (auto it = nodes.begin(); it != nodes.end();)
+        {
+            std::uint64_t number = 0;
+            // Ready messages of frames skipped by a node are passed over
+            bool ready = false;
+            while ((*it)->receive(MessageType::Ready, number))
+            {
+                if (number >= frameNumber)
+                {
+                    ready = true;
+                    break;
+                }
+            }
+
+            if (ready)
+            {
+                ++it;
+            }
+            else
+            {
+                it = nodes.erase(it);
+                GetLogger()->warn("Cluster node not responding, {} connected\n", nodes.size());
+            }
+        }
+
+        for (auto it = nodes.begin(); it != nodes.end();)
+        {
+            if ((*it)->send(MessageType::Swap, frameNumber))
+                ++it;
+            else
+                it = nodes.erase(it);
+        }
+    }
+    else if (connection != nullptr)
+    {
+        std::uint64_t number = 0;
+        bool swapped = connection->send(MessageType::Ready, frameNumber);
+        while (swapped && (swapped = connection->receive(MessageType::Swap, number)) && number < frameNumber)
+            continue;
+
+        if (!swapped)
+        {
+            GetLogger()->warn("Lost the cluster master {}:{}\n", host, port);
+            connection.reset();
+        }
+    }
+}
@@ -0,0 +1,89 @@
+// clustersync.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Frame-locked rendering of one simulation on several machines.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <Eigen/Geometry>
+
+class CelestiaCore;
+class ClusterConnection;
+struct ClusterFrame;
+
+/*! ClusterSync shows one simulation on the displays of several machines,
+ *  e.g. the projectors of a dome or the screens of a video wall. The
+ *  master runs the simulation, the scripts and the input; after each tick
+ *  it sends the state of the frame to the render nodes connected over
+ *  TCP. A node takes that state in place of its own simulation, turned by
+ *  the offset of its view, and draws it through its own warp mesh. Then
+ *  all machines wait at a barrier, so that the buffers of a frame are
+ *  swapped together.
+ */
+class ClusterSync
+{
+ public:
+    // View of a render node relative to the master: angles in degrees, a
+    // positive yaw turning it right and a positive pitch up. With a field
+    // of view of 0, the master's is used.
+    struct NodeView
+    {
+        float yaw           { 0.0f };
+        float pitch         { 0.0f };
+        float roll          { 0.0f };
+        float fieldOfView   { 0.0f };
+    };
+
+    ~ClusterSync();
+
+    static std::unique_ptr<ClusterSync> createMaster(std::uint16_t port);
+    static std::unique_ptr<ClusterSync> createNode(const std::string& host,
+                                                   std::uint16_t port,
+                                                   const NodeView& view);
+
+    bool isMaster() const { return master; }
+
+    // On the master, send the state of the simulation after a tick to the
+    // nodes, which are accepted as they connect
+    void sendFrame(CelestiaCore* appCore);
+    // On a node, wait for the next frame and set the simulation to it;
+    // returns false if none came, leaving the simulation unchanged
+    bool receiveFrame(CelestiaCore* appCore);
+    // Wait until all machines have drawn the frame, before it's swapped
+    void swapBarrier();
+
+ private:
+    explicit ClusterSync(bool _master);
+
+    void acceptNodes();
+    bool connectToMaster();
+    void applyFrame(CelestiaCore* appCore, const ClusterFrame& frame) const;
+
+    bool master;
+    std::uint64_t frameNumber{ 0 };
+    // Whether a frame was sent or received since the last barrier
+    bool framePending{ false };
+
+    // On the master
+    std::unique_ptr<ClusterConnection> listener;
+    std::vector<std::unique_ptr<ClusterConnection>> nodes;
+
+    // On a node
+    std::string host;
+    std::uint16_t port{ 0 };
+    Eigen::Quaternionf viewOffset{ Eigen::Quaternionf::Identity() };
+    float fieldOfView{ 0.0f };
+    std::unique_ptr<ClusterConnection> connection;
+    std::chrono::steady_clock::time_point lastConnectAttempt;
+};
@@ -66,6 +66,8 @@ CelestiaConfig* ReadCelestiaConfig(const fs::path& filename, CelestiaConfig *con
         config->initScriptFile = *path;
     if (auto path = configParams->getPath("DemoScript"); path.has_value())
         config->demoScriptFile = *path;
+    if (auto path = configParams->getPath("LoadTraceFile"); path.has_value())
+        config->loadTraceFile = *path;
     if (auto path = configParams->getPath("AsterismsFile"); path.has_value())
         config->asterismsFile = *path;
     if (auto path = configParams->getPath("BoundariesFile"); path.has_value())
@@ -74,6 +76,8 @@ CelestiaConfig* ReadCelestiaConfig(const fs::path& filename, CelestiaConfig *con
         config->starDatabaseFile = *path;
     if (auto path = configParams->getPath("StarNameDatabase"); path.has_value())
         config->starNamesFile = *path;
+    if (auto path = configParams->getPath("PagedStarDatabase"); path.has_value())
+        config->pagedStarDatabaseFile = *path;
     if (auto path = configParams->getPath("HDCrossIndex"); path.has_value())
         config->HDCrossIndexFile = *path;
     if (auto path = configParams->getPath("SAOCrossIndex"); path.has_value())
@@ -98,8 +102,23 @@ CelestiaConfig* ReadCelestiaConfig(const fs::path& filename, CelestiaConfig *con
         config->viewportEffect = *viewportEffect;
     if (const std::string* warpMeshFile = configParams->getString("WarpMeshFile"); warpMeshFile != nullptr)
         config->warpMeshFile = *warpMeshFile;
+    auto aperture = configParams->getNumber<float>("FisheyeAperture").value_or(180.0f);
+    config->fisheyeAperture = std::clamp(aperture, 1.0f, 360.0f);
+    if (const std::string* clusterRole = configParams->getString("ClusterRole"); clusterRole != nullptr)
+        config->clusterRole = *clusterRole;
+    if (const std::string* clusterHost = configParams->getString("ClusterHost"); clusterHost != nullptr)
+        config->clusterHost = *clusterHost;
+    config->clusterPort = std::min(configParams->getNumber<unsigned int>("ClusterPort").value_or(7890u), 65535u);
+    config->clusterViewYaw = configParams->getNumber<float>("ClusterViewYaw").value_or(0.0f);
+    config->clusterViewPitch = configParams->getNumber<float>("ClusterViewPitch").value_or(0.0f);
+    config->clusterViewRoll = configParams->getNumber<float>("ClusterViewRoll").value_or(0.0f);
+    config->clusterFieldOfView = std::clamp(configParams->getNumber<float>("ClusterFieldOfView").value_or(0.0f), 0.0f, 179.0f);
+    config->controlPort = std::min(configParams->getNumber<unsigned int>("ControlPort").value_or(0u), 65535u);
+    config->controlAllowRemote = configParams->getBoolean("ControlAllowRemote").value_or(false);
     if (const std::string* x264EncoderOptions = configParams->getString("X264EncoderOptions"); x264EncoderOptions != nullptr)
         config->x264EncoderOptions = *x264EncoderOptions;
+    if (const std::string* h264Encoder = configParams->getString("H264Encoder"); h264Encoder != nullptr)
+        config->h264Encoder = *h264Encoder;
     if (const std::string* ffvhEncoderOptions = configParams->getString("FFVHEncoderOptions"); ffvhEncoderOptions != nullptr)
         config->ffvhEncoderOptions = *ffvhEncoderOptions;
     if (const std::string* measurementSystem = configParams->getString("MeasurementSystem"); measurementSystem != nullptr)
@@ -113,8 +132,34 @@ CelestiaConfig* ReadCelestiaConfig(const fs::path& filename, CelestiaConfig *con
     config->SolarSystemMaxDistance = std::clamp(maxDist, 1.0f, 10.0f);
 
     config->ShadowMapSize = configParams->getNumber<unsigned int>("ShadowMapSize").value_or(0u);
+    config->ShadowMapCacheSize = configParams->getNumber<unsigned int>("ShadowMapCacheSize").value_or(0u);
+    config->ShadowMapCascadeSize = configParams->getNumber<unsigned int>("ShadowMapCascadeSize").value_or(0u);
+    config->RingShadowTextureSize = configParams->getNumber<unsigned int>("RingShadowTextureSize").value_or(0u);
 
     config->aaSamples = configParams->getNumber<unsigned int>("AntialiasingSamples").value_or(1u);
+    config->gpuStarCatalog = configParams->getBoolean("GPUStarCatalog").value_or(false);
+    config->shaderCache = configParams->getBoolean("ShaderCache").value_or(true);
+    config->shaderWarmUp = configParams->getBoolean("ShaderWarmUp").value_or(false);
+    config->asyncShaderCompile = configParams->getBoolean("AsyncShaderCompile").value_or(false);
+    config->compressTextures = configParams->getBoolean("CompressTextures").value_or(false);
+    config->staticSphereMeshes = configParams->getBoolean("StaticSphereMeshes").value_or(false);
+    config->optimizeModels = configParams->getBoolean("OptimizeModels").value_or(false);
+    config->modelLevelsOfDetail = configParams->getBoolean("ModelLevelsOfDetail").value_or(false);
+    config->frameTimeBudget = std::max(configParams->getNumber<float>("FrameTimeBudget").value_or(0.0f), 0.0f);
+    config->declutterLabels = configParams->getBoolean("DeclutterLabels").value_or(false);
+    config->distanceFieldFonts = configParams->getBoolean("DistanceFieldFonts").value_or(false);
+    config->gpuPicking = configParams->getBoolean("GPUPicking").value_or(false);
+    config->reverseDepth = configParams->getBoolean("ReverseDepth").value_or(false);
+    config->starBloom = configParams->getBoolean("StarBloom").value_or(false);
+    config->pagedStarQuantized = configParams->getBoolean("PagedStarQuantized").value_or(true);
+    config->stagedStartup = configParams->getBoolean("StagedStartup").value_or(false);
+    config->cacheCatalogs = configParams->getBoolean("CacheCatalogs").value_or(false);
+    config->cacheSize = configParams->getNumber<unsigned int>("CacheSize").value_or(2048u);
+    config->lazyMinorBodies = configParams->getBoolean("LazyMinorBodies").value_or(false);
+    config->simulationThread = configParams->getBoolean("SimulationThread").value_or(false);
+    config->jobThreads = configParams->getNumber<unsigned int>("JobThreads").value_or(0u);
+    config->asyncLogging = configParams->getBoolean("AsyncLogging").value_or(false);
+    config->logRateLimit = configParams->getNumber<unsigned int>("LogRateLimit").value_or(0u);
 
     config->rotateAcceleration = configParams->getNumber<float>("RotateAcceleration").value_or(120.0f);
     config->mouseRotationSensitivity = configParams->getNumber<float>("MouseRotationSensitivity").value_or(1.0f);
@@ -123,14 +168,26 @@ CelestiaConfig* ReadCelestiaConfig(const fs::path& filename, CelestiaConfig *con
         config->scriptScreenshotDirectory = *path;
     if (const std::string* scriptSystemAccessPolicy = configParams->getString("ScriptSystemAccessPolicy"); scriptSystemAccessPolicy != nullptr)
         config->scriptSystemAccessPolicy = *scriptSystemAccessPolicy;
+    config->scriptFrameBudget = configParams->getNumber<float>("ScriptFrameBudget").value_or(0.0f);
 
     config->orbitWindowEnd = configParams->getNumber<float>("OrbitWindowEnd").value_or(0.5f);
     config->orbitPeriodsShown = configParams->getNumber<float>("OrbitPeriodsShown").value_or(1.0f);
     config->linearFadeFraction = configParams->getNumber<float>("LinearFadeFraction").value_or(0.0f);
 
     config->orbitPathSamplePoints = configParams->getNumber<unsigned int>("OrbitPathSamplePoints").value_or(100u);
+    config->pagedStarMemoryBudget = configParams->getNumber<unsigned int>("PagedStarMemoryBudget").value_or(512u);
     config->shadowTextureSize = configParams->getNumber<unsigned int>("ShadowTextureSize").value_or(256u);
     config->eclipseTextureSize = configParams->getNumber<unsigned int>("EclipseTextureSize").value_or(128u);
+    config->starRenderThreads = configParams->getNumber<unsigned int>("StarRenderThreads").value_or(1u);
+    config->dsoRenderThreads = configParams->getNumber<unsigned int>("DSORenderThreads").value_or(1u);
+    config->orbitSamplingThreads = configParams->getNumber<unsigned int>("OrbitSamplingThreads").value_or(1u);
+    config->renderListThreads = configParams->getNumber<unsigned int>("RenderListThreads").value_or(1u);
+    config->textureLoadingThreads = configParams->getNumber<unsigned int>("TextureLoadingThreads").value_or(0u);
+    config->modelLoadingThreads = configParams->getNumber<unsigned int>("ModelLoadingThreads").value_or(0u);
+    config->virtualTextureMemoryBudget = configParams->getNumber<unsigned int>("VirtualTextureMemoryBudget").value_or(512u);
+    config->tileCacheSize = configParams->getNumber<unsigned int>("TileCacheSize").value_or(1024u);
+    config->textureMemoryBudget = configParams->getNumber<unsigned int>("TextureMemoryBudget").value_or(0u);
+    config->autoTextureResolution = configParams->getBoolean("AutoTextureResolution").value_or(false);
 
     config->consoleLogRows = configParams->getNumber<unsigned int>("LogSize").value_or(200u);
 
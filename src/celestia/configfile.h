@@ -22,17 +22,29 @@ class CelestiaConfig
 public:
     fs::path starDatabaseFile;
     fs::path starNamesFile;
+    fs::path pagedStarDatabaseFile;
+    unsigned int pagedStarMemoryBudget;
+    bool pagedStarQuantized;
     std::vector<fs::path> solarSystemFiles;
     std::vector<fs::path> starCatalogFiles;
     std::vector<fs::path> dsoCatalogFiles;
     std::vector<fs::path> extrasDirs;
     std::vector<fs::path> skipExtras;
+    bool stagedStartup;
+    bool cacheCatalogs;
+    unsigned int cacheSize;
+    bool lazyMinorBodies;
+    bool simulationThread;
+    unsigned int jobThreads;
+    bool asyncLogging;
+    unsigned int logRateLimit;
     fs::path deepSkyCatalog;
     fs::path asterismsFile;
     fs::path boundariesFile;
     float faintestVisible;
     fs::path favoritesFile;
     fs::path initScriptFile;
+    fs::path loadTraceFile;
     fs::path demoScriptFile;
     fs::path destinationsFile;
     std::string mainFont;
@@ -49,6 +61,7 @@ public:
     double linearFadeFraction;
     fs::path scriptScreenshotDirectory;
     std::string scriptSystemAccessPolicy;
+    float scriptFrameBudget;
 #ifdef CELX
     fs::path luaHook;
     const Hash* configParams;
@@ -64,6 +77,27 @@ public:
     unsigned int shadowTextureSize;
     unsigned int eclipseTextureSize;
     unsigned int orbitPathSamplePoints;
+    unsigned int starRenderThreads;
+    unsigned int dsoRenderThreads;
+    unsigned int orbitSamplingThreads;
+    unsigned int renderListThreads;
+    unsigned int textureLoadingThreads;
+    unsigned int modelLoadingThreads;
+    unsigned int virtualTextureMemoryBudget;
+    unsigned int tileCacheSize;
+    unsigned int textureMemoryBudget;
+    bool autoTextureResolution;
+    bool gpuStarCatalog;
+    bool shaderCache;
+    bool shaderWarmUp;
+    bool asyncShaderCompile;
+    bool compressTextures;
+    bool staticSphereMeshes;
+    bool optimizeModels;
+    bool modelLevelsOfDetail;
+    float frameTimeBudget;
+    bool declutterLabels;
+    bool distanceFieldFonts;
 
     unsigned int aaSamples;
 
@@ -73,14 +107,34 @@ public:
 
     float SolarSystemMaxDistance;
     unsigned ShadowMapSize;
+    unsigned ShadowMapCacheSize;
+    unsigned ShadowMapCascadeSize;
+    unsigned RingShadowTextureSize;
+    bool gpuPicking;
+    bool reverseDepth;
+    bool starBloom;
 
     std::string projectionMode;
     std::string viewportEffect;
     std::string warpMeshFile;
+    float fisheyeAperture;
+
+    std::string clusterRole;
+    std::string clusterHost;
+    unsigned int clusterPort;
+    float clusterViewYaw;
+    float clusterViewPitch;
+    float clusterViewRoll;
+    float clusterFieldOfView;
+
+    // The control server is started if the port isn't 0
+    unsigned int controlPort;
+    bool controlAllowRemote;
     std::string measurementSystem;
     std::string temperatureScale;
 
     std::string x264EncoderOptions;
+    std::string h264Encoder;
     std::string ffvhEncoderOptions;
 
     fs::path leapSecondsFile;
@@ -0,0 +1,201 @@
+// controlcommand.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Commands and replies of the control server.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "controlcommand.h"
+
+#include <cmath>
+
+#include <fmt/format.h>
+
+namespace
+{
+
+bool
+isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+} // end unnamed namespace
+
+bool
+ControlCommand::parse(std::string_view line)
+{
+    id.clear();
+    name.clear();
+    args.clear();
+
+    std::vector<std::string> words;
+    std::size_t pos = 0;
+    while (pos < line.size())
+    {
+        if (isSpace(line[pos]))
+        {
+            ++pos;
+            continue;
+        }
+
+        std::string word;
+        if (line[pos] == '"')
+        {
+            for (++pos;; ++pos)
+            {
+                if (pos == line.size())
+                    return false;
+                if (line[pos] == '"')
+                    break;
+                if (line[pos] == '\\' && pos + 1 < line.size())
+                    ++pos;
+                word += line[pos];
+            }
+            ++pos;
+        }
+        else
+        {
+            while (pos < line.size() && !isSpace(line[pos]))
+                word += line[pos++];
+        }
+        words.push_back(std::move(word));
+    }
+
+    auto it = words.begin();
+    if (it != words.end() && it->size() > 1 && it->front() == '@')
+    {
+        id = it->substr(1);
+        ++it;
+    }
+    if (it == words.end())
+        return false;
+
+    name = std::move(*it);
+    args.assign(std::make_move_iterator(it + 1), std::make_move_iterator(words.end()));
+    return true;
+}
+
+
+void
+JsonWriter::separate()
+{
+    if (afterKey)
+    {
+        afterKey = false;
+        return;
+    }
+    if (!empty.empty())
+    {
+        if (!empty.back())
+            text += ',';
+        empty.back() = false;
+    }
+}
+
+JsonWriter&
+JsonWriter::beginObject()
+{
+    separate();
+    text += '{';
+    empty.push_back(true);
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::endObject()
+{
+    text += '}';
+    empty.pop_back();
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::beginArray()
+{
+    separate();
+    text += '[';
+    empty.push_back(true);
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::endArray()
+{
+    text += ']';
+    empty.pop_back();
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::key(std::string_view k)
+{
+    value(k);
+    text += ':';
+    afterKey = true;
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::value(std::string_view v)
+{
+    separate();
+    text += '"';
+    for (char c : v)
+    {
+        if (c == '"' || c == '\\')
+        {
+            text += '\\';
+            text += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            text += fmt::format("\\u{:04x}", static_cast<unsigned int>(c));
+        }
+        else
+        {
+            text += c;
+        }
+    }
+    text += '"';
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::value(bool v)
+{
+    separate();
+    text += v ? "true" : "false";
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::value(std::int64_t v)
+{
+    separate();
+    text += fmt::format("{}", v);
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::value(double v)
+{
+    if (!std::isfinite(v))
+        return null();
+
+    separate();
+    text += fmt::format("{}", v);
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::null()
+{
+    separate();
+    text += "null";
+    return *this;
+}
@@ -0,0 +1,71 @@
+// controlcommand.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Commands and replies of the control server.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*! A command sent to the control server as a line of words separated by
+ *  spaces; words containing spaces are quoted with ", in which \" and \\
+ *  stand for " and \. A first word starting with @ is an identifier,
+ *  returned with the reply so that clients may match them.
+ *
+ *      @12 goto "Sol/Earth/Moon" 3
+ */
+struct ControlCommand
+{
+    std::string                 id;
+    std::string                 name;
+    std::vector<std::string>    args;
+
+    // Returns false if the line is blank or a quote isn't closed
+    bool parse(std::string_view line);
+};
+
+/*! Writes the JSON text of a reply. Values are added to the innermost
+ *  object or array begun; key() must come before each value of an object.
+ */
+class JsonWriter
+{
+ public:
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+
+    JsonWriter& key(std::string_view k);
+    JsonWriter& value(std::string_view v);
+    JsonWriter& value(const char* v) { return value(std::string_view(v)); }
+    JsonWriter& value(bool v);
+    JsonWriter& value(int v) { return value(static_cast<std::int64_t>(v)); }
+    JsonWriter& value(std::int64_t v);
+    // Infinities and NaN, which JSON can't represent, are written as null
+    JsonWriter& value(double v);
+    JsonWriter& null();
+
+    template<typename T> JsonWriter& member(std::string_view k, T v)
+    {
+        return key(k).value(v);
+    }
+
+    const std::string& str() const { return text; }
+
+ private:
+    void separate();
+
+    std::string text;
+    // Whether the object or array at each depth has no value yet
+    std::vector<bool> empty;
+    bool afterKey{ false };
+};
@@ -0,0 +1,729 @@
+// controlserver.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Control of the simulation by other programs over TCP.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "controlserver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/socket.h>
+#endif
+
+#include <celcompat/charconv.h>
+#include <celcompat/numbers.h>
+#include <celengine/body.h>
+#include <celengine/observer.h>
+#include <celengine/render.h>
+#include <celengine/simulation.h>
+#include <celengine/star.h>
+#include <celengine/stardb.h>
+#include <celengine/universe.h>
+#include <celmath/mathlib.h>
+#include <celutil/logger.h>
+#include "celestiacore.h"
+#include "controlcommand.h"
+#include "url.h"
+
+using namespace celestia::net;
+using celestia::util::GetLogger;
+
+namespace
+{
+
+// A client sending longer lines isn't speaking the protocol
+constexpr std::size_t MaxLineLength = 1 << 16;
+// A client not reading its replies is dropped once this much is pending
+constexpr std::size_t MaxPendingOutput = 1 << 22;
+// Commands applied per client and frame, so that a flood of them doesn't
+// stall the frame; the others wait for the next one
+constexpr int MaxCommandsPerFrame = 256;
+// Input buffered per client; the rest stays with the socket until the
+// commands already received have been applied
+constexpr std::size_t MaxPendingInput = MaxLineLength * MaxCommandsPerFrame;
+// Objects listed by the visible query unless a count is given
+constexpr int DefaultVisibleCount = 100;
+
+struct CommandContext
+{
+    CelestiaCore* appCore;
+    Simulation* sim;
+    const ControlCommand& command;
+    JsonWriter& reply;
+    std::string error;
+};
+
+using CommandHandler = bool (*)(CommandContext&);
+
+bool
+parseNumber(const std::string& s, double& value)
+{
+    const char* last = s.data() + s.size();
+    auto result = celestia::compat::from_chars(s.data(), last, value);
+    return result.ec == std::errc() && result.ptr == last;
+}
+
+// The optional number argument at index, or the default value if missing
+bool
+numberArgument(CommandContext& ctx, std::size_t index, double defaultValue, double& value)
+{
+    if (index >= ctx.command.args.size())
+    {
+        value = defaultValue;
+        return true;
+    }
+    if (parseNumber(ctx.command.args[index], value))
+        return true;
+
+    ctx.error = "Invalid number " + ctx.command.args[index];
+    return false;
+}
+
+bool
+requireArguments(CommandContext& ctx, std::size_t count)
+{
+    if (ctx.command.args.size() >= count)
+        return true;
+
+    ctx.error = "Missing argument";
+    return false;
+}
+
+Selection
+findObject(CommandContext& ctx, const std::string& path)
+{
+    Selection sel = ctx.sim->findObjectFromPath(path, true);
+    if (sel.empty())
+        ctx.error = "Object not found: " + path;
+    return sel;
+}
+
+std::string
+objectPath(const CommandContext& ctx, const Selection& sel)
+{
+    return sel.empty() ? std::string() : Url::decodeString(Url::getEncodedObjectName(sel, ctx.appCore));
+}
+
+const char*
+typeName(Selection::Type type)
+{
+    switch (type)
+    {
+    case Selection::Type_Star:
+        return "star";
+    case Selection::Type_Body:
+        return "body";
+    case Selection::Type_DeepSky:
+        return "deepsky";
+    case Selection::Type_Location:
+        return "location";
+    default:
+        return "none";
+    }
+}
+
+void
+writeVector(JsonWriter& reply, std::string_view key, const Eigen::Vector3d& v)
+{
+    reply.key(key).beginArray().value(v.x()).value(v.y()).value(v.z()).endArray();
+}
+
+// Collects the stars which the renderer would draw in the view
+class VisibleStarCollector : public StarHandler
+{
+ public:
+    explicit VisibleStarCollector(std::vector<std::pair<float, const Star*>>& _stars) : stars(_stars) {}
+
+    void process(const Star& star, float /*distance*/, float appMag) override
+    {
+        stars.emplace_back(appMag, &star);
+    }
+
+ private:
+    std::vector<std::pair<float, const Star*>>& stars;
+};
+
+// Append the visible bodies of the system and of their satellites whose
+// spheres intersect the view cone
+void
+findVisibleBodies(const PlanetarySystem* system,
+                  const UniversalCoord& observerPosition,
+                  const Eigen::Vector3d& viewDirection,
+                  double halfAngle,
+                  double now,
+                  std::vector<std::pair<double, Body*>>& bodies)
+{
+    if (system == nullptr)
+        return;
+
+    for (int i = 0; i < system->getSystemSize(); ++i)
+    {
+        Body* body = system->getBody(i);
+        if (!body->isVisible())
+            continue;
+
+        Eigen::Vector3d offset = body->getPosition(now).offsetFromKm(observerPosition);
+        double distance = offset.norm();
+        double radius = body->getRadius();
+        double angularRadius = distance > radius ? std::asin(radius / distance) : celestia::numbers::pi;
+        double angle = std::acos(std::clamp(offset.dot(viewDirection) / std::max(distance, 1.0e-9), -1.0, 1.0));
+        if (angle <= halfAngle + angularRadius)
+            bodies.emplace_back(distance, body);
+
+        findVisibleBodies(body->getSatellites(), observerPosition, viewDirection, halfAngle, now, bodies);
+    }
+}
+
+
+bool
+selectCommand(CommandContext& ctx)
+{
+    if (!requireArguments(ctx, 1))
+        return false;
+
+    Selection sel = findObject(ctx, ctx.command.args[0]);
+    if (sel.empty())
+        return false;
+
+    ctx.sim->setSelection(sel);
+    return true;
+}
+
+bool
+gotoCommand(CommandContext& ctx)
+{
+    double duration;
+    double distance;
+    if (!requireArguments(ctx, 1)
+        || !numberArgument(ctx, 1, 5.0, duration)
+        || !numberArgument(ctx, 2, 0.0, distance))
+    {
+        return false;
+    }
+
+    Selection sel = findObject(ctx, ctx.command.args[0]);
+    if (sel.empty())
+        return false;
+
+    ctx.sim->setSelection(sel);
+    if (distance > 0.0)
+        ctx.sim->gotoSelection(duration, distance, Eigen::Vector3f::UnitY(), ObserverFrame::ObserverLocal);
+    else
+        ctx.sim->gotoSelection(duration, Eigen::Vector3f::UnitY(), ObserverFrame::ObserverLocal);
+    return true;
+}
+
+bool
+centerCommand(CommandContext& ctx)
+{
+    double duration;
+    if (!numberArgument(ctx, 0, 0.5, duration))
+        return false;
+
+    ctx.sim->centerSelection(duration);
+    return true;
+}
+
+bool
+followCommand(CommandContext& ctx)
+{
+    ctx.sim->follow();
+    return true;
+}
+
+bool
+syncCommand(CommandContext& ctx)
+{
+    ctx.sim->geosynchronousFollow();
+    return true;
+}
+
+bool
+lockCommand(CommandContext& ctx)
+{
+    ctx.sim->phaseLock();
+    return true;
+}
+
+bool
+chaseCommand(CommandContext& ctx)
+{
+    ctx.sim->chase();
+    return true;
+}
+
+bool
+trackCommand(CommandContext& ctx)
+{
+    ctx.sim->setTrackedObject(ctx.sim->getSelection());
+    return true;
+}
+
+bool
+untrackCommand(CommandContext& ctx)
+{
+    ctx.sim->setTrackedObject(Selection());
+    return true;
+}
+
+bool
+cancelCommand(CommandContext& ctx)
+{
+    ctx.sim->cancelMotion();
+    return true;
+}
+
+bool
+timeCommand(CommandContext& ctx)
+{
+    double tdb;
+    if (!numberArgument(ctx, 0, ctx.sim->getTime(), tdb))
+        return false;
+
+    ctx.sim->setTime(tdb);
+    ctx.reply.member("time", ctx.sim->getTime());
+    return true;
+}
+
+bool
+timeScaleCommand(CommandContext& ctx)
+{
+    double scale;
+    if (!requireArguments(ctx, 1) || !numberArgument(ctx, 0, 1.0, scale))
+        return false;
+
+    ctx.sim->setTimeScale(scale);
+    return true;
+}
+
+bool
+pauseCommand(CommandContext& ctx)
+{
+    ctx.sim->setPauseState(true);
+    return true;
+}
+
+bool
+resumeCommand(CommandContext& ctx)
+{
+    ctx.sim->setPauseState(false);
+    return true;
+}
+
+bool
+fovCommand(CommandContext& ctx)
+{
+    double fov;
+    if (!requireArguments(ctx, 1) || !numberArgument(ctx, 0, 45.0, fov))
+        return false;
+    if (fov <= 0.0 || fov >= 180.0)
+    {
+        ctx.error = "Field of view out of range";
+        return false;
+    }
+
+    ctx.sim->getActiveObserver()->setFOV(celmath::degToRad(static_cast<float>(fov)));
+    return true;
+}
+
+bool
+stateCommand(CommandContext& ctx)
+{
+    const Observer& observer = *ctx.sim->getActiveObserver();
+    Eigen::Quaterniond orientation = observer.getOrientation();
+
+    ctx.reply.member("time", ctx.sim->getTime())
+             .member("timeScale", ctx.sim->getTimeScale())
+             .member("paused", ctx.sim->getPauseState())
+             .member("fov", static_cast<double>(celmath::radToDeg(observer.getFOV())));
+    writeVector(ctx.reply, "position", observer.getPosition().toLy());
+    ctx.reply.key("orientation").beginArray()
+             .value(orientation.w()).value(orientation.x()).value(orientation.y()).value(orientation.z())
+             .endArray();
+    ctx.reply.member("selection", objectPath(ctx, ctx.sim->getSelection()))
+             .member("tracked", objectPath(ctx, ctx.sim->getTrackedObject()));
+    return true;
+}
+
+bool
+positionCommand(CommandContext& ctx)
+{
+    if (!requireArguments(ctx, 1))
+        return false;
+
+    double now = ctx.sim->getTime();
+    UniversalCoord observerPosition = ctx.sim->getActiveObserver()->getPosition();
+
+    ctx.reply.key("objects").beginArray();
+    for (const std::string& path : ctx.command.args)
+    {
+        ctx.reply.beginObject().member("path", path);
+        if (Selection sel = ctx.sim->findObjectFromPath(path, true); !sel.empty())
+        {
+            Eigen::Vector3d offset = sel.getPosition(now).offsetFromKm(observerPosition);
+            writeVector(ctx.reply, "position", offset);
+            ctx.reply.member("distance", offset.norm());
+        }
+        else
+        {
+            ctx.reply.key("position").null();
+        }
+        ctx.reply.endObject();
+    }
+    ctx.reply.endArray();
+    return true;
+}
+
+bool
+infoCommand(CommandContext& ctx)
+{
+    if (!requireArguments(ctx, 1))
+        return false;
+
+    double now = ctx.sim->getTime();
+    UniversalCoord observerPosition = ctx.sim->getActiveObserver()->getPosition();
+    const StarDatabase* stars = ctx.sim->getUniverse()->getStarCatalog();
+
+    ctx.reply.key("objects").beginArray();
+    for (const std::string& path : ctx.command.args)
+    {
+        ctx.reply.beginObject().member("path", path);
+        Selection sel = ctx.sim->findObjectFromPath(path, true);
+        ctx.reply.member("type", typeName(sel.getType()));
+        if (!sel.empty())
+        {
+            double distance = sel.getPosition(now).distanceFromKm(observerPosition);
+            ctx.reply.member("name", sel.getType() == Selection::Type_Star
+                                     ? stars->getStarName(*sel.star(), true)
+                                     : sel.getName(true))
+                     .member("radius", sel.radius())
+                     .member("distance", distance);
+            if (sel.getType() == Selection::Type_Star)
+            {
+                auto ly = static_cast<float>(astro::kilometersToLightYears(distance));
+                ctx.reply.member("magnitude", static_cast<double>(sel.star()->getApparentMagnitude(ly)))
+                         .member("absoluteMagnitude", static_cast<double>(sel.star()->getAbsoluteMagnitude()));
+            }
+        }
+        ctx.reply.endObject();
+    }
+    ctx.reply.endArray();
+    return true;
+}
+
+bool
+visibleCommand(CommandContext& ctx)
+{
+    double count;
+    if (!numberArgument(ctx, 0, DefaultVisibleCount, count))
+        return false;
+    auto maxCount = static_cast<std::size_t>(std::max(count, 0.0));
+
+    const Observer& observer = *ctx.sim->getActiveObserver();
+    UniversalCoord observerPosition = observer.getPosition();
+    Eigen::Quaternionf orientation = observer.getOrientationf();
+    float fov = observer.getFOV();
+    float aspectRatio = ctx.appCore->getRenderer()->getAspectRatio();
+    double now = ctx.sim->getTime();
+
+    // The bodies of the nearest system within the cone around the view
+    // holding its corners, nearest first
+    std::vector<std::pair<double, Body*>> bodies;
+    if (const SolarSystem* system = ctx.sim->getNearestSolarSystem(); system != nullptr)
+    {
+        double tanHalfFov = std::tan(0.5 * static_cast<double>(fov));
+        double halfAngle = std::atan(tanHalfFov * std::sqrt(1.0 + static_cast<double>(aspectRatio * aspectRatio)));
+        Eigen::Vector3d viewDirection = (orientation.conjugate() * -Eigen::Vector3f::UnitZ()).cast<double>();
+        findVisibleBodies(system->getPlanets(), observerPosition, viewDirection, halfAngle, now, bodies);
+        std::sort(bodies.begin(), bodies.end(),
+                  [](const auto& b0, const auto& b1) { return b0.first < b1.first; });
+    }
+
+    // The stars in the view frustum bright enough to be drawn, brightest
+    // first
+    std::vector<std::pair<float, const Star*>> stars;
+    VisibleStarCollector collector(stars);
+    ctx.sim->getUniverse()->getStarCatalog()->findVisibleStars(collector,
+                                                               observerPosition.toLy().cast<float>(),
+                                                               orientation,
+                                                               fov,
+                                                               aspectRatio,
+                                                               ctx.sim->getFaintestVisible());
+    std::sort(stars.begin(), stars.end(),
+              [](const auto& s0, const auto& s1) { return s0.first < s1.first; });
+
+    ctx.reply.key("objects").beginArray();
+    std::size_t listed = 0;
+    for (const auto& [distance, body] : bodies)
+    {
+        if (listed++ == maxCount)
+            break;
+        ctx.reply.beginObject()
+                 .member("path", objectPath(ctx, Selection(body)))
+                 .member("type", "body")
+                 .member("distance", distance)
+                 .endObject();
+    }
+    for (const auto& [appMag, star] : stars)
+    {
+        if (listed++ >= maxCount)
+            break;
+        // Found as const by the octree, but selections hold mutable objects
+        Selection sel(const_cast<Star*>(star));
+        ctx.reply.beginObject()
+                 .member("path", objectPath(ctx, sel))
+                 .member("type", "star")
+                 .member("distance", sel.getPosition(now).distanceFromKm(observerPosition))
+                 .member("magnitude", static_cast<double>(appMag))
+                 .endObject();
+    }
+    ctx.reply.endArray();
+    return true;
+}
+
+bool
+pingCommand(CommandContext& /*ctx*/)
+{
+    return true;
+}
+
+struct CommandEntry
+{
+    std::string_view name;
+    CommandHandler handler;
+};
+
+constexpr CommandEntry Commands[] =
+{
+    { "select",     selectCommand },
+    { "goto",       gotoCommand },
+    { "center",     centerCommand },
+    { "follow",     followCommand },
+    { "sync",       syncCommand },
+    { "lock",       lockCommand },
+    { "chase",      chaseCommand },
+    { "track",      trackCommand },
+    { "untrack",    untrackCommand },
+    { "cancel",     cancelCommand },
+    { "time",       timeCommand },
+    { "timescale",  timeScaleCommand },
+    { "pause",      pauseCommand },
+    { "resume",     resumeCommand },
+    { "fov",        fovCommand },
+    { "state",      stateCommand },
+    { "position",   positionCommand },
+    { "info",       infoCommand },
+    { "visible",    visibleCommand },
+    { "ping",       pingCommand },
+};
+
+} // end unnamed namespace
+
+
+struct ControlServer::Client
+{
+    explicit Client(SocketHandle _socket) : socket(_socket) {}
+    ~Client() { closeSocket(socket); }
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    SocketHandle socket;
+    // Received but not yet applied, and replies not yet sent
+    std::string input;
+    std::string output;
+    bool closing{ false };
+};
+
+
+ControlServer::ControlServer(SocketHandle _listener) :
+    listener(_listener)
+{
+}
+
+
+ControlServer::~ControlServer()
+{
+    clients.clear();
+    closeSocket(listener);
+}
+
+
+std::unique_ptr<ControlServer> ControlServer::create(std::uint16_t port, bool allowRemote)
+{
+    if (!initSockets())
+        return nullptr;
+
+    SocketHandle s = listenOn(port, !allowRemote);
+    if (s == InvalidSocket)
+    {
+        GetLogger()->error("Control server can't listen on port {}\n", port);
+        return nullptr;
+    }
+
+    setBlocking(s, false);
+    GetLogger()->info("Control server listening on port {}\n", port);
+    return std::unique_ptr<ControlServer>(new ControlServer(s));
+}
+
+
+void ControlServer::acceptClients()
+{
+    for (;;)
+    {
+        SocketHandle s = accept(listener, nullptr, nullptr);
+        if (s == InvalidSocket)
+            return;
+
+        setBlocking(s, false);
+        setNoDelay(s);
+        clients.push_back(std::make_unique<Client>(s));
+    }
+}
+
+
+// Read the data received, up to MaxPendingInput buffered bytes; returns
+// false once the client is gone
+bool ControlServer::receive(Client& client) const
+{
+    char buffer[4096];
+    while (client.input.size() < MaxPendingInput)
+    {
+        std::size_t length = std::min(sizeof(buffer), MaxPendingInput - client.input.size());
+        auto received = ::recv(client.socket, buffer, static_cast<int>(length), 0);
+        if (received > 0)
+        {
+            client.input.append(buffer, static_cast<std::size_t>(received));
+            continue;
+        }
+        return received < 0 && wouldBlock();
+    }
+
+    return true;
+}
+
+
+// Send as much of the replies as the connection takes without waiting;
+// returns false once the client is gone
+bool ControlServer::send(Client& client) const
+{
+    std::size_t sent = 0;
+    while (sent < client.output.size())
+    {
+        auto n = ::send(client.socket,
+                        client.output.data() + sent,
+                        static_cast<int>(client.output.size() - sent),
+                        sendFlags());
+        if (n <= 0)
+        {
+            if (n < 0 && wouldBlock())
+                break;
+            return false;
+        }
+        sent += static_cast<std::size_t>(n);
+    }
+
+    client.output.erase(0, sent);
+    return client.output.size() <= MaxPendingOutput;
+}
+
+
+void ControlServer::execute(CelestiaCore* appCore, Client& client, const ControlCommand& command) const
+{
+    JsonWriter reply;
+    reply.beginObject();
+    if (!command.id.empty())
+        reply.member("id", command.id);
+
+    bool ok = false;
+    std::string error;
+    if (command.name == "close")
+    {
+        client.closing = true;
+        ok = true;
+    }
+    else if (auto it = std::find_if(std::begin(Commands), std::end(Commands),
+                                    [&command](const CommandEntry& entry) { return entry.name == command.name; });
+             it != std::end(Commands))
+    {
+        // Handlers only write values once they can't fail
+        CommandContext ctx{ appCore, appCore->getSimulation(), command, reply, {} };
+        ok = it->handler(ctx);
+        error = std::move(ctx.error);
+    }
+    else
+    {
+        error = "Unknown command " + command.name;
+    }
+
+    reply.member("ok", ok);
+    if (!ok)
+        reply.member("error", error);
+    reply.endObject();
+    client.output += reply.str();
+    client.output += '\n';
+}
+
+
+void ControlServer::processCommands(CelestiaCore* appCore)
+{
+    acceptClients();
+
+    for (auto it = clients.begin(); it != clients.end();)
+    {
+        Client& client = **it;
+        bool connected = receive(client);
+
+        std::size_t start = 0;
+        for (int n = 0; n < MaxCommandsPerFrame && !client.closing; ++n)
+        {
+            std::size_t end = client.input.find('\n', start);
+            if (end == std::string::npos)
+                break;
+            if (end - start > MaxLineLength)
+            {
+                connected = false;
+                break;
+            }
+
+            ControlCommand command;
+            std::string_view line(client.input.data() + start, end - start);
+            if (command.parse(line))
+            {
+                execute(appCore, client, command);
+            }
+            else if (line.find_first_not_of(" \t\r") != std::string_view::npos)
+            {
+                JsonWriter reply;
+                reply.beginObject().member("ok", false).member("error", "Unbalanced quotes").endObject();
+                client.output += reply.str();
+                client.output += '\n';
+            }
+            start = end + 1;
+        }
+        client.input.erase(0, start);
+
+        if (client.input.size() > MaxLineLength && client.input.find('\n') == std::string::npos)
+            connected = false;
+        if (!send(client) || (client.closing && client.output.empty()))
+            connected = false;
+
+        if (connected)
+            ++it;
+        else
+            it = clients.erase(it);
+    }
+}
@@ -0,0 +1,66 @@
+// controlserver.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Control of the simulation by other programs over TCP.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "netsocket.h"
+
+class CelestiaCore;
+struct ControlCommand;
+class JsonWriter;
+
+/*! ControlServer lets another program, e.g. a show control system, drive
+ *  the simulation without writing scripts. Clients connect over TCP and
+ *  send commands as lines of text (see ControlCommand); each is answered
+ *  by a line holding a JSON object, with "ok" false and an "error" if it
+ *  failed. The commands map onto those of the simulation and observer,
+ *  and queries return the state of many objects at once:
+ *
+ *  - select PATH, goto PATH [SECONDS [KM]], center [SECONDS], follow,
+ *    sync, lock, chase, track, untrack, cancel
+ *  - time [JD], timescale SCALE, pause, resume, fov DEGREES
+ *  - state, position PATH..., info PATH..., visible [COUNT], ping, close
+ *
+ *  The server never waits: the commands received are applied between the
+ *  ticks of the simulation, so that they take effect in the next frame,
+ *  and the queries are answered from the state that frame is drawn with.
+ */
+class ControlServer
+{
+ public:
+    ~ControlServer();
+
+    // Listen on the port of the loopback interface only, unless remote
+    // clients are allowed
+    static std::unique_ptr<ControlServer> create(std::uint16_t port, bool allowRemote);
+
+    // Accept the clients connecting, then apply the commands received
+    // since the last call and send their replies
+    void processCommands(CelestiaCore* appCore);
+
+ private:
+    struct Client;
+
+    explicit ControlServer(celestia::net::SocketHandle _listener);
+
+    void acceptClients();
+    bool receive(Client& client) const;
+    bool send(Client& client) const;
+    void execute(CelestiaCore* appCore, Client& client, const ControlCommand& command) const;
+
+    celestia::net::SocketHandle listener;
+    std::vector<std::unique_ptr<Client>> clients;
+};
@@ -0,0 +1,198 @@
+// eventfinder.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Finds transits, occultations and close approaches between objects.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "eventfinder.h"
+
+#include <cmath>
+
+#include <Eigen/Geometry>
+
+#include "eventsearch.h"
+
+using namespace Eigen;
+
+namespace
+{
+
+constexpr double DefaultSearchStep = 1.0 / 24.0; // one hour
+
+// Angle between the directions to a and b
+double
+getSeparation(const Vector3d& a, const Vector3d& b)
+{
+    return std::atan2(a.cross(b).norm(), a.dot(b));
+}
+
+// Angular radius of a sphere at a distance larger than its radius
+double
+getAngularRadius(double radius, double distance)
+{
+    return std::asin(radius / distance);
+}
+
+struct PendingEvent
+{
+    CelestialEvent::Type type;
+    Selection observer;
+    Selection object;
+    Selection target;
+    double distance;
+};
+
+} // end unnamed namespace
+
+
+CelestialEventFinder::CelestialEventFinder(EventSearchWatcher* _watcher) :
+    watcher(_watcher),
+    searchStep(DefaultSearchStep)
+{
+}
+
+
+void
+CelestialEventFinder::addOccultations(const Selection& observer,
+                                      const std::vector<Selection>& objects,
+                                      const std::vector<Selection>& targets)
+{
+    occultations.push_back({ observer, objects, targets });
+}
+
+
+void
+CelestialEventFinder::addCloseApproaches(const std::vector<Selection>& objects,
+                                         const std::vector<Selection>& targets,
+                                         double distance)
+{
+    approaches.push_back({ objects, targets, distance });
+}
+
+
+/*! All the requests are searched at once, so the positions of objects in
+ *  several of them are only computed once per step.
+ */
+void
+CelestialEventFinder::findEvents(double startDate,
+                                 double endDate,
+                                 std::vector<CelestialEvent>& events) const
+{
+    Selection first;
+    if (!occultations.empty())
+        first = occultations.front().observer;
+    else if (!approaches.empty() && !approaches.front().objects.empty())
+        first = approaches.front().objects.front();
+    if (first.empty())
+        return;
+
+    EventSearch search(first.getPosition(startDate));
+    search.setSearchStep(searchStep);
+    std::vector<PendingEvent> pending;
+
+    for (const auto& request : occultations)
+    {
+        std::size_t o = search.track(request.observer);
+        for (const Selection& object : request.objects)
+        {
+            if (object.empty() || object == request.observer)
+                continue;
+
+            std::size_t a = search.track(object);
+            double objectRadius = object.radius();
+            for (const Selection& target : request.targets)
+            {
+                if (target.empty() || target == object || target == request.observer)
+                    continue;
+
+                // The object may be in front of the target, or behind it;
+                // the events are only looked for while it's in front.
+                std::size_t b = search.track(target);
+                double targetRadius = target.radius();
+                search.addCondition([=](const Vector3d* positions)
+                {
+                    Vector3d toObject = positions[a] - positions[o];
+                    Vector3d toTarget = positions[b] - positions[o];
+                    double objectDistance = toObject.norm();
+                    double targetDistance = toTarget.norm();
+                    if (objectDistance >= targetDistance ||
+                        objectDistance <= objectRadius ||
+                        targetDistance <= targetRadius)
+                    {
+                        return EventSearch::NotNear;
+                    }
+
+                    return getSeparation(toObject, toTarget) -
+                           getAngularRadius(objectRadius, objectDistance) -
+                           getAngularRadius(targetRadius, targetDistance);
+                });
+                pending.push_back({ CelestialEvent::Occultation, request.observer, object, target, 0.0 });
+            }
+        }
+    }
+
+    for (const auto& request : approaches)
+    {
+        for (const Selection& object : request.objects)
+        {
+            if (object.empty())
+                continue;
+
+            std::size_t a = search.track(object);
+            for (const Selection& target : request.targets)
+            {
+                if (target.empty() || target == object)
+                    continue;
+
+                std::size_t b = search.track(target);
+                double distance = request.distance;
+                search.addCondition([=](const Vector3d* positions)
+                {
+                    return (positions[a] - positions[b]).norm() - distance;
+                });
+                pending.push_back({ CelestialEvent::CloseApproach, Selection(), object, target, distance });
+            }
+        }
+    }
+
+    std::vector<EventSearch::Span> spans;
+    search.find(startDate, endDate, watcher, spans);
+
+    for (const auto& span : spans)
+    {
+        const PendingEvent& p = pending[span.condition];
+
+        CelestialEvent event;
+        event.type = p.type;
+        event.object = p.object;
+        event.target = p.target;
+        event.observer = p.observer;
+        event.startTime = span.startTime;
+        event.endTime = span.endTime;
+        event.extremeTime = span.extremeTime;
+
+        if (p.type == CelestialEvent::CloseApproach)
+        {
+            event.separation = span.extremeValue + p.distance;
+        }
+        else
+        {
+            // Transits and occultations are told apart by the apparent sizes
+            // of the objects at the middle of the event.
+            UniversalCoord observerPosition = p.observer.getPosition(span.extremeTime);
+            Vector3d toObject = p.object.getPosition(span.extremeTime).offsetFromKm(observerPosition);
+            Vector3d toTarget = p.target.getPosition(span.extremeTime).offsetFromKm(observerPosition);
+            double objectSize = getAngularRadius(p.object.radius(), toObject.norm());
+            double targetSize = getAngularRadius(p.target.radius(), toTarget.norm());
+            event.type = objectSize < targetSize ? CelestialEvent::Transit : CelestialEvent::Occultation;
+            event.separation = getSeparation(toObject, toTarget);
+        }
+
+        events.push_back(event);
+    }
+}
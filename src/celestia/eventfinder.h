@@ -0,0 +1,98 @@
+// eventfinder.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Finds transits, occultations and close approaches between objects.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <vector>
+
+#include <celengine/selection.h>
+
+class EventSearchWatcher;
+
+struct CelestialEvent
+{
+    enum Type
+    {
+        // A nearer object crossing the disk of a larger one
+        Transit       = 0x01,
+        // A nearer object hiding a smaller one, or a star
+        Occultation   = 0x02,
+        // Two objects coming within a distance of each other
+        CloseApproach = 0x04,
+    };
+
+    Type type{ Transit };
+
+    // For transits and occultations the object is in front of the target
+    Selection object;
+    Selection target;
+    Selection observer;
+
+    double startTime{ 0.0 };
+    double endTime{ 0.0 };
+
+    // Time of the smallest separation, and the separation: an angle in
+    // radians between the centers for transits and occultations, a
+    // distance in km for close approaches.
+    double extremeTime{ 0.0 };
+    double separation{ 0.0 };
+};
+
+/*! Collects event searches between objects, and runs them all in one pass
+ *  over time. Positions are geometric: light time and aberration are
+ *  ignored, and observers are at the center of the observing object.
+ */
+class CelestialEventFinder
+{
+ public:
+    explicit CelestialEventFinder(EventSearchWatcher* _watcher = nullptr);
+
+    // Transits and occultations of the targets by the objects, as seen
+    // from the observer
+    void addOccultations(const Selection& observer,
+                         const std::vector<Selection>& objects,
+                         const std::vector<Selection>& targets);
+
+    // Times when any of the objects is within the distance in km of any of
+    // the targets
+    void addCloseApproaches(const std::vector<Selection>& objects,
+                            const std::vector<Selection>& targets,
+                            double distance);
+
+    // Distance in days between the times tested; events shorter than that
+    // are found if they come near enough to a tested time. The default is
+    // one hour.
+    void setSearchStep(double step) { searchStep = step; }
+
+    // Append the events found between startDate and endDate, sorted by their
+    // start time
+    void findEvents(double startDate, double endDate, std::vector<CelestialEvent>& events) const;
+
+ private:
+    struct OccultationRequest
+    {
+        Selection observer;
+        std::vector<Selection> objects;
+        std::vector<Selection> targets;
+    };
+
+    struct ApproachRequest
+    {
+        std::vector<Selection> objects;
+        std::vector<Selection> targets;
+        double distance;
+    };
+
+    EventSearchWatcher* watcher;
+    double searchStep;
+    std::vector<OccultationRequest> occultations;
+    std::vector<ApproachRequest> approaches;
+};
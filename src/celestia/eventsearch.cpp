@@ -0,0 +1,472 @@
+// eventsearch.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Searches for the times when a condition on the positions of a set of
+// objects holds, on several threads.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "eventsearch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#include <Eigen/Geometry>
+
+#include <celengine/body.h>
+#include <celengine/frame.h>
+#include <celengine/star.h>
+#include <celengine/timeline.h>
+#include <celengine/timelinephase.h>
+
+using namespace Eigen;
+
+namespace
+{
+
+constexpr double DefaultSearchStep = 1.0 / 24.0; // one hour
+constexpr double DefaultPrecision = 1.0 / (24.0 * 60.0); // one minute
+
+// Steps searched at once by a thread
+constexpr std::int64_t BlockSteps = 256;
+// Steps on either side of a block over which spans found in the block are
+// followed; a span running on beyond that is joined to the part found by
+// the next block.
+constexpr std::int64_t BlockMargin = 48;
+// Blocks searched by each thread between progress updates
+constexpr std::int64_t BlocksPerUpdate = 4;
+
+constexpr std::size_t NodesPerBlock = BlockSteps + 2 * BlockMargin + 1;
+constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+} // end unnamed namespace
+
+
+struct EventSearch::Block
+{
+    double startDate;
+    std::int64_t firstStep;
+    std::int64_t nSteps;
+    // Positions of the objects which can't be computed on other threads,
+    // from BlockMargin steps before the block to BlockMargin steps after
+    std::vector<Vector3d> nodes;
+    std::vector<Span> spans;
+};
+
+
+EventSearch::EventSearch(const UniversalCoord& _origin) :
+    origin(_origin),
+    searchStep(DefaultSearchStep),
+    precision(DefaultPrecision)
+{
+}
+
+
+std::size_t
+EventSearch::track(const Selection& object)
+{
+    auto it = std::find(objects.begin(), objects.end(), object);
+    if (it != objects.end())
+        return static_cast<std::size_t>(it - objects.begin());
+
+    if (object.getType() == Selection::Type_Body)
+        bodyIndices.emplace(object.body(), objects.size());
+    objects.push_back(object);
+    return objects.size() - 1;
+}
+
+
+std::size_t
+EventSearch::addCondition(Condition&& condition)
+{
+    conditions.push_back(std::move(condition));
+    return conditions.size() - 1;
+}
+
+
+double
+EventSearch::getTime(const Block& block, std::int64_t step) const
+{
+    return block.startDate + static_cast<double>(step) * searchStep;
+}
+
+
+// Return true if the body's position may be computed from several threads
+// at once; the positions of tracked bodies it's relative to are taken from
+// the search.
+bool
+EventSearch::isPositionThreadSafe(const Body* body) const
+{
+    const Timeline* timeline = body->getTimeline();
+    for (unsigned int i = 0; i < timeline->phaseCount(); i++)
+    {
+        const auto& phase = timeline->getPhase(i);
+        if (!phase->orbit()->isThreadSafe() ||
+            !phase->orbitFrame()->isThreadSafe() ||
+            !isCenterThreadSafe(phase->orbitFrame()->getCenter()))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+bool
+EventSearch::isCenterThreadSafe(const Selection& center) const
+{
+    switch (center.getType())
+    {
+    case Selection::Type_Star:
+        return IsPositionThreadSafe(center);
+    case Selection::Type_Body:
+        return bodyIndices.count(center.body()) != 0 || isPositionThreadSafe(center.body());
+    default:
+        return false;
+    }
+}
+
+
+void
+EventSearch::prepareBlock(Block& block) const
+{
+    block.nodes.resize(nInterpolated * NodesPerBlock);
+    for (std::size_t i = 0; i < objects.size(); i++)
+    {
+        if (slots[i] == npos)
+            continue;
+
+        Vector3d* nodes = block.nodes.data() + slots[i] * NodesPerBlock;
+        for (std::int64_t n = 0; n < static_cast<std::int64_t>(NodesPerBlock); n++)
+        {
+            double t = getTime(block, block.firstStep - BlockMargin + n);
+            nodes[n] = objects[i].getPosition(t).offsetFromKm(origin);
+        }
+    }
+}
+
+
+// Cubic through the four nodes around t
+Vector3d
+EventSearch::interpolate(std::size_t slot, double t, const Block& block) const
+{
+    const Vector3d* nodes = block.nodes.data() + slot * NodesPerBlock;
+    double x = (t - getTime(block, block.firstStep - BlockMargin)) / searchStep;
+    auto n = static_cast<std::int64_t>(std::floor(x));
+    n = std::clamp<std::int64_t>(n, 1, static_cast<std::int64_t>(NodesPerBlock) - 3);
+    double u = x - static_cast<double>(n);
+
+    double w0 = -u * (u - 1.0) * (u - 2.0) / 6.0;
+    double w1 = (u + 1.0) * (u - 1.0) * (u - 2.0) / 2.0;
+    double w2 = -(u + 1.0) * u * (u - 2.0) / 2.0;
+    double w3 = (u + 1.0) * u * (u - 1.0) / 6.0;
+    return w0 * nodes[n - 1] + w1 * nodes[n] + w2 * nodes[n + 1] + w3 * nodes[n + 2];
+}
+
+
+Vector3d
+EventSearch::getPosition(std::size_t i, double t, const Block& block) const
+{
+    if (slots[i] != npos)
+        return interpolate(slots[i], t, block);
+
+    const Selection& object = objects[i];
+    if (object.getType() == Selection::Type_Star)
+        return object.star()->getPosition(t).offsetFromKm(origin);
+    return getBodyPosition(object.body(), t, block);
+}
+
+
+// Same as Body::getPosition, with the positions of the tracked bodies taken
+// from the search
+Vector3d
+EventSearch::getBodyPosition(const Body* body, double t, const Block& block) const
+{
+    const auto& phase = body->getTimeline()->findPhase(t);
+    Vector3d p = phase->orbitFrame()->getOrientation(t).conjugate() * phase->orbit()->positionAtTime(t);
+
+    Selection center = phase->orbitFrame()->getCenter();
+    if (center.getType() == Selection::Type_Body)
+    {
+        auto it = bodyIndices.find(center.body());
+        return p + (it != bodyIndices.end()
+                    ? getPosition(it->second, t, block)
+                    : getBodyPosition(center.body(), t, block));
+    }
+
+    return p + center.star()->getPosition(t).offsetFromKm(origin);
+}
+
+
+double
+EventSearch::evaluate(std::size_t condition, double t, const Block& block) const
+{
+    std::vector<Vector3d> positions(objects.size());
+    for (std::size_t i = 0; i < objects.size(); i++)
+        positions[i] = getPosition(i, t, block);
+    return conditions[condition](positions.data());
+}
+
+
+// Given a time when the condition holds, find the first time when it
+// doesn't, which is at most the precision away from the end of the span.
+double
+EventSearch::findSpanEnd(std::size_t condition, double t, double direction, const Block& block) const
+{
+    double limit = direction > 0.0
+        ? getTime(block, block.firstStep + block.nSteps - 1 + BlockMargin)
+        : getTime(block, block.firstStep - BlockMargin);
+
+    // Step out of the span, then halve the interval to the last time inside
+    // it until it's within the precision.
+    double inside = t;
+    double outside = t + direction * searchStep;
+    while (evaluate(condition, outside, block) < 0.0)
+    {
+        if ((outside - limit) * direction >= 0.0)
+            return limit;
+        inside = outside;
+        outside += direction * searchStep;
+    }
+
+    while (std::abs(outside - inside) > precision)
+    {
+        double mid = 0.5 * (inside + outside);
+        if (evaluate(condition, mid, block) < 0.0)
+            inside = mid;
+        else
+            outside = mid;
+    }
+
+    return outside;
+}
+
+
+namespace
+{
+
+// Golden section search for the smallest value of f over [a, b], stopping
+// early when stop returns true for a value found
+template<typename F, typename S>
+std::pair<double, double>
+minimize(F f, double a, double b, double precision, S stop)
+{
+    constexpr double InvPhi = 0.6180339887498949;
+    double c = b - InvPhi * (b - a);
+    double d = a + InvPhi * (b - a);
+    double fc = f(c);
+    double fd = f(d);
+    while (b - a > precision && !stop(fc) && !stop(fd))
+    {
+        if (fc < fd)
+        {
+            b = d;
+            d = c;
+            fd = fc;
+            c = b - InvPhi * (b - a);
+            fc = f(c);
+        }
+        else
+        {
+            a = c;
+            c = d;
+            fc = fd;
+            d = a + InvPhi * (b - a);
+            fd = f(d);
+        }
+    }
+
+    return fc < fd ? std::make_pair(c, fc) : std::make_pair(d, fd);
+}
+
+} // end unnamed namespace
+
+
+// Look for a span shorter than a step around a near miss at t
+bool
+EventSearch::findShortSpan(std::size_t condition, double t, const Block& block, double& spanTime) const
+{
+    auto f = [&](double x) { return evaluate(condition, x, block); };
+    auto [time, value] = minimize(f, t - searchStep, t + searchStep, precision,
+                                  [](double x) { return x < 0.0; });
+    spanTime = time;
+    return value < 0.0;
+}
+
+
+void
+EventSearch::findExtreme(std::size_t condition, const Block& block, Span& span) const
+{
+    auto f = [&](double x) { return evaluate(condition, x, block); };
+    std::tie(span.extremeTime, span.extremeValue) =
+        minimize(f, span.startTime, span.endTime, precision, [](double) { return false; });
+}
+
+
+void
+EventSearch::searchBlock(Block& block) const
+{
+    // Positions at the steps of the block and the ones on either side
+    std::int64_t nNodes = block.nSteps + 2;
+    std::vector<Vector3d> positions(objects.size() * nNodes);
+    for (std::int64_t n = 0; n < nNodes; n++)
+    {
+        double t = getTime(block, block.firstStep - 1 + n);
+        for (std::size_t i = 0; i < objects.size(); i++)
+            positions[n * objects.size() + i] = getPosition(i, t, block);
+    }
+
+    std::vector<double> values(nNodes);
+    for (std::size_t condition = 0; condition < conditions.size(); condition++)
+    {
+        for (std::int64_t n = 0; n < nNodes; n++)
+            values[n] = conditions[condition](positions.data() + n * objects.size());
+
+        double previousEnd = -std::numeric_limits<double>::infinity();
+        for (std::int64_t n = 1; n <= block.nSteps; n++)
+        {
+            double t = getTime(block, block.firstStep - 1 + n);
+            if (t <= previousEnd)
+                continue;
+
+            // Spans are either found at a step, or shorter ones around steps
+            // where the condition comes closer to holding than at the ones
+            // before and after, by less than the change from them.
+            double spanTime = t;
+            double f = values[n];
+            if (f >= 0.0)
+            {
+                double before = values[n - 1];
+                double after = values[n + 1];
+                if (f == NotNear || before == NotNear || after == NotNear ||
+                    f > before || f > after || f >= std::max(before - f, after - f) ||
+                    !findShortSpan(condition, t, block, spanTime))
+                {
+                    continue;
+                }
+            }
+
+            Span span;
+            span.condition = condition;
+            span.startTime = findSpanEnd(condition, spanTime, -1.0, block);
+            span.endTime = findSpanEnd(condition, spanTime, 1.0, block);
+            findExtreme(condition, block, span);
+            block.spans.push_back(span);
+
+            previousEnd = span.endTime;
+        }
+    }
+}
+
+
+void
+EventSearch::find(double startDate, double endDate, EventSearchWatcher* watcher, std::vector<Span>& spans)
+{
+    if (conditions.empty() || endDate < startDate)
+        return;
+
+    slots.clear();
+    nInterpolated = 0;
+    for (const Selection& object : objects)
+    {
+        bool threadSafe = object.getType() == Selection::Type_Body
+            ? isPositionThreadSafe(object.body())
+            : isCenterThreadSafe(object);
+        slots.push_back(threadSafe ? npos : nInterpolated++);
+    }
+
+    auto nSteps = static_cast<std::int64_t>(std::floor((endDate - startDate) / searchStep)) + 1;
+    std::int64_t nBlocks = (nSteps + BlockSteps - 1) / BlockSteps;
+
+    unsigned int nThreads = nInterpolated < objects.size()
+        ? std::max(1u, std::thread::hardware_concurrency())
+        : 1u;
+    std::int64_t blocksPerUpdate = static_cast<std::int64_t>(nThreads) * BlocksPerUpdate;
+
+    std::vector<Span> found;
+    std::vector<Block> blocks;
+    for (std::int64_t firstBlock = 0; firstBlock < nBlocks; firstBlock += blocksPerUpdate)
+    {
+        blocks.resize(static_cast<std::size_t>(std::min(blocksPerUpdate, nBlocks - firstBlock)));
+        for (std::size_t i = 0; i < blocks.size(); i++)
+        {
+            Block& block = blocks[i];
+            block.startDate = startDate;
+            block.firstStep = (firstBlock + static_cast<std::int64_t>(i)) * BlockSteps;
+            block.nSteps = std::min(BlockSteps, nSteps - block.firstStep);
+            block.spans.clear();
+            prepareBlock(block);
+        }
+
+        std::atomic<std::size_t> nextBlock{ 0 };
+        auto worker = [&]()
+        {
+            for (;;)
+            {
+                std::size_t n = nextBlock.fetch_add(1, std::memory_order_relaxed);
+                if (n >= blocks.size())
+                    break;
+                searchBlock(blocks[n]);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned int i = 1; i < std::min<std::size_t>(nThreads, blocks.size()); i++)
+            workers.emplace_back(worker);
+        worker();
+        for (auto& thread : workers)
+            thread.join();
+
+        for (const Block& block : blocks)
+            found.insert(found.end(), block.spans.begin(), block.spans.end());
+
+        if (watcher != nullptr)
+        {
+            const Block& last = blocks.back();
+            double t = getTime(last, last.firstStep + last.nSteps - 1);
+            if (watcher->eventSearchProgressUpdate(t) == EventSearchWatcher::AbortOperation)
+                break;
+        }
+    }
+
+    // Join the parts of spans found by several blocks
+    std::sort(found.begin(), found.end(),
+              [](const Span& a, const Span& b)
+              {
+                  return std::tie(a.condition, a.startTime) < std::tie(b.condition, b.startTime);
+              });
+
+    std::vector<Span> merged;
+    for (const Span& span : found)
+    {
+        if (!merged.empty() &&
+            merged.back().condition == span.condition &&
+            merged.back().endTime >= span.startTime)
+        {
+            Span& last = merged.back();
+            last.endTime = std::max(last.endTime, span.endTime);
+            if (span.extremeValue < last.extremeValue)
+            {
+                last.extremeTime = span.extremeTime;
+                last.extremeValue = span.extremeValue;
+            }
+        }
+        else
+        {
+            merged.push_back(span);
+        }
+    }
+
+    std::sort(merged.begin(), merged.end(),
+              [](const Span& a, const Span& b) { return a.startTime < b.startTime; });
+    spans.insert(spans.end(), merged.begin(), merged.end());
+}
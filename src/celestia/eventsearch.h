@@ -0,0 +1,127 @@
+// eventsearch.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Searches for the times when a condition on the positions of a set of
+// objects holds, on several threads.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celengine/selection.h>
+#include <celengine/univcoord.h>
+
+class Body;
+class Star;
+
+class EventSearchWatcher
+{
+ public:
+    enum Status
+    {
+        ContinueOperation = 0,
+        AbortOperation = 1,
+    };
+
+    virtual Status eventSearchProgressUpdate(double t) = 0;
+    virtual ~EventSearchWatcher() = default;
+};
+
+/*! Finds the time spans over which conditions on the positions of objects
+ *  hold. The conditions are tested a step apart, and the spans found are
+ *  narrowed down to a given precision; a condition which holds for less
+ *  than a step is found if it comes near enough to holding at a step.
+ *
+ *  The interval is cut into blocks searched by several threads at once.
+ *  Positions which can't be computed from other threads, like the
+ *  scripted orbits, are computed from the calling thread at the steps of
+ *  each block and interpolated between them.
+ */
+class EventSearch
+{
+ public:
+    // Negative while the condition holds, given the positions of the
+    // tracked objects relative to the origin, in km. Called from several
+    // threads at once.
+    using Condition = std::function<double(const Eigen::Vector3d* positions)>;
+
+    // Returned by conditions which are far from holding: no short span is
+    // looked for around the times they return it for.
+    static constexpr double NotNear = std::numeric_limits<double>::infinity();
+
+    struct Span
+    {
+        // Index of the condition
+        std::size_t condition;
+        double startTime;
+        double endTime;
+        // Time and value of the smallest value of the condition
+        double extremeTime;
+        double extremeValue;
+    };
+
+    explicit EventSearch(const UniversalCoord& _origin);
+
+    // Return the index of the object's position in the positions passed to
+    // the conditions
+    std::size_t track(const Selection& object);
+    std::size_t addCondition(Condition&& condition);
+
+    // Distance in days between the times tested, and the precision of the
+    // ends of the spans found
+    void setSearchStep(double step) { searchStep = step; }
+    void setPrecision(double _precision) { precision = _precision; }
+
+    bool empty() const { return conditions.empty(); }
+
+    // Append the spans found between startDate and endDate, sorted by their
+    // start. If the watcher aborts the search, the spans found until then
+    // are returned.
+    void find(double startDate, double endDate, EventSearchWatcher* watcher, std::vector<Span>& spans);
+
+ private:
+    struct Block;
+
+    double getTime(const Block& block, std::int64_t step) const;
+
+    bool isPositionThreadSafe(const Body* body) const;
+    bool isCenterThreadSafe(const Selection& center) const;
+
+    void prepareBlock(Block& block) const;
+    void searchBlock(Block& block) const;
+
+    Eigen::Vector3d getPosition(std::size_t i, double t, const Block& block) const;
+    Eigen::Vector3d getBodyPosition(const Body* body, double t, const Block& block) const;
+    Eigen::Vector3d interpolate(std::size_t slot, double t, const Block& block) const;
+    double evaluate(std::size_t condition, double t, const Block& block) const;
+
+    double findSpanEnd(std::size_t condition, double t, double direction, const Block& block) const;
+    bool findShortSpan(std::size_t condition, double t, const Block& block, double& spanTime) const;
+    void findExtreme(std::size_t condition, const Block& block, Span& span) const;
+
+    UniversalCoord origin;
+    double searchStep;
+    double precision;
+
+    std::vector<Selection> objects;
+    std::unordered_map<const Body*, std::size_t> bodyIndices;
+    std::vector<Condition> conditions;
+
+    // Index of each object in the interpolated positions of the blocks, or
+    // npos if its position may be computed from any thread; set by find().
+    std::vector<std::size_t> slots;
+    std::size_t nInterpolated{ 0 };
+};
@@ -7,22 +7,47 @@ extern "C"
 {
 #include <libavcodec/avcodec.h>
 #include <libavutil/timestamp.h>
+#include <libavutil/hwcontext.h>
 #include <libavutil/pixdesc.h>
 #include <libavutil/opt.h>
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 }
 
+#include <condition_variable>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <fmt/format.h>
 
+#include <celengine/framereadback.h>
 #include <celengine/pixelformat.h>
 #include <celengine/render.h>
 
 using namespace std;
 using namespace celestia;
 
+namespace
+{
+// frames are mapped this many frames after they were read back, when the
+// GPU has finished with them
+constexpr std::size_t ReadbackLatency = 2;
+// and at most this many mapped frames wait for the encoding thread, which
+// the render thread waits for when they're all in use
+constexpr std::size_t MaxQueuedFrames = 3;
+
+// a mapped frame, given by its top row
+struct QueuedFrame
+{
+    const uint8_t  *top;
+    std::ptrdiff_t stride;
+};
+}
+
 // a wrapper around a single output AVStream
 class FFMPEGCapturePrivate
 {
@@ -33,7 +58,13 @@ class FFMPEGCapturePrivate
     bool addStream(int w, int h, float fps);
     bool openVideo();
     bool start();
+    bool initHardwareFrames();
     bool writeVideoFrame(bool = false);
+    bool queueReadFrames(std::size_t latency);
+    bool releaseEncodedFrames(bool wait);
+    void encodeQueuedFrames();
+    bool fillFrame(const uint8_t* top, std::ptrdiff_t stride);
+    bool encodeFrame(AVFrame*);
     void finish();
     void setVideoCodec(int);
 
@@ -49,21 +80,43 @@ class FFMPEGCapturePrivate
     const AVCodec   *vc       { nullptr };
     AVPacket        *pkt      { nullptr };
     SwsContext      *swsc     { nullptr };
+    // device and frame uploaded to for hardware encoders which need it
+    AVBufferRef     *hwDevice { nullptr };
+    AVFrame         *hwfr     { nullptr };
 
     const Renderer  *renderer { nullptr };
+    // frames are read back through pixel pack buffers when supported, and
+    // then encoded on their own thread
+    std::unique_ptr<FrameReadback> readback;
+    std::thread             encoder;
+    std::mutex              queueMutex;
+    std::condition_variable queueCondition;
+    std::condition_variable encodedCondition;
+    // frames being encoded or waiting for it
+    std::deque<QueuedFrame> queue;
+    // frames encoded and not yet released by the render thread
+    std::size_t             encodedFrames  { 0     };
+    bool                    stopEncoding   { false };
+    bool                    encodingFailed { false };
 
     // pts of the next frame that will be generated
     int64_t         nextPts   { 0       };
+    // frames captured, including those not encoded yet
+    int64_t         capturedFrames { 0  };
     // requested bitrate
     int64_t         bit_rate  { 400000  };
 
     AVCodecID       vc_id     { AV_CODEC_ID_FFVHUFF };
     AVPixelFormat   format    { AV_PIX_FMT_NONE     };
+    // format of the frames converted to for the encoder, which differs from
+    // the codec's for frames uploaded to the hardware
+    AVPixelFormat   swFormat  { AV_PIX_FMT_NONE     };
     float           fps       { 0       };
     bool            capturing { false   };
     bool            hasAlpha  { false   };
 
     fs::path        filename;
+    std::string     vc_name;
     std::string     vc_options;
 
  public:
@@ -209,8 +262,20 @@ bool FFMPEGCapturePrivate::addStream(int width, int height, float fps)
 {
     this->fps = fps;
 
-    // find the encoder
-    vc = avcodec_find_encoder(vc_id);
+    // find the encoder, preferring the one given by name, e.g. a hardware
+    // encoder, if it's available and for the right codec
+    if (!vc_name.empty())
+    {
+        vc = avcodec_find_encoder_by_name(vc_name.c_str());
+        if (vc == nullptr || vc->id != vc_id)
+        {
+            fmt::print("Video encoder {} isn't available, using the default one\n", vc_name);
+            vc = nullptr;
+        }
+    }
+
+    if (vc == nullptr)
+        vc = avcodec_find_encoder(vc_id);
     if (vc == nullptr)
     {
         cout << "Video codec isn't found\n";
@@ -274,6 +339,13 @@ bool FFMPEGCapturePrivate::addStream(int width, int height, float fps)
             avcodec_default_get_format(enc, &(enc->pix_fmt));
     }
 
+    // hardware encoders which only take frames in video memory get them
+    // uploaded from frames converted to NV12
+    swFormat = enc->pix_fmt;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(enc->pix_fmt);
+    if (desc != nullptr && (desc->flags & AV_PIX_FMT_FLAG_HWACCEL) != 0 && !initHardwareFrames())
+        return false;
+
     if (enc->codec_id == AV_CODEC_ID_MPEG1VIDEO)
     {
         // Need to avoid usage of macroblocks in which some coeffs overflow.
@@ -292,6 +364,63 @@ bool FFMPEGCapturePrivate::addStream(int width, int height, float fps)
     return true;
 }
 
+bool FFMPEGCapturePrivate::initHardwareFrames()
+{
+    const AVCodecHWConfig *config = nullptr;
+    for (int i = 0; (config = avcodec_get_hw_config(vc, i)) != nullptr; i++)
+    {
+        if (config->pix_fmt == enc->pix_fmt &&
+            (config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_FRAMES_CTX) != 0)
+        {
+            break;
+        }
+    }
+
+    if (config == nullptr)
+    {
+        cout << "Video encoder needs unsupported hardware frames\n";
+        return false;
+    }
+
+    if (av_hwdevice_ctx_create(&hwDevice, config->device_type, nullptr, nullptr, 0) < 0)
+    {
+        cout << "Failed to open the hardware encoding device\n";
+        return false;
+    }
+
+    AVBufferRef *framesRef = av_hwframe_ctx_alloc(hwDevice);
+    if (framesRef == nullptr)
+    {
+        cout << "Failed to allocate hardware frames\n";
+        return false;
+    }
+
+    auto *frames = reinterpret_cast<AVHWFramesContext*>(framesRef->data);
+    frames->format    = enc->pix_fmt;
+    frames->sw_format = AV_PIX_FMT_NV12;
+    frames->width     = enc->width;
+    frames->height    = enc->height;
+    frames->initial_pool_size = 20;
+    if (av_hwframe_ctx_init(framesRef) < 0)
+    {
+        cout << "Failed to initialize hardware frames\n";
+        av_buffer_unref(&framesRef);
+        return false;
+    }
+
+    // the codec context takes the reference
+    enc->hw_frames_ctx = framesRef;
+    swFormat = AV_PIX_FMT_NV12;
+
+    if ((hwfr = av_frame_alloc()) == nullptr)
+    {
+        cout << "Failed to allocate hardware frame\n";
+        return false;
+    }
+
+    return true;
+}
+
 bool FFMPEGCapturePrivate::start()
 {
     // open the output file, if needed
@@ -354,7 +483,7 @@ bool FFMPEGCapturePrivate::openVideo()
         return false;
     }
 
-    frame->format = enc->pix_fmt;
+    frame->format = swFormat;
     frame->width  = enc->width;
     frame->height = enc->height;
 
@@ -365,12 +494,12 @@ bool FFMPEGCapturePrivate::openVideo()
         return false;
     }
 
-    if (enc->pix_fmt != format)
+    if (swFormat != format)
     {
         // as we only grab a RGB24 picture, we must convert it
         // to the codec pixel format if needed
         swsc = sws_getContext(enc->width, enc->height, format,
-                              enc->width, enc->height, enc->pix_fmt,
+                              enc->width, enc->height, swFormat,
                               SWS_BITEXACT, nullptr, nullptr, nullptr);
         if (swsc == nullptr)
         {
@@ -404,59 +533,234 @@ bool FFMPEGCapturePrivate::openVideo()
         return false;
     }
 
+    if (FrameReadback::isSupported())
+    {
+        readback = std::make_unique<FrameReadback>(enc->width, enc->height,
+                                                   renderer->getPreferredCaptureFormat(),
+                                                   ReadbackLatency + MaxQueuedFrames);
+        if (!readback->isValid())
+            readback = nullptr;
+    }
+
+    // mapped frames are encoded on their own thread while the next ones
+    // are rendered
+    if (readback != nullptr)
+        encoder = std::thread(&FFMPEGCapturePrivate::encodeQueuedFrames, this);
+
     return true;
 }
 
-static void captureImage(AVFrame *pict, int width, int height, const Renderer *r)
+static void getCaptureOrigin(int width, int height, const Renderer *r, int &x, int &y)
 {
-    int x, y, w, h;
+    int w, h;
     r->getViewport(&x, &y, &w, &h);
 
     x += (w - width) / 2;
     y += (h - height) / 2;
+}
+
+static void captureImage(AVFrame *pict, int width, int height, const Renderer *r)
+{
+    int x, y;
+    getCaptureOrigin(width, height, r, x, y);
     r->captureFrame(x, y, width, height,
                     r->getPreferredCaptureFormat(),
                     pict->data[0]);
 }
 
-// encode one video frame and send it to the muxer
-// return 1 when encoding is finished, 0 otherwise
+// capture one video frame, and encode it and send it to the muxer or
+// queue it for reading back; flush the encoder when finalizing
 bool FFMPEGCapturePrivate::writeVideoFrame(bool finalize)
 {
-    AVFrame *frame = finalize ? nullptr : this->frame;
-    const int bytesPerPixel = hasAlpha ? 4 : 3;
+    if (finalize)
+    {
+        bool ok = true;
+        if (readback != nullptr)
+        {
+            // encode the remaining frames and wait for the encoder thread
+            ok = queueReadFrames(0);
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                stopEncoding = true;
+            }
+            queueCondition.notify_one();
+            encoder.join();
+            ok = releaseEncodedFrames(false) && ok;
+        }
+        return ok && encodeFrame(nullptr);
+    }
 
-    // check if we want to generate more frames
-    if (!finalize)
+    if (readback != nullptr)
     {
-        // when we pass a frame to the encoder, it may keep a reference to it
-        // internally; make sure we do not overwrite it here
-        if (av_frame_make_writable(frame) < 0)
+        // frames read ReadbackLatency frames ago are complete by now
+        if (!releaseEncodedFrames(false) || !queueReadFrames(ReadbackLatency))
+            return false;
+
+        // only wait for the encoder thread if all the buffers are in use
+        if (readback->isFull() && !releaseEncodedFrames(true))
+            return false;
+
+        int x, y;
+        getCaptureOrigin(enc->width, enc->height, renderer, x, y);
+        if (!readback->read(x, y))
         {
-            cout << "Failed to make the frame writable\n";
+            cout << "Failed to read the frame\n";
             return false;
         }
+        ++capturedFrames;
+        return true;
+    }
 
-        if (enc->pix_fmt != format)
+    // when we pass a frame to the encoder, it may keep a reference to it
+    // internally; make sure we do not overwrite it here
+    if (av_frame_make_writable(frame) < 0)
+    {
+        cout << "Failed to make the frame writable\n";
+        return false;
+    }
+
+    if (swFormat != format)
+    {
+        captureImage(tmpfr, enc->width, enc->height, renderer);
+        // we need to compute the correct line width of our source data
+        const int linesize = (hasAlpha ? 4 : 3) * enc->width;
+        sws_scale(swsc, tmpfr->data, &linesize, 0, enc->height,
+                  frame->data, frame->linesize);
+    }
+    else
+    {
+        captureImage(frame, enc->width, enc->height, renderer);
+    }
+
+    frame->pts = nextPts++;
+    ++capturedFrames;
+    return encodeFrame(frame);
+}
+
+// map the frames read back more than latency frames ago and queue them for
+// the encoder thread
+bool FFMPEGCapturePrivate::queueReadFrames(std::size_t latency)
+{
+    while (readback->pending() - readback->mapped() > latency)
+    {
+        QueuedFrame queued;
+        queued.top = readback->map(queued.stride);
+        if (queued.top == nullptr)
         {
-            captureImage(tmpfr, enc->width, enc->height, renderer);
-            // we need to compute the correct line width of our source data
-            const int linesize = bytesPerPixel * enc->width;
-            sws_scale(swsc, tmpfr->data, &linesize, 0, enc->height,
-                      frame->data, frame->linesize);
+            cout << "Failed to map the frame\n";
+            return false;
         }
-        else
+
         {
-            captureImage(frame, enc->width, enc->height, renderer);
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queue.push_back(queued);
         }
+        queueCondition.notify_one();
+    }
+
+    return true;
+}
 
-        frame->pts = nextPts++;
+// unmap the frames the encoder thread is done with, waiting for one if
+// wait is set; returns false if encoding failed
+bool FFMPEGCapturePrivate::releaseEncodedFrames(bool wait)
+{
+    std::size_t count;
+    bool failed;
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        if (wait)
+            encodedCondition.wait(lock, [this] { return encodedFrames > 0 || encodingFailed; });
+        count = encodedFrames;
+        encodedFrames = 0;
+        failed = encodingFailed;
     }
 
+    // frames are encoded in the order they were mapped
+    for (; count > 0; count--)
+        readback->release();
+
+    return !failed;
+}
+
+// the encoder thread: convert and encode the mapped frames in order until
+// asked to stop and the queue is empty; GL calls are only made by the
+// rendering thread
+void FFMPEGCapturePrivate::encodeQueuedFrames()
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+    for (;;)
+    {
+        queueCondition.wait(lock, [this] { return !queue.empty() || stopEncoding; });
+        if (queue.empty())
+            break;
+
+        QueuedFrame queued = queue.front();
+        lock.unlock();
+        bool ok = fillFrame(queued.top, queued.stride) && encodeFrame(frame);
+        lock.lock();
+
+        queue.pop_front();
+        ++encodedFrames;
+        if (!ok)
+            encodingFailed = true;
+        encodedCondition.notify_one();
+        if (!ok)
+            break;
+    }
+}
+
+// copy a frame given by its top row into the frame passed to the encoder,
+// converting it to the codec pixel format if needed
+bool FFMPEGCapturePrivate::fillFrame(const uint8_t *top, std::ptrdiff_t stride)
+{
+    if (av_frame_make_writable(frame) < 0)
+    {
+        cout << "Failed to make the frame writable\n";
+        return false;
+    }
+
+    if (swFormat != format)
+    {
+        // a negative stride flips the rows while converting them
+        const uint8_t *srcSlice[] = { top };
+        const int srcStride[] = { static_cast<int>(stride) };
+        sws_scale(swsc, srcSlice, srcStride, 0, enc->height,
+                  frame->data, frame->linesize);
+    }
+    else
+    {
+        const size_t rowSize = (hasAlpha ? 4 : 3) * enc->width;
+        for (int row = 0; row < enc->height; row++)
+            memcpy(frame->data[0] + row * frame->linesize[0], top + row * stride, rowSize);
+    }
+
+    frame->pts = nextPts++;
+    return true;
+}
+
+// encode one video frame, or flush the encoder if frame is null, and send
+// the packets to the muxer
+bool FFMPEGCapturePrivate::encodeFrame(AVFrame *frame)
+{
 #if (LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 133, 100))
     av_init_packet(pkt);
 #endif
 
+    // hardware encoders get the frame uploaded to video memory
+    if (frame != nullptr && hwfr != nullptr)
+    {
+        av_frame_unref(hwfr);
+        if (av_hwframe_get_buffer(enc->hw_frames_ctx, hwfr, 0) < 0 ||
+            av_hwframe_transfer_data(hwfr, frame, 0) < 0)
+        {
+            cout << "Failed to upload the frame\n";
+            return false;
+        }
+        hwfr->pts = frame->pts;
+        frame = hwfr;
+    }
+
     // encode the image
     if (avcodec_send_frame(enc, frame) < 0)
     {
@@ -490,6 +794,7 @@ bool FFMPEGCapturePrivate::writeVideoFrame(bool finalize)
 void FFMPEGCapturePrivate::finish()
 {
     writeVideoFrame(true);
+    readback = nullptr;
 
     // Write the trailer, if any. The trailer must be written before you
     // close the CodecContexts open when you wrote the header; otherwise
@@ -503,10 +808,23 @@ void FFMPEGCapturePrivate::finish()
 
 FFMPEGCapturePrivate::~FFMPEGCapturePrivate()
 {
+    if (encoder.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopEncoding = true;
+        }
+        queueCondition.notify_one();
+        encoder.join();
+    }
+
     avcodec_free_context(&enc);
     av_frame_free(&frame);
     if (tmpfr != nullptr)
         av_frame_free(&tmpfr);
+    if (hwfr != nullptr)
+        av_frame_free(&hwfr);
+    av_buffer_unref(&hwDevice);
     avformat_free_context(oc);
     av_packet_free(&pkt);
 }
@@ -527,7 +845,8 @@ FFMPEGCapture::~FFMPEGCapture()
 
 int FFMPEGCapture::getFrameCount() const
 {
-    return d->nextPts;
+    // include the frames still being read back or encoded
+    return static_cast<int>(d->capturedFrames);
 }
 
 int FFMPEGCapture::getWidth() const
@@ -577,9 +896,10 @@ bool FFMPEGCapture::captureFrame()
     return d->capturing && d->writeVideoFrame();
 }
 
-void FFMPEGCapture::setVideoCodec(AVCodecID vc_id)
+void FFMPEGCapture::setVideoCodec(AVCodecID vc_id, const std::string &encoder)
 {
     d->vc_id = vc_id;
+    d->vc_name = encoder;
 }
 
 void FFMPEGCapture::setBitRate(int64_t bit_rate)
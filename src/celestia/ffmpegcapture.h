@@ -30,7 +30,9 @@ class FFMPEGCapture : public MovieCapture
     void setQuality(float) override {};
     void recordingStatus(bool) override {};
 
-    void setVideoCodec(AVCodecID);
+    // encoder is the name of a specific encoder for the codec to try first,
+    // e.g. a hardware one
+    void setVideoCodec(AVCodecID, const std::string &encoder = {});
     void setBitRate(int64_t);
     void setEncoderOptions(const std::string&);
 
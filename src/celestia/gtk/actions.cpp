@@ -1122,12 +1122,17 @@ static void captureMovie(const char* filename, const int resolution[], float fps
                          AVCodecID codec, float bitrate, AppData* app)
 {
     auto* movieCapture = new FFMPEGCapture(app->renderer);
-    movieCapture->setVideoCodec(codec);
     movieCapture->setBitRate(bitrate);
     if (codec == AV_CODEC_ID_H264)
+    {
+        movieCapture->setVideoCodec(codec, app->core->getConfig()->h264Encoder);
         movieCapture->setEncoderOptions(app->core->getConfig()->x264EncoderOptions);
+    }
     else
+    {
+        movieCapture->setVideoCodec(codec);
         movieCapture->setEncoderOptions(app->core->getConfig()->ffvhEncoderOptions);
+    }
 
     bool success = movieCapture->start(filename, resolution[0], resolution[1], fps);
     if (success)
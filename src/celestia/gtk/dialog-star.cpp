@@ -37,12 +37,13 @@ static void starDestroy(GtkWidget* w, gint, sbData* sb);
 
 /* Declarations: Helpers */
 static void addStars(sbData* sb);
+static gboolean checkStars(sbData* sb);
 
 
 /* ENTRY: Navigation -> Star Browser... */
 void dialogStarBrowser(AppData* app)
 {
-    sbData* sb = g_new0(sbData, 1);
+    sbData* sb = new sbData();
     sb->app = app;
     sb->numListStars = 100;
 
@@ -148,7 +149,7 @@ void dialogStarBrowser(AppData* app)
         return;
     gtk_box_pack_start(GTK_BOX(mainbox), hbox, FALSE, FALSE, 0);
 
-    g_signal_connect(browser, "response", G_CALLBACK(starDestroy), browser);
+    g_signal_connect(browser, "response", G_CALLBACK(starDestroy), sb);
 
     gtk_widget_set_size_request(browser, -1, 400); /* Absolute Size, urghhh */
     gtk_widget_show_all(browser);
@@ -239,8 +240,16 @@ static void listStarSliderChange(GtkRange *range, sbData* sb)
 
 
 /* CALLBACK: Destroy Window */
-static void starDestroy(GtkWidget* w, gint, sbData*)
+static void starDestroy(GtkWidget* w, gint, sbData* sb)
 {
+    /* Stop any search still running before its list store goes away */
+    if (sb->queryTimer != 0)
+    {
+        g_source_remove(sb->queryTimer);
+        sb->queryTimer = 0;
+    }
+    sb->browser.cancelListStars();
+
     gtk_widget_destroy(GTK_WIDGET(w));
 
     /* Cannot do this, as the program crashes because of the StarBrowser:
@@ -248,23 +257,40 @@ static void starDestroy(GtkWidget* w, gint, sbData*)
 }
 
 
-/* HELPER: Clear and Add stars to the starListStore */
+/* HELPER: Search for the stars to list in the background; the list is
+ * filled by checkStars once the search is done. */
 static void addStars(sbData* sb)
+{
+    sb->browser.refresh();
+    if (!sb->browser.listStarsAsync(sb->numListStars))
+        return;
+
+    if (sb->queryTimer == 0)
+        sb->queryTimer = g_timeout_add(50, (GSourceFunc)checkStars, sb);
+}
+
+
+/* HELPER: Clear and Add stars to the starListStore when the search is done */
+static gboolean checkStars(sbData* sb)
 {
     const char *values[5];
     GtkTreeIter iter;
 
     StarDatabase* stardb;
-    vector<const Star*> *stars;
+    vector<const Star*> stars;
     unsigned int currentLength;
     UniversalCoord ucPos;
 
+    if (!sb->browser.starsReady())
+        return TRUE;
+    sb->queryTimer = 0;
+
     /* Load the catalogs and set data */
     stardb = sb->app->simulation->getUniverse()->getStarCatalog();
-    sb->browser.refresh();
-    stars = sb->browser.listStars(sb->numListStars);
-    currentLength = (*stars).size();
-    sb->app->simulation->setSelection(Selection((Star *)(*stars)[0]));
+    stars = sb->browser.takeStars();
+    currentLength = stars.size();
+    if (currentLength > 0)
+        sb->app->simulation->setSelection(Selection((Star *)stars[0]));
     ucPos = sb->app->simulation->getObserver().getPosition();
 
     gtk_list_store_clear(sb->starListStore);
@@ -272,7 +298,7 @@ static void addStars(sbData* sb)
     for (unsigned int i = 0; i < currentLength; i++)
     {
         char buf[20];
-        const Star *star=(*stars)[i];
+        const Star *star=stars[i];
         values[0] = g_strdup(ReplaceGreekLetterAbbr((stardb->getStarName(*star))).c_str());
 
         /* Calculate distance to star */
@@ -297,5 +323,5 @@ static void addStars(sbData* sb)
                            5, (gpointer)star, -1);
     }
 
-    delete stars;
+    return FALSE;
 }
@@ -37,6 +37,7 @@ struct _sbData {
     int numListStars;
     GtkWidget* entry;
     GtkWidget* scale;
+    guint queryTimer;
 };
 
 static const char * const sbTitles[] =
@@ -0,0 +1,362 @@
+// benchmain.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Measures the rendering performance on a set of scenarios, each a celx
+// script which sets up a scene and moves the camera along a fixed path,
+// returning control with wait(0) after each frame. The frames are drawn
+// offscreen at a fixed size and time step, so each run of a scenario
+// renders the same frames. For each scenario the time to set it up, the
+// percentiles of the frame times and the memory use are reported.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include <fmt/format.h>
+#include <fmt/ostream.h>
+#include <celcompat/filesystem.h>
+#include <celengine/framebuffer.h>
+#include <celengine/glsupport.h>
+#include <celengine/render.h>
+#include <celutil/gettext.h>
+#include <celestia/celestiacore.h>
+#include <celestia/configfile.h>
+#include "eglcontext.h"
+
+namespace celestia
+{
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// Scenarios are stopped after this many frames if they haven't finished
+constexpr int DefaultMaxFrames = 3000;
+// The first frames are left out of the statistics, as they include
+// loading textures and models and filling the caches
+constexpr int DefaultWarmupFrames = 10;
+
+class BenchAlerter : public CelestiaCore::Alerter
+{
+ public:
+    void fatalError(const std::string& msg) override
+    {
+        std::cerr << msg << '\n';
+    }
+};
+
+struct BenchOptions
+{
+    int width{ 1920 };
+    int height{ 1080 };
+    float frameRate{ 30.0f };
+    int warmupFrames{ DefaultWarmupFrames };
+    int maxFrames{ DefaultMaxFrames };
+    fs::path configFile;
+    fs::path csvFile;
+    std::vector<fs::path> scenarios;
+};
+
+struct ScenarioResult
+{
+    std::string name;
+    double setupTime{ 0.0 };
+    // In seconds, without the warmup frames
+    std::vector<double> frameTimes;
+    long residentKB{ -1 };
+    long peakKB{ -1 };
+};
+
+double
+secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// A field of /proc/self/status in kB, or -1 where it isn't available
+long
+readMemoryKB(std::string_view field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, field.size(), field) == 0 && line.size() > field.size() && line[field.size()] == ':')
+            return std::atol(line.c_str() + field.size() + 1);
+    }
+    return -1;
+}
+
+// Nearest rank percentile of sorted values
+double
+percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+    auto rank = static_cast<std::size_t>(std::ceil(p / 100.0 * static_cast<double>(sorted.size())));
+    return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+
+// Draw a frame and wait for the GPU to finish it, so that the time measured
+// is that of the frame rather than of queueing its commands
+void
+drawFrame(CelestiaCore *core)
+{
+    core->tick();
+    core->draw();
+    glFinish();
+}
+
+bool
+runScenario(CelestiaCore *core, const fs::path &filename, const BenchOptions &options, ScenarioResult &result)
+{
+    result.name = filename.stem().string();
+
+    // The script sets up the scene until its first wait
+    auto start = Clock::now();
+    core->runScript(filename, false);
+    if (!core->isScriptLoaded())
+    {
+        std::cerr << fmt::format("Cannot run {}\n", filename.string());
+        return false;
+    }
+    drawFrame(core);
+    result.setupTime = secondsSince(start);
+
+    for (int frame = 0; core->isScriptLoaded() && frame < options.maxFrames; frame++)
+    {
+        start = Clock::now();
+        drawFrame(core);
+        if (frame >= options.warmupFrames)
+            result.frameTimes.push_back(secondsSince(start));
+    }
+
+    if (core->isScriptLoaded())
+    {
+        std::cerr << fmt::format("{} didn't finish in {} frames\n", filename.string(), options.maxFrames);
+        core->cancelScript();
+    }
+
+    result.residentKB = readMemoryKB("VmRSS");
+    result.peakKB = readMemoryKB("VmHWM");
+
+    if (result.frameTimes.empty())
+    {
+        std::cerr << fmt::format("{} has no frames after the {} warmup frames\n",
+                                 filename.string(), options.warmupFrames);
+        return false;
+    }
+    return true;
+}
+
+void
+printResults(std::ostream &out, const std::vector<ScenarioResult> &results, bool csv)
+{
+    constexpr double percentiles[] = { 50.0, 90.0, 95.0, 99.0 };
+
+    if (csv)
+        out << "scenario,frames,setup_ms,mean_ms,p50_ms,p90_ms,p95_ms,p99_ms,max_ms,rss_kb,peak_rss_kb\n";
+    else
+        fmt::print(out, "{:<16} {:>6} {:>9} {:>8} {:>8} {:>8} {:>8} {:>8} {:>8} {:>8} {:>8}\n",
+                   "scenario", "frames", "setup ms", "mean ms", "p50", "p90", "p95", "p99", "max", "RSS MB", "peak MB");
+
+    for (const auto &result : results)
+    {
+        std::vector<double> sorted = result.frameTimes;
+        std::sort(sorted.begin(), sorted.end());
+        double mean = sorted.empty() ? 0.0 : std::accumulate(sorted.begin(), sorted.end(), 0.0) / static_cast<double>(sorted.size());
+        double maximum = sorted.empty() ? 0.0 : sorted.back();
+
+        if (csv)
+        {
+            fmt::print(out, "{},{},{:.3f},{:.3f}", result.name, sorted.size(), result.setupTime * 1000.0, mean * 1000.0);
+            for (double p : percentiles)
+                fmt::print(out, ",{:.3f}", percentile(sorted, p) * 1000.0);
+            fmt::print(out, ",{:.3f},{},{}\n", maximum * 1000.0, result.residentKB, result.peakKB);
+        }
+        else
+        {
+            fmt::print(out, "{:<16} {:>6} {:>9.1f} {:>8.2f}", result.name, sorted.size(), result.setupTime * 1000.0, mean * 1000.0);
+            for (double p : percentiles)
+                fmt::print(out, " {:>8.2f}", percentile(sorted, p) * 1000.0);
+            fmt::print(out, " {:>8.2f} {:>8.1f} {:>8.1f}\n", maximum * 1000.0,
+                       static_cast<double>(result.residentKB) / 1024.0, static_cast<double>(result.peakKB) / 1024.0);
+        }
+    }
+}
+
+// [--size WxH] [--fps F] [--warmup N] [--max-frames N] [--conf FILE] [--csv FILE] SCENARIO...
+bool
+parseOptions(int argc, char **argv, BenchOptions &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if (arg.substr(0, 2) != "--")
+        {
+            options.scenarios.push_back(fs::absolute(argv[i]));
+            continue;
+        }
+
+        if (i + 1 == argc)
+            return false;
+
+        const char *value = argv[++i];
+        if (arg == "--size")
+        {
+            if (std::sscanf(value, "%dx%d", &options.width, &options.height) != 2)
+                return false;
+        }
+        else if (arg == "--fps")
+            options.frameRate = static_cast<float>(std::atof(value));
+        else if (arg == "--warmup")
+            options.warmupFrames = std::atoi(value);
+        else if (arg == "--max-frames")
+            options.maxFrames = std::atoi(value);
+        else if (arg == "--conf")
+            options.configFile = fs::absolute(value);
+        else if (arg == "--csv")
+            options.csvFile = fs::absolute(value);
+        else
+            return false;
+    }
+
+    return !options.scenarios.empty() && options.frameRate > 0.0f &&
+           options.width > 0 && options.height > 0 && options.warmupFrames >= 0;
+}
+
+int
+benchmain(int argc, char **argv)
+{
+    setlocale(LC_ALL, "");
+    setlocale(LC_NUMERIC, "C");
+    bindtextdomain("celestia", LOCALEDIR);
+    bind_textdomain_codeset("celestia", "UTF-8");
+    bindtextdomain("celestia-data", LOCALEDIR);
+    bind_textdomain_codeset("celestia-data", "UTF-8");
+    textdomain("celestia");
+
+    // paths are resolved before changing to the data directory
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--size WxH] [--fps F] [--warmup N] [--max-frames N]"
+                     " [--conf FILE] [--csv FILE] SCENARIO...\n";
+        return 1;
+    }
+
+    const char *dataDir = getenv("CELESTIA_DATA_DIR");
+    if (dataDir == nullptr)
+        dataDir = CONFIG_DATA_DIR;
+
+    std::error_code ec;
+    fs::current_path(dataDir, ec);
+    if (ec)
+    {
+        std::cerr << fmt::format("Cannot chdir to {}, probably due to improper installation\n", dataDir);
+        return 1;
+    }
+
+    EGLContextHolder context;
+    if (!context.create())
+    {
+        std::cerr << fmt::format("Could not create an EGL context, error {:#x}\n", eglGetError());
+        return 2;
+    }
+
+    gl::init();
+#ifndef GL_ES
+    if (!gl::checkVersion(gl::GL_2_1))
+    {
+        std::cerr << "Celestia requires OpenGL 2.1!\n";
+        return 2;
+    }
+#endif
+
+    auto loadStart = Clock::now();
+    auto core = std::make_unique<CelestiaCore>();
+    core->setAlerter(new BenchAlerter());
+    if (!core->initSimulation(options.configFile) || !core->initRenderer())
+    {
+        std::cerr << "Could not initialize Celestia!\n";
+        return 3;
+    }
+    double loadTime = secondsSince(loadStart);
+
+    auto *renderer = core->getRenderer();
+    const auto *config = core->getConfig();
+    renderer->setRenderFlags(Renderer::DefaultRenderFlags);
+    renderer->setShadowMapSize(config->ShadowMapSize);
+    renderer->setSolarSystemMaxDistance(config->SolarSystemMaxDistance);
+
+    core->start();
+    core->resize(options.width, options.height);
+    core->setFixedTimeStep(1.0 / options.frameRate);
+
+    // The frames are drawn offscreen, so their size doesn't depend on the
+    // largest surface the display allows
+    FramebufferObject fbo(options.width, options.height,
+                          FramebufferObject::ColorAttachment | FramebufferObject::DepthAttachment);
+    if (!fbo.isValid())
+    {
+        std::cerr << fmt::format("Could not create a framebuffer of {}x{}!\n", options.width, options.height);
+        return 4;
+    }
+    fbo.bind();
+
+    fmt::print(std::cout, "{} {}x{} at {} fps\n", reinterpret_cast<const char*>(glGetString(GL_RENDERER)),
+               options.width, options.height, options.frameRate);
+    fmt::print(std::cout, "Loaded in {:.2f} s, RSS {:.1f} MB\n\n",
+               loadTime, static_cast<double>(readMemoryKB("VmRSS")) / 1024.0);
+
+    std::vector<ScenarioResult> results;
+    int failed = 0;
+    for (const auto &scenario : options.scenarios)
+    {
+        ScenarioResult result;
+        if (runScenario(core.get(), scenario, options, result))
+            results.push_back(std::move(result));
+        else
+            failed++;
+    }
+
+    printResults(std::cout, results, false);
+    if (!options.csvFile.empty())
+    {
+        std::ofstream csv(options.csvFile);
+        printResults(csv, results, true);
+        if (!csv.good())
+        {
+            std::cerr << fmt::format("Cannot write {}\n", options.csvFile.string());
+            failed++;
+        }
+    }
+
+    fbo.unbind(0);
+    return failed == 0 ? 0 : 5;
+}
+
+} // end unnamed namespace
+} // namespace celestia
+
+int
+main(int argc, char **argv)
+{
+    return celestia::benchmain(argc, argv);
+}
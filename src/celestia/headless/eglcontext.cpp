@@ -0,0 +1,103 @@
+// eglcontext.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// An EGL context for the frontends which render without a window.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "eglcontext.h"
+
+#include <string_view>
+#include <EGL/eglext.h>
+
+namespace celestia
+{
+
+EGLContextHolder::~EGLContextHolder()
+{
+    if (m_display == EGL_NO_DISPLAY)
+        return;
+
+    eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (m_context != EGL_NO_CONTEXT)
+        eglDestroyContext(m_display, m_context);
+    if (m_surface != EGL_NO_SURFACE)
+        eglDestroySurface(m_display, m_surface);
+    eglTerminate(m_display);
+}
+
+bool
+EGLContextHolder::create()
+{
+    // Prefer a display which doesn't need a window system at all
+    std::string_view clientExtensions;
+    if (const char *s = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS); s != nullptr)
+        clientExtensions = s;
+
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    if (clientExtensions.find("EGL_MESA_platform_surfaceless") != std::string_view::npos)
+    {
+        auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (getPlatformDisplay != nullptr)
+            m_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+#endif
+    if (m_display == EGL_NO_DISPLAY)
+        m_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (m_display == EGL_NO_DISPLAY || !eglInitialize(m_display, nullptr, nullptr))
+        return false;
+
+#ifdef GL_ES
+    if (!eglBindAPI(EGL_OPENGL_ES_API))
+        return false;
+    constexpr EGLint renderableType = EGL_OPENGL_ES2_BIT;
+#else
+    if (!eglBindAPI(EGL_OPENGL_API))
+        return false;
+    constexpr EGLint renderableType = EGL_OPENGL_BIT;
+#endif
+
+    const EGLint configAttribs[] =
+    {
+        EGL_SURFACE_TYPE,       EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE,    renderableType,
+        EGL_RED_SIZE,           8,
+        EGL_GREEN_SIZE,         8,
+        EGL_BLUE_SIZE,          8,
+        EGL_DEPTH_SIZE,         24,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(m_display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+        return false;
+
+#ifdef GL_ES
+    const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+#else
+    const EGLint *contextAttribs = nullptr;
+#endif
+    m_context = eglCreateContext(m_display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (m_context == EGL_NO_CONTEXT)
+        return false;
+
+    // Frames are rendered into framebuffer objects, so the default
+    // framebuffer is only needed where the context can't do without one
+    std::string_view extensions = eglQueryString(m_display, EGL_EXTENSIONS);
+    if (extensions.find("EGL_KHR_surfaceless_context") == std::string_view::npos)
+    {
+        const EGLint surfaceAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        m_surface = eglCreatePbufferSurface(m_display, config, surfaceAttribs);
+        if (m_surface == EGL_NO_SURFACE)
+            return false;
+    }
+
+    return eglMakeCurrent(m_display, m_surface, m_surface, m_context) == EGL_TRUE;
+}
+
+} // namespace celestia
@@ -0,0 +1,38 @@
+// eglcontext.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// An EGL context for the frontends which render without a window.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <EGL/egl.h>
+
+namespace celestia
+{
+
+// An OpenGL context without a window, on a display which doesn't need a
+// window system where EGL has one
+class EGLContextHolder
+{
+ public:
+    EGLContextHolder() = default;
+    ~EGLContextHolder();
+
+    EGLContextHolder(const EGLContextHolder&) = delete;
+    EGLContextHolder& operator=(const EGLContextHolder&) = delete;
+
+    bool create();
+
+ private:
+    EGLDisplay m_display{ EGL_NO_DISPLAY };
+    EGLSurface m_surface{ EGL_NO_SURFACE };
+    EGLContext m_context{ EGL_NO_CONTEXT };
+};
+
+} // namespace celestia
@@ -0,0 +1,287 @@
+// headlessmain.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Renders batches of images without a window system, on an EGL context.
+// The universe is loaded once, then jobs are read one per line from the
+// standard input or a file:
+//
+//     url OUTPUT URL        render the view of a cel:// URL
+//     script OUTPUT FILE    run a cel or celx script, then render
+//     celx OUTPUT CODE      run a line of celx code, then render
+//
+// and the result of each is printed as "ok OUTPUT" or "error OUTPUT".
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unistd.h>
+#include <fmt/format.h>
+#include <celcompat/filesystem.h>
+#include <celengine/glsupport.h>
+#include <celengine/render.h>
+#include <celengine/simulation.h>
+#include <celutil/gettext.h>
+#include <celestia/celestiacore.h>
+#include <celestia/configfile.h>
+#include <celestia/offlinerenderer.h>
+#include "eglcontext.h"
+
+namespace celestia
+{
+namespace
+{
+
+// Scripts are stopped after running for this many seconds of simulation
+// time
+constexpr double DefaultScriptTimeout = 60.0;
+
+class HeadlessAlerter : public CelestiaCore::Alerter
+{
+ public:
+    void fatalError(const std::string& msg) override
+    {
+        std::cerr << msg << '\n';
+    }
+};
+
+struct HeadlessOptions
+{
+    // relative paths in the jobs are resolved against it
+    fs::path workingDir;
+    fs::path jobsFile;
+    fs::path configFile;
+    double scriptTimeout{ DefaultScriptTimeout };
+    OfflineRenderer::Options renderer;
+};
+
+// Run the script loaded by a job until it finishes or times out
+bool
+runScript(CelestiaCore *core, const fs::path &filename, const HeadlessOptions &options)
+{
+    core->runScript(filename, false);
+    if (!core->isScriptLoaded())
+        return false;
+
+    double dt = 1.0 / options.renderer.frameRate;
+    for (double t = 0.0; core->isScriptLoaded() && t < options.scriptTimeout; t += dt)
+        core->tick();
+
+    if (core->isScriptLoaded())
+    {
+        std::cerr << "Script " << filename << " timed out\n";
+        core->cancelScript();
+    }
+    return true;
+}
+
+bool
+runJob(CelestiaCore *core, OfflineRenderer &renderer, const std::string &line,
+       const HeadlessOptions &options, fs::path &output)
+{
+    // kind, output file and the rest of the line
+    auto kindEnd = line.find(' ');
+    if (kindEnd == std::string::npos)
+        return false;
+    auto outputEnd = line.find(' ', kindEnd + 1);
+    if (outputEnd == std::string::npos)
+        return false;
+
+    std::string_view kind(line.data(), kindEnd);
+    output = options.workingDir / line.substr(kindEnd + 1, outputEnd - kindEnd - 1);
+    std::string argument = line.substr(outputEnd + 1);
+
+    bool ok = false;
+    if (kind == "url")
+    {
+        ok = core->goToUrl(argument);
+    }
+    else if (kind == "script")
+    {
+        ok = runScript(core, options.workingDir / argument, options);
+    }
+    else if (kind == "celx")
+    {
+        fs::path filename = fs::temp_directory_path() / fmt::format("celestia-headless-{}.celx", getpid());
+        {
+            std::ofstream out(filename);
+            out << argument << '\n';
+            ok = out.good();
+        }
+        ok = ok && runScript(core, filename, options);
+        std::error_code ec;
+        fs::remove(filename, ec);
+    }
+
+    if (!ok)
+        return false;
+
+    // Render the state the job left without stepping the time further
+    core->getSimulation()->update(0.0);
+    return renderer.renderFrame(output, false);
+}
+
+// [--size WxH] [--tile-size N] [--fps F] [--script-timeout T] [--conf FILE] [JOBS]
+bool
+parseOptions(int argc, char **argv, HeadlessOptions &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if (arg.substr(0, 2) != "--")
+        {
+            options.jobsFile = fs::absolute(argv[i]);
+            continue;
+        }
+
+        if (i + 1 == argc)
+            return false;
+
+        const char *value = argv[++i];
+        if (arg == "--size")
+        {
+            if (std::sscanf(value, "%dx%d", &options.renderer.width, &options.renderer.height) != 2)
+                return false;
+        }
+        else if (arg == "--tile-size")
+            options.renderer.maxTileSize = std::atoi(value);
+        else if (arg == "--fps")
+            options.renderer.frameRate = static_cast<float>(std::atof(value));
+        else if (arg == "--script-timeout")
+            options.scriptTimeout = std::atof(value);
+        else if (arg == "--conf")
+            options.configFile = fs::absolute(value);
+        else
+            return false;
+    }
+
+    return options.renderer.frameRate > 0.0f;
+}
+
+int
+headlessmain(int argc, char **argv)
+{
+    setlocale(LC_ALL, "");
+    setlocale(LC_NUMERIC, "C");
+    bindtextdomain("celestia", LOCALEDIR);
+    bind_textdomain_codeset("celestia", "UTF-8");
+    bindtextdomain("celestia-data", LOCALEDIR);
+    bind_textdomain_codeset("celestia-data", "UTF-8");
+    textdomain("celestia");
+
+    // paths are resolved before changing to the data directory
+    HeadlessOptions options;
+    options.workingDir = fs::current_path();
+    if (!parseOptions(argc, argv, options))
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--size WxH] [--tile-size N] [--fps F] [--script-timeout T]"
+                     " [--conf FILE] [JOBS]\n";
+        return 1;
+    }
+
+    const char *dataDir = getenv("CELESTIA_DATA_DIR");
+    if (dataDir == nullptr)
+        dataDir = CONFIG_DATA_DIR;
+
+    std::error_code ec;
+    fs::current_path(dataDir, ec);
+    if (ec)
+    {
+        std::cerr << fmt::format("Cannot chdir to {}, probably due to improper installation\n", dataDir);
+        return 1;
+    }
+
+    EGLContextHolder context;
+    if (!context.create())
+    {
+        std::cerr << fmt::format("Could not create an EGL context, error {:#x}\n", eglGetError());
+        return 2;
+    }
+
+    gl::init();
+#ifndef GL_ES
+    if (!gl::checkVersion(gl::GL_2_1))
+    {
+        std::cerr << "Celestia requires OpenGL 2.1!\n";
+        return 2;
+    }
+#endif
+
+    auto core = std::make_unique<CelestiaCore>();
+    core->setAlerter(new HeadlessAlerter());
+    if (!core->initSimulation(options.configFile) || !core->initRenderer())
+    {
+        std::cerr << "Could not initialize Celestia!\n";
+        return 3;
+    }
+
+    auto *renderer = core->getRenderer();
+    const auto *config = core->getConfig();
+    renderer->setRenderFlags(Renderer::DefaultRenderFlags);
+    renderer->setShadowMapSize(config->ShadowMapSize);
+    renderer->setSolarSystemMaxDistance(config->SolarSystemMaxDistance);
+
+    core->start();
+    core->resize(options.renderer.width, options.renderer.height);
+
+    int failed = 0;
+    {
+        OfflineRenderer offline(core.get(), options.renderer);
+        if (!offline.isValid())
+        {
+            std::cerr << "Could not create the framebuffer for the images!\n";
+            return 4;
+        }
+
+        std::ifstream jobsFile;
+        if (!options.jobsFile.empty())
+        {
+            jobsFile.open(options.jobsFile);
+            if (!jobsFile.good())
+            {
+                std::cerr << fmt::format("Cannot open {}\n", options.jobsFile.string());
+                return 1;
+            }
+        }
+        std::istream &jobs = options.jobsFile.empty() ? std::cin : jobsFile;
+
+        std::string line;
+        while (std::getline(jobs, line))
+        {
+            if (line.empty() || line[0] == '#')
+                continue;
+
+            fs::path output;
+            bool ok = runJob(core.get(), offline, line, options, output);
+            if (!ok)
+                failed++;
+            // the image may still be being written
+            std::cout << (ok ? "ok " : "error ") << output.string() << std::endl;
+        }
+
+        if (!offline.finish())
+            failed++;
+    }
+
+    return failed == 0 ? 0 : 5;
+}
+
+} // end unnamed namespace
+} // namespace celestia
+
+int
+main(int argc, char **argv)
+{
+    return celestia::headlessmain(argc, argv);
+}
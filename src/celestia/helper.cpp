@@ -3,6 +3,7 @@
 #include <celengine/render.h>
 #include <celengine/selection.h>
 #include <celutil/gettext.h>
+#include <celutil/memoryreport.h>
 #include "helper.h"
 
 using namespace std;
@@ -144,6 +145,23 @@ std::string Helper::getRenderInfo(const Renderer *r)
     if (info.count("MaxAnisotropy") > 0)
         s += fmt::sprintf(_("Max anisotropy filtering: %s\n"), info["MaxAnisotropy"]);
 
+    if (info.count("TextureMemory") > 0)
+        s += fmt::sprintf(_("Texture memory: %s MB\n"), info["TextureMemory"]);
+
+    if (info.count("FontTextureMemory") > 0 && info.count("FramebufferMemory") > 0)
+        s += fmt::sprintf(_("Font and framebuffer memory: %s MB, %s MB\n"), info["FontTextureMemory"], info["FramebufferMemory"]);
+
+    if (info.count("TextureMemoryBudget") > 0)
+        s += fmt::sprintf(_("Texture memory budget: %s MB, %s textures unloaded\n"), info["TextureMemoryBudget"], info["TexturesEvicted"]);
+
+    constexpr std::string_view memoryPrefix = "Memory.";
+    for (const auto& [key, value] : info)
+    {
+        if (key.compare(0, memoryPrefix.size(), memoryPrefix) == 0)
+            s += fmt::sprintf(_("Memory used by %s: %s\n"), key.substr(memoryPrefix.size()),
+                              celestia::util::formatMemorySize(std::stoull(value)));
+    }
+
     s += "\n";
 
     if (info.count("Extensions") > 0)
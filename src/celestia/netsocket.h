@@ -0,0 +1,48 @@
+// netsocket.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Portable helpers for the TCP sockets of the cluster and control servers.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#endif
+
+namespace celestia::net
+{
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+constexpr SocketHandle InvalidSocket = INVALID_SOCKET;
+#else
+using SocketHandle = int;
+constexpr SocketHandle InvalidSocket = -1;
+#endif
+
+// Initialize the socket library once; always succeeds but on Windows
+bool initSockets();
+void closeSocket(SocketHandle s);
+void setBlocking(SocketHandle s, bool blocking);
+// Small messages are sent at once rather than delayed to be merged
+void setNoDelay(SocketHandle s);
+// Whether the last call on a non-blocking socket failed only because it
+// would have had to wait
+bool wouldBlock();
+
+// A listening socket on the port of all interfaces, or of the loopback
+// interface only; InvalidSocket if it can't be bound
+SocketHandle listenOn(std::uint16_t port, bool loopbackOnly = false);
+
+// Flags for send(), which mustn't raise SIGPIPE on a closed connection
+int sendFlags();
+
+} // end namespace celestia::net
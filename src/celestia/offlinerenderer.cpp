@@ -0,0 +1,306 @@
+// offlinerenderer.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Renders frames of a fixed size and time step, independent of the window
+// and the system clock, for exporting movies and image sequences.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "offlinerenderer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include <celengine/framebuffer.h>
+#include <celengine/glsupport.h>
+#include <celengine/image.h>
+#include <celengine/render.h>
+#include <celimage/imageformats.h>
+#include <celutil/filetype.h>
+#include <celutil/gettext.h>
+#include <celutil/logger.h>
+#include "celestiacore.h"
+#include "moviecapture.h"
+
+using celestia::util::GetLogger;
+
+namespace
+{
+
+int
+bytesPerPixel(celestia::PixelFormat format)
+{
+    return format == celestia::PixelFormat::RGB
+#ifndef GL_ES
+           || format == celestia::PixelFormat::BGR
+#endif
+           ? 3 : 4;
+}
+
+// Captured rows are aligned to GL_PACK_ALIGNMENT, which is left at four
+std::size_t
+rowSize(int width, celestia::PixelFormat format)
+{
+    return (static_cast<std::size_t>(width * bytesPerPixel(format)) + 3) & ~static_cast<std::size_t>(3);
+}
+
+bool
+isImageFile(const fs::path &filename)
+{
+    ContentType type = DetermineFileType(filename);
+    return type == ContentType::JPEG || type == ContentType::PNG;
+}
+
+} // end unnamed namespace
+
+
+OfflineRenderer::OfflineRenderer(CelestiaCore *core, const Options &options) :
+    core(core),
+    options(options)
+{
+    Renderer *renderer = core->getRenderer();
+    format = renderer->getPreferredCaptureFormat();
+    renderer->getViewport(savedViewport);
+
+    if (!FramebufferObject::isSupported() ||
+        options.width <= 0 || options.height <= 0 || !(options.frameRate > 0.0f))
+    {
+        return;
+    }
+
+    // The whole frame is drawn for each tile, so it must fit in a viewport
+    GLint maxViewportSize[2] = { 0, 0 };
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewportSize);
+    if (options.width > maxViewportSize[0] || options.height > maxViewportSize[1])
+    {
+        GetLogger()->error(_("Frames of {}x{} are larger than the largest viewport, {}x{}\n"),
+                           options.width, options.height, maxViewportSize[0], maxViewportSize[1]);
+        return;
+    }
+
+    GLint maxTileSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTileSize);
+    if (options.maxTileSize > 0)
+        maxTileSize = std::min(maxTileSize, options.maxTileSize);
+    tileWidth = std::min(options.width, static_cast<int>(maxTileSize));
+    tileHeight = std::min(options.height, static_cast<int>(maxTileSize));
+    if (tileWidth <= 0 || tileHeight <= 0)
+        return;
+    columns = (options.width + tileWidth - 1) / tileWidth;
+    rows = (options.height + tileHeight - 1) / tileHeight;
+
+    fbo = std::make_unique<FramebufferObject>(tileWidth, tileHeight,
+                                              FramebufferObject::ColorAttachment |
+                                              FramebufferObject::DepthAttachment);
+    if (!fbo->isValid())
+    {
+        GetLogger()->error(_("Unable to create a framebuffer of {}x{}\n"), tileWidth, tileHeight);
+        fbo = nullptr;
+        return;
+    }
+
+    tilePixels.resize(rowSize(tileWidth, format) * tileHeight);
+
+    core->setFixedTimeStep(1.0 / options.frameRate);
+    core->resize(options.width, options.height);
+
+    writer = std::thread(&OfflineRenderer::writeImages, this);
+}
+
+
+OfflineRenderer::~OfflineRenderer()
+{
+    if (!isValid())
+        return;
+
+    {
+        std::scoped_lock lock(writerMutex);
+        stopWriting = true;
+    }
+    writerCondition.notify_all();
+    writer.join();
+
+    core->setFixedTimeStep(0.0);
+    core->setRenderOrigin(0, 0);
+    core->resize(savedViewport[2], savedViewport[3]);
+}
+
+
+bool
+OfflineRenderer::isValid() const
+{
+    return fbo != nullptr;
+}
+
+
+int
+OfflineRenderer::getTileCount() const
+{
+    return columns * rows;
+}
+
+
+bool
+OfflineRenderer::renderFrame(MovieCapture *capture)
+{
+    if (!isValid() || getTileCount() != 1 ||
+        capture->getWidth() != options.width || capture->getHeight() != options.height)
+    {
+        return false;
+    }
+
+    // The capture reads the frame back from the framebuffer while it's
+    // bound
+    beginFrame();
+    drawTile(0);
+    bool ok = capture->captureFrame();
+    endFrame();
+    return ok;
+}
+
+
+bool
+OfflineRenderer::renderFrame(const fs::path &filename, bool advance)
+{
+    if (!isValid())
+        return false;
+
+    if (!isImageFile(filename))
+    {
+        GetLogger()->error(_("Unsupported image type: {}!\n"), filename);
+        return false;
+    }
+
+    // Frames can be large, so wait for the previous one to be taken by the
+    // writer before rendering the next
+    {
+        std::unique_lock lock(writerMutex);
+        writerCondition.wait(lock, [this] { return pendingImages.empty() || writeFailed; });
+        if (writeFailed)
+            return false;
+    }
+
+    auto image = std::make_unique<Image>(format, options.width, options.height);
+
+    beginFrame(advance);
+    bool ok = true;
+    for (int tile = 0; ok && tile < getTileCount(); tile++)
+    {
+        drawTile(tile);
+        ok = readTile(tile, *image);
+    }
+    endFrame();
+
+    if (!ok)
+    {
+        GetLogger()->error(_("Unable to capture a frame!\n"));
+        return false;
+    }
+
+    {
+        std::scoped_lock lock(writerMutex);
+        pendingImages.push_back({ filename, std::move(image) });
+    }
+    writerCondition.notify_all();
+    return true;
+}
+
+
+bool
+OfflineRenderer::finish()
+{
+    if (!isValid())
+        return false;
+
+    std::unique_lock lock(writerMutex);
+    writerCondition.wait(lock, [this] { return pendingImages.empty() && !writing; });
+    return !writeFailed;
+}
+
+
+void
+OfflineRenderer::beginFrame(bool advance)
+{
+    if (advance)
+        core->tick();
+
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &savedFramebuffer);
+    fbo->bind();
+}
+
+
+void
+OfflineRenderer::endFrame()
+{
+    core->setRenderOrigin(0, 0);
+    fbo->unbind(savedFramebuffer);
+}
+
+
+void
+OfflineRenderer::drawTile(int tile)
+{
+    core->setRenderOrigin((tile % columns) * tileWidth, (tile / columns) * tileHeight);
+    core->draw();
+}
+
+
+bool
+OfflineRenderer::readTile(int tile, Image &image)
+{
+    int x = (tile % columns) * tileWidth;
+    int y = (tile / columns) * tileHeight;
+    int width = std::min(tileWidth, options.width - x);
+    int height = std::min(tileHeight, options.height - y);
+
+    if (!core->getRenderer()->captureFrame(0, 0, width, height, format, tilePixels.data()))
+        return false;
+
+    // The captured rows are top down, while y counts from the bottom
+    int components = bytesPerPixel(format);
+    std::size_t tilePitch = rowSize(width, format);
+    for (int row = 0; row < height; row++)
+    {
+        std::memcpy(image.getPixelRow(options.height - y - height + row) + x * components,
+                    tilePixels.data() + row * tilePitch,
+                    static_cast<std::size_t>(width) * components);
+    }
+
+    return true;
+}
+
+
+void
+OfflineRenderer::writeImages()
+{
+    std::unique_lock lock(writerMutex);
+    for (;;)
+    {
+        writerCondition.wait(lock, [this] { return !pendingImages.empty() || stopWriting; });
+        if (pendingImages.empty())
+            break;
+
+        PendingImage pending = std::move(pendingImages.front());
+        pendingImages.pop_front();
+        writing = true;
+        lock.unlock();
+        writerCondition.notify_all();
+
+        bool ok = DetermineFileType(pending.filename) == ContentType::JPEG
+            ? SaveJPEGImage(pending.filename, *pending.image)
+            : SavePNGImage(pending.filename, *pending.image);
+        if (!ok)
+            GetLogger()->error(_("Unable to write {}\n"), pending.filename);
+        pending.image = nullptr;
+
+        lock.lock();
+        writing = false;
+        writeFailed = writeFailed || !ok;
+        writerCondition.notify_all();
+    }
+}
@@ -0,0 +1,106 @@
+// offlinerenderer.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Renders frames of a fixed size and time step, independent of the window
+// and the system clock, for exporting movies and image sequences.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celengine/pixelformat.h>
+
+class CelestiaCore;
+class FramebufferObject;
+class Image;
+class MovieCapture;
+
+/*! Renders the frames into a framebuffer object rather than the window, so
+ *  their size isn't limited by it. Frames larger than the largest texture
+ *  are rendered in tiles, by drawing the whole frame with its viewport
+ *  offset so that each tile in turn falls into the framebuffer. Each frame
+ *  advances the simulation by exactly one frame period, however long it
+ *  takes to render, so the output doesn't depend on the speed of the GPU.
+ *
+ *  Images are compressed and written on a worker thread while the next
+ *  frame is rendered.
+ */
+class OfflineRenderer
+{
+ public:
+    struct Options
+    {
+        int width{ 1920 };
+        int height{ 1080 };
+        float frameRate{ 30.0f };
+        // Largest width and height of a tile, zero for the largest the GL
+        // supports
+        int maxTileSize{ 0 };
+    };
+
+    OfflineRenderer(CelestiaCore *core, const Options &options);
+    ~OfflineRenderer();
+
+    OfflineRenderer(const OfflineRenderer&) = delete;
+    OfflineRenderer& operator=(const OfflineRenderer&) = delete;
+
+    bool isValid() const;
+    int getTileCount() const;
+
+    // Render the next frame and pass it to a movie capture started with
+    // the size of the frames, which must not be tiled.
+    bool renderFrame(MovieCapture *capture);
+    // Render the next frame and save it to a PNG or JPEG file. Without
+    // advance, the current state is rendered without a time step.
+    bool renderFrame(const fs::path &filename, bool advance = true);
+    // Wait for the images being written, returning false if any failed.
+    bool finish();
+
+ private:
+    struct PendingImage
+    {
+        fs::path filename;
+        std::unique_ptr<Image> image;
+    };
+
+    void beginFrame(bool advance = true);
+    void endFrame();
+    void drawTile(int tile);
+    bool readTile(int tile, Image &image);
+    void writeImages();
+
+    CelestiaCore *core;
+    Options options;
+    celestia::PixelFormat format;
+    int tileWidth{ 0 };
+    int tileHeight{ 0 };
+    int columns{ 0 };
+    int rows{ 0 };
+    std::unique_ptr<FramebufferObject> fbo;
+    std::vector<unsigned char> tilePixels;
+
+    // window size and framebuffer to restore
+    std::array<int, 4> savedViewport;
+    int savedFramebuffer{ 0 };
+
+    std::thread writer;
+    std::mutex writerMutex;
+    std::condition_variable writerCondition;
+    std::deque<PendingImage> pendingImages;
+    bool writing{ false };
+    bool stopWriting{ false };
+    bool writeFailed{ false };
+};
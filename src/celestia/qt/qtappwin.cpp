@@ -135,7 +135,12 @@ public:
 
     void fatalError(const string& msg)
     {
-        QMessageBox::critical(parent, "Celestia", QString(msg.c_str()));
+        // Errors of the render thread are shown on the GUI thread
+        QString text = QString::fromStdString(msg);
+        QMetaObject::invokeMethod(parent, [this, text]
+        {
+            QMessageBox::critical(parent, "Celestia", text);
+        });
     }
 
 private:
@@ -280,6 +285,7 @@ void CelestiaAppWindow::init(const CelestiaCommandLineOptions& options)
     QSurfaceFormat::setDefaultFormat(glformat);
 
     glWidget = new CelestiaGlWidget(nullptr, "Celestia", m_appCore);
+    glWidget->setThreadedRendering(options.renderThread);
 
     m_appCore->setCursorHandler(glWidget);
     m_appCore->setContextMenuHandler(this);
@@ -593,6 +599,13 @@ void CelestiaAppWindow::saveBookmarks()
 
 void CelestiaAppWindow::celestia_tick()
 {
+    // The render thread ticks the frames it draws
+    if (glWidget->hasRenderThread())
+    {
+        glWidget->requestFrame();
+        return;
+    }
+
     m_appCore->tick();
     glWidget->update();
 }
@@ -626,7 +639,7 @@ void CelestiaAppWindow::slotGrabImage()
 
     if (!saveAsName.isEmpty())
     {
-        QImage grabbedImage = glWidget->grabFramebuffer();
+        QImage grabbedImage = glWidget->grabFrame();
         grabbedImage.save(saveAsName);
     }
     settings.endGroup();
@@ -700,12 +713,17 @@ void CelestiaAppWindow::slotCaptureVideo()
             int br = bitrateEdit->text().toLongLong();
 
             auto *movieCapture = new FFMPEGCapture(m_appCore->getRenderer());
-            movieCapture->setVideoCodec(vc);
             movieCapture->setBitRate(br);
             if (vc == AV_CODEC_ID_H264)
+            {
+                movieCapture->setVideoCodec(vc, m_appCore->getConfig()->h264Encoder);
                 movieCapture->setEncoderOptions(m_appCore->getConfig()->x264EncoderOptions);
+            }
             else
+            {
+                movieCapture->setVideoCodec(vc);
                 movieCapture->setEncoderOptions(m_appCore->getConfig()->ffvhEncoderOptions);
+            }
 
             bool ok = movieCapture->start(saveAsName.toStdString(),
                                           videoSize.width(), videoSize.height(),
@@ -738,7 +756,7 @@ static QImage::Format toQFormat(PixelFormat format)
 
 void CelestiaAppWindow::slotCopyImage()
 {
-    QImage grabbedImage = glWidget->grabFramebuffer();
+    QImage grabbedImage = glWidget->grabFrame();
     QApplication::clipboard()->setImage(grabbedImage);
     m_appCore->flash(_("Captured screen shot to clipboard"));
 }
@@ -1048,7 +1066,7 @@ void CelestiaAppWindow::slotAddBookmark()
     appState.captureState();
 
     // Capture the current frame buffer to use as a bookmark icon.
-    QImage grabbedImage = glWidget->grabFramebuffer();
+    QImage grabbedImage = glWidget->grabFrame();
     int width = grabbedImage.width();
     int height = grabbedImage.height();
 
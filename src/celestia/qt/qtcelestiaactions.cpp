@@ -13,6 +13,7 @@
 #include <QAction>
 #include <QActionGroup>
 #include <QMenu>
+#include <QThread>
 
 #include <celengine/body.h>
 #include <celestia/celestiacore.h>
@@ -310,6 +311,13 @@ void CelestiaActions::syncWithAppCore()
 
 void CelestiaActions::notifyRenderSettingsChanged(const Renderer* renderer)
 {
+    // Settings changed by scripts running on the render thread
+    if (QThread::currentThread() != thread())
+    {
+        QMetaObject::invokeMethod(this, [this, renderer] { syncWithRenderer(renderer); }, Qt::QueuedConnection);
+        return;
+    }
+
     syncWithRenderer(renderer);
 }
 
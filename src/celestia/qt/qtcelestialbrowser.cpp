@@ -11,6 +11,7 @@
 // of the License, or (at your option) any later version.
 
 #include <celestia/celestiacore.h>
+#include <celengine/starquery.h>
 #include <celutil/gettext.h>
 #include <celutil/greek.h>
 #include "qtcelestialbrowser.h"
@@ -31,8 +32,8 @@
 #include <QRegExp>
 #include <QFontMetrics>
 #include <QCollator>
+#include <QTimer>
 #include <vector>
-#include <set>
 
 using namespace Eigen;
 using namespace std;
@@ -94,6 +95,8 @@ public:
     int rowCount(const QModelIndex& index) const override;
     int columnCount(const QModelIndex& index) const override;
     void sort(int column, Qt::SortOrder order) override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
 
     // Methods from ModelHelper
     Selection itemForInfoPanel(const QModelIndex&) override;
@@ -114,19 +117,29 @@ public:
         SpectralTypeColumn = 4,
     };
 
+    // Start searching for the stars to list in the background; update()
+    // shows them once found.
     void populate(const UniversalCoord& _observerPos,
                   double _now,
-                  StarFilterPredicate& filterPred,
+                  const StarFilterPredicate& filterPred,
                   StarPredicate::Criterion criterion,
                   unsigned int nStars);
+    bool update();
 
     Selection itemAtRow(unsigned int row) const;
+    // Number of stars found, including those not yet shown
+    std::size_t getStarCount() const { return stars.size(); }
 
 private:
     const Universe* universe;
     UniversalCoord observerPos{ 0.0, 0.0, 0.0 };
     double now{ astro::J2000 };
     vector<Star*> stars;
+    // The rows are added to the view in batches as it scrolls down to them
+    std::size_t shownStars{ 0 };
+    celestia::engine::StarQuery query;
+
+    static constexpr std::size_t FetchBatchSize = 100;
 };
 
 Selection StarTableModel::objectAtIndex(const QModelIndex& _index) const
@@ -148,7 +161,7 @@ Qt::ItemFlags StarTableModel::flags(const QModelIndex& /*unused*/) const
 QVariant StarTableModel::data(const QModelIndex& index, int role) const
 {
     int row = index.row();
-    if (row < 0 || row >= (int) stars.size())
+    if (row < 0 || row >= (int) shownStars)
     {
         // Out of range
         return QVariant();
@@ -237,7 +250,27 @@ QVariant StarTableModel::headerData(int section, Qt::Orientation /* orientation
 // Override QAbstractDataModel::rowCount()
 int StarTableModel::rowCount(const QModelIndex& /*unused*/) const
 {
-    return (int) stars.size();
+    return (int) shownStars;
+}
+
+
+// Override QAbstractItemModel::canFetchMore()
+bool StarTableModel::canFetchMore(const QModelIndex& parent) const
+{
+    return !parent.isValid() && shownStars < stars.size();
+}
+
+
+// Override QAbstractItemModel::fetchMore()
+void StarTableModel::fetchMore(const QModelIndex& parent)
+{
+    if (!canFetchMore(parent))
+        return;
+
+    std::size_t count = std::min(FetchBatchSize, stars.size() - shownStars);
+    beginInsertRows(QModelIndex(), (int) shownStars, (int) (shownStars + count - 1));
+    shownStars += count;
+    endInsertRows();
 }
 
 
@@ -385,90 +418,50 @@ void StarTableModel::sort(int column, Qt::SortOrder order)
     if (order == Qt::DescendingOrder)
         reverse(stars.begin(), stars.end());
 
-    dataChanged(index(0, 0), index(stars.size() - 1, 4));
+    // All the stars found are sorted, so the rows shown are the first ones
+    // in the new order
+    if (shownStars > 0)
+        dataChanged(index(0, 0), index((int) shownStars - 1, 4));
 }
 
 
 void StarTableModel::populate(const UniversalCoord& _observerPos,
                               double _now,
-                              StarFilterPredicate& filterPred,
+                              const StarFilterPredicate& filterPred,
                               StarPredicate::Criterion criterion,
                               unsigned int nStars)
 {
-    const StarDatabase& stardb = *universe->getStarCatalog();
-
     observerPos = _observerPos;
     now = _now;
 
-    typedef multiset<Star*, StarPredicate> StarSet;
-    StarPredicate pred(criterion, observerPos, universe);
-
-    // Apply the filter
-    vector<Star*> filteredStars;
-    unsigned int totalStars = stardb.size();
-    unsigned int i = 0;
-    filteredStars.reserve(totalStars);
-    for (i = 0; i < totalStars; i++)
-    {
-        Star* star = stardb.getStar(i);
-        if (!filterPred(star))
-            filteredStars.push_back(star);
-    }
-
-    // Don't try and show more stars than remain after the filter
-    if (filteredStars.size() < nStars)
-        nStars = filteredStars.size();
-
     // Clear out the results of the previous populate() call
     if (stars.size() != 0)
     {
         beginResetModel();
         stars.clear();
+        shownStars = 0;
         endResetModel();
     }
 
-    if (filteredStars.empty())
-        return;
-
-    StarSet firstStars(pred);
+    StarPredicate pred(criterion, observerPos, universe);
+    query.start(*universe->getStarCatalog(), pred, filterPred, nStars);
+}
 
-    // We'll need at least nStars in the set, so first fill
-    // up the list indiscriminately.
-    for (i = 0; i < nStars; i++)
-    {
-        firstStars.insert(filteredStars[i]);
-    }
 
-    // From here on, only add a star to the set if it's
-    // A better match than the worst matching star already
-    // in the set.
-    const Star* lastStar = *--firstStars.end();
-    for (; i < filteredStars.size(); i++)
-    {
-        Star* star = filteredStars[i];
-        if (pred(star, lastStar))
-        {
-            firstStars.insert(star);
-            firstStars.erase(--firstStars.end());
-            lastStar = *--firstStars.end();
-        }
-    }
-
-    // Move the best matching stars into the vector
-    stars.reserve(nStars);
-    for (const auto& star : firstStars)
-    {
-        stars.push_back(star);
-    }
+bool StarTableModel::update()
+{
+    if (!query.ready())
+        return false;
 
-    beginInsertRows(QModelIndex(), 0, stars.size());
-    endInsertRows();
+    stars = query.get();
+    fetchMore(QModelIndex());
+    return true;
 }
 
 
 Selection StarTableModel::itemAtRow(unsigned int row) const
 {
-    if (row >= stars.size())
+    if (row >= shownStars)
         return Selection();
     else
         return Selection(stars[row]);
@@ -620,6 +613,11 @@ CelestialBrowser::CelestialBrowser(CelestiaCore* _appCore, QWidget* parent, Info
     layout->addWidget(markGroup);
     // End marking group
 
+    // The stars are searched in the background; poll for the results
+    queryTimer = new QTimer(this);
+    queryTimer->setInterval(50);
+    connect(queryTimer, &QTimer::timeout, this, &CelestialBrowser::slotCheckQuery);
+
     slotRefreshTable();
 
     setLayout(layout);
@@ -672,12 +670,23 @@ void CelestialBrowser::slotRefreshTable()
     }
 
     starModel->populate(observerPos, now, filterPred, criterion, 1000);
+    searchResultLabel->setText(QString(_("Searching...")));
+    queryTimer->start();
+}
+
+
+void CelestialBrowser::slotCheckQuery()
+{
+    if (!starModel->update())
+        return;
+
+    queryTimer->stop();
 
     treeView->resizeColumnToContents(StarTableModel::DistanceColumn);
     treeView->resizeColumnToContents(StarTableModel::AppMagColumn);
     treeView->resizeColumnToContents(StarTableModel::AbsMagColumn);
 
-    searchResultLabel->setText(QString(_("%1 objects found")).arg(starModel->rowCount(QModelIndex())));
+    searchResultLabel->setText(QString(_("%1 objects found")).arg(starModel->getStarCount()));
 }
 
 
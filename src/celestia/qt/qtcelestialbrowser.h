@@ -25,6 +25,7 @@ class QComboBox;
 class QCheckBox;
 class QLabel;
 class QLineEdit;
+class QTimer;
 class ColorSwatchWidget;
 class CelestiaCore;
 class InfoPanel;
@@ -43,6 +44,7 @@ Q_OBJECT
     void slotUncheckMultipleFilterBox();
     void slotUncheckBarycentersFilterBox();
     void slotRefreshTable();
+    void slotCheckQuery();
     void slotContextMenu(const QPoint& pos);
     void slotMarkSelected();
     void slotUnmarkSelected();
@@ -74,6 +76,8 @@ Q_OBJECT
 
     ColorSwatchWidget* colorSwatch{nullptr};
     InfoPanel* infoPanel{nullptr};
+
+    QTimer* queryTimer{nullptr};
 };
 
 #endif // _QTCELESTIALBROWSER_H_
@@ -19,6 +19,7 @@ CelestiaCommandLineOptions ParseCommandLine(const QCoreApplication& app)
         { { "s", "nosplash" }, _("Skip the splash screen.") },
         { { "u", "url" }, _("Set the start cel:// URL or startup script path."), _("url") },
         { { "l", "log" }, _("Set the path to the log file."), _("logpath") },
+        { "render-thread", _("Render on a thread separate from the user interface.") },
     });
 
     parser.process(app);
@@ -52,6 +53,7 @@ CelestiaCommandLineOptions ParseCommandLine(const QCoreApplication& app)
 
     options.skipSplashScreen = parser.isSet("nosplash");
     options.startFullscreen = parser.isSet("fullscreen");
+    options.renderThread = parser.isSet("render-thread");
 
     return options;
 }
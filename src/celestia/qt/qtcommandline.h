@@ -24,6 +24,7 @@ struct CelestiaCommandLineOptions
     QString configFileName{ };
     bool skipSplashScreen{ false };
     bool startFullscreen{ false };
+    bool renderThread{ false };
 };
 
 CelestiaCommandLineOptions ParseCommandLine(const QCoreApplication&);
@@ -31,6 +31,7 @@
 #include <celengine/body.h>
 #include <celestia/celestiacore.h>
 #include <celestia/eclipsefinder.h>
+#include <celestia/eventfinder.h>
 #include <celmath/distance.h>
 #include <celmath/intersect.h>
 #include <celmath/geomutil.h>
@@ -66,7 +67,7 @@ static QDateTime TDBToQDate(double tdb)
 class EventTableModel : public QAbstractTableModel
 {
 public:
-    EventTableModel() = default;
+    explicit EventTableModel(const Universe* _universe) : universe(_universe) {}
     virtual ~EventTableModel() = default;
 
     // Methods from QAbstractTableModel
@@ -78,8 +79,10 @@ public:
     void sort(int column, Qt::SortOrder order) override;
 
     void setEclipses(const vector<Eclipse>& _eclipses);
+    void setEvents(const vector<CelestialEvent>& _events);
 
     const Eclipse* eclipseAtIndex(const QModelIndex& index) const;
+    const CelestialEvent* eventAtIndex(const QModelIndex& index) const;
 
     enum
     {
@@ -90,10 +93,47 @@ public:
     };
 
 private:
+    QString getObjectName(const Selection& sel) const;
+    QVariant eventData(const CelestialEvent& event, int column) const;
+
+    const Universe* universe;
+
+    // Only one of these is used at a time: the objects of events are shown
+    // in the occulter column, and their targets as eclipsed bodies.
     vector<Eclipse> eclipses;
+    vector<CelestialEvent> events;
 };
 
 
+QString EventTableModel::getObjectName(const Selection& sel) const
+{
+    if (sel.star() != nullptr)
+        return QString(universe->getStarCatalog()->getStarName(*sel.star(), true).c_str());
+    return QString(sel.getName(true).c_str());
+}
+
+
+QVariant EventTableModel::eventData(const CelestialEvent& event, int column) const
+{
+    switch (column)
+    {
+    case ReceiverColumn:
+        return getObjectName(event.target);
+    case OcculterColumn:
+        return getObjectName(event.object);
+    case StartTimeColumn:
+        return TDBToQDate(event.startTime).toLocalTime().toString("dd MMM yyyy hh:mm");
+    case DurationColumn:
+    {
+        int minutes = (int) ((event.endTime - event.startTime) * 24 * 60);
+        return QString("%1:%2").arg(minutes / 60).arg(minutes % 60, 2, 10, QLatin1Char('0'));
+    }
+    default:
+        return QVariant();
+    }
+}
+
+
 Qt::ItemFlags EventTableModel::flags(const QModelIndex& /*unused*/) const
 {
     return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
@@ -102,7 +142,7 @@ Qt::ItemFlags EventTableModel::flags(const QModelIndex& /*unused*/) const
 
 QVariant EventTableModel::data(const QModelIndex& index, int role) const
 {
-    if (index.row() < 0 || index.row() >= (int) eclipses.size())
+    if (index.row() < 0 || index.row() >= rowCount(QModelIndex()))
     {
         // Out of range
         return QVariant();
@@ -113,6 +153,9 @@ QVariant EventTableModel::data(const QModelIndex& index, int role) const
         return QVariant();
     }
 
+    if (!events.empty())
+        return eventData(events[index.row()], index.column());
+
     const Eclipse& eclipse = eclipses[index.row()];
 
     switch (index.column())
@@ -157,7 +200,7 @@ QVariant EventTableModel::headerData(int section, Qt::Orientation /*unused*/, in
 
 int EventTableModel::rowCount(const QModelIndex& /*unused*/) const
 {
-    return (int) eclipses.size();
+    return (int) (eclipses.size() + events.size());
 }
 
 
@@ -189,10 +232,33 @@ void EventTableModel::sort(int column, Qt::SortOrder order)
         break;
     }
 
+    switch (column)
+    {
+    case ReceiverColumn:
+        std::sort(events.begin(), events.end(),
+                  [](const CelestialEvent& e0, const CelestialEvent& e1) { return e0.target.getName() < e1.target.getName(); });
+        break;
+    case OcculterColumn:
+        std::sort(events.begin(), events.end(),
+                  [](const CelestialEvent& e0, const CelestialEvent& e1) { return e0.object.getName() < e1.object.getName(); });
+        break;
+    case StartTimeColumn:
+        std::sort(events.begin(), events.end(),
+                  [](const CelestialEvent& e0, const CelestialEvent& e1) { return e0.startTime < e1.startTime; });
+        break;
+    case DurationColumn:
+        std::sort(events.begin(), events.end(),
+                  [](const CelestialEvent& e0, const CelestialEvent& e1) { return e0.endTime - e0.startTime < e1.endTime - e1.startTime; });
+        break;
+    }
+
     if (order == Qt::DescendingOrder)
+    {
         reverse(eclipses.begin(), eclipses.end());
+        reverse(events.begin(), events.end());
+    }
 
-    dataChanged(index(0, 0), index(eclipses.size() - 1, columnCount(QModelIndex())));
+    dataChanged(index(0, 0), index(rowCount(QModelIndex()) - 1, columnCount(QModelIndex())));
 }
 
 
@@ -200,6 +266,16 @@ void EventTableModel::setEclipses(const vector<Eclipse>& _eclipses)
 {
     beginResetModel();
     eclipses = _eclipses;
+    events.clear();
+    endResetModel();
+}
+
+
+void EventTableModel::setEvents(const vector<CelestialEvent>& _events)
+{
+    beginResetModel();
+    events = _events;
+    eclipses.clear();
     endResetModel();
 }
 
@@ -214,6 +290,16 @@ const Eclipse* EventTableModel::eclipseAtIndex(const QModelIndex& index) const
 }
 
 
+const CelestialEvent* EventTableModel::eventAtIndex(const QModelIndex& index) const
+{
+    int row = index.row();
+    if (row >= 0 && row < (int) events.size())
+        return &events[row];
+    else
+        return nullptr;
+}
+
+
 EventFinder::EventFinder(CelestiaCore* _appCore,
                          const QString& title,
                          QWidget* parent) :
@@ -242,10 +328,12 @@ EventFinder::EventFinder(CelestiaCore* _appCore,
     solarOnlyButton = new QRadioButton(_("Solar eclipses"));
     lunarOnlyButton = new QRadioButton(_("Lunar eclipses"));
     allEclipsesButton = new QRadioButton(_("All eclipses"));
+    occultationsButton = new QRadioButton(_("Transits and occultations"));
 
     eclipseTypeLayout->addWidget(solarOnlyButton);
     eclipseTypeLayout->addWidget(lunarOnlyButton);
     eclipseTypeLayout->addWidget(allEclipsesButton);
+    eclipseTypeLayout->addWidget(occultationsButton);
     eclipseTypeBox->setLayout(eclipseTypeLayout);
 
     // Search the search range box
@@ -293,14 +381,14 @@ EventFinder::EventFinder(CelestiaCore* _appCore,
     endDateEdit->setDate(now.addYears(1));
     solarOnlyButton->setChecked(true);
 
-    model = new EventTableModel();
+    model = new EventTableModel(appCore->getSimulation()->getUniverse());
     eventTable->setModel(model);
 
     this->setWidget(finderWidget);
 }
 
 
-EclipseFinderWatcher::Status EventFinder::eclipseFinderProgressUpdate(double t)
+bool EventFinder::updateProgress(double t)
 {
     if (progress != nullptr)
     {
@@ -315,9 +403,63 @@ EclipseFinderWatcher::Status EventFinder::eclipseFinderProgressUpdate(double t)
             lastProgressUpdate = t;
         }
 
-        return progress->wasCanceled() ? AbortOperation : ContinueOperation;
+        return progress->wasCanceled();
+    }
+    return false;
+}
+
+
+EclipseFinderWatcher::Status EventFinder::eclipseFinderProgressUpdate(double t)
+{
+    return updateProgress(t) ? EclipseFinderWatcher::AbortOperation : EclipseFinderWatcher::ContinueOperation;
+}
+
+
+EventSearchWatcher::Status EventFinder::eventSearchProgressUpdate(double t)
+{
+    return updateProgress(t) ? EventSearchWatcher::AbortOperation : EventSearchWatcher::ContinueOperation;
+}
+
+
+/*! Find the transits and occultations of the Sun, the planets and the moons
+ *  of the observer as seen from it.
+ */
+void EventFinder::findOccultations(Body* observer, double startTime, double endTime)
+{
+    constexpr int OccultingObjectMask = Body::Planet | Body::DwarfPlanet | Body::Moon;
+
+    vector<Selection> objects;
+    const Star* sun = observer->getSystem()->getStar();
+    if (sun != nullptr)
+    {
+        const SolarSystem* solarSystem = appCore->getSimulation()->getUniverse()->getSolarSystem(sun);
+        const PlanetarySystem* planets = solarSystem != nullptr ? solarSystem->getPlanets() : nullptr;
+        for (int i = 0; planets != nullptr && i < planets->getSystemSize(); i++)
+        {
+            Body* planet = planets->getBody(i);
+            if ((planet->getClassification() & OccultingObjectMask) != 0 && planet != observer)
+                objects.emplace_back(planet);
+        }
+    }
+
+    const PlanetarySystem* satellites = observer->getSatellites();
+    for (int i = 0; satellites != nullptr && i < satellites->getSystemSize(); i++)
+    {
+        Body* moon = satellites->getBody(i);
+        if ((moon->getClassification() & OccultingObjectMask) != 0)
+            objects.emplace_back(moon);
     }
-    return EclipseFinderWatcher::ContinueOperation;
+
+    vector<Selection> targets = objects;
+    if (sun != nullptr)
+        targets.emplace_back(const_cast<Star*>(sun));
+
+    CelestialEventFinder finder(this);
+    finder.addOccultations(Selection(observer), objects, targets);
+
+    vector<CelestialEvent> events;
+    finder.findEvents(startTime, endTime, events);
+    model->setEvents(events);
 }
 
 
@@ -350,7 +492,6 @@ void EventFinder::slotFindEclipses()
         return;
     }
 
-    EclipseFinder finder(obj.body(), this);
     searchTimer.start();
 
     double startTimeTDB = QDateToTDB(startDate);
@@ -365,16 +506,23 @@ void EventFinder::slotFindEclipses()
     progress->show();
 
 
-    vector<Eclipse> eclipses;
-    finder.findEclipses(startTimeTDB, endTimeTDB,
-                        eclipseTypeMask,
-                        eclipses);
+    if (occultationsButton->isChecked())
+    {
+        findOccultations(obj.body(), startTimeTDB, endTimeTDB);
+    }
+    else
+    {
+        EclipseFinder finder(obj.body(), this);
+        vector<Eclipse> eclipses;
+        finder.findEclipses(startTimeTDB, endTimeTDB,
+                            eclipseTypeMask,
+                            eclipses);
+        model->setEclipses(eclipses);
+    }
 
     delete progress;
     progress = nullptr;
 
-    model->setEclipses(eclipses);
-
     eventTable->resizeColumnToContents(EventTableModel::OcculterColumn);
     eventTable->resizeColumnToContents(EventTableModel::ReceiverColumn);
     eventTable->resizeColumnToContents(EventTableModel::StartTimeColumn);
@@ -385,8 +533,21 @@ void EventFinder::slotContextMenu(const QPoint& pos)
 {
     QModelIndex index = eventTable->indexAt(pos);
     activeEclipse = model->eclipseAtIndex(index);
+    activeEvent = model->eventAtIndex(index);
+
+    if (activeEvent != nullptr)
+    {
+        if (contextMenu == nullptr)
+            contextMenu = new QMenu(this);
+        contextMenu->clear();
+
+        QAction* setTimeAction = new QAction(_("Set time to mid-event"), contextMenu);
+        connect(setTimeAction, SIGNAL(triggered()), this, SLOT(slotSetEclipseTime()));
+        contextMenu->addAction(setTimeAction);
 
-    if (activeEclipse != nullptr)
+        contextMenu->popup(eventTable->mapToGlobal(pos), setTimeAction);
+    }
+    else if (activeEclipse != nullptr)
     {
         if (contextMenu == nullptr)
             contextMenu = new QMenu(this);
@@ -419,6 +580,12 @@ void EventFinder::slotContextMenu(const QPoint& pos)
 
 void EventFinder::slotSetEclipseTime()
 {
+    if (activeEvent != nullptr)
+    {
+        appCore->getSimulation()->setTime(activeEvent->extremeTime);
+        return;
+    }
+
     double midEclipseTime = (activeEclipse->startTime + activeEclipse->endTime) / 2.0;
     appCore->getSimulation()->setTime(midEclipseTime);
 }
@@ -16,6 +16,7 @@
 #include <QDockWidget>
 #include <QElapsedTimer>
 #include <celestia/eclipsefinder.h>
+#include <celestia/eventsearch.h>
 
 class QTreeView;
 class QRadioButton;
@@ -25,8 +26,9 @@ class QProgressDialog;
 class QMenu;
 class EventTableModel;
 class CelestiaCore;
+struct CelestialEvent;
 
-class EventFinder : public QDockWidget, EclipseFinderWatcher
+class EventFinder : public QDockWidget, EclipseFinderWatcher, EventSearchWatcher
 {
     Q_OBJECT
 
@@ -35,6 +37,7 @@ class EventFinder : public QDockWidget, EclipseFinderWatcher
     ~EventFinder() = default;
 
     EclipseFinderWatcher::Status eclipseFinderProgressUpdate(double t);
+    EventSearchWatcher::Status eventSearchProgressUpdate(double t);
 
  public slots:
     void slotFindEclipses();
@@ -47,11 +50,16 @@ class EventFinder : public QDockWidget, EclipseFinderWatcher
     void slotViewBehindOccluder();
 
  private:
+    // Show the progress, return true if the search was canceled
+    bool updateProgress(double t);
+    void findOccultations(Body* observer, double startTime, double endTime);
+
     CelestiaCore* appCore;
 
     QRadioButton* solarOnlyButton{ nullptr };
     QRadioButton* lunarOnlyButton{ nullptr };
     QRadioButton* allEclipsesButton{ nullptr };
+    QRadioButton* occultationsButton{ nullptr };
 
     QDateEdit* startDateEdit{ nullptr };
     QDateEdit* endDateEdit{ nullptr };
@@ -69,6 +77,7 @@ class EventFinder : public QDockWidget, EclipseFinderWatcher
     QElapsedTimer searchTimer;
 
     const Eclipse* activeEclipse{ nullptr };
+    const CelestialEvent* activeEvent{ nullptr };
 };
 
 #endif // _QTEVENTFINDER_H_
@@ -27,6 +27,7 @@
 #include <QMouseEvent>
 #include <QSettings>
 #include <QMessageBox>
+#include <QTimer>
 
 #ifndef DEBUG
 #  define G_DISABLE_ASSERT
@@ -40,6 +41,7 @@
 #include <celutil/filetype.h>
 #include <celutil/gettext.h>
 #include "qtglwidget.h"
+#include "qtrenderthread.h"
 
 
 using namespace Qt;
@@ -78,6 +80,36 @@ CelestiaGlWidget::CelestiaGlWidget(QWidget* parent, const char* /* name */, Cele
 }
 
 
+CelestiaGlWidget::~CelestiaGlWidget()
+{
+    // Stop rendering while the widget is complete
+    renderThread = nullptr;
+}
+
+
+void CelestiaGlWidget::setThreadedRendering(bool enable)
+{
+    threadedRendering = enable;
+}
+
+
+void CelestiaGlWidget::requestFrame()
+{
+    if (renderThread != nullptr)
+        renderThread->requestFrame();
+    else
+        update();
+}
+
+
+QImage CelestiaGlWidget::grabFrame()
+{
+    if (renderThread != nullptr)
+        renderThread->waitForFrame();
+    return grabFramebuffer();
+}
+
+
 /*!
   Paint the box. The actual openGL commands for drawing the box are
   performed here.
@@ -89,6 +121,14 @@ void CelestiaGlWidget::paintGL()
 }
 
 
+void CelestiaGlWidget::paintEvent(QPaintEvent* e)
+{
+    // The render thread draws the frames, painting only composes them
+    if (renderThread == nullptr)
+        QOpenGLWidget::paintEvent(e);
+}
+
+
 /*!
   Set up the OpenGL rendering state, and define display list
 */
@@ -139,6 +179,10 @@ void CelestiaGlWidget::initializeGL()
 
     appRenderer->setSolarSystemMaxDistance(appCore->getConfig()->SolarSystemMaxDistance);
     appRenderer->setShadowMapSize(appCore->getConfig()->ShadowMapSize);
+
+    // The context can only be handed over once it's no longer current
+    if (threadedRendering)
+        QTimer::singleShot(0, this, [this] { renderThread = std::make_unique<CelestiaRenderThread>(this, appCore); });
 }
 
 
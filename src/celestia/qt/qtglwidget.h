@@ -14,9 +14,11 @@
 #ifndef QTGLWIDGET_H
 #define QTGLWIDGET_H
 
+#include <memory>
 #include <string>
 #include <vector>
 
+#include <QImage>
 #include <QOpenGLWidget>
 
 #include "celestia/celestiacore.h"
@@ -24,6 +26,8 @@
 #include <celengine/starbrowser.h>
 #include "qtdraghandler.h"
 
+class CelestiaRenderThread;
+
 /**
   *@author Christophe Teyssier
   */
@@ -34,14 +38,24 @@ class CelestiaGlWidget : public QOpenGLWidget, public CelestiaCore::CursorHandle
 
 public:
     CelestiaGlWidget(QWidget* parent, const char* name, CelestiaCore* core);
-    ~CelestiaGlWidget() = default;
+    ~CelestiaGlWidget();
 
     void setCursorShape(CelestiaCore::CursorShape);
     CelestiaCore::CursorShape getCursorShape() const;
 
+    // Tick and draw the frames on a thread of their own, started once
+    // OpenGL is initialized; set before the widget is shown
+    void setThreadedRendering(bool);
+    bool hasRenderThread() const { return renderThread != nullptr; }
+    // Ask the render thread for a frame
+    void requestFrame();
+    // grabFramebuffer(), once the render thread is done with the context
+    QImage grabFrame();
+
 protected:
     void initializeGL();
     void paintGL();
+    void paintEvent(QPaintEvent* e) override;
     void resizeGL( int w, int h );
     virtual void mouseMoveEvent(QMouseEvent* m );
     virtual void mousePressEvent(QMouseEvent* m );
@@ -63,6 +77,8 @@ private:
     bool cursorVisible;
     std::unique_ptr<DragHandler> dragHandler;
     CelestiaCore::CursorShape currentCursor;
+    bool threadedRendering{ false };
+    std::unique_ptr<CelestiaRenderThread> renderThread;
 
     //KActionCollection* actionColl;
 
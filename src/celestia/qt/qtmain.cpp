@@ -35,6 +35,32 @@
 #include "qtappwin.h"
 #include "qtcommandline.h"
 #include "qtgettext.h"
+#include "qtrenderthread.h"
+
+namespace
+{
+
+// Delivers the events which may use the core holding the core lock when
+// rendering runs on a thread
+class CelestiaApplication : public QApplication
+{
+public:
+    using QApplication::QApplication;
+
+    bool notify(QObject* receiver, QEvent* event) override
+    {
+        CelestiaCoreLock& lock = CelestiaCoreLock::get();
+        if (!lock.isEnabled() || !CelestiaCoreLock::needsCore(event))
+            return QApplication::notify(receiver, event);
+
+        lock.beginEvent();
+        bool result = QApplication::notify(receiver, event);
+        lock.endEvent();
+        return result;
+    }
+};
+
+} // end unnamed namespace
 
 int main(int argc, char *argv[])
 {
@@ -43,7 +69,7 @@ int main(int argc, char *argv[])
 #else
     QCoreApplication::setAttribute(Qt::AA_UseOpenGLES);
 #endif
-    QApplication app(argc, argv);
+    CelestiaApplication app(argc, argv);
 
     // Gettext integration
     setlocale(LC_ALL, "");
@@ -0,0 +1,223 @@
+// qtrenderthread.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Rendering thread for the Qt front-end.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "qtrenderthread.h"
+
+#include <QAbstractEventDispatcher>
+#include <QEvent>
+#include <QMutexLocker>
+#include <QOpenGLContext>
+
+#include <celestia/celestiacore.h>
+#include "qtglwidget.h"
+
+
+CelestiaCoreLock&
+CelestiaCoreLock::get()
+{
+    static CelestiaCoreLock lock;
+    return lock;
+}
+
+
+void
+CelestiaCoreLock::enable()
+{
+    if (enabled)
+        return;
+
+    enabled = true;
+    QAbstractEventDispatcher* dispatcher = QAbstractEventDispatcher::instance();
+    QObject::connect(dispatcher, &QAbstractEventDispatcher::aboutToBlock, [this] { release(); });
+    QObject::connect(dispatcher, &QAbstractEventDispatcher::awake, [this]
+    {
+        // Back in an event loop nested in the delivery of an event
+        if (eventDepth > 0)
+            acquire();
+    });
+}
+
+
+bool
+CelestiaCoreLock::needsCore(const QEvent* event)
+{
+    switch (event->type())
+    {
+    case QEvent::Paint:
+    case QEvent::UpdateRequest:
+    case QEvent::UpdateLater:
+    case QEvent::LayoutRequest:
+    case QEvent::Polish:
+    case QEvent::PolishRequest:
+    case QEvent::Expose:
+    case QEvent::Move:
+    case QEvent::ChildAdded:
+    case QEvent::ChildPolished:
+    case QEvent::ChildRemoved:
+    case QEvent::Enter:
+    case QEvent::Leave:
+    case QEvent::HoverEnter:
+    case QEvent::HoverLeave:
+    case QEvent::HoverMove:
+        return false;
+    default:
+        return true;
+    }
+}
+
+
+void
+CelestiaCoreLock::beginEvent()
+{
+    ++eventDepth;
+    acquire();
+}
+
+
+void
+CelestiaCoreLock::endEvent()
+{
+    if (--eventDepth == 0)
+        release();
+}
+
+
+void
+CelestiaCoreLock::acquire()
+{
+    if (!held)
+    {
+        mutex.lock();
+        held = true;
+    }
+}
+
+
+void
+CelestiaCoreLock::release()
+{
+    if (held)
+    {
+        mutex.unlock();
+        held = false;
+    }
+}
+
+
+CelestiaRenderThread::CelestiaRenderThread(CelestiaGlWidget* _widget, CelestiaCore* _appCore) :
+    widget(_widget),
+    appCore(_appCore),
+    guiThread(QThread::currentThread()),
+    worker(std::make_unique<QObject>())
+{
+    CelestiaCoreLock::get().enable();
+
+    // The GUI thread needs the context while it composes and resizes
+    connect(widget, &QOpenGLWidget::aboutToCompose, this, [this] { waitForFrame(); });
+    connect(widget, &QOpenGLWidget::aboutToResize, this, [this] { waitForFrame(); });
+    connect(widget, &QOpenGLWidget::frameSwapped, this, [this]
+    {
+        composePending = false;
+        if (framePending && !frameInFlight)
+            startFrame();
+    });
+
+    worker->moveToThread(&thread);
+    thread.setObjectName("Render");
+    thread.start();
+}
+
+
+CelestiaRenderThread::~CelestiaRenderThread()
+{
+    waitForFrame();
+    thread.quit();
+    thread.wait();
+}
+
+
+void
+CelestiaRenderThread::requestFrame()
+{
+    framePending = true;
+    // A hidden widget isn't composed, so it doesn't render until shown
+    if (!frameInFlight && !composePending)
+        startFrame();
+}
+
+
+void
+CelestiaRenderThread::waitForFrame()
+{
+    QMutexLocker locker(&stateMutex);
+    if (!rendering)
+        return;
+
+    // The frame can't finish while the GUI thread has the core
+    CelestiaCoreLock& lock = CelestiaCoreLock::get();
+    bool wasHeld = lock.isHeld();
+    lock.release();
+
+    while (rendering)
+        frameDone.wait(&stateMutex);
+
+    locker.unlock();
+    if (wasHeld)
+        lock.acquire();
+}
+
+
+void
+CelestiaRenderThread::startFrame()
+{
+    framePending = false;
+    frameInFlight = true;
+
+    widget->doneCurrent();
+    widget->context()->moveToThread(&thread);
+    {
+        QMutexLocker locker(&stateMutex);
+        rendering = true;
+    }
+
+    QMetaObject::invokeMethod(worker.get(), [this] { render(); }, Qt::QueuedConnection);
+}
+
+
+void
+CelestiaRenderThread::render()
+{
+    CelestiaCoreLock& lock = CelestiaCoreLock::get();
+    lock.lockForRendering();
+    widget->makeCurrent();
+    appCore->tick();
+    appCore->draw();
+    widget->doneCurrent();
+    lock.unlockForRendering();
+
+    widget->context()->moveToThread(guiThread);
+    {
+        QMutexLocker locker(&stateMutex);
+        rendering = false;
+    }
+    frameDone.wakeAll();
+
+    QMetaObject::invokeMethod(this, [this] { frameRendered(); }, Qt::QueuedConnection);
+}
+
+
+void
+CelestiaRenderThread::frameRendered()
+{
+    frameInFlight = false;
+    composePending = true;
+    widget->update();
+}
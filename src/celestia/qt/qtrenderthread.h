@@ -0,0 +1,106 @@
+// qtrenderthread.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Rendering thread for the Qt front-end.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <memory>
+
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+#include <QWaitCondition>
+
+class CelestiaCore;
+class CelestiaGlWidget;
+class QEvent;
+
+// CelestiaCore isn't thread safe, so the GUI thread and the render thread
+// take turns using it. The GUI thread holds the lock while it delivers
+// the events which may use the core, and lets go of it whenever it waits
+// for events, in the nested event loops of modal dialogs too. The render
+// thread holds it while it ticks and draws a frame. Painting and layout
+// events don't take the lock, so the other widgets are redrawn while a
+// frame renders.
+class CelestiaCoreLock
+{
+public:
+    static CelestiaCoreLock& get();
+
+    // Called on the GUI thread; until then the lock does nothing
+    void enable();
+    bool isEnabled() const { return enabled; }
+
+    static bool needsCore(const QEvent* event);
+
+    // On the GUI thread, around the delivery of an event
+    void beginEvent();
+    void endEvent();
+
+    // On the GUI thread
+    bool isHeld() const { return held; }
+    void acquire();
+    void release();
+
+    // On the render thread
+    void lockForRendering() { mutex.lock(); }
+    void unlockForRendering() { mutex.unlock(); }
+
+private:
+    CelestiaCoreLock() = default;
+
+    QMutex mutex;
+    bool enabled{ false };
+    // State of the GUI thread
+    int eventDepth{ 0 };
+    bool held{ false };
+};
+
+
+// Ticks and draws the frames of a CelestiaGlWidget on a thread. The
+// OpenGL context of the widget is handed to the thread for each frame
+// and back to the GUI thread, which composes the frame and resizes the
+// widget, once it's drawn.
+class CelestiaRenderThread : public QObject
+{
+    Q_OBJECT
+
+public:
+    CelestiaRenderThread(CelestiaGlWidget* widget, CelestiaCore* appCore);
+    ~CelestiaRenderThread() override;
+
+    // Render a frame once the last one is drawn and composed
+    void requestFrame();
+    // Wait for the frame being drawn, if any, so that the context of the
+    // widget is back on the GUI thread
+    void waitForFrame();
+
+private:
+    void startFrame();
+    void render();
+    void frameRendered();
+
+    CelestiaGlWidget* widget;
+    CelestiaCore* appCore;
+    QThread* guiThread;
+
+    QThread thread;
+    // Lives on the thread, to queue the frames to
+    std::unique_ptr<QObject> worker;
+
+    QMutex stateMutex;
+    QWaitCondition frameDone;
+    bool rendering{ false };
+
+    // State of the GUI thread
+    bool framePending{ false };
+    bool frameInFlight{ false };
+    bool composePending{ false };
+};
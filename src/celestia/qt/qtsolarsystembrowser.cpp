@@ -20,6 +20,8 @@
 #include <QCheckBox>
 #include <QComboBox>
 #include <QLabel>
+#include <algorithm>
+#include <deque>
 #include <vector>
 #ifdef TEST_MODEL
 #include <QAbstractItemModelTester>
@@ -56,6 +58,12 @@ public:
     void sort(int column, Qt::SortOrder order) override;
     QModelIndex sibling(int row, int column, const QModelIndex &index) const override;
 
+    // The children of an item are only listed when it's expanded, and
+    // added to the model in batches as the view needs them
+    bool hasChildren(const QModelIndex& parent) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
+
     // Methods from ModelHelper
     Selection itemForInfoPanel(const QModelIndex&) override;
 
@@ -76,13 +84,19 @@ private:
 
         Selection obj;
         TreeItem* parent{nullptr};
-        TreeItem** children{nullptr};
-        int nChildren{0};
+        std::vector<TreeItem*> children;
+        // Children listed but not yet added to the model
+        std::deque<TreeItem*> pending;
         int childIndex{0};
         int classification{0};
+        // Whether the children have been listed
+        bool expanded{false};
+        // The objects of a group item
+        std::vector<Body*> members;
     };
 
-    TreeItem* createTreeItem(Selection sel, TreeItem* parent, int childIndex);
+    TreeItem* createTreeItem(Selection sel, TreeItem* parent);
+    void expandTreeItem(TreeItem* item);
     void addTreeItemChildren(TreeItem* item,
                              PlanetarySystem* sys,
                              const vector<Star*>* orbitingStars);
@@ -93,9 +107,9 @@ private:
                                     const vector<Star*>* orbitingStars,
                                     Selection parent);
     TreeItem* createGroupTreeItem(int classification,
-                                  const vector<Body*>& objects,
-                                  TreeItem* parent,
-                                  int childIndex);
+                                  vector<Body*>&& objects,
+                                  TreeItem* parent);
+    PlanetarySystem* getPlanetarySystem(Selection sel) const;
 
     TreeItem* itemAtIndex(const QModelIndex& index) const;
 
@@ -107,14 +121,16 @@ private:
 };
 
 
+// Number of children added to the model at a time
+constexpr std::size_t FetchBatchSize = 1000;
+
+
 SolarSystemTreeModel::TreeItem::~TreeItem()
 {
-    if (children != nullptr)
-    {
-        for (int i = 0; i < nChildren; i++)
-            delete children[i];
-        delete[] children;
-    }
+    for (TreeItem* child : children)
+        delete child;
+    for (TreeItem* child : pending)
+        delete child;
 }
 
 
@@ -126,7 +142,8 @@ SolarSystemTreeModel::SolarSystemTreeModel(const Universe* _universe) :
 }
 
 
-// Call createTreeItem() to build the parallel tree structure
+// Create the item of the root star; the rest of the tree is built as it's
+// expanded
 void SolarSystemTreeModel::buildModel(Star* star, bool _groupByClass, int _bodyFilter)
 {
     beginResetModel();
@@ -138,13 +155,10 @@ void SolarSystemTreeModel::buildModel(Star* star, bool _groupByClass, int _bodyF
 
     rootItem = new TreeItem();
     rootItem->obj = Selection();
+    rootItem->expanded = true;
 
     if (star != nullptr)
-    {
-        rootItem->nChildren = 1;
-        rootItem->children = new TreeItem*[1];
-        rootItem->children[0] = createTreeItem(Selection(star), rootItem, 0);
-    }
+        rootItem->children.push_back(createTreeItem(Selection(star), rootItem));
 
     endResetModel();
 }
@@ -159,44 +173,59 @@ void SolarSystemTreeModel::buildModel(Star* star, bool _groupByClass, int _bodyF
 // and solar system bodies can be treated almost identically once
 // the new tree is built.
 SolarSystemTreeModel::TreeItem*
-SolarSystemTreeModel::createTreeItem(Selection sel,
-                                     TreeItem* parent,
-                                     int childIndex)
+SolarSystemTreeModel::createTreeItem(Selection sel, TreeItem* parent)
 {
     auto* item = new TreeItem();
     item->parent = parent;
     item->obj = sel;
-    item->childIndex = childIndex;
+    return item;
+}
 
-    const vector<Star*>* orbitingStars = nullptr;
 
-    PlanetarySystem* sys = nullptr;
+PlanetarySystem*
+SolarSystemTreeModel::getPlanetarySystem(Selection sel) const
+{
     if (sel.body() != nullptr)
+        return sel.body()->getSatellites();
+
+    if (sel.star() != nullptr)
     {
-        sys = sel.body()->getSatellites();
-    }
-    else if (sel.star() != nullptr)
-    {
-        // Stars may have both a solar system and other stars orbiting
-        // them.
         SolarSystemCatalog* solarSystems = universe->getSolarSystemCatalog();
         auto iter = solarSystems->find(sel.star()->getIndex());
         if (iter != solarSystems->end())
-        {
-            sys = iter->second->getPlanets();
-        }
+            return iter->second->getPlanets();
+    }
+
+    return nullptr;
+}
+
+
+// List the children of the item as pending
+void
+SolarSystemTreeModel::expandTreeItem(TreeItem* item)
+{
+    item->expanded = true;
 
-        orbitingStars = sel.star()->getOrbitingStars();
+    if (item->classification != 0)
+    {
+        for (Body* body : item->members)
+            item->pending.push_back(createTreeItem(Selection(body), item));
+        item->members.clear();
+        item->members.shrink_to_fit();
+        return;
     }
 
+    // Stars may have both a solar system and other stars orbiting them.
+    Selection sel = item->obj;
+    PlanetarySystem* sys = getPlanetarySystem(sel);
+    const vector<Star*>* orbitingStars = sel.star() != nullptr ? sel.star()->getOrbitingStars() : nullptr;
+
     if (groupByClass && sys != nullptr)
         addTreeItemChildrenGrouped(item, sys, orbitingStars, sel);
     else if (bodyFilter != 0 && sys != nullptr)
         addTreeItemChildrenFiltered(item, sys);
     else
         addTreeItemChildren(item, sys, orbitingStars);
-
-    return item;
 }
 
 
@@ -205,40 +234,18 @@ SolarSystemTreeModel::addTreeItemChildren(TreeItem* item,
                                           PlanetarySystem* sys,
                                           const vector<Star*>* orbitingStars)
 {
-    // Calculate the number of children: the number of orbiting stars plus
-    // the number of orbiting solar system bodies.
-    item->nChildren = 0;
+    // Add the stars
     if (orbitingStars != nullptr)
-        item->nChildren += orbitingStars->size();
-    if (sys != nullptr)
-        item->nChildren += sys->getSystemSize();
-
-    if (item->nChildren != 0)
     {
-        int childIndex = 0;
-        item->children = new TreeItem*[item->nChildren];
-
-        // Add the stars
-        if (orbitingStars != nullptr)
-        {
-            for (unsigned int i = 0; i < orbitingStars->size(); i++)
-            {
-                Selection child(orbitingStars->at(i));
-                item->children[childIndex] = createTreeItem(child, item, childIndex);
-                childIndex++;
-            }
-        }
+        for (Star* star : *orbitingStars)
+            item->pending.push_back(createTreeItem(Selection(star), item));
+    }
 
-        // Add the solar system bodies
-        if (sys != nullptr)
-        {
-            for (int i = 0; i < sys->getSystemSize(); i++)
-            {
-                Selection child(sys->getBody(i));
-                item->children[childIndex] = createTreeItem(child, item, childIndex);
-                childIndex++;
-            }
-        }
+    // Add the solar system bodies
+    if (sys != nullptr)
+    {
+        for (int i = 0; i < sys->getSystemSize(); i++)
+            item->pending.push_back(createTreeItem(Selection(sys->getBody(i)), item));
     }
 }
 
@@ -247,27 +254,11 @@ void
 SolarSystemTreeModel::addTreeItemChildrenFiltered(TreeItem* item,
                                                   PlanetarySystem* sys)
 {
-    vector<Body*> bodies;
-
     for (int i = 0; i < sys->getSystemSize(); i++)
     {
         Body* body = sys->getBody(i);
         if ((bodyFilter & body->getClassification()) != 0)
-            bodies.push_back(body);
-    }
-
-    // Calculate the total number of children
-    if ((item->nChildren = bodies.size()) == 0)
-        return;
-
-    int childIndex = 0;
-    item->children = new TreeItem*[item->nChildren];
-
-    // Add the direct children
-    for (int i = 0; i < (int) bodies.size(); i++)
-    {
-        item->children[childIndex] = createTreeItem(bodies[i], item, childIndex);
-        childIndex++;
+            item->pending.push_back(createTreeItem(Selection(body), item));
     }
 }
 
@@ -351,122 +342,42 @@ SolarSystemTreeModel::addTreeItemChildrenGrouped(TreeItem* item,
         }
     }
 
-    // Calculate the total number of children
-    item->nChildren = 0;
+    // Add the stars
     if (orbitingStars != nullptr)
-        item->nChildren += orbitingStars->size();
+    {
+        for (Star* star : *orbitingStars)
+            item->pending.push_back(createTreeItem(Selection(star), item));
+    }
+
+    // Add the direct children
+    for (Body* body : normal)
+        item->pending.push_back(createTreeItem(Selection(body), item));
 
-    item->nChildren += normal.size();
+    // Add the groups
+    if (!minorMoons.empty())
+        item->pending.push_back(createGroupTreeItem(Body::MinorMoon, std::move(minorMoons), item));
     if (!asteroids.empty())
-        item->nChildren++;
+        item->pending.push_back(createGroupTreeItem(Body::Asteroid, std::move(asteroids), item));
     if (!spacecraft.empty())
-        item->nChildren++;
-    if (!minorMoons.empty())
-        item->nChildren++;
+        item->pending.push_back(createGroupTreeItem(Body::Spacecraft, std::move(spacecraft), item));
     if (!surfaceFeatures.empty())
-        item->nChildren++;
+        item->pending.push_back(createGroupTreeItem(Body::SurfaceFeature, std::move(surfaceFeatures), item));
     if (!components.empty())
-        item->nChildren++;
+        item->pending.push_back(createGroupTreeItem(Body::Component, std::move(components), item));
     if (!other.empty())
-        item->nChildren++;
-
-    if (item->nChildren != 0)
-    {
-        int childIndex = 0;
-        item->children = new TreeItem*[item->nChildren];
-        {
-            // Add the stars
-            if (orbitingStars != nullptr)
-            {
-                for (unsigned int i = 0; i < orbitingStars->size(); i++)
-                {
-                    Selection child(orbitingStars->at(i));
-                    item->children[childIndex] = createTreeItem(child, item, childIndex);
-                    childIndex++;
-                }
-            }
-
-            // Add the direct children
-            for (int i = 0; i < (int) normal.size(); i++)
-            {
-                item->children[childIndex] = createTreeItem(normal[i], item, childIndex);
-                childIndex++;
-            }
-
-            // Add the groups
-            if (!minorMoons.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(Body::MinorMoon,
-                                                                 minorMoons,
-                                                                 item, childIndex);
-                childIndex++;
-            }
-
-            if (!asteroids.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(Body::Asteroid,
-                                                                 asteroids,
-                                                                 item, childIndex);
-                childIndex++;
-            }
-
-            if (!spacecraft.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(Body::Spacecraft,
-                                                                 spacecraft,
-                                                                 item, childIndex);
-                childIndex++;
-            }
-
-            if (!surfaceFeatures.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(Body::SurfaceFeature,
-                                                                 surfaceFeatures,
-                                                                 item, childIndex);
-                childIndex++;
-            }
-
-            if (!components.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(Body::Component,
-                                                                 components,
-                                                                 item, childIndex);
-                childIndex++;
-            }
-
-            if (!other.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(Body::Unknown,
-                                                                 other,
-                                                                 item, childIndex);
-                childIndex++;
-            }
-        }
-    }
+        item->pending.push_back(createGroupTreeItem(Body::Unknown, std::move(other), item));
 }
 
 
 SolarSystemTreeModel::TreeItem*
 SolarSystemTreeModel::createGroupTreeItem(int classification,
-                                          const vector<Body*>& objects,
-                                          TreeItem* parent,
-                                          int childIndex)
+                                          vector<Body*>&& objects,
+                                          TreeItem* parent)
 {
     auto* item = new TreeItem();
     item->parent = parent;
-    item->childIndex = childIndex;
     item->classification = classification;
-
-    if (!objects.empty())
-    {
-        item->nChildren = (int) objects.size();
-        item->children = new TreeItem*[item->nChildren];
-        for (int i = 0; i < item->nChildren; i++)
-        {
-            item->children[i] = createTreeItem(Selection(objects[i]), item, i);
-        }
-    }
-
+    item->members = std::move(objects);
     return item;
 }
 
@@ -503,7 +414,7 @@ QModelIndex SolarSystemTreeModel::index(int row, int column, const QModelIndex&
     else
         parentItem = static_cast<TreeItem*>(parent.internalPointer());
 
-    if (row < parentItem->nChildren)
+    if (row < static_cast<int>(parentItem->children.size()))
         return createIndex(row, column, parentItem->children[row]);
     else
         return QModelIndex();
@@ -669,10 +580,67 @@ int SolarSystemTreeModel::rowCount(const QModelIndex& parent) const
     if (parent.column() > 0)
         return 0;
 
-    if (!parent.isValid())
-        return rootItem->nChildren;
+    return static_cast<int>(itemAtIndex(parent)->children.size());
+}
+
+
+// Override QAbstractItemModel::hasChildren(); whether an item which
+// hasn't been expanded has children is guessed from its object, so
+// filtered items may turn out to have none
+bool SolarSystemTreeModel::hasChildren(const QModelIndex& parent) const
+{
+    if (parent.column() > 0)
+        return false;
+
+    const TreeItem* item = itemAtIndex(parent);
+    if (item->expanded)
+        return !item->children.empty() || !item->pending.empty();
+    if (item->classification != 0)
+        return true;
+
+    const PlanetarySystem* sys = getPlanetarySystem(item->obj);
+    if (sys != nullptr && sys->getSystemSize() > 0)
+        return true;
+
+    const vector<Star*>* orbitingStars = item->obj.star() != nullptr ? item->obj.star()->getOrbitingStars() : nullptr;
+    return orbitingStars != nullptr && !orbitingStars->empty();
+}
+
 
-    return static_cast<TreeItem*>(parent.internalPointer())->nChildren;
+// Override QAbstractItemModel::canFetchMore()
+bool SolarSystemTreeModel::canFetchMore(const QModelIndex& parent) const
+{
+    if (parent.column() > 0)
+        return false;
+
+    const TreeItem* item = itemAtIndex(parent);
+    return item->expanded ? !item->pending.empty() : hasChildren(parent);
+}
+
+
+// Override QAbstractItemModel::fetchMore()
+void SolarSystemTreeModel::fetchMore(const QModelIndex& parent)
+{
+    if (parent.column() > 0)
+        return;
+
+    TreeItem* item = itemAtIndex(parent);
+    if (!item->expanded)
+        expandTreeItem(item);
+    if (item->pending.empty())
+        return;
+
+    auto first = static_cast<int>(item->children.size());
+    auto count = static_cast<int>(std::min(item->pending.size(), FetchBatchSize));
+    beginInsertRows(parent, first, first + count - 1);
+    for (int i = 0; i < count; i++)
+    {
+        TreeItem* child = item->pending.front();
+        item->pending.pop_front();
+        child->childIndex = first + i;
+        item->children.push_back(child);
+    }
+    endInsertRows();
 }
 
 
@@ -885,6 +853,8 @@ void SolarSystemBrowser::slotRefreshTree()
     QModelIndex primary = solarSystemModel->index(0, 0, QModelIndex());
     if (primary.isValid() && solarSystemModel->objectAtIndex(primary).star() != nullptr)
     {
+        if (solarSystemModel->canFetchMore(primary))
+            solarSystemModel->fetchMore(primary);
         treeView->setExpanded(primary, true);
         QModelIndex secondary = solarSystemModel->index(0, 0, primary);
         if (secondary.isValid() && solarSystemModel->objectAtIndex(secondary).star() != nullptr)
@@ -8,6 +8,8 @@
 // of the License, or (at your option) any later version.
 
 #include <cctype>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <memory>
@@ -28,6 +30,7 @@
 #include <emscripten.h>
 #endif
 #include <celestia/celestiacore.h>
+#include <celestia/offlinerenderer.h>
 #include <celestia/url.h>
 
 namespace celestia
@@ -46,6 +49,15 @@ class SDL_Alerter : public CelestiaCore::Alerter
     }
 };
 
+// Rendering to files instead of the window, selected on the command line
+struct OfflineRenderOptions
+{
+    fs::path outputDir;
+    fs::path script;
+    int frames{ 0 };
+    OfflineRenderer::Options renderer;
+};
+
 class SDL_Application
 {
  public:
@@ -74,10 +86,11 @@ class SDL_Application
 
     static std::shared_ptr<SDL_Application> init(std::string_view, int, int);
 
-    bool createOpenGLWindow();
+    bool createOpenGLWindow(bool hidden = false);
 
     bool initCelestiaCore();
     void run();
+    bool renderOffline(const OfflineRenderOptions&);
     EventHandleResult handleEvent();
     RunLoopState update();
     std::string_view getError() const;
@@ -145,14 +158,16 @@ SDL_Application::~SDL_Application()
 }
 
 bool
-SDL_Application::createOpenGLWindow()
+SDL_Application::createOpenGLWindow(bool hidden)
 {
+    Uint32 flags = SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI;
+    flags |= hidden ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN;
     m_mainWindow = SDL_CreateWindow(m_appName.c_str(),
                                     SDL_WINDOWPOS_CENTERED,
                                     SDL_WINDOWPOS_CENTERED,
                                     m_windowWidth,
                                     m_windowHeight,
-                                    SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
+                                    flags);
     if (m_mainWindow == nullptr)
         return false;
 
@@ -283,6 +298,33 @@ SDL_Application::run()
 #endif
 }
 
+bool
+SDL_Application::renderOffline(const OfflineRenderOptions &options)
+{
+    m_appCore->initRenderer();
+    configure();
+    m_appCore->start();
+
+    SDL_GL_GetDrawableSize(m_mainWindow, &m_windowWidth, &m_windowHeight);
+    m_appCore->resize(m_windowWidth, m_windowHeight);
+
+    if (!options.script.empty())
+        m_appCore->runScript(options.script);
+
+    OfflineRenderer renderer(m_appCore, options.renderer);
+    if (!renderer.isValid())
+        return false;
+
+    for (int frame = 0; frame < options.frames; frame++)
+    {
+        SDL_PumpEvents();
+        if (!renderer.renderFrame(options.outputDir / fmt::format("frame{:05}.png", frame)))
+            return false;
+    }
+
+    return renderer.finish();
+}
+
 SDL_Application::RunLoopState
 SDL_Application::update()
 {
@@ -648,8 +690,41 @@ DumpGLInfo()
         std::cout << s << '\n';
 }
 
+// --render DIR --frames N [--size WxH] [--fps F] [--tile-size N] [--script FILE]
+static bool
+parseOfflineRenderOptions(int argc, char **argv, OfflineRenderOptions &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if (i + 1 == argc)
+            return false;
+
+        const char *value = argv[++i];
+        if (arg == "--render")
+            options.outputDir = fs::absolute(value);
+        else if (arg == "--script")
+            options.script = fs::absolute(value);
+        else if (arg == "--frames")
+            options.frames = std::atoi(value);
+        else if (arg == "--fps")
+            options.renderer.frameRate = static_cast<float>(std::atof(value));
+        else if (arg == "--tile-size")
+            options.renderer.maxTileSize = std::atoi(value);
+        else if (arg == "--size")
+        {
+            if (std::sscanf(value, "%dx%d", &options.renderer.width, &options.renderer.height) != 2)
+                return false;
+        }
+        else
+            return false;
+    }
+
+    return !options.outputDir.empty() && options.frames > 0;
+}
+
 int
-sdlmain(int /* argc */, char ** /* argv */)
+sdlmain(int argc, char **argv)
 {
     setlocale(LC_ALL, "");
     setlocale(LC_NUMERIC, "C");
@@ -659,6 +734,16 @@ sdlmain(int /* argc */, char ** /* argv */)
     bind_textdomain_codeset("celestia-data", "UTF-8");
     textdomain("celestia");
 
+    // paths are resolved before changing to the data directory
+    OfflineRenderOptions offline;
+    bool renderOffline = argc > 1;
+    if (renderOffline && !parseOfflineRenderOptions(argc, argv, offline))
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--render DIR --frames N [--size WxH] [--fps F] [--tile-size N] [--script FILE]]\n";
+        return 1;
+    }
+
     const char *dataDir = getenv("CELESTIA_DATA_DIR");
     if (dataDir == nullptr)
         dataDir = CONFIG_DATA_DIR;
@@ -683,7 +768,7 @@ sdlmain(int /* argc */, char ** /* argv */)
         FatalError("Could not initialize Celestia!");
         return 3;
     }
-    if (!app->createOpenGLWindow())
+    if (!app->createOpenGLWindow(renderOffline))
     {
         FatalError("Could not create a OpenGL window! Error: {}", app->getError());
         return 4;
@@ -700,6 +785,16 @@ sdlmain(int /* argc */, char ** /* argv */)
 
     DumpGLInfo();
 
+    if (renderOffline)
+    {
+        if (!app->renderOffline(offline))
+        {
+            FatalError("Could not render the frames to {}!", offline.outputDir.string());
+            return 6;
+        }
+        return 0;
+    }
+
     app->run();
 
     return 0;
@@ -0,0 +1,71 @@
+// simulationthread.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Advances the simulation on a worker thread while the render thread draws
+// copies of the observers taken before the time step.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "simulationthread.h"
+
+#include <celengine/simulation.h>
+
+SimulationThread::SimulationThread(Simulation* _sim) :
+    sim(_sim),
+    worker(&SimulationThread::run, this)
+{
+}
+
+SimulationThread::~SimulationThread()
+{
+    {
+        std::scoped_lock lock(mutex);
+        stopRequested = true;
+    }
+    condition.notify_all();
+    worker.join();
+}
+
+void
+SimulationThread::start(double dt)
+{
+    {
+        std::scoped_lock lock(mutex);
+        timeStep = dt;
+        pending = true;
+    }
+    condition.notify_all();
+}
+
+void
+SimulationThread::wait()
+{
+    std::unique_lock lock(mutex);
+    condition.wait(lock, [this] { return !pending; });
+}
+
+void
+SimulationThread::run()
+{
+    std::unique_lock lock(mutex);
+    for (;;)
+    {
+        condition.wait(lock, [this] { return pending || stopRequested; });
+        if (stopRequested)
+            break;
+
+        double dt = timeStep;
+        lock.unlock();
+        // The body state cache belongs to the render thread, so the
+        // observers are advanced without it
+        sim->advance(dt);
+        lock.lock();
+
+        pending = false;
+        condition.notify_all();
+    }
+}
@@ -0,0 +1,50 @@
+// simulationthread.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Advances the simulation on a worker thread while the render thread draws
+// copies of the observers taken before the time step.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+class Simulation;
+
+class SimulationThread
+{
+ public:
+    explicit SimulationThread(Simulation* sim);
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    // Start advancing the simulation by dt seconds. The simulation mustn't
+    // be touched until wait() returns, other than through copies of its
+    // state made before.
+    void start(double dt);
+    // Wait for the time step started last to finish
+    void wait();
+
+ private:
+    void run();
+
+    Simulation* sim;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    double timeStep{ 0.0 };
+    bool pending{ false };
+    bool stopRequested{ false };
+
+    // Started last, once the members it uses are initialized
+    std::thread worker;
+};
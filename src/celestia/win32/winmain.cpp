@@ -460,12 +460,17 @@ static bool BeginMovieCapture(const Renderer* renderer,
                               int64_t bitrate)
 {
     auto* movieCapture = new FFMPEGCapture(renderer);
-    movieCapture->setVideoCodec(codec);
     movieCapture->setBitRate(bitrate);
     if (codec == AV_CODEC_ID_H264)
+    {
+        movieCapture->setVideoCodec(codec, appCore->getConfig()->h264Encoder);
         movieCapture->setEncoderOptions(appCore->getConfig()->x264EncoderOptions);
+    }
     else
+    {
+        movieCapture->setVideoCodec(codec);
         movieCapture->setEncoderOptions(appCore->getConfig()->ffvhEncoderOptions);
+    }
 
     bool success = movieCapture->start(filename, width, height, framerate);
     if (success)
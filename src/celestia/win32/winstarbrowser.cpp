@@ -11,10 +11,10 @@
 
 #include <string>
 #include <algorithm>
-#include <set>
 #include <windows.h>
 #include <commctrl.h>
 #include <cstring>
+#include <celengine/starquery.h>
 #include <celutil/gettext.h>
 #include <celutil/winutil.h>
 #include "winuiutils.h"
@@ -151,50 +151,10 @@ struct SolarSystemPredicate
 template<class Pred> vector<const Star*>*
 FindStars(const StarDatabase& stardb, Pred pred, int nStars)
 {
-    vector<const Star*>* finalStars = new vector<const Star*>();
-    if (nStars == 0)
-        return finalStars;
-
-    typedef multiset<const Star*, Pred> StarSet;
-    StarSet firstStars(pred);
-
-    int totalStars = stardb.size();
-    if (totalStars < nStars)
-        nStars = totalStars;
-
-    // We'll need at least nStars in the set, so first fill
-    // up the list indiscriminately.
-    int i = 0;
-    for (i = 0; i < nStars; i++)
-    {
-        Star* star = stardb.getStar(i);
-        if (star->getVisibility())
-            firstStars.insert(star);
-    }
-
-    // From here on, only add a star to the set if it's
-    // a better match than the worst matching star already
-    // in the set.
-    const Star* lastStar = *--firstStars.end();
-    for (; i < totalStars; i++)
-    {
-        Star* star = stardb.getStar(i);
-        if (star->getVisibility() && pred(star, lastStar))
-        {
-            firstStars.insert(star);
-            firstStars.erase(--firstStars.end());
-            lastStar = *--firstStars.end();
-        }
-    }
-
-    // Move the best matching stars into the vector
-    finalStars->reserve(nStars);
-    for (const auto& star : firstStars)
-    {
-        finalStars->insert(finalStars->end(), star);
-    }
-
-    return finalStars;
+    // Barycenters aren't listed
+    auto filter = [](const Star* star) { return !star->getVisibility(); };
+    vector<Star*> stars = celestia::engine::findBestStars(stardb, pred, filter, max(nStars, 0));
+    return new vector<const Star*>(stars.begin(), stars.end());
 }
 
 
@@ -8,6 +8,9 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <thread>
+
 #include <celengine/image.h>
 #include <celutil/logger.h>
 
@@ -18,9 +21,21 @@ extern "C" {
 using celestia::PixelFormat;
 using celestia::util::GetLogger;
 
+namespace
+{
+// AV1 decoding is slow enough that large planet maps are worth decoding
+// on several threads; the codec runs its own, so they can't be jobs
+int
+decodingThreads()
+{
+    return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+} // anonymous namespace
+
 Image* LoadAVIFImage(const fs::path& filename)
 {
     avifDecoder* decoder = avifDecoderCreate();
+    decoder->maxThreads = decodingThreads();
     avifResult result = avifDecoderSetIOFile(decoder, filename.string().c_str());
     if (result != AVIF_RESULT_OK)
     {
@@ -44,13 +59,20 @@ Image* LoadAVIFImage(const fs::path& filename)
         return nullptr;
     }
 
+    // Decode straight into the image, with 8 bits per channel whatever the
+    // depth of the file, and without alpha when it has none
     avifRGBImage rgb;
-    rgb.format = AVIF_RGB_FORMAT_RGBA;
     avifRGBImageSetDefaults(&rgb, decoder->image);
+    rgb.depth = 8;
+    bool hasAlpha = decoder->image->alphaPlane != nullptr;
+    rgb.format = hasAlpha ? AVIF_RGB_FORMAT_RGBA : AVIF_RGB_FORMAT_RGB;
+#if AVIF_VERSION >= 1000000
+    rgb.maxThreads = decodingThreads();
+#endif
 
-    Image* image = new Image(PixelFormat::RGBA, rgb.width, rgb.height);
+    Image* image = new Image(hasAlpha ? PixelFormat::RGBA : PixelFormat::RGB, rgb.width, rgb.height);
     rgb.pixels = image->getPixels();
-    rgb.rowBytes = image->getWidth() * image->getComponents();
+    rgb.rowBytes = image->getPitch();
 
     if (avifImageYUVToRGB(decoder->image, &rgb) != AVIF_RESULT_OK)
     {
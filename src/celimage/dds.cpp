@@ -85,53 +85,6 @@ constexpr uint32_t FourCC(const char* s)
             (uint32_t) s[0]);
 }
 
-// decompress a DXTc texture to a RGBA texture, taken from https://github.com/ptitSeb/gl4es
-uint32_t* decompressDXTc(uint32_t width, uint32_t height, GLenum format, bool transparent0, ifstream &in)
-{
-    // TODO: check with the size of the input data stream if the stream is in fact decompressed
-    // alloc memory
-    auto *pixels = new uint32_t[((width + 3) & ~3) * ((height + 3) & ~3)];
-
-    int blocksize = 0;
-#define DDS_MAX_BLOCK_SIZE      16
-    switch (format)
-    {
-    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
-        blocksize = 8;
-        break;
-    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
-    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
-        blocksize = 16;
-        break;
-    }
-    uint8_t block[DDS_MAX_BLOCK_SIZE]; // enough to hold DXT1/3/5 blocks
-    for (uint32_t y = 0; y < height; y += 4)
-    {
-        for (uint32_t x = 0; x < width; x += 4)
-        {
-            if (!in.good())
-            {
-                delete[] pixels;
-                return nullptr;
-            }
-            in.read((char*)block, blocksize);
-            switch(format)
-            {
-            case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
-                DecompressBlockDXT1(x, y, width, block, transparent0, pixels);
-                break;
-            case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
-                DecompressBlockDXT3(x, y, width, block, transparent0, pixels);
-                break;
-            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
-                DecompressBlockDXT5(x, y, width, block, transparent0, pixels);
-                break;
-            }
-        }
-    }
-    return pixels;
-}
-
 } // anonymous namespace
 
 Image* LoadDDSImage(const fs::path& filename)
@@ -237,61 +190,6 @@ Image* LoadDDSImage(const fs::path& filename)
         return nullptr;
     }
 
-    // Check if the platform supports compressed DTXc textures
-    if (format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT ||
-        format == GL_COMPRESSED_RGBA_S3TC_DXT3_EXT ||
-        format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
-    {
-        if (!gl::EXT_texture_compression_s3tc)
-        {
-            // DXTc texture not supported, decompress DXTc to RGB/RGBA
-            uint32_t *pixels = nullptr;
-            bool transparent0 = format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
-            if ((ddsd.width & 3) != 0 || (ddsd.height & 3) != 0)
-            {
-                uint32_t nw = max(ddsd.width, 4u);
-                uint32_t nh = max(ddsd.height, 4u);
-                auto *tmp = decompressDXTc(nw, nh, format, transparent0, in);
-                if (tmp != nullptr)
-                {
-                    pixels = new uint32_t[ddsd.width * ddsd.height];
-                    // crop
-                    for (uint32_t y = 0; y < ddsd.height; y++)
-                        memcpy((char *)pixels + y * ddsd.width * 4, (char *)tmp + y * nw * 4, ddsd.width * 4);
-                    delete[] tmp;
-                }
-            }
-            else
-            {
-                pixels = decompressDXTc(ddsd.width, ddsd.height, format, transparent0, in);
-            }
-
-            if (pixels == nullptr)
-            {
-                GetLogger()->error("Failed to decompress DDS texture file {}.\n", filename);
-                return nullptr;
-            }
-
-            if (transparent0)
-            {
-                // Remove the alpha channel for DXT1 since DXT1 textures
-                // are deemed not to contain alpha values in Celestia
-                // https://github.com/CelestiaProject/Celestia/pull/1086
-                char *ptr = reinterpret_cast<char*>(pixels);
-                uint32_t numberOfPixels = ddsd.width * ddsd.height;
-                for (uint32_t index = 0; index < numberOfPixels; ++index)
-                {
-                    memcpy(&ptr[3 * index], &ptr[4 * index], sizeof(char) * 3);
-                }
-            }
-
-            Image *img = new Image(transparent0 ? PixelFormat::RGB : PixelFormat::RGBA, ddsd.width, ddsd.height);
-            memcpy(img->getPixels(), pixels, (transparent0 ? 3 : 4) * ddsd.width * ddsd.height);
-            delete[] pixels;
-            return img;
-        }
-    }
-
     // TODO: Verify that the reported texture size matches the amount of
     // data expected.
 
@@ -307,5 +205,89 @@ Image* LoadDDSImage(const fs::path& filename)
         return nullptr;
     }
 
+    // Check if the platform supports compressed DTXc textures
+    if (img->isCompressed() && !gl::EXT_texture_compression_s3tc)
+    {
+        // DXTc texture not supported, decompress DXTc to RGB/RGBA. Tiled
+        // textures don't take uncompressed mipmaps, so large images lose
+        // theirs.
+        bool mipMaps = img->getWidth() <= gl::maxTextureSize && img->getHeight() <= gl::maxTextureSize;
+        std::unique_ptr<Image> decompressed = DecompressDXTImage(*img, mipMaps);
+        delete img;
+        return decompressed.release();
+    }
+
     return img;
 }
+
+
+bool SaveDDSImage(const fs::path& filename, const Image& image)
+{
+    uint32_t fourCC;
+    switch (image.getFormat())
+    {
+    case PixelFormat::DXT1:
+        fourCC = FourCC("DXT1");
+        break;
+    case PixelFormat::DXT3:
+        fourCC = FourCC("DXT3");
+        break;
+    case PixelFormat::DXT5:
+        fourCC = FourCC("DXT5");
+        break;
+    default:
+        GetLogger()->error("Only compressed images can be saved as DDS: {}\n", filename);
+        return false;
+    }
+
+    // Flags and caps values from the DirectDraw headers
+    constexpr uint32_t DDSD_CAPS        = 0x1;
+    constexpr uint32_t DDSD_HEIGHT      = 0x2;
+    constexpr uint32_t DDSD_WIDTH       = 0x4;
+    constexpr uint32_t DDSD_PIXELFORMAT = 0x1000;
+    constexpr uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+    constexpr uint32_t DDSD_LINEARSIZE  = 0x80000;
+    constexpr uint32_t DDPF_FOURCC      = 0x4;
+    constexpr uint32_t DDSCAPS_COMPLEX  = 0x8;
+    constexpr uint32_t DDSCAPS_TEXTURE  = 0x1000;
+    constexpr uint32_t DDSCAPS_MIPMAP   = 0x400000;
+
+    DDSurfaceDesc ddsd;
+    memset(&ddsd, 0, sizeof ddsd);
+    uint32_t mipLevels = static_cast<uint32_t>(image.getMipLevelCount());
+    LE_TO_CPU_INT32(ddsd.size, static_cast<uint32_t>(sizeof ddsd));
+    LE_TO_CPU_INT32(ddsd.flags, DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT
+                                | DDSD_LINEARSIZE | (mipLevels > 1 ? DDSD_MIPMAPCOUNT : 0u));
+    LE_TO_CPU_INT32(ddsd.height, static_cast<uint32_t>(image.getHeight()));
+    LE_TO_CPU_INT32(ddsd.width, static_cast<uint32_t>(image.getWidth()));
+    LE_TO_CPU_INT32(ddsd.pitch, static_cast<uint32_t>(image.getMipLevelSize(0)));
+    LE_TO_CPU_INT32(ddsd.mipMapLevels, mipLevels);
+    LE_TO_CPU_INT32(ddsd.format.size, static_cast<uint32_t>(sizeof ddsd.format));
+    LE_TO_CPU_INT32(ddsd.format.flags, DDPF_FOURCC);
+    LE_TO_CPU_INT32(ddsd.format.fourCC, fourCC);
+    LE_TO_CPU_INT32(ddsd.caps.caps, DDSCAPS_TEXTURE
+                                    | (mipLevels > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0u));
+
+    ofstream out(filename, ios::out | ios::binary);
+    if (!out.good())
+    {
+        GetLogger()->error("Error opening DDS texture file {} for writing.\n", filename);
+        return false;
+    }
+
+    out.write("DDS ", 4);
+    out.write(reinterpret_cast<const char*>(&ddsd), sizeof ddsd);
+    for (int mip = 0; mip < image.getMipLevelCount(); mip++)
+    {
+        out.write(reinterpret_cast<const char*>(image.getMipLevel(mip)),
+                  image.getMipLevelSize(mip));
+    }
+
+    if (!out.good())
+    {
+        GetLogger()->error("Failed writing DDS texture file {}.\n", filename);
+        return false;
+    }
+
+    return true;
+}
@@ -1,5 +1,12 @@
 #include <stddef.h>
 #include <stdint.h>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <celengine/image.h>
+#include "dds_decompress.h"
 
 /*
 DXT1/DXT3/DXT5 texture decompression
@@ -367,3 +374,95 @@ void DecompressBlockDXT3(uint32_t x,
     DecompressBlockDXT1Internal(blockStorage, image + x + (y * width), width,
                                 transparent0, alphaValues);
 }
+
+namespace
+{
+// Images with at least this many blocks in a mip level are decompressed on
+// several threads
+constexpr int ParallelMinBlocks = 64 * 1024;
+
+// Decompress the rows of blocks [firstRow, endRow) of a mip level, writing
+// the pixels straight into the destination image
+void DecompressBlockRows(const Image& img, Image& dest, int mip, int firstRow, int endRow)
+{
+    using celestia::PixelFormat;
+
+    int width = std::max(img.getWidth() >> mip, 1);
+    int height = std::max(img.getHeight() >> mip, 1);
+    int blocksPerRow = (width + 3) / 4;
+    int blockSize = img.getFormat() == PixelFormat::DXT1 ? 8 : 16;
+    int components = dest.getComponents();
+    const uint8_t* blocks = img.getMipLevel(mip);
+
+    uint32_t pixels[16];
+    for (int by = firstRow; by < endRow; by++)
+    {
+        int rows = std::min(4, height - by * 4);
+        for (int bx = 0; bx < blocksPerRow; bx++)
+        {
+            const uint8_t* block = blocks + (by * blocksPerRow + bx) * blockSize;
+            switch (img.getFormat())
+            {
+            case PixelFormat::DXT1:
+                DecompressBlockDXT1(0, 0, 4, block, true, pixels);
+                break;
+            case PixelFormat::DXT3:
+                DecompressBlockDXT3(0, 0, 4, block, false, pixels);
+                break;
+            default:
+                DecompressBlockDXT5(0, 0, 4, block, false, pixels);
+                break;
+            }
+
+            int columns = std::min(4, width - bx * 4);
+            for (int y = 0; y < rows; y++)
+            {
+                uint8_t* out = dest.getPixelRow(mip, by * 4 + y) + bx * 4 * components;
+                for (int x = 0; x < columns; x++)
+                {
+                    uint32_t pixel = pixels[y * 4 + x];
+                    for (int c = 0; c < components; c++)
+                        out[x * components + c] = (uint8_t)(pixel >> (8 * c));
+                }
+            }
+        }
+    }
+}
+} // anonymous namespace
+
+std::unique_ptr<Image> DecompressDXTImage(const Image& img, bool mipMaps)
+{
+    using celestia::PixelFormat;
+
+    if (!img.isCompressed())
+        return nullptr;
+
+    int mipLevels = mipMaps ? img.getMipLevelCount() : 1;
+    auto dest = std::make_unique<Image>(img.getFormat() == PixelFormat::DXT1 ? PixelFormat::RGB : PixelFormat::RGBA,
+                                        img.getWidth(), img.getHeight(), mipLevels);
+
+    unsigned int nThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (int mip = 0; mip < mipLevels; mip++)
+    {
+        int blocksPerRow = (std::max(img.getWidth() >> mip, 1) + 3) / 4;
+        int blockRows = (std::max(img.getHeight() >> mip, 1) + 3) / 4;
+        if (nThreads < 2 || blocksPerRow * blockRows < ParallelMinBlocks)
+        {
+            DecompressBlockRows(img, *dest, mip, 0, blockRows);
+            continue;
+        }
+
+        int bandRows = (blockRows + (int) nThreads - 1) / (int) nThreads;
+        std::vector<std::thread> workers;
+        for (int firstRow = bandRows; firstRow < blockRows; firstRow += bandRows)
+        {
+            workers.emplace_back(DecompressBlockRows, std::cref(img), std::ref(*dest), mip,
+                                 firstRow, std::min(firstRow + bandRows, blockRows));
+        }
+        DecompressBlockRows(img, *dest, mip, 0, std::min(bandRows, blockRows));
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    return dest;
+}
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
+
+class Image;
+
 void DecompressBlockDXT1(uint32_t x, uint32_t y, uint32_t width,
     const uint8_t* blockStorage,
     bool transparent0,
@@ -14,3 +19,8 @@ void DecompressBlockDXT5(uint32_t x, uint32_t y, uint32_t width,
     const uint8_t* blockStorage,
     bool transparent0,
     uint32_t* image);
+
+// Decompress a DXT1/3/5 image to RGB (DXT1, which Celestia treats as
+// opaque) or RGBA, optionally with all its mip levels. Large images are
+// decompressed on several threads.
+std::unique_ptr<Image> DecompressDXTImage(const Image& img, bool mipMaps);
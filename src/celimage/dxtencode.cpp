@@ -0,0 +1,380 @@
+// dxtencode.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// DXT1/DXT5 block encoder. The color end points are the extremes of the
+// block colors along their principal axis, inset slightly as described in
+// J.M.P. van Waveren, "Real-Time DXT Compression".
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "dxtencode.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using celestia::PixelFormat;
+
+namespace
+{
+
+constexpr int BlockPixels = 16;
+constexpr int PowerIterations = 4;
+
+std::uint16_t
+packRGB565(int r, int g, int b)
+{
+    return static_cast<std::uint16_t>(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+}
+
+void
+unpackRGB565(std::uint16_t c, int* rgb)
+{
+    rgb[0] = ((c >> 11) & 0x1f) * 255 / 31;
+    rgb[1] = ((c >> 5) & 0x3f) * 255 / 63;
+    rgb[2] = (c & 0x1f) * 255 / 31;
+}
+
+void
+putLE16(std::uint8_t* p, std::uint16_t v)
+{
+    p[0] = static_cast<std::uint8_t>(v & 0xff);
+    p[1] = static_cast<std::uint8_t>(v >> 8);
+}
+
+// Encode the color part of a block; DXT1 and DXT5 share the same layout.
+// The end points are always ordered so that the block uses four colors.
+void
+encodeColorBlock(const std::uint8_t* rgba, std::uint8_t* block)
+{
+    // Find the principal axis of the block colors from their covariance
+    std::array<float, 3> mean{ 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < BlockPixels; i++)
+    {
+        for (int c = 0; c < 3; c++)
+            mean[c] += rgba[i * 4 + c];
+    }
+    for (float& m : mean)
+        m /= static_cast<float>(BlockPixels);
+
+    std::array<float, 6> cov{ 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < BlockPixels; i++)
+    {
+        float r = rgba[i * 4 + 0] - mean[0];
+        float g = rgba[i * 4 + 1] - mean[1];
+        float b = rgba[i * 4 + 2] - mean[2];
+        cov[0] += r * r;
+        cov[1] += r * g;
+        cov[2] += r * b;
+        cov[3] += g * g;
+        cov[4] += g * b;
+        cov[5] += b * b;
+    }
+
+    // Start from the covariance column of the channel varying most, which
+    // can't be orthogonal to the principal axis
+    std::array<float, 3> axis;
+    if (cov[0] >= cov[3] && cov[0] >= cov[5])
+        axis = { cov[0], cov[1], cov[2] };
+    else if (cov[3] >= cov[5])
+        axis = { cov[1], cov[3], cov[4] };
+    else
+        axis = { cov[2], cov[4], cov[5] };
+    for (int iteration = 0; iteration < PowerIterations; iteration++)
+    {
+        std::array<float, 3> v
+        {
+            cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+            cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+            cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2],
+        };
+        float length = std::max({ std::abs(v[0]), std::abs(v[1]), std::abs(v[2]) });
+        if (length == 0.0f)
+            break;
+        for (int c = 0; c < 3; c++)
+            axis[c] = v[c] / length;
+    }
+
+    // The end points are the extreme colors along the axis, inset by 1/16 of
+    // their distance to reduce the error introduced by using the extremes
+    int minIndex = 0;
+    int maxIndex = 0;
+    float minDot = 1.0e30f;
+    float maxDot = -1.0e30f;
+    for (int i = 0; i < BlockPixels; i++)
+    {
+        float dot = rgba[i * 4 + 0] * axis[0] + rgba[i * 4 + 1] * axis[1] + rgba[i * 4 + 2] * axis[2];
+        if (dot < minDot)
+        {
+            minDot = dot;
+            minIndex = i;
+        }
+        if (dot > maxDot)
+        {
+            maxDot = dot;
+            maxIndex = i;
+        }
+    }
+
+    std::array<int, 3> lo;
+    std::array<int, 3> hi;
+    for (int c = 0; c < 3; c++)
+    {
+        int l = rgba[minIndex * 4 + c];
+        int h = rgba[maxIndex * 4 + c];
+        int inset = (h - l) / 16;
+        lo[c] = std::clamp(l + inset, 0, 255);
+        hi[c] = std::clamp(h - inset, 0, 255);
+    }
+
+    std::uint16_t c0 = packRGB565(hi[0], hi[1], hi[2]);
+    std::uint16_t c1 = packRGB565(lo[0], lo[1], lo[2]);
+    if (c0 < c1)
+        std::swap(c0, c1);
+
+    putLE16(block, c0);
+    putLE16(block + 2, c1);
+
+    std::uint32_t indices = 0;
+    if (c0 != c1)
+    {
+        std::array<std::array<int, 3>, 4> palette;
+        unpackRGB565(c0, palette[0].data());
+        unpackRGB565(c1, palette[1].data());
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (int i = 0; i < BlockPixels; i++)
+        {
+            int best = 0;
+            int bestDistance = 0x7fffffff;
+            for (int j = 0; j < 4; j++)
+            {
+                int distance = 0;
+                for (int c = 0; c < 3; c++)
+                {
+                    int d = static_cast<int>(rgba[i * 4 + c]) - palette[j][c];
+                    distance += d * d;
+                }
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = j;
+                }
+            }
+            indices |= static_cast<std::uint32_t>(best) << (2 * i);
+        }
+    }
+
+    for (int i = 0; i < 4; i++)
+        block[4 + i] = static_cast<std::uint8_t>(indices >> (8 * i));
+}
+
+void
+encodeAlphaBlock(const std::uint8_t* rgba, std::uint8_t* block)
+{
+    int lo = 255;
+    int hi = 0;
+    for (int i = 0; i < BlockPixels; i++)
+    {
+        lo = std::min(lo, static_cast<int>(rgba[i * 4 + 3]));
+        hi = std::max(hi, static_cast<int>(rgba[i * 4 + 3]));
+    }
+
+    block[0] = static_cast<std::uint8_t>(hi);
+    block[1] = static_cast<std::uint8_t>(lo);
+
+    // With a0 > a1 the block interpolates six values between the end points
+    std::uint64_t indices = 0;
+    if (hi != lo)
+    {
+        std::array<int, 8> palette;
+        palette[0] = hi;
+        palette[1] = lo;
+        for (int j = 1; j < 7; j++)
+            palette[j + 1] = ((7 - j) * hi + j * lo) / 7;
+
+        for (int i = 0; i < BlockPixels; i++)
+        {
+            int a = rgba[i * 4 + 3];
+            int best = 0;
+            int bestDistance = 256;
+            for (int j = 0; j < 8; j++)
+            {
+                int distance = std::abs(a - palette[j]);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = j;
+                }
+            }
+            indices |= static_cast<std::uint64_t>(best) << (3 * i);
+        }
+    }
+
+    for (int i = 0; i < 6; i++)
+        block[2 + i] = static_cast<std::uint8_t>(indices >> (8 * i));
+}
+
+// Expand an RGB or RGBA image to tightly packed RGBA
+std::vector<std::uint8_t>
+toRGBA(const Image& img)
+{
+    int width = img.getWidth();
+    int height = img.getHeight();
+    int components = img.getComponents();
+    std::vector<std::uint8_t> rgba(static_cast<std::size_t>(width) * height * 4);
+    for (int y = 0; y < height; y++)
+    {
+        const std::uint8_t* src = img.getPixels() + y * img.getPitch();
+        std::uint8_t* dst = rgba.data() + static_cast<std::size_t>(y) * width * 4;
+        for (int x = 0; x < width; x++)
+        {
+            std::memcpy(dst + x * 4, src + x * components, 3);
+            dst[x * 4 + 3] = components == 4 ? src[x * components + 3] : 255;
+        }
+    }
+
+    return rgba;
+}
+
+// Box filter an RGBA level down to the next mip level
+std::vector<std::uint8_t>
+downsample(const std::vector<std::uint8_t>& src, int width, int height)
+{
+    int mipWidth = std::max(width / 2, 1);
+    int mipHeight = std::max(height / 2, 1);
+    std::vector<std::uint8_t> dst(static_cast<std::size_t>(mipWidth) * mipHeight * 4);
+    for (int y = 0; y < mipHeight; y++)
+    {
+        int y0 = std::min(y * 2, height - 1);
+        int y1 = std::min(y * 2 + 1, height - 1);
+        for (int x = 0; x < mipWidth; x++)
+        {
+            int x0 = std::min(x * 2, width - 1);
+            int x1 = std::min(x * 2 + 1, width - 1);
+            for (int c = 0; c < 4; c++)
+            {
+                int sum = src[(y0 * width + x0) * 4 + c] + src[(y0 * width + x1) * 4 + c]
+                        + src[(y1 * width + x0) * 4 + c] + src[(y1 * width + x1) * 4 + c];
+                dst[(y * mipWidth + x) * 4 + c] = static_cast<std::uint8_t>((sum + 2) / 4);
+            }
+        }
+    }
+
+    return dst;
+}
+
+void
+encodeLevel(const std::vector<std::uint8_t>& rgba,
+            int width, int height,
+            bool alpha,
+            std::uint8_t* out)
+{
+    const int blockSize = alpha ? 16 : 8;
+    std::array<std::uint8_t, BlockPixels * 4> pixels;
+    for (int by = 0; by < height; by += 4)
+    {
+        for (int bx = 0; bx < width; bx += 4)
+        {
+            // Partial blocks at the edges of small mip levels repeat the
+            // last row and column
+            for (int y = 0; y < 4; y++)
+            {
+                int sy = std::min(by + y, height - 1);
+                for (int x = 0; x < 4; x++)
+                {
+                    int sx = std::min(bx + x, width - 1);
+                    std::memcpy(pixels.data() + (y * 4 + x) * 4,
+                                rgba.data() + (static_cast<std::size_t>(sy) * width + sx) * 4,
+                                4);
+                }
+            }
+
+            if (alpha)
+                EncodeBlockDXT5(pixels.data(), out);
+            else
+                EncodeBlockDXT1(pixels.data(), out);
+            out += blockSize;
+        }
+    }
+}
+
+int
+mipLevelCount(int width, int height)
+{
+    int count = 1;
+    while (width > 1 || height > 1)
+    {
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+        count++;
+    }
+    return count;
+}
+
+} // end unnamed namespace
+
+
+void
+EncodeBlockDXT1(const std::uint8_t* rgba, std::uint8_t* block)
+{
+    encodeColorBlock(rgba, block);
+}
+
+
+void
+EncodeBlockDXT5(const std::uint8_t* rgba, std::uint8_t* block)
+{
+    encodeAlphaBlock(rgba, block);
+    encodeColorBlock(rgba, block + 8);
+}
+
+
+std::unique_ptr<Image>
+CompressImageDXT(const Image& img, bool generateMipMaps)
+{
+    if (img.getFormat() != PixelFormat::RGB && img.getFormat() != PixelFormat::RGBA)
+        return nullptr;
+
+    int width = img.getWidth();
+    int height = img.getHeight();
+    std::vector<std::uint8_t> rgba = toRGBA(img);
+
+    // Use DXT1 for RGBA images that are in fact opaque
+    bool alpha = false;
+    if (img.hasAlpha())
+    {
+        for (std::size_t i = 3; i < rgba.size(); i += 4)
+        {
+            if (rgba[i] != 255)
+            {
+                alpha = true;
+                break;
+            }
+        }
+    }
+
+    int mipLevels = generateMipMaps ? mipLevelCount(width, height) : 1;
+    auto compressed = std::make_unique<Image>(alpha ? PixelFormat::DXT5 : PixelFormat::DXT1,
+                                              width, height, mipLevels);
+    for (int mip = 0; mip < mipLevels; mip++)
+    {
+        int mipWidth = std::max(width >> mip, 1);
+        int mipHeight = std::max(height >> mip, 1);
+        if (mip > 0)
+            rgba = downsample(rgba, std::max(width >> (mip - 1), 1), std::max(height >> (mip - 1), 1));
+        encodeLevel(rgba, mipWidth, mipHeight, alpha, compressed->getMipLevel(mip));
+    }
+
+    return compressed;
+}
@@ -0,0 +1,26 @@
+// dxtencode.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <celengine/image.h>
+
+// Encode a block of 4x4 RGBA pixels (row-major, 64 bytes) as an 8 byte DXT1
+// or a 16 byte DXT5 block.
+void EncodeBlockDXT1(const std::uint8_t* rgba, std::uint8_t* block);
+void EncodeBlockDXT5(const std::uint8_t* rgba, std::uint8_t* block);
+
+// Compress an uncompressed RGB or RGBA image to DXT1 (opaque images) or DXT5
+// (images with non-opaque alpha). If generateMipMaps is set, a complete set of
+// box-filtered mip levels is built before encoding. Returns nullptr for
+// formats that can't be compressed.
+std::unique_ptr<Image> CompressImageDXT(const Image& img, bool generateMipMaps);
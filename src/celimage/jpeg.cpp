@@ -8,8 +8,18 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <cstdio>  // fopen, fclose
 #include <cstring> // memcpy
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
 #include <setjmp.h>
 extern "C" {
 #include <jpeglib.h>
@@ -22,6 +32,12 @@ using celestia::util::GetLogger;
 
 namespace
 {
+// Images with at least this many pixels are decoded on several threads
+// when they contain restart markers at the start of MCU rows
+constexpr std::size_t ParallelDecodeMinPixels = 4096 * 2048;
+// Number of strips per decoding thread, to even out the load
+constexpr unsigned int StripsPerThread = 4;
+
 struct my_error_mgr
 {
     struct jpeg_error_mgr pub;  // "public" fields
@@ -42,137 +58,388 @@ METHODDEF(void) my_error_exit(j_common_ptr cinfo)
     // Return control to the setjmp point
     longjmp(myerr->setjmp_buffer, 1);
 }
-} // anonymous namespace
 
-Image* LoadJPEGImage(const fs::path& filename, int /*unused*/)
+// Decode the rows of a JPEG whose source has been set up. This is kept apart
+// from the setjmp in decodeJPEG, so none of the locals it changes can be
+// clobbered by the longjmp on errors.
+bool decodeRows(jpeg_decompress_struct& cinfo,
+                Image*& img,
+                int firstRow,
+                int skipRows,
+                int rowCount)
 {
-    Image* img = nullptr;
+    (void) jpeg_read_header(&cinfo, TRUE);
+    (void) jpeg_start_decompress(&cinfo);
 
-    // This struct contains the JPEG decompression parameters and pointers to
-    // working space (which is allocated as needed by the JPEG library).
-    struct jpeg_decompress_struct cinfo;
+    int row_stride = cinfo.output_width * cinfo.output_components;
+    if (img == nullptr)
+    {
+        PixelFormat format = PixelFormat::RGB;
+        if (cinfo.output_components == 1)
+            format = PixelFormat::LUMINANCE;
+        img = new Image(format, cinfo.output_width, cinfo.output_height);
+    }
 
-    // We use our private extension JPEG error handler.
-    // Note that this struct must live as long as the main JPEG parameter
-    // struct, to avoid dangling-pointer problems.
-    struct my_error_mgr jerr;
-    // More stuff
-    JSAMPARRAY buffer;        // Output row buffer
-    int row_stride;        // physical row width in output buffer
-    long cont;
+    if (rowCount < 0)
+        rowCount = static_cast<int>(cinfo.output_height) - skipRows;
+    if (static_cast<int>(cinfo.output_width) != img->getWidth()
+        || cinfo.output_components != img->getComponents()
+        || skipRows + rowCount > static_cast<int>(cinfo.output_height)
+        || firstRow + rowCount > img->getHeight())
+        return false;
 
-    // In this example we want to open the input file before doing anything else,
-    // so that the setjmp() error recovery below can assume the file is open.
-    // VERY IMPORTANT: use "b" option to fopen() if you are on a machine that
-    // requires it in order to read binary files.
+    // Scanlines are decoded straight into the image
+    JSAMPARRAY scratch = (*cinfo.mem->alloc_sarray)
+        ((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
+    while (cinfo.output_scanline < cinfo.output_height)
+    {
+        int row = static_cast<int>(cinfo.output_scanline) - skipRows;
+        JSAMPROW dest = row >= 0 && row < rowCount ? img->getPixelRow(firstRow + row) : scratch[0];
+        (void) jpeg_read_scanlines(&cinfo, &dest, 1);
+    }
 
-    FILE *in;
-#ifdef _WIN32
-    in = _wfopen(filename.c_str(), L"rb");
-#else
-    in = fopen(filename.c_str(), "rb");
-#endif
-    if (!in)
-        return nullptr;
+    (void) jpeg_finish_decompress(&cinfo);
+    return true;
+}
 
-    // Step 1: allocate and initialize JPEG decompression object
-    // We set up the normal JPEG error routines, then override error_exit.
+// Decode the JPEG in data to the rows of img starting at firstRow. If img is
+// null, it's created with the size of the JPEG. The first skipRows decoded
+// rows are dropped, as are those after rowCount rows if it's non-negative.
+bool decodeJPEG(const std::vector<std::uint8_t>& data,
+                Image*& img,
+                int firstRow,
+                int skipRows = 0,
+                int rowCount = -1)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct my_error_mgr jerr;
     cinfo.err = jpeg_std_error(&jerr.pub);
     jerr.pub.error_exit = my_error_exit;
-    // Establish the setjmp return context for my_error_exit to use.
     if (setjmp(jerr.setjmp_buffer))
     {
-        // If we get here, the JPEG code has signaled an error.
-        // We need to clean up the JPEG object, close the input file, and return.
         jpeg_destroy_decompress(&cinfo);
-        fclose(in);
-        delete img;
-
-        return nullptr;
+        return false;
     }
 
-    // Now we can initialize the JPEG decompression object.
     jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, const_cast<unsigned char*>(data.data()), static_cast<unsigned long>(data.size()));
+    bool decoded = decodeRows(cinfo, img, firstRow, skipRows, rowCount);
+    jpeg_destroy_decompress(&cinfo);
+    return decoded;
+}
 
-    // Step 2: specify data source (eg, a file)
-    jpeg_stdio_src(&cinfo, in);
+std::uint16_t readBE16(const std::vector<std::uint8_t>& data, std::size_t pos)
+{
+    return static_cast<std::uint16_t>((data[pos] << 8) | data[pos + 1]);
+}
 
-    // Step 3: read file parameters with jpeg_read_header()
-    (void) jpeg_read_header(&cinfo, TRUE);
+// A baseline JPEG split at the restart markers which start MCU rows. Each
+// strip is turned into a JPEG of its own by patching the image height in
+// the frame header and renumbering the restart markers. Strips are decoded
+// with the rows around them, as the chroma upsampling of the rows at the
+// edges depends on their neighbors.
+class JPEGStrips
+{
+ public:
+    struct Strip
+    {
+        int firstRow;
+        int height;
+        std::size_t firstInterval;
+        std::size_t endInterval;
+    };
+
+    bool parse(const std::vector<std::uint8_t>&);
+    void mergeStrips(std::size_t count);
+    std::size_t size() const { return strips.size(); }
+    const Strip& getStrip(std::size_t strip) const { return strips[strip]; }
+    // The strip extended by its neighbors
+    Strip getDecodedStrip(std::size_t strip) const;
+    std::vector<std::uint8_t> makeJPEG(const std::vector<std::uint8_t>&, const Strip&) const;
+
+ private:
+
+    std::size_t heightOffset{ 0 };
+    std::size_t scanOffset{ 0 };
+    std::size_t scanEnd{ 0 };
+    // Offsets of the scan data of each restart interval
+    std::vector<std::size_t> intervals;
+    // The smallest strips, each starting at a restart marker
+    std::vector<Strip> units;
+    std::vector<Strip> strips;
+    // The range of units in each strip
+    std::vector<std::pair<std::size_t, std::size_t>> stripUnits;
+};
 
-    // We can ignore the return value from jpeg_read_header since
-    //  (a) suspension is not possible with the stdio data source, and
-    //  (b) we passed TRUE to reject a tables-only JPEG file as an error.
+bool JPEGStrips::parse(const std::vector<std::uint8_t>& data)
+{
+    if (data.size() < 4 || data[0] != 0xff || data[1] != 0xd8)
+        return false;
 
-    // Step 4: set parameters for decompression
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    int maxH = 1;
+    int maxV = 1;
+    unsigned int restartInterval = 0;
 
-    // In this example, we don't need to change any of the defaults set by
-    // jpeg_read_header(), so we do nothing here.
+    // Walk the segments up to the start of scan
+    std::size_t pos = 2;
+    for (;;)
+    {
+        if (pos + 4 > data.size() || data[pos] != 0xff)
+            return false;
+        std::uint8_t marker = data[pos + 1];
+        if (marker == 0xff)
+        {
+            pos++;
+            continue;
+        }
 
-    // Step 5: Start decompressor
+        std::size_t length = readBE16(data, pos + 2);
+        if (length < 2 || pos + 2 + length > data.size())
+            return false;
 
-    (void) jpeg_start_decompress(&cinfo);
-    // We can ignore the return value since suspension is not possible
-    // with the stdio data source.
-
-    // We may need to do some setup of our own at this point before reading
-    // the data.  After jpeg_start_decompress() we have the correct scaled
-    // output image dimensions available, as well as the output colormap
-    // if we asked for color quantization.
-    // In this example, we need to make an output work buffer of the right size.
-    // JSAMPLEs per row in output buffer
-    row_stride = cinfo.output_width * cinfo.output_components;
-    // Make a one-row-high sample array that will go away when done with image
-    buffer = (*cinfo.mem->alloc_sarray)
-        ((j_common_ptr) & cinfo, JPOOL_IMAGE, row_stride, 1);
-
-    // Step 6: while (scan lines remain to be read)
-    //             jpeg_read_scanlines(...);
-
-    // Here we use the library's state variable cinfo.output_scanline as the
-    // loop counter, so that we don't have to keep track ourselves.
-
-    PixelFormat format = PixelFormat::RGB;
-    if (cinfo.output_components == 1)
-        format = PixelFormat::LUMINANCE;
-
-    img = new Image(format, cinfo.image_width, cinfo.image_height);
-
-    // cont = cinfo.output_height - 1;
-    cont = 0;
-    while (cinfo.output_scanline < cinfo.output_height)
+        if (marker == 0xc0 || marker == 0xc1)
+        {
+            // Baseline or extended sequential, Huffman coded
+            if (length < 8)
+                return false;
+            heightOffset = pos + 5;
+            height = readBE16(data, pos + 5);
+            width = readBE16(data, pos + 7);
+            components = data[pos + 9];
+            if (length < 8 + 3 * static_cast<std::size_t>(components))
+                return false;
+            for (int i = 0; i < components; i++)
+            {
+                std::uint8_t sampling = data[pos + 11 + i * 3];
+                maxH = std::max(maxH, sampling >> 4);
+                maxV = std::max(maxV, sampling & 0xf);
+            }
+        }
+        else if ((marker >= 0xc2 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc)
+                 || marker == 0xd9)
+        {
+            // Progressive, lossless and arithmetic coded images have to be
+            // decoded sequentially
+            return false;
+        }
+        else if (marker == 0xdd)
+        {
+            if (length < 4)
+                return false;
+            restartInterval = readBE16(data, pos + 4);
+        }
+        else if (marker == 0xda)
+        {
+            // All components must be in the one scan
+            if (length < 3 || data[pos + 4] != components)
+                return false;
+            scanOffset = pos + 2 + length;
+            break;
+        }
+
+        pos += 2 + length;
+    }
+
+    if (width == 0 || height == 0 || restartInterval == 0)
+        return false;
+
+    // Find the restart markers; any other marker ends the scan
+    intervals.push_back(scanOffset);
+    for (pos = scanOffset; pos + 1 < data.size(); pos++)
     {
-        // jpeg_read_scanlines expects an array of pointers to scanlines.
-        // Here the array is only one element long, but you could ask for
-        // more than one scanline at a time if that's more convenient.
-        (void) jpeg_read_scanlines(&cinfo, buffer, 1);
+        if (data[pos] != 0xff || data[pos + 1] == 0x00 || data[pos + 1] == 0xff)
+            continue;
+        if (data[pos + 1] < 0xd0 || data[pos + 1] > 0xd7)
+            break;
+        pos++;
+        intervals.push_back(pos + 1);
+    }
+    scanEnd = pos;
+
+    int mcuWidth = 8 * maxH;
+    int mcuHeight = 8 * maxV;
+    std::size_t mcusPerRow = static_cast<std::size_t>((width + mcuWidth - 1) / mcuWidth);
+    std::size_t mcuRows = static_cast<std::size_t>((height + mcuHeight - 1) / mcuHeight);
+    std::size_t intervalCount = intervals.size();
+    if (intervalCount * restartInterval < mcusPerRow * mcuRows)
+        return false;
 
-        // Assume put_scanline_someplace wants a pointer and sample count.
-        // put_scanline_someplace(buffer[0], row_stride);
-        memcpy(img->getPixelRow(cont), buffer[0], row_stride);
-        cont++;
+    // Every restart interval that begins an MCU row can begin a strip
+    std::size_t first = 0;
+    for (std::size_t i = 1; i <= intervalCount; i++)
+    {
+        std::size_t mcu = i * restartInterval;
+        if (i < intervalCount && mcu % mcusPerRow != 0)
+            continue;
+        int firstRow = static_cast<int>(first * restartInterval / mcusPerRow) * mcuHeight;
+        int endRow = i < intervalCount
+                   ? static_cast<int>(mcu / mcusPerRow) * mcuHeight
+                   : height;
+        units.push_back({ firstRow, std::min(endRow, height) - firstRow, first, i });
+        first = i;
     }
 
-    // Step 7: Finish decompression
+    strips = units;
+    for (std::size_t i = 0; i < units.size(); i++)
+        stripUnits.emplace_back(i, i + 1);
+    return units.size() > 2;
+}
 
-    (void) jpeg_finish_decompress(&cinfo);
-    // We can ignore the return value since suspension is not possible
-    // with the stdio data source.
+// Join neighboring strips until there are no more than count of them
+void JPEGStrips::mergeStrips(std::size_t count)
+{
+    if (units.size() <= count)
+        return;
 
-    // Step 8: Release JPEG decompression object
+    strips.clear();
+    stripUnits.clear();
+    std::size_t perStrip = (units.size() + count - 1) / count;
+    for (std::size_t i = 0; i < units.size(); i += perStrip)
+    {
+        std::size_t end = std::min(i + perStrip, units.size());
+        const Strip& first = units[i];
+        const Strip& last = units[end - 1];
+        strips.push_back({ first.firstRow,
+                           last.firstRow + last.height - first.firstRow,
+                           first.firstInterval,
+                           last.endInterval });
+        stripUnits.emplace_back(i, end);
+    }
+}
 
-    // This is an important step since it will release a good deal of memory.
+JPEGStrips::Strip JPEGStrips::getDecodedStrip(std::size_t strip) const
+{
+    auto [firstUnit, endUnit] = stripUnits[strip];
+    const Strip& first = units[firstUnit > 0 ? firstUnit - 1 : firstUnit];
+    const Strip& last = units[endUnit < units.size() ? endUnit : endUnit - 1];
+    return { first.firstRow,
+             last.firstRow + last.height - first.firstRow,
+             first.firstInterval,
+             last.endInterval };
+}
+
+std::vector<std::uint8_t> JPEGStrips::makeJPEG(const std::vector<std::uint8_t>& data,
+                                               const Strip& s) const
+{
+    std::vector<std::uint8_t> result(data.begin(), data.begin() + scanOffset);
+    result[heightOffset] = static_cast<std::uint8_t>(s.height >> 8);
+    result[heightOffset + 1] = static_cast<std::uint8_t>(s.height & 0xff);
+
+    for (std::size_t i = s.firstInterval; i < s.endInterval; i++)
+    {
+        if (i > s.firstInterval)
+        {
+            result.push_back(0xff);
+            result.push_back(static_cast<std::uint8_t>(0xd0 + (i - s.firstInterval - 1) % 8));
+        }
+        // The scan data of an interval runs up to the restart marker
+        // following it
+        std::size_t end = i + 1 < intervals.size() ? intervals[i + 1] - 2 : scanEnd;
+        result.insert(result.end(), data.begin() + intervals[i], data.begin() + end);
+    }
+
+    result.push_back(0xff);
+    result.push_back(0xd9);
+    return result;
+}
+
+// Decode a large JPEG with restart markers on several threads, each
+// decoding a strip of rows straight into the image.
+Image* decodeJPEGParallel(const std::vector<std::uint8_t>& data)
+{
+    unsigned int nThreads = std::thread::hardware_concurrency();
+    if (nThreads < 2)
+        return nullptr;
+
+    // Read the header to find the image size and output format
+    struct jpeg_decompress_struct cinfo;
+    struct my_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = my_error_exit;
+    if (setjmp(jerr.setjmp_buffer))
+    {
+        jpeg_destroy_decompress(&cinfo);
+        return nullptr;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, const_cast<unsigned char*>(data.data()), static_cast<unsigned long>(data.size()));
+    (void) jpeg_read_header(&cinfo, TRUE);
+    jpeg_calc_output_dimensions(&cinfo);
+    int width = static_cast<int>(cinfo.output_width);
+    int height = static_cast<int>(cinfo.output_height);
+    int components = cinfo.output_components;
     jpeg_destroy_decompress(&cinfo);
 
-    // After finish_decompress, we can close the input file.
-    // Here we postpone it until after no more JPEG errors are possible,
-    // so as to simplify the setjmp error logic above.  (Actually, I don't
-    // think that jpeg_destroy can do an error exit, but why assume anything...
+    if (static_cast<std::size_t>(width) * static_cast<std::size_t>(height) < ParallelDecodeMinPixels
+        || (components != 1 && components != 3))
+    {
+        return nullptr;
+    }
+
+    JPEGStrips strips;
+    if (!strips.parse(data))
+        return nullptr;
+    strips.mergeStrips(static_cast<std::size_t>(nThreads) * StripsPerThread);
+    nThreads = std::min(nThreads, static_cast<unsigned int>(strips.size()));
+
+    auto img = std::make_unique<Image>(components == 1 ? PixelFormat::LUMINANCE : PixelFormat::RGB,
+                                       width, height);
+    std::atomic<std::size_t> nextStrip{ 0 };
+    std::atomic<bool> failed{ false };
+    auto decodeStrips = [&]()
+    {
+        for (;;)
+        {
+            std::size_t strip = nextStrip.fetch_add(1);
+            if (strip >= strips.size() || failed)
+                return;
+
+            const JPEGStrips::Strip& output = strips.getStrip(strip);
+            JPEGStrips::Strip decoded = strips.getDecodedStrip(strip);
+            Image* dest = img.get();
+            if (!decodeJPEG(strips.makeJPEG(data, decoded), dest,
+                            output.firstRow,
+                            output.firstRow - decoded.firstRow,
+                            output.height))
+            {
+                failed = true;
+            }
+        }
+    };
 
-    fclose(in);
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < nThreads; i++)
+        workers.emplace_back(decodeStrips);
+    decodeStrips();
+    for (std::thread& worker : workers)
+        worker.join();
 
-    // At this point you may want to check to see whether any corrupt-data
-    // warnings occurred (test whether jerr.pub.num_warnings is nonzero).
+    return failed ? nullptr : img.release();
+}
+} // anonymous namespace
+
+Image* LoadJPEGImage(const fs::path& filename, int /*unused*/)
+{
+    std::vector<std::uint8_t> data;
+    {
+        std::ifstream in(filename, std::ios::in | std::ios::binary);
+        if (!in.good())
+            return nullptr;
+        data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    if (Image* img = decodeJPEGParallel(data); img != nullptr)
+        return img;
+
+    Image* img = nullptr;
+    if (!decodeJPEG(data, img, 0))
+    {
+        delete img;
+        return nullptr;
+    }
 
     return img;
 }
@@ -0,0 +1,279 @@
+// ktx.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Loader for KTX2 texture containers, see
+// https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <celengine/glsupport.h>
+#include <celengine/image.h>
+#include <celutil/binaryread.h>
+#include <celutil/logger.h>
+#include "dds_decompress.h"
+
+using celestia::PixelFormat;
+using celestia::util::GetLogger;
+
+namespace gl = celestia::gl;
+namespace celutil = celestia::util;
+
+namespace
+{
+
+constexpr std::array<std::uint8_t, 12> KTX2Identifier =
+{
+    0xab, 0x4b, 0x54, 0x58, 0x20, 0x32, 0x30, 0xbb, 0x0d, 0x0a, 0x1a, 0x0a
+};
+
+struct KTX2Header
+{
+    std::uint32_t vkFormat;
+    std::uint32_t typeSize;
+    std::uint32_t pixelWidth;
+    std::uint32_t pixelHeight;
+    std::uint32_t pixelDepth;
+    std::uint32_t layerCount;
+    std::uint32_t faceCount;
+    std::uint32_t levelCount;
+    std::uint32_t supercompressionScheme;
+};
+
+// The largest of either dimension when the GL limit isn't known yet
+constexpr std::uint32_t MaxKTX2Dimension = 1u << 16;
+
+struct KTX2Level
+{
+    std::uint64_t byteOffset;
+    std::uint64_t byteLength;
+    std::uint64_t uncompressedByteLength;
+};
+
+// The size of the index between the header and the level index: the offsets
+// and lengths of the data format descriptor, the key/value data and the
+// supercompression global data.
+constexpr std::streamoff KTX2IndexSize = 4 * 4 + 2 * 8;
+
+enum class SupercompressionScheme : std::uint32_t
+{
+    None      = 0,
+    BasisLZ   = 1,
+    Zstandard = 2,
+    ZLIB      = 3,
+};
+
+// Map the Vulkan formats that Image can hold to pixel formats. Celestia
+// doesn't use sRGB textures, so sRGB formats are loaded as linear ones.
+PixelFormat toPixelFormat(std::uint32_t vkFormat)
+{
+    switch (vkFormat)
+    {
+    case 9:   // VK_FORMAT_R8_UNORM
+    case 15:  // VK_FORMAT_R8_SRGB
+        return PixelFormat::LUMINANCE;
+    case 16:  // VK_FORMAT_R8G8_UNORM
+    case 22:  // VK_FORMAT_R8G8_SRGB
+        return PixelFormat::LUM_ALPHA;
+    case 23:  // VK_FORMAT_R8G8B8_UNORM
+    case 29:  // VK_FORMAT_R8G8B8_SRGB
+        return PixelFormat::RGB;
+    case 30:  // VK_FORMAT_B8G8R8_UNORM
+    case 36:  // VK_FORMAT_B8G8R8_SRGB
+        return PixelFormat::BGR;
+    case 37:  // VK_FORMAT_R8G8B8A8_UNORM
+    case 43:  // VK_FORMAT_R8G8B8A8_SRGB
+        return PixelFormat::RGBA;
+    case 44:  // VK_FORMAT_B8G8R8A8_UNORM
+    case 50:  // VK_FORMAT_B8G8R8A8_SRGB
+        return PixelFormat::BGRA;
+    case 131: // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+    case 132: // VK_FORMAT_BC1_RGB_SRGB_BLOCK
+    case 133: // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+    case 134: // VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+        return PixelFormat::DXT1;
+    case 135: // VK_FORMAT_BC2_UNORM_BLOCK
+    case 136: // VK_FORMAT_BC2_SRGB_BLOCK
+        return PixelFormat::DXT3;
+    case 137: // VK_FORMAT_BC3_UNORM_BLOCK
+    case 138: // VK_FORMAT_BC3_SRGB_BLOCK
+        return PixelFormat::DXT5;
+    default:
+        return PixelFormat::INVALID;
+    }
+}
+
+int bytesPerPixel(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::LUMINANCE:
+        return 1;
+    case PixelFormat::LUM_ALPHA:
+        return 2;
+    case PixelFormat::RGB:
+    case PixelFormat::BGR:
+        return 3;
+    default:
+        return 4;
+    }
+}
+
+bool isCompressedFormat(PixelFormat format)
+{
+    return format == PixelFormat::DXT1 || format == PixelFormat::DXT3 || format == PixelFormat::DXT5;
+}
+
+// KTX2 level data has no row padding, while Image rows are padded to four
+// bytes. Compressed levels are copied as they are.
+bool readLevel(std::ifstream& in, const KTX2Level& level, Image& img, int mip)
+{
+    int width = std::max(img.getWidth() >> mip, 1);
+    int height = std::max(img.getHeight() >> mip, 1);
+    if (img.isCompressed())
+    {
+        if (level.byteLength != static_cast<std::uint64_t>(img.getMipLevelSize(mip)))
+            return false;
+        return in.seekg(static_cast<std::streamoff>(level.byteOffset)).read(
+            reinterpret_cast<char*>(img.getMipLevel(mip)), img.getMipLevelSize(mip)).good();
+    }
+
+    int rowSize = width * bytesPerPixel(img.getFormat());
+    if (level.byteLength != static_cast<std::uint64_t>(rowSize) * static_cast<std::uint64_t>(height))
+        return false;
+
+    in.seekg(static_cast<std::streamoff>(level.byteOffset));
+    for (int y = 0; y < height; y++)
+    {
+        if (!in.read(reinterpret_cast<char*>(img.getPixelRow(mip, y)), rowSize).good())
+            return false;
+    }
+
+    return true;
+}
+
+} // anonymous namespace
+
+Image* LoadKTXImage(const fs::path& filename)
+{
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in.good())
+    {
+        GetLogger()->error("Error opening KTX2 texture file {}.\n", filename);
+        return nullptr;
+    }
+
+    std::array<std::uint8_t, KTX2Identifier.size()> identifier;
+    if (!in.read(reinterpret_cast<char*>(identifier.data()), identifier.size()).good()
+        || identifier != KTX2Identifier)
+    {
+        GetLogger()->error("KTX2 texture file {} has bad header.\n", filename);
+        return nullptr;
+    }
+
+    KTX2Header header;
+    if (!celutil::readLE<std::uint32_t>(in, header.vkFormat)
+        || !celutil::readLE<std::uint32_t>(in, header.typeSize)
+        || !celutil::readLE<std::uint32_t>(in, header.pixelWidth)
+        || !celutil::readLE<std::uint32_t>(in, header.pixelHeight)
+        || !celutil::readLE<std::uint32_t>(in, header.pixelDepth)
+        || !celutil::readLE<std::uint32_t>(in, header.layerCount)
+        || !celutil::readLE<std::uint32_t>(in, header.faceCount)
+        || !celutil::readLE<std::uint32_t>(in, header.levelCount)
+        || !celutil::readLE<std::uint32_t>(in, header.supercompressionScheme))
+    {
+        GetLogger()->error("KTX2 texture file {} has bad header.\n", filename);
+        return nullptr;
+    }
+
+    if (header.supercompressionScheme != static_cast<std::uint32_t>(SupercompressionScheme::None))
+    {
+        GetLogger()->error("Supercompressed KTX2 texture file {} isn't supported.\n", filename);
+        return nullptr;
+    }
+
+    // Only plain 2D textures; arrays, cube maps and 3D textures can't be
+    // held by an Image
+    if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1
+        || header.layerCount > 1 || header.faceCount != 1)
+    {
+        GetLogger()->error("KTX2 texture file {} isn't a 2D texture.\n", filename);
+        return nullptr;
+    }
+
+    // The dimensions and level count come straight from the file, so they're
+    // checked before anything is allocated for them
+    std::uint32_t maxDimension = gl::maxTextureSize > 0
+                               ? static_cast<std::uint32_t>(gl::maxTextureSize)
+                               : MaxKTX2Dimension;
+    maxDimension = std::min(maxDimension, static_cast<std::uint32_t>(std::numeric_limits<int>::max()));
+    if (header.pixelWidth > maxDimension || header.pixelHeight > maxDimension)
+    {
+        GetLogger()->error("KTX2 texture file {} is larger than {} pixels.\n", filename, maxDimension);
+        return nullptr;
+    }
+
+    // A full mip chain has floor(log2(max(width, height))) + 1 levels
+    std::uint32_t maxLevelCount = 1;
+    for (std::uint32_t size = std::max(header.pixelWidth, header.pixelHeight); size > 1; size >>= 1)
+        ++maxLevelCount;
+    if (header.levelCount > maxLevelCount)
+    {
+        GetLogger()->error("KTX2 texture file {} has too many levels.\n", filename);
+        return nullptr;
+    }
+
+    PixelFormat format = toPixelFormat(header.vkFormat);
+    if (format == PixelFormat::INVALID)
+    {
+        GetLogger()->error("Unsupported format {} in KTX2 texture file {}.\n", header.vkFormat, filename);
+        return nullptr;
+    }
+
+    // A level count of zero asks for mipmaps to be generated at load time
+    std::uint32_t levelCount = std::max(header.levelCount, 1u);
+    std::vector<KTX2Level> levels(levelCount);
+    in.seekg(KTX2IndexSize, std::ios::cur);
+    for (KTX2Level& level : levels)
+    {
+        if (!celutil::readLE<std::uint64_t>(in, level.byteOffset)
+            || !celutil::readLE<std::uint64_t>(in, level.byteLength)
+            || !celutil::readLE<std::uint64_t>(in, level.uncompressedByteLength))
+        {
+            GetLogger()->error("KTX2 texture file {} has a bad level index.\n", filename);
+            return nullptr;
+        }
+    }
+
+    auto img = std::make_unique<Image>(format,
+                                       static_cast<int>(header.pixelWidth),
+                                       static_cast<int>(header.pixelHeight),
+                                       static_cast<int>(levelCount));
+    for (std::uint32_t mip = 0; mip < levelCount; mip++)
+    {
+        if (!readLevel(in, levels[mip], *img, static_cast<int>(mip)))
+        {
+            GetLogger()->error("Failed reading data from KTX2 texture file {}.\n", filename);
+            return nullptr;
+        }
+    }
+
+    // Without S3TC support the image is decompressed, as for DDS files
+    if (isCompressedFormat(format) && !gl::EXT_texture_compression_s3tc)
+    {
+        bool mipMaps = img->getWidth() <= gl::maxTextureSize && img->getHeight() <= gl::maxTextureSize;
+        return DecompressDXTImage(*img, mipMaps).release();
+    }
+
+    return img.release();
+}
@@ -7,7 +7,9 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 
 #include <Eigen/LU>
 
@@ -109,6 +111,58 @@ Frustum::testSphere(const Eigen::Vector3d& center, double radius) const
 }
 
 
+void
+Frustum::testSpheres(const float* centerX, const float* centerY, const float* centerZ,
+                     const float* radii, std::size_t count, Aspect* aspects) const
+{
+    // Spheres are tested in blocks, so that the flags of a block stay in
+    // the cache while it is tested against each plane
+    constexpr std::size_t BlockSize = 256;
+
+    unsigned int nPlanes = infinite ? 5 : 6;
+    std::uint8_t outside[BlockSize];
+    std::uint8_t intersect[BlockSize];
+
+    for (std::size_t start = 0; start < count; start += BlockSize)
+    {
+        std::size_t n = std::min(BlockSize, count - start);
+        const float* x = centerX + start;
+        const float* y = centerY + start;
+        const float* z = centerZ + start;
+        const float* r = radii + start;
+
+        std::fill_n(outside, n, std::uint8_t(0));
+        std::fill_n(intersect, n, std::uint8_t(0));
+        for (unsigned int i = 0; i < nPlanes; i++)
+        {
+            const Eigen::Vector4f& coeffs = planes[i].coeffs();
+            float a = coeffs.x();
+            float b = coeffs.y();
+            float c = coeffs.z();
+            float d = coeffs.w();
+            for (std::size_t j = 0; j < n; j++)
+            {
+                float distanceToPlane = a * x[j] + b * y[j] + c * z[j] + d;
+                outside[j] |= static_cast<std::uint8_t>(distanceToPlane < -r[j]);
+                intersect[j] |= static_cast<std::uint8_t>(distanceToPlane <= r[j]);
+            }
+        }
+
+        for (std::size_t j = 0; j < n; j++)
+            aspects[start + j] = outside[j] != 0 ? Outside : (intersect[j] != 0 ? Intersect : Inside);
+    }
+}
+
+
+void
+Frustum::testSpheres(const SphereBatch& spheres, std::vector<Aspect>& aspects) const
+{
+    aspects.resize(spheres.size());
+    testSpheres(spheres.x.data(), spheres.y.data(), spheres.z.data(), spheres.radii.data(),
+                spheres.size(), aspects.data());
+}
+
+
 void
 Frustum::transform(const Eigen::Matrix3f& m)
 {
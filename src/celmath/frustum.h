@@ -9,6 +9,9 @@
 
 #pragma once
 
+#include <cstddef>
+#include <vector>
+
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
@@ -16,6 +19,36 @@
 namespace celmath
 {
 
+/*! Spheres to be tested against a frustum together, with the coordinates
+ *  of their centers and their radii kept in separate arrays.
+ */
+class SphereBatch
+{
+public:
+    void clear()
+    {
+        x.clear();
+        y.clear();
+        z.clear();
+        radii.clear();
+    }
+
+    void add(const Eigen::Vector3f& center, float radius)
+    {
+        x.push_back(center.x());
+        y.push_back(center.y());
+        z.push_back(center.z());
+        radii.push_back(radius);
+    }
+
+    std::size_t size() const { return radii.size(); }
+
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> radii;
+};
+
 class Frustum
 {
  public:
@@ -50,6 +83,12 @@ class Frustum
     Aspect test(const Eigen::Vector3f& point) const;
     Aspect testSphere(const Eigen::Vector3f& center, float radius) const;
     Aspect testSphere(const Eigen::Vector3d& center, double radius) const;
+    // The aspects of count spheres, the same as testSphere() gives for
+    // each; the loops over the spheres have no branches, so that the
+    // compiler can vectorize them.
+    void testSpheres(const float* centerX, const float* centerY, const float* centerZ,
+                     const float* radii, std::size_t count, Aspect* aspects) const;
+    void testSpheres(const SphereBatch& spheres, std::vector<Aspect>& aspects) const;
 
  private:
     void init(float, float, float, float);
@@ -169,6 +169,33 @@ Perspective(T fovy, T aspect, T nearZ, T farZ)
     return m;
 }
 
+/*! Return a perspective projection matrix with no far plane which maps the
+ *  near plane to depth 1 and infinity to depth 0, for a [0, 1] clip range.
+ *  With a floating point depth buffer the depths have about the same
+ *  relative precision at all distances.
+ */
+template<class T> Eigen::Matrix<T, 4, 4>
+ReverseInfinitePerspective(T fovy, T aspect, T nearZ)
+{
+    using std::cos, std::sin;
+
+    if (aspect == static_cast<T>(0))
+        return Eigen::Matrix<T, 4, 4>::Identity();
+
+    T angle = degToRad(fovy / static_cast<T>(2));
+    T sine = sin(angle);
+    if (sine == static_cast<T>(0))
+        return Eigen::Matrix<T, 4, 4>::Identity();
+    T ctg = cos(angle) / sine;
+
+    Eigen::Matrix<T, 4, 4> m = Eigen::Matrix<T, 4, 4>::Zero();
+    m(0, 0) = ctg / aspect;
+    m(1, 1) = ctg;
+    m(2, 3) = nearZ;
+    m(3, 2) = static_cast<T>(-1);
+    return m;
+}
+
 /*! Return an orthographic projection matrix
  */
 template<class T> Eigen::Matrix<T, 4, 4>
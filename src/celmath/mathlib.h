@@ -12,6 +12,8 @@
 #include <config.h>
 
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 
 #include <Eigen/Core>
 
@@ -115,6 +117,35 @@ template<typename T> inline constexpr T sphereArea(T r)
     return static_cast<T>(4) * pi_v<T> * r * r;
 }
 
+// Base 2 logarithm of a positive normal float, to within a few ulps. The
+// exponent is taken from the bits and the logarithm of the mantissa from
+// the series of atanh, so unlike std::log2 it vectorizes.
+inline float fastLog2(float x)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+
+    // x = 2^e * m with m in [sqrt(1/2), sqrt(2))
+    auto e = static_cast<std::int32_t>(bits - 0x3f3504f3u) >> 23;
+    bits -= static_cast<std::uint32_t>(e) << 23;
+    float m;
+    std::memcpy(&m, &bits, sizeof(m));
+
+    // log2(m) = 2/ln(2) * atanh(s) with |s| < 0.172
+    float s = (m - 1.0f) / (m + 1.0f);
+    float s2 = s * s;
+    float p = 0.41219858f;
+    p = p * s2 + 0.57707802f;
+    p = p * s2 + 0.96179669f;
+    p = p * s2 + 2.88539008f;
+    return static_cast<float>(e) + s * p;
+}
+
+inline float fastLog10(float x)
+{
+    return fastLog2(x) * 0.30102999566f;
+}
+
 template <typename T> static Eigen::Matrix<T, 3, 1>
 ellipsoidTangent(const Eigen::Matrix<T, 3, 1>& recipSemiAxes,
                  const Eigen::Matrix<T, 3, 1>& w,
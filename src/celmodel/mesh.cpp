@@ -15,12 +15,14 @@
 #include <tuple>
 #include <utility>
 #include <celutil/logger.h>
+#include <celutil/memoryreport.h>
 
 #ifdef HAVE_MESHOPTIMIZER
 #include <meshoptimizer.h>
 #endif
 
 #include "mesh.h"
+#include "meshquantize.h"
 
 using celestia::util::GetLogger;
 
@@ -165,6 +167,9 @@ Mesh::clone() const
     std::transform(groups.cbegin(), groups.cend(), std::back_inserter(newMesh.groups),
                    [](const PrimitiveGroup& group) { return group.clone(); });
     newMesh.name = name;
+    newMesh.trackIndex = trackIndex;
+    newMesh.positionOffset = positionOffset;
+    newMesh.positionScale = positionScale;
     return newMesh;
 }
 
@@ -388,15 +393,8 @@ Mesh::pick(const Eigen::Vector3d& rayOrigin, const Eigen::Vector3d& rayDirection
 
     // Pick will automatically fail without vertex positions--no reasonable
     // mesh should lack these.
-    if (vertexDesc.getAttribute(VertexAttributeSemantic::Position).semantic != VertexAttributeSemantic::Position ||
-        vertexDesc.getAttribute(VertexAttributeSemantic::Position).format != VertexAttributeFormat::Float3)
-    {
+    if (!hasPositions())
         return false;
-    }
-
-    unsigned int stride = vertexDesc.strideBytes / sizeof(VWord);
-    unsigned int posOffset = vertexDesc.getAttribute(VertexAttributeSemantic::Position).offsetWords;
-    const VWord* vdata = vertices.data();
 
     // Iterate over all primitive groups in the mesh
     for (const auto& group : groups)
@@ -412,23 +410,37 @@ Mesh::pick(const Eigen::Vector3d& rayOrigin, const Eigen::Vector3d& rayDirection
             (nIndices >= 3) &&
             !(primType == PrimitiveGroupType::TriList && nIndices % 3 != 0))
         {
-            unsigned int primitiveIndex = 0;
-            Index32 index = 0;
-            Index32 i0 = group.indices[0];
-            Index32 i1 = group.indices[1];
-            Index32 i2 = group.indices[2];
-
             // Iterate over the triangles in the primitive group
-            do
+            unsigned int nTriangles = group.getPrimitiveCount();
+            for (unsigned int primitiveIndex = 0; primitiveIndex < nTriangles; primitiveIndex++)
             {
+                Index32 i0;
+                Index32 i1;
+                Index32 i2;
+                if (primType == PrimitiveGroupType::TriList)
+                {
+                    i0 = group.indices[primitiveIndex * 3 + 0];
+                    i1 = group.indices[primitiveIndex * 3 + 1];
+                    i2 = group.indices[primitiveIndex * 3 + 2];
+                }
+                else if (primType == PrimitiveGroupType::TriStrip)
+                {
+                    // TODO: alternate orientation of triangles in a strip
+                    i0 = group.indices[primitiveIndex + 0];
+                    i1 = group.indices[primitiveIndex + 1];
+                    i2 = group.indices[primitiveIndex + 2];
+                }
+                else // primType == TriFan
+                {
+                    i0 = group.indices[0];
+                    i1 = group.indices[primitiveIndex + 1];
+                    i2 = group.indices[primitiveIndex + 2];
+                }
+
                 // Get the triangle vertices v0, v1, and v2
-                float fv[3];
-                std::memcpy(fv, vdata + i0 * stride + posOffset, sizeof(float) * 3);
-                Eigen::Vector3d v0 = Eigen::Map<Eigen::Vector3f>(fv).cast<double>();
-                std::memcpy(fv, vdata + i1 * stride + posOffset, sizeof(float) * 3);
-                Eigen::Vector3d v1 = Eigen::Map<Eigen::Vector3f>(fv).cast<double>();
-                std::memcpy(fv, vdata + i2 * stride + posOffset, sizeof(float) * 3);
-                Eigen::Vector3d v2 = Eigen::Map<Eigen::Vector3f>(fv).cast<double>();
+                Eigen::Vector3d v0 = getVertexPosition(i0).cast<double>();
+                Eigen::Vector3d v1 = getVertexPosition(i1).cast<double>();
+                Eigen::Vector3d v2 = getVertexPosition(i2).cast<double>();
 
                 // Compute the edge vectors e0 and e1, and the normal n
                 Eigen::Vector3d e0 = v1 - v0;
@@ -473,43 +485,7 @@ Mesh::pick(const Eigen::Vector3d& rayOrigin, const Eigen::Vector3d& rayDirection
                         }
                     }
                 }
-
-                // Get the indices for the next triangle
-                if (primType == PrimitiveGroupType::TriList)
-                {
-                    index += 3;
-                    if (index < nIndices)
-                    {
-                        i0 = group.indices[index + 0];
-                        i1 = group.indices[index + 1];
-                        i2 = group.indices[index + 2];
-                    }
-                }
-                else if (primType == PrimitiveGroupType::TriStrip)
-                {
-                    index += 1;
-                    if (index < nIndices)
-                    {
-                        i0 = i1;
-                        i1 = i2;
-                        i2 = group.indices[index];
-                        // TODO: alternate orientation of triangles in a strip
-                    }
-                }
-                else // primType == TriFan
-                {
-                    index += 1;
-                    if (index < nIndices)
-                    {
-                        index += 1;
-                        i1 = i2;
-                        i2 = group.indices[index];
-                    }
-                }
-
-                primitiveIndex++;
-
-            } while (index < nIndices);
+            }
         }
     }
 
@@ -537,26 +513,20 @@ Mesh::getBoundingBox() const
     Eigen::AlignedBox<float, 3> bbox;
 
     // Return an empty box if there's no position info
-    if (vertexDesc.getAttribute(VertexAttributeSemantic::Position).format != VertexAttributeFormat::Float3)
+    if (!hasPositions())
         return bbox;
 
-    const VWord* vdata = vertices.data() + vertexDesc.getAttribute(VertexAttributeSemantic::Position).offsetWords;
-
     unsigned int stride = vertexDesc.strideBytes / sizeof(VWord);
     if (vertexDesc.getAttribute(VertexAttributeSemantic::PointSize).format == VertexAttributeFormat::Float1)
     {
         // Handle bounding box calculation for point sprites. Unlike other
         // primitives, point sprite vertices have a non-zero size.
-        int pointSizeOffset = (int) vertexDesc.getAttribute(VertexAttributeSemantic::PointSize).offsetWords -
-            (int) vertexDesc.getAttribute(VertexAttributeSemantic::Position).offsetWords;
-
+        const VWord* vdata = vertices.data() + vertexDesc.getAttribute(VertexAttributeSemantic::PointSize).offsetWords;
         for (unsigned int i = 0; i < nVertices; i++, vdata += stride)
         {
-            float fv[3];
-            std::memcpy(fv, vdata, sizeof(float) * 3);
-            Eigen::Vector3f center = Eigen::Map<Eigen::Vector3f>(fv);
+            Eigen::Vector3f center = getVertexPosition(i);
             float pointSize;
-            std::memcpy(&pointSize, vdata + pointSizeOffset, sizeof(float));
+            std::memcpy(&pointSize, vdata, sizeof(float));
             Eigen::Vector3f offsetVec = Eigen::Vector3f::Constant(pointSize);
 
             Eigen::AlignedBox<float, 3> pointbox(center - offsetVec, center + offsetVec);
@@ -565,12 +535,8 @@ Mesh::getBoundingBox() const
     }
     else
     {
-        for (unsigned int i = 0; i < nVertices; i++, vdata += stride)
-        {
-            float fv[3];
-            std::memcpy(fv, vdata, sizeof(float) * 3);
-            bbox.extend(Eigen::Map<Eigen::Vector3f>(fv));
-        }
+        for (unsigned int i = 0; i < nVertices; i++)
+            bbox.extend(getVertexPosition(i));
     }
 
     return bbox;
@@ -580,21 +546,31 @@ Mesh::getBoundingBox() const
 void
 Mesh::transform(const Eigen::Vector3f& translation, float scale)
 {
-    if (vertexDesc.getAttribute(VertexAttributeSemantic::Position).format != VertexAttributeFormat::Float3)
+    if (!hasPositions())
         return;
 
-    VWord* vdata = vertices.data() + vertexDesc.getAttribute(VertexAttributeSemantic::Position).offsetWords;
+    VWord* vdata;
     unsigned int i;
 
     unsigned int stride = vertexDesc.strideBytes / sizeof(VWord);
 
-    // Scale and translate the vertex positions
-    for (i = 0; i < nVertices; i++, vdata += stride)
+    if (hasQuantizedPositions())
+    {
+        // Only the mapping of quantized positions changes
+        positionOffset = (positionOffset + translation) * scale;
+        positionScale *= scale;
+    }
+    else
     {
-        float fv[3];
-        std::memcpy(fv, vdata, sizeof(float) * 3);
-        const Eigen::Vector3f tv = (Eigen::Map<Eigen::Vector3f>(fv) + translation) * scale;
-        std::memcpy(vdata, tv.data(), sizeof(float) * 3);
+        // Scale and translate the vertex positions
+        vdata = vertices.data() + vertexDesc.getAttribute(VertexAttributeSemantic::Position).offsetWords;
+        for (i = 0; i < nVertices; i++, vdata += stride)
+        {
+            float fv[3];
+            std::memcpy(fv, vdata, sizeof(float) * 3);
+            const Eigen::Vector3f tv = (Eigen::Map<Eigen::Vector3f>(fv) + translation) * scale;
+            std::memcpy(vdata, tv.data(), sizeof(float) * 3);
+        }
     }
 
     // Point sizes need to be scaled as well
@@ -612,6 +588,49 @@ Mesh::transform(const Eigen::Vector3f& translation, float scale)
 }
 
 
+bool
+Mesh::hasPositions() const
+{
+    const VertexAttribute& position = vertexDesc.getAttribute(VertexAttributeSemantic::Position);
+    return position.semantic == VertexAttributeSemantic::Position &&
+           (position.format == VertexAttributeFormat::Float3 ||
+            position.format == VertexAttributeFormat::Short4);
+}
+
+
+bool
+Mesh::hasQuantizedPositions() const
+{
+    const VertexAttribute& position = vertexDesc.getAttribute(VertexAttributeSemantic::Position);
+    return position.semantic == VertexAttributeSemantic::Position &&
+           position.format == VertexAttributeFormat::Short4;
+}
+
+
+Eigen::Vector3f
+Mesh::getVertexPosition(Index32 index) const
+{
+    const VertexAttribute& position = vertexDesc.getAttribute(VertexAttributeSemantic::Position);
+    const VWord* vdata = vertices.data() +
+                         static_cast<std::size_t>(index) * (vertexDesc.strideBytes / sizeof(VWord)) +
+                         position.offsetWords;
+    if (position.format == VertexAttributeFormat::Short4)
+        return positionOffset + DecodeVertexAttribute(vdata, position.format).head<3>() * positionScale;
+
+    Eigen::Vector3f v;
+    std::memcpy(v.data(), vdata, sizeof(float) * 3);
+    return v;
+}
+
+
+void
+Mesh::setPositionQuantization(const Eigen::Vector3f& offset, float scale)
+{
+    positionOffset = offset;
+    positionScale = scale;
+}
+
+
 unsigned int
 Mesh::getPrimitiveCount() const
 {
@@ -623,6 +642,19 @@ Mesh::getPrimitiveCount() const
     return count;
 }
 
+
+std::size_t
+Mesh::getMemoryUsage() const
+{
+    using celestia::util::vectorMemory;
+
+    std::size_t size = sizeof(Mesh) + vectorMemory(vertices) + vectorMemory(groups);
+    for (const auto& group : groups)
+        size += vectorMemory(group.indices);
+
+    return size;
+}
+
 void
 Mesh::merge(const Mesh &other)
 {
@@ -651,8 +683,11 @@ Mesh::canMerge(const Mesh &other, const std::vector<Material> &materials) const
     if (tg.prim != PrimitiveGroupType::TriList)
         return false;
 
-    if (std::tie(tg.materialIndex, tg.prim, vertexDesc.strideBytes) !=
-        std::tie(og.materialIndex, og.prim, other.vertexDesc.strideBytes))
+    if (std::tie(tg.materialIndex, tg.prim, vertexDesc.strideBytes, trackIndex) !=
+        std::tie(og.materialIndex, og.prim, other.vertexDesc.strideBytes, other.trackIndex))
+        return false;
+
+    if (positionOffset != other.positionOffset || positionScale != other.positionScale)
         return false;
 
     if (!isOpaqueMaterial(materials[tg.materialIndex]) || !isOpaqueMaterial(materials[og.materialIndex]))
@@ -53,7 +53,15 @@ enum class VertexAttributeFormat : std::int16_t
     Float3    = 2,
     Float4    = 3,
     UByte4    = 4,
-    FormatMax = 5,
+    // Four signed 16-bit integers mapped to [-1, 1]. Positions are scaled
+    // and offset by the mesh, and have w = 1.
+    Short4    = 5,
+    // Two 16-bit floating point numbers
+    Half2     = 6,
+    // A unit vector as two signed 16-bit integers mapped to [-1, 1], the
+    // point of its octahedral projection unfolded onto a square
+    Octahedral = 7,
+    FormatMax = 8,
     InvalidFormat = -1,
 };
 
@@ -96,8 +104,11 @@ struct VertexAttribute
         {
         case VertexAttributeFormat::Float1:
         case VertexAttributeFormat::UByte4:
+        case VertexAttributeFormat::Half2:
+        case VertexAttributeFormat::Octahedral:
             return 1;
         case VertexAttributeFormat::Float2:
+        case VertexAttributeFormat::Short4:
             return 2;
         case VertexAttributeFormat::Float3:
             return 3;
@@ -221,18 +232,39 @@ class Mesh
     const std::string& getName() const;
     void setName(std::string&&);
 
+    /*! Index of the model's transform track animating the mesh, or ~0u
+     *  if the mesh is static.
+     */
+    unsigned int getTrackIndex() const { return trackIndex; }
+    void setTrackIndex(unsigned int index) { trackIndex = index; }
+
     bool pick(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, PickResult* result) const;
     bool pick(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, double& distance) const;
 
     Eigen::AlignedBox<float, 3> getBoundingBox() const;
     void transform(const Eigen::Vector3f& translation, float scale);
 
+    /*! True if the vertices have Float3 or Short4 positions */
+    bool hasPositions() const;
+    /*! Position of a vertex in model coordinates */
+    Eigen::Vector3f getVertexPosition(Index32 index) const;
+
+    /*! Short4 positions are mapped from [-1, 1] to model coordinates by
+     *  a uniform scale and an offset.
+     */
+    const Eigen::Vector3f& getPositionOffset() const { return positionOffset; }
+    float getPositionScale() const { return positionScale; }
+    void setPositionQuantization(const Eigen::Vector3f& offset, float scale);
+    bool hasQuantizedPositions() const;
+
     const VWord* getVertexData() const { return vertices.data(); }
     unsigned int getVertexCount() const { return nVertices; }
     unsigned int getVertexStrideWords() const { return vertexDesc.strideBytes / sizeof(cmod::VWord); }
     unsigned int getPrimitiveCount() const;
 
     unsigned int getIndexCount() const { return nTotalIndices; }
+    // Bytes taken by the vertices and indices
+    std::size_t getMemoryUsage() const;
 
     void merge(const Mesh&);
     bool canMerge(const Mesh&, const std::vector<Material> &materials) const;
@@ -253,6 +285,10 @@ class Mesh
     std::vector<PrimitiveGroup> groups;
 
     std::string name;
+    unsigned int trackIndex{ ~0u };
+
+    Eigen::Vector3f positionOffset{ Eigen::Vector3f::Zero() };
+    float positionScale{ 1.0f };
 };
 
 } // namespace cmod
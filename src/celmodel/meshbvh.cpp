@@ -0,0 +1,355 @@
+// meshbvh.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "meshbvh.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+
+#include "model.h"
+
+
+namespace cmod
+{
+namespace
+{
+
+constexpr std::uint32_t MaxLeafTriangles = 4;
+
+// Deep enough for any tree built from 32-bit triangle counts
+constexpr std::size_t MaxStackDepth = 64;
+
+// Intersection of a ray with the box, between tNear and tFar. The slabs of
+// the three axes are tested together.
+bool
+intersectBox(const Eigen::AlignedBox<float, 3>& box,
+             const Eigen::Array3f& origin,
+             const Eigen::Array3f& invDirection,
+             float tFar,
+             float& tNear)
+{
+    Eigen::Array3f t0 = (box.min().array() - origin) * invDirection;
+    Eigen::Array3f t1 = (box.max().array() - origin) * invDirection;
+    float tEnter = t0.min(t1).maxCoeff();
+    float tExit = t0.max(t1).minCoeff();
+    tNear = std::max(tEnter, 0.0f);
+    return tNear <= tExit && tNear <= tFar;
+}
+
+// The same test as in Mesh::pick
+bool
+intersectTriangle(const Eigen::Vector3d& v0,
+                  const Eigen::Vector3d& v1,
+                  const Eigen::Vector3d& v2,
+                  const Eigen::Vector3d& rayOrigin,
+                  const Eigen::Vector3d& rayDirection,
+                  double closest,
+                  double& distance)
+{
+    Eigen::Vector3d e0 = v1 - v0;
+    Eigen::Vector3d e1 = v2 - v0;
+    Eigen::Vector3d n = e0.cross(e1);
+
+    double c = n.dot(rayDirection);
+    if (c == 0.0)
+        return false;
+
+    double t = (n.dot(v0 - rayOrigin)) / c;
+    if (t >= closest || t <= 0.0)
+        return false;
+
+    double m00 = e0.dot(e0);
+    double m01 = e0.dot(e1);
+    double m10 = e1.dot(e0);
+    double m11 = e1.dot(e1);
+    double det = m00 * m11 - m01 * m10;
+    if (det == 0.0)
+        return false;
+
+    Eigen::Vector3d q = rayOrigin + rayDirection * t - v0;
+    double q0 = e0.dot(q);
+    double q1 = e1.dot(q);
+    double d = 1.0 / det;
+    double s0 = (m11 * q0 - m01 * q1) * d;
+    double s1 = (m00 * q1 - m10 * q0) * d;
+    if (s0 < 0.0 || s1 < 0.0 || s0 + s1 > 1.0)
+        return false;
+
+    distance = t;
+    return true;
+}
+
+} // end unnamed namespace
+
+
+MeshBVH::MeshBVH(const Mesh& mesh)
+{
+    if (!mesh.hasPositions())
+        return;
+
+    for (unsigned int i = 0; i < mesh.getGroupCount(); i++)
+        addTriangles(mesh, *mesh.getGroup(i));
+
+    if (triangles.empty())
+        return;
+
+    std::vector<Eigen::Vector3f> centroids;
+    centroids.reserve(triangles.size());
+    for (const Triangle& tri : triangles)
+        centroids.push_back((tri.v0 + tri.v1 + tri.v2) / 3.0f);
+
+    nodes.reserve(2 * triangles.size() / MaxLeafTriangles + 1);
+    build(0, static_cast<std::uint32_t>(triangles.size()), centroids);
+}
+
+
+void
+MeshBVH::addTriangles(const Mesh& mesh, const PrimitiveGroup& group)
+{
+    auto nIndices = static_cast<Index32>(group.indices.size());
+    if (nIndices < 3)
+        return;
+
+    auto vertex = [&mesh](Index32 index) { return mesh.getVertexPosition(index); };
+
+    auto add = [&](Index32 i0, Index32 i1, Index32 i2, unsigned int primitiveIndex)
+    {
+        triangles.push_back(Triangle{ vertex(i0), vertex(i1), vertex(i2), &group, primitiveIndex });
+    };
+
+    switch (group.prim)
+    {
+    case PrimitiveGroupType::TriList:
+        if (nIndices % 3 != 0)
+            return;
+        for (Index32 i = 0; i < nIndices; i += 3)
+            add(group.indices[i], group.indices[i + 1], group.indices[i + 2], i / 3);
+        break;
+    case PrimitiveGroupType::TriStrip:
+        for (Index32 i = 2; i < nIndices; i++)
+            add(group.indices[i - 2], group.indices[i - 1], group.indices[i], i - 2);
+        break;
+    case PrimitiveGroupType::TriFan:
+        for (Index32 i = 2; i < nIndices; i++)
+            add(group.indices[0], group.indices[i - 1], group.indices[i], i - 2);
+        break;
+    default:
+        break;
+    }
+}
+
+
+// Split the triangles at the median of their centroids along the longest
+// axis of the centroid bounds.
+std::uint32_t
+MeshBVH::build(std::uint32_t first, std::uint32_t count,
+               std::vector<Eigen::Vector3f>& centroids)
+{
+    auto nodeIndex = static_cast<std::uint32_t>(nodes.size());
+    nodes.push_back(Node{ Eigen::AlignedBox<float, 3>(), first, count });
+
+    Eigen::AlignedBox<float, 3> bounds;
+    Eigen::AlignedBox<float, 3> centroidBounds;
+    for (std::uint32_t i = first; i < first + count; i++)
+    {
+        bounds.extend(triangles[i].v0).extend(triangles[i].v1).extend(triangles[i].v2);
+        centroidBounds.extend(centroids[i]);
+    }
+    nodes[nodeIndex].bounds = bounds;
+
+    if (count <= MaxLeafTriangles)
+        return nodeIndex;
+
+    int axis;
+    centroidBounds.sizes().maxCoeff(&axis);
+
+    // Sort the triangles together with their centroids
+    std::vector<std::uint32_t> order(count);
+    for (std::uint32_t i = 0; i < count; i++)
+        order[i] = first + i;
+
+    std::uint32_t half = count / 2;
+    std::nth_element(order.begin(), order.begin() + half, order.end(),
+                     [&](std::uint32_t a, std::uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+
+    std::vector<Triangle> sortedTriangles;
+    std::vector<Eigen::Vector3f> sortedCentroids;
+    sortedTriangles.reserve(count);
+    sortedCentroids.reserve(count);
+    for (std::uint32_t i : order)
+    {
+        sortedTriangles.push_back(triangles[i]);
+        sortedCentroids.push_back(centroids[i]);
+    }
+    std::copy(sortedTriangles.begin(), sortedTriangles.end(), triangles.begin() + first);
+    std::copy(sortedCentroids.begin(), sortedCentroids.end(), centroids.begin() + first);
+
+    build(first, half, centroids);
+    std::uint32_t right = build(first + half, count - half, centroids);
+    nodes[nodeIndex].first = right;
+    nodes[nodeIndex].count = 0;
+
+    return nodeIndex;
+}
+
+
+const Eigen::AlignedBox<float, 3>&
+MeshBVH::getBoundingBox() const
+{
+    static const Eigen::AlignedBox<float, 3> empty;
+    return nodes.empty() ? empty : nodes.front().bounds;
+}
+
+
+bool
+MeshBVH::pick(const Eigen::Vector3d& rayOrigin,
+              const Eigen::Vector3d& rayDirection,
+              Mesh::PickResult* result,
+              double maxDistance) const
+{
+    if (nodes.empty())
+        return false;
+
+    Eigen::Array3f origin = rayOrigin.cast<float>().array();
+    // A huge but finite inverse for zero components, as an infinite one
+    // would give NaN for rays in the plane of a box side.
+    Eigen::Array3f direction = rayDirection.cast<float>().array();
+    Eigen::Array3f invDirection = (direction.abs() < 1.0e-30f).select(Eigen::Array3f::Constant(1.0e30f),
+                                                                      direction.inverse());
+
+    double closest = maxDistance;
+    const Triangle* closestTriangle = nullptr;
+
+    // The boxes are tested in single precision, so allow for some rounding
+    // when comparing their distance with the closest hit.
+    auto farLimit = [&closest]
+    {
+        return closest >= 1.0e30 ? std::numeric_limits<float>::max()
+                                 : static_cast<float>(closest) * 1.0001f + 1.0e-6f;
+    };
+
+    std::array<std::uint32_t, MaxStackDepth> stack;
+    std::size_t stackSize = 0;
+    float tNear;
+    if (intersectBox(nodes[0].bounds, origin, invDirection, farLimit(), tNear))
+        stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const Node& node = nodes[stack[--stackSize]];
+        if (node.count > 0)
+        {
+            for (std::uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                const Triangle& tri = triangles[i];
+                double t;
+                if (intersectTriangle(tri.v0.cast<double>(), tri.v1.cast<double>(), tri.v2.cast<double>(),
+                                      rayOrigin, rayDirection, closest, t))
+                {
+                    closest = t;
+                    closestTriangle = &tri;
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first, so that the farther one is more
+        // likely to be culled by the closest hit.
+        auto left = static_cast<std::uint32_t>(&node - nodes.data()) + 1;
+        std::uint32_t right = node.first;
+        float tLeft;
+        float tRight;
+        float tFar = farLimit();
+        bool hitLeft = intersectBox(nodes[left].bounds, origin, invDirection, tFar, tLeft);
+        bool hitRight = intersectBox(nodes[right].bounds, origin, invDirection, tFar, tRight);
+        if (hitLeft && hitRight)
+        {
+            if (tLeft > tRight)
+                std::swap(left, right);
+            stack[stackSize++] = right;
+            stack[stackSize++] = left;
+        }
+        else if (hitLeft)
+        {
+            stack[stackSize++] = left;
+        }
+        else if (hitRight)
+        {
+            stack[stackSize++] = right;
+        }
+    }
+
+    if (closestTriangle == nullptr)
+        return false;
+
+    if (result != nullptr)
+    {
+        result->group = closestTriangle->group;
+        result->primitiveIndex = closestTriangle->primitiveIndex;
+        result->distance = closest;
+    }
+
+    return true;
+}
+
+
+ModelBVH::ModelBVH(const Model& model)
+{
+    meshes.reserve(model.getMeshCount());
+    meshBVHs.reserve(model.getMeshCount());
+    for (unsigned int i = 0; i < model.getMeshCount(); i++)
+    {
+        meshes.push_back(model.getMesh(i));
+        meshBVHs.emplace_back(*model.getMesh(i));
+    }
+}
+
+
+bool
+ModelBVH::pick(const Eigen::Vector3d& rayOrigin,
+               const Eigen::Vector3d& rayDirection,
+               Mesh::PickResult* result) const
+{
+    double maxDistance = 1.0e30;
+    Mesh::PickResult closestResult;
+    closestResult.distance = maxDistance;
+
+    for (std::size_t i = 0; i < meshBVHs.size(); i++)
+    {
+        Mesh::PickResult meshResult;
+        if (meshBVHs[i].pick(rayOrigin, rayDirection, &meshResult, closestResult.distance))
+        {
+            closestResult = meshResult;
+            closestResult.mesh = meshes[i];
+        }
+    }
+
+    if (closestResult.distance == maxDistance)
+        return false;
+
+    if (result != nullptr)
+        *result = closestResult;
+    return true;
+}
+
+
+bool
+ModelBVH::pick(const Eigen::Vector3d& rayOrigin, const Eigen::Vector3d& rayDirection, double& distance) const
+{
+    Mesh::PickResult result;
+    bool hit = pick(rayOrigin, rayDirection, &result);
+    if (hit)
+        distance = result.distance;
+
+    return hit;
+}
+
+} // namespace cmod
@@ -0,0 +1,91 @@
+// meshbvh.h
+//
+// Copyright (C) 2023-present, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "mesh.h"
+
+
+namespace cmod
+{
+class Model;
+
+/*! Bounding volume hierarchy of the triangles of a mesh, for ray queries
+ *  which would otherwise test every triangle. The triangles are copied,
+ *  so the BVH has to be rebuilt when the mesh is changed.
+ */
+class MeshBVH
+{
+ public:
+    explicit MeshBVH(const Mesh& mesh);
+
+    /*! Find the closest intersection between the ray and the mesh which
+     *  is nearer than maxDistance, with the same results as Mesh::pick.
+     */
+    bool pick(const Eigen::Vector3d& origin,
+              const Eigen::Vector3d& direction,
+              Mesh::PickResult* result,
+              double maxDistance = 1.0e30) const;
+
+    const Eigen::AlignedBox<float, 3>& getBoundingBox() const;
+    std::size_t getTriangleCount() const { return triangles.size(); }
+
+ private:
+    struct Triangle
+    {
+        Eigen::Vector3f v0;
+        Eigen::Vector3f v1;
+        Eigen::Vector3f v2;
+        const PrimitiveGroup* group;
+        unsigned int primitiveIndex;
+    };
+
+    // Leaves hold count triangles from first; the children of the other
+    // nodes are the next node and the node at first.
+    struct Node
+    {
+        Eigen::AlignedBox<float, 3> bounds;
+        std::uint32_t first;
+        std::uint32_t count;
+    };
+
+    void addTriangles(const Mesh& mesh, const PrimitiveGroup& group);
+    std::uint32_t build(std::uint32_t first, std::uint32_t count,
+                        std::vector<Eigen::Vector3f>& centroids);
+
+    std::vector<Triangle> triangles;
+    std::vector<Node> nodes;
+};
+
+
+/*! The BVHs of all meshes of a model */
+class ModelBVH
+{
+ public:
+    explicit ModelBVH(const Model& model);
+
+    bool pick(const Eigen::Vector3d& origin,
+              const Eigen::Vector3d& direction,
+              Mesh::PickResult* result) const;
+    bool pick(const Eigen::Vector3d& origin,
+              const Eigen::Vector3d& direction,
+              double& distance) const;
+
+ private:
+    std::vector<const Mesh*> meshes;
+    std::vector<MeshBVH> meshBVHs;
+};
+
+} // namespace cmod
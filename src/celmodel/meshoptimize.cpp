@@ -0,0 +1,474 @@
+// meshoptimize.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// The vertex cache ordering is Tipsify from Sander, Nehab and Barczak,
+// "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw",
+// SIGGRAPH 2007, and the overdraw ordering the simplified version of the
+// cluster sort from the same paper which meshoptimizer uses.
+
+#include "meshoptimize.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "model.h"
+
+
+namespace cmod
+{
+namespace
+{
+
+constexpr Index32 NoVertex = std::numeric_limits<Index32>::max();
+
+// Clusters are split again where the running miss ratio drops this close
+// to the ratio of the whole cluster.
+constexpr float ClusterThreshold = 1.05f;
+
+// The triangles using each vertex
+struct TriangleAdjacency
+{
+    TriangleAdjacency(const std::vector<Index32>& indices, unsigned int nVertices);
+
+    std::vector<Index32> counts;
+    std::vector<Index32> offsets;
+    std::vector<Index32> triangles;
+};
+
+
+TriangleAdjacency::TriangleAdjacency(const std::vector<Index32>& indices, unsigned int nVertices) :
+    counts(nVertices, 0),
+    offsets(nVertices, 0),
+    triangles(indices.size())
+{
+    for (Index32 index : indices)
+        counts[index]++;
+
+    Index32 offset = 0;
+    for (unsigned int i = 0; i < nVertices; i++)
+    {
+        offsets[i] = offset;
+        offset += counts[i];
+    }
+
+    std::vector<Index32> fill = offsets;
+    for (std::size_t i = 0; i < indices.size(); i++)
+        triangles[fill[indices[i]]++] = static_cast<Index32>(i / 3);
+}
+
+
+// FIFO model of the post-transform cache: a vertex is still cached if fewer
+// than cacheSize vertices were transformed after it.
+class VertexCache
+{
+ public:
+    VertexCache(unsigned int nVertices, unsigned int _cacheSize) :
+        cacheTime(nVertices, 0),
+        cacheSize(_cacheSize),
+        timestamp(_cacheSize + 1)
+    {}
+
+    bool contains(Index32 vertex) const { return timestamp - cacheTime[vertex] <= cacheSize; }
+    unsigned int age(Index32 vertex) const { return timestamp - cacheTime[vertex]; }
+
+    // Return true on a cache miss
+    bool use(Index32 vertex)
+    {
+        if (contains(vertex))
+            return false;
+        cacheTime[vertex] = timestamp++;
+        return true;
+    }
+
+    void flush() { timestamp += cacheSize + 1; }
+
+ private:
+    std::vector<unsigned int> cacheTime;
+    unsigned int cacheSize;
+    unsigned int timestamp;
+};
+
+
+// Reorder the triangles of a triangle list for the vertex cache. The
+// result starts a new cluster at each triangle in clusters, where the
+// order had to jump to a vertex which is no longer cached.
+std::vector<Index32>
+tipsify(const std::vector<Index32>& indices,
+        unsigned int nVertices,
+        unsigned int cacheSize,
+        std::vector<std::size_t>& clusters)
+{
+    TriangleAdjacency adjacency(indices, nVertices);
+    std::vector<Index32> live = adjacency.counts;
+    std::vector<bool> emitted(indices.size() / 3, false);
+    VertexCache cache(nVertices, cacheSize);
+
+    std::vector<Index32> deadEnd;
+    std::vector<Index32> candidates;
+    std::vector<Index32> result;
+    result.reserve(indices.size());
+
+    Index32 cursor = 0;
+    auto nextUnused = [&]
+    {
+        for (; cursor < nVertices; cursor++)
+        {
+            if (live[cursor] > 0)
+                return cursor;
+        }
+        return NoVertex;
+    };
+
+    Index32 fanning = nextUnused();
+    clusters.assign(1, 0);
+    while (fanning != NoVertex)
+    {
+        candidates.clear();
+        const Index32* first = adjacency.triangles.data() + adjacency.offsets[fanning];
+        for (const Index32* t = first; t != first + adjacency.counts[fanning]; t++)
+        {
+            if (emitted[*t])
+                continue;
+            emitted[*t] = true;
+
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                Index32 v = indices[*t * 3 + k];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                cache.use(v);
+            }
+        }
+
+        // Prefer the cached vertex which entered the cache earliest, as long
+        // as all its remaining triangles fit in the cache
+        Index32 next = NoVertex;
+        int bestPriority = -1;
+        for (Index32 v : candidates)
+        {
+            if (live[v] == 0)
+                continue;
+
+            int priority = 0;
+            if (cache.age(v) + 2 * live[v] <= cacheSize)
+                priority = static_cast<int>(cache.age(v));
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+
+        if (next == NoVertex)
+        {
+            while (!deadEnd.empty())
+            {
+                Index32 v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0)
+                {
+                    next = v;
+                    break;
+                }
+            }
+        }
+
+        if (next == NoVertex)
+        {
+            next = nextUnused();
+            if (next != NoVertex)
+                clusters.push_back(result.size() / 3);
+        }
+
+        fanning = next;
+    }
+
+    return result;
+}
+
+
+// Split the clusters further wherever the cache would have warmed up again
+std::vector<std::size_t>
+splitClusters(const std::vector<Index32>& indices,
+              unsigned int nVertices,
+              unsigned int cacheSize,
+              const std::vector<std::size_t>& clusters)
+{
+    std::size_t nTriangles = indices.size() / 3;
+    VertexCache cache(nVertices, cacheSize);
+    auto misses = [&](std::size_t triangle)
+    {
+        return static_cast<unsigned int>(cache.use(indices[triangle * 3])) +
+               static_cast<unsigned int>(cache.use(indices[triangle * 3 + 1])) +
+               static_cast<unsigned int>(cache.use(indices[triangle * 3 + 2]));
+    };
+
+    std::vector<std::size_t> result;
+    for (std::size_t c = 0; c < clusters.size(); c++)
+    {
+        std::size_t start = clusters[c];
+        std::size_t end = c + 1 < clusters.size() ? clusters[c + 1] : nTriangles;
+
+        cache.flush();
+        unsigned int clusterMisses = 0;
+        for (std::size_t i = start; i < end; i++)
+            clusterMisses += misses(i);
+        float threshold = ClusterThreshold * static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+        cache.flush();
+        result.push_back(start);
+        unsigned int runningMisses = 0;
+        unsigned int runningTriangles = 0;
+        for (std::size_t i = start; i < end; i++)
+        {
+            runningMisses += misses(i);
+            runningTriangles++;
+            if (static_cast<float>(runningMisses) <= threshold * static_cast<float>(runningTriangles) &&
+                i + 1 < end)
+            {
+                result.push_back(i + 1);
+                runningMisses = 0;
+                runningTriangles = 0;
+                cache.flush();
+            }
+        }
+    }
+
+    return result;
+}
+
+
+// Draw the clusters which face outwards first, as they are the most likely
+// to hide the others.
+void
+sortClusters(std::vector<Index32>& indices,
+             const std::vector<std::size_t>& clusters,
+             const Mesh& mesh)
+{
+    auto vertex = [&mesh](Index32 index) { return mesh.getVertexPosition(index); };
+
+    std::size_t nTriangles = indices.size() / 3;
+    std::vector<Eigen::Vector3f> centroids(clusters.size(), Eigen::Vector3f::Zero());
+    std::vector<Eigen::Vector3f> normals(clusters.size(), Eigen::Vector3f::Zero());
+    Eigen::Vector3f meshCentroid = Eigen::Vector3f::Zero();
+    float meshArea = 0.0f;
+    for (std::size_t c = 0; c < clusters.size(); c++)
+    {
+        std::size_t end = c + 1 < clusters.size() ? clusters[c + 1] : nTriangles;
+        float clusterArea = 0.0f;
+        for (std::size_t i = clusters[c]; i < end; i++)
+        {
+            Eigen::Vector3f v0 = vertex(indices[i * 3]);
+            Eigen::Vector3f v1 = vertex(indices[i * 3 + 1]);
+            Eigen::Vector3f v2 = vertex(indices[i * 3 + 2]);
+            Eigen::Vector3f n = (v1 - v0).cross(v2 - v0);
+            float area = n.norm();
+            centroids[c] += (v0 + v1 + v2) * (area / 3.0f);
+            normals[c] += n;
+            clusterArea += area;
+        }
+        meshCentroid += centroids[c];
+        meshArea += clusterArea;
+        if (clusterArea > 0.0f)
+            centroids[c] /= clusterArea;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    std::vector<float> keys(clusters.size());
+    for (std::size_t c = 0; c < clusters.size(); c++)
+        keys[c] = (centroids[c] - meshCentroid).dot(normals[c].normalized());
+
+    std::vector<std::size_t> order(clusters.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&keys](std::size_t a, std::size_t b) { return keys[a] > keys[b]; });
+
+    std::vector<Index32> sorted;
+    sorted.reserve(indices.size());
+    for (std::size_t c : order)
+    {
+        std::size_t end = c + 1 < clusters.size() ? clusters[c + 1] : nTriangles;
+        sorted.insert(sorted.end(), indices.begin() + clusters[c] * 3, indices.begin() + end * 3);
+    }
+    indices = std::move(sorted);
+}
+
+
+// Store the vertices in the order of their first use so that the vertex
+// fetches follow the index order. Unused vertices are moved to the end.
+void
+reorderVertices(Mesh& mesh)
+{
+    unsigned int nVertices = mesh.getVertexCount();
+    std::vector<Index32> vertexMap(nVertices, NoVertex);
+    Index32 nextVertex = 0;
+    for (unsigned int i = 0; i < mesh.getGroupCount(); i++)
+    {
+        for (Index32 index : mesh.getGroup(i)->indices)
+        {
+            if (vertexMap[index] == NoVertex)
+                vertexMap[index] = nextVertex++;
+        }
+    }
+
+    for (Index32& index : vertexMap)
+    {
+        if (index == NoVertex)
+            index = nextVertex++;
+    }
+
+    unsigned int stride = mesh.getVertexStrideWords();
+    const VWord* vdata = mesh.getVertexData();
+    std::vector<VWord> newVertices(static_cast<std::size_t>(nVertices) * stride);
+    for (unsigned int i = 0; i < nVertices; i++)
+    {
+        std::memcpy(newVertices.data() + static_cast<std::size_t>(vertexMap[i]) * stride,
+                    vdata + static_cast<std::size_t>(i) * stride,
+                    stride * sizeof(VWord));
+    }
+
+    mesh.setVertices(nVertices, std::move(newVertices));
+    mesh.remapIndices(vertexMap);
+}
+
+
+bool
+isTriangleList(const PrimitiveGroup& group)
+{
+    return group.prim == PrimitiveGroupType::TriList && !group.indices.empty() && group.indices.size() % 3 == 0;
+}
+
+} // end unnamed namespace
+
+
+unsigned int
+RemoveDuplicateVertices(Mesh& mesh)
+{
+    unsigned int nVertices = mesh.getVertexCount();
+    unsigned int stride = mesh.getVertexStrideWords();
+    const VWord* vdata = mesh.getVertexData();
+    if (nVertices == 0 || stride == 0)
+        return 0;
+
+    auto hash = [vdata, stride](Index32 index)
+    {
+        const VWord* v = vdata + static_cast<std::size_t>(index) * stride;
+        std::size_t h = 0;
+        for (unsigned int i = 0; i < stride; i++)
+            h = h * 31 + std::hash<VWord>()(v[i]);
+        return h;
+    };
+    auto equal = [vdata, stride](Index32 a, Index32 b)
+    {
+        return std::memcmp(vdata + static_cast<std::size_t>(a) * stride,
+                           vdata + static_cast<std::size_t>(b) * stride,
+                           stride * sizeof(VWord)) == 0;
+    };
+
+    std::unordered_map<Index32, Index32, decltype(hash), decltype(equal)> uniqueVertices(nVertices, hash, equal);
+    std::vector<Index32> vertexMap(nVertices);
+    std::vector<VWord> newVertices;
+    newVertices.reserve(static_cast<std::size_t>(nVertices) * stride);
+    for (Index32 i = 0; i < nVertices; i++)
+    {
+        auto newIndex = static_cast<Index32>(uniqueVertices.size());
+        if (auto [iter, inserted] = uniqueVertices.try_emplace(i, newIndex); inserted)
+        {
+            const VWord* v = vdata + static_cast<std::size_t>(i) * stride;
+            newVertices.insert(newVertices.end(), v, v + stride);
+            vertexMap[i] = newIndex;
+        }
+        else
+        {
+            vertexMap[i] = iter->second;
+        }
+    }
+
+    auto nUnique = static_cast<unsigned int>(uniqueVertices.size());
+    if (nUnique == nVertices)
+        return 0;
+
+    // The map refers to the old vertex data, so it has to go first
+    uniqueVertices.clear();
+    mesh.setVertices(nUnique, std::move(newVertices));
+    mesh.remapIndices(vertexMap);
+    return nVertices - nUnique;
+}
+
+
+void
+OptimizeMesh(Mesh& mesh, unsigned int cacheSize)
+{
+    if (mesh.getVertexCount() == 0)
+        return;
+
+    mesh.aggregateByMaterial();
+    RemoveDuplicateVertices(mesh);
+
+    bool hasPositions = mesh.hasPositions();
+
+    for (unsigned int i = 0; i < mesh.getGroupCount(); i++)
+    {
+        PrimitiveGroup* group = mesh.getGroup(i);
+        if (!isTriangleList(*group))
+            continue;
+
+        std::vector<std::size_t> clusters;
+        group->indices = tipsify(group->indices, mesh.getVertexCount(), cacheSize, clusters);
+        if (hasPositions)
+        {
+            clusters = splitClusters(group->indices, mesh.getVertexCount(), cacheSize, clusters);
+            sortClusters(group->indices, clusters, mesh);
+        }
+    }
+
+    reorderVertices(mesh);
+    mesh.rebuildIndexMetadata();
+}
+
+
+void
+OptimizeModel(Model& model, unsigned int cacheSize)
+{
+    for (unsigned int i = 0; i < model.getMeshCount(); i++)
+        OptimizeMesh(*model.getMesh(i), cacheSize);
+}
+
+
+float
+ComputeACMR(const Mesh& mesh, unsigned int cacheSize)
+{
+    VertexCache cache(mesh.getVertexCount(), cacheSize);
+    std::size_t nTriangles = 0;
+    std::size_t nMisses = 0;
+    for (unsigned int i = 0; i < mesh.getGroupCount(); i++)
+    {
+        const PrimitiveGroup* group = mesh.getGroup(i);
+        if (!isTriangleList(*group))
+            continue;
+
+        for (Index32 index : group->indices)
+            nMisses += cache.use(index) ? 1 : 0;
+        nTriangles += group->indices.size() / 3;
+    }
+
+    return nTriangles == 0 ? 0.0f : static_cast<float>(nMisses) / static_cast<float>(nTriangles);
+}
+
+} // namespace cmod
@@ -0,0 +1,44 @@
+// meshoptimize.h
+//
+// Copyright (C) 2023-present, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include "mesh.h"
+
+
+namespace cmod
+{
+class Model;
+
+// Size of the post-transform vertex cache the triangle order is tuned for
+constexpr unsigned int DefaultVertexCacheSize = 16;
+
+/*! Remove vertices which are bitwise identical to an earlier one. Return
+ *  the number of vertices removed.
+ */
+unsigned int RemoveDuplicateVertices(Mesh& mesh);
+
+/*! Prepare a mesh for rendering: merge the primitive groups by material,
+ *  remove duplicate vertices, reorder the triangles of triangle lists for
+ *  the vertex cache (Tipsify) and then, cluster by cluster, from the
+ *  outside in to reduce overdraw, and finally store the vertices in the
+ *  order of their first use. Other primitive types are left in order.
+ */
+void OptimizeMesh(Mesh& mesh, unsigned int cacheSize = DefaultVertexCacheSize);
+
+/*! Optimize all meshes of a model with OptimizeMesh */
+void OptimizeModel(Model& model, unsigned int cacheSize = DefaultVertexCacheSize);
+
+/*! Average number of vertices transformed per triangle list triangle
+ *  with a FIFO vertex cache, between 0.5 for an ideal order of a large
+ *  grid and 3.
+ */
+float ComputeACMR(const Mesh& mesh, unsigned int cacheSize = DefaultVertexCacheSize);
+
+} // namespace cmod
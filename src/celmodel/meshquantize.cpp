@@ -0,0 +1,385 @@
+// meshquantize.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// The octahedral normal encoding is from Cigolle et al., "A Survey of
+// Efficient Representations for Independent Unit Vectors", JCGT 2014.
+
+#include "meshquantize.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+
+namespace cmod
+{
+namespace
+{
+
+constexpr float SNorm16Max = 32767.0f;
+
+std::int16_t
+toSNorm16(float f)
+{
+    return static_cast<std::int16_t>(std::lround(std::clamp(f, -1.0f, 1.0f) * SNorm16Max));
+}
+
+float
+fromSNorm16(std::int16_t i)
+{
+    return std::max(static_cast<float>(i) / SNorm16Max, -1.0f);
+}
+
+std::array<float, 2>
+encodeOctahedral(Eigen::Vector3f v)
+{
+    float l1 = v.cwiseAbs().sum();
+    if (l1 == 0.0f)
+        return { 0.0f, 0.0f };
+
+    v /= l1;
+    if (v.z() < 0.0f)
+    {
+        // Fold the lower hemisphere over the diagonals
+        float x = (1.0f - std::abs(v.y())) * (v.x() >= 0.0f ? 1.0f : -1.0f);
+        float y = (1.0f - std::abs(v.x())) * (v.y() >= 0.0f ? 1.0f : -1.0f);
+        return { x, y };
+    }
+    return { v.x(), v.y() };
+}
+
+Eigen::Vector3f
+decodeOctahedral(float x, float y)
+{
+    Eigen::Vector3f v(x, y, 1.0f - std::abs(x) - std::abs(y));
+    float t = std::max(-v.z(), 0.0f);
+    v.x() += v.x() >= 0.0f ? -t : t;
+    v.y() += v.y() >= 0.0f ? -t : t;
+    return v.normalized();
+}
+
+bool
+isDirection(VertexAttributeSemantic semantic)
+{
+    return semantic == VertexAttributeSemantic::Normal || semantic == VertexAttributeSemantic::Tangent;
+}
+
+} // end unnamed namespace
+
+
+std::uint16_t
+FloatToHalf(float f)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    auto sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000);
+    std::uint32_t absBits = bits & 0x7fffffff;
+
+    // Infinity and NaN, which stays a NaN
+    if (absBits >= 0x7f800000)
+        return sign | 0x7c00 | (absBits > 0x7f800000 ? 0x200 : 0);
+    // Rounds to infinity
+    if (absBits >= 0x477ff000)
+        return sign | 0x7c00;
+    // Subnormal half, rounded to the nearest multiple of 2^-24
+    if (absBits < 0x38800000)
+    {
+        float absF;
+        std::memcpy(&absF, &absBits, sizeof(absF));
+        return sign | static_cast<std::uint16_t>(std::lrint(absF * 16777216.0f));
+    }
+
+    // Rebias the exponent and round the mantissa to nearest even
+    std::uint32_t rounded = absBits - 0x38000000 + 0x0fff + ((absBits >> 13) & 1);
+    return sign | static_cast<std::uint16_t>(rounded >> 13);
+}
+
+
+float
+HalfToFloat(std::uint16_t h)
+{
+    std::uint32_t sign = static_cast<std::uint32_t>(h & 0x8000) << 16;
+    std::uint32_t exponent = (h >> 10) & 0x1f;
+    std::uint32_t mantissa = h & 0x3ff;
+
+    std::uint32_t bits;
+    if (exponent == 0)
+    {
+        float f = static_cast<float>(mantissa) / 16777216.0f;
+        return sign != 0 ? -f : f;
+    }
+
+    if (exponent == 0x1f)
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    else
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+
+Eigen::Vector4f
+DecodeVertexAttribute(const VWord* data, VertexAttributeFormat format)
+{
+    Eigen::Vector4f v = Eigen::Vector4f::Zero();
+    switch (format)
+    {
+    case VertexAttributeFormat::Float1:
+    case VertexAttributeFormat::Float2:
+    case VertexAttributeFormat::Float3:
+    case VertexAttributeFormat::Float4:
+        std::memcpy(v.data(), data, VertexAttribute::getFormatSizeWords(format) * sizeof(float));
+        break;
+    case VertexAttributeFormat::UByte4:
+        {
+            std::array<std::uint8_t, 4> bytes;
+            std::memcpy(bytes.data(), data, bytes.size());
+            for (int i = 0; i < 4; i++)
+                v[i] = static_cast<float>(bytes[i]) / 255.0f;
+        }
+        break;
+    case VertexAttributeFormat::Short4:
+        {
+            std::array<std::int16_t, 4> shorts;
+            std::memcpy(shorts.data(), data, sizeof(shorts));
+            for (int i = 0; i < 4; i++)
+                v[i] = fromSNorm16(shorts[i]);
+        }
+        break;
+    case VertexAttributeFormat::Half2:
+        {
+            std::array<std::uint16_t, 2> halves;
+            std::memcpy(halves.data(), data, sizeof(halves));
+            v.x() = HalfToFloat(halves[0]);
+            v.y() = HalfToFloat(halves[1]);
+        }
+        break;
+    case VertexAttributeFormat::Octahedral:
+        {
+            std::array<std::int16_t, 2> shorts;
+            std::memcpy(shorts.data(), data, sizeof(shorts));
+            v.head<3>() = decodeOctahedral(fromSNorm16(shorts[0]), fromSNorm16(shorts[1]));
+        }
+        break;
+    default:
+        break;
+    }
+
+    return v;
+}
+
+
+void
+EncodeVertexAttribute(const Eigen::Vector4f& value, VertexAttributeFormat format, VWord* data)
+{
+    switch (format)
+    {
+    case VertexAttributeFormat::Float1:
+    case VertexAttributeFormat::Float2:
+    case VertexAttributeFormat::Float3:
+    case VertexAttributeFormat::Float4:
+        std::memcpy(data, value.data(), VertexAttribute::getFormatSizeWords(format) * sizeof(float));
+        break;
+    case VertexAttributeFormat::UByte4:
+        {
+            std::array<std::uint8_t, 4> bytes;
+            for (int i = 0; i < 4; i++)
+                bytes[i] = static_cast<std::uint8_t>(std::lround(std::clamp(value[i], 0.0f, 1.0f) * 255.0f));
+            std::memcpy(data, bytes.data(), bytes.size());
+        }
+        break;
+    case VertexAttributeFormat::Short4:
+        {
+            std::array<std::int16_t, 4> shorts;
+            for (int i = 0; i < 4; i++)
+                shorts[i] = toSNorm16(value[i]);
+            std::memcpy(data, shorts.data(), sizeof(shorts));
+        }
+        break;
+    case VertexAttributeFormat::Half2:
+        {
+            std::array<std::uint16_t, 2> halves{ FloatToHalf(value.x()), FloatToHalf(value.y()) };
+            std::memcpy(data, halves.data(), sizeof(halves));
+        }
+        break;
+    case VertexAttributeFormat::Octahedral:
+        {
+            std::array<float, 2> xy = encodeOctahedral(value.head<3>());
+            std::array<std::int16_t, 2> shorts{ toSNorm16(xy[0]), toSNorm16(xy[1]) };
+            std::memcpy(data, shorts.data(), sizeof(shorts));
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+
+bool
+ConvertVertexAttribute(Mesh& mesh, VertexAttributeSemantic semantic, VertexAttributeFormat format)
+{
+    const VertexDescription& desc = mesh.getVertexDescription();
+    const VertexAttribute& oldAttribute = desc.getAttribute(semantic);
+    if (oldAttribute.semantic != semantic || oldAttribute.format == format ||
+        VertexAttribute::getFormatSizeWords(format) == 0)
+    {
+        return false;
+    }
+
+    bool isPosition = semantic == VertexAttributeSemantic::Position;
+    if (isPosition && format != VertexAttributeFormat::Float3 && format != VertexAttributeFormat::Short4)
+        return false;
+
+    std::vector<VertexAttribute> attributes;
+    attributes.reserve(desc.attributes.size());
+    unsigned int offset = 0;
+    for (const VertexAttribute& attribute : desc.attributes)
+    {
+        attributes.emplace_back(attribute.semantic,
+                                attribute.semantic == semantic ? format : attribute.format,
+                                offset);
+        offset += VertexAttribute::getFormatSizeWords(attributes.back().format);
+    }
+
+    VertexDescription newDesc(std::move(attributes));
+    const VertexAttribute& newAttribute = newDesc.getAttribute(semantic);
+
+    // Quantized positions are mapped from the cube around the bounding box
+    unsigned int nVertices = mesh.getVertexCount();
+    Eigen::Vector3f positionOffset = Eigen::Vector3f::Zero();
+    float positionScale = 1.0f;
+    if (isPosition && format == VertexAttributeFormat::Short4)
+    {
+        Eigen::AlignedBox<float, 3> bounds;
+        for (Index32 i = 0; i < nVertices; i++)
+            bounds.extend(mesh.getVertexPosition(i));
+        if (!bounds.isEmpty())
+        {
+            positionOffset = bounds.center();
+            positionScale = bounds.sizes().maxCoeff() * 0.5f;
+            if (positionScale == 0.0f)
+                positionScale = 1.0f;
+        }
+    }
+
+    unsigned int oldStride = mesh.getVertexStrideWords();
+    unsigned int newStride = newDesc.strideBytes / sizeof(VWord);
+    const VWord* oldData = mesh.getVertexData();
+    std::vector<VWord> newData(static_cast<std::size_t>(nVertices) * newStride);
+    for (Index32 i = 0; i < nVertices; i++)
+    {
+        const VWord* oldVertex = oldData + static_cast<std::size_t>(i) * oldStride;
+        VWord* newVertex = newData.data() + static_cast<std::size_t>(i) * newStride;
+        for (std::size_t j = 0; j < desc.attributes.size(); j++)
+        {
+            if (desc.attributes[j].semantic == semantic)
+                continue;
+            std::memcpy(newVertex + newDesc.attributes[j].offsetWords,
+                        oldVertex + desc.attributes[j].offsetWords,
+                        VertexAttribute::getFormatSizeWords(desc.attributes[j].format) * sizeof(VWord));
+        }
+
+        Eigen::Vector4f value;
+        if (isPosition)
+        {
+            value << mesh.getVertexPosition(i), 1.0f;
+            if (format == VertexAttributeFormat::Short4)
+                value.head<3>() = (value.head<3>() - positionOffset) / positionScale;
+        }
+        else
+        {
+            value = DecodeVertexAttribute(oldVertex + oldAttribute.offsetWords, oldAttribute.format);
+            if (isDirection(semantic) &&
+                (format == VertexAttributeFormat::Short4 || format == VertexAttributeFormat::Octahedral))
+            {
+                value.head<3>().normalize();
+                value.w() = 0.0f;
+            }
+        }
+
+        EncodeVertexAttribute(value, format, newVertex + newAttribute.offsetWords);
+    }
+
+    mesh.setVertexDescription(std::move(newDesc));
+    mesh.setVertices(nVertices, std::move(newData));
+    if (isPosition)
+        mesh.setPositionQuantization(positionOffset, positionScale);
+
+    return true;
+}
+
+
+bool
+QuantizeMesh(Mesh& mesh)
+{
+    constexpr std::array<std::pair<VertexAttributeSemantic, VertexAttributeFormat>, 7> conversions
+    {
+        std::make_pair(VertexAttributeSemantic::Position, VertexAttributeFormat::Short4),
+        std::make_pair(VertexAttributeSemantic::Normal,   VertexAttributeFormat::Octahedral),
+        std::make_pair(VertexAttributeSemantic::Tangent,  VertexAttributeFormat::Short4),
+        std::make_pair(VertexAttributeSemantic::Texture0, VertexAttributeFormat::Half2),
+        std::make_pair(VertexAttributeSemantic::Texture1, VertexAttributeFormat::Half2),
+        std::make_pair(VertexAttributeSemantic::Texture2, VertexAttributeFormat::Half2),
+        std::make_pair(VertexAttributeSemantic::Texture3, VertexAttributeFormat::Half2),
+    };
+
+    bool converted = false;
+    for (const auto& [semantic, format] : conversions)
+    {
+        // Only the formats with the same components are replaced
+        VertexAttributeFormat oldFormat = mesh.getVertexDescription().getAttribute(semantic).format;
+        bool convertible = format == VertexAttributeFormat::Half2
+            ? oldFormat == VertexAttributeFormat::Float2
+            : oldFormat == VertexAttributeFormat::Float3;
+        if (convertible)
+            converted |= ConvertVertexAttribute(mesh, semantic, format);
+    }
+
+    return converted;
+}
+
+
+bool
+DequantizeMesh(Mesh& mesh)
+{
+    bool converted = false;
+    for (auto semantic = VertexAttributeSemantic::Position;
+         semantic < VertexAttributeSemantic::SemanticMax;
+         semantic = static_cast<VertexAttributeSemantic>(1 + static_cast<std::int16_t>(semantic)))
+    {
+        switch (mesh.getVertexDescription().getAttribute(semantic).format)
+        {
+        case VertexAttributeFormat::Short4:
+            converted |= ConvertVertexAttribute(mesh, semantic,
+                                                semantic == VertexAttributeSemantic::Position || isDirection(semantic)
+                                                    ? VertexAttributeFormat::Float3
+                                                    : VertexAttributeFormat::Float4);
+            break;
+        case VertexAttributeFormat::Half2:
+            converted |= ConvertVertexAttribute(mesh, semantic, VertexAttributeFormat::Float2);
+            break;
+        case VertexAttributeFormat::Octahedral:
+            converted |= ConvertVertexAttribute(mesh, semantic, VertexAttributeFormat::Float3);
+            break;
+        default:
+            break;
+        }
+    }
+
+    return converted;
+}
+
+} // namespace cmod
@@ -0,0 +1,54 @@
+// meshquantize.h
+//
+// Copyright (C) 2023-present, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+
+#include <Eigen/Core>
+
+#include "mesh.h"
+
+
+namespace cmod
+{
+
+std::uint16_t FloatToHalf(float f);
+float HalfToFloat(std::uint16_t h);
+
+/*! Read a vertex attribute as floats; missing components are zero, and
+ *  normalized formats are mapped to [0, 1] or [-1, 1]. Short4 positions
+ *  aren't scaled by the mesh.
+ */
+Eigen::Vector4f DecodeVertexAttribute(const VWord* data, VertexAttributeFormat format);
+
+/*! Store a vertex attribute, clamping the components of normalized
+ *  formats. Octahedral stores the direction of xyz.
+ */
+void EncodeVertexAttribute(const Eigen::Vector4f& value, VertexAttributeFormat format, VWord* data);
+
+/*! Change the format of an attribute of all vertices of a mesh. Positions
+ *  converted to Short4 are mapped from the bounding box of the mesh, and
+ *  normals and tangents are normalized for Short4 and Octahedral. Return
+ *  false if the mesh has no such attribute or it already has the format.
+ */
+bool ConvertVertexAttribute(Mesh& mesh, VertexAttributeSemantic semantic, VertexAttributeFormat format);
+
+/*! Store Float3 positions and tangents as Short4, Float3 normals as
+ *  Octahedral and Float2 texture coordinates as Half2, which takes half
+ *  the space or less. Return true if any attribute was converted.
+ */
+bool QuantizeMesh(Mesh& mesh);
+
+/*! Store all Short4, Half2 and Octahedral attributes as floats. Return
+ *  true if any attribute was converted.
+ */
+bool DequantizeMesh(Mesh& mesh);
+
+} // namespace cmod
@@ -0,0 +1,477 @@
+// meshsimplify.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "meshsimplify.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "meshoptimize.h"
+#include "model.h"
+
+
+namespace cmod
+{
+namespace
+{
+
+constexpr Index32 NoVertex = std::numeric_limits<Index32>::max();
+constexpr unsigned int NoGroup = std::numeric_limits<unsigned int>::max();
+
+struct Triangle
+{
+    std::array<Index32, 3> v;
+    unsigned int group;
+
+    bool contains(Index32 vertex) const { return v[0] == vertex || v[1] == vertex || v[2] == vertex; }
+    bool isDegenerate() const { return v[0] == v[1] || v[1] == v[2] || v[2] == v[0]; }
+};
+
+struct Collapse
+{
+    Index32 from;
+    Index32 to;
+    double cost;
+};
+
+
+bool
+isTriangleList(const PrimitiveGroup& group)
+{
+    return group.prim == PrimitiveGroupType::TriList && !group.indices.empty() && group.indices.size() % 3 == 0;
+}
+
+
+std::uint64_t
+edgeKey(Index32 a, Index32 b)
+{
+    return (static_cast<std::uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+}
+
+
+double
+evaluateQuadric(const Eigen::Matrix4d& q, const Eigen::Vector3d& p)
+{
+    Eigen::Vector4d v(p.x(), p.y(), p.z(), 1.0);
+    return std::max(v.dot(q * v), 0.0);
+}
+
+
+class Simplifier
+{
+ public:
+    explicit Simplifier(const Mesh& mesh);
+
+    void run(std::size_t targetTriangles);
+    Mesh buildMesh() const;
+    double getError() const { return std::sqrt(maxCost); }
+
+ private:
+    void lockVertices();
+    void computeQuadrics();
+    void buildAdjacency();
+    bool collapsePass(std::size_t targetTriangles);
+    bool canCollapse(Index32 from, Index32 to, std::vector<Index32>& neighbours) const;
+
+    Mesh mesh;
+    std::vector<Eigen::Vector3d> positions;
+    std::vector<Triangle> triangles;
+    std::vector<bool> locked;
+    std::vector<Eigen::Matrix4d> quadrics;
+
+    // The triangles around each vertex, valid during a pass
+    std::vector<Index32> adjacencyOffsets;
+    std::vector<Index32> adjacency;
+
+    double maxCost{ 0.0 };
+};
+
+
+Simplifier::Simplifier(const Mesh& source) :
+    mesh(source.clone())
+{
+    if (!mesh.hasPositions())
+        return;
+
+    // Split vertices would make every edge a border
+    RemoveDuplicateVertices(mesh);
+
+    unsigned int nVertices = mesh.getVertexCount();
+    positions.resize(nVertices);
+    for (unsigned int i = 0; i < nVertices; i++)
+        positions[i] = mesh.getVertexPosition(i).cast<double>();
+
+    for (unsigned int g = 0; g < mesh.getGroupCount(); g++)
+    {
+        const PrimitiveGroup* group = mesh.getGroup(g);
+        if (!isTriangleList(*group))
+            continue;
+
+        for (std::size_t i = 0; i < group->indices.size(); i += 3)
+        {
+            Triangle tri{ { group->indices[i], group->indices[i + 1], group->indices[i + 2] }, g };
+            if (!tri.isDegenerate())
+                triangles.push_back(tri);
+        }
+    }
+
+    lockVertices();
+    computeQuadrics();
+}
+
+
+// Vertices on borders have edges with only one triangle; texture and normal
+// seams are borders too once identical vertices are merged. Non-manifold
+// edges, vertices shared between groups and vertices of other primitives
+// are locked as well.
+void
+Simplifier::lockVertices()
+{
+    unsigned int nVertices = mesh.getVertexCount();
+    locked.assign(nVertices, false);
+
+    std::vector<unsigned int> vertexGroups(nVertices, NoGroup);
+    for (unsigned int g = 0; g < mesh.getGroupCount(); g++)
+    {
+        const PrimitiveGroup* group = mesh.getGroup(g);
+        if (isTriangleList(*group))
+            continue;
+        for (Index32 index : group->indices)
+            locked[index] = true;
+    }
+
+    std::unordered_map<std::uint64_t, unsigned int> edgeCounts;
+    edgeCounts.reserve(triangles.size() * 2);
+    for (const Triangle& tri : triangles)
+    {
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            Index32 v = tri.v[k];
+            if (vertexGroups[v] == NoGroup)
+                vertexGroups[v] = tri.group;
+            else if (vertexGroups[v] != tri.group)
+                locked[v] = true;
+
+            edgeCounts[edgeKey(v, tri.v[(k + 1) % 3])]++;
+        }
+    }
+
+    for (const auto& [key, count] : edgeCounts)
+    {
+        if (count != 2)
+        {
+            locked[static_cast<Index32>(key >> 32)] = true;
+            locked[static_cast<Index32>(key & 0xffffffffu)] = true;
+        }
+    }
+}
+
+
+// The quadrics are sums of the squared distances to the planes of the
+// triangles around each vertex.
+void
+Simplifier::computeQuadrics()
+{
+    quadrics.assign(positions.size(), Eigen::Matrix4d::Zero());
+    for (const Triangle& tri : triangles)
+    {
+        const Eigen::Vector3d& p0 = positions[tri.v[0]];
+        Eigen::Vector3d n = (positions[tri.v[1]] - p0).cross(positions[tri.v[2]] - p0);
+        double length = n.norm();
+        if (length == 0.0)
+            continue;
+        n /= length;
+
+        Eigen::Vector4d plane(n.x(), n.y(), n.z(), -n.dot(p0));
+        Eigen::Matrix4d q = plane * plane.transpose();
+        for (Index32 v : tri.v)
+            quadrics[v] += q;
+    }
+}
+
+
+void
+Simplifier::buildAdjacency()
+{
+    std::size_t nVertices = positions.size();
+    std::vector<Index32> counts(nVertices, 0);
+    for (const Triangle& tri : triangles)
+    {
+        for (Index32 v : tri.v)
+            counts[v]++;
+    }
+
+    adjacencyOffsets.resize(nVertices + 1);
+    adjacencyOffsets[0] = 0;
+    for (std::size_t i = 0; i < nVertices; i++)
+        adjacencyOffsets[i + 1] = adjacencyOffsets[i] + counts[i];
+
+    adjacency.resize(triangles.size() * 3);
+    std::vector<Index32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (std::size_t t = 0; t < triangles.size(); t++)
+    {
+        for (Index32 v : triangles[t].v)
+            adjacency[fill[v]++] = static_cast<Index32>(t);
+    }
+}
+
+
+// A collapse is allowed if the edge has exactly two triangles sharing
+// it, the one-rings of its vertices only meet on those triangles, and none
+// of the remaining triangles around the removed vertex flips over.
+bool
+Simplifier::canCollapse(Index32 from, Index32 to, std::vector<Index32>& neighbours) const
+{
+    auto ring = [this](Index32 vertex, std::vector<Index32>& result)
+    {
+        result.clear();
+        for (Index32 i = adjacencyOffsets[vertex]; i < adjacencyOffsets[vertex + 1]; i++)
+        {
+            for (Index32 v : triangles[adjacency[i]].v)
+            {
+                if (v != vertex)
+                    result.push_back(v);
+            }
+        }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+    };
+
+    std::vector<Index32> toRing;
+    ring(from, neighbours);
+    ring(to, toRing);
+
+    std::size_t shared = 0;
+    std::size_t sharedTriangles = 0;
+    auto i = neighbours.begin();
+    auto j = toRing.begin();
+    while (i != neighbours.end() && j != toRing.end())
+    {
+        if (*i < *j)
+            ++i;
+        else if (*j < *i)
+            ++j;
+        else
+        {
+            shared++;
+            ++i;
+            ++j;
+        }
+    }
+
+    for (Index32 k = adjacencyOffsets[from]; k < adjacencyOffsets[from + 1]; k++)
+    {
+        const Triangle& tri = triangles[adjacency[k]];
+        if (tri.contains(to))
+        {
+            sharedTriangles++;
+            continue;
+        }
+
+        std::array<Eigen::Vector3d, 3> p;
+        std::array<Eigen::Vector3d, 3> q;
+        for (unsigned int n = 0; n < 3; n++)
+        {
+            p[n] = positions[tri.v[n]];
+            q[n] = tri.v[n] == from ? positions[to] : p[n];
+        }
+        Eigen::Vector3d oldNormal = (p[1] - p[0]).cross(p[2] - p[0]);
+        Eigen::Vector3d newNormal = (q[1] - q[0]).cross(q[2] - q[0]);
+        if (newNormal.dot(oldNormal) <= 1.0e-3 * oldNormal.squaredNorm())
+            return false;
+    }
+
+    return shared == 2 && sharedTriangles == 2;
+}
+
+
+// Collapse the cheapest edges whose neighbourhoods don't overlap
+bool
+Simplifier::collapsePass(std::size_t targetTriangles)
+{
+    buildAdjacency();
+
+    std::vector<Collapse> collapses;
+    collapses.reserve(triangles.size() * 3);
+    for (const Triangle& tri : triangles)
+    {
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            Index32 a = tri.v[k];
+            Index32 b = tri.v[(k + 1) % 3];
+            Eigen::Matrix4d q = quadrics[a] + quadrics[b];
+            if (!locked[a])
+                collapses.push_back(Collapse{ a, b, evaluateQuadric(q, positions[b]) });
+            if (!locked[b])
+                collapses.push_back(Collapse{ b, a, evaluateQuadric(q, positions[a]) });
+        }
+    }
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse& c0, const Collapse& c1) { return c0.cost < c1.cost; });
+
+    std::size_t toRemove = triangles.size() - targetTriangles;
+    std::size_t removed = 0;
+    std::vector<Index32> remap(positions.size(), NoVertex);
+    std::vector<bool> touched(positions.size(), false);
+    std::vector<Index32> neighbours;
+    for (const Collapse& c : collapses)
+    {
+        if (removed >= toRemove)
+            break;
+        if (touched[c.from] || touched[c.to] || !canCollapse(c.from, c.to, neighbours))
+            continue;
+
+        remap[c.from] = c.to;
+        touched[c.from] = true;
+        for (Index32 v : neighbours)
+            touched[v] = true;
+        quadrics[c.to] += quadrics[c.from];
+        maxCost = std::max(maxCost, c.cost);
+        removed += 2;
+    }
+
+    if (removed == 0)
+        return false;
+
+    for (Triangle& tri : triangles)
+    {
+        for (Index32& v : tri.v)
+        {
+            if (remap[v] != NoVertex)
+                v = remap[v];
+        }
+    }
+    triangles.erase(std::remove_if(triangles.begin(), triangles.end(),
+                                   [](const Triangle& tri) { return tri.isDegenerate(); }),
+                    triangles.end());
+    return true;
+}
+
+
+void
+Simplifier::run(std::size_t targetTriangles)
+{
+    while (triangles.size() > targetTriangles)
+    {
+        if (!collapsePass(targetTriangles))
+            break;
+    }
+}
+
+
+Mesh
+Simplifier::buildMesh() const
+{
+    // Gather the triangles again by group, and drop the unused vertices
+    std::vector<std::vector<Index32>> groupIndices(mesh.getGroupCount());
+    for (const Triangle& tri : triangles)
+        groupIndices[tri.group].insert(groupIndices[tri.group].end(), tri.v.begin(), tri.v.end());
+
+    unsigned int nVertices = mesh.getVertexCount();
+    std::vector<Index32> vertexMap(nVertices, NoVertex);
+    Index32 nextVertex = 0;
+    auto mapIndices = [&](std::vector<Index32>& indices)
+    {
+        for (Index32& index : indices)
+        {
+            if (vertexMap[index] == NoVertex)
+                vertexMap[index] = nextVertex++;
+            index = vertexMap[index];
+        }
+    };
+
+    Mesh result;
+    for (unsigned int g = 0; g < mesh.getGroupCount(); g++)
+    {
+        const PrimitiveGroup* group = mesh.getGroup(g);
+        std::vector<Index32> indices = isTriangleList(*group) && !positions.empty()
+            ? std::move(groupIndices[g])
+            : group->indices;
+        if (indices.empty())
+            continue;
+
+        mapIndices(indices);
+        result.addGroup(group->prim, group->materialIndex, std::move(indices));
+    }
+
+    unsigned int stride = mesh.getVertexStrideWords();
+    const VWord* vdata = mesh.getVertexData();
+    std::vector<VWord> vertices(static_cast<std::size_t>(nextVertex) * stride);
+    for (unsigned int i = 0; i < nVertices; i++)
+    {
+        if (vertexMap[i] == NoVertex)
+            continue;
+        std::memcpy(vertices.data() + static_cast<std::size_t>(vertexMap[i]) * stride,
+                    vdata + static_cast<std::size_t>(i) * stride,
+                    stride * sizeof(VWord));
+    }
+
+    result.setVertexDescription(mesh.getVertexDescription().clone());
+    result.setVertices(nextVertex, std::move(vertices));
+    result.setName(std::string(mesh.getName()));
+    result.setTrackIndex(mesh.getTrackIndex());
+    result.setPositionQuantization(mesh.getPositionOffset(), mesh.getPositionScale());
+    result.rebuildIndexMetadata();
+    return result;
+}
+
+} // end unnamed namespace
+
+
+Mesh
+SimplifyMesh(const Mesh& mesh, float targetRatio, float& error)
+{
+    Simplifier simplifier(mesh);
+    std::size_t nTriangles = 0;
+    for (unsigned int g = 0; g < mesh.getGroupCount(); g++)
+    {
+        if (isTriangleList(*mesh.getGroup(g)))
+            nTriangles += mesh.getGroup(g)->indices.size() / 3;
+    }
+
+    auto target = static_cast<std::size_t>(static_cast<float>(nTriangles) * std::clamp(targetRatio, 0.0f, 1.0f));
+    simplifier.run(target);
+    error = static_cast<float>(simplifier.getError());
+    return simplifier.buildMesh();
+}
+
+
+std::unique_ptr<Model>
+SimplifyModel(const Model& model, float targetRatio, float& error)
+{
+    auto result = std::make_unique<Model>();
+    for (unsigned int i = 0; i < model.getMaterialCount(); i++)
+        result->addMaterial(model.getMaterial(i)->clone());
+    for (unsigned int i = 0; i < model.getTrackCount(); i++)
+        result->addTrack(TransformTrack(*model.getTrack(i)));
+
+    error = 0.0f;
+    for (unsigned int i = 0; i < model.getMeshCount(); i++)
+    {
+        float meshError;
+        Mesh mesh = SimplifyMesh(*model.getMesh(i), targetRatio, meshError);
+        error = std::max(error, meshError);
+        if (mesh.getGroupCount() > 0)
+            result->addMesh(std::move(mesh));
+    }
+
+    return result;
+}
+
+} // namespace cmod
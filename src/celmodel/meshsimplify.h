@@ -0,0 +1,36 @@
+// meshsimplify.h
+//
+// Copyright (C) 2023-present, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <memory>
+
+#include "mesh.h"
+
+
+namespace cmod
+{
+class Model;
+
+/*! Reduce the triangle lists of a mesh to about targetRatio of their
+ *  triangles by collapsing edges in the order of their quadric error
+ *  (Garland and Heckbert). Vertices only move onto their neighbours, so
+ *  no new attributes are interpolated, and vertices on borders, texture
+ *  and normal seams and between materials are never removed. Other
+ *  primitive types are copied. error is set to the estimated largest
+ *  distance between the result and the original surface.
+ */
+Mesh SimplifyMesh(const Mesh& mesh, float targetRatio, float& error);
+
+/*! Simplify all meshes of a model; materials and transform tracks are
+ *  copied in the same order, so their indices are unchanged.
+ */
+std::unique_ptr<Model> SimplifyModel(const Model& model, float targetRatio, float& error);
+
+} // namespace cmod
@@ -16,6 +16,7 @@
 #include <Eigen/Geometry>
 
 #include <celutil/logger.h>
+#include <celutil/memoryreport.h>
 
 #include "model.h"
 
@@ -140,6 +141,19 @@ Model::getMeshCount() const
 }
 
 
+std::size_t
+Model::getMemoryUsage() const
+{
+    using celestia::util::vectorMemory;
+
+    std::size_t size = sizeof(Model) + vectorMemory(materials) + vectorMemory(tracks);
+    for (const auto& mesh : meshes)
+        size += mesh.getMemoryUsage();
+
+    return size;
+}
+
+
 Mesh*
 Model::getMesh(unsigned int index)
 {
@@ -168,6 +182,31 @@ Model::addMesh(Mesh&& m)
 }
 
 
+const TransformTrack*
+Model::getTrack(unsigned int index) const
+{
+    if (index < tracks.size())
+        return &tracks[index];
+    else
+        return nullptr;
+}
+
+
+unsigned int
+Model::getTrackCount() const
+{
+    return tracks.size();
+}
+
+
+unsigned int
+Model::addTrack(TransformTrack&& track)
+{
+    tracks.push_back(std::move(track));
+    return tracks.size();
+}
+
+
 bool
 Model::pick(const Eigen::Vector3d& rayOrigin,
             const Eigen::Vector3d& rayDirection,
@@ -227,6 +266,8 @@ Model::transform(const Eigen::Vector3f& translation, float scale)
 {
     for (auto& mesh : meshes)
         mesh.transform(translation, scale);
+    for (auto& track : tracks)
+        track.transform(translation, scale);
 }
 
 
@@ -18,6 +18,7 @@
 
 #include "material.h"
 #include "mesh.h"
+#include "transformtrack.h"
 
 
 namespace cmod
@@ -65,11 +66,30 @@ class Model
      */
     unsigned int getMeshCount() const;
 
+    /*! Return the bytes taken by the meshes, materials and transform
+     *  tracks of the model
+     */
+    std::size_t getMemoryUsage() const;
+
     /*! Add a new mesh to the model; the return value is the
      *  total number of meshes in the model.
      */
     unsigned int addMesh(Mesh&& mesh);
 
+    /*! Return the transform track with the specified index, or nullptr
+     *  if the index is out of range.
+     */
+    const TransformTrack* getTrack(unsigned int index) const;
+
+    /*! Return the number of transform tracks in the model.
+     */
+    unsigned int getTrackCount() const;
+
+    /*! Add a new transform track to the model; the return value is the
+     *  total number of tracks in the model.
+     */
+    unsigned int addTrack(TransformTrack&& track);
+
     /** Find the closest intersection between the ray (given
      *  by origin and direction) and the model. If the ray
      *  intersects the model, return true and fill in the
@@ -156,6 +176,7 @@ class Model
  private:
     std::vector<Material> materials{ };
     std::vector<Mesh> meshes{ };
+    std::vector<TransformTrack> tracks{ };
 
     std::array<bool, static_cast<std::size_t>(TextureSemantic::TextureSemanticMax)> textureUsage;
     bool opaque{ true };
@@ -12,9 +12,11 @@
 #include <array>
 #include <cassert>
 #include <cstring>
+#include <fstream>
 #include <istream>
 #include <optional>
 #include <ostream>
+#include <streambuf>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -22,11 +24,16 @@
 #include <fmt/format.h>
 #include <fmt/ostream.h>
 
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
 #include <celutil/binaryread.h>
 #include <celutil/binarywrite.h>
 #include <celutil/logger.h>
+#include <celutil/mappedfile.h>
 #include <celutil/tokenizer.h>
 #include "mesh.h"
+#include "meshquantize.h"
 #include "model.h"
 #include "modelfile.h"
 
@@ -58,8 +65,13 @@ constexpr std::string_view EndMeshToken = "end_mesh"sv;
 constexpr std::string_view VertexDescToken = "vertexdesc"sv;
 constexpr std::string_view EndVertexDescToken = "end_vertexdesc"sv;
 constexpr std::string_view VerticesToken = "vertices"sv;
+constexpr std::string_view QuantizationToken = "quantization"sv;
 constexpr std::string_view MaterialToken = "material"sv;
 constexpr std::string_view EndMaterialToken = "end_material"sv;
+constexpr std::string_view TrackToken = "track"sv;
+constexpr std::string_view EndTrackToken = "end_track"sv;
+constexpr std::string_view PivotToken = "pivot"sv;
+constexpr std::string_view KeyToken = "key"sv;
 
 // Binary file tokens
 enum class CmodToken
@@ -78,6 +90,12 @@ enum class CmodToken
     Vertices      = 1013,
     Emissive      = 1014,
     Blend         = 1015,
+    Track         = 1016,
+    EndTrack      = 1017,
+    Pivot         = 1018,
+    Key           = 1019,
+    MeshTrack     = 1020,
+    MeshQuantization = 1021,
 };
 
 enum class CmodType
@@ -142,7 +160,8 @@ defined here--they have the obvious definitions.
 
 <header>              ::= #celmodel__ascii
 
-<model>               ::= { <material_definition> } { <mesh_definition> }
+<model>               ::= { <material_definition> } { <track_definition> }
+                          { <mesh_definition> }
 
 <material_definition> ::= material
                           { <material_attribute> }
@@ -169,9 +188,24 @@ defined here--they have the obvious definitions.
 
 <blendmode>           ::= normal | add | premultiplied
 
+<track_definition>    ::= track
+                          [ pivot <float> <float> <float> ]
+                          { <track_key> }
+                          end_track
+
+<track_key>           ::= key <time> <rotation> <translation>
+
+<time>                ::= <float>
+
+<rotation>            ::= <float> <float> <float> <float>
+
+<translation>         ::= <float> <float> <float>
+
 <mesh_definition>     ::= mesh
                           <vertex_description>
                           <vertex_pool>
+                          [ quantization <float> <float> <float> <float> ]
+                          [ track <track_index> ]
                           { <prim_group> }
                           end_mesh
 
@@ -185,7 +219,7 @@ defined here--they have the obvious definitions.
                           texcoord0 | texcoord1 | texcoord2 | texcoord3 |
                           pointsize
 
-<vertex_format>       ::= f1 | f2 | f3 | f4 | ub4
+<vertex_format>       ::= f1 | f2 | f3 | f4 | ub4 | s4 | h2 | oct
 
 <vertex_pool>         ::= vertices <count>
                           { <float> }
@@ -200,7 +234,19 @@ defined here--they have the obvious definitions.
                           sprites
 
 <material_index>      :: <unsigned_int> | -1
+
+<track_index>         :: <unsigned_int>
 \endcode
+
+Attributes in ub4 format are given as four integers from 0 to 255, in s4
+as four integers from -32767 to 32767 and in oct as two, and h2 texture
+coordinates as two floats. The quantization of a mesh with s4 positions
+is the scale and the x y z offset mapping them from [-1, 1] to model
+coordinates.
+
+Key times are in seconds and must increase; the rotation is a unit
+quaternion w x y z about the pivot, and the translation is applied after
+it. The animation loops with the time of the last key as its period.
 */
 
 PrimitiveGroupType
@@ -265,6 +311,12 @@ parseVertexAttributeFormat(std::string_view name)
         return VertexAttributeFormat::Float4;
     if (name == "ub4"sv)
         return VertexAttributeFormat::UByte4;
+    if (name == "s4"sv)
+        return VertexAttributeFormat::Short4;
+    if (name == "h2"sv)
+        return VertexAttributeFormat::Half2;
+    if (name == "oct"sv)
+        return VertexAttributeFormat::Octahedral;
     return VertexAttributeFormat::InvalidFormat;
 }
 
@@ -300,12 +352,16 @@ protected:
 
 private:
     bool loadMaterial(Material& material);
+    bool loadTrack(TransformTrack& track);
+    bool loadNumbers(float* values, int count);
     VertexDescription loadVertexDescription();
     bool loadMesh(Mesh& mesh);
     std::vector<VWord> loadVertices(const VertexDescription& vertexDesc,
                                     unsigned int& vertexCount);
     bool loadUByte4Attribute(const VertexAttribute& attr,
                              cmod::VWord* destination);
+    bool loadShortAttribute(const VertexAttribute& attr,
+                            cmod::VWord* destination);
     bool loadFloatAttribute(const VertexAttribute& attr,
                             cmod::VWord* destination);
 
@@ -454,6 +510,86 @@ AsciiModelLoader::loadMaterial(Material& material)
 }
 
 
+bool
+AsciiModelLoader::loadNumbers(float* values, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        tok.nextToken();
+        if (auto tokenValue = tok.getNumberValue(); tokenValue.has_value())
+            values[i] = static_cast<float>(*tokenValue);
+        else
+            return false;
+    }
+
+    return true;
+}
+
+
+bool
+AsciiModelLoader::loadTrack(TransformTrack& track)
+{
+    tok.nextToken();
+    if (tok.getNameValue() != TrackToken)
+    {
+        reportError("Track definition expected");
+        return false;
+    }
+
+    for (;;)
+    {
+        tok.nextToken();
+        auto tokenValue = tok.getNameValue();
+        if (!tokenValue.has_value())
+        {
+            reportError("Key expected in track");
+            return false;
+        }
+
+        if (*tokenValue == EndTrackToken)
+            break;
+
+        if (*tokenValue == PivotToken)
+        {
+            float pivot[3];
+            if (!loadNumbers(pivot, 3))
+            {
+                reportError("Bad pivot in track");
+                return false;
+            }
+            track.setPivot(Eigen::Map<Eigen::Vector3f>(pivot));
+        }
+        else if (*tokenValue == KeyToken)
+        {
+            // time, rotation (w x y z), translation
+            float values[8];
+            if (!loadNumbers(values, 8))
+            {
+                reportError("Bad key in track");
+                return false;
+            }
+
+            TransformTrack::Key key;
+            key.time = values[0];
+            key.rotation = Eigen::Quaternionf(values[1], values[2], values[3], values[4]);
+            key.translation = Eigen::Map<Eigen::Vector3f>(values + 5);
+            if (!track.addKey(key))
+            {
+                reportError("Track key times must increase");
+                return false;
+            }
+        }
+        else
+        {
+            reportError(fmt::format("Unknown track property {}", *tokenValue));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
 VertexDescription
 AsciiModelLoader::loadVertexDescription()
 {
@@ -574,9 +710,20 @@ AsciiModelLoader::loadVertices(const VertexDescription& vertexDesc,
         assert(offset < vertexDataSize);
         for (const auto& attr : vertexDesc.attributes)
         {
-            bool status = attr.format == VertexAttributeFormat::UByte4
-                ? loadUByte4Attribute(attr, vertexData.data() + offset)
-                : loadFloatAttribute(attr, vertexData.data() + offset);
+            bool status;
+            switch (attr.format)
+            {
+            case VertexAttributeFormat::UByte4:
+                status = loadUByte4Attribute(attr, vertexData.data() + offset);
+                break;
+            case VertexAttributeFormat::Short4:
+            case VertexAttributeFormat::Octahedral:
+                status = loadShortAttribute(attr, vertexData.data() + offset);
+                break;
+            default:
+                status = loadFloatAttribute(attr, vertexData.data() + offset);
+                break;
+            }
 
             if (!status)
             {
@@ -614,11 +761,36 @@ AsciiModelLoader::loadUByte4Attribute(const VertexAttribute& attr,
 }
 
 
+bool
+AsciiModelLoader::loadShortAttribute(const VertexAttribute& attr,
+                                     cmod::VWord* destination)
+{
+    std::array<std::int16_t, 4> values;
+    std::size_t readCount = attr.format == VertexAttributeFormat::Short4 ? 4 : 2;
+    for (std::size_t i = 0; i < readCount; ++i)
+    {
+        tok.nextToken();
+        if (auto tokenValue = tok.getIntegerValue();
+            tokenValue.has_value() && *tokenValue >= -32768 && *tokenValue <= 32767)
+        {
+            values[i] = static_cast<std::int16_t>(*tokenValue);
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    std::memcpy(destination + attr.offsetWords, values.data(), sizeof(std::int16_t) * readCount);
+    return true;
+}
+
+
 bool
 AsciiModelLoader::loadFloatAttribute(const VertexAttribute& attr,
                                      cmod::VWord* destination)
 {
-    std::array<float, 4> values;
+    Eigen::Vector4f values = Eigen::Vector4f::Zero();
     std::size_t readCount;
     switch (attr.format)
     {
@@ -626,6 +798,7 @@ AsciiModelLoader::loadFloatAttribute(const VertexAttribute& attr,
         readCount = 1;
         break;
     case VertexAttributeFormat::Float2:
+    case VertexAttributeFormat::Half2:
         readCount = 2;
         break;
     case VertexAttributeFormat::Float3:
@@ -651,7 +824,7 @@ AsciiModelLoader::loadFloatAttribute(const VertexAttribute& attr,
         }
     }
 
-    std::memcpy(destination + attr.offsetWords, values.data(), sizeof(float) * readCount);
+    EncodeVertexAttribute(values, attr.format, destination + attr.offsetWords);
     return true;
 }
 
@@ -680,6 +853,41 @@ AsciiModelLoader::loadMesh(Mesh& mesh)
     mesh.setVertexDescription(std::move(vertexDesc));
     mesh.setVertices(vertexCount, std::move(vertexData));
 
+    tok.nextToken();
+    if (tok.getNameValue() == QuantizationToken)
+    {
+        float quantization[4];
+        if (!loadNumbers(quantization, 4) || quantization[0] <= 0.0f)
+        {
+            reportError("Bad quantization in mesh");
+            return false;
+        }
+        mesh.setPositionQuantization(Eigen::Map<Eigen::Vector3f>(quantization + 1), quantization[0]);
+    }
+    else
+    {
+        tok.pushBack();
+    }
+
+    tok.nextToken();
+    if (tok.getNameValue() == TrackToken)
+    {
+        tok.nextToken();
+        if (auto tokenValue = tok.getIntegerValue(); tokenValue.has_value() && *tokenValue >= 0)
+        {
+            mesh.setTrackIndex(static_cast<unsigned int>(*tokenValue));
+        }
+        else
+        {
+            reportError("Bad track index in mesh");
+            return false;
+        }
+    }
+    else
+    {
+        tok.pushBack();
+    }
+
     for (;;)
     {
         tok.nextToken();
@@ -790,6 +998,22 @@ AsciiModelLoader::load()
 
                 model->addMaterial(std::move(material));
             }
+            else if (*tokenValue == TrackToken)
+            {
+                if (seenMeshes)
+                {
+                    reportError("Tracks must be defined before meshes");
+                    return nullptr;
+                }
+
+                TransformTrack track;
+                if (!loadTrack(track))
+                {
+                    return nullptr;
+                }
+
+                model->addTrack(std::move(track));
+            }
             else if (*tokenValue == "mesh")
             {
                 seenMeshes = true;
@@ -800,6 +1024,12 @@ AsciiModelLoader::load()
                     return nullptr;
                 }
 
+                if (mesh.getTrackIndex() != ~0u && mesh.getTrackIndex() >= model->getTrackCount())
+                {
+                    reportError("Track index out of range");
+                    return nullptr;
+                }
+
                 model->addMesh(std::move(mesh));
             }
             else
@@ -835,6 +1065,7 @@ public:
 private:
     bool writeMesh(const Mesh& /*mesh*/);
     bool writeMaterial(const Material& /*material*/);
+    bool writeTrack(const TransformTrack& /*track*/);
     bool writeGroup(const PrimitiveGroup& /*group*/);
     bool writeVertexDescription(const VertexDescription& /*desc*/);
     bool writeVertices(const VWord* vertexData,
@@ -861,6 +1092,13 @@ AsciiModelWriter::write(const Model& model)
         if (!out->good()) { return false; }
     }
 
+    for (unsigned int trackIndex = 0; model.getTrack(trackIndex) != nullptr; trackIndex++)
+    {
+        if (!writeTrack(*model.getTrack(trackIndex))) { return false; }
+        fmt::print(*out, "\n");
+        if (!out->good()) { return false; }
+    }
+
     for (unsigned int meshIndex = 0; model.getMesh(meshIndex) != nullptr; meshIndex++)
     {
         if (!writeMesh(*model.getMesh(meshIndex))) { return false; }
@@ -872,6 +1110,33 @@ AsciiModelWriter::write(const Model& model)
 }
 
 
+bool
+AsciiModelWriter::writeTrack(const TransformTrack& track)
+{
+    fmt::print(*out, "track\n");
+    if (!out->good()) { return false; }
+
+    const Eigen::Vector3f& pivot = track.getPivot();
+    if (pivot != Eigen::Vector3f::Zero())
+    {
+        fmt::print(*out, "pivot {} {} {}\n", pivot.x(), pivot.y(), pivot.z());
+        if (!out->good()) { return false; }
+    }
+
+    for (const auto& key : track.getKeys())
+    {
+        fmt::print(*out, "key {}  {} {} {} {}  {} {} {}\n",
+                   key.time,
+                   key.rotation.w(), key.rotation.x(), key.rotation.y(), key.rotation.z(),
+                   key.translation.x(), key.translation.y(), key.translation.z());
+        if (!out->good()) { return false; }
+    }
+
+    fmt::print(*out, "end_track\n");
+    return out->good();
+}
+
+
 bool
 AsciiModelWriter::writeGroup(const PrimitiveGroup& group)
 {
@@ -946,6 +1211,20 @@ AsciiModelWriter::writeMesh(const Mesh& mesh)
     fmt::print(*out, "\n");
     if (!out->good()) { return false; }
 
+    if (mesh.hasQuantizedPositions())
+    {
+        const Eigen::Vector3f& offset = mesh.getPositionOffset();
+        fmt::print(*out, "quantization {} {} {} {}\n\n",
+                   mesh.getPositionScale(), offset.x(), offset.y(), offset.z());
+        if (!out->good()) { return false; }
+    }
+
+    if (mesh.getTrackIndex() != ~0u)
+    {
+        fmt::print(*out, "track {}\n\n", mesh.getTrackIndex());
+        if (!out->good()) { return false; }
+    }
+
     for (unsigned int groupIndex = 0; mesh.getGroup(groupIndex) != nullptr; groupIndex++)
     {
         if (!writeGroup(*mesh.getGroup(groupIndex))) { return false; }
@@ -1020,6 +1299,26 @@ AsciiModelWriter::writeVertex(const cmod::VWord* vertexData,
         case VertexAttributeFormat::UByte4:
             fmt::print(*out, "{} {} {} {}", +data[0], +data[1], +data[2], +data[3]);
             break;
+        case VertexAttributeFormat::Short4:
+            {
+                std::array<std::int16_t, 4> sdata;
+                std::memcpy(sdata.data(), data, sizeof(sdata));
+                fmt::print(*out, "{} {} {} {}", sdata[0], sdata[1], sdata[2], sdata[3]);
+            }
+            break;
+        case VertexAttributeFormat::Octahedral:
+            {
+                std::array<std::int16_t, 2> sdata;
+                std::memcpy(sdata.data(), data, sizeof(sdata));
+                fmt::print(*out, "{} {}", sdata[0], sdata[1]);
+            }
+            break;
+        case VertexAttributeFormat::Half2:
+            {
+                Eigen::Vector4f v = DecodeVertexAttribute(data, attr.format);
+                fmt::print(*out, "{} {}", v.x(), v.y());
+            }
+            break;
         default:
             assert(0);
             break;
@@ -1097,6 +1396,15 @@ AsciiModelWriter::writeVertexDescription(const VertexDescription& desc)
         case VertexAttributeFormat::UByte4:
             fmt::print(*out, "ub4\n");
             break;
+        case VertexAttributeFormat::Short4:
+            fmt::print(*out, "s4\n");
+            break;
+        case VertexAttributeFormat::Half2:
+            fmt::print(*out, "h2\n");
+            break;
+        case VertexAttributeFormat::Octahedral:
+            fmt::print(*out, "oct\n");
+            break;
         default:
             return false;
             break;
@@ -1244,6 +1552,21 @@ bool readTypeFloat1(std::istream& in, float& f)
 }
 
 
+// Read a Float2, Float3 or Float4 value
+bool readTypeFloats(std::istream& in, CmodType expected, float* f)
+{
+    CmodType cmodType;
+    if (!readType(in, cmodType) || cmodType != expected) { return false; }
+
+    for (int i = 0; i < static_cast<int>(expected); i++)
+    {
+        if (!celutil::readLE<float>(in, f[i])) { return false; }
+    }
+
+    return true;
+}
+
+
 bool readTypeColor(std::istream& in, Color& c)
 {
     CmodType cmodType;
@@ -1346,6 +1669,7 @@ protected:
 
 private:
     bool loadMaterial(Material& material);
+    bool loadTrack(TransformTrack& track);
     VertexDescription loadVertexDescription();
     bool loadMesh(Mesh& mesh);
     std::vector<VWord> loadVertices(const VertexDescription& vertexDesc,
@@ -1398,6 +1722,22 @@ BinaryModelLoader::load()
 
             model->addMaterial(std::move(material));
         }
+        else if (tok == CmodToken::Track)
+        {
+            if (seenMeshes)
+            {
+                reportError("Tracks must be defined before meshes");
+                return nullptr;
+            }
+
+            TransformTrack track;
+            if (!loadTrack(track))
+            {
+                return nullptr;
+            }
+
+            model->addTrack(std::move(track));
+        }
         else if (tok == CmodToken::Mesh)
         {
             seenMeshes = true;
@@ -1408,6 +1748,12 @@ BinaryModelLoader::load()
                 return nullptr;
             }
 
+            if (mesh.getTrackIndex() != ~0u && mesh.getTrackIndex() >= model->getTrackCount())
+            {
+                reportError("Track index out of range");
+                return nullptr;
+            }
+
             model->addMesh(std::move(mesh));
         }
         else
@@ -1536,6 +1882,66 @@ BinaryModelLoader::loadMaterial(Material& material)
 }
 
 
+bool
+BinaryModelLoader::loadTrack(TransformTrack& track)
+{
+    for (;;)
+    {
+        CmodToken tok;
+        if (!readToken(*in, tok))
+        {
+            reportError("Error reading token type");
+            return false;
+        }
+
+        switch (tok)
+        {
+        case CmodToken::Pivot:
+            {
+                float pivot[3];
+                if (!readTypeFloats(*in, CmodType::Float3, pivot))
+                {
+                    reportError("Float3 expected for track pivot");
+                    return false;
+                }
+                track.setPivot(Eigen::Map<Eigen::Vector3f>(pivot));
+            }
+            break;
+
+        case CmodToken::Key:
+            {
+                TransformTrack::Key key;
+                float rotation[4];
+                float translation[3];
+                if (!readTypeFloat1(*in, key.time)
+                    || !readTypeFloats(*in, CmodType::Float4, rotation)
+                    || !readTypeFloats(*in, CmodType::Float3, translation))
+                {
+                    reportError("Bad key in track");
+                    return false;
+                }
+
+                key.rotation = Eigen::Quaternionf(rotation[0], rotation[1], rotation[2], rotation[3]);
+                key.translation = Eigen::Map<Eigen::Vector3f>(translation);
+                if (!track.addKey(key))
+                {
+                    reportError("Track key times must increase");
+                    return false;
+                }
+            }
+            break;
+
+        case CmodToken::EndTrack:
+            return true;
+
+        default:
+            reportError("Unknown token in track");
+            return false;
+        }
+    }
+}
+
+
 VertexDescription
 BinaryModelLoader::loadVertexDescription()
 {
@@ -1630,6 +2036,30 @@ BinaryModelLoader::loadMesh(Mesh& mesh)
         {
             break;
         }
+        if (tok == static_cast<std::int16_t>(CmodToken::MeshQuantization))
+        {
+            float scale;
+            float offset[3];
+            if (!readTypeFloat1(*in, scale) || scale <= 0.0f ||
+                !readTypeFloats(*in, CmodType::Float3, offset))
+            {
+                reportError("Bad quantization in mesh");
+                return false;
+            }
+            mesh.setPositionQuantization(Eigen::Map<Eigen::Vector3f>(offset), scale);
+            continue;
+        }
+        if (tok == static_cast<std::int16_t>(CmodToken::MeshTrack))
+        {
+            std::uint32_t trackIndex;
+            if (!celutil::readLE<std::uint32_t>(*in, trackIndex) || trackIndex == ~0u)
+            {
+                reportError("Bad track index in mesh");
+                return false;
+            }
+            mesh.setTrackIndex(trackIndex);
+            continue;
+        }
         if (tok < 0 || tok >= static_cast<std::int16_t>(PrimitiveGroupType::PrimitiveTypeMax))
         {
             reportError("Bad primitive group type");
@@ -1645,19 +2075,29 @@ BinaryModelLoader::loadMesh(Mesh& mesh)
             return false;
         }
 
-        std::vector<Index32> indices;
-        indices.reserve(indexCount);
-
-        for (unsigned int i = 0; i < indexCount; i++)
+        std::vector<Index32> indices(indexCount);
+#ifdef WORDS_BIGENDIAN
+        for (auto& index : indices)
         {
-            std::uint32_t index;
-            if (!celutil::readLE<std::uint32_t>(*in, index) || index >= vertexCount)
+            if (!celutil::readLE<std::uint32_t>(*in, index))
             {
-                reportError("Index out of range");
+                reportError("Could not read primitive indices");
                 return false;
             }
+        }
+#else
+        if (indexCount > 0 &&
+            !in->read(reinterpret_cast<char*>(indices.data()), indices.size() * sizeof(Index32)).good()) //NOSONAR
+        {
+            reportError("Could not read primitive indices");
+            return false;
+        }
+#endif
 
-            indices.push_back(index);
+        if (std::any_of(indices.begin(), indices.end(), [vertexCount](Index32 index) { return index >= vertexCount; }))
+        {
+            reportError("Index out of range");
+            return false;
         }
 
         mesh.addGroup(type, materialIndex, std::move(indices));
@@ -1687,6 +2127,15 @@ BinaryModelLoader::loadVertices(const VertexDescription& vertexDesc,
     unsigned int vertexDataSize = stride * vertexCount;
     std::vector<VWord> vertexData(vertexDataSize);
 
+#ifndef WORDS_BIGENDIAN
+    // The attributes are stored in the order and little-endian formats of
+    // the vertex description, so the data can be read as one block.
+    if (!in->read(reinterpret_cast<char*>(vertexData.data()), vertexData.size() * sizeof(VWord)).good()) //NOSONAR
+    {
+        reportError("Failed to load vertex attribute");
+        return {};
+    }
+#else
     unsigned int offset = 0;
     for (unsigned int i = 0; i < vertexCount; i++, offset += stride)
     {
@@ -1700,6 +2149,7 @@ BinaryModelLoader::loadVertices(const VertexDescription& vertexDesc,
             }
         }
     }
+#endif
 
     return vertexData;
 }
@@ -1715,6 +2165,22 @@ BinaryModelLoader::loadAttribute(const VertexAttribute& attr,
         return celutil::readNative<std::uint32_t>(*in, *destination);
     }
 
+    if (attr.format == VertexAttributeFormat::Short4 ||
+        attr.format == VertexAttributeFormat::Half2 ||
+        attr.format == VertexAttributeFormat::Octahedral)
+    {
+        // Little-endian 16-bit components
+        std::array<std::uint16_t, 4> s;
+        std::size_t count = VertexAttribute::getFormatSizeWords(attr.format) * 2;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (!celutil::readLE<std::uint16_t>(*in, s[i])) { return false; }
+        }
+
+        std::memcpy(destination, s.data(), sizeof(std::uint16_t) * count);
+        return true;
+    }
+
     std::array<float, 4> f;
     std::size_t readCount;
     switch (attr.format)
@@ -1765,6 +2231,19 @@ bool writeTypeFloat1(std::ostream& out, float f)
 }
 
 
+bool writeTypeFloats(std::ostream& out, CmodType type, const float* f)
+{
+    if (!writeType(out, type)) { return false; }
+
+    for (int i = 0; i < static_cast<int>(type); i++)
+    {
+        if (!celutil::writeLE<float>(out, f[i])) { return false; }
+    }
+
+    return true;
+}
+
+
 bool writeTypeColor(std::ostream& out, const Color& c)
 {
     return writeType(out, CmodType::Color)
@@ -1797,6 +2276,7 @@ public:
 private:
     bool writeMesh(const Mesh& /*mesh*/);
     bool writeMaterial(const Material& /*material*/);
+    bool writeTrack(const TransformTrack& /*track*/);
     bool writeGroup(const PrimitiveGroup& /*group*/);
     bool writeVertexDescription(const VertexDescription& /*desc*/);
     bool writeVertices(const VWord* vertexData,
@@ -1819,6 +2299,11 @@ BinaryModelWriter::write(const Model& model)
         if (!writeMaterial(*model.getMaterial(matIndex))) { return false; }
     }
 
+    for (unsigned int trackIndex = 0; model.getTrack(trackIndex) != nullptr; trackIndex++)
+    {
+        if (!writeTrack(*model.getTrack(trackIndex))) { return false; }
+    }
+
     for (unsigned int meshIndex = 0; model.getMesh(meshIndex) != nullptr; meshIndex++)
     {
         if (!writeMesh(*model.getMesh(meshIndex))) { return false; }
@@ -1828,6 +2313,34 @@ BinaryModelWriter::write(const Model& model)
 }
 
 
+bool
+BinaryModelWriter::writeTrack(const TransformTrack& track)
+{
+    if (!writeToken(*out, CmodToken::Track)) { return false; }
+
+    if (track.getPivot() != Eigen::Vector3f::Zero()
+        && (!writeToken(*out, CmodToken::Pivot)
+            || !writeTypeFloats(*out, CmodType::Float3, track.getPivot().data())))
+    {
+        return false;
+    }
+
+    for (const auto& key : track.getKeys())
+    {
+        const float rotation[4] = { key.rotation.w(), key.rotation.x(), key.rotation.y(), key.rotation.z() };
+        if (!writeToken(*out, CmodToken::Key)
+            || !writeTypeFloat1(*out, key.time)
+            || !writeTypeFloats(*out, CmodType::Float4, rotation)
+            || !writeTypeFloats(*out, CmodType::Float3, key.translation.data()))
+        {
+            return false;
+        }
+    }
+
+    return writeToken(*out, CmodToken::EndTrack);
+}
+
+
 bool
 BinaryModelWriter::writeGroup(const PrimitiveGroup& group)
 {
@@ -1860,6 +2373,21 @@ BinaryModelWriter::writeMesh(const Mesh& mesh)
         return false;
     }
 
+    if (mesh.hasQuantizedPositions()
+        && (!writeToken(*out, CmodToken::MeshQuantization)
+            || !writeTypeFloat1(*out, mesh.getPositionScale())
+            || !writeTypeFloats(*out, CmodType::Float3, mesh.getPositionOffset().data())))
+    {
+        return false;
+    }
+
+    if (mesh.getTrackIndex() != ~0u
+        && (!writeToken(*out, CmodToken::MeshTrack)
+            || !celutil::writeLE<std::uint32_t>(*out, mesh.getTrackIndex())))
+    {
+        return false;
+    }
+
     for (unsigned int groupIndex = 0; mesh.getGroup(groupIndex) != nullptr; groupIndex++)
     {
         if (!writeGroup(*mesh.getGroup(groupIndex))) { return false; }
@@ -1915,6 +2443,18 @@ BinaryModelWriter::writeVertices(const VWord* vertexData,
             case VertexAttributeFormat::UByte4:
                 result = celutil::writeNative<std::uint32_t>(*out, *cdata);
                 break;
+            case VertexAttributeFormat::Short4:
+            case VertexAttributeFormat::Half2:
+            case VertexAttributeFormat::Octahedral:
+                {
+                    std::array<std::uint16_t, 4> sdata;
+                    std::size_t count = VertexAttribute::getFormatSizeWords(attr.format) * 2;
+                    std::memcpy(sdata.data(), cdata, sizeof(std::uint16_t) * count);
+                    result = true;
+                    for (std::size_t j = 0; j < count && result; ++j)
+                        result = celutil::writeLE<std::uint16_t>(*out, sdata[j]);
+                }
+                break;
             default:
                 assert(0);
                 result = false;
@@ -2008,6 +2548,20 @@ BinaryModelWriter::writeMaterial(const Material& material)
 }
 
 
+// Read-only stream buffer over a memory mapped file, so that reading from
+// it is copying from the mapping
+class MappedFileBuffer : public std::streambuf
+{
+public:
+    explicit MappedFileBuffer(const celutil::MappedFile& file)
+    {
+        // The get area is never written to
+        char* data = const_cast<char*>(file.data()); //NOSONAR
+        setg(data, data, data + file.size());
+    }
+};
+
+
 std::unique_ptr<ModelLoader>
 openModel(std::istream& in, HandleGetter&& getHandle)
 {
@@ -2055,6 +2609,23 @@ LoadModel(std::istream& in, HandleGetter handleGetter)
 }
 
 
+std::unique_ptr<Model>
+LoadModel(const fs::path& filename, HandleGetter handleGetter)
+{
+    if (auto file = celutil::MappedFile::open(filename); file != nullptr)
+    {
+        MappedFileBuffer buffer(*file);
+        std::istream in(&buffer);
+        return LoadModel(in, std::move(handleGetter));
+    }
+
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in.good())
+        return nullptr;
+    return LoadModel(in, std::move(handleGetter));
+}
+
+
 bool
 SaveModelAscii(const Model* model, std::ostream& out, SourceGetter sourceGetter)
 {
@@ -26,6 +26,10 @@ using SourceGetter = std::function<fs::path(ResourceHandle)>;
 
 std::unique_ptr<Model> LoadModel(std::istream& in, HandleGetter getHandle);
 
+// Load a model file through a memory mapping, falling back to reading it
+// when the file can't be mapped
+std::unique_ptr<Model> LoadModel(const fs::path& filename, HandleGetter getHandle);
+
 bool SaveModelAscii(const Model* model, std::ostream& out, SourceGetter getSource);
 bool SaveModelBinary(const Model* model, std::ostream& out, SourceGetter getSource);
 }
@@ -0,0 +1,86 @@
+// transformtrack.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include "transformtrack.h"
+
+namespace cmod
+{
+
+bool
+TransformTrack::addKey(const Key& key)
+{
+    if (!std::isfinite(key.time) || (!keys.empty() && key.time <= keys.back().time))
+        return false;
+
+    Key k = key;
+    k.rotation.normalize();
+    keys.push_back(k);
+    return true;
+}
+
+
+Eigen::Affine3f
+TransformTrack::evaluate(double t) const
+{
+    if (keys.empty())
+        return Eigen::Affine3f::Identity();
+
+    // Loop over the animation; the track is clamped to the first key
+    // before it starts.
+    double period = keys.back().time;
+    if (period > 0.0)
+    {
+        t = std::fmod(t, period);
+        if (t < 0.0)
+            t += period;
+    }
+
+    auto time = static_cast<float>(t);
+    auto next = std::upper_bound(keys.begin(), keys.end(), time,
+                                 [](float time, const Key& key) { return time < key.time; });
+
+    Eigen::Quaternionf rotation;
+    Eigen::Vector3f translation;
+    if (next == keys.begin())
+    {
+        rotation = next->rotation;
+        translation = next->translation;
+    }
+    else if (next == keys.end())
+    {
+        rotation = keys.back().rotation;
+        translation = keys.back().translation;
+    }
+    else
+    {
+        const Key& prev = *std::prev(next);
+        float s = (time - prev.time) / (next->time - prev.time);
+        rotation = prev.rotation.slerp(s, next->rotation);
+        translation = prev.translation + (next->translation - prev.translation) * s;
+    }
+
+    return Eigen::Translation3f(pivot + translation) * rotation * Eigen::Translation3f(-pivot);
+}
+
+
+void
+TransformTrack::transform(const Eigen::Vector3f& translation, float scale)
+{
+    // Vertices are mapped by v' = (v + translation) * scale, so the pivot
+    // moves with them and the offsets are only scaled.
+    pivot = (pivot + translation) * scale;
+    for (auto& key : keys)
+        key.translation *= scale;
+}
+
+} // end namespace cmod
@@ -0,0 +1,63 @@
+// transformtrack.h
+//
+// Copyright (C) 2023-present, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+
+namespace cmod
+{
+
+/*! A TransformTrack animates the rigid transform of the meshes that
+ *  refer to it. The track is a list of keys with increasing times in
+ *  seconds; the rotation of a key is about the pivot point of the track,
+ *  and its translation is applied after the rotation. Tracks loop with
+ *  a period equal to the time of their last key.
+ */
+class TransformTrack
+{
+ public:
+    struct Key
+    {
+        float time{ 0.0f };
+        Eigen::Quaternionf rotation{ Eigen::Quaternionf::Identity() };
+        Eigen::Vector3f translation{ Eigen::Vector3f::Zero() };
+    };
+
+    TransformTrack() = default;
+
+    const Eigen::Vector3f& getPivot() const { return pivot; }
+    void setPivot(const Eigen::Vector3f& p) { pivot = p; }
+
+    /*! Append a key to the track; returns false if the time of the key
+     *  is not later than that of the last key.
+     */
+    bool addKey(const Key& key);
+    const std::vector<Key>& getKeys() const { return keys; }
+
+    /*! Return the transform of the track at time t in seconds. Rotations
+     *  are interpolated spherically and translations linearly.
+     */
+    Eigen::Affine3f evaluate(double t) const;
+
+    /*! Adjust the track to a model translated and scaled with
+     *  Model::transform().
+     */
+    void transform(const Eigen::Vector3f& translation, float scale);
+
+ private:
+    Eigen::Vector3f pivot{ Eigen::Vector3f::Zero() };
+    std::vector<Key> keys;
+};
+
+} // namespace cmod
@@ -19,7 +19,7 @@ namespace celestia::render
 {
 
 AsterismRenderer::AsterismRenderer(const Renderer &renderer, const AsterismList *asterisms) :
-    m_lineRenderer(LineRenderer(renderer, 1.0f, LineRenderer::PrimType::Lines, LineRenderer::StorageType::Static)),
+    m_renderer(renderer),
     m_asterisms(asterisms)
 {
 }
@@ -33,41 +33,50 @@ bool AsterismRenderer::sameAsterisms(const AsterismList *asterisms) const
  */
 void AsterismRenderer::render(const Color &defaultColor, const Matrices &mvp)
 {
-    if (!m_initialized)
-    {
-        if (!prepare()) return;
-        m_initialized = true;
-    }
+    if (stateChanged(defaultColor))
+        prepare(defaultColor);
 
-    m_lineRenderer.render(mvp, defaultColor, m_totalLineCount * 2);
+    if (m_totalLineCount == 0)
+        return;
 
-    assert(m_asterisms->size() == m_lineCount.size());
+    m_lineRenderer->render(mvp, m_totalLineCount * 2);
+    m_lineRenderer->finish();
+}
+
+bool AsterismRenderer::stateChanged(const Color &defaultColor) const
+{
+    if (!m_lineRenderer.has_value() || defaultColor != m_defaultColor)
+        return true;
 
-    int offset = 0;
-    float opacity = defaultColor.alpha();
+    assert(m_asterisms->size() == m_state.size());
     for (std::size_t size = m_asterisms->size(), i = 0; i < size; i++)
     {
         const auto& ast = (*m_asterisms)[i];
-        if (!ast.getActive() || !ast.isColorOverridden())
-        {
-            offset += m_lineCount[i];
-            continue;
-        }
-
-        Color color = {ast.getOverrideColor(), opacity};
-        m_lineRenderer.render(mvp, color, m_lineCount[i] * 2, offset * 2);
-        offset += m_lineCount[i];
+        AsterismState state = { ast.getActive(), ast.isColorOverridden(), ast.getOverrideColor() };
+        if (!(state == m_state[i]))
+            return true;
     }
-    m_lineRenderer.finish();
+
+    return false;
 }
 
-bool AsterismRenderer::prepare()
+void AsterismRenderer::prepare(const Color &defaultColor)
 {
+    // Static buffers can't be updated, so the line renderer is replaced
+    m_lineRenderer.emplace(m_renderer, 1.0f, LineRenderer::PrimType::Lines,
+                           LineRenderer::StorageType::Static, LineRenderer::VertexFormat::P3F_C4UB);
+    m_defaultColor = defaultColor;
+    m_state.clear();
+    m_state.reserve(m_asterisms->size());
+
     // calculate required vertices number
     GLsizei vtx_num = 0;
     for (const auto& ast : *m_asterisms)
     {
-        GLsizei ast_vtx_num = 0;
+        m_state.push_back({ ast.getActive(), ast.isColorOverridden(), ast.getOverrideColor() });
+        if (!ast.getActive())
+            continue;
+
         for (int k = 0; k < ast.getChainCount(); k++)
         {
             // as we use GL_LINES we should double the number of vertices.
@@ -75,29 +84,33 @@ bool AsterismRenderer::prepare()
             // the 1st and last vertexes
             auto s = static_cast<GLsizei>(ast.getChain(k).size());
             if (s > 1)
-                ast_vtx_num += s - 1;
+                vtx_num += s - 1;
         }
-
-        m_lineCount.push_back(ast_vtx_num);
-        vtx_num += ast_vtx_num;
     }
 
-    if (vtx_num == 0)
-        return false;
-
     m_totalLineCount = vtx_num;
+    if (vtx_num == 0)
+        return;
 
+    m_lineRenderer->setVertexCount(vtx_num * 2);
     for (const auto& ast : *m_asterisms)
     {
+        if (!ast.getActive())
+            continue;
+
+        Color color = ast.isColorOverridden()
+            ? Color(ast.getOverrideColor(), defaultColor.alpha())
+            : defaultColor;
         for (int k = 0; k < ast.getChainCount(); k++)
         {
             const auto& chain = ast.getChain(k);
             for (unsigned i = 1; i < chain.size(); i++)
-                m_lineRenderer.addSegment(chain[i - 1], chain[i]);
+            {
+                m_lineRenderer->addVertex(chain[i - 1], color);
+                m_lineRenderer->addVertex(chain[i], color);
+            }
         }
     }
-
-    return true;
 }
 
 } // end namespace celestia::render
@@ -9,12 +9,13 @@
 
 #pragma once
 
+#include <optional>
 #include <vector>
 
 #include <celengine/asterism.h>
 #include <celrender/linerenderer.h>
+#include <celutil/color.h>
 
-class Color;
 class Renderer;
 struct Matrices;
 
@@ -36,13 +37,33 @@ public:
     bool sameAsterisms(const AsterismList *asterisms) const;
 
 private:
-    bool prepare();
+    // What an asterism's lines are drawn with: no lines if inactive,
+    // otherwise the override color or the default one
+    struct AsterismState
+    {
+        bool  active;
+        bool  overridden;
+        Color color;
 
-    LineRenderer        m_lineRenderer;
-    std::vector<int>    m_lineCount;
-    const AsterismList *m_asterisms       { nullptr };
-    int                 m_totalLineCount  { 0 };
-    bool                m_initialized     { false };
+        bool operator==(const AsterismState &other) const
+        {
+            return active == other.active &&
+                   overridden == other.overridden &&
+                   color == other.color;
+        }
+    };
+
+    bool stateChanged(const Color &defaultColor) const;
+    void prepare(const Color &defaultColor);
+
+    const Renderer                &m_renderer;
+    // The lines of the active asterisms with their colors, rebuilt when an
+    // asterism is shown, hidden or recolored, or the default color fades
+    std::optional<LineRenderer>    m_lineRenderer;
+    std::vector<AsterismState>     m_state;
+    Color                          m_defaultColor;
+    const AsterismList            *m_asterisms       { nullptr };
+    int                            m_totalLineCount  { 0 };
 };
 
 } // end namespace celestia::render
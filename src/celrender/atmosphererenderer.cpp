@@ -12,7 +12,7 @@
 
 #include <algorithm>
 #include <cmath>
-#include <cstring>
+#include <vector>
 
 #include <celcompat/numbers.h>
 #include <celengine/atmosphere.h>
@@ -36,12 +36,30 @@ namespace celestia::render
 {
 namespace
 {
-constexpr int MaxSkyRings = 32;
-constexpr int MaxSkySlices = 180;
-constexpr int MinSkySlices = 30;
-
-constexpr int MaxVertices = MaxSkySlices * (MaxSkyRings + 1);
-constexpr int MaxIndices = IndexListCapacity(MaxSkySlices,  MaxSkyRings + 1);
+// The sky is drawn as rings around the limb of the planet: up to six from
+// the horizon outwards, and twelve more up to the zenith from within the
+// atmosphere.
+constexpr int MaxHorizonRings = 6;
+constexpr int MaxSkyRings = MaxHorizonRings + 12;
+constexpr int SkySlices = 180;
+
+constexpr int SkyVertexCount = SkySlices * (MaxSkyRings + 1);
+constexpr int SkyIndexCount = IndexListCapacity(SkySlices, MaxSkyRings + 1);
+
+// The limb of the ellipsoid seen in a direction from the eye
+Eigen::Vector3f
+limbPoint(const Eigen::Vector3f &uAxis,
+          const Eigen::Vector3f &vAxis,
+          float                  theta,
+          const Eigen::Matrix3f &irot,
+          const Eigen::Vector3f &recipSemiAxes,
+          const Eigen::Vector3f &e,
+          const Eigen::Vector3f &e_,
+          float                  ee)
+{
+    Eigen::Vector3f w = std::cos(theta) * uAxis + std::sin(theta) * vAxis;
+    return irot * celmath::ellipsoidTangent(recipSemiAxes, w, e, e_, ee);
+}
 } // end unnamed namespace
 
 AtmosphereRenderer::AtmosphereRenderer(Renderer &renderer) :
@@ -56,15 +74,11 @@ void AtmosphereRenderer::initGL()
 
     m_initialized = true;
 
-    m_skyVertices.reserve(MaxVertices);
-    m_skyIndices.reserve(MaxIndices);
-    m_skyContour.reserve(MaxSkySlices + 1);
-
     m_vo = std::make_unique<IndexedVertexObject>(
-        MaxVertices * sizeof(SkyVertex),
-        GL_STREAM_DRAW,
+        SkyVertexCount * sizeof(SkyVertex),
+        GL_STATIC_DRAW,
         GL_UNSIGNED_SHORT,
-        MaxIndices * sizeof(unsigned short));
+        SkyIndexCount * sizeof(unsigned short));
 }
 
 void AtmosphereRenderer::deinitGL()
@@ -73,8 +87,38 @@ void AtmosphereRenderer::deinitGL()
     m_vo = nullptr;
 }
 
+// The vertices only hold the angle around the limb and the ring index; the
+// sky shader places and colors them.
+void
+AtmosphereRenderer::initVertexObject()
+{
+    std::vector<SkyVertex> vertices;
+    vertices.reserve(SkyVertexCount);
+    for (int i = 0; i <= MaxSkyRings; i++)
+    {
+        for (int j = 0; j < SkySlices; j++)
+        {
+            float theta = static_cast<float>(j) / static_cast<float>(SkySlices) * 2.0f * numbers::pi_v<float>;
+            vertices.push_back({ theta, static_cast<float>(i) });
+        }
+    }
+
+    std::vector<unsigned short> indices;
+    BuildIndexList(static_cast<ushort>(MaxSkyRings), static_cast<ushort>(SkySlices), indices);
+
+    m_vo->bind();
+    m_vo->allocate(vertices.data(), indices.data());
+    m_vo->setVertexAttribArray(
+        CelestiaGLProgram::VertexCoordAttributeIndex,
+        2,
+        GL_FLOAT,
+        false,
+        sizeof(SkyVertex),
+        0);
+}
+
 void
-AtmosphereRenderer::computeLegacy(
+AtmosphereRenderer::renderLegacy(
     const Atmosphere         &atmosphere,
     const LightingState      &ls,
     const Eigen::Vector3f    &center,
@@ -82,8 +126,13 @@ AtmosphereRenderer::computeLegacy(
     const Eigen::Vector3f    &semiAxes,
     const Eigen::Vector3f    &sunDirection,
     float                     pixSize,
-    bool                      lit)
+    bool                      lit,
+    const Matrices           &m)
 {
+    auto *prog = m_renderer.getShaderManager().getShader("sky");
+    if (prog == nullptr)
+        return;
+
     // Gradually fade in the atmosphere if it's thickness on screen is just
     // over one pixel.
     float fade = std::clamp(pixSize - 2.0f, 0.0f, 1.0f);
@@ -91,11 +140,9 @@ AtmosphereRenderer::computeLegacy(
     Eigen::Matrix3f rot = orientation.toRotationMatrix();
     Eigen::Matrix3f irot = orientation.conjugate().toRotationMatrix();
 
-    Eigen::Vector3f eyePos(Eigen::Vector3f::Zero());
     float radius = semiAxes.maxCoeff();
-    Eigen::Vector3f eyeVec = center - eyePos;
-    eyeVec = rot * eyeVec;
-    double centerDist = eyeVec.norm();
+    Eigen::Vector3f eyeVec = rot * center;
+    float centerDist = eyeVec.norm();
 
     float height = atmosphere.height / radius;
     Eigen::Vector3f recipSemiAxes = semiAxes.cwiseInverse();
@@ -110,19 +157,10 @@ AtmosphereRenderer::computeLegacy(
     float ellipDist = (eyeVec.cwiseProduct(recipSemiAxes)).norm() - 1.0f;
     bool within = ellipDist < height;
 
-    // Adjust the tesselation of the sky dome/ring based on distance from the
-    // planet surface.
-    int nSlices = MaxSkySlices;
-    if (ellipDist < 0.25f)
-    {
-        nSlices = MinSkySlices + std::max(0, static_cast<int>((ellipDist * 4.0f)) * (MaxSkySlices - MinSkySlices));
-        nSlices &= ~1;
-    }
-
-    int nRings = std::min(1 + static_cast<int>(pixSize) / 5, 6);
+    int nRings = std::min(1 + static_cast<int>(pixSize) / 5, MaxHorizonRings);
     int nHorizonRings = nRings;
     if (within)
-        nRings += 12;
+        nRings += MaxSkyRings - MaxHorizonRings;
 
     float horizonHeight = height;
     if (within)
@@ -142,25 +180,16 @@ AtmosphereRenderer::computeLegacy(
     float cosSunAltitude = 0.0f;
     {
         // Check for a sun either directly behind or in front of the viewer
-        float cosSunAngle = sunDirection.dot(e) / static_cast<float>(centerDist);
-        if (cosSunAngle < -1.0f + 1.0e-6f)
-        {
-            cosSunAltitude = 0.0f;
-        }
-        else if (cosSunAngle > 1.0f - 1.0e-6f)
+        float cosSunAngle = sunDirection.dot(e) / centerDist;
+        if (cosSunAngle > -1.0f + 1.0e-6f && cosSunAngle < 1.0f - 1.0e-6f)
         {
-            cosSunAltitude = 0.0f;
-        }
-        else
-        {
-            Eigen::Vector3f v = (rot * -sunDirection) * static_cast<float>(centerDist);
+            Eigen::Vector3f v = (rot * -sunDirection) * centerDist;
             Eigen::Vector3f tangentPoint = center + irot * celmath::ellipsoidTangent(recipSemiAxes, v, e, e_, ee);
-            Eigen::Vector3f tangentDir = (tangentPoint - eyePos).normalized();
-            cosSunAltitude = sunDirection.dot(tangentDir);
+            cosSunAltitude = sunDirection.dot(tangentPoint.normalized());
         }
     }
 
-    Eigen::Vector3f normal = eyeVec / static_cast<float>(centerDist);
+    Eigen::Vector3f normal = eyeVec / centerDist;
 
     Eigen::Vector3f uAxis, vAxis;
     if (std::abs(normal.x()) < std::abs(normal.y()) && std::abs(normal.x()) < std::abs(normal.z()))
@@ -177,28 +206,8 @@ AtmosphereRenderer::computeLegacy(
     }
     uAxis.normalize();
     vAxis = uAxis.cross(normal);
-
-    // Compute the contour of the ellipsoid
-    for (int i = 0; i <= nSlices; i++)
-    {
-        SkyContourPoint p;
-        // We want rays with an origin at the eye point and tangent to the the
-        // ellipsoid.
-        float theta = static_cast<float>(i) / static_cast<float>(nSlices) * 2.0f * numbers::pi_v<float>;
-        Eigen::Vector3f w = std::cos(theta) * uAxis + std::sin(theta) * vAxis;
-        w *= static_cast<float>(centerDist);
-
-        Eigen::Vector3f toCenter = celmath::ellipsoidTangent(recipSemiAxes, w, e, e_, ee);
-        p.v = irot * toCenter;
-        p.centerDist = p.v.norm();
-        p.eyeDir = p.v + (center - eyePos);
-        p.eyeDist = p.eyeDir.norm();
-        p.eyeDir.normalize();
-
-        float skyCapDist = std::hypot(p.eyeDist, horizonHeight * radius);
-        p.cosSkyCapAltitude = p.eyeDist / skyCapDist;
-        m_skyContour.push_back(p);
-    }
+    uAxis *= centerDist;
+    vAxis *= centerDist;
 
     Eigen::Vector3f botColor = atmosphere.lowerColor.toVector3();
     Eigen::Vector3f topColor = atmosphere.upperColor.toVector3();
@@ -218,140 +227,49 @@ AtmosphereRenderer::computeLegacy(
         botColor = topColor = sunsetColor = Eigen::Vector3f::Zero();
     }
 
-    Eigen::Vector3f zenith = m_skyContour[0].v + m_skyContour[nSlices / 2].v;
-    zenith.normalize();
-    zenith *= m_skyContour[0].centerDist * (1.0f + horizonHeight * 2.0f);
+    // The rings above the horizon converge to the zenith, found from two
+    // opposite points of the limb
+    Eigen::Vector3f limb0 = limbPoint(uAxis, vAxis, 0.0f, irot, recipSemiAxes, e, e_, ee);
+    Eigen::Vector3f limb1 = limbPoint(uAxis, vAxis, numbers::pi_v<float>, irot, recipSemiAxes, e, e_, ee);
+    Eigen::Vector3f zenith = (limb0 + limb1).normalized() * limb0.norm() * (1.0f + horizonHeight * 2.0f);
 
     float minOpacity = within ? (1.0f - ellipDist / height) * 0.75f : 0.0f;
     float sunset = cosSunAltitude < 0.9f ? 0.0f : (cosSunAltitude - 0.9f) * 10.0f;
 
-    // Build the list of vertices
-    for (int i = 0; i <= nRings; i++)
-    {
-        SkyVertex vtx;
-        float h = std::min(1.0f, static_cast<float>(i) / static_cast<float>(nHorizonRings));
-        float hh = std::sqrt(h);
-        float u = i <= nHorizonRings ? 0.0f :
-            static_cast<float>(i - nHorizonRings) / static_cast<float>(nRings - nHorizonRings);
-        float r = celmath::lerp(h, 1.0f - (horizonHeight * 0.05f), 1.0f + horizonHeight);
-
-        for (int j = 0; j < nSlices; j++)
-        {
-            Eigen::Vector3f v;
-            if (i <= nHorizonRings)
-                v = m_skyContour[j].v * r;
-            else
-                v = celmath::mix(m_skyContour[j].v, zenith, u) * r;
-            Eigen::Vector3f p = center + v;
-
-            Eigen::Vector3f viewDir = p.normalized();
-            float cosSunAngle = viewDir.dot(sunDirection);
-            float cosAltitude = viewDir.dot(m_skyContour[j].eyeDir);
-            float brightness = 1.0f;
-            float coloration = 0.0f;
-            if (lit)
-            {
-                if (sunset > 0.0f && cosSunAngle > 0.7f && cosAltitude > 0.98f)
-                {
-                    coloration =  (1.0f / 0.30f) * (cosSunAngle - 0.70f);
-                    coloration *= 50.0f * (cosAltitude - 0.98f);
-                    coloration *= sunset;
-                }
-
-                cosSunAngle = m_skyContour[j].v.dot(sunDirection) / m_skyContour[j].centerDist;
-                if (cosSunAngle <= -0.2f)
-                    brightness = 0.0f;
-                else if (cosSunAngle >= 0.3f)
-                    brightness = 1.0f;
-                else
-                    brightness = (cosSunAngle + 0.2f) * 2.0f;
-            }
-
-            std::memcpy(&vtx.position[0], p.data(), vtx.position.size() * sizeof(vtx.position[0]));
-
-            float atten = 1.0f - hh;
-            Eigen::Vector3f color = celmath::mix(botColor, topColor, hh);
-            brightness *= minOpacity + (1.0f - minOpacity) * fade * atten;
-            if (coloration != 0.0f)
-                color = celmath::mix(color, sunsetColor, coloration);
-
-            Color(brightness * color.x(),
-                  brightness * color.y(),
-                  brightness * color.z(),
-                  fade * (minOpacity + (1.0f - minOpacity)) * atten).get(&vtx.color[0]);
-            m_skyVertices.push_back(vtx);
-        }
-    }
-    m_skyContour.clear();
-
-    // Create the index list
-    BuildIndexList(static_cast<ushort>(nRings), static_cast<ushort>(nSlices), m_skyIndices);
-}
-
-void
-AtmosphereRenderer::initVertexObject()
-{
-    m_vo->bind();
-    m_vo->setVertexAttribArray(
-        CelestiaGLProgram::VertexCoordAttributeIndex,
-        3,
-        GL_FLOAT,
-        false,
-        sizeof(SkyVertex),
-        offsetof(SkyVertex, position));
-    m_vo->setVertexAttribArray(
-        CelestiaGLProgram::ColorAttributeIndex,
-        4,
-        GL_UNSIGNED_BYTE,
-        true,
-        sizeof(SkyVertex),
-        offsetof(SkyVertex, color));
-}
-
-void
-AtmosphereRenderer::renderLegacy(
-    const Atmosphere         &atmosphere,
-    const LightingState      &ls,
-    const Eigen::Vector3f    &center,
-    const Eigen::Quaternionf &orientation,
-    const Eigen::Vector3f    &semiAxes,
-    const Eigen::Vector3f    &sunDirection,
-    float                     pixSize,
-    bool                      lit,
-    const Matrices           &m)
-{
-    computeLegacy(atmosphere, ls, center, orientation, semiAxes, sunDirection, pixSize, lit);
-
-    ShaderProperties shadprop;
-    shadprop.texUsage = ShaderProperties::VertexColors;
-    shadprop.lightModel = ShaderProperties::UnlitModel;
-    auto *prog = m_renderer.getShaderManager().getShader(shadprop);
-    if (prog == nullptr)
-        return;
-
     Renderer::PipelineState ps;
     ps.depthTest = true;
     ps.blending = true;
     ps.blendFunc = {GL_ONE, GL_ONE_MINUS_SRC_ALPHA};
     m_renderer.setPipelineState(ps);
 
+    prog->use();
+    prog->setMVPMatrices(*m.projection, *m.modelview);
+    prog->vec3Param("center") = center;
+    prog->mat3Param("invRotation") = irot;
+    prog->vec3Param("eyeVec") = eyeVec;
+    prog->vec3Param("recipSemiAxes") = recipSemiAxes;
+    prog->vec3Param("uAxis") = uAxis;
+    prog->vec3Param("vAxis") = vAxis;
+    prog->vec3Param("zenith") = zenith;
+    prog->floatParam("horizonHeight") = horizonHeight;
+    prog->floatParam("horizonRings") = static_cast<float>(nHorizonRings);
+    prog->floatParam("rings") = static_cast<float>(nRings);
+    prog->vec3Param("sunDirection") = sunDirection;
+    prog->vec3Param("botColor") = botColor;
+    prog->vec3Param("topColor") = topColor;
+    prog->vec3Param("sunsetColor") = sunsetColor;
+    prog->floatParam("sunset") = sunset;
+    prog->floatParam("minOpacity") = minOpacity;
+    prog->floatParam("fade") = fade;
+    prog->floatParam("lit") = lit ? 1.0f : 0.0f;
+
     if (m_vo->initialized())
-        m_vo->bindWritable();
+        m_vo->bind();
     else
         initVertexObject();
 
-    m_vo->allocate(nullptr, nullptr); // allocate or orphan GPU memory buffers
-
-    m_vo->setBufferData(m_skyVertices.data(), 0, m_skyVertices.size() * sizeof(SkyVertex));
-    m_vo->setIndexBufferData(m_skyIndices.data(), 0, m_skyIndices.size() * sizeof(unsigned short));
-
-    prog->use();
-    prog->setMVPMatrices(*m.projection, *m.modelview);
-    m_vo->draw(GL_TRIANGLE_STRIP, static_cast<int>(m_skyIndices.size()), 0);
+    m_vo->draw(GL_TRIANGLE_STRIP, IndexListCapacity(SkySlices, nRings + 1), 0);
     m_vo->unbind();
-
-    m_skyIndices.clear();
-    m_skyVertices.clear();
 }
 
 void
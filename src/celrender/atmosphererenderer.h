@@ -10,10 +10,7 @@
 
 #pragma once
 
-#include <array>
-#include <cstdint>
 #include <memory>
-#include <vector>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -67,37 +64,15 @@ public:
     void deinitGL();
 
 private:
-    void computeLegacy(
-        const Atmosphere         &atmosphere,
-        const LightingState      &ls,
-        const Eigen::Vector3f    &center,
-        const Eigen::Quaternionf &orientation,
-        const Eigen::Vector3f    &semiAxes,
-        const Eigen::Vector3f    &sunDirection,
-        float                     pixSize,
-        bool                      lit);
-
     void initVertexObject();
 
     struct SkyVertex
     {
-        std::array<float,        3> position;
-        std::array<std::uint8_t, 4> color;
-    };
-
-    struct SkyContourPoint
-    {
-        Eigen::Vector3f v;
-        Eigen::Vector3f eyeDir;
-        float centerDist;
-        float eyeDist;
-        float cosSkyCapAltitude;
+        float theta;
+        float ring;
     };
 
     Renderer                               &m_renderer;
-    std::vector<SkyVertex>                  m_skyVertices;
-    std::vector<unsigned short>             m_skyIndices;
-    std::vector<SkyContourPoint>            m_skyContour;
     std::unique_ptr<IndexedVertexObject>    m_vo;
 
     bool                                    m_initialized   { false };
@@ -29,35 +29,39 @@ bool BoundariesRenderer::sameBoundaries(const ConstellationBoundaries *boundarie
 
 void BoundariesRenderer::render(const Color &color, const Matrices &mvp)
 {
+    // The boundaries don't change, so their buffer is built only once, even
+    // if it turns out empty
     if (!m_initialized)
     {
-        if (!prepare()) return;
+        prepare();
         m_initialized = true;
     }
 
+    if (m_lineCount == 0)
+        return;
+
     m_lineRenderer.render(mvp, color, m_lineCount * 2);
     m_lineRenderer.finish();
 }
 
 
-bool BoundariesRenderer::prepare()
+void BoundariesRenderer::prepare()
 {
     auto chains = m_boundaries->getChains();
     auto lineCount = std::accumulate(chains.begin(), chains.end(), 0,
                                      [](int a, const ConstellationBoundaries::Chain* b) { return a + b->size() - 1; });
 
+    m_lineCount = lineCount;
     if (lineCount == 0)
-        return false;
+        return;
 
-    m_lineCount = lineCount;
+    m_lineRenderer.setVertexCount(lineCount * 2);
 
     for (const auto chain : chains)
     {
         for (unsigned i = 1; i < chain->size(); i++)
             m_lineRenderer.addSegment((*chain)[i - 1], (*chain)[i]);
     }
-
-    return true;
 }
 
 } // end namespace celestia::render
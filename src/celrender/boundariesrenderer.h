@@ -34,7 +34,7 @@ public:
     bool sameBoundaries(const ConstellationBoundaries*) const;
 
 private:
-    bool prepare();
+    void prepare();
 
     LineRenderer                   m_lineRenderer;
     const ConstellationBoundaries *m_boundaries      { nullptr };
@@ -12,6 +12,8 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <vector>
 
 #include <Eigen/Geometry>
 
@@ -19,7 +21,6 @@
 #include <celengine/astro.h>
 #include <celengine/body.h>
 #include <celengine/glsupport.h>
-#include <celengine/observer.h>
 #include <celengine/render.h>
 #include <celengine/shadermanager.h>
 #include <celmath/mathlib.h>
@@ -40,19 +41,35 @@ namespace
 
 constexpr int MaxCometTailPoints = 120;
 constexpr int MaxCometTailSlices = 48;
-constexpr int MaxVertices = MaxCometTailPoints*MaxCometTailSlices;
-constexpr int MaxIndices = IndexListCapacity(MaxCometTailSlices, MaxCometTailPoints);
+
+// Levels of detail of the template mesh, as fractions of the maximum
+// number of points and slices, from the finest to the coarsest
+constexpr std::array<float, 4> TailLevels = { 1.0f, 0.6f, 0.35f, 0.2f };
+
+// Radius of the dust tail relative to its length
+constexpr float DustTailRadiusRatio = 0.1f;
 
 // Distance from the Sun at which comet tails will start to fade out
 constexpr float CometTailAttenDistSol = astro::AUtoKilometers(5.0f);
 
+int
+levelPoints(std::size_t level)
+{
+    return static_cast<int>(MaxCometTailPoints * TailLevels[level]);
+}
+
+int
+levelSlices(std::size_t level)
+{
+    return static_cast<int>(MaxCometTailSlices * TailLevels[level]);
+}
+
 } // end unnamed namespace
 
 CometRenderer::CometRenderer(Renderer &renderer) :
-    m_renderer(renderer),
-    m_vertices(std::make_unique<CometTailVertex[]>(MaxVertices)),
-    m_indices(std::make_unique<unsigned short[]>(MaxIndices))
+    m_renderer(renderer)
 {
+    static_assert(TailLevels.size() == LevelCount);
 }
 
 void
@@ -64,13 +81,30 @@ CometRenderer::initGL()
     m_initialized = true;
 
     m_prog = m_renderer.getShaderManager().getShader("comet");
+    if (m_prog == nullptr)
+        return;
+
     m_brightnessLoc = m_prog->attribIndex("in_Brightness");
+    m_instanceLocs = {
+        m_prog->attribIndex("in_CometPosition"),
+        m_prog->attribIndex("in_CometAxis"),
+        m_prog->attribIndex("in_CometBasis"),
+        m_prog->attribIndex("in_CometColor"),
+    };
+
+    int nVertices = 0;
+    int nIndices = 0;
+    for (std::size_t level = 0; level < LevelCount; level++)
+    {
+        nVertices += levelPoints(level) * levelSlices(level);
+        nIndices += IndexListCapacity(levelSlices(level), levelPoints(level));
+    }
 
     m_vo = std::make_unique<IndexedVertexObject>(
-            MaxVertices * sizeof(CometTailVertex),
-            GL_STREAM_DRAW,
+            nVertices * sizeof(CometTailVertex),
+            GL_STATIC_DRAW,
             GL_UNSIGNED_SHORT,
-            MaxIndices * sizeof(unsigned short));
+            nIndices * sizeof(unsigned short));
 }
 
 void
@@ -78,26 +112,84 @@ CometRenderer::deinitGL()
 {
     m_initialized = false;
     m_vo = nullptr;
+    if (m_instanceBuffer != 0)
+    {
+        glDeleteBuffers(1, &m_instanceBuffer);
+        m_instanceBuffer = 0;
+    }
 }
 
 void
 CometRenderer::initVertexObject()
 {
+    // The template tails of all levels share the buffers, a level's
+    // indices being offset by the vertices of the levels before it.
+    std::vector<CometTailVertex> vertices;
+    std::vector<ushort> indices;
+    for (std::size_t level = 0; level < LevelCount; level++)
+    {
+        int nTailPoints = levelPoints(level);
+        int nTailSlices = levelSlices(level);
+        auto baseVertex = static_cast<ushort>(vertices.size());
+
+        for (int i = 0; i < nTailPoints; i++)
+        {
+            float alpha = static_cast<float>(i) / static_cast<float>(nTailPoints);
+            float brightness = 1.0f - static_cast<float>(i) / static_cast<float>(nTailPoints - 1);
+
+            // The points of the tail lie on a line, at squared intervals,
+            // so the slope of the tail surface only depends on the number
+            // of points.
+            float w0, w1;
+            if (i == 0)
+            {
+                w0 = 1.0f;
+                w1 = 0.0f;
+            }
+            else
+            {
+                float dr = DustTailRadiusRatio * static_cast<float>(nTailPoints) / static_cast<float>(2 * i - 1);
+                w0 = std::atan(dr);
+                float d = std::sqrt(1.0f + w0 * w0);
+                w1 = 1.0f / d;
+                w0 = w0 / d;
+            }
+
+            for (int j = 0; j < nTailSlices; j++)
+            {
+                float theta = 2.0f * numbers::pi_v<float> * static_cast<float>(j) / static_cast<float>(nTailSlices);
+                float s, c;
+                celmath::sincos(theta, s, c);
+                vertices.push_back({ Eigen::Vector4f(alpha * alpha, alpha, s, c),
+                                     Eigen::Vector2f(w0, w1),
+                                     brightness });
+            }
+        }
+
+        auto firstIndex = static_cast<int>(indices.size());
+        BuildIndexList(static_cast<ushort>(nTailPoints - 1), static_cast<ushort>(nTailSlices), indices);
+        for (auto it = indices.begin() + firstIndex; it != indices.end(); ++it)
+            *it += baseVertex;
+
+        m_levels[level] = { firstIndex, static_cast<int>(indices.size()) - firstIndex };
+    }
+
     m_vo->bind();
+    m_vo->allocate(vertices.data(), indices.data());
     m_vo->setVertexAttribArray(
         CelestiaGLProgram::VertexCoordAttributeIndex,
-        3,
+        4,
         GL_FLOAT,
         GL_FALSE,
         sizeof(CometTailVertex),
-        offsetof(CometTailVertex, point));
+        offsetof(CometTailVertex, shape));
     m_vo->setVertexAttribArray(
-        CelestiaGLProgram::NormalAttributeIndex,
-        3,
+        CelestiaGLProgram::TextureCoord0AttributeIndex,
+        2,
         GL_FLOAT,
         GL_FALSE,
         sizeof(CometTailVertex),
-        offsetof(CometTailVertex, normal));
+        offsetof(CometTailVertex, normalWeights));
     m_vo->setVertexAttribArray(
         m_brightnessLoc,
         1,
@@ -108,41 +200,34 @@ CometRenderer::initVertexObject()
 }
 
 void
-CometRenderer::render(const Body &body,
-                      const Observer &observer,
-                      const Eigen::Vector3f &pos,
-                      float dustTailLength,
-                      float discSizeInPixels,
-                      const Matrices &m)
+CometRenderer::queue(const Body &body,
+                     const Eigen::Vector3f &pos,
+                     float dustTailLength,
+                     float discSizeInPixels)
 {
     if (m_prog == nullptr)
         return;
 
-    double now = observer.getTime();
-
-    Eigen::Vector3f cometPoints[MaxCometTailPoints];
-#if 0
-    Eigen::Vector3d pos0 = body.getOrbit(now)->positionAtTime(now);
-    Eigen::Vector3d pos1 = body.getOrbit(now)->positionAtTime(now - 0.01);
-    Eigen::Vector3d vd = pos1 - pos0;
-#endif
-
     // Adjust the amount of triangles used for the comet tail based on
     // the screen size of the comet.
     float lod = std::clamp(discSizeInPixels / 1000.0f, 0.2f, 1.0f);
-    auto nTailPoints = static_cast<int>(MaxCometTailPoints * lod);
-    auto nTailSlices = static_cast<int>(MaxCometTailSlices * lod);
+    std::size_t level = 0;
+    while (level + 1 < LevelCount && TailLevels[level + 1] >= lod)
+        level++;
 
     float irradiance_max = 0.0f;
     // Find the sun with the largest irrradiance of light onto the comet
     // as function of the comet's position;
     // irradiance = sun's luminosity / square(distanceFromSun);
     Eigen::Vector3d sunPos(Eigen::Vector3d::Zero());
-    for (const auto star : m_renderer.getNearStars())
+    auto nearStars = m_renderer.getNearStars();
+    auto nearStarOffsets = m_renderer.getNearStarOffsets();
+    for (std::size_t i = 0; i < nearStars.size(); i++)
     {
+        const Star* star = nearStars[i];
         if (star->getVisibility())
         {
-            Eigen::Vector3d p = star->getPosition(now).offsetFromKm(observer.getPosition());
+            const Eigen::Vector3d& p = nearStarOffsets[i];
             float distanceFromSun = static_cast<float>((pos.cast<double>() - p).norm());
             float irradiance = star->getBolometricLuminosity() / celmath::square(distanceFromSun);
 
@@ -156,91 +241,37 @@ CometRenderer::render(const Body &body,
 
     float fadeDistance = 1.0f / (CometTailAttenDistSol * std::sqrt(irradiance_max));
 
+    // If fadeDistFromSun = x/x0 >= 1.0, comet tail starts fading,
+    // i.e. fadeFactor quickly transits from 1 to 0.
+    float fadeFactor = 0.5f * (1.0f - std::tanh(fadeDistance - 1.0f / fadeDistance));
+
     // direction to sun with dominant light irradiance:
     Eigen::Vector3f sunDir = (pos.cast<double>() - sunPos).cast<float>().normalized();
 
-    float dustTailRadius = dustTailLength * 0.1f;
-
-    Eigen::Vector3f origin = -sunDir * (body.getRadius() * 100);
-
-    for (int i = 0; i < nTailPoints; i++)
-    {
-        float alpha = static_cast<float>(i) / static_cast<float>(nTailPoints);
-        alpha = alpha * alpha;
-        cometPoints[i] = origin + sunDir * (dustTailLength * alpha);
-    }
-
     // We need three axes to define the coordinate system for rendering the
     // comet. The first axis is the sun-to-comet direction, and the other
-    // two are chose orthogonal to each other and the primary axis.
-    Eigen::Vector3f v = (cometPoints[1] - cometPoints[0]).normalized();
-    Eigen::Quaternionf q = body.getEclipticToEquatorial(now).cast<float>();
-    Eigen::Vector3f u = v.unitOrthogonal();
-    Eigen::Vector3f w = u.cross(v);
+    // two are chosen orthogonal to each other and the primary axis; the
+    // shader derives the third one.
+    Eigen::Vector3f u = sunDir.unitOrthogonal();
+    Eigen::Vector3f color = body.getCometTailColor().toVector3();
+
+    CometTailInstance instance;
+    instance.position << pos, dustTailLength;
+    instance.axis << sunDir, body.getRadius() * 100.0f;
+    instance.basis << u, fadeFactor;
+    instance.color << color, 1.0f;
+    m_queues[level].push_back(instance);
+}
 
-    for (int i = 0; i < nTailPoints; i++)
+void
+CometRenderer::renderQueued(const Matrices &m)
+{
+    if (m_prog == nullptr ||
+        std::all_of(m_queues.begin(), m_queues.end(), [](const auto& q) { return q.empty(); }))
     {
-        float brightness = 1.0f - static_cast<float>(i) / static_cast<float>(nTailPoints - 1);
-        Eigen::Vector3f v0, v1;
-        float w0, w1;
-        // Special case for the first vertex in the comet tail
-        if (i == 0)
-        {
-            v0 = cometPoints[1] - cometPoints[0];
-            v0.normalize();
-            v1 = v0;
-            w0 = 1.0f;
-            w1 = 0.0f;
-        }
-        else
-        {
-            v0 = cometPoints[i] - cometPoints[i - 1];
-            float sectionLength = v0.norm();
-            v0.normalize();
-
-            if (i == nTailPoints - 1)
-            {
-                v1 = v0;
-            }
-            else
-            {
-                v1 = (cometPoints[i + 1] - cometPoints[i]).normalized();
-                q.setFromTwoVectors(v0, v1);
-                Eigen::Matrix3f rot = q.toRotationMatrix();
-                u = rot * u;
-                v = rot * v;
-                w = rot * w;
-            }
-            float dr = dustTailRadius / static_cast<float>(nTailPoints) / sectionLength;
-            w0 = std::atan(dr);
-            float d = std::sqrt(1.0f + w0 * w0);
-            w1 = 1.0f / d;
-            w0 = w0 / d;
-        }
-
-        float radius = static_cast<float>(i) / static_cast<float>(nTailPoints) * dustTailRadius;
-        for (int j = 0; j < nTailSlices; j++)
-        {
-            float theta = 2.0f * numbers::pi_v<float> * static_cast<float>(j) / static_cast<float>(nTailSlices);
-            float s, c;
-            celmath::sincos(theta, s, c);
-            CometTailVertex& vtx = m_vertices[i * nTailSlices + j];
-            vtx.normal = u * (s * w1) + w * (c * w1) + v * w0;
-            vtx.normal.normalize();
-            s *= radius;
-            c *= radius;
-
-            vtx.point = cometPoints[i] + u * s + w * c;
-            vtx.brightness = brightness;
-        }
+        return;
     }
 
-    BuildIndexList(static_cast<ushort>(nTailPoints-1), static_cast<ushort>(nTailSlices), m_indices.get());
-
-    // If fadeDistFromSun = x/x0 >= 1.0, comet tail starts fading,
-    // i.e. fadeFactor quickly transits from 1 to 0.
-    float fadeFactor = 0.5f * (1.0f - std::tanh(fadeDistance - 1.0f / fadeDistance));
-
     Renderer::PipelineState ps;
     ps.blending = true;
     ps.blendFunc = {GL_SRC_ALPHA, GL_ONE};
@@ -248,25 +279,74 @@ CometRenderer::render(const Body &body,
     m_renderer.setPipelineState(ps);
 
     m_prog->use();
-    m_prog->setMVPMatrices(*m.projection, (*m.modelview) * celmath::translate(pos));
-    m_prog->vec3Param("color") = body.getCometTailColor().toVector3();
-    m_prog->vec3Param("viewDir") = pos.normalized();
-    m_prog->floatParam("fadeFactor") = fadeFactor;
+    m_prog->setMVPMatrices(*m.projection, *m.modelview);
 
     if (m_vo->initialized())
-        m_vo->bindWritable();
+        m_vo->bind();
     else
         initVertexObject();
 
-    m_vo->allocate(nullptr, nullptr); // allocate or orphan GPU memory buffers
-
-    m_vo->setBufferData(m_vertices.get(), 0, sizeof(CometTailVertex) * nTailPoints * nTailSlices);
-    int count = IndexListCapacity(nTailSlices, nTailPoints);
-    m_vo->setIndexBufferData(m_indices.get(), 0, count * sizeof(m_indices[0]));
+    bool instanced = gl::ARB_instanced_arrays;
+    if (instanced && m_instanceBuffer == 0)
+        glGenBuffers(1, &m_instanceBuffer);
 
     glDisable(GL_CULL_FACE);
-    m_vo->draw(GL_TRIANGLE_STRIP, count, 0);
-    m_vo->unbind();
+    for (std::size_t level = 0; level < LevelCount; level++)
+    {
+        std::vector<CometTailInstance>& instances = m_queues[level];
+        if (instances.empty())
+            continue;
+
+        const TailLevel& tail = m_levels[level];
+        if (instanced)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+            glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(CometTailInstance), instances.data(), GL_STREAM_DRAW);
+            for (std::size_t i = 0; i < m_instanceLocs.size(); i++)
+            {
+                if (m_instanceLocs[i] < 0)
+                    continue;
+                auto location = static_cast<GLuint>(m_instanceLocs[i]);
+                glEnableVertexAttribArray(location);
+                glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(CometTailInstance),
+                                      reinterpret_cast<const void*>(i * sizeof(Eigen::Vector4f))); //NOSONAR
+                glVertexAttribDivisor(location, 1);
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+            m_vo->drawInstanced(GL_TRIANGLE_STRIP, tail.nIndices, static_cast<GLsizei>(instances.size()), tail.firstIndex);
+
+            for (int location : m_instanceLocs)
+            {
+                if (location < 0)
+                    continue;
+                glVertexAttribDivisor(static_cast<GLuint>(location), 0);
+                glDisableVertexAttribArray(static_cast<GLuint>(location));
+            }
+        }
+        else
+        {
+            // Without instancing the parameters of each tail are passed
+            // as constant vertex attributes.
+            for (const CometTailInstance& instance : instances)
+            {
+                std::array<const Eigen::Vector4f*, 4> params =
+                {
+                    &instance.position, &instance.axis, &instance.basis, &instance.color
+                };
+                for (std::size_t i = 0; i < m_instanceLocs.size(); i++)
+                {
+                    if (m_instanceLocs[i] >= 0)
+                        glVertexAttrib4fv(static_cast<GLuint>(m_instanceLocs[i]), params[i]->data());
+                }
+                m_vo->draw(GL_TRIANGLE_STRIP, tail.nIndices, tail.firstIndex);
+            }
+        }
+
+        instances.clear();
+    }
     glEnable(GL_CULL_FACE);
+
+    m_vo->unbind();
 }
 }
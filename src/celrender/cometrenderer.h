@@ -10,12 +10,16 @@
 
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <memory>
+#include <vector>
 
 #include <Eigen/Core>
 
+#include <celengine/glsupport.h>
+
 class Body;
-class Observer;
 class Renderer;
 class CelestiaGLProgram;
 struct Matrices;
@@ -34,12 +38,17 @@ public:
     CometRenderer& operator=(const CometRenderer&) = delete;
     CometRenderer& operator=(CometRenderer&&) = delete;
 
-    void render(const Body &body,
-                const Observer &observer,
-                const Eigen::Vector3f &pos,
-                float dustTailLength,
-                float discSizeInPixels,
-                const Matrices &m);
+    // Queue the tail of a comet. The tail geometry is generated by the
+    // vertex shader from a template mesh, so queueing only computes the
+    // parameters of the tail.
+    void queue(const Body &body,
+               const Eigen::Vector3f &pos,
+               float dustTailLength,
+               float discSizeInPixels);
+
+    // Draw the queued tails, one instanced draw call per level of detail.
+    // The tails are blended additively, so their order doesn't matter.
+    void renderQueued(const Matrices &m);
 
     void initGL();
     void deinitGL();
@@ -50,18 +59,41 @@ private:
 
     struct CometTailVertex
     {
-        Eigen::Vector3f point;
-        Eigen::Vector3f normal;
+        // Squared distance along the tail and radius, relative to the
+        // tail length and radius, and the sine and cosine of the angle
+        // around the tail
+        Eigen::Vector4f shape;
+        // Weights of the tail axis and the radial direction in the normal
+        Eigen::Vector2f normalWeights;
         float brightness;
     };
 
+    // Per comet parameters of the template mesh, see comet_vert.glsl
+    struct CometTailInstance
+    {
+        Eigen::Vector4f position;   // nucleus position, tail length
+        Eigen::Vector4f axis;       // direction away from the sun, tail start offset
+        Eigen::Vector4f basis;      // direction orthogonal to the axis, fade factor
+        Eigen::Vector4f color;
+    };
+
+    struct TailLevel
+    {
+        int firstIndex;
+        int nIndices;
+    };
+
+    static constexpr std::size_t LevelCount = 4;
+
     Renderer                               &m_renderer;
     CelestiaGLProgram                      *m_prog              { nullptr };
     int                                     m_brightnessLoc     { -1 };
+    std::array<int, 4>                      m_instanceLocs      { -1, -1, -1, -1 };
     bool                                    m_initialized       { false };
 
-    std::unique_ptr<CometTailVertex[]>      m_vertices;
-    std::unique_ptr<unsigned short[]>       m_indices;
+    std::array<TailLevel, LevelCount>       m_levels            {};
+    std::array<std::vector<CometTailInstance>, LevelCount> m_queues;
     std::unique_ptr<IndexedVertexObject>    m_vo;
+    GLuint                                  m_instanceBuffer    { 0 };
 };
 }
@@ -0,0 +1,154 @@
+// floatdepthtarget.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Offscreen framebuffer with a floating point depth buffer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "floatdepthtarget.h"
+
+#include <algorithm>
+
+#include <celutil/logger.h>
+#include "texturememory.h"
+
+using celestia::util::GetLogger;
+
+
+namespace celestia::render
+{
+
+namespace
+{
+// Four bytes per sample for both the color and the depth buffer
+constexpr std::size_t BytesPerSample = 8;
+} // end unnamed namespace
+
+FloatDepthTarget::~FloatDepthTarget()
+{
+    destroy();
+}
+
+bool
+FloatDepthTarget::bind(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_oldFboId);
+
+    GLint samples = 0;
+    glGetIntegerv(GL_SAMPLES, &samples);
+
+    // Grow only, so that views of different sizes share the framebuffer
+    GLsizei neededWidth = x + width;
+    GLsizei neededHeight = y + height;
+    if (m_fboId == 0 || samples != m_samples || neededWidth > m_width || neededHeight > m_height)
+    {
+        neededWidth = std::max(neededWidth, m_width);
+        neededHeight = std::max(neededHeight, m_height);
+        destroy();
+        if (!create(neededWidth, neededHeight, samples))
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, m_oldFboId);
+            return false;
+        }
+    }
+    else
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_fboId);
+    }
+
+    m_region[0] = x;
+    m_region[1] = y;
+    m_region[2] = x + width;
+    m_region[3] = y + height;
+    return true;
+}
+
+bool
+FloatDepthTarget::unbind()
+{
+    if (!m_verified)
+    {
+        // Don't blame the copy for earlier errors
+        while (glGetError() != GL_NO_ERROR);
+    }
+
+    // The scissor test applies to the copy too; if enabled it's set to
+    // the region of the view
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fboId);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_oldFboId);
+    glBlitFramebuffer(m_region[0], m_region[1], m_region[2], m_region[3],
+                      m_region[0], m_region[1], m_region[2], m_region[3],
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_oldFboId);
+
+    if (m_verified)
+        return true;
+
+    if (glGetError() != GL_NO_ERROR)
+    {
+        destroy();
+        return false;
+    }
+
+    m_verified = true;
+    return true;
+}
+
+bool
+FloatDepthTarget::create(GLsizei width, GLsizei height, GLint samples)
+{
+    m_width = width;
+    m_height = height;
+    m_samples = samples;
+    m_verified = false;
+
+    glGenRenderbuffers(1, &m_colorBufferId);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_colorBufferId);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &m_depthBufferId);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_depthBufferId);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT32F, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &m_fboId);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fboId);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorBufferId);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBufferId);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        GetLogger()->error("Error creating {}x{} framebuffer with a floating point depth buffer.\n",
+                           width, height);
+        destroy();
+        return false;
+    }
+
+    m_memorySize = static_cast<std::size_t>(width) * static_cast<std::size_t>(height) *
+                   static_cast<std::size_t>(std::max(samples, 1)) * BytesPerSample;
+    addTextureMemory(TextureMemoryCategory::Framebuffers, m_memorySize);
+    return true;
+}
+
+void
+FloatDepthTarget::destroy()
+{
+    if (m_fboId != 0)
+        glDeleteFramebuffers(1, &m_fboId);
+    if (m_colorBufferId != 0)
+        glDeleteRenderbuffers(1, &m_colorBufferId);
+    if (m_depthBufferId != 0)
+        glDeleteRenderbuffers(1, &m_depthBufferId);
+    removeTextureMemory(TextureMemoryCategory::Framebuffers, m_memorySize);
+
+    m_fboId = 0;
+    m_colorBufferId = 0;
+    m_depthBufferId = 0;
+    m_width = 0;
+    m_height = 0;
+    m_memorySize = 0;
+}
+
+} // namespace
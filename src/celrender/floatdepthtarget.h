@@ -0,0 +1,75 @@
+// floatdepthtarget.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Offscreen framebuffer with a floating point depth buffer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+
+#include <celengine/glsupport.h>
+
+namespace celestia::render
+{
+/**
+ * \class FloatDepthTarget floatdepthtarget.h celrender/floatdepthtarget.h
+ *
+ * @brief Framebuffer with a 32-bit floating point depth buffer which a view is drawn to in place
+ * of the framebuffer bound.
+ *
+ * The window framebuffers have fixed point depth buffers, which a reversed projection doesn't
+ * make any more precise. The view is drawn here with the viewport and scissor unchanged, then
+ * its colors are copied back. The color buffer has the sample count of the framebuffer it
+ * stands in for, as copies between multisampled framebuffers need matching counts.
+ */
+class FloatDepthTarget
+{
+ public:
+    FloatDepthTarget() = default;
+    ~FloatDepthTarget();
+
+    FloatDepthTarget(const FloatDepthTarget&) = delete;
+    FloatDepthTarget(FloatDepthTarget&&) = delete;
+    FloatDepthTarget& operator=(const FloatDepthTarget&) = delete;
+    FloatDepthTarget& operator=(FloatDepthTarget&&) = delete;
+
+    /**
+     * @brief Bind the framebuffer in place of the one bound.
+     *
+     * The framebuffer is created, or created again, to cover the region.
+     * @param x, y, width, height Region of the view in the framebuffer bound.
+     * @return false if the framebuffer can't be created; the framebuffer bound is unchanged.
+     */
+    bool bind(GLint x, GLint y, GLsizei width, GLsizei height);
+
+    /**
+     * @brief Copy the colors of the region to the framebuffer bound before bind() and bind it
+     * again.
+     *
+     * @return false if the first copy after creating the framebuffer failed, e.g. because its
+     * color format doesn't match a multisampled framebuffer bound.
+     */
+    bool unbind();
+
+ private:
+    bool create(GLsizei width, GLsizei height, GLint samples);
+    void destroy();
+
+    GLuint      m_fboId         { 0 };
+    GLuint      m_colorBufferId { 0 };
+    GLuint      m_depthBufferId { 0 };
+    GLsizei     m_width         { 0 };
+    GLsizei     m_height        { 0 };
+    GLint       m_samples       { 0 };
+    GLint       m_oldFboId      { 0 };
+    GLint       m_region[4]     { 0, 0, 0, 0 };
+    std::size_t m_memorySize    { 0 };
+    bool        m_verified      { false };
+};
+} // namespace
@@ -0,0 +1,339 @@
+// frameprofiler.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// CPU and GPU times of the passes of a frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "frameprofiler.h"
+
+#include <algorithm>
+
+#include <fmt/ostream.h>
+
+#include <celutil/gettext.h>
+#include <celutil/logger.h>
+
+using celestia::util::GetLogger;
+
+namespace celestia::render
+{
+
+const char*
+profilePassName(ProfilePass pass)
+{
+    switch (pass)
+    {
+    case ProfilePass::PointStars:         return "stars";
+    case ProfilePass::DeepSkyObjects:     return "dsos";
+    case ProfilePass::SolarSystemObjects: return "objects";
+    case ProfilePass::Orbits:             return "orbits";
+    case ProfilePass::Annotations:        return "annotations";
+    case ProfilePass::Overlay:            return "overlay";
+    default:                              return "";
+    }
+}
+
+
+FrameProfiler::~FrameProfiler()
+{
+    stopTrace();
+    releaseQueries();
+}
+
+
+bool
+FrameProfiler::hasTimestamps()
+{
+#ifdef GL_ES
+    return false;
+#else
+    return gl::ARB_timer_query;
+#endif
+}
+
+
+void
+FrameProfiler::setEnabled(bool enable)
+{
+    enableRequested = enable;
+    if (!inFrame)
+        enabled = enable;
+}
+
+
+bool
+FrameProfiler::startTrace(const fs::path& filename)
+{
+    stopTrace();
+
+    trace.open(filename, std::ios::out | std::ios::trunc);
+    if (!trace.good())
+    {
+        GetLogger()->error(_("Unable to open {} for writing\n"), filename);
+        trace.close();
+        return false;
+    }
+
+    chromeTrace = filename.extension() == ".json";
+    firstTraceEvent = true;
+    if (chromeTrace)
+    {
+        trace << "[\n";
+    }
+    else
+    {
+        trace << "frame,start,cpu";
+        for (std::size_t i = 0; i < ProfilePassCount; i++)
+        {
+            const char* name = profilePassName(static_cast<ProfilePass>(i));
+            fmt::print(trace, ",{0}_cpu,{0}_gpu", name);
+        }
+        trace << ",draw_calls,program_changes,state_changes,triangles,points,arena_bytes,jobs,stolen_jobs,job_time\n";
+    }
+
+    setEnabled(true);
+    return true;
+}
+
+
+void
+FrameProfiler::stopTrace()
+{
+    if (!trace.is_open())
+        return;
+
+    if (chromeTrace)
+        trace << "\n]\n";
+    trace.close();
+}
+
+
+double
+FrameProfiler::now() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - origin).count();
+}
+
+
+void
+FrameProfiler::beginFrame()
+{
+    enabled = enableRequested;
+    inFrame = enabled;
+    if (!enabled)
+        return;
+
+    if (frameNumber == 0)
+        origin = std::chrono::steady_clock::now();
+
+    // Collect the oldest frame before its queries are used again
+    currentSlot = (currentSlot + 1) % slots.size();
+    FrameSlot& slot = slots[currentSlot];
+    if (slot.pending)
+        collect(slot);
+
+    slot.frame = {};
+    slot.frame.number = frameNumber++;
+    slot.frame.startTime = now();
+    slot.usedQueries = 0;
+    slot.lastQuery = 0;
+    slot.intervals.clear();
+
+    // Only count the jobs run from the start of the frame
+    celestia::util::GetJobSystem()->takeStats();
+}
+
+
+void
+FrameProfiler::endFrame(const RenderStats& stats)
+{
+    if (!inFrame)
+        return;
+    inFrame = false;
+
+    FrameSlot& slot = slots[currentSlot];
+    slot.frame.cpuFrameTime = now() - slot.frame.startTime;
+    slot.frame.stats = stats;
+    slot.frame.jobs = celestia::util::GetJobSystem()->takeStats();
+    slot.pending = true;
+
+    // Without timestamps, the frame is complete already; otherwise take
+    // the frames whose queries the GPU has written
+    for (std::size_t i = 1; i <= slots.size(); i++)
+    {
+        FrameSlot& oldSlot = slots[(currentSlot + i) % slots.size()];
+        if (!oldSlot.pending)
+            continue;
+
+        if (oldSlot.lastQuery != 0)
+        {
+            GLint available = GL_FALSE;
+            glGetQueryObjectiv(oldSlot.lastQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available == GL_FALSE)
+                break;
+        }
+        collect(oldSlot);
+    }
+
+    enabled = enableRequested;
+}
+
+
+void
+FrameProfiler::beginPass(ProfilePass pass)
+{
+    if (!inFrame)
+        return;
+
+    auto index = static_cast<std::size_t>(pass);
+    passStart[index] = now();
+
+    if (!hasTimestamps())
+        return;
+
+    FrameSlot& slot = slots[currentSlot];
+    if (slot.usedQueries == slot.queries.size())
+    {
+        PassQueries queries{ pass, 0, 0 };
+        glGenQueries(1, &queries.begin);
+        glGenQueries(1, &queries.end);
+        slot.queries.push_back(queries);
+    }
+
+    // Passes of different kinds may be nested
+    passQueries[index] = slot.usedQueries++;
+    PassQueries& queries = slot.queries[passQueries[index]];
+    queries.pass = pass;
+#ifndef GL_ES
+    glQueryCounter(queries.begin, GL_TIMESTAMP);
+#endif
+    slot.lastQuery = queries.begin;
+}
+
+
+void
+FrameProfiler::endPass(ProfilePass pass)
+{
+    if (!inFrame)
+        return;
+
+    auto index = static_cast<std::size_t>(pass);
+    FrameSlot& slot = slots[currentSlot];
+    double end = now();
+    slot.frame.cpuTimes[index] += end - passStart[index];
+    slot.frame.runs[index]++;
+    if (trace.is_open())
+        slot.intervals.push_back({ pass, passStart[index], end });
+
+    if (!hasTimestamps())
+        return;
+
+    const PassQueries& queries = slot.queries[passQueries[index]];
+#ifndef GL_ES
+    glQueryCounter(queries.end, GL_TIMESTAMP);
+#endif
+    slot.lastQuery = queries.end;
+}
+
+
+void
+FrameProfiler::collect(FrameSlot& slot)
+{
+    ProfiledFrame& frame = slot.frame;
+    if (hasTimestamps())
+    {
+        frame.gpuTimes.fill(0.0);
+#ifndef GL_ES
+        for (std::size_t i = 0; i < slot.usedQueries; i++)
+        {
+            GLuint64 begin = 0;
+            GLuint64 end = 0;
+            glGetQueryObjectui64v(slot.queries[i].begin, GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(slot.queries[i].end, GL_QUERY_RESULT, &end);
+            frame.gpuTimes[static_cast<std::size_t>(slot.queries[i].pass)] +=
+                static_cast<double>(end - begin) * 1.0e-9;
+        }
+#endif
+    }
+    else
+    {
+        frame.gpuTimes.fill(-1.0);
+    }
+
+    slot.pending = false;
+    completed = frame;
+    if (trace.is_open())
+        writeTrace(frame, slot);
+}
+
+
+void
+FrameProfiler::writeTrace(const ProfiledFrame& frame, const FrameSlot& slot)
+{
+    if (!chromeTrace)
+    {
+        fmt::print(trace, "{},{:.6f},{:.6f}", frame.number, frame.startTime, frame.cpuFrameTime);
+        for (std::size_t i = 0; i < ProfilePassCount; i++)
+            fmt::print(trace, ",{:.6f},{:.6f}", frame.cpuTimes[i], frame.gpuTimes[i]);
+        fmt::print(trace, ",{},{},{},{},{},{},{},{},{:.6f}\n",
+                   frame.stats.drawCalls, frame.stats.programChanges, frame.stats.stateChanges,
+                   frame.stats.triangles, frame.stats.points, frame.stats.arenaBytes,
+                   frame.jobs.jobs, frame.jobs.stolenJobs, frame.jobs.busyTime);
+        return;
+    }
+
+    // Complete events in microseconds, the CPU on thread 0 and the GPU on
+    // thread 1. The GPU passes of the frame are laid out one after the
+    // other from its start, as the GPU clock has another origin.
+    auto event = [this](const char* name, int tid, double start, double duration)
+    {
+        fmt::print(trace, "{}{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                   firstTraceEvent ? "" : ",\n", name, tid, start * 1.0e6, duration * 1.0e6);
+        firstTraceEvent = false;
+    };
+
+    event("frame", 0, frame.startTime, frame.cpuFrameTime);
+    for (const PassInterval& interval : slot.intervals)
+        event(profilePassName(interval.pass), 0, interval.start, interval.end - interval.start);
+    double gpuStart = frame.startTime;
+    for (std::size_t i = 0; i < ProfilePassCount; i++)
+    {
+        if (frame.runs[i] == 0)
+            continue;
+        const char* name = profilePassName(static_cast<ProfilePass>(i));
+        if (frame.gpuTimes[i] >= 0.0)
+        {
+            event(name, 1, gpuStart, frame.gpuTimes[i]);
+            gpuStart += frame.gpuTimes[i];
+        }
+    }
+    fmt::print(trace, ",\n{{\"name\":\"stats\",\"ph\":\"C\",\"pid\":0,\"ts\":{:.3f},\"args\":"
+                      "{{\"draw_calls\":{},\"triangles\":{},\"points\":{},\"jobs\":{}}}}}",
+               frame.startTime * 1.0e6, frame.stats.drawCalls, frame.stats.triangles, frame.stats.points,
+               frame.jobs.jobs);
+}
+
+
+void
+FrameProfiler::releaseQueries()
+{
+    for (FrameSlot& slot : slots)
+    {
+        for (const PassQueries& queries : slot.queries)
+        {
+            glDeleteQueries(1, &queries.begin);
+            glDeleteQueries(1, &queries.end);
+        }
+        slot.queries.clear();
+        slot.usedQueries = 0;
+        slot.lastQuery = 0;
+        slot.pending = false;
+    }
+}
+
+} // end namespace celestia::render
@@ -0,0 +1,171 @@
+// frameprofiler.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// CPU and GPU times of the passes of a frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celengine/glsupport.h>
+#include <celutil/jobsystem.h>
+#include "renderstats.h"
+
+namespace celestia::render
+{
+
+enum class ProfilePass : unsigned int
+{
+    PointStars,
+    DeepSkyObjects,
+    SolarSystemObjects,
+    Orbits,
+    Annotations,
+    Overlay,
+    Count,
+};
+
+constexpr std::size_t ProfilePassCount = static_cast<std::size_t>(ProfilePass::Count);
+
+const char* profilePassName(ProfilePass);
+
+struct ProfiledFrame
+{
+    std::uint32_t number{ 0 };
+    // Seconds from the start of profiling
+    double startTime{ 0.0 };
+    double cpuFrameTime{ 0.0 };
+    // In seconds, summed over each time the pass ran in the frame. The GPU
+    // times are negative when they can't be measured.
+    std::array<double, ProfilePassCount> cpuTimes{};
+    std::array<double, ProfilePassCount> gpuTimes{};
+    std::array<unsigned int, ProfilePassCount> runs{};
+    RenderStats stats;
+    celestia::util::JobStats jobs;
+};
+
+/*! Times the passes of each frame while enabled. The CPU times are taken
+ *  from the steady clock, the GPU times from timestamp queries written
+ *  before and after each pass. The queries of a frame are only read after
+ *  FramesInFlight more frames, when the GPU has finished with them, so the
+ *  latest frame available lags behind the one drawn.
+ *
+ *  Completed frames can be written to a trace file, as CSV with one line
+ *  per frame or, for a .json file, as Chrome trace events.
+ */
+class FrameProfiler
+{
+ public:
+    static constexpr std::size_t FramesInFlight = 3;
+
+    FrameProfiler() = default;
+    ~FrameProfiler();
+
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+    // Enabling or disabling takes effect from the next frame
+    bool isEnabled() const { return enabled; }
+    void setEnabled(bool);
+
+    bool startTrace(const fs::path&);
+    void stopTrace();
+    bool isTracing() const { return trace.is_open(); }
+
+    void beginFrame();
+    // stats are the counters of the frame which ends
+    void endFrame(const RenderStats& stats);
+
+    void beginPass(ProfilePass);
+    void endPass(ProfilePass);
+
+    // The latest frame whose GPU times are known
+    const ProfiledFrame& lastFrame() const { return completed; }
+
+ private:
+    struct PassQueries
+    {
+        ProfilePass pass;
+        GLuint begin;
+        GLuint end;
+    };
+
+    struct PassInterval
+    {
+        ProfilePass pass;
+        double start;
+        double end;
+    };
+
+    struct FrameSlot
+    {
+        ProfiledFrame frame;
+        std::vector<PassQueries> queries;
+        std::size_t usedQueries{ 0 };
+        // the query written last, which the GPU finishes last
+        GLuint lastQuery{ 0 };
+        // Each run of a pass, for the trace
+        std::vector<PassInterval> intervals;
+        bool pending{ false };
+    };
+
+    static bool hasTimestamps();
+    double now() const;
+    void collect(FrameSlot&);
+    void writeTrace(const ProfiledFrame&, const FrameSlot&);
+    void releaseQueries();
+
+    bool enabled{ false };
+    bool enableRequested{ false };
+    bool inFrame{ false };
+    std::uint32_t frameNumber{ 0 };
+    std::chrono::steady_clock::time_point origin;
+    std::array<FrameSlot, FramesInFlight + 1> slots;
+    std::size_t currentSlot{ 0 };
+    std::array<double, ProfilePassCount> passStart{};
+    std::array<std::size_t, ProfilePassCount> passQueries{};
+    ProfiledFrame completed;
+
+    std::ofstream trace;
+    bool chromeTrace{ false };
+    bool firstTraceEvent{ true };
+};
+
+// Times a pass of the renderer for the lifetime of the object
+class ProfileScope
+{
+ public:
+    ProfileScope(FrameProfiler& profiler, ProfilePass pass) :
+        profiler(profiler),
+        pass(pass)
+    {
+        if (profiler.isEnabled())
+            profiler.beginPass(pass);
+    }
+
+    ~ProfileScope()
+    {
+        if (profiler.isEnabled())
+            profiler.endPass(pass);
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+ private:
+    FrameProfiler& profiler;
+    ProfilePass pass;
+};
+
+} // end namespace celestia::render
@@ -0,0 +1,337 @@
+// gpustarrenderer.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "gpustarrenderer.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include <celengine/astro.h>
+#include <celengine/glsupport.h>
+#include <celengine/observer.h>
+#include <celengine/pointstarrenderer.h>
+#include <celengine/render.h>
+#include <celengine/shadermanager.h>
+#include <celengine/starcolors.h>
+#include <celengine/stardb.h>
+#include <celengine/texture.h>
+#include <celmath/mathlib.h>
+#include <celutil/color.h>
+#include "multidraw.h"
+#include "vertexobject.h"
+
+namespace celestia::render
+{
+
+namespace
+{
+
+// Number of stars converted between each buffer upload
+constexpr std::uint32_t UploadChunkSize = 65536;
+
+// Passes only the nearby stars which would have been passed to the point
+// star renderer by the usual octree traversal.
+class CloseStarFilter : public StarHandler
+{
+public:
+    CloseStarFilter(PointStarRenderer &starRenderer, float limitingMag) :
+        m_starRenderer(starRenderer),
+        m_limitingMag(limitingMag)
+    {
+    }
+
+    void process(const Star &star, float distance, float appMag) override
+    {
+        if (appMag < m_limitingMag || star.getOrbit() != nullptr)
+            m_starRenderer.process(star, distance, appMag);
+    }
+
+private:
+    PointStarRenderer &m_starRenderer;
+    float m_limitingMag;
+};
+
+// Passes the stars beyond the solar system distance, the nearer ones being
+// found by findCloseStars.
+class DistantStarFilter : public StarHandler
+{
+public:
+    DistantStarFilter(PointStarRenderer &starRenderer, float radius) :
+        m_starRenderer(starRenderer),
+        m_radius(radius)
+    {
+    }
+
+    void process(const Star &star, float distance, float appMag) override
+    {
+        if (distance > m_radius)
+            m_starRenderer.process(star, distance, appMag);
+    }
+
+private:
+    PointStarRenderer &m_starRenderer;
+    float m_radius;
+};
+
+// Adds the labels of the distant stars drawn on the GPU, using the same
+// rules as PointStarRenderer.
+class StarLabeler : public StarHandler
+{
+public:
+    explicit StarLabeler(const PointStarRenderer &starRenderer) :
+        m_starRenderer(starRenderer)
+    {
+    }
+
+    void process(const Star &star, float distance, float appMag) override
+    {
+        // The stars added to the database after loading aren't drawn on the
+        // GPU, and PointStarRenderer labels them
+        const StarCullingData &cullingData = *m_starRenderer.cullingData;
+        if (!cullingData.contains(&star))
+            return;
+
+        std::size_t i = cullingData.indexOf(&star);
+        if (distance <= m_starRenderer.SolarSystemMaxDistance ||
+            distance > m_starRenderer.distanceLimit ||
+            (cullingData.flags[i] & StarCullingData::HasOrbit) != 0 ||
+            appMag >= m_starRenderer.labelThresholdMag)
+        {
+            return;
+        }
+
+        Eigen::Vector3d starPos(cullingData.positionX[i], cullingData.positionY[i], cullingData.positionZ[i]);
+        Eigen::Vector3f relPos = (starPos - m_starRenderer.obsPos).cast<float>();
+        if (relPos.normalized().dot(m_starRenderer.viewNormal) <= m_starRenderer.cosFOV)
+            return;
+
+        float labelThresholdMag = m_starRenderer.labelThresholdMag;
+        float distr = std::min(1.0f, 3.5f * (labelThresholdMag - appMag) / labelThresholdMag);
+        Color color = Color(Renderer::StarLabelColor, distr * Renderer::StarLabelColor.alpha());
+        m_starRenderer.renderer->addBackgroundAnnotation(nullptr,
+                                                          m_starRenderer.renderer->getLabelCache().getStarLabel(*m_starRenderer.starDB, star),
+                                                          color,
+                                                          relPos,
+                                                          Renderer::LabelHorizontalAlignment::Start,
+                                                          Renderer::LabelVerticalAlignment::Bottom,
+                                                          0.0f,
+                                                          -appMag);
+    }
+
+private:
+    const PointStarRenderer &m_starRenderer;
+};
+
+} // end unnamed namespace
+
+GPUStarRenderer::GPUStarRenderer(Renderer &renderer) :
+    m_renderer(renderer),
+    m_draws(std::make_unique<MultiDrawArrays>())
+{
+}
+
+GPUStarRenderer::~GPUStarRenderer() = default;
+
+void
+GPUStarRenderer::render(const StarDatabase &starDB,
+                        PointStarRenderer &starRenderer,
+                        const Observer &observer,
+                        float faintestMagNight,
+                        Texture *starTex,
+                        Texture *glareTex)
+{
+    if (m_prog == nullptr)
+    {
+        m_prog = m_renderer.getShaderManager().getShader("gpustar");
+        if (m_prog == nullptr)
+            return;
+    }
+
+    if (m_starDB != &starDB || m_nStars != starDB.size() || m_colorTemp != m_renderer.colorTemp)
+        upload(starDB, m_renderer.colorTemp);
+
+    if (m_nStars == 0)
+        return;
+
+    m_ranges.clear();
+    starDB.findVisibleStarRanges(m_ranges,
+                                 observer.getPosition().toLy().cast<float>(),
+                                 observer.getOrientationf(),
+                                 celmath::degToRad(m_renderer.fov),
+                                 m_renderer.getAspectRatio(),
+                                 faintestMagNight);
+
+    const StarCullingData &cullingData = starDB.getCullingData();
+    m_draws->clear();
+    for (const auto &range : m_ranges)
+    {
+        m_draws->add(static_cast<GLint>(cullingData.indexOf(range.firstObject)),
+                     static_cast<GLsizei>(range.nObjects));
+    }
+
+    // Draw before the point star renderer starts filling its vertex
+    // buffers, as those assume their own program stays bound.
+    draw(observer, faintestMagNight, starTex, glareTex);
+    renderCPUStars(starDB, starRenderer, observer, faintestMagNight);
+}
+
+void
+GPUStarRenderer::upload(const StarDatabase &starDB, const ColorTemperatureTable *colorTemp)
+{
+    m_starDB = &starDB;
+    m_colorTemp = colorTemp;
+    m_nStars = starDB.size();
+    if (m_nStars == 0)
+        return;
+
+    const StarCullingData &cullingData = starDB.getCullingData();
+
+    bool initialized = m_vo != nullptr;
+    if (!initialized)
+        m_vo = std::make_unique<VertexObject>(0, GL_STATIC_DRAW);
+
+    if (initialized)
+        m_vo->bindWritable();
+    else
+        m_vo->bind();
+
+    m_vo->allocate(static_cast<GLsizeiptr>(m_nStars) * sizeof(StarVertex), nullptr);
+
+    std::vector<StarVertex> vertices(std::min(m_nStars, UploadChunkSize));
+    for (std::uint32_t first = 0; first < m_nStars; first += UploadChunkSize)
+    {
+        std::uint32_t count = std::min(UploadChunkSize, m_nStars - first);
+        for (std::uint32_t j = 0; j < count; j++)
+        {
+            std::uint32_t i = first + j;
+            StarVertex &v = vertices[j];
+            v.position[0] = cullingData.positionX[i];
+            v.position[1] = cullingData.positionY[i];
+            v.position[2] = cullingData.positionZ[i];
+            v.absMag = cullingData.absMag[i];
+            v.extinction = cullingData.extinction[i];
+            colorTemp->lookupColor(cullingData.temperature[i]).get(v.color);
+            // Stars with orbits are left to the CPU
+            v.color[3] = (cullingData.flags[i] & StarCullingData::HasOrbit) != 0 ? 0 : 255;
+        }
+
+        m_vo->setBufferData(vertices.data(),
+                            static_cast<GLintptr>(first) * sizeof(StarVertex),
+                            static_cast<GLsizeiptr>(count) * sizeof(StarVertex));
+    }
+
+    if (!initialized)
+    {
+        m_vo->setVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex,
+                                   3, GL_FLOAT, false, sizeof(StarVertex),
+                                   offsetof(StarVertex, position));
+        m_vo->setVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex,
+                                   2, GL_FLOAT, false, sizeof(StarVertex),
+                                   offsetof(StarVertex, absMag));
+        m_vo->setVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex,
+                                   4, GL_UNSIGNED_BYTE, true, sizeof(StarVertex),
+                                   offsetof(StarVertex, color));
+    }
+
+    m_vo->unbind();
+}
+
+void
+GPUStarRenderer::draw(const Observer &observer,
+                      float faintestMagNight,
+                      Texture *starTex,
+                      Texture *glareTex)
+{
+    if (m_draws->empty())
+        return;
+
+    const Renderer &r = m_renderer;
+
+    m_prog->use();
+    m_prog->setMVPMatrices(r.getCurrentProjectionMatrix(), r.getCurrentModelViewMatrix());
+    m_prog->samplerParam("starTex") = 0;
+    m_prog->vec3Param("observerPos") = observer.getPosition().toLy().cast<float>();
+    m_prog->floatParam("limitingMag") = faintestMagNight;
+    m_prog->floatParam("faintestMag") = r.faintestMag;
+    m_prog->floatParam("brightnessScale") = r.brightnessScale;
+    m_prog->floatParam("brightnessBias") = r.brightnessBias;
+    m_prog->floatParam("satPoint") = r.satPoint;
+    m_prog->floatParam("baseSize") = BaseStarDiscSize * static_cast<float>(r.screenDpi) / 96.0f;
+    m_prog->floatParam("pointScale") = static_cast<float>(r.screenDpi) / 96.0f;
+    m_prog->floatParam("minDistance") = r.SolarSystemMaxDistance;
+    m_prog->floatParam("maxDistance") = std::min(r.distanceLimit, StarDistanceLimit);
+    m_prog->floatParam("scaledDiscs") = r.starStyle == Renderer::ScaledDiscStars ? 1.0f : 0.0f;
+    m_prog->floatParam("basicPoints") = r.starStyle == Renderer::PointStars ? 1.0f : 0.0f;
+
+    m_vo->bind();
+
+    // The glares and then the discs, from the same batch of ranges
+    glareTex->bind();
+    m_prog->floatParam("glare") = 1.0f;
+    m_prog->floatParam("textured") = 1.0f;
+    m_draws->draw(GL_POINTS);
+
+    starTex->bind();
+    m_prog->floatParam("glare") = 0.0f;
+    m_prog->floatParam("textured") = r.starStyle == Renderer::PointStars ? 0.0f : 1.0f;
+    m_draws->draw(GL_POINTS);
+
+    m_vo->unbind();
+}
+
+void
+GPUStarRenderer::renderCPUStars(const StarDatabase &starDB,
+                                PointStarRenderer &starRenderer,
+                                const Observer &observer,
+                                float faintestMagNight) const
+{
+    Eigen::Vector3f obsPos = observer.getPosition().toLy().cast<float>();
+    float radius = m_renderer.SolarSystemMaxDistance;
+
+    CloseStarFilter closeStars(starRenderer, faintestMagNight);
+    starDB.findCloseStars(closeStars, obsPos, radius);
+
+    // The stars with orbits further away than that
+    const StarCullingData &cullingData = starDB.getCullingData();
+    for (std::uint32_t i : cullingData.orbitingStars)
+    {
+        Eigen::Vector3f starPos(cullingData.positionX[i], cullingData.positionY[i], cullingData.positionZ[i]);
+        float distance2 = (obsPos - starPos).squaredNorm();
+        if (distance2 < radius * radius)
+            continue;
+
+        float distance = std::sqrt(distance2);
+        float appMag = astro::absToAppMag(cullingData.absMag[i], distance) + cullingData.extinction[i] * distance;
+        if (appMag < faintestMagNight)
+            starRenderer.process(*starDB.getStar(i), distance, appMag);
+    }
+
+    // The distant stars added to the database after loading, which the GPU
+    // copy of the catalog doesn't include
+    DistantStarFilter addedStars(starRenderer, radius);
+    starDB.findVisibleAddedStars(addedStars,
+                                 obsPos,
+                                 observer.getOrientationf(),
+                                 celmath::degToRad(m_renderer.fov),
+                                 m_renderer.getAspectRatio(),
+                                 faintestMagNight);
+
+    if ((starRenderer.labelMode & Renderer::StarLabels) != 0)
+    {
+        StarLabeler labeler(starRenderer);
+        starDB.findVisibleStars(labeler,
+                                obsPos,
+                                observer.getOrientationf(),
+                                celmath::degToRad(m_renderer.fov),
+                                m_renderer.getAspectRatio(),
+                                std::min(faintestMagNight, starRenderer.labelThresholdMag));
+    }
+}
+
+} // end namespace celestia::render
@@ -0,0 +1,84 @@
+// gpustarrenderer.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <celengine/staroctree.h>
+
+class CelestiaGLProgram;
+class ColorTemperatureTable;
+class Observer;
+class PointStarRenderer;
+class Renderer;
+class StarDatabase;
+class Texture;
+
+namespace celestia::render
+{
+class MultiDrawArrays;
+class VertexObject;
+
+// Renders the point stars from a copy of the star catalog kept in GPU
+// memory. Only the visible octree node ranges are determined on the CPU;
+// the apparent magnitude, point size and glare of each star are computed
+// in the vertex shader. Nearby stars, stars with orbits and star labels
+// are still handled on the CPU by the PointStarRenderer.
+class GPUStarRenderer
+{
+public:
+    explicit GPUStarRenderer(Renderer &renderer);
+    ~GPUStarRenderer();
+    GPUStarRenderer() = delete;
+    GPUStarRenderer(const GPUStarRenderer&) = delete;
+    GPUStarRenderer(GPUStarRenderer&&) = delete;
+    GPUStarRenderer& operator=(const GPUStarRenderer&) = delete;
+    GPUStarRenderer& operator=(GPUStarRenderer&&) = delete;
+
+    void render(const StarDatabase &starDB,
+                PointStarRenderer &starRenderer,
+                const Observer &observer,
+                float faintestMagNight,
+                Texture *starTex,
+                Texture *glareTex);
+
+private:
+    struct StarVertex
+    {
+        float position[3];
+        float absMag;
+        float extinction;
+        std::uint8_t color[4];
+    };
+
+    void upload(const StarDatabase &starDB, const ColorTemperatureTable *colorTemp);
+    void draw(const Observer &observer,
+              float faintestMagNight,
+              Texture *starTex,
+              Texture *glareTex);
+    void renderCPUStars(const StarDatabase &starDB,
+                        PointStarRenderer &starRenderer,
+                        const Observer &observer,
+                        float faintestMagNight) const;
+
+    Renderer                                &m_renderer;
+    CelestiaGLProgram                       *m_prog         { nullptr };
+    std::unique_ptr<VertexObject>            m_vo;
+    const StarDatabase                      *m_starDB       { nullptr };
+    const ColorTemperatureTable             *m_colorTemp    { nullptr };
+    std::uint32_t                            m_nStars       { 0 };
+    std::vector<StarOctree::ObjectRange>     m_ranges;
+    // Draw calls of the visible ranges
+    std::unique_ptr<MultiDrawArrays>         m_draws;
+};
+
+} // end namespace celestia::render
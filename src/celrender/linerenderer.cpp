@@ -22,7 +22,28 @@
 namespace celestia::render
 {
 
-LineRenderer::~LineRenderer() = default;
+namespace
+{
+
+// Side of the line, segment end and extension beyond the end of the
+// vertices of the template quad of instanced segments
+constexpr std::array<float, 18> SegmentQuad =
+{
+    -0.5f, 0.0f, 0.0f,   0.5f, 0.0f, 0.0f,  -0.5f, 1.0f, 0.0f,
+    -0.5f, 1.0f, 0.0f,   0.5f, 1.0f, 0.0f,  -0.5f, 0.0f, 0.0f,
+};
+
+// Fade instanced lines out over the width of a pixel only when smooth lines
+// are drawn; otherwise the fade is narrower than a pixel.
+constexpr float SharpLineFeather = 1.0e6f;
+
+} // end unnamed namespace
+
+LineRenderer::~LineRenderer()
+{
+    if (m_instanceBuffer != 0)
+        glDeleteBuffers(1, &m_instanceBuffer);
+}
 
 /**
  * @brief Return number of elements of position attribute.
@@ -71,6 +92,67 @@ LineRenderer::draw_triangle_strip(int count, int offset) const
     m_trVertexObj->draw(GL_TRIANGLE_STRIP, count, offset);
 }
 
+//! Draw each segment as an instance of the template quad.
+void
+LineRenderer::draw_instances(int count, int offset) const
+{
+    int instanceCount;
+    GLsizei stride;
+    if (m_primType == PrimType::Lines)
+    {
+        instanceCount = count / 2;
+        stride = static_cast<GLsizei>(2 * sizeof(Vertex));
+    }
+    else
+    {
+        // the closing segment of a loop ends at a copy of the first vertex
+        instanceCount = m_primType == PrimType::LineLoop ? count : count - 1;
+        stride = static_cast<GLsizei>(sizeof(Vertex));
+    }
+
+    if (instanceCount <= 0)
+        return;
+
+    // There is no base instance with GL 3.3 and GLES 3.0, so the first
+    // segment is selected with the attribute offsets
+    auto base = static_cast<std::size_t>(offset) * sizeof(Vertex);
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+    glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
+                          pos_count(), GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<const void*>(base + offsetof(Vertex, pos))); //NOSONAR
+    glVertexAttribDivisor(CelestiaGLProgram::VertexCoordAttributeIndex, 1);
+    glEnableVertexAttribArray(CelestiaGLProgram::NextVCoordAttributeIndex);
+    glVertexAttribPointer(CelestiaGLProgram::NextVCoordAttributeIndex,
+                          pos_count(), GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<const void*>(base + sizeof(Vertex) + offsetof(Vertex, pos))); //NOSONAR
+    glVertexAttribDivisor(CelestiaGLProgram::NextVCoordAttributeIndex, 1);
+    if (color_count() != 0)
+    {
+        glEnableVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex);
+        glVertexAttribPointer(CelestiaGLProgram::ColorAttributeIndex,
+                              color_count(),
+                              color_type() == VF_UBYTE ? GL_UNSIGNED_BYTE : GL_FLOAT,
+                              color_type() == VF_UBYTE ? GL_TRUE : GL_FALSE,
+                              stride,
+                              reinterpret_cast<const void*>(base + offsetof(Vertex, color))); //NOSONAR
+        glVertexAttribDivisor(CelestiaGLProgram::ColorAttributeIndex, 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    m_quadVertexObj->drawInstanced(GL_TRIANGLES, 6, instanceCount);
+
+    glVertexAttribDivisor(CelestiaGLProgram::VertexCoordAttributeIndex, 0);
+    glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+    glVertexAttribDivisor(CelestiaGLProgram::NextVCoordAttributeIndex, 0);
+    glDisableVertexAttribArray(CelestiaGLProgram::NextVCoordAttributeIndex);
+    if (color_count() != 0)
+    {
+        glVertexAttribDivisor(CelestiaGLProgram::ColorAttributeIndex, 0);
+        glDisableVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex);
+    }
+}
+
 //! Draw lines defained with segments.
 void
 LineRenderer::draw_lines(int count, int offset) const
@@ -89,6 +171,8 @@ LineRenderer::setup_shader()
         props.lightModel = ShaderProperties::UnlitModel;
         if (m_useTriangles)
             props.texUsage |= ShaderProperties::LineAsTriangles;
+        else if (m_useInstances)
+            props.texUsage |= ShaderProperties::LineAsTriangles | ShaderProperties::InstancedLines;
         if ((m_hints & DISABLE_FISHEYE_TRANFORMATION) != 0)
             props.fishEyeOverride = ShaderProperties::FisheyeOverrideModeDisabled;
         m_prog = m_renderer.getShaderManager().getShader(props);
@@ -103,6 +187,21 @@ LineRenderer::setup_shader()
         m_prog->lineWidthX = m_width * width_multiplyer() * m_renderer.getPointWidth();
         m_prog->lineWidthY = m_width * width_multiplyer() * m_renderer.getPointHeight();
     }
+    else if (m_useInstances)
+    {
+        // Smooth lines are widened by a pixel, which is their fade
+        float width = rasterized_width();
+        float scale = 1.0f;
+        float feather = SharpLineFeather;
+        if ((m_renderer.getRenderFlags() & Renderer::ShowSmoothLines) != 0)
+        {
+            scale = (width + 1.0f) / width;
+            feather = 0.5f * (width + 1.0f);
+        }
+        m_prog->lineWidthX = m_width * width_multiplyer() * m_renderer.getPointWidth() * scale;
+        m_prog->lineWidthY = m_width * width_multiplyer() * m_renderer.getPointHeight() * scale;
+        m_prog->lineFeather = feather;
+    }
     else
     {
         glLineWidth(rasterized_width());
@@ -275,14 +374,78 @@ LineRenderer::setup_vbo_triangles()
     }
 }
 
+//! Copy the vertices of instanced segments to GPU memory.
+void
+LineRenderer::upload_instances() const
+{
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+    if (m_primType == PrimType::LineLoop && !m_vertices.empty())
+    {
+        // close the loop with a copy of the first vertex
+        auto size = static_cast<GLsizeiptr>((m_vertices.size() + 1) * sizeof(Vertex));
+        glBufferData(GL_ARRAY_BUFFER, size, nullptr, static_cast<GLenum>(m_storageType));
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size - sizeof(Vertex), m_vertices.data());
+        glBufferSubData(GL_ARRAY_BUFFER, size - sizeof(Vertex), sizeof(Vertex), m_vertices.data());
+    }
+    else
+    {
+        glBufferData(GL_ARRAY_BUFFER,
+                     static_cast<GLsizeiptr>(m_vertices.size() * sizeof(Vertex)),
+                     m_vertices.data(),
+                     static_cast<GLenum>(m_storageType));
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+//! Allocate GPU memory for the template quad and the vertices of instanced segments.
+void
+LineRenderer::create_vbo_instances()
+{
+    glGenBuffers(1, &m_instanceBuffer);
+    upload_instances();
+
+    std::array<float, 18> quad = SegmentQuad;
+    if (m_primType != PrimType::Lines)
+    {
+        // extend the segments of strips and loops over their joins
+        for (std::size_t i = 2; i < quad.size(); i += 3)
+            quad[i] = 1.0f;
+    }
+
+    m_quadVertexObj = std::make_unique<VertexObject>(0, GL_STATIC_DRAW);
+    m_quadVertexObj->bind();
+    m_quadVertexObj->allocate(sizeof(quad), quad.data());
+    m_quadVertexObj->setVertexAttribArray(
+        CelestiaGLProgram::ScaleFactorAttributeIndex,
+        3,
+        GL_FLOAT,
+        GL_FALSE,
+        3 * sizeof(float),
+        0);
+    // the attribute pointers must be defined while the quad buffer is bound
+    m_quadVertexObj->unbind();
+}
+
 //! Update or create GPU memory for vertices.
 void
 LineRenderer::setup_vbo()
 {
-    if (!m_useTriangles)
+    if (m_useInstances)
+    {
+        if (m_quadVertexObj == nullptr)
+            create_vbo_instances();
+        else if (m_storageType != StorageType::Static)
+            upload_instances();
+        m_quadVertexObj->bind();
+    }
+    else if (!m_useTriangles)
+    {
         setup_vbo_lines();
+    }
     else
+    {
         setup_vbo_triangles();
+    }
 }
 
 //! Add new triagles for a line segment (when primitive is Lines).
@@ -427,7 +590,11 @@ void
 LineRenderer::startUpdate()
 {
     if (m_storageType != StorageType::Static)
-        m_useTriangles = should_triangulate();
+    {
+        // instanced segments use the same vertices as thin lines
+        m_useInstances = gl::ARB_instanced_arrays && should_triangulate();
+        m_useTriangles = !m_useInstances && should_triangulate();
+    }
 }
 
 void
@@ -458,6 +625,8 @@ LineRenderer::finish()
         m_lnVertexObj->unbind();
     if (m_trVertexObj != nullptr)
         m_trVertexObj->unbind();
+    if (m_quadVertexObj != nullptr)
+        m_quadVertexObj->unbind();
     m_inUse = false;
     m_prog = nullptr;
 }
@@ -465,7 +634,13 @@ LineRenderer::finish()
 void
 LineRenderer::prerender()
 {
-    m_useTriangles = m_useTriangles || should_triangulate();
+    if (!m_useTriangles && !m_useInstances && should_triangulate())
+    {
+        if (gl::ARB_instanced_arrays)
+            m_useInstances = true;
+        else
+            m_useTriangles = true;
+    }
 
     if (m_useTriangles)
         triangulate();
@@ -503,6 +678,10 @@ LineRenderer::render(const Matrices &mvp, int count, int offset)
             draw_triangle_strip(count*2, offset*2);
         }
     }
+    else if (m_useInstances)
+    {
+        draw_instances(count, offset);
+    }
     else
     {
         draw_lines(count, offset);
@@ -597,9 +776,15 @@ LineRenderer::dropLast()
 {
     if ((m_hints & PREFER_SIMPLE_TRIANGLES) == 0 && m_primType != PrimType::Lines)
     {
-        m_vertices.pop_back();
-        m_verticesTr.pop_back();
-        m_verticesTr.pop_back();
+        if (!m_useTriangles)
+        {
+            m_vertices.pop_back();
+        }
+        else
+        {
+            m_verticesTr.pop_back();
+            m_verticesTr.pop_back();
+        }
     }
 }
 
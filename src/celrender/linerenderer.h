@@ -39,6 +39,10 @@ class VertexObject;
  * the actual rendering is done. For lines with dynamic or stream storage conversation into
  * triangles is performed immediatelly when a new vertex or segment is added.
  *
+ * When instanced arrays are supported the lines aren't converted into triangles. Instead each
+ * segment is drawn as an instance of a quad, which the vertex shader places in screen space from
+ * the segment end points, so wide lines cost as little CPU time as thin ones.
+ *
  * Worflow:
  *   1. create lr
  *   2. lr.addVertex()/lr.addSegment()
@@ -247,12 +251,15 @@ private:
     void draw_lines(int count, int offset) const;
     void draw_triangles(int count, int offset) const;
     void draw_triangle_strip(int count, int offset) const;
+    void draw_instances(int count, int offset) const;
     void setup_shader();
     void setup_vbo();
     void create_vbo_lines();
     void setup_vbo_lines();
     void create_vbo_triangles();
     void setup_vbo_triangles();
+    void create_vbo_instances();
+    void upload_instances() const;
     void triangulate();
     void triangulate_segments();
     void triangulate_vertices_as_segments();
@@ -273,6 +280,10 @@ private:
     std::vector<Color>              m_colors;
     std::unique_ptr<VertexObject>   m_lnVertexObj;
     std::unique_ptr<VertexObject>   m_trVertexObj;
+    //! Template quad of instanced segments
+    std::unique_ptr<VertexObject>   m_quadVertexObj;
+    //! Line vertices of instanced segments
+    unsigned int                    m_instanceBuffer    { 0     };
     const Renderer                 &m_renderer;
     float                           m_width;
     PrimType                        m_primType;
@@ -280,6 +291,7 @@ private:
     VertexFormat                    m_format;
     int                             m_hints             { 0     };
     bool                            m_useTriangles      { false };
+    bool                            m_useInstances      { false };
     bool                            m_triangulated      { false };
     bool                            m_loopDone          { false };
     bool                            m_inUse             { false };
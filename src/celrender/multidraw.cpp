@@ -0,0 +1,96 @@
+// multidraw.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Batches of draw calls of ranges of a vertex buffer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "multidraw.h"
+#include "renderstats.h"
+
+#include <cstddef>
+
+
+namespace celestia::render
+{
+
+MultiDrawArrays::~MultiDrawArrays()
+{
+    if (m_indirectBufferId != 0)
+        glDeleteBuffers(1, &m_indirectBufferId);
+}
+
+void
+MultiDrawArrays::clear() noexcept
+{
+    m_firsts.clear();
+    m_counts.clear();
+    m_commands.clear();
+    m_vertexCount = 0;
+    m_uploaded = false;
+}
+
+void
+MultiDrawArrays::add(GLint first, GLsizei count)
+{
+    if (count <= 0)
+        return;
+
+    m_firsts.push_back(first);
+    m_counts.push_back(count);
+    m_vertexCount += count;
+    if (gl::hasIndirectDraws())
+    {
+        m_commands.push_back({ static_cast<GLuint>(count), 1u, static_cast<GLuint>(first), 0u });
+        m_uploaded = false;
+    }
+}
+
+void
+MultiDrawArrays::upload()
+{
+#ifndef GL_ES
+    if (m_indirectBufferId == 0)
+        glCreateBuffers(1, &m_indirectBufferId);
+    glNamedBufferData(m_indirectBufferId,
+                      static_cast<GLsizeiptr>(m_commands.size() * sizeof(DrawArraysIndirectCommand)),
+                      m_commands.data(),
+                      GL_STREAM_DRAW);
+#endif
+    m_uploaded = true;
+}
+
+void
+MultiDrawArrays::draw(GLenum primitive)
+{
+    if (m_counts.empty())
+        return;
+
+#ifdef GL_ES
+    for (std::size_t i = 0; i < m_counts.size(); i++)
+    {
+        glDrawArrays(primitive, m_firsts[i], m_counts[i]);
+        countDrawCall(primitive, m_counts[i]);
+    }
+#else
+    if (gl::hasIndirectDraws())
+    {
+        if (!m_uploaded)
+            upload();
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBufferId);
+        glMultiDrawArraysIndirect(primitive, nullptr, static_cast<GLsizei>(m_commands.size()), 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    else
+    {
+        glMultiDrawArrays(primitive, m_firsts.data(), m_counts.data(), static_cast<GLsizei>(m_counts.size()));
+    }
+    countDrawCall(primitive, m_vertexCount);
+#endif
+}
+
+} // namespace
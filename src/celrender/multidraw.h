@@ -0,0 +1,80 @@
+// multidraw.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Batches of draw calls of ranges of a vertex buffer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <vector>
+
+#include <celengine/glsupport.h>
+
+namespace celestia::render
+{
+/**
+ * \class MultiDrawArrays multidraw.h celrender/multidraw.h
+ *
+ * @brief Draws a list of vertex ranges of the bound vertex buffer with as few calls as possible.
+ *
+ * With gl::hasIndirectDraws() the ranges are uploaded once to an indirect buffer, however often
+ * they are drawn, and drawn with glMultiDrawArraysIndirect. Desktop GL otherwise draws them
+ * with glMultiDrawArrays and GLES with a call per range.
+ */
+class MultiDrawArrays
+{
+ public:
+    MultiDrawArrays() = default;
+    ~MultiDrawArrays();
+
+    MultiDrawArrays(const MultiDrawArrays&) = delete;
+    MultiDrawArrays(MultiDrawArrays&&) = delete;
+    MultiDrawArrays& operator=(const MultiDrawArrays&) = delete;
+    MultiDrawArrays& operator=(MultiDrawArrays&&) = delete;
+
+    //! Remove all ranges.
+    void clear() noexcept;
+
+    /**
+     * @brief Add a range to draw.
+     *
+     * @param first First vertex of the range.
+     * @param count Number of vertices.
+     */
+    void add(GLint first, GLsizei count);
+
+    //! Return whether there are no ranges to draw.
+    bool empty() const noexcept { return m_counts.empty(); }
+
+    /**
+     * @brief Draw the ranges from the vertex object bound.
+     *
+     * @param primitive OpenGL primitive (GL_POINTS, GL_LINES and so on).
+     */
+    void draw(GLenum primitive);
+
+ private:
+    // Layout of the commands of glMultiDrawArraysIndirect
+    struct DrawArraysIndirectCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint first;
+        GLuint baseInstance;
+    };
+
+    void upload();
+
+    std::vector<GLint>                      m_firsts;
+    std::vector<GLsizei>                    m_counts;
+    std::vector<DrawArraysIndirectCommand>  m_commands;
+    long                                    m_vertexCount      { 0 };
+    GLuint                                  m_indirectBufferId { 0 };
+    bool                                    m_uploaded         { false };
+};
+} // namespace
@@ -0,0 +1,475 @@
+// pickrenderer.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "pickrenderer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+#include <celengine/body.h>
+#include <celengine/dsodb.h>
+#include <celengine/framebuffer.h>
+#include <celengine/framereadback.h>
+#include <celengine/glsupport.h>
+#include <celengine/observer.h>
+#include <celengine/pointstarrenderer.h>
+#include <celengine/pointstarvertexbuffer.h>
+#include <celengine/render.h>
+#include <celengine/shadermanager.h>
+#include <celengine/star.h>
+#include <celengine/stardb.h>
+#include <celengine/universe.h>
+#include <celmath/geomutil.h>
+#include <celmath/mathlib.h>
+#include <celutil/logger.h>
+#include "vertexobject.h"
+
+using celestia::util::GetLogger;
+
+namespace celestia::render
+{
+
+namespace
+{
+
+// The objects are drawn at unit distance from the viewer
+constexpr float TileNearPlane = 0.5f;
+constexpr float TileFarPlane = 2.0f;
+
+constexpr std::uint32_t MaxID = 0xffffff;
+
+// An object to add to the tile, which are drawn in increasing order
+struct PickObject
+{
+    Eigen::Vector3f direction;
+    float size;
+    Selection sel;
+    float order;
+};
+
+// An object drawn as a disc of an angular radius, given as its sine. If the
+// pick ray hits the disc, it's drawn over the whole tile, as its center
+// may be outside of the tile.
+PickObject
+sphereObject(const Eigen::Vector3f &direction,
+             float sinRadius,
+             const Eigen::Vector3f &pickRay,
+             float pixelSize,
+             const Selection &sel,
+             float order)
+{
+    float cosRadius = std::sqrt(std::max(1.0f - sinRadius * sinRadius, 0.0f));
+    if (direction.dot(pickRay) >= cosRadius)
+        return { pickRay, static_cast<float>(PickRenderer::TileSize), sel, order };
+
+    float size = 2.0f * sinRadius / (cosRadius * pixelSize);
+    return { direction, std::max(size, 1.0f), sel, order };
+}
+
+// Collects the distant stars drawn as points, with their apparent
+// magnitudes as order; the nearby stars are in the render list.
+class PickStarCollector : public StarHandler
+{
+public:
+    PickStarCollector(const Eigen::Vector3d &obsPos,
+                      float minDistance,
+                      float maxDistance,
+                      std::vector<PickObject> &objects) :
+        m_obsPos(obsPos),
+        m_minDistance(minDistance),
+        m_maxDistance(maxDistance),
+        m_objects(objects)
+    {
+    }
+
+    void process(const Star &star, float distance, float appMag) override
+    {
+        if (distance < m_minDistance || distance > m_maxDistance)
+            return;
+
+        // As Universe::pick, stars in a multiple star system select their
+        // barycenter
+        Star *picked = star.getOrbitBarycenter();
+        if (picked == nullptr)
+            picked = const_cast<Star*>(&star);
+
+        Eigen::Vector3f relPos = (star.getPosition().cast<double>() - m_obsPos).cast<float>();
+        // The brightest drawn last
+        m_objects.push_back({ relPos.normalized(), 1.0f, Selection(picked), -appMag });
+    }
+
+private:
+    Eigen::Vector3d m_obsPos;
+    float m_minDistance;
+    float m_maxDistance;
+    std::vector<PickObject> &m_objects;
+};
+
+// Collects the deep sky objects which Universe::pick would consider
+class PickDSOCollector : public DSOHandler
+{
+public:
+    PickDSOCollector(const Eigen::Vector3d &obsPos,
+                     const Eigen::Vector3f &pickRay,
+                     std::uint64_t renderFlags,
+                     float pixelSize,
+                     std::vector<PickObject> &objects) :
+        m_obsPos(obsPos),
+        m_pickRay(pickRay),
+        m_renderFlags(renderFlags),
+        m_pixelSize(pixelSize),
+        m_objects(objects)
+    {
+    }
+
+    void process(DeepSkyObject* const &dso, double /*distance*/, float /*appMag*/) override
+    {
+        if ((dso->getRenderMask() & m_renderFlags) == 0 || !dso->isVisible() || !dso->isClickable())
+            return;
+
+        Eigen::Vector3d relPos = dso->getPosition() - m_obsPos;
+        double distance = relPos.norm();
+        // Don't pick the object the observer is in
+        if (distance <= dso->getRadius())
+            return;
+
+        // The smallest drawn last
+        auto sinRadius = static_cast<float>(dso->getRadius() / distance);
+        m_objects.push_back(sphereObject((relPos / distance).cast<float>(), sinRadius,
+                                         m_pickRay, m_pixelSize, Selection(dso), -sinRadius));
+    }
+
+private:
+    Eigen::Vector3d m_obsPos;
+    Eigen::Vector3f m_pickRay;
+    std::uint64_t m_renderFlags;
+    float m_pixelSize;
+    std::vector<PickObject> &m_objects;
+};
+
+} // end unnamed namespace
+
+PickRenderer::PickRenderer(Renderer &renderer) :
+    m_renderer(renderer)
+{
+}
+
+PickRenderer::~PickRenderer() = default;
+
+bool
+PickRenderer::isSupported()
+{
+    return FramebufferObject::isSupported() && FrameReadback::isSupported();
+}
+
+bool
+PickRenderer::init()
+{
+    if (m_fbo != nullptr)
+        return true;
+    if (m_failed || !isSupported())
+        return false;
+
+    m_fbo = std::make_unique<FramebufferObject>(TileSize, TileSize, FramebufferObject::ColorAttachment);
+    m_readback = std::make_unique<FrameReadback>(TileSize, TileSize, PixelFormat::RGBA, Latency + 1);
+    if (!m_fbo->isValid() || !m_readback->isValid())
+    {
+        GetLogger()->warn("Error creating the pick buffer.\n");
+        m_fbo = nullptr;
+        m_readback = nullptr;
+        m_failed = true;
+        return false;
+    }
+
+    m_vo = std::make_unique<VertexObject>(0, GL_STREAM_DRAW);
+    return true;
+}
+
+void
+PickRenderer::render(const Observer &observer,
+                     const Universe &universe,
+                     const Eigen::Vector3f &pickRay,
+                     float tolerance,
+                     std::uint32_t frame)
+{
+    if (!init() || m_readback->isFull())
+        return;
+
+    const Renderer &r = m_renderer;
+    const Eigen::Quaternionf &cameraOrientation = r.getCameraOrientation();
+    Eigen::Quaternionf tileOrientation = Eigen::Quaternionf::FromTwoVectors(pickRay, -Eigen::Vector3f::UnitZ()) *
+                                         cameraOrientation;
+    m_pickRay = cameraOrientation.conjugate() * pickRay;
+    // One pixel of the tile is the size of one of the view
+    float fov = 2.0f * std::atan(0.5f * static_cast<float>(TileSize) * r.pixelSize);
+
+    m_vertices.clear();
+    m_objects.clear();
+
+    Eigen::Vector3d obsPos = observer.getPosition().toLy();
+    if ((r.renderFlags & Renderer::ShowDeepSpaceObjects) != 0 && universe.getDSOCatalog() != nullptr)
+        addDeepSkyObjects(*universe.getDSOCatalog(), obsPos, tileOrientation, fov);
+    if ((r.renderFlags & Renderer::ShowStars) != 0 && universe.getStarCatalog() != nullptr)
+        addStars(*universe.getStarCatalog(), obsPos, tileOrientation, fov);
+    addRenderListEntries();
+
+    if (draw(tileOrientation, fov))
+        m_tiles.push_back({ frame, std::min(tolerance, static_cast<float>(TileSize / 2)), std::move(m_objects) });
+    m_objects.clear();
+}
+
+void
+PickRenderer::add(const Eigen::Vector3f &direction, float size, const Selection &sel)
+{
+    if (m_objects.size() == MaxID)
+        return;
+
+    m_objects.push_back(sel);
+    PickVertex &v = m_vertices.emplace_back();
+    v.position = direction;
+    v.size = size;
+    encodeID(static_cast<std::uint32_t>(m_objects.size()), v.color);
+}
+
+void
+PickRenderer::addDeepSkyObjects(const DSODatabase &dsoDB,
+                                const Eigen::Vector3d &obsPos,
+                                const Eigen::Quaternionf &tileOrientation,
+                                float fov)
+{
+    const Renderer &r = m_renderer;
+    std::vector<PickObject> objects;
+    PickDSOCollector collector(obsPos, m_pickRay, r.renderFlags, r.pixelSize, objects);
+    dsoDB.findVisibleDSOs(collector, obsPos, tileOrientation, fov, 1.0f, 2.0f * r.faintestMag);
+    std::sort(objects.begin(), objects.end(),
+              [](const PickObject &a, const PickObject &b) { return a.order < b.order; });
+    for (const PickObject &object : objects)
+        add(object.direction, object.size, object.sel);
+}
+
+void
+PickRenderer::addStars(const StarDatabase &starDB,
+                       const Eigen::Vector3d &obsPos,
+                       const Eigen::Quaternionf &tileOrientation,
+                       float fov)
+{
+    const Renderer &r = m_renderer;
+    std::vector<PickObject> objects;
+    float pointSize = BaseStarDiscSize * static_cast<float>(r.getScreenDpi()) / 96.0f;
+    PickStarCollector collector(obsPos, r.SolarSystemMaxDistance, r.distanceLimit, objects);
+    starDB.findVisibleStars(collector,
+                            obsPos.cast<float>(),
+                            tileOrientation,
+                            fov,
+                            1.0f,
+                            r.faintestMag - r.qualityGovernor.starMagnitudeOffset());
+
+    // Their sizes as drawn by the point star renderer
+    for (PickObject &object : objects)
+    {
+        float alpha, glareSize, glareAlpha;
+        r.calculatePointSize(-object.order, pointSize, object.size, alpha, glareSize, glareAlpha);
+        object.size = std::max(object.size, 1.0f);
+    }
+    std::sort(objects.begin(), objects.end(),
+              [](const PickObject &a, const PickObject &b) { return a.order < b.order; });
+    for (const PickObject &object : objects)
+        add(object.direction, object.size, object.sel);
+}
+
+void
+PickRenderer::addRenderListEntries()
+{
+    const Renderer &r = m_renderer;
+    std::vector<PickObject> objects;
+    for (const RenderListEntry &rle : r.renderList)
+    {
+        Selection sel;
+        if (rle.renderableType == RenderListEntry::RenderableBody && rle.body->isClickable())
+            sel = Selection(rle.body);
+        else if (rle.renderableType == RenderListEntry::RenderableStar)
+            sel = Selection(const_cast<Star*>(rle.star));
+        else
+            continue;
+
+        if (rle.distance > rle.radius)
+        {
+            // The nearest drawn last
+            objects.push_back(sphereObject(rle.position / rle.distance, rle.radius / rle.distance,
+                                           m_pickRay, r.pixelSize, sel, -rle.distance));
+        }
+    }
+    std::sort(objects.begin(), objects.end(),
+              [](const PickObject &a, const PickObject &b) { return a.order < b.order; });
+    for (const PickObject &object : objects)
+        add(object.direction, object.size, object.sel);
+}
+
+bool
+PickRenderer::draw(const Eigen::Quaternionf &tileOrientation, float fov)
+{
+    GLint oldFboId;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFboId);
+    std::array<int, 4> viewport;
+    m_renderer.getViewport(viewport);
+    std::array<GLfloat, 4> clearColor;
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor.data());
+
+    m_fbo->bind();
+#ifndef GL_ES
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+#endif
+    // The scissor box is that of the view, not of the tile
+    bool scissor = m_renderer.m_pipelineState.scissor;
+    if (scissor)
+        glDisable(GL_SCISSOR_TEST);
+    glViewport(0, 0, TileSize, TileSize);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    ShaderProperties shadprop;
+    shadprop.texUsage = ShaderProperties::VertexColors | ShaderProperties::PointSprite;
+    shadprop.lightModel = ShaderProperties::UnlitModel;
+    shadprop.fishEyeOverride = ShaderProperties::FisheyeOverrideModeDisabled;
+    CelestiaGLProgram *prog = m_renderer.getShaderManager().getShader(shadprop);
+
+    if (prog != nullptr && !m_vertices.empty())
+    {
+        Eigen::Matrix4f projection = celmath::Perspective(celmath::radToDeg(fov), 1.0f,
+                                                          TileNearPlane, TileFarPlane);
+        Eigen::Matrix4f modelView = Eigen::Affine3f(tileOrientation).matrix();
+
+        // Colors are IDs, so they mustn't be blended
+        Renderer::PipelineState ps;
+        m_renderer.setPipelineState(ps);
+
+        if (m_vo->initialized())
+        {
+            m_vo->bindWritable();
+        }
+        else
+        {
+            m_vo->bind();
+            m_vo->setVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex,
+                                       3, GL_FLOAT, false, sizeof(PickVertex),
+                                       offsetof(PickVertex, position));
+            m_vo->setVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex,
+                                       4, GL_UNSIGNED_BYTE, true, sizeof(PickVertex),
+                                       offsetof(PickVertex, color));
+            m_vo->setVertexAttribArray(CelestiaGLProgram::PointSizeAttributeIndex,
+                                       1, GL_FLOAT, false, sizeof(PickVertex),
+                                       offsetof(PickVertex, size));
+        }
+        m_vo->allocate(static_cast<GLsizeiptr>(m_vertices.size() * sizeof(PickVertex)), m_vertices.data());
+
+        prog->use();
+        prog->setMVPMatrices(projection, modelView);
+        prog->pointScale = 1.0f;
+
+        PointStarVertexBuffer::enable();
+        m_vo->draw(GL_POINTS, static_cast<GLsizei>(m_vertices.size()));
+        PointStarVertexBuffer::disable();
+        m_vo->unbind();
+    }
+
+    bool queued = m_readback->read(0, 0);
+
+    if (scissor)
+        glEnable(GL_SCISSOR_TEST);
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    m_fbo->unbind(oldFboId);
+    m_renderer.setViewport(viewport);
+
+    return queued;
+}
+
+void
+PickRenderer::update(std::uint32_t frame)
+{
+    while (!m_tiles.empty() && frame - m_tiles.front().frame >= Latency)
+    {
+        const Tile &tile = m_tiles.front();
+        std::ptrdiff_t stride;
+        if (const std::uint8_t *top = m_readback->map(stride); top != nullptr)
+        {
+            std::uint32_t id = findNearestID(top, stride, TileSize, tile.radius);
+            m_result = id == 0 || id > tile.objects.size() ? Selection() : tile.objects[id - 1];
+            m_hasResult = true;
+        }
+
+        m_readback->release();
+        m_tiles.pop_front();
+    }
+}
+
+bool
+PickRenderer::getResult(Selection &sel) const
+{
+    if (!m_hasResult)
+        return false;
+
+    sel = m_result;
+    return true;
+}
+
+void
+PickRenderer::encodeID(std::uint32_t id, std::uint8_t *color)
+{
+    color[0] = static_cast<std::uint8_t>(id >> 16);
+    color[1] = static_cast<std::uint8_t>(id >> 8);
+    color[2] = static_cast<std::uint8_t>(id);
+    color[3] = 0xff;
+}
+
+std::uint32_t
+PickRenderer::decodeID(const std::uint8_t *color)
+{
+    return (static_cast<std::uint32_t>(color[0]) << 16) |
+           (static_cast<std::uint32_t>(color[1]) << 8) |
+           static_cast<std::uint32_t>(color[2]);
+}
+
+std::uint32_t
+PickRenderer::findNearestID(const std::uint8_t *top,
+                            std::ptrdiff_t stride,
+                            int size,
+                            float radius)
+{
+    int center = size / 2;
+    float maxDistance2 = radius * radius;
+    int nearestDistance2 = 0;
+    std::uint32_t nearest = 0;
+
+    for (int y = 0; y < size; y++)
+    {
+        const std::uint8_t *row = top + y * stride;
+        for (int x = 0; x < size; x++)
+        {
+            std::uint32_t id = decodeID(row + 4 * x);
+            if (id == 0)
+                continue;
+
+            int distance2 = (x - center) * (x - center) + (y - center) * (y - center);
+            if (static_cast<float>(distance2) > maxDistance2 ||
+                (nearest != 0 && distance2 >= nearestDistance2))
+            {
+                continue;
+            }
+
+            nearest = id;
+            nearestDistance2 = distance2;
+        }
+    }
+
+    return nearest;
+}
+
+} // end namespace celestia::render
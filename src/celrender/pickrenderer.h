@@ -0,0 +1,134 @@
+// pickrenderer.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celengine/selection.h>
+
+class DSODatabase;
+class FrameReadback;
+class FramebufferObject;
+class Observer;
+class Renderer;
+class StarDatabase;
+class Universe;
+
+namespace celestia::render
+{
+class VertexObject;
+
+// Picks objects on the GPU. The objects around a pick ray are drawn as
+// points colored with their IDs into a small offscreen tile centered on
+// the ray, which is read back through pixel pack buffers a few frames
+// later, so that picking in every frame, e.g. to highlight the object
+// under the mouse, neither stalls the GPU nor searches the catalogs.
+// The picked object is the one drawn at the pixel nearest to the center
+// of the tile; objects are drawn in the order they're added, so the last
+// one covering a pixel wins.
+class PickRenderer
+{
+public:
+    // Width of the tile in pixels, which bounds the pick tolerance
+    static constexpr int TileSize = 17;
+    // Frames drawn after a tile before it's read back
+    static constexpr std::uint32_t Latency = 2;
+
+    explicit PickRenderer(Renderer &renderer);
+    ~PickRenderer();
+    PickRenderer() = delete;
+    PickRenderer(const PickRenderer&) = delete;
+    PickRenderer(PickRenderer&&) = delete;
+    PickRenderer& operator=(const PickRenderer&) = delete;
+    PickRenderer& operator=(PickRenderer&&) = delete;
+
+    static bool isSupported();
+
+    // Draw the tile of a view around a pick ray in camera coordinates and
+    // queue it for reading back. The tolerance is the distance in pixels
+    // from the ray within which objects are picked. As Universe::pick,
+    // bodies are preferred to stars and stars to deep sky objects.
+    void render(const Observer &observer,
+                const Universe &universe,
+                const Eigen::Vector3f &pickRay,
+                float tolerance,
+                std::uint32_t frame);
+
+    // Decode the tiles drawn at least Latency frames before
+    void update(std::uint32_t frame);
+
+    // The object found in the latest tile read back, which may be empty;
+    // false if no tile was read back yet.
+    bool getResult(Selection &sel) const;
+
+    // The objects of a tile are numbered from 1 in a 24 bit RGB color, 0
+    // being the background.
+    static void encodeID(std::uint32_t id, std::uint8_t *color);
+    static std::uint32_t decodeID(const std::uint8_t *color);
+    // The ID at the pixel nearest to the center of a tile of RGBA pixels
+    // whose top row is at top, within radius pixels of the center, or 0.
+    static std::uint32_t findNearestID(const std::uint8_t *top,
+                                       std::ptrdiff_t stride,
+                                       int size,
+                                       float radius);
+
+private:
+    struct PickVertex
+    {
+        Eigen::Vector3f position;
+        float size;
+        std::uint8_t color[4];
+    };
+
+    struct Tile
+    {
+        std::uint32_t frame;
+        float radius;
+        std::vector<Selection> objects;
+    };
+
+    bool init();
+    // Add an object in the direction of a unit vector in world
+    // orientation, drawn as a square of size pixels
+    void add(const Eigen::Vector3f &direction, float size, const Selection &sel);
+    void addDeepSkyObjects(const DSODatabase &dsoDB,
+                           const Eigen::Vector3d &obsPos,
+                           const Eigen::Quaternionf &tileOrientation,
+                           float fov);
+    void addStars(const StarDatabase &starDB,
+                  const Eigen::Vector3d &obsPos,
+                  const Eigen::Quaternionf &tileOrientation,
+                  float fov);
+    void addRenderListEntries();
+    // Draw the objects added and read the tile back
+    bool draw(const Eigen::Quaternionf &tileOrientation, float fov);
+
+    Renderer                                &m_renderer;
+    std::unique_ptr<FramebufferObject>       m_fbo;
+    std::unique_ptr<FrameReadback>           m_readback;
+    std::unique_ptr<VertexObject>            m_vo;
+    bool                                     m_failed       { false };
+    // Pick ray in world orientation
+    Eigen::Vector3f                          m_pickRay      { -Eigen::Vector3f::UnitZ() };
+    std::vector<PickVertex>                  m_vertices;
+    std::vector<Selection>                   m_objects;
+    std::deque<Tile>                         m_tiles;
+    Selection                                m_result;
+    bool                                     m_hasResult    { false };
+};
+
+} // end namespace celestia::render
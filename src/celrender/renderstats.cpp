@@ -0,0 +1,44 @@
+// renderstats.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "renderstats.h"
+
+#include <celengine/glsupport.h>
+
+namespace celestia::render
+{
+
+RenderStats frameStats;
+
+void
+countDrawCall(unsigned int primitive, long count, long instances)
+{
+    ++frameStats.drawCalls;
+    if (count <= 0 || instances <= 0)
+        return;
+
+    switch (primitive)
+    {
+    case GL_TRIANGLES:
+        frameStats.triangles += static_cast<unsigned long>(count / 3 * instances);
+        break;
+    case GL_TRIANGLE_STRIP:
+    case GL_TRIANGLE_FAN:
+        if (count > 2)
+            frameStats.triangles += static_cast<unsigned long>((count - 2) * instances);
+        break;
+    case GL_POINTS:
+        frameStats.points += static_cast<unsigned long>(count * instances);
+        break;
+    default:
+        break;
+    }
+}
+
+} // end namespace celestia::render
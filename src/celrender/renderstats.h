@@ -0,0 +1,41 @@
+// renderstats.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Counters of the GL work done to draw a frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+namespace celestia::render
+{
+
+struct RenderStats
+{
+    // Draw calls of any kind, instanced ones counting once
+    unsigned int drawCalls{ 0 };
+    // glUseProgram calls which switched to another program
+    unsigned int programChanges{ 0 };
+    // Pipeline state changes: blending, depth test and mask, smoothing
+    unsigned int stateChanges{ 0 };
+    // Primitives drawn, counting each instance, where the draw call
+    // reports them
+    unsigned long triangles{ 0 };
+    unsigned long points{ 0 };
+    // Bytes the annotation labels took from the renderer's frame arena
+    unsigned long arenaBytes{ 0 };
+};
+
+// Counters of the frame being drawn. They are only updated on the render
+// thread; CelestiaCore::draw() resets them at the start of each frame.
+extern RenderStats frameStats;
+
+inline void countDrawCall() { ++frameStats.drawCalls; }
+// Count a draw call of count vertices of a GL primitive type
+void countDrawCall(unsigned int primitive, long count, long instances = 1);
+
+} // end namespace celestia::render
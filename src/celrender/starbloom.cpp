@@ -0,0 +1,251 @@
+// starbloom.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Glare of the bright stars as a blur of their light.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "starbloom.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include <celengine/render.h>
+#include <celengine/shadermanager.h>
+#include <celutil/color.h>
+#include <celutil/logger.h>
+#include "texturememory.h"
+
+using celestia::util::GetLogger;
+
+
+namespace celestia::render
+{
+
+namespace
+{
+// Ratio of the view resolution to that of the bloom targets
+constexpr GLsizei Downsample = 4;
+
+// Light of a glare sprite relative to that of a square of its size
+constexpr float GlareSpriteFill = 0.25f;
+
+// Stars streamed per draw call, well within the stream buffer
+constexpr std::size_t MaxStarsPerDraw = 16384;
+
+// Two RGBA half float textures
+constexpr std::size_t BytesPerTexel = 16;
+
+const float QuadVertices[] =
+{
+    // positions   // texCoords
+    -1.0f,  1.0f,  0.0f, 1.0f,
+    -1.0f, -1.0f,  0.0f, 0.0f,
+     1.0f, -1.0f,  1.0f, 0.0f,
+
+    -1.0f,  1.0f,  0.0f, 1.0f,
+     1.0f, -1.0f,  1.0f, 0.0f,
+     1.0f,  1.0f,  1.0f, 1.0f
+};
+} // end unnamed namespace
+
+StarBloom::StarBloom(StreamBuffer& streamBuffer) :
+    m_pointsVO(streamBuffer),
+    m_quadVO(0, GL_STATIC_DRAW)
+{
+}
+
+StarBloom::~StarBloom()
+{
+    destroy();
+}
+
+void
+StarBloom::clear() noexcept
+{
+    m_vertices.clear();
+}
+
+void
+StarBloom::addStar(const Eigen::Vector3f& position, const Color& color, float size)
+{
+    // The light of the sprite goes to a single texel, so the blurred glare
+    // gets about as much of it
+    float light = color.alpha() * size * size * GlareSpriteFill /
+                  static_cast<float>(Downsample * Downsample);
+    m_vertices.push_back({ position, { color.red() * light, color.green() * light, color.blue() * light } });
+}
+
+bool
+StarBloom::render(Renderer& renderer)
+{
+    if (m_vertices.empty())
+        return true;
+
+    CelestiaGLProgram* pointProg = renderer.getShaderManager().getShader("bloompoint");
+    CelestiaGLProgram* blurProg = renderer.getShaderManager().getShader("bloomblur");
+    CelestiaGLProgram* compositeProg = renderer.getShaderManager().getShader("passthrough");
+    if (pointProg == nullptr || blurProg == nullptr || compositeProg == nullptr)
+        return false;
+
+    GLint oldFboId = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFboId);
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    bool scissor = glIsEnabled(GL_SCISSOR_TEST) == GL_TRUE;
+
+    GLsizei width = std::max(viewport[2] / Downsample, 1);
+    GLsizei height = std::max(viewport[3] / Downsample, 1);
+    if (width != m_width || height != m_height)
+    {
+        destroy();
+        if (!create(width, height))
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, oldFboId);
+            return false;
+        }
+    }
+
+    if (scissor)
+        glDisable(GL_SCISSOR_TEST);
+    glViewport(0, 0, width, height);
+
+    // Add the light of the stars
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fboIds[0]);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    Renderer::PipelineState ps;
+    ps.blending = true;
+    ps.blendFunc = { GL_ONE, GL_ONE };
+    renderer.setPipelineState(ps);
+
+    if (!m_pointsVO.initialized())
+    {
+        m_pointsVO.bind();
+        m_pointsVO.setVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex,
+                                        3, GL_FLOAT, false, sizeof(Vertex), offsetof(Vertex, position));
+        m_pointsVO.setVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex,
+                                        3, GL_FLOAT, false, sizeof(Vertex), offsetof(Vertex, color));
+    }
+    else
+    {
+        m_pointsVO.bindWritable();
+    }
+
+    pointProg->use();
+    pointProg->setMVPMatrices(renderer.getCurrentProjectionMatrix(), renderer.getCurrentModelViewMatrix());
+    for (std::size_t i = 0; i < m_vertices.size(); i += MaxStarsPerDraw)
+    {
+        auto count = static_cast<GLsizei>(std::min(MaxStarsPerDraw, m_vertices.size() - i));
+        GLint first = m_pointsVO.stream(m_vertices.data() + i, count, sizeof(Vertex));
+        if (first >= 0)
+            m_pointsVO.draw(GL_POINTS, count, first);
+    }
+    m_pointsVO.unbind();
+
+    // Blur horizontally into the second target, then vertically back
+    renderer.setPipelineState(Renderer::PipelineState());
+    m_quadVO.bind();
+    if (!m_quadVO.initialized())
+    {
+        m_quadVO.allocate(sizeof(QuadVertices), QuadVertices);
+        m_quadVO.setVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex,
+                                      2, GL_FLOAT, false, 4 * sizeof(float), 0);
+        m_quadVO.setVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex,
+                                      2, GL_FLOAT, false, 4 * sizeof(float), 2 * sizeof(float));
+    }
+
+    blurProg->use();
+    blurProg->samplerParam("tex") = 0;
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fboIds[1]);
+    glBindTexture(GL_TEXTURE_2D, m_textureIds[0]);
+    blurProg->floatParam("stepX") = 1.0f / static_cast<float>(width);
+    blurProg->floatParam("stepY") = 0.0f;
+    drawQuad();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fboIds[0]);
+    glBindTexture(GL_TEXTURE_2D, m_textureIds[1]);
+    blurProg->floatParam("stepX") = 0.0f;
+    blurProg->floatParam("stepY") = 1.0f / static_cast<float>(height);
+    drawQuad();
+
+    // Add the glares to the view
+    glBindFramebuffer(GL_FRAMEBUFFER, oldFboId);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    if (scissor)
+        glEnable(GL_SCISSOR_TEST);
+    renderer.setPipelineState(ps);
+
+    compositeProg->use();
+    compositeProg->samplerParam("tex") = 0;
+    glBindTexture(GL_TEXTURE_2D, m_textureIds[0]);
+    drawQuad();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    m_quadVO.unbind();
+
+    return true;
+}
+
+bool
+StarBloom::create(GLsizei width, GLsizei height)
+{
+    m_width = width;
+    m_height = height;
+
+    glGenTextures(2, m_textureIds);
+    glGenFramebuffers(2, m_fboIds);
+    for (int i = 0; i < 2; i++)
+    {
+        glBindTexture(GL_TEXTURE_2D, m_textureIds[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, nullptr);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, m_fboIds[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_textureIds[i], 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            GetLogger()->error("Error creating {}x{} half float framebuffer for star glares.\n",
+                               width, height);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            destroy();
+            return false;
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    m_memorySize = static_cast<std::size_t>(width) * static_cast<std::size_t>(height) * BytesPerTexel;
+    addTextureMemory(TextureMemoryCategory::Framebuffers, m_memorySize);
+    return true;
+}
+
+void
+StarBloom::destroy()
+{
+    if (m_fboIds[0] != 0)
+        glDeleteFramebuffers(2, m_fboIds);
+    if (m_textureIds[0] != 0)
+        glDeleteTextures(2, m_textureIds);
+    removeTextureMemory(TextureMemoryCategory::Framebuffers, m_memorySize);
+
+    m_fboIds[0] = m_fboIds[1] = 0;
+    m_textureIds[0] = m_textureIds[1] = 0;
+    m_width = 0;
+    m_height = 0;
+    m_memorySize = 0;
+}
+
+void
+StarBloom::drawQuad()
+{
+    m_quadVO.draw(GL_TRIANGLES, 6);
+}
+
+} // namespace
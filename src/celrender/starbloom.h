@@ -0,0 +1,94 @@
+// starbloom.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Glare of the bright stars as a blur of their light.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celengine/glsupport.h>
+#include "vertexobject.h"
+
+class Color;
+class Renderer;
+
+namespace celestia::render
+{
+class StreamBuffer;
+
+/**
+ * \class StarBloom starbloom.h celrender/starbloom.h
+ *
+ * @brief Draws the glare of the stars as a blurred image of their light instead of a sprite per
+ * star.
+ *
+ * The light of each star is added to a single texel of a half float target at a quarter of the
+ * view resolution, which is blurred with a separable Gaussian filter and added to the view.
+ * However many glares overlap, only the texels of the stars are written besides the blur and
+ * composite passes, which cost the same for any number of stars.
+ */
+class StarBloom
+{
+ public:
+    explicit StarBloom(StreamBuffer& streamBuffer);
+    ~StarBloom();
+
+    StarBloom(const StarBloom&) = delete;
+    StarBloom(StarBloom&&) = delete;
+    StarBloom& operator=(const StarBloom&) = delete;
+    StarBloom& operator=(StarBloom&&) = delete;
+
+    //! Remove the stars added for the previous view.
+    void clear() noexcept;
+
+    /**
+     * @brief Add the glare of a star.
+     *
+     * @param position Position of the star in the coordinates of the modelview matrix.
+     * @param color Color and opacity of the glare sprite which the glare replaces.
+     * @param size Size of that sprite in pixels.
+     */
+    void addStar(const Eigen::Vector3f& position, const Color& color, float size);
+
+    //! Return whether there are no glares to draw.
+    bool empty() const noexcept { return m_vertices.empty(); }
+
+    /**
+     * @brief Draw the glares of the stars added into the viewport of the framebuffer bound, with
+     * the current matrices of the renderer.
+     *
+     * @return false if the bloom targets can't be created.
+     */
+    bool render(Renderer& renderer);
+
+ private:
+    struct Vertex
+    {
+        Eigen::Vector3f position;
+        float color[3];
+    };
+
+    bool create(GLsizei width, GLsizei height);
+    void destroy();
+    void drawQuad();
+
+    std::vector<Vertex> m_vertices;
+    VertexObject        m_pointsVO;
+    VertexObject        m_quadVO;
+    GLuint              m_textureIds[2] { 0, 0 };
+    GLuint              m_fboIds[2]     { 0, 0 };
+    GLsizei             m_width         { 0 };
+    GLsizei             m_height        { 0 };
+    std::size_t         m_memorySize    { 0 };
+};
+} // namespace
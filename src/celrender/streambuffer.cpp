@@ -0,0 +1,177 @@
+// streambuffer.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Ring buffer shared by the producers of vertex data streamed each frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "streambuffer.h"
+
+#include <cstring>
+
+
+namespace celestia::render
+{
+
+namespace
+{
+#ifdef GL_ES
+constexpr GLbitfield MappingFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT_EXT | GL_MAP_COHERENT_BIT_EXT;
+#else
+constexpr GLbitfield MappingFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+#endif
+
+// Wait for a fence for up to a second at a time
+constexpr GLuint64 FenceTimeout = 1000000000;
+} // end unnamed namespace
+
+StreamBuffer::StreamBuffer(GLsizeiptr size) :
+    m_size(size)
+{
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    for (const Fence& fence : m_fences)
+        glDeleteSync(fence.sync);
+
+    if (m_bufferId == 0)
+        return;
+
+    if (m_mapping != nullptr)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, m_bufferId);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &m_bufferId);
+}
+
+void
+StreamBuffer::bind() noexcept
+{
+    if (m_bufferId == 0)
+        create();
+    else
+        glBindBuffer(GL_ARRAY_BUFFER, m_bufferId);
+}
+
+void
+StreamBuffer::create() noexcept
+{
+    glGenBuffers(1, &m_bufferId);
+    glBindBuffer(GL_ARRAY_BUFFER, m_bufferId);
+    if (!gl::ARB_buffer_storage)
+        return;
+
+#ifdef GL_ES
+    glBufferStorageEXT(GL_ARRAY_BUFFER, m_size, nullptr, MappingFlags);
+#else
+    glBufferStorage(GL_ARRAY_BUFFER, m_size, nullptr, MappingFlags);
+#endif
+    m_mapping = static_cast<std::byte*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, m_size, MappingFlags));
+    if (m_mapping == nullptr)
+    {
+        // The storage is immutable, so orphaning needs a new buffer
+        glDeleteBuffers(1, &m_bufferId);
+        glGenBuffers(1, &m_bufferId);
+        glBindBuffer(GL_ARRAY_BUFFER, m_bufferId);
+    }
+}
+
+GLintptr
+StreamBuffer::write(const void* data, GLsizeiptr size, GLsizeiptr alignment) noexcept
+{
+    if (size > m_size)
+        return -1;
+
+    // Data never needs to wrap around in an empty ring
+    if (m_mapping != nullptr && m_used == 0)
+        m_head = 0;
+
+    GLintptr offset = (m_head + alignment - 1) / alignment * alignment;
+    bool wrap = offset + size > m_size;
+    if (wrap)
+        offset = 0;
+
+    if (m_mapping == nullptr)
+    {
+        if (m_orphan || wrap)
+        {
+            glBufferData(GL_ARRAY_BUFFER, m_size, nullptr, GL_STREAM_DRAW);
+            m_orphan = false;
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+        m_head = offset + size;
+        return offset;
+    }
+
+    // The bytes skipped at the end of the ring count as written, so that
+    // the used bytes always end at the head
+    GLsizeiptr written = (wrap ? m_size - m_head : offset - m_head) + size;
+    while (m_used + written > m_size)
+    {
+        // When this frame alone fills the ring the GPU has to finish the
+        // draw calls issued for it so far
+        if (m_fences.empty())
+            addFence();
+        waitForOldestFence();
+    }
+
+    std::memcpy(m_mapping + offset, data, static_cast<std::size_t>(size));
+    m_used += written;
+    m_unfenced += written;
+    m_head = offset + size;
+    return offset;
+}
+
+void
+StreamBuffer::beginFrame() noexcept
+{
+    m_orphan = true;
+    if (m_mapping == nullptr)
+        return;
+
+    if (m_unfenced != 0)
+        addFence();
+
+    // Release the data of the frames the GPU is done with
+    while (!m_fences.empty())
+    {
+        GLenum result = glClientWaitSync(m_fences.front().sync, 0, 0);
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+            break;
+        glDeleteSync(m_fences.front().sync);
+        m_used -= m_fences.front().size;
+        m_fences.pop_front();
+    }
+}
+
+void
+StreamBuffer::addFence() noexcept
+{
+    m_fences.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), m_unfenced });
+    m_unfenced = 0;
+}
+
+void
+StreamBuffer::waitForOldestFence() noexcept
+{
+    const Fence& fence = m_fences.front();
+    for (;;)
+    {
+        GLenum result = glClientWaitSync(fence.sync, GL_SYNC_FLUSH_COMMANDS_BIT, FenceTimeout);
+        if (result != GL_TIMEOUT_EXPIRED)
+            break;
+    }
+
+    glDeleteSync(fence.sync);
+    m_used -= fence.size;
+    m_fences.pop_front();
+}
+
+} // namespace
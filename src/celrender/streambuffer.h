@@ -0,0 +1,94 @@
+// streambuffer.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Ring buffer shared by the producers of vertex data streamed each frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <deque>
+
+#include <celengine/glsupport.h>
+
+namespace celestia::render
+{
+/**
+ * \class StreamBuffer streambuffer.h celrender/streambuffer.h
+ *
+ * @brief Ring of GPU memory which the vertex data streamed each frame is copied to.
+ *
+ * With ARB_buffer_storage the buffer is mapped persistently and coherently and the data is
+ * copied to the mapping; a fence at the start of each frame tells when the GPU is done with the
+ * data of the previous one, and writes wait for it only when the ring is full. Otherwise the
+ * data is copied with glBufferSubData and the buffer is orphaned when it wraps around and at
+ * the start of each frame.
+ */
+class StreamBuffer
+{
+ public:
+    /**
+     * @brief Construct a new StreamBuffer.
+     *
+     * No GL objects are created until the buffer is first bound.
+     * @param size Ring size in bytes.
+     */
+    explicit StreamBuffer(GLsizeiptr size);
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer(StreamBuffer&&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(StreamBuffer&&) = delete;
+
+    //! Bind the buffer to GL_ARRAY_BUFFER, creating it on first use.
+    void bind() noexcept;
+
+    /**
+     * @brief Copy data to the buffer.
+     *
+     * The data is placed at a multiple of alignment, so with the vertex stride as alignment
+     * the offset divided by the stride is the first vertex to draw from vertex attributes
+     * defined at the start of the buffer. The buffer must be bound.
+     *
+     * @param data Pointer to CPU side memory buffer with vertex data.
+     * @param size Total number of bytes to copy.
+     * @param alignment Alignment of the offset in bytes.
+     * @return Offset of the data in the buffer, or -1 if it is larger than the buffer.
+     */
+    GLintptr write(const void* data, GLsizeiptr size, GLsizeiptr alignment) noexcept;
+
+    //! Start the writes of a new frame, after all draw calls of the previous one.
+    void beginFrame() noexcept;
+
+    //! Return whether the buffer is mapped persistently; false until it is bound.
+    bool isPersistent() const noexcept { return m_mapping != nullptr; }
+
+ private:
+    struct Fence
+    {
+        GLsync sync;
+        GLsizeiptr size; // bytes written before it since the previous fence
+    };
+
+    void create() noexcept;
+    void addFence() noexcept;
+    void waitForOldestFence() noexcept;
+
+    GLuint             m_bufferId   { 0 };
+    GLsizeiptr         m_size;
+    GLintptr           m_head       { 0 };
+    // Bytes in the ring which the GPU may still read, and the part of them
+    // written since the last fence
+    GLsizeiptr         m_used       { 0 };
+    GLsizeiptr         m_unfenced   { 0 };
+    std::deque<Fence>  m_fences;
+    std::byte*         m_mapping    { nullptr };
+    bool               m_orphan     { true };
+};
+} // namespace
@@ -0,0 +1,24 @@
+// texturememory.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <numeric>
+
+#include "texturememory.h"
+
+namespace celestia::render
+{
+
+std::array<std::size_t, static_cast<std::size_t>(TextureMemoryCategory::Count)> textureMemory{};
+
+std::size_t getTotalTextureMemory()
+{
+    return std::accumulate(textureMemory.begin(), textureMemory.end(), std::size_t(0));
+}
+
+} // end namespace celestia::render
@@ -0,0 +1,53 @@
+// texturememory.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Accounting of the GPU memory taken by textures.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+namespace celestia::render
+{
+
+enum class TextureMemoryCategory
+{
+    // Texture objects: loaded and procedural textures, virtual texture
+    // tiles and atlases
+    Textures     = 0,
+    // Glyph textures of fonts
+    Fonts        = 1,
+    // Color and depth textures of framebuffer objects, such as shadow maps
+    Framebuffers = 2,
+    Count        = 3,
+};
+
+// Sizes are estimated from the dimensions and formats of the uploaded
+// levels; drivers may pad them. Only updated on the render thread.
+extern std::array<std::size_t, static_cast<std::size_t>(TextureMemoryCategory::Count)> textureMemory;
+
+inline void addTextureMemory(TextureMemoryCategory category, std::size_t size)
+{
+    textureMemory[static_cast<std::size_t>(category)] += size;
+}
+
+inline void removeTextureMemory(TextureMemoryCategory category, std::size_t size)
+{
+    textureMemory[static_cast<std::size_t>(category)] -= size;
+}
+
+inline std::size_t getTextureMemory(TextureMemoryCategory category)
+{
+    return textureMemory[static_cast<std::size_t>(category)];
+}
+
+std::size_t getTotalTextureMemory();
+
+} // end namespace celestia::render
@@ -9,6 +9,8 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include "renderstats.h"
+#include "streambuffer.h"
 #include "vertexobject.h"
 
 #include <cassert>
@@ -38,17 +40,24 @@ VertexObject::VertexObject(GLsizeiptr bufferSize, GLenum streamType) :
 {
 }
 
+VertexObject::VertexObject(StreamBuffer& streamBuffer) :
+    m_streamBuffer(&streamBuffer)
+{
+}
+
 VertexObject::VertexObject(VertexObject &&other) noexcept :
     m_attribParams(std::move(other.m_attribParams)),
     m_vboId(other.m_vboId),
     m_vaoId(other.m_vaoId),
     m_bufferSize(other.m_bufferSize),
-    m_streamType(other.m_streamType)
+    m_streamType(other.m_streamType),
+    m_streamBuffer(other.m_streamBuffer)
 {
-    other.m_vboId      = 0;
-    other.m_vaoId      = 0;
-    other.m_bufferSize = 0;
-    other.m_streamType = 0;
+    other.m_vboId        = 0;
+    other.m_vaoId        = 0;
+    other.m_bufferSize   = 0;
+    other.m_streamType   = 0;
+    other.m_streamBuffer = nullptr;
 }
 
 VertexObject& VertexObject::operator=(VertexObject &&other) noexcept
@@ -60,11 +69,13 @@ VertexObject& VertexObject::operator=(VertexObject &&other) noexcept
     m_vaoId        = other.m_vaoId;
     m_bufferSize   = other.m_bufferSize;
     m_streamType   = other.m_streamType;
+    m_streamBuffer = other.m_streamBuffer;
 
-    other.m_vboId      = 0;
-    other.m_vaoId      = 0;
-    other.m_bufferSize = 0;
-    other.m_streamType = 0;
+    other.m_vboId        = 0;
+    other.m_vaoId        = 0;
+    other.m_bufferSize   = 0;
+    other.m_streamType   = 0;
+    other.m_streamBuffer = nullptr;
 
     return *this;
 }
@@ -84,8 +95,9 @@ void VertexObject::bind() noexcept
             glGenVertexArrays(1, &m_vaoId);
             glBindVertexArray(m_vaoId);
         }
-        glGenBuffers(1, &m_vboId);
-        glBindBuffer(GL_ARRAY_BUFFER, m_vboId);
+        if (m_streamBuffer == nullptr)
+            glGenBuffers(1, &m_vboId);
+        bindBuffer();
     }
     else
     {
@@ -93,16 +105,25 @@ void VertexObject::bind() noexcept
         {
             glBindVertexArray(m_vaoId);
             if ((m_state & State::Update) != 0)
-                glBindBuffer(GL_ARRAY_BUFFER, m_vboId);
+                bindBuffer();
         }
         else
         {
-            glBindBuffer(GL_ARRAY_BUFFER, m_vboId);
+            bindBuffer();
             enableAttribArrays();
         }
     }
 }
 
+inline void
+VertexObject::bindBuffer() const noexcept
+{
+    if (m_streamBuffer != nullptr)
+        m_streamBuffer->bind();
+    else
+        glBindBuffer(GL_ARRAY_BUFFER, m_vboId);
+}
+
 void VertexObject::bindWritable() noexcept
 {
     m_state |= State::Update;
@@ -155,12 +176,29 @@ void VertexObject::setBufferData(const void* data, GLintptr offset, GLsizeiptr s
     glBufferSubData(GL_ARRAY_BUFFER, offset, size == 0 ? m_bufferSize : size, data);
 }
 
+GLint VertexObject::stream(const void* data, GLsizei count, GLsizei stride) const noexcept
+{
+    assert(m_streamBuffer != nullptr);
+    GLintptr offset = m_streamBuffer->write(data, static_cast<GLsizeiptr>(count) * stride, stride);
+    return offset < 0 ? -1 : static_cast<GLint>(offset / stride);
+}
+
 void VertexObject::draw(GLenum primitive, GLsizei count, GLint first) const noexcept
 {
     if ((m_state & State::Initialize) != 0)
         enableAttribArrays();
 
     glDrawArrays(primitive, first, count);
+    countDrawCall(primitive, count);
+}
+
+void VertexObject::drawInstanced(GLenum primitive, GLsizei count, GLsizei instanceCount, GLint first) const noexcept
+{
+    if ((m_state & State::Initialize) != 0)
+        enableAttribArrays();
+
+    glDrawArraysInstanced(primitive, first, count, instanceCount);
+    countDrawCall(primitive, count, instanceCount);
 }
 
 struct VertexObject::PtrParams
@@ -330,6 +368,20 @@ IndexedVertexObject::draw(GLenum primitive, GLsizei count, GLint first) const no
     auto offset = first * (m_indexType == GL_UNSIGNED_INT ? sizeof(GLuint) : sizeof(GLushort));
     glDrawElements(primitive, count, m_indexType,
                    reinterpret_cast<const void*>(static_cast<std::intptr_t>(offset))); //NOSONAR
+    countDrawCall(primitive, count);
+}
+
+void
+IndexedVertexObject::drawInstanced(GLenum primitive, GLsizei count, GLsizei instanceCount, GLint first) const noexcept
+{
+    if ((m_state & State::Initialize) != 0)
+        enableAttribArrays();
+
+    auto offset = first * (m_indexType == GL_UNSIGNED_INT ? sizeof(GLuint) : sizeof(GLushort));
+    glDrawElementsInstanced(primitive, count, m_indexType,
+                            reinterpret_cast<const void*>(static_cast<std::intptr_t>(offset)), //NOSONAR
+                            instanceCount);
+    countDrawCall(primitive, count, instanceCount);
 }
 
 void
@@ -18,6 +18,8 @@
 
 namespace celestia::render
 {
+class StreamBuffer;
+
 /**
  * \class VertexObject vertexobject.h celrender/vertexobject.h
  *
@@ -38,6 +40,10 @@ namespace celestia::render
  *            2. <em>(optionaly)</em> vo.allocate(nullptr)
  *            3. vo.setBufferData()
  *            4. vo.draw()
+ *       -# buffers streamed from a StreamBuffer
+ *            1. vo.bindWritable()
+ *            2. first = vo.stream()
+ *            3. vo.draw(primitive, count, first)
  */
 class VertexObject //NOSONAR
 {
@@ -57,6 +63,16 @@ class VertexObject //NOSONAR
      */
     VertexObject(GLsizeiptr bufferSize, GLenum streamType);
 
+    /**
+     * @brief Construct a new VertexObject streaming its vertices from a shared buffer.
+     *
+     * The vertex data is copied with stream() instead of allocate() and setBufferData(), and
+     * the vertex attributes are defined as for data at the start of the buffer.
+     *
+     * @param streamBuffer Buffer to stream vertices from, which must outlive the object.
+     */
+    explicit VertexObject(StreamBuffer& streamBuffer);
+
     ~VertexObject();
 
     /**
@@ -87,6 +103,17 @@ class VertexObject //NOSONAR
      */
     void draw(GLenum primitive, GLsizei count, GLint first = 0) const noexcept;
 
+    /**
+     * @brief Draw several instances of the buffer data
+     *
+     * The shaders tell the instances apart with gl_InstanceID.
+     * @param primitive OpenGL primitive (GL_LINES, GL_TRIANGLES and so on).
+     * @param count Number of vertices to draw per instance.
+     * @param instanceCount Number of instances to draw.
+     * @param first First vertice to draw.
+     */
+    void drawInstanced(GLenum primitive, GLsizei count, GLsizei instanceCount, GLint first = 0) const noexcept;
+
     /**
      * @brief Allocate a GPU buffer and (optionally) copy data.
      *
@@ -124,6 +151,18 @@ class VertexObject //NOSONAR
      */
     void setBufferData(const void* data, GLintptr offset = 0, GLsizeiptr size = 0) const noexcept;
 
+    /**
+     * @brief Copy vertex data to the stream buffer for the draw calls of this frame.
+     *
+     * The object must be bound writable.
+     *
+     * @param data Pointer to CPU side memory buffer with vertex data.
+     * @param count Number of vertices to copy.
+     * @param stride Vertex size in bytes.
+     * @return First vertex of the data to pass to draw(), or -1 if it is larger than the buffer.
+     */
+    GLint stream(const void* data, GLsizei count, GLsizei stride) const noexcept;
+
     /**
      * @brief Define an array of generic vertex attribute data.
      *
@@ -192,6 +231,7 @@ class VertexObject //NOSONAR
 
 private:
     void cleanup() const noexcept;
+    void bindBuffer() const noexcept;
 
     std::vector<PtrParams> m_attribParams;
 
@@ -200,6 +240,8 @@ private:
 
     GLsizeiptr m_bufferSize         { 0 };
     GLenum     m_streamType         { 0 };
+
+    StreamBuffer* m_streamBuffer    { nullptr };
 };
 
 class IndexedVertexObject : private VertexObject //NOSONAR
@@ -248,6 +290,16 @@ public:
      */
     void draw(GLenum primitive, GLsizei count, GLint first = 0) const noexcept;
 
+    /**
+     * @brief Draw several instances of the buffer data
+     *
+     * @param primitive OpenGL primitive (GL_LINES, GL_TRIANGLES and so on).
+     * @param count Number of indices to draw per instance.
+     * @param instanceCount Number of instances to draw.
+     * @param first First index to draw.
+     */
+    void drawInstanced(GLenum primitive, GLsizei count, GLsizei instanceCount, GLint first = 0) const noexcept;
+
     /**
      * @brief Allocate GPU vertex and index buffers and copy data.
      *
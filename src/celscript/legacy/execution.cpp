@@ -11,10 +11,21 @@
 
 #include <utility>
 
+#include <celengine/render.h>
+#include <celestia/celestiacore.h>
+#include "execenv.h"
+
 namespace celestia::scripts
 {
 
 Execution::Execution(CommandSequence&& cmd, ExecutionEnvironment& _env) :
+    commandSequence(std::make_shared<CommandSequence>(std::move(cmd))),
+    env(_env)
+{
+}
+
+
+Execution::Execution(std::shared_ptr<CommandSequence> cmd, ExecutionEnvironment& _env) :
     commandSequence(std::move(cmd)),
     env(_env)
 {
@@ -32,9 +43,32 @@ bool Execution::tick(double dt)
         return false;
     }
 
-    while (dt > 0.0 && currentCommand < commandSequence.size())
+    // Scripts often change many settings at once, e.g. with several set or
+    // renderflags commands in a row; the watchers only hear of them at the
+    // end of the tick.
+    Renderer* renderer = env.getRenderer();
+    CelestiaCore* core = env.getCelestiaCore();
+    if (renderer != nullptr)
+        renderer->beginSettingsBatch();
+    if (core != nullptr)
+        core->beginNotificationBatch();
+
+    runCommands(dt);
+
+    if (core != nullptr)
+        core->endNotificationBatch();
+    if (renderer != nullptr)
+        renderer->endSettingsBatch();
+
+    return currentCommand == commandSequence->size();
+}
+
+
+void Execution::runCommands(double dt)
+{
+    while (dt > 0.0 && currentCommand < commandSequence->size())
     {
-        Command* cmd = commandSequence[currentCommand].get();
+        Command* cmd = (*commandSequence)[currentCommand].get();
 
         double timeLeft = cmd->getDuration() - commandTime;
         if (dt >= timeLeft)
@@ -51,8 +85,6 @@ bool Execution::tick(double dt)
             dt = 0.0;
         }
     }
-
-    return currentCommand == commandSequence.size();
 }
 
 }
@@ -10,6 +10,7 @@
 #pragma once
 
 #include <cstddef>
+#include <memory>
 
 #include "command.h"
 
@@ -22,11 +23,18 @@ class Execution
 {
  public:
     Execution(CommandSequence&&, ExecutionEnvironment&);
+    // The commands keep no state of their own, so a parsed script can be
+    // shared by several executions
+    Execution(std::shared_ptr<CommandSequence>, ExecutionEnvironment&);
 
     bool tick(double);
 
+    const std::shared_ptr<CommandSequence>& getCommands() const { return commandSequence; }
+
  private:
-    CommandSequence commandSequence;
+    void runCommands(double);
+
+    std::shared_ptr<CommandSequence> commandSequence;
     std::size_t currentCommand{ 0 };
     ExecutionEnvironment& env;
     double commandTime{ -1.0 };
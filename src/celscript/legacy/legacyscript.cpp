@@ -11,6 +11,8 @@
 
 #include <fstream>
 #include <istream>
+#include <system_error>
+#include <utility>
 
 #include <celestia/celestiacore.h>
 #include <celutil/gettext.h>
@@ -26,6 +28,9 @@ namespace celestia::scripts
 namespace
 {
 
+// Parsed scripts kept at most by the plugin
+constexpr std::size_t MaxParsedScripts = 16;
+
 // Extremely basic implementation of an ExecutionEnvironment for
 // running scripts.
 class CoreExecutionEnvironment : public ExecutionEnvironment
@@ -83,11 +88,18 @@ bool LegacyScript::load(std::istream &scriptfile, const fs::path &/*path*/, std:
     return true;
 }
 
+void LegacyScript::load(std::shared_ptr<CommandSequence> script)
+{
+    m_runningScript = std::make_unique<Execution>(std::move(script), *m_execEnv);
+}
+
 bool LegacyScript::tick(double dt)
 {
     return m_runningScript->tick(dt);
 }
 
+LegacyScriptPlugin::~LegacyScriptPlugin() = default;
+
 bool LegacyScriptPlugin::isOurFile(const fs::path &p) const
 {
     return p.extension() == ".cel";
@@ -95,6 +107,21 @@ bool LegacyScriptPlugin::isOurFile(const fs::path &p) const
 
 std::unique_ptr<IScript> LegacyScriptPlugin::loadScript(const fs::path &path)
 {
+    std::error_code ec;
+    auto size = fs::file_size(path, ec);
+    auto modified = ec ? fs::file_time_type() : fs::last_write_time(path, ec);
+    bool cacheable = !ec;
+    if (cacheable)
+    {
+        if (auto it = m_parsedScripts.find(path);
+            it != m_parsedScripts.end() && it->second.size == size && it->second.modified == modified)
+        {
+            auto script = std::make_unique<LegacyScript>(appCore());
+            script->load(it->second.commands);
+            return script;
+        }
+    }
+
     std::ifstream scriptfile(path);
     if (!scriptfile.good())
     {
@@ -111,6 +138,13 @@ std::unique_ptr<IScript> LegacyScriptPlugin::loadScript(const fs::path &path)
         appCore()->fatalError(errorMsg);
         return nullptr;
     }
+
+    if (cacheable)
+    {
+        if (m_parsedScripts.size() >= MaxParsedScripts)
+            m_parsedScripts.clear();
+        m_parsedScripts[path] = { size, modified, script->m_runningScript->getCommands() };
+    }
     return script;
 }
 
@@ -9,9 +9,12 @@
 
 #pragma once
 
+#include <cstdint>
 #include <iosfwd>
+#include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <celcompat/filesystem.h>
 #include <celscript/common/script.h>
@@ -22,9 +25,12 @@ class CelestiaCore;
 namespace celestia::scripts
 {
 
+class Command;
 class Execution;
 class ExecutionEnvironment;
 
+using CommandSequence = std::vector<std::unique_ptr<Command>>;
+
 class LegacyScript : public IScript
 {
  public:
@@ -32,6 +38,7 @@ class LegacyScript : public IScript
     ~LegacyScript() override = default;
 
     bool load(std::istream&, const fs::path&, std::string&);
+    void load(std::shared_ptr<CommandSequence>);
 
     bool tick(double) override;
 
@@ -48,7 +55,7 @@ class LegacyScriptPlugin : public IScriptPlugin
  public:
     LegacyScriptPlugin() = delete;
     LegacyScriptPlugin(CelestiaCore *appCore) : IScriptPlugin(appCore) {};
-    ~LegacyScriptPlugin() override = default;
+    ~LegacyScriptPlugin() override;
     LegacyScriptPlugin(const LegacyScriptPlugin&) = delete;
     LegacyScriptPlugin(LegacyScriptPlugin&&) = delete;
     LegacyScriptPlugin& operator=(const LegacyScriptPlugin&) = delete;
@@ -56,6 +63,18 @@ class LegacyScriptPlugin : public IScriptPlugin
 
     bool isOurFile(const fs::path&) const override;
     std::unique_ptr<IScript> loadScript(const fs::path&) override;
+
+ private:
+    // Parsed scripts, so that running a long tour again doesn't parse it
+    // again unless the file changed
+    struct ParsedScript
+    {
+        std::uintmax_t size;
+        fs::file_time_type modified;
+        std::shared_ptr<CommandSequence> commands;
+    };
+
+    std::map<fs::path, ParsedScript> m_parsedScripts;
 };
 
 } // end namespace celestia::scripts
@@ -11,14 +11,19 @@
 // of the License, or (at your option) any later version.
 
 #include <config.h>
+#include <algorithm>
 #include <cassert>
 #include <ctime>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <sstream>
+#include <string_view>
 #include <utility>
 #include <celengine/astro.h>
 #include <celengine/asterism.h>
+#include <celengine/meshmanager.h>
+#include <celengine/texmanager.h>
 #include <celscript/legacy/cmdparser.h>
 #include <celscript/legacy/execution.h>
 #include <celengine/timeline.h>
@@ -27,6 +32,7 @@
 #include <celutil/logger.h>
 #include <celutil/stringutils.h>
 #include <celestia/celestiacore.h>
+#include <celestia/configfile.h>
 #include <celestia/url.h>
 
 #include "celx_internal.h"
@@ -41,6 +47,7 @@
 #include "celx_celestia.h"
 #include "celx_gl.h"
 #include "celx_category.h"
+#include "celx_worker.h"
 
 
 using namespace Eigen;
@@ -62,7 +69,8 @@ const char* CelxLua::ClassNames[] =
     "class_image",
     "class_texture",
     "class_phase",
-    "class_category"
+    "class_category",
+    "class_worker"
 };
 
 #define CLASS(i) ClassNames[(i)]
@@ -263,6 +271,13 @@ static void checkTimeslice(lua_State* l, lua_Debug* /*ar*/)
         lua_pushstring(l, errormsg);
         lua_error(l);
     }
+
+#if LUA_VERSION_NUM >= 503
+    // Suspend the script until the next frame; scripts can't be suspended
+    // in callbacks or functions called from C, which run to the end
+    if (luastate->frameBudgetExpired() && lua_isyieldable(l))
+        lua_yield(l, 0);
+#endif
 }
 
 
@@ -336,6 +351,18 @@ string LuaState::getErrorMessage()
 }
 
 
+bool LuaState::frameBudgetExpired() const
+{
+    return frameDeadline > 0.0 && frameDeadline < getTime();
+}
+
+
+void LuaState::setFrameBudget(double budget)
+{
+    frameBudget = std::max(budget, 0.0);
+}
+
+
 bool LuaState::timesliceExpired()
 {
     if (timeout < getTime())
@@ -688,7 +715,9 @@ int LuaState::resume()
         return 0;
 
     timeout = getTime() + MaxTimeslice;
+    frameDeadline = frameBudget > 0.0 ? getTime() + frameBudget : 0.0;
     int nArgs = resumeLuaThread(state, co, 0);
+    frameDeadline = 0.0;
     if (nArgs < 0)
     {
         alive = false;
@@ -795,7 +824,7 @@ bool LuaState::tick(double dt)
         return false;
     }
 
-    if (dt == 0 || scriptAwakenTime > getTime())
+    if (dt == 0 || scriptAwakenTime > getTime() || !isWaitOver())
         return false;
 
     int nArgs = resume();
@@ -806,12 +835,14 @@ bool LuaState::tick(double dt)
     lua_State* state = getState();
 
     // The values on the stack indicate what event will wake up the
-    // script.  For now, we just support wait()
-    double delay;
-    if (nArgs == 1 && lua_isnumber(state, -1))
+    // script: a delay from wait(), or a kind of event followed by its
+    // arguments from the other wait functions. Scripts suspended at the
+    // end of their frame budget yield nothing, and go on in the next frame.
+    double delay = 0.0;
+    if (nArgs >= 1 && lua_type(state, -nArgs) == LUA_TSTRING)
+        beginWait(nArgs);
+    else if (nArgs == 1 && lua_isnumber(state, -1))
         delay = lua_tonumber(state, -1);
-    else
-        delay = 0.0;
     scriptAwakenTime = getTime() + delay;
 
     // Clean up the stack
@@ -820,6 +851,99 @@ bool LuaState::tick(double dt)
 }
 
 
+// The arguments of the wait functions defined in init()
+void LuaState::beginWait(int nArgs)
+{
+    std::string_view kind = lua_tostring(state, -nArgs);
+    int arg = -nArgs + 1;
+    auto getTimeout = [this, nArgs](int index)
+    {
+        return index < 0 && index >= -nArgs && lua_isnumber(state, index)
+            ? getTime() + lua_tonumber(state, index)
+            : std::numeric_limits<double>::infinity();
+    };
+
+    endWait();
+    if (kind == "frames")
+    {
+        waitKind = WaitKind::Frames;
+        waitFrames = nArgs >= 2 && lua_isnumber(state, arg) ? static_cast<int>(lua_tonumber(state, arg)) : 1;
+    }
+    else if (kind == "until" && nArgs >= 2 && lua_isfunction(state, arg))
+    {
+        waitKind = WaitKind::Condition;
+        lua_pushvalue(state, arg);
+        waitCondition = luaL_ref(state, LUA_REGISTRYINDEX);
+        waitDeadline = getTimeout(arg + 1);
+    }
+    else if (kind == "loading")
+    {
+        waitKind = WaitKind::Loading;
+        waitDeadline = getTimeout(arg);
+    }
+    else
+    {
+        GetLogger()->warn("Unknown event {} to wait for\n", kind);
+    }
+}
+
+
+// Checked once a frame, as long as the script waits
+bool LuaState::isWaitOver()
+{
+    switch (waitKind)
+    {
+    case WaitKind::Frames:
+        if (--waitFrames > 0)
+            return false;
+        break;
+
+    case WaitKind::Condition:
+        if (getTime() < waitDeadline)
+        {
+            // Like the event handlers, the condition runs in the script
+            // thread
+            lua_rawgeti(costate, LUA_REGISTRYINDEX, waitCondition);
+            timeout = getTime() + 1.0;
+            bool met = true;
+            if (lua_pcall(costate, 0, 1, 0) != 0)
+                GetLogger()->error("Error while testing the condition to wait for: {}\n", lua_tostring(costate, -1));
+            else
+                met = lua_toboolean(costate, -1) != 0;
+            lua_pop(costate, 1);
+            if (!met)
+                return false;
+        }
+        break;
+
+    case WaitKind::Loading:
+        if (getTime() < waitDeadline &&
+            (GetTextureManager()->isLoading() || GetGeometryManager()->isLoading()))
+        {
+            return false;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    endWait();
+    return true;
+}
+
+
+void LuaState::endWait()
+{
+    if (waitCondition != LUA_NOREF)
+        luaL_unref(state, LUA_REGISTRYINDEX, waitCondition);
+    waitKind = WaitKind::None;
+    waitFrames = 0;
+    waitCondition = LUA_NOREF;
+    waitDeadline = 0.0;
+}
+
+
 void LuaState::requestIO()
 {
     // the script requested IO, set the mode
@@ -1063,10 +1187,18 @@ bool LuaState::init(CelestiaCore* appCore)
     // library of useful functions that can be defined purely in Lua.
     // At that point, we'll want something a bit more robust than just
     // parsing the whole text of the library every time a script is launched
-    if (loadScript("wait = function(x) coroutine.yield(x) end") != 0)
+    //
+    // Besides waiting for a time, scripts can wait for a number of frames,
+    // for a function to return true, tested once a frame, or for the
+    // textures and models being loaded in the background, the last two
+    // with an optional timeout in seconds.
+    if (loadScript("wait = function(x) coroutine.yield(x) end\n"
+                   "waitframes = function(n) coroutine.yield(\"frames\", n) end\n"
+                   "waituntil = function(f, t) coroutine.yield(\"until\", f, t) end\n"
+                   "waitforloading = function(t) coroutine.yield(\"loading\", t) end\n") != 0)
         return false;
 
-    // Execute the script fragment to define the wait function
+    // Execute the script fragment to define the wait functions
     if (lua_pcall(state, 0, 0, 0) != 0)
     {
         cout << "Error running script initialization fragment.\n";
@@ -1076,6 +1208,9 @@ bool LuaState::init(CelestiaCore* appCore)
     lua_pushnumber(state, KM_PER_LY<lua_Number>/1e6);
     lua_setglobal(state, "KM_PER_MICROLY");
 
+    if (const CelestiaConfig* config = appCore->getConfig(); config != nullptr)
+        setFrameBudget(config->scriptFrameBudget / 1000.0);
+
     loadLuaLibs(state);
 
     // Create the celestia object
@@ -1137,6 +1272,7 @@ static void loadLuaLibs(lua_State* state)
     CreateImageMetaTable(state);
     CreateTextureMetaTable(state);
     CreateCategoryMetaTable(state);
+    CreateWorkerMetaTable(state);
     ExtendCelestiaMetaTable(state);
     ExtendObjectMetaTable(state);
 
@@ -1207,6 +1343,8 @@ bool LuaState::callLuaHook(void* obj, const char* method)
            handled = lua_toboolean(costate, -1) == 1 ? true : false;
         }
         lua_pop(costate, 1);             // pop the return value
+        // the primitives of renderoverlay are drawn before the overlay
+        FlushLuaGraphics();
     }
     else
     {
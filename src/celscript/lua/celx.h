@@ -52,6 +52,10 @@ public:
     void cleanup();
     bool isAlive() const;
     bool timesliceExpired();
+    bool frameBudgetExpired() const;
+    // Time in seconds the script may run in a frame before it's suspended
+    // until the next one, zero to run it until it waits
+    void setFrameBudget(double);
     void requestIO();
 
     bool charEntered(const char*);
@@ -84,11 +88,31 @@ public:
     };
 
 private:
+    // What the script waits for besides the delay of wait(), set by the
+    // values it yields
+    enum class WaitKind
+    {
+        None,
+        Frames,
+        Condition,
+        Loading,
+    };
+
+    void beginWait(int nArgs);
+    bool isWaitOver();
+    void endWait();
+
     lua_State* state;
     lua_State* costate{ nullptr }; // coroutine stack
     bool alive{ false };
     Timer* timer;
     double scriptAwakenTime{ 0.0 };
+    double frameBudget{ 0.0 };
+    double frameDeadline{ 0.0 };
+    WaitKind waitKind{ WaitKind::None };
+    int waitFrames{ 0 };
+    int waitCondition{ LUA_NOREF };
+    double waitDeadline{ 0.0 };
     IOMode ioMode{ IOMode::NotDetermined };
     bool eventHandlerEnabled{ false };
 };
@@ -9,22 +9,33 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <limits>
 #include <optional>
+#include <string_view>
 
 #include <fmt/format.h>
 
 #include <celcompat/filesystem.h>
+#include <celengine/bodypositions.h>
 #include <celengine/category.h>
+#include <celengine/render.h>
+#include <celengine/starquery.h>
 #include <celengine/texture.h>
 #include <celestia/audiosession.h>
+#include <celestia/eventfinder.h>
 #include <celestia/url.h>
 #include <celestia/celestiacore.h>
 #include <celestia/view.h>
+#include <celrender/frameprofiler.h>
 #include <celscript/common/scriptmaps.h>
 #include <celttf/truetypefont.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include <celutil/memoryreport.h>
 #include <celutil/stringutils.h>
 #include "celx.h"
 #include "celx_internal.h"
@@ -37,6 +48,7 @@
 #include "celx_rotation.h"
 #include "celx_vector.h"
 #include "celx_category.h"
+#include "celx_worker.h"
 
 
 using namespace std;
@@ -1806,6 +1818,158 @@ static int celestia_getstar(lua_State* l)
     return 1;
 }
 
+// Push a column of star data, as an array or, when packed, as a string of
+// the values in native byte order for string.unpack
+template<typename T, typename F>
+static void pushStarColumn(lua_State* l, const vector<Star*>& stars, bool packed, F&& value)
+{
+    if (packed)
+    {
+        string column(stars.size() * sizeof(T), '\0');
+        for (size_t i = 0; i < stars.size(); i++)
+        {
+            T v = value(*stars[i]);
+            memcpy(column.data() + i * sizeof(T), &v, sizeof(T));
+        }
+        lua_pushlstring(l, column.data(), column.size());
+        return;
+    }
+
+    lua_createtable(l, static_cast<int>(stars.size()), 0);
+    for (size_t i = 0; i < stars.size(); i++)
+    {
+        lua_pushnumber(l, static_cast<lua_Number>(value(*stars[i])));
+        lua_rawseti(l, -2, static_cast<int>(i + 1));
+    }
+}
+
+void StarDataRequest::read(lua_State* l, int index)
+{
+    lua_getfield(l, index, "first");
+    lua_getfield(l, index, "count");
+    lua_getfield(l, index, "radius");
+    lua_getfield(l, index, "maxmagnitude");
+    if (lua_isnumber(l, -4))
+        first = static_cast<uint32_t>(max(lua_tonumber(l, -4), 0.0));
+    if (lua_isnumber(l, -3))
+        count = static_cast<uint32_t>(clamp(lua_tonumber(l, -3), 0.0, static_cast<double>(count)));
+    if (lua_isnumber(l, -2))
+        radius = static_cast<float>(lua_tonumber(l, -2));
+    if (lua_isnumber(l, -1))
+        maxMagnitude = static_cast<float>(lua_tonumber(l, -1));
+    lua_pop(l, 4);
+
+    lua_getfield(l, index, "packed");
+    packed = lua_toboolean(l, -1) != 0;
+    lua_pop(l, 1);
+}
+
+int StarDataRequest::push(lua_State* l, const StarDatabase& stardb) const
+{
+    uint32_t last = first + min(count, stardb.size() - min(first, stardb.size()));
+    float radius2 = radius * radius;
+    auto filter = [this, radius2](const Star* star)
+    {
+        if (radius > 0.0f && (star->getPosition() - center).squaredNorm() > radius2)
+            return true;
+        return isfinite(maxMagnitude) &&
+               star->getApparentMagnitude((star->getPosition() - viewpoint).norm()) > maxMagnitude;
+    };
+    vector<Star*> stars = celestia::engine::findStars(stardb, first, last, filter);
+
+    lua_newtable(l);
+    lua_pushnumber(l, static_cast<lua_Number>(stars.size()));
+    lua_setfield(l, -2, "count");
+
+    pushStarColumn<uint32_t>(l, stars, packed, [](const Star& star) { return star.getIndex(); });
+    lua_setfield(l, -2, "index");
+    pushStarColumn<float>(l, stars, packed, [](const Star& star) { return star.getPosition().x(); });
+    lua_setfield(l, -2, "x");
+    pushStarColumn<float>(l, stars, packed, [](const Star& star) { return star.getPosition().y(); });
+    lua_setfield(l, -2, "y");
+    pushStarColumn<float>(l, stars, packed, [](const Star& star) { return star.getPosition().z(); });
+    lua_setfield(l, -2, "z");
+    pushStarColumn<float>(l, stars, packed, [](const Star& star) { return star.getAbsoluteMagnitude(); });
+    lua_setfield(l, -2, "absmag");
+    Eigen::Vector3f from = viewpoint;
+    pushStarColumn<float>(l, stars, packed, [from](const Star& star)
+                          { return star.getApparentMagnitude((star.getPosition() - from).norm()); });
+    lua_setfield(l, -2, "appmag");
+
+    // Lua interns the strings, so the few distinct spectral types are only
+    // stored once
+    lua_createtable(l, static_cast<int>(stars.size()), 0);
+    for (size_t i = 0; i < stars.size(); i++)
+    {
+        lua_pushstring(l, stars[i]->getSpectralType());
+        lua_rawseti(l, -2, static_cast<int>(i + 1));
+    }
+    lua_setfield(l, -2, "spectraltype");
+
+    return 1;
+}
+
+// Data of many stars at once, without creating an object for each:
+//   celestia:getstardata{ first = i, count = n, center = position,
+//                         radius = ly, maxmagnitude = m, packed = bool }
+// selects the stars numbered first to first + count - 1, as in
+// celestia:getstar, within radius light years of center and brighter than
+// the apparent magnitude maxmagnitude as seen from the active observer;
+// all fields are optional. Returns a table with the number of stars found
+// in count, and arrays of their catalog numbers (index), positions in light
+// years (x, y, z), absolute and apparent magnitudes (absmag, appmag) and
+// spectral types (spectraltype). When packed is true the numeric columns
+// are strings of 32 bit unsigned integers and floats instead.
+static int celestia_getstardata(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 2, "Zero or one table argument expected to function celestia:getstardata");
+    CelestiaCore* appCore = this_celestia(l);
+    if (lua_gettop(l) == 2 && !lua_istable(l, 2))
+    {
+        Celx_DoError(l, "Argument to celestia:getstardata must be a table");
+        return 0;
+    }
+
+    StarDataRequest request;
+    request.viewpoint = appCore->getSimulation()->getActiveObserver()->getPosition().toLy().cast<float>();
+    request.center = request.viewpoint;
+    if (lua_gettop(l) == 2)
+    {
+        request.read(l, 2);
+
+        lua_getfield(l, 2, "center");
+        if (!lua_isnil(l, -1))
+        {
+            const UniversalCoord* uc = to_position(l, -1);
+            if (uc == nullptr)
+            {
+                Celx_DoError(l, "center of celestia:getstardata must be a position");
+                return 0;
+            }
+            request.center = uc->toLy().cast<float>();
+        }
+        lua_pop(l, 1);
+    }
+
+    return request.push(l, *appCore->getSimulation()->getUniverse()->getStarCatalog());
+}
+
+// Start a worker running code on a thread of its own:
+//   celestia:newworker(code [, name])
+// See LuaWorker for what the code can do.
+static int celestia_newworker(lua_State* l)
+{
+    Celx_CheckArgs(l, 2, 3, "One or two arguments expected to function celestia:newworker");
+    CelestiaCore* appCore = this_celestia(l);
+    const char* code = Celx_SafeGetString(l, 2, AllErrors, "First argument to celestia:newworker must be a string");
+    const char* name = Celx_SafeGetString(l, 3, WrongType, "Second argument to celestia:newworker must be a string");
+    if (code == nullptr)
+        return 0;
+
+    return worker_new(l, code, name == nullptr ? "=worker" : name,
+                      appCore->getSimulation()->getUniverse()->getStarCatalog());
+}
+
 static int celestia_getdso(lua_State* l)
 {
     Celx_CheckArgs(l, 2, 2, "One argument expected to function celestia:getdso");
@@ -1822,6 +1986,238 @@ static int celestia_getdso(lua_State* l)
     return 1;
 }
 
+// Read the objects in the field of the table at index
+static bool getObjectList(lua_State* l, int index, const char* field, vector<Selection>& objects)
+{
+    lua_getfield(l, index, field);
+    if (!lua_istable(l, -1))
+    {
+        lua_pop(l, 1);
+        return false;
+    }
+
+    lua_pushnil(l);
+    while (lua_next(l, -2) != 0)
+    {
+        Selection* sel = to_object(l, -1);
+        if (sel == nullptr)
+        {
+            lua_pop(l, 3);
+            return false;
+        }
+        objects.push_back(*sel);
+        lua_pop(l, 1);
+    }
+
+    lua_pop(l, 1);
+    return true;
+}
+
+// Find transits, occultations or close approaches, returned in a table of
+// events sorted by their start time:
+//   celestia:findevents{ type = "occultation", observer = obj, objects = {...},
+//                        targets = {...}, starttime = t0, endtime = t1 }
+//   celestia:findevents{ type = "closeapproach", distance = km, objects = {...},
+//                        targets = {...}, starttime = t0, endtime = t1 }
+// An optional step sets the interval in days between the times tested.
+static int celestia_findevents(lua_State* l)
+{
+    Celx_CheckArgs(l, 2, 2, "One table argument expected to function celestia:findevents");
+    this_celestia(l);
+    if (!lua_istable(l, 2))
+    {
+        Celx_DoError(l, "Argument to celestia:findevents must be a table");
+        return 0;
+    }
+
+    lua_getfield(l, 2, "type");
+    string type = lua_isstring(l, -1) ? lua_tostring(l, -1) : "";
+    lua_pop(l, 1);
+
+    lua_getfield(l, 2, "starttime");
+    lua_getfield(l, 2, "endtime");
+    lua_getfield(l, 2, "step");
+    lua_getfield(l, 2, "distance");
+    if (!lua_isnumber(l, -4) || !lua_isnumber(l, -3))
+    {
+        Celx_DoError(l, "celestia:findevents requires starttime and endtime numbers");
+        return 0;
+    }
+    double startTime = lua_tonumber(l, -4);
+    double endTime = lua_tonumber(l, -3);
+    double step = lua_isnumber(l, -2) ? lua_tonumber(l, -2) : 0.0;
+    double distance = lua_isnumber(l, -1) ? lua_tonumber(l, -1) : 0.0;
+    lua_pop(l, 4);
+
+    vector<Selection> objects;
+    vector<Selection> targets;
+    if (!getObjectList(l, 2, "objects", objects) || !getObjectList(l, 2, "targets", targets))
+    {
+        Celx_DoError(l, "objects and targets of celestia:findevents must be tables of objects");
+        return 0;
+    }
+
+    CelestialEventFinder finder;
+    if (step > 0.0)
+        finder.setSearchStep(step);
+
+    if (type == "occultation")
+    {
+        lua_getfield(l, 2, "observer");
+        Selection* observer = to_object(l, -1);
+        lua_pop(l, 1);
+        if (observer == nullptr)
+        {
+            Celx_DoError(l, "Occultation searches of celestia:findevents require an observer object");
+            return 0;
+        }
+        finder.addOccultations(*observer, objects, targets);
+    }
+    else if (type == "closeapproach")
+    {
+        if (distance <= 0.0)
+        {
+            Celx_DoError(l, "Close approach searches of celestia:findevents require a distance");
+            return 0;
+        }
+        finder.addCloseApproaches(objects, targets, distance);
+    }
+    else
+    {
+        Celx_DoError(l, "Type of celestia:findevents must be occultation or closeapproach");
+        return 0;
+    }
+
+    vector<CelestialEvent> events;
+    finder.findEvents(startTime, endTime, events);
+
+    lua_newtable(l);
+    for (unsigned int i = 0; i < events.size(); i++)
+    {
+        const CelestialEvent& event = events[i];
+        lua_newtable(l);
+
+        switch (event.type)
+        {
+        case CelestialEvent::Transit:
+            lua_pushstring(l, "transit");
+            break;
+        case CelestialEvent::Occultation:
+            lua_pushstring(l, "occultation");
+            break;
+        default:
+            lua_pushstring(l, "closeapproach");
+            break;
+        }
+        lua_setfield(l, -2, "type");
+
+        object_new(l, event.object);
+        lua_setfield(l, -2, "object");
+        object_new(l, event.target);
+        lua_setfield(l, -2, "target");
+        if (!event.observer.empty())
+        {
+            object_new(l, event.observer);
+            lua_setfield(l, -2, "observer");
+        }
+
+        setTable(l, "starttime", event.startTime);
+        setTable(l, "endtime", event.endTime);
+        setTable(l, "time", event.extremeTime);
+        setTable(l, "separation", event.separation);
+
+        lua_rawseti(l, -2, i + 1);
+    }
+
+    return 1;
+}
+
+// Positions of several objects at several times, computed together:
+//   celestia:getpositions({ obj1, obj2, ... }, { t1, t2, ... })
+// returns a table with a table of positions for each object, in the order
+// of the times.
+static int celestia_getpositions(lua_State* l)
+{
+    Celx_CheckArgs(l, 3, 3, "Two table arguments expected to function celestia:getpositions");
+    this_celestia(l);
+    if (!lua_istable(l, 2) || !lua_istable(l, 3))
+    {
+        Celx_DoError(l, "Arguments to celestia:getpositions must be tables of objects and times");
+        return 0;
+    }
+
+    // The tables are read as arrays, up to their first nil
+    vector<Selection> objects;
+    for (int i = 1;; i++)
+    {
+        lua_rawgeti(l, 2, i);
+        if (lua_isnil(l, -1))
+        {
+            lua_pop(l, 1);
+            break;
+        }
+
+        Selection* sel = to_object(l, -1);
+        if (sel == nullptr)
+        {
+            Celx_DoError(l, "First argument to celestia:getpositions must be a table of objects");
+            return 0;
+        }
+        objects.push_back(*sel);
+        lua_pop(l, 1);
+    }
+
+    vector<double> times;
+    for (int i = 1;; i++)
+    {
+        lua_rawgeti(l, 3, i);
+        if (lua_isnil(l, -1))
+        {
+            lua_pop(l, 1);
+            break;
+        }
+
+        if (!lua_isnumber(l, -1))
+        {
+            Celx_DoError(l, "Second argument to celestia:getpositions must be a table of numbers");
+            return 0;
+        }
+        times.push_back(lua_tonumber(l, -1));
+        lua_pop(l, 1);
+    }
+
+    // Bodies are computed in a batch, other objects one at a time
+    vector<const Body*> bodies;
+    for (const Selection& sel : objects)
+    {
+        if (sel.body() != nullptr)
+            bodies.push_back(sel.body());
+    }
+
+    vector<UniversalCoord> bodyPositions;
+    BodyPositionBatch(bodies).compute(times, bodyPositions);
+
+    lua_newtable(l);
+    size_t nBodies = 0;
+    for (unsigned int i = 0; i < objects.size(); i++)
+    {
+        lua_newtable(l);
+        for (unsigned int j = 0; j < times.size(); j++)
+        {
+            if (objects[i].body() != nullptr)
+                position_new(l, bodyPositions[nBodies * times.size() + j]);
+            else
+                position_new(l, objects[i].getPosition(times[j]));
+            lua_rawseti(l, -2, j + 1);
+        }
+        if (objects[i].body() != nullptr)
+            nBodies++;
+        lua_rawseti(l, -2, i + 1);
+    }
+
+    return 1;
+}
+
 
 static int celestia_newvector(lua_State* l)
 {
@@ -1908,6 +2304,18 @@ static int celestia_getscripttime(lua_State* l)
     return 1;
 }
 
+// Time in milliseconds the script may run in a frame, zero for no limit
+static int celestia_setscriptbudget(lua_State* l)
+{
+    Celx_CheckArgs(l, 2, 2, "One argument expected for celestia:setscriptbudget");
+    this_celestia(l);
+    double budget = Celx_SafeGetNumber(l, 2, AllErrors, "Argument to celestia:setscriptbudget must be a number");
+
+    LuaState* luastate_ptr = getLuaStateObject(l);
+    luastate_ptr->setFrameBudget(budget / 1000.0);
+    return 0;
+}
+
 static int celestia_newframe(lua_State* l)
 {
     Celx_CheckArgs(l, 2, 4, "One to three arguments expected for function celestia:newframe");
@@ -2568,6 +2976,133 @@ static int celestia_loadfragment(lua_State* l)
     return 1;
 }
 
+// Counters and pass times in milliseconds of the latest frame profiled
+static int celestia_getframestats(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 1, "No arguments expected for celestia:getframestats()");
+    CelestiaCore* appCore = this_celestia(l);
+    const celestia::render::ProfiledFrame& frame = appCore->getRenderer()->getProfiler().lastFrame();
+
+    lua_newtable(l);
+    lua_pushnumber(l, frame.number);
+    lua_setfield(l, -2, "frame");
+    lua_pushnumber(l, frame.cpuFrameTime * 1000.0);
+    lua_setfield(l, -2, "cpu");
+    lua_pushnumber(l, frame.stats.drawCalls);
+    lua_setfield(l, -2, "drawcalls");
+    lua_pushnumber(l, frame.stats.programChanges);
+    lua_setfield(l, -2, "programchanges");
+    lua_pushnumber(l, frame.stats.stateChanges);
+    lua_setfield(l, -2, "statechanges");
+    lua_pushnumber(l, static_cast<lua_Number>(frame.stats.triangles));
+    lua_setfield(l, -2, "triangles");
+    lua_pushnumber(l, static_cast<lua_Number>(frame.stats.points));
+    lua_setfield(l, -2, "points");
+
+    // One table for each pass, without gpu when it can't be measured
+    for (std::size_t i = 0; i < celestia::render::ProfilePassCount; i++)
+    {
+        lua_newtable(l);
+        lua_pushnumber(l, frame.cpuTimes[i] * 1000.0);
+        lua_setfield(l, -2, "cpu");
+        if (frame.gpuTimes[i] >= 0.0)
+        {
+            lua_pushnumber(l, frame.gpuTimes[i] * 1000.0);
+            lua_setfield(l, -2, "gpu");
+        }
+        lua_pushnumber(l, frame.runs[i]);
+        lua_setfield(l, -2, "runs");
+        lua_setfield(l, -2, celestia::render::profilePassName(static_cast<celestia::render::ProfilePass>(i)));
+    }
+
+    return 1;
+}
+
+// Estimated memory taken by each subsystem: a table with the bytes and
+// objects of each category, and the total bytes
+static int celestia_getmemoryusage(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 1, "No arguments expected for celestia:getmemoryusage()");
+    CelestiaCore* appCore = this_celestia(l);
+    celestia::util::MemoryReport report = appCore->getMemoryReport();
+
+    lua_newtable(l);
+    for (const auto& entry : report.getEntries())
+    {
+        lua_newtable(l);
+        lua_pushnumber(l, static_cast<lua_Number>(entry.bytes));
+        lua_setfield(l, -2, "bytes");
+        lua_pushnumber(l, static_cast<lua_Number>(entry.objects));
+        lua_setfield(l, -2, "objects");
+        lua_setfield(l, -2, entry.category.c_str());
+    }
+    lua_pushnumber(l, static_cast<lua_Number>(report.getTotal()));
+    lua_setfield(l, -2, "total");
+
+    return 1;
+}
+
+static int celestia_setprofiling(lua_State* l)
+{
+    Celx_CheckArgs(l, 2, 2, "One argument expected for celestia:setprofiling()");
+    if (!lua_isboolean(l, 2))
+    {
+        Celx_DoError(l, "Argument for celestia:setprofiling must be a boolean");
+        return 0;
+    }
+
+    CelestiaCore* appCore = this_celestia(l);
+    appCore->getRenderer()->getProfiler().setEnabled(lua_toboolean(l, 2) != 0);
+
+    return 0;
+}
+
+// The trace is written to the screenshot directory, with the file type and
+// a part of its name given by the script
+static int celestia_starttrace(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 3, "Need 0 to 2 arguments for celestia:starttrace");
+    CelestiaCore* appCore = this_celestia(l);
+
+    const char* filetype = Celx_SafeGetString(l, 2, WrongType, "First argument to celestia:starttrace must be a string");
+    if (filetype == nullptr)
+        filetype = "csv";
+    if (std::string_view(filetype) != "csv" && std::string_view(filetype) != "json")
+    {
+        Celx_DoError(l, "First argument to celestia:starttrace must be \"csv\" or \"json\"");
+        return 0;
+    }
+
+    const char* fileid_ptr = Celx_SafeGetString(l, 3, WrongType, "Second argument to celestia:starttrace must be a string");
+    string fileid(fileid_ptr == nullptr ? "" : fileid_ptr);
+    for (char& ch : fileid)
+    {
+        if (!((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9')))
+            ch = '_';
+    }
+    if (fileid.length() > 16)
+        fileid = fileid.substr(0, 16);
+    if (fileid.length() > 0)
+        fileid.insert(0, "-");
+
+    fs::path filepath = appCore->getConfig()->scriptScreenshotDirectory / fmt::format("trace{}.{}", fileid, filetype);
+    lua_pushboolean(l, appCore->getRenderer()->getProfiler().startTrace(filepath));
+
+    return 1;
+}
+
+static int celestia_stoptrace(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 1, "No arguments expected for celestia:stoptrace()");
+    CelestiaCore* appCore = this_celestia(l);
+
+    celestia::render::FrameProfiler& profiler = appCore->getRenderer()->getProfiler();
+    profiler.stopTrace();
+    profiler.setEnabled(appCore->getFrameProfileShown());
+
+    return 0;
+}
+
 static int celestia_version(lua_State* l)
 {
     lua_pushstring(l, VERSION);
@@ -2661,12 +3196,17 @@ void CreateCelestiaMetaTable(lua_State* l)
     Celx_RegisterMethod(l, "getstarcount", celestia_getstarcount);
     Celx_RegisterMethod(l, "getdsocount", celestia_getdsocount);
     Celx_RegisterMethod(l, "getstar", celestia_getstar);
+    Celx_RegisterMethod(l, "getstardata", celestia_getstardata);
+    Celx_RegisterMethod(l, "newworker", celestia_newworker);
     Celx_RegisterMethod(l, "getdso", celestia_getdso);
+    Celx_RegisterMethod(l, "findevents", celestia_findevents);
+    Celx_RegisterMethod(l, "getpositions", celestia_getpositions);
     Celx_RegisterMethod(l, "newframe", celestia_newframe);
     Celx_RegisterMethod(l, "newvector", celestia_newvector);
     Celx_RegisterMethod(l, "newposition", celestia_newposition);
     Celx_RegisterMethod(l, "newrotation", celestia_newrotation);
     Celx_RegisterMethod(l, "getscripttime", celestia_getscripttime);
+    Celx_RegisterMethod(l, "setscriptbudget", celestia_setscriptbudget);
     Celx_RegisterMethod(l, "requestkeyboard", celestia_requestkeyboard);
     Celx_RegisterMethod(l, "takescreenshot", celestia_takescreenshot);
     Celx_RegisterMethod(l, "createcelscript", celestia_createcelscript);
@@ -2683,6 +3223,11 @@ void CreateCelestiaMetaTable(lua_State* l)
     Celx_RegisterMethod(l, "geturl", celestia_geturl);
     Celx_RegisterMethod(l, "overlay", celestia_overlay);
     Celx_RegisterMethod(l, "verbosity", celestia_verbosity);
+    Celx_RegisterMethod(l, "getframestats", celestia_getframestats);
+    Celx_RegisterMethod(l, "getmemoryusage", celestia_getmemoryusage);
+    Celx_RegisterMethod(l, "setprofiling", celestia_setprofiling);
+    Celx_RegisterMethod(l, "starttrace", celestia_starttrace);
+    Celx_RegisterMethod(l, "stoptrace", celestia_stoptrace);
 
     // Compatibility audio playback
     Celx_RegisterMethod(l, "play", celestia_play);
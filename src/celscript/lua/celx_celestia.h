@@ -12,7 +12,29 @@
 #ifndef _CELX_CELESTIA_H_
 #define _CELX_CELESTIA_H_
 
+#include <cstdint>
+#include <limits>
+#include <Eigen/Core>
+
 struct lua_State;
+class StarDatabase;
+
+// The stars selected by celestia:getstardata, and the columns of data
+// about them pushed as a table
+struct StarDataRequest
+{
+    std::uint32_t first{ 0 };
+    std::uint32_t count{ std::numeric_limits<std::uint32_t>::max() };
+    Eigen::Vector3f center{ Eigen::Vector3f::Zero() };
+    float radius{ 0.0f };
+    Eigen::Vector3f viewpoint{ Eigen::Vector3f::Zero() };
+    float maxMagnitude{ std::numeric_limits<float>::infinity() };
+    bool packed{ false };
+
+    // Read the numeric and boolean fields of the table at index
+    void read(lua_State*, int index);
+    int push(lua_State*, const StarDatabase&) const;
+};
 
 int celestia_new(lua_State*, CelestiaCore*);
 CelestiaCore* to_celestia(lua_State*, int);
@@ -9,7 +9,9 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <vector>
 #include "celx.h"
+#include "celx_gl.h"
 #include "celx_internal.h"
 #include "celx_object.h"
 #include <celengine/glsupport.h>
@@ -103,6 +105,7 @@ static int gl_TexParameter(lua_State* l)
     float x = (float)celx.safeGetNumber(1, WrongType, "argument 1 to gl.TexParameter must be a number", 0.0);
     float y = (float)celx.safeGetNumber(2, WrongType, "argument 2 to gl.TexParameter must be a number", 0.0);
     float z = (float)celx.safeGetNumber(3, WrongType, "argument 3 to gl.TexParameter must be a number", 0.0);
+    fpcFlush();
     glTexParameteri((GLint) x, (GLenum) y, (GLenum) z);
     return 0;
 }
@@ -137,6 +140,7 @@ static int gl_LineWidth(lua_State* l)
     CelxLua celx(l);
     celx.checkArgs(1, 1, "One argument expected for gl.LineWidth()");
     float n = (float)celx.safeGetNumber(1, WrongType, "argument 1 to gl.LineWidth must be a number", 1.0);
+    fpcFlush();
     glLineWidth(n);
     return 0;
 }
@@ -157,6 +161,7 @@ static int gl_BlendFunc(lua_State* l)
     celx.checkArgs(2, 2, "Two arguments expected for gl.BlendFunc()");
     int i = (int)celx.safeGetNumber(1, WrongType, "argument 1 to gl.BlendFunc must be a number", 0.0);
     int j = (int)celx.safeGetNumber(2, WrongType, "argument 2 to gl.BlendFunc must be a number", 0.0);
+    fpcFlush();
     glBlendFuncSeparate(i,j,GL_ZERO,GL_ONE);
     return 0;
 }
@@ -167,7 +172,7 @@ static int gl_Begin(lua_State* l)
     celx.checkArgs(1, 1, "One argument expected for gl.Begin()");
     int i = (int)celx.safeGetNumber(1, WrongType, "argument 1 to gl.Begin must be a number", 0.0);
 #ifndef USE_GLES_COMPAT_LAYER
-    glUseProgram(0);
+    GLProgram::useNone();
 #endif
     glBegin(i);
     return 0;
@@ -232,6 +237,84 @@ static int gl_PushMatrix(lua_State* l)
     return 0;
 }
 
+// Read the numbers of a flat table argument, n per vertex
+static bool getVertexData(lua_State* l, int index, int n, std::vector<float>& data)
+{
+    auto size = static_cast<int>(lua_rawlen(l, index));
+    if (size % n != 0)
+        return false;
+    data.resize(size);
+    for (int i = 0; i < size; i++)
+    {
+        lua_rawgeti(l, index, i + 1);
+        int isNumber = 0;
+        data[i] = (float) lua_tonumberx(l, -1, &isNumber);
+        lua_pop(l, 1);
+        if (isNumber == 0)
+            return false;
+    }
+    return true;
+}
+
+// gl.Shape(mode, positions [, texcoords [, colors]]) uploads a shape of x, y
+// positions, u, v texture coordinates and r, g, b, a colors and returns its
+// handle; without colors it is drawn with the current color
+static int gl_Shape(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(2, 4, "Two to four arguments expected for gl.Shape()");
+    int mode = (int)celx.safeGetNumber(1, WrongType, "argument 1 to gl.Shape must be a number", 0.0);
+
+    std::vector<float> positions;
+    std::vector<float> texCoords;
+    std::vector<float> colors;
+    if (!celx.isTable(2) || !getVertexData(l, 2, 2, positions))
+        celx.doError("argument 2 to gl.Shape must be a table of x, y positions");
+    auto count = static_cast<int>(positions.size() / 2);
+    if (!lua_isnoneornil(l, 3) &&
+        (!celx.isTable(3) || !getVertexData(l, 3, 2, texCoords) || texCoords.size() != positions.size()))
+    {
+        celx.doError("argument 3 to gl.Shape must be a table of u, v coordinates for each position");
+    }
+    if (!lua_isnoneornil(l, 4) &&
+        (!celx.isTable(4) || !getVertexData(l, 4, 4, colors) || colors.size() != positions.size() * 2))
+    {
+        celx.doError("argument 4 to gl.Shape must be a table of r, g, b, a colors for each position");
+    }
+
+    int handle = fpcCreateShape(mode, positions.data(),
+                                texCoords.empty() ? nullptr : texCoords.data(),
+                                colors.empty() ? nullptr : colors.data(),
+                                count);
+    if (handle == 0)
+        return celx.push();
+    return celx.push(handle);
+}
+
+static int gl_DrawShape(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(1, 1, "One argument expected for gl.DrawShape()");
+    int handle = (int)celx.safeGetNumber(1, WrongType, "argument 1 to gl.DrawShape must be a number", 0.0);
+    if (!fpcDrawShape(handle))
+        celx.doError("argument 1 to gl.DrawShape isn't a shape");
+    return 0;
+}
+
+static int gl_DeleteShape(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(1, 1, "One argument expected for gl.DeleteShape()");
+    int handle = (int)celx.safeGetNumber(1, WrongType, "argument 1 to gl.DeleteShape must be a number", 0.0);
+    fpcDeleteShape(handle);
+    return 0;
+}
+
+void FlushLuaGraphics()
+{
+    fpcFlush();
+}
+
 void LoadLuaGraphicsLibrary(lua_State* l)
 {
     CelxLua celx(l);
@@ -254,12 +337,19 @@ void LoadLuaGraphicsLibrary(lua_State* l)
     celx.registerMethod("PopMatrix", gl_PopMatrix);
     celx.registerMethod("LoadIdentity", gl_LoadIdentity);
     celx.registerMethod("PushMatrix", gl_PushMatrix);
+    celx.registerMethod("Shape", gl_Shape);
+    celx.registerMethod("DrawShape", gl_DrawShape);
+    celx.registerMethod("DeleteShape", gl_DeleteShape);
 
     celx.registerValue("QUADS", GL_QUADS);
     celx.registerValue("LIGHTING", GL_LIGHTING);
     celx.registerValue("POINTS", GL_POINTS);
     celx.registerValue("LINES", GL_LINES);
     celx.registerValue("LINE_LOOP", GL_LINE_LOOP);
+    celx.registerValue("LINE_STRIP", GL_LINE_STRIP);
+    celx.registerValue("TRIANGLES", GL_TRIANGLES);
+    celx.registerValue("TRIANGLE_STRIP", GL_TRIANGLE_STRIP);
+    celx.registerValue("TRIANGLE_FAN", GL_TRIANGLE_FAN);
     celx.registerValue("LINE_SMOOTH", GL_LINE_SMOOTH);
     celx.registerValue("POLYGON", GL_POLYGON);
     celx.registerValue("PROJECTION", GL_PROJECTION);
@@ -15,5 +15,7 @@
 struct lua_State;
 
 extern void LoadLuaGraphicsLibrary(lua_State* l);
+// Draw what the scripts batched; done before other drawing
+extern void FlushLuaGraphics();
 
 #endif // _CELX_GL_H_
@@ -0,0 +1,633 @@
+// celx_worker.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Lua script extensions for Celestia: worker object
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "celx_worker.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <celengine/stardb.h>
+#include "celx.h"
+#include "celx_internal.h"
+#include "celx_celestia.h"
+
+namespace
+{
+
+// Tables nested deeper than this, which are likely to have cycles, can't
+// be sent
+constexpr int MaxMessageDepth = 32;
+
+// Interval in instructions at which a worker checks whether it's stopped
+constexpr int StopCheckInterval = 1000;
+
+const char* WorkerKey = "celestia-worker";
+
+void
+openLibrary(lua_State* l, const char* name, lua_CFunction func)
+{
+#if LUA_VERSION_NUM >= 502
+    luaL_requiref(l, name, func, 1);
+    lua_pop(l, 1);
+#else
+    lua_pushcfunction(l, func);
+    lua_pushstring(l, name);
+    lua_call(l, 1, 0);
+#endif
+}
+
+template<typename T>
+void
+packRaw(std::string& out, T value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+bool
+unpackRaw(const char*& p, const char* end, T& value)
+{
+    if (static_cast<std::size_t>(end - p) < sizeof(T))
+        return false;
+    std::memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+}
+
+// The states don't share any memory, so values are sent between them
+// packed into strings: a type tag followed by the value, with tables as
+// their pairs of keys and values up to an end tag. Only nil, booleans,
+// numbers, strings and tables of these can be packed.
+bool
+packValue(lua_State* l, int index, std::string& out, int depth = 0)
+{
+    if (index < 0)
+        index = lua_gettop(l) + index + 1;
+
+    switch (lua_type(l, index))
+    {
+    case LUA_TNIL:
+        out.push_back('n');
+        return true;
+
+    case LUA_TBOOLEAN:
+        out.push_back(lua_toboolean(l, index) ? 't' : 'f');
+        return true;
+
+    case LUA_TNUMBER:
+#if LUA_VERSION_NUM >= 503
+        if (lua_isinteger(l, index))
+        {
+            out.push_back('i');
+            packRaw<lua_Integer>(out, lua_tointeger(l, index));
+            return true;
+        }
+#endif
+        out.push_back('d');
+        packRaw<lua_Number>(out, lua_tonumber(l, index));
+        return true;
+
+    case LUA_TSTRING:
+        {
+            std::size_t length;
+            const char* s = lua_tolstring(l, index, &length);
+            out.push_back('s');
+            packRaw<std::uint32_t>(out, static_cast<std::uint32_t>(length));
+            out.append(s, length);
+        }
+        return true;
+
+    case LUA_TTABLE:
+        if (depth == MaxMessageDepth)
+            return false;
+        out.push_back('{');
+        lua_pushnil(l);
+        while (lua_next(l, index) != 0)
+        {
+            if (!packValue(l, -2, out, depth + 1) || !packValue(l, -1, out, depth + 1))
+            {
+                lua_pop(l, 2);
+                return false;
+            }
+            lua_pop(l, 1);
+        }
+        out.push_back('}');
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+bool
+unpackValue(lua_State* l, const char*& p, const char* end)
+{
+    if (p == end)
+        return false;
+
+    switch (*p++)
+    {
+    case 'n':
+        lua_pushnil(l);
+        return true;
+
+    case 't':
+    case 'f':
+        lua_pushboolean(l, p[-1] == 't');
+        return true;
+
+#if LUA_VERSION_NUM >= 503
+    case 'i':
+        {
+            lua_Integer value;
+            if (!unpackRaw(p, end, value))
+                return false;
+            lua_pushinteger(l, value);
+        }
+        return true;
+#endif
+
+    case 'd':
+        {
+            lua_Number value;
+            if (!unpackRaw(p, end, value))
+                return false;
+            lua_pushnumber(l, value);
+        }
+        return true;
+
+    case 's':
+        {
+            std::uint32_t length;
+            if (!unpackRaw(p, end, length) || static_cast<std::size_t>(end - p) < length)
+                return false;
+            lua_pushlstring(l, p, length);
+            p += length;
+        }
+        return true;
+
+    case '{':
+        lua_newtable(l);
+        while (p != end && *p != '}')
+        {
+            if (!unpackValue(l, p, end) || !unpackValue(l, p, end))
+                return false;
+            lua_settable(l, -3);
+        }
+        if (p == end)
+            return false;
+        p++;
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+/*! A Lua state of its own running a chunk of code on a thread, for
+ *  computations which would otherwise hold up the frames. The worker
+ *  exchanges messages with the script which started it, and can read the
+ *  star catalog, which doesn't change once loaded; it has no access to
+ *  anything else of the simulation, nor to the libraries for files and the
+ *  system.
+ *
+ *  In the worker, send(value) posts a message to the script, receive()
+ *  takes the next message from it, waiting up to an optional timeout in
+ *  seconds and returning nil if none came, and getstardata() and
+ *  getstarcount() are as in the celestia object, with positions given as
+ *  tables of x, y and z in light years.
+ */
+class LuaWorker
+{
+ public:
+    LuaWorker(std::string code, std::string name, const StarDatabase* stardb);
+    ~LuaWorker();
+
+    LuaWorker(const LuaWorker&) = delete;
+    LuaWorker& operator=(const LuaWorker&) = delete;
+
+    void post(std::string message);
+    std::optional<std::string> take();
+    bool isRunning() const;
+    std::string getError() const;
+    // Stop the worker at its next check, without waiting for it
+    void stop();
+
+ private:
+    void run();
+
+    static LuaWorker* fromState(lua_State* l);
+    static void checkStop(lua_State* l, lua_Debug*);
+    static int send(lua_State* l);
+    static int receive(lua_State* l);
+    static int getStarData(lua_State* l);
+    static int getStarCount(lua_State* l);
+
+    std::string code;
+    std::string name;
+    const StarDatabase* stardb;
+
+    mutable std::mutex mutex;
+    std::condition_variable condition;
+    // Messages to the worker, and from it
+    std::deque<std::string> inbox;
+    std::deque<std::string> outbox;
+    std::atomic<bool> stopRequested{ false };
+    bool running{ true };
+    std::string error;
+
+    std::thread thread;
+};
+
+
+LuaWorker::LuaWorker(std::string code, std::string name, const StarDatabase* stardb) :
+    code(std::move(code)),
+    name(std::move(name)),
+    stardb(stardb)
+{
+    thread = std::thread(&LuaWorker::run, this);
+}
+
+
+LuaWorker::~LuaWorker()
+{
+    stop();
+    thread.join();
+}
+
+
+void
+LuaWorker::post(std::string message)
+{
+    {
+        std::scoped_lock lock(mutex);
+        inbox.push_back(std::move(message));
+    }
+    condition.notify_all();
+}
+
+
+std::optional<std::string>
+LuaWorker::take()
+{
+    std::scoped_lock lock(mutex);
+    if (outbox.empty())
+        return std::nullopt;
+    std::string message = std::move(outbox.front());
+    outbox.pop_front();
+    return message;
+}
+
+
+bool
+LuaWorker::isRunning() const
+{
+    std::scoped_lock lock(mutex);
+    return running;
+}
+
+
+std::string
+LuaWorker::getError() const
+{
+    std::scoped_lock lock(mutex);
+    return error;
+}
+
+
+void
+LuaWorker::stop()
+{
+    {
+        std::scoped_lock lock(mutex);
+        stopRequested = true;
+    }
+    condition.notify_all();
+}
+
+
+void
+LuaWorker::run()
+{
+    lua_State* l = luaL_newstate();
+    openLibrary(l, "", luaopen_base);
+    openLibrary(l, LUA_MATHLIBNAME, luaopen_math);
+    openLibrary(l, LUA_TABLIBNAME, luaopen_table);
+    openLibrary(l, LUA_STRLIBNAME, luaopen_string);
+#if LUA_VERSION_NUM >= 502
+    openLibrary(l, LUA_COLIBNAME, luaopen_coroutine);
+#endif
+
+    lua_pushstring(l, WorkerKey);
+    lua_pushlightuserdata(l, this);
+    lua_settable(l, LUA_REGISTRYINDEX);
+
+    lua_register(l, "send", send);
+    lua_register(l, "receive", receive);
+    lua_register(l, "getstardata", getStarData);
+    lua_register(l, "getstarcount", getStarCount);
+    lua_sethook(l, checkStop, LUA_MASKCOUNT, StopCheckInterval);
+
+    std::string message;
+    if (luaL_loadbuffer(l, code.data(), code.size(), name.c_str()) != 0 ||
+        lua_pcall(l, 0, 0, 0) != 0)
+    {
+        const char* errorMessage = lua_tostring(l, -1);
+        message = errorMessage == nullptr ? "Unknown worker error" : errorMessage;
+    }
+    lua_close(l);
+
+    std::scoped_lock lock(mutex);
+    running = false;
+    // Being stopped isn't an error
+    if (!stopRequested)
+        error = std::move(message);
+}
+
+
+LuaWorker*
+LuaWorker::fromState(lua_State* l)
+{
+    lua_pushstring(l, WorkerKey);
+    lua_gettable(l, LUA_REGISTRYINDEX);
+    auto worker = static_cast<LuaWorker*>(lua_touserdata(l, -1));
+    lua_pop(l, 1);
+    return worker;
+}
+
+
+void
+LuaWorker::checkStop(lua_State* l, lua_Debug*)
+{
+    if (fromState(l)->stopRequested)
+        luaL_error(l, "Worker stopped");
+}
+
+
+int
+LuaWorker::send(lua_State* l)
+{
+    std::string message;
+    if (!packValue(l, 1, message))
+        return luaL_error(l, "send: only nil, booleans, numbers, strings and tables of them can be sent");
+
+    LuaWorker* worker = fromState(l);
+    std::scoped_lock lock(worker->mutex);
+    worker->outbox.push_back(std::move(message));
+    return 0;
+}
+
+
+int
+LuaWorker::receive(lua_State* l)
+{
+    LuaWorker* worker = fromState(l);
+    bool hasTimeout = lua_isnumber(l, 1);
+    auto timeout = std::chrono::duration<double>(hasTimeout ? lua_tonumber(l, 1) : 0.0);
+
+    // Errors are only raised once the lock is released
+    std::optional<std::string> message;
+    {
+        std::unique_lock lock(worker->mutex);
+        auto ready = [worker]() { return !worker->inbox.empty() || worker->stopRequested; };
+        if (hasTimeout)
+            worker->condition.wait_for(lock, timeout, ready);
+        else
+            worker->condition.wait(lock, ready);
+
+        if (!worker->stopRequested && !worker->inbox.empty())
+        {
+            message = std::move(worker->inbox.front());
+            worker->inbox.pop_front();
+        }
+    }
+
+    if (worker->stopRequested)
+        return luaL_error(l, "Worker stopped");
+    if (!message.has_value())
+        return 0;
+
+    const char* p = message->data();
+    if (!unpackValue(l, p, p + message->size()))
+        return luaL_error(l, "receive: bad message");
+    return 1;
+}
+
+
+// Read a position given as a table of x, y and z
+bool
+readVector(lua_State* l, int index, const char* field, Eigen::Vector3f& v)
+{
+    lua_getfield(l, index, field);
+    if (lua_istable(l, -1))
+    {
+        lua_getfield(l, -1, "x");
+        lua_getfield(l, -2, "y");
+        lua_getfield(l, -3, "z");
+        v = Eigen::Vector3f(static_cast<float>(lua_tonumber(l, -3)),
+                            static_cast<float>(lua_tonumber(l, -2)),
+                            static_cast<float>(lua_tonumber(l, -1)));
+        lua_pop(l, 3);
+    }
+    bool ok = lua_isnil(l, -1) || lua_istable(l, -1);
+    lua_pop(l, 1);
+    return ok;
+}
+
+
+int
+LuaWorker::getStarData(lua_State* l)
+{
+    LuaWorker* worker = fromState(l);
+    StarDataRequest request;
+    if (lua_istable(l, 1))
+    {
+        request.read(l, 1);
+        if (!readVector(l, 1, "viewpoint", request.viewpoint) || !readVector(l, 1, "center", request.center))
+            return luaL_error(l, "getstardata: center and viewpoint must be tables of x, y and z");
+    }
+    return request.push(l, *worker->stardb);
+}
+
+
+int
+LuaWorker::getStarCount(lua_State* l)
+{
+    lua_pushnumber(l, static_cast<lua_Number>(fromState(l)->stardb->size()));
+    return 1;
+}
+
+
+LuaWorker*
+to_worker(lua_State* l, int index)
+{
+    auto worker = static_cast<LuaWorker**>(Celx_CheckUserData(l, index, Celx_Worker));
+    return worker == nullptr ? nullptr : *worker;
+}
+
+
+LuaWorker*
+this_worker(lua_State* l)
+{
+    LuaWorker* worker = to_worker(l, 1);
+    if (worker == nullptr)
+        Celx_DoError(l, "Bad worker object!");
+    return worker;
+}
+
+
+/*! worker:send(value)
+ *
+ * Post a message to the worker, which it gets from receive(). Only nil,
+ * booleans, numbers, strings and tables of them can be sent.
+ */
+int
+worker_send(lua_State* l)
+{
+    Celx_CheckArgs(l, 2, 2, "One argument expected for worker:send()");
+    LuaWorker* worker = this_worker(l);
+
+    std::string message;
+    if (!packValue(l, 2, message))
+    {
+        Celx_DoError(l, "Only nil, booleans, numbers, strings and tables of them can be sent to a worker");
+        return 0;
+    }
+    worker->post(std::move(message));
+    return 0;
+}
+
+
+/*! worker:receive()
+ *
+ * Take the next message the worker sent, or nil if there's none yet; it
+ * doesn't wait, so scripts poll for messages once a frame, for instance
+ * with waituntil().
+ */
+int
+worker_receive(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 1, "No arguments expected for worker:receive()");
+    LuaWorker* worker = this_worker(l);
+
+    std::optional<std::string> message = worker->take();
+    if (!message.has_value())
+        return 0;
+
+    const char* p = message->data();
+    if (!unpackValue(l, p, p + message->size()))
+    {
+        Celx_DoError(l, "Bad message from worker");
+        return 0;
+    }
+    return 1;
+}
+
+
+/*! worker:running()
+ *
+ * Return true until the code of the worker has finished.
+ */
+int
+worker_running(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 1, "No arguments expected for worker:running()");
+    lua_pushboolean(l, this_worker(l)->isRunning());
+    return 1;
+}
+
+
+/*! worker:error()
+ *
+ * Return the error which ended the worker, or nil.
+ */
+int
+worker_error(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 1, "No arguments expected for worker:error()");
+    std::string error = this_worker(l)->getError();
+    if (error.empty())
+        return 0;
+    lua_pushstring(l, error.c_str());
+    return 1;
+}
+
+
+/*! worker:stop()
+ *
+ * Stop the worker; it's also stopped when the script ends.
+ */
+int
+worker_stop(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 1, "No arguments expected for worker:stop()");
+    this_worker(l)->stop();
+    return 0;
+}
+
+
+int
+worker_tostring(lua_State* l)
+{
+    lua_pushstring(l, "[Worker]");
+    return 1;
+}
+
+
+int
+worker_gc(lua_State* l)
+{
+    auto worker = static_cast<LuaWorker**>(Celx_CheckUserData(l, 1, Celx_Worker));
+    if (worker != nullptr)
+    {
+        delete *worker;
+        *worker = nullptr;
+    }
+    return 0;
+}
+
+} // end unnamed namespace
+
+
+int
+worker_new(lua_State* l, const char* code, const char* name, const StarDatabase* stardb)
+{
+    auto worker = static_cast<LuaWorker**>(lua_newuserdata(l, sizeof(LuaWorker*)));
+    *worker = new LuaWorker(code, name, stardb);
+    Celx_SetClass(l, Celx_Worker);
+    return 1;
+}
+
+
+void
+CreateWorkerMetaTable(lua_State* l)
+{
+    Celx_CreateClassMetatable(l, Celx_Worker);
+
+    Celx_RegisterMethod(l, "__tostring", worker_tostring);
+    Celx_RegisterMethod(l, "__gc", worker_gc);
+    Celx_RegisterMethod(l, "send", worker_send);
+    Celx_RegisterMethod(l, "receive", worker_receive);
+    Celx_RegisterMethod(l, "running", worker_running);
+    Celx_RegisterMethod(l, "error", worker_error);
+    Celx_RegisterMethod(l, "stop", worker_stop);
+
+    lua_pop(l, 1); // remove metatable from stack
+}
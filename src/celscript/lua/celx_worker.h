@@ -0,0 +1,20 @@
+// celx_worker.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Lua script extensions for Celestia: worker object
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+struct lua_State;
+class StarDatabase;
+
+// Start a worker running the chunk of Lua code on a thread of its own,
+// and push the object the script talks to it through.
+int worker_new(lua_State* l, const char* code, const char* name, const StarDatabase* stardb);
+void CreateWorkerMetaTable(lua_State* l);
@@ -9,10 +9,13 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstddef>
 #include <cstring>                      // memcpy
 #include <memory>
+#include <vector>
 #include <Eigen/Core>
 #include <fmt/format.h>
 #include <celengine/glsupport.h>
@@ -91,7 +94,7 @@ const char kVertexShader[] = R"glsl(
 precision highp float;
 #endif
 
-attribute vec2 in_Position;
+attribute vec4 in_Position;
 attribute vec2 in_TexCoord0;
 #if SHADER_COLOR
 attribute vec4 in_Color;
@@ -115,7 +118,7 @@ void main(void)
 #if SHADER_TEXCOORD
     v_texCoord = in_TexCoord0;
 #endif
-    gl_Position = MVPMatrix * vec4(in_Position, 0.0, 1.0);
+    gl_Position = MVPMatrix * in_Position;
 }}
 )glsl";
 
@@ -154,17 +157,43 @@ enum ShaderAttributes
     SHADER_COUNT    = 2
 };
 
-GLenum gPrimitive = GL_NONE;
-int gVertexCounter = 0;
-int gTexCoordCounter = 0;
-int gColorCounter = 0;
-
+// Vertices are batched in clip coordinates, so that primitives drawn with
+// different matrices are still drawn together. Retained shapes keep them
+// in object coordinates.
 struct Vertex
 {
-    float x, y, u, v, r, g, b, a;
+    float x, y, z, w, u, v, r, g, b, a;
+};
+
+// The primitive between Begin and End
+GLenum gPrimitive = GL_NONE;
+bool gPrimitiveTextured = false;
+Eigen::Matrix4f gPrimitiveMVP = Eigen::Matrix4f::Identity();
+std::vector<Vertex> gPrimitiveVertices;
+
+// Current attributes of the next vertex
+std::array<float, 4> gColor { 0.0f, 0.0f, 0.0f, 1.0f };
+std::array<float, 2> gTexCoord { 0.0f, 0.0f };
+
+// Vertices of the primitives ended since the last flush, all of the same
+// kind; drawing one of another kind or changing the state flushes them
+constexpr std::size_t MaxBatchVertices = 65536;
+GLenum gBatchMode = GL_NONE;
+bool gBatchTextured = false;
+std::vector<Vertex> gBatch;
+GLuint gStreamBuffer = 0;
+
+struct Shape
+{
+    GLuint buffer{ 0 };
+    GLenum mode{ GL_NONE };
+    GLsizei count{ 0 };
+    bool textured{ false };
+    bool colored{ false };
 };
 
-std::array<Vertex, 16> vertices {};
+// Handle n is slot n - 1; deleted slots have no buffer
+std::vector<Shape> gShapes;
 
 GLProgram* BuildProgram(const std::string &vertex, const std::string &fragment)
 {
@@ -199,95 +228,135 @@ GLSLProgram* FindGLProgram(ShaderAttributes attr)
         std::string fragment = fmt::format(kFragmentShader, glsl_version, color, texture);
         auto *glprog = BuildProgram(vertex, fragment);
         if (glprog != nullptr)
-            programs[attr] = new GLSLProgram(glprog);
+            programs[attr] = prog = new GLSLProgram(glprog);
     }
     return prog;
 }
 
+// The mode of independent primitives a primitive is drawn with
+GLenum IndependentMode(GLenum primitive)
+{
+    switch (primitive)
+    {
+    case GL_POINTS:
+        return GL_POINTS;
+    case GL_LINES:
+    case GL_LINE_STRIP:
+    case GL_LINE_LOOP:
+        return GL_LINES;
+    case GL_TRIANGLES:
+    case GL_TRIANGLE_STRIP:
+    case GL_TRIANGLE_FAN:
+    case GL_QUADS:
+    case GL_POLYGON:
+        return GL_TRIANGLES;
+    default:
+        return GL_NONE;
+    }
+}
 
-void Draw()
+// Append the vertices of a primitive as independent points, lines or
+// triangles
+void AppendIndependent(GLenum primitive, const std::vector<Vertex> &in, std::vector<Vertex> &out)
 {
-    if (gPrimitive == GL_NONE || gVertexCounter == 0)
-        return; // Do nothing
+    std::size_t n = in.size();
+    switch (primitive)
+    {
+    case GL_POINTS:
+        out.insert(out.end(), in.begin(), in.end());
+        break;
+    case GL_LINES:
+        out.insert(out.end(), in.begin(), in.begin() + (n - n % 2));
+        break;
+    case GL_LINE_STRIP:
+    case GL_LINE_LOOP:
+        for (std::size_t i = 1; i < n; i++)
+        {
+            out.push_back(in[i - 1]);
+            out.push_back(in[i]);
+        }
+        if (primitive == GL_LINE_LOOP && n > 2)
+        {
+            out.push_back(in[n - 1]);
+            out.push_back(in[0]);
+        }
+        break;
+    case GL_TRIANGLES:
+        out.insert(out.end(), in.begin(), in.begin() + (n - n % 3));
+        break;
+    case GL_TRIANGLE_STRIP:
+        for (std::size_t i = 2; i < n; i++)
+        {
+            // keep the winding of the odd triangles
+            out.push_back(in[i % 2 == 0 ? i - 2 : i - 1]);
+            out.push_back(in[i % 2 == 0 ? i - 1 : i - 2]);
+            out.push_back(in[i]);
+        }
+        break;
+    case GL_QUADS:
+        for (std::size_t i = 3; i < n; i += 4)
+        {
+            out.insert(out.end(), { in[i - 3], in[i - 2], in[i - 1] });
+            out.insert(out.end(), { in[i - 3], in[i - 1], in[i] });
+        }
+        break;
+    case GL_TRIANGLE_FAN:
+    case GL_POLYGON:
+        for (std::size_t i = 2; i < n; i++)
+            out.insert(out.end(), { in[0], in[i - 1], in[i] });
+        break;
+    default:
+        break;
+    }
+}
 
-    bool hasTexCoords       = gTexCoordCounter == gVertexCounter;
-    bool hasColors          = gColorCounter == gVertexCounter;
-    ShaderAttributes type   = hasTexCoords ? SHADER_TEXCOORD : SHADER_COLOR;
+// Draw vertices from the bound array buffer
+void DrawArrays(GLenum mode, GLsizei count, bool textured, bool colored, const Eigen::Matrix4f &mvp)
+{
+    auto *prog = FindGLProgram(textured ? SHADER_TEXCOORD : SHADER_COLOR);
+    if (prog == nullptr)
+        return;
 
     glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    glVertexAttribPointer(
-        CelestiaGLProgram::VertexCoordAttributeIndex,
-        2, GL_FLOAT, false, sizeof(Vertex), &vertices[0].x
-    );
-
-    if (hasTexCoords)
+    glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
+                          4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          reinterpret_cast<const void*>(offsetof(Vertex, x)));
+    if (textured)
     {
         glEnableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
-        glVertexAttribPointer(
-            CelestiaGLProgram::TextureCoord0AttributeIndex,
-            2, GL_FLOAT, false, sizeof(Vertex), &vertices[0].u
-        );
+        glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex,
+                              2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                              reinterpret_cast<const void*>(offsetof(Vertex, u)));
     }
-
-    if (hasColors)
+    if (colored)
     {
         glEnableVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex);
-        glVertexAttribPointer(
-            CelestiaGLProgram::ColorAttributeIndex,
-            4, GL_FLOAT, false, sizeof(Vertex), &vertices[0].r
-        );
+        glVertexAttribPointer(CelestiaGLProgram::ColorAttributeIndex,
+                              4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                              reinterpret_cast<const void*>(offsetof(Vertex, r)));
     }
-
-    if (auto *prog = FindGLProgram(type); prog != nullptr)
+    else
     {
-        prog->use();
-        prog->setMVPMatrix(g_projectionStack[g_projectionPosition] * g_modelViewStack[g_modelViewPosition]);
-        glDrawArrays(gPrimitive, 0, gVertexCounter);
+        glVertexAttrib4f(CelestiaGLProgram::ColorAttributeIndex, gColor[0], gColor[1], gColor[2], gColor[3]);
     }
 
+    prog->use();
+    prog->setMVPMatrix(mvp);
+    glDrawArrays(mode, 0, count);
+
     glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    if (hasTexCoords)
-        glDisableVertexAttribArray(CelestiaGLProgram::TextureCoord3AttributeIndex);
-    if (hasColors)
+    if (textured)
+        glDisableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
+    if (colored)
         glDisableVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex);
-
-    // reset state
-    gVertexCounter = 0;
-    gTexCoordCounter = 0;
-    gColorCounter = 0;
-    gPrimitive = GL_NONE;
 }
 
 void PushVertex(float x, float y)
 {
-    if (gVertexCounter < vertices.size())
-    {
-        vertices[gVertexCounter].x = x;
-        vertices[gVertexCounter].y = y;
-        gVertexCounter++;
-    }
-}
-
-void PushTexCoord(float u, float v)
-{
-    if (gTexCoordCounter < vertices.size())
-    {
-        vertices[gTexCoordCounter].u = u;
-        vertices[gTexCoordCounter].v = v;
-        gTexCoordCounter++;
-    }
-}
-
-void PushColor(float r, float g, float b, float a)
-{
-    if (gColorCounter < vertices.size())
-    {
-        vertices[gColorCounter].r = r;
-        vertices[gColorCounter].g = g;
-        vertices[gColorCounter].b = b;
-        vertices[gColorCounter].a = a;
-        gColorCounter++;
-    }
+    Eigen::Vector4f p = gPrimitiveMVP * Eigen::Vector4f(x, y, 0.0f, 1.0f);
+    gPrimitiveVertices.push_back({ p.x(), p.y(), p.z(), p.w(),
+                                   gTexCoord[0], gTexCoord[1],
+                                   gColor[0], gColor[1], gColor[2], gColor[3] });
 }
 } // namespace
 
@@ -493,6 +562,7 @@ void fpcEnable(GLenum param) noexcept
     case GL_LINE_SMOOTH:
 #endif
     case GL_BLEND:
+        fpcFlush();
         orig_glEnable(param);
     default:
         break;
@@ -507,6 +577,7 @@ void fpcDisable(GLenum param) noexcept
     case GL_LINE_SMOOTH:
 #endif
     case GL_BLEND:
+        fpcFlush();
         orig_glDisable(param);
     default:
         break;
@@ -515,31 +586,141 @@ void fpcDisable(GLenum param) noexcept
 
 void fpcBegin(GLenum param) noexcept
 {
-    if (gPrimitive == 0)
-        gPrimitive = (param == GL_POLYGON || param == GL_QUADS) ? GL_TRIANGLE_FAN : param;
+    if (gPrimitive != GL_NONE || IndependentMode(param) == GL_NONE)
+        return;
+
+    gPrimitive = param;
+    gPrimitiveTextured = false;
+    gPrimitiveMVP = g_projectionStack[g_projectionPosition] * g_modelViewStack[g_modelViewPosition];
+    gPrimitiveVertices.clear();
 }
 
 void fpcEnd() noexcept
 {
-    Draw();
+    if (gPrimitive == GL_NONE)
+        return;
+
+    GLenum mode = IndependentMode(gPrimitive);
+    if (mode != gBatchMode || gPrimitiveTextured != gBatchTextured
+        || gBatch.size() + gPrimitiveVertices.size() * 3 > MaxBatchVertices)
+    {
+        fpcFlush();
+        gBatchMode = mode;
+        gBatchTextured = gPrimitiveTextured;
+    }
+
+    AppendIndependent(gPrimitive, gPrimitiveVertices, gBatch);
+    gPrimitive = GL_NONE;
+}
+
+void fpcFlush() noexcept
+{
+    if (gBatch.empty())
+        return;
+
+    if (gStreamBuffer == 0)
+        glGenBuffers(1, &gStreamBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, gStreamBuffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(gBatch.size() * sizeof(Vertex)), gBatch.data(), GL_STREAM_DRAW);
+    DrawArrays(gBatchMode, static_cast<GLsizei>(gBatch.size()), gBatchTextured, true, Eigen::Matrix4f::Identity());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    gBatch.clear();
+    gBatchMode = GL_NONE;
 }
 
 void fpcColor4f(float r, float g, float b, float a) noexcept
 {
+    gColor = { r, g, b, a };
     if (gPrimitive == GL_NONE)
         glVertexAttrib4f(CelestiaGLProgram::ColorAttributeIndex, r, g, b, a);
-    else
-        PushColor(r, g, b, a);
 }
 
 void fpcVertex2f(float x, float y) noexcept
 {
-    PushVertex(x, y);
+    if (gPrimitive != GL_NONE)
+        PushVertex(x, y);
 }
 
 void fpcTexCoord2f(float x, float y) noexcept
 {
-    PushTexCoord(x, y);
+    gTexCoord = { x, y };
+    if (gPrimitive != GL_NONE)
+        gPrimitiveTextured = true;
+}
+
+int fpcCreateShape(GLenum mode, const float *positions, const float *texCoords, const float *colors, int count) noexcept
+{
+    GLenum independentMode = IndependentMode(mode);
+    if (independentMode == GL_NONE || count <= 0)
+        return 0;
+
+    std::vector<Vertex> in;
+    in.reserve(static_cast<std::size_t>(count));
+    for (int i = 0; i < count; i++)
+    {
+        Vertex &v = in.emplace_back();
+        v = { positions[2 * i], positions[2 * i + 1], 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+        if (texCoords != nullptr)
+        {
+            v.u = texCoords[2 * i];
+            v.v = texCoords[2 * i + 1];
+        }
+        if (colors != nullptr)
+        {
+            v.r = colors[4 * i];
+            v.g = colors[4 * i + 1];
+            v.b = colors[4 * i + 2];
+            v.a = colors[4 * i + 3];
+        }
+    }
+
+    std::vector<Vertex> vertices;
+    AppendIndependent(mode, in, vertices);
+    if (vertices.empty())
+        return 0;
+
+    Shape shape;
+    shape.mode = independentMode;
+    shape.count = static_cast<GLsizei>(vertices.size());
+    shape.textured = texCoords != nullptr;
+    shape.colored = colors != nullptr;
+    glGenBuffers(1, &shape.buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, shape.buffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices.size() * sizeof(Vertex)), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    auto slot = std::find_if(gShapes.begin(), gShapes.end(), [](const Shape &s) { return s.buffer == 0; });
+    if (slot == gShapes.end())
+        slot = gShapes.insert(gShapes.end(), shape);
+    else
+        *slot = shape;
+    return static_cast<int>(slot - gShapes.begin()) + 1;
+}
+
+bool fpcDrawShape(int handle) noexcept
+{
+    if (handle <= 0 || handle > static_cast<int>(gShapes.size()) || gShapes[handle - 1].buffer == 0)
+        return false;
+
+    // keep the order with the immediate mode primitives
+    fpcFlush();
+
+    const Shape &shape = gShapes[handle - 1];
+    glBindBuffer(GL_ARRAY_BUFFER, shape.buffer);
+    DrawArrays(shape.mode, shape.count, shape.textured, shape.colored,
+               g_projectionStack[g_projectionPosition] * g_modelViewStack[g_modelViewPosition]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+void fpcDeleteShape(int handle) noexcept
+{
+    if (handle <= 0 || handle > static_cast<int>(gShapes.size()) || gShapes[handle - 1].buffer == 0)
+        return;
+
+    glDeleteBuffers(1, &gShapes[handle - 1].buffer);
+    gShapes[handle - 1] = Shape();
 }
 
 void gluLookAt(float ix, float iy, float iz, float cx, float cy, float cz, float ux, float uy, float uz) noexcept
@@ -27,6 +27,9 @@
 #ifndef GL_QUADS
 #define GL_QUADS 0x0007
 #endif
+#ifndef GL_LINE_STRIP
+#define GL_LINE_STRIP 0x0003
+#endif
 #ifndef GL_LIGHTING
 #define GL_LIGHTING 0x0B50
 #endif
@@ -156,4 +159,12 @@ void fpcEnd() noexcept;
 void fpcColor4f(float r, float g, float b, float a) noexcept;
 void fpcVertex2f(float x, float y) noexcept;
 void fpcTexCoord2f(float x, float y) noexcept;
+// Draw the primitives batched since the last call; called before changing
+// any state they are drawn with and at the end of the frame
+void fpcFlush() noexcept;
+// Retained shapes, uploaded once and drawn with the matrices current at
+// each draw; texCoords and colors are optional. Handles are positive.
+int fpcCreateShape(GLenum mode, const float *positions, const float *texCoords, const float *colors, int count) noexcept;
+bool fpcDrawShape(int handle) noexcept;
+void fpcDeleteShape(int handle) noexcept;
 void fpcLookAt(float ix, float iy, float iz, float cx, float cy, float cz, float ux, float uy, float uz) noexcept;
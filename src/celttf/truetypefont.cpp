@@ -9,33 +9,50 @@
 
 #include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+#include <fmt/format.h>
 #include <celcompat/charconv.h>
 #include <celengine/glsupport.h>
 #include <celengine/render.h>
+#include <celrender/renderstats.h>
+#include <celrender/texturememory.h>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/color.h>
+#include <celutil/diskcache.h>
+#include <celutil/fsutils.h>
 #include <celutil/logger.h>
 #include <celutil/utf8.h>
 #include <ft2build.h>
-#include <map>
-#include <system_error>
-#include <vector>
 #include FT_FREETYPE_H
+#include FT_MODULE_H
 #include "truetypefont.h"
 
 #define DUMP_TEXTURE 0
 
-#if DUMP_TEXTURE
-#include <fstream>
+// Distance fields are rendered by FreeType since 2.11
+#if FREETYPE_MAJOR > 2 || (FREETYPE_MAJOR == 2 && FREETYPE_MINOR >= 11)
+#define HAVE_FT_SDF 1
 #endif
 
 using celestia::compat::from_chars;
 using celestia::util::GetLogger;
 
+namespace celutil = celestia::util;
+
 struct Glyph
 {
     wchar_t ch;
 
-    int ax; // advance.x
-    int ay; // advance.y
+    float ax; // advance.x
+    float ay; // advance.y
 
     unsigned int bw; // bitmap.width;
     unsigned int bh; // bitmap.height;
@@ -43,8 +60,8 @@ struct Glyph
     int bl; // bitmap_left;
     int bt; // bitmap_top;
 
-    float tx; // x offset of glyph in texture coordinates
-    float ty; // y offset of glyph in texture coordinates
+    int tx; // x offset of glyph in the texture in pixels
+    int ty; // y offset of glyph in the texture in pixels
 };
 
 struct UnicodeBlock
@@ -52,121 +69,164 @@ struct UnicodeBlock
     wchar_t first, last;
 };
 
-struct TextureFontPrivate
+namespace
 {
-    struct FontVertex
-    {
-        FontVertex(float _x, float _y, float _u, float _v) : x(_x), y(_y), u(_u), v(_v)
-        {
-        }
-        float x, y;
-        float u, v;
-    };
 
-    static_assert(std::is_standard_layout_v<FontVertex>);
+// Distance field atlases are rendered at this size in pixels and scaled to
+// the size of each font
+constexpr int DistanceFieldSize = 32;
+// Distances up to this many pixels of the atlas size are stored, enough
+// for the edges to stay smooth when the glyphs are scaled down
+constexpr int DistanceFieldSpread = 4;
 
-    TextureFontPrivate(const Renderer *renderer);
-    ~TextureFontPrivate();
-    TextureFontPrivate() = delete;
-    TextureFontPrivate(const TextureFontPrivate &) = default;
-    TextureFontPrivate(TextureFontPrivate &&) = default;
-    TextureFontPrivate &operator=(const TextureFontPrivate &) = default;
-    TextureFontPrivate &operator=(TextureFontPrivate &&) = default;
+// Widest that an atlas gets, glyphs are added in rows below
+constexpr int MaxAtlasWidth = 1024;
 
-    std::pair<float, float> render(std::wstring_view line, float x, float y);
-    std::pair<float, float> render(wchar_t ch, float xoffset, float yoffset);
+constexpr std::string_view AtlasCacheMagic = "CELGLYPH";
+constexpr std::uint16_t AtlasCacheVersion = 0x0100;
 
-    bool               buildAtlas();
-    void               computeTextureSize();
-    bool               loadGlyphInfo(wchar_t /*ch*/, Glyph & /*c*/) const;
-    void               initCommonGlyphs();
-    int                getCommonGlyphsCount();
-    Glyph &            getGlyph(wchar_t /*ch*/);
-    Glyph &            getGlyph(wchar_t /*ch*/, wchar_t /*fallback*/);
-    [[nodiscard]] int  toPos(wchar_t /*ch*/) const;
-    void               optimize();
-    CelestiaGLProgram *getProgram();
-    void               flush();
+bool useDistanceFields = false;
 
-    const Renderer    *m_renderer;
-    CelestiaGLProgram *m_prog{ nullptr };
+} // end unnamed namespace
 
-    FT_Face m_face; // font face
+/*! The glyphs of a face rendered at one size, either as bitmaps for fonts
+ *  of that size or as distance fields, which serve fonts of any size. The
+ *  glyphs are packed into the texture in rows as they are first used,
+ *  without redrawing those already there. A copy of the pixels is kept on
+ *  the CPU, so the texture can be grown when it's full and distance field
+ *  atlases can be kept in a disk cache.
+ */
+struct GlyphAtlas
+{
+    GlyphAtlas(FT_Face face, bool distanceField);
+    ~GlyphAtlas();
+    GlyphAtlas(const GlyphAtlas &) = delete;
+    GlyphAtlas &operator=(const GlyphAtlas &) = delete;
+
+    bool         init();
+    const Glyph *findGlyph(wchar_t ch) const;
+    const Glyph &addGlyph(wchar_t ch);
+
+    bool               loadGlyph(wchar_t ch, Glyph &c) const;
+    bool               place(Glyph &c, const FT_Bitmap &bitmap);
+    bool               grow(int minHeight);
+    bool               updateTexture();
+    void               deleteTexture();
+    [[nodiscard]] int  toPos(wchar_t ch) const;
+#ifndef PORTABLE_BUILD
+    bool               loadCache();
+    void               saveCache() const;
+#endif
 
-    int m_maxAscent{ 0 };
-    int m_maxDescent{ 0 };
-    int m_maxWidth{ 0 };
+    FT_Face face;
+    bool    distanceField;
 
-    int m_texWidth{ 0 };
-    int m_texHeight{ 0 };
+    static constexpr std::array<UnicodeBlock, 2> UnicodeBlocks
+    {
+        UnicodeBlock{ 0x0020, 0x007E }, // Basic Latin
+        UnicodeBlock{ 0x03B1, 0x03CF }, // Lower case Greek
+    };
 
-    GLuint             m_texName{ 0 };   // texture object
-    std::vector<Glyph> m_glyphs;         // character information
+    // The glyphs of the blocks above by position, then all others
+    std::vector<Glyph>                 m_commonGlyphs;
+    std::unordered_map<wchar_t, Glyph> m_otherGlyphs;
 
-    std::array<UnicodeBlock, 2> m_unicodeBlocks;
-    int                         m_commonGlyphsCount{ 0 };
+    std::vector<std::uint8_t> m_pixels;
+    int m_width{ 0 };
+    int m_height{ 0 };
 
-    int m_inserted{ 0 };
+    // Position of the row being filled
+    int m_rowX{ 0 };
+    int m_rowY{ 0 };
+    int m_rowHeight{ 0 };
 
-    Eigen::Matrix4f         m_projection;
-    Eigen::Matrix4f         m_modelView;
-    bool                    m_shaderInUse{ false };
-    std::vector<FontVertex> m_fontVertices;
+    // Rows of pixels changed since updateTexture
+    int m_dirtyFirst{ 0 };
+    int m_dirtyLast{ 0 };
 
-    static GLuint m_vbo;
-    static GLuint m_vio;
-    static constexpr std::size_t MaxVertices = 256; // This gives BO size 4kB, MUST be multiply of 4
-    static constexpr std::size_t MaxIndices = MaxVertices / 4 * 6;
-};
+    GLuint      m_texName{ 0 };
+    int         m_texHeight{ 0 };
+    std::size_t m_texMemorySize{ 0 };
 
-GLuint TextureFontPrivate::m_vbo = 0;
-GLuint TextureFontPrivate::m_vio = 0;
+    // Changed whenever the texture is reallocated, which moves the glyphs
+    // in texture coordinates
+    unsigned int m_generation{ 0 };
 
-namespace
-{
+    fs::path m_cachePath;
+    // Whether glyphs were added since the atlas was read from the cache
+    bool     m_modified{ false };
+};
 
-inline float
-pt_to_px(float pt, int dpi = 96)
+namespace
 {
-    return dpi == 0 ? pt : pt / 72.0f * static_cast<float>(dpi);
-}
 
-Glyph g_badGlyph = { 0, 0, 0, 0, 0, 0, 0, 0.0f, 0.0f };
+Glyph g_badGlyph = { 0, 0.0f, 0.0f, 0, 0, 0, 0, 0, 0 };
 
 } // namespace
 
-/*
-   first = ((c / 32) + 1) * 32  == c & ~0xdf
-   last  = first + 32
-*/
+GlyphAtlas::GlyphAtlas(FT_Face face, bool distanceField) :
+    face(face),
+    distanceField(distanceField),
+    m_width(std::min(MaxAtlasWidth, celestia::gl::maxTextureSize))
+{
+}
 
-TextureFontPrivate::TextureFontPrivate(const Renderer *renderer) : m_renderer(renderer)
+GlyphAtlas::~GlyphAtlas()
 {
-    m_unicodeBlocks[0] = { 0x0020, 0x007E }; // Basic Latin
-    m_unicodeBlocks[1] = { 0x03B1, 0x03CF }; // Lower case Greek
-    if (m_vbo == 0) glGenBuffers(1, &m_vbo);
-    if (m_vio == 0) glGenBuffers(1, &m_vio);
+#ifndef PORTABLE_BUILD
+    if (m_modified && !m_cachePath.empty())
+        saveCache();
+#endif
+    if (face != nullptr) FT_Done_Face(face);
+    deleteTexture();
 }
 
-TextureFontPrivate::~TextureFontPrivate()
+void
+GlyphAtlas::deleteTexture()
 {
-    if (m_face != nullptr) FT_Done_Face(m_face);
     if (m_texName != 0) glDeleteTextures(1, &m_texName);
+    m_texName = 0;
+    m_texHeight = 0;
+    celestia::render::removeTextureMemory(celestia::render::TextureMemoryCategory::Fonts, m_texMemorySize);
+    m_texMemorySize = 0;
 }
 
 bool
-TextureFontPrivate::loadGlyphInfo(wchar_t ch, Glyph &c) const
+GlyphAtlas::loadGlyph(wchar_t ch, Glyph &c) const
 {
-    FT_GlyphSlot g = m_face->glyph;
-    if (FT_Load_Char(m_face, ch, FT_LOAD_RENDER) != 0)
+    FT_GlyphSlot g = face->glyph;
+#ifdef HAVE_FT_SDF
+    if (distanceField)
+    {
+        // The outlines are scaled rather than hinted for each size; glyphs
+        // without contours, like the space, have nothing to render
+        if (FT_Load_Char(face, ch, FT_LOAD_NO_HINTING) != 0 ||
+            (g->outline.n_contours > 0 && FT_Render_Glyph(g, FT_RENDER_MODE_SDF) != 0))
+        {
+            c.ch = 0;
+            return false;
+        }
+
+        c.ch = ch;
+        c.ax = static_cast<float>(g->linearHoriAdvance) / 65536.0f;
+        c.ay = static_cast<float>(g->advance.y) / 64.0f;
+        c.bw = g->bitmap.width;
+        c.bh = g->bitmap.rows;
+        c.bl = g->bitmap_left;
+        c.bt = g->bitmap_top;
+        return true;
+    }
+#endif
+
+    if (FT_Load_Char(face, ch, FT_LOAD_RENDER) != 0)
     {
         c.ch = 0;
         return false;
     }
 
     c.ch = ch;
-    c.ax = g->advance.x >> 6;
-    c.ay = g->advance.y >> 6;
+    c.ax = static_cast<float>(g->advance.x >> 6);
+    c.ay = static_cast<float>(g->advance.y >> 6);
     c.bw = g->bitmap.width;
     c.bh = g->bitmap.rows;
     c.bl = g->bitmap_left;
@@ -174,83 +234,149 @@ TextureFontPrivate::loadGlyphInfo(wchar_t ch, Glyph &c) const
     return true;
 }
 
-void
-TextureFontPrivate::initCommonGlyphs()
+bool
+GlyphAtlas::init()
 {
-    if (!m_glyphs.empty()) return;
+#ifndef PORTABLE_BUILD
+    if (!m_cachePath.empty() && loadCache())
+        return updateTexture();
+#endif
 
-    m_glyphs.reserve(256);
+    std::size_t count = 0;
+    for (auto const &block : UnicodeBlocks)
+        count += block.last - block.first + 1;
+    m_commonGlyphs.reserve(count);
 
-    for (auto const &block : m_unicodeBlocks)
+    for (auto const &block : UnicodeBlocks)
     {
         for (wchar_t ch = block.first, e = block.last; ch <= e; ch++)
         {
             Glyph c;
-            if (!loadGlyphInfo(ch, c))
+            if (!loadGlyph(ch, c) || !place(c, face->glyph->bitmap))
+            {
                 GetLogger()->warn("Loading character {:x} failed!\n", static_cast<unsigned>(ch));
-            m_glyphs.push_back(c); // still pushing empty
+                c.ch = 0;
+            }
+            m_commonGlyphs.push_back(c); // still pushing empty
         }
     }
+
+    // Room is only added as later glyphs need it
+    m_height = m_rowY + m_rowHeight;
+    m_pixels.resize(static_cast<std::size_t>(m_width) * static_cast<std::size_t>(m_height));
+    m_modified = true;
+
+    return updateTexture();
 }
 
-void
-TextureFontPrivate::computeTextureSize()
+bool
+GlyphAtlas::place(Glyph &c, const FT_Bitmap &bitmap)
 {
-    int roww = 0;
-    int rowh = 0;
-    int w    = 0;
-    int h    = 0;
+    if (c.bw == 0 || c.bh == 0) return true;
 
-    // Find minimum size for a texture holding all visible ASCII characters
-    for (const auto &c : m_glyphs)
+    auto bw = static_cast<int>(c.bw);
+    auto bh = static_cast<int>(c.bh);
+    if (bw > m_width) return false;
+
+    // Glyphs are one pixel apart so that filtering doesn't mix them
+    if (m_rowX + bw > m_width)
     {
-        if (c.ch == 0) continue; // skip bad glyphs
+        m_rowY += m_rowHeight + 1;
+        m_rowX = 0;
+        m_rowHeight = 0;
+    }
 
-        if (roww + c.bw + 1 >= celestia::gl::maxTextureSize)
-        {
-            w = std::max(w, roww);
-            h += rowh;
-            roww = 0;
-            rowh = 0;
-        }
-        roww += c.bw + 1;
-        rowh = std::max(rowh, static_cast<int>(c.bh));
+    if (m_rowY + bh > m_height && !grow(m_rowY + bh))
+        return false;
+
+    for (int row = 0; row < bh; row++)
+    {
+        std::copy_n(bitmap.buffer + static_cast<std::ptrdiff_t>(row) * bitmap.pitch,
+                    bw,
+                    m_pixels.begin() + static_cast<std::ptrdiff_t>(m_rowY + row) * m_width + m_rowX);
     }
 
-    w = std::max(w, roww);
-    h += rowh;
+    c.tx = m_rowX;
+    c.ty = m_rowY;
+
+    if (m_dirtyFirst == m_dirtyLast)
+        m_dirtyFirst = m_rowY;
+    m_dirtyFirst = std::min(m_dirtyFirst, m_rowY);
+    m_dirtyLast = std::max(m_dirtyLast, m_rowY + bh);
 
-    m_texWidth  = w;
-    m_texHeight = h;
+    m_rowX += bw + 1;
+    m_rowHeight = std::max(m_rowHeight, bh);
+    return true;
 }
 
+// The height is doubled so that the texture isn't reallocated for each new
+// row
 bool
-TextureFontPrivate::buildAtlas()
+GlyphAtlas::grow(int minHeight)
 {
-    FT_GlyphSlot g = m_face->glyph;
+    if (minHeight > celestia::gl::maxTextureSize)
+        return false;
 
-    initCommonGlyphs();
-    computeTextureSize();
+    m_height = std::min(std::max(m_height * 2, minHeight), celestia::gl::maxTextureSize);
+    m_pixels.resize(static_cast<std::size_t>(m_width) * static_cast<std::size_t>(m_height));
+    return true;
+}
+
+bool
+GlyphAtlas::updateTexture()
+{
+    // Fonts without any visible glyph in the common blocks
+    if (m_height == 0) return true;
 
-    // Create a texture that will be used to hold all glyphs
     glActiveTexture(GL_TEXTURE0);
-    if (m_texName != 0) glDeleteTextures(1, &m_texName);
-    glGenTextures(1, &m_texName);
-    if (m_texName == 0) return false;
+
+    // We require 1 byte alignment when uploading texture data
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    if (m_texName != 0 && m_texHeight == m_height)
+    {
+        if (m_dirtyFirst < m_dirtyLast)
+        {
+            // Only the rows with new glyphs are uploaded
+            glBindTexture(GL_TEXTURE_2D, m_texName);
+            glTexSubImage2D(GL_TEXTURE_2D,
+                            0,
+                            0,
+                            m_dirtyFirst,
+                            m_width,
+                            m_dirtyLast - m_dirtyFirst,
+                            GL_ALPHA,
+                            GL_UNSIGNED_BYTE,
+                            m_pixels.data() + static_cast<std::ptrdiff_t>(m_dirtyFirst) * m_width);
+        }
+        m_dirtyFirst = m_dirtyLast = 0;
+        return true;
+    }
+
+    m_dirtyFirst = m_dirtyLast = 0;
+
+    // The texture keeps its name when it grows, so it needn't be bound again
+    if (m_texName == 0)
+    {
+        glGenTextures(1, &m_texName);
+        if (m_texName == 0) return false;
+    }
 
     glBindTexture(GL_TEXTURE_2D, m_texName);
     glTexImage2D(GL_TEXTURE_2D,
                  0,
                  GL_ALPHA,
-                 m_texWidth,
-                 m_texHeight,
+                 m_width,
+                 m_height,
                  0,
                  GL_ALPHA,
                  GL_UNSIGNED_BYTE,
-                 nullptr);
-
-    // We require 1 byte alignment when uploading texture data
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                 m_pixels.data());
+    m_texHeight = m_height;
+    ++m_generation;
+    celestia::render::removeTextureMemory(celestia::render::TextureMemoryCategory::Fonts, m_texMemorySize);
+    m_texMemorySize = static_cast<std::size_t>(m_width) * static_cast<std::size_t>(m_height);
+    celestia::render::addTextureMemory(celestia::render::TextureMemoryCategory::Fonts, m_texMemorySize);
 
     // Clamping to edges is important to prevent artifacts when scaling
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -264,175 +390,372 @@ TextureFontPrivate::buildAtlas()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
 #endif
 
-    // Paste all glyph bitmaps into the texture, remembering the offset
-    int ox = 0;
-    int oy = 0;
+#if DUMP_TEXTURE
+    fmt::print("Generated a {} x {} ({} kb) texture atlas\n",
+               m_width, m_height,
+               m_width * m_height / 1024);
+    std::ofstream f(fmt::format("/tmp/texture_{}x{}.data", m_width, m_height), std::ios::binary);
+    f.write(reinterpret_cast<const char *>(m_pixels.data()), m_pixels.size());
+    f.close();
+#endif
+    return true;
+}
+
+int
+GlyphAtlas::toPos(wchar_t ch) const
+{
+    int pos = 0;
 
-    int rowh = 0;
+    if (ch > UnicodeBlocks.back().last) return -1;
 
-    for (auto &c : m_glyphs)
+    for (const auto &r : UnicodeBlocks)
     {
-        if (c.ch == 0) continue; // skip bad glyphs
+        if (ch < r.first) return -1;
 
-        if (FT_Load_Char(m_face, c.ch, FT_LOAD_RENDER) != 0)
+        if (ch <= r.last)
         {
-            GetLogger()->warn("Loading character {:x} failed!\n", static_cast<unsigned>(c.ch));
-            c.ch = 0;
-            continue;
+            return pos + ch - r.first;
         }
 
-        if (ox + int(g->bitmap.width) > int(m_texWidth))
+        pos += r.last - r.first + 1;
+    }
+    return -1;
+}
+
+const Glyph *
+GlyphAtlas::findGlyph(wchar_t ch) const
+{
+    if (auto pos = toPos(ch); pos != -1)
+        return pos < static_cast<int>(m_commonGlyphs.size()) ? &m_commonGlyphs[pos] : &g_badGlyph;
+
+    auto it = m_otherGlyphs.find(ch);
+    return it == m_otherGlyphs.end() ? nullptr : &it->second;
+}
+
+// Characters which can't be loaded are kept as bad glyphs, so they aren't
+// tried again
+const Glyph &
+GlyphAtlas::addGlyph(wchar_t ch)
+{
+    Glyph &c = m_otherGlyphs[ch];
+    if (!loadGlyph(ch, c) || !place(c, face->glyph->bitmap))
+    {
+        c = g_badGlyph;
+        return c;
+    }
+
+    m_modified = true;
+    updateTexture();
+    return c;
+}
+
+#ifndef PORTABLE_BUILD
+namespace
+{
+
+bool
+writeGlyph(std::ostream &out, wchar_t code, const Glyph &c)
+{
+    return celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(code))
+        && celutil::writeLE<std::uint8_t>(out, c.ch == 0 ? 0 : 1)
+        && celutil::writeLE<float>(out, c.ax)
+        && celutil::writeLE<float>(out, c.ay)
+        && celutil::writeLE<std::uint32_t>(out, c.bw)
+        && celutil::writeLE<std::uint32_t>(out, c.bh)
+        && celutil::writeLE<std::int32_t>(out, c.bl)
+        && celutil::writeLE<std::int32_t>(out, c.bt)
+        && celutil::writeLE<std::int32_t>(out, c.tx)
+        && celutil::writeLE<std::int32_t>(out, c.ty);
+}
+
+bool
+readGlyph(std::istream &in, wchar_t &code, Glyph &c)
+{
+    std::uint32_t ch;
+    std::uint8_t valid;
+    std::int32_t bl, bt, tx, ty;
+    if (!celutil::readLE<std::uint32_t>(in, ch)
+        || !celutil::readLE<std::uint8_t>(in, valid)
+        || !celutil::readLE<float>(in, c.ax)
+        || !celutil::readLE<float>(in, c.ay)
+        || !celutil::readLE<std::uint32_t>(in, c.bw)
+        || !celutil::readLE<std::uint32_t>(in, c.bh)
+        || !celutil::readLE<std::int32_t>(in, bl)
+        || !celutil::readLE<std::int32_t>(in, bt)
+        || !celutil::readLE<std::int32_t>(in, tx)
+        || !celutil::readLE<std::int32_t>(in, ty))
+    {
+        return false;
+    }
+
+    code = static_cast<wchar_t>(ch);
+    c.ch = valid != 0 ? code : 0;
+    c.bl = bl;
+    c.bt = bt;
+    c.tx = tx;
+    c.ty = ty;
+    return true;
+}
+
+} // end unnamed namespace
+
+bool
+GlyphAtlas::loadCache()
+{
+    if (!celutil::DiskCache::use(m_cachePath))
+        return false;
+
+    std::ifstream in(m_cachePath, std::ios::in | std::ios::binary);
+    if (!in.good())
+        return false;
+
+    std::array<char, AtlasCacheMagic.size()> magic;
+    std::uint16_t version;
+    std::int32_t width, height, rowX, rowY, rowHeight;
+    std::uint32_t count;
+    if (!in.read(magic.data(), magic.size()).good()
+        || std::string_view(magic.data(), magic.size()) != AtlasCacheMagic
+        || !celutil::readLE<std::uint16_t>(in, version) || version != AtlasCacheVersion
+        || !celutil::readLE<std::int32_t>(in, width) || width <= 0 || width > celestia::gl::maxTextureSize
+        || !celutil::readLE<std::int32_t>(in, height) || height < 0 || height > celestia::gl::maxTextureSize
+        || !celutil::readLE<std::int32_t>(in, rowX)
+        || !celutil::readLE<std::int32_t>(in, rowY)
+        || !celutil::readLE<std::int32_t>(in, rowHeight)
+        || !celutil::readLE<std::uint32_t>(in, count))
+    {
+        return false;
+    }
+
+    std::vector<Glyph> commonGlyphs;
+    std::unordered_map<wchar_t, Glyph> otherGlyphs;
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        wchar_t code;
+        Glyph c;
+        if (!readGlyph(in, code, c)
+            || c.tx < 0 || c.ty < 0 || c.tx + static_cast<int>(c.bw) > width || c.ty + static_cast<int>(c.bh) > height)
         {
-            oy += rowh;
-            rowh = 0;
-            ox   = 0;
+            return false;
         }
 
-        glTexSubImage2D(GL_TEXTURE_2D,
-                        0,
-                        ox,
-                        oy,
-                        g->bitmap.width,
-                        g->bitmap.rows,
-                        GL_ALPHA,
-                        GL_UNSIGNED_BYTE,
-                        g->bitmap.buffer);
-        c.tx = static_cast<float>(ox) / static_cast<float>(m_texWidth);
-        c.ty = static_cast<float>(oy) / static_cast<float>(m_texHeight);
-
-        rowh = std::max(rowh, static_cast<int>(g->bitmap.rows));
-        ox += g->bitmap.width + 1;
+        if (auto pos = toPos(code); pos != -1)
+        {
+            // The common glyphs are written first and in order
+            if (pos != static_cast<int>(commonGlyphs.size()))
+                return false;
+            commonGlyphs.push_back(c);
+        }
+        else
+        {
+            otherGlyphs[code] = c;
+        }
     }
 
-#if DUMP_TEXTURE
-    fmt::print("Generated a {} x {} ({} kb) texture atlas\n",
-               m_texWidth, m_texHeight,
-               m_texWidth * m_texHeight / 1024);
-    size_t   img_size = sizeof(uint8_t) * m_texWidth * m_texHeight * 4;
-    uint8_t *raw_img  = new uint8_t[img_size];
-    glGetTexImage(GL_TEXTURE_2D, 0, GL_BGRA, GL_UNSIGNED_BYTE, raw_img);
-    ofstream f(fmt::format("/tmp/texture_{}x{}.data", m_texWidth, m_texHeight), ios::binary);
-    f.write(reinterpret_cast<const char *>(raw_img), img_size);
-    f.close();
-    delete[] raw_img;
-#endif
+    std::vector<std::uint8_t> pixels(static_cast<std::size_t>(width) * static_cast<std::size_t>(height));
+    if (!in.read(reinterpret_cast<char *>(pixels.data()), static_cast<std::streamsize>(pixels.size())).good())
+        return false;
+
+    m_commonGlyphs = std::move(commonGlyphs);
+    m_otherGlyphs = std::move(otherGlyphs);
+    m_pixels = std::move(pixels);
+    m_width = width;
+    m_height = height;
+    m_rowX = rowX;
+    m_rowY = rowY;
+    m_rowHeight = rowHeight;
+    m_modified = false;
     return true;
 }
 
-int
-TextureFontPrivate::getCommonGlyphsCount()
+void
+GlyphAtlas::saveCache() const
 {
-    if (m_commonGlyphsCount == 0)
+    bool ok = celutil::DiskCache::write(m_cachePath, [this](const fs::path &path)
     {
-        for (auto const &block : m_unicodeBlocks)
-            m_commonGlyphsCount += (block.last - block.first + 1);
-    }
-    return m_commonGlyphsCount;
+        std::ofstream out(path, std::ios::out | std::ios::binary);
+        bool written = out.write(AtlasCacheMagic.data(), AtlasCacheMagic.size()).good()
+            && celutil::writeLE<std::uint16_t>(out, AtlasCacheVersion)
+            && celutil::writeLE<std::int32_t>(out, m_width)
+            && celutil::writeLE<std::int32_t>(out, m_height)
+            && celutil::writeLE<std::int32_t>(out, m_rowX)
+            && celutil::writeLE<std::int32_t>(out, m_rowY)
+            && celutil::writeLE<std::int32_t>(out, m_rowHeight)
+            && celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(m_commonGlyphs.size() + m_otherGlyphs.size()));
+
+        std::size_t pos = 0;
+        for (auto const &block : UnicodeBlocks)
+        {
+            for (wchar_t ch = block.first; written && ch <= block.last && pos < m_commonGlyphs.size(); ch++, pos++)
+                written = writeGlyph(out, ch, m_commonGlyphs[pos]);
+        }
+        for (auto it = m_otherGlyphs.begin(); written && it != m_otherGlyphs.end(); ++it)
+            written = writeGlyph(out, it->first, it->second);
+
+        written = written && out.write(reinterpret_cast<const char *>(m_pixels.data()), static_cast<std::streamsize>(m_pixels.size())).good();
+        out.close();
+        return written && out.good();
+    });
+
+    if (!ok)
+        GetLogger()->warn("Failed to write the glyph atlas cache {}\n", m_cachePath);
 }
+#endif
 
-int
-TextureFontPrivate::toPos(wchar_t ch) const
+struct TextureFontPrivate
 {
-    int pos = 0;
+    using FontVertex = TextureFont::Vertex;
 
-    if (ch > m_unicodeBlocks.back().last) return -1;
+    static_assert(std::is_standard_layout_v<FontVertex>);
 
-    for (const auto &r : m_unicodeBlocks)
-    {
-        if (ch < r.first) return -1;
+    TextureFontPrivate(const Renderer *renderer);
+    ~TextureFontPrivate() = default;
+    TextureFontPrivate() = delete;
+    TextureFontPrivate(const TextureFontPrivate &) = default;
+    TextureFontPrivate(TextureFontPrivate &&) = default;
+    TextureFontPrivate &operator=(const TextureFontPrivate &) = default;
+    TextureFontPrivate &operator=(TextureFontPrivate &&) = default;
 
-        if (ch <= r.last)
+    std::pair<float, float> render(std::wstring_view line, float x, float y);
+    std::pair<float, float> render(wchar_t ch, float xoffset, float yoffset);
+
+    const Glyph &      getGlyph(wchar_t /*ch*/);
+    const Glyph &      getGlyph(wchar_t /*ch*/, wchar_t /*fallback*/);
+    CelestiaGLProgram *getProgram();
+    void               flush();
+    void               addQuad(float x1, float y1, float x2, float y2,
+                               float tx1, float ty1, float tx2, float ty2);
+    void               addGlyph(const Glyph &g, float x, float y);
+
+    const Renderer    *m_renderer;
+    CelestiaGLProgram *m_prog{ nullptr };
+
+    // Shared by the fonts of all sizes of a face with distance fields
+    std::shared_ptr<GlyphAtlas> m_atlas;
+    // Size of the font over the size of the glyphs in the atlas
+    float m_scale{ 1.0f };
+
+    int m_maxAscent{ 0 };
+    int m_maxDescent{ 0 };
+    int m_maxWidth{ 0 };
+
+    Eigen::Matrix4f         m_projection;
+    Eigen::Matrix4f         m_modelView;
+    bool                    m_shaderInUse{ false };
+    // Whether the vertices have the color set with setColor
+    bool                    m_vertexColors{ false };
+    std::array<std::uint8_t, 4> m_color{ 255, 255, 255, 255 };
+    std::vector<FontVertex> m_fontVertices;
+
+    // Text rendered since beginCapture
+    bool                    m_capturing{ false };
+    unsigned int            m_captureGeneration{ 0 };
+    std::vector<FontVertex> m_capturedVertices;
+
+    static GLuint m_vbo;
+    static GLuint m_vio;
+    // Enough for a screen full of labels in one draw call; the indices of
+    // the quads never change, so they are written once. MUST be multiply of 4
+    // and at most 65536 for the 16 bit indices.
+    static constexpr std::size_t MaxVertices = 16384;
+    static constexpr std::size_t MaxIndices = MaxVertices / 4 * 6;
+};
+
+GLuint TextureFontPrivate::m_vbo = 0;
+GLuint TextureFontPrivate::m_vio = 0;
+
+namespace
+{
+
+inline float
+pt_to_px(float pt, int dpi = 96)
+{
+    return dpi == 0 ? pt : pt / 72.0f * static_cast<float>(dpi);
+}
+
+} // namespace
+
+TextureFontPrivate::TextureFontPrivate(const Renderer *renderer) : m_renderer(renderer)
+{
+    if (m_vbo == 0) glGenBuffers(1, &m_vbo);
+    if (m_vio == 0)
+    {
+        std::vector<GLushort> indexes;
+        indexes.reserve(MaxIndices);
+        for (std::size_t index = 0; index < MaxVertices; index += 4)
         {
-            return pos + ch - r.first;
+            auto i = static_cast<GLushort>(index);
+            indexes.insert(indexes.end(), { i, static_cast<GLushort>(i + 1), static_cast<GLushort>(i + 2),
+                                            static_cast<GLushort>(i + 1), static_cast<GLushort>(i + 3), static_cast<GLushort>(i + 2) });
         }
 
-        pos += r.last - r.first + 1;
+        glGenBuffers(1, &m_vio);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_vio);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * indexes.size(), indexes.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     }
-    return -1;
 }
 
-Glyph &
+const Glyph &
 TextureFontPrivate::getGlyph(wchar_t ch, wchar_t fallback)
 {
     auto &g = getGlyph(ch);
     return g.ch == ch ? g : getGlyph(fallback);
 }
 
-Glyph &
+const Glyph &
 TextureFontPrivate::getGlyph(wchar_t ch)
 {
-    if (auto pos = toPos(ch); pos != -1)
-        return m_glyphs[pos];
-
-    auto it = std::find_if(m_glyphs.begin() + getCommonGlyphsCount(),
-                           m_glyphs.end(),
-                           [ch](const Glyph &g) { return g.ch == ch; });
-
-    if (it != m_glyphs.end())
-        return *it;
-
-    Glyph c;
-    if (!loadGlyphInfo(ch, c))
-        return g_badGlyph;
+    if (const Glyph *g = m_atlas->findGlyph(ch); g != nullptr)
+        return *g;
 
     flush(); // render text to avoid garbled output due to changed texture
 
-    m_glyphs.push_back(c);
-    if (++m_inserted == 10) optimize();
-    buildAtlas();
-
-    return m_glyphs.back();
+    return m_atlas->addGlyph(ch);
 }
 
 void
-TextureFontPrivate::optimize()
+TextureFontPrivate::addGlyph(const Glyph &g, float x, float y)
 {
-    m_inserted = 0;
+    // Calculate the vertex and texture coordinates
+    const float x1 = x + static_cast<float>(g.bl) * m_scale;
+    const float y1 = y + (static_cast<float>(g.bt) - static_cast<float>(g.bh)) * m_scale;
+    const float x2 = x1 + static_cast<float>(g.bw) * m_scale;
+    const float y2 = y1 + static_cast<float>(g.bh) * m_scale;
+
+    const auto  texWidth  = static_cast<float>(m_atlas->m_width);
+    const auto  texHeight = static_cast<float>(m_atlas->m_height);
+    const float tx1 = static_cast<float>(g.tx) / texWidth;
+    const float ty1 = static_cast<float>(g.ty) / texHeight;
+    const float tx2 = static_cast<float>(g.tx + static_cast<int>(g.bw)) / texWidth;
+    const float ty2 = static_cast<float>(g.ty + static_cast<int>(g.bh)) / texHeight;
+
+    addQuad(x1, y1, x2, y2, tx1, ty1, tx2, ty2);
 }
 
 /*
  * Render text using the currently loaded font and currently set font size.
  * Rendering starts at coordinates (x, y), z is always 0.
- * The pixel coordinates that the FreeType2 library uses are scaled by (sx, sy).
+ * The pixel coordinates of the glyphs in the atlas are scaled by m_scale.
  */
 std::pair<float, float>
 TextureFontPrivate::render(std::wstring_view line, float x, float y)
 {
-    if (m_texName == 0) return {0, 0};
+    if (m_atlas->m_texName == 0) return {0, 0};
 
     // Use the texture containing the atlas
-    glBindTexture(GL_TEXTURE_2D, m_texName);
+    glBindTexture(GL_TEXTURE_2D, m_atlas->m_texName);
 
     for (auto ch : line)
     {
         auto &g = getGlyph(ch, L'?');
 
-        // Calculate the vertex and texture coordinates
-        const float x1 = x + g.bl;
-        const float y1 = y + g.bt - g.bh;
-        const float w  = g.bw;
-        const float h  = g.bh;
-        const float x2 = x1 + w;
-        const float y2 = y1 + h;
-
-        // Advance the cursor to the start of the next character
-        x += g.ax;
-        y += g.ay;
-
         // Skip glyphs that have no pixels
-        if (g.bw == 0 || g.bh == 0) continue;
+        if (g.bw != 0 && g.bh != 0)
+            addGlyph(g, x, y);
 
-        const float tx1 = g.tx;
-        const float ty1 = g.ty;
-        const float tx2 = tx1 + w / m_texWidth;
-        const float ty2 = ty1 + h / m_texHeight;
-
-        m_fontVertices.emplace_back(x1, y1, tx1, ty2);
-        m_fontVertices.emplace_back(x2, y1, tx2, ty2);
-        m_fontVertices.emplace_back(x1, y2, tx1, ty1);
-        m_fontVertices.emplace_back(x2, y2, tx2, ty1);
-
-        if (m_fontVertices.size() == MaxVertices) flush();
+        // Advance the cursor to the start of the next character
+        x += g.ax * m_scale;
+        y += g.ay * m_scale;
     }
 
     return {x, y};
@@ -443,32 +766,32 @@ TextureFontPrivate::render(wchar_t ch, float xoffset, float yoffset)
 {
     auto &g = getGlyph(ch, L'?');
 
-    // Calculate the vertex and texture coordinates
-    const float x1 = xoffset + g.bl;
-    const float y1 = yoffset + g.bt - g.bh;
-    const float x2 = x1 + g.bw;
-    const float y2 = y1 + g.bh;
+    if (g.bw != 0 && g.bh != 0)
+        addGlyph(g, xoffset, yoffset);
 
-    const float tx1 = g.tx;
-    const float ty1 = g.ty;
-    const float tx2 = tx1 + static_cast<float>(g.bw) / m_texWidth;
-    const float ty2 = ty1 + static_cast<float>(g.bh) / m_texHeight;
+    return {g.ax * m_scale, g.ay * m_scale};
+}
 
-    m_fontVertices.emplace_back(x1, y1, tx1, ty2);
-    m_fontVertices.emplace_back(x2, y1, tx2, ty2);
-    m_fontVertices.emplace_back(x1, y2, tx1, ty1);
-    m_fontVertices.emplace_back(x2, y2, tx2, ty1);
+void
+TextureFontPrivate::addQuad(float x1, float y1, float x2, float y2,
+                            float tx1, float ty1, float tx2, float ty2)
+{
+    m_fontVertices.push_back({ x1, y1, tx1, ty2, m_color });
+    m_fontVertices.push_back({ x2, y1, tx2, ty2, m_color });
+    m_fontVertices.push_back({ x1, y2, tx1, ty1, m_color });
+    m_fontVertices.push_back({ x2, y2, tx2, ty1, m_color });
 
-    if (m_fontVertices.size() == MaxVertices) flush();
+    if (m_capturing)
+        m_capturedVertices.insert(m_capturedVertices.end(), m_fontVertices.end() - 4, m_fontVertices.end());
 
-    return {g.ax, g.ay};
+    if (m_fontVertices.size() == MaxVertices) flush();
 }
 
 CelestiaGLProgram *
 TextureFontPrivate::getProgram()
 {
     if (m_prog != nullptr) return m_prog;
-    m_prog = m_renderer->getShaderManager().getShader("text");
+    m_prog = m_renderer->getShaderManager().getShader(m_atlas->distanceField ? "textsdf" : "text");
     return m_prog;
 }
 
@@ -477,26 +800,10 @@ TextureFontPrivate::flush()
 {
     if (m_fontVertices.size() < 4) return;
 
-    std::vector<unsigned short> indexes;
-    indexes.reserve(MaxIndices);
-    for (unsigned short index = 0; index < static_cast<unsigned short>(m_fontVertices.size()); index += 4)
-    {
-        indexes.push_back(index + 0);
-        indexes.push_back(index + 1);
-        indexes.push_back(index + 2);
-        indexes.push_back(index + 1);
-        indexes.push_back(index + 3);
-        indexes.push_back(index + 2);
-    }
-
     glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_vio);
 
-    glBufferData(GL_ARRAY_BUFFER, sizeof(FontVertex) * MaxVertices, nullptr, GL_STREAM_DRAW);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * MaxIndices, nullptr, GL_STREAM_DRAW);
-
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(FontVertex) * m_fontVertices.size(), m_fontVertices.data());
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(GLushort) * indexes.size(), indexes.data());
+    glBufferData(GL_ARRAY_BUFFER, sizeof(FontVertex) * m_fontVertices.size(), m_fontVertices.data(), GL_STREAM_DRAW);
 
     glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
     glEnableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
@@ -512,15 +819,35 @@ TextureFontPrivate::flush()
                           GL_FALSE,
                           sizeof(FontVertex),
                           reinterpret_cast<const void*>(offsetof(FontVertex, u)));
-    glDrawElements(GL_TRIANGLES, indexes.size(), GL_UNSIGNED_SHORT, nullptr);
+    if (m_vertexColors)
+    {
+        glEnableVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex);
+        glVertexAttribPointer(CelestiaGLProgram::ColorAttributeIndex,
+                              4,
+                              GL_UNSIGNED_BYTE,
+                              GL_TRUE,
+                              sizeof(FontVertex),
+                              reinterpret_cast<const void*>(offsetof(FontVertex, color)));
+    }
+    auto indexCount = static_cast<GLsizei>(m_fontVertices.size() / 4 * 6);
+    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, nullptr);
+    celestia::render::countDrawCall(GL_TRIANGLES, indexCount);
     glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
     glDisableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
+    if (m_vertexColors)
+    {
+        glDisableVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex);
+        // The current color is undefined after drawing from an array
+        glVertexAttrib4f(CelestiaGLProgram::ColorAttributeIndex,
+                         m_color[0] / 255.0f, m_color[1] / 255.0f, m_color[2] / 255.0f, m_color[3] / 255.0f);
+    }
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
     m_fontVertices.clear();
 }
 
+
 TextureFont::TextureFont(const Renderer *renderer) :
     impl(std::make_unique<TextureFontPrivate>(renderer))
 {
@@ -571,14 +898,14 @@ TextureFont::render(std::wstring_view line, float xoffset, float yoffset) const
 int
 TextureFont::getWidth(std::wstring_view line) const
 {
-    int  width     = 0;
+    float width = 0.0f;
     for (auto ch : line)
     {
         auto &g = impl->getGlyph(ch, L'?');
         width += g.ax;
     }
 
-    return width;
+    return static_cast<int>(std::ceil(width * impl->m_scale));
 }
 
 /**
@@ -645,12 +972,17 @@ TextureFont::bind()
     auto *prog = impl->getProgram();
     if (prog == nullptr) return;
 
-    if (impl->m_texName != 0)
+    if (impl->m_atlas->m_texName != 0)
     {
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, impl->m_texName);
+        glBindTexture(GL_TEXTURE_2D, impl->m_atlas->m_texName);
         prog->use();
         prog->samplerParam("atlasTex") = 0;
+        // The distances in the texture are from 0 to 1 for twice the spread
+        // in pixels of the atlas, and the edges are smoothed over a pixel
+        // on the screen
+        if (impl->m_atlas->distanceField)
+            prog->floatParam("distanceScale") = 2.0f * static_cast<float>(DistanceFieldSpread) * impl->m_scale;
         impl->m_shaderInUse            = true;
         prog->setMVPMatrices(impl->m_projection, impl->m_modelView);
     }
@@ -680,6 +1012,22 @@ TextureFont::unbind()
 {
     flush();
     impl->m_shaderInUse = false;
+    impl->m_vertexColors = false;
+}
+
+/**
+ * Set the color of the text rendered next.
+ */
+void
+TextureFont::setColor(const Color &color)
+{
+    if (!impl->m_vertexColors)
+    {
+        // Text added before has the color of the attribute
+        flush();
+        impl->m_vertexColors = true;
+    }
+    std::copy_n(color.data(), 4, impl->m_color.begin());
 }
 
 /**
@@ -689,7 +1037,7 @@ short
 TextureFont::getAdvance(wchar_t ch) const
 {
     auto &g = impl->getGlyph(ch, L'?');
-    return g.ax;
+    return static_cast<short>(std::lround(g.ax * impl->m_scale));
 }
 
 /**
@@ -701,6 +1049,82 @@ TextureFont::flush()
     impl->flush();
 }
 
+/**
+ * Start keeping the vertices of the text rendered next.
+ */
+void
+TextureFont::beginCapture()
+{
+    impl->m_capturing = true;
+    impl->m_captureGeneration = impl->m_atlas->m_generation;
+    impl->m_capturedVertices.clear();
+}
+
+/**
+ * Move the vertices of the text rendered since beginCapture to geometry.
+ */
+void
+TextureFont::endCapture(Geometry &geometry)
+{
+    impl->m_capturing = false;
+    // If the texture grew meanwhile, the geometry is invalid from the start
+    geometry.textureGeneration = impl->m_captureGeneration;
+    geometry.vertices.swap(impl->m_capturedVertices);
+    impl->m_capturedVertices.clear();
+}
+
+/**
+ * Return whether captured text can still be drawn with the glyph texture.
+ */
+bool
+TextureFont::isValid(const Geometry &geometry) const
+{
+    return geometry.textureGeneration == impl->m_atlas->m_generation;
+}
+
+/**
+ * Draw the text captured with beginCapture and endCapture.
+ */
+void
+TextureFont::draw(const Geometry &geometry)
+{
+    if (impl->m_atlas->m_texName == 0 || geometry.vertices.empty()) return;
+
+    if (!impl->m_vertexColors)
+    {
+        flush();
+        impl->m_vertexColors = true;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, impl->m_atlas->m_texName);
+
+    // Both counts are of whole quads
+    auto &vertices = impl->m_fontVertices;
+    for (auto it = geometry.vertices.begin(); it != geometry.vertices.end();)
+    {
+        auto count = std::min(static_cast<std::size_t>(geometry.vertices.end() - it),
+                              TextureFontPrivate::MaxVertices - vertices.size());
+        vertices.insert(vertices.end(), it, it + static_cast<std::ptrdiff_t>(count));
+        it += static_cast<std::ptrdiff_t>(count);
+        if (vertices.size() == TextureFontPrivate::MaxVertices) flush();
+    }
+}
+
+/**
+ * Render the glyphs of the fonts loaded next as distance fields, sharing
+ * one atlas between all sizes of a face.
+ */
+void
+TextureFont::setDistanceFields(bool enable)
+{
+#ifdef HAVE_FT_SDF
+    useDistanceFields = enable;
+#else
+    if (enable)
+        GetLogger()->warn("Distance field fonts need FreeType 2.11 or later\n");
+#endif
+}
+
 namespace
 {
 
@@ -753,6 +1177,50 @@ ParseFontName(const fs::path &filename, int &index, int &size)
     return filename;
 }
 
+#ifndef PORTABLE_BUILD
+// The cache file name is derived from the font path, size and modification
+// time, so stale entries are never picked up after the font changes
+fs::path
+getAtlasCachePath(const fs::path &path, int index)
+{
+    static celutil::DiskCache cache(celutil::WriteableDataPath() / "cache" / "fonts", AtlasCacheVersion);
+    return cache.getPath(path, fmt::format("{}|{}|{}", index, DistanceFieldSize, DistanceFieldSpread), ".dat");
+}
+#endif
+
+#ifdef HAVE_FT_SDF
+using AtlasCache = std::map<std::string, std::weak_ptr<GlyphAtlas>>;
+
+// One atlas serves all sizes of a face
+std::shared_ptr<GlyphAtlas>
+LoadDistanceFieldAtlas(FT_Library ft, const fs::path &path, int index)
+{
+    static AtlasCache *atlasCache = nullptr;
+    if (atlasCache == nullptr)
+        atlasCache = new AtlasCache;
+
+    std::weak_ptr<GlyphAtlas> &entry = (*atlasCache)[fmt::format("{}|{}", path.string(), index)];
+    std::shared_ptr<GlyphAtlas> atlas = entry.lock();
+    if (atlas != nullptr)
+        return atlas;
+
+    // With 0 dpi the size is in pixels
+    auto face = LoadFontFace(ft, path, index, DistanceFieldSize, 0);
+    if (face == nullptr)
+        return nullptr;
+
+    atlas = std::make_shared<GlyphAtlas>(face, true);
+#ifndef PORTABLE_BUILD
+    atlas->m_cachePath = getAtlasCachePath(path, index);
+#endif
+    if (!atlas->init())
+        return nullptr;
+
+    entry = atlas;
+    return atlas;
+}
+#endif
+
 } // namespace
 
 using FontCache = std::map<fs::path, std::weak_ptr<TextureFont>>;
@@ -762,10 +1230,17 @@ LoadTextureFont(const Renderer *r, const fs::path &filename, int index, int size
 {
     // Init FreeType library
     static FT_Library ftlib = nullptr;
-    if (ftlib == nullptr && FT_Init_FreeType(&ftlib) != 0)
+    if (ftlib == nullptr)
     {
-        GetLogger()->error("Could not init freetype library\n");
-        return nullptr;
+        if (FT_Init_FreeType(&ftlib) != 0)
+        {
+            GetLogger()->error("Could not init freetype library\n");
+            return nullptr;
+        }
+#ifdef HAVE_FT_SDF
+        FT_Int spread = DistanceFieldSpread;
+        FT_Property_Set(ftlib, "sdf", "spread", &spread);
+#endif
     }
 
     // Init FontCache
@@ -781,22 +1256,41 @@ LoadTextureFont(const Renderer *r, const fs::path &filename, int index, int size
         int  psize    = 12; // default size if missing
         int  pindex   = 0;
         auto nameonly = ParseFontName(filename, pindex, psize);
-        auto face     = LoadFontFace(ftlib, nameonly,
-                                     index > 0 ? index : pindex,
-                                     size > 0 ? size : psize,
-                                     r->getScreenDpi());
-        if (face == nullptr)
-            return nullptr;
+        int  fontIndex = index > 0 ? index : pindex;
+        int  fontSize  = size > 0 ? size : psize;
 
         ret = std::make_shared<TextureFont>(r);
-        ret->impl->m_face = face;
 
-        if (!ret->impl->buildAtlas())
+#ifdef HAVE_FT_SDF
+        if (useDistanceFields)
         {
-            FT_Done_Face(face);
-            return nullptr;
+            auto atlas = LoadDistanceFieldAtlas(ftlib, nameonly, fontIndex);
+            if (atlas == nullptr)
+                return nullptr;
+
+            // The metrics are scaled from the unhinted outlines like the
+            // glyphs
+            float px = pt_to_px(static_cast<float>(fontSize), r->getScreenDpi());
+            float unitsToPx = px / static_cast<float>(atlas->face->units_per_EM);
+            ret->impl->m_atlas = atlas;
+            ret->impl->m_scale = px / static_cast<float>(DistanceFieldSize);
+            ret->setMaxAscent(static_cast<int>(std::ceil(static_cast<float>(atlas->face->ascender) * unitsToPx)));
+            ret->setMaxDescent(static_cast<int>(std::ceil(static_cast<float>(-atlas->face->descender) * unitsToPx)));
+
+            font = ret;
+            return ret;
         }
+#endif
+
+        auto face = LoadFontFace(ftlib, nameonly, fontIndex, fontSize, r->getScreenDpi());
+        if (face == nullptr)
+            return nullptr;
+
+        auto atlas = std::make_shared<GlyphAtlas>(face, false);
+        if (!atlas->init())
+            return nullptr;
 
+        ret->impl->m_atlas = atlas;
         ret->setMaxAscent(static_cast<int>(face->size->metrics.ascender >> 6));
         ret->setMaxDescent(static_cast<int>(-face->size->metrics.descender >> 6));
 
@@ -9,10 +9,15 @@
 
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
 #include <Eigen/Core>
 #include <celcompat/filesystem.h>
-#include <string_view>
 
+class Color;
 class Renderer;
 class TextureFont;
 
@@ -23,6 +28,22 @@ struct TextureFontPrivate;
 class TextureFont
 {
  public:
+    struct Vertex
+    {
+        float x, y;
+        float u, v;
+        std::array<std::uint8_t, 4> color;
+    };
+
+    // Vertices of rendered text, kept to draw the same text again without
+    // laying it out
+    struct Geometry
+    {
+        std::vector<Vertex> vertices;
+        // The texture coordinates are for this version of the glyph texture
+        unsigned int textureGeneration{ 0 };
+    };
+
     TextureFont(const Renderer *);
     TextureFont() = delete;
     ~TextureFont() = default;
@@ -53,6 +74,27 @@ class TextureFont
     void unbind();
     void flush();
 
+    // Give the text rendered next this color, stored in the vertices so
+    // that text of many colors is drawn at once. Until it's called after
+    // bind, the text has the color of the color attribute.
+    void setColor(const Color&);
+
+    // Render the fonts loaded next from distance fields, one atlas serving
+    // all sizes of a face. Needs FreeType 2.11, without it bitmaps are
+    // always used.
+    static void setDistanceFields(bool);
+
+    // Keep the vertices of the text rendered next, which is still drawn,
+    // until endCapture moves them to the geometry. Only the text rendered
+    // after setColor keeps its color.
+    void beginCapture();
+    void endCapture(Geometry&);
+    // Whether captured text can be drawn, which it can't once the glyph
+    // texture has grown.
+    bool isValid(const Geometry&) const;
+    // Draw captured text, after bind.
+    void draw(const Geometry&);
+
  private:
     std::unique_ptr<TextureFontPrivate> impl;
 
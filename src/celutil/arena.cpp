@@ -0,0 +1,63 @@
+// arena.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Bump allocator for short-lived objects.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace celestia::util
+{
+
+Arena::Arena(std::size_t _blockSize) :
+    blockSize(_blockSize)
+{
+}
+
+
+void*
+Arena::allocate(std::size_t size, std::size_t alignment)
+{
+    // Blocks come from new[], so they are aligned for any fundamental type
+    for (; current < blocks.size(); ++current, used = 0)
+    {
+        Block& block = blocks[current];
+        auto base = reinterpret_cast<std::uintptr_t>(block.data.get());
+        std::size_t offset = ((base + used + alignment - 1) & ~(alignment - 1)) - base;
+        if (offset + size <= block.size)
+        {
+            used = offset + size;
+            return block.data.get() + offset;
+        }
+    }
+
+    // Oversized allocations get a block of their own
+    std::size_t newSize = std::max(blockSize, size + alignment);
+    blocks.push_back({ std::make_unique<char[]>(newSize), newSize });
+    current = blocks.size() - 1;
+
+    auto base = reinterpret_cast<std::uintptr_t>(blocks.back().data.get());
+    std::size_t offset = ((base + alignment - 1) & ~(alignment - 1)) - base;
+    used = offset + size;
+    return blocks.back().data.get() + offset;
+}
+
+
+void
+Arena::reset()
+{
+    // The blocks are kept, so parsing entry after entry allocates nothing
+    // once there are enough blocks for the largest entry
+    current = 0;
+    used = 0;
+}
+
+} // end namespace celestia::util
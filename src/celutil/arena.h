@@ -0,0 +1,117 @@
+// arena.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Bump allocator for short-lived objects.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace celestia::util
+{
+
+/*! Arena hands out memory from large blocks and frees it all at once,
+ *  which suits objects that are discarded together, such as the property
+ *  tree of a catalog entry. Objects created in an arena must be destroyed
+ *  by their owner, but their memory is only reclaimed by reset() or when
+ *  the arena is destroyed.
+ */
+class Arena
+{
+public:
+    static constexpr std::size_t DefaultBlockSize = 64 * 1024;
+
+    explicit Arena(std::size_t blockSize = DefaultBlockSize);
+    ~Arena() = default;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(std::size_t size, std::size_t alignment);
+
+    template<typename T, typename... Args>
+    T* create(Args&&... args)
+    {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Make all the memory available again; every object created in the
+    // arena must have been destroyed.
+    void reset();
+
+private:
+    struct Block
+    {
+        std::unique_ptr<char[]> data;
+        std::size_t size;
+    };
+
+    std::size_t blockSize;
+    std::vector<Block> blocks;
+    std::size_t current{ 0 };
+    std::size_t used{ 0 };
+};
+
+
+/*! Allocator for containers whose elements live in an arena. A default
+ *  constructed allocator uses the heap, so the same container type can
+ *  be used either way.
+ */
+template<typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ArenaAllocator() noexcept = default;
+    explicit ArenaAllocator(Arena* _arena) noexcept : arena(_arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.getArena()) {}
+
+    T* allocate(std::size_t n)
+    {
+        if (arena == nullptr)
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t) noexcept
+    {
+        if (arena == nullptr)
+            ::operator delete(p);
+    }
+
+    Arena* getArena() const noexcept { return arena; }
+
+private:
+    Arena* arena{ nullptr };
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) noexcept
+{
+    return a.getArena() == b.getArena();
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) noexcept
+{
+    return a.getArena() != b.getArena();
+}
+
+} // end namespace celestia::util
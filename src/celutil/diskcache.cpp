@@ -0,0 +1,372 @@
+// diskcache.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Persistent cache of files derived from the data files.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "diskcache.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "logger.h"
+
+namespace celestia::util
+{
+
+namespace
+{
+
+// When over the size limit, delete entries down to this fraction of it, so
+// that it isn't exceeded again by the very next entry
+constexpr double TrimTarget = 0.9;
+
+constexpr std::string_view TempExtension = ".tmp";
+
+bool
+isEntry(const fs::directory_entry& entry)
+{
+    std::error_code ec;
+    return entry.is_regular_file(ec) && entry.path().extension() != TempExtension;
+}
+
+// The thread writing the entries queued and keeping the caches within
+// their size limit
+class CacheWriter
+{
+public:
+    static CacheWriter& get()
+    {
+        static CacheWriter writer;
+        return writer;
+    }
+
+    ~CacheWriter();
+
+    CacheWriter(const CacheWriter&) = delete;
+    CacheWriter& operator=(const CacheWriter&) = delete;
+
+    void post(std::function<void()>&& job);
+    void flush();
+
+    void addDirectory(const fs::path& directory);
+    void addEntry(std::uintmax_t size);
+    void setMaxSize(std::uintmax_t size);
+
+private:
+    CacheWriter() = default;
+
+    void run();
+    void scan(const fs::path& directory);
+    void trim();
+    // Called with the mutex locked
+    void checkSize();
+
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable jobsDone;
+    std::deque<std::function<void()>> jobs;
+    bool busy{ false };
+    bool stopRequested{ false };
+    std::thread thread;
+
+    std::vector<fs::path> directories;
+    std::uintmax_t totalSize{ 0 };
+    std::uintmax_t maxSize{ 0 };
+    bool trimQueued{ false };
+};
+
+CacheWriter::~CacheWriter()
+{
+    {
+        std::scoped_lock lock(mutex);
+        stopRequested = true;
+    }
+    jobReady.notify_one();
+    if (thread.joinable())
+        thread.join();
+}
+
+void
+CacheWriter::post(std::function<void()>&& job)
+{
+    {
+        std::scoped_lock lock(mutex);
+        jobs.push_back(std::move(job));
+        if (!thread.joinable())
+            thread = std::thread(&CacheWriter::run, this);
+    }
+    jobReady.notify_one();
+}
+
+void
+CacheWriter::flush()
+{
+    std::unique_lock lock(mutex);
+    jobsDone.wait(lock, [this]() { return jobs.empty() && !busy; });
+}
+
+// The queued entries are all written before the thread stops
+void
+CacheWriter::run()
+{
+    std::unique_lock lock(mutex);
+    for (;;)
+    {
+        jobReady.wait(lock, [this]() { return stopRequested || !jobs.empty(); });
+        if (jobs.empty())
+            return;
+
+        std::function<void()> job = std::move(jobs.front());
+        jobs.pop_front();
+        busy = true;
+        lock.unlock();
+        job();
+        lock.lock();
+        busy = false;
+        if (jobs.empty())
+            jobsDone.notify_all();
+    }
+}
+
+void
+CacheWriter::addDirectory(const fs::path& directory)
+{
+    std::scoped_lock lock(mutex);
+    if (std::find(directories.begin(), directories.end(), directory) != directories.end())
+        return;
+
+    directories.push_back(directory);
+    jobs.push_back([this, directory]() { scan(directory); });
+    if (!thread.joinable())
+        thread = std::thread(&CacheWriter::run, this);
+    jobReady.notify_one();
+}
+
+void
+CacheWriter::addEntry(std::uintmax_t size)
+{
+    std::scoped_lock lock(mutex);
+    totalSize += size;
+    checkSize();
+}
+
+void
+CacheWriter::setMaxSize(std::uintmax_t size)
+{
+    std::scoped_lock lock(mutex);
+    maxSize = size;
+    checkSize();
+}
+
+void
+CacheWriter::checkSize()
+{
+    if (maxSize == 0 || totalSize <= maxSize || trimQueued || directories.empty())
+        return;
+
+    trimQueued = true;
+    jobs.push_back([this]() { trim(); });
+    if (!thread.joinable())
+        thread = std::thread(&CacheWriter::run, this);
+    jobReady.notify_one();
+}
+
+void
+CacheWriter::scan(const fs::path& directory)
+{
+    std::uintmax_t size = 0;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(directory, ec))
+    {
+        if (isEntry(entry))
+            size += entry.file_size(ec);
+    }
+
+    std::scoped_lock lock(mutex);
+    totalSize += size;
+    checkSize();
+}
+
+// Delete the entries of all caches used least recently
+void
+CacheWriter::trim()
+{
+    std::vector<fs::path> trimmed;
+    std::uintmax_t limit;
+    {
+        std::scoped_lock lock(mutex);
+        trimmed = directories;
+        limit = maxSize;
+    }
+
+    struct Entry
+    {
+        fs::path path;
+        fs::file_time_type lastUsed;
+        std::uintmax_t size;
+    };
+
+    std::vector<Entry> entries;
+    std::uintmax_t size = 0;
+    std::error_code ec;
+    for (const fs::path& directory : trimmed)
+    {
+        for (const auto& entry : fs::directory_iterator(directory, ec))
+        {
+            if (!isEntry(entry))
+                continue;
+            Entry& e = entries.emplace_back();
+            e.path = entry.path();
+            e.lastUsed = entry.last_write_time(ec);
+            e.size = entry.file_size(ec);
+            size += e.size;
+        }
+    }
+
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry& e0, const Entry& e1) { return e0.lastUsed < e1.lastUsed; });
+
+    auto target = static_cast<std::uintmax_t>(static_cast<double>(limit) * TrimTarget);
+    std::size_t nDeleted = 0;
+    for (const Entry& e : entries)
+    {
+        if (size <= target)
+            break;
+        if (fs::remove(e.path, ec))
+        {
+            size -= e.size;
+            ++nDeleted;
+        }
+    }
+
+    if (nDeleted > 0)
+        GetLogger()->verbose("Deleted {} cache entries, {} bytes left\n", nDeleted, size);
+
+    std::scoped_lock lock(mutex);
+    totalSize = size;
+    trimQueued = false;
+}
+
+} // end unnamed namespace
+
+DiskCache::DiskCache(const fs::path& _directory, std::uint32_t _version) :
+    directory(_directory),
+    version(_version)
+{
+    CacheWriter::get().addDirectory(directory);
+}
+
+fs::path
+DiskCache::getPath(const fs::path& source,
+                   std::string_view variant,
+                   std::string_view extension) const
+{
+    std::error_code ec;
+    fs::path absolutePath = fs::absolute(source, ec);
+    if (ec)
+        return fs::path();
+    auto size = fs::file_size(source, ec);
+    if (ec)
+        return fs::path();
+    auto modified = fs::last_write_time(source, ec);
+    if (ec)
+        return fs::path();
+
+    auto key = fmt::format("{}|{}|{}|{}",
+                           absolutePath.string(),
+                           variant,
+                           static_cast<std::uint64_t>(size),
+                           static_cast<std::int64_t>(modified.time_since_epoch().count()));
+    return getKeyPath(source.stem().string(), key, extension);
+}
+
+fs::path
+DiskCache::getKeyPath(std::string_view prefix,
+                      std::string_view key,
+                      std::string_view extension) const
+{
+    auto hash = std::hash<std::string>()(fmt::format("{}|{}", version, key));
+    if (prefix.empty())
+        return directory / fmt::format("{:016x}{}", static_cast<std::uint64_t>(hash), extension);
+    return directory / fmt::format("{}-{:016x}{}", prefix, static_cast<std::uint64_t>(hash), extension);
+}
+
+// Entries are used least recently when they were last written or used
+bool
+DiskCache::use(const fs::path& path)
+{
+    std::error_code ec;
+    if (!fs::exists(path, ec))
+        return false;
+
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    return true;
+}
+
+bool
+DiskCache::write(const fs::path& path, const Writer& writer)
+{
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+    if (ec)
+        return false;
+
+    fs::path tempPath = path;
+    tempPath += fmt::format(".{:x}{}", std::hash<std::thread::id>()(std::this_thread::get_id()), TempExtension);
+    bool written = writer(tempPath);
+    if (written)
+        fs::rename(tempPath, path, ec);
+    if (!written || ec)
+    {
+        fs::remove(tempPath, ec);
+        return false;
+    }
+
+    CacheWriter::get().addEntry(fs::file_size(path, ec));
+    return true;
+}
+
+void
+DiskCache::writeLater(const fs::path& path, std::string&& data)
+{
+    CacheWriter::get().post([path, data = std::move(data)]()
+    {
+        bool written = write(path, [&data](const fs::path& tempPath)
+        {
+            std::ofstream out(tempPath, std::ios::out | std::ios::binary);
+            out.write(data.data(), static_cast<std::streamsize>(data.size()));
+            out.close();
+            return out.good();
+        });
+        if (!written)
+            GetLogger()->warn("Failed to write the cache entry {}\n", path);
+    });
+}
+
+void
+DiskCache::flush()
+{
+    CacheWriter::get().flush();
+}
+
+void
+DiskCache::setMaxSize(std::uintmax_t maxSize)
+{
+    CacheWriter::get().setMaxSize(maxSize);
+}
+
+} // end namespace celestia::util
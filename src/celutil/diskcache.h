@@ -0,0 +1,78 @@
+// diskcache.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Persistent cache of files derived from the data files.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include <celcompat/filesystem.h>
+
+namespace celestia::util
+{
+
+/*! DiskCache names and writes the entries of a directory of files derived
+ *  from other files, like compressed textures, converted models or lexed
+ *  catalogs, which are expensive to derive again on every run.
+ *
+ *  Entries are named after a hash of a key and of the version of the
+ *  cache, so that entries of a changed format are never read, only left
+ *  unused until they are deleted. They are written to a temporary file
+ *  which is renamed once complete, so that readers, on other threads or in
+ *  other instances, see entries either whole or not at all.
+ *
+ *  The directories of all caches share a size limit. Once their entries
+ *  take more, those used least recently are deleted on a background
+ *  thread, which also writes the entries queued with writeLater().
+ */
+class DiskCache
+{
+public:
+    // Write an entry into the file at the path, returning whether it
+    // succeeded
+    using Writer = std::function<bool(const fs::path&)>;
+
+    DiskCache(const fs::path& directory, std::uint32_t version);
+
+    const fs::path& getDirectory() const { return directory; }
+
+    // Path of the entry derived from the source file and the variant, keyed
+    // by the source's absolute path, size and modification time; empty if
+    // the source can't be read. The extension may be empty.
+    fs::path getPath(const fs::path& source,
+                     std::string_view variant,
+                     std::string_view extension) const;
+    // Path of the entry named with the prefix for a key of the contents it
+    // is derived from
+    fs::path getKeyPath(std::string_view prefix,
+                        std::string_view key,
+                        std::string_view extension) const;
+
+    // Whether the entry exists, marking it as used
+    static bool use(const fs::path& path);
+    // Write the entry with the writer, replacing it whole
+    static bool write(const fs::path& path, const Writer& writer);
+    // Write the entry with the data on the background thread
+    static void writeLater(const fs::path& path, std::string&& data);
+    // Wait until the entries queued with writeLater() are written
+    static void flush();
+
+    // Limit of the size of all caches in bytes; with 0 there is none
+    static void setMaxSize(std::uintmax_t maxSize);
+
+private:
+    fs::path directory;
+    std::uint32_t version;
+};
+
+} // end namespace celestia::util
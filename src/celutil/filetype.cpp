@@ -36,6 +36,7 @@ constexpr std::string_view CelestiaStarCatalogExt = ".stc"sv;
 constexpr std::string_view CelestiaDeepSkyCatalogExt = ".dsc"sv;
 constexpr std::string_view MKVExt = ".mkv"sv;
 constexpr std::string_view DDSExt = ".dds"sv;
+constexpr std::string_view KTX2Ext = ".ktx2"sv;
 constexpr std::string_view DXT5NormalMapExt = ".dxt5nm"sv;
 constexpr std::string_view CelestiaLegacyScriptExt = ".cel"sv;
 constexpr std::string_view CelestiaScriptExt = ".clx"sv;
@@ -84,6 +85,8 @@ ContentType DetermineFileType(const fs::path& filename, bool isExtension)
         return ContentType::MKV;
     if (compareIgnoringCase(DDSExt, ext) == 0)
         return ContentType::DDS;
+    if (compareIgnoringCase(KTX2Ext, ext) == 0)
+        return ContentType::KTX2;
     if (compareIgnoringCase(CelestiaLegacyScriptExt, ext) == 0)
         return ContentType::CelestiaLegacyScript;
     if (compareIgnoringCase(CelestiaScriptExt, ext) == 0 ||
@@ -0,0 +1,317 @@
+// jobsystem.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Pool of worker threads running short jobs.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "jobsystem.h"
+
+#include <chrono>
+#include <utility>
+
+namespace celestia::util
+{
+
+namespace
+{
+
+struct ThreadState
+{
+    const JobSystem* system{ nullptr };
+    unsigned int index{ JobSystem::NotAJobThread };
+};
+
+thread_local ThreadState threadState;
+
+std::unique_ptr<JobSystem> sharedJobSystem;
+std::mutex sharedJobSystemMutex;
+
+} // end unnamed namespace
+
+
+bool
+JobSystem::Counter::isDone() const
+{
+    // Taking the lock also makes sure that the thread finishing the last
+    // job is done with the counter, so that it may be destroyed
+    std::scoped_lock lock(mutex);
+    return pending == 0;
+}
+
+
+JobSystem::JobSystem(unsigned int nThreads) :
+    mainThread(std::this_thread::get_id())
+{
+    if (nThreads == 0)
+        nThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned int i = 0; i < nThreads; i++)
+    {
+        queues.push_back(std::make_unique<Queue>());
+        arenas.push_back(std::make_unique<Arena>());
+    }
+
+    workers.reserve(nThreads - 1);
+    for (unsigned int i = 1; i < nThreads; i++)
+        workers.emplace_back(&JobSystem::run, this, i);
+}
+
+
+JobSystem::~JobSystem()
+{
+    {
+        std::scoped_lock lock(sleepMutex);
+        stopRequested = true;
+    }
+    sleepCondition.notify_all();
+
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+
+unsigned int
+JobSystem::threadIndex() const
+{
+    if (threadState.system == this)
+        return threadState.index;
+    return std::this_thread::get_id() == mainThread ? 0 : NotAJobThread;
+}
+
+
+void
+JobSystem::submit(Job job, Counter* counter, Counter* dependency)
+{
+    if (counter != nullptr)
+    {
+        std::scoped_lock lock(counter->mutex);
+        ++counter->pending;
+    }
+
+    if (dependency != nullptr)
+    {
+        std::scoped_lock lock(dependency->mutex);
+        if (dependency->pending != 0)
+        {
+            dependency->dependents.push_back({ std::move(job), counter });
+            return;
+        }
+    }
+
+    push({ std::move(job), counter });
+}
+
+
+void
+JobSystem::push(Entry&& entry)
+{
+    // Jobs queued from other threads go to the queue of the main thread
+    unsigned int index = threadIndex();
+    Queue& queue = *queues[index == NotAJobThread ? 0 : index];
+    // Counted first, so that the count never drops below zero
+    ++queued;
+    {
+        std::scoped_lock lock(queue.mutex);
+        queue.entries.push_back(std::move(entry));
+    }
+
+    if (workers.empty())
+        return;
+
+    // The lock keeps a worker which just found no job from missing the
+    // notification before it sleeps
+    {
+        std::scoped_lock lock(sleepMutex);
+    }
+    sleepCondition.notify_one();
+}
+
+
+void
+JobSystem::wait(const Counter& counter)
+{
+    unsigned int index = threadIndex();
+    while (!counter.isDone())
+    {
+        if (!runOne(index))
+            std::this_thread::yield();
+    }
+}
+
+
+bool
+JobSystem::runOne(unsigned int index)
+{
+    Entry entry;
+    bool found = false;
+    bool stolen = false;
+
+    if (index != NotAJobThread)
+    {
+        Queue& queue = *queues[index];
+        std::scoped_lock lock(queue.mutex);
+        if (!queue.entries.empty())
+        {
+            entry = std::move(queue.entries.back());
+            queue.entries.pop_back();
+            found = true;
+        }
+    }
+
+    for (std::size_t i = 1; !found && i <= queues.size(); i++)
+    {
+        std::size_t victim = (static_cast<std::size_t>(index == NotAJobThread ? 0 : index) + i) % queues.size();
+        Queue& queue = *queues[victim];
+        std::scoped_lock lock(queue.mutex);
+        if (!queue.entries.empty())
+        {
+            entry = std::move(queue.entries.front());
+            queue.entries.pop_front();
+            found = true;
+            stolen = true;
+        }
+    }
+
+    if (!found)
+        return false;
+
+    --queued;
+
+    auto start = std::chrono::steady_clock::now();
+    entry.job();
+    auto duration = std::chrono::steady_clock::now() - start;
+
+    busyNanoseconds += static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    ++jobsRun;
+    if (stolen)
+        ++jobsStolen;
+
+    finish(entry.counter);
+    return true;
+}
+
+
+void
+JobSystem::finish(Counter* counter)
+{
+    if (counter == nullptr)
+        return;
+
+    std::vector<Counter::Dependent> released;
+    {
+        std::scoped_lock lock(counter->mutex);
+        if (--counter->pending == 0)
+            released.swap(counter->dependents);
+    }
+
+    for (Counter::Dependent& dependent : released)
+        push({ std::move(dependent.job), dependent.counter });
+}
+
+
+void
+JobSystem::run(unsigned int index)
+{
+    threadState = { this, index };
+    std::uint32_t lastFrame = frame;
+
+    for (;;)
+    {
+        // Between jobs, so none of the scratch memory is in use
+        if (std::uint32_t currentFrame = frame; currentFrame != lastFrame)
+        {
+            arenas[index]->reset();
+            lastFrame = currentFrame;
+        }
+
+        if (runOne(index))
+            continue;
+
+        std::unique_lock lock(sleepMutex);
+        sleepCondition.wait(lock, [this] { return stopRequested || queued > 0; });
+        if (stopRequested && queued == 0)
+            break;
+    }
+}
+
+
+Arena*
+JobSystem::scratchArena()
+{
+    unsigned int index = threadIndex();
+    return index == NotAJobThread ? nullptr : arenas[index].get();
+}
+
+
+void
+JobSystem::runOnMainThread(Job job)
+{
+    std::scoped_lock lock(mainThreadMutex);
+    mainThreadJobs.push_back(std::move(job));
+}
+
+
+void
+JobSystem::update()
+{
+    // Without workers, nothing else runs the jobs nobody waits for
+    if (workers.empty())
+    {
+        while (runOne(0));
+    }
+
+    std::vector<Job> jobs;
+    {
+        std::scoped_lock lock(mainThreadMutex);
+        jobs.swap(mainThreadJobs);
+    }
+
+    for (const Job& job : jobs)
+        job();
+
+    arenas[0]->reset();
+    ++frame;
+}
+
+
+JobStats
+JobSystem::takeStats()
+{
+    JobStats stats;
+    stats.jobs = jobsRun.exchange(0);
+    stats.stolenJobs = jobsStolen.exchange(0);
+    stats.busyTime = static_cast<double>(busyNanoseconds.exchange(0)) * 1.0e-9;
+    return stats;
+}
+
+
+JobSystem*
+CreateJobSystem(unsigned int nThreads)
+{
+    std::scoped_lock lock(sharedJobSystemMutex);
+    if (sharedJobSystem == nullptr)
+        sharedJobSystem = std::make_unique<JobSystem>(nThreads);
+    return sharedJobSystem.get();
+}
+
+
+JobSystem*
+GetJobSystem()
+{
+    return CreateJobSystem(0);
+}
+
+
+void
+DestroyJobSystem()
+{
+    std::scoped_lock lock(sharedJobSystemMutex);
+    sharedJobSystem = nullptr;
+}
+
+} // end namespace celestia::util
@@ -0,0 +1,199 @@
+// jobsystem.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Pool of worker threads running short jobs.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "arena.h"
+
+namespace celestia::util
+{
+
+struct JobStats
+{
+    // Jobs run, and those of them taken from the queue of another thread
+    unsigned int jobs{ 0 };
+    unsigned int stolenJobs{ 0 };
+    // Seconds spent running jobs, summed over the threads
+    double busyTime{ 0.0 };
+};
+
+/*! JobSystem runs jobs on a pool of worker threads. Each thread has a
+ *  queue of its own, which it takes its latest jobs from first, and takes
+ *  the oldest ones of the other threads when it's empty. The main thread,
+ *  the one which created the system, runs jobs too while it waits for
+ *  them, so a system of one thread has no workers and runs every job on
+ *  the main thread, in wait() or update().
+ *
+ *  Jobs are counted in a Counter, to wait for them or to only start other
+ *  jobs once they're done. Work which must be done on the main thread,
+ *  like uploading results to the GPU, is queued with runOnMainThread()
+ *  and run by update().
+ */
+class JobSystem
+{
+public:
+    using Job = std::function<void()>;
+
+    static constexpr unsigned int NotAJobThread = ~0u;
+
+    // Number of unfinished jobs of a group. It must outlive the jobs
+    // counted and the dependent jobs waiting for it.
+    class Counter
+    {
+    public:
+        Counter() = default;
+        ~Counter() = default;
+
+        Counter(const Counter&) = delete;
+        Counter& operator=(const Counter&) = delete;
+
+        bool isDone() const;
+
+    private:
+        struct Dependent
+        {
+            Job job;
+            Counter* counter;
+        };
+
+        mutable std::mutex mutex;
+        unsigned int pending{ 0 };
+        std::vector<Dependent> dependents;
+
+        friend class JobSystem;
+    };
+
+    // With 0 threads, one per CPU core is used
+    explicit JobSystem(unsigned int nThreads = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Threads running jobs, the main thread included
+    unsigned int threadCount() const { return static_cast<unsigned int>(queues.size()); }
+    // 0 on the main thread, 1 to threadCount() - 1 on the workers and
+    // NotAJobThread on any other thread
+    unsigned int threadIndex() const;
+
+    // Queue a job, counted in counter if not null. With a dependency, it's
+    // only queued once the jobs counted in the dependency are done.
+    void submit(Job job, Counter* counter = nullptr, Counter* dependency = nullptr);
+    // Run jobs until the ones counted in counter are done
+    void wait(const Counter& counter);
+
+    // Call fn(chunkBegin, chunkEnd) for chunks of [begin, end) of at most
+    // grain items, in parallel, and return once all are done. The calling
+    // thread takes the first chunk.
+    template<typename F>
+    void parallelFor(std::size_t begin, std::size_t end, std::size_t grain, F&& fn);
+
+    // Memory for the job running on the calling thread, reclaimed between
+    // jobs after the next update(), so it mustn't outlive the job or, on
+    // the main thread, the frame. Null on other threads, which makes an
+    // ArenaAllocator use the heap.
+    Arena* scratchArena();
+
+    // Queue a job to run on the main thread in the next update()
+    void runOnMainThread(Job job);
+    // Called on the main thread once per frame, outside of any job: run
+    // the jobs queued for the main thread and reclaim the scratch memory.
+    void update();
+
+    // The counters since the last call
+    JobStats takeStats();
+
+private:
+    struct Entry
+    {
+        Job job;
+        Counter* counter;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Entry> entries;
+    };
+
+    void run(unsigned int index);
+    void push(Entry&& entry);
+    bool runOne(unsigned int index);
+    void finish(Counter* counter);
+
+    std::thread::id mainThread;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::unique_ptr<Arena>> arenas;
+    std::atomic<std::size_t> queued{ 0 };
+    std::atomic<std::uint32_t> frame{ 0 };
+
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    bool stopRequested{ false };
+
+    std::mutex mainThreadMutex;
+    std::vector<Job> mainThreadJobs;
+
+    std::atomic<unsigned int> jobsRun{ 0 };
+    std::atomic<unsigned int> jobsStolen{ 0 };
+    std::atomic<std::uint64_t> busyNanoseconds{ 0 };
+
+    // Started last, once the members they use are initialized
+    std::vector<std::thread> workers;
+};
+
+template<typename F>
+void
+JobSystem::parallelFor(std::size_t begin, std::size_t end, std::size_t grain, F&& fn)
+{
+    if (begin >= end)
+        return;
+
+    grain = std::max<std::size_t>(grain, 1);
+    if (end - begin <= grain || threadCount() == 1)
+    {
+        fn(begin, end);
+        return;
+    }
+
+    Counter counter;
+    for (std::size_t chunkBegin = begin + grain; chunkBegin < end;)
+    {
+        std::size_t chunkEnd = end - chunkBegin > grain ? chunkBegin + grain : end;
+        submit([&fn, chunkBegin, chunkEnd] { fn(chunkBegin, chunkEnd); }, &counter);
+        chunkBegin = chunkEnd;
+    }
+
+    fn(begin, begin + grain);
+    wait(counter);
+}
+
+// Create the job system shared by the application; call it on the main
+// thread before any use. Once created the system isn't replaced.
+JobSystem* CreateJobSystem(unsigned int nThreads = 0);
+// The shared job system, created with the default thread count if
+// CreateJobSystem() wasn't called
+JobSystem* GetJobSystem();
+void DestroyJobSystem();
+
+} // end namespace celestia::util
@@ -0,0 +1,243 @@
+// loadtrace.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Durations of the files and phases loaded at startup.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "loadtrace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <utility>
+
+#include <fmt/ostream.h>
+
+namespace celestia::util
+{
+
+namespace
+{
+
+// Threads are numbered in the order they first record an event
+std::atomic<std::uint32_t> threadCount{ 0 };
+thread_local std::uint32_t threadIndex = threadCount.fetch_add(1, std::memory_order_relaxed);
+thread_local std::uint32_t threadDepth = 0;
+
+// Escape the characters of a string which end or break a JSON string
+std::string
+escapeJSON(std::string_view s)
+{
+    std::string escaped;
+    escaped.reserve(s.size());
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            escaped += fmt::format("\\u{:04x}", static_cast<unsigned int>(c));
+        }
+        else
+        {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+} // end unnamed namespace
+
+LoadTrace::LoadTrace() :
+    origin(std::chrono::steady_clock::now())
+{
+}
+
+LoadTrace&
+LoadTrace::get()
+{
+    static LoadTrace trace;
+    return trace;
+}
+
+void
+LoadTrace::stop()
+{
+    recording.store(false, std::memory_order_relaxed);
+}
+
+double
+LoadTrace::now() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void
+LoadTrace::add(LoadEvent&& event)
+{
+    std::scoped_lock lock(mutex);
+    events.push_back(std::move(event));
+}
+
+std::vector<LoadEvent>
+LoadTrace::getEvents() const
+{
+    std::scoped_lock lock(mutex);
+    return events;
+}
+
+double
+LoadTrace::getDuration() const
+{
+    std::scoped_lock lock(mutex);
+    double duration = 0.0;
+    for (const LoadEvent& event : events)
+        duration = std::max(duration, event.start + event.duration);
+    return duration;
+}
+
+LoadEvent
+LoadTrace::getSlowest() const
+{
+    std::scoped_lock lock(mutex);
+    const LoadEvent* slowest = nullptr;
+    for (const LoadEvent& event : events)
+    {
+        if (event.category != LoadScope::Phase && (slowest == nullptr || event.duration > slowest->duration))
+            slowest = &event;
+    }
+    return slowest == nullptr ? LoadEvent() : *slowest;
+}
+
+void
+LoadTrace::writeChromeTrace(std::ostream& out) const
+{
+    std::vector<LoadEvent> recorded = getEvents();
+    out << "[\n";
+    bool first = true;
+    for (const LoadEvent& event : recorded)
+    {
+        fmt::print(out, "{}{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":{},"
+                        "\"ts\":{:.3f},\"dur\":{:.3f},\"args\":{{\"bytes\":{},\"objects\":{}}}}}",
+                   first ? "" : ",\n",
+                   escapeJSON(event.name), escapeJSON(event.category), event.thread,
+                   event.start * 1.0e6, event.duration * 1.0e6,
+                   event.bytes, event.objects);
+        first = false;
+    }
+    out << "\n]\n";
+}
+
+void
+LoadTrace::writeSummary(std::ostream& out, std::size_t count) const
+{
+    std::vector<LoadEvent> recorded = getEvents();
+
+    struct Totals
+    {
+        std::size_t events{ 0 };
+        double duration{ 0.0 };
+        std::uintmax_t bytes{ 0 };
+        std::size_t objects{ 0 };
+    };
+
+    std::map<std::string, Totals> categories;
+    for (const LoadEvent& event : recorded)
+    {
+        Totals& totals = categories[event.category];
+        ++totals.events;
+        totals.duration += event.duration;
+        totals.bytes += event.bytes;
+        totals.objects += event.objects;
+    }
+
+    fmt::print(out, "{:<12} {:>8} {:>12} {:>14} {:>10}\n", "Category", "Count", "Time (ms)", "Bytes", "Objects");
+    for (const auto& [category, totals] : categories)
+    {
+        fmt::print(out, "{:<12} {:>8} {:>12.1f} {:>14} {:>10}\n",
+                   category, totals.events, totals.duration * 1000.0, totals.bytes, totals.objects);
+    }
+
+    std::sort(recorded.begin(), recorded.end(),
+              [](const LoadEvent& e0, const LoadEvent& e1) { return e0.duration > e1.duration; });
+
+    fmt::print(out, "\n{:<12} {:>12} {:>14} {:>10}  {}\n", "Category", "Time (ms)", "Bytes", "Objects", "Name");
+    std::size_t written = 0;
+    for (const LoadEvent& event : recorded)
+    {
+        if (written == count)
+            break;
+        if (event.category == LoadScope::Phase)
+            continue;
+        fmt::print(out, "{:<12} {:>12.1f} {:>14} {:>10}  {}\n",
+                   event.category, event.duration * 1000.0, event.bytes, event.objects, event.name);
+        ++written;
+    }
+}
+
+bool
+LoadTrace::write(const fs::path& path) const
+{
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+    if (!out.good())
+        return false;
+
+    if (path.extension() == ".json")
+        writeChromeTrace(out);
+    else
+        writeSummary(out);
+    out.close();
+    return out.good();
+}
+
+LoadScope::LoadScope(std::string_view category, std::string_view name) :
+    active(LoadTrace::get().isRecording())
+{
+    if (!active)
+        return;
+
+    event.category = category;
+    event.name = name;
+    event.thread = threadIndex;
+    event.depth = threadDepth++;
+    event.start = LoadTrace::get().now();
+}
+
+LoadScope::LoadScope(std::string_view category, std::string_view name, const fs::path& file) :
+    LoadScope(category, name)
+{
+    if (!active)
+        return;
+
+    std::error_code ec;
+    auto size = fs::file_size(file, ec);
+    if (!ec)
+        event.bytes = size;
+}
+
+LoadScope
+LoadScope::forFile(std::string_view category, const fs::path& file)
+{
+    return LoadScope(category, file.string(), file);
+}
+
+LoadScope::~LoadScope()
+{
+    if (!active)
+        return;
+
+    --threadDepth;
+    LoadTrace& trace = LoadTrace::get();
+    event.duration = trace.now() - event.start;
+    trace.add(std::move(event));
+}
+
+} // end namespace celestia::util
@@ -0,0 +1,111 @@
+// loadtrace.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Durations of the files and phases loaded at startup.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+
+namespace celestia::util
+{
+
+struct LoadEvent
+{
+    // The kind of file or phase, e.g. "stc" or "shader", and its name
+    std::string category;
+    std::string name;
+    // In seconds from the start of the trace
+    double start{ 0.0 };
+    double duration{ 0.0 };
+    std::uintmax_t bytes{ 0 };
+    std::size_t objects{ 0 };
+    // Number of threads recording, and the depth of nesting on the thread
+    std::uint32_t thread{ 0 };
+    std::uint32_t depth{ 0 };
+};
+
+/*! LoadTrace records when each file and phase of the startup is loaded,
+ *  how long it takes, how many bytes it reads and how many objects it
+ *  creates, so that the catalogs, add-ons, fonts or shaders slowing it
+ *  down can be found. Events are recorded from the start of the program
+ *  until stop(); they can be written as Chrome trace events, which
+ *  chrome://tracing or Perfetto show on a time line, or as a table.
+ */
+class LoadTrace
+{
+public:
+    static LoadTrace& get();
+
+    bool isRecording() const { return recording.load(std::memory_order_relaxed); }
+    // Stop recording, keeping the events recorded
+    void stop();
+
+    double now() const;
+    void add(LoadEvent&& event);
+    std::vector<LoadEvent> getEvents() const;
+    // Time from the start of the trace to the end of the last event
+    double getDuration() const;
+    // The event taking longest of those which aren't phases
+    LoadEvent getSlowest() const;
+
+    void writeChromeTrace(std::ostream& out) const;
+    // The totals of each category, then the count events taking longest
+    void writeSummary(std::ostream& out, std::size_t count = 20) const;
+    // As Chrome trace events for a .json file, else as a summary
+    bool write(const fs::path& path) const;
+
+private:
+    LoadTrace();
+
+    std::chrono::steady_clock::time_point origin;
+    std::atomic<bool> recording{ true };
+    mutable std::mutex mutex;
+    std::vector<LoadEvent> events;
+};
+
+/*! Records a loading event in the LoadTrace for the lifetime of the
+ *  object; those of a phase contain the events of its files.
+ */
+class LoadScope
+{
+public:
+    // The category of phases, which are ignored by LoadTrace::getSlowest()
+    static constexpr std::string_view Phase = "phase";
+
+    LoadScope(std::string_view category, std::string_view name);
+    ~LoadScope();
+
+    // A scope named after the file, whose bytes read are its size
+    static LoadScope forFile(std::string_view category, const fs::path& file);
+
+    LoadScope(const LoadScope&) = delete;
+    LoadScope& operator=(const LoadScope&) = delete;
+
+    void addBytes(std::uintmax_t bytes) { event.bytes += bytes; }
+    void setObjects(std::size_t objects) { event.objects = objects; }
+
+private:
+    LoadScope(std::string_view category, std::string_view name, const fs::path& file);
+
+    bool active;
+    LoadEvent event;
+};
+
+} // end namespace celestia::util
@@ -9,7 +9,15 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <utility>
 
 #ifdef _MSC_VER
 #include <windows.h>
@@ -20,6 +28,265 @@
 namespace celestia::util
 {
 
+namespace
+{
+
+constexpr std::size_t LevelCount = static_cast<std::size_t>(Level::Debug) + 1;
+
+// How long the writer thread sleeps at most before looking for messages
+// again, in case the wake-up of a producer passed it by
+constexpr auto WriterIdleTime = std::chrono::milliseconds(10);
+
+std::int64_t
+currentSecond()
+{
+    using namespace std::chrono;
+    return duration_cast<seconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+} // end unnamed namespace
+
+/*! The Sink of a Logger limits the rate of its messages and, when it's
+ *  asynchronous, queues them for a writer thread. The queue is a bounded
+ *  ring of slots, each with a sequence number telling whether it's free
+ *  or written, so that any thread can queue a message with a single
+ *  compare-and-swap and the writer thread can take it without a lock.
+ *  The writer only takes the mutex to sleep when the queue is empty.
+ */
+class Logger::Sink
+{
+public:
+    ~Sink() { stop(); }
+
+    bool allow(Level level);
+    void setRateLimit(Level level, unsigned int perSecond);
+
+    bool isAsync() const { return async.load(std::memory_order_acquire); }
+    void start(const Logger& logger, std::size_t capacity);
+    void stop();
+    void flush();
+    void post(Level level, std::string&& text);
+
+private:
+    struct Slot
+    {
+        std::atomic<std::size_t> sequence;
+        Level level;
+        std::string text;
+    };
+
+    struct RateLimit
+    {
+        std::atomic<unsigned int> perSecond{ 0 };
+        std::atomic<std::int64_t> second{ 0 };
+        std::atomic<unsigned int> count{ 0 };
+    };
+
+    bool push(Level level, std::string& text);
+    bool pop(Level& level, std::string& text);
+    void run(const Logger& logger);
+
+    std::array<RateLimit, LevelCount> rateLimits;
+    std::atomic<std::size_t> dropped{ 0 };
+
+    std::atomic<bool> async{ false };
+    std::unique_ptr<Slot[]> slots;
+    std::size_t mask{ 0 };
+    alignas(64) std::atomic<std::size_t> enqueuePosition{ 0 };
+    alignas(64) std::atomic<std::size_t> dequeuePosition{ 0 };
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable drained;
+    std::atomic<bool> sleeping{ false };
+    bool stopRequested{ false };
+    std::thread thread;
+};
+
+bool
+Logger::Sink::allow(Level level)
+{
+    RateLimit& limit = rateLimits[static_cast<std::size_t>(level)];
+    unsigned int perSecond = limit.perSecond.load(std::memory_order_relaxed);
+    if (perSecond == 0)
+        return true;
+
+    std::int64_t now = currentSecond();
+    std::int64_t second = limit.second.load(std::memory_order_relaxed);
+    if (second != now && limit.second.compare_exchange_strong(second, now, std::memory_order_relaxed))
+        limit.count.store(0, std::memory_order_relaxed);
+
+    if (limit.count.fetch_add(1, std::memory_order_relaxed) < perSecond)
+        return true;
+
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void
+Logger::Sink::setRateLimit(Level level, unsigned int perSecond)
+{
+    rateLimits[static_cast<std::size_t>(level)].perSecond.store(perSecond, std::memory_order_relaxed);
+}
+
+void
+Logger::Sink::start(const Logger& logger, std::size_t capacity)
+{
+    if (isAsync())
+        return;
+
+    // The capacity is rounded up to a power of two to index the ring by mask
+    std::size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+
+    slots = std::make_unique<Slot[]>(size);
+    for (std::size_t i = 0; i < size; ++i)
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    mask = size - 1;
+    enqueuePosition.store(0, std::memory_order_relaxed);
+    dequeuePosition.store(0, std::memory_order_relaxed);
+    stopRequested = false;
+    thread = std::thread(&Sink::run, this, std::cref(logger));
+    async.store(true, std::memory_order_release);
+}
+
+void
+Logger::Sink::stop()
+{
+    if (!isAsync())
+        return;
+
+    // Messages queued meanwhile are still written by the thread
+    async.store(false, std::memory_order_release);
+    {
+        std::scoped_lock lock(mutex);
+        stopRequested = true;
+    }
+    wake.notify_one();
+    thread.join();
+    slots = nullptr;
+}
+
+void
+Logger::Sink::flush()
+{
+    if (!isAsync() || std::this_thread::get_id() == thread.get_id())
+        return;
+
+    std::size_t target = enqueuePosition.load(std::memory_order_acquire);
+    std::unique_lock lock(mutex);
+    wake.notify_one();
+    drained.wait(lock, [this, target]()
+    {
+        return dequeuePosition.load(std::memory_order_acquire) >= target;
+    });
+}
+
+void
+Logger::Sink::post(Level level, std::string&& text)
+{
+    // Errors and warnings are never dropped, but wait for room
+    while (!push(level, text))
+    {
+        if (level > Level::Warning || std::this_thread::get_id() == thread.get_id())
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        std::this_thread::yield();
+    }
+
+    if (sleeping.load())
+    {
+        std::scoped_lock lock(mutex);
+        wake.notify_one();
+    }
+}
+
+bool
+Logger::Sink::push(Level level, std::string& text)
+{
+    std::size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;)
+    {
+        slot = &slots[position & mask];
+        std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        auto difference = static_cast<std::ptrdiff_t>(sequence - position);
+        if (difference == 0)
+        {
+            if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+        {
+            // The slot is still to be taken by the writer: the ring is full
+            return false;
+        }
+        else
+        {
+            position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->level = level;
+    slot->text = std::move(text);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+// Called on the writer thread only
+bool
+Logger::Sink::pop(Level& level, std::string& text)
+{
+    std::size_t position = dequeuePosition.load(std::memory_order_relaxed);
+    Slot& slot = slots[position & mask];
+    if (slot.sequence.load(std::memory_order_acquire) != position + 1)
+        return false;
+
+    level = slot.level;
+    text = std::move(slot.text);
+    slot.text.clear();
+    slot.sequence.store(position + mask + 1, std::memory_order_release);
+    dequeuePosition.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+void
+Logger::Sink::run(const Logger& logger)
+{
+    Level level;
+    std::string text;
+    for (;;)
+    {
+        while (pop(level, text))
+            logger.write(level, text);
+
+        if (std::size_t count = dropped.exchange(0, std::memory_order_relaxed); count > 0)
+            logger.write(Level::Warning, fmt::format("{} log messages dropped\n", count));
+        logger.m_log.flush();
+        logger.m_err.flush();
+
+        std::unique_lock lock(mutex);
+        drained.notify_all();
+        sleeping.store(true);
+        // Messages queued before sleeping was set are seen here
+        if (pop(level, text))
+        {
+            sleeping.store(false);
+            lock.unlock();
+            logger.write(level, text);
+            continue;
+        }
+        if (stopRequested)
+            return;
+
+        wake.wait_for(lock, WriterIdleTime);
+        sleeping.store(false);
+    }
+}
+
 Logger* Logger::g_logger = nullptr;
 
 Logger* GetLogger()
@@ -46,12 +313,47 @@ void DestroyLogger()
 
 Logger::Logger() :
     m_log(std::clog),
-    m_err(std::cerr)
+    m_err(std::cerr),
+    m_sink(std::make_unique<Sink>())
+{
+}
+
+Logger::Logger(Level level, Stream &log, Stream &err) :
+    m_log(log),
+    m_err(err),
+    m_level(level),
+    m_sink(std::make_unique<Sink>())
 {
 }
 
+// The messages queued are written before the streams may go away
+Logger::~Logger() = default;
+
+void Logger::startAsync(std::size_t capacity)
+{
+    m_sink->start(*this, capacity);
+}
+
+void Logger::stopAsync()
+{
+    m_sink->stop();
+}
+
+void Logger::flush() const
+{
+    m_sink->flush();
+}
+
+void Logger::setRateLimit(Level level, unsigned int perSecond)
+{
+    m_sink->setRateLimit(level, perSecond);
+}
+
 void Logger::vlog(Level level, fmt::string_view format, fmt::format_args args) const
 {
+    if (!m_sink->allow(level))
+        return;
+
 #ifdef _MSC_VER
     if (level == Level::Debug && IsDebuggerPresent())
     {
@@ -60,8 +362,20 @@ void Logger::vlog(Level level, fmt::string_view format, fmt::format_args args) c
     }
 #endif
 
+    if (m_sink->isAsync())
+    {
+        m_sink->post(level, fmt::vformat(format, args));
+        return;
+    }
+
     auto &stream = (level <= Level::Warning || level == Level::Debug) ? m_err : m_log;
     fmt::vprint(stream, format, args);
 }
 
+void Logger::write(Level level, std::string_view text) const
+{
+    auto &stream = (level <= Level::Warning || level == Level::Debug) ? m_err : m_log;
+    stream.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
 } // end namespace celestia::util
@@ -11,7 +11,9 @@
 
 #pragma once
 
+#include <cstddef>
 #include <iosfwd>
+#include <memory>
 #include <string>
 
 #include <fmt/format.h>
@@ -46,11 +48,8 @@ class Logger
     using Stream = std::basic_ostream<char>;
 
     Logger();
-    Logger(Level level, Stream &log, Stream &err) :
-        m_level(level),
-        m_log(log),
-        m_err(err)
-    {}
+    Logger(Level level, Stream &log, Stream &err);
+    ~Logger();
 
     void setLevel(Level level)
     {
@@ -75,14 +74,32 @@ class Logger
     template <typename... Args> void
     log(Level, const char *format, const Args&... args) const;
 
+    // Write the messages on a background thread, so that logging only
+    // formats them. Up to capacity messages are queued; when the queue is
+    // full, more errors and warnings wait for room and others are dropped.
+    // Neither this nor stopAsync() may be called while other threads log.
+    void startAsync(std::size_t capacity = 4096);
+    // Write the messages queued, then write them at once again
+    void stopAsync();
+    // Wait until the messages queued are written
+    void flush() const;
+
+    // Log at most perSecond messages of the level a second, dropping the
+    // others; with 0 there is no limit
+    void setRateLimit(Level level, unsigned int perSecond);
+
     static Logger* g_logger;
 
  private:
+    class Sink;
+
     void vlog(Level level, fmt::string_view format, fmt::format_args args) const;
+    void write(Level level, std::string_view text) const;
 
     Stream &m_log;
     Stream &m_err;
     Level   m_level { Level::Info };
+    std::unique_ptr<Sink> m_sink;
 };
 
 template <typename... Args> void
@@ -0,0 +1,47 @@
+// mappedfile.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Read-only memory mapped file.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+#include <celcompat/filesystem.h>
+
+namespace celestia::util
+{
+
+class MappedFile
+{
+public:
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns nullptr if the file can't be opened or mapped
+    static std::unique_ptr<MappedFile> open(const fs::path&);
+
+    const char* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+
+private:
+    MappedFile() = default;
+
+    const char* m_data{ nullptr };
+    std::size_t m_size{ 0 };
+#ifdef _WIN32
+    void* m_file{ nullptr };
+    void* m_mapping{ nullptr };
+#endif
+};
+
+} // end namespace celestia::util
@@ -0,0 +1,94 @@
+// memoryreport.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Estimates of the memory taken by each subsystem.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "memoryreport.h"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+
+#include <fmt/format.h>
+
+namespace celestia::util
+{
+
+std::size_t
+stringMemory(const std::string& s)
+{
+    // Short strings point into the object itself
+    const char* data = s.data();
+    const char* object = reinterpret_cast<const char*>(&s);
+    if (std::greater_equal<const char*>()(data, object) && std::less<const char*>()(data, object + sizeof(s)))
+        return 0;
+    return s.capacity() + 1;
+}
+
+void
+MemoryReport::add(std::string_view category, std::size_t bytes, std::size_t objects)
+{
+    auto it = std::find_if(entries.begin(), entries.end(),
+                           [category](const Entry& entry) { return entry.category == category; });
+    if (it == entries.end())
+    {
+        entries.push_back(Entry{ std::string(category), bytes, objects });
+        return;
+    }
+
+    it->bytes += bytes;
+    it->objects += objects;
+}
+
+const MemoryReport::Entry*
+MemoryReport::find(std::string_view category) const
+{
+    auto it = std::find_if(entries.begin(), entries.end(),
+                           [category](const Entry& entry) { return entry.category == category; });
+    return it == entries.end() ? nullptr : &*it;
+}
+
+std::size_t
+MemoryReport::getTotal() const
+{
+    std::size_t total = 0;
+    for (const Entry& entry : entries)
+        total += entry.bytes;
+    return total;
+}
+
+std::vector<MemoryReport::Entry>
+MemoryReport::getLargest(std::size_t count) const
+{
+    std::vector<Entry> largest = entries;
+    std::stable_sort(largest.begin(), largest.end(),
+                     [](const Entry& e0, const Entry& e1) { return e0.bytes > e1.bytes; });
+    if (largest.size() > count)
+        largest.resize(count);
+    return largest;
+}
+
+std::string
+formatMemorySize(std::size_t bytes)
+{
+    constexpr std::array<const char*, 4> units = { "KiB", "MiB", "GiB", "TiB" };
+    if (bytes < 1024)
+        return fmt::format("{} B", bytes);
+
+    double size = static_cast<double>(bytes) / 1024.0;
+    std::size_t unit = 0;
+    while (size >= 1024.0 && unit + 1 < units.size())
+    {
+        size /= 1024.0;
+        ++unit;
+    }
+    return fmt::format("{:.1f} {}", size, units[unit]);
+}
+
+} // end namespace celestia::util
@@ -0,0 +1,67 @@
+// memoryreport.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Estimates of the memory taken by each subsystem.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace celestia::util
+{
+
+// Bytes allocated by a vector for its elements
+template<typename T, typename A>
+std::size_t vectorMemory(const std::vector<T, A>& v)
+{
+    return v.capacity() * sizeof(T);
+}
+
+// Bytes allocated by a string, which are none when it's short enough to be
+// stored in the object
+std::size_t stringMemory(const std::string& s);
+
+/*! MemoryReport collects the memory taken by the containers of each
+ *  subsystem, such as the stars or the loaded models, as estimated by the
+ *  containers from the sizes of their objects and arrays; allocator
+ *  overheads aren't included. The categories are kept in the order they
+ *  are first added.
+ */
+class MemoryReport
+{
+public:
+    struct Entry
+    {
+        std::string category;
+        std::size_t bytes{ 0 };
+        std::size_t objects{ 0 };
+    };
+
+    // Add bytes and objects to the category, created if needed
+    void add(std::string_view category, std::size_t bytes, std::size_t objects = 0);
+
+    const std::vector<Entry>& getEntries() const { return entries; }
+    // The entry of the category, or nullptr if nothing was added to it
+    const Entry* find(std::string_view category) const;
+    std::size_t getTotal() const;
+    // The entries from the largest
+    std::vector<Entry> getLargest(std::size_t count) const;
+
+private:
+    std::vector<Entry> entries;
+};
+
+// A size in bytes with the largest binary unit it's at least one of,
+// e.g. "12.3 MiB"
+std::string formatMemorySize(std::size_t bytes);
+
+} // end namespace celestia::util
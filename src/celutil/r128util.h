@@ -15,6 +15,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <string_view>
 
@@ -30,4 +31,77 @@ R128 DecodeFromBase64(std::string_view);
 // which represents the bounds of the simulated volume.
 bool isOutOfBounds(const R128 &);
 
+// Inline versions of the R128 operations most used on universal
+// coordinates, which otherwise are calls into r128.h. They give the same
+// results as r128Add(), r128Sub(), r128ToFloat() and r128FromFloat(),
+// using 128-bit integers where the compiler has them.
+
+inline R128 addFixed(const R128 &a, const R128 &b)
+{
+#ifdef __SIZEOF_INT128__
+    using U128 = unsigned __int128;
+    U128 r = ((static_cast<U128>(a.hi) << 64) | a.lo) + ((static_cast<U128>(b.hi) << 64) | b.lo);
+    return R128(static_cast<std::uint64_t>(r), static_cast<std::uint64_t>(r >> 64));
+#else
+    std::uint64_t lo = a.lo + b.lo;
+    return R128(lo, a.hi + b.hi + (lo < a.lo ? 1 : 0));
+#endif
+}
+
+inline R128 subtractFixed(const R128 &a, const R128 &b)
+{
+#ifdef __SIZEOF_INT128__
+    using U128 = unsigned __int128;
+    U128 r = ((static_cast<U128>(a.hi) << 64) | a.lo) - ((static_cast<U128>(b.hi) << 64) | b.lo);
+    return R128(static_cast<std::uint64_t>(r), static_cast<std::uint64_t>(r >> 64));
+#else
+    return R128(a.lo - b.lo, a.hi - b.hi - (a.lo < b.lo ? 1 : 0));
+#endif
+}
+
+inline double fixedToDouble(const R128 &v)
+{
+    // Convert the magnitude, as r128ToFloat() does, so that the rounding
+    // is the same for negative values
+    std::uint64_t lo = v.lo;
+    std::uint64_t hi = v.hi;
+    bool negative = static_cast<std::int64_t>(hi) < 0;
+    if (negative)
+    {
+        hi = ~hi + (lo == 0 ? 1 : 0);
+        lo = ~lo + 1;
+    }
+
+    double d = static_cast<double>(hi) + static_cast<double>(lo) * (1.0 / 18446744073709551616.0);
+    return negative ? -d : d;
+}
+
+inline R128 fixedFromDouble(double v)
+{
+    if (v < -9223372036854775808.0)
+        return R128_min;
+    if (v >= 9223372036854775808.0)
+        return R128_max;
+
+    bool negative = v < 0.0;
+    if (negative)
+        v = -v;
+
+    auto hi = static_cast<std::uint64_t>(static_cast<std::int64_t>(v));
+    v -= static_cast<double>(static_cast<std::int64_t>(v));
+    auto lo = static_cast<std::uint64_t>(v * 18446744073709551616.0);
+    if (negative)
+    {
+        hi = ~hi + (lo == 0 ? 1 : 0);
+        lo = ~lo + 1;
+    }
+    return R128(lo, hi);
+}
+
+// The difference a - b, computed at full precision and then rounded
+inline double fixedDifferenceToDouble(const R128 &a, const R128 &b)
+{
+    return fixedToDouble(subtractFixed(a, b));
+}
+
 } // end namespace celestia::util
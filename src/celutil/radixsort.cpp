@@ -0,0 +1,58 @@
+// radixsort.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Sorting of large records by compact keys.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "radixsort.h"
+
+#include <array>
+#include <cstddef>
+
+namespace celestia::util
+{
+
+void
+RadixSort(std::vector<SortKey>& keys, std::vector<SortKey>& scratch)
+{
+    constexpr unsigned int Digits = sizeof(std::uint32_t);
+
+    if (keys.size() < 2)
+        return;
+
+    // Count the digits of all passes at once
+    std::array<std::array<std::size_t, 256>, Digits> counts{};
+    for (const SortKey& k : keys)
+    {
+        for (unsigned int d = 0; d < Digits; d++)
+            ++counts[d][(k.key >> (d * 8)) & 0xff];
+    }
+
+    scratch.resize(keys.size());
+    for (unsigned int d = 0; d < Digits; d++)
+    {
+        auto& count = counts[d];
+        // All keys have the same digit, so this pass wouldn't move any
+        if (count[(keys.front().key >> (d * 8)) & 0xff] == keys.size())
+            continue;
+
+        std::size_t offset = 0;
+        for (std::size_t& c : count)
+        {
+            std::size_t n = c;
+            c = offset;
+            offset += n;
+        }
+
+        for (const SortKey& k : keys)
+            scratch[count[(k.key >> (d * 8)) & 0xff]++] = k;
+        keys.swap(scratch);
+    }
+}
+
+} // end namespace celestia::util
@@ -0,0 +1,76 @@
+// radixsort.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Sorting of large records by compact keys.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace celestia::util
+{
+
+// Key of a record to sort and the index of the record
+struct SortKey
+{
+    std::uint32_t key;
+    std::uint32_t index;
+};
+
+// An unsigned integer ordered as the float is, with -0 before +0
+inline std::uint32_t
+FloatSortKey(float f)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return (bits & 0x80000000u) != 0 ? ~bits : bits | 0x80000000u;
+}
+
+// Sort the keys in ascending order with a stable radix sort of 8-bit
+// digits, skipping the digits which are the same for all keys. scratch
+// is resized to the number of keys.
+void RadixSort(std::vector<SortKey>& keys, std::vector<SortKey>& scratch);
+
+// Sorts vectors of records by a key computed once per record, moving each
+// record once rather than for each swap. Equal keys keep their order. The
+// memory used is kept for the next sort.
+template<typename T>
+class KeySorter
+{
+public:
+    template<typename F>
+    void sort(std::vector<T>& records, F&& key)
+    {
+        if (records.size() < 2)
+            return;
+
+        keys.resize(records.size());
+        for (std::size_t i = 0; i < records.size(); i++)
+            keys[i] = { key(records[i]), static_cast<std::uint32_t>(i) };
+
+        RadixSort(keys, scratch);
+
+        sorted.clear();
+        sorted.reserve(records.size());
+        for (const SortKey& k : keys)
+            sorted.push_back(std::move(records[k.index]));
+        records.swap(sorted);
+    }
+
+private:
+    std::vector<SortKey> keys;
+    std::vector<SortKey> scratch;
+    std::vector<T> sorted;
+};
+
+} // end namespace celestia::util
@@ -9,8 +9,18 @@
 
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iterator>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -22,9 +32,20 @@ enum class ResourceState {
     NotLoaded     = 0,
     Loaded        = 1,
     LoadingFailed = 2,
+    Loading       = 3,
 };
 
 
+// Resources are normally loaded by find() when first requested. Managers of
+// a type T which can split loading in two may instead load in the
+// background, once enableAsyncLoading() has been called. T then provides
+//
+//     std::function<std::unique_ptr<ResourceType>()> decode(const ResourceKey&) const;
+//
+// which is called on a worker thread; it does the part of the loading which
+// doesn't need the calling thread, such as reading and decoding files, and
+// returns the rest of it, or an empty function if loading failed. That part
+// is run by finishLoading().
 template<class T> class ResourceManager
 {
  private:
@@ -32,7 +53,20 @@ template<class T> class ResourceManager
 
  public:
     explicit ResourceManager(const fs::path& _baseDir) : baseDir(_baseDir) {};
-    ~ResourceManager() = default;
+    ~ResourceManager()
+    {
+        if (async == nullptr)
+            return;
+
+        {
+            std::scoped_lock lock(async->mutex);
+            async->stopRequested = true;
+        }
+        async->requestReady.notify_all();
+
+        for (auto& worker : async->workers)
+            worker.join();
+    }
 
     ResourceManager(const ResourceManager&) = delete;
     ResourceManager& operator=(const ResourceManager&) = delete;
@@ -49,6 +83,8 @@ template<class T> class ResourceManager
         T info;
         ResourceState state{ ResourceState::NotLoaded };
         std::shared_ptr<ResourceType> resource{ nullptr };
+        // Value of usageClock when the resource was last found
+        unsigned int lastUsed{ 0 };
 
         explicit InfoType(T _info) : info(std::move(_info)) {}
         InfoType(const InfoType&) = delete;
@@ -68,31 +104,110 @@ template<class T> class ResourceManager
     using ResourceHandleMap = std::map<T, ResourceHandle>;
     using NameMap = std::map<KeyType, std::weak_ptr<ResourceType>>;
 
+    using FinishFunction = std::function<std::unique_ptr<ResourceType>()>;
+
+    struct LoadRequest
+    {
+        ResourceHandle handle;
+        T info;
+        float priority;
+
+        bool operator<(const LoadRequest& other) const { return priority < other.priority; }
+    };
+
+    struct LoadResult
+    {
+        ResourceHandle handle;
+        KeyType resolvedKey;
+        FinishFunction finish;
+    };
+
+    struct AsyncState
+    {
+        std::mutex mutex;
+        std::condition_variable requestReady;
+        std::priority_queue<LoadRequest> requests;
+        std::vector<LoadResult> decoded;
+        bool stopRequested{ false };
+        std::vector<std::thread> workers;
+
+        // Only accessed by the thread calling find()
+        std::deque<LoadResult> finishing;
+        bool forceSynchronous{ false };
+    };
+
     ResourceTable resources;
     ResourceHandleMap handles;
     NameMap loadedResources;
+    std::unique_ptr<AsyncState> async;
+    unsigned int usageClock{ 0 };
 
-    void loadResource(InfoType& info)
+    // Share the resource if another handle already loaded the same file
+    bool findLoadedResource(InfoType& info, const KeyType& resolvedKey)
     {
-        KeyType resolvedKey = info.resolve(baseDir);
         std::shared_ptr<ResourceType> resource = nullptr;
         if (auto iter = loadedResources.find(resolvedKey); iter != loadedResources.end())
             resource = iter->second.lock();
 
-        if (resource != nullptr)
+        if (resource == nullptr)
+            return false;
+
+        info.resource = std::move(resource);
+        info.state = ResourceState::Loaded;
+        return true;
+    }
+
+    void addLoadedResource(InfoType& info, KeyType&& resolvedKey)
+    {
+        if (info.resource == nullptr)
         {
-            info.resource = std::move(resource);
-            info.state = ResourceState::Loaded;
+            info.state = ResourceState::LoadingFailed;
+            return;
         }
-        else if (info.load(resolvedKey))
+
+        info.state = ResourceState::Loaded;
+        if (auto [iter, inserted] = loadedResources.try_emplace(std::move(resolvedKey), info.resource); !inserted)
+            iter->second = info.resource;
+    }
+
+    void loadResource(InfoType& info)
+    {
+        KeyType resolvedKey = info.resolve(baseDir);
+        if (findLoadedResource(info, resolvedKey))
+            return;
+
+        info.load(resolvedKey);
+        addLoadedResource(info, std::move(resolvedKey));
+    }
+
+    void queueResource(ResourceHandle h, float priority)
+    {
+        resources[h].state = ResourceState::Loading;
         {
-            info.state = ResourceState::Loaded;
-            if (auto [iter, inserted] = loadedResources.try_emplace(std::move(resolvedKey), info.resource); !inserted)
-                iter->second = info.resource;
+            std::scoped_lock lock(async->mutex);
+            async->requests.push(LoadRequest{ h, resources[h].info, priority });
         }
-        else
+        async->requestReady.notify_one();
+    }
+
+    void runWorker()
+    {
+        std::unique_lock lock(async->mutex);
+        for (;;)
         {
-            info.state = ResourceState::LoadingFailed;
+            async->requestReady.wait(lock, [this]() { return async->stopRequested || !async->requests.empty(); });
+            if (async->stopRequested)
+                return;
+
+            LoadRequest request = async->requests.top();
+            async->requests.pop();
+
+            lock.unlock();
+            KeyType resolvedKey = request.info.resolve(baseDir);
+            FinishFunction finish = request.info.decode(resolvedKey);
+            lock.lock();
+
+            async->decoded.push_back(LoadResult{ request.handle, std::move(resolvedKey), std::move(finish) });
         }
     }
 
@@ -111,20 +226,196 @@ template<class T> class ResourceManager
         }
     }
 
-    ResourceType* find(ResourceHandle h)
+    // With asynchronous loading, a resource which isn't loaded yet is
+    // queued and nullptr returned until finishLoading() has completed it.
+    // The requests with the highest priority are loaded first.
+    ResourceType* find(ResourceHandle h, float priority = 0.0f)
     {
         if (h < 0 || h >= static_cast<ResourceHandle>(handles.size()))
         {
             return nullptr;
         }
 
-        if (resources[h].state == ResourceState::NotLoaded)
+        InfoType& info = resources[h];
+        bool loadInBackground = async != nullptr && !async->forceSynchronous;
+        if (info.state == ResourceState::NotLoaded && loadInBackground)
+        {
+            queueResource(h, priority);
+        }
+        else if (info.state == ResourceState::NotLoaded ||
+                 (info.state == ResourceState::Loading && !loadInBackground))
+        {
+            // The result of the pending request is dropped
+            loadResource(info);
+        }
+
+        if (info.state != ResourceState::Loaded)
+            return nullptr;
+
+        info.lastUsed = usageClock;
+        return info.resource.get();
+    }
+
+    // The info the handle was created for, or nullptr for invalid handles
+    const T* getResourceInfo(ResourceHandle h) const
+    {
+        if (h < 0 || h >= static_cast<ResourceHandle>(handles.size()))
+            return nullptr;
+        return &resources[h].info;
+    }
+
+    ResourceState getState(ResourceHandle h) const
+    {
+        if (h < 0 || h >= static_cast<ResourceHandle>(handles.size()))
+            return ResourceState::LoadingFailed;
+        return resources[h].state;
+    }
+
+    // Load the resources requested from now on with nThreads worker threads
+    void enableAsyncLoading(unsigned int nThreads)
+    {
+        if (async != nullptr || nThreads == 0)
+            return;
+
+        async = std::make_unique<AsyncState>();
+        for (unsigned int i = 0; i < nThreads; ++i)
+            async->workers.emplace_back(&ResourceManager::runWorker, this);
+    }
+
+    bool isAsyncLoadingEnabled() const { return async != nullptr; }
+
+    // Whether any resource is still being loaded in the background
+    bool isLoading() const
+    {
+        return async != nullptr &&
+               std::any_of(resources.begin(), resources.end(),
+                           [](const InfoType& info) { return info.state == ResourceState::Loading; });
+    }
+
+    // Start a new period of use, usually a frame, for evict()
+    void advanceUsage() { ++usageClock; }
+
+    // The number of resources loaded and the memory they take, as given by
+    // sizeOf(resource); resources shared by several handles count once.
+    // Must be called from the thread calling find().
+    template<typename SizeFunction>
+    std::pair<std::size_t, std::size_t> getLoadedSize(SizeFunction sizeOf) const
+    {
+        std::size_t count = 0;
+        std::size_t size = 0;
+        for (const auto& [key, weakResource] : loadedResources)
+        {
+            if (auto resource = weakResource.lock(); resource != nullptr)
+            {
+                ++count;
+                size += static_cast<std::size_t>(sizeOf(*resource));
+            }
+        }
+        return { count, size };
+    }
+
+    // Unload resources which haven't been found in the last minIdle
+    // periods of use, until used, the memory taken by all resources, is
+    // within budget. The resources ranked highest go first, and the least
+    // recently used among those of the same rank. sizeOf(resource) gives
+    // the memory a resource takes, rank(info) its rank. Unloaded resources
+    // are loaded again when found. Returns the number of resources
+    // unloaded. Must be called from the thread calling find(), while none
+    // of the pointers it returned is in use.
+    template<typename SizeFunction, typename RankFunction>
+    std::size_t evict(std::size_t used, std::size_t budget, unsigned int minIdle,
+                      SizeFunction sizeOf, RankFunction rank)
+    {
+        if (used <= budget)
+            return 0;
+
+        std::vector<ResourceHandle> candidates;
+        for (std::size_t i = 0; i < resources.size(); ++i)
+        {
+            const InfoType& info = resources[i];
+            if (info.state == ResourceState::Loaded && info.resource != nullptr &&
+                usageClock - info.lastUsed >= minIdle)
+            {
+                candidates.push_back(static_cast<ResourceHandle>(i));
+            }
+        }
+
+        std::sort(candidates.begin(), candidates.end(),
+                  [this, &rank](ResourceHandle h0, ResourceHandle h1)
+                  {
+                      auto rank0 = rank(resources[h0].info);
+                      auto rank1 = rank(resources[h1].info);
+                      if (rank0 != rank1)
+                          return rank1 < rank0;
+                      return resources[h0].lastUsed < resources[h1].lastUsed;
+                  });
+
+        std::size_t nEvicted = 0;
+        for (ResourceHandle h : candidates)
         {
-            loadResource(resources[h]);
+            if (used <= budget)
+                break;
+
+            // A resource shared by several handles is only freed with the
+            // last of them
+            InfoType& info = resources[h];
+            if (info.resource.use_count() == 1)
+                used -= std::min(used, static_cast<std::size_t>(sizeOf(*info.resource)));
+
+            info.resource = nullptr;
+            info.state = ResourceState::NotLoaded;
+            ++nEvicted;
+        }
+
+        return nEvicted;
+    }
+
+    // Load in find() even with asynchronous loading enabled, for when
+    // every frame must be complete, as while recording a movie
+    void setForceSynchronous(bool force)
+    {
+        if (async != nullptr)
+            async->forceSynchronous = force;
+    }
+
+    // Complete the resources decoded in the background, until the time
+    // spent exceeds budget; at least one resource is completed if any is
+    // ready. Returns true if any resource was completed. Must be called
+    // from the thread calling find().
+    bool finishLoading(std::chrono::steady_clock::duration budget)
+    {
+        if (async == nullptr)
+            return false;
+
+        {
+            std::scoped_lock lock(async->mutex);
+            std::move(async->decoded.begin(), async->decoded.end(), std::back_inserter(async->finishing));
+            async->decoded.clear();
+        }
+
+        auto startTime = std::chrono::steady_clock::now();
+        bool finished = false;
+        while (!async->finishing.empty())
+        {
+            if (finished && std::chrono::steady_clock::now() - startTime > budget)
+                break;
+
+            LoadResult result = std::move(async->finishing.front());
+            async->finishing.pop_front();
+
+            // Skip resources loaded synchronously in the meantime
+            InfoType& info = resources[result.handle];
+            if (info.state != ResourceState::Loading)
+                continue;
+
+            if (!findLoadedResource(info, result.resolvedKey))
+            {
+                info.resource = result.finish ? result.finish() : nullptr;
+                addLoadedResource(info, std::move(result.resolvedKey));
+            }
+            finished = true;
         }
 
-        return resources[h].state == ResourceState::Loaded
-            ? resources[h].resource.get()
-            : nullptr;
+        return finished;
     }
 };
@@ -13,6 +13,7 @@
 #include <cmath>
 #include <cstring>
 #include <istream>
+#include <ostream>
 #include <string>
 #include <type_traits>
 #include <utility>
@@ -30,6 +31,44 @@ namespace
 {
 constexpr inline std::string_view UTF8_BOM = "\357\273\277"sv;
 
+constexpr inline std::string_view TOKEN_LIST_MAGIC = "CELTOKS\0"sv;
+constexpr std::uint32_t TOKEN_LIST_VERSION = 1;
+// Distinguishes the byte orders
+constexpr std::uint32_t TOKEN_LIST_BYTE_ORDER = 0x01020304;
+
+enum class StoredValue : std::uint8_t
+{
+    None    = 0,
+    Integer = 1,
+    Double  = 2,
+    Text    = 3,
+};
+
+struct StoredToken
+{
+    std::uint8_t type;
+    StoredValue kind;
+    std::uint16_t reserved;
+    std::int32_t lineNumber;
+    // Length of text values
+    std::uint32_t length;
+    std::uint32_t reserved2;
+    // Integer, bits of a double, or offset of a text value
+    std::uint64_t value;
+};
+
+struct TokenListHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint64_t tokenCount;
+    std::uint64_t textSize;
+};
+
+static_assert(sizeof(StoredToken) == 24);
+static_assert(sizeof(TokenListHeader) == 32);
+
 constexpr bool
 isWhitespace(char ch)
 {
@@ -157,6 +196,8 @@ public:
     using TokenValue = std::variant<std::monostate, std::int32_t, double, std::string_view, std::string>;
 
     TokenizerImpl(std::istream*, std::size_t);
+    explicit TokenizerImpl(std::string_view);
+    explicit TokenizerImpl(const TokenList&);
 
     Tokenizer::TokenType nextToken();
 
@@ -166,6 +207,9 @@ public:
 private:
     std::istream* in;
     std::vector<char> buffer;
+    // The characters being read: the buffer, or the text given to the
+    // tokenizer, which is then read in place.
+    const char* chars{ nullptr };
     std::size_t position{ 0 };
     std::size_t length{ 0 };
     TokenValue tokenValue{ std::in_place_type<std::monostate> };
@@ -174,6 +218,11 @@ private:
     bool isAtStart{ true };
     bool isEnded{ false };
 
+    const TokenList* replay{ nullptr };
+    std::size_t replayIndex{ 0 };
+
+    Tokenizer::TokenType nextReplayedToken();
+
     bool skipUTF8Bom();
 
     std::variant<char, Tokenizer::TokenType> skipWhitespace();
@@ -198,7 +247,24 @@ private:
 
 TokenizerImpl::TokenizerImpl(std::istream* _in, std::size_t _bufferSize)
     : in(_in),
-      buffer(_bufferSize)
+      buffer(_bufferSize),
+      chars(buffer.data())
+{}
+
+
+TokenizerImpl::TokenizerImpl(std::string_view text)
+    : in(nullptr),
+      chars(text.data()),
+      length(text.size()),
+      isEnded(true)
+{}
+
+
+TokenizerImpl::TokenizerImpl(const TokenList& tokens)
+    : in(nullptr),
+      isAtStart(false),
+      isEnded(true),
+      replay(&tokens)
 {}
 
 
@@ -206,6 +272,7 @@ Tokenizer::TokenType
 TokenizerImpl::nextToken()
 {
     tokenValue.emplace<std::monostate>();
+    if (replay != nullptr) { return nextReplayedToken(); }
 
     // skip UTF8 BOM
     if (isAtStart && !skipUTF8Bom()) { return Tokenizer::TokenError; }
@@ -227,15 +294,42 @@ TokenizerImpl::nextToken()
 }
 
 
+Tokenizer::TokenType
+TokenizerImpl::nextReplayedToken()
+{
+    const auto& tokens = replay->tokens;
+    if (replayIndex == tokens.size())
+    {
+        // The list ends with the input or with an error
+        return tokens.empty() || tokens.back().type != Tokenizer::TokenError
+            ? Tokenizer::TokenEnd
+            : Tokenizer::TokenError;
+    }
+
+    const TokenList::Token& token = tokens[replayIndex++];
+    lineNumber = token.lineNumber;
+    std::visit([this](const auto& value)
+    {
+        using T = std::decay_t<decltype(value)>;
+        if constexpr (std::is_same_v<T, std::pair<std::size_t, std::size_t>>)
+            tokenValue.emplace<std::string_view>(replay->text.data() + value.first, value.second);
+        else
+            tokenValue = value;
+    }, token.value);
+
+    return token.type;
+}
+
+
 std::variant<char, Tokenizer::TokenType>
 TokenizerImpl::skipWhitespace()
 {
     for (;;)
     {
         // skip whitespace
-        auto bufferEnd = buffer.cbegin() + length;
-        auto it = std::find_if_not(buffer.cbegin() + position, bufferEnd, isWhitespace);
-        position = it - buffer.cbegin();
+        auto bufferEnd = chars + length;
+        auto it = std::find_if_not(chars + position, bufferEnd, isWhitespace);
+        position = it - chars;
         if (it == bufferEnd)
         {
             if (isEnded) { return Tokenizer::TokenEnd; }
@@ -258,17 +352,18 @@ TokenizerImpl::skipWhitespace()
         // skip comments
         for (;;)
         {
-            it = std::find(buffer.cbegin() + position, bufferEnd, '\n');
-            position = it - buffer.cbegin();
-            if (it != bufferEnd)
+            const void* eol = position < length
+                            ? std::memchr(chars + position, '\n', length - position)
+                            : nullptr;
+            if (eol != nullptr)
             {
-                ++position;
+                position = static_cast<std::size_t>(static_cast<const char*>(eol) - chars) + 1;
                 break;
             }
 
+            position = length;
             if (isEnded) { return Tokenizer::TokenEnd; }
             if (!fillBuffer()) { return Tokenizer::TokenError; }
-            bufferEnd = buffer.cbegin() + length;
         }
     }
 }
@@ -333,9 +428,9 @@ TokenizerImpl::readToken(char ch)
 bool
 TokenizerImpl::skipUTF8Bom()
 {
-    if (!fillBuffer()) { return false; }
+    if (in != nullptr && !fillBuffer()) { return false; }
     isAtStart = false;
-    if (length >= UTF8_BOM.size() && std::string_view(buffer.data(), UTF8_BOM.size()) == UTF8_BOM)
+    if (length >= UTF8_BOM.size() && std::string_view(chars, UTF8_BOM.size()) == UTF8_BOM)
     {
         position += UTF8_BOM.size();
     }
@@ -350,9 +445,9 @@ TokenizerImpl::readName()
     std::size_t endPosition = position + 1;
     do
     {
-        auto bufferEnd = buffer.cbegin() + length;
-        auto it = std::find_if_not(buffer.cbegin() + endPosition, bufferEnd, isName);
-        endPosition = it - buffer.cbegin();
+        auto bufferEnd = chars + length;
+        auto it = std::find_if_not(chars + endPosition, bufferEnd, isName);
+        endPosition = it - chars;
         if (it != bufferEnd || isEnded) { break; }
 
         if (!fillBuffer(&endPosition))
@@ -362,7 +457,7 @@ TokenizerImpl::readName()
         }
     } while (endPosition < length);
 
-    tokenValue.emplace<std::string_view>(buffer.data() + position, endPosition - position);
+    tokenValue.emplace<std::string_view>(chars + position, endPosition - position);
     position = endPosition;
 
     return true;
@@ -380,9 +475,9 @@ TokenizerImpl::readNumber()
 
     while (state.part != NumberPart::End)
     {
-        auto bufferEnd = buffer.cbegin() + length;
-        auto it = std::find_if_not(buffer.cbegin() + state.endPosition, bufferEnd, isAsciiDigit);
-        state.endPosition = it - buffer.cbegin();
+        auto bufferEnd = chars + length;
+        auto it = std::find_if_not(chars + state.endPosition, bufferEnd, isAsciiDigit);
+        state.endPosition = it - chars;
         if (it == bufferEnd)
         {
             if (isEnded)
@@ -427,7 +522,7 @@ TokenizerImpl::createNumberState()
 {
     NumberState state;
     state.endPosition = position + 1;
-    if (buffer[position] == '.')
+    if (chars[position] == '.')
     {
         // decimal point must be followed by a digit
         if (auto check = peekAt(state.endPosition); !isAsciiDigit(check.value_or('\0')))
@@ -439,7 +534,7 @@ TokenizerImpl::createNumberState()
         state.isInteger = false;
         state.part = NumberPart::Fraction;
     }
-    else if (isSign(buffer[position]))
+    else if (isSign(chars[position]))
     {
         // sign must be followed by either a decimal point or a digit
         if (auto check = peekAt(state.endPosition); check == '.')
@@ -521,10 +616,10 @@ TokenizerImpl::setNumber(const NumberState& numberState)
 {
     using celestia::compat::from_chars;
 
-    const char* startPtr = buffer.data() + position;
+    const char* startPtr = chars + position;
     if (*startPtr == '+') { ++startPtr; }
 
-    const char* endPtr = buffer.data() + numberState.endPosition;
+    const char* endPtr = chars + numberState.endPosition;
     position = numberState.endPosition;
 
     // detect negative zero in order to roundtrip CMOD correctly
@@ -571,7 +666,7 @@ TokenizerImpl::readString()
             return false;
         }
 
-        std::string_view run(buffer.data() + position + state.runStart,
+        std::string_view run(chars + position + state.runStart,
                              state.runEnd - state.runStart);
 
         if (!state.checkUTF8(ch, run)) { continue; }
@@ -579,7 +674,7 @@ TokenizerImpl::readString()
         if (!parseChar(state, ch, run)) { return false;}
     }
 
-    const char* startPtr = buffer.data() + position;
+    const char* startPtr = chars + position;
     position += state.runEnd + 1;
 
     if (state.runStart == 1)
@@ -664,8 +759,8 @@ TokenizerImpl::parseEscape(StringState& state, char ch)
                 return false;
             }
 
-            const char* uStart = buffer.data() + position + state.runEnd + 2;
-            const char* uEnd = buffer.data() + position + state.runEnd + 6;
+            const char* uStart = chars + position + state.runEnd + 2;
+            const char* uEnd = chars + position + state.runEnd + 6;
 
             std::uint32_t uch;
             if (auto [ptr, ec] = celestia::compat::from_chars(uStart, uEnd, uch, 16);
@@ -677,7 +772,7 @@ TokenizerImpl::parseEscape(StringState& state, char ch)
             }
             else
             {
-                position = ptr - buffer.data();
+                position = ptr - chars;
                 return false;
             }
         }
@@ -733,9 +828,9 @@ TokenizerImpl::fillBuffer(std::size_t* alterOffset)
 std::optional<char>
 TokenizerImpl::peekAt(std::size_t& offset)
 {
-    if (offset < length) { return buffer[offset]; }
+    if (offset < length) { return chars[offset]; }
     if (isEnded || !fillBuffer(&offset) || offset >= length) { return std::nullopt; }
-    return buffer[offset];
+    return chars[offset];
 }
 
 
@@ -744,6 +839,16 @@ Tokenizer::Tokenizer(std::istream* _in, std::size_t buffer_size)
 {}
 
 
+Tokenizer::Tokenizer(std::string_view text)
+    : impl(std::make_unique<TokenizerImpl>(text))
+{}
+
+
+Tokenizer::Tokenizer(const TokenList& tokens)
+    : impl(std::make_unique<TokenizerImpl>(tokens))
+{}
+
+
 Tokenizer::~Tokenizer() = default;
 
 
@@ -813,3 +918,172 @@ Tokenizer::getLineNumber() const
 }
 
 
+TokenList::TokenList(Tokenizer& tokenizer)
+{
+    for (;;)
+    {
+        Tokenizer::TokenType type = tokenizer.nextToken();
+        if (type == Tokenizer::TokenEnd) { break; }
+
+        Token& token = tokens.emplace_back();
+        token.type = type;
+        token.lineNumber = tokenizer.getLineNumber();
+
+        switch (type)
+        {
+        case Tokenizer::TokenNumber:
+            if (auto i = tokenizer.getIntegerValue(); i.has_value())
+                token.value = *i;
+            else
+                token.value = *tokenizer.getNumberValue();
+            break;
+
+        case Tokenizer::TokenName:
+        case Tokenizer::TokenString:
+            {
+                std::string_view sv = type == Tokenizer::TokenName
+                    ? *tokenizer.getNameValue()
+                    : *tokenizer.getStringValue();
+                token.value = std::make_pair(text.size(), sv.size());
+                text.append(sv);
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        if (type == Tokenizer::TokenError) { break; }
+    }
+}
+
+
+bool
+TokenList::write(std::ostream& out) const
+{
+    TokenListHeader header;
+    std::memcpy(header.magic, TOKEN_LIST_MAGIC.data(), sizeof(header.magic));
+    header.version = TOKEN_LIST_VERSION;
+    header.byteOrder = TOKEN_LIST_BYTE_ORDER;
+    header.tokenCount = tokens.size();
+    header.textSize = text.size();
+
+    std::vector<StoredToken> stored(tokens.size());
+    for (std::size_t i = 0; i < tokens.size(); ++i)
+    {
+        const Token& token = tokens[i];
+        StoredToken& st = stored[i];
+        st.type = static_cast<std::uint8_t>(token.type);
+        st.reserved = 0;
+        st.lineNumber = token.lineNumber;
+        st.length = 0;
+        st.reserved2 = 0;
+        st.value = 0;
+        std::visit([&st](const auto& value)
+        {
+            using T = std::decay_t<decltype(value)>;
+            if constexpr (std::is_same_v<T, std::monostate>)
+            {
+                st.kind = StoredValue::None;
+            }
+            else if constexpr (std::is_same_v<T, std::int32_t>)
+            {
+                st.kind = StoredValue::Integer;
+                st.value = static_cast<std::uint64_t>(static_cast<std::int64_t>(value));
+            }
+            else if constexpr (std::is_same_v<T, double>)
+            {
+                st.kind = StoredValue::Double;
+                std::memcpy(&st.value, &value, sizeof(st.value));
+            }
+            else
+            {
+                st.kind = StoredValue::Text;
+                st.value = value.first;
+                st.length = static_cast<std::uint32_t>(value.second);
+            }
+        }, token.value);
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(stored.data()),
+              static_cast<std::streamsize>(stored.size() * sizeof(StoredToken)));
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+    return out.good();
+}
+
+
+bool
+TokenList::isTokenList(std::string_view data)
+{
+    return data.substr(0, TOKEN_LIST_MAGIC.size()) == TOKEN_LIST_MAGIC;
+}
+
+
+bool
+TokenList::read(std::string_view data)
+{
+    tokens.clear();
+    text.clear();
+
+    TokenListHeader header;
+    if (data.size() < sizeof(header)) { return false; }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::string_view(header.magic, sizeof(header.magic)) != TOKEN_LIST_MAGIC ||
+        header.version != TOKEN_LIST_VERSION ||
+        header.byteOrder != TOKEN_LIST_BYTE_ORDER)
+    {
+        return false;
+    }
+
+    std::size_t available = data.size() - sizeof(header);
+    if (header.tokenCount > available / sizeof(StoredToken) ||
+        header.textSize != available - header.tokenCount * sizeof(StoredToken))
+    {
+        return false;
+    }
+
+    const char* ptr = data.data() + sizeof(header);
+    tokens.resize(static_cast<std::size_t>(header.tokenCount));
+    for (Token& token : tokens)
+    {
+        StoredToken st;
+        std::memcpy(&st, ptr, sizeof(st));
+        ptr += sizeof(st);
+
+        if (st.type > Tokenizer::TokenEndUnits ||
+            (st.kind == StoredValue::Text && (st.value > header.textSize || st.length > header.textSize - st.value)))
+        {
+            tokens.clear();
+            return false;
+        }
+
+        token.type = static_cast<Tokenizer::TokenType>(st.type);
+        token.lineNumber = st.lineNumber;
+        switch (st.kind)
+        {
+        case StoredValue::None:
+            token.value.emplace<std::monostate>();
+            break;
+        case StoredValue::Integer:
+            token.value = static_cast<std::int32_t>(static_cast<std::int64_t>(st.value));
+            break;
+        case StoredValue::Double:
+            {
+                double d;
+                std::memcpy(&d, &st.value, sizeof(d));
+                token.value = d;
+            }
+            break;
+        case StoredValue::Text:
+            token.value = std::make_pair(static_cast<std::size_t>(st.value), static_cast<std::size_t>(st.length));
+            break;
+        default:
+            tokens.clear();
+            return false;
+        }
+    }
+
+    text.assign(ptr, static_cast<std::size_t>(header.textSize));
+    return true;
+}
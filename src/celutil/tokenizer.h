@@ -15,9 +15,14 @@
 #include <iosfwd>
 #include <memory>
 #include <optional>
+#include <string>
 #include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
 
 
+class TokenList;
 class TokenizerImpl;
 
 class Tokenizer
@@ -45,6 +50,12 @@ public:
     static constexpr std::size_t DEFAULT_BUFFER_SIZE = 4096;
 
     Tokenizer(std::istream*, std::size_t = DEFAULT_BUFFER_SIZE);
+    // Read the text in place, e.g. from a memory mapped file; the text must
+    // outlive the tokenizer, and the names and strings it returns are views
+    // of the text when they need no unescaping.
+    explicit Tokenizer(std::string_view);
+    // Replay tokens read earlier; the list must outlive the tokenizer
+    explicit Tokenizer(const TokenList&);
     ~Tokenizer();
 
     TokenType nextToken();
@@ -62,3 +73,42 @@ private:
     TokenType tokenType{ TokenType::TokenBegin };
     bool isPushedBack{ false };
 };
+
+
+/*! The tokens of a whole input, read ahead of time so that the costly
+ *  lexing can be done on another thread than the one using the tokens.
+ *  Reading stops at the end of the input or at the first error, which a
+ *  tokenizer replaying the list then keeps returning.
+ */
+class TokenList
+{
+public:
+    TokenList() = default;
+    explicit TokenList(Tokenizer&);
+
+    bool empty() const { return tokens.empty(); }
+
+    // Store the tokens in a binary form for caching; it's in native byte
+    // order, so it's only meant to be read on the same machine.
+    bool write(std::ostream&) const;
+    // Replace the tokens with those stored by write(); returns false and
+    // leaves the list empty if the data is invalid.
+    bool read(std::string_view);
+    // Return true if the data begins like the output of write(), as do the
+    // catalogs compiled by compilecatalogs.
+    static bool isTokenList(std::string_view);
+
+private:
+    struct Token
+    {
+        Tokenizer::TokenType type;
+        int lineNumber;
+        // Names and strings are stored as offset and length in text
+        std::variant<std::monostate, std::int32_t, double, std::pair<std::size_t, std::size_t>> value;
+    };
+
+    std::vector<Token> tokens;
+    std::string text;
+
+    friend class TokenizerImpl;
+};
@@ -544,6 +544,41 @@ int UTF8StringCompare(std::string_view s0, std::string_view s1, size_t n, bool i
         return 0;
 }
 
+bool UTF8FoldCase(std::string_view s, std::string& dest)
+{
+    int len = s.length();
+    int i = 0;
+    while (i < len)
+    {
+        wchar_t ch = 0;
+        if (!UTF8Decode(s, i, ch))
+            return false;
+
+        i += UTF8EncodedSize(ch);
+        ch = static_cast<wchar_t>(std::towlower(UTF8Normalize(ch)));
+        UTF8Encode(static_cast<std::uint32_t>(ch), dest);
+    }
+
+    return true;
+}
+
+bool UTF8NormalizeString(std::string_view s, std::string& dest)
+{
+    int len = s.length();
+    int i = 0;
+    while (i < len)
+    {
+        wchar_t ch = 0;
+        if (!UTF8Decode(s, i, ch))
+            return false;
+
+        i += UTF8EncodedSize(ch);
+        UTF8Encode(static_cast<std::uint32_t>(UTF8Normalize(ch)), dest);
+    }
+
+    return true;
+}
+
 UTF8Status
 UTF8Validator::check(unsigned char c)
 {
@@ -23,6 +23,17 @@ void UTF8Encode(std::uint32_t ch, std::string &dest);
 int  UTF8StringCompare(std::string_view s0, std::string_view s1);
 int  UTF8StringCompare(std::string_view s0, std::string_view s1, size_t n, bool ignoreCase = false);
 
+// Append s to dest with the characters normalized and lower cased as in
+// UTF8StringCompare with ignoreCase, so that byte-wise comparisons of the
+// results agree with it. Stops at the first invalid sequence and returns
+// false if there is one.
+bool UTF8FoldCase(std::string_view s, std::string& dest);
+
+// Append s to dest with the characters normalized as in UTF8StringCompare,
+// so that two strings comparing equal have the same normalized form.
+// Stops at the first invalid sequence and returns false if there is one.
+bool UTF8NormalizeString(std::string_view s, std::string& dest);
+
 class UTF8StringOrderingPredicate
 {
  public:
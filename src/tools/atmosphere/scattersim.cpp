@@ -14,7 +14,13 @@
 #include <cstdlib>
 #include <cmath>
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <map>
+#include <thread>
+#include <vector>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -58,6 +64,9 @@ enum LUTUsageType
 static LUTUsageType LUTUsage = NoLUT;
 static bool UseFisheyeCameras = false;
 static double CameraExposure = 0.0;
+// Zero means one worker thread per hardware thread
+static unsigned int WorkerThreadCount = 0;
+static string LUTFileName;
 
 
 typedef map<string, double> ParameterSet;
@@ -306,8 +315,8 @@ public:
 
     double sunAngularDiameter;
 
-    LUT2* extinctionLUT;
-    LUT3* scatteringLUT;
+    LUT2* extinctionLUT{ nullptr };
+    LUT3* scatteringLUT{ nullptr };
 };
 
 
@@ -374,6 +383,7 @@ void usage()
 {
     cerr << "Usage: scattersim [options] <config file>\n";
     cerr << "   --lut (or -l)              : accelerate calculation by using a lookup table\n";
+    cerr << "   --LUT (or -L)              : also use a lookup table for scattering\n";
     cerr << "   --fisheye (or -f)          : use wide angle cameras on surface\n";
     cerr << "   --exposure <value> (or -e) : set exposure for HDR\n";
     cerr << "   --width <value> (or -w)    : set width of output image\n";
@@ -384,6 +394,10 @@ void usage()
     cerr << "           set the number of integration steps for depth\n";
     cerr << "   --scattersteps <value> (or -s)\n";
     cerr << "           set the number of integration steps for scattering\n";
+    cerr << "   --threads <value> (or -t)  : set the number of threads building the lookup tables\n";
+    cerr << "           (default is one per hardware thread)\n";
+    cerr << "   --lutfile <filename> (or -o)\n";
+    cerr << "           write the lookup tables built with -l or -L to a binary file\n";
 }
 
 
@@ -534,6 +548,91 @@ void DumpLUT(const LUT2& lut, const string& filename)
 }
 
 
+/* Binary lookup table file, all values little endian:
+ *   char[8]  magic "CELSCLUT"
+ *   uint32   version (1)
+ *   uint32   table count
+ * then for every table:
+ *   uint32   channel count, width, height, depth
+ *   float32  values, channels of a texel adjacent, x varying fastest
+ * Table 0 holds the extinction, table 1 (if present) the scattering factors.
+ */
+constexpr const char LUTFileMagic[8] = { 'C', 'E', 'L', 'S', 'C', 'L', 'U', 'T' };
+constexpr const uint32_t LUTFileVersion = 1;
+
+static void writeLE32(ostream& out, uint32_t v)
+{
+    char bytes[4] = { (char) (v & 0xff), (char) ((v >> 8) & 0xff),
+                      (char) ((v >> 16) & 0xff), (char) ((v >> 24) & 0xff) };
+    out.write(bytes, sizeof(bytes));
+}
+
+
+static void writeLE32(ostream& out, float f)
+{
+    uint32_t v;
+    memcpy(&v, &f, sizeof(v));
+    writeLE32(out, v);
+}
+
+
+bool WriteLUTFile(const string& filename, const LUT2& extinction, const LUT3* scattering)
+{
+    ofstream out(filename, ios::binary);
+    if (!out.good())
+    {
+        cerr << "Error opening LUT file " << filename << endl;
+        return false;
+    }
+
+    out.write(LUTFileMagic, sizeof(LUTFileMagic));
+    writeLE32(out, LUTFileVersion);
+    writeLE32(out, (uint32_t) (scattering != nullptr ? 2 : 1));
+
+    writeLE32(out, (uint32_t) 3);
+    writeLE32(out, (uint32_t) extinction.getWidth());
+    writeLE32(out, (uint32_t) extinction.getHeight());
+    writeLE32(out, (uint32_t) 1);
+    for (unsigned int y = 0; y < extinction.getHeight(); y++)
+    {
+        for (unsigned int x = 0; x < extinction.getWidth(); x++)
+        {
+            Vector3d v = extinction.getValue(x, y);
+            for (int c = 0; c < 3; c++)
+                writeLE32(out, (float) v[c]);
+        }
+    }
+
+    if (scattering != nullptr)
+    {
+        writeLE32(out, (uint32_t) 4);
+        writeLE32(out, (uint32_t) scattering->getWidth());
+        writeLE32(out, (uint32_t) scattering->getHeight());
+        writeLE32(out, (uint32_t) scattering->getDepth());
+        for (unsigned int z = 0; z < scattering->getDepth(); z++)
+        {
+            for (unsigned int y = 0; y < scattering->getHeight(); y++)
+            {
+                for (unsigned int x = 0; x < scattering->getWidth(); x++)
+                {
+                    Vector4d v = scattering->getValue(x, y, z);
+                    for (int c = 0; c < 4; c++)
+                        writeLE32(out, (float) v[c]);
+                }
+            }
+        }
+    }
+
+    if (!out.good())
+    {
+        cerr << "Error writing LUT file " << filename << endl;
+        return false;
+    }
+
+    return true;
+}
+
+
 
 template<class T> T lerp(double t, const T& v0, const T& v1)
 {
@@ -821,6 +920,14 @@ double phaseSchlick(double cosTheta, double k)
 /*** Pure ray marching integration functions; no use of lookup tables ***/
 
 
+// Sample points of the optical depth integral are processed in fixed size
+// blocks: the heights of a whole block are computed at once from the
+// closed form of the distance along the ray, rather than by stepping the
+// sample point, before the densities of all three particle populations
+// are accumulated in a single pass over them.
+constexpr const unsigned int DensityBlockSize = 8;
+using DensityBlock = Array<double, DensityBlockSize, 1>;
+
 OpticalDepths integrateOpticalDepth(const Scene& scene,
                                     const Vector3d& atmStart,
                                     const Vector3d& atmEnd)
@@ -839,22 +946,34 @@ OpticalDepths integrateOpticalDepth(const Scene& scene,
         return depth;
 
     dir = dir * (1.0 / length);
-    Vector3d samplePoint = atmStart + (0.5 * stepDist * dir);
 
-    for (unsigned int i = 0; i < nSteps; i++)
+    // The distance of a sample point at t along the ray from the planet
+    // center is sqrt(|start|^2 + 2t start.dir + t^2)
+    double startDistSquared = atmStart.squaredNorm();
+    double startDotDir2 = 2.0 * atmStart.dot(dir);
+    const Atmosphere& atm = scene.atmosphere;
+
+    for (unsigned int first = 0; first < nSteps; first += DensityBlockSize)
     {
-        double h = samplePoint.norm() - scene.planet.radius;
+        unsigned int count = min(DensityBlockSize, nSteps - first);
+        DensityBlock t = DensityBlock::LinSpaced(first + 0.5, first + DensityBlockSize - 0.5) * stepDist;
+        DensityBlock h = (startDistSquared + t * (startDotDir2 + t)).max(0.0).sqrt() - scene.planet.radius;
 
         // Optical depth due to two phenomena:
         //   Outscattering by Rayleigh and Mie scattering particles
         //   Absorption by absorbing particles
-        depth.rayleigh   += scene.atmosphere.rayleighDensity(h) * stepDist;
-        depth.mie        += scene.atmosphere.mieDensity(h)      * stepDist;
-        depth.absorption += scene.atmosphere.absorbDensity(h)   * stepDist;
-
-        samplePoint += stepDist * dir;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            depth.rayleigh   += exp(min(1.0, -h[i] / atm.rayleighScaleHeight));
+            depth.mie        += exp(min(1.0, -h[i] / atm.mieScaleHeight));
+            depth.absorption += exp(min(1.0, -h[i] / atm.absorbScaleHeight));
+        }
     }
 
+    depth.rayleigh   *= stepDist;
+    depth.mie        *= stepDist;
+    depth.absorption *= stepDist;
+
     return depth;
 }
 
@@ -1028,6 +1147,33 @@ double unpackSNorm(double un)
 }
 
 
+// Call body for every index in [0, count) on a pool of worker threads. The
+// indexes are handed out one at a time, as the cost of a lookup table row
+// varies with the height.
+void parallelFor(unsigned int count, const function<void(unsigned int)>& body)
+{
+    unsigned int nThreads = WorkerThreadCount;
+    if (nThreads == 0)
+        nThreads = max(1u, thread::hardware_concurrency());
+    nThreads = min(nThreads, count);
+
+    atomic<unsigned int> next{ 0 };
+    auto worker = [&]()
+    {
+        for (unsigned int i = next++; i < count; i = next++)
+            body(i);
+    };
+
+    vector<thread> threads;
+    for (unsigned int i = 1; i < nThreads; i++)
+        threads.emplace_back(worker);
+    worker();
+
+    for (thread& t : threads)
+        t.join();
+}
+
+
 LUT2*
 buildExtinctionLUT(const Scene& scene)
 {
@@ -1037,7 +1183,7 @@ buildExtinctionLUT(const Scene& scene)
     //Sphered planet = Sphered(scene.planet.radius);
     Sphered shell = Sphered(scene.planet.radius + scene.atmosphereShellHeight);
 
-    for (unsigned int i = 0; i < ExtinctionLUTHeightSteps; i++)
+    parallelFor(ExtinctionLUTHeightSteps, [&](unsigned int i)
     {
         double h = (double) i / (double) (ExtinctionLUTHeightSteps - 1) *
             scene.atmosphereShellHeight * 0.9999;
@@ -1064,7 +1210,7 @@ buildExtinctionLUT(const Scene& scene)
 
             lut->setValue(i, j, ext.cwiseMax(1.0e-18));
         }
-    }
+    });
 
     return lut;
 }
@@ -1097,7 +1243,7 @@ buildOpticalDepthLUT(const Scene& scene)
     //Sphered planet = Sphered(scene.planet.radius);
     Sphered shell = Sphered(scene.planet.radius + scene.atmosphereShellHeight);
 
-    for (unsigned int i = 0; i < ExtinctionLUTHeightSteps; i++)
+    parallelFor(ExtinctionLUTHeightSteps, [&](unsigned int i)
     {
         double h = (double) i / (double) (ExtinctionLUTHeightSteps - 1) *
             scene.atmosphereShellHeight;
@@ -1123,7 +1269,7 @@ buildOpticalDepthLUT(const Scene& scene)
 
             lut->setValue(i, j, Vector3d(depth.rayleigh, depth.mie, depth.absorption));
         }
-    }
+    });
 
     return lut;
 }
@@ -1314,7 +1460,7 @@ buildScatteringLUT(const Scene& scene)
 
     Sphered shell = Sphered(scene.planet.radius + scene.atmosphereShellHeight);
 
-    for (unsigned int i = 0; i < ScatteringLUTHeightSteps; i++)
+    parallelFor(ScatteringLUTHeightSteps, [&](unsigned int i)
     {
         double h = (double) i / (double) (ScatteringLUTHeightSteps - 1) *
             scene.atmosphereShellHeight * 0.9999;
@@ -1355,7 +1501,7 @@ buildScatteringLUT(const Scene& scene)
                 lut->setValue(i, j, k, inscatter);
             }
         }
-    }
+    });
 
     return lut;
 }
@@ -1881,6 +2027,23 @@ bool parseCommandLine(int argc, char* argv[])
                     return false;
                 i++;
             }
+            else if (!strcmp(argv[i], "-t") || !strcmp(argv[i], "--threads"))
+            {
+                if (i == argc - 1)
+                    return false;
+
+                if (sscanf(argv[i + 1], " %u", &WorkerThreadCount) != 1)
+                    return false;
+                i++;
+            }
+            else if (!strcmp(argv[i], "-o") || !strcmp(argv[i], "--lutfile"))
+            {
+                if (i == argc - 1)
+                    return false;
+
+                LUTFileName = string(argv[i + 1]);
+                i++;
+            }
             else if (!strcmp(argv[i], "-i") || !strcmp(argv[i], "--image"))
             {
                 if (i == argc - 1)
@@ -1973,6 +2136,18 @@ int main(int argc, char* argv[])
         DumpLUT(*scene.scatteringLUT, "lut.png");
     }
 
+    if (!LUTFileName.empty())
+    {
+        if (scene.extinctionLUT == nullptr)
+        {
+            cerr << "No lookup tables to write; use --lut or --LUT\n";
+            exit(1);
+        }
+
+        if (!WriteLUTFile(LUTFileName, *scene.extinctionLUT, scene.scatteringLUT))
+            exit(1);
+    }
+
     double planetRadius = scene.planet.radius;
     double cameraFarDist = planetRadius * 3;
     double cameraCloseDist = planetRadius * 1.2;
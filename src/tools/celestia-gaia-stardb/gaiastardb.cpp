@@ -0,0 +1,845 @@
+// gaiastardb.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Build a sorted star database from the Gaia DR3 gaia_source partitions.
+// The partitions are read on several threads, straight from the gzipped
+// CSV/ECSV files, and the stars passing the parallax quality cut are
+// sorted in bounded runs written to temporary files, which are merged to
+// the star database.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celengine/astro.h>
+#include <celengine/stardb.h>
+#include <celengine/stellarclass.h>
+#include <celutil/binarywrite.h>
+
+using namespace std;
+
+
+namespace
+{
+
+constexpr uint32_t TYC3_MULTIPLIER = 1000000000u;
+constexpr uint32_t TYC2_MULTIPLIER = 10000u;
+
+// Catalog numbers given to the stars without a Hipparcos or Tycho
+// identifier, in the order of their Gaia source ids. They lie between the
+// largest HIP number and the smallest TYC number.
+constexpr uint32_t FirstGaiaIndex = 1000000u;
+constexpr uint32_t LastGaiaIndex = TYC3_MULTIPLIER - 1u;
+
+// Sort keys of the stars without a catalog number are their source id
+// offset past all the catalog numbers, so they follow the cross-matched
+// stars in the merged runs.
+constexpr uint64_t GaiaKeyOffset = UINT64_C(1) << 32;
+
+struct Options
+{
+    string hipFile;
+    string tycFile;
+    string tempDir;
+    double minParallaxOverError{ 5.0 };
+    double magnitudeLimit{ 99.0 };
+    unsigned int threads{ max(1u, thread::hardware_concurrency()) };
+    size_t memoryBudget{ size_t(1024) << 20 };
+    vector<string> inputFiles;
+    string outputFile;
+};
+
+struct StarEntry
+{
+    uint64_t key;
+    float x;
+    float y;
+    float z;
+    int16_t absMag;
+    uint16_t spectralType;
+};
+
+using SourceIndex = unordered_map<uint64_t, uint32_t>;
+
+
+void Usage()
+{
+    cerr << "Usage: celestia-gaia-stardb [options] <gaia_source file>... <output star database>\n";
+    cerr << "  Options:\n";
+    cerr << "    --hip <file>        : Gaia to Hipparcos 2 best neighbour table\n";
+    cerr << "    --tyc <file>        : Gaia to Tycho 2 best neighbour table\n";
+    cerr << "    --poe <ratio>       : minimum parallax over error (default 5)\n";
+    cerr << "    --mag <magnitude>   : faintest apparent magnitude included\n";
+    cerr << "    --threads <count>   : number of threads reading the partitions\n";
+    cerr << "    --memory <MiB>      : memory used for sorting (default 1024)\n";
+    cerr << "    --tmpdir <dir>      : directory of the temporary files\n";
+    cerr << "  Input files may be gzipped.\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[], Options& options)
+{
+    vector<string> files;
+    for (int i = 1; i < argc; i++)
+    {
+        string_view arg = argv[i];
+        if (arg.empty() || arg[0] != '-')
+        {
+            files.emplace_back(arg);
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            cerr << "Missing value for " << arg << '\n';
+            return false;
+        }
+
+        const char* value = argv[++i];
+        if (arg == "--hip")
+            options.hipFile = value;
+        else if (arg == "--tyc")
+            options.tycFile = value;
+        else if (arg == "--tmpdir")
+            options.tempDir = value;
+        else if (arg == "--poe")
+            options.minParallaxOverError = atof(value);
+        else if (arg == "--mag")
+            options.magnitudeLimit = atof(value);
+        else if (arg == "--threads")
+            options.threads = max(1, atoi(value));
+        else if (arg == "--memory")
+            options.memoryBudget = size_t(max(16, atoi(value))) << 20;
+        else
+        {
+            cerr << "Unknown command line switch: " << arg << '\n';
+            return false;
+        }
+    }
+
+    if (files.size() < 2)
+        return false;
+
+    options.outputFile = files.back();
+    files.pop_back();
+    options.inputFiles = std::move(files);
+    return true;
+}
+
+
+// Reads the lines of a text file, decompressing it with gzip if needed.
+class LineReader
+{
+public:
+    explicit LineReader(const string& filename)
+    {
+        if (filename.size() > 3 && filename.compare(filename.size() - 3, 3, ".gz") == 0)
+        {
+            string command = "gzip -dc '" + filename + "'";
+            file = popen(command.c_str(), "r");
+            piped = true;
+        }
+        else
+        {
+            file = fopen(filename.c_str(), "r");
+        }
+    }
+
+    ~LineReader()
+    {
+        free(line);
+        if (file == nullptr)
+            return;
+        if (piped)
+            pclose(file);
+        else
+            fclose(file);
+    }
+
+    LineReader(const LineReader&) = delete;
+    LineReader& operator=(const LineReader&) = delete;
+
+    bool good() const { return file != nullptr; }
+
+    // The next line without its line ending, modifiable in place; nullptr
+    // at the end of the file
+    char* next()
+    {
+        ssize_t length = getline(&line, &capacity, file);
+        if (length < 0)
+            return nullptr;
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+            line[--length] = '\0';
+        return line;
+    }
+
+private:
+    FILE* file{ nullptr };
+    bool piped{ false };
+    char* line{ nullptr };
+    size_t capacity{ 0 };
+};
+
+
+// Split a CSV line in place at the commas outside quotes
+void splitFields(char* line, vector<char*>& fields)
+{
+    fields.clear();
+    fields.push_back(line);
+    bool quoted = false;
+    for (char* p = line; *p != '\0'; ++p)
+    {
+        if (*p == '"')
+        {
+            quoted = !quoted;
+        }
+        else if (*p == ',' && !quoted)
+        {
+            *p = '\0';
+            fields.push_back(p + 1);
+        }
+    }
+}
+
+
+// Read the header line of a CSV or ECSV file, skipping the ECSV metadata
+// lines, and find the columns with the names given
+bool findColumns(LineReader& reader, const vector<string_view>& names, vector<int>& columns)
+{
+    char* line;
+    while ((line = reader.next()) != nullptr && line[0] == '#')
+        ;
+    if (line == nullptr)
+        return false;
+
+    vector<char*> fields;
+    splitFields(line, fields);
+    columns.assign(names.size(), -1);
+    for (size_t i = 0; i < fields.size(); i++)
+    {
+        auto it = find(names.begin(), names.end(), string_view(fields[i]));
+        if (it != names.end())
+            columns[it - names.begin()] = static_cast<int>(i);
+    }
+    return true;
+}
+
+
+bool parseDouble(const char* field, double& value)
+{
+    char* end;
+    value = strtod(field, &end);
+    return end != field && isfinite(value);
+}
+
+
+bool parseSourceId(const char* field, uint64_t& value)
+{
+    char* end;
+    value = strtoull(field, &end, 10);
+    return end != field;
+}
+
+
+// Parse a Tycho identifier TYC1-TYC2-TYC3, with or without the TYC prefix
+bool parseTycho(const char* field, uint32_t& catalogNumber)
+{
+    while (*field != '\0' && (*field < '0' || *field > '9'))
+        ++field;
+
+    unsigned int tyc1, tyc2, tyc3;
+    if (sscanf(field, "%u-%u-%u", &tyc1, &tyc2, &tyc3) != 3 ||
+        tyc1 < 1 || tyc1 > 9999 || tyc2 < 1 || tyc2 > 99999 || tyc3 < 1 || tyc3 > 4)
+    {
+        return false;
+    }
+
+    catalogNumber = tyc3 * TYC3_MULTIPLIER + tyc2 * TYC2_MULTIPLIER + tyc1;
+    return true;
+}
+
+
+// Load a best neighbour table from the Gaia archive, mapping source id to
+// the identifier of the external catalog
+bool loadCrossIndex(const string& filename, bool tycho, SourceIndex& index)
+{
+    LineReader reader(filename);
+    vector<int> columns;
+    if (!reader.good() || !findColumns(reader, { "source_id", "original_ext_source_id" }, columns) ||
+        columns[0] < 0 || columns[1] < 0)
+    {
+        cerr << "Error reading cross index " << filename << '\n';
+        return false;
+    }
+
+    size_t minFields = static_cast<size_t>(max(columns[0], columns[1])) + 1;
+    vector<char*> fields;
+    while (char* line = reader.next())
+    {
+        splitFields(line, fields);
+        if (fields.size() < minFields)
+            continue;
+
+        uint64_t sourceId;
+        if (!parseSourceId(fields[columns[0]], sourceId))
+            continue;
+
+        const char* ext = fields[columns[1]];
+        if (*ext == '"')
+            ++ext;
+
+        uint32_t catalogNumber;
+        if (tycho)
+        {
+            if (!parseTycho(ext, catalogNumber))
+                continue;
+        }
+        else
+        {
+            char* end;
+            unsigned long hip = strtoul(ext, &end, 10);
+            if (end == ext || hip == 0 || hip >= FirstGaiaIndex)
+                continue;
+            catalogNumber = static_cast<uint32_t>(hip);
+        }
+
+        // The Hipparcos identifier is preferred over the Tycho one
+        index.try_emplace(sourceId, catalogNumber);
+    }
+
+    return true;
+}
+
+
+// Approximate spectral type from the BP-RP color or the effective
+// temperature, after the mean dwarf sequence of Pecaut & Mamajek (2013).
+// Types are numbered in tenths of a class from O0.
+struct SpectralPoint
+{
+    float value;
+    float type;
+};
+
+constexpr SpectralPoint ColorSequence[] =
+{
+    { -0.40f,  5.0f }, // O5
+    { -0.33f, 10.0f }, // B0
+    { -0.12f, 15.0f }, // B5
+    {  0.00f, 20.0f }, // A0
+    {  0.19f, 25.0f }, // A5
+    {  0.37f, 30.0f }, // F0
+    {  0.59f, 35.0f }, // F5
+    {  0.76f, 40.0f }, // G0
+    {  0.85f, 45.0f }, // G5
+    {  0.98f, 50.0f }, // K0
+    {  1.43f, 55.0f }, // K5
+    {  1.84f, 60.0f }, // M0
+    {  2.55f, 63.0f }, // M3
+    {  3.33f, 65.0f }, // M5
+    {  4.50f, 69.0f }, // M9
+};
+
+constexpr SpectralPoint TemperatureSequence[] =
+{
+    { 41400.0f,  5.0f },
+    { 31400.0f, 10.0f },
+    { 15700.0f, 15.0f },
+    {  9700.0f, 20.0f },
+    {  8080.0f, 25.0f },
+    {  7220.0f, 30.0f },
+    {  6510.0f, 35.0f },
+    {  5920.0f, 40.0f },
+    {  5660.0f, 45.0f },
+    {  5280.0f, 50.0f },
+    {  4450.0f, 55.0f },
+    {  3850.0f, 60.0f },
+    {  3410.0f, 63.0f },
+    {  3060.0f, 65.0f },
+    {  2400.0f, 69.0f },
+};
+
+template<size_t N>
+float interpolateType(const SpectralPoint (&sequence)[N], float value, bool decreasing)
+{
+    auto before = [decreasing](float a, float b) { return decreasing ? a > b : a < b; };
+    if (!before(sequence[0].value, value))
+        return sequence[0].type;
+    for (size_t i = 1; i < N; i++)
+    {
+        if (!before(sequence[i].value, value))
+        {
+            float t = (value - sequence[i - 1].value) / (sequence[i].value - sequence[i - 1].value);
+            return sequence[i - 1].type + t * (sequence[i].type - sequence[i - 1].type);
+        }
+    }
+    return sequence[N - 1].type;
+}
+
+StellarClass spectralClass(double color, double temperature, float absMag)
+{
+    float type;
+    if (isfinite(color))
+        type = interpolateType(ColorSequence, static_cast<float>(color), false);
+    else if (isfinite(temperature))
+        type = interpolateType(TemperatureSequence, static_cast<float>(temperature), true);
+    else
+        return StellarClass(StellarClass::NormalStar, StellarClass::Spectral_Unknown,
+                            StellarClass::Subclass_Unknown, StellarClass::Lum_Unknown);
+
+    // Stars far below the main sequence are white dwarfs
+    if (absMag > 10.0f && type < 50.0f)
+        return StellarClass(StellarClass::WhiteDwarf, StellarClass::Spectral_DA,
+                            StellarClass::Subclass_Unknown, StellarClass::Lum_Unknown);
+
+    auto step = static_cast<unsigned int>(clamp(lround(type), 0L, 69L));
+    auto spectral = static_cast<StellarClass::SpectralClass>(StellarClass::Spectral_O + step / 10);
+
+    // Cool stars much brighter than the main sequence are giants
+    StellarClass::LuminosityClass lum = StellarClass::Lum_V;
+    if (type >= 40.0f && absMag < 2.0f)
+        lum = absMag < -3.0f ? StellarClass::Lum_Ib : StellarClass::Lum_III;
+
+    return StellarClass(StellarClass::NormalStar, spectral, step % 10, lum);
+}
+
+
+enum GaiaColumn
+{
+    SourceId,
+    RA,
+    Dec,
+    Parallax,
+    ParallaxOverError,
+    GMag,
+    BpRp,
+    Teff,
+    ColumnCount,
+};
+
+const vector<string_view> GaiaColumnNames =
+{
+    "source_id",
+    "ra",
+    "dec",
+    "parallax",
+    "parallax_over_error",
+    "phot_g_mean_mag",
+    "bp_rp",
+    "teff_gspphot",
+};
+
+
+// Collects the stars read on a thread, writing them out in sorted runs
+// whenever its buffer is full
+class RunWriter
+{
+public:
+    RunWriter(const fs::path& _tempDir, size_t _capacity, atomic<unsigned int>& _runCounter) :
+        tempDir(_tempDir), capacity(_capacity), runCounter(_runCounter)
+    {
+        entries.reserve(capacity);
+    }
+
+    bool add(const StarEntry& entry)
+    {
+        entries.push_back(entry);
+        return entries.size() < capacity || flush();
+    }
+
+    bool flush()
+    {
+        if (entries.empty())
+            return true;
+
+        sort(entries.begin(), entries.end(),
+             [](const StarEntry& a, const StarEntry& b) { return a.key < b.key; });
+
+        fs::path path = tempDir / ("gaia-run-" + to_string(runCounter++) + ".tmp");
+        ofstream out(path, ios::out | ios::binary);
+        out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(StarEntry));
+        if (!out.good())
+        {
+            cerr << "Error writing temporary file " << path << '\n';
+            return false;
+        }
+
+        {
+            lock_guard<mutex> lock(runsMutex);
+            runs.push_back(std::move(path));
+        }
+        entries.clear();
+        return true;
+    }
+
+    static vector<fs::path> runs;
+    static mutex runsMutex;
+
+private:
+    fs::path tempDir;
+    size_t capacity;
+    atomic<unsigned int>& runCounter;
+    vector<StarEntry> entries;
+};
+
+vector<fs::path> RunWriter::runs;
+mutex RunWriter::runsMutex;
+
+
+struct ReadStats
+{
+    atomic<uint64_t> read{ 0 };
+    atomic<uint64_t> accepted{ 0 };
+    atomic<uint64_t> matched{ 0 };
+};
+
+
+bool readPartition(const string& filename,
+                   const Options& options,
+                   const SourceIndex& crossIndex,
+                   RunWriter& runs,
+                   ReadStats& stats)
+{
+    LineReader reader(filename);
+    vector<int> columns;
+    if (!reader.good() || !findColumns(reader, GaiaColumnNames, columns))
+    {
+        cerr << "Error reading " << filename << '\n';
+        return false;
+    }
+
+    for (int i = 0; i < ColumnCount; i++)
+    {
+        // The color and temperature are optional
+        if (columns[i] < 0 && i != BpRp && i != Teff && i != ParallaxOverError)
+        {
+            cerr << "Missing column " << GaiaColumnNames[i] << " in " << filename << '\n';
+            return false;
+        }
+    }
+
+    auto field = [&columns](const vector<char*>& fields, int column, double& value)
+    {
+        int i = columns[column];
+        return i >= 0 && static_cast<size_t>(i) < fields.size() && parseDouble(fields[i], value);
+    };
+
+    vector<char*> fields;
+    uint64_t nRead = 0;
+    uint64_t nAccepted = 0;
+    uint64_t nMatched = 0;
+    while (char* line = reader.next())
+    {
+        splitFields(line, fields);
+        nRead++;
+
+        uint64_t sourceId;
+        double ra, dec, parallax, gMag;
+        if (static_cast<size_t>(columns[SourceId]) >= fields.size() ||
+            !parseSourceId(fields[columns[SourceId]], sourceId) ||
+            !field(fields, RA, ra) || !field(fields, Dec, dec) ||
+            !field(fields, Parallax, parallax) || !field(fields, GMag, gMag) ||
+            parallax <= 0.0 || gMag > options.magnitudeLimit)
+        {
+            continue;
+        }
+
+        double poe;
+        if (!field(fields, ParallaxOverError, poe))
+            poe = 0.0;
+        if (poe < options.minParallaxOverError)
+            continue;
+
+        double color = NAN;
+        double temperature = NAN;
+        field(fields, BpRp, color);
+        field(fields, Teff, temperature);
+
+        // G to Johnson V after Riello et al. (2021)
+        double vMag = gMag;
+        if (isfinite(color))
+            vMag -= -0.02704 + color * (0.01424 + color * (-0.2156 + color * 0.01426));
+
+        double distance = 1000.0 / parallax * LY_PER_PARSEC<double>;
+        auto absMag = static_cast<float>(astro::appToAbsMag<double>(vMag, distance));
+        Eigen::Vector3d position = astro::equatorialToCelestialCart(ra * 24.0 / 360.0, dec, distance);
+
+        StarEntry entry;
+        if (auto it = crossIndex.find(sourceId); it != crossIndex.end())
+        {
+            entry.key = it->second;
+            nMatched++;
+        }
+        else
+        {
+            entry.key = GaiaKeyOffset + sourceId;
+        }
+        entry.x = static_cast<float>(position.x());
+        entry.y = static_cast<float>(position.y());
+        entry.z = static_cast<float>(position.z());
+        entry.absMag = static_cast<int16_t>(lround(clamp(absMag, -127.0f, 127.0f) * 256.0f));
+        entry.spectralType = spectralClass(color, temperature, absMag).packV1();
+
+        if (!runs.add(entry))
+            return false;
+        nAccepted++;
+    }
+
+    stats.read += nRead;
+    stats.accepted += nAccepted;
+    stats.matched += nMatched;
+    return true;
+}
+
+
+// Reads the entries of a sorted run in blocks
+class RunReader
+{
+public:
+    explicit RunReader(const fs::path& path, size_t _blockSize) :
+        in(path, ios::in | ios::binary), blockSize(_blockSize)
+    {
+        block.reserve(blockSize);
+    }
+
+    bool next(StarEntry& entry)
+    {
+        if (position == block.size())
+        {
+            block.resize(blockSize);
+            in.read(reinterpret_cast<char*>(block.data()), blockSize * sizeof(StarEntry));
+            block.resize(static_cast<size_t>(in.gcount()) / sizeof(StarEntry));
+            position = 0;
+            if (block.empty())
+                return false;
+        }
+        entry = block[position++];
+        return true;
+    }
+
+private:
+    ifstream in;
+    size_t blockSize;
+    vector<StarEntry> block;
+    size_t position{ 0 };
+};
+
+
+void writeRecord(ostream& out, uint32_t catalogNumber, const StarEntry& entry)
+{
+    celestia::util::writeLE<uint32_t>(out, catalogNumber);
+    celestia::util::writeLE<float>(out, entry.x);
+    celestia::util::writeLE<float>(out, entry.y);
+    celestia::util::writeLE<float>(out, entry.z);
+    celestia::util::writeLE<int16_t>(out, entry.absMag);
+    celestia::util::writeLE<uint16_t>(out, entry.spectralType);
+}
+
+
+// Merge the sorted runs to an unsorted binary star database. Several
+// Gaia sources may match a single Hipparcos or Tycho star, in which case
+// the brightest is kept.
+bool mergeRuns(const vector<fs::path>& runs, const Options& options, ostream& out, uint32_t& nStars)
+{
+    size_t blockSize = max(size_t(1024), options.memoryBudget / (2 * sizeof(StarEntry) * max(size_t(1), runs.size())));
+    vector<unique_ptr<RunReader>> readers;
+    using QueueItem = pair<StarEntry, size_t>;
+    auto later = [](const QueueItem& a, const QueueItem& b) { return a.first.key > b.first.key; };
+    priority_queue<QueueItem, vector<QueueItem>, decltype(later)> queue(later);
+
+    for (const fs::path& run : runs)
+    {
+        readers.push_back(make_unique<RunReader>(run, blockSize));
+        StarEntry entry;
+        if (readers.back()->next(entry))
+            queue.emplace(entry, readers.size() - 1);
+    }
+
+    out.write("CELSTARS", 8);
+    celestia::util::writeLE<uint16_t>(out, 0x0100);
+    celestia::util::writeLE<uint32_t>(out, 0);
+
+    nStars = 0;
+    uint32_t nextGaiaIndex = FirstGaiaIndex;
+    bool havePending = false;
+    StarEntry pending;
+    auto emit = [&]()
+    {
+        uint32_t catalogNumber;
+        if (pending.key < GaiaKeyOffset)
+            catalogNumber = static_cast<uint32_t>(pending.key);
+        else if (nextGaiaIndex <= LastGaiaIndex)
+            catalogNumber = nextGaiaIndex++;
+        else
+            return;
+        writeRecord(out, catalogNumber, pending);
+        nStars++;
+    };
+
+    while (!queue.empty())
+    {
+        auto [entry, run] = queue.top();
+        queue.pop();
+
+        if (havePending && entry.key == pending.key)
+        {
+            if (entry.absMag < pending.absMag)
+                pending = entry;
+        }
+        else
+        {
+            if (havePending)
+                emit();
+            pending = entry;
+            havePending = true;
+        }
+
+        StarEntry next;
+        if (readers[run]->next(next))
+            queue.emplace(next, run);
+    }
+    if (havePending)
+        emit();
+
+    if (nextGaiaIndex > LastGaiaIndex)
+        cerr << "Warning: out of catalog numbers, some stars were dropped\n";
+
+    out.seekp(10);
+    celestia::util::writeLE<uint32_t>(out, nStars);
+    return out.good();
+}
+
+
+void removeFiles(const vector<fs::path>& paths)
+{
+    std::error_code ec;
+    for (const fs::path& path : paths)
+        fs::remove(path, ec);
+}
+
+} // end unnamed namespace
+
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseCommandLine(argc, argv, options))
+    {
+        Usage();
+        return 1;
+    }
+
+    fs::path tempDir = options.tempDir;
+    if (tempDir.empty())
+    {
+        tempDir = fs::path(options.outputFile).parent_path();
+        if (tempDir.empty())
+            tempDir = ".";
+    }
+
+    SourceIndex crossIndex;
+    if ((!options.hipFile.empty() && !loadCrossIndex(options.hipFile, false, crossIndex)) ||
+        (!options.tycFile.empty() && !loadCrossIndex(options.tycFile, true, crossIndex)))
+    {
+        return 1;
+    }
+
+    // Each thread sorts its share of the memory budget at a time
+    unsigned int nThreads = min(options.threads, static_cast<unsigned int>(options.inputFiles.size()));
+    size_t runCapacity = max(size_t(1024), options.memoryBudget / (sizeof(StarEntry) * nThreads));
+
+    ReadStats stats;
+    atomic<size_t> nextFile{ 0 };
+    atomic<unsigned int> runCounter{ 0 };
+    atomic<bool> failed{ false };
+    auto worker = [&]()
+    {
+        RunWriter writer(tempDir, runCapacity, runCounter);
+        for (;;)
+        {
+            size_t i = nextFile.fetch_add(1);
+            if (i >= options.inputFiles.size() || failed)
+                break;
+            if (!readPartition(options.inputFiles[i], options, crossIndex, writer, stats))
+                failed = true;
+        }
+        if (!writer.flush())
+            failed = true;
+    };
+
+    vector<thread> workers;
+    for (unsigned int i = 0; i < nThreads; i++)
+        workers.emplace_back(worker);
+    for (thread& t : workers)
+        t.join();
+
+    if (failed)
+    {
+        removeFiles(RunWriter::runs);
+        return 1;
+    }
+
+    cerr << stats.accepted << " of " << stats.read << " sources accepted, "
+         << stats.matched << " matched to Hipparcos or Tycho\n";
+
+    fs::path unsortedPath = tempDir / "gaia-stars.tmp";
+    uint32_t nStars = 0;
+    {
+        ofstream unsorted(unsortedPath, ios::out | ios::binary);
+        bool merged = unsorted.good() && mergeRuns(RunWriter::runs, options, unsorted, nStars);
+        removeFiles(RunWriter::runs);
+        if (!merged)
+        {
+            cerr << "Error writing temporary file " << unsortedPath << '\n';
+            removeFiles({ unsortedPath });
+            return 1;
+        }
+    }
+
+    // The octree is built in memory, like Celestia does when it loads an
+    // unsorted database
+    StarDatabase starDB;
+    {
+        ifstream in(unsortedPath, ios::in | ios::binary);
+        bool loaded = starDB.loadBinary(in);
+        in.close();
+        removeFiles({ unsortedPath });
+        if (!loaded)
+        {
+            cerr << "Error reading temporary file " << unsortedPath << '\n';
+            return 1;
+        }
+    }
+    starDB.finish();
+
+    ofstream out(options.outputFile, ios::out | ios::binary);
+    if (!out.good() || !starDB.writeSortedBinary(out))
+    {
+        cerr << "Error writing star database " << options.outputFile << '\n';
+        return 1;
+    }
+
+    cerr << nStars << " stars written to " << options.outputFile << '\n';
+    return 0;
+}
@@ -20,6 +20,9 @@
 
 #include <celmath/mathlib.h>
 #include <celmodel/mesh.h>
+#include <celmodel/meshoptimize.h>
+#include <celmodel/meshquantize.h>
+#include <celmodel/meshsimplify.h>
 #include <celmodel/model.h>
 #include <celmodel/modelfile.h>
 
@@ -36,6 +39,9 @@ bool genTangents = false;
 bool weldVertices = false;
 bool mergeMeshes = false;
 bool stripify = false;
+bool reorder = false;
+bool quantize = false;
+float simplifyRatio = 1.0f;
 unsigned int vertexCacheSize = 16;
 float smoothAngle = 60.0f;
 
@@ -51,6 +57,9 @@ void usage()
     std::cerr << "   --smooth (or -s) <angle> : smoothing angle for normal generation\n";
     std::cerr << "   --weld (or -w)        : join identical vertices before normal generation\n";
     std::cerr << "   --merge (or -m)       : merge submeshes to improve rendering performance\n";
+    std::cerr << "   --reorder (or -r)     : reorder triangles and vertices for the vertex cache and overdraw\n";
+    std::cerr << "   --quantize (or -q)    : store vertex attributes in compact formats\n";
+    std::cerr << "   --simplify (or -l) <ratio> : reduce the triangle count to ratio for a lower level of detail\n";
 #ifdef TRISTRIP
     std::cerr << "   --optimize (or -o)    : optimize by converting triangle lists to strips\n";
 #endif
@@ -98,6 +107,25 @@ bool parseCommandLine(int argc, char* argv[])
             {
                 stripify = true;
             }
+            else if (!std::strcmp(argv[i], "-r") || !std::strcmp(argv[i], "--reorder"))
+            {
+                reorder = true;
+            }
+            else if (!std::strcmp(argv[i], "-q") || !std::strcmp(argv[i], "--quantize"))
+            {
+                quantize = true;
+            }
+            else if (!std::strcmp(argv[i], "-l") || !std::strcmp(argv[i], "--simplify"))
+            {
+                if (i == argc - 1)
+                    return false;
+                if (std::sscanf(argv[i + 1], " %f", &simplifyRatio) != 1 ||
+                    simplifyRatio <= 0.0f || simplifyRatio > 1.0f)
+                {
+                    return false;
+                }
+                i++;
+            }
             else if (!std::strcmp(argv[i], "-s") || !std::strcmp(argv[i], "--smooth"))
             {
                 if (i == argc - 1)
@@ -235,6 +263,27 @@ int main(int argc, char* argv[])
         }
     }
 
+    if (simplifyRatio < 1.0f)
+    {
+        float error = 0.0f;
+        model = cmod::SimplifyModel(*model, simplifyRatio, error);
+        std::cerr << "Simplified with an error of " << error << "\n";
+    }
+
+    if (quantize)
+    {
+        for (std::uint32_t i = 0; model->getMesh(i) != nullptr; i++)
+        {
+            QuantizeColors(*model->getMesh(i));
+            cmod::QuantizeMesh(*model->getMesh(i));
+        }
+    }
+
+    if (reorder)
+    {
+        cmod::OptimizeModel(*model);
+    }
+
 #ifdef TRISTRIP
     if (stripify)
     {
@@ -40,6 +40,7 @@
 #include <celmath/mathlib.h>
 #include <celmodel/material.h>
 #include <celmodel/mesh.h>
+#include <celmodel/meshquantize.h>
 #include <celmodel/model.h>
 #include <celmodel/modelfile.h>
 
@@ -266,6 +267,11 @@ MainWindow::setModel(const QString& fileName, std::unique_ptr<cmod::Model>&& mod
 {
     QFileInfo info(fileName);
     QString modelDir = info.absoluteDir().path();
+
+    // The viewer and the editing operations only handle float attributes
+    for (std::uint32_t i = 0; model->getMesh(i) != nullptr; ++i)
+        cmod::DequantizeMesh(*model->getMesh(i));
+
     m_modelView->setModel(std::move(model), modelDir);
 
     // Only reset the camera when we've loaded a new model. Leaving
@@ -14,12 +14,16 @@
 #include <cassert>
 #include <cmath>
 #include <cstring>
+#include <functional>
 #include <iostream>
 #include <iterator>
 #include <numeric>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include <celmodel/meshoptimize.h>
 #include <celmodel/model.h>
 
 #include "cmodops.h"
@@ -27,23 +31,6 @@
 
 namespace
 {
-struct Vertex
-{
-    Vertex() :
-        index(0),
-        attributes(nullptr)
-    {};
-
-    Vertex(std::uint32_t _index, const cmod::VWord* _attributes) :
-        index(_index),
-        attributes(_attributes)
-    {};
-
-    std::uint32_t index;
-    const cmod::VWord* attributes;
-};
-
-
 struct Face
 {
     Eigen::Vector3f normal;
@@ -52,86 +39,33 @@ struct Face
 };
 
 
-struct VertexComparator
+// Call func(begin, end) for ranges covering [0, count), on several threads
+// when there's enough work
+template<typename F> void
+parallelFor(std::uint32_t count, F&& func)
 {
-    virtual bool compare(const Vertex& a, const Vertex& b) const = 0;
-    virtual ~VertexComparator() = default;
-
-    bool operator()(const Vertex& a, const Vertex& b) const
-    {
-        return compare(a, b);
-    }
-};
-
-
-class FullComparator : public VertexComparator
-{
-public:
-    FullComparator(int _vertexSize) :
-        vertexSize(_vertexSize)
-    {
-    }
-
-    bool compare(const Vertex& a, const Vertex& b) const override
-    {
-        return std::lexicographical_compare(a.attributes, a.attributes + vertexSize,
-                                            b.attributes, b.attributes + vertexSize);
-    }
-
-private:
-    int vertexSize;
-};
-
-
-class PointOrderingPredicate : public VertexComparator
-{
-public:
-    bool compare(const Vertex& a, const Vertex& b) const override
-    {
-        std::array<float, 3> p0;
-        std::memcpy(p0.data(), a.attributes, sizeof(float) * 3);
-
-        std::array<float, 3> p1;
-        std::memcpy(p1.data(), b.attributes, sizeof(float) * 3);
-
-        return p0 < p1;
-    }
-
-private:
-    int ignore;
-};
-
-
-class PointTexCoordOrderingPredicate : public VertexComparator
-{
-public:
-    PointTexCoordOrderingPredicate(std::uint32_t _posOffset,
-                                   std::uint32_t _texCoordOffset,
-                                   bool _wrap) :
-        posOffset(_posOffset),
-        texCoordOffset(_texCoordOffset),
-        wrap(_wrap)
+    constexpr std::uint32_t MinRangeSize = 4096;
+    unsigned int nThreads = std::max(1u, std::thread::hardware_concurrency());
+    nThreads = std::min(nThreads, std::max(1u, count / MinRangeSize));
+    if (nThreads == 1)
     {
+        func(0u, count);
+        return;
     }
 
-    bool compare(const Vertex& a, const Vertex& b) const override
+    std::uint32_t rangeSize = (count + nThreads - 1) / nThreads;
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < nThreads; t++)
     {
-        std::array<float, 5> ptc0;
-        std::memcpy(ptc0.data(), a.attributes + posOffset, sizeof(float) * 3);
-        std::memcpy(ptc0.data() + 3, a.attributes + texCoordOffset, sizeof(float) * 2);
-
-        std::array<float, 5> ptc1;
-        std::memcpy(ptc1.data(), b.attributes + posOffset, sizeof(float) * 3);
-        std::memcpy(ptc1.data() + 3, b.attributes + texCoordOffset, sizeof(float) * 2);
-
-        return ptc0 < ptc1;
+        std::uint32_t begin = std::min(count, t * rangeSize);
+        std::uint32_t end = std::min(count, begin + rangeSize);
+        threads.emplace_back([&func, begin, end] { func(begin, end); });
     }
+    func(0u, std::min(count, rangeSize));
 
-private:
-    std::uint32_t posOffset;
-    std::uint32_t texCoordOffset;
-    bool wrap;
-};
+    for (auto& thread : threads)
+        thread.join();
+}
 
 
 bool approxEqual(float x, float y, float prec)
@@ -140,88 +74,6 @@ bool approxEqual(float x, float y, float prec)
 }
 
 
-class PointEquivalencePredicate : public VertexComparator
-{
-public:
-    PointEquivalencePredicate(std::uint32_t _posOffset,
-                              float _tolerance) :
-        posOffset(_posOffset),
-        tolerance(_tolerance)
-    {
-    }
-
-    bool compare(const Vertex& a, const Vertex& b) const override
-    {
-        std::array<float, 3> p0;
-        std::memcpy(p0.data(), a.attributes + posOffset, sizeof(float) * 3);
-
-        std::array<float, 3> p1;
-        std::memcpy(p1.data(), b.attributes + posOffset, sizeof(float) * 3);
-
-        return std::equal(p0.cbegin(), p0.cend(), p1.cbegin(),
-                          [&](float f0, float f1) { return approxEqual(f0, f1, tolerance); });
-    }
-
-private:
-    std::uint32_t posOffset;
-    float tolerance;
-};
-
-
-class PointTexCoordEquivalencePredicate : public VertexComparator
-{
-public:
-    PointTexCoordEquivalencePredicate(std::uint32_t _posOffset,
-                                      std::uint32_t _texCoordOffset,
-                                      bool _wrap,
-                                      float _tolerance) :
-        posOffset(_posOffset),
-        texCoordOffset(_texCoordOffset),
-        wrap(_wrap),
-        tolerance(_tolerance)
-    {
-    }
-
-    bool compare(const Vertex& a, const Vertex& b) const override
-    {
-        std::array<float, 5> ptc0;
-        std::memcpy(ptc0.data(), a.attributes + posOffset, sizeof(float) * 3);
-        std::memcpy(ptc0.data() + 3, a.attributes + texCoordOffset, sizeof(float) * 2);
-
-        std::array<float, 5> ptc1;
-        std::memcpy(ptc1.data(), b.attributes + posOffset, sizeof(float) * 3);
-        std::memcpy(ptc1.data() + 3, b.attributes + texCoordOffset, sizeof(float) * 2);
-
-        return std::equal(ptc0.cbegin(), ptc0.cend(), ptc1.cbegin(),
-                          [&](float f0, float f1) { return approxEqual(f0, f1, tolerance); });
-    }
-
-private:
-    std::uint32_t posOffset;
-    std::uint32_t texCoordOffset;
-    bool wrap;
-    float tolerance;
-};
-
-
-bool equal(const Vertex& a, const Vertex& b, std::uint32_t vertexSize)
-{
-    return std::equal(a.attributes, a.attributes + vertexSize, b.attributes);
-}
-
-
-bool equalPoint(const Vertex& a, const Vertex& b)
-{
-    std::array<float, 3> p0;
-    std::memcpy(p0.data(), a.attributes, sizeof(float) * 3);
-
-    std::array<float, 3> p1;
-    std::memcpy(p1.data(), b.attributes, sizeof(float) * 3);
-
-    return p0 == p1;
-}
-
-
 Eigen::Vector3f
 getVertex(const cmod::VWord* vertexData,
           int positionOffset,
@@ -249,7 +101,7 @@ getTexCoord(const cmod::VWord* vertexData,
 Eigen::Vector3f
 averageFaceVectors(const std::vector<Face>& faces,
                    std::uint32_t thisFace,
-                   std::uint32_t* vertexFaces,
+                   const std::uint32_t* vertexFaces,
                    std::uint32_t vertexFaceCount,
                    float cosSmoothingAngle)
 {
@@ -329,7 +181,9 @@ augmentVertexDescription(cmod::VertexDescription& desc,
         stride += cmod::VertexAttribute::getFormatSizeWords(format);
     }
 
-    desc.strideBytes = stride * sizeof(cmod::VWord);
+    // Rebuild the description so that getAttribute() sees the new layout
+    desc = cmod::VertexDescription(std::move(desc.attributes));
+    assert(desc.strideBytes == stride * sizeof(cmod::VWord));
 }
 
 
@@ -351,65 +205,196 @@ addGroupWithOffset(cmod::Mesh& mesh,
 }
 
 
-template<typename T, typename U> void
-joinVertices(std::vector<Face>& faces,
+struct CellKey
+{
+    std::array<std::int64_t, 3> cell;
+
+    bool operator==(const CellKey& other) const { return cell == other.cell; }
+};
+
+
+struct CellKeyHash
+{
+    std::size_t operator()(const CellKey& key) const
+    {
+        std::size_t h = 0;
+        for (std::int64_t c : key.cell)
+            h = h * 0x9e3779b97f4a7c15ull + std::hash<std::int64_t>()(c);
+        return h;
+    }
+};
+
+
+// Set the point indices of the faces, joining the vertices whose positions,
+// and texture coordinates if texCoordOffset isn't ~0u, are equal within the
+// relative tolerance. The vertices are hashed on a grid with cells as large
+// as the largest difference allowed, so that only the neighbouring cells
+// need to be searched; with no tolerance the cells are the exact positions.
+void
+weldVertices(std::vector<Face>& faces,
              const cmod::VWord* vertexData,
              const cmod::VertexDescription& desc,
-             const T& orderingPredicate,
-             const U& equivalencePredicate)
+             std::uint32_t texCoordOffset,
+             float tolerance)
 {
     // Don't do anything if we're given no data
-    if (faces.size() == 0)
+    if (faces.empty())
         return;
 
     // Must have a position
     assert(desc.getAttribute(cmod::VertexAttributeSemantic::Position).format == cmod::VertexAttributeFormat::Float3);
 
     std::uint32_t posOffset = desc.getAttribute(cmod::VertexAttributeSemantic::Position).offsetWords;
-    const cmod::VWord* vertexPoints = vertexData + posOffset;
-    std::uint32_t nVertices = faces.size() * 3;
-
-    // Initialize the array of vertices
-    std::vector<Vertex> vertices(nVertices);
-    std::uint32_t f;
     unsigned int stride = desc.strideBytes / sizeof(cmod::VWord);
-    for (f = 0; f < faces.size(); f++)
+
+    std::uint32_t nVertices = 0;
+    for (const Face& face : faces)
+        nVertices = std::max({ nVertices, face.i[0] + 1, face.i[1] + 1, face.i[2] + 1 });
+
+    auto attributes = [&](std::uint32_t index)
     {
-        for (std::uint32_t j = 0; j < 3; j++)
+        std::array<float, 5> values{};
+        std::memcpy(values.data(), vertexData + stride * index + posOffset, sizeof(float) * 3);
+        if (texCoordOffset != ~0u)
+            std::memcpy(values.data() + 3, vertexData + stride * index + texCoordOffset, sizeof(float) * 2);
+        return values;
+    };
+    std::size_t nCompared = texCoordOffset != ~0u ? 5 : 3;
+
+    float cellSize = 0.0f;
+    if (tolerance > 0.0f)
+    {
+        float maxCoord = 0.0f;
+        for (const Face& face : faces)
         {
-            std::uint32_t index = faces[f].i[j];
-            vertices[f * 3 + j] = Vertex(index, vertexPoints + stride * index);
-
+            for (std::uint32_t index : face.i)
+            {
+                auto values = attributes(index);
+                for (int k = 0; k < 3; k++)
+                    maxCoord = std::max(maxCoord, std::abs(values[k]));
+            }
         }
+        cellSize = tolerance * maxCoord;
     }
 
-    // Sort the vertices so that identical ones will be ordered consecutively
-    std::sort(vertices.begin(), vertices.end(), orderingPredicate);
+    auto cellOf = [cellSize](const std::array<float, 5>& values)
+    {
+        CellKey key;
+        for (int k = 0; k < 3; k++)
+        {
+            if (cellSize > 0.0f)
+            {
+                key.cell[k] = static_cast<std::int64_t>(std::floor(values[k] / cellSize));
+            }
+            else
+            {
+                // Adding zero turns -0 into 0, which compares equal
+                float value = values[k] + 0.0f;
+                std::uint32_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                key.cell[k] = bits;
+            }
+        }
+        return key;
+    };
+
+    // Each cell holds a list of the distinct vertices in it, linked
+    // through next
+    std::unordered_map<CellKey, std::uint32_t, CellKeyHash> cells;
+    std::vector<std::uint32_t> next(nVertices, ~0u);
+    std::vector<std::uint32_t> mergeMap(nVertices, ~0u);
+    int searchRadius = cellSize > 0.0f ? 1 : 0;
 
-    // Build the vertex merge map
-    std::vector<std::uint32_t> mergeMap(nVertices);
-    std::uint32_t lastUnique = 0;
-    std::uint32_t uniqueCount = 0;
-    for (std::uint32_t i = 0; i < nVertices; i++)
+    auto findEquivalent = [&](const std::array<float, 5>& values, const CellKey& key)
     {
-        if (i == 0 || !equivalencePredicate(vertices[i - 1], vertices[i]))
+        for (int dx = -searchRadius; dx <= searchRadius; dx++)
         {
-            lastUnique = i;
-            uniqueCount++;
+            for (int dy = -searchRadius; dy <= searchRadius; dy++)
+            {
+                for (int dz = -searchRadius; dz <= searchRadius; dz++)
+                {
+                    CellKey neighbour{ { key.cell[0] + dx, key.cell[1] + dy, key.cell[2] + dz } };
+                    auto it = cells.find(neighbour);
+                    if (it == cells.end())
+                        continue;
+
+                    for (std::uint32_t v = it->second; v != ~0u; v = next[v])
+                    {
+                        auto other = attributes(v);
+                        if (std::equal(values.cbegin(), values.cbegin() + nCompared, other.cbegin(),
+                                       [&](float f0, float f1) { return approxEqual(f0, f1, tolerance); }))
+                        {
+                            return v;
+                        }
+                    }
+                }
+            }
         }
+        return ~0u;
+    };
 
-        mergeMap[vertices[i].index] = vertices[lastUnique].index;
+    for (Face& face : faces)
+    {
+        for (std::uint32_t k = 0; k < 3; k++)
+        {
+            std::uint32_t index = face.i[k];
+            if (mergeMap[index] == ~0u)
+            {
+                auto values = attributes(index);
+                CellKey key = cellOf(values);
+                std::uint32_t equivalent = findEquivalent(values, key);
+                if (equivalent == ~0u)
+                {
+                    auto [it, inserted] = cells.try_emplace(key, index);
+                    if (!inserted)
+                    {
+                        next[index] = it->second;
+                        it->second = index;
+                    }
+                    equivalent = index;
+                }
+                mergeMap[index] = equivalent;
+            }
+
+            face.vi[k] = mergeMap[index];
+        }
     }
+}
+
 
-    // Remap the vertex indices
-    for (f = 0; f < faces.size(); f++)
+// The faces around each point of a mesh, stored consecutively
+class VertexFaces
+{
+public:
+    VertexFaces(const std::vector<Face>& faces, std::uint32_t nVertices) :
+        offsets(nVertices + 1, 0)
     {
-        for (std::uint32_t k= 0; k < 3; k++)
+        // Count the number of faces in which each vertex appears
+        for (const Face& face : faces)
         {
-            faces[f].vi[k] = mergeMap[faces[f].i[k]];
+            for (std::uint32_t vi : face.vi)
+                offsets[vi + 1]++;
+        }
+
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+        // Fill in the vertex/face lists
+        faceIndices.resize(offsets.back());
+        std::vector<std::uint32_t> position(offsets.begin(), offsets.end() - 1);
+        for (std::uint32_t f = 0; f < faces.size(); f++)
+        {
+            for (std::uint32_t vi : faces[f].vi)
+                faceIndices[position[vi]++] = f;
         }
     }
-}
+
+    const std::uint32_t* begin(std::uint32_t vertex) const { return faceIndices.data() + offsets[vertex]; }
+    std::uint32_t count(std::uint32_t vertex) const { return offsets[vertex + 1] - offsets[vertex]; }
+
+private:
+    std::vector<std::uint32_t> offsets;
+    std::vector<std::uint32_t> faceIndices;
+};
 
 
 } // end unnamed namespace
@@ -545,31 +530,28 @@ GenerateNormals(const cmod::Mesh& mesh, float smoothAngle, bool weld, float weld
     const cmod::VWord* vertexData = mesh.getVertexData();
 
     // Compute normals for the faces
-    for (f = 0; f < nFaces; f++)
+    parallelFor(nFaces, [&](std::uint32_t begin, std::uint32_t end)
     {
-        Face& face = faces[f];
-        Eigen::Vector3f p0 = getVertex(vertexData, posOffset, stride, face.i[0]);
-        Eigen::Vector3f p1 = getVertex(vertexData, posOffset, stride, face.i[1]);
-        Eigen::Vector3f p2 = getVertex(vertexData, posOffset, stride, face.i[2]);
-        face.normal = (p1 - p0).cross(p2 - p1);
-        if (face.normal.squaredNorm() > 0.0f)
+        for (std::uint32_t f = begin; f < end; f++)
         {
-            face.normal.normalize();
+            Face& face = faces[f];
+            Eigen::Vector3f p0 = getVertex(vertexData, posOffset, stride, face.i[0]);
+            Eigen::Vector3f p1 = getVertex(vertexData, posOffset, stride, face.i[1]);
+            Eigen::Vector3f p2 = getVertex(vertexData, posOffset, stride, face.i[2]);
+            face.normal = (p1 - p0).cross(p2 - p1);
+            if (face.normal.squaredNorm() > 0.0f)
+            {
+                face.normal.normalize();
+            }
         }
-    }
-
-    // For each vertex, create a list of faces that contain it
-    std::vector<std::uint32_t> faceCounts(nVertices, 0);
-    std::vector<std::vector<std::uint32_t>> vertexFaces(nVertices);
+    });
 
     // If we're welding vertices before generating normals, find identical
     // points and merge them.  Otherwise, the point indices will be the same
     // as the attribute indices.
     if (weld)
     {
-        joinVertices(faces, vertexData, desc,
-                     PointOrderingPredicate(),
-                     PointEquivalencePredicate(0, weldTolerance));
+        weldVertices(faces, vertexData, desc, ~0u, weldTolerance);
     }
     else
     {
@@ -581,48 +563,26 @@ GenerateNormals(const cmod::Mesh& mesh, float smoothAngle, bool weld, float weld
         }
     }
 
-    // Count the number of faces in which each vertex appears
-    for (f = 0; f < nFaces; f++)
-    {
-        Face& face = faces[f];
-        faceCounts[face.vi[0]]++;
-        faceCounts[face.vi[1]]++;
-        faceCounts[face.vi[2]]++;
-    }
-
-    // Allocate space for the per-vertex face lists
-    for (i = 0; i < nVertices; i++)
-    {
-        if (faceCounts[i] > 0)
-        {
-            vertexFaces[i].resize(faceCounts[i] + 1);
-            vertexFaces[i][0] = faceCounts[i];
-        }
-    }
-
-    // Fill in the vertex/face lists
-    for (f = 0; f < nFaces; f++)
-    {
-        Face& face = faces[f];
-        vertexFaces[face.vi[0]][faceCounts[face.vi[0]]--] = f;
-        vertexFaces[face.vi[1]][faceCounts[face.vi[1]]--] = f;
-        vertexFaces[face.vi[2]][faceCounts[face.vi[2]]--] = f;
-    }
+    // For each vertex, create a list of faces that contain it
+    VertexFaces vertexFaces(faces, nVertices);
 
     // Compute the vertex normals by averaging
     std::vector<Eigen::Vector3f> vertexNormals(nFaces * 3);
-    for (f = 0; f < nFaces; f++)
+    parallelFor(nFaces, [&](std::uint32_t begin, std::uint32_t end)
     {
-        Face& face = faces[f];
-        for (std::uint32_t j = 0; j < 3; j++)
+        for (std::uint32_t f = begin; f < end; f++)
         {
-            vertexNormals[f * 3 + j] =
-                averageFaceVectors(faces, f,
-                                   &vertexFaces[face.vi[j]][1],
-                                   vertexFaces[face.vi[j]][0],
-                                   cosSmoothAngle);
+            const Face& face = faces[f];
+            for (std::uint32_t j = 0; j < 3; j++)
+            {
+                vertexNormals[f * 3 + j] =
+                    averageFaceVectors(faces, f,
+                                       vertexFaces.begin(face.vi[j]),
+                                       vertexFaces.count(face.vi[j]),
+                                       cosSmoothAngle);
+            }
         }
-    }
+    });
 
     // Finally, create a new mesh with normals included
 
@@ -662,21 +622,24 @@ GenerateNormals(const cmod::Mesh& mesh, float smoothAngle, bool weld, float weld
     // new vertex data buffer.
     unsigned int newStride = newDesc.strideBytes / sizeof(cmod::VWord);
     std::vector<cmod::VWord> newVertexData(newStride * nFaces * 3);
-    for (f = 0; f < nFaces; f++)
+    parallelFor(nFaces, [&](std::uint32_t begin, std::uint32_t end)
     {
-        Face& face = faces[f];
-
-        for (std::uint32_t j = 0; j < 3; j++)
+        for (std::uint32_t f = begin; f < end; f++)
         {
-            cmod::VWord* newVertex = newVertexData.data() + (f * 3 + j) * newStride;
-            copyVertex(newVertex, newDesc,
-                       vertexData, desc,
-                       face.i[j],
-                       fromOffsets);
-            std::memcpy(newVertex + normalOffset, &vertexNormals[f * 3 + j],
-                        cmod::VertexAttribute::getFormatSizeWords(cmod::VertexAttributeFormat::Float3) * sizeof(cmod::VWord));
+            const Face& face = faces[f];
+
+            for (std::uint32_t j = 0; j < 3; j++)
+            {
+                cmod::VWord* newVertex = newVertexData.data() + (f * 3 + j) * newStride;
+                copyVertex(newVertex, newDesc,
+                           vertexData, desc,
+                           face.i[j],
+                           fromOffsets);
+                std::memcpy(newVertex + normalOffset, &vertexNormals[f * 3 + j],
+                            cmod::VertexAttribute::getFormatSizeWords(cmod::VertexAttributeFormat::Float3) * sizeof(cmod::VWord));
+            }
         }
-    }
+    });
 
     // Create the Celestia mesh
     cmod::Mesh newMesh;
@@ -804,45 +767,35 @@ GenerateTangents(const cmod::Mesh& mesh, bool weld)
     const cmod::VWord* vertexData = mesh.getVertexData();
 
     // Compute tangents for faces
-    for (f = 0; f < nFaces; f++)
-    {
-        Face& face = faces[f];
-        Eigen::Vector3f p0 = getVertex(vertexData, posOffset, stride, face.i[0]);
-        Eigen::Vector3f p1 = getVertex(vertexData, posOffset, stride, face.i[1]);
-        Eigen::Vector3f p2 = getVertex(vertexData, posOffset, stride, face.i[2]);
-        Eigen::Vector2f tc0 = getTexCoord(vertexData, texCoordOffset, stride, face.i[0]);
-        Eigen::Vector2f tc1 = getTexCoord(vertexData, texCoordOffset, stride, face.i[1]);
-        Eigen::Vector2f tc2 = getTexCoord(vertexData, texCoordOffset, stride, face.i[2]);
-        float s1 = tc1.x() - tc0.x();
-        float s2 = tc2.x() - tc0.x();
-        float t1 = tc1.y() - tc0.y();
-        float t2 = tc2.y() - tc0.y();
-        float a = s1 * t2 - s2 * t1;
-        if (a != 0.0f)
-            face.normal = (t2 * (p1 - p0) - t1 * (p2 - p0)) * (1.0f / a);
-        else
-            face.normal = Eigen::Vector3f::Zero();
-    }
-
-    // For each vertex, create a list of faces that contain it
-    std::uint32_t* faceCounts = new std::uint32_t[nVertices];
-    std::uint32_t** vertexFaces = new std::uint32_t*[nVertices];
-
-    // Initialize the lists
-    for (i = 0; i < nVertices; i++)
+    parallelFor(nFaces, [&](std::uint32_t begin, std::uint32_t end)
     {
-        faceCounts[i] = 0;
-        vertexFaces[i] = nullptr;
-    }
+        for (std::uint32_t f = begin; f < end; f++)
+        {
+            Face& face = faces[f];
+            Eigen::Vector3f p0 = getVertex(vertexData, posOffset, stride, face.i[0]);
+            Eigen::Vector3f p1 = getVertex(vertexData, posOffset, stride, face.i[1]);
+            Eigen::Vector3f p2 = getVertex(vertexData, posOffset, stride, face.i[2]);
+            Eigen::Vector2f tc0 = getTexCoord(vertexData, texCoordOffset, stride, face.i[0]);
+            Eigen::Vector2f tc1 = getTexCoord(vertexData, texCoordOffset, stride, face.i[1]);
+            Eigen::Vector2f tc2 = getTexCoord(vertexData, texCoordOffset, stride, face.i[2]);
+            float s1 = tc1.x() - tc0.x();
+            float s2 = tc2.x() - tc0.x();
+            float t1 = tc1.y() - tc0.y();
+            float t2 = tc2.y() - tc0.y();
+            float a = s1 * t2 - s2 * t1;
+            if (a != 0.0f)
+                face.normal = (t2 * (p1 - p0) - t1 * (p2 - p0)) * (1.0f / a);
+            else
+                face.normal = Eigen::Vector3f::Zero();
+        }
+    });
 
     // If we're welding vertices before generating normals, find identical
     // points and merge them.  Otherwise, the point indices will be the same
     // as the attribute indices.
     if (weld)
     {
-        joinVertices(faces, vertexData, desc,
-                     PointTexCoordOrderingPredicate(posOffset, texCoordOffset, true),
-                     PointTexCoordEquivalencePredicate(posOffset, texCoordOffset, true, 1.0e-5f));
+        weldVertices(faces, vertexData, desc, texCoordOffset, 1.0e-5f);
     }
     else
     {
@@ -854,48 +807,26 @@ GenerateTangents(const cmod::Mesh& mesh, bool weld)
         }
     }
 
-    // Count the number of faces in which each vertex appears
-    for (f = 0; f < nFaces; f++)
-    {
-        Face& face = faces[f];
-        faceCounts[face.vi[0]]++;
-        faceCounts[face.vi[1]]++;
-        faceCounts[face.vi[2]]++;
-    }
-
-    // Allocate space for the per-vertex face lists
-    for (i = 0; i < nVertices; i++)
-    {
-        if (faceCounts[i] > 0)
-        {
-            vertexFaces[i] = new std::uint32_t[faceCounts[i] + 1];
-            vertexFaces[i][0] = faceCounts[i];
-        }
-    }
-
-    // Fill in the vertex/face lists
-    for (f = 0; f < nFaces; f++)
-    {
-        Face& face = faces[f];
-        vertexFaces[face.vi[0]][faceCounts[face.vi[0]]--] = f;
-        vertexFaces[face.vi[1]][faceCounts[face.vi[1]]--] = f;
-        vertexFaces[face.vi[2]][faceCounts[face.vi[2]]--] = f;
-    }
+    // For each vertex, create a list of faces that contain it
+    VertexFaces vertexFaces(faces, nVertices);
 
     // Compute the vertex tangents by averaging
     std::vector<Eigen::Vector3f> vertexTangents(nFaces * 3);
-    for (f = 0; f < nFaces; f++)
+    parallelFor(nFaces, [&](std::uint32_t begin, std::uint32_t end)
     {
-        Face& face = faces[f];
-        for (std::uint32_t j = 0; j < 3; j++)
+        for (std::uint32_t f = begin; f < end; f++)
         {
-            vertexTangents[f * 3 + j] =
-                averageFaceVectors(faces, f,
-                                   &vertexFaces[face.vi[j]][1],
-                                   vertexFaces[face.vi[j]][0],
-                                   0.0f);
+            const Face& face = faces[f];
+            for (std::uint32_t j = 0; j < 3; j++)
+            {
+                vertexTangents[f * 3 + j] =
+                    averageFaceVectors(faces, f,
+                                       vertexFaces.begin(face.vi[j]),
+                                       vertexFaces.count(face.vi[j]),
+                                       0.0f);
+            }
         }
-    }
+    });
 
     // Create the new vertex description
     cmod::VertexDescription newDesc = desc.clone();
@@ -933,20 +864,23 @@ GenerateTangents(const cmod::Mesh& mesh, bool weld)
     // new vertex data buffer.
     unsigned int newStride = newDesc.strideBytes / sizeof(cmod::VWord);
     std::vector<cmod::VWord> newVertexData(newStride * nFaces * 3);
-    for (f = 0; f < nFaces; f++)
+    parallelFor(nFaces, [&](std::uint32_t begin, std::uint32_t end)
     {
-        Face& face = faces[f];
-
-        for (std::uint32_t j = 0; j < 3; j++)
+        for (std::uint32_t f = begin; f < end; f++)
         {
-            cmod::VWord* newVertex = newVertexData.data() + (f * 3 + j) * newStride;
-            copyVertex(newVertex, newDesc,
-                       vertexData, desc,
-                       face.i[j],
-                       fromOffsets);
-            std::memcpy(newVertex + tangentOffset, &vertexTangents[f * 3 + j], 3 * sizeof(float));
+            const Face& face = faces[f];
+
+            for (std::uint32_t j = 0; j < 3; j++)
+            {
+                cmod::VWord* newVertex = newVertexData.data() + (f * 3 + j) * newStride;
+                copyVertex(newVertex, newDesc,
+                           vertexData, desc,
+                           face.i[j],
+                           fromOffsets);
+                std::memcpy(newVertex + tangentOffset, &vertexTangents[f * 3 + j], 3 * sizeof(float));
+            }
         }
-    }
+    });
 
     // Create the Celestia mesh
     cmod::Mesh newMesh;
@@ -983,15 +917,6 @@ GenerateTangents(const cmod::Mesh& mesh, bool weld)
         firstIndex += faceCount * 3;
     }
 
-    // Clean up
-    delete[] faceCounts;
-    for (i = 0; i < nVertices; i++)
-    {
-        if (vertexFaces[i] != nullptr)
-            delete[] vertexFaces[i];
-    }
-    delete[] vertexFaces;
-
     return newMesh;
 }
 
@@ -999,63 +924,83 @@ GenerateTangents(const cmod::Mesh& mesh, bool weld)
 bool
 UniquifyVertices(cmod::Mesh& mesh)
 {
-    std::uint32_t nVertices = mesh.getVertexCount();
-    const cmod::VertexDescription& desc = mesh.getVertexDescription();
+    if (mesh.getVertexCount() == 0 || mesh.getVertexData() == nullptr)
+        return false;
+
+    cmod::RemoveDuplicateVertices(mesh);
+    return true;
+}
+
 
-    if (nVertices == 0)
+// Store floating point vertex colors as four normalized bytes, which take
+// a quarter of the space in the vertex buffer
+bool
+QuantizeColors(cmod::Mesh& mesh)
+{
+    const cmod::VertexDescription& desc = mesh.getVertexDescription();
+    const cmod::VertexAttribute& color = desc.getAttribute(cmod::VertexAttributeSemantic::Color0);
+    if (color.semantic != cmod::VertexAttributeSemantic::Color0 ||
+        (color.format != cmod::VertexAttributeFormat::Float3 &&
+         color.format != cmod::VertexAttributeFormat::Float4))
+    {
         return false;
+    }
 
+    std::uint32_t nVertices = mesh.getVertexCount();
     const cmod::VWord* vertexData = mesh.getVertexData();
-    if (vertexData == nullptr)
+    if (nVertices == 0 || vertexData == nullptr)
         return false;
 
-    // Initialize the array of vertices
     unsigned int stride = desc.strideBytes / sizeof(cmod::VWord);
-    std::vector<Vertex> vertices(nVertices);
-    std::uint32_t i;
-    for (i = 0; i < nVertices; i++)
-    {
-        vertices[i] = Vertex(i, vertexData + i * stride);
-    }
+    unsigned int colorOffset = color.offsetWords;
+    unsigned int colorComponents = cmod::VertexAttribute::getFormatSizeWords(color.format);
 
-    // Sort the vertices so that identical ones will be ordered consecutively
-    std::sort(vertices.begin(), vertices.end(), FullComparator(stride));
+    cmod::VertexDescription newDesc = desc.clone();
+    augmentVertexDescription(newDesc, cmod::VertexAttributeSemantic::Color0, cmod::VertexAttributeFormat::UByte4);
 
-    // Count the number of unique vertices
-    std::uint32_t uniqueVertexCount = 0;
-    for (i = 0; i < nVertices; i++)
+    std::uint32_t newColorOffset = 0;
+    std::uint32_t fromOffsets[16];
+    for (std::size_t i = 0; i < newDesc.attributes.size(); i++)
     {
-        if (i == 0 || !equal(vertices[i - 1], vertices[i], stride))
-            uniqueVertexCount++;
-    }
-
-    // No work left to do if we couldn't eliminate any vertices
-    if (uniqueVertexCount == nVertices)
-        return true;
+        fromOffsets[i] = ~0u;
+        if (newDesc.attributes[i].semantic == cmod::VertexAttributeSemantic::Color0)
+        {
+            newColorOffset = newDesc.attributes[i].offsetWords;
+            continue;
+        }
 
-    // Build the vertex map and the uniquified vertex data
-    std::vector<std::uint32_t> vertexMap(nVertices);
-    std::vector<cmod::VWord> newVertexData(uniqueVertexCount * stride);
-    const cmod::VWord* oldVertexData = mesh.getVertexData();
-    std::uint32_t j = 0;
-    for (i = 0; i < nVertices; i++)
-    {
-        if (i == 0 || !equal(vertices[i - 1], vertices[i], stride))
+        for (const auto& oldAttr : desc.attributes)
         {
-            if (i != 0)
-                j++;
-            assert(j < uniqueVertexCount);
-            std::memcpy(newVertexData.data() + j * stride,
-                        oldVertexData + vertices[i].index * stride,
-                        desc.strideBytes);
+            if (oldAttr.semantic == newDesc.attributes[i].semantic)
+            {
+                fromOffsets[i] = oldAttr.offsetWords;
+                break;
+            }
         }
-        vertexMap[vertices[i].index] = j;
     }
 
-    // Replace the vertex data with the compacted data
-    mesh.setVertices(uniqueVertexCount, std::move(newVertexData));
+    unsigned int newStride = newDesc.strideBytes / sizeof(cmod::VWord);
+    std::vector<cmod::VWord> newVertexData(static_cast<std::size_t>(newStride) * nVertices);
+    parallelFor(nVertices, [&](std::uint32_t begin, std::uint32_t end)
+    {
+        for (std::uint32_t v = begin; v < end; v++)
+        {
+            cmod::VWord* newVertex = newVertexData.data() + static_cast<std::size_t>(v) * newStride;
+            copyVertex(newVertex, newDesc, vertexData, desc, v, fromOffsets);
+
+            float rgba[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+            std::memcpy(rgba, vertexData + static_cast<std::size_t>(v) * stride + colorOffset,
+                        colorComponents * sizeof(float));
+
+            std::array<std::uint8_t, 4> bytes;
+            for (unsigned int c = 0; c < 4; c++)
+                bytes[c] = static_cast<std::uint8_t>(std::clamp(rgba[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+            std::memcpy(newVertex + newColorOffset, bytes.data(), bytes.size());
+        }
+    });
 
-    mesh.remapIndices(vertexMap);
+    mesh.setVertexDescription(std::move(newDesc));
+    mesh.setVertices(nVertices, std::move(newVertexData));
 
     return true;
 }
@@ -1087,15 +1032,20 @@ MergeModelMeshes(const cmod::Model& model)
     std::uint32_t meshIndex = 0;
     while (meshIndex < meshes.size())
     {
-        const cmod::VertexDescription& desc = meshes[meshIndex]->getVertexDescription();
+        const cmod::Mesh* first = meshes[meshIndex];
+        const cmod::VertexDescription& desc = first->getVertexDescription();
 
-        // Count the number of matching meshes
+        // Count the number of matching meshes; quantized positions must
+        // also have the same mapping
         std::uint32_t nMatchingMeshes;
         for (nMatchingMeshes = 1;
              meshIndex + nMatchingMeshes < meshes.size();
              nMatchingMeshes++)
         {
-            if (!(meshes[meshIndex + nMatchingMeshes]->getVertexDescription() == desc))
+            const cmod::Mesh* mesh = meshes[meshIndex + nMatchingMeshes];
+            if (!(mesh->getVertexDescription() == desc) ||
+                mesh->getPositionOffset() != first->getPositionOffset() ||
+                mesh->getPositionScale() != first->getPositionScale())
             {
                 break;
             }
@@ -1127,6 +1077,7 @@ MergeModelMeshes(const cmod::Model& model)
         cmod::Mesh mergedMesh;
         mergedMesh.setVertexDescription(desc.clone());
         mergedMesh.setVertices(totalVertices, std::move(vertexData));
+        mergedMesh.setPositionQuantization(first->getPositionOffset(), first->getPositionScale());
 
         // Reindex and add primitive groups
         vertexCount = 0;
@@ -29,6 +29,7 @@ class Model;
 extern cmod::Mesh GenerateNormals(const cmod::Mesh& mesh, float smoothAngle, bool weld, float weldTolerance = 0.0f);
 extern cmod::Mesh GenerateTangents(const cmod::Mesh& mesh, bool weld);
 extern bool UniquifyVertices(cmod::Mesh& mesh);
+extern bool QuantizeColors(cmod::Mesh& mesh);
 
 // Model operations
 extern std::unique_ptr<cmod::Model> MergeModelMeshes(const cmod::Model& model);
@@ -0,0 +1,477 @@
+// compilecatalogs.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Check and compile solar system, star and deep sky catalogs and star
+// names files, so Celestia can load them without parsing. Solar system and
+// star catalogs are compiled to token lists, deep sky catalogs to the
+// binary deep sky database format and star names to the binary name
+// database format; the compiled files keep the names of their sources and
+// Celestia tells them apart by their contents. The files are compiled on
+// several threads.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <celcompat/filesystem.h>
+#include <celengine/dsodb.h>
+#include <celengine/dsosdat.h>
+#include <celengine/parser.h>
+#include <celengine/starname.h>
+#include <celutil/arena.h>
+#include <celutil/filetype.h>
+#include <celutil/logger.h>
+#include <celutil/mappedfile.h>
+#include <celutil/tokenizer.h>
+
+using namespace std;
+using celestia::util::CreateLogger;
+using celestia::util::MappedFile;
+
+
+namespace
+{
+
+enum class CatalogKind
+{
+    SolarSystem,
+    Stars,
+    DeepSky,
+    StarNames,
+};
+
+struct Options
+{
+    fs::path outputDirectory;
+    vector<fs::path> inputs;
+    vector<fs::path> nameFiles;
+    unsigned int threads{ max(1u, thread::hardware_concurrency()) };
+    bool checkOnly{ false };
+};
+
+struct Job
+{
+    CatalogKind kind;
+    fs::path input;
+    fs::path output;
+    // Filled in by compile()
+    bool ok{ false };
+    size_t objectCount{ 0 };
+    string messages;
+};
+
+
+void Usage()
+{
+    cerr << "Usage: compilecatalogs [options] -o <output directory> <catalog files and directories...>\n";
+    cerr << "  Options:\n";
+    cerr << "    -o <directory>      : directory of the compiled catalogs\n";
+    cerr << "    --names <file>      : star names file to compile\n";
+    cerr << "    --check             : only check the catalogs\n";
+    cerr << "    --threads <count>   : number of threads\n";
+    cerr << "  The ssc, stc and dsc files in the directories are compiled to the same\n";
+    cerr << "  relative paths in the output directory.\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        string_view arg = argv[i];
+        if (arg.empty() || arg[0] != '-')
+        {
+            options.inputs.emplace_back(arg);
+            continue;
+        }
+
+        if (arg == "--check")
+        {
+            options.checkOnly = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            cerr << "Missing value for " << arg << '\n';
+            return false;
+        }
+
+        const char* value = argv[++i];
+        if (arg == "-o")
+            options.outputDirectory = value;
+        else if (arg == "--names")
+            options.nameFiles.emplace_back(value);
+        else if (arg == "--threads")
+            options.threads = max(1, atoi(value));
+        else
+        {
+            cerr << "Unknown command line switch: " << arg << '\n';
+            return false;
+        }
+    }
+
+    if (options.inputs.empty() && options.nameFiles.empty())
+        return false;
+
+    if (options.outputDirectory.empty() && !options.checkOnly)
+    {
+        cerr << "No output directory given\n";
+        return false;
+    }
+
+    return true;
+}
+
+
+bool
+catalogKind(const fs::path& path, CatalogKind& kind)
+{
+    switch (DetermineFileType(path))
+    {
+    case ContentType::CelestiaCatalog:
+        kind = CatalogKind::SolarSystem;
+        return true;
+    case ContentType::CelestiaStarCatalog:
+        kind = CatalogKind::Stars;
+        return true;
+    case ContentType::CelestiaDeepSkyCatalog:
+        kind = CatalogKind::DeepSky;
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+// Make the list of files to compile, in the order they were given and
+// sorted within each directory, as Celestia reads the extras directories
+bool
+listJobs(const Options& options, vector<Job>& jobs)
+{
+    for (const fs::path& input : options.inputs)
+    {
+        std::error_code ec;
+        if (!fs::is_directory(input, ec))
+        {
+            Job job;
+            if (!catalogKind(input, job.kind))
+            {
+                cerr << input.string() << ": not an ssc, stc or dsc catalog\n";
+                return false;
+            }
+            job.input = input;
+            job.output = options.outputDirectory / input.filename();
+            jobs.push_back(std::move(job));
+            continue;
+        }
+
+        size_t first = jobs.size();
+        for (auto iter = fs::recursive_directory_iterator(input, ec); !ec && iter != end(iter); iter.increment(ec))
+        {
+            Job job;
+            if (fs::is_directory(iter->path(), ec) || !catalogKind(iter->path(), job.kind))
+                continue;
+            job.input = iter->path();
+            job.output = options.outputDirectory / fs::relative(iter->path(), input, ec);
+            jobs.push_back(std::move(job));
+        }
+        if (ec)
+        {
+            cerr << "Error listing " << input.string() << '\n';
+            return false;
+        }
+
+        sort(jobs.begin() + first, jobs.end(),
+             [](const Job& a, const Job& b) { return a.input < b.input; });
+    }
+
+    for (const fs::path& input : options.nameFiles)
+    {
+        Job job;
+        job.kind = CatalogKind::StarNames;
+        job.input = input;
+        job.output = options.outputDirectory / input.filename();
+        jobs.push_back(std::move(job));
+    }
+
+    return true;
+}
+
+
+bool
+readOptionalName(Tokenizer& tokenizer, initializer_list<string_view> values)
+{
+    if (auto name = tokenizer.getNameValue(); name.has_value() &&
+        find(values.begin(), values.end(), *name) != values.end())
+    {
+        tokenizer.nextToken();
+        return true;
+    }
+    return false;
+}
+
+
+// Check the structure of a catalog as the loader of its kind reads it,
+// parsing the properties of each object with the runtime's parser. The
+// properties themselves are only checked where they can be without a
+// universe, i.e. for deep sky objects.
+bool
+checkCatalog(const TokenList& tokens, Job& job)
+{
+    Tokenizer tokenizer(tokens);
+    celestia::util::Arena arena;
+    Parser parser(&tokenizer, &arena);
+
+    auto error = [&](string_view message)
+    {
+        job.messages += fmt::format("{}:{}: {}\n", job.input.string(), tokenizer.getLineNumber(), message);
+        return false;
+    };
+
+    while (tokenizer.nextToken() != Tokenizer::TokenEnd)
+    {
+        arena.reset();
+        if (tokenizer.getTokenType() == Tokenizer::TokenError)
+            return error("syntax error");
+
+        switch (job.kind)
+        {
+        case CatalogKind::SolarSystem:
+            readOptionalName(tokenizer, { "Add", "Replace", "Modify" });
+            if (tokenizer.getNameValue().has_value() &&
+                !readOptionalName(tokenizer, { "Body", "ReferencePoint", "SurfaceObject", "AltSurface", "Location" }))
+            {
+                return error(fmt::format("unknown object type {}", *tokenizer.getNameValue()));
+            }
+            if (!tokenizer.getStringValue().has_value())
+                return error("object name expected");
+            tokenizer.nextToken();
+            if (!tokenizer.getStringValue().has_value())
+                return error("parent object name expected");
+            break;
+
+        case CatalogKind::Stars:
+            readOptionalName(tokenizer, { "Add", "Replace", "Modify" });
+            if (tokenizer.getNameValue().has_value() && !readOptionalName(tokenizer, { "Star", "Barycenter" }))
+                return error(fmt::format("unknown object type {}", *tokenizer.getNameValue()));
+            if (tokenizer.getNumberValue().has_value())
+                tokenizer.nextToken();
+            if (tokenizer.getStringValue().has_value())
+                tokenizer.nextToken();
+            if (tokenizer.getTokenType() != Tokenizer::TokenBeginGroup)
+                return error("{ expected");
+            tokenizer.pushBack();
+            break;
+
+        case CatalogKind::DeepSky:
+            if (!readOptionalName(tokenizer, { "Galaxy", "Globular", "Nebula", "OpenCluster" }))
+                return error("deep sky object type expected");
+            if (!tokenizer.getStringValue().has_value())
+                return error("object name expected");
+            break;
+
+        default:
+            return false;
+        }
+
+        const Value properties = parser.readValue();
+        if (properties.getHash() == nullptr)
+            return error("bad property list");
+        job.objectCount++;
+    }
+
+    return true;
+}
+
+
+// Star names files have a catalog number and a colon separated list of
+// names on each line
+bool
+checkStarNames(string_view text, Job& job)
+{
+    int lineNumber = 0;
+    for (size_t pos = 0; pos < text.size();)
+    {
+        size_t end = min(text.find('\n', pos), text.size());
+        string_view line = text.substr(pos, end - pos);
+        pos = end + 1;
+        lineNumber++;
+
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        if (line.find_first_not_of(" \t") == string_view::npos)
+            continue;
+
+        size_t colon = line.find(':');
+        size_t digits = line.substr(0, colon).find_first_not_of("0123456789");
+        if (colon == 0 || colon == string_view::npos || digits != string_view::npos)
+        {
+            job.messages += fmt::format("{}:{}: catalog number and names expected\n", job.input.string(), lineNumber);
+            return false;
+        }
+        job.objectCount++;
+    }
+
+    return true;
+}
+
+
+bool
+writeOutput(Job& job, const fs::path& output, bool (*write)(ostream&, const void*), const void* data)
+{
+    std::error_code ec;
+    fs::create_directories(output.parent_path(), ec);
+
+    bool written;
+    {
+        ofstream out(output, ios::out | ios::binary);
+        written = out.good() && write(out, data) && out.good();
+    }
+
+    if (!written)
+    {
+        fs::remove(output, ec);
+        job.messages += fmt::format("{}: error writing {}\n", job.input.string(), output.string());
+    }
+    return written;
+}
+
+
+void
+compile(Job& job, bool checkOnly)
+{
+    auto file = MappedFile::open(job.input);
+    if (file == nullptr)
+    {
+        job.messages += fmt::format("{}: error opening the file\n", job.input.string());
+        return;
+    }
+
+    string_view text(file->data(), file->size());
+    if (TokenList::isTokenList(text) ||
+        (job.kind == CatalogKind::DeepSky && DSODatabase::isBinary(job.input)) ||
+        (job.kind == CatalogKind::StarNames && NameDatabase::isBinary(job.input)))
+    {
+        job.messages += fmt::format("{}: already compiled\n", job.input.string());
+        return;
+    }
+
+    if (job.kind == CatalogKind::StarNames)
+    {
+        if (!checkStarNames(text, job))
+            return;
+
+        istringstream in{ string(text) };
+        unique_ptr<StarNameDatabase> names(StarNameDatabase::readNames(in));
+        if (names == nullptr)
+        {
+            job.messages += fmt::format("{}: error reading the star names\n", job.input.string());
+            return;
+        }
+
+        job.ok = checkOnly || writeOutput(job, job.output, [](ostream& out, const void* data)
+        {
+            return static_cast<const StarNameDatabase*>(data)->writeBinary(out);
+        }, names.get());
+        return;
+    }
+
+    Tokenizer tokenizer(text);
+    TokenList tokens(tokenizer);
+    if (!checkCatalog(tokens, job))
+        return;
+
+    if (job.kind == CatalogKind::DeepSky)
+    {
+        // Build the records exactly as Celestia does from the text, which
+        // also checks the properties of the objects
+        vector<celestia::engine::DSOsDatEntry> entries;
+        istringstream in{ string(text) };
+        if (!celestia::engine::readDSCEntries(in, entries))
+        {
+            job.messages += fmt::format("{}: bad deep sky object definition\n", job.input.string());
+            return;
+        }
+
+        job.ok = checkOnly || writeOutput(job, job.output, [](ostream& out, const void* data)
+        {
+            return celestia::engine::writeDSOsDat(out, *static_cast<const vector<celestia::engine::DSOsDatEntry>*>(data));
+        }, &entries);
+        return;
+    }
+
+    job.ok = checkOnly || writeOutput(job, job.output, [](ostream& out, const void* data)
+    {
+        return static_cast<const TokenList*>(data)->write(out);
+    }, &tokens);
+}
+
+} // end unnamed namespace
+
+
+int main(int argc, char* argv[])
+{
+    CreateLogger();
+
+    Options options;
+    if (!parseCommandLine(argc, argv, options))
+    {
+        Usage();
+        return 1;
+    }
+
+    vector<Job> jobs;
+    if (!listJobs(options, jobs))
+        return 1;
+
+    atomic<size_t> next{ 0 };
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < jobs.size(); i = next++)
+            compile(jobs[i], options.checkOnly);
+    };
+
+    vector<thread> threads;
+    for (unsigned int i = 1; i < options.threads && i < jobs.size(); i++)
+        threads.emplace_back(worker);
+    worker();
+    for (thread& t : threads)
+        t.join();
+
+    size_t failed = 0;
+    for (const Job& job : jobs)
+    {
+        cerr << job.messages;
+        if (job.ok)
+            cout << job.input.string() << ": " << job.objectCount << " objects\n";
+        else
+            failed++;
+    }
+
+    if (failed != 0)
+    {
+        cerr << failed << " of " << jobs.size() << " files failed\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,462 @@
+// makegalaxydb.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Build a binary deep sky database of galaxies from a survey table, such
+// as a HyperLEDA or 2MASS extended source catalog export. The galaxies get
+// the distances, radii, magnitudes and orientations deepsky.pl derives;
+// the rows are parsed on several threads.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celengine/astro.h>
+#include <celengine/dsosdat.h>
+#include <celmath/mathlib.h>
+#include <celutil/logger.h>
+#include "surveytable.h"
+
+using namespace std;
+using celestia::engine::DSOsDatEntry;
+using celestia::util::CreateLogger;
+
+
+namespace
+{
+
+enum class SizeUnit
+{
+    LogD25,         // log10 of the D25 diameter in 0.1 arcmin
+    RadiusArcsec,
+};
+
+struct Preset
+{
+    string_view name;
+    bool raInHours;
+    SizeUnit sizeUnit;
+    bool logAxisRatio;      // log10 of major/minor, else minor/major
+    double magnitudeOffset; // added to the magnitudes to get B
+    string_view namePrefix;
+    string_view altNamePrefix;
+    map<string, vector<string>> columns;
+};
+
+const Preset* findPreset(string_view name)
+{
+    static const Preset presets[] =
+    {
+        {
+            "hyperleda", true, SizeUnit::LogD25, true, 0.0, "", "PGC ",
+            {
+                { "name",     { "objname" } },
+                { "altname",  { "pgc" } },
+                { "ra",       { "al2000" } },
+                { "dec",      { "de2000" } },
+                { "t",        { "t" } },
+                { "type",     { "type" } },
+                { "bar",      { "bar" } },
+                { "size",     { "logd25" } },
+                { "ratio",    { "logr25" } },
+                { "pa",       { "pa" } },
+                { "mag",      { "btc", "bt" } },
+                { "modulus",  { "modbest", "mod0" } },
+                { "velocity", { "vvir", "v" } },
+            },
+        },
+        {
+            // B - K is about 4 for most galaxies
+            "2mass", false, SizeUnit::RadiusArcsec, false, 4.0, "2MASX J", "",
+            {
+                { "name",     { "designation" } },
+                { "ra",       { "ra" } },
+                { "dec",      { "dec" } },
+                { "size",     { "r_k20fe" } },
+                { "ratio",    { "k_ba" } },
+                { "pa",       { "k_phi" } },
+                { "mag",      { "k_m_k20fe" } },
+                { "velocity", { "cz", "vel" } },
+                { "redshift", { "z" } },
+            },
+        },
+    };
+
+    for (const Preset& preset : presets)
+    {
+        if (preset.name == name)
+            return &preset;
+    }
+
+    return nullptr;
+}
+
+struct Options
+{
+    fs::path inputFile;
+    fs::path outputFile;
+    const Preset* preset{ findPreset("hyperleda") };
+    map<string, vector<string>> columnOverrides;
+    string defaultType{ "S0" };
+    unsigned int threads{ max(1u, thread::hardware_concurrency()) };
+};
+
+// Indices of the columns of a table, -1 for those it lacks
+struct Columns
+{
+    int name;
+    int altName;
+    int ra;
+    int dec;
+    int t;
+    int type;
+    int bar;
+    int size;
+    int ratio;
+    int pa;
+    int mag;
+    int modulus;
+    int velocity;
+    int redshift;
+    int distance;
+};
+
+
+void Usage()
+{
+    cerr << "Usage: makegalaxydb [options] <survey table> <output dsos.dat>\n";
+    cerr << "  Options:\n";
+    cerr << "    --preset <name>     : columns of hyperleda (default) or 2mass tables\n";
+    cerr << "    --map <key>=<column>: column to use for a key instead of the preset's\n";
+    cerr << "    --type <Hubble type>: type of the galaxies lacking one (default S0)\n";
+    cerr << "    --threads <count>   : number of threads\n";
+    cerr << "  Keys are name, altname, ra, dec, t, type, bar, size, ratio, pa, mag,\n";
+    cerr << "  modulus, velocity (km/s), redshift and distance (Mpc).\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[], Options& options)
+{
+    int fileCount = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        string_view arg = argv[i];
+        if (arg.empty() || arg[0] != '-')
+        {
+            if (fileCount == 0)
+                options.inputFile = arg;
+            else if (fileCount == 1)
+                options.outputFile = arg;
+            else
+                return false;
+            fileCount++;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            cerr << "Missing value for " << arg << '\n';
+            return false;
+        }
+
+        string_view value = argv[++i];
+        if (arg == "--preset")
+        {
+            options.preset = findPreset(value);
+            if (options.preset == nullptr)
+            {
+                cerr << "Unknown preset: " << value << '\n';
+                return false;
+            }
+        }
+        else if (arg == "--map")
+        {
+            auto pos = value.find('=');
+            if (pos == string_view::npos || pos == 0)
+            {
+                cerr << "Bad column mapping: " << value << '\n';
+                return false;
+            }
+            options.columnOverrides[string(value.substr(0, pos))] = { string(value.substr(pos + 1)) };
+        }
+        else if (arg == "--type")
+            options.defaultType = value;
+        else if (arg == "--threads")
+            options.threads = max(1, atoi(value.data()));
+        else
+        {
+            cerr << "Unknown command line switch: " << arg << '\n';
+            return false;
+        }
+    }
+
+    return fileCount == 2;
+}
+
+
+bool findColumns(const SurveyTable& table, const Options& options, Columns& columns)
+{
+    auto find = [&](const string& key)
+    {
+        auto it = options.columnOverrides.find(key);
+        if (it == options.columnOverrides.end())
+        {
+            it = options.preset->columns.find(key);
+            if (it == options.preset->columns.end())
+                return -1;
+        }
+
+        for (const string& name : it->second)
+        {
+            if (int column = table.column(name); column >= 0)
+                return column;
+        }
+        return -1;
+    };
+
+    columns.name = find("name");
+    columns.altName = find("altname");
+    columns.ra = find("ra");
+    columns.dec = find("dec");
+    columns.t = find("t");
+    columns.type = find("type");
+    columns.bar = find("bar");
+    columns.size = find("size");
+    columns.ratio = find("ratio");
+    columns.pa = find("pa");
+    columns.mag = find("mag");
+    columns.modulus = find("modulus");
+    columns.velocity = find("velocity");
+    columns.redshift = find("redshift");
+    columns.distance = find("distance");
+
+    bool ok = true;
+    for (auto [key, column] : { pair("name", columns.name), pair("ra", columns.ra), pair("dec", columns.dec),
+                                pair("size", columns.size), pair("mag", columns.mag) })
+    {
+        if (column >= 0)
+            continue;
+        // Nameless rows are named after their alternate designation
+        if (key == string_view("name") && columns.altName >= 0)
+            continue;
+        cerr << "No " << key << " column in the table\n";
+        ok = false;
+    }
+
+    if (columns.modulus < 0 && columns.velocity < 0 && columns.redshift < 0 && columns.distance < 0)
+    {
+        cerr << "No distance, modulus, velocity or redshift column in the table\n";
+        ok = false;
+    }
+
+    return ok;
+}
+
+
+// Simple Hubble class of the numeric type T, as deepsky.pl assigns them
+string typeFromT(double t, bool barred)
+{
+    long type = lround(t);
+    if (type <= -4)
+        return "E0";
+    if (type <= 0)
+        return "S0";
+    if (type >= 9)
+        return "Irr";
+
+    string name = barred ? "SB" : "S";
+    name += type == 1 ? 'a' : type <= 3 ? 'b' : 'c';
+    return name;
+}
+
+
+// Reduce a morphological type such as SABbc or E3 to a Hubble class
+string typeFromName(string_view name)
+{
+    if (name.empty())
+        return {};
+
+    if (name[0] == 'E')
+    {
+        if (name.size() > 1 && name[1] >= '0' && name[1] <= '7')
+            return string("E") + name[1];
+        return name.find("S0") != string_view::npos ? "S0" : "E0";
+    }
+
+    if (name[0] == 'I' || name.substr(0, 2) == "Sm" || name.substr(0, 2) == "Sd")
+        return "Irr";
+
+    if (name[0] == 'L' || name.find("S0") != string_view::npos)
+        return "S0";
+
+    if (name[0] != 'S')
+        return {};
+
+    // The de Vaucouleurs SA and SAB families are taken as unbarred
+    bool barred = name.substr(0, 2) == "SB";
+    auto stage = name.find_first_of("abcdm", 1);
+    if (stage == string_view::npos)
+        return "S0";
+    if (name[stage] == 'd' || name[stage] == 'm')
+        return "Irr";
+
+    string type = barred ? "SB" : "S";
+    type += name[stage];
+    return type;
+}
+
+
+bool parseGalaxy(const SurveyRow& row, const Columns& columns, const Options& options, DSOsDatEntry& entry)
+{
+    const Preset& preset = *options.preset;
+
+    auto ra = row.angle(columns.ra);
+    auto dec = row.angle(columns.dec);
+    auto size = row.number(columns.size);
+    auto mag = row.number(columns.mag);
+    if (!ra.has_value() || !dec.has_value() || !size.has_value() || !mag.has_value())
+        return false;
+
+    double raHours = preset.raInHours ? *ra : *ra / 15.0;
+
+    // Distance from the modulus, failing that from Hubble's law
+    double distance = 0.0;
+    if (auto modulus = row.number(columns.modulus); modulus.has_value())
+        distance = pow(10.0, (*modulus + 5.0) / 5.0) * LY_PER_PARSEC<double>;
+    else if (auto d = row.number(columns.distance); d.has_value())
+        distance = *d * 1.0e6 * LY_PER_PARSEC<double>;
+    else if (auto z = row.number(columns.redshift); z.has_value() && *z > 0.0)
+        distance = ComovingDistance(*z);
+    else if (auto v = row.number(columns.velocity); v.has_value() && *v > 0.0)
+        distance = *v / HUBBLE_CONSTANT * 1.0e6 * LY_PER_PARSEC<double>;
+    if (distance <= 0.0)
+        return false;
+
+    // Angular radius in degrees
+    double angularRadius;
+    switch (preset.sizeUnit)
+    {
+    case SizeUnit::LogD25:
+        angularRadius = 0.5 * 0.1 * pow(10.0, *size) / 60.0;
+        break;
+    default:
+        angularRadius = *size / 3600.0;
+        break;
+    }
+    double radius = celmath::degToRad(angularRadius) * distance;
+    if (radius <= 0.0 || radius >= distance)
+        return false;
+
+    // Minor to major axis ratio
+    double axisRatio = 1.0;
+    if (auto ratio = row.number(columns.ratio); ratio.has_value())
+        axisRatio = preset.logAxisRatio ? pow(10.0, -*ratio) : *ratio;
+    axisRatio = clamp(axisRatio, 0.0, 1.0);
+
+    string type;
+    if (auto t = row.number(columns.t); t.has_value())
+        type = typeFromT(*t, row.text(columns.bar) == "B");
+    else
+        type = typeFromName(row.text(columns.type));
+    if (type.empty())
+        type = options.defaultType;
+    // Ellipticals with the flattening of their image
+    if (type == "E0")
+        type = "E" + to_string(min(7L, lround(10.0 * (1.0 - axisRatio))));
+
+    double positionAngle = row.number(columns.pa).value_or(0.0);
+    double inclination = type[0] == 'E' ? 0.0 : DiskInclination(axisRatio);
+
+    // The magnitude from the edge of the galaxy, as Celestia takes it
+    double absMag = *mag + preset.magnitudeOffset
+                  - 5.0 * log10((distance - radius) / (10.0 * LY_PER_PARSEC<double>));
+
+    string name;
+    if (string_view primary = row.text(columns.name); !primary.empty())
+    {
+        name = StandardizeName(string(preset.namePrefix) + string(primary));
+    }
+    if (string_view alternate = row.text(columns.altName); !alternate.empty())
+    {
+        string altName = StandardizeName(string(preset.altNamePrefix) + string(alternate));
+        if (name.empty())
+            name = altName;
+        else if (altName != name)
+            name += ':' + altName;
+    }
+    if (name.empty())
+        return false;
+
+    DSOProperties properties;
+    properties.set("Type", type);
+    properties.set("RA", raHours);
+    properties.set("Dec", *dec);
+    properties.set("Distance", distance);
+    properties.set("Radius", radius);
+    properties.set("AbsMag", absMag);
+    properties.setOrientation(DSOOrientation(raHours, *dec, positionAngle, inclination));
+    return properties.makeEntry("Galaxy", name, entry);
+}
+
+} // end unnamed namespace
+
+
+int main(int argc, char* argv[])
+{
+    CreateLogger();
+
+    Options options;
+    if (!parseCommandLine(argc, argv, options))
+    {
+        Usage();
+        return 1;
+    }
+
+    auto table = SurveyTable::open(options.inputFile);
+    if (table == nullptr)
+        return 1;
+
+    Columns columns;
+    if (!findColumns(*table, options, columns))
+        return 1;
+
+    vector<DSOsDatEntry> entries;
+    size_t skipped = table->parse([&](const SurveyRow& row, DSOsDatEntry& entry)
+                                  {
+                                      return parseGalaxy(row, columns, options, entry);
+                                  },
+                                  options.threads, entries);
+
+    ofstream out(options.outputFile, ios::out | ios::binary);
+    if (!out.good())
+    {
+        cerr << "Error opening " << options.outputFile << '\n';
+        return 1;
+    }
+
+    if (!celestia::engine::writeDSOsDat(out, entries))
+    {
+        cerr << "Error writing " << options.outputFile << '\n';
+        return 1;
+    }
+
+    cout << entries.size() << " galaxies written";
+    if (skipped != 0)
+        cout << ", " << skipped << " rows without the needed values skipped";
+    cout << '\n';
+
+    return 0;
+}
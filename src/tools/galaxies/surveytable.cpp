@@ -0,0 +1,462 @@
+// surveytable.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "surveytable.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#include <celcompat/charconv.h>
+#include <celengine/astro.h>
+#include <celengine/value.h>
+#include <celmath/mathlib.h>
+#include <celutil/mappedfile.h>
+#include <celutil/stringutils.h>
+
+namespace compat = celestia::compat;
+namespace engine = celestia::engine;
+namespace util = celestia::util;
+
+namespace
+{
+
+constexpr std::string_view Blanks = " \t\r\n";
+
+std::string_view
+trim(std::string_view text)
+{
+    auto start = text.find_first_not_of(Blanks);
+    if (start == std::string_view::npos)
+        return {};
+    auto end = text.find_last_not_of(Blanks);
+    text = text.substr(start, end - start + 1);
+    if (text.size() >= 2 && text.front() == '"' && text.back() == '"')
+        text = trim(text.substr(1, text.size() - 2));
+    return text;
+}
+
+void
+splitFields(std::string_view line, char delimiter, std::vector<std::string_view>& fields)
+{
+    fields.clear();
+    for (;;)
+    {
+        auto pos = line.find(delimiter);
+        fields.push_back(trim(line.substr(0, pos)));
+        if (pos == std::string_view::npos)
+            break;
+        line.remove_prefix(pos + 1);
+    }
+}
+
+// Lines such as ------|------ under a header
+bool
+isSeparatorLine(std::string_view line, char delimiter)
+{
+    bool hasRule = false;
+    for (char c : line)
+    {
+        if (c == '-' || c == '=' || c == '+')
+            hasRule = true;
+        else if (c != delimiter && Blanks.find(c) == std::string_view::npos)
+            return false;
+    }
+    return hasRule;
+}
+
+bool
+isSkipped(std::string_view line)
+{
+    line = trim(line);
+    return line.empty() || line.front() == '#' || line.front() == '\\';
+}
+
+// Split text into lines, calling f(lineNumber, line)
+template<typename F> void
+forEachLine(std::string_view text, std::size_t firstLine, F&& f)
+{
+    std::size_t lineNumber = firstLine;
+    while (!text.empty())
+    {
+        auto pos = text.find('\n');
+        std::string_view line = text.substr(0, pos);
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        f(lineNumber, line);
+        ++lineNumber;
+        if (pos == std::string_view::npos)
+            break;
+        text.remove_prefix(pos + 1);
+    }
+}
+
+struct Chunk
+{
+    std::string_view text;
+    std::size_t firstLine;
+    std::vector<engine::DSOsDatEntry> entries;
+    std::size_t rejected{ 0 };
+};
+
+} // end unnamed namespace
+
+std::string_view
+SurveyRow::text(int column) const
+{
+    if (column < 0 || static_cast<std::size_t>(column) >= m_fields.size())
+        return {};
+    return m_fields[static_cast<std::size_t>(column)];
+}
+
+std::optional<double>
+SurveyRow::number(int column) const
+{
+    std::string_view field = text(column);
+    if (!field.empty() && field.front() == '+')
+        field.remove_prefix(1);
+    if (field.empty())
+        return std::nullopt;
+
+    double value;
+    auto [ptr, ec] = compat::from_chars(field.data(), field.data() + field.size(), value);
+    if (ec != std::errc() || ptr != field.data() + field.size() || !std::isfinite(value))
+        return std::nullopt;
+    return value;
+}
+
+std::optional<double>
+SurveyRow::angle(int column) const
+{
+    std::string_view field = text(column);
+    if (field.empty())
+        return std::nullopt;
+
+    double sign = 1.0;
+    if (field.front() == '-' || field.front() == '+')
+    {
+        sign = field.front() == '-' ? -1.0 : 1.0;
+        field = trim(field.substr(1));
+    }
+
+    // Up to three parts, separated by blanks, colons or unit letters
+    constexpr std::string_view Separators = " \t:hdmsHDM'\"";
+    constexpr std::array<double, 3> Scales{ 1.0, 1.0 / 60.0, 1.0 / 3600.0 };
+    double value = 0.0;
+    const char* ptr = field.data();
+    const char* end = field.data() + field.size();
+    std::size_t parts = 0;
+    while (ptr != end)
+    {
+        if (parts == Scales.size())
+            return std::nullopt;
+
+        double part;
+        auto result = compat::from_chars(ptr, end, part);
+        if (result.ec != std::errc() || part < 0.0)
+            return std::nullopt;
+        value += part * Scales[parts++];
+
+        ptr = result.ptr;
+        while (ptr != end && Separators.find(*ptr) != std::string_view::npos)
+            ++ptr;
+    }
+
+    if (parts == 0)
+        return std::nullopt;
+    return sign * value;
+}
+
+SurveyTable::~SurveyTable() = default;
+
+std::unique_ptr<SurveyTable>
+SurveyTable::open(const fs::path& path)
+{
+    auto file = util::MappedFile::open(path);
+    if (file == nullptr)
+    {
+        std::cerr << "Error opening " << path << '\n';
+        return nullptr;
+    }
+
+    std::unique_ptr<SurveyTable> table(new SurveyTable);
+    std::string_view text(file->data(), file->size());
+    bool haveHeader = false;
+    std::size_t afterHeader = 0;
+    std::size_t offset = 0;
+    std::size_t lineNumber = 1;
+    while (offset < text.size())
+    {
+        auto pos = text.find('\n', offset);
+        std::size_t next = pos == std::string_view::npos ? text.size() : pos + 1;
+        std::string_view line = text.substr(offset, next - offset);
+
+        if (!haveHeader)
+        {
+            if (!isSkipped(line))
+            {
+                auto delimiter = line.find_first_of("|\t;,");
+                if (delimiter == std::string_view::npos)
+                {
+                    std::cerr << path.string() << ':' << lineNumber << ": no delimiter in the header\n";
+                    return nullptr;
+                }
+                // Pipe first: HyperLEDA and IRSA tables pad their columns
+                // with blanks which tables with other delimiters lack
+                for (char c : { '|', '\t', ';', ',' })
+                {
+                    if (line.find(c) != std::string_view::npos)
+                    {
+                        table->m_delimiter = c;
+                        break;
+                    }
+                }
+
+                std::vector<std::string_view> fields;
+                splitFields(line, table->m_delimiter, fields);
+                for (std::string_view field : fields)
+                    table->m_columns.emplace_back(field);
+                haveHeader = true;
+                table->m_bodyOffset = next;
+                table->m_bodyLine = lineNumber + 1;
+            }
+        }
+        else
+        {
+            // Skip through a separator line among the first two after the
+            // header, along with a unit line above it
+            if (isSeparatorLine(line, table->m_delimiter))
+            {
+                table->m_bodyOffset = next;
+                table->m_bodyLine = lineNumber + 1;
+                break;
+            }
+            if (++afterHeader == 2)
+                break;
+        }
+
+        offset = next;
+        ++lineNumber;
+    }
+
+    if (!haveHeader)
+    {
+        std::cerr << "No header found in " << path << '\n';
+        return nullptr;
+    }
+
+    table->m_file = std::move(file);
+    return table;
+}
+
+int
+SurveyTable::column(std::initializer_list<std::string_view> names) const
+{
+    for (std::string_view name : names)
+    {
+        auto it = std::find_if(m_columns.begin(), m_columns.end(),
+                               [name](const std::string& c) { return compareIgnoringCase(c, name) == 0; });
+        if (it != m_columns.end())
+            return static_cast<int>(it - m_columns.begin());
+    }
+
+    return -1;
+}
+
+std::size_t
+SurveyTable::parse(const RowParser& parser, unsigned int threads,
+                   std::vector<engine::DSOsDatEntry>& entries) const
+{
+    std::string_view body(m_file->data() + m_bodyOffset, m_file->size() - m_bodyOffset);
+
+    // Several chunks per thread even out the work of tables whose rows
+    // differ in length
+    threads = std::max(1u, threads);
+    std::size_t chunkCount = threads == 1 ? 1 : threads * 4;
+    std::size_t chunkSize = body.size() / chunkCount + 1;
+
+    std::vector<Chunk> chunks;
+    std::size_t start = 0;
+    std::size_t lineNumber = m_bodyLine;
+    while (start < body.size())
+    {
+        std::size_t end = body.find('\n', std::min(body.size(), start + chunkSize));
+        end = end == std::string_view::npos ? body.size() : end + 1;
+
+        Chunk& chunk = chunks.emplace_back();
+        chunk.text = body.substr(start, end - start);
+        chunk.firstLine = lineNumber;
+        lineNumber += static_cast<std::size_t>(std::count(chunk.text.begin(), chunk.text.end(), '\n'));
+        start = end;
+    }
+
+    auto parseChunk = [this, &parser](Chunk& chunk)
+    {
+        std::vector<std::string_view> fields;
+        forEachLine(chunk.text, chunk.firstLine, [&](std::size_t line, std::string_view text)
+        {
+            if (isSkipped(text) || isSeparatorLine(text, m_delimiter))
+                return;
+
+            splitFields(text, m_delimiter, fields);
+            engine::DSOsDatEntry entry;
+            if (parser(SurveyRow(line, fields), entry))
+                chunk.entries.push_back(std::move(entry));
+            else
+                ++chunk.rejected;
+        });
+    };
+
+    std::atomic<std::size_t> nextChunk{ 0 };
+    auto worker = [&]()
+    {
+        for (std::size_t i = nextChunk++; i < chunks.size(); i = nextChunk++)
+            parseChunk(chunks[i]);
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < threads && i < chunks.size(); i++)
+        workers.emplace_back(worker);
+    worker();
+    for (std::thread& t : workers)
+        t.join();
+
+    std::size_t rejected = 0;
+    for (Chunk& chunk : chunks)
+    {
+        entries.insert(entries.end(),
+                       std::make_move_iterator(chunk.entries.begin()),
+                       std::make_move_iterator(chunk.entries.end()));
+        rejected += chunk.rejected;
+    }
+
+    return rejected;
+}
+
+void
+DSOProperties::set(std::string_view key, double value)
+{
+    m_properties.addValue(key, Value(value));
+}
+
+void
+DSOProperties::set(std::string_view key, std::string_view value)
+{
+    m_properties.addValue(key, Value(value));
+}
+
+void
+DSOProperties::setOrientation(const Eigen::Quaterniond& orientation)
+{
+    Eigen::AngleAxisd axisAngle(orientation);
+    auto axis = std::make_unique<ValueArray>();
+    axis->reserve(3);
+    for (int i = 0; i < 3; i++)
+        axis->emplace_back(axisAngle.axis()[i]);
+    m_properties.addValue("Axis", Value(std::move(axis)));
+    m_properties.addValue("Angle", Value(celmath::radToDeg(axisAngle.angle())));
+}
+
+bool
+DSOProperties::makeEntry(std::string_view objType, std::string_view name,
+                         engine::DSOsDatEntry& entry) const
+{
+    if (!engine::readDSCEntry(objType, &m_properties, entry))
+        return false;
+    entry.name = name;
+    return true;
+}
+
+Eigen::Quaterniond
+DSOOrientation(double ra, double dec, double positionAngle, double inclination)
+{
+    // Rotations of the object's frame as composed by deepsky.pl
+    constexpr double Obliquity = 23.4392911;
+    Eigen::Quaterniond decRotation(Eigen::AngleAxisd(celmath::degToRad(90.0 - dec), Eigen::Vector3d::UnitX()));
+    Eigen::Quaterniond raRotation(Eigen::AngleAxisd(celmath::degToRad(90.0 - ra * 15.0), Eigen::Vector3d::UnitY()));
+    Eigen::Quaterniond paRotation(Eigen::AngleAxisd(celmath::degToRad(positionAngle), Eigen::Vector3d::UnitY()));
+    Eigen::Quaterniond incRotation(Eigen::AngleAxisd(celmath::degToRad(inclination), Eigen::Vector3d::UnitZ()));
+    Eigen::Quaterniond eclipticRotation(Eigen::AngleAxisd(celmath::degToRad(Obliquity), Eigen::Vector3d::UnitX()));
+    return (incRotation * paRotation * decRotation * raRotation * eclipticRotation).normalized();
+}
+
+double
+DiskInclination(double axisRatio)
+{
+    // Intrinsic axis ratio of 0.2, as taken by deepsky.pl
+    double w = (axisRatio * axisRatio - 0.04) / 0.96;
+    if (w <= 1.0e-8)
+        return 90.0;
+    return 3.0 + celmath::radToDeg(std::acos(std::sqrt(std::min(w, 1.0))));
+}
+
+double
+ComovingDistance(double z)
+{
+    constexpr double H0 = HUBBLE_CONSTANT;
+    constexpr double SpeedOfLight = 299792.458;
+    constexpr double OmegaMatter = 0.27;
+    constexpr double OmegaLambda = 0.73;
+    constexpr double OmegaRadiation = 0.4165 / (H0 * H0);
+    constexpr double OmegaCurvature = 1.0 - OmegaMatter - OmegaRadiation - OmegaLambda;
+    constexpr int Steps = 50;
+
+    // Midpoint rule integral over a = 1/(1 + z) from az to 1
+    double az = 1.0 / (1.0 + z);
+    double sum = 0.0;
+    for (int i = 0; i < Steps; i++)
+    {
+        double a = az + (1.0 - az) * (i + 0.5) / Steps;
+        double adot = std::sqrt(OmegaCurvature + OmegaMatter / a + OmegaRadiation / (a * a) + OmegaLambda * a * a);
+        sum += 1.0 / (a * adot);
+    }
+
+    return LY_PER_PARSEC<double> * 1.0e6 * SpeedOfLight / H0 * (1.0 - az) * sum / Steps;
+}
+
+std::string
+StandardizeName(std::string_view name)
+{
+    name = trim(name);
+    auto prefixEnd = std::find_if(name.begin(), name.end(), [](char c) { return !std::isalpha(static_cast<unsigned char>(c)); });
+    std::string_view prefix = name.substr(0, static_cast<std::size_t>(prefixEnd - name.begin()));
+    std::string_view number = trim(name.substr(prefix.size()));
+    if (prefix.empty() || number.empty() || !std::isdigit(static_cast<unsigned char>(number.front())))
+        return std::string(name);
+
+    while (number.size() > 1 && number.front() == '0' && std::isdigit(static_cast<unsigned char>(number[1])))
+        number.remove_prefix(1);
+
+    // Abbreviations of the RC3 and the NED
+    constexpr std::array<std::pair<std::string_view, std::string_view>, 6> Abbreviations
+    {
+        std::pair("N", "NGC"), std::pair("I", "IC"), std::pair("U", "UGC"),
+        std::pair("UA", "UGCA"), std::pair("E", "ESO"), std::pair("D", "DDO"),
+    };
+    for (const auto& [abbreviation, catalog] : Abbreviations)
+    {
+        if (prefix == abbreviation)
+        {
+            prefix = catalog;
+            break;
+        }
+    }
+
+    std::string result(prefix);
+    result += ' ';
+    result += number;
+    return result;
+}
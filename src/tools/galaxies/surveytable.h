@@ -0,0 +1,129 @@
+// surveytable.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Reading of the survey tables the deep sky catalog generators take, and
+// the geometry they share.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+#include <celcompat/filesystem.h>
+#include <celengine/dsosdat.h>
+#include <celengine/hash.h>
+#include <celengine/value.h>
+
+namespace celestia::util
+{
+class MappedFile;
+}
+
+// One data row of a survey table; fields refer to the mapped table.
+class SurveyRow
+{
+ public:
+    SurveyRow(std::size_t line, const std::vector<std::string_view>& fields) :
+        m_line(line), m_fields(fields)
+    {}
+
+    std::size_t line() const { return m_line; }
+
+    // The trimmed field, empty when column is -1 or the row is short
+    std::string_view text(int column) const;
+    std::optional<double> number(int column) const;
+    // A decimal or sexagesimal angle, in the unit of its first part: both
+    // 12 34 56.7 and 12:34:56.7 are 12.5824
+    std::optional<double> angle(int column) const;
+
+ private:
+    std::size_t m_line;
+    const std::vector<std::string_view>& m_fields;
+};
+
+// A delimited table with a header row naming its columns, as exported by
+// VizieR or the HyperLEDA and IRSA query pages. The delimiter is the first
+// of |, tab, ; and , found in the header; lines starting with # and the
+// VizieR unit and separator lines are skipped, and fields are trimmed of
+// spaces and quotes, but a field cannot contain the delimiter.
+class SurveyTable
+{
+ public:
+    // Called for each data row; returns false to leave a row out
+    using RowParser = std::function<bool(const SurveyRow&, celestia::engine::DSOsDatEntry&)>;
+
+    ~SurveyTable();
+
+    SurveyTable(const SurveyTable&) = delete;
+    SurveyTable& operator=(const SurveyTable&) = delete;
+
+    static std::unique_ptr<SurveyTable> open(const fs::path&);
+
+    const std::vector<std::string>& columns() const { return m_columns; }
+
+    // Index of the first of names found in the header, ignoring case, or -1
+    int column(std::initializer_list<std::string_view> names) const;
+    int column(std::string_view name) const { return column({ name }); }
+
+    // Parse the rows on threads threads, appending the entries in the order
+    // of the rows; returns the number of rows left out.
+    std::size_t parse(const RowParser& parser, unsigned int threads,
+                      std::vector<celestia::engine::DSOsDatEntry>& entries) const;
+
+ private:
+    SurveyTable() = default;
+
+    std::unique_ptr<celestia::util::MappedFile> m_file;
+    std::vector<std::string> m_columns;
+    char m_delimiter{ ',' };
+    std::size_t m_bodyOffset{ 0 };
+    std::size_t m_bodyLine{ 0 };
+};
+
+// The properties of one object, read by celestia::engine::readDSCEntry as
+// those of a deep sky catalog entry
+class DSOProperties
+{
+ public:
+    void set(std::string_view key, double value);
+    void set(std::string_view key, std::string_view value);
+    // Axis and Angle of the orientation
+    void setOrientation(const Eigen::Quaterniond&);
+
+    bool makeEntry(std::string_view objType, std::string_view name,
+                   celestia::engine::DSOsDatEntry& entry) const;
+
+ private:
+    Hash m_properties;
+};
+
+// Orientation of an object at ra (hours) and dec (degrees), with the given
+// position angle and inclination in degrees, in ecliptic coordinates
+Eigen::Quaterniond DSOOrientation(double ra, double dec, double positionAngle, double inclination);
+
+// Inclination in degrees of a disk with the axis ratio minor/major
+double DiskInclination(double axisRatio);
+
+// Hubble constant in km/s/Mpc (WMAP 2007, as used by deepsky.pl)
+constexpr double HUBBLE_CONSTANT = 73.2;
+
+// Comoving distance in light years at redshift z, for a flat universe
+// with Omega_matter = 0.27
+double ComovingDistance(double z);
+
+// Catalog designations without the padding zeros: NGC0224 is NGC 224
+std::string StandardizeName(std::string_view name);
@@ -0,0 +1,273 @@
+// makeglobulardb.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Build a binary deep sky database of globular clusters from a table with
+// the columns of the Harris catalog. The clusters get the radii of their
+// mu_V = 25 isophotes from their King profiles, as globulars.pl derives
+// them; the rows are parsed on several threads.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celengine/astro.h>
+#include <celengine/dsosdat.h>
+#include <celmath/mathlib.h>
+#include <celutil/logger.h>
+#include "surveytable.h"
+
+using namespace std;
+using celestia::engine::DSOsDatEntry;
+using celestia::util::CreateLogger;
+
+
+namespace
+{
+
+// Averages over the Harris catalog, used for the clusters lacking values
+constexpr double AverageAbsMag = -6.86;
+constexpr double AverageConcentration = 1.47;
+constexpr double AverageCoreRadius = 0.83; // arcmin
+constexpr double AverageRadius = 40.32;    // ly
+
+struct Options
+{
+    fs::path inputFile;
+    fs::path outputFile;
+    map<string, string> columnNames
+    {
+        { "id",       "ID" },
+        { "name",     "Name" },
+        { "ra",       "RAJ2000" },
+        { "dec",      "DEJ2000" },
+        { "distance", "Rsun" },
+        { "mag",      "MVt" },
+        { "core",     "rc" },
+        { "c",        "c" },
+        { "mu",       "muV" },
+    };
+    unsigned int threads{ max(1u, thread::hardware_concurrency()) };
+};
+
+// Indices of the columns of a table, -1 for those it lacks
+struct Columns
+{
+    int id;
+    int name;
+    int ra;
+    int dec;
+    int distance;
+    int mag;
+    int core;
+    int concentration;
+    int mu;
+};
+
+
+void Usage()
+{
+    cerr << "Usage: makeglobulardb [options] <cluster table> <output dsos.dat>\n";
+    cerr << "  Options:\n";
+    cerr << "    --map <key>=<column>: column to use for a key\n";
+    cerr << "    --threads <count>   : number of threads\n";
+    cerr << "  Keys and their default columns are id (ID), name (Name), ra (RAJ2000,\n";
+    cerr << "  hours), dec (DEJ2000), distance (Rsun, kpc), mag (MVt), core (rc,\n";
+    cerr << "  arcmin), c (c) and mu (muV, central surface brightness).\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[], Options& options)
+{
+    int fileCount = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        string_view arg = argv[i];
+        if (arg.empty() || arg[0] != '-')
+        {
+            if (fileCount == 0)
+                options.inputFile = arg;
+            else if (fileCount == 1)
+                options.outputFile = arg;
+            else
+                return false;
+            fileCount++;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            cerr << "Missing value for " << arg << '\n';
+            return false;
+        }
+
+        string_view value = argv[++i];
+        if (arg == "--map")
+        {
+            auto pos = value.find('=');
+            auto it = options.columnNames.find(string(value.substr(0, pos)));
+            if (pos == string_view::npos || it == options.columnNames.end())
+            {
+                cerr << "Bad column mapping: " << value << '\n';
+                return false;
+            }
+            it->second = value.substr(pos + 1);
+        }
+        else if (arg == "--threads")
+            options.threads = max(1, atoi(value.data()));
+        else
+        {
+            cerr << "Unknown command line switch: " << arg << '\n';
+            return false;
+        }
+    }
+
+    return fileCount == 2;
+}
+
+
+bool findColumns(const SurveyTable& table, const Options& options, Columns& columns)
+{
+    auto find = [&](const string& key) { return table.column(options.columnNames.at(key)); };
+
+    columns.id = find("id");
+    columns.name = find("name");
+    columns.ra = find("ra");
+    columns.dec = find("dec");
+    columns.distance = find("distance");
+    columns.mag = find("mag");
+    columns.core = find("core");
+    columns.concentration = find("c");
+    columns.mu = find("mu");
+
+    bool ok = true;
+    for (auto [key, column] : { pair("id", columns.id), pair("ra", columns.ra), pair("dec", columns.dec),
+                                pair("distance", columns.distance) })
+    {
+        if (column < 0)
+        {
+            cerr << "No " << options.columnNames.at(key) << " column in the table\n";
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+
+// Angular radius of the mu_V = 25 isophote of a King profile, in the unit
+// of the core radius; zero if the center is fainter.
+double isophoteRadius(double coreRadius, double concentration, double centralBrightness)
+{
+    // The profile is (1/sqrt(1 + x^2) - a)^2 at x core radii
+    double a = 1.0 / sqrt(1.0 + pow(10.0, 2.0 * concentration));
+    double f = (1.0 - a) * pow(10.0, 0.2 * centralBrightness - 5.0) + a;
+    double x2 = 1.0 / (f * f) - 1.0;
+    return x2 > 0.0 ? sqrt(x2) * coreRadius : 0.0;
+}
+
+
+bool parseGlobular(const SurveyRow& row, const Columns& columns, DSOsDatEntry& entry)
+{
+    auto ra = row.angle(columns.ra);
+    auto dec = row.angle(columns.dec);
+    auto distanceKpc = row.number(columns.distance);
+    if (!ra.has_value() || !dec.has_value() || !distanceKpc.has_value() || *distanceKpc <= 0.0)
+        return false;
+
+    double distance = *distanceKpc * 1.0e3 * LY_PER_PARSEC<double>;
+    double absMag = row.number(columns.mag).value_or(AverageAbsMag);
+    auto coreRadius = row.number(columns.core);
+    auto concentration = row.number(columns.concentration);
+    auto mu = row.number(columns.mu);
+
+    double radius = AverageRadius;
+    if (coreRadius.has_value() && concentration.has_value() && mu.has_value())
+    {
+        // globulars.pl took the isophote radius for arcminutes rather than
+        // core radii
+        if (double isophote = isophoteRadius(*coreRadius, *concentration, *mu); isophote > 0.0)
+            radius = celmath::degToRad(isophote / 60.0) * distance;
+    }
+
+    string name(row.text(columns.id));
+    if (name.empty())
+        return false;
+    name = StandardizeName(name);
+    if (string_view commonName = row.text(columns.name); !commonName.empty() && commonName != name)
+        name = string(commonName) + ':' + name;
+
+    DSOProperties properties;
+    properties.set("RA", *ra);
+    properties.set("Dec", *dec);
+    properties.set("Distance", distance);
+    properties.set("Radius", radius);
+    properties.set("AbsMag", absMag);
+    properties.set("CoreRadius", coreRadius.value_or(AverageCoreRadius));
+    properties.set("KingConcentration", concentration.value_or(AverageConcentration));
+    properties.setOrientation(DSOOrientation(*ra, *dec, 0.0, 0.0));
+    return properties.makeEntry("Globular", name, entry);
+}
+
+} // end unnamed namespace
+
+
+int main(int argc, char* argv[])
+{
+    CreateLogger();
+
+    Options options;
+    if (!parseCommandLine(argc, argv, options))
+    {
+        Usage();
+        return 1;
+    }
+
+    auto table = SurveyTable::open(options.inputFile);
+    if (table == nullptr)
+        return 1;
+
+    Columns columns;
+    if (!findColumns(*table, options, columns))
+        return 1;
+
+    vector<DSOsDatEntry> entries;
+    size_t skipped = table->parse([&](const SurveyRow& row, DSOsDatEntry& entry)
+                                  {
+                                      return parseGlobular(row, columns, entry);
+                                  },
+                                  options.threads, entries);
+
+    ofstream out(options.outputFile, ios::out | ios::binary);
+    if (!out.good())
+    {
+        cerr << "Error opening " << options.outputFile << '\n';
+        return 1;
+    }
+
+    if (!celestia::engine::writeDSOsDat(out, entries))
+    {
+        cerr << "Error writing " << options.outputFile << '\n';
+        return 1;
+    }
+
+    cout << entries.size() << " globular clusters written";
+    if (skipped != 0)
+        cout << ", " << skipped << " rows without the needed values skipped";
+    cout << '\n';
+
+    return 0;
+}
@@ -7,9 +7,12 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 //
-// Create a Celestia xyzv file from a pool of SPICE SPK files
+// Create Celestia xyzv files from pools of SPICE SPK files
 
 #include "SpiceUsr.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -18,11 +21,15 @@
 #include <iomanip>
 #include <cmath>
 #include <ctime>
-
-#ifndef min
-#define min(a, b) ((a) < (b) ? (a) : (b))
+#include <thread>
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #endif
 
+#include "xyzvwriter.h"
+
 using namespace std;
 
 
@@ -37,6 +44,22 @@ const double MAX_STEP_SIZE = 5 * 86400.0;
 // Units are kilometers
 const double TOLERANCE     = 20.0;
 
+// Steps tried in a row differ by this factor
+const double STEP_FACTOR   = 2.0;
+
+// The step is narrowed down by bisection until the largest step known to
+// be within the tolerance and the smallest one known not to be are this
+// close
+const double STEP_PRECISION = 1.05;
+
+
+enum class OutputFormat
+{
+    Text,
+    Binary,
+    Compressed,
+};
+
 
 class Configuration
 {
@@ -57,6 +80,7 @@ public:
     string observerName;
     string targetName;
     string frameName;
+    string outputName;
     double minStepSize;
     double maxStepSize;
     double tolerance;
@@ -117,6 +141,8 @@ ostream& operator<<(ostream& o, const Vec3d& v)
 class StateVector
 {
 public:
+    StateVector() = default;
+
     // Construct a new StateVector from an array of 6 doubles
     // (as used by SPICE.)
     StateVector(const double v[]) :
@@ -233,32 +259,78 @@ string etToString(double et)
 }
 
 
-void printRecord(ostream& out, double et, const StateVector& state)
+void printRecord(ostream& out, const XYZVSample& sample)
 {
+    const XYZVVector& p = sample.position;
+    const XYZVVector& v = sample.velocity;
+
     // < 1 second error around J2000
-    out << setprecision(12) << et2jd(et) << " ";
+    out << setprecision(12) << sample.t << " ";
 
     // < 1 meter error at 1 billion km
-    out << setprecision(12) << state.position << " ";
+    out << setprecision(12) << p[0] << ' ' << p[1] << ' ' << p[2] << " ";
 
     // < 0.1 mm/s error at 10 km/s
-    out << setprecision(8) << state.velocity << endl;
+    out << setprecision(8) << v[0] << ' ' << v[1] << ' ' << v[2] << '\n';
+}
+
+
+XYZVSample toSample(double et, const StateVector& state)
+{
+    const Vec3d& p = state.position;
+    const Vec3d& v = state.velocity;
+    return XYZVSample{ et2jd(et), { p.x, p.y, p.z }, { v.x, v.y, v.z } };
 }
 
 
-StateVector getStateVector(SpiceInt targetID,
-                           double et,
-                           const string& frameName,
-                           SpiceInt observerID)
+// Evaluates the states of a target relative to the observer
+class StateSource
 {
-    double stateVector[6];
-    double lightTime = 0.0;
+public:
+    StateSource(SpiceInt _targetID, SpiceInt _observerID, const string& _frameName) :
+        targetID(_targetID), observerID(_observerID), frameName(_frameName)
+    {
+    }
 
-    spkgeo_c(targetID, et, frameName.c_str(), observerID,
-             stateVector, &lightTime);
+    StateVector getState(double et)
+    {
+        double stateVector[6];
+        double lightTime = 0.0;
 
-    return StateVector(stateVector);
-}
+        spkgeo_c(targetID, et, frameName.c_str(), observerID,
+                 stateVector, &lightTime);
+        ++evaluations;
+
+        return StateVector(stateVector);
+    }
+
+    // Largest distance between the positions at a quarter, half and three
+    // quarters of the way from t0 to t1 and the cubic Hermite interpolation
+    // of the states at t0 and t1; the state at t1 is returned in s1.
+    double getInterpolationError(double t0, const StateVector& s0, double t1, StateVector& s1)
+    {
+        s1 = getState(t1);
+        double dt = t1 - t0;
+        double error = 0.0;
+        for (double u : { 0.25, 0.5, 0.75 })
+        {
+            Vec3d pTest = getState(t0 + dt * u).position;
+            Vec3d pInterp = cubicInterpolate(s0.position, s0.velocity * dt,
+                                             s1.position, s1.velocity * dt,
+                                             u);
+            error = std::max(error, (pInterp - pTest).length());
+        }
+
+        return error;
+    }
+
+    int evaluations{ 0 };
+
+private:
+    SpiceInt targetID;
+    SpiceInt observerID;
+    string frameName;
+};
 
 
 // Convert a body name to a NAIF ID. Return true if the ID was
@@ -338,17 +410,15 @@ void writeCommentHeader(const Configuration& config,
 }
 
 
-bool convertSpkToXyzv(const Configuration& config,
-                      ostream& out)
+// Choose the smallest number of samples between the start and end dates of
+// the configuration for which cubic Hermite interpolation stays within the
+// tolerance. Each step starts from the previous one, grows or shrinks by
+// STEP_FACTOR until the error changes sides of the tolerance, and is then
+// bisected to the largest step which is within it.
+bool sampleTrajectory(const Configuration& config,
+                      double tolerance,
+                      vector<XYZVSample>& samples)
 {
-    // Load the required SPICE kernels
-    for (vector<string>::const_iterator iter = config.kernelList.begin();
-         iter != config.kernelList.end(); iter++)
-    {
-        string pathname = config.kernelDirectory + "/" + *iter;
-        furnsh_c(pathname.c_str());
-    }
-
     double startET = 0.0;
     double endET = 0.0;
 
@@ -369,92 +439,153 @@ bool convertSpkToXyzv(const Configuration& config,
         return false;
     }
 
-    double startStepSize = config.minStepSize; // samplingParams.startStep;
-    double maxStepSize   = config.maxStepSize; // samplingParams.maxStep;
-    double minStepSize   = config.minStepSize; // samplingParams.minStep;
-    double tolerance     = config.tolerance;   // samplingParams.tolerance;
-    double t = startET;
-    const double stepFactor = 1.25;
-
-    StateVector lastState = getStateVector(targetID, startET, config.frameName, observerID);
-    double et = startET;
-
-    printRecord(out, et, lastState);
+    StateSource source(targetID, observerID, config.frameName);
 
-    int sampCount = 0;
-    int nTests = 0;
+    double t = startET;
+    StateVector lastState = source.getState(t);
+    samples.push_back(toSample(t, lastState));
 
+    double dt = config.minStepSize;
     while (t < endET)
     {
         // Make sure that we don't go past the end of the sample interval
-        maxStepSize = min(maxStepSize, endET - t);
-        double dt = min(maxStepSize, startStepSize * 2.0);
-
-        StateVector s1 = getStateVector(targetID, t + dt, config.frameName, observerID);
-
-        double tmid = t + dt / 2.0;
-        Vec3d pTest = getStateVector(targetID, tmid, config.frameName, observerID).position;
-        Vec3d pInterp = cubicInterpolate(lastState.position,
-                                         lastState.velocity * dt,
-                                         s1.position,
-                                         s1.velocity * dt,
-                                         0.5);
-        nTests++;
-
-        double positionError = (pInterp - pTest).length();
-
-        // Error is greater than tolerance; decrease the step until the
-        // error is within the tolerance.
-        if (positionError > tolerance)
+        double maxStepSize = min(config.maxStepSize, endET - t);
+        double minStepSize = min(config.minStepSize, maxStepSize);
+        auto endOfStep = [&](double step) { return step >= endET - t ? endET : t + step; };
+
+        // The good step is within the tolerance, the bad one isn't
+        double goodStep = 0.0;
+        double badStep = 0.0;
+        StateVector goodState;
+        StateVector state;
+
+        dt = std::clamp(dt * STEP_FACTOR, minStepSize, maxStepSize);
+        if (source.getInterpolationError(t, lastState, endOfStep(dt), state) <= tolerance)
         {
-            while (positionError > tolerance && dt > minStepSize)
+            goodStep = dt;
+            goodState = state;
+            while (goodStep < maxStepSize)
             {
-                dt /= stepFactor;
-
-                s1 = getStateVector(targetID, t + dt, config.frameName, observerID);
-
-                tmid = t + dt / 2.0;
-                Vec3d pTest = getStateVector(targetID, tmid, config.frameName, observerID).position;
-                pInterp = cubicInterpolate(lastState.position,
-                                           lastState.velocity * dt,
-                                           s1.position,
-                                           s1.velocity * dt,
-                                           0.5);
-                nTests++;
-
-                positionError = (pInterp - pTest).length();
+                dt = min(goodStep * STEP_FACTOR, maxStepSize);
+                if (source.getInterpolationError(t, lastState, endOfStep(dt), state) > tolerance)
+                {
+                    badStep = dt;
+                    break;
+                }
+                goodStep = dt;
+                goodState = state;
             }
         }
         else
         {
-            // Error is less than the tolerance; increase the step size until
-            // the tolerance is just exceeded.
-            while (positionError < tolerance && dt < maxStepSize)
+            badStep = dt;
+            while (goodStep == 0.0)
             {
-                dt *= stepFactor;
-                dt = min(maxStepSize, dt);
+                dt = max(badStep / STEP_FACTOR, minStepSize);
+                if (source.getInterpolationError(t, lastState, endOfStep(dt), state) <= tolerance ||
+                    dt <= minStepSize)
+                {
+                    goodStep = dt;
+                    goodState = state;
+                }
+                else
+                {
+                    badStep = dt;
+                }
+            }
+        }
 
-                s1 = getStateVector(targetID, t + dt, config.frameName, observerID);
+        while (badStep > goodStep * STEP_PRECISION)
+        {
+            dt = std::sqrt(goodStep * badStep);
+            if (source.getInterpolationError(t, lastState, endOfStep(dt), state) <= tolerance)
+            {
+                goodStep = dt;
+                goodState = state;
+            }
+            else
+            {
+                badStep = dt;
+            }
+        }
 
-                tmid = t + dt / 2.0;
-                Vec3d pTest = getStateVector(targetID, tmid, config.frameName, observerID).position;
-                pInterp = cubicInterpolate(lastState.position,
-                                           lastState.velocity * dt,
-                                           s1.position,
-                                           s1.velocity * dt,
-                                           0.5);
+        dt = goodStep;
+        t = endOfStep(goodStep);
+        lastState = goodState;
+        samples.push_back(toSample(t, lastState));
+    }
 
-                nTests++;
+    cerr << config.targetName << ": " << samples.size() << " samples from "
+         << source.evaluations << " SPICE states\n";
 
-                positionError = (pInterp - pTest).length();
-            }
+    return true;
+}
+
+
+bool convertSpkToXyzv(const Configuration& config,
+                      OutputFormat format,
+                      const string& outputName)
+{
+    // Each conversion loads its own kernels
+    kclear_c();
+
+#if defined(_WIN32)
+    furnsh_c("naif0012.tls");
+#else
+    furnsh_c(CONFIG_DATA_DIR "/" "naif0012.tls");
+#endif
+
+    for (vector<string>::const_iterator iter = config.kernelList.begin();
+         iter != config.kernelList.end(); iter++)
+    {
+        string pathname = config.kernelDirectory + "/" + *iter;
+        furnsh_c(pathname.c_str());
+    }
+
+    // Leave room for quantization in compressed files, whose samples are
+    // all kept
+    double tolerance = config.tolerance;
+    if (format == OutputFormat::Compressed)
+        tolerance *= 1.0 - 3.0 * XYZVQuantumFraction;
+
+    vector<XYZVSample> samples;
+    if (!sampleTrajectory(config, tolerance, samples))
+        return false;
+
+    ofstream file;
+    if (!outputName.empty())
+    {
+        file.open(outputName, format == OutputFormat::Text ? ios::out : ios::out | ios::binary);
+        if (!file)
+        {
+            cerr << "Error opening output file " << outputName << ".\n";
+            return false;
         }
+    }
+    ostream& out = outputName.empty() ? cout : file;
 
-        t = t + dt;
-        lastState = s1;
+    bool written = false;
+    switch (format)
+    {
+    case OutputFormat::Text:
+        writeCommentHeader(config, out);
+        for (const XYZVSample& sample : samples)
+            printRecord(out, sample);
+        written = out.good();
+        break;
+    case OutputFormat::Binary:
+        written = WriteXYZVBinary(out, samples, true);
+        break;
+    case OutputFormat::Compressed:
+        written = WriteXYZVCompressed(out, samples, config.tolerance, false);
+        break;
+    }
 
-        printRecord(out, t, lastState);
-        sampCount++;
+    out.flush();
+    if (!written || !out.good())
+    {
+        cerr << "Error writing " << (outputName.empty() ? string("output") : outputName) << ".\n";
+        return false;
     }
 
     return true;
@@ -512,6 +643,11 @@ bool readConfig(istream& in, Configuration& config)
             {
                 in >> config.tolerance;
             }
+            else if (key == "Output")
+            {
+                if (in >> qs)
+                    config.outputName = qs.value;
+            }
             else if (key == "KernelDirectory")
             {
                 if (in >> qs)
@@ -532,70 +668,190 @@ bool readConfig(istream& in, Configuration& config)
 }
 
 
-int main(int argc, char* argv[])
+// Check that all required parameters are present.
+bool checkConfig(const Configuration& config, const string& filename)
 {
-    if (argc < 2)
+    const char* missing = nullptr;
+    if (config.startDate.empty())
+        missing = "StartDate";
+    else if (config.endDate.empty())
+        missing = "EndDate";
+    else if (config.targetName.empty())
+        missing = "Target";
+    else if (config.observerName.empty())
+        missing = "Observer";
+    else if (config.kernelList.empty())
+        missing = "Kernels";
+
+    if (missing != nullptr)
     {
-        cerr << "Usage: spice2xyzv <config filename> [output filename]\n";
-        return 1;
+        cerr << missing << " missing from configuration file " << filename << ".\n";
+        return false;
     }
 
+    return true;
+}
 
-    ifstream configFile(argv[1]);
-    if (!configFile)
-    {
-        cerr << "Error opening configuration file.\n";
-        return 1;
-    }
 
+// Name of the output of a configuration file: the Output parameter, or the
+// name of the file with the extension of the format.
+string getOutputName(const Configuration& config, const string& configFilename, OutputFormat format)
+{
+    if (!config.outputName.empty())
+        return config.outputName;
+
+    string name = configFilename;
+    string::size_type slash = name.find_last_of("/\\");
+    string::size_type dot = name.rfind('.');
+    if (dot != string::npos && (slash == string::npos || dot > slash))
+        name.erase(dot);
 
+    return name + (format == OutputFormat::Text ? ".xyzv" : ".xyzvbin");
+}
+
+
+struct Job
+{
     Configuration config;
-    if (!readConfig(configFile, config))
-    {
-        cerr << "Error in configuration file.\n";
-        return 1;
-    }
+    string outputName;
+};
 
-    // Check that all required parameters are present.
-    if (config.startDate.empty())
-    {
-        cerr << "StartDate missing from configuration file.\n";
-        return 1;
-    }
 
-    if (config.endDate.empty())
+// The SPICE kernel pool is shared by the whole process, so conversions run
+// in parallel in processes of their own.
+bool runJobs(const vector<Job>& jobs, OutputFormat format, unsigned int maxProcesses)
+{
+    bool succeeded = true;
+#ifndef _WIN32
+    if (maxProcesses > 1 && jobs.size() > 1)
     {
-        cerr << "EndDate missing from configuration file.\n";
-        return 1;
+        unsigned int running = 0;
+        for (std::size_t next = 0; next < jobs.size() || running > 0;)
+        {
+            if (next < jobs.size() && running < maxProcesses)
+            {
+                const Job& job = jobs[next++];
+                cout.flush();
+                pid_t pid = fork();
+                if (pid == 0)
+                {
+                    bool converted = convertSpkToXyzv(job.config, format, job.outputName);
+                    std::exit(converted ? 0 : 1);
+                }
+
+                if (pid > 0)
+                    ++running;
+                else
+                    succeeded = convertSpkToXyzv(job.config, format, job.outputName) && succeeded;
+                continue;
+            }
+
+            int status = 0;
+            if (wait(&status) < 0)
+                return false;
+            --running;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                succeeded = false;
+        }
+
+        return succeeded;
     }
+#endif
+
+    for (const Job& job : jobs)
+        succeeded = convertSpkToXyzv(job.config, format, job.outputName) && succeeded;
+
+    return succeeded;
+}
+
+
+void usage()
+{
+    cerr << "Usage: spice2xyzv [options] <config filename> [<config filename>...]\n";
+    cerr << "   --binary (or -b)        : write binary xyzv files\n";
+    cerr << "   --compress (or -c)      : write compressed binary xyzv files\n";
+    cerr << "   --output (or -o) <file> : output file of a single configuration\n";
+    cerr << "   --jobs (or -j) <count>  : configurations converted at the same time\n";
+    cerr << "A single text xyzv file is written to standard output unless --output\n";
+    cerr << "or Output is given; otherwise each file is named after its configuration.\n";
+}
+
+
+int main(int argc, char* argv[])
+{
+    OutputFormat format = OutputFormat::Text;
+    string outputName;
+    unsigned int maxProcesses = max(1u, std::thread::hardware_concurrency());
+    vector<string> configFilenames;
 
-    if (config.targetName.empty())
+    for (int i = 1; i < argc; i++)
     {
-        cerr << "Target missing from configuration file.\n";
-        return 1;
+        if (!strcmp(argv[i], "-b") || !strcmp(argv[i], "--binary"))
+        {
+            format = OutputFormat::Binary;
+        }
+        else if (!strcmp(argv[i], "-c") || !strcmp(argv[i], "--compress"))
+        {
+            format = OutputFormat::Compressed;
+        }
+        else if ((!strcmp(argv[i], "-o") || !strcmp(argv[i], "--output")) && i + 1 < argc)
+        {
+            outputName = argv[++i];
+        }
+        else if ((!strcmp(argv[i], "-j") || !strcmp(argv[i], "--jobs")) && i + 1 < argc)
+        {
+            int count = atoi(argv[++i]);
+            if (count < 1)
+            {
+                usage();
+                return 1;
+            }
+            maxProcesses = static_cast<unsigned int>(count);
+        }
+        else if (argv[i][0] == '-')
+        {
+            usage();
+            return 1;
+        }
+        else
+        {
+            configFilenames.push_back(argv[i]);
+        }
     }
 
-    if (config.observerName.empty())
+    if (configFilenames.empty() || (!outputName.empty() && configFilenames.size() > 1))
     {
-        cerr << "Observer missing from configuration file.\n";
+        usage();
         return 1;
     }
 
-    if (config.kernelList.empty())
+    vector<Job> jobs;
+    for (const string& filename : configFilenames)
     {
-        cerr << "Kernels missing from configuration file.\n";
-        return 1;
-    }
+        ifstream configFile(filename);
+        if (!configFile)
+        {
+            cerr << "Error opening configuration file " << filename << ".\n";
+            return 1;
+        }
 
-    // Load the leap second kernel
-#if defined(_WIN32)
-    furnsh_c("naif0012.tls");
-#else
-    furnsh_c(CONFIG_DATA_DIR "/" "naif0012.tls");
-#endif
+        Job job;
+        if (!readConfig(configFile, job.config))
+        {
+            cerr << "Error in configuration file " << filename << ".\n";
+            return 1;
+        }
+
+        if (!checkConfig(job.config, filename))
+            return 1;
 
-    writeCommentHeader(config, cout);
-    convertSpkToXyzv(config, cout);
+        if (!outputName.empty())
+            job.outputName = outputName;
+        else if (configFilenames.size() > 1 || format != OutputFormat::Text || !job.config.outputName.empty())
+            job.outputName = getOutputName(job.config, filename, format);
+
+        jobs.push_back(std::move(job));
+    }
 
-    return 0;
+    return runJobs(jobs, format, maxProcesses) ? 0 : 1;
 }
@@ -9,15 +9,19 @@
 
 #include <string>
 #include <vector>
-#include <map>
+#include <unordered_map>
+#include <queue>
+#include <memory>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
 #include <iostream>
 #include <fstream>
-#include <random>
 #include <cstdio>
-#include <cassert>
 #include <unistd.h>
 #include <config.h>
+#include <celcompat/filesystem.h>
 #include "celengine/stardb.h"
 
 using namespace std;
@@ -42,6 +46,7 @@ static const int TycStarRecordLength = 351;
 static uint32_t NullCCDMIdentifier = 0xffffffff;
 static uint32_t NullCatalogNumber = 0xffffffff;
 static int verbose, dropstars;
+static bool createCompanions = false;
 
 
 class HipparcosStar
@@ -164,46 +169,11 @@ void HipparcosStar::analyze()
     }
 }
 
-
-bool operator<(const HipparcosStar& a, const HipparcosStar& b)
-{
-    return a.HIPCatalogNumber < b.HIPCatalogNumber;
-}
-
-struct HIPCatalogComparePredicate
-{
-    HIPCatalogComparePredicate()
-    {
-    }
-
-    bool operator()(const HipparcosStar* star0, const HipparcosStar* star1) const
-    {
-        return star0->HIPCatalogNumber < star1->HIPCatalogNumber;
-    }
-
-    bool operator()(const HipparcosStar* star0, uint32_t hip)
-    {
-        return star0->HIPCatalogNumber < hip;
-    }
-
-    int dummy{0};
-};
-
-
-class MultistarSystem
-{
-public:
-    int nStars; // Never greater than four in the HIPPARCOS catalog
-    HipparcosStar* stars[4];
-};
-
-
 class HipparcosComponent
 {
 public:
     HipparcosComponent() = default;
 
-    HipparcosStar* star{nullptr};
     char componentID{'A'};
     char refComponentID{'A'};
     float ascension;
@@ -216,30 +186,6 @@ public:
     float separation{0.0f};
 };
 
-vector<HipparcosStar> stars;
-vector<HipparcosStar> companions;
-vector<HipparcosComponent> components;
-vector<HipparcosStar*> starIndex;
-
-typedef map<uint32_t, MultistarSystem*> MultistarSystemCatalog;
-MultistarSystemCatalog starSystems;
-
-
-HipparcosStar* findStar(uint32_t hip)
-{
-    HIPCatalogComparePredicate pred;
-
-    vector<HipparcosStar*>::iterator iter = lower_bound(starIndex.begin(),
-                                                        starIndex.end(),
-                                                        hip, pred);
-    if (iter == starIndex.end())
-        return nullptr;
-    HipparcosStar* star = *iter;
-    if (star->HIPCatalogNumber == hip)
-        return star;
-
-    return nullptr;
-}
 
 
 StellarClass ParseStellarClass(char *starType)
@@ -436,42 +382,261 @@ StellarClass guessSpectralType(float colorIndex, float /*absMag*/)
 
 
 
-static unsigned int okStars, lineno, changes, tested;
 
-bool CheckStarRecord(istream& in)
+static unsigned int okStars, changes, tested;
+static unsigned int nThreads = max(1u, thread::hardware_concurrency());
+static size_t memoryBudget = size_t(512) << 20;
+static fs::path tempDir;
+
+
+// A record of one of the catalogs, ordered by HIP catalog number and then
+// by its line in the catalog
+template<class T> struct CatalogEntry
 {
-    HipparcosStar star,*hipstar;
-    char buf[HipStarRecordLength];
-    bool ok=true;
+    uint32_t hip;
+    uint32_t line;
+    T record;
 
-    in.read(buf, TycStarRecordLength);
-    lineno++;
+    bool operator<(const CatalogEntry& other) const
+    {
+        return hip < other.hip || (hip == other.hip && line < other.line);
+    }
+};
 
-    if (sscanf(buf + 210, "%u", &star.HIPCatalogNumber) != 1)
+
+// Records sorted in runs which fit in the memory budget, written to
+// temporary files and merged back in order
+template<class T> class ExternalSorter
+{
+public:
+    explicit ExternalSorter(const char* _name) : name(_name)
     {
-        // Not in Hipparcos, skip it.
-        if (verbose>1)
-            cout << "Error reading HIPPARCOS catalog number.\n";
-        return false;
     }
 
-    if (verbose>1)
-        cout << "Testing HIP " << star.HIPCatalogNumber << " from Line " << lineno << " ." << endl;
-    if (!(hipstar=findStar(star.HIPCatalogNumber)))
+    ~ExternalSorter()
     {
-        cout << "Error finding HIP " << star.HIPCatalogNumber << " from Line " << lineno << " ." << endl;
-        return false;
+        error_code ec;
+        for (const auto& path : runs)
+            fs::remove(path, ec);
     }
 
-    if (hipstar->tycline)
+    // Sort the records and write them as a run, emptying the vector. May
+    // be called from several threads.
+    bool writeRun(vector<T>& records)
     {
-        if (verbose>0)
-            cout << "Duplicate Tycho Line for HIP " << star.HIPCatalogNumber << " from Line " << lineno << ", earlier Line at " << hipstar->tycline << " ." << endl;
+        if (records.empty())
+            return true;
+
+        sort(records.begin(), records.end());
+
+        fs::path path;
+        {
+            lock_guard<mutex> lock(runsMutex);
+            path = tempDir / (string("buildstardb-") + name + "-" + to_string(runs.size()) + ".tmp");
+            runs.push_back(path);
+        }
+
+        ofstream out(path, ios::out | ios::binary);
+        out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(T));
+        if (!out.good())
+        {
+            cout << "Error writing " << path << '\n';
+            return false;
+        }
+
+        count += records.size();
+        records.clear();
+        return true;
     }
-    else
-        hipstar->tycline=lineno;
 
-    tested++;
+    size_t size() const { return count; }
+    size_t runCount() const { return runs.size(); }
+
+    // Reads the records of all the runs in order
+    class Merger
+    {
+    public:
+        Merger(const ExternalSorter& sorter, size_t blockSize)
+        {
+            for (const auto& path : sorter.runs)
+            {
+                readers.push_back(make_unique<RunReader>(path, blockSize));
+                fill(readers.size() - 1);
+            }
+        }
+
+        // The next record, or nullptr once all have been read
+        const T* peek() const { return queue.empty() ? nullptr : &queue.top().first; }
+
+        void pop()
+        {
+            size_t run = queue.top().second;
+            queue.pop();
+            fill(run);
+        }
+
+    private:
+        class RunReader
+        {
+        public:
+            RunReader(const fs::path& path, size_t _blockSize) :
+                in(path, ios::in | ios::binary), blockSize(_blockSize)
+            {
+            }
+
+            bool next(T& record)
+            {
+                if (position == block.size())
+                {
+                    block.resize(blockSize);
+                    in.read(reinterpret_cast<char*>(block.data()), blockSize * sizeof(T));
+                    block.resize(static_cast<size_t>(in.gcount()) / sizeof(T));
+                    position = 0;
+                    if (block.empty())
+                        return false;
+                }
+                record = block[position++];
+                return true;
+            }
+
+        private:
+            ifstream in;
+            size_t blockSize;
+            vector<T> block;
+            size_t position{0};
+        };
+
+        using QueueItem = pair<T, size_t>;
+        struct Later
+        {
+            bool operator()(const QueueItem& a, const QueueItem& b) const { return b.first < a.first; }
+        };
+
+        void fill(size_t run)
+        {
+            T record;
+            if (readers[run]->next(record))
+                queue.emplace(record, run);
+        }
+
+        vector<unique_ptr<RunReader>> readers;
+        priority_queue<QueueItem, vector<QueueItem>, Later> queue;
+    };
+
+private:
+    const char* name;
+    mutex runsMutex;
+    vector<fs::path> runs;
+    atomic<size_t> count{0};
+};
+
+
+// Parse the fixed length records of a catalog on several threads into the
+// runs of a sorter. Each thread reads blocks of records at their offset
+// in the file, so the catalog is never held in memory. parse(buf, line,
+// entry) returns false for the records to skip.
+template<class T, class F> bool ParseCatalog(const string& filename,
+                                            int recordLength,
+                                            ExternalSorter<T>& sorter,
+                                            F parse)
+{
+    uint64_t nRecords;
+    {
+        ifstream in(filename, ios::in | ios::binary | ios::ate);
+        if (!in.is_open())
+        {
+            cout << "Error opening " << filename << '\n';
+            cout << "You may download this file from ftp://cdsarc.u-strasbg.fr/cats/I/239/\n";
+            return false;
+        }
+        nRecords = static_cast<uint64_t>(in.tellg()) / recordLength;
+    }
+
+    constexpr uint64_t BlockRecords = 16384;
+    size_t nBlocks = static_cast<size_t>((nRecords + BlockRecords - 1) / BlockRecords);
+    size_t runRecords = max(static_cast<size_t>(BlockRecords), memoryBudget / (sizeof(T) * nThreads));
+
+    atomic<size_t> nextBlock{0};
+    atomic<bool> failed{false};
+    auto worker = [&]()
+    {
+        ifstream in(filename, ios::in | ios::binary);
+        vector<char> buf(BlockRecords * recordLength);
+        vector<T> run;
+        run.reserve(runRecords);
+        for (;;)
+        {
+            size_t block = nextBlock++;
+            if (block >= nBlocks || failed)
+                break;
+
+            uint64_t first = block * BlockRecords;
+            uint64_t count = min(BlockRecords, nRecords - first);
+            in.seekg(first * recordLength);
+            if (!in.read(buf.data(), count * recordLength).good())
+            {
+                cout << "Error reading " << filename << '\n';
+                failed = true;
+                break;
+            }
+
+            for (uint64_t i = 0; i < count; i++)
+            {
+                // Terminate the record in place of its line ending
+                char* record = buf.data() + i * recordLength;
+                record[recordLength - 1] = '\0';
+
+                T entry;
+                if (!parse(record, static_cast<uint32_t>(first + i + 1), entry))
+                    continue;
+                run.push_back(entry);
+                if (run.size() == runRecords && !sorter.writeRun(run))
+                    failed = true;
+            }
+        }
+        if (!sorter.writeRun(run))
+            failed = true;
+    };
+
+    vector<thread> workers;
+    for (unsigned int i = 1; i < min(static_cast<size_t>(nThreads), nBlocks); i++)
+        workers.emplace_back(worker);
+    worker();
+    for (auto& t : workers)
+        t.join();
+
+    return !failed;
+}
+
+
+struct TychoRecord
+{
+    HipparcosStar star;
+    bool hasMag{false};
+    bool hasParallax{false};
+    bool hasPosition{false};
+    bool hasCCDM{false};
+};
+
+
+bool ParseTychoRecord(char* buf, uint32_t line, CatalogEntry<TychoRecord>& entry)
+{
+    TychoRecord& tyc = entry.record;
+    HipparcosStar& star = tyc.star;
+    tyc = TychoRecord();
+
+    if (sscanf(buf + 210, "%u", &star.HIPCatalogNumber) != 1)
+    {
+        // Not in Hipparcos, skip it.
+        if (verbose>1)
+            cout << "Error reading HIPPARCOS catalog number.\n";
+        return false;
+    }
+
+    entry.hip = star.HIPCatalogNumber;
+    entry.line = line;
+    star.tycline = line;
+
     sscanf(buf + 309, "%u", &star.HDCatalogNumber);
 
     if (sscanf(buf + 224, "%f", &star.e_Mag) != 1)
@@ -484,80 +649,61 @@ bool CheckStarRecord(istream& in)
     }
     else if (star.e_Mag >1000.0)
     {
-        cout << "Huge BTmag error for HIP " << star.HIPCatalogNumber << " from Line " << lineno << " ." << endl;
+        cout << "Huge BTmag error for HIP " << star.HIPCatalogNumber << " from Line " << line << " ." << endl;
     }
 
     if (sscanf(buf + 41, "%f", &star.appMag) != 1)
     {
         if (verbose>0)
-            cout << "Error reading magnitude for HIP " << star.HIPCatalogNumber << " from Line " << lineno << " ." << endl;
-    }
-    else if (star.e_Mag < hipstar->e_Mag)
-    {
-        hipstar->appMag=star.appMag;
-        hipstar->e_Mag=star.e_Mag;
-        changes++;
-        if (verbose > 2)
-            cout << "  Change Mag.\n";
+            cout << "Error reading magnitude for HIP " << star.HIPCatalogNumber << " from Line " << line << " ." << endl;
     }
-
-    float parallaxError = 0.0f;
-    if (sscanf(buf + 119, "%f", &parallaxError) != 0)
+    else
     {
-        if (star.parallax < 0.0f || parallaxError / star.parallax > 1.0f)
-            star.parallaxError = 255u;
-        else
-            star.parallaxError = (uint8_t) (parallaxError / star.parallax * 200);
+        tyc.hasMag = true;
     }
 
     if (sscanf(buf + 79, "%f", &star.parallax) != 1)
     {
         if (verbose>0)
-            cout << "Error reading parallax for HIP " << star.HIPCatalogNumber << " from Line " << lineno << " ." << endl;
-        ok=false;
+            cout << "Error reading parallax for HIP " << star.HIPCatalogNumber << " from Line " << line << " ." << endl;
     }
-    else if (star.parallax< 0.0)
+    else
     {
-        if (hipstar->parallax< 0.0)
-        {
-            if (verbose>0)
-                cout << "Negative parallax for HIP " << star.HIPCatalogNumber << " from Line " << lineno << " ." << endl;
-        ok=false;
-        }
+        tyc.hasParallax = true;
     }
-    else if (star.parallaxError < hipstar->parallaxError)
+
+    float parallaxError = 0.0f;
+    if (sscanf(buf + 119, "%f", &parallaxError) != 0)
     {
-        hipstar->parallax=star.parallax;
-        hipstar->parallaxError=star.parallaxError;
-        changes++;
-        if (verbose > 2)
-            cout << "  Change Parallax.\n";
+        if (star.parallax < 0.0f || parallaxError / star.parallax > 1.0f)
+            star.parallaxError = 255u;
+        else
+            star.parallaxError = (uint8_t) (parallaxError / star.parallax * 200);
     }
 
-
     if (sscanf(buf + 105, "%f", &star.e_RA) != 1)
     {
             /* no standard Error givenfor Right Ascension , give it a large
                value so original HIPPARCOS value will be used */
             if (verbose>0)
-                cout << "No RA error for HIP " << star.HIPCatalogNumber << " from Line " << lineno << " ." << endl;
+                cout << "No RA error for HIP " << star.HIPCatalogNumber << " from Line " << line << " ." << endl;
             star.e_RA = 2000.0f;
     }
     else if (star.e_RA >1000.0)
     {
-        cout << "Huge RA error for HIP " << star.HIPCatalogNumber << " from Line " << lineno << " ." << endl;
+        cout << "Huge RA error for HIP " << star.HIPCatalogNumber << " from Line " << line << " ." << endl;
     }
     if (sscanf(buf + 112, "%f", &star.e_DE) != 1)
     {
             /* no standard Error given for Declination, give it a large value
                so original HIPPARCOS value will be used. */
             if (verbose>0)
-                cout << "No DE error for HIP " << star.HIPCatalogNumber << " from Line " << lineno << " ." << endl;
+                cout << "No DE error for HIP " << star.HIPCatalogNumber << " from Line " << line << " ." << endl;
             star.e_DE = 2000.0f;
     }
     else if (star.e_DE >1000.0)
     {
-        cout << "Huge DE error for HIP " << star.HIPCatalogNumber << " from Line " << lineno << " ." << endl;
+        cout << "Huge DE error for HIP " << star.HIPCatalogNumber << " from Line " << line << " ." << endl;
     }
 
     bool coordReadError = false;
@@ -578,7 +724,7 @@ bool CheckStarRecord(istream& in)
         coordReadError=false;
         if (sscanf(buf + 17, "%d %d %f", &hh, &mm, &seconds) != 3)
         {
-            cout << "Error reading ascension for HIP " << star.HIPCatalogNumber << " from Line " << lineno << " ." << endl;
+            cout << "Error reading ascension for HIP " << star.HIPCatalogNumber << " from Line " << line << " ." << endl;
             coordReadError=true;;
         }
         else
@@ -589,7 +735,7 @@ bool CheckStarRecord(istream& in)
             int deg;
             if (sscanf(buf + 29, "%c%d %d %f", &decSign, &deg, &mm, &seconds) != 4)
             {
-                cout << "Error reading declination for HIP " << star.HIPCatalogNumber << " from Line " << lineno << " ." << endl;
+                cout << "Error reading declination for HIP " << star.HIPCatalogNumber << " from Line " << line << " ." << endl;
                 coordReadError=true;;
             }
             else
@@ -600,8 +746,75 @@ bool CheckStarRecord(istream& in)
             }
         }
     }
+    tyc.hasPosition = !coordReadError;
 
-    if (!((coordReadError) || ((star.ascension==hipstar->ascension) && (star.declination==hipstar->declination))))
+    int asc = 0;
+    int dec = 0;
+    char decSign = ' ';
+    if (sscanf(buf + 299, "%d%c%d", &asc, &decSign, &dec) == 3)
+    {
+        if (decSign == '-')
+            dec = -dec;
+        star.CCDMIdentifier = asc << 16 | (dec & 0xffff);
+        tyc.hasCCDM = true;
+    }
+
+    return true;
+}
+
+
+// Use the values of a Tycho record for a Hipparcos star where their error
+// is smaller
+void CheckStarRecord(const TychoRecord& tyc, HipparcosStar* hipstar)
+{
+    const HipparcosStar& star = tyc.star;
+    bool ok=true;
+
+    if (verbose>1)
+        cout << "Testing HIP " << star.HIPCatalogNumber << " from Line " << star.tycline << " ." << endl;
+
+    if (hipstar->tycline)
+    {
+        if (verbose>0)
+            cout << "Duplicate Tycho Line for HIP " << star.HIPCatalogNumber << " from Line " << star.tycline << ", earlier Line at " << hipstar->tycline << " ." << endl;
+    }
+    else
+        hipstar->tycline=star.tycline;
+
+    tested++;
+
+    if (tyc.hasMag && star.e_Mag < hipstar->e_Mag)
+    {
+        hipstar->appMag=star.appMag;
+        hipstar->e_Mag=star.e_Mag;
+        changes++;
+        if (verbose > 2)
+            cout << "  Change Mag.\n";
+    }
+
+    if (!tyc.hasParallax)
+    {
+        ok=false;
+    }
+    else if (star.parallax< 0.0)
+    {
+        if (hipstar->parallax< 0.0)
+        {
+            if (verbose>0)
+                cout << "Negative parallax for HIP " << star.HIPCatalogNumber << " from Line " << star.tycline << " ." << endl;
+        ok=false;
+        }
+    }
+    else if (star.parallaxError < hipstar->parallaxError)
+    {
+        hipstar->parallax=star.parallax;
+        hipstar->parallaxError=star.parallaxError;
+        changes++;
+        if (verbose > 2)
+            cout << "  Change Parallax.\n";
+    }
+
+    if (!((!tyc.hasPosition) || ((star.ascension==hipstar->ascension) && (star.declination==hipstar->declination))))
     {
         float ast=star.e_RA * star.e_DE;
         float ahi=hipstar->e_RA * hipstar->e_DE;
@@ -619,35 +832,21 @@ bool CheckStarRecord(istream& in)
         }
     }
 
-    int asc = 0;
-    int dec = 0;
-    char decSign = ' ';
-    if (sscanf(buf + 299, "%d%c%d", &asc, &decSign, &dec) == 3)
+    if (tyc.hasCCDM && star.CCDMIdentifier != hipstar->CCDMIdentifier)
     {
-        if (decSign == '-')
-            dec = -dec;
-        star.CCDMIdentifier = asc << 16 | (dec & 0xffff);
-
-        if (star.CCDMIdentifier != hipstar->CCDMIdentifier)
-        {
-            cout << "Diffrence in CCDM Identifier for HIP " << star.HIPCatalogNumber << " from Line " << lineno << " ." << endl;
+        cout << "Diffrence in CCDM Identifier for HIP " << star.HIPCatalogNumber << " from Line " << star.tycline << " ." << endl;
         ok=false;
-        }
     }
 
     if (ok)
         okStars++;
-
-    return true;
 }
 
 
-bool ReadStarRecord(istream& in)
+bool ParseStarRecord(char* buf, uint32_t line, CatalogEntry<HipparcosStar>& entry)
 {
-    HipparcosStar star;
-    char buf[HipStarRecordLength];
-
-    in.read(buf, HipStarRecordLength);
+    HipparcosStar& star = entry.record;
+    star = HipparcosStar();
 
     if (sscanf(buf + 8, "%u", &star.HIPCatalogNumber) != 1)
     {
@@ -655,6 +854,9 @@ bool ReadStarRecord(istream& in)
         return false;
     }
 
+    entry.hip = star.HIPCatalogNumber;
+    entry.line = line;
+
     sscanf(buf + 390, "%u", &star.HDCatalogNumber);
     star.tycline=0;
 
@@ -761,7 +963,7 @@ bool ReadStarRecord(istream& in)
     }
     else if (star.e_RA >1000.0)
     {
-        cout << "Huge RA error for HIP " << star.HIPCatalogNumber << " from Line " << lineno << " ." << endl;
+        cout << "Huge RA error for HIP " << star.HIPCatalogNumber << " from Line " << line << " ." << endl;
     }
     if (sscanf(buf + 112, "%f", &star.e_DE) != 1)
     {
@@ -771,7 +973,7 @@ bool ReadStarRecord(istream& in)
     }
     else if (star.e_DE >1000.0)
     {
-        cout << "Huge DE error for HIP " << star.HIPCatalogNumber << " from Line " << lineno << " ." << endl;
+        cout << "Huge DE error for HIP " << star.HIPCatalogNumber << " from Line " << line << " ." << endl;
     }
 
     if (sscanf(buf + 224, "%f", &star.e_Mag) != 1)
@@ -782,35 +984,24 @@ bool ReadStarRecord(istream& in)
     }
     else if (star.e_Mag >1000.0)
     {
-        cout << "Huge BTmag error for HIP " << star.HIPCatalogNumber << " from Line " << lineno << " ." << endl;
+        cout << "Huge BTmag error for HIP " << star.HIPCatalogNumber << " from Line " << line << " ." << endl;
     }
 
-    stars.push_back(star);
-
     return true;
 }
 
 
-bool ReadComponentRecord(istream& in)
+bool ParseComponentRecord(char* buf, uint32_t line, CatalogEntry<HipparcosComponent>& entry)
 {
-    HipparcosComponent component;
-    char buf[HipComponentRecordLength];
-
-    in.read(buf, HipComponentRecordLength);
+    HipparcosComponent& component = entry.record;
+    component = HipparcosComponent();
 
-    uint32_t hip;
-    if (sscanf(buf + 42, "%ud", &hip) != 1)
+    if (sscanf(buf + 42, "%ud", &entry.hip) != 1)
     {
         cout << "Missing HIP catalog number for component.\n";
         return false;
     }
-
-    component.star = findStar(hip);
-    if (component.star == nullptr)
-    {
-        cout << "Nonexistent HIP catalog number for component.\n";
-        return false;
-    }
+    entry.line = line;
 
     if (sscanf(buf + 40, "%c", &component.componentID) != 1)
     {
@@ -872,190 +1063,75 @@ bool ReadComponentRecord(istream& in)
         }
     }
 
-    components.push_back(component);
-
     return true;
 }
 
 
-void BuildMultistarSystemCatalog()
-{
-    for (auto star : stars)
-    {
-        if (star.CCDMIdentifier != NullCCDMIdentifier)
-        {
-            auto it = starSystems.find(star.CCDMIdentifier);
-            if (it == starSystems.end())
-            {
-                MultistarSystem* multiSystem = new MultistarSystem();
-                multiSystem->nStars = 1;
-                multiSystem->stars[0] = &star;
-                starSystems.insert(MultistarSystemCatalog::value_type(star.CCDMIdentifier, multiSystem));
-            }
-            else
-            {
-                MultistarSystem* multiSystem = it->second;
-                if (multiSystem->nStars == 4)
-                {
-                    cout << "Number of stars in system exceeds 4\n";
-                }
-                else
-                {
-                    multiSystem->stars[multiSystem->nStars] = &star;
-                    multiSystem->nStars++;
-                }
-            }
-        }
-    }
-}
-
-
-void ConstrainComponentParallaxes()
+// The companion star of a component which isn't the reference component
+// of its system, or false if it has none
+bool CreateCompanion(const HipparcosComponent& comp, const HipparcosStar& primary, HipparcosStar& star)
 {
-    for (const auto& ss : starSystems)
-    {
-        MultistarSystem* multiSystem = ss.second;
-        if (multiSystem->nStars > 1)
-        {
-            for (int i = 1; i < multiSystem->nStars; i++)
-                multiSystem->stars[i]->parallax = multiSystem->stars[0]->parallax;
-        }
-#if 0
-        if (multiSystem->nStars > 2)
-        {
-            cout << multiSystem->nStars << ": ";
-            if (multiSystem->stars[0]->HDCatalogNumber != NullCatalogNumber)
-                cout << "HD " << multiSystem->stars[0]->HDCatalogNumber;
-            else
-                cout << "HIP " << multiSystem->stars[0]->HIPCatalogNumber;
-            cout << '\n';
-        }
-#endif
-    }
-}
-
+    // Don't insert the reference component, as this star should already
+    // be in the primary database.
+    if (comp.componentID == comp.refComponentID)
+        return false;
 
-void CorrectErrors()
-{
-    for (auto& star : stars)
-    {
-        // Fix the spectral class of Capella, listed for some reason
-        // as M1 in the database.
-        if (star.HDCatalogNumber == 34029)
-        {
-            star.stellarClass = StellarClass(StellarClass::NormalStar,
-                                              StellarClass::Spectral_G, 0,
-                                              StellarClass::Lum_III);
-        }
-    }
-}
+    int componentNumber = comp.componentID - 'A';
+    if (componentNumber <= 0 || componentNumber >= 8)
+        return false;
 
+    star.HDCatalogNumber = NullCatalogNumber;
+    star.HIPCatalogNumber = primary.HIPCatalogNumber |
+        (componentNumber << 25);
 
-// Process the vector of star components and insert those that are companions
-// of stars in the primary database into the companions vector.
-void CreateCompanionList()
-{
-    for (const auto& comp : components)
-    {
-        // Don't insert the reference component, as this star should already
-        // be in the primary database.
-        if (comp.componentID != comp.refComponentID)
-        {
-            int componentNumber = comp.componentID - 'A';
-            if (componentNumber > 0 && componentNumber < 8)
-            {
-                HipparcosStar star;
-
-                star.HDCatalogNumber = NullCatalogNumber;
-                star.HIPCatalogNumber = comp.star->HIPCatalogNumber |
-                    (componentNumber << 25);
-
-                star.ascension = comp.ascension;
-                star.declination = comp.declination;
-                star.parallax = comp.star->parallax;
-                star.appMag = comp.appMag;
-                if (comp.hasBV)
-                    star.stellarClass = guessSpectralType(comp.bMag - comp.vMag, 0.0f);
-                else
-                    star.stellarClass = StellarClass(StellarClass::NormalStar,
-                                                     StellarClass::Spectral_Unknown,
-                                                     0, StellarClass::Lum_V);
+    star.ascension = comp.ascension;
+    star.declination = comp.declination;
+    star.parallax = primary.parallax;
+    star.appMag = comp.appMag;
+    if (comp.hasBV)
+        star.stellarClass = guessSpectralType(comp.bMag - comp.vMag, 0.0f);
+    else
+        star.stellarClass = StellarClass(StellarClass::NormalStar,
+                                         StellarClass::Spectral_Unknown,
+                                         0, StellarClass::Lum_V);
 
-                star.CCDMIdentifier = comp.star->CCDMIdentifier;
-                star.parallaxError = comp.star->parallaxError;
+    star.CCDMIdentifier = primary.CCDMIdentifier;
+    star.parallaxError = primary.parallaxError;
 
-                companions.push_back(star);
-            }
-        }
-    }
+    return true;
 }
 
 
-void ShowStarsWithComponents()
+void CorrectErrors(HipparcosStar& star)
 {
-    cout << "\nStars with >2 components\n";
-    for (auto& star :stars)
+    // Fix the spectral class of Capella, listed for some reason
+    // as M1 in the database.
+    if (star.HDCatalogNumber == 34029)
     {
-        if (star.nComponents > 2)
-        {
-            cout << (int) star.nComponents << ": ";
-            if (star.HDCatalogNumber != NullCatalogNumber)
-                cout << "HD " << star.HDCatalogNumber;
-            else
-                cout << "HIP " << star.HIPCatalogNumber;
-            cout << '\n';
-        }
+        star.stellarClass = StellarClass(StellarClass::NormalStar,
+                                          StellarClass::Spectral_G, 0,
+                                          StellarClass::Lum_III);
     }
 }
 
 
-void CompareTycho()
+void Usage()
 {
-    ifstream tycDatabase(TychoDatabaseFile, ios::in | ios::binary);
-    if (!tycDatabase.is_open())
-    {
-        cout << "Error opening " << TychoDatabaseFile << '\n';
-        cout << "You may download this file from ftp://cdsarc.u-strasbg.fr/cats/I/239/\n";
-        return;
-    }
-
-    int recs=0;
-    cout << "Comparing Tycho data set.\n";
-    okStars=0;
-    lineno=0;
-    changes=0;
-    while (tycDatabase.good())
-    {
-        CheckStarRecord(tycDatabase);
-        if (++recs % 10000 == 0)
-        {
-            if (verbose>=0)
-                cout << recs << " records.\n";
-            else
-                cout << ".";
-            cout.flush();
-        }
-    }
-    if (verbose<0)
-        cout << "\n";
-    else
-        cout << recs  << " records checked, " << tested << " tested,  " << okStars << " checked out OK, and " << changes << " changes were made.\n";
+    cout << "Usage: buildstardb [-v[<verbosity_level>] [-q] [-c] [-d <drop-level>] [-j <threads>] [-m <MiB>] [-t <temporary dir>] [<output file>]\n";
 }
 
 
-
 int main(int argc, char* argv[])
 {
-    assert(sizeof(StellarClass) == 2);
     verbose=0;
     dropstars=1;
     int c;
-    while((c=getopt(argc,argv,"v::qd:"))>-1)
+    while((c=getopt(argc,argv,"v::qcd:j:m:t:"))>-1)
     {
         switch (c)
         {
         case '?':
-            cout << "Usage: buildstardb [-v[<verbosity_level>] [-q] [-d <drop-level>\n";
+            Usage();
             exit(1);
         case 'v':
             if (optarg)
@@ -1079,91 +1155,136 @@ int main(int argc, char* argv[])
             else if (dropstars>2)
                 dropstars=2;
             break;
+        case 'j':
+            nThreads=(unsigned int)max(1L, atol(optarg));
+            break;
+        case 'm':
+            memoryBudget=(size_t)max(16L, atol(optarg)) << 20;
+            break;
+        case 't':
+            tempDir=optarg;
+            break;
+        case 'c':
+            createCompanions=true;
+            break;
         case 'q':
             verbose=-1;
         }
     }
 
-    // Read star records from the primary HIPPARCOS catalog
+    const char* outputFile = "stars.dat";
+    if (argv[optind])
+        outputFile = argv[optind];
+
+    if (tempDir.empty())
     {
-        ifstream mainDatabase(MainDatabaseFile, ios::in | ios::binary);
-        if (!mainDatabase.is_open())
-        {
-            cout << "Error opening " << MainDatabaseFile << '\n';
-            cout << "You may download this file from ftp://cdsarc.u-strasbg.fr/cats/I/239/\n";
-            exit(1);
-        }
+        tempDir = fs::path(outputFile).parent_path();
+        if (tempDir.empty())
+            tempDir = ".";
+    }
+
+    // The catalogs are parsed into sorted runs, which are merged in order
+    // of HIP catalog number
+    ExternalSorter<CatalogEntry<HipparcosStar>> stars("stars");
+    ExternalSorter<CatalogEntry<HipparcosComponent>> components("components");
+    ExternalSorter<CatalogEntry<TychoRecord>> tycho("tycho");
 
+    if (verbose>=0)
         cout << "Reading HIPPARCOS data set.\n";
-        while (mainDatabase.good())
-        {
-            ReadStarRecord(mainDatabase);
-            if (stars.size() % 10000 == 0)
-            {
-                if (verbose>=0)
-                    cout << stars.size() << " records.\n";
-                else
-                    cout << ".";
-                cout.flush();
-            }
-        }
-        if (verbose<0)
-            cout << "\n";
-    }
+    if (!ParseCatalog(MainDatabaseFile, HipStarRecordLength, stars, ParseStarRecord))
+        exit(1);
+
     if (verbose>=0)
     {
         cout << "Read " << stars.size() << " stars from main database.\n";
         cout << "Adding the Sun...\n";
     }
-    stars.push_back(TheSun());
+    {
+        vector<CatalogEntry<HipparcosStar>> sun{ { 0, 0, TheSun() } };
+        if (!stars.writeRun(sun))
+            exit(1);
+    }
 
     if (verbose>=0)
-        cout << "Sorting stars...\n";
-    {
-        starIndex.reserve(stars.size());
-        for (auto star : stars)
-        {
-            starIndex.push_back(&star);
-        }
+        cout << "Reading HIPPARCOS component database.\n";
+    if (!ParseCatalog(ComponentDatabaseFile, HipComponentRecordLength, components, ParseComponentRecord))
+        exit(1);
 
-        HIPCatalogComparePredicate pred;
+    if (verbose>=0)
+        cout << "Reading Tycho data set.\n";
+    bool haveTycho = ParseCatalog(TychoDatabaseFile, TycStarRecordLength, tycho, ParseTychoRecord);
 
-        // It may not even be necessary to sort the records, if the
-        // HIPPARCOS catalog is strictly ordered by catalog number.  I'm not
-        // sure about this however,
-        std::random_device rng;
-        std::mt19937 urng(rng());
-        shuffle(starIndex.begin(), starIndex.end(), urng);
-        sort(starIndex.begin(), starIndex.end(), pred);
+    cout << "Writing processed star records to " << outputFile << '\n';
+    ofstream out(outputFile, ios::out | ios::binary);
+    if (!out.good())
+    {
+        cout << "Error opening " << outputFile << '\n';
+        exit(1);
     }
+    // The star count is written once known
+    binwrite(out, size_t(0));
+
+    // Merge the stars with their components and Tycho records. The stars
+    // of a multiple system get the parallax of the first star of the
+    // system, before it is updated from the Tycho data set.
+    size_t nRuns = stars.runCount() + components.runCount() + tycho.runCount();
+    size_t blockSize = max(size_t(256), memoryBudget / (sizeof(CatalogEntry<TychoRecord>) * max(size_t(1), nRuns)));
+    ExternalSorter<CatalogEntry<HipparcosStar>>::Merger starMerger(stars, blockSize);
+    ExternalSorter<CatalogEntry<HipparcosComponent>>::Merger componentMerger(components, blockSize);
+    ExternalSorter<CatalogEntry<TychoRecord>>::Merger tychoMerger(tycho, blockSize);
 
-    // Read component records
+    struct MultistarSystem
     {
-        ifstream componentDatabase(ComponentDatabaseFile,
-                                   ios::in | ios::binary);
-        if (!componentDatabase.is_open())
-        {
-            cout << "Error opening " << ComponentDatabaseFile << '\n';
-            cout << "You may download this file from ftp://cdsarc.u-strasbg.fr/cats/I/239/\n";
-            exit(1);
-        }
+        int nStars; // Never greater than four in the HIPPARCOS catalog
+        float parallax;
+    };
+    unordered_map<uint32_t, MultistarSystem> starSystems;
+
+    vector<HipparcosStar> companions;
+    vector<HipparcosStar> starsWithComponents;
+    int aComp = 0, bComp = 0, cComp = 0, dComp = 0, eComp = 0, otherComp = 0;
+    int bvComp = 0;
+    size_t nComponents = 0;
+    size_t nStars = 0;
+
+    if (haveTycho)
+        cout << "Comparing Tycho data set.\n";
+    while (const auto* entry = starMerger.peek())
+    {
+        HipparcosStar star = entry->record;
+        uint32_t hip = entry->hip;
+        starMerger.pop();
 
-        if (verbose>=0)
-            cout << "Reading HIPPARCOS component database.\n";
-        while (componentDatabase.good())
+        if (star.CCDMIdentifier != NullCCDMIdentifier)
         {
-            ReadComponentRecord(componentDatabase);
+            auto [it, inserted] = starSystems.try_emplace(star.CCDMIdentifier, MultistarSystem{ 1, star.parallax });
+            MultistarSystem& multiSystem = it->second;
+            if (!inserted)
+            {
+                if (multiSystem.nStars == 4)
+                {
+                    cout << "Number of stars in system exceeds 4\n";
+                }
+                else
+                {
+                    star.parallax = multiSystem.parallax;
+                    multiSystem.nStars++;
+                }
+            }
         }
-    }
-    if (verbose>=0)
-        cout << "Read " << components.size() << " components.\n";
 
-    {
-        int aComp = 0, bComp = 0, cComp = 0, dComp = 0, eComp = 0, otherComp = 0;
-        int bvComp = 0;
-        for (unsigned int i = 0; i < components.size(); i++)
+        CorrectErrors(star);
+
+        for (; componentMerger.peek() != nullptr && componentMerger.peek()->hip <= hip; componentMerger.pop())
         {
-            switch (components[i].componentID)
+            if (componentMerger.peek()->hip < hip)
+            {
+                cout << "Nonexistent HIP catalog number for component.\n";
+                continue;
+            }
+
+            const HipparcosComponent& comp = componentMerger.peek()->record;
+            switch (comp.componentID)
             {
             case 'A':
                 aComp++; break;
@@ -1178,114 +1299,85 @@ int main(int argc, char* argv[])
             default:
                 otherComp++; break;
             }
-            if (components[i].hasBV && components[i].componentID != 'A')
+            if (comp.hasBV && comp.componentID != 'A')
                 bvComp++;
+            nComponents++;
+
+            HipparcosStar companion;
+            if (createCompanions && CreateCompanion(comp, star, companion))
+                companions.push_back(companion);
         }
 
-        if (verbose>=0)
+        for (; tychoMerger.peek() != nullptr && tychoMerger.peek()->hip <= hip; tychoMerger.pop())
         {
-            cout << "A:" << aComp << "  B:" << bComp << "  C:" << cComp << "  D:" << dComp << "  E:" << eComp << '\n';
-            cout << "Components with B-V mag: " << bvComp << '\n';
+            if (tychoMerger.peek()->hip < hip)
+            {
+                cout << "Error finding HIP " << tychoMerger.peek()->hip << " from Line " << tychoMerger.peek()->line << " ." << endl;
+                continue;
+            }
+            CheckStarRecord(tychoMerger.peek()->record, &star);
         }
-    }
 
-    if (verbose>=0)
-        cout << "Building catalog of multiple star systems.\n";
-    BuildMultistarSystemCatalog();
+        if (verbose>0 && star.nComponents > 2)
+            starsWithComponents.push_back(star);
 
-    int nMultipleSystems = starSystems.size();
-    if (verbose>=0)
-        cout << "Stars in multiple star systems: " << nMultipleSystems << '\n';
-
-    ConstrainComponentParallaxes();
-
-    CorrectErrors();
+        star.analyze();
+        star.write(out);
+        nStars++;
+    }
 
-    CompareTycho();
+    for (; tychoMerger.peek() != nullptr; tychoMerger.pop())
+        cout << "Error finding HIP " << tychoMerger.peek()->hip << " from Line " << tychoMerger.peek()->line << " ." << endl;
+    for (; componentMerger.peek() != nullptr; componentMerger.pop())
+        cout << "Nonexistent HIP catalog number for component.\n";
 
-    // CreateCompanionList();
-    if (verbose>=0)
+    for (auto& comp : companions)
     {
-        cout << "Companion stars: " << companions.size() << '\n';
-        cout << "Total stars: " << stars.size() + companions.size() << '\n';
+        comp.analyze();
+        comp.write(out);
     }
 
-    if (verbose>0)
-        ShowStarsWithComponents();
-
-    const char* outputFile = "stars.dat";
-    if (argv[optind])
-        outputFile = argv[optind];
-
-    cout << "Writing processed star records to " << outputFile << '\n';
-    ofstream out(outputFile, ios::out | ios::binary);
-    if (!out.good())
+    if (verbose>=0)
     {
-        cout << "Error opening " << outputFile << '\n';
-        exit(1);
-    }
+        cout << "Read " << nComponents << " components.\n";
+        cout << "A:" << aComp << "  B:" << bComp << "  C:" << cComp << "  D:" << dComp << "  E:" << eComp << '\n';
+        cout << "Components with B-V mag: " << bvComp << '\n';
+        cout << "Stars in multiple star systems: " << starSystems.size() << '\n';
+        if (haveTycho)
+            cout << tycho.size() << " records checked, " << tested << " tested,  " << okStars << " checked out OK, and " << changes << " changes were made.\n";
+        cout << "Companion stars: " << companions.size() << '\n';
+        cout << "Total stars: " << nStars + companions.size() << '\n';
 
-    s_er=0.0; // Zero the statistics values
-    s_erq=0.0;
-    n_er=0;
-    s_er=0.0;
-    s_erq=0.0;
-    n_er=0;
-    n_drop=0;
-    n_dub=0;
-    {
-        for (auto& star : stars)
-            star.analyze();
-        for (auto& comp : companions)
-            comp.analyze();
-        binwrite(out, stars.size() + companions.size() - n_drop);
         float av_r,av_d; // average Right Ascension/Declination
         av_r=s_er/((float)n_er);
         av_d=s_ed/((float)n_ed);
-        if (verbose>=0)
+        cout << "RA Error average: " << av_r << " with Standard Error: " << sqrt((s_erq+(square(s_er)/n_er) - (2*av_r*s_er))/(n_er-1)) << " .\n";
+        cout << "DE Error average: " << av_d << " with Standard Error: " << sqrt((s_edq+(square(s_ed)/n_ed) - (2*av_d*s_ed))/(n_ed-1)) << " .\n";
+    }
+
+    if (verbose>0)
+    {
+        cout << "\nStars with >2 components\n";
+        for (const auto& star : starsWithComponents)
         {
-            cout << "RA Error average: " << av_r << " with Standard Error: " << sqrt((s_erq+(square(s_er)/n_er) - (2*av_r*s_er))/(n_er-1)) << " .\n";
-            cout << "DE Error average: " << av_d << " with Standard Error: " << sqrt((s_edq+(square(s_ed)/n_ed) - (2*av_d*s_ed))/(n_ed-1)) << " .\n";
+            cout << (int) star.nComponents << ": ";
+            if (star.HDCatalogNumber != NullCatalogNumber)
+                cout << "HD " << star.HDCatalogNumber;
+            else
+                cout << "HIP " << star.HIPCatalogNumber;
+            cout << '\n';
         }
-        for (auto& star : stars)
-            star.write(out);
-        for (auto& comp : companions)
-            comp.write(out);
     }
-    cout << "Stars processed: " << stars.size() + companions.size() << "   Number dropped: " << n_drop << "  number dubious: " << n_dub << " .\n";
-
-#if 0
-    char* hdOutputFile = "hdxref.dat";
 
-    cout << "Writing out HD cross reference to " << hdOutputFile << '\n';
-    ofstream hdout(hdOutputFile, ios::out | ios::binary);
+    out.seekp(0);
+    binwrite(out, nStars + companions.size() - n_drop);
     if (!out.good())
     {
-        cout << "Error opening " << hdOutputFile << '\n';
+        cout << "Error writing " << outputFile << '\n';
         exit(1);
     }
 
-    {
-        int nHD = 0;
-        for (const auto& star: stars)
-        {
-            if (star.HDCatalogNumber != NullCatalogNumber)
-                nHD++;
-        }
-        binwrite(hdout, nHD);
-
-        cout << nHD << " stars have HD numbers.\n";
-
-        for (const auto& star: stars)
-        {
-            if (star.HDCatalogNumber != NullCatalogNumber)
-            {
-                binwrite(hdout, star.HDCatalogNumber);
-                binwrite(hdout, star.HIPCatalogNumber);
-            }
-        }
-    }
-#endif
+    cout << "Stars processed: " << nStars + companions.size() << "   Number dropped: " << n_drop << "  number dubious: " << n_dub << " .\n";
 
     return 0;
 }
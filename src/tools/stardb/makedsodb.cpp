@@ -0,0 +1,68 @@
+// makedsodb.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Compile deep sky catalog files to the binary format, which Celestia
+// reads at startup instead of parsing the catalogs.
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <celengine/dsosdat.h>
+
+using namespace std;
+using celestia::engine::DSOsDatEntry;
+
+
+void Usage()
+{
+    cerr << "Usage: makedsodb <input deep sky catalog files...> <output deep sky database>\n";
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        Usage();
+        return 1;
+    }
+
+    vector<DSOsDatEntry> entries;
+    for (int i = 1; i < argc - 1; ++i)
+    {
+        ifstream in(argv[i], ios::in);
+        if (!in.good())
+        {
+            cerr << "Error opening input file " << argv[i] << '\n';
+            return 1;
+        }
+
+        if (!celestia::engine::readDSCEntries(in, entries))
+        {
+            cerr << "Error reading deep sky catalog " << argv[i] << '\n';
+            return 1;
+        }
+    }
+
+    ofstream out(argv[argc - 1], ios::out | ios::binary);
+    if (!out.good())
+    {
+        cerr << "Error opening output file " << argv[argc - 1] << '\n';
+        return 1;
+    }
+
+    if (!celestia::engine::writeDSOsDat(out, entries))
+    {
+        cerr << "Error writing deep sky database " << argv[argc - 1] << '\n';
+        return 1;
+    }
+
+    cout << "Wrote " << entries.size() << " deep sky objects\n";
+    return 0;
+}
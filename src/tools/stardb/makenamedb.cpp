@@ -0,0 +1,63 @@
+// makenamedb.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Compile a star names file to the binary format, which Celestia maps
+// at startup instead of parsing the names.
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <celengine/starname.h>
+
+using namespace std;
+
+
+void Usage()
+{
+    cerr << "Usage: makenamedb <input star names file> <output name database>\n";
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        Usage();
+        return 1;
+    }
+
+    ifstream in(argv[1], ios::in);
+    if (!in.good())
+    {
+        cerr << "Error opening input file " << argv[1] << '\n';
+        return 1;
+    }
+
+    unique_ptr<StarNameDatabase> namesDB(StarNameDatabase::readNames(in));
+    if (namesDB == nullptr)
+    {
+        cerr << "Error reading star names " << argv[1] << '\n';
+        return 1;
+    }
+
+    ofstream out(argv[2], ios::out | ios::binary);
+    if (!out.good())
+    {
+        cerr << "Error opening output file " << argv[2] << '\n';
+        return 1;
+    }
+
+    if (!namesDB->writeBinary(out))
+    {
+        cerr << "Error writing name database " << argv[2] << '\n';
+        return 1;
+    }
+
+    return 0;
+}
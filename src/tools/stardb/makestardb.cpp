@@ -12,11 +12,13 @@
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <sstream>
 #include <cctype>
 #include <cassert>
 #include <celutil/bytes.h>
 #include <celengine/astro.h>
 #include <celengine/star.h>
+#include <celengine/stardb.h>
 
 using namespace std;
 
@@ -24,6 +26,7 @@ using namespace std;
 static string inputFilename;
 static string outputFilename;
 static bool useSphericalCoords = false;
+static bool writeSorted = false;
 
 
 void Usage()
@@ -31,6 +34,7 @@ void Usage()
     cerr << "Usage: makestardb [options] <input file> <output star database>\n";
     cerr << "  Options:\n";
     cerr << "    --spherical (or -s) : input file has spherical coords (RA/dec/distance\n";
+    cerr << "    --sorted (or -S)    : write the stars in octree order, with the octree\n";
 }
 
 
@@ -47,6 +51,10 @@ bool parseCommandLine(int argc, char* argv[])
             {
                 useSphericalCoords = true;
             }
+            else if (!strcmp(argv[i], "--sorted") || !strcmp(argv[i], "-S"))
+            {
+                writeSorted = true;
+            }
             else
             {
                 cerr << "Unknown command line switch: " << argv[i] << '\n';
@@ -235,7 +243,31 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    bool success = WriteStarDatabase(inputFile, stardbFile, useSphericalCoords);
+    if (!writeSorted)
+    {
+        bool success = WriteStarDatabase(inputFile, stardbFile, useSphericalCoords);
+        return success ? 0 : 1;
+    }
+
+    // Build the octree here rather than at every startup, as sortstardb
+    // does for an existing database
+    stringstream unsorted(ios::in | ios::out | ios::binary);
+    if (!WriteStarDatabase(inputFile, unsorted, useSphericalCoords))
+        return 1;
+
+    StarDatabase starDB;
+    if (!starDB.loadBinary(unsorted))
+    {
+        cerr << "Error reading the converted stars\n";
+        return 1;
+    }
+    starDB.finish();
+
+    if (!starDB.writeSortedBinary(stardbFile))
+    {
+        cerr << "Error writing star database " << outputFilename << '\n';
+        return 1;
+    }
 
-    return success ? 0 : 1;
+    return 0;
 }
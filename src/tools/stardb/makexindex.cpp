@@ -13,7 +13,9 @@
 #include <fstream>
 #include <iomanip>
 #include <string>
-#include <celutil/bytes.h>
+#include <utility>
+#include <vector>
+#include <celengine/crossindex.h>
 
 using namespace std;
 
@@ -67,27 +69,9 @@ bool parseCommandLine(int argc, char* argv[])
 }
 
 
-static void writeUint(ostream& out, uint32_t n)
-{
-    LE_TO_CPU_INT32(n, n);
-    out.write(reinterpret_cast<const char*>(&n), sizeof n);
-}
-
-
-static void writeShort(ostream& out, int16_t n)
-{
-    LE_TO_CPU_INT16(n, n);
-    out.write(reinterpret_cast<const char*>(&n), sizeof n);
-}
-
-
 bool WriteCrossIndex(istream& in, ostream& out)
 {
-    // Write the header
-    out.write("CELINDEX", 8);
-
-    // Write the version
-    writeShort(out, 0x0100);
+    vector<CrossIndex::Entry> entries;
 
     unsigned int record = 0;
     while (!in.eof())
@@ -97,7 +81,7 @@ bool WriteCrossIndex(istream& in, ostream& out)
 
         in >> catalogNumber;
         if (in.eof())
-            return true;
+            break;
 
         in >> celCatalogNumber;
         if (!in.good())
@@ -106,13 +90,13 @@ bool WriteCrossIndex(istream& in, ostream& out)
             return false;
         }
 
-        writeUint(out, (uint32_t) catalogNumber);
-        writeUint(out, (uint32_t) celCatalogNumber);
+        entries.push_back({ (uint32_t) catalogNumber, (uint32_t) celCatalogNumber });
 
         record++;
     }
 
-    return true;
+    // Written sorted by both numbers, for Celestia to map
+    return CrossIndex::write(out, std::move(entries));
 }
 
 
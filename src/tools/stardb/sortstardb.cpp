@@ -0,0 +1,63 @@
+// sortstardb.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Convert a binary star database to the sorted format, which stores the
+// star octree so that Celestia doesn't need to build it at startup.
+
+#include <fstream>
+#include <iostream>
+#include <celengine/stardb.h>
+
+using namespace std;
+
+
+void Usage()
+{
+    cerr << "Usage: sortstardb <input star database> <output star database>\n";
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        Usage();
+        return 1;
+    }
+
+    ifstream in(argv[1], ios::in | ios::binary);
+    if (!in.good())
+    {
+        cerr << "Error opening input file " << argv[1] << '\n';
+        return 1;
+    }
+
+    StarDatabase starDB;
+    if (!starDB.loadBinary(in))
+    {
+        cerr << "Error reading star database " << argv[1] << '\n';
+        return 1;
+    }
+    starDB.finish();
+
+    ofstream out(argv[2], ios::out | ios::binary);
+    if (!out.good())
+    {
+        cerr << "Error opening output file " << argv[2] << '\n';
+        return 1;
+    }
+
+    if (!starDB.writeSortedBinary(out))
+    {
+        cerr << "Error writing star database " << argv[2] << '\n';
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,453 @@
+// imagereader.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "imagereader.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <setjmp.h>
+
+#include <png.h>
+#include <jpeglib.h>
+#ifdef HAVE_TIFF
+#include <tiffio.h>
+#endif
+
+using namespace std;
+
+
+namespace
+{
+
+FILE*
+openFile(const fs::path& filename)
+{
+#ifdef _WIN32
+    return _wfopen(filename.c_str(), L"rb");
+#else
+    return fopen(filename.c_str(), "rb");
+#endif
+}
+
+
+// Expand rows of gray or gray + alpha samples in place to RGB or RGBA
+void
+expandGray(uint8_t* row, int width, int grayChannels)
+{
+    for (int x = width - 1; x >= 0; x--)
+    {
+        uint8_t gray = row[x * grayChannels];
+        if (grayChannels == 2)
+        {
+            uint8_t alpha = row[x * 2 + 1];
+            row[x * 4 + 3] = alpha;
+            row[x * 4 + 2] = row[x * 4 + 1] = row[x * 4] = gray;
+        }
+        else
+        {
+            row[x * 3 + 2] = row[x * 3 + 1] = row[x * 3] = gray;
+        }
+    }
+}
+
+
+class PNGReader : public ImageReader
+{
+ public:
+    ~PNGReader() override;
+
+    bool open(FILE* file);
+    bool readRow(uint8_t* row) override;
+
+ private:
+    FILE* fp{ nullptr };
+    png_structp png{ nullptr };
+    png_infop info{ nullptr };
+    int row{ 0 };
+};
+
+
+PNGReader::~PNGReader()
+{
+    if (png != nullptr)
+        png_destroy_read_struct(&png, &info, nullptr);
+    if (fp != nullptr)
+        fclose(fp);
+}
+
+
+bool
+PNGReader::open(FILE* file)
+{
+    fp = file;
+    png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    if (png == nullptr)
+        return false;
+    info = png_create_info_struct(png);
+    if (info == nullptr)
+        return false;
+
+    if (setjmp(png_jmpbuf(png)))
+        return false;
+
+    png_init_io(png, fp);
+    png_read_info(png, info);
+
+    png_uint_32 w;
+    png_uint_32 h;
+    int bitDepth;
+    int colorType;
+    int interlaceType;
+    png_get_IHDR(png, info, &w, &h, &bitDepth, &colorType, &interlaceType, nullptr, nullptr);
+
+    // Interlaced images can't be read a row at a time
+    if (interlaceType != PNG_INTERLACE_NONE)
+    {
+        cerr << "Interlaced PNG images are not supported\n";
+        return false;
+    }
+
+    if (colorType == PNG_COLOR_TYPE_PALETTE)
+        png_set_palette_to_rgb(png);
+    if (colorType == PNG_COLOR_TYPE_GRAY || colorType == PNG_COLOR_TYPE_GRAY_ALPHA)
+        png_set_gray_to_rgb(png);
+    if (bitDepth < 8)
+        png_set_expand(png);
+    if (png_get_valid(png, info, PNG_INFO_tRNS))
+        png_set_tRNS_to_alpha(png);
+    if (bitDepth == 16)
+        png_set_strip_16(png);
+    png_read_update_info(png, info);
+
+    width = static_cast<int>(w);
+    height = static_cast<int>(h);
+    channels = png_get_channels(png, info);
+    return channels == 3 || channels == 4;
+}
+
+
+bool
+PNGReader::readRow(uint8_t* dest)
+{
+    if (row >= height)
+        return false;
+
+    if (setjmp(png_jmpbuf(png)))
+        return false;
+
+    png_read_row(png, dest, nullptr);
+    row++;
+    return true;
+}
+
+
+struct JPEGErrorManager
+{
+    struct jpeg_error_mgr pub;
+    jmp_buf setjmpBuffer;
+};
+
+
+METHODDEF(void)
+jpegErrorExit(j_common_ptr cinfo)
+{
+    auto* err = reinterpret_cast<JPEGErrorManager*>(cinfo->err);
+    (*cinfo->err->output_message)(cinfo);
+    longjmp(err->setjmpBuffer, 1);
+}
+
+
+class JPEGReader : public ImageReader
+{
+ public:
+    ~JPEGReader() override;
+
+    bool open(FILE* file);
+    bool readRow(uint8_t* row) override;
+
+ private:
+    FILE* fp{ nullptr };
+    struct jpeg_decompress_struct cinfo;
+    JPEGErrorManager jerr;
+    bool created{ false };
+};
+
+
+JPEGReader::~JPEGReader()
+{
+    if (created)
+        jpeg_destroy_decompress(&cinfo);
+    if (fp != nullptr)
+        fclose(fp);
+}
+
+
+bool
+JPEGReader::open(FILE* file)
+{
+    fp = file;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpegErrorExit;
+    if (setjmp(jerr.setjmpBuffer))
+        return false;
+
+    jpeg_create_decompress(&cinfo);
+    created = true;
+    jpeg_stdio_src(&cinfo, fp);
+    (void) jpeg_read_header(&cinfo, TRUE);
+    if (cinfo.jpeg_color_space != JCS_GRAYSCALE)
+        cinfo.out_color_space = JCS_RGB;
+    (void) jpeg_start_decompress(&cinfo);
+
+    width = static_cast<int>(cinfo.output_width);
+    height = static_cast<int>(cinfo.output_height);
+    channels = 3;
+    return cinfo.output_components == 1 || cinfo.output_components == 3;
+}
+
+
+bool
+JPEGReader::readRow(uint8_t* dest)
+{
+    if (cinfo.output_scanline >= cinfo.output_height)
+        return false;
+
+    if (setjmp(jerr.setjmpBuffer))
+        return false;
+
+    JSAMPROW rows[1] = { dest };
+    (void) jpeg_read_scanlines(&cinfo, rows, 1);
+    if (cinfo.output_components == 1)
+        expandGray(dest, width, 1);
+    return true;
+}
+
+
+#ifdef HAVE_TIFF
+// Strips are read a scanline at a time, tiled images a row of tiles at a
+// time. 16 bit samples are reduced to 8 bits and extra samples past the
+// alpha channel are dropped.
+class TIFFReader : public ImageReader
+{
+ public:
+    ~TIFFReader() override;
+
+    bool open(const fs::path& filename);
+    bool readRow(uint8_t* row) override;
+
+ private:
+    bool readScanline(uint32_t y, vector<uint8_t>& dest);
+
+    TIFF* tif{ nullptr };
+    uint16_t samplesPerPixel{ 1 };
+    uint16_t bitsPerSample{ 8 };
+    uint32_t tileWidth{ 0 };
+    uint32_t tileHeight{ 0 };
+    // Decoded rows of the current row of tiles
+    vector<uint8_t> tileRows;
+    uint32_t tileRowsStart{ 0 };
+    vector<uint8_t> scanline;
+    uint32_t row{ 0 };
+};
+
+
+TIFFReader::~TIFFReader()
+{
+    if (tif != nullptr)
+        TIFFClose(tif);
+}
+
+
+bool
+TIFFReader::open(const fs::path& filename)
+{
+#ifdef _WIN32
+    tif = TIFFOpenW(filename.c_str(), "r");
+#else
+    tif = TIFFOpen(filename.c_str(), "r");
+#endif
+    if (tif == nullptr)
+        return false;
+
+    uint32_t w = 0;
+    uint32_t h = 0;
+    uint16_t planarConfig = PLANARCONFIG_CONTIG;
+    uint16_t photometric = PHOTOMETRIC_MINISBLACK;
+    uint16_t sampleFormat = SAMPLEFORMAT_UINT;
+    uint16_t compression = COMPRESSION_NONE;
+    TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &w);
+    TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &h);
+    TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLESPERPIXEL, &samplesPerPixel);
+    TIFFGetFieldDefaulted(tif, TIFFTAG_BITSPERSAMPLE, &bitsPerSample);
+    TIFFGetFieldDefaulted(tif, TIFFTAG_PLANARCONFIG, &planarConfig);
+    TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLEFORMAT, &sampleFormat);
+    TIFFGetFieldDefaulted(tif, TIFFTAG_COMPRESSION, &compression);
+    TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &photometric);
+
+    if (compression == COMPRESSION_JPEG && photometric == PHOTOMETRIC_YCBCR)
+    {
+        TIFFSetField(tif, TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RGB);
+        photometric = PHOTOMETRIC_RGB;
+    }
+
+    if (planarConfig != PLANARCONFIG_CONTIG ||
+        sampleFormat != SAMPLEFORMAT_UINT ||
+        (bitsPerSample != 8 && bitsPerSample != 16) ||
+        (photometric != PHOTOMETRIC_RGB && photometric != PHOTOMETRIC_MINISBLACK))
+    {
+        cerr << "Only 8 and 16 bit RGB and gray TIFF images with contiguous samples are supported\n";
+        return false;
+    }
+
+    int colorChannels = photometric == PHOTOMETRIC_RGB ? 3 : 1;
+    if (samplesPerPixel < colorChannels)
+        return false;
+
+    width = static_cast<int>(w);
+    height = static_cast<int>(h);
+    channels = samplesPerPixel > colorChannels ? 4 : 3;
+
+    if (TIFFIsTiled(tif))
+    {
+        TIFFGetField(tif, TIFFTAG_TILEWIDTH, &tileWidth);
+        TIFFGetField(tif, TIFFTAG_TILELENGTH, &tileHeight);
+        if (tileWidth == 0 || tileHeight == 0)
+            return false;
+    }
+
+    return true;
+}
+
+
+bool
+TIFFReader::readScanline(uint32_t y, vector<uint8_t>& dest)
+{
+    size_t pixelBytes = samplesPerPixel * (bitsPerSample / 8);
+    if (tileWidth == 0)
+    {
+        dest.resize(TIFFScanlineSize(tif));
+        return TIFFReadScanline(tif, dest.data(), y, 0) >= 0;
+    }
+
+    if (tileRows.empty() || y >= tileRowsStart + tileHeight)
+    {
+        size_t rowBytes = pixelBytes * static_cast<size_t>(width);
+        tileRows.assign(rowBytes * tileHeight, 0);
+        tileRowsStart = y - y % tileHeight;
+
+        vector<uint8_t> tile(TIFFTileSize(tif));
+        for (uint32_t x = 0; x < static_cast<uint32_t>(width); x += tileWidth)
+        {
+            if (TIFFReadTile(tif, tile.data(), x, tileRowsStart, 0, 0) < 0)
+                return false;
+
+            size_t columns = min<size_t>(tileWidth, static_cast<size_t>(width) - x);
+            for (uint32_t i = 0; i < tileHeight; i++)
+            {
+                memcpy(tileRows.data() + i * rowBytes + x * pixelBytes,
+                       tile.data() + i * tileWidth * pixelBytes,
+                       columns * pixelBytes);
+            }
+        }
+    }
+
+    size_t rowBytes = tileRows.size() / tileHeight;
+    dest.assign(tileRows.begin() + (y - tileRowsStart) * rowBytes,
+                tileRows.begin() + (y - tileRowsStart + 1) * rowBytes);
+    return true;
+}
+
+
+bool
+TIFFReader::readRow(uint8_t* dest)
+{
+    if (row >= static_cast<uint32_t>(height))
+        return false;
+
+    if (!readScanline(row, scanline))
+        return false;
+
+    int colorChannels = channels == 4 ? samplesPerPixel - 1 : samplesPerPixel;
+    if (colorChannels > 3)
+        colorChannels = 3;
+    for (int x = 0; x < width; x++)
+    {
+        for (int c = 0; c < channels; c++)
+        {
+            // Gray samples are repeated for RGB, alpha follows the color
+            int sample = c < 3 ? min(c, colorChannels - 1) : colorChannels;
+            size_t index = static_cast<size_t>(x) * samplesPerPixel + sample;
+            if (bitsPerSample == 16)
+                dest[x * channels + c] = static_cast<uint8_t>(reinterpret_cast<const uint16_t*>(scanline.data())[index] >> 8);
+            else
+                dest[x * channels + c] = scanline[index];
+        }
+    }
+
+    row++;
+    return true;
+}
+#endif
+
+} // end unnamed namespace
+
+
+unique_ptr<ImageReader>
+OpenImageReader(const fs::path& filename)
+{
+    FILE* fp = openFile(filename);
+    if (fp == nullptr)
+    {
+        cerr << "Error opening " << filename << '\n';
+        return nullptr;
+    }
+
+    uint8_t header[8] = { 0 };
+    size_t headerSize = fread(header, 1, sizeof(header), fp);
+    rewind(fp);
+
+    if (headerSize == sizeof(header) && png_sig_cmp(header, 0, sizeof(header)) == 0)
+    {
+        auto reader = make_unique<PNGReader>();
+        if (reader->open(fp))
+            return reader;
+    }
+    else if (headerSize >= 2 && header[0] == 0xff && header[1] == 0xd8)
+    {
+        auto reader = make_unique<JPEGReader>();
+        if (reader->open(fp))
+            return reader;
+    }
+    else if (headerSize >= 4 &&
+             (memcmp(header, "II", 2) == 0 || memcmp(header, "MM", 2) == 0) &&
+             (header[2] == 42 || header[3] == 42 || header[2] == 43 || header[3] == 43))
+    {
+        fclose(fp);
+#ifdef HAVE_TIFF
+        auto reader = make_unique<TIFFReader>();
+        if (reader->open(filename))
+            return reader;
+#else
+        cerr << "TIFF images are not supported by this build\n";
+        return nullptr;
+#endif
+    }
+    else
+    {
+        fclose(fp);
+        cerr << filename << " is not a PNG, JPEG or TIFF image\n";
+        return nullptr;
+    }
+
+    cerr << "Error reading " << filename << '\n';
+    return nullptr;
+}
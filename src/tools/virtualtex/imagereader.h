@@ -0,0 +1,43 @@
+// imagereader.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Readers returning the rows of an image one at a time, so images much
+// larger than memory can be processed.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <celcompat/filesystem.h>
+
+class ImageReader
+{
+ public:
+    virtual ~ImageReader() = default;
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    // 3 for RGB and 4 for RGBA rows
+    int getChannels() const { return channels; }
+
+    // Read the next row of 8 bit samples, width * channels bytes. Rows are
+    // read top to bottom; returns false on errors and past the last row.
+    virtual bool readRow(std::uint8_t* row) = 0;
+
+ protected:
+    int width{ 0 };
+    int height{ 0 };
+    int channels{ 3 };
+};
+
+// Open a PNG, JPEG or, when built with libtiff, TIFF image; BigTIFF and
+// tiled TIFF files are supported. Gray images are read as RGB, and only
+// one row, or one row of TIFF tiles, is kept in memory.
+std::unique_ptr<ImageReader> OpenImageReader(const fs::path& filename);
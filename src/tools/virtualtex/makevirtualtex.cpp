@@ -0,0 +1,684 @@
+// makevirtualtex.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Build the tiles of a virtual texture from an equirectangular image. The
+// image is read a row at a time and resampled to the finest level in bands
+// the height of a tile; each band is cut into tiles and averaged down into
+// the band of the next coarser level, so only about two bands of the finest
+// level are in memory however large the image is. Resampling, compression
+// and writing of the tiles are spread over several threads.
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <celcompat/filesystem.h>
+#include <celengine/image.h>
+#include <celimage/dxtencode.h>
+#include <celimage/imageformats.h>
+#include <celutil/logger.h>
+#include "imagereader.h"
+
+using namespace std;
+using celestia::PixelFormat;
+using celestia::util::CreateLogger;
+
+
+namespace
+{
+
+// Levels the virtual texture loader looks for
+constexpr unsigned int MaxResolutionLevels = 13;
+
+enum class TileType
+{
+    DDS,
+    PNG,
+    JPEG,
+};
+
+struct Options
+{
+    string inputFile;
+    string outputDirectory;
+    unsigned int tileSize{ 512 };
+    unsigned int baseSplit{ 0 };
+    int levels{ -1 };
+    string prefix{ "tx_" };
+    TileType type{ TileType::DDS };
+    bool indexOnly{ false };
+    unsigned int threads{ max(1u, thread::hardware_concurrency()) };
+};
+
+
+void Usage()
+{
+    cerr << "Usage: makevirtualtex [options] <image> <output directory>\n";
+    cerr << "       makevirtualtex --index-only [options] <tile directory>\n";
+    cerr << "  Options:\n";
+    cerr << "    --tilesize <size>   : width and height of the tiles (default 512)\n";
+    cerr << "    --basesplit <n>     : level 0 is 2^(n + 1) by 2^n tiles (default 0)\n";
+    cerr << "    --levels <count>    : number of levels (default: enough for the image)\n";
+    cerr << "    --prefix <prefix>   : prefix of the tile file names (default tx_)\n";
+    cerr << "    --type <type>       : dds, png or jpg tiles (default dds)\n";
+    cerr << "    --threads <count>   : number of threads\n";
+    cerr << "    --index-only        : index the tiles of an existing virtual texture\n";
+    cerr << "  The image is a PNG, JPEG or TIFF (including BigTIFF and GeoTIFF)\n";
+    cerr << "  image covering the whole globe in an equirectangular projection.\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[], Options& options)
+{
+    vector<string> files;
+    for (int i = 1; i < argc; i++)
+    {
+        string_view arg = argv[i];
+        if (arg.empty() || arg[0] != '-')
+        {
+            files.emplace_back(arg);
+            continue;
+        }
+
+        if (arg == "--index-only")
+        {
+            options.indexOnly = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            cerr << "Missing value for " << arg << '\n';
+            return false;
+        }
+
+        string_view value = argv[++i];
+        if (arg == "--tilesize")
+            options.tileSize = static_cast<unsigned int>(max(0, atoi(value.data())));
+        else if (arg == "--basesplit")
+            options.baseSplit = static_cast<unsigned int>(max(0, atoi(value.data())));
+        else if (arg == "--levels")
+            options.levels = atoi(value.data());
+        else if (arg == "--prefix")
+            options.prefix = value;
+        else if (arg == "--threads")
+            options.threads = max(1, atoi(value.data()));
+        else if (arg == "--type")
+        {
+            if (value == "dds")
+                options.type = TileType::DDS;
+            else if (value == "png")
+                options.type = TileType::PNG;
+            else if (value == "jpg")
+                options.type = TileType::JPEG;
+            else
+            {
+                cerr << "Unknown tile type " << value << '\n';
+                return false;
+            }
+        }
+        else
+        {
+            cerr << "Unknown command line switch: " << arg << '\n';
+            return false;
+        }
+    }
+
+    if (files.size() != (options.indexOnly ? 1 : 2))
+        return false;
+
+    if (options.tileSize < 64 || (options.tileSize & (options.tileSize - 1)) != 0)
+    {
+        cerr << "The tile size must be a power of two >= 64\n";
+        return false;
+    }
+
+    if (options.prefix.empty() || options.prefix.find_first_of("%/\\ ") != string::npos)
+    {
+        cerr << "Bad tile prefix " << options.prefix << '\n';
+        return false;
+    }
+
+    options.outputDirectory = files.back();
+    if (!options.indexOnly)
+        options.inputFile = files[0];
+    return true;
+}
+
+
+const char*
+tileExtension(TileType type)
+{
+    switch (type)
+    {
+    case TileType::PNG:
+        return "png";
+    case TileType::JPEG:
+        return "jpg";
+    default:
+        return "dds";
+    }
+}
+
+
+// Runs of tiles present in the rows of a level
+struct TileRun
+{
+    int v;
+    int firstU;
+    int lastU;
+};
+
+using LevelIndex = vector<TileRun>;
+
+
+// Write tiles.idx, the tile index read by the virtual texture loader, with
+// the runs of each level that has tiles
+bool
+writeTileIndex(const Options& options, const vector<LevelIndex>& levels)
+{
+    fs::path path = fs::path(options.outputDirectory) / "tiles.idx";
+    ofstream out(path);
+    out << "VirtualTextureIndex " << options.prefix << ' ' << tileExtension(options.type) << '\n';
+    for (size_t level = 0; level < levels.size(); level++)
+    {
+        if (levels[level].empty())
+            continue;
+
+        out << "level " << level << '\n';
+        for (const TileRun& run : levels[level])
+            out << run.v << ' ' << run.firstU << ' ' << run.lastU << '\n';
+    }
+
+    out.close();
+    if (!out.good())
+    {
+        cerr << "Error writing " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+
+// Parse <prefix><u>_<v>.<type>
+bool
+parseTileName(const string& name, const Options& options, int& u, int& v)
+{
+    string suffix = fmt::format(".{}", tileExtension(options.type));
+    if (name.size() <= options.prefix.size() + suffix.size() ||
+        name.compare(0, options.prefix.size(), options.prefix) != 0 ||
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+    {
+        return false;
+    }
+
+    const char* end = name.data() + name.size() - suffix.size();
+    auto [uEnd, uError] = from_chars(name.data() + options.prefix.size(), end, u);
+    if (uError != errc() || uEnd == end || *uEnd != '_')
+        return false;
+    auto [vEnd, vError] = from_chars(uEnd + 1, end, v);
+    return vError == errc() && vEnd == end;
+}
+
+
+// Index the tiles already in the level directories, as Celestia finds
+// them when there's no index
+bool
+indexTiles(const Options& options)
+{
+    vector<LevelIndex> levels;
+    size_t tileCount = 0;
+    for (unsigned int level = 0; level + options.baseSplit < MaxResolutionLevels; level++)
+    {
+        LevelIndex& runs = levels.emplace_back();
+        fs::path directory = fs::path(options.outputDirectory) / fmt::format("level{:d}", level);
+        std::error_code ec;
+        if (!fs::is_directory(directory, ec))
+            continue;
+
+        int uLimit = 2 << (level + options.baseSplit);
+        int vLimit = 1 << (level + options.baseSplit);
+        vector<pair<int, int>> tiles;
+        for (const auto& entry : fs::directory_iterator(directory, ec))
+        {
+            int u;
+            int v;
+            if (parseTileName(entry.path().filename().string(), options, u, v) &&
+                u >= 0 && u < uLimit && v >= 0 && v < vLimit)
+            {
+                tiles.emplace_back(v, u);
+            }
+        }
+
+        sort(tiles.begin(), tiles.end());
+        tiles.erase(unique(tiles.begin(), tiles.end()), tiles.end());
+        for (const auto& [v, u] : tiles)
+        {
+            if (!runs.empty() && runs.back().v == v && runs.back().lastU == u - 1)
+                runs.back().lastU = u;
+            else
+                runs.push_back({ v, u, u });
+        }
+        tileCount += tiles.size();
+    }
+
+    cout << "Indexed " << tileCount << " tiles\n";
+    return writeTileIndex(options, levels);
+}
+
+
+// Run f(0) ... f(count - 1) on up to threads threads
+template<typename F> void
+parallelFor(int count, unsigned int threads, F&& f)
+{
+    atomic<int> next{ 0 };
+    auto run = [&]()
+    {
+        for (int i = next++; i < count; i = next++)
+            f(i);
+    };
+
+    vector<thread> workers;
+    for (unsigned int i = 1; i < threads && static_cast<int>(i) < count; i++)
+        workers.emplace_back(run);
+    run();
+    for (thread& worker : workers)
+        worker.join();
+}
+
+
+// Weights of the source samples for each destination sample of one axis,
+// a tent filter as wide as the larger of a source and a destination sample
+class ResampleFilter
+{
+ public:
+    ResampleFilter(int sourceSize, int destSize)
+    {
+        double scale = static_cast<double>(sourceSize) / static_cast<double>(destSize);
+        double radius = max(1.0, scale);
+        start.reserve(destSize + 1);
+        for (int i = 0; i < destSize; i++)
+        {
+            double center = (i + 0.5) * scale - 0.5;
+            int firstTap = static_cast<int>(floor(center - radius)) + 1;
+            int lastTap = static_cast<int>(ceil(center + radius)) - 1;
+            first.push_back(firstTap);
+            start.push_back(weights.size());
+
+            double sum = 0.0;
+            for (int j = firstTap; j <= lastTap; j++)
+                sum += 1.0 - abs(j - center) / radius;
+            for (int j = firstTap; j <= lastTap; j++)
+                weights.push_back(static_cast<float>((1.0 - abs(j - center) / radius) / sum));
+        }
+        start.push_back(weights.size());
+    }
+
+    int firstTap(int i) const { return first[i]; }
+    int lastTap(int i) const { return first[i] + tapCount(i) - 1; }
+    int tapCount(int i) const { return static_cast<int>(start[i + 1] - start[i]); }
+    const float* tapWeights(int i) const { return weights.data() + start[i]; }
+
+ private:
+    vector<int> first;
+    vector<size_t> start;
+    vector<float> weights;
+};
+
+
+// The rows of the source image needed by the band being resampled
+class SourceWindow
+{
+ public:
+    explicit SourceWindow(ImageReader& _reader) : reader(_reader) {}
+
+    // Read the source rows up to lastRow and forget the rows before firstRow
+    bool advance(int firstRow, int lastRow)
+    {
+        size_t rowBytes = static_cast<size_t>(reader.getWidth()) * reader.getChannels();
+        while (nextRow <= lastRow)
+        {
+            vector<uint8_t> row(rowBytes);
+            if (!reader.readRow(row.data()))
+            {
+                cerr << "Error reading row " << nextRow << " of the image\n";
+                return false;
+            }
+            rows.push_back(std::move(row));
+            nextRow++;
+        }
+
+        while (!rows.empty() && windowStart < firstRow)
+        {
+            rows.pop_front();
+            windowStart++;
+        }
+        return true;
+    }
+
+    const uint8_t* row(int i) const { return rows[i - windowStart].data(); }
+
+ private:
+    ImageReader& reader;
+    deque<vector<uint8_t>> rows;
+    int windowStart{ 0 };
+    int nextRow{ 0 };
+};
+
+
+class TileBuilder
+{
+ public:
+    TileBuilder(const Options& _options, ImageReader& _reader, unsigned int finestLevel);
+
+    bool build();
+
+ private:
+    int levelWidth(unsigned int level) const { return static_cast<int>(options.tileSize << (level + options.baseSplit + 1)); }
+    int bandCount(unsigned int level) const { return 1 << (level + options.baseSplit); }
+
+    bool resampleBand(int band);
+    bool finishBand(unsigned int level, int band);
+    bool writeTiles(unsigned int level, int band);
+
+    const Options& options;
+    ImageReader& reader;
+    SourceWindow window;
+    unsigned int finestLevel;
+    int channels;
+    ResampleFilter horizontal;
+    ResampleFilter vertical;
+    // One band of tileSize rows for each level
+    vector<vector<uint8_t>> bands;
+};
+
+
+TileBuilder::TileBuilder(const Options& _options, ImageReader& _reader, unsigned int _finestLevel) :
+    options(_options),
+    reader(_reader),
+    window(_reader),
+    finestLevel(_finestLevel),
+    channels(_options.type == TileType::DDS ? _reader.getChannels() : 3),
+    horizontal(_reader.getWidth(), levelWidth(_finestLevel)),
+    vertical(_reader.getHeight(), levelWidth(_finestLevel) / 2)
+{
+    for (unsigned int level = 0; level <= finestLevel; level++)
+        bands.emplace_back(static_cast<size_t>(levelWidth(level)) * options.tileSize * channels);
+}
+
+
+bool
+TileBuilder::build()
+{
+    for (unsigned int level = 0; level <= finestLevel; level++)
+    {
+        std::error_code ec;
+        fs::create_directories(fs::path(options.outputDirectory) / fmt::format("level{:d}", level), ec);
+        if (ec)
+        {
+            cerr << "Error creating the directory of level " << level << '\n';
+            return false;
+        }
+    }
+
+    int count = bandCount(finestLevel);
+    for (int band = 0; band < count; band++)
+    {
+        if (!resampleBand(band) || !finishBand(finestLevel, band))
+            return false;
+        cout << "Band " << band + 1 << " of " << count << " done\r" << flush;
+    }
+    cout << '\n';
+
+    // All tiles are written, so each row of each level is a single run
+    vector<LevelIndex> levels(finestLevel + 1);
+    for (unsigned int level = 0; level <= finestLevel; level++)
+    {
+        int lastU = levelWidth(level) / static_cast<int>(options.tileSize) - 1;
+        for (int v = 0; v < bandCount(level); v++)
+            levels[level].push_back({ v, 0, lastU });
+    }
+
+    return writeTileIndex(options, levels);
+}
+
+
+bool
+TileBuilder::resampleBand(int band)
+{
+    int firstRow = band * static_cast<int>(options.tileSize);
+    int lastRow = firstRow + static_cast<int>(options.tileSize) - 1;
+    int sourceHeight = reader.getHeight();
+    int firstSourceRow = clamp(vertical.firstTap(firstRow), 0, sourceHeight - 1);
+    int lastSourceRow = clamp(vertical.lastTap(lastRow), 0, sourceHeight - 1);
+    if (!window.advance(firstSourceRow, lastSourceRow))
+        return false;
+
+    int sourceWidth = reader.getWidth();
+    int sourceChannels = reader.getChannels();
+    int width = levelWidth(finestLevel);
+    uint8_t* bandPixels = bands[finestLevel].data();
+
+    parallelFor(static_cast<int>(options.tileSize), options.threads, [&](int i)
+    {
+        // Filter vertically to a row of the source width, clamping at the
+        // poles, and then horizontally, wrapping around the date line.
+        int y = firstRow + i;
+        vector<float> row(static_cast<size_t>(sourceWidth) * sourceChannels, 0.0f);
+        const float* rowWeights = vertical.tapWeights(y);
+        for (int k = 0; k < vertical.tapCount(y); k++)
+        {
+            const uint8_t* source = window.row(clamp(vertical.firstTap(y) + k, 0, sourceHeight - 1));
+            for (size_t j = 0; j < row.size(); j++)
+                row[j] += rowWeights[k] * source[j];
+        }
+
+        uint8_t* dest = bandPixels + static_cast<size_t>(i) * width * channels;
+        for (int x = 0; x < width; x++)
+        {
+            float pixel[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            const float* columnWeights = horizontal.tapWeights(x);
+            for (int k = 0; k < horizontal.tapCount(x); k++)
+            {
+                int column = (horizontal.firstTap(x) + k) % sourceWidth;
+                if (column < 0)
+                    column += sourceWidth;
+                const float* source = row.data() + static_cast<size_t>(column) * sourceChannels;
+                for (int c = 0; c < channels; c++)
+                    pixel[c] += columnWeights[k] * source[c];
+            }
+
+            for (int c = 0; c < channels; c++)
+                dest[x * channels + c] = static_cast<uint8_t>(clamp(pixel[c] + 0.5f, 0.0f, 255.0f));
+        }
+    });
+
+    return true;
+}
+
+
+// Write the tiles of a complete band and average it into the band of the
+// next coarser level, which is complete after its second half.
+bool
+TileBuilder::finishBand(unsigned int level, int band)
+{
+    if (!writeTiles(level, band))
+        return false;
+    if (level == 0)
+        return true;
+
+    int width = levelWidth(level);
+    int halfSize = static_cast<int>(options.tileSize / 2);
+    const uint8_t* source = bands[level].data();
+    uint8_t* dest = bands[level - 1].data() + static_cast<size_t>(band & 1) * halfSize * (width / 2) * channels;
+    parallelFor(halfSize, options.threads, [&](int y)
+    {
+        const uint8_t* row0 = source + static_cast<size_t>(2 * y) * width * channels;
+        const uint8_t* row1 = row0 + static_cast<size_t>(width) * channels;
+        uint8_t* out = dest + static_cast<size_t>(y) * (width / 2) * channels;
+        for (int x = 0; x < width / 2; x++)
+        {
+            for (int c = 0; c < channels; c++)
+            {
+                int i = 2 * x * channels + c;
+                out[x * channels + c] = static_cast<uint8_t>((row0[i] + row0[i + channels] +
+                                                              row1[i] + row1[i + channels] + 2) / 4);
+            }
+        }
+    });
+
+    if ((band & 1) == 0)
+        return true;
+    return finishBand(level - 1, band / 2);
+}
+
+
+bool
+TileBuilder::writeTiles(unsigned int level, int band)
+{
+    int width = levelWidth(level);
+    int tileSize = static_cast<int>(options.tileSize);
+    fs::path directory = fs::path(options.outputDirectory) / fmt::format("level{:d}", level);
+    const uint8_t* bandPixels = bands[level].data();
+    atomic<bool> failed{ false };
+
+    parallelFor(width / tileSize, options.threads, [&](int u)
+    {
+        Image tile(channels == 4 ? PixelFormat::RGBA : PixelFormat::RGB, tileSize, tileSize);
+        for (int y = 0; y < tileSize; y++)
+        {
+            memcpy(tile.getPixelRow(y),
+                   bandPixels + (static_cast<size_t>(y) * width + static_cast<size_t>(u) * tileSize) * channels,
+                   static_cast<size_t>(tileSize) * channels);
+        }
+
+        fs::path path = directory / fmt::format("{}{}_{}.{}", options.prefix, u, band, tileExtension(options.type));
+        bool written = false;
+        switch (options.type)
+        {
+        case TileType::DDS:
+            // Only the tiles of level 0 are mipmapped by Celestia
+            if (auto compressed = CompressImageDXT(tile, level == 0); compressed != nullptr)
+                written = SaveDDSImage(path, *compressed);
+            break;
+        case TileType::PNG:
+            written = SavePNGImage(path, tile);
+            break;
+        case TileType::JPEG:
+            written = SaveJPEGImage(path, tile);
+            break;
+        }
+
+        if (!written)
+        {
+            cerr << "Error writing " << path << '\n';
+            failed = true;
+        }
+    });
+
+    return !failed;
+}
+
+
+bool
+writeTextureFile(const Options& options)
+{
+    fs::path directory(options.outputDirectory);
+    if (directory.filename().empty())
+        directory = directory.parent_path();
+    fs::path path = directory;
+    path += ".ctx";
+
+    ofstream out(path);
+    out << "VirtualTexture\n{\n";
+    out << "        ImageDirectory \"" << directory.filename().string() << "\"\n";
+    out << "        BaseSplit " << options.baseSplit << '\n';
+    out << "        TileSize " << options.tileSize << '\n';
+    out << "        TileType \"" << tileExtension(options.type) << "\"\n";
+    out << "        TilePrefix \"" << options.prefix << "\"\n";
+    out << "}\n";
+
+    out.close();
+    if (!out.good())
+    {
+        cerr << "Error writing " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+} // end unnamed namespace
+
+
+int main(int argc, char* argv[])
+{
+    CreateLogger();
+
+    Options options;
+    if (!parseCommandLine(argc, argv, options))
+    {
+        Usage();
+        return 1;
+    }
+
+    if (options.indexOnly)
+        return indexTiles(options) ? 0 : 1;
+
+    unique_ptr<ImageReader> reader = OpenImageReader(options.inputFile);
+    if (reader == nullptr)
+        return 1;
+
+    if (reader->getChannels() == 4 && options.type != TileType::DDS)
+        cerr << "Warning: the alpha channel is dropped from " << tileExtension(options.type) << " tiles\n";
+
+    // By default, the finest level is the first at least as wide as the image
+    unsigned int maxLevels = MaxResolutionLevels - min(options.baseSplit, MaxResolutionLevels - 1);
+    unsigned int finestLevel = 0;
+    if (options.levels > 0)
+        finestLevel = static_cast<unsigned int>(options.levels) - 1;
+    else
+    {
+        while (finestLevel + 1 < maxLevels &&
+               (static_cast<uint64_t>(options.tileSize) << (finestLevel + options.baseSplit + 1)) <
+               static_cast<uint64_t>(reader->getWidth()))
+        {
+            finestLevel++;
+        }
+    }
+
+    if (finestLevel >= maxLevels)
+    {
+        cerr << "Celestia doesn't load more than " << maxLevels << " levels with base split " << options.baseSplit << '\n';
+        return 1;
+    }
+
+    cout << "Building " << finestLevel + 1 << " levels of "
+         << options.tileSize << "x" << options.tileSize << " tiles\n";
+
+    TileBuilder builder(options, *reader, finestLevel);
+    if (!builder.build() || !writeTextureFile(options))
+        return 1;
+
+    return 0;
+}
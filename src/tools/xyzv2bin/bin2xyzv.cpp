@@ -28,6 +28,7 @@ static bool binaryToText(const std::string& infilename, const std::string& outfi
         return false;
     }
 
+    decltype(XYZVBinaryHeader::count) count;
     {
         std::array<char, sizeof(XYZVBinaryHeader)> header;
         if (!in.read(header.data(), header.size())) /* Flawfinder: ignore */
@@ -60,14 +61,14 @@ static bool binaryToText(const std::string& infilename, const std::string& outfi
             return false;
         }
 
-        decltype(XYZVBinaryHeader::count) count;
         std::memcpy(&count, header.data() + offsetof(XYZVBinaryHeader, count), sizeof(count));
         fmt::print(stderr, "File has {} records.\n", count);
         if (count == 0)
             return false;
     }
 
-    while (!in.eof())
+    // The records may be followed by an index block
+    for (decltype(count) i = 0; i < count && !in.eof(); i++)
     {
         std::array<char, sizeof(XYZVBinaryData)> data;
         if (!in.read(data.data(), data.size())) /* Flawfinder: ignore */
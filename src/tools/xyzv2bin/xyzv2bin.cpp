@@ -1,17 +1,24 @@
+#include <algorithm>
 #include <array>
 #include <cctype>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
 #include <istream>
 #include <limits>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include <fmt/format.h>
 
 #include <celephem/xyzvbinary.h>
 #include <celutil/bytes.h>
+#include "xyzvwriter.h"
 
 // Scan past comments. A comment begins with the # character and ends
 // with a newline. Return true if the stream state is good. The stream
@@ -57,7 +64,7 @@ static bool SkipComments(std::istream& in)
 }
 
 // Convert text xyzv file to binary file.
-static bool xyzvToBinary(const std::string& inFilename, const std::string& outFilename)
+static bool xyzvToBinary(const std::string& inFilename, const std::string& outFilename, bool withIndex)
 {
     using celestia::ephem::XYZVBinaryData;
     using celestia::ephem::XYZVBinaryHeader;
@@ -88,6 +95,8 @@ static bool xyzvToBinary(const std::string& inFilename, const std::string& outFi
         return false;
 
     decltype(XYZVBinaryHeader::count) counter = 0;
+    std::vector<double> times;
+    double boundingRadius = 0.0;
     while (!in.eof())
     {
         static_assert(offsetof(XYZVBinaryData, tdb)      == 0 * sizeof(double));
@@ -117,6 +126,12 @@ static bool xyzvToBinary(const std::string& inFilename, const std::string& outFi
             break;
         }
         counter++;
+
+        if (withIndex)
+        {
+            times.push_back(values[0]);
+            boundingRadius = std::max(boundingRadius, std::hypot(values[1], values[2], values[3]));
+        }
     }
 
     fmt::print(stderr, "Written {} records.\n", counter);
@@ -124,6 +139,9 @@ static bool xyzvToBinary(const std::string& inFilename, const std::string& outFi
     if (counter == 0)
         return false;
 
+    if (withIndex && !WriteXYZVIndex(out, times, boundingRadius))
+        return false;
+
     // write actual header
     std::memcpy(header.data() + offsetof(XYZVBinaryHeader, count), &counter, sizeof(counter));
 
@@ -131,17 +149,86 @@ static bool xyzvToBinary(const std::string& inFilename, const std::string& outFi
     return !!out.write(reinterpret_cast<const char*>(&header), sizeof(header));
 }
 
+static bool readSamples(std::istream& in, std::vector<XYZVSample>& samples)
+{
+    while (!in.eof())
+    {
+        XYZVSample sample;
+        in >> sample.t;
+        for (double& x : sample.position)
+            in >> x;
+        for (double& x : sample.velocity)
+            in >> x;
+
+        if (!in.good())
+        {
+            if (!in.eof())
+            {
+                fmt::print(stderr, "Error reading input file, line {}\n", samples.size() + 1);
+                return false;
+            }
+            break;
+        }
+
+        if (!samples.empty() && !(sample.t > samples.back().t))
+        {
+            fmt::print(stderr, "Sample times aren't increasing, line {}\n", samples.size() + 1);
+            return false;
+        }
+        samples.push_back(sample);
+    }
+
+    return !samples.empty();
+}
+
+// Convert text xyzv file to a compressed binary file.
+static bool xyzvToCompressed(const std::string& inFilename, const std::string& outFilename, double tolerance)
+{
+    std::ifstream in(inFilename);
+    std::ofstream out(outFilename, std::ios::binary);
+    if (!in.good() || !out.good())
+        return false;
+
+    std::vector<XYZVSample> samples;
+    if (!SkipComments(in) || !readSamples(in, samples))
+        return false;
+
+    return WriteXYZVCompressed(out, samples, tolerance, true);
+}
+
 int main(int argc, char* argv[])
 {
-    if (argc < 3)
+    bool withIndex = false;
+    double tolerance = 0.0;
+    int first = 1;
+    if (argc > 1 && std::string_view(argv[1]) == "--index")
+    {
+        withIndex = true;
+        first = 2;
+    }
+    else if (argc > 2 && std::string_view(argv[1]) == "--compress")
+    {
+        tolerance = std::atof(argv[2]);
+        if (!(tolerance > 0.0))
+        {
+            fmt::print(stderr, "The tolerance must be a positive distance in km.\n");
+            return 1;
+        }
+        first = 3;
+    }
+
+    if (argc < first + 2)
     {
-        fmt::print(stderr, "Usage: {} infile.xyzv outfile.bin\n", argv[0]);
+        fmt::print(stderr, "Usage: {} [--index | --compress tolerance] infile.xyzv outfile.bin\n", argv[0]);
         return 1;
     }
 
-    if (!xyzvToBinary(argv[1], argv[2]))
+    bool converted = tolerance > 0.0
+        ? xyzvToCompressed(argv[first], argv[first + 1], tolerance)
+        : xyzvToBinary(argv[first], argv[first + 1], withIndex);
+    if (!converted)
     {
-        fmt::print(stderr, "Error converting {} to {}.\n", argv[1], argv[2]);
+        fmt::print(stderr, "Error converting {} to {}.\n", argv[first], argv[first + 1]);
         return 1;
     }
 
@@ -0,0 +1,309 @@
+// xyzvwriter.cpp
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Writers of binary and compressed xyzv trajectories.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "xyzvwriter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include <fmt/format.h>
+
+#include <celephem/xyzvbinary.h>
+
+namespace
+{
+
+// Records in each bucket of the index block, on average
+constexpr std::uint64_t RecordsPerBucket = 8;
+
+// Samples a segment may span; longer segments rarely fit, and the cost of
+// trying grows with the square of the length.
+constexpr std::size_t MaxSegmentSamples = 512;
+
+// Largest value of |h10| and |h11|, the Hermite basis functions of the
+// velocities
+constexpr double MaxVelocityBasis = 4.0 / 27.0;
+
+double
+distance(const XYZVVector& a, const XYZVVector& b)
+{
+    return std::hypot(a[0] - b[0], a[1] - b[1], a[2] - b[2]);
+}
+
+bool
+fits(const std::vector<XYZVSample>& samples, std::size_t first, std::size_t last, double tolerance)
+{
+    for (std::size_t i = first + 1; i < last; i++)
+    {
+        if (distance(InterpolateXYZV(samples[first], samples[last], samples[i].t), samples[i].position) > tolerance)
+            return false;
+    }
+    return true;
+}
+
+// Pick the samples to keep, extending each segment for as long as the samples
+// it skips are within the tolerance.
+std::vector<std::size_t>
+selectKnots(const std::vector<XYZVSample>& samples, double tolerance)
+{
+    std::vector<std::size_t> knots{ 0 };
+    std::size_t first = 0;
+    while (first + 1 < samples.size())
+    {
+        std::size_t last = first + 1;
+        std::size_t limit = std::min(samples.size() - 1, first + MaxSegmentSamples);
+        while (last < limit && fits(samples, first, last + 1, tolerance))
+            ++last;
+        knots.push_back(last);
+        first = last;
+    }
+
+    return knots;
+}
+
+void
+writeVarint(std::string& data, std::int64_t value)
+{
+    // Zigzag encoding puts small negative values next to small positive ones
+    auto bits = (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+    while (bits >= 0x80)
+    {
+        data.push_back(static_cast<char>((bits & 0x7f) | 0x80));
+        bits >>= 7;
+    }
+    data.push_back(static_cast<char>(bits));
+}
+
+} // end unnamed namespace
+
+
+XYZVVector
+InterpolateXYZV(const XYZVSample& s0, const XYZVSample& s1, double t)
+{
+    double h = s1.t - s0.t;
+    double u = (t - s0.t) / h;
+    double u2 = u * u;
+    double u3 = u2 * u;
+    double h00 = 2.0 * u3 - 3.0 * u2 + 1.0;
+    double h10 = u3 - 2.0 * u2 + u;
+    double h01 = -2.0 * u3 + 3.0 * u2;
+    double h11 = u3 - u2;
+    double hv = h * 86400.0;
+
+    XYZVVector p;
+    for (int i = 0; i < 3; i++)
+    {
+        p[i] = h00 * s0.position[i] + h10 * hv * s0.velocity[i] +
+               h01 * s1.position[i] + h11 * hv * s1.velocity[i];
+    }
+    return p;
+}
+
+
+bool
+WriteXYZVIndex(std::ostream& out, const std::vector<double>& times, double boundingRadius)
+{
+    using celestia::ephem::XYZVBinaryIndex;
+    using celestia::ephem::XYZV_INDEX_MAGIC;
+
+    if (times.size() < 2 || !std::is_sorted(times.begin(), times.end()) || !(times.back() > times.front()))
+    {
+        fmt::print(stderr, "Record times aren't increasing, not writing an index.\n");
+        return true;
+    }
+
+    std::uint64_t count = std::max<std::uint64_t>(times.size() / RecordsPerBucket, 1);
+    double startTime = times.front();
+    double bucketsPerDay = static_cast<double>(count) / (times.back() - times.front());
+
+    std::array<char, sizeof(XYZVBinaryIndex)> index = {};
+    std::memcpy(index.data() + offsetof(XYZVBinaryIndex, magic), XYZV_INDEX_MAGIC.data(), XYZV_INDEX_MAGIC.size());
+    std::memcpy(index.data() + offsetof(XYZVBinaryIndex, count), &count, sizeof(count));
+    std::memcpy(index.data() + offsetof(XYZVBinaryIndex, startTime), &startTime, sizeof(startTime));
+    std::memcpy(index.data() + offsetof(XYZVBinaryIndex, bucketsPerDay), &bucketsPerDay, sizeof(bucketsPerDay));
+    std::memcpy(index.data() + offsetof(XYZVBinaryIndex, boundingRadius), &boundingRadius, sizeof(boundingRadius));
+    if (!out.write(index.data(), index.size()))
+        return false;
+
+    // Same computation as the one used for looking up times
+    auto getBucket = [&](double t)
+    {
+        double b = (t - startTime) * bucketsPerDay;
+        return b <= 0.0 ? 0 : std::min(static_cast<std::uint64_t>(b), count - 1);
+    };
+
+    std::vector<std::uint64_t> buckets(count + 1);
+    std::uint64_t i = 0;
+    for (std::uint64_t b = 0; b < count; b++)
+    {
+        while (i < times.size() && getBucket(times[i]) < b)
+            ++i;
+        buckets[b] = i;
+    }
+    buckets[count] = times.size();
+
+    return !!out.write(reinterpret_cast<const char*>(buckets.data()), buckets.size() * sizeof(std::uint64_t));
+}
+
+
+bool
+WriteXYZVBinary(std::ostream& out, const std::vector<XYZVSample>& samples, bool withIndex)
+{
+    using celestia::ephem::XYZVBinaryData;
+    using celestia::ephem::XYZVBinaryHeader;
+    using celestia::ephem::XYZV_MAGIC;
+
+    std::array<char, sizeof(XYZVBinaryHeader)> header = {};
+    {
+        auto byteOrder = static_cast<decltype(XYZVBinaryHeader::byteOrder)>(__BYTE_ORDER__);
+        auto digits =    static_cast<decltype(XYZVBinaryHeader::digits)   >(std::numeric_limits<double>::digits);
+        auto count =     static_cast<decltype(XYZVBinaryHeader::count)    >(samples.size());
+
+        std::memcpy(header.data() + offsetof(XYZVBinaryHeader, magic),     XYZV_MAGIC.data(), XYZV_MAGIC.size());
+        std::memcpy(header.data() + offsetof(XYZVBinaryHeader, byteOrder), &byteOrder,        sizeof(byteOrder));
+        std::memcpy(header.data() + offsetof(XYZVBinaryHeader, digits),    &digits,           sizeof(digits));
+        std::memcpy(header.data() + offsetof(XYZVBinaryHeader, count),     &count,            sizeof(count));
+    }
+
+    if (!out.write(header.data(), header.size()))
+        return false;
+
+    std::vector<double> times;
+    double boundingRadius = 0.0;
+    for (const XYZVSample& sample : samples)
+    {
+        static_assert(sizeof(XYZVBinaryData) == 7 * sizeof(double));
+        std::array<double, 7> values{ sample.t,
+                                      sample.position[0], sample.position[1], sample.position[2],
+                                      sample.velocity[0], sample.velocity[1], sample.velocity[2] };
+        if (!out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(double)))
+            return false;
+
+        if (withIndex)
+        {
+            times.push_back(sample.t);
+            boundingRadius = std::max(boundingRadius, std::hypot(sample.position[0], sample.position[1], sample.position[2]));
+        }
+    }
+
+    return !withIndex || WriteXYZVIndex(out, times, boundingRadius);
+}
+
+
+bool
+WriteXYZVCompressed(std::ostream& out, const std::vector<XYZVSample>& samples,
+                    double tolerance, bool dropSamples)
+{
+    using celestia::ephem::XYZVCompressedHeader;
+    using celestia::ephem::XYZV_COMPRESSED_MAGIC;
+
+    if (samples.empty())
+        return false;
+
+    double quantizationError = tolerance * XYZVQuantumFraction;
+    std::vector<std::size_t> knots;
+    if (dropSamples)
+    {
+        knots = selectKnots(samples, tolerance - 3.0 * quantizationError);
+    }
+    else
+    {
+        knots.resize(samples.size());
+        for (std::size_t i = 0; i < knots.size(); i++)
+            knots[i] = i;
+    }
+
+    // Quanta for errors of at most quantizationError each: half a time
+    // quantum moves a knot by the speed times that, and half a velocity
+    // quantum moves a segment by up to MaxVelocityBasis times that over the
+    // length of the segment at each end. Rounding the three components of
+    // a vector adds up to sqrt(3) times the rounding of one.
+    double maxSpeed = 0.0;
+    for (const XYZVSample& sample : samples)
+        maxSpeed = std::max(maxSpeed, std::hypot(sample.velocity[0], sample.velocity[1], sample.velocity[2]));
+    double maxSegment = 0.0;
+    for (std::size_t i = 1; i < knots.size(); i++)
+        maxSegment = std::max(maxSegment, samples[knots[i]].t - samples[knots[i - 1]].t);
+
+    constexpr double Sqrt3 = 1.7320508075688772;
+    double positionQuantum = 2.0 * quantizationError / Sqrt3;
+    double timeQuantum = maxSpeed > 0.0 ? 2.0 * quantizationError / (maxSpeed * 86400.0) : 1.0e-6;
+    double velocityQuantum = maxSegment > 0.0
+        ? 2.0 * quantizationError / (Sqrt3 * 2.0 * MaxVelocityBasis * maxSegment * 86400.0)
+        : 1.0;
+    double startTime = samples.front().t;
+
+    std::array<char, sizeof(XYZVCompressedHeader)> header = {};
+    {
+        auto byteOrder = static_cast<decltype(XYZVCompressedHeader::byteOrder)>(__BYTE_ORDER__);
+        auto digits =    static_cast<decltype(XYZVCompressedHeader::digits)   >(std::numeric_limits<double>::digits);
+        auto count =     static_cast<decltype(XYZVCompressedHeader::count)    >(knots.size());
+
+        std::memcpy(header.data() + offsetof(XYZVCompressedHeader, magic), XYZV_COMPRESSED_MAGIC.data(), XYZV_COMPRESSED_MAGIC.size());
+        std::memcpy(header.data() + offsetof(XYZVCompressedHeader, byteOrder),       &byteOrder,       sizeof(byteOrder));
+        std::memcpy(header.data() + offsetof(XYZVCompressedHeader, digits),          &digits,          sizeof(digits));
+        std::memcpy(header.data() + offsetof(XYZVCompressedHeader, count),           &count,           sizeof(count));
+        std::memcpy(header.data() + offsetof(XYZVCompressedHeader, startTime),       &startTime,       sizeof(double));
+        std::memcpy(header.data() + offsetof(XYZVCompressedHeader, timeQuantum),     &timeQuantum,     sizeof(double));
+        std::memcpy(header.data() + offsetof(XYZVCompressedHeader, positionQuantum), &positionQuantum, sizeof(double));
+        std::memcpy(header.data() + offsetof(XYZVCompressedHeader, velocityQuantum), &velocityQuantum, sizeof(double));
+        std::memcpy(header.data() + offsetof(XYZVCompressedHeader, tolerance),       &tolerance,       sizeof(double));
+    }
+
+    std::string data(header.data(), header.size());
+    std::array<std::int64_t, 7> previous = {};
+    std::vector<XYZVSample> decoded;
+    for (std::size_t knot : knots)
+    {
+        const XYZVSample& sample = samples[knot];
+        std::array<std::int64_t, 7> values;
+        values[0] = std::llround((sample.t - startTime) / timeQuantum);
+        for (int i = 0; i < 3; i++)
+        {
+            values[1 + i] = std::llround(sample.position[i] / positionQuantum);
+            values[4 + i] = std::llround(sample.velocity[i] / velocityQuantum);
+        }
+
+        for (int i = 0; i < 7; i++)
+            writeVarint(data, values[i] - previous[i]);
+        previous = values;
+
+        XYZVSample& d = decoded.emplace_back();
+        d.t = startTime + static_cast<double>(values[0]) * timeQuantum;
+        for (int i = 0; i < 3; i++)
+        {
+            d.position[i] = static_cast<double>(values[1 + i]) * positionQuantum;
+            d.velocity[i] = static_cast<double>(values[4 + i]) * velocityQuantum;
+        }
+    }
+
+    // Check the trajectory as it will be read back
+    double maxError = 0.0;
+    for (std::size_t k = 1; k < knots.size(); k++)
+    {
+        for (std::size_t i = knots[k - 1]; i <= knots[k]; i++)
+        {
+            double t = std::clamp(samples[i].t, decoded[k - 1].t, decoded[k].t);
+            maxError = std::max(maxError, distance(InterpolateXYZV(decoded[k - 1], decoded[k], t), samples[i].position));
+        }
+    }
+
+    fmt::print(stderr, "Kept {} of {} samples in {} bytes, largest error {} km.\n",
+               knots.size(), samples.size(), data.size(), maxError);
+
+    return !!out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
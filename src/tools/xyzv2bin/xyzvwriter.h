@@ -0,0 +1,45 @@
+// xyzvwriter.h
+//
+// Copyright (C) 2023-present, the Celestia Development Team
+//
+// Writers of binary and compressed xyzv trajectories.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <ostream>
+#include <vector>
+
+using XYZVVector = std::array<double, 3>;
+
+struct XYZVSample
+{
+    double t; // TDB Julian date
+    XYZVVector position; // km
+    XYZVVector velocity; // km/s
+};
+
+// Parts of the tolerance of a compressed file taken by quantizing each of
+// time, position and velocity; the rest is left for the fit.
+constexpr double XYZVQuantumFraction = 0.125;
+
+// Position at t on the cubic Hermite segment between two samples, which is
+// how Celestia interpolates xyzv trajectories
+XYZVVector InterpolateXYZV(const XYZVSample& s0, const XYZVSample& s1, double t);
+
+// Write an index block for the times of the records; see XYZVBinaryIndex.
+bool WriteXYZVIndex(std::ostream& out, const std::vector<double>& times, double boundingRadius);
+
+bool WriteXYZVBinary(std::ostream& out, const std::vector<XYZVSample>& samples, bool withIndex);
+
+// Write the samples as a compressed file within tolerance km of them. When
+// dropSamples is false, all samples are kept as knots and they must be
+// within tolerance * (1 - 3 * XYZVQuantumFraction) of the trajectory
+// between them.
+bool WriteXYZVCompressed(std::ostream& out, const std::vector<XYZVSample>& samples,
+                         double tolerance, bool dropSamples);
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celephem/orbit.h>
+
+struct OrbitSample
+{
+    double t;
+    Eigen::Vector3d position;
+    Eigen::Vector3d velocity;
+};
+
+// Collects the samples passed to it by Orbit::sample
+class SampleCollector : public celestia::ephem::OrbitSampleProc
+{
+public:
+    void sample(double t, const Eigen::Vector3d& position, const Eigen::Vector3d& velocity) override
+    {
+        samples.push_back({ t, position, velocity });
+    }
+
+    std::vector<OrbitSample> samples;
+};
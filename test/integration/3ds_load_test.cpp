@@ -1,5 +1,6 @@
 #include <cstdint>
 #include <memory>
+#include <string>
 
 #include <catch.hpp>
 
@@ -35,3 +36,41 @@ TEST_CASE("Load a 3DS file", "[3ds] [integration]")
     REQUIRE(faceCount == 6098);
     REQUIRE(vertexCount == 3263);
 }
+
+
+namespace
+{
+
+class CountingHandler : public M3DSceneHandler
+{
+ public:
+    void material(M3DMaterial&&) override { ++materialCount; }
+    void beginObject(const std::string&) override { ++objectCount; }
+
+    void triangleMesh(M3DTriangleMesh&& mesh) override
+    {
+        ++meshCount;
+        faceCount += static_cast<std::uint32_t>(mesh.getFaceCount());
+        vertexCount += static_cast<std::uint32_t>(mesh.getVertexCount());
+    }
+
+    std::uint32_t materialCount{ 0 };
+    std::uint32_t objectCount{ 0 };
+    std::uint32_t meshCount{ 0 };
+    std::uint32_t faceCount{ 0 };
+    std::uint32_t vertexCount{ 0 };
+};
+
+} // end unnamed namespace
+
+
+TEST_CASE("Stream a 3DS file", "[3ds] [integration]")
+{
+    CountingHandler handler;
+    REQUIRE(Read3DSFile("huygens.3ds", handler));
+    REQUIRE(handler.materialCount == 4);
+    REQUIRE(handler.objectCount == 8);
+    REQUIRE(handler.meshCount == 8);
+    REQUIRE(handler.faceCount == 6098);
+    REQUIRE(handler.vertexCount == 3263);
+}
@@ -0,0 +1,75 @@
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celengine/asyncorbitsampler.h>
+#include <celengine/orbitsampler.h>
+#include <celephem/orbit.h>
+
+using celestia::ephem::EllipticalOrbit;
+
+namespace
+{
+
+std::vector<AsyncOrbitSampler::Result>
+collectAll(AsyncOrbitSampler& sampler, std::size_t count)
+{
+    std::vector<AsyncOrbitSampler::Result> results;
+    for (int i = 0; i < 1000 && results.size() < count; ++i)
+    {
+        sampler.collect(results);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return results;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Background orbit sampling", "[orbit] [integration]")
+{
+    // An asteroid and a comet
+    const EllipticalOrbit asteroid(3.5e8, 0.1, 0.2, 1.0, 2.0, 3.0, 1500.0);
+    const EllipticalOrbit comet(1.0e8, 0.9, 1.2, 0.5, 0.3, 0.1, 27000.0);
+    REQUIRE(asteroid.isThreadSafe());
+
+    SECTION("Samples match the synchronous ones")
+    {
+        AsyncOrbitSampler sampler(2);
+        sampler.request(&asteroid, 0.0, 1500.0, 1.0f);
+        sampler.request(&comet, 100.0, 27100.0, 2.0f);
+
+        auto results = collectAll(sampler, 2);
+        REQUIRE(results.size() == 2);
+
+        for (const auto& result : results)
+        {
+            OrbitSampler expected;
+            if (result.orbit == &asteroid)
+                asteroid.sample(0.0, 1500.0, expected);
+            else
+                comet.sample(100.0, 27100.0, expected);
+
+            REQUIRE(!result.samples.empty());
+            REQUIRE(result.samples.size() == expected.samples.size());
+            for (std::size_t i = 0; i < expected.samples.size(); ++i)
+            {
+                REQUIRE(result.samples[i].t == expected.samples[i].t);
+                REQUIRE(result.samples[i].position == expected.samples[i].position);
+            }
+        }
+    }
+
+    SECTION("Cleared requests are dropped")
+    {
+        // Without threads nothing is sampled until the requests are cleared
+        AsyncOrbitSampler sampler(0);
+        sampler.request(&asteroid, 0.0, 1500.0, 1.0f);
+        sampler.clear();
+
+        std::vector<AsyncOrbitSampler::Result> results;
+        sampler.collect(results);
+        REQUIRE(results.empty());
+    }
+}
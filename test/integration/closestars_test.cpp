@@ -0,0 +1,56 @@
+#include <cstdint>
+#include <map>
+#include <sstream>
+
+#include <catch.hpp>
+
+#include <celengine/stardb.h>
+
+#include "stardatfixture.h"
+
+namespace
+{
+
+constexpr std::uint32_t StarCount = 20000;
+
+std::map<AstroCatalog::IndexNumber, Eigen::Vector3f>
+bruteForce(const StarDatabase& starDB, const Eigen::Vector3f& position, float radius)
+{
+    std::map<AstroCatalog::IndexNumber, Eigen::Vector3f> result;
+    for (std::uint32_t i = 0; i < starDB.size(); ++i)
+    {
+        const Star* star = starDB.getStar(i);
+        if ((star->getPosition() - position).squaredNorm() < radius * radius)
+            result.emplace(star->getIndex(), star->getPosition());
+    }
+    return result;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Close star queries", "[stardb] [integration]")
+{
+    std::stringstream starsDat;
+    writeStarsDat(starsDat, { StarCount, 9876, 200.0f });
+
+    StarDatabase starDB;
+    REQUIRE(starDB.loadBinary(starsDat));
+    starDB.finish();
+
+    // A flight path with small steps, reusing the cache, and some jumps
+    Eigen::Vector3f position(0.0f, 0.0f, 0.0f);
+    for (int step = 0; step < 200; ++step)
+    {
+        if (step % 50 == 49)
+            position += Eigen::Vector3f(30.0f, -20.0f, 10.0f);
+        else
+            position += Eigen::Vector3f(0.05f, 0.02f, -0.03f);
+
+        for (float radius : { 1.0f, 5.0f, 12.0f })
+        {
+            StarCollector collector;
+            starDB.findCloseStars(collector, position, radius);
+            REQUIRE(collector.stars == bruteForce(starDB, position, radius));
+        }
+    }
+}
@@ -0,0 +1,142 @@
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <ios>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celcompat/filesystem.h>
+#include <celmodel/mesh.h>
+#include <celmodel/model.h>
+#include <celmodel/modelfile.h>
+#include <celutil/reshandle.h>
+
+using namespace std::string_literals;
+
+namespace
+{
+
+constexpr unsigned int VertexCount = 200000;
+constexpr unsigned int TriangleCount = 400000;
+
+ResourceHandle
+getHandle(const fs::path&)
+{
+    return 0;
+}
+
+fs::path
+getSource(ResourceHandle)
+{
+    return "texture.png";
+}
+
+std::unique_ptr<cmod::Model>
+makeModel()
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+    std::uniform_int_distribution<cmod::Index32> index(0, VertexCount - 1);
+
+    // Positions, normals and texture coordinates
+    constexpr unsigned int stride = 8;
+    std::vector<cmod::VWord> vertices(VertexCount * stride);
+    for (auto& word : vertices)
+    {
+        float f = coord(rng);
+        std::memcpy(&word, &f, sizeof(f));
+    }
+
+    std::vector<cmod::Index32> indices(TriangleCount * 3);
+    for (auto& i : indices)
+        i = index(rng);
+
+    cmod::Mesh mesh;
+    cmod::VertexDescription desc({
+        cmod::VertexAttribute(cmod::VertexAttributeSemantic::Position, cmod::VertexAttributeFormat::Float3, 0),
+        cmod::VertexAttribute(cmod::VertexAttributeSemantic::Normal, cmod::VertexAttributeFormat::Float3, 3),
+        cmod::VertexAttribute(cmod::VertexAttributeSemantic::Texture0, cmod::VertexAttributeFormat::Float2, 6),
+    });
+    mesh.setVertexDescription(std::move(desc));
+    mesh.setVertices(VertexCount, std::move(vertices));
+    mesh.addGroup(cmod::PrimitiveGroupType::TriList, 0, std::move(indices));
+
+    cmod::Material material;
+    material.setMap(cmod::TextureSemantic::DiffuseMap, 0);
+
+    auto model = std::make_unique<cmod::Model>();
+    model->addMaterial(std::move(material));
+    model->addMesh(std::move(mesh));
+    return model;
+}
+
+std::string
+saveBinary(const cmod::Model& model)
+{
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    REQUIRE(cmod::SaveModelBinary(&model, out, getSource));
+    return out.str();
+}
+
+} // end unnamed namespace
+
+TEST_CASE("CMOD binary loading", "[cmod] [integration]")
+{
+    auto model = makeModel();
+    std::string data = saveBinary(*model);
+
+    const fs::path filename = "cmod_mapped_load.cmod";
+    {
+        std::ofstream out(filename, std::ios::out | std::ios::binary);
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        REQUIRE(out.good());
+    }
+
+    SECTION("Mapped and streamed files give the same model")
+    {
+        std::unique_ptr<cmod::Model> mapped = cmod::LoadModel(filename, getHandle);
+        std::ifstream in(filename, std::ios::in | std::ios::binary);
+        std::unique_ptr<cmod::Model> streamed = cmod::LoadModel(in, getHandle);
+
+        REQUIRE(mapped != nullptr);
+        REQUIRE(streamed != nullptr);
+        REQUIRE(mapped->getVertexCount() == VertexCount);
+        REQUIRE(mapped->getPrimitiveCount() == TriangleCount);
+        REQUIRE(saveBinary(*mapped) == data);
+        REQUIRE(saveBinary(*streamed) == data);
+
+        const cmod::Mesh* mesh = mapped->getMesh(0);
+        REQUIRE(std::memcmp(mesh->getVertexData(), model->getMesh(0)->getVertexData(),
+                            VertexCount * mesh->getVertexDescription().strideBytes) == 0);
+        REQUIRE(mesh->getGroup(0)->indices == model->getMesh(0)->getGroup(0)->indices);
+    }
+
+    SECTION("Truncated files are rejected")
+    {
+        const fs::path truncated = "cmod_mapped_load_truncated.cmod";
+        {
+            std::ofstream out(truncated, std::ios::out | std::ios::binary);
+            out.write(data.data(), static_cast<std::streamsize>(data.size() / 2));
+        }
+        REQUIRE(cmod::LoadModel(truncated, getHandle) == nullptr);
+        fs::remove(truncated);
+    }
+
+    SECTION("Out of range indices are rejected")
+    {
+        std::string bad = data;
+        // Overwrite the last index, just before the end of mesh token
+        cmod::Index32 invalid = VertexCount;
+        std::memcpy(bad.data() + bad.size() - sizeof(std::int16_t) - sizeof(invalid), &invalid, sizeof(invalid));
+        std::istringstream in(bad, std::ios::in | std::ios::binary);
+        REQUIRE(cmod::LoadModel(in, getHandle) == nullptr);
+    }
+
+    fs::remove(filename);
+}
@@ -0,0 +1,105 @@
+#include <cstdint>
+#include <fstream>
+#include <ios>
+#include <memory>
+#include <sstream>
+#include <string_view>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celcompat/filesystem.h>
+#include <celengine/crossindex.h>
+#include <celutil/binarywrite.h>
+
+namespace celutil = celestia::util;
+
+namespace
+{
+
+// Catalog numbers with gaps as in HD, the Celestia numbers unordered
+std::vector<CrossIndex::Entry>
+makeEntries()
+{
+    std::vector<CrossIndex::Entry> entries;
+    std::uint32_t seed = 2468;
+    AstroCatalog::IndexNumber catalogNumber = 1;
+    for (std::uint32_t i = 0; i < 5000; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        catalogNumber += 1 + (seed >> 28);
+        entries.push_back({ catalogNumber, (seed >> 4) % 1000000 });
+    }
+
+    // A star with two numbers in the catalog
+    entries.push_back({ 5, 777777777 });
+    entries.push_back({ 6, 777777777 });
+    return entries;
+}
+
+void
+checkLookups(const CrossIndex& xindex, const std::vector<CrossIndex::Entry>& entries)
+{
+    REQUIRE(xindex.size() == entries.size());
+    for (const auto& entry : entries)
+    {
+        const CrossIndex::Entry* first = nullptr;
+        const CrossIndex::Entry* firstReverse = nullptr;
+        for (const auto& other : entries)
+        {
+            if (first == nullptr && other.catalogNumber == entry.catalogNumber)
+                first = &other;
+            if (firstReverse == nullptr && other.celCatalogNumber == entry.celCatalogNumber)
+                firstReverse = &other;
+        }
+
+        REQUIRE(xindex.findCelestiaNumber(entry.catalogNumber) == first->celCatalogNumber);
+        REQUIRE(xindex.findCatalogNumber(entry.celCatalogNumber) == firstReverse->catalogNumber);
+    }
+
+    REQUIRE(xindex.findCelestiaNumber(0) == AstroCatalog::IndexNumber(AstroCatalog::InvalidIndex));
+    REQUIRE(xindex.findCatalogNumber(1000001) == AstroCatalog::IndexNumber(AstroCatalog::InvalidIndex));
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Cross index", "[stardb] [integration]")
+{
+    const auto entries = makeEntries();
+
+    SECTION("Version 1")
+    {
+        std::stringstream in;
+        in.write("CELINDEX", 8);
+        celutil::writeLE<std::uint16_t>(in, 0x0100);
+        for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+        {
+            celutil::writeLE<std::uint32_t>(in, it->catalogNumber);
+            celutil::writeLE<std::uint32_t>(in, it->celCatalogNumber);
+        }
+
+        auto xindex = CrossIndex::read(in);
+        REQUIRE(xindex != nullptr);
+
+        std::vector<CrossIndex::Entry> reversed(entries.rbegin(), entries.rend());
+        checkLookups(*xindex, reversed);
+    }
+
+    SECTION("Version 2")
+    {
+        const fs::path path = "sorted_xindex.dat";
+        {
+            std::ofstream out(path, std::ios::out | std::ios::binary);
+            REQUIRE(CrossIndex::write(out, entries));
+        }
+
+        auto mapped = CrossIndex::open(path);
+        REQUIRE(mapped != nullptr);
+        checkLookups(*mapped, entries);
+
+        std::ifstream in(path, std::ios::in | std::ios::binary);
+        auto read = CrossIndex::read(in);
+        REQUIRE(read != nullptr);
+        checkLookups(*read, entries);
+    }
+}
@@ -0,0 +1,53 @@
+#include "dsocatalogfixture.h"
+
+#include <sstream>
+
+std::string
+makeDSOCatalog(const DSOCatalogParams& params)
+{
+    std::uint32_t seed = params.seed;
+    auto next = [&seed]()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<float>(seed >> 8) / static_cast<float>(1u << 24) - 0.5f;
+    };
+
+    std::ostringstream out;
+    for (std::uint32_t i = 0; i < params.objectCount; ++i)
+    {
+        if (!params.mixedTypes)
+        {
+            out << "OpenCluster \"\"\n{\n";
+        }
+        else
+        {
+            switch (i % 3)
+            {
+            case 0:
+                out << "OpenCluster \"OC " << i << ":Cluster " << i << "\"\n{\n";
+                break;
+            case 1:
+                out << "Globular \"GC " << i << "\"\n{\n"
+                    << "    CoreRadius " << 0.5f + next() * 0.5f << '\n'
+                    << "    KingConcentration " << 1.5f + next() << '\n';
+                break;
+            default:
+                out << "Nebula \"Neb " << i << "\"\n{\n"
+                    << "    InfoURL \"https://example.org/neb" << i << "\"\n"
+                    << "    Visible false\n";
+                break;
+            }
+        }
+
+        out << "    Position [ " << next() * params.extent << ' '
+                                 << next() * params.extent << ' '
+                                 << next() * params.extent << " ]\n"
+            << "    Axis [ 0 1 0 ]\n"
+            << "    Angle " << next() * 360.0f << '\n'
+            << "    Radius " << params.minRadius + next() << '\n'
+            << "    AbsMag " << -8.0f + next() * 8.0f << '\n'
+            << "}\n";
+    }
+
+    return out.str();
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Settings for a .dsc catalog of deep sky objects at random positions
+struct DSOCatalogParams
+{
+    std::uint32_t objectCount{ 300 };
+    std::uint32_t seed{ 13579 };
+    // Length of the sides of the cube the objects are spread over, in light
+    // years
+    float extent{ 20000.0f };
+    float minRadius{ 10.0f };
+    // Cycle through named open clusters, globulars and invisible nebulae
+    // instead of writing only unnamed open clusters
+    bool mixedTypes{ false };
+};
+
+std::string makeDSOCatalog(const DSOCatalogParams& params);
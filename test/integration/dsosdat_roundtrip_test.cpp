@@ -0,0 +1,144 @@
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celengine/deepskyobj.h>
+#include <celengine/dsodb.h>
+#include <celengine/dsoname.h>
+#include <celengine/dsosdat.h>
+#include <celengine/globular.h>
+
+#include "dsocatalogfixture.h"
+
+namespace
+{
+
+constexpr std::uint32_t ObjectCount = 300;
+
+} // end unnamed namespace
+
+TEST_CASE("Binary DSO catalog roundtrip", "[dsodb] [integration]")
+{
+    const std::string catalog = makeDSOCatalog({ ObjectCount, 13579, 20000.0f, 10.0f, true });
+
+    std::istringstream textIn(catalog);
+    DSODatabase textDB;
+    textDB.setNameDatabase(new DSONameDatabase());
+    REQUIRE(textDB.load(textIn));
+    textDB.finish();
+    REQUIRE(textDB.size() == ObjectCount);
+
+    std::istringstream entriesIn(catalog);
+    std::vector<celestia::engine::DSOsDatEntry> entries;
+    REQUIRE(celestia::engine::readDSCEntries(entriesIn, entries));
+    REQUIRE(entries.size() == ObjectCount);
+
+    std::stringstream binary;
+    REQUIRE(celestia::engine::writeDSOsDat(binary, entries));
+
+    DSODatabase binaryDB;
+    binaryDB.setNameDatabase(new DSONameDatabase());
+    REQUIRE(binaryDB.loadBinary(binary));
+    binaryDB.finish();
+    REQUIRE(binaryDB.size() == ObjectCount);
+
+    for (std::uint32_t i = 0; i < ObjectCount; ++i)
+    {
+        const DeepSkyObject* expected = textDB.getDSO(i);
+        const DeepSkyObject* actual = binaryDB.getDSO(i);
+
+        REQUIRE(actual->getIndex() == expected->getIndex());
+        REQUIRE(std::string(actual->getObjTypeName()) == expected->getObjTypeName());
+        REQUIRE(actual->getPosition() == expected->getPosition());
+        REQUIRE(actual->getOrientation().coeffs() == expected->getOrientation().coeffs());
+        REQUIRE(actual->getRadius() == expected->getRadius());
+        REQUIRE(actual->getAbsoluteMagnitude() == expected->getAbsoluteMagnitude());
+        REQUIRE(actual->getBoundingSphereRadius() == expected->getBoundingSphereRadius());
+        REQUIRE(actual->isVisible() == expected->isVisible());
+        REQUIRE(actual->getInfoURL() == expected->getInfoURL());
+        REQUIRE(binaryDB.getDSONameList(actual) == textDB.getDSONameList(expected));
+
+        if (auto expectedGlobular = dynamic_cast<const Globular*>(expected); expectedGlobular != nullptr)
+        {
+            auto actualGlobular = dynamic_cast<const Globular*>(actual);
+            REQUIRE(actualGlobular != nullptr);
+            REQUIRE(actualGlobular->getCoreRadius() == expectedGlobular->getCoreRadius());
+            REQUIRE(actualGlobular->getKingConcentration() == expectedGlobular->getKingConcentration());
+        }
+    }
+
+    const DeepSkyObject* cluster = binaryDB.find("Cluster 3", false);
+    REQUIRE(cluster != nullptr);
+    REQUIRE(binaryDB.find("OC 3", false) == cluster);
+}
+
+TEST_CASE("Binary DSO catalog rejects bad files", "[dsodb] [integration]")
+{
+    std::vector<celestia::engine::DSOsDatEntry> entries(1);
+    entries[0].name = "Test";
+
+    std::stringstream binary;
+    REQUIRE(celestia::engine::writeDSOsDat(binary, entries));
+    std::string data = binary.str();
+
+    SECTION("Truncated")
+    {
+        std::istringstream in(data.substr(0, data.size() - 1));
+        DSODatabase db;
+        REQUIRE(!db.loadBinary(in));
+    }
+
+    SECTION("Bad magic")
+    {
+        data[0] = 'X';
+        std::istringstream in(data);
+        DSODatabase db;
+        REQUIRE(!db.loadBinary(in));
+    }
+}
+
+TEST_CASE("DSO catalog built from entries", "[dsodb] [integration]")
+{
+    SECTION("Empty")
+    {
+        DSODatabase db;
+        db.setNameDatabase(new DSONameDatabase());
+        db.finish();
+        REQUIRE(db.size() == 0);
+        REQUIRE(db.getAverageAbsoluteMagnitude() == 0.0f);
+        REQUIRE(db.find("Cluster 3", false) == nullptr);
+    }
+
+    SECTION("Entry by entry")
+    {
+        const std::string catalog = makeDSOCatalog({ ObjectCount, 13579, 20000.0f, 10.0f, true });
+
+        std::istringstream textIn(catalog);
+        DSODatabase textDB;
+        textDB.setNameDatabase(new DSONameDatabase());
+        REQUIRE(textDB.load(textIn));
+        textDB.finish();
+
+        std::istringstream entriesIn(catalog);
+        std::vector<celestia::engine::DSOsDatEntry> entries;
+        REQUIRE(celestia::engine::readDSCEntries(entriesIn, entries));
+
+        DSODatabase db;
+        db.setNameDatabase(new DSONameDatabase());
+        db.reserve(entries.size());
+        for (const auto& entry : entries)
+            db.addEntry(entry);
+        db.finish();
+        REQUIRE(db.size() == textDB.size());
+
+        for (std::uint32_t i = 0; i < db.size(); ++i)
+        {
+            REQUIRE(db.getDSO(i)->getIndex() == textDB.getDSO(i)->getIndex());
+            REQUIRE(db.getDSO(i)->getPosition() == textDB.getDSO(i)->getPosition());
+            REQUIRE(db.getDSONameList(db.getDSO(i)) == textDB.getDSONameList(textDB.getDSO(i)));
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#include <cstdint>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celengine/dsodb.h>
+
+#include "dsocatalogfixture.h"
+
+namespace
+{
+
+constexpr std::uint32_t ClusterCount = 20000;
+
+class DSOCollector : public DSOHandler
+{
+public:
+    void process(DeepSkyObject* const& dso, double distance, float /*absMag*/) override
+    {
+        dsos.emplace(dso, distance);
+        ++processed;
+    }
+
+    std::map<const DeepSkyObject*, double> dsos;
+    std::size_t processed{ 0 };
+};
+
+} // end unnamed namespace
+
+TEST_CASE("Parallel DSO octree traversal", "[dsodb] [integration]")
+{
+    std::istringstream catalog(makeDSOCatalog({ ClusterCount, 24680, 200000.0f, 1.0f }));
+
+    DSODatabase dsoDB;
+    REQUIRE(dsoDB.load(catalog));
+    dsoDB.finish();
+    REQUIRE(dsoDB.size() == ClusterCount);
+
+    const Eigen::Vector3d position(100.0, -2000.0, 500.0);
+    const Eigen::Quaternionf orientation(Eigen::AngleAxisf(0.5f, Eigen::Vector3f::UnitY()));
+    constexpr float fovY = 1.0f;
+    constexpr float aspectRatio = 1.5f;
+    constexpr float limitingMag = 16.0f;
+
+    DSOCollector serial;
+    dsoDB.findVisibleDSOs(serial, position, orientation, fovY, aspectRatio, limitingMag);
+    REQUIRE(!serial.dsos.empty());
+    REQUIRE(serial.dsos.size() < ClusterCount);
+
+    std::vector<DSOCollector> collectors(4);
+    std::vector<DSOHandler*> handlers;
+    for (auto& collector : collectors)
+        handlers.push_back(&collector);
+
+    dsoDB.findVisibleDSOs(handlers, position, orientation, fovY, aspectRatio, limitingMag);
+
+    // Every DSO is handed to exactly one of the handlers
+    std::map<const DeepSkyObject*, double> parallel;
+    std::size_t processed = 0;
+    for (const auto& collector : collectors)
+    {
+        parallel.insert(collector.dsos.begin(), collector.dsos.end());
+        processed += collector.processed;
+    }
+
+    REQUIRE(processed == serial.processed);
+    REQUIRE(parallel == serial.dsos);
+}
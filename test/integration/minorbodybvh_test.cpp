@@ -0,0 +1,147 @@
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celcompat/numbers.h>
+#include <celengine/body.h>
+#include <celengine/frame.h>
+#include <celengine/frametree.h>
+#include <celengine/minorbodybvh.h>
+#include <celengine/solarsys.h>
+#include <celengine/star.h>
+#include <celengine/timeline.h>
+#include <celengine/timelinephase.h>
+#include <celephem/orbit.h>
+#include <celephem/rotation.h>
+
+using celestia::ephem::ConstantOrientation;
+using celestia::ephem::EllipticalOrbit;
+using celestia::ephem::Orbit;
+
+namespace
+{
+
+constexpr double AU = 1.495978707e8;
+constexpr unsigned int AsteroidCount = 2000;
+constexpr unsigned int CometCount = 50;
+
+class TestSystem
+{
+public:
+    TestSystem() :
+        solarSystem(&star),
+        frame(std::make_shared<J2000EclipticFrame>(Selection(&star))),
+        rotation(Eigen::Quaterniond::Identity())
+    {
+        std::uint32_t seed = 13579;
+        auto next = [&seed]()
+        {
+            seed = seed * 1664525u + 1013904223u;
+            return static_cast<double>(seed >> 8) / static_cast<double>(1u << 24);
+        };
+
+        for (unsigned int i = 0; i < AsteroidCount + CometCount; i++)
+        {
+            bool comet = i >= AsteroidCount;
+            double a = comet ? (5.0 + next() * 20.0) * AU : (2.0 + next() * 2.0) * AU;
+            double e = comet ? 0.9 + next() * 0.09 : next() * 0.3;
+            double period = 365.25 * std::pow(a / AU, 1.5);
+
+            orbits.push_back(std::make_unique<EllipticalOrbit>(a * (1.0 - e), e,
+                                                               next() * 0.5,
+                                                               next() * 2.0 * celestia::numbers::pi,
+                                                               next() * 2.0 * celestia::numbers::pi,
+                                                               next() * 2.0 * celestia::numbers::pi,
+                                                               period));
+
+            auto* body = new Body(solarSystem.getPlanets(), "");
+            body->setClassification(comet ? Body::Comet : Body::Asteroid);
+            body->setSemiAxes(Eigen::Vector3f::Constant(1.0f + static_cast<float>(next()) * 50.0f));
+
+            auto phase = std::make_shared<const TimelinePhase>(body,
+                                                               -1.0e9, 1.0e9,
+                                                               frame, orbits.back().get(),
+                                                               frame, &rotation,
+                                                               solarSystem.getFrameTree());
+            auto* timeline = new Timeline();
+            timeline->appendPhase(phase);
+            body->setTimeline(timeline);
+            solarSystem.getFrameTree()->addChild(phase);
+        }
+
+        solarSystem.getFrameTree()->recomputeBoundingSphere();
+    }
+
+    FrameTree& tree() const { return *solarSystem.getFrameTree(); }
+
+private:
+    Star star;
+    SolarSystem solarSystem;
+    ReferenceFrame::SharedConstPtr frame;
+    ConstantOrientation rotation;
+    std::vector<std::unique_ptr<Orbit>> orbits;
+};
+
+} // end unnamed namespace
+
+TEST_CASE("Minor body BVH", "[frametree] [integration]")
+{
+    TestSystem system;
+    FrameTree& tree = system.tree();
+    MinorBodyBVH* bvh = tree.getMinorBodyBVH();
+    REQUIRE(bvh != nullptr);
+
+    std::uint32_t stamp = 0;
+    const double startTime = 2451545.0;
+
+    SECTION("Bodies stay within their nodes as time advances")
+    {
+        // Small steps, then jumps forcing refits and rebuilds
+        std::vector<double> times;
+        for (int i = 0; i < 40; i++)
+            times.push_back(startTime + i * 0.37);
+        for (int i = 0; i < 40; i++)
+            times.push_back(startTime + 20.0 + i * 11.3);
+        times.push_back(startTime - 5000.0);
+
+        for (double t : times)
+        {
+            bvh->update(tree, t);
+            for (unsigned int i = 0; i < tree.childCount(); i += 7)
+            {
+                REQUIRE(bvh->covers(i));
+                Eigen::Vector3d position = tree.getChild(i)->orbit()->positionAtTime(t);
+                bvh->cull([&position](const MinorBodyBVH::Node& node)
+                          { return (position - node.center).norm() <= node.radius; },
+                          ++stamp);
+                REQUIRE(!bvh->isCulled(i, stamp));
+            }
+        }
+    }
+
+    SECTION("Culling a small region rejects most bodies")
+    {
+        bvh->update(tree, startTime);
+        const Eigen::Vector3d center(2.5 * AU, 0.0, 0.0);
+        const double radius = 0.2 * AU;
+        bvh->cull([&](const MinorBodyBVH::Node& node)
+                  { return (node.center - center).norm() <= node.radius + radius; },
+                  ++stamp);
+
+        unsigned int nCulled = 0;
+        for (unsigned int i = 0; i < tree.childCount(); i++)
+        {
+            Eigen::Vector3d position = tree.getChild(i)->orbit()->positionAtTime(startTime);
+            if (bvh->isCulled(i, stamp))
+            {
+                REQUIRE((position - center).norm() > radius);
+                ++nCulled;
+            }
+        }
+
+        REQUIRE(nCulled > tree.childCount() / 2);
+    }
+}
@@ -0,0 +1,71 @@
+#include <fstream>
+#include <ios>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celcompat/filesystem.h>
+#include <celengine/starname.h>
+
+TEST_CASE("Compiled name database roundtrip", "[NameDatabase] [integration]")
+{
+    std::istringstream starNames("32349:Sirius:ALF CMa:9 CMa\n"
+                                 "30438:Canopus:ALF Car\n"
+                                 "71683:Rigil Kentaurus:ALF1 Cen\n");
+
+    std::unique_ptr<StarNameDatabase> textDB(StarNameDatabase::readNames(starNames));
+    REQUIRE(textDB != nullptr);
+    for (AstroCatalog::IndexNumber i = 1; i <= 5000; ++i)
+        textDB->add(i * 7, "HIP " + std::to_string(i * 7));
+
+    const fs::path compiledPath = "starnames_compiled.dat";
+    {
+        std::ofstream out(compiledPath, std::ios::out | std::ios::binary);
+        REQUIRE(textDB->writeBinary(out));
+    }
+
+    REQUIRE(NameDatabase::isBinary(compiledPath));
+    StarNameDatabase binaryDB;
+    REQUIRE(binaryDB.loadBinary(compiledPath));
+    REQUIRE(binaryDB.getNameCount() == textDB->getNameCount());
+
+    SECTION("Lookups")
+    {
+        REQUIRE(binaryDB.getCatalogNumberByName("sirius", true) == 32349);
+        REQUIRE(binaryDB.findCatalogNumberByName("alpha Car", false) == 30438);
+        REQUIRE(binaryDB.getNameByCatalogNumber(71683) == "Rigil Kentaurus");
+        for (AstroCatalog::IndexNumber i = 1; i <= 5000; ++i)
+            REQUIRE(binaryDB.getCatalogNumberByName("HIP " + std::to_string(i * 7), false) == i * 7);
+
+        std::vector<std::string> names;
+        for (auto iter = binaryDB.getFirstNameIter(32349); iter != binaryDB.getFinalNameIter(); ++iter)
+            names.emplace_back(*iter);
+        REQUIRE(names.size() == 3);
+        REQUIRE(names[0] == "Sirius");
+    }
+
+    SECTION("Completion")
+    {
+        std::vector<std::string> expected;
+        textDB->getCompletion(expected, "hip 12", true);
+        std::vector<std::string> completion;
+        binaryDB.getCompletion(completion, "hip 12", true);
+        REQUIRE(!completion.empty());
+        REQUIRE(completion == expected);
+    }
+
+    SECTION("Names added to the mapped database")
+    {
+        binaryDB.add(32349, "Dog Star");
+        binaryDB.erase(30438);
+        REQUIRE(binaryDB.getCatalogNumberByName("Dog Star", false) == 32349);
+        REQUIRE(binaryDB.getCatalogNumberByName("Sirius", false) == 32349);
+        REQUIRE(binaryDB.getNameByCatalogNumber(30438).empty());
+
+        std::vector<std::string> completion;
+        binaryDB.getCompletion(completion, "dog", false);
+        REQUIRE(completion == std::vector<std::string>{ "Dog Star" });
+    }
+}
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <ios>
+#include <sstream>
+#include <system_error>
+#include <thread>
+
+#include <catch.hpp>
+
+#include <celcompat/filesystem.h>
+#include <celengine/pagedstarcatalog.h>
+#include <celengine/stardb.h>
+
+#include "stardatfixture.h"
+
+namespace
+{
+
+// More than fit in a single page
+constexpr std::uint32_t StarCount = 100000;
+
+// A directory of its own for the catalog file, removed with its contents
+class TempDirectory
+{
+ public:
+    explicit TempDirectory(const char* name) :
+        path(fs::temp_directory_path() / name)
+    {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+        fs::create_directories(path, ec);
+    }
+
+    ~TempDirectory()
+    {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    }
+
+    fs::path path;
+};
+
+} // end unnamed namespace
+
+TEST_CASE("Paged star catalog", "[stardb] [integration]")
+{
+    // Declared first, so that the catalog is closed before it's removed
+    TempDirectory directory("celestia-pagedstarcatalog");
+
+    std::stringstream starsDat;
+    writeStarsDat(starsDat, { StarCount, 54321, 2000.0f });
+
+    StarDatabase starDB;
+    REQUIRE(starDB.loadBinary(starsDat));
+    starDB.finish();
+
+    const fs::path sortedPath = directory.path / "paged_stars.dat";
+    {
+        std::ofstream out(sortedPath, std::ios::out | std::ios::binary);
+        REQUIRE(starDB.writeSortedBinary(out));
+    }
+
+    const Eigen::Vector3f position(10.0f, -20.0f, 5.0f);
+    const Eigen::Quaternionf orientation = Eigen::Quaternionf::Identity();
+    const Eigen::Vector3f viewDirection = orientation.conjugate() * -Eigen::Vector3f::UnitZ();
+    constexpr float fovY = 1.0f;
+    constexpr float aspectRatio = 1.5f;
+    constexpr float limitingMag = 9.0f;
+
+    StarCollector inMemory;
+    starDB.findVisibleStars(inMemory, position, orientation, fovY, aspectRatio, limitingMag);
+    REQUIRE(!inMemory.stars.empty());
+
+    auto checkLayout = [&](bool quantized)
+    {
+        auto pagedCatalog = PagedStarCatalog::open(sortedPath, std::size_t(64) << 20, quantized);
+        REQUIRE(pagedCatalog != nullptr);
+        REQUIRE(pagedCatalog->size() == StarCount);
+        starDB.setPagedCatalog(std::move(pagedCatalog));
+
+        // Keep traversing until all the pages in view have been loaded
+        StarCollector paged;
+        for (int frame = 0; frame < 1000; ++frame)
+        {
+            starDB.getPagedCatalog()->update();
+            paged = StarCollector();
+            starDB.findVisiblePagedStars(paged, position, orientation, fovY, aspectRatio, limitingMag);
+            if (std::all_of(inMemory.stars.begin(), inMemory.stars.end(),
+                            [&paged](const auto& star) { return paged.stars.count(star.first) == 1; }))
+            {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        // The main catalog also rejects the stars behind the observer
+        for (const auto& [index, starPosition] : inMemory.stars)
+            REQUIRE(paged.stars.count(index) == 1);
+        for (const auto& [index, starPosition] : paged.stars)
+        {
+            if (inMemory.stars.count(index) == 0)
+                REQUIRE((starPosition - position).dot(viewDirection) < 0.0f);
+        }
+
+        REQUIRE(starDB.getPagedCatalog()->getLoadedSize() > 0);
+    };
+
+    SECTION("Full layout")
+    {
+        checkLayout(false);
+    }
+
+    SECTION("Quantized layout")
+    {
+        checkLayout(true);
+    }
+}
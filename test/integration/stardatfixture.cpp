@@ -0,0 +1,48 @@
+#include "stardatfixture.h"
+
+#include <ostream>
+#include <string_view>
+
+#include <celengine/stellarclass.h>
+#include <celutil/binarywrite.h>
+
+namespace celutil = celestia::util;
+
+void
+writeStarsDat(std::ostream& out, const StarsDatParams& params)
+{
+    constexpr std::string_view magic = "CELSTARS";
+    out.write(magic.data(), magic.size());
+    celutil::writeLE<std::uint16_t>(out, 0x0100);
+    celutil::writeLE<std::uint32_t>(out, params.starCount);
+
+    std::uint16_t spectralType = StellarClass(StellarClass::NormalStar,
+                                              StellarClass::Spectral_G,
+                                              2,
+                                              StellarClass::Lum_V).packV1();
+    std::uint32_t seed = params.seed;
+    auto next = [&seed]()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<float>(seed >> 8) / static_cast<float>(1u << 24) - 0.5f;
+    };
+
+    for (std::uint32_t i = 0; i < params.starCount; ++i)
+    {
+        celutil::writeLE<std::uint32_t>(out, params.reverseCatalogNumbers ? (params.starCount - i) * 10 : i + 1);
+        celutil::writeLE<float>(out, next() * params.extent);
+        celutil::writeLE<float>(out, next() * params.extent);
+        celutil::writeLE<float>(out, next() * params.extent);
+        auto absMag = params.coarseMagnitudes
+                    ? static_cast<std::int16_t>(static_cast<std::int16_t>(next() * 20.0f) * 256)
+                    : static_cast<std::int16_t>(next() * 20.0f * 256.0f);
+        celutil::writeLE<std::int16_t>(out, absMag);
+        celutil::writeLE<std::uint16_t>(out, spectralType);
+    }
+}
+
+void
+StarCollector::process(const Star& star, float /*distance*/, float /*appMag*/)
+{
+    stars.emplace(star.getIndex(), star.getPosition());
+}
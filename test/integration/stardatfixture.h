@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+
+#include <Eigen/Core>
+
+#include <celengine/astroobj.h>
+#include <celengine/star.h>
+#include <celengine/stardb.h>
+
+// Settings for a stars.dat file of G2V stars at random positions
+struct StarsDatParams
+{
+    std::uint32_t starCount{ 1000 };
+    std::uint32_t seed{ 12345 };
+    // Length of the sides of the cube the stars are spread over, in light
+    // years
+    float extent{ 500.0f };
+    // Number the stars 10 * (starCount - i) instead of i + 1, so that the
+    // catalog numbers aren't in the order of the records
+    bool reverseCatalogNumbers{ false };
+    // Round the absolute magnitudes to whole numbers, so that many stars
+    // compare equal
+    bool coarseMagnitudes{ false };
+};
+
+void writeStarsDat(std::ostream& out, const StarsDatParams& params);
+
+// Collects the stars passed to it, keyed by catalog number
+class StarCollector : public StarHandler
+{
+public:
+    void process(const Star& star, float distance, float appMag) override;
+
+    std::map<AstroCatalog::IndexNumber, Eigen::Vector3f> stars;
+};
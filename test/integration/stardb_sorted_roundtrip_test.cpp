@@ -0,0 +1,61 @@
+#include <cstdint>
+#include <fstream>
+#include <ios>
+#include <sstream>
+
+#include <catch.hpp>
+
+#include <celcompat/filesystem.h>
+#include <celengine/stardb.h>
+
+#include "stardatfixture.h"
+
+namespace
+{
+
+constexpr std::uint32_t StarCount = 2000;
+
+} // end unnamed namespace
+
+TEST_CASE("Sorted star database roundtrip", "[stardb] [integration]")
+{
+    std::stringstream starsDat;
+    writeStarsDat(starsDat, { StarCount, 12345, 500.0f, true });
+
+    StarDatabase starDB;
+    REQUIRE(starDB.loadBinary(starsDat));
+    starDB.finish();
+    REQUIRE(starDB.size() == StarCount);
+
+    const fs::path sortedPath = "sorted_stars.dat";
+    {
+        std::ofstream out(sortedPath, std::ios::out | std::ios::binary);
+        REQUIRE(starDB.writeSortedBinary(out));
+    }
+
+    REQUIRE(StarDatabase::isSortedBinary(sortedPath));
+
+    StarDatabase sortedDB;
+    REQUIRE(sortedDB.loadSortedBinary(sortedPath));
+    sortedDB.finish();
+    REQUIRE(sortedDB.size() == StarCount);
+
+    // The stars must be in the same order, as the octree is reused
+    for (std::uint32_t i = 0; i < StarCount; ++i)
+    {
+        const Star* star = starDB.getStar(i);
+        const Star* sortedStar = sortedDB.getStar(i);
+        REQUIRE(sortedStar->getIndex() == star->getIndex());
+        REQUIRE(sortedStar->getPosition() == star->getPosition());
+        REQUIRE(sortedStar->getAbsoluteMagnitude() == star->getAbsoluteMagnitude());
+        REQUIRE(sortedDB.find(star->getIndex()) == sortedStar);
+    }
+
+    // Writing the loaded database gives back the same file
+    std::stringstream rewritten;
+    REQUIRE(sortedDB.writeSortedBinary(rewritten));
+    std::ifstream in(sortedPath, std::ios::in | std::ios::binary);
+    std::stringstream original;
+    original << in.rdbuf();
+    REQUIRE(rewritten.str() == original.str());
+}
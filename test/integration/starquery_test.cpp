@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celengine/stardb.h>
+#include <celengine/starquery.h>
+
+#include "stardatfixture.h"
+
+namespace
+{
+
+// Enough stars for the search to be split into several chunks
+constexpr std::uint32_t StarCount = 150000;
+
+struct CloserStar
+{
+    Eigen::Vector3f pos;
+    bool operator()(const Star* star0, const Star* star1) const
+    {
+        return (pos - star0->getPosition()).squaredNorm() < (pos - star1->getPosition()).squaredNorm();
+    }
+};
+
+struct BrighterStar
+{
+    bool operator()(const Star* star0, const Star* star1) const
+    {
+        return star0->getAbsoluteMagnitude() < star1->getAbsoluteMagnitude();
+    }
+};
+
+struct OddStarFilter
+{
+    bool operator()(const Star* star) const { return (star->getIndex() & 1) != 0; }
+};
+
+template<typename Pred, typename Filter>
+std::vector<Star*>
+bruteForce(const StarDatabase& starDB, Pred pred, Filter filter, std::size_t nStars)
+{
+    std::vector<Star*> stars;
+    for (std::uint32_t i = 0; i < starDB.size(); ++i)
+    {
+        if (!filter(starDB.getStar(i)))
+            stars.push_back(starDB.getStar(i));
+    }
+    std::stable_sort(stars.begin(), stars.end(), pred);
+    stars.resize(std::min(nStars, stars.size()));
+    return stars;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Best star queries", "[stardb] [integration]")
+{
+    std::stringstream starsDat;
+    writeStarsDat(starsDat, { StarCount, 13579, 2000.0f, false, true });
+
+    StarDatabase starDB;
+    REQUIRE(starDB.loadBinary(starsDat));
+    starDB.finish();
+    REQUIRE(starDB.size() == StarCount);
+
+    const CloserStar closer{ Eigen::Vector3f(10.0f, -300.0f, 50.0f) };
+    auto noFilter = [](const Star*) { return false; };
+
+    SECTION("Nearest stars")
+    {
+        auto expected = bruteForce(starDB, closer, noFilter, 500);
+        for (unsigned int nThreads : { 1u, 4u })
+            REQUIRE(celestia::engine::findBestStars(starDB, closer, noFilter, 500, nThreads) == expected);
+    }
+
+    SECTION("Ties keep the database order")
+    {
+        auto expected = bruteForce(starDB, BrighterStar(), OddStarFilter(), 1000);
+        for (unsigned int nThreads : { 1u, 4u })
+            REQUIRE(celestia::engine::findBestStars(starDB, BrighterStar(), OddStarFilter(), 1000, nThreads) == expected);
+    }
+
+    SECTION("More stars than the database holds")
+    {
+        auto stars = celestia::engine::findBestStars(starDB, closer, OddStarFilter(), StarCount, 4);
+        REQUIRE(stars == bruteForce(starDB, closer, OddStarFilter(), StarCount));
+        REQUIRE(stars.size() == StarCount / 2);
+    }
+
+    SECTION("Cancelled")
+    {
+        std::atomic<bool> cancelled{ true };
+        REQUIRE(celestia::engine::findBestStars(starDB, closer, noFilter, 10, 4, &cancelled).empty());
+    }
+
+    SECTION("Stars of a range")
+    {
+        constexpr std::uint32_t first = 1000;
+        constexpr std::uint32_t last = StarCount - 1000;
+        std::vector<Star*> expected;
+        for (std::uint32_t i = first; i < last; ++i)
+        {
+            if (!OddStarFilter()(starDB.getStar(i)))
+                expected.push_back(starDB.getStar(i));
+        }
+        for (unsigned int nThreads : { 1u, 4u })
+            REQUIRE(celestia::engine::findStars(starDB, first, last, OddStarFilter(), nThreads) == expected);
+
+        REQUIRE(celestia::engine::findStars(starDB, 0, StarCount * 2, noFilter, 4).size() == StarCount);
+        REQUIRE(celestia::engine::findStars(starDB, StarCount, StarCount * 2, noFilter, 4).empty());
+    }
+
+    SECTION("Asynchronous")
+    {
+        celestia::engine::StarQuery query;
+        REQUIRE(!query.running());
+        query.start(starDB, BrighterStar(), noFilter, 100);
+        REQUIRE(query.running());
+        // Restarting cancels the first search
+        query.start(starDB, closer, noFilter, 100);
+        REQUIRE(query.get() == bruteForce(starDB, closer, noFilter, 100));
+        REQUIRE(!query.running());
+    }
+}
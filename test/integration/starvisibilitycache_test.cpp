@@ -0,0 +1,63 @@
+#include <cstdint>
+#include <sstream>
+
+#include <catch.hpp>
+
+#include <celengine/stardb.h>
+#include <celengine/starvisibilitycache.h>
+#include <celutil/array_view.h>
+
+#include "stardatfixture.h"
+
+namespace celutil = celestia::util;
+
+namespace
+{
+
+constexpr std::uint32_t StarCount = 50000;
+
+} // end unnamed namespace
+
+TEST_CASE("Star visibility cache", "[stardb] [integration]")
+{
+    std::stringstream starsDat;
+    writeStarsDat(starsDat, { StarCount, 24680, 1000.0f });
+
+    StarDatabase starDB;
+    REQUIRE(starDB.loadBinary(starsDat));
+    starDB.finish();
+
+    StarVisibilityCache cache;
+    constexpr float fovY = 0.8f;
+    constexpr float aspectRatio = 1.6f;
+    constexpr float limitingMag = 8.0f;
+
+    // Slow drift and rotation, with occasional jumps which invalidate the
+    // cache
+    Eigen::Vector3f position(1.0f, 2.0f, -3.0f);
+    Eigen::Quaternionf orientation = Eigen::Quaternionf::Identity();
+    for (int frame = 0; frame < 300; ++frame)
+    {
+        if (frame % 100 == 99)
+        {
+            position += Eigen::Vector3f(5.0f, 0.0f, 0.0f);
+            orientation = Eigen::Quaternionf(Eigen::AngleAxisf(1.0f, Eigen::Vector3f::UnitX())) * orientation;
+        }
+        else
+        {
+            position += Eigen::Vector3f(2.0e-5f, -1.0e-5f, 0.0f);
+            orientation = Eigen::Quaternionf(Eigen::AngleAxisf(0.002f, Eigen::Vector3f::UnitY())) * orientation;
+        }
+
+        StarCollector full;
+        starDB.findVisibleStars(full, position, orientation, fovY, aspectRatio, limitingMag);
+
+        StarCollector cached;
+        StarHandler* handler = &cached;
+        starDB.findVisibleStars(celutil::array_view<StarHandler*>(&handler, 1),
+                                position, orientation, fovY, aspectRatio, limitingMag,
+                                cache);
+
+        REQUIRE(cached.stars == full.stars);
+    }
+}
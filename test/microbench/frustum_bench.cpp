@@ -0,0 +1,58 @@
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <catch.hpp>
+
+#include <celmath/frustum.h>
+
+using celmath::Frustum;
+using celmath::SphereBatch;
+
+namespace
+{
+
+// Bodies scattered around the observer, most of them outside the view
+SphereBatch
+getSpheres()
+{
+    std::mt19937 rng(13);
+    std::uniform_real_distribution<float> position(-1.0e6f, 1.0e6f);
+    std::uniform_real_distribution<float> radius(1.0f, 1.0e4f);
+    SphereBatch spheres;
+    for (int i = 0; i < 10000; i++)
+        spheres.add(Eigen::Vector3f(position(rng), position(rng), position(rng)), radius(rng));
+    return spheres;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Frustum sphere tests", "[!benchmark][Frustum]")
+{
+    SphereBatch spheres = getSpheres();
+    Frustum frustum(0.8f, 1.6f, 1.0f);
+    frustum.transform(Eigen::Matrix3f(Eigen::AngleAxisf(0.5f, Eigen::Vector3f::UnitX())));
+    std::vector<Frustum::Aspect> aspects;
+
+    BENCHMARK("10000 spheres, one at a time")
+    {
+        int visible = 0;
+        for (std::size_t i = 0; i < spheres.size(); i++)
+        {
+            Eigen::Vector3f center(spheres.x[i], spheres.y[i], spheres.z[i]);
+            if (frustum.testSphere(center, spheres.radii[i]) != Frustum::Outside)
+                ++visible;
+        }
+        return visible;
+    };
+
+    BENCHMARK("10000 spheres, batch")
+    {
+        frustum.testSpheres(spheres, aspects);
+        int visible = 0;
+        for (Frustum::Aspect aspect : aspects)
+            visible += aspect != Frustum::Outside ? 1 : 0;
+        return visible;
+    };
+}
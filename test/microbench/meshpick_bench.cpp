@@ -0,0 +1,108 @@
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celmodel/mesh.h>
+#include <celmodel/meshbvh.h>
+
+using namespace cmod;
+
+namespace
+{
+
+// A bumpy height field over the unit square
+Mesh
+makeMesh(int size)
+{
+    std::vector<VWord> vertices;
+    for (int y = 0; y <= size; y++)
+    {
+        for (int x = 0; x <= size; x++)
+        {
+            float fx = static_cast<float>(x) / static_cast<float>(size);
+            float fy = static_cast<float>(y) / static_cast<float>(size);
+            float v[3] = { fx, fy, 0.1f * std::sin(fx * 17.0f) * std::cos(fy * 11.0f) };
+            VWord w[3];
+            std::memcpy(w, v, sizeof(v));
+            vertices.insert(vertices.end(), w, w + 3);
+        }
+    }
+
+    Mesh mesh;
+    VertexDescription desc({ VertexAttribute(VertexAttributeSemantic::Position, VertexAttributeFormat::Float3, 0) });
+    desc.strideBytes = 3 * sizeof(VWord);
+    mesh.setVertexDescription(std::move(desc));
+    mesh.setVertices((size + 1) * (size + 1), std::move(vertices));
+
+    auto index = [size](int x, int y) { return static_cast<Index32>(y * (size + 1) + x); };
+    std::vector<Index32> list;
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            list.insert(list.end(), { index(x, y), index(x + 1, y), index(x, y + 1) });
+            list.insert(list.end(), { index(x + 1, y), index(x + 1, y + 1), index(x, y + 1) });
+        }
+    }
+    mesh.addGroup(PrimitiveGroupType::TriList, 0, std::move(list));
+
+    return mesh;
+}
+
+struct Ray
+{
+    Eigen::Vector3d origin;
+    Eigen::Vector3d direction;
+};
+
+// Rays from above, some of which miss the mesh
+std::vector<Ray>
+makeRays(int count)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> dist(-0.2, 1.2);
+    std::vector<Ray> rays;
+    for (int i = 0; i < count; i++)
+    {
+        Eigen::Vector3d origin(dist(rng), dist(rng), 2.0);
+        Eigen::Vector3d target(dist(rng), dist(rng), 0.0);
+        rays.push_back({ origin, target - origin });
+    }
+    return rays;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Mesh picking", "[!benchmark][Mesh]")
+{
+    // 80000 triangles
+    Mesh mesh = makeMesh(200);
+    MeshBVH bvh(mesh);
+    std::vector<Ray> rays = makeRays(100);
+
+    BENCHMARK("100 rays, Mesh::pick")
+    {
+        int hits = 0;
+        for (const Ray& ray : rays)
+        {
+            double distance;
+            hits += mesh.pick(ray.origin, ray.direction, distance) ? 1 : 0;
+        }
+        return hits;
+    };
+
+    BENCHMARK("100 rays, MeshBVH::pick")
+    {
+        int hits = 0;
+        for (const Ray& ray : rays)
+        {
+            Mesh::PickResult result;
+            hits += bvh.pick(ray.origin, ray.direction, &result) ? 1 : 0;
+        }
+        return hits;
+    };
+}
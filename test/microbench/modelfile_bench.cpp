@@ -0,0 +1,113 @@
+#include <cstring>
+#include <fstream>
+#include <ios>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celcompat/filesystem.h>
+#include <celmodel/mesh.h>
+#include <celmodel/model.h>
+#include <celmodel/modelfile.h>
+#include <celutil/reshandle.h>
+
+namespace
+{
+
+constexpr unsigned int VertexCount = 100000;
+constexpr unsigned int TriangleCount = 200000;
+
+ResourceHandle
+getHandle(const fs::path&)
+{
+    return 0;
+}
+
+fs::path
+getSource(ResourceHandle)
+{
+    return "texture.png";
+}
+
+// One mesh of positions, normals and texture coordinates
+std::unique_ptr<cmod::Model>
+makeModel()
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+    std::uniform_int_distribution<cmod::Index32> index(0, VertexCount - 1);
+
+    constexpr unsigned int stride = 8;
+    std::vector<cmod::VWord> vertices(VertexCount * stride);
+    for (auto& word : vertices)
+    {
+        float f = coord(rng);
+        std::memcpy(&word, &f, sizeof(f));
+    }
+
+    std::vector<cmod::Index32> indices(TriangleCount * 3);
+    for (auto& i : indices)
+        i = index(rng);
+
+    cmod::Mesh mesh;
+    cmod::VertexDescription desc({
+        cmod::VertexAttribute(cmod::VertexAttributeSemantic::Position, cmod::VertexAttributeFormat::Float3, 0),
+        cmod::VertexAttribute(cmod::VertexAttributeSemantic::Normal, cmod::VertexAttributeFormat::Float3, 3),
+        cmod::VertexAttribute(cmod::VertexAttributeSemantic::Texture0, cmod::VertexAttributeFormat::Float2, 6),
+    });
+    mesh.setVertexDescription(std::move(desc));
+    mesh.setVertices(VertexCount, std::move(vertices));
+    mesh.addGroup(cmod::PrimitiveGroupType::TriList, 0, std::move(indices));
+
+    cmod::Material material;
+    material.setMap(cmod::TextureSemantic::DiffuseMap, 0);
+
+    auto model = std::make_unique<cmod::Model>();
+    model->addMaterial(std::move(material));
+    model->addMesh(std::move(mesh));
+    return model;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("CMOD binary loader", "[!benchmark][cmod]")
+{
+    std::string data;
+    {
+        auto model = makeModel();
+        std::ostringstream out(std::ios::out | std::ios::binary);
+        REQUIRE(cmod::SaveModelBinary(model.get(), out, getSource));
+        data = out.str();
+    }
+
+    BENCHMARK("Load a " + std::to_string(data.size() / 1024) + " kB model")
+    {
+        std::istringstream in(data, std::ios::in | std::ios::binary);
+        return cmod::LoadModel(in, getHandle);
+    };
+
+    const fs::path filename = "modelfile_bench.cmod";
+    {
+        std::ofstream out(filename, std::ios::out | std::ios::binary);
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        REQUIRE(out.good());
+    }
+
+    BENCHMARK("Load a " + std::to_string(data.size() / 1024) + " kB model from a mapped file")
+    {
+        return cmod::LoadModel(filename, getHandle);
+    };
+
+    BENCHMARK("Load a " + std::to_string(data.size() / 1024) + " kB model from a file stream")
+    {
+        std::ifstream in(filename, std::ios::in | std::ios::binary);
+        return cmod::LoadModel(in, getHandle);
+    };
+
+    fs::remove(filename);
+}
@@ -0,0 +1,59 @@
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <celengine/name.h>
+
+#include <catch.hpp>
+
+namespace
+{
+
+// Names like those of star and asteroid catalogs: random words, some with
+// a catalog prefix
+void
+addNames(NameDatabase& db, std::uint32_t count)
+{
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::uniform_int_distribution<int> length(3, 10);
+
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        std::string name = i % 4 == 0 ? "HD " : "";
+        name += static_cast<char>(letter(rng) - 'a' + 'A');
+        for (int n = length(rng); n > 0; n--)
+            name += static_cast<char>(letter(rng));
+        db.add(i + 1, name);
+    }
+}
+
+} // end unnamed namespace
+
+TEST_CASE("NameDatabase completion", "[!benchmark][NameDatabase]")
+{
+    NameDatabase db;
+    addNames(db, 200000);
+
+    BENCHMARK("Completion of one letter, limited to 10")
+    {
+        std::vector<std::string> completion;
+        db.getCompletion(completion, "s", false, 10);
+        return completion.size();
+    };
+
+    BENCHMARK("Completion of two letters")
+    {
+        std::vector<std::string> completion;
+        db.getCompletion(completion, "sa", false);
+        return completion.size();
+    };
+
+    BENCHMARK("Completion of a catalog prefix, limited to 10")
+    {
+        std::vector<std::string> completion;
+        db.getCompletion(completion, "hd k", false, 10);
+        return completion.size();
+    };
+}
@@ -0,0 +1,82 @@
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <fmt/ostream.h>
+
+#include <catch.hpp>
+
+#include <celcompat/filesystem.h>
+#include <celephem/orbit.h>
+#include <celephem/samporbit.h>
+
+using namespace celestia::ephem;
+
+namespace
+{
+
+constexpr double StartTime = 2451545.0;
+constexpr int SampleCount = 50000;
+
+// A year of positions and velocities on a spiral
+void
+writeTrajectory(const fs::path& path)
+{
+    std::ofstream out(path);
+    for (int i = 0; i < SampleCount; i++)
+    {
+        double t = StartTime + i * 365.25 / SampleCount;
+        double a = (t - StartTime) * 0.1;
+        fmt::print(out, "{:.9f} {:.9f} {:.9f} {:.9f} {:.9f} {:.9f} {:.9f}\n",
+                   t, std::cos(a) * 1000.0, std::sin(a) * 1000.0, a * 10.0,
+                   -std::sin(a) * 100.0 / 86400.0, std::cos(a) * 100.0 / 86400.0, 0.1 / 86400.0);
+    }
+}
+
+// Random times, as when the position of an orbit is wanted for a jump in
+// time, and consecutive ones, as for an animation
+std::vector<double>
+getTimes(bool random)
+{
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> dist(StartTime, StartTime + 365.25);
+    std::vector<double> times;
+    for (int i = 0; i < 1000; i++)
+        times.push_back(random ? dist(rng) : StartTime + 100.0 + i * 0.01);
+    return times;
+}
+
+// Each run shifts the times a little so none of the positions is found in
+// the orbit cache
+Eigen::Vector3d
+sumPositions(const Orbit& orbit, const std::vector<double>& times, double& offset)
+{
+    offset += 1.0e-6;
+    Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+    for (double t : times)
+        sum += orbit.positionAtTime(t + offset);
+    return sum;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Sampled orbit positions", "[!benchmark][SampledOrbit]")
+{
+    const fs::path path = "samporbit_bench.xyzv";
+    writeTrajectory(path);
+    auto linear = LoadXYZVTrajectoryDoublePrec(path, TrajectoryInterpolation::Linear);
+    auto cubic = LoadXYZVTrajectoryDoublePrec(path, TrajectoryInterpolation::Cubic);
+    fs::remove(path);
+    REQUIRE(linear != nullptr);
+    REQUIRE(cubic != nullptr);
+
+    std::vector<double> randomTimes = getTimes(true);
+    std::vector<double> consecutiveTimes = getTimes(false);
+
+    double offset = 0.0;
+    BENCHMARK("1000 random times, linear") { return sumPositions(*linear, randomTimes, offset); };
+    BENCHMARK("1000 random times, cubic") { return sumPositions(*cubic, randomTimes, offset); };
+    BENCHMARK("1000 consecutive times, cubic") { return sumPositions(*cubic, consecutiveTimes, offset); };
+}
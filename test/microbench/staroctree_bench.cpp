@@ -0,0 +1,107 @@
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <Eigen/Geometry>
+
+#include <catch.hpp>
+
+#include <celengine/stardb.h>
+#include <celengine/starsdat.h>
+#include <celengine/stellarclass.h>
+#include <celmath/mathlib.h>
+
+using celestia::engine::StarsDatHeader;
+using celestia::engine::StarsDatRecord;
+
+namespace
+{
+
+template<typename T> void
+writeField(char* ptr, std::size_t offset, T value)
+{
+    std::memcpy(ptr + offset, &value, sizeof(value));
+}
+
+// A stars.dat file of stars spread through a disc of 5000 ly, denser
+// towards the Sun, with the spread of magnitudes of a real catalog
+std::string
+makeStarsDat(std::uint32_t count)
+{
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::normal_distribution<float> absMag(4.0f, 3.0f);
+    const std::uint16_t spectralType = StellarClass(StellarClass::NormalStar,
+                                                    StellarClass::Spectral_G, 2,
+                                                    StellarClass::Lum_V).packV1();
+
+    std::string data(sizeof(StarsDatHeader) + sizeof(StarsDatRecord) * count, '\0');
+    std::memcpy(data.data() + offsetof(StarsDatHeader, magic), "CELSTARS", 8);
+    writeField(data.data(), offsetof(StarsDatHeader, version), std::uint16_t(0x0100));
+    writeField(data.data(), offsetof(StarsDatHeader, counter), count);
+
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        float r = 5000.0f * unit(rng) * unit(rng);
+        float angle = 2.0f * static_cast<float>(celestia::numbers::pi) * unit(rng);
+        char* record = data.data() + sizeof(StarsDatHeader) + sizeof(StarsDatRecord) * i;
+        writeField(record, offsetof(StarsDatRecord, catNo), i + 1);
+        writeField(record, offsetof(StarsDatRecord, x), r * std::cos(angle));
+        writeField(record, offsetof(StarsDatRecord, y), 300.0f * (unit(rng) - 0.5f));
+        writeField(record, offsetof(StarsDatRecord, z), r * std::sin(angle));
+        writeField(record, offsetof(StarsDatRecord, absMag), static_cast<std::int16_t>(absMag(rng) * 256.0f));
+        writeField(record, offsetof(StarsDatRecord, spectralType), spectralType);
+    }
+
+    return data;
+}
+
+class CountingHandler : public StarHandler
+{
+ public:
+    void process(const Star&, float, float) override { ++count; }
+
+    unsigned int count{ 0 };
+};
+
+} // end unnamed namespace
+
+TEST_CASE("Star octree traversal", "[!benchmark][StarOctree]")
+{
+    StarDatabase db;
+    {
+        std::istringstream in(makeStarsDat(500000));
+        REQUIRE(db.loadBinary(in));
+    }
+    db.finish();
+
+    const float fov = celmath::degToRad(45.0f);
+    const float aspectRatio = 16.0f / 9.0f;
+    const Eigen::Quaternionf toCenter(Eigen::AngleAxisf(celmath::degToRad(30.0f), Eigen::Vector3f::UnitY()));
+
+    BENCHMARK("From the Sun, to magnitude 6")
+    {
+        CountingHandler handler;
+        db.findVisibleStars(handler, Eigen::Vector3f::Zero(), toCenter, fov, aspectRatio, 6.0f);
+        return handler.count;
+    };
+
+    BENCHMARK("From the Sun, to magnitude 12")
+    {
+        CountingHandler handler;
+        db.findVisibleStars(handler, Eigen::Vector3f::Zero(), toCenter, fov, aspectRatio, 12.0f);
+        return handler.count;
+    };
+
+    BENCHMARK("From 4000 ly above the disc, to magnitude 12")
+    {
+        CountingHandler handler;
+        Eigen::Quaternionf down(Eigen::AngleAxisf(celmath::degToRad(-90.0f), Eigen::Vector3f::UnitX()));
+        db.findVisibleStars(handler, Eigen::Vector3f(0.0f, 4000.0f, 0.0f), down, fov, aspectRatio, 12.0f);
+        return handler.count;
+    };
+}
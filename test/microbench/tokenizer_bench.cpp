@@ -0,0 +1,61 @@
+#include <sstream>
+#include <string>
+
+#include <fmt/format.h>
+
+#include <celutil/tokenizer.h>
+
+#include <catch.hpp>
+
+namespace
+{
+
+// An ssc file of asteroids, with the usual mix of names, numbers, strings
+// and nested groups
+std::string
+makeSsc(int count)
+{
+    std::string ssc;
+    for (int i = 0; i < count; i++)
+    {
+        ssc += fmt::format("\"{0} Bench:Bench {0}\" \"Sol\"\n"
+                           "{{\n"
+                           "    Class \"asteroid\"\n"
+                           "    Texture \"asteroid.jpg\"\n"
+                           "    Radius {1}\n"
+                           "    EllipticalOrbit\n"
+                           "    {{\n"
+                           "        Epoch 2459000.5\n"
+                           "        Period {2:.6f}\n"
+                           "        SemiMajorAxis {3:.6f}\n"
+                           "        Eccentricity 0.{4:04}\n"
+                           "        Inclination {5}.25\n"
+                           "        AscendingNode {6}.5\n"
+                           "        ArgOfPericenter 12.75\n"
+                           "        MeanAnomaly 1.2e2\n"
+                           "    }}\n"
+                           "    Albedo 0.15\n"
+                           "    Color [ 0.8 0.7 0.6 ]\n"
+                           "}}\n\n",
+                           i + 1, 1 + i % 50, 3.0 + i * 1.0e-5, 2.1 + i * 1.0e-5,
+                           i % 10000, i % 30, i % 360);
+    }
+    return ssc;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Tokenizer", "[!benchmark][Tokenizer]")
+{
+    std::string ssc = makeSsc(20000);
+
+    BENCHMARK("Tokens of a " + std::to_string(ssc.size() / 1024) + " kB ssc file")
+    {
+        std::istringstream in(ssc);
+        Tokenizer tok(&in);
+        int tokens = 0;
+        while (tok.nextToken() != Tokenizer::TokenEnd)
+            tokens++;
+        return tokens;
+    };
+}
@@ -0,0 +1,81 @@
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <catch.hpp>
+
+#include <celengine/univcoord.h>
+#include <celutil/r128util.h>
+
+namespace
+{
+
+// Positions of stars within a thousand light years, as found when
+// gathering the stars near the observer or picking
+std::vector<UniversalCoord>
+getPositions()
+{
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> dist(-1000.0, 1000.0);
+    std::vector<UniversalCoord> positions;
+    for (int i = 0; i < 10000; i++)
+        positions.push_back(UniversalCoord::CreateLy(Eigen::Vector3d(dist(rng), dist(rng), dist(rng))));
+    return positions;
+}
+
+// The offsets computed with the generic R128 operators, as before
+Eigen::Vector3d
+genericOffsetFromKm(const UniversalCoord& uc, const UniversalCoord& origin)
+{
+    return Eigen::Vector3d(static_cast<double>(uc.x - origin.x),
+                           static_cast<double>(uc.y - origin.y),
+                           static_cast<double>(uc.z - origin.z)) * astro::microLightYearsToKilometers(1.0);
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Universal coordinate offsets", "[!benchmark][UniversalCoord]")
+{
+    std::vector<UniversalCoord> positions = getPositions();
+    UniversalCoord origin = UniversalCoord::CreateLy(Eigen::Vector3d(8.6, -0.3, 2.1));
+    std::vector<Eigen::Vector3d> offsets(positions.size());
+
+    BENCHMARK("10000 offsets, generic R128")
+    {
+        Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+        for (const UniversalCoord& uc : positions)
+            sum += genericOffsetFromKm(uc, origin);
+        return sum;
+    };
+
+    BENCHMARK("10000 offsets, inline kernels")
+    {
+        Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+        for (const UniversalCoord& uc : positions)
+            sum += uc.offsetFromKm(origin);
+        return sum;
+    };
+
+    BENCHMARK("10000 offsets, batch")
+    {
+        UniversalCoord::offsetsFromKm(origin, positions, offsets.data());
+        return offsets.back();
+    };
+
+    BENCHMARK("10000 conversions from double, generic R128")
+    {
+        R128 sum(0);
+        for (const Eigen::Vector3d& v : offsets)
+            sum += R128(v.x());
+        return sum;
+    };
+
+    BENCHMARK("10000 conversions from double, inline kernels")
+    {
+        R128 sum(0);
+        for (const Eigen::Vector3d& v : offsets)
+            sum = celestia::util::addFixed(sum, celestia::util::fixedFromDouble(v.x()));
+        return sum;
+    };
+}
@@ -0,0 +1,43 @@
+#include <memory>
+
+#include <catch.hpp>
+
+#include <celephem/customorbittype.h>
+#include <celephem/orbit.h>
+#include <celephem/vsop87.h>
+
+using namespace celestia::ephem;
+
+namespace
+{
+
+constexpr double J2000 = 2451545.0;
+
+// Positions a day apart, as when the time runs fast. Each run starts at a
+// new time so none of the positions is found in the orbit cache.
+Eigen::Vector3d
+sumPositions(const Orbit& orbit, double& start, int count)
+{
+    start += 1.0 / 1440.0;
+    Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+    for (int i = 0; i < count; i++)
+        sum += orbit.positionAtTime(start + i);
+    return sum;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("VSOP87 evaluation", "[!benchmark][VSOP87]")
+{
+    auto mercury = CreateVSOP87Orbit(CustomOrbitType::VSOP87Mercury);
+    auto earth = CreateVSOP87Orbit(CustomOrbitType::VSOP87Earth);
+    auto jupiter = CreateVSOP87Orbit(CustomOrbitType::VSOP87Jupiter);
+    REQUIRE(mercury != nullptr);
+    REQUIRE(earth != nullptr);
+    REQUIRE(jupiter != nullptr);
+
+    double start = J2000;
+    BENCHMARK("100 positions of Mercury") { return sumPositions(*mercury, start, 100); };
+    BENCHMARK("100 positions of the Earth") { return sumPositions(*earth, start, 100); };
+    BENCHMARK("100 positions of Jupiter") { return sumPositions(*jupiter, start, 100); };
+}
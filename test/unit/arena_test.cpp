@@ -0,0 +1,53 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <celutil/arena.h>
+
+#include <catch.hpp>
+
+using celestia::util::Arena;
+using celestia::util::ArenaAllocator;
+
+TEST_CASE("Arena", "[Arena]")
+{
+    SECTION("Allocations are aligned and distinct")
+    {
+        Arena arena(256);
+        auto* a = static_cast<char*>(arena.allocate(3, 1));
+        auto* b = static_cast<double*>(arena.allocate(sizeof(double), alignof(double)));
+        REQUIRE(reinterpret_cast<std::uintptr_t>(b) % alignof(double) == 0);
+        REQUIRE(reinterpret_cast<char*>(b) >= a + 3);
+
+        // Larger than a block
+        auto* big = static_cast<char*>(arena.allocate(1000, 16));
+        REQUIRE(reinterpret_cast<std::uintptr_t>(big) % 16 == 0);
+        big[999] = 'x';
+    }
+
+    SECTION("Reset reuses the memory")
+    {
+        Arena arena(256);
+        void* first = arena.allocate(100, 8);
+        arena.allocate(200, 8);
+        arena.reset();
+        REQUIRE(arena.allocate(100, 8) == first);
+    }
+
+    SECTION("Containers use the arena or the heap")
+    {
+        Arena arena;
+        auto* strings = arena.create<std::vector<std::string, ArenaAllocator<std::string>>>(
+            ArenaAllocator<std::string>(&arena));
+        for (int i = 0; i < 100; i++)
+            strings->push_back(std::to_string(i));
+        REQUIRE(strings->size() == 100);
+        REQUIRE((*strings)[42] == "42");
+        strings->~vector();
+
+        std::vector<int, ArenaAllocator<int>> heap;
+        heap.assign(1000, 7);
+        REQUIRE(heap.get_allocator().getArena() == nullptr);
+        REQUIRE(heap[999] == 7);
+    }
+}
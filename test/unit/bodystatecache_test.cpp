@@ -0,0 +1,94 @@
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celengine/bodystatecache.h>
+
+class Body;
+
+namespace
+{
+
+const Body*
+fakeBody(std::size_t i)
+{
+    // The cache only uses the pointers as keys
+    return reinterpret_cast<const Body*>(static_cast<std::uintptr_t>((i + 1) * 64));
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Body state cache", "[BodyStateCache]")
+{
+    BodyStateCache cache;
+    cache.invalidate();
+
+    SECTION("Entries are keyed by body and time")
+    {
+        auto* entry = cache.insert(fakeBody(0), 2451545.0);
+        REQUIRE(entry != nullptr);
+        REQUIRE(entry->flags == 0);
+        entry->astrocentricPosition = Eigen::Vector3d(1.0, 2.0, 3.0);
+        entry->flags |= BodyStateCache::AstrocentricPosition;
+
+        const auto* found = cache.find(fakeBody(0), 2451545.0);
+        REQUIRE(found != nullptr);
+        REQUIRE(found->flags == BodyStateCache::AstrocentricPosition);
+        REQUIRE(found->astrocentricPosition == Eigen::Vector3d(1.0, 2.0, 3.0));
+
+        REQUIRE(cache.find(fakeBody(0), 2451546.0) == nullptr);
+        REQUIRE(cache.find(fakeBody(1), 2451545.0) == nullptr);
+    }
+
+    SECTION("Entries survive the table growing")
+    {
+        for (std::size_t i = 0; i < 10000; i++)
+        {
+            auto* entry = cache.insert(fakeBody(i), static_cast<double>(i % 3));
+            REQUIRE(entry != nullptr);
+            entry->astrocentricPosition = Eigen::Vector3d::Constant(static_cast<double>(i));
+            entry->flags |= BodyStateCache::AstrocentricPosition;
+        }
+
+        for (std::size_t i = 0; i < 10000; i++)
+        {
+            const auto* entry = cache.find(fakeBody(i), static_cast<double>(i % 3));
+            REQUIRE(entry != nullptr);
+            REQUIRE(entry->astrocentricPosition.x() == static_cast<double>(i));
+        }
+    }
+
+    SECTION("Invalidation drops all entries")
+    {
+        cache.insert(fakeBody(0), 0.0)->flags |= BodyStateCache::Orientation;
+        cache.invalidate();
+        REQUIRE(cache.find(fakeBody(0), 0.0) == nullptr);
+
+        cache.insert(fakeBody(0), 0.0)->flags |= BodyStateCache::Orientation;
+        cache.clear();
+        REQUIRE(cache.find(fakeBody(0), 0.0) == nullptr);
+    }
+
+    SECTION("The cache isn't used from other threads")
+    {
+        cache.insert(fakeBody(0), 0.0)->flags |= BodyStateCache::Position;
+
+        const BodyStateCache::Entry* found = nullptr;
+        BodyStateCache::Entry* inserted = nullptr;
+        std::thread thread([&]()
+        {
+            found = cache.find(fakeBody(0), 0.0);
+            inserted = cache.insert(fakeBody(1), 0.0);
+            cache.clearIfOwner();
+        });
+        thread.join();
+
+        REQUIRE(found == nullptr);
+        REQUIRE(inserted == nullptr);
+        REQUIRE(cache.find(fakeBody(0), 0.0) != nullptr);
+
+        cache.clearIfOwner();
+        REQUIRE(cache.find(fakeBody(0), 0.0) == nullptr);
+    }
+}
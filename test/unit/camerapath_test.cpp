@@ -0,0 +1,123 @@
+#include <cmath>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <catch.hpp>
+
+#include <celengine/camerapath.h>
+
+namespace
+{
+
+CameraPath::Key
+makeKey(double time, const Eigen::Vector3d& positionKm, double angle = 0.0, float fov = 0.5f)
+{
+    CameraPath::Key key;
+    key.time = time;
+    key.position = UniversalCoord::Zero().offsetKm(positionKm);
+    key.orientation = Eigen::Quaterniond(Eigen::AngleAxisd(angle, Eigen::Vector3d::UnitY()));
+    key.fov = fov;
+    return key;
+}
+
+Eigen::Vector3d
+positionKm(const CameraPath::Key& key)
+{
+    return key.position.offsetFromKm(UniversalCoord::Zero());
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Camera path", "[CameraPath]")
+{
+    CameraPath path;
+
+    SECTION("Keys must be added in time order")
+    {
+        REQUIRE(path.addKey(makeKey(0.0, Eigen::Vector3d::Zero())));
+        REQUIRE(path.addKey(makeKey(1.0, Eigen::Vector3d::UnitX())));
+        REQUIRE_FALSE(path.addKey(makeKey(1.0, Eigen::Vector3d::UnitY())));
+        REQUIRE_FALSE(path.addKey(makeKey(0.5, Eigen::Vector3d::UnitY())));
+        REQUIRE(path.getKeys().size() == 2);
+    }
+
+    SECTION("The path passes through its keys")
+    {
+        path.addKey(makeKey(0.0, Eigen::Vector3d(0.0, 0.0, 0.0), 0.0, 0.5f));
+        path.addKey(makeKey(2.0, Eigen::Vector3d(100.0, 0.0, 0.0), 0.5, 0.4f));
+        path.addKey(makeKey(3.0, Eigen::Vector3d(100.0, 50.0, 0.0), 1.0, 0.3f));
+
+        for (const auto& key : path.getKeys())
+        {
+            auto evaluated = path.evaluate(key.time);
+            REQUIRE((positionKm(evaluated) - positionKm(key)).norm() < 1.0e-6);
+            REQUIRE(evaluated.orientation.angularDistance(key.orientation) < 1.0e-6);
+            REQUIRE(evaluated.fov == Approx(key.fov));
+        }
+
+        // Clamped outside of the keys
+        REQUIRE(positionKm(path.evaluate(-1.0)).norm() < 1.0e-6);
+        REQUIRE((positionKm(path.evaluate(10.0)) - Eigen::Vector3d(100.0, 50.0, 0.0)).norm() < 1.0e-6);
+    }
+
+    SECTION("Evenly spaced keys on a line are followed at constant speed")
+    {
+        for (int i = 0; i < 5; i++)
+            path.addKey(makeKey(static_cast<double>(i), Eigen::Vector3d(10.0 * i, 0.0, 0.0)));
+
+        REQUIRE(path.getStartDistance() == 0.0);
+        REQUIRE(path.getEndDistance() == Approx(40.0));
+        REQUIRE(positionKm(path.evaluate(1.25)).x() == Approx(12.5));
+        REQUIRE(path.getDistance(2.5) == Approx(25.0));
+        REQUIRE(path.getTime(5.0) == Approx(0.5));
+    }
+
+    SECTION("Distance and time are inverses")
+    {
+        path.addKey(makeKey(0.0, Eigen::Vector3d(0.0, 0.0, 0.0)));
+        path.addKey(makeKey(1.0, Eigen::Vector3d(1000.0, 0.0, 0.0)));
+        path.addKey(makeKey(5.0, Eigen::Vector3d(1000.0, 1000.0, 0.0)));
+        path.addKey(makeKey(6.0, Eigen::Vector3d(0.0, 1000.0, 500.0)));
+
+        double previous = -1.0;
+        for (double t = 0.0; t <= 6.0; t += 0.1)
+        {
+            double distance = path.getDistance(t);
+            REQUIRE(distance >= previous);
+            REQUIRE(path.getTime(distance) == Approx(t).margin(1.0e-9));
+            previous = distance;
+        }
+    }
+
+    SECTION("Positions far from the origin keep their precision")
+    {
+        // About 100 light years away
+        Eigen::Vector3d base(9.46e14, 0.0, 0.0);
+        path.addKey(makeKey(0.0, base));
+        path.addKey(makeKey(1.0, base + Eigen::Vector3d(0.0, 1.0, 0.0)));
+
+        auto key = path.evaluate(0.5);
+        Eigen::Vector3d offset = key.position.offsetFromKm(path.getKeys().front().position);
+        REQUIRE(offset.x() == Approx(0.0).margin(1.0e-6));
+        REQUIRE(offset.y() == Approx(0.5).margin(1.0e-6));
+    }
+
+    SECTION("Removing old keys keeps the distances")
+    {
+        for (int i = 0; i < 10; i++)
+            path.addKey(makeKey(static_cast<double>(i), Eigen::Vector3d(10.0 * i, 0.0, 0.0)));
+
+        double distance = path.getDistance(7.5);
+        auto position = positionKm(path.evaluate(7.5));
+        path.removeKeysBefore(7.5);
+
+        REQUIRE(path.getKeys().size() == 4);
+        REQUIRE(path.getStartTime() == 6.0);
+        REQUIRE(path.getDistance(7.5) == Approx(distance));
+        REQUIRE((positionKm(path.evaluate(7.5)) - position).norm() < 1.0e-6);
+
+        REQUIRE(path.addKey(makeKey(10.0, Eigen::Vector3d(100.0, 0.0, 0.0))));
+        REQUIRE(path.getEndDistance() == Approx(100.0));
+    }
+}
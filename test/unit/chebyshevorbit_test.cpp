@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celephem/chebyshevorbit.h>
+#include <celephem/orbit.h>
+
+using namespace celestia::ephem;
+
+namespace
+{
+
+constexpr double Period = 10.0;
+constexpr double Radius = 1.0e6;
+
+// An eccentric orbit counting its evaluations
+class CountingOrbit : public Orbit
+{
+ public:
+    CountingOrbit() : orbit(Radius, 0.5, 0.3, 0.2, 0.1, 0.0, Period) {}
+
+    Eigen::Vector3d positionAtTime(double jd) const override
+    {
+        ++evaluations;
+        return orbit.positionAtTime(jd);
+    }
+
+    double getPeriod() const override { return Period; }
+    double getBoundingRadius() const override { return Radius * 1.5; }
+
+    EllipticalOrbit orbit;
+    mutable std::atomic<int> evaluations{ 0 };
+};
+
+// An orbit jumping between two positions
+class SteppedOrbit : public Orbit
+{
+ public:
+    Eigen::Vector3d positionAtTime(double jd) const override
+    {
+        return Eigen::Vector3d(jd < 0.3 ? 0.0 : 1000.0, 0.0, 0.0);
+    }
+
+    double getPeriod() const override { return 1.0; }
+    double getBoundingRadius() const override { return 1000.0; }
+};
+
+// An orbit with a limited coverage, clamping times outside of it
+class ClampedOrbit : public Orbit
+{
+ public:
+    ClampedOrbit(double _begin, double _end) :
+        orbit(Radius, 0.5, 0.3, 0.2, 0.1, 0.0, Period), begin(_begin), end(_end) {}
+
+    Eigen::Vector3d positionAtTime(double jd) const override
+    {
+        return orbit.positionAtTime(std::clamp(jd, begin, end));
+    }
+
+    double getPeriod() const override { return Period; }
+    double getBoundingRadius() const override { return Radius * 1.5; }
+
+    EllipticalOrbit orbit;
+    double begin;
+    double end;
+};
+
+} // end unnamed namespace
+
+TEST_CASE("Chebyshev orbit fits", "[ChebyshevOrbit]")
+{
+    constexpr double tolerance = 1.0e-3;
+
+    SECTION("Positions and velocities match the source")
+    {
+        auto source = std::make_unique<CountingOrbit>();
+        const EllipticalOrbit reference = source->orbit;
+        ChebyshevOrbit orbit(std::move(source), Period / 16.0, tolerance);
+
+        std::mt19937 rng(5);
+        std::uniform_real_distribution<double> time(-2.0 * Period, 2.0 * Period);
+        for (int i = 0; i < 2000; i++)
+        {
+            double t = 2451545.0 + time(rng);
+            REQUIRE((orbit.positionAtTime(t) - reference.positionAtTime(t)).norm() < 2.0 * tolerance);
+
+            Eigen::Vector3d velocity = reference.velocityAtTime(t);
+            REQUIRE((orbit.velocityAtTime(t) - velocity).norm() < 1.0e-6 * velocity.norm());
+        }
+
+        REQUIRE(orbit.getPeriod() == Period);
+        REQUIRE(orbit.isThreadSafe());
+    }
+
+    SECTION("Windows are only fitted once")
+    {
+        auto source = std::make_unique<CountingOrbit>();
+        const CountingOrbit& counter = *source;
+        ChebyshevOrbit orbit(std::move(source), Period / 16.0, tolerance);
+
+        orbit.positionAtTime(2451545.1);
+        for (int i = 0; i < 10000; i++)
+            orbit.positionAtTime(2451545.1 + i * 1.0e-5);
+
+        // Fitting a window takes a few dozen evaluations for each piece,
+        // and the neighbouring windows may be fitted in the background.
+        REQUIRE(counter.evaluations < 3000);
+    }
+
+    SECTION("Several threads get the same positions")
+    {
+        ChebyshevOrbit orbit(std::make_unique<CountingOrbit>(), Period / 16.0, tolerance);
+        constexpr int nTimes = 500;
+        std::vector<Eigen::Vector3d> expected;
+        for (int i = 0; i < nTimes; i++)
+            expected.push_back(orbit.positionAtTime(2451545.0 + i * 0.37));
+
+        std::atomic<int> mismatches{ 0 };
+        std::vector<std::thread> threads;
+        for (int n = 0; n < 4; n++)
+        {
+            threads.emplace_back([&, n]
+            {
+                for (int i = 0; i < nTimes; i++)
+                {
+                    int j = (i * 7 + n * 101) % nTimes;
+                    if (orbit.positionAtTime(2451545.0 + j * 0.37) != expected[j])
+                        ++mismatches;
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        REQUIRE(mismatches == 0);
+    }
+
+    SECTION("Discontinuous sources are fitted up to the subdivision limit")
+    {
+        ChebyshevOrbit orbit(std::make_unique<SteppedOrbit>(), 1.0, tolerance);
+        REQUIRE(orbit.positionAtTime(0.1).x() == Approx(0.0).margin(tolerance));
+        REQUIRE(orbit.positionAtTime(0.9).x() == Approx(1000.0));
+    }
+
+    SECTION("Precomputed ranges are fitted up to their bounds")
+    {
+        constexpr double begin = 2451545.3;
+        constexpr double end = begin + 3.7;
+        auto source = std::make_unique<ClampedOrbit>(begin, end);
+        const EllipticalOrbit reference = source->orbit;
+        ChebyshevOrbit orbit(std::move(source), 1.0, tolerance);
+        orbit.precompute(begin, end);
+
+        for (int i = 0; i <= 100; i++)
+        {
+            double t = begin + (end - begin) * i / 100.0;
+            REQUIRE((orbit.positionAtTime(t) - reference.positionAtTime(t)).norm() < 2.0 * tolerance);
+        }
+
+        REQUIRE((orbit.positionAtTime(end + 2.0) - reference.positionAtTime(end)).norm() < 2.0 * tolerance);
+    }
+}
@@ -0,0 +1,68 @@
+#include <string>
+
+#include <catch.hpp>
+
+#include <celestia/clusterframe.h>
+
+TEST_CASE("ClusterFrame", "[ClusterFrame]")
+{
+    ClusterFrame frame;
+    frame.number = 1234567890123ULL;
+    frame.coordSys = ObserverFrame::PhaseLock;
+    frame.refName = "Sol:Earth";
+    frame.targetName = "Sol:Earth:Moon";
+    frame.observerPosition = UniversalCoord(R128(0x0123456789abcdefULL, 0xfedcba9876543210ULL),
+                                            R128(-1.5),
+                                            R128(1.0e9));
+    frame.observerOrientation = Eigen::Quaternionf(0.5f, -0.5f, 0.5f, 0.5f);
+    frame.fieldOfView = 35.5f;
+    frame.tdb = 2451545.125;
+    frame.timeScale = -100.0f;
+    frame.pauseState = true;
+    frame.lightTimeDelay = false;
+    frame.trackedName = "";
+    frame.selectedName = "Sol:Mars";
+    frame.labelMode = 0x1234;
+    frame.renderFlags = 0x8000000000000001ULL;
+
+    std::string data = frame.encode();
+
+    SECTION("Frames are decoded to the state encoded")
+    {
+        ClusterFrame decoded;
+        REQUIRE(decoded.decode(data));
+        REQUIRE(decoded.number == frame.number);
+        REQUIRE(decoded.coordSys == frame.coordSys);
+        REQUIRE(decoded.refName == frame.refName);
+        REQUIRE(decoded.targetName == frame.targetName);
+        REQUIRE(decoded.observerPosition.x.lo == frame.observerPosition.x.lo);
+        REQUIRE(decoded.observerPosition.x.hi == frame.observerPosition.x.hi);
+        REQUIRE(decoded.observerPosition.y == frame.observerPosition.y);
+        REQUIRE(decoded.observerPosition.z == frame.observerPosition.z);
+        REQUIRE(decoded.observerOrientation.coeffs() == frame.observerOrientation.coeffs());
+        REQUIRE(decoded.fieldOfView == frame.fieldOfView);
+        REQUIRE(decoded.tdb == frame.tdb);
+        REQUIRE(decoded.timeScale == frame.timeScale);
+        REQUIRE(decoded.pauseState);
+        REQUIRE(!decoded.lightTimeDelay);
+        REQUIRE(decoded.trackedName.empty());
+        REQUIRE(decoded.selectedName == frame.selectedName);
+        REQUIRE(decoded.labelMode == frame.labelMode);
+        REQUIRE(decoded.renderFlags == frame.renderFlags);
+    }
+
+    SECTION("Truncated frames are refused")
+    {
+        ClusterFrame decoded;
+        for (std::size_t size = 0; size < data.size(); ++size)
+            REQUIRE(!decoded.decode(std::string_view(data).substr(0, size)));
+    }
+
+    SECTION("Other data is refused")
+    {
+        ClusterFrame decoded;
+        std::string other = data;
+        other[0] = 'X';
+        REQUIRE(!decoded.decode(other));
+    }
+}
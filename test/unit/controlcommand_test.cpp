@@ -0,0 +1,81 @@
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#include <catch.hpp>
+
+#include <celestia/controlcommand.h>
+
+TEST_CASE("ControlCommand", "[ControlCommand]")
+{
+    ControlCommand command;
+
+    SECTION("Words are separated by spaces")
+    {
+        REQUIRE(command.parse("  goto   Mars 3\r"));
+        REQUIRE(command.id.empty());
+        REQUIRE(command.name == "goto");
+        REQUIRE(command.args.size() == 2);
+        REQUIRE(command.args[0] == "Mars");
+        REQUIRE(command.args[1] == "3");
+    }
+
+    SECTION("Quoted words may hold spaces and escaped quotes")
+    {
+        REQUIRE(command.parse(R"(@7 info "Sol/Earth/Moon" "a \"b\" \\c" "")"));
+        REQUIRE(command.id == "7");
+        REQUIRE(command.name == "info");
+        REQUIRE(command.args.size() == 3);
+        REQUIRE(command.args[0] == "Sol/Earth/Moon");
+        REQUIRE(command.args[1] == R"(a "b" \c)");
+        REQUIRE(command.args[2].empty());
+    }
+
+    SECTION("Blank lines and open quotes are rejected")
+    {
+        REQUIRE_FALSE(command.parse(""));
+        REQUIRE_FALSE(command.parse(" \t"));
+        REQUIRE_FALSE(command.parse("@3"));
+        REQUIRE_FALSE(command.parse("select \"Sol"));
+    }
+
+    SECTION("A lone @ is a command name")
+    {
+        REQUIRE(command.parse("@ state"));
+        REQUIRE(command.id.empty());
+        REQUIRE(command.name == "@");
+    }
+}
+
+TEST_CASE("JsonWriter", "[JsonWriter]")
+{
+    SECTION("Members and elements are separated by commas")
+    {
+        JsonWriter writer;
+        writer.beginObject()
+              .member("id", "12")
+              .member("ok", true)
+              .member("count", 3)
+              .key("values").beginArray().value(1.5).value(false).null().endArray()
+              .key("objects").beginArray().beginObject().member("a", std::int64_t(-2)).endObject().beginObject().endObject().endArray()
+              .endObject();
+        REQUIRE(writer.str() == R"({"id":"12","ok":true,"count":3,"values":[1.5,false,null],"objects":[{"a":-2},{}]})");
+    }
+
+    SECTION("Strings are escaped")
+    {
+        JsonWriter writer;
+        writer.beginArray().value("a\"b\\c\n").endArray();
+        REQUIRE(writer.str() == R"(["a\"b\\c\u000a"])");
+    }
+
+    SECTION("Numbers JSON can't represent are null")
+    {
+        JsonWriter writer;
+        writer.beginArray()
+              .value(std::numeric_limits<double>::infinity())
+              .value(std::numeric_limits<double>::quiet_NaN())
+              .endArray();
+        REQUIRE(writer.str() == "[null,null]");
+    }
+}
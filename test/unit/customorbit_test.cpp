@@ -0,0 +1,51 @@
+#include <atomic>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celephem/customorbit.h>
+#include <celephem/orbit.h>
+
+using namespace std::string_view_literals;
+using namespace celestia::ephem;
+
+TEST_CASE("Planet theory orbits", "[customorbit]")
+{
+    SECTION("Several threads get the same positions as a serial evaluation")
+    {
+        for (auto name : { "mercury"sv, "mars"sv, "jupiter"sv, "pluto"sv })
+        {
+            INFO(name);
+            std::unique_ptr<Orbit> orbit = GetCustomOrbit(name);
+            REQUIRE(orbit != nullptr);
+            REQUIRE(orbit->isThreadSafe());
+
+            constexpr int nTimes = 2000;
+            std::vector<Eigen::Vector3d> expected;
+            for (int i = 0; i < nTimes; i++)
+                expected.push_back(orbit->positionAtTime(2451545.0 + i * 1.37));
+
+            std::atomic<int> mismatches{ 0 };
+            std::vector<std::thread> threads;
+            for (int n = 0; n < 4; n++)
+            {
+                threads.emplace_back([&, n]
+                {
+                    for (int i = 0; i < nTimes; i++)
+                    {
+                        int j = (i * 7 + n * 101) % nTimes;
+                        if (orbit->positionAtTime(2451545.0 + j * 1.37) != expected[j])
+                            ++mismatches;
+                    }
+                });
+            }
+            for (auto& thread : threads)
+                thread.join();
+
+            REQUIRE(mismatches == 0);
+        }
+    }
+}
@@ -0,0 +1,129 @@
+#include <chrono>
+#include <fstream>
+#include <string>
+
+#include <catch.hpp>
+
+#include <celcompat/filesystem.h>
+#include <celutil/diskcache.h>
+
+using celestia::util::DiskCache;
+
+namespace
+{
+
+class TempDirectory
+{
+ public:
+    explicit TempDirectory(const char* name) :
+        path(fs::temp_directory_path() / name)
+    {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+        fs::create_directories(path, ec);
+    }
+
+    ~TempDirectory()
+    {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    }
+
+    fs::path path;
+};
+
+bool
+writeFile(const fs::path& path, const std::string& contents)
+{
+    std::ofstream out(path, std::ios::out | std::ios::binary);
+    out << contents;
+    out.close();
+    return out.good();
+}
+
+std::string
+readFile(const fs::path& path)
+{
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+} // end unnamed namespace
+
+TEST_CASE("DiskCache", "[DiskCache]")
+{
+    SECTION("Entries are keyed by the source, variant and version")
+    {
+        TempDirectory directory("celestia-diskcache-keys");
+        fs::path source = directory.path / "source.txt";
+        REQUIRE(writeFile(source, "source"));
+
+        DiskCache cache(directory.path / "cache", 1);
+        DiskCache otherVersion(directory.path / "cache", 2);
+        fs::path path = cache.getPath(source, "a", ".dat");
+        REQUIRE(path.parent_path() == directory.path / "cache");
+        REQUIRE(path.extension() == ".dat");
+        REQUIRE(path.filename().string().rfind("source-", 0) == 0);
+        REQUIRE(cache.getPath(source, "a", ".dat") == path);
+        REQUIRE(cache.getPath(source, "b", ".dat") != path);
+        REQUIRE(otherVersion.getPath(source, "a", ".dat") != path);
+
+        REQUIRE(writeFile(source, "changed source"));
+        REQUIRE(cache.getPath(source, "a", ".dat") != path);
+
+        REQUIRE(cache.getPath(directory.path / "missing.txt", "a", ".dat").empty());
+        REQUIRE(cache.getKeyPath("shader", "key", ".bin") != cache.getKeyPath("shader", "other key", ".bin"));
+    }
+
+    SECTION("Entries are written whole or not at all")
+    {
+        TempDirectory directory("celestia-diskcache-write");
+        DiskCache cache(directory.path / "cache", 1);
+        fs::path path = cache.getKeyPath("entry", "key", ".dat");
+
+        REQUIRE(!DiskCache::use(path));
+        REQUIRE(DiskCache::write(path, [](const fs::path& p) { return writeFile(p, "contents"); }));
+        REQUIRE(DiskCache::use(path));
+        REQUIRE(readFile(path) == "contents");
+
+        REQUIRE(!DiskCache::write(path, [](const fs::path& p) { writeFile(p, "partial"); return false; }));
+        REQUIRE(readFile(path) == "contents");
+        for (const auto& entry : fs::directory_iterator(cache.getDirectory()))
+            REQUIRE(entry.path() == path);
+    }
+
+    SECTION("Entries are written in the background")
+    {
+        TempDirectory directory("celestia-diskcache-later");
+        DiskCache cache(directory.path / "cache", 1);
+        fs::path path = cache.getKeyPath("entry", "key", ".dat");
+
+        DiskCache::writeLater(path, std::string("queued"));
+        DiskCache::flush();
+        REQUIRE(readFile(path) == "queued");
+    }
+
+    SECTION("The entries used least recently are deleted")
+    {
+        TempDirectory directory("celestia-diskcache-trim");
+        DiskCache cache(directory.path / "cache", 1);
+        fs::path paths[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            paths[i] = cache.getKeyPath("entry", std::to_string(i), ".dat");
+            REQUIRE(DiskCache::write(paths[i], [](const fs::path& p) { return writeFile(p, std::string(1000, 'x')); }));
+            fs::last_write_time(paths[i], fs::file_time_type::clock::now() - std::chrono::hours(3 - i));
+        }
+
+        // The oldest entry is used again
+        REQUIRE(DiskCache::use(paths[0]));
+
+        DiskCache::setMaxSize(2500);
+        DiskCache::flush();
+        DiskCache::setMaxSize(0);
+
+        REQUIRE(fs::exists(paths[0]));
+        REQUIRE(!fs::exists(paths[1]));
+        REQUIRE(fs::exists(paths[2]));
+    }
+}
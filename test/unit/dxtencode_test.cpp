@@ -0,0 +1,165 @@
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+
+#include <catch.hpp>
+
+#include <celimage/dds_decompress.h>
+#include <celimage/dxtencode.h>
+
+namespace
+{
+
+using Block = std::array<std::uint8_t, 64>;
+
+Block
+makeGradient(std::uint8_t alphaBase, std::uint8_t alphaStep)
+{
+    Block block;
+    for (int i = 0; i < 16; i++)
+    {
+        block[i * 4 + 0] = static_cast<std::uint8_t>(i * 16);
+        block[i * 4 + 1] = static_cast<std::uint8_t>(255 - i * 16);
+        block[i * 4 + 2] = 128;
+        block[i * 4 + 3] = static_cast<std::uint8_t>(alphaBase + i * alphaStep);
+    }
+    return block;
+}
+
+int
+maxError(const Block& block, const std::array<std::uint32_t, 16>& decoded, int channels)
+{
+    int error = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < channels; c++)
+        {
+            int value = static_cast<int>((decoded[i] >> (8 * c)) & 0xff);
+            error = std::max(error, std::abs(value - static_cast<int>(block[i * 4 + c])));
+        }
+    }
+    return error;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("DXT encoding", "[DXT]")
+{
+    SECTION("Solid color DXT1 block")
+    {
+        Block block;
+        for (int i = 0; i < 16; i++)
+        {
+            block[i * 4 + 0] = 255;
+            block[i * 4 + 1] = 0;
+            block[i * 4 + 2] = 255;
+            block[i * 4 + 3] = 255;
+        }
+
+        std::array<std::uint8_t, 8> encoded;
+        EncodeBlockDXT1(block.data(), encoded.data());
+        std::array<std::uint32_t, 16> decoded;
+        DecompressBlockDXT1(0, 0, 4, encoded.data(), false, decoded.data());
+        REQUIRE(maxError(block, decoded, 3) == 0);
+    }
+
+    SECTION("Gradient DXT1 block")
+    {
+        Block block = makeGradient(255, 0);
+        std::array<std::uint8_t, 8> encoded;
+        EncodeBlockDXT1(block.data(), encoded.data());
+
+        // Four color mode: the first end point is the larger one
+        REQUIRE((encoded[0] | (encoded[1] << 8)) > (encoded[2] | (encoded[3] << 8)));
+
+        std::array<std::uint32_t, 16> decoded;
+        DecompressBlockDXT1(0, 0, 4, encoded.data(), false, decoded.data());
+        REQUIRE(maxError(block, decoded, 3) <= 48);
+    }
+
+    SECTION("Gradient DXT5 block")
+    {
+        Block block = makeGradient(0, 17);
+        std::array<std::uint8_t, 16> encoded;
+        EncodeBlockDXT5(block.data(), encoded.data());
+        std::array<std::uint32_t, 16> decoded;
+        DecompressBlockDXT5(0, 0, 4, encoded.data(), false, decoded.data());
+        REQUIRE(maxError(block, decoded, 4) <= 48);
+
+        // Alpha is interpolated between eight levels
+        for (int i = 0; i < 16; i++)
+        {
+            int alpha = static_cast<int>(decoded[i] >> 24);
+            REQUIRE(std::abs(alpha - static_cast<int>(block[i * 4 + 3])) <= 19);
+        }
+    }
+}
+
+TEST_CASE("DXT image compression", "[DXT]")
+{
+    SECTION("Opaque images are compressed to DXT1 with mipmaps")
+    {
+        Image img(celestia::PixelFormat::RGBA, 16, 8);
+        for (int i = 0; i < 16 * 8 * 4; i++)
+            img.getPixels()[i] = (i % 4) == 3 ? 255 : static_cast<std::uint8_t>(i);
+
+        auto compressed = CompressImageDXT(img, true);
+        REQUIRE(compressed != nullptr);
+        REQUIRE(compressed->getFormat() == celestia::PixelFormat::DXT1);
+        REQUIRE(compressed->getMipLevelCount() == 5);
+        REQUIRE(compressed->getMipLevelSize(0) == 4 * 2 * 8);
+    }
+
+    SECTION("Transparent images are compressed to DXT5")
+    {
+        Image img(celestia::PixelFormat::RGBA, 8, 8);
+        for (int i = 0; i < 8 * 8 * 4; i++)
+            img.getPixels()[i] = static_cast<std::uint8_t>(i);
+
+        auto compressed = CompressImageDXT(img, false);
+        REQUIRE(compressed != nullptr);
+        REQUIRE(compressed->getFormat() == celestia::PixelFormat::DXT5);
+        REQUIRE(compressed->getMipLevelCount() == 1);
+    }
+
+    SECTION("Luminance images are not compressed")
+    {
+        Image img(celestia::PixelFormat::LUMINANCE, 8, 8);
+        REQUIRE(CompressImageDXT(img, true) == nullptr);
+    }
+
+    SECTION("Compressed images decompress with their mip levels")
+    {
+        Image img(celestia::PixelFormat::RGB, 10, 6);
+        for (int y = 0; y < 6; y++)
+        {
+            std::uint8_t* row = img.getPixelRow(y);
+            for (int x = 0; x < 10 * 3; x++)
+                row[x] = static_cast<std::uint8_t>(x < 15 ? 40 : 200);
+        }
+
+        auto compressed = CompressImageDXT(img, true);
+        REQUIRE(compressed != nullptr);
+        auto decompressed = DecompressDXTImage(*compressed, true);
+        REQUIRE(decompressed != nullptr);
+        REQUIRE(decompressed->getFormat() == celestia::PixelFormat::RGB);
+        REQUIRE(decompressed->getWidth() == 10);
+        REQUIRE(decompressed->getHeight() == 6);
+        REQUIRE(decompressed->getMipLevelCount() == compressed->getMipLevelCount());
+
+        // Within the RGB565 quantization of the input
+        for (int y = 0; y < 6; y++)
+        {
+            const std::uint8_t* row = decompressed->getPixelRow(y);
+            REQUIRE(std::abs(static_cast<int>(row[0]) - 40) <= 8);
+            REQUIRE(std::abs(static_cast<int>(row[29]) - 200) <= 8);
+        }
+
+        // The smallest level averages both halves
+        const std::uint8_t* last = decompressed->getPixelRow(decompressed->getMipLevelCount() - 1, 0);
+        REQUIRE(std::abs(static_cast<int>(last[0]) - 120) <= 24);
+
+        auto baseOnly = DecompressDXTImage(*compressed, false);
+        REQUIRE(baseOnly->getMipLevelCount() == 1);
+    }
+}
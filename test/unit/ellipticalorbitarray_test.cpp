@@ -0,0 +1,131 @@
+#include <cmath>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celcompat/numbers.h>
+#include <celephem/ellipticalorbitarray.h>
+#include <celephem/orbit.h>
+
+using celestia::ephem::EllipticalOrbit;
+using celestia::ephem::EllipticalOrbitArray;
+
+namespace
+{
+
+constexpr double Period = 1600.0;
+constexpr double SemiMajorAxis = 3.0e8;
+
+// Solve Kepler's equation by bisection, which is slow but can't fail
+double
+referenceEccentricAnomaly(double e, double M)
+{
+    M = std::remainder(M, 2.0 * celestia::numbers::pi);
+    double low = M - e - 1.0;
+    double high = M + e + 1.0;
+    for (int i = 0; i < 200; i++)
+    {
+        double E = 0.5 * (low + high);
+        if (E - e * std::sin(E) < M)
+            low = E;
+        else
+            high = E;
+    }
+    return 0.5 * (low + high);
+}
+
+Eigen::Vector3d
+referencePosition(double e, double M)
+{
+    double E = referenceEccentricAnomaly(e, M);
+    // An orbit in the reference plane, with the pericenter along x
+    double x = SemiMajorAxis * (std::cos(E) - e);
+    double y = SemiMajorAxis * std::sqrt(1.0 - e * e) * std::sin(E);
+    return Eigen::Vector3d(x, 0.0, -y);
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Elliptical orbit arrays", "[EllipticalOrbitArray]")
+{
+    SECTION("Kepler's equation is solved for all eccentricities")
+    {
+        const std::vector<double> eccentricities{ 0.0, 0.01, 0.19, 0.5, 0.9, 0.97, 0.99, 0.999, 0.9999 };
+        constexpr int nMeanAnomalies = 301;
+
+        EllipticalOrbitArray orbits;
+        for (double e : eccentricities)
+        {
+            for (int i = 0; i < nMeanAnomalies; i++)
+            {
+                // Mean anomalies from -3 pi to 3 pi at the epoch
+                double M = 3.0 * celestia::numbers::pi * (2.0 * i / (nMeanAnomalies - 1) - 1.0);
+                REQUIRE(orbits.add(SemiMajorAxis * (1.0 - e), e, 0.0, 0.0, 0.0, M, Period));
+            }
+        }
+
+        std::vector<Eigen::Vector3d> positions;
+        orbits.computePositions(2451545.0, positions);
+        REQUIRE(positions.size() == orbits.size());
+
+        for (std::size_t i = 0; i < orbits.size(); i++)
+        {
+            Eigen::Vector3d expected = referencePosition(orbits.getEccentricity(i), orbits.getMeanAnomalyAtEpoch(i));
+            REQUIRE((positions[i] - expected).norm() < 1.0e-12 * SemiMajorAxis);
+        }
+    }
+
+    SECTION("Positions agree with elliptical orbits")
+    {
+        EllipticalOrbitArray orbits;
+        const std::vector<double> eccentricities{ 0.3, 0.66, 0.95 };
+        for (double e : eccentricities)
+            REQUIRE(orbits.add(SemiMajorAxis * (1.0 - e), e, 0.3, 1.2, 2.5, 0.7, Period, 2451000.0));
+
+        std::vector<Eigen::Vector3d> positions;
+        for (double tdb : { 2451545.0, 2455000.5, 2460123.25 })
+        {
+            orbits.computePositions(tdb, positions);
+            for (std::size_t i = 0; i < orbits.size(); i++)
+            {
+                double e = eccentricities[i];
+                EllipticalOrbit orbit(SemiMajorAxis * (1.0 - e), e, 0.3, 1.2, 2.5, 0.7, Period, 2451000.0);
+                Eigen::Vector3d expected = orbit.positionAtTime(tdb);
+                REQUIRE((positions[i] - expected).norm() < 1.0e-9 * SemiMajorAxis);
+            }
+        }
+
+        REQUIRE(orbits.getBoundingRadius(1) == Approx(SemiMajorAxis * 1.66));
+    }
+
+    SECTION("Orbits which aren't ellipses are rejected")
+    {
+        EllipticalOrbitArray orbits;
+        REQUIRE(!orbits.add(1.0e8, 1.0, 0.0, 0.0, 0.0, 0.0, Period));
+        REQUIRE(!orbits.add(1.0e8, 1.5, 0.0, 0.0, 0.0, 0.0, Period));
+        REQUIRE(!orbits.add(1.0e8, 0.5, 0.0, 0.0, 0.0, 0.0, 0.0));
+        REQUIRE(orbits.size() == 0);
+    }
+
+    SECTION("Ranges and threads give the same positions")
+    {
+        EllipticalOrbitArray orbits;
+        for (int i = 0; i < 20000; i++)
+        {
+            double e = (i % 97) / 100.0;
+            REQUIRE(orbits.add(SemiMajorAxis * (1.0 - e), e, 0.001 * i, 0.002 * i, 0.003 * i, 0.01 * i, Period + i));
+        }
+
+        std::vector<Eigen::Vector3d> positions;
+        orbits.computePositions(2459000.5, positions, 1);
+
+        std::vector<Eigen::Vector3d> threadedPositions;
+        orbits.computePositions(2459000.5, threadedPositions, 4);
+        REQUIRE(threadedPositions == positions);
+
+        std::vector<Eigen::Vector3d> rangePositions(7);
+        orbits.computePositions(2459000.5, 13, 20, rangePositions.data());
+        for (std::size_t i = 0; i < rangePositions.size(); i++)
+            REQUIRE(rangePositions[i] == positions[13 + i]);
+    }
+}
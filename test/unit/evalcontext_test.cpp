@@ -0,0 +1,127 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celephem/evalcontext.h>
+#include <celephem/orbit.h>
+
+using namespace celestia::ephem;
+
+namespace
+{
+
+constexpr double J2000 = 2451545.0;
+
+// An orbit counting its evaluations
+class CountingOrbit : public CachingOrbit
+{
+ public:
+    Eigen::Vector3d computePosition(double jd) const override
+    {
+        ++evaluations;
+        return Eigen::Vector3d(jd - J2000, 1.0, 0.0);
+    }
+
+    double getPeriod() const override { return 1.0; }
+    double getBoundingRadius() const override { return 1.0; }
+
+    mutable std::atomic<int> evaluations{ 0 };
+};
+
+// An orbit relative to another caching orbit, which evaluates it while
+// computing its own position
+class NestedOrbit : public CachingOrbit
+{
+ public:
+    explicit NestedOrbit(const Orbit& _parent) : parent(_parent) {}
+
+    Eigen::Vector3d computePosition(double jd) const override
+    {
+        return parent.positionAtTime(jd) + Eigen::Vector3d(0.0, 0.0, 2.0);
+    }
+
+    double getPeriod() const override { return 1.0; }
+    double getBoundingRadius() const override { return 3.0; }
+
+ private:
+    const Orbit& parent;
+};
+
+} // end unnamed namespace
+
+TEST_CASE("Evaluation contexts", "[EvaluationContext]")
+{
+    SECTION("Cache IDs are unique")
+    {
+        CacheId a;
+        CacheId b(a);
+        CacheId c;
+        c = a;
+        REQUIRE(a.get() != b.get());
+        REQUIRE(a.get() != c.get());
+        REQUIRE(b.get() != c.get());
+    }
+
+    SECTION("Caching orbits compute each time once per thread")
+    {
+        CountingOrbit orbit;
+        for (int i = 0; i < 10; i++)
+        {
+            REQUIRE(orbit.positionAtTime(J2000 + 0.5).x() == 0.5);
+            REQUIRE(orbit.positionAtTime(J2000 + 0.25).x() == 0.25);
+        }
+        REQUIRE(orbit.evaluations == 2);
+        REQUIRE(orbit.isThreadSafe());
+
+        std::thread other([&orbit]
+        {
+            for (int i = 0; i < 10; i++)
+                orbit.positionAtTime(J2000 + 0.5);
+        });
+        other.join();
+        REQUIRE(orbit.evaluations == 3);
+
+        orbit.positionAtTime(J2000 + 0.5);
+        REQUIRE(orbit.evaluations == 3);
+    }
+
+    SECTION("Copies don't share the cache")
+    {
+        CountingOrbit orbit;
+        orbit.positionAtTime(J2000);
+        NestedOrbit first(orbit);
+        NestedOrbit second(first);
+        REQUIRE(first.positionAtTime(J2000) == Eigen::Vector3d(0.0, 1.0, 2.0));
+        REQUIRE(second.positionAtTime(J2000) == Eigen::Vector3d(0.0, 1.0, 2.0));
+        REQUIRE(orbit.evaluations == 1);
+    }
+
+    SECTION("Several threads evaluate the same orbits")
+    {
+        CountingOrbit orbit;
+        NestedOrbit nested(orbit);
+        constexpr int nTimes = 2000;
+
+        std::atomic<int> mismatches{ 0 };
+        std::vector<std::thread> threads;
+        for (int n = 0; n < 4; n++)
+        {
+            threads.emplace_back([&, n]
+            {
+                for (int i = 0; i < nTimes; i++)
+                {
+                    double t = J2000 + ((i * 7 + n * 13) % 50) * 0.1;
+                    Eigen::Vector3d expected(t - J2000, 1.0, 2.0);
+                    if (nested.positionAtTime(t) != expected || nested.velocityAtTime(t).norm() == 0.0)
+                        ++mismatches;
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        REQUIRE(mismatches == 0);
+    }
+}
@@ -0,0 +1,68 @@
+#include <random>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celmath/frustum.h>
+
+using celmath::Frustum;
+using celmath::SphereBatch;
+
+namespace
+{
+
+// Spheres inside, outside and across the planes of a frustum looking down
+// the -z axis
+SphereBatch
+getSpheres()
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> xy(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> depth(-200.0f, 20.0f);
+    std::uniform_real_distribution<float> radius(0.0f, 10.0f);
+    SphereBatch spheres;
+    for (int i = 0; i < 1000; i++)
+        spheres.add(Eigen::Vector3f(xy(rng), xy(rng), depth(rng)), radius(rng));
+    return spheres;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Frustum", "[Frustum]")
+{
+    SphereBatch spheres = getSpheres();
+
+    SECTION("Spheres tested together have the aspects they have alone")
+    {
+        Frustum infinite(1.0f, 1.5f, 1.0f);
+        Frustum finite(1.0f, 1.5f, 1.0f, 100.0f);
+        finite.transform(Eigen::Matrix3f(Eigen::AngleAxisf(0.3f, Eigen::Vector3f::UnitY())));
+
+        for (const Frustum* frustum : { &infinite, &finite })
+        {
+            std::vector<Frustum::Aspect> aspects;
+            frustum->testSpheres(spheres, aspects);
+            REQUIRE(aspects.size() == spheres.size());
+
+            int counts[3] = { 0, 0, 0 };
+            for (std::size_t i = 0; i < spheres.size(); i++)
+            {
+                Eigen::Vector3f center(spheres.x[i], spheres.y[i], spheres.z[i]);
+                REQUIRE(aspects[i] == frustum->testSphere(center, spheres.radii[i]));
+                ++counts[aspects[i]];
+            }
+
+            REQUIRE(counts[Frustum::Outside] > 0);
+            REQUIRE(counts[Frustum::Inside] > 0);
+            REQUIRE(counts[Frustum::Intersect] > 0);
+        }
+    }
+
+    SECTION("An empty batch is tested")
+    {
+        Frustum frustum(1.0f, 1.0f, 1.0f);
+        std::vector<Frustum::Aspect> aspects{ Frustum::Inside };
+        frustum.testSpheres(SphereBatch(), aspects);
+        REQUIRE(aspects.empty());
+    }
+}
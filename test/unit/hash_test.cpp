@@ -99,4 +99,35 @@ TEST_CASE("AssociativeArray", "[AssociativeArray]")
             REQUIRE(c->alpha() == Approx(0x78 / 255.).epsilon(EPSILON));
         }
     }
+
+    SECTION("Keys")
+    {
+        AssociativeArray h;
+        h.addValue("Radius", Value(1.0));
+        h.addValue("Mass", Value(2.0));
+        h.addValue("Radius", Value(3.0));
+
+        REQUIRE(h.getNumber<double>("Radius") == 1.0);
+        REQUIRE(h.getNumber<double>("Mass") == 2.0);
+        REQUIRE(h.getValue("Albedo") == nullptr);
+
+        std::size_t count = 0;
+        h.for_all([&count](std::string_view, const Value&) { ++count; });
+        REQUIRE(count == 2);
+    }
+    SECTION("Arena")
+    {
+        celestia::util::Arena arena;
+        {
+            auto* h = arena.create<AssociativeArray>(&arena);
+            Value hash = Value::fromArena(h);
+            auto* name = arena.create<std::string>("a name longer than the short string buffer");
+            h->addValue("Name", Value::fromArena(name));
+            h->addValue("Radius", Value(6378.0));
+
+            REQUIRE(*hash.getHash()->getString("Name") == *name);
+            REQUIRE(hash.getHash()->getNumber<double>("Radius") == 6378.0);
+        }
+        arena.reset();
+    }
 }
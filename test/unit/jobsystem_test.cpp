@@ -0,0 +1,125 @@
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include <celutil/jobsystem.h>
+
+#include <catch.hpp>
+
+using celestia::util::JobSystem;
+
+TEST_CASE("Job system", "[JobSystem]")
+{
+    SECTION("Parallel for covers the range once")
+    {
+        JobSystem jobs(4);
+        std::vector<std::atomic<int>> visits(1000);
+        jobs.parallelFor(0, visits.size(), 7, [&visits](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t i = begin; i < end; i++)
+                ++visits[i];
+        });
+
+        for (const auto& v : visits)
+            REQUIRE(v == 1);
+    }
+
+    SECTION("Dependent jobs start after their dependency")
+    {
+        JobSystem jobs(4);
+        JobSystem::Counter first;
+        JobSystem::Counter second;
+        std::atomic<int> done{ 0 };
+        std::atomic<bool> ordered{ true };
+
+        for (int i = 0; i < 16; i++)
+        {
+            jobs.submit([&done]
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                ++done;
+            }, &first);
+        }
+        jobs.submit([&done, &ordered] { ordered = done == 16; }, &second, &first);
+
+        jobs.wait(second);
+        REQUIRE(first.isDone());
+        REQUIRE(ordered);
+    }
+
+    SECTION("One thread runs the jobs on the main thread")
+    {
+        JobSystem jobs(1);
+        REQUIRE(jobs.threadCount() == 1);
+
+        JobSystem::Counter counter;
+        std::thread::id ranOn;
+        jobs.submit([&ranOn] { ranOn = std::this_thread::get_id(); }, &counter);
+        jobs.wait(counter);
+        REQUIRE(ranOn == std::this_thread::get_id());
+
+        bool ran = false;
+        jobs.submit([&ran] { ran = true; });
+        jobs.update();
+        REQUIRE(ran);
+    }
+
+    SECTION("Main thread jobs run in update")
+    {
+        JobSystem jobs(2);
+        JobSystem::Counter counter;
+        std::thread::id ranOn;
+        jobs.submit([&jobs, &ranOn]
+        {
+            jobs.runOnMainThread([&ranOn] { ranOn = std::this_thread::get_id(); });
+        }, &counter);
+        jobs.wait(counter);
+
+        REQUIRE(ranOn == std::thread::id());
+        jobs.update();
+        REQUIRE(ranOn == std::this_thread::get_id());
+    }
+
+    SECTION("Threads are numbered")
+    {
+        JobSystem jobs(3);
+        REQUIRE(jobs.threadIndex() == 0);
+        REQUIRE(jobs.scratchArena() != nullptr);
+
+        std::vector<std::atomic<int>> seen(jobs.threadCount());
+        std::atomic<bool> valid{ true };
+        jobs.parallelFor(0, 64, 1, [&jobs, &seen, &valid](std::size_t, std::size_t)
+        {
+            unsigned int index = jobs.threadIndex();
+            if (index < jobs.threadCount())
+                ++seen[index];
+            else
+                valid = false;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        });
+        REQUIRE(valid);
+        REQUIRE(seen[0] > 0);
+
+        unsigned int otherIndex = 0;
+        std::thread other([&jobs, &otherIndex] { otherIndex = jobs.threadIndex(); });
+        other.join();
+        REQUIRE(otherIndex == JobSystem::NotAJobThread);
+    }
+
+    SECTION("Statistics count the jobs run")
+    {
+        JobSystem jobs(2);
+        jobs.takeStats();
+        JobSystem::Counter counter;
+        for (int i = 0; i < 10; i++)
+            jobs.submit([] {}, &counter);
+        jobs.wait(counter);
+
+        auto stats = jobs.takeStats();
+        REQUIRE(stats.jobs == 10);
+        REQUIRE(stats.stolenJobs <= stats.jobs);
+        REQUIRE(jobs.takeStats().jobs == 0);
+    }
+}
@@ -0,0 +1,210 @@
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <ios>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include <catch.hpp>
+
+#include <celcompat/filesystem.h>
+#include <celephem/jpleph.h>
+#include <celutil/bytes.h>
+
+using namespace celestia::ephem;
+
+namespace
+{
+
+constexpr double StartDate = 2451536.5;
+constexpr double DaysPerInterval = 32.0;
+constexpr unsigned int NRecords = 3;
+constexpr unsigned int NCoeffs = 8;
+constexpr unsigned int NGranules = 2;
+constexpr unsigned int NPlanets = 11;
+// Start and end time, then three components for every granule of the planets
+constexpr unsigned int RecordSize = 2 + NPlanets * NCoeffs * NGranules * 3;
+constexpr double EarthMoonMassRatio = 81.3;
+
+// Offsets within the DE file header
+constexpr std::size_t DatesOffset = 3 * 84 + 400 * 6;
+constexpr std::size_t AUOffset = DatesOffset + 3 * 8 + 4;
+constexpr std::size_t CoeffInfoOffset = AUOffset + 2 * 8;
+constexpr std::size_t DENumOffset = CoeffInfoOffset + 12 * 12;
+
+// The constant term of a component; the other terms are the same for all
+double
+getConstantTerm(unsigned int planet, unsigned int component, unsigned int record, unsigned int granule)
+{
+    return 1000.0 * planet + 100.0 * component + 10.0 * record + granule;
+}
+
+// Value of the series at the normalized time u
+double
+getExpected(unsigned int planet, unsigned int component, unsigned int record, unsigned int granule, double u)
+{
+    return getConstantTerm(planet, component, record, granule) + u + 0.25 * (2.0 * u * u - 1.0);
+}
+
+class EphemerisWriter
+{
+public:
+    explicit EphemerisWriter(bool _swap) :
+        data((NRecords + 2) * RecordSize * sizeof(double), '\0'),
+        swap(_swap)
+    {
+        putDouble(DatesOffset, StartDate);
+        putDouble(DatesOffset + 8, StartDate + NRecords * DaysPerInterval);
+        putDouble(DatesOffset + 16, DaysPerInterval);
+        putDouble(AUOffset, 1.495978707e8);
+        putDouble(AUOffset + 8, EarthMoonMassRatio);
+        for (unsigned int i = 0; i < NPlanets; i++)
+        {
+            putUint(CoeffInfoOffset + i * 12, 3 + i * NCoeffs * NGranules * 3);
+            putUint(CoeffInfoOffset + i * 12 + 4, NCoeffs);
+            putUint(CoeffInfoOffset + i * 12 + 8, NGranules);
+        }
+        putUint(DENumOffset, 405);
+
+        for (unsigned int r = 0; r < NRecords; r++)
+        {
+            std::size_t record = (r + 2) * RecordSize;
+            putDouble(record * 8, StartDate + r * DaysPerInterval);
+            putDouble(record * 8 + 8, StartDate + (r + 1) * DaysPerInterval);
+            for (unsigned int i = 0; i < NPlanets; i++)
+            {
+                for (unsigned int g = 0; g < NGranules; g++)
+                {
+                    for (unsigned int c = 0; c < 3; c++)
+                    {
+                        std::size_t first = record + 2 + ((i * NGranules + g) * 3 + c) * NCoeffs;
+                        putDouble(first * 8, getConstantTerm(i, c, r, g));
+                        putDouble((first + 1) * 8, 1.0);
+                        putDouble((first + 2) * 8, 0.25);
+                    }
+                }
+            }
+        }
+    }
+
+    std::string data;
+
+private:
+    void putUint(std::size_t offset, std::uint32_t value)
+    {
+        if (swap)
+            value = bswap_32(value);
+        std::memcpy(data.data() + offset, &value, sizeof(value));
+    }
+
+    void putDouble(std::size_t offset, double value)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        if (swap)
+            bits = bswap_64(bits);
+        std::memcpy(data.data() + offset, &bits, sizeof(bits));
+    }
+
+    bool swap;
+};
+
+void
+checkPositions(const JPLEphemeris& eph)
+{
+    REQUIRE(eph.getDENumber() == 405);
+    REQUIRE(eph.getRecordSize() == RecordSize);
+    REQUIRE(eph.getStartDate() == StartDate);
+    REQUIRE(eph.getEndDate() == StartDate + NRecords * DaysPerInterval);
+
+    const double daysPerGranule = DaysPerInterval / NGranules;
+    for (unsigned int r = 0; r < NRecords; r++)
+    {
+        for (unsigned int g = 0; g < NGranules; g++)
+        {
+            for (double u : { -0.5, 0.0, 0.75 })
+            {
+                double tjd = StartDate + r * DaysPerInterval + (g + 0.5 * (u + 1.0)) * daysPerGranule;
+                for (unsigned int i = 0; i < NPlanets; i++)
+                {
+                    Eigen::Vector3d pos = eph.getPlanetPosition(static_cast<JPLEphemItem>(i), tjd);
+                    for (unsigned int c = 0; c < 3; c++)
+                        REQUIRE(pos[c] == Approx(getExpected(i, c, r, g, u)));
+                }
+
+                Eigen::Vector3d emb = eph.getPlanetPosition(JPLEphemItem::EarthMoonBary, tjd);
+                Eigen::Vector3d moon = eph.getPlanetPosition(JPLEphemItem::Moon, tjd);
+                Eigen::Vector3d earth = eph.getPlanetPosition(JPLEphemItem::Earth, tjd);
+                REQUIRE(earth.isApprox(emb - moon / (EarthMoonMassRatio + 1.0)));
+            }
+        }
+    }
+
+    // Times outside of the ephemeris are clamped
+    Eigen::Vector3d last = eph.getPlanetPosition(JPLEphemItem::Mars, eph.getEndDate() + 100.0);
+    REQUIRE(last.x() == Approx(getExpected(3, 0, NRecords - 1, NGranules - 1, 1.0)));
+    Eigen::Vector3d first = eph.getPlanetPosition(JPLEphemItem::Mars, StartDate - 100.0);
+    REQUIRE(first.x() == Approx(getExpected(3, 0, 0, 0, -1.0)));
+    REQUIRE(eph.getPlanetPosition(JPLEphemItem::SSB, StartDate) == Eigen::Vector3d::Zero());
+}
+
+void
+writeFile(const fs::path& path, const std::string& data)
+{
+    std::ofstream out(path, std::ios::out | std::ios::binary);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    REQUIRE(out.good());
+}
+
+} // end unnamed namespace
+
+TEST_CASE("JPL ephemeris", "[JPLEphemeris]")
+{
+    for (bool swap : { false, true })
+    {
+        EphemerisWriter writer(swap);
+        const fs::path path = "jpleph_test.dat";
+        writeFile(path, writer.data);
+
+        SECTION(swap ? "Mapped byte swapped file" : "Mapped file")
+        {
+            std::unique_ptr<JPLEphemeris> eph(JPLEphemeris::load(path));
+            REQUIRE(eph != nullptr);
+            REQUIRE(eph->getByteSwap() == swap);
+            checkPositions(*eph);
+        }
+
+        SECTION(swap ? "Streamed byte swapped file" : "Streamed file")
+        {
+            std::istringstream in(writer.data, std::ios::in | std::ios::binary);
+            std::unique_ptr<JPLEphemeris> eph(JPLEphemeris::load(in));
+            REQUIRE(eph != nullptr);
+            REQUIRE(eph->getByteSwap() == swap);
+            checkPositions(*eph);
+        }
+
+        SECTION(swap ? "Truncated byte swapped files are rejected" : "Truncated files are rejected")
+        {
+            std::string truncated = writer.data.substr(0, writer.data.size() - 8);
+            writeFile(path, truncated);
+            REQUIRE(JPLEphemeris::load(path) == nullptr);
+
+            std::istringstream in(truncated, std::ios::in | std::ios::binary);
+            REQUIRE(JPLEphemeris::load(in) == nullptr);
+        }
+
+        fs::remove(path);
+    }
+
+    SECTION("Coefficients outside of the records are rejected")
+    {
+        EphemerisWriter writer(false);
+        std::uint32_t offset = RecordSize;
+        std::memcpy(writer.data.data() + CoeffInfoOffset + 10 * 12, &offset, sizeof(offset));
+        std::istringstream in(writer.data, std::ios::in | std::ios::binary);
+        REQUIRE(JPLEphemeris::load(in) == nullptr);
+    }
+
+    REQUIRE(JPLEphemeris::load(fs::path("jpleph_test_missing.dat")) == nullptr);
+}
@@ -0,0 +1,123 @@
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include <catch.hpp>
+
+#include <celcompat/filesystem.h>
+#include <celengine/image.h>
+#include <celimage/imageformats.h>
+
+namespace
+{
+
+constexpr std::uint32_t VkFormatR8G8B8A8Unorm = 37;
+
+struct Header
+{
+    std::uint32_t vkFormat{ VkFormatR8G8B8A8Unorm };
+    std::uint32_t typeSize{ 1 };
+    std::uint32_t pixelWidth{ 2 };
+    std::uint32_t pixelHeight{ 2 };
+    std::uint32_t pixelDepth{ 0 };
+    std::uint32_t layerCount{ 0 };
+    std::uint32_t faceCount{ 1 };
+    std::uint32_t levelCount{ 1 };
+    std::uint32_t supercompressionScheme{ 0 };
+};
+
+void
+appendLE(std::string& data, std::uint64_t value, int size)
+{
+    for (int i = 0; i < size; i++)
+        data.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+// Writes a KTX2 file with the given header and a single 2x2 RGBA level
+fs::path
+writeKTX(const char* name, const Header& header)
+{
+    std::string data("\xab\x4b\x54\x58\x20\x32\x30\xbb\x0d\x0a\x1a\x0a", 12);
+    for (std::uint32_t value : { header.vkFormat, header.typeSize,
+                                 header.pixelWidth, header.pixelHeight,
+                                 header.pixelDepth, header.layerCount,
+                                 header.faceCount, header.levelCount,
+                                 header.supercompressionScheme })
+    {
+        appendLE(data, value, 4);
+    }
+
+    // Data format descriptor, key/value data and supercompression offsets
+    data.append(32, '\0');
+
+    constexpr std::uint64_t pixelBytes = 2 * 2 * 4;
+    std::uint64_t pixelOffset = data.size() + 24;
+    appendLE(data, pixelOffset, 8);
+    appendLE(data, pixelBytes, 8);
+    appendLE(data, pixelBytes, 8);
+    for (std::uint64_t i = 0; i < pixelBytes; i++)
+        data.push_back(static_cast<char>(i));
+
+    fs::path path = fs::temp_directory_path() / name;
+    std::ofstream out(path, std::ios::out | std::ios::binary);
+    out << data;
+    return path;
+}
+
+std::unique_ptr<Image>
+loadKTX(const char* name, const Header& header)
+{
+    fs::path path = writeKTX(name, header);
+    std::unique_ptr<Image> img(LoadKTXImage(path));
+    std::error_code ec;
+    fs::remove(path, ec);
+    return img;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("KTX2 loader", "[KTX]")
+{
+    SECTION("A well formed texture loads")
+    {
+        auto img = loadKTX("celestia-ktx-valid.ktx2", Header());
+        REQUIRE(img != nullptr);
+        REQUIRE(img->getWidth() == 2);
+        REQUIRE(img->getHeight() == 2);
+        REQUIRE(img->getMipLevelCount() == 1);
+        REQUIRE(img->getPixelRow(0, 1)[0] == 8);
+    }
+
+    SECTION("Zero dimensions are rejected")
+    {
+        Header header;
+        header.pixelWidth = 0;
+        REQUIRE(loadKTX("celestia-ktx-zero.ktx2", header) == nullptr);
+    }
+
+    SECTION("Dimensions too large for an int are rejected")
+    {
+        Header header;
+        header.pixelWidth = 0x80000000u;
+        header.pixelHeight = 0xffffffffu;
+        REQUIRE(loadKTX("celestia-ktx-huge.ktx2", header) == nullptr);
+    }
+
+    SECTION("Dimensions too large for a texture are rejected")
+    {
+        Header header;
+        header.pixelWidth = 1u << 20;
+        REQUIRE(loadKTX("celestia-ktx-large.ktx2", header) == nullptr);
+    }
+
+    SECTION("Level counts beyond the mip chain are rejected")
+    {
+        Header header;
+        header.levelCount = 3;
+        REQUIRE(loadKTX("celestia-ktx-levels.ktx2", header) == nullptr);
+
+        header.levelCount = 0xffffffffu;
+        REQUIRE(loadKTX("celestia-ktx-maxlevels.ktx2", header) == nullptr);
+    }
+}
@@ -0,0 +1,57 @@
+#include <catch.hpp>
+
+#include <celengine/labelgrid.h>
+
+using celestia::engine::LabelGrid;
+
+TEST_CASE("LabelGrid", "[LabelGrid]")
+{
+    LabelGrid grid;
+    grid.reset(640, 480, 64);
+
+    SECTION("Overlapping boxes")
+    {
+        REQUIRE(grid.tryAdd({ 10.0f, 10.0f, 100.0f, 24.0f }));
+        REQUIRE_FALSE(grid.tryAdd({ 90.0f, 20.0f, 150.0f, 34.0f }));
+        REQUIRE(grid.overlaps({ 50.0f, 0.0f, 60.0f, 11.0f }));
+    }
+
+    SECTION("Touching boxes")
+    {
+        REQUIRE(grid.tryAdd({ 10.0f, 10.0f, 100.0f, 24.0f }));
+        REQUIRE(grid.tryAdd({ 100.0f, 10.0f, 200.0f, 24.0f }));
+        REQUIRE(grid.tryAdd({ 10.0f, 24.0f, 100.0f, 38.0f }));
+    }
+
+    SECTION("Boxes across cells")
+    {
+        // Spans many cells, but only meets the second box in the last one
+        REQUIRE(grid.tryAdd({ 0.0f, 100.0f, 600.0f, 110.0f }));
+        REQUIRE_FALSE(grid.tryAdd({ 590.0f, 105.0f, 700.0f, 120.0f }));
+        REQUIRE(grid.tryAdd({ 590.0f, 110.0f, 700.0f, 120.0f }));
+    }
+
+    SECTION("Boxes off the screen")
+    {
+        REQUIRE(grid.tryAdd({ -100.0f, 10.0f, -10.0f, 24.0f }));
+        REQUIRE(grid.tryAdd({ -100.0f, 10.0f, -10.0f, 24.0f }));
+
+        // Partly on the screen
+        REQUIRE(grid.tryAdd({ -50.0f, 10.0f, 20.0f, 24.0f }));
+        REQUIRE_FALSE(grid.tryAdd({ 0.0f, 0.0f, 10.0f, 15.0f }));
+    }
+
+    SECTION("Forced boxes")
+    {
+        grid.add({ 10.0f, 10.0f, 100.0f, 24.0f });
+        grid.add({ 20.0f, 10.0f, 110.0f, 24.0f });
+        REQUIRE_FALSE(grid.tryAdd({ 105.0f, 10.0f, 120.0f, 24.0f }));
+    }
+
+    SECTION("Reset")
+    {
+        REQUIRE(grid.tryAdd({ 10.0f, 10.0f, 100.0f, 24.0f }));
+        grid.reset(320, 240, 32);
+        REQUIRE(grid.tryAdd({ 10.0f, 10.0f, 100.0f, 24.0f }));
+    }
+}
@@ -0,0 +1,82 @@
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celcompat/numbers.h>
+#include <celengine/lazybodycatalog.h>
+#include <celephem/orbit.h>
+
+namespace
+{
+
+LazyBodyCatalog::Definition
+makeDefinition(std::vector<std::string> names, double eccentricity)
+{
+    LazyBodyCatalog::Definition definition;
+    definition.names = std::move(names);
+    definition.radius = 10.0f;
+    definition.geomAlbedo = 0.2f;
+    definition.orbit.pericenterDistance = 3.0e8 * (1.0 - eccentricity);
+    definition.orbit.eccentricity = eccentricity;
+    definition.orbit.inclination = 0.3;
+    definition.orbit.ascendingNode = 1.2;
+    definition.orbit.argOfPeriapsis = 2.5;
+    definition.orbit.meanAnomalyAtEpoch = 0.7;
+    definition.orbit.period = 1600.0;
+    definition.orbit.epoch = 2451545.0;
+    return definition;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Lazy body catalog", "[LazyBodyCatalog]")
+{
+    // Without a system, bodies can't be created
+    LazyBodyCatalog catalog(nullptr, nullptr);
+
+    catalog.add(makeDefinition({ "Ceres", "1 Ceres" }, 0.08));
+    catalog.add(makeDefinition({ "Hidalgo" }, 0.66));
+    catalog.add(makeDefinition({ "Phaethon" }, 0.89));
+    for (int i = 0; i < 3000; i++)
+        catalog.add(makeDefinition({ "Asteroid " + std::to_string(i) }, 0.1));
+
+    SECTION("Bodies are found by any of their names")
+    {
+        REQUIRE(catalog.find("Ceres") == 0);
+        REQUIRE(catalog.find("1 Ceres") == 0);
+        REQUIRE(catalog.find("ceres") == 0);
+        REQUIRE(catalog.find("Hidalgo") == 1);
+        REQUIRE(catalog.find("Asteroid 2999") == 3002);
+        REQUIRE(catalog.find("Pallas") == LazyBodyCatalog::InvalidIndex);
+        REQUIRE(catalog.getBody(0) == nullptr);
+    }
+
+    SECTION("Names are completed")
+    {
+        std::vector<std::string> completion;
+        catalog.getCompletion(completion, "1 C");
+        REQUIRE(completion == std::vector<std::string>{ "1 Ceres" });
+    }
+
+    SECTION("Positions agree with the elliptical orbits")
+    {
+        std::vector<Eigen::Vector3d> positions;
+        for (double tdb : { 2451545.0, 2455000.5, 2460123.25 })
+        {
+            catalog.computePositions(tdb, positions);
+            REQUIRE(positions.size() == catalog.size());
+
+            for (std::uint32_t i = 0; i < 4; i++)
+            {
+                const double e = i == 0 ? 0.08 : i == 1 ? 0.66 : i == 2 ? 0.89 : 0.1;
+                celestia::ephem::EllipticalOrbit orbit(3.0e8 * (1.0 - e), e, 0.3, 1.2, 2.5, 0.7, 1600.0);
+                Eigen::Vector3d expected = orbit.positionAtTime(tdb);
+                REQUIRE((positions[i] - expected).norm() < 1.0e-6 * expected.norm());
+            }
+        }
+
+        REQUIRE(catalog.getBoundingRadius(1) == Approx(3.0e8 * 1.66));
+    }
+}
@@ -0,0 +1,82 @@
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <catch.hpp>
+
+#include <celcompat/filesystem.h>
+#include <celutil/loadtrace.h>
+
+using celestia::util::LoadEvent;
+using celestia::util::LoadScope;
+using celestia::util::LoadTrace;
+
+TEST_CASE("LoadTrace", "[LoadTrace]")
+{
+    LoadTrace& trace = LoadTrace::get();
+    fs::path file = fs::temp_directory_path() / "celestia-loadtrace-test.stc";
+    {
+        std::ofstream out(file, std::ios::out | std::ios::binary);
+        out << std::string(1234, 'x');
+    }
+
+    {
+        LoadScope phase(LoadScope::Phase, "stars");
+        {
+            LoadScope scope = LoadScope::forFile("stc", file);
+            scope.setObjects(42);
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        LoadScope scope("crossindex", "a \"quoted\" name");
+    }
+
+    std::vector<LoadEvent> events = trace.getEvents();
+    REQUIRE(events.size() == 3);
+
+    // The trace is global, so the checks run in one pass rather than in
+    // sections, which would record the events again
+    {
+        // Events are added as they end
+        const LoadEvent& stc = events[0];
+        REQUIRE(stc.category == "stc");
+        REQUIRE(stc.name == file.string());
+        REQUIRE(stc.bytes == 1234);
+        REQUIRE(stc.objects == 42);
+        REQUIRE(stc.depth == 1);
+        REQUIRE(stc.duration >= 0.015);
+
+        const LoadEvent& phase = events[2];
+        REQUIRE(phase.category == LoadScope::Phase);
+        REQUIRE(phase.depth == 0);
+        REQUIRE(phase.start <= stc.start);
+        REQUIRE(phase.start + phase.duration >= stc.start + stc.duration);
+
+        REQUIRE(trace.getSlowest().category == "stc");
+        REQUIRE(trace.getDuration() >= phase.start + phase.duration);
+    }
+
+    {
+        std::ostringstream json;
+        trace.writeChromeTrace(json);
+        REQUIRE(json.str().rfind("[\n{\"name\":", 0) == 0);
+        REQUIRE(json.str().find("\"bytes\":1234,\"objects\":42") != std::string::npos);
+        REQUIRE(json.str().find("a \\\"quoted\\\" name") != std::string::npos);
+
+        std::ostringstream summary;
+        trace.writeSummary(summary);
+        REQUIRE(summary.str().find("crossindex") != std::string::npos);
+        REQUIRE(summary.str().find(file.string()) != std::string::npos);
+    }
+
+    {
+        trace.stop();
+        {
+            LoadScope scope("shader", "late");
+        }
+        REQUIRE(trace.getEvents().size() == 3);
+    }
+
+    std::error_code ec;
+    fs::remove(file, ec);
+}
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celengine/location.h>
+#include <celengine/locationindex.h>
+
+namespace
+{
+
+constexpr double BodyRadius = 1737.0;
+
+// Locations which an observer can see and which are large enough
+std::vector<const Location*>
+findVisible(const std::vector<Location*>& locations, const LocationIndex::Query& query)
+{
+    std::vector<const Location*> visible;
+    for (const Location* location : locations)
+    {
+        Eigen::Vector3d position = location->getPosition().cast<double>();
+        Eigen::Vector3d toObserver = query.observerPosition - position;
+        double distance = toObserver.norm();
+        if ((location->getFeatureType() & query.featureMask) == 0 ||
+            !(LocationIndex::getImportance(*location) > query.minImportancePerDistance * distance))
+        {
+            continue;
+        }
+
+        // Distance from the center of the line of sight to the location
+        double t = std::clamp(-position.dot(toObserver) / (distance * distance), 0.0, 1.0);
+        if ((position + t * toObserver).norm() < query.occluderRadius)
+            continue;
+
+        visible.push_back(location);
+    }
+
+    return visible;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Location index", "[LocationIndex]")
+{
+    std::mt19937 rng(3);
+    std::normal_distribution<double> normal;
+    std::uniform_real_distribution<float> sizes(1.0f, 500.0f);
+
+    std::vector<std::unique_ptr<Location>> storage;
+    std::vector<Location*> locations;
+    for (int i = 0; i < 5000; i++)
+    {
+        Eigen::Vector3d direction(normal(rng), normal(rng), normal(rng));
+        auto& location = storage.emplace_back(std::make_unique<Location>());
+        location->setPosition((direction.normalized() * BodyRadius).cast<float>());
+        location->setSize(sizes(rng));
+        if (i % 10 == 0)
+            location->setImportance(1000.0f);
+        location->setFeatureType(i % 3 == 0 ? Location::Crater : Location::Mons);
+        locations.push_back(location.get());
+    }
+
+    LocationIndex index(locations);
+
+    SECTION("Visible locations are found in order of importance")
+    {
+        for (double distance : { 1800.0, 3000.0, 20000.0, 1.0e5 })
+        {
+            LocationIndex::Query query;
+            query.observerPosition = Eigen::Vector3d(0.3, -0.5, 0.8).normalized() * distance;
+            query.occluderRadius = BodyRadius * 0.999;
+            query.minImportancePerDistance = 20.0 * 2.0e-4;
+
+            std::vector<const Location*> found;
+            index.find(query, found);
+
+            std::vector<const Location*> expected = findVisible(locations, query);
+            REQUIRE(!expected.empty());
+            for (const Location* location : expected)
+                REQUIRE(std::find(found.begin(), found.end(), location) != found.end());
+
+            REQUIRE(std::is_sorted(found.begin(), found.end(),
+                                   [](const Location* a, const Location* b)
+                                   {
+                                       return LocationIndex::getImportance(*a) > LocationIndex::getImportance(*b);
+                                   }));
+
+            // Most of the locations on the far side are skipped
+            REQUIRE(found.size() < locations.size() * 3 / 4);
+        }
+    }
+
+    SECTION("Locations are filtered by feature type")
+    {
+        LocationIndex::Query query;
+        query.observerPosition = Eigen::Vector3d(0.0, 0.0, 4000.0);
+        query.occluderRadius = BodyRadius * 0.999;
+        query.featureMask = Location::Crater;
+
+        std::vector<const Location*> found;
+        index.find(query, found);
+        REQUIRE(!found.empty());
+        for (const Location* location : found)
+            REQUIRE(location->getFeatureType() == Location::Crater);
+        REQUIRE(found.size() >= findVisible(locations, query).size());
+    }
+}
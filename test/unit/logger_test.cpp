@@ -1,6 +1,9 @@
 #include <catch.hpp>
 #include <sstream>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
 #include <celutil/logger.h>
 
 using celestia::util::Logger;
@@ -154,4 +157,58 @@ TEST_CASE("logger", "[logger]")
         REQUIRE(err.str() == "s=1 e=a\n");
         REQUIRE(log.str().empty());
     }
+
+    SECTION("With asynchronous writes")
+    {
+        std::ostringstream err, log;
+        Logger logger(Level::Info, log, err);
+        logger.startAsync(16);
+
+        logger.error("number={}\n", 123);
+        logger.info("hello world\n");
+        logger.flush();
+        REQUIRE(err.str() == "number=123\n");
+        REQUIRE(log.str() == "hello world\n");
+        CLEAR(err);
+        CLEAR(log);
+
+        // Errors wait for room in the queue, so none is lost
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i)
+        {
+            threads.emplace_back([&logger, i]()
+            {
+                for (int j = 0; j < 100; ++j)
+                    logger.error("{} {}\n", i, j);
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        logger.stopAsync();
+
+        std::istringstream lines(err.str());
+        std::string line;
+        int count = 0;
+        while (std::getline(lines, line))
+            ++count;
+        REQUIRE(count == 400);
+
+        logger.info("synchronous\n");
+        REQUIRE(log.str() == "synchronous\n");
+    }
+
+    SECTION("With a rate limit")
+    {
+        std::ostringstream err, log;
+        Logger logger(Level::Info, log, err);
+        logger.setRateLimit(Level::Info, 2);
+
+        for (int i = 0; i < 10; ++i)
+            logger.info("{}\n", i);
+        logger.error("error\n");
+        // Messages within the limit come first, unless a second passed
+        REQUIRE(log.str().rfind("0\n1\n", 0) == 0);
+        REQUIRE(log.str().size() <= 8);
+        REQUIRE(err.str() == "error\n");
+    }
 }
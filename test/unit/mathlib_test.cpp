@@ -0,0 +1,26 @@
+#include <cmath>
+
+#include <catch.hpp>
+
+#include <celmath/mathlib.h>
+
+TEST_CASE("fastLog2", "[mathlib]")
+{
+    SECTION("Powers of two")
+    {
+        for (int e = -126; e < 128; e++)
+            REQUIRE(celmath::fastLog2(std::ldexp(1.0f, e)) == Approx(static_cast<float>(e)).margin(1.0e-5));
+    }
+
+    SECTION("Mantissas")
+    {
+        for (float x = 0.5f; x < 4.0f; x += 0.001f)
+            REQUIRE(celmath::fastLog2(x) == Approx(std::log2(x)).margin(1.0e-6));
+    }
+
+    SECTION("Star distances")
+    {
+        for (float x = 1.0e-6f; x < 1.0e10f; x *= 1.37f)
+            REQUIRE(celmath::fastLog10(x) == Approx(std::log10(x)).epsilon(1.0e-6).margin(1.0e-6));
+    }
+}
@@ -0,0 +1,67 @@
+#include <string>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celutil/memoryreport.h>
+
+using celestia::util::MemoryReport;
+using celestia::util::formatMemorySize;
+using celestia::util::stringMemory;
+using celestia::util::vectorMemory;
+
+TEST_CASE("MemoryReport", "[MemoryReport]")
+{
+    SECTION("Categories accumulate in the order they are added")
+    {
+        MemoryReport report;
+        report.add("Stars", 1000, 10);
+        report.add("Names", 300);
+        report.add("Stars", 500, 5);
+
+        const auto& entries = report.getEntries();
+        REQUIRE(entries.size() == 2);
+        REQUIRE(entries[0].category == "Stars");
+        REQUIRE(entries[0].bytes == 1500);
+        REQUIRE(entries[0].objects == 15);
+        REQUIRE(entries[1].category == "Names");
+        REQUIRE(report.getTotal() == 1800);
+
+        REQUIRE(report.find("Names") == &entries[1]);
+        REQUIRE(report.find("Models") == nullptr);
+    }
+
+    SECTION("Largest entries")
+    {
+        MemoryReport report;
+        report.add("A", 10);
+        report.add("B", 30);
+        report.add("C", 20);
+
+        auto largest = report.getLargest(2);
+        REQUIRE(largest.size() == 2);
+        REQUIRE(largest[0].category == "B");
+        REQUIRE(largest[1].category == "C");
+        REQUIRE(report.getLargest(5).size() == 3);
+    }
+
+    SECTION("Container sizes")
+    {
+        std::vector<double> v;
+        v.reserve(100);
+        REQUIRE(vectorMemory(v) == v.capacity() * sizeof(double));
+
+        REQUIRE(stringMemory(std::string()) == 0);
+        std::string s(1000, 'x');
+        REQUIRE(stringMemory(s) == s.capacity() + 1);
+    }
+
+    SECTION("Formatting")
+    {
+        REQUIRE(formatMemorySize(0) == "0 B");
+        REQUIRE(formatMemorySize(1023) == "1023 B");
+        REQUIRE(formatMemorySize(1536) == "1.5 KiB");
+        REQUIRE(formatMemorySize(std::size_t(3) << 20) == "3.0 MiB");
+        REQUIRE(formatMemorySize(std::size_t(5) << 30) == "5.0 GiB");
+    }
+}
@@ -0,0 +1,126 @@
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celmodel/mesh.h>
+#include <celmodel/meshbvh.h>
+#include <celmodel/model.h>
+
+using namespace cmod;
+
+namespace
+{
+
+// A bumpy height field over the unit square, as triangle lists, and a
+// strip along one edge
+Mesh
+makeMesh(int size)
+{
+    std::vector<VWord> vertices;
+    for (int y = 0; y <= size; y++)
+    {
+        for (int x = 0; x <= size; x++)
+        {
+            float fx = static_cast<float>(x) / static_cast<float>(size);
+            float fy = static_cast<float>(y) / static_cast<float>(size);
+            float v[3] = { fx, fy, 0.1f * std::sin(fx * 17.0f) * std::cos(fy * 11.0f) };
+            VWord w[3];
+            std::memcpy(w, v, sizeof(v));
+            vertices.insert(vertices.end(), w, w + 3);
+        }
+    }
+
+    Mesh mesh;
+    VertexDescription desc({ VertexAttribute(VertexAttributeSemantic::Position, VertexAttributeFormat::Float3, 0) });
+    desc.strideBytes = 3 * sizeof(VWord);
+    mesh.setVertexDescription(std::move(desc));
+    mesh.setVertices((size + 1) * (size + 1), std::move(vertices));
+
+    auto index = [size](int x, int y) { return static_cast<Index32>(y * (size + 1) + x); };
+    std::vector<Index32> list;
+    for (int y = 0; y < size - 1; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            list.insert(list.end(), { index(x, y), index(x + 1, y), index(x, y + 1) });
+            list.insert(list.end(), { index(x + 1, y), index(x + 1, y + 1), index(x, y + 1) });
+        }
+    }
+    mesh.addGroup(PrimitiveGroupType::TriList, 0, std::move(list));
+
+    std::vector<Index32> strip;
+    for (int x = 0; x <= size; x++)
+    {
+        strip.push_back(index(x, size - 1));
+        strip.push_back(index(x, size));
+    }
+    mesh.addGroup(PrimitiveGroupType::TriStrip, 0, std::move(strip));
+
+    return mesh;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Mesh BVH", "[MeshBVH]")
+{
+    Mesh mesh = makeMesh(40);
+    MeshBVH bvh(mesh);
+    REQUIRE(bvh.getTriangleCount() == mesh.getPrimitiveCount());
+
+    SECTION("Picks the same triangles as the mesh")
+    {
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<double> dist(-0.2, 1.2);
+        int hits = 0;
+        for (int i = 0; i < 500; i++)
+        {
+            Eigen::Vector3d origin(dist(rng), dist(rng), 2.0);
+            Eigen::Vector3d target(dist(rng), dist(rng), 0.0);
+            Eigen::Vector3d direction = target - origin;
+
+            Mesh::PickResult expected;
+            Mesh::PickResult actual;
+            bool expectedHit = mesh.pick(origin, direction, &expected);
+            REQUIRE(bvh.pick(origin, direction, &actual) == expectedHit);
+            if (expectedHit)
+            {
+                hits++;
+                REQUIRE(actual.group == expected.group);
+                REQUIRE(actual.primitiveIndex == expected.primitiveIndex);
+                REQUIRE(actual.distance == Approx(expected.distance));
+            }
+        }
+        REQUIRE(hits > 100);
+    }
+
+    SECTION("Hits beyond the maximum distance are ignored")
+    {
+        Eigen::Vector3d origin(0.5, 0.5, 2.0);
+        Eigen::Vector3d direction(0.0, 0.0, -1.0);
+        Mesh::PickResult result;
+        REQUIRE(bvh.pick(origin, direction, &result));
+        REQUIRE(!bvh.pick(origin, direction, &result, result.distance * 0.5));
+    }
+
+    SECTION("Picks the nearest mesh of a model")
+    {
+        Model model;
+        Mesh nearMesh = makeMesh(8);
+        nearMesh.transform(Eigen::Vector3f(0.0f, 0.0f, 1.0f), 1.0f);
+        model.addMesh(makeMesh(8));
+        model.addMesh(std::move(nearMesh));
+        ModelBVH modelBVH(model);
+
+        Mesh::PickResult result;
+        REQUIRE(modelBVH.pick(Eigen::Vector3d(0.5, 0.5, 3.0), Eigen::Vector3d(0.0, 0.0, -1.0), &result));
+        REQUIRE(result.mesh == model.getMesh(1));
+        REQUIRE(result.distance == Approx(2.0).margin(0.1));
+
+        double distance = 0.0;
+        REQUIRE(!modelBVH.pick(Eigen::Vector3d(5.0, 5.0, 3.0), Eigen::Vector3d(0.0, 0.0, -1.0), distance));
+    }
+}
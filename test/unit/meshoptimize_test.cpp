@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celmodel/mesh.h>
+#include <celmodel/meshoptimize.h>
+
+using namespace cmod;
+
+namespace
+{
+
+using Triangle = std::array<std::array<float, 3>, 3>;
+
+// A bumpy grid stored as a triangle soup in random order, with three
+// vertices of its own per triangle
+Mesh
+makeSoup(int size, unsigned int seed)
+{
+    auto position = [size](int x, int y)
+    {
+        float fx = static_cast<float>(x) / static_cast<float>(size);
+        float fy = static_cast<float>(y) / static_cast<float>(size);
+        return std::array<float, 3>{ fx, fy, 0.1f * std::sin(fx * 7.0f) * std::cos(fy * 5.0f) };
+    };
+
+    std::vector<Triangle> triangles;
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            triangles.push_back({ position(x, y), position(x + 1, y), position(x, y + 1) });
+            triangles.push_back({ position(x + 1, y), position(x + 1, y + 1), position(x, y + 1) });
+        }
+    }
+    std::mt19937 rng(seed);
+    std::shuffle(triangles.begin(), triangles.end(), rng);
+
+    std::vector<VWord> vertices;
+    std::vector<Index32> indices;
+    for (const Triangle& tri : triangles)
+    {
+        for (const auto& v : tri)
+        {
+            VWord w[3];
+            std::memcpy(w, v.data(), sizeof(w));
+            indices.push_back(static_cast<Index32>(vertices.size() / 3));
+            vertices.insert(vertices.end(), w, w + 3);
+        }
+    }
+
+    Mesh mesh;
+    VertexDescription desc({ VertexAttribute(VertexAttributeSemantic::Position, VertexAttributeFormat::Float3, 0) });
+    desc.strideBytes = 3 * sizeof(VWord);
+    mesh.setVertexDescription(std::move(desc));
+    mesh.setVertices(static_cast<unsigned int>(indices.size()), std::move(vertices));
+    mesh.addGroup(PrimitiveGroupType::TriList, 0, std::move(indices));
+    return mesh;
+}
+
+// The triangles of the mesh, each rotated to start with its smallest
+// vertex so that the winding is kept
+std::vector<Triangle>
+getTriangles(const Mesh& mesh)
+{
+    std::vector<Triangle> triangles;
+    const VWord* vdata = mesh.getVertexData();
+    for (unsigned int g = 0; g < mesh.getGroupCount(); g++)
+    {
+        const auto& indices = mesh.getGroup(g)->indices;
+        for (std::size_t i = 0; i < indices.size(); i += 3)
+        {
+            Triangle tri;
+            for (std::size_t k = 0; k < 3; k++)
+                std::memcpy(tri[k].data(), vdata + indices[i + k] * 3, sizeof(float) * 3);
+            std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end()), tri.end());
+            triangles.push_back(tri);
+        }
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Mesh optimization", "[MeshOptimize]")
+{
+    constexpr int size = 30;
+
+    SECTION("Duplicate vertices are removed")
+    {
+        Mesh mesh = makeSoup(size, 1);
+        auto triangles = getTriangles(mesh);
+        unsigned int nVertices = mesh.getVertexCount();
+
+        unsigned int removed = RemoveDuplicateVertices(mesh);
+        REQUIRE(mesh.getVertexCount() == (size + 1) * (size + 1));
+        REQUIRE(removed == nVertices - mesh.getVertexCount());
+        REQUIRE(getTriangles(mesh) == triangles);
+        REQUIRE(RemoveDuplicateVertices(mesh) == 0);
+    }
+
+    SECTION("Optimized meshes keep their triangles and use the cache better")
+    {
+        Mesh mesh = makeSoup(size, 2);
+        auto triangles = getTriangles(mesh);
+        RemoveDuplicateVertices(mesh);
+        float acmrBefore = ComputeACMR(mesh);
+
+        OptimizeMesh(mesh);
+        REQUIRE(mesh.getVertexCount() == (size + 1) * (size + 1));
+        REQUIRE(mesh.getGroupCount() == 1);
+        REQUIRE(mesh.getIndexCount() == 6 * size * size);
+        REQUIRE(getTriangles(mesh) == triangles);
+
+        float acmrAfter = ComputeACMR(mesh);
+        REQUIRE(acmrBefore > 2.0f);
+        REQUIRE(acmrAfter < 0.8f);
+
+        // The vertices are stored in the order of their first use
+        const auto& indices = mesh.getGroup(0)->indices;
+        Index32 maxIndex = 0;
+        for (Index32 index : indices)
+        {
+            REQUIRE(index <= maxIndex + 1);
+            maxIndex = std::max(maxIndex, index);
+        }
+    }
+
+    SECTION("Groups with the same material are merged")
+    {
+        Mesh mesh = makeSoup(4, 3);
+        std::vector<Index32> second = mesh.getGroup(0)->indices;
+        mesh.addGroup(PrimitiveGroupType::TriList, 0, std::move(second));
+        auto triangles = getTriangles(mesh);
+
+        OptimizeMesh(mesh);
+        REQUIRE(mesh.getGroupCount() == 1);
+        REQUIRE(getTriangles(mesh) == triangles);
+    }
+}
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celmodel/mesh.h>
+#include <celmodel/meshquantize.h>
+
+using namespace cmod;
+
+namespace
+{
+
+// Points on a sphere of radius 3 around (10, -2, 5) with their normals and
+// texture coordinates
+Mesh
+makeSphere(int size)
+{
+    std::vector<VWord> vertices;
+    for (int i = 0; i <= size; i++)
+    {
+        for (int j = 0; j <= size; j++)
+        {
+            float u = static_cast<float>(j) / static_cast<float>(size);
+            float v = static_cast<float>(i) / static_cast<float>(size);
+            float theta = v * 3.14159265f;
+            float phi = u * 6.28318531f;
+            float n[3] = { std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta) };
+            float values[8] = { 10.0f + 3.0f * n[0], -2.0f + 3.0f * n[1], 5.0f + 3.0f * n[2],
+                                n[0], n[1], n[2], u, v };
+            VWord w[8];
+            std::memcpy(w, values, sizeof(values));
+            vertices.insert(vertices.end(), w, w + 8);
+        }
+    }
+
+    Mesh mesh;
+    VertexDescription desc({
+        VertexAttribute(VertexAttributeSemantic::Position, VertexAttributeFormat::Float3, 0),
+        VertexAttribute(VertexAttributeSemantic::Normal, VertexAttributeFormat::Float3, 3),
+        VertexAttribute(VertexAttributeSemantic::Texture0, VertexAttributeFormat::Float2, 6),
+    });
+    mesh.setVertexDescription(std::move(desc));
+    mesh.setVertices((size + 1) * (size + 1), std::move(vertices));
+
+    std::vector<Index32> indices;
+    for (Index32 i = 0; i + 2 < mesh.getVertexCount(); i++)
+        indices.insert(indices.end(), { i, i + 1, i + 2 });
+    mesh.addGroup(PrimitiveGroupType::TriList, 0, std::move(indices));
+    return mesh;
+}
+
+Eigen::Vector4f
+getAttribute(const Mesh& mesh, Index32 index, VertexAttributeSemantic semantic)
+{
+    const VertexDescription& desc = mesh.getVertexDescription();
+    const VertexAttribute& attr = desc.getAttribute(semantic);
+    const VWord* vertex = mesh.getVertexData() + index * (desc.strideBytes / sizeof(VWord));
+    return DecodeVertexAttribute(vertex + attr.offsetWords, attr.format);
+}
+
+} // end unnamed namespace
+
+
+TEST_CASE("Mesh quantization", "[MeshQuantize]")
+{
+    SECTION("Half floats round trip")
+    {
+        for (float f : { 0.0f, 1.0f, -2.5f, 0.333333f, 65504.0f, 1.0e-6f })
+            REQUIRE(HalfToFloat(FloatToHalf(f)) == Approx(f).epsilon(1.0e-3).margin(1.0e-7));
+        REQUIRE(std::isinf(HalfToFloat(FloatToHalf(1.0e6f))));
+    }
+
+    SECTION("Octahedral normals round trip")
+    {
+        for (int i = 0; i < 200; i++)
+        {
+            float theta = static_cast<float>(i) * 0.7f;
+            float z = static_cast<float>(i) / 100.0f - 1.0f;
+            float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+            Eigen::Vector4f n(r * std::cos(theta), r * std::sin(theta), z, 0.0f);
+
+            VWord encoded;
+            EncodeVertexAttribute(n, VertexAttributeFormat::Octahedral, &encoded);
+            Eigen::Vector4f decoded = DecodeVertexAttribute(&encoded, VertexAttributeFormat::Octahedral);
+            REQUIRE(decoded.head<3>().norm() == Approx(1.0f).margin(1.0e-5));
+            REQUIRE(decoded.head<3>().dot(n.head<3>()) > std::cos(1.0e-3f));
+        }
+    }
+
+    SECTION("Quantized meshes keep their shape")
+    {
+        Mesh original = makeSphere(16);
+        Mesh mesh = original.clone();
+        REQUIRE(QuantizeMesh(mesh));
+        REQUIRE(mesh.hasQuantizedPositions());
+
+        const VertexDescription& desc = mesh.getVertexDescription();
+        REQUIRE(desc.getAttribute(VertexAttributeSemantic::Position).format == VertexAttributeFormat::Short4);
+        REQUIRE(desc.getAttribute(VertexAttributeSemantic::Normal).format == VertexAttributeFormat::Octahedral);
+        REQUIRE(desc.getAttribute(VertexAttributeSemantic::Texture0).format == VertexAttributeFormat::Half2);
+        REQUIRE(desc.strideBytes == 4 * sizeof(VWord));
+
+        float tolerance = mesh.getPositionScale() / 32767.0f;
+        for (Index32 i = 0; i < mesh.getVertexCount(); i++)
+        {
+            REQUIRE((mesh.getVertexPosition(i) - original.getVertexPosition(i)).norm() <= 2.0f * tolerance);
+            Eigen::Vector4f n0 = getAttribute(original, i, VertexAttributeSemantic::Normal);
+            Eigen::Vector4f n1 = getAttribute(mesh, i, VertexAttributeSemantic::Normal);
+            REQUIRE(n0.head<3>().dot(n1.head<3>()) > 0.9999f);
+            Eigen::Vector4f t0 = getAttribute(original, i, VertexAttributeSemantic::Texture0);
+            Eigen::Vector4f t1 = getAttribute(mesh, i, VertexAttributeSemantic::Texture0);
+            REQUIRE((t0 - t1).cwiseAbs().maxCoeff() < 1.0e-3f);
+        }
+
+        Eigen::AlignedBox<float, 3> box = mesh.getBoundingBox();
+        REQUIRE(box.min().x() == Approx(7.0f).margin(1.0e-3));
+        REQUIRE(box.max().z() == Approx(8.0f).margin(1.0e-3));
+
+        REQUIRE(DequantizeMesh(mesh));
+        REQUIRE(!mesh.hasQuantizedPositions());
+        REQUIRE(mesh.getVertexDescription().getAttribute(VertexAttributeSemantic::Position).format ==
+                VertexAttributeFormat::Float3);
+        REQUIRE((mesh.getVertexPosition(5) - original.getVertexPosition(5)).norm() <= 2.0f * tolerance);
+    }
+
+    SECTION("Quantized meshes are transformed")
+    {
+        Mesh original = makeSphere(8);
+        Mesh mesh = original.clone();
+        QuantizeMesh(mesh);
+        original.transform(Eigen::Vector3f(-10.0f, 2.0f, -5.0f), 0.5f);
+        mesh.transform(Eigen::Vector3f(-10.0f, 2.0f, -5.0f), 0.5f);
+
+        REQUIRE(mesh.getBoundingBox().max().x() == Approx(1.5f).margin(1.0e-3));
+        for (Index32 i = 0; i < mesh.getVertexCount(); i++)
+            REQUIRE((mesh.getVertexPosition(i) - original.getVertexPosition(i)).norm() < 1.0e-3f);
+    }
+}
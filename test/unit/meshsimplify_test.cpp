@@ -0,0 +1,153 @@
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celmodel/mesh.h>
+#include <celmodel/meshsimplify.h>
+#include <celmodel/model.h>
+
+using namespace cmod;
+
+namespace
+{
+
+// A grid over the unit square with the given relief; the triangles of the
+// right half use the second material.
+Mesh
+makeGrid(int size, float relief)
+{
+    std::vector<VWord> vertices;
+    for (int y = 0; y <= size; y++)
+    {
+        for (int x = 0; x <= size; x++)
+        {
+            float fx = static_cast<float>(x) / static_cast<float>(size);
+            float fy = static_cast<float>(y) / static_cast<float>(size);
+            float v[3] = { fx, fy, relief * std::sin(fx * 3.0f) * std::cos(fy * 2.0f) };
+            VWord w[3];
+            std::memcpy(w, v, sizeof(v));
+            vertices.insert(vertices.end(), w, w + 3);
+        }
+    }
+
+    Mesh mesh;
+    VertexDescription desc({ VertexAttribute(VertexAttributeSemantic::Position, VertexAttributeFormat::Float3, 0) });
+    desc.strideBytes = 3 * sizeof(VWord);
+    mesh.setVertexDescription(std::move(desc));
+    mesh.setVertices((size + 1) * (size + 1), std::move(vertices));
+
+    auto index = [size](int x, int y) { return static_cast<Index32>(y * (size + 1) + x); };
+    std::vector<Index32> left;
+    std::vector<Index32> right;
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            auto& list = x < size / 2 ? left : right;
+            list.insert(list.end(), { index(x, y), index(x + 1, y), index(x, y + 1) });
+            list.insert(list.end(), { index(x + 1, y), index(x + 1, y + 1), index(x, y + 1) });
+        }
+    }
+    mesh.addGroup(PrimitiveGroupType::TriList, 0, std::move(left));
+    mesh.addGroup(PrimitiveGroupType::TriList, 1, std::move(right));
+    mesh.rebuildIndexMetadata();
+    return mesh;
+}
+
+// Area of the triangles, projected onto the xy plane and signed by their
+// winding
+double
+getProjectedArea(const Mesh& mesh)
+{
+    double area = 0.0;
+    const VWord* vdata = mesh.getVertexData();
+    for (unsigned int g = 0; g < mesh.getGroupCount(); g++)
+    {
+        const auto& indices = mesh.getGroup(g)->indices;
+        for (std::size_t i = 0; i < indices.size(); i += 3)
+        {
+            float p[3][3];
+            for (std::size_t k = 0; k < 3; k++)
+                std::memcpy(p[k], vdata + indices[i + k] * 3, sizeof(p[k]));
+            area += 0.5 * ((p[1][0] - p[0][0]) * (p[2][1] - p[0][1]) - (p[2][0] - p[0][0]) * (p[1][1] - p[0][1]));
+        }
+    }
+    return area;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Mesh simplification", "[MeshSimplify]")
+{
+    constexpr int size = 40;
+
+    SECTION("Flat meshes are reduced without error")
+    {
+        Mesh mesh = makeGrid(size, 0.0f);
+        float error = -1.0f;
+        Mesh simplified = SimplifyMesh(mesh, 0.1f, error);
+
+        REQUIRE(simplified.getPrimitiveCount() <= mesh.getPrimitiveCount() / 10);
+        REQUIRE(simplified.getPrimitiveCount() > 0);
+        REQUIRE(simplified.getIndexCount() == simplified.getPrimitiveCount() * 3);
+        REQUIRE(error < 1.0e-4f);
+        REQUIRE(getProjectedArea(simplified) == Approx(1.0));
+        REQUIRE(simplified.getBoundingBox().min().isApprox(mesh.getBoundingBox().min()));
+        REQUIRE(simplified.getBoundingBox().max().isApprox(mesh.getBoundingBox().max()));
+    }
+
+    SECTION("Materials are kept")
+    {
+        Mesh mesh = makeGrid(size, 0.0f);
+        float error;
+        Mesh simplified = SimplifyMesh(mesh, 0.1f, error);
+
+        REQUIRE(simplified.getGroupCount() == 2);
+        REQUIRE(simplified.getGroup(0)->materialIndex == 0);
+        REQUIRE(simplified.getGroup(1)->materialIndex == 1);
+
+        // No triangle crosses the border between the materials
+        const VWord* vdata = simplified.getVertexData();
+        for (unsigned int g = 0; g < 2; g++)
+        {
+            for (Index32 index : simplified.getGroup(g)->indices)
+            {
+                float x;
+                std::memcpy(&x, vdata + index * 3, sizeof(x));
+                if (g == 0)
+                    REQUIRE(x <= 0.5f);
+                else
+                    REQUIRE(x >= 0.5f);
+            }
+        }
+    }
+
+    SECTION("Curved meshes have a small error")
+    {
+        Mesh mesh = makeGrid(size, 0.2f);
+        float error = -1.0f;
+        Mesh simplified = SimplifyMesh(mesh, 0.25f, error);
+
+        REQUIRE(simplified.getPrimitiveCount() <= mesh.getPrimitiveCount() / 4);
+        REQUIRE(error > 0.0f);
+        REQUIRE(error < 0.05f);
+        REQUIRE(getProjectedArea(simplified) == Approx(1.0));
+    }
+
+    SECTION("Models keep their materials")
+    {
+        Model model;
+        model.addMaterial(Material());
+        model.addMaterial(Material());
+        model.addMesh(makeGrid(size, 0.2f));
+
+        float error;
+        auto simplified = SimplifyModel(model, 0.25f, error);
+        REQUIRE(simplified->getMaterialCount() == 2);
+        REQUIRE(simplified->getMeshCount() == 1);
+        REQUIRE(simplified->getPrimitiveCount() <= model.getPrimitiveCount() / 4);
+    }
+}
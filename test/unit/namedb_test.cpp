@@ -0,0 +1,139 @@
+#include <string>
+#include <vector>
+
+#include <celengine/name.h>
+
+#include <catch.hpp>
+
+TEST_CASE("NameDatabase", "[NameDatabase]")
+{
+    NameDatabase db;
+    db.add(1, "Sirius");
+    db.add(2, "Sirrah");
+    db.add(3, "Sir");
+    db.add(4, "Altair");
+    db.add(5, "ALF CMa");
+    db.add(6, "Siriüs B");
+
+    SECTION("Completion")
+    {
+        std::vector<std::string> completion;
+        db.getCompletion(completion, "sir", false);
+        REQUIRE(completion == std::vector<std::string>{ "Sir", "Sirius", "Sirrah", "Siriüs B" });
+    }
+
+    SECTION("Limited completion")
+    {
+        std::vector<std::string> completion;
+        db.getCompletion(completion, "SIR", false, 2);
+        REQUIRE(completion == std::vector<std::string>{ "Sir", "Sirius" });
+    }
+
+    SECTION("Completion ignores accents")
+    {
+        std::vector<std::string> completion;
+        db.getCompletion(completion, "siriu", false);
+        REQUIRE(completion == std::vector<std::string>{ "Sirius", "Siriüs B" });
+    }
+
+    SECTION("Completion of Greek letters")
+    {
+        std::vector<std::string> completion;
+        db.getCompletion(completion, "alpha", false);
+        REQUIRE(completion.size() == 1);
+        REQUIRE(db.getCatalogNumberByName(completion.front(), false) == 5);
+    }
+
+    SECTION("Names added after completion")
+    {
+        std::vector<std::string> completion;
+        db.getCompletion(completion, "alt", false);
+        REQUIRE(completion == std::vector<std::string>{ "Altair" });
+
+        db.add(7, "Altais");
+        completion.clear();
+        db.getCompletion(completion, "alt", false);
+        REQUIRE(completion == std::vector<std::string>{ "Altair", "Altais" });
+    }
+}
+
+TEST_CASE("NameDatabase lookup", "[NameDatabase]")
+{
+    NameDatabase db;
+    db.add(1, "Sirius");
+    db.add(1, "ALF CMa");
+    db.add(1, "9 CMa");
+    db.add(2, "Canopus");
+
+    const AstroCatalog::IndexNumber invalidIndex = AstroCatalog::InvalidIndex;
+
+    SECTION("Names")
+    {
+        REQUIRE(db.getNameCount() == 4);
+        REQUIRE(db.getCatalogNumberByName("sirius", false) == 1);
+        REQUIRE(db.getCatalogNumberByName("CANOPUS", false) == 2);
+        REQUIRE(db.getCatalogNumberByName("ALF CMa", false) == 1);
+        REQUIRE(db.getCatalogNumberByName("Vega", false) == invalidIndex);
+    }
+
+    SECTION("Numbers")
+    {
+        REQUIRE(db.getNameByCatalogNumber(1) == "Sirius");
+        REQUIRE(db.getNameByCatalogNumber(3).empty());
+
+        std::vector<std::string> names;
+        for (auto iter = db.getFirstNameIter(1); iter != db.getFinalNameIter(); ++iter)
+            names.emplace_back(*iter);
+        REQUIRE(names.size() == 3);
+        REQUIRE(names[0] == "Sirius");
+        REQUIRE(names[2] == "9 CMa");
+    }
+
+    SECTION("Generation")
+    {
+        std::uint32_t generation = db.getGeneration();
+        db.getNameByCatalogNumber(1);
+        REQUIRE(db.getGeneration() == generation);
+
+        db.add(4, "Rigel");
+        REQUIRE(db.getGeneration() != generation);
+        generation = db.getGeneration();
+
+        db.erase(4);
+        REQUIRE(db.getGeneration() != generation);
+        generation = db.getGeneration();
+
+        db.erase(5);
+        REQUIRE(db.getGeneration() == generation);
+    }
+
+    SECTION("Erase")
+    {
+        db.erase(1);
+        REQUIRE(db.getFirstNameIter(1) == db.getFinalNameIter());
+        REQUIRE(db.getCatalogNumberByName("Sirius", false) == 1);
+
+        db.add(1, "Sirius A");
+        REQUIRE(db.getNameByCatalogNumber(1) == "Sirius A");
+    }
+
+    SECTION("Renamed")
+    {
+        db.add(3, "SIRIUS");
+        REQUIRE(db.getNameCount() == 4);
+        REQUIRE(db.getCatalogNumberByName("Sirius", false) == 3);
+        REQUIRE(db.getNameByCatalogNumber(3) == "SIRIUS");
+    }
+
+    SECTION("Many names")
+    {
+        for (AstroCatalog::IndexNumber i = 10; i < 10010; ++i)
+            db.add(i * 1024, "HIP " + std::to_string(i));
+        for (AstroCatalog::IndexNumber i = 10; i < 10010; ++i)
+        {
+            REQUIRE(db.getCatalogNumberByName("hip " + std::to_string(i), false) == i * 1024);
+            REQUIRE(db.getNameByCatalogNumber(i * 1024) == "HIP " + std::to_string(i));
+        }
+        REQUIRE(db.getCatalogNumberByName("Canopus", false) == 2);
+    }
+}
@@ -0,0 +1,58 @@
+#include <cstdint>
+
+#include <catch.hpp>
+
+#include <celengine/image.h>
+
+using celestia::PixelFormat;
+
+TEST_CASE("Normal map computation", "[NormalMap]")
+{
+    SECTION("Flat height maps point straight up")
+    {
+        Image heightMap(PixelFormat::LUMINANCE, 64, 32);
+        for (int i = 0; i < 32; i++)
+        {
+            std::uint8_t* row = heightMap.getPixelRow(i);
+            for (int j = 0; j < 64; j++)
+                row[j] = 100;
+        }
+
+        auto normalMap = heightMap.computeNormalMap(1.0f, true, true);
+        REQUIRE(normalMap != nullptr);
+        REQUIRE(normalMap->getFormat() == PixelFormat::RGBA);
+        REQUIRE(normalMap->getMipLevelCount() == 7);
+        for (int mip = 0; mip < normalMap->getMipLevelCount(); mip++)
+        {
+            const std::uint8_t* pixel = normalMap->getPixelRow(mip, 0);
+            REQUIRE(pixel[0] == 128);
+            REQUIRE(pixel[1] == 128);
+            REQUIRE(pixel[2] == 255);
+            REQUIRE(pixel[3] == 255);
+        }
+    }
+
+    SECTION("Slopes tilt the normals")
+    {
+        Image heightMap(PixelFormat::LUMINANCE, 16, 16);
+        for (int i = 0; i < 16; i++)
+        {
+            std::uint8_t* row = heightMap.getPixelRow(i);
+            for (int j = 0; j < 16; j++)
+                row[j] = static_cast<std::uint8_t>(j * 8);
+        }
+
+        auto normalMap = heightMap.computeNormalMap(255.0f / 8.0f, false);
+        REQUIRE(normalMap->getMipLevelCount() == 1);
+
+        // Height rises by 8 per column, so dx = -1 at scale 255/8
+        const std::uint8_t* pixel = normalMap->getPixelRow(5) + 5 * 4;
+        REQUIRE(pixel[0] == 38);
+        REQUIRE(pixel[1] == 128);
+        REQUIRE(pixel[2] == 217);
+
+        // The first column takes the slope of the second when not wrapping
+        const std::uint8_t* first = normalMap->getPixelRow(5);
+        REQUIRE(first[0] == 38);
+    }
+}
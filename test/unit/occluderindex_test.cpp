@@ -0,0 +1,88 @@
+#include <cstdint>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celengine/occluderindex.h>
+
+namespace
+{
+
+const Body*
+fakeBody(std::size_t i)
+{
+    // The lists only use the pointers to identify the bodies
+    return reinterpret_cast<const Body*>(static_cast<std::uintptr_t>((i + 1) * 64));
+}
+
+const PlanetarySystem*
+fakeSystem(std::size_t i)
+{
+    return reinterpret_cast<const PlanetarySystem*>(static_cast<std::uintptr_t>((i + 1) * 64));
+}
+
+std::vector<const Body*>
+getCandidates(const OccluderList& list,
+              const Eigen::Vector3d& position,
+              double radius,
+              double minRadius,
+              float lightRadius)
+{
+    std::vector<const Body*> bodies;
+    list.forEachCandidate(position, radius, minRadius, lightRadius,
+                          [&](const OccluderList::Occluder& occluder) { bodies.push_back(occluder.body); });
+    return bodies;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Occluder lists", "[OccluderIndex]")
+{
+    OccluderList list;
+    list.add(fakeBody(0), Eigen::Vector3d(1.0e4, 0.0, 0.0), 10.0, false);
+    list.add(fakeBody(1), Eigen::Vector3d(2.0e5, 0.0, 0.0), 1000.0, false);
+    list.add(fakeBody(2), Eigen::Vector3d(1.0e8, 0.0, 0.0), 100.0, true);
+    list.add(fakeBody(3), Eigen::Vector3d(1.0e8, 0.0, 0.0), 100.0, false);
+    list.finish();
+
+    SECTION("Candidates are the largest first")
+    {
+        auto bodies = getCandidates(list, Eigen::Vector3d::Zero(), 1.0, 0.0, 0.0f);
+        REQUIRE(bodies == std::vector<const Body*>{ fakeBody(1), fakeBody(2), fakeBody(3), fakeBody(0) });
+    }
+
+    SECTION("Casters too small relative to the receiver are left out")
+    {
+        auto bodies = getCandidates(list, Eigen::Vector3d::Zero(), 1.0, 50.0, 0.0f);
+        REQUIRE(bodies == std::vector<const Body*>{ fakeBody(1), fakeBody(2), fakeBody(3) });
+    }
+
+    SECTION("Casters too far for a deep enough shadow are left out")
+    {
+        // The sun seen from the Earth; a caster of radius r has a visible
+        // shadow up to about 3400 r away
+        auto bodies = getCandidates(list, Eigen::Vector3d::Zero(), 1.0, 0.0, 0.00465f);
+        REQUIRE(bodies == std::vector<const Body*>{ fakeBody(1), fakeBody(2), fakeBody(0) });
+    }
+}
+
+TEST_CASE("Occluder index", "[OccluderIndex]")
+{
+    OccluderIndex index;
+    REQUIRE(index.find(fakeSystem(0), 2451545.0) == nullptr);
+
+    OccluderList& list = index.insert(fakeSystem(0), 2451545.0);
+    list.add(fakeBody(0), Eigen::Vector3d::Zero(), 1.0, false);
+    list.finish();
+
+    const OccluderList* found = index.find(fakeSystem(0), 2451545.0);
+    REQUIRE(found == &list);
+    REQUIRE(found->size() == 1);
+    REQUIRE(index.find(fakeSystem(0), 2451546.0) == nullptr);
+    REQUIRE(index.find(fakeSystem(1), 2451545.0) == nullptr);
+
+    REQUIRE(index.insert(fakeSystem(0), 2451546.0).empty());
+
+    index.invalidate();
+    REQUIRE(index.find(fakeSystem(0), 2451546.0) == nullptr);
+}
@@ -0,0 +1,66 @@
+#include <algorithm>
+#include <cmath>
+
+#include <catch.hpp>
+
+#include <celcompat/numbers.h>
+#include <celephem/orbit.h>
+
+#include "orbitsamplecollector.h"
+
+using celestia::ephem::EllipticalOrbit;
+
+namespace
+{
+
+constexpr double AU = 1.495978707e8;
+constexpr double Period = 365.25;
+
+} // end unnamed namespace
+
+TEST_CASE("Adaptive orbit sampling", "[orbit]")
+{
+    SECTION("Circular orbit")
+    {
+        EllipticalOrbit orbit(AU, 0.0, 0.1, 0.2, 0.3, 0.0, Period);
+        SampleCollector collector;
+        orbit.sample(0.0, Period, collector);
+
+        REQUIRE(collector.samples.size() >= 16);
+        REQUIRE(collector.samples.size() <= 48);
+        REQUIRE(collector.samples.front().t == 0.0);
+        REQUIRE(collector.samples.back().t == Approx(Period));
+    }
+
+    SECTION("Eccentric orbit")
+    {
+        // Starting at the apocenter, so the pericenter is passed halfway
+        EllipticalOrbit orbit(AU, 0.95, 0.1, 0.2, 0.3, celestia::numbers::pi, Period * 20.0);
+        SampleCollector collector;
+        orbit.sample(0.0, Period * 20.0, collector);
+
+        const auto& samples = collector.samples;
+        REQUIRE(samples.size() > 16);
+        REQUIRE(samples.size() < 1000);
+
+        // Samples are much denser around the pericenter than elsewhere
+        auto closest = std::min_element(samples.begin(), samples.end(),
+                                        [](const OrbitSample& s0, const OrbitSample& s1)
+                                        { return s0.position.norm() < s1.position.norm(); });
+        REQUIRE(closest != samples.begin());
+        REQUIRE(closest + 1 != samples.end());
+        double pericenterStep = (closest + 1)->t - closest->t;
+        double longestStep = 0.0;
+        for (std::size_t i = 1; i < samples.size(); ++i)
+            longestStep = std::max(longestStep, samples[i].t - samples[i - 1].t);
+        REQUIRE(pericenterStep * 100.0 < longestStep);
+
+        // The direction of motion doesn't turn by more than 10 degrees per step
+        for (std::size_t i = 1; i + 1 < samples.size(); ++i)
+        {
+            Eigen::Vector3d d0 = samples[i].position - samples[i - 1].position;
+            Eigen::Vector3d d1 = samples[i + 1].position - samples[i].position;
+            REQUIRE(d0.dot(d1) > std::cos(0.4) * d0.norm() * d1.norm());
+        }
+    }
+}
@@ -0,0 +1,98 @@
+#include <catch.hpp>
+
+#include <celengine/qualitygovernor.h>
+
+namespace
+{
+
+constexpr double Budget = 0.02;
+
+void
+feed(QualityGovernor& governor, int frames, double frameTime, bool moving = true)
+{
+    for (int i = 0; i < frames; ++i)
+        governor.update(frameTime, -1.0, moving);
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Quality governor", "[QualityGovernor]")
+{
+    QualityGovernor governor(Budget);
+    REQUIRE(governor.level() == 0);
+
+    SECTION("The level goes up after several slow frames")
+    {
+        feed(governor, QualityGovernor::DegradeFrames - 1, Budget * 2.0);
+        REQUIRE(governor.level() == 0);
+        REQUIRE(governor.update(Budget * 2.0, -1.0, true));
+        REQUIRE(governor.level() == 1);
+
+        feed(governor, QualityGovernor::DegradeFrames * 10, Budget * 2.0);
+        REQUIRE(governor.level() == QualityGovernor::MaxLevel);
+    }
+
+    SECTION("The slower of the CPU and GPU counts")
+    {
+        for (int i = 0; i < QualityGovernor::DegradeFrames; ++i)
+            governor.update(Budget * 0.1, Budget * 2.0, true);
+        REQUIRE(governor.level() == 1);
+    }
+
+    SECTION("A fast frame resets the count of slow ones")
+    {
+        feed(governor, QualityGovernor::DegradeFrames - 1, Budget * 2.0);
+        feed(governor, 1, Budget * 0.8);
+        feed(governor, QualityGovernor::DegradeFrames - 1, Budget * 2.0);
+        REQUIRE(governor.level() == 0);
+    }
+
+    SECTION("The level comes down after many fast frames")
+    {
+        feed(governor, QualityGovernor::DegradeFrames * 2, Budget * 2.0);
+        REQUIRE(governor.level() == 2);
+
+        // Frames just within the budget keep the level
+        feed(governor, QualityGovernor::RecoverFrames * 2, Budget * 0.9);
+        REQUIRE(governor.level() == 2);
+
+        feed(governor, QualityGovernor::RecoverFrames, Budget * 0.1);
+        REQUIRE(governor.level() == 1);
+    }
+
+    SECTION("A still camera restores full quality")
+    {
+        feed(governor, QualityGovernor::DegradeFrames * 3, Budget * 2.0);
+        REQUIRE(governor.level() == 3);
+
+        feed(governor, QualityGovernor::StillFrames - 1, Budget * 2.0, false);
+        REQUIRE(governor.level() == 3);
+        feed(governor, 1, Budget * 2.0, false);
+        REQUIRE(governor.level() == 0);
+
+        // and keeps it, however long the frames take
+        feed(governor, QualityGovernor::DegradeFrames * 3, Budget * 2.0, false);
+        REQUIRE(governor.level() == 0);
+
+        // until it moves again
+        feed(governor, QualityGovernor::DegradeFrames, Budget * 2.0);
+        REQUIRE(governor.level() == 1);
+    }
+
+    SECTION("Settings of the levels")
+    {
+        REQUIRE(governor.starMagnitudeOffset() == 0.0f);
+        REQUIRE(governor.orbitSubdivisionScale() == 1.0f);
+        REQUIRE(governor.galaxyDetail() == 1.0f);
+        REQUIRE(governor.sphereLODBias() == 0);
+        REQUIRE(governor.shadowMapSize(2048) == 2048);
+
+        feed(governor, QualityGovernor::DegradeFrames * QualityGovernor::MaxLevel, Budget * 2.0);
+        REQUIRE(governor.level() == QualityGovernor::MaxLevel);
+        REQUIRE(governor.starMagnitudeOffset() > 0.0f);
+        REQUIRE(governor.orbitSubdivisionScale() > 1.0f);
+        REQUIRE(governor.galaxyDetail() < 1.0f);
+        REQUIRE(governor.sphereLODBias() < 0);
+        REQUIRE(governor.shadowMapSize(2048) < 2048);
+    }
+}
@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <celutil/radixsort.h>
+
+#include <catch.hpp>
+
+using celestia::util::FloatSortKey;
+using celestia::util::KeySorter;
+using celestia::util::RadixSort;
+using celestia::util::SortKey;
+
+TEST_CASE("RadixSort", "[RadixSort]")
+{
+    SECTION("Float keys order as the floats do")
+    {
+        std::vector<float> values = { -std::numeric_limits<float>::infinity(), -1.0e30f, -2.5f, -1.0f,
+                                      -1.0e-30f, -0.0f, 0.0f, 1.0e-30f, 1.0f, 2.5f, 1.0e30f,
+                                      std::numeric_limits<float>::infinity() };
+        for (std::size_t i = 1; i < values.size(); i++)
+            REQUIRE(FloatSortKey(values[i - 1]) < FloatSortKey(values[i]));
+    }
+
+    SECTION("Keys are sorted stably")
+    {
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<std::uint32_t> dist(0, 1000);
+        std::vector<SortKey> keys;
+        for (std::uint32_t i = 0; i < 5000; i++)
+            keys.push_back({ dist(rng) * 65537u, i });
+
+        std::vector<SortKey> expected = keys;
+        std::stable_sort(expected.begin(), expected.end(),
+                         [](const SortKey& a, const SortKey& b) { return a.key < b.key; });
+
+        std::vector<SortKey> scratch;
+        RadixSort(keys, scratch);
+        REQUIRE(keys.size() == expected.size());
+        for (std::size_t i = 0; i < keys.size(); i++)
+        {
+            REQUIRE(keys[i].key == expected[i].key);
+            REQUIRE(keys[i].index == expected[i].index);
+        }
+    }
+
+    SECTION("Records are reordered by their keys")
+    {
+        struct Record
+        {
+            float depth;
+            std::string name;
+        };
+
+        std::vector<Record> records = { { -3.0f, "c" }, { 2.0f, "b" }, { -3.0f, "d" }, { 5.0f, "a" } };
+        KeySorter<Record> sorter;
+        sorter.sort(records, [](const Record& r) { return FloatSortKey(-r.depth); });
+        REQUIRE(records.size() == 4);
+        REQUIRE(records[0].name == "a");
+        REQUIRE(records[1].name == "b");
+        REQUIRE(records[2].name == "c");
+        REQUIRE(records[3].name == "d");
+
+        // The sorter is reusable
+        records.push_back({ 10.0f, "e" });
+        sorter.sort(records, [](const Record& r) { return FloatSortKey(-r.depth); });
+        REQUIRE(records[0].name == "e");
+        REQUIRE(records[4].name == "d");
+    }
+}
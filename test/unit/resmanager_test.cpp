@@ -0,0 +1,147 @@
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <catch.hpp>
+
+#include <celutil/resmanager.h>
+
+namespace
+{
+
+// Loads the number in the file name, failing for negative numbers
+class NumberInfo
+{
+ public:
+    using ResourceType = int;
+    using ResourceKey = fs::path;
+
+    explicit NumberInfo(int _number) : number(_number) {}
+
+    fs::path resolve(const fs::path& baseDir) const { return baseDir / std::to_string(number); }
+
+    std::unique_ptr<int> load(const fs::path& name) const
+    {
+        int value = std::stoi(name.filename().string());
+        return value < 0 ? nullptr : std::make_unique<int>(value);
+    }
+
+    std::function<std::unique_ptr<int>()> decode(const fs::path& name) const
+    {
+        int value = std::stoi(name.filename().string());
+        if (value < 0)
+            return {};
+        return [value]() { return std::make_unique<int>(value); };
+    }
+
+    bool operator<(const NumberInfo& other) const { return number < other.number; }
+
+ private:
+    int number;
+};
+
+// Finish the loads until handle h has been loaded or has failed
+void
+waitForResource(ResourceManager<NumberInfo>& manager, ResourceHandle h)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (manager.getState(h) == ResourceState::Loading && std::chrono::steady_clock::now() < deadline)
+    {
+        manager.finishLoading(std::chrono::milliseconds(1));
+        std::this_thread::yield();
+    }
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Resource manager", "[ResourceManager]")
+{
+    ResourceManager<NumberInfo> manager("numbers");
+    ResourceHandle h1 = manager.getHandle(NumberInfo(1));
+    ResourceHandle h2 = manager.getHandle(NumberInfo(2));
+    ResourceHandle hFail = manager.getHandle(NumberInfo(-1));
+    REQUIRE(manager.getHandle(NumberInfo(1)) == h1);
+
+    SECTION("Resources load synchronously by default")
+    {
+        int* value = manager.find(h1);
+        REQUIRE(value != nullptr);
+        REQUIRE(*value == 1);
+        REQUIRE(manager.getState(h1) == ResourceState::Loaded);
+        REQUIRE(manager.find(hFail) == nullptr);
+        REQUIRE(manager.getState(hFail) == ResourceState::LoadingFailed);
+        REQUIRE(manager.getState(h2) == ResourceState::NotLoaded);
+    }
+
+    SECTION("Asynchronous loads complete in finishLoading")
+    {
+        manager.enableAsyncLoading(2);
+        REQUIRE(manager.find(h1, 1.0f) == nullptr);
+        REQUIRE(manager.find(hFail, 2.0f) == nullptr);
+        REQUIRE(manager.getState(h1) == ResourceState::Loading);
+
+        waitForResource(manager, h1);
+        waitForResource(manager, hFail);
+        REQUIRE(manager.getState(h1) == ResourceState::Loaded);
+        REQUIRE(*manager.find(h1) == 1);
+        REQUIRE(manager.getState(hFail) == ResourceState::LoadingFailed);
+        REQUIRE(manager.find(hFail) == nullptr);
+    }
+
+    SECTION("Forcing synchronous loads completes pending resources")
+    {
+        manager.enableAsyncLoading(1);
+        REQUIRE(manager.find(h2) == nullptr);
+
+        manager.setForceSynchronous(true);
+        int* value = manager.find(h2);
+        REQUIRE(value != nullptr);
+        REQUIRE(*value == 2);
+
+        // The result of the background load is dropped
+        manager.setForceSynchronous(false);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+        while (std::chrono::steady_clock::now() < deadline)
+            manager.finishLoading(std::chrono::milliseconds(1));
+        REQUIRE(manager.find(h2) == value);
+    }
+
+    SECTION("Idle resources are evicted least recently used first")
+    {
+        auto sizeOf = [](const int& value) { return static_cast<std::size_t>(value); };
+        auto rank = [](const NumberInfo&) { return 0; };
+
+        REQUIRE(manager.find(h1) != nullptr);
+        manager.advanceUsage();
+        REQUIRE(manager.find(h2) != nullptr);
+        manager.advanceUsage();
+
+        // Neither was left unused for long enough
+        REQUIRE(manager.evict(3, 2, 5, sizeOf, rank) == 0);
+        REQUIRE(manager.evict(3, 3, 1, sizeOf, rank) == 0);
+
+        REQUIRE(manager.evict(3, 2, 1, sizeOf, rank) == 1);
+        REQUIRE(manager.getState(h1) == ResourceState::NotLoaded);
+        REQUIRE(manager.getState(h2) == ResourceState::Loaded);
+
+        // Evicted resources load again when found
+        int* value = manager.find(h1);
+        REQUIRE(value != nullptr);
+        REQUIRE(*value == 1);
+    }
+
+    SECTION("The size of the loaded resources is summed")
+    {
+        auto sizeOf = [](const int& value) { return static_cast<std::size_t>(value) * 100; };
+        REQUIRE(manager.getLoadedSize(sizeOf) == std::pair<std::size_t, std::size_t>(0, 0));
+
+        REQUIRE(manager.find(h1) != nullptr);
+        REQUIRE(manager.find(h2) != nullptr);
+        REQUIRE(manager.find(hFail) == nullptr);
+        REQUIRE(manager.getLoadedSize(sizeOf) == std::pair<std::size_t, std::size_t>(2, 300));
+    }
+}
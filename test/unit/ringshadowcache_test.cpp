@@ -0,0 +1,106 @@
+#include <cmath>
+
+#include <Eigen/Geometry>
+
+#include <catch.hpp>
+
+#include <celengine/ringshadowcache.h>
+
+namespace
+{
+
+// A light at an elevation above the ring plane, turned around the polar
+// axis from the direction of -x
+Eigen::Vector3f
+lightDirection(float elevation, float azimuth)
+{
+    Eigen::Vector3f light(-std::cos(elevation), std::sin(elevation), 0.0f);
+    return Eigen::AngleAxisf(azimuth, Eigen::Vector3f::UnitY()) * light;
+}
+
+RingShadowCache::Key
+makeKey(float elevation)
+{
+    return { std::sin(elevation), 0.005f, 2.3f, 0.1f };
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Sunlit fraction of the sun disc", "[RingShadowCache]")
+{
+    Eigen::Vector3f light = lightDirection(0.2f, 0.0f);
+
+    REQUIRE(RingShadowCache::sunlitFraction(Eigen::Vector3f(2.0f, 0.0f, 0.0f), light, 0.01f, 0.0f) == 0.0f);
+    REQUIRE(RingShadowCache::sunlitFraction(Eigen::Vector3f(-2.0f, 0.0f, 0.0f), light, 0.01f, 0.0f) == 1.0f);
+    REQUIRE(RingShadowCache::sunlitFraction(Eigen::Vector3f(0.0f, 0.0f, 2.0f), light, 0.01f, 0.0f) == 1.0f);
+
+    // With the sun on the limb of the planet about half of it is hidden
+    Eigen::Vector3f limb = Eigen::Vector3f(2.0f, 0.0f, 0.0f).normalized();
+    Eigen::Vector3f grazing = Eigen::AngleAxisf(std::asin(0.5f), Eigen::Vector3f::UnitY()) * -limb;
+    REQUIRE(RingShadowCache::sunlitFraction(Eigen::Vector3f(2.0f, 0.0f, 0.0f), grazing, 0.01f, 0.0f) == Approx(0.5f).margin(0.02f));
+}
+
+TEST_CASE("Ring shadow texture reuse", "[RingShadowCache]")
+{
+    RingShadowCache cache(64);
+    REQUIRE_FALSE(cache.canReuse(makeKey(0.3f)));
+
+    cache.bake(makeKey(0.3f));
+    REQUIRE(cache.pixels().size() == 64 * 64);
+    REQUIRE(cache.canReuse(makeKey(0.3f)));
+    REQUIRE(cache.canReuse(makeKey(0.3001f)));
+    REQUIRE_FALSE(cache.canReuse(makeKey(0.35f)));
+
+    RingShadowCache::Key larger = makeKey(0.3f);
+    larger.outerRadius = 2.5f;
+    REQUIRE_FALSE(cache.canReuse(larger));
+}
+
+TEST_CASE("Ring shadow texture coordinates", "[RingShadowCache]")
+{
+    constexpr unsigned int size = 128;
+    RingShadowCache::Key key = makeKey(0.3f);
+    RingShadowCache cache(size);
+    cache.bake(key);
+
+    // The texture doesn't depend on the rotation of the planet
+    float azimuth = GENERATE(0.0f, 1.0f, 2.5f, -2.0f);
+    Eigen::Vector3f light = lightDirection(0.3f, azimuth);
+    Eigen::Vector4f texGenS;
+    Eigen::Vector4f texGenT;
+    RingShadowCache::texGen(light, key.outerRadius, texGenS, texGenT);
+
+    int shadowed = 0;
+    for (float radius : { 1.5f, 1.9f, 2.2f })
+    {
+        for (float angle = 0.0f; angle < 6.28f; angle += 0.05f)
+        {
+            Eigen::Vector4f position(radius * std::cos(angle), 0.0f, radius * std::sin(angle), 1.0f);
+            float s = position.dot(texGenS);
+            float t = position.dot(texGenT);
+            float expected = RingShadowCache::sunlitFraction(position.head(3), light, key.sunRadius, key.oblateness);
+
+            auto i = static_cast<unsigned int>(std::clamp(s, 0.0f, 1.0f - 1.0e-6f) * size);
+            auto j = static_cast<unsigned int>(std::clamp(t, 0.0f, 1.0f - 1.0e-6f) * size);
+            float baked = static_cast<float>(cache.pixels()[j * size + i]) / 255.0f;
+
+            // Away from the edge of the shadow the nearest texel matches
+            bool nearEdge = false;
+            for (const Eigen::Vector3f& offset : { Eigen::Vector3f(0.04f, 0.0f, 0.0f), Eigen::Vector3f(-0.04f, 0.0f, 0.0f),
+                                                   Eigen::Vector3f(0.0f, 0.0f, 0.04f), Eigen::Vector3f(0.0f, 0.0f, -0.04f) })
+            {
+                Eigen::Vector3f neighbor = position.head(3) + offset;
+                if (RingShadowCache::sunlitFraction(neighbor, light, key.sunRadius, key.oblateness) != expected)
+                    nearEdge = true;
+            }
+            if (!nearEdge)
+            {
+                REQUIRE(baked == Approx(expected).margin(0.01f));
+                if (expected == 0.0f)
+                    shadowed++;
+            }
+        }
+    }
+
+    REQUIRE(shadowed > 0);
+}
@@ -0,0 +1,91 @@
+#include <cmath>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celephem/customrotation.h>
+#include <celephem/rotation.h>
+
+using namespace celestia::ephem;
+
+namespace
+{
+
+constexpr double J2000 = 2451545.0;
+
+// A rotation counting its evaluations
+class CountingRotationModel : public CachingRotationModel
+{
+ public:
+    Eigen::Quaterniond computeSpin(double tjd) const override
+    {
+        ++spinEvaluations;
+        return Eigen::Quaterniond(Eigen::AngleAxisd(tjd, Eigen::Vector3d::UnitY()));
+    }
+
+    Eigen::Quaterniond computeEquatorOrientation(double) const override
+    {
+        ++equatorEvaluations;
+        return Eigen::Quaterniond::Identity();
+    }
+
+    double getPeriod() const override { return 1.0; }
+    bool isPeriodic() const override { return true; }
+
+    mutable int spinEvaluations{ 0 };
+    mutable int equatorEvaluations{ 0 };
+};
+
+double
+angleBetween(const Eigen::Quaterniond& a, const Eigen::Quaterniond& b)
+{
+    return a.angularDistance(b);
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Rotation models", "[RotationModel]")
+{
+    SECTION("Caching models keep recent times")
+    {
+        CountingRotationModel model;
+        for (int i = 0; i < 10; i++)
+        {
+            model.orientationAtTime(J2000);
+            model.orientationAtTime(J2000 + 0.001);
+            model.orientationAtTime(J2000 + 0.002);
+        }
+        REQUIRE(model.spinEvaluations == 3);
+        REQUIRE(model.equatorEvaluations == 3);
+
+        for (int i = 0; i < 5; i++)
+            model.spin(J2000 + 1.0 + i);
+        REQUIRE(model.spinEvaluations == 8);
+        REQUIRE(model.isThreadSafe());
+    }
+
+    SECTION("Tabulated IAU models match the series")
+    {
+        // The lunar model has periodic terms, so its angles are tabulated
+        // once a window of time is in steady use; the first evaluations in
+        // a window are from the series.
+        const RotationModel* moon = GetCustomRotationModel("iau-moon");
+        REQUIRE(moon != nullptr);
+
+        std::vector<double> times;
+        std::vector<Eigen::Quaterniond> exact;
+        for (int i = 0; i < 12; i++)
+        {
+            double t = J2000 + 1000.0 + i * 1.37;
+            times.push_back(t);
+            exact.push_back(moon->orientationAtTime(t));
+        }
+
+        // Fill the table, then look up the first times again
+        for (int i = 0; i < 40; i++)
+            moon->orientationAtTime(J2000 + 1000.0 + i * 0.011);
+
+        for (std::size_t i = 0; i < times.size(); i++)
+            REQUIRE(angleBetween(moon->orientationAtTime(times[i]), exact[i]) < 1.0e-9);
+    }
+}
@@ -0,0 +1,404 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celcompat/filesystem.h>
+#include <celephem/orbit.h>
+#include <celephem/samporbit.h>
+#include <celephem/xyzvbinary.h>
+
+#include "orbitsamplecollector.h"
+
+using namespace celestia::ephem;
+
+namespace
+{
+
+// Samples bunched up in places, as in trajectories of spacecraft flybys
+std::vector<double>
+getSampleTimes()
+{
+    std::vector<double> times;
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> step(0.01, 1.0);
+    double t = 2451545.0;
+    for (int i = 0; i < 2000; i++)
+    {
+        times.push_back(t);
+        t += i % 500 < 100 ? step(rng) * 0.001 : step(rng);
+    }
+
+    return times;
+}
+
+Eigen::Vector3d
+getPosition(double t)
+{
+    return Eigen::Vector3d(std::cos(t * 0.1), std::sin(t * 0.1), 0.01 * t) * 1000.0;
+}
+
+// Linear interpolation found by searching all samples, in Celestia's
+// coordinate system
+Eigen::Vector3d
+interpolate(const std::vector<double>& times, double t)
+{
+    Eigen::Vector3d p;
+    if (t <= times.front())
+    {
+        p = getPosition(times.front());
+    }
+    else if (t >= times.back())
+    {
+        p = getPosition(times.back());
+    }
+    else
+    {
+        std::size_t n = 1;
+        while (times[n] < t)
+            ++n;
+        double u = (t - times[n - 1]) / (times[n] - times[n - 1]);
+        p = getPosition(times[n - 1]) + u * (getPosition(times[n]) - getPosition(times[n - 1]));
+    }
+
+    return Eigen::Vector3d(p.x(), p.z(), -p.y());
+}
+
+Eigen::Vector3d
+getVelocity(double t)
+{
+    return Eigen::Vector3d(-std::sin(t * 0.1), std::cos(t * 0.1), 0.1) * 100.0 / 86400.0;
+}
+
+template<typename T> void
+append(std::string& data, const T& value)
+{
+    data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Binary xyzv file, with an index block if bucketsPerRecord isn't zero
+std::string
+getBinaryFile(const std::vector<double>& times, double bucketsPerRecord)
+{
+    using celestia::ephem::XYZV_INDEX_MAGIC;
+    using celestia::ephem::XYZV_MAGIC;
+
+    std::string data(XYZV_MAGIC);
+    append(data, static_cast<std::uint16_t>(__BYTE_ORDER__));
+    append(data, static_cast<std::uint16_t>(std::numeric_limits<double>::digits));
+    append(data, std::uint32_t(0));
+    append(data, static_cast<std::uint64_t>(times.size()));
+    for (double t : times)
+    {
+        Eigen::Vector3d p = getPosition(t);
+        Eigen::Vector3d v = getVelocity(t);
+        for (double value : { t, p.x(), p.y(), p.z(), v.x(), v.y(), v.z() })
+            append(data, value);
+    }
+
+    if (bucketsPerRecord == 0.0)
+        return data;
+
+    auto count = static_cast<std::uint64_t>(times.size() * bucketsPerRecord);
+    double bucketsPerDay = static_cast<double>(count) / (times.back() - times.front());
+    data.append(XYZV_INDEX_MAGIC);
+    append(data, count);
+    append(data, times.front());
+    append(data, bucketsPerDay);
+    append(data, getPosition(times.back()).norm());
+    std::uint64_t i = 0;
+    for (std::uint64_t b = 0; b < count; b++)
+    {
+        while (i < times.size() &&
+               std::min(static_cast<std::uint64_t>((times[i] - times.front()) * bucketsPerDay), count - 1) < b)
+            ++i;
+        append(data, i);
+    }
+    append(data, static_cast<std::uint64_t>(times.size()));
+
+    return data;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Sampled trajectories", "[SampledOrbit]")
+{
+    const std::vector<double> times = getSampleTimes();
+    const fs::path path = "samporbit_test.xyz";
+    {
+        std::ofstream out(path);
+        out.precision(17);
+        out << "# test trajectory\n";
+        for (double t : times)
+        {
+            Eigen::Vector3d p = getPosition(t);
+            out << t << ' ' << p.x() << ' ' << p.y() << ' ' << p.z() << '\n';
+        }
+    }
+
+    auto orbit = LoadSampledTrajectoryDoublePrec(path, TrajectoryInterpolation::Linear);
+    fs::remove(path);
+    REQUIRE(orbit != nullptr);
+
+    double begin = 0.0;
+    double end = 0.0;
+    orbit->getValidRange(begin, end);
+    REQUIRE(begin == times.front());
+    REQUIRE(end == times.back());
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> time(begin - 10.0, end + 10.0);
+    std::vector<double> lookups;
+    for (int i = 0; i < 5000; i++)
+        lookups.push_back(time(rng));
+    // Times of samples and next to them
+    for (std::size_t i = 0; i < times.size(); i += 37)
+    {
+        lookups.push_back(times[i]);
+        lookups.push_back(std::nextafter(times[i], 0.0));
+        lookups.push_back(std::nextafter(times[i], end + 1.0));
+    }
+
+    SECTION("Positions match the samples around the time")
+    {
+        for (double t : lookups)
+        {
+            Eigen::Vector3d expected = interpolate(times, t);
+            REQUIRE((orbit->positionAtTime(t) - expected).norm() < 1.0e-6);
+        }
+    }
+
+    SECTION("Batched evaluation matches single evaluation")
+    {
+        std::sort(lookups.begin(), lookups.end());
+        SampleCollector collector;
+        orbit->sampleAtTimes(lookups, collector);
+        REQUIRE(collector.samples.size() == lookups.size());
+        for (std::size_t i = 0; i < lookups.size(); i++)
+        {
+            const OrbitSample& sample = collector.samples[i];
+            REQUIRE(sample.t == lookups[i]);
+            REQUIRE(sample.position == orbit->positionAtTime(lookups[i]));
+            REQUIRE(sample.velocity == orbit->velocityAtTime(lookups[i]));
+        }
+    }
+}
+
+TEST_CASE("Binary xyzv trajectories", "[SampledOrbit]")
+{
+    const std::vector<double> times = getSampleTimes();
+    const fs::path textPath = "samporbit_test.xyzv";
+    {
+        std::ofstream out(textPath);
+        out.precision(17);
+        for (double t : times)
+        {
+            Eigen::Vector3d p = getPosition(t);
+            Eigen::Vector3d v = getVelocity(t);
+            out << t << ' ' << p.x() << ' ' << p.y() << ' ' << p.z() << ' '
+                << v.x() << ' ' << v.y() << ' ' << v.z() << '\n';
+        }
+    }
+
+    auto reference = LoadXYZVTrajectoryDoublePrec(textPath, TrajectoryInterpolation::Cubic);
+    fs::remove(textPath);
+    REQUIRE(reference != nullptr);
+
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> time(times.front() - 10.0, times.back() + 10.0);
+    std::vector<double> lookups;
+    for (int i = 0; i < 5000; i++)
+        lookups.push_back(time(rng));
+    for (std::size_t i = 0; i < times.size(); i += 37)
+        lookups.push_back(times[i]);
+    std::sort(lookups.begin(), lookups.end());
+
+    // Without an index, with one, and with one which doesn't fit the records
+    for (double bucketsPerRecord : { 0.0, 0.125, 3.0 })
+    {
+        std::string data = getBinaryFile(times, bucketsPerRecord);
+        if (bucketsPerRecord == 3.0)
+            std::memset(data.data() + data.size() - 8 * times.size(), 0x11, 8 * 100);
+
+        const fs::path path = "samporbit_test.xyzvbin";
+        {
+            std::ofstream out(path, std::ios::out | std::ios::binary);
+            out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        }
+
+        auto orbit = LoadXYZVBinaryDoublePrec(path, TrajectoryInterpolation::Cubic);
+        REQUIRE(orbit != nullptr);
+
+        double begin = 0.0;
+        double end = 0.0;
+        orbit->getValidRange(begin, end);
+        REQUIRE(begin == times.front());
+        REQUIRE(end == times.back());
+        REQUIRE(orbit->getBoundingRadius() == Approx(reference->getBoundingRadius()));
+
+        for (double t : lookups)
+        {
+            REQUIRE((orbit->positionAtTime(t) - reference->positionAtTime(t)).norm() < 1.0e-9);
+            REQUIRE((orbit->velocityAtTime(t) - reference->velocityAtTime(t)).norm() < 1.0e-9);
+        }
+
+        SampleCollector batch;
+        orbit->sampleAtTimes(lookups, batch);
+        REQUIRE(batch.samples.size() == lookups.size());
+        for (std::size_t i = 0; i < lookups.size(); i++)
+            REQUIRE((batch.samples[i].position - reference->positionAtTime(lookups[i])).norm() < 1.0e-9);
+
+        // Only the records in the range and next to it are sampled
+        SampleCollector collector;
+        orbit->sample(times[100] + 1.0e-6, times[200] - 1.0e-6, collector);
+        REQUIRE(collector.samples.size() == 101);
+        REQUIRE(collector.samples.front().t == times[100]);
+        REQUIRE(collector.samples.back().t == times[200]);
+
+        orbit.reset();
+        fs::remove(path);
+    }
+}
+
+TEST_CASE("Compressed xyzv trajectories", "[SampledOrbit]")
+{
+    using celestia::ephem::XYZV_COMPRESSED_MAGIC;
+
+    // Quanta which are powers of two, so that the knots are represented
+    // exactly by the text file as well
+    constexpr double TimeQuantum = 1.0 / 65536.0;
+    constexpr double PositionQuantum = 1.0 / 1024.0;
+    constexpr double VelocityQuantum = 1.0 / 1048576.0;
+    constexpr double StartTime = 2451545.0;
+
+    auto writeVarint = [](std::string& data, std::int64_t value)
+    {
+        auto bits = (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+        for (; bits >= 0x80; bits >>= 7)
+            data.push_back(static_cast<char>((bits & 0x7f) | 0x80));
+        data.push_back(static_cast<char>(bits));
+    };
+
+    std::string data(XYZV_COMPRESSED_MAGIC);
+    append(data, static_cast<std::uint16_t>(__BYTE_ORDER__));
+    append(data, static_cast<std::uint16_t>(std::numeric_limits<double>::digits));
+    append(data, std::uint32_t(0));
+    append(data, std::uint64_t(300));
+    for (double value : { StartTime, TimeQuantum, PositionQuantum, VelocityQuantum, 0.001 })
+        append(data, value);
+
+    const fs::path textPath = "samporbit_test.xyzv";
+    std::ofstream text(textPath);
+    text.precision(17);
+    std::array<std::int64_t, 7> previous{};
+    for (int i = 0; i < 300; i++)
+    {
+        double t = i * 0.7 + 0.1 * std::sin(i);
+        Eigen::Vector3d p = getPosition(StartTime + t);
+        Eigen::Vector3d v = getVelocity(StartTime + t);
+        std::array<std::int64_t, 7> values = {
+            std::llround(t / TimeQuantum),
+            std::llround(p.x() / PositionQuantum),
+            std::llround(p.y() / PositionQuantum),
+            std::llround(p.z() / PositionQuantum),
+            std::llround(v.x() / VelocityQuantum),
+            std::llround(v.y() / VelocityQuantum),
+            std::llround(v.z() / VelocityQuantum),
+        };
+        for (int j = 0; j < 7; j++)
+            writeVarint(data, values[j] - previous[j]);
+        previous = values;
+
+        text << StartTime + values[0] * TimeQuantum;
+        for (int j = 1; j < 4; j++)
+            text << ' ' << values[j] * PositionQuantum;
+        for (int j = 4; j < 7; j++)
+            text << ' ' << values[j] * VelocityQuantum;
+        text << '\n';
+    }
+    text.close();
+
+    auto reference = LoadXYZVTrajectoryDoublePrec(textPath, TrajectoryInterpolation::Cubic);
+    fs::remove(textPath);
+    REQUIRE(reference != nullptr);
+
+    const fs::path path = "samporbit_test.xyzvbin";
+    auto writeFile = [&](const std::string& contents)
+    {
+        std::ofstream out(path, std::ios::out | std::ios::binary);
+        out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    };
+
+    SECTION("Knots are interpolated with Hermite segments")
+    {
+        writeFile(data);
+        // The interpolation of the file always applies
+        auto orbit = LoadXYZVBinaryDoublePrec(path, TrajectoryInterpolation::Linear);
+        REQUIRE(orbit != nullptr);
+
+        double begin = 0.0;
+        double end = 0.0;
+        orbit->getValidRange(begin, end);
+        REQUIRE(begin == StartTime);
+
+        for (int i = 0; i < 3000; i++)
+        {
+            double t = begin + (end - begin) * i / 2999.0;
+            REQUIRE((orbit->positionAtTime(t) - reference->positionAtTime(t)).norm() < 1.0e-9);
+            REQUIRE((orbit->velocityAtTime(t) - reference->velocityAtTime(t)).norm() < 1.0e-9);
+        }
+    }
+
+    SECTION("Truncated files are rejected")
+    {
+        writeFile(data.substr(0, data.size() - 1));
+        REQUIRE(LoadXYZVBinaryDoublePrec(path, TrajectoryInterpolation::Cubic) == nullptr);
+    }
+
+    fs::remove(path);
+}
+
+TEST_CASE("Tabulated trajectories", "[SampledOrbit]")
+{
+    // An eccentric orbit of ten days
+    const EllipticalOrbit source(1.0e6, 0.5, 0.3, 0.2, 0.1, 0.0, 10.0);
+    constexpr double begin = 2451545.0;
+    constexpr double end = begin + 100.0;
+    constexpr double tolerance = 0.01;
+
+    auto orbit = TabulateOrbit(source, begin, end, tolerance);
+    REQUIRE(orbit != nullptr);
+
+    double validBegin = 0.0;
+    double validEnd = 0.0;
+    orbit->getValidRange(validBegin, validEnd);
+    REQUIRE(validBegin == begin);
+    REQUIRE(validEnd == end);
+
+    SECTION("Positions are within tolerance of the source")
+    {
+        std::mt19937 rng(11);
+        std::uniform_real_distribution<double> time(begin, end);
+        for (int i = 0; i < 5000; i++)
+        {
+            double t = time(rng);
+            // refinement checks the midpoints only
+            REQUIRE((orbit->positionAtTime(t) - source.positionAtTime(t)).norm() < tolerance * 10.0);
+        }
+    }
+
+    SECTION("Empty ranges aren't tabulated")
+    {
+        REQUIRE(TabulateOrbit(source, begin, begin, tolerance) == nullptr);
+        REQUIRE(TabulateOrbit(source, begin, end, 0.0) == nullptr);
+    }
+}
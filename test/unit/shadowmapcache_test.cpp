@@ -0,0 +1,116 @@
+#include <cmath>
+#include <cstdint>
+
+#include <Eigen/Geometry>
+
+#include <catch.hpp>
+
+#include <celengine/shadowmapcache.h>
+
+namespace
+{
+
+const void*
+fakeCaster(std::size_t i)
+{
+    // The cache only uses the pointers to identify the casters
+    return reinterpret_cast<const void*>(static_cast<std::uintptr_t>((i + 1) * 64));
+}
+
+ShadowMapCache::View
+makeView(const Eigen::Vector3f& lightDirection)
+{
+    return { lightDirection, Eigen::Vector2f::Zero(), 1.0f, 1024 };
+}
+
+// A direction turned from the z axis by an angle in radians
+Eigen::Vector3f
+turned(float angle)
+{
+    return Eigen::AngleAxisf(angle, Eigen::Vector3f::UnitX()) * Eigen::Vector3f::UnitZ();
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Shadow map reuse", "[ShadowMapCache]")
+{
+    ShadowMapCache::View cached = makeView(Eigen::Vector3f::UnitZ());
+
+    // Half a texel at the edge of the model is 1/1024 radians
+    REQUIRE(ShadowMapCache::canReuse(cached, makeView(turned(0.0005f))));
+    REQUIRE_FALSE(ShadowMapCache::canReuse(cached, makeView(turned(0.002f))));
+
+    ShadowMapCache::View larger = cached;
+    larger.size = 2048;
+    REQUIRE_FALSE(ShadowMapCache::canReuse(cached, larger));
+
+    ShadowMapCache::View moved = cached;
+    moved.center = Eigen::Vector2f(0.125f, 0.0f);
+    REQUIRE_FALSE(ShadowMapCache::canReuse(cached, moved));
+}
+
+TEST_CASE("Shadow map cascade centers", "[ShadowMapCache]")
+{
+    Eigen::Vector2f snapped = ShadowMapCache::snapCenter(Eigen::Vector2f(0.3f, -0.2f), 0.25f);
+    REQUIRE(snapped.x() == Approx(0.25f));
+    REQUIRE(snapped.y() == Approx(-0.25f));
+    REQUIRE(ShadowMapCache::snapCenter(Eigen::Vector2f(0.26f, -0.24f), 0.25f) == snapped);
+}
+
+TEST_CASE("Shadow map cache", "[ShadowMapCache]")
+{
+    ShadowMapCache cache(2);
+    ShadowMapCache::View view = makeView(Eigen::Vector3f::UnitZ());
+
+    ShadowMapCache::Slot first = cache.find(fakeCaster(0), 0, 0, view, false, 1);
+    REQUIRE(first.needsRender);
+
+    SECTION("Maps are reused while the light doesn't move")
+    {
+        ShadowMapCache::Slot again = cache.find(fakeCaster(0), 0, 0, view, false, 2);
+        REQUIRE_FALSE(again.needsRender);
+        REQUIRE(again.index == first.index);
+    }
+
+    SECTION("Maps of animated casters are always rendered")
+    {
+        ShadowMapCache::Slot again = cache.find(fakeCaster(0), 0, 0, view, true, 2);
+        REQUIRE(again.needsRender);
+        REQUIRE(again.index == first.index);
+    }
+
+    SECTION("A caster whose light moved renders into its old map")
+    {
+        ShadowMapCache::Slot moved = cache.find(fakeCaster(0), 0, 0, makeView(turned(0.1f)), false, 2);
+        REQUIRE(moved.needsRender);
+        REQUIRE(moved.index == first.index);
+    }
+
+    SECTION("Objects sharing a caster in a frame get maps of their own")
+    {
+        ShadowMapCache::Slot other = cache.find(fakeCaster(0), 0, 0, makeView(turned(0.1f)), false, 1);
+        REQUIRE(other.needsRender);
+        REQUIRE(other.index != first.index);
+        REQUIRE_FALSE(cache.find(fakeCaster(0), 0, 0, view, false, 2).needsRender);
+        REQUIRE_FALSE(cache.find(fakeCaster(0), 0, 0, makeView(turned(0.1f)), false, 2).needsRender);
+    }
+
+    SECTION("The least recently used map is replaced")
+    {
+        ShadowMapCache::Slot second = cache.find(fakeCaster(1), 0, 0, view, false, 2);
+        REQUIRE(second.index != first.index);
+        REQUIRE_FALSE(cache.find(fakeCaster(1), 0, 0, view, false, 3).needsRender);
+
+        ShadowMapCache::Slot third = cache.find(fakeCaster(2), 0, 0, view, false, 3);
+        REQUIRE(third.needsRender);
+        REQUIRE(third.index == first.index);
+        REQUIRE_FALSE(cache.find(fakeCaster(1), 0, 0, view, false, 4).needsRender);
+        REQUIRE(cache.find(fakeCaster(0), 0, 0, view, false, 4).needsRender);
+    }
+
+    SECTION("Clearing renders all maps again")
+    {
+        cache.clear();
+        REQUIRE(cache.find(fakeCaster(0), 0, 0, view, false, 2).needsRender);
+    }
+}
@@ -0,0 +1,80 @@
+#include <cmath>
+
+#include <catch.hpp>
+
+#include <celengine/skyoccluders.h>
+
+namespace
+{
+
+bool
+hidesPoint(const SkyOccluders& occluders, const Eigen::Vector3f& offset)
+{
+    return occluders.hides(offset, offset.norm());
+}
+
+} // end unnamed namespace
+
+TEST_CASE("SkyOccluders", "[SkyOccluders]")
+{
+    SkyOccluders occluders;
+
+    SECTION("Empty list hides nothing")
+    {
+        REQUIRE(occluders.empty());
+        REQUIRE_FALSE(hidesPoint(occluders, Eigen::Vector3f(0.0f, 0.0f, -1.0e6f)));
+        REQUIRE_FALSE(occluders.hides(Eigen::Vector3f(0.0f, 0.0f, -1.0e6f), 1.0e6f, 1.0f));
+    }
+
+    SECTION("Observer inside a sphere")
+    {
+        occluders.add(Eigen::Vector3f(0.0f, 0.0f, -5.0f), 10.0f);
+        REQUIRE(occluders.empty());
+    }
+
+    // A sphere of radius 1 at distance 2 covers 30 degrees around its center
+    occluders.add(Eigen::Vector3f(2.0f, 0.0f, 0.0f), 1.0f);
+    REQUIRE(occluders.size() == 1);
+
+    SECTION("Points")
+    {
+        auto direction = [](float degrees) -> Eigen::Vector3f
+        {
+            float angle = degrees * static_cast<float>(M_PI) / 180.0f;
+            return Eigen::Vector3f(std::cos(angle), std::sin(angle), 0.0f) * 1.0e6f;
+        };
+
+        REQUIRE(hidesPoint(occluders, direction(0.0f)));
+        REQUIRE(hidesPoint(occluders, direction(29.0f)));
+        REQUIRE_FALSE(hidesPoint(occluders, direction(31.0f)));
+        REQUIRE_FALSE(hidesPoint(occluders, direction(180.0f)));
+    }
+
+    SECTION("Spheres")
+    {
+        float distance = 1.0e6f;
+        float radius = distance * std::sin(10.0f * static_cast<float>(M_PI) / 180.0f);
+        auto offset = [distance](float degrees) -> Eigen::Vector3f
+        {
+            float angle = degrees * static_cast<float>(M_PI) / 180.0f;
+            return Eigen::Vector3f(std::cos(angle), 0.0f, std::sin(angle)) * distance;
+        };
+
+        REQUIRE(occluders.hides(offset(0.0f), distance, radius));
+        REQUIRE(occluders.hides(offset(19.0f), distance, radius));
+        REQUIRE_FALSE(occluders.hides(offset(21.0f), distance, radius));
+
+        // Larger than the occluder
+        float large = distance * std::sin(40.0f * static_cast<float>(M_PI) / 180.0f);
+        REQUIRE_FALSE(occluders.hides(offset(0.0f), distance, large));
+
+        // Observer inside the sphere
+        REQUIRE_FALSE(occluders.hides(offset(0.0f), distance, 2.0f * distance));
+    }
+
+    SECTION("Clear")
+    {
+        occluders.clear();
+        REQUIRE_FALSE(hidesPoint(occluders, Eigen::Vector3f(1.0e6f, 0.0f, 0.0f)));
+    }
+}
@@ -0,0 +1,141 @@
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <catch.hpp>
+
+#include <celcompat/filesystem.h>
+#include <celengine/tilecache.h>
+
+namespace
+{
+
+constexpr std::size_t TileBytes = 1000;
+
+// A downloader writing a tile of TileBytes bytes for URLs not ending in
+// "missing", counting its calls
+TileCache::Downloader
+fakeDownloader(std::atomic<int>& downloads)
+{
+    return [&downloads](const std::string& url, const fs::path& path)
+    {
+        ++downloads;
+        if (url.size() >= 7 && url.compare(url.size() - 7, 7, "missing") == 0)
+            return false;
+        std::ofstream out(path, std::ios::out | std::ios::binary);
+        out << std::string(TileBytes, 'x');
+        return out.good();
+    };
+}
+
+class TempDirectory
+{
+ public:
+    TempDirectory() :
+        path(fs::temp_directory_path() / "celestia-tilecache-test")
+    {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    }
+
+    ~TempDirectory()
+    {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    }
+
+    fs::path path;
+};
+
+void
+setAge(const fs::path& path, std::chrono::hours age)
+{
+    fs::last_write_time(path, fs::file_time_type::clock::now() - age);
+}
+
+} // end unnamed namespace
+
+TEST_CASE("TileCache", "[TileCache]")
+{
+    TempDirectory directory;
+    std::atomic<int> downloads{ 0 };
+
+    SECTION("Tiles are downloaded once")
+    {
+        TileCache cache(directory.path, 1 << 20, fakeDownloader(downloads));
+        fs::path first = cache.fetch("https://example.org/0/0_0", ".jpg");
+        REQUIRE(!first.empty());
+        REQUIRE(first.extension() == ".jpg");
+        REQUIRE(fs::file_size(first) == TileBytes);
+
+        fs::path second = cache.fetch("https://example.org/0/0_0", ".jpg");
+        REQUIRE(second == first);
+        REQUIRE(downloads == 1);
+        REQUIRE(cache.getSize() == TileBytes);
+    }
+
+    SECTION("Tiles are found again by a new cache")
+    {
+        {
+            TileCache cache(directory.path, 1 << 20, fakeDownloader(downloads));
+            cache.fetch("https://example.org/0/0_0", ".png");
+        }
+
+        TileCache cache(directory.path, 1 << 20, fakeDownloader(downloads));
+        REQUIRE(cache.getSize() == TileBytes);
+        REQUIRE(!cache.fetch("https://example.org/0/0_0", ".png").empty());
+        REQUIRE(downloads == 1);
+    }
+
+    SECTION("Failed downloads leave no file")
+    {
+        TileCache cache(directory.path, 1 << 20, fakeDownloader(downloads));
+        REQUIRE(cache.fetch("https://example.org/missing", ".jpg").empty());
+        REQUIRE(fs::is_empty(directory.path));
+        REQUIRE(cache.getSize() == 0);
+    }
+
+    SECTION("The tiles fetched least recently are deleted")
+    {
+        TileCache cache(directory.path, 3 * TileBytes, fakeDownloader(downloads));
+        fs::path a = cache.fetch("https://example.org/a", ".jpg");
+        fs::path b = cache.fetch("https://example.org/b", ".jpg");
+        fs::path c = cache.fetch("https://example.org/c", ".jpg");
+        setAge(a, std::chrono::hours(3));
+        setAge(b, std::chrono::hours(2));
+        setAge(c, std::chrono::hours(1));
+
+        REQUIRE(cache.fetch("https://example.org/a", ".jpg") == a);
+        fs::path d = cache.fetch("https://example.org/d", ".jpg");
+        REQUIRE(!d.empty());
+
+        REQUIRE(cache.getSize() <= 3 * TileBytes);
+        REQUIRE(fs::exists(a));
+        REQUIRE(!fs::exists(b));
+        REQUIRE(fs::exists(d));
+    }
+
+    SECTION("Concurrent fetches of a tile share its download")
+    {
+        TileCache::Downloader download = fakeDownloader(downloads);
+        TileCache cache(directory.path, 1 << 20,
+                        [&download](const std::string& url, const fs::path& path)
+                        {
+                            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                            return download(url, path);
+                        });
+
+        fs::path paths[4];
+        std::thread threads[4];
+        for (int i = 0; i < 4; ++i)
+            threads[i] = std::thread([&cache, &paths, i]() { paths[i] = cache.fetch("https://example.org/0/0_0", ".jpg"); });
+        for (std::thread& thread : threads)
+            thread.join();
+
+        REQUIRE(downloads == 1);
+        for (const fs::path& path : paths)
+            REQUIRE(path == paths[0]);
+    }
+}
@@ -3,6 +3,7 @@
 #include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <tuple>
 
 #include <celutil/tokenizer.h>
@@ -517,3 +518,117 @@ TEST_CASE("Tokenizer skips comments", "[Tokenizer]")
 }
 
 
+
+TEST_CASE("Tokenizer reads text in place", "[Tokenizer]")
+{
+    std::string_view input = "\357\273\277"
+                             "Name \"plain\" \"esc\\\"aped\" # comment\n"
+                             "-1.5e3 42 { } # trailing comment";
+    Tokenizer tok(input);
+
+    REQUIRE(tok.nextToken() == Tokenizer::TokenName);
+    auto name = tok.getNameValue();
+    REQUIRE(name == "Name");
+    REQUIRE(name->data() == input.data() + 3);
+
+    REQUIRE(tok.nextToken() == Tokenizer::TokenString);
+    auto plain = tok.getStringValue();
+    REQUIRE(plain == "plain");
+    REQUIRE(plain->data() == input.data() + 9);
+
+    REQUIRE(tok.nextToken() == Tokenizer::TokenString);
+    REQUIRE(tok.getStringValue() == "esc\"aped");
+
+    REQUIRE(tok.nextToken() == Tokenizer::TokenNumber);
+    REQUIRE(tok.getNumberValue() == -1500.0);
+
+    REQUIRE(tok.nextToken() == Tokenizer::TokenNumber);
+    REQUIRE(tok.getIntegerValue() == 42);
+
+    REQUIRE(tok.nextToken() == Tokenizer::TokenBeginGroup);
+    REQUIRE(tok.nextToken() == Tokenizer::TokenEndGroup);
+    REQUIRE(tok.nextToken() == Tokenizer::TokenEnd);
+
+    Tokenizer empty(std::string_view{});
+    REQUIRE(empty.nextToken() == Tokenizer::TokenEnd);
+}
+
+TEST_CASE("Tokenizer replays token lists", "[Tokenizer]")
+{
+    std::string_view input = "Name \"str\\ning\" # comment\n"
+                             "-2 1.5 { A [ 1 2 ] } <km> |\n"
+                             "\"bad\\escape\" More";
+
+    Tokenizer source(input);
+    TokenList tokens(source);
+
+    Tokenizer expected(input);
+    Tokenizer replayed(tokens);
+    for (;;)
+    {
+        auto type = expected.nextToken();
+        REQUIRE(replayed.nextToken() == type);
+        REQUIRE(replayed.getLineNumber() == expected.getLineNumber());
+        REQUIRE(replayed.getNameValue() == expected.getNameValue());
+        REQUIRE(replayed.getStringValue() == expected.getStringValue());
+        REQUIRE(replayed.getNumberValue() == expected.getNumberValue());
+        REQUIRE(replayed.getIntegerValue() == expected.getIntegerValue());
+        if (type == Tokenizer::TokenEnd || type == Tokenizer::TokenError)
+            break;
+    }
+
+    // Reading stopped at the error
+    REQUIRE(replayed.nextToken() == Tokenizer::TokenError);
+
+    Tokenizer empty(std::string_view{});
+    TokenList noTokens(empty);
+    REQUIRE(noTokens.empty());
+    Tokenizer replayedEmpty(noTokens);
+    REQUIRE(replayedEmpty.nextToken() == Tokenizer::TokenEnd);
+}
+
+TEST_CASE("Tokenizer stores token lists", "[Tokenizer]")
+{
+    std::string_view input = "Name \"string\" -2 1.5 { A [ 1 2 ] }\n<km> |";
+
+    Tokenizer source(input);
+    TokenList tokens(source);
+
+    std::ostringstream out;
+    REQUIRE(tokens.write(out));
+    std::string data = out.str();
+
+    SECTION("A stored list replays the same tokens")
+    {
+        REQUIRE(TokenList::isTokenList(data));
+        TokenList restored;
+        REQUIRE(restored.read(data));
+
+        Tokenizer expected(input);
+        Tokenizer replayed(restored);
+        for (;;)
+        {
+            auto type = expected.nextToken();
+            REQUIRE(replayed.nextToken() == type);
+            REQUIRE(replayed.getLineNumber() == expected.getLineNumber());
+            REQUIRE(replayed.getNameValue() == expected.getNameValue());
+            REQUIRE(replayed.getStringValue() == expected.getStringValue());
+            REQUIRE(replayed.getNumberValue() == expected.getNumberValue());
+            if (type == Tokenizer::TokenEnd)
+                break;
+        }
+    }
+
+    SECTION("Damaged data is rejected")
+    {
+        TokenList restored;
+        REQUIRE_FALSE(restored.read(std::string_view(data).substr(0, data.size() - 1)));
+        REQUIRE(restored.empty());
+
+        std::string badMagic = data;
+        badMagic[0] = 'X';
+        REQUIRE_FALSE(TokenList::isTokenList(badMagic));
+        REQUIRE_FALSE(restored.read(badMagic));
+        REQUIRE_FALSE(restored.read(std::string_view{}));
+    }
+}
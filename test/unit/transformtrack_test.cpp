@@ -0,0 +1,166 @@
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <catch.hpp>
+
+#include <celcompat/filesystem.h>
+#include <celcompat/numbers.h>
+#include <celmodel/mesh.h>
+#include <celmodel/model.h>
+#include <celmodel/modelfile.h>
+#include <celmodel/transformtrack.h>
+#include <celutil/reshandle.h>
+
+using namespace cmod;
+
+namespace
+{
+
+ResourceHandle
+getHandle(const fs::path&)
+{
+    return 0;
+}
+
+fs::path
+getSource(ResourceHandle)
+{
+    return "texture.png";
+}
+
+// A quarter turn about z over two seconds around the pivot (1, 0, 0),
+// moving up by one unit
+TransformTrack
+makeTrack()
+{
+    TransformTrack track;
+    track.setPivot(Eigen::Vector3f(1.0f, 0.0f, 0.0f));
+
+    TransformTrack::Key key;
+    key.time = 0.0f;
+    REQUIRE(track.addKey(key));
+
+    key.time = 2.0f;
+    key.rotation = Eigen::Quaternionf(Eigen::AngleAxisf(celestia::numbers::pi_v<float> * 0.5f, Eigen::Vector3f::UnitZ()));
+    key.translation = Eigen::Vector3f(0.0f, 0.0f, 1.0f);
+    REQUIRE(track.addKey(key));
+    return track;
+}
+
+std::unique_ptr<Model>
+makeModel()
+{
+    Mesh mesh;
+    VertexDescription desc({ VertexAttribute(VertexAttributeSemantic::Position, VertexAttributeFormat::Float3, 0) });
+    desc.strideBytes = 3 * sizeof(VWord);
+    mesh.setVertexDescription(std::move(desc));
+
+    float positions[9] = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f };
+    std::vector<VWord> vertices(9);
+    std::memcpy(vertices.data(), positions, sizeof(positions));
+    mesh.setVertices(3, std::move(vertices));
+    mesh.addGroup(PrimitiveGroupType::TriList, 0, { 0, 1, 2 });
+    mesh.setTrackIndex(0);
+
+    auto model = std::make_unique<Model>();
+    model->addMaterial(Material());
+    model->addTrack(makeTrack());
+    model->addMesh(std::move(mesh));
+    return model;
+}
+
+} // end unnamed namespace
+
+
+TEST_CASE("Transform tracks", "[TransformTrack]")
+{
+    TransformTrack track = makeTrack();
+
+    SECTION("Keys are interpolated about the pivot")
+    {
+        Eigen::Vector3f p(2.0f, 0.0f, 0.0f);
+        REQUIRE(track.evaluate(0.0).isApprox(Eigen::Affine3f::Identity()));
+
+        Eigen::Vector3f half = track.evaluate(1.0) * p;
+        float s = std::sqrt(0.5f);
+        REQUIRE(half.isApprox(Eigen::Vector3f(1.0f + s, s, 0.5f)));
+    }
+
+    SECTION("Tracks loop")
+    {
+        REQUIRE(track.evaluate(5.0).isApprox(track.evaluate(1.0)));
+        REQUIRE(track.evaluate(-1.0).isApprox(track.evaluate(1.0)));
+    }
+
+    SECTION("Keys must be in order")
+    {
+        TransformTrack::Key key;
+        key.time = 1.0f;
+        REQUIRE(!track.addKey(key));
+        REQUIRE(track.getKeys().size() == 2);
+    }
+
+    SECTION("Transforming the track follows its vertices")
+    {
+        Eigen::Vector3f p(2.0f, 0.0f, 0.0f);
+        Eigen::Vector3f translation(1.0f, 2.0f, 3.0f);
+        Eigen::Vector3f expected = (track.evaluate(1.0) * p + translation) * 0.5f;
+
+        track.transform(translation, 0.5f);
+        REQUIRE((track.evaluate(1.0) * ((p + translation) * 0.5f)).isApprox(expected));
+    }
+}
+
+
+TEST_CASE("Transform tracks in cmod files", "[TransformTrack]")
+{
+    auto model = makeModel();
+    Eigen::Affine3f expected = model->getTrack(0)->evaluate(1.0);
+
+    SECTION("ASCII files")
+    {
+        std::ostringstream out;
+        REQUIRE(SaveModelAscii(model.get(), out, getSource));
+        std::istringstream in(out.str());
+        auto loaded = LoadModel(in, getHandle);
+
+        REQUIRE(loaded != nullptr);
+        REQUIRE(loaded->getTrackCount() == 1);
+        REQUIRE(loaded->getMesh(0)->getTrackIndex() == 0);
+        REQUIRE(loaded->getTrack(0)->evaluate(1.0).isApprox(expected));
+    }
+
+    SECTION("Binary files")
+    {
+        std::ostringstream out(std::ios::out | std::ios::binary);
+        REQUIRE(SaveModelBinary(model.get(), out, getSource));
+        std::istringstream in(out.str(), std::ios::in | std::ios::binary);
+        auto loaded = LoadModel(in, getHandle);
+
+        REQUIRE(loaded != nullptr);
+        REQUIRE(loaded->getTrackCount() == 1);
+        REQUIRE(loaded->getMesh(0)->getTrackIndex() == 0);
+        REQUIRE(loaded->getTrack(0)->evaluate(1.0).isApprox(expected));
+    }
+
+    SECTION("Track indices are checked")
+    {
+        std::string source = "#celmodel__ascii\n"
+                             "mesh\n"
+                             "vertexdesc\nposition f3\nend_vertexdesc\n"
+                             "vertices 1\n0 0 0\n"
+                             "track 0\n"
+                             "points 0 1\n0\n"
+                             "end_mesh\n";
+        std::istringstream in(source);
+        REQUIRE(LoadModel(in, getHandle) == nullptr);
+    }
+}
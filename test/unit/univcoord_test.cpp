@@ -0,0 +1,86 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celengine/univcoord.h>
+#include <celutil/r128util.h>
+
+using namespace celestia::util;
+
+namespace
+{
+
+bool
+sameBits(const R128& a, const R128& b)
+{
+    return a.lo == b.lo && a.hi == b.hi;
+}
+
+// Values over the whole range of universal coordinates, with the limits
+// and the values rounded differently on either side of zero
+std::vector<double>
+getValues()
+{
+    std::vector<double> values{ 0.0, -0.0, 1.0, -1.0, 0.5, -0.5, 1.0e-20, -1.0e-20,
+                                3.0e18, -3.0e18,
+                                9223372036854775808.0, -9223372036854775808.0,
+                                1.0e19, -1.0e19, 1.0e300, -1.0e300 };
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> exponent(-20.0, 18.0);
+    std::uniform_real_distribution<double> mantissa(-1.0, 1.0);
+    for (int i = 0; i < 2000; i++)
+        values.push_back(mantissa(rng) * std::pow(10.0, exponent(rng)));
+    return values;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("UniversalCoord", "[UniversalCoord]")
+{
+    std::vector<double> values = getValues();
+
+    SECTION("Fixed point kernels give the same results as R128")
+    {
+        for (double v : values)
+        {
+            R128 r(v);
+            REQUIRE(sameBits(fixedFromDouble(v), r));
+            REQUIRE(fixedToDouble(r) == static_cast<double>(r));
+        }
+
+        REQUIRE(fixedToDouble(R128_min) == static_cast<double>(R128_min));
+        REQUIRE(fixedToDouble(R128_max) == static_cast<double>(R128_max));
+
+        for (std::size_t i = 1; i < values.size(); i++)
+        {
+            R128 a(values[i - 1]);
+            R128 b(values[i]);
+            REQUIRE(sameBits(addFixed(a, b), a + b));
+            REQUIRE(sameBits(subtractFixed(a, b), a - b));
+            REQUIRE(fixedDifferenceToDouble(a, b) == static_cast<double>(a - b));
+        }
+
+        // Carries and borrows across the fractional part
+        R128 fraction(0xffffffffffffffffULL, 0);
+        R128 one(0, 1);
+        REQUIRE(sameBits(addFixed(fraction, one), fraction + one));
+        REQUIRE(sameBits(addFixed(fraction, fraction), fraction + fraction));
+        REQUIRE(sameBits(subtractFixed(one, fraction), one - fraction));
+        REQUIRE(sameBits(subtractFixed(R128_min, one), R128_min - one));
+    }
+
+    SECTION("Offsets from an origin are computed together as one at a time")
+    {
+        UniversalCoord origin = UniversalCoord::CreateLy(Eigen::Vector3d(4.2, -1.3, 0.7));
+        std::vector<UniversalCoord> coords;
+        for (std::size_t i = 2; i < values.size(); i += 3)
+            coords.emplace_back(values[i - 2] * 1.0e-3, values[i - 1] * 1.0e-3, values[i] * 1.0e-3);
+
+        std::vector<Eigen::Vector3d> offsets(coords.size());
+        UniversalCoord::offsetsFromKm(origin, coords, offsets.data());
+        for (std::size_t i = 0; i < coords.size(); i++)
+            REQUIRE(offsets[i] == coords[i].offsetFromKm(origin));
+    }
+}
@@ -0,0 +1,73 @@
+#include <cmath>
+#include <memory>
+
+#include <catch.hpp>
+
+#include <celcompat/numbers.h>
+#include <celephem/customorbittype.h>
+#include <celephem/orbit.h>
+#include <celephem/vsop87.h>
+
+#include "orbitsamplecollector.h"
+
+using namespace celestia::ephem;
+
+namespace
+{
+
+constexpr double AU = 1.495978707e8;
+constexpr double J2000 = 2451545.0;
+
+// Heliocentric ecliptic coordinates in Celestia's coordinate system
+Eigen::Vector3d
+fromSpherical(double l, double b, double r)
+{
+    return Eigen::Vector3d(std::cos(l) * std::cos(b), std::sin(b), -std::sin(l) * std::cos(b)) * r;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("VSOP87 orbits", "[VSOP87]")
+{
+    SECTION("Positions match the VSOP87B check values")
+    {
+        // Bretagnon and Francou, vsop87.chk: Earth and Jupiter at J2000.0;
+        // the tolerance allows for the truncation of the series
+        auto earth = CreateVSOP87Orbit(CustomOrbitType::VSOP87Earth);
+        REQUIRE(earth != nullptr);
+        Eigen::Vector3d expected = fromSpherical(1.7519238681, -0.0000039656, 0.9833276819 * AU);
+        REQUIRE((earth->positionAtTime(J2000) - expected).norm() < 2.0e-6 * AU);
+
+        auto jupiter = CreateVSOP87Orbit(CustomOrbitType::VSOP87Jupiter);
+        REQUIRE(jupiter != nullptr);
+        expected = fromSpherical(0.6334614186, -0.0205001039, 4.9653813154 * AU);
+        REQUIRE((jupiter->positionAtTime(J2000) - expected).norm() < 2.0e-5 * AU);
+    }
+
+    SECTION("Sampled positions and velocities match the full series")
+    {
+        auto mars = CreateVSOP87Orbit(CustomOrbitType::VSOP87Mars);
+        REQUIRE(mars != nullptr);
+
+        double period = mars->getPeriod();
+        SampleCollector collector;
+        mars->sample(J2000, J2000 + 2.0 * period, collector);
+
+        const auto& samples = collector.samples;
+        REQUIRE(samples.size() >= 301);
+        REQUIRE(samples.size() <= 302);
+        REQUIRE(samples.front().t == J2000);
+        REQUIRE(samples.back().t == Approx(J2000 + 2.0 * period));
+
+        for (const OrbitSample& sample : samples)
+        {
+            // The coarse series leave out terms adding up to 1e-7
+            Eigen::Vector3d position = mars->positionAtTime(sample.t);
+            REQUIRE((sample.position - position).norm() < 1.0e-6 * AU);
+
+            Eigen::Vector3d velocity = (mars->positionAtTime(sample.t + 0.01) -
+                                        mars->positionAtTime(sample.t - 0.01)) / 0.02;
+            REQUIRE((sample.velocity - velocity).norm() < 1.0e-4 * velocity.norm());
+        }
+    }
+}